@@ -0,0 +1,40 @@
+#ifndef BOOT_TRACE_H
+#define BOOT_TRACE_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Boot phase profiler.
+ *
+ * Each boot phase is bracketed by boot_trace_begin()/boot_trace_end(), which
+ * only store an RDTSC timestamp, so they work from the first instruction of
+ * main(), long before the clock is calibrated. Phases nest: a phase begun
+ * inside another is recorded as its sub-phase. boot_trace_report() converts
+ * the cycles with the calibrated TSC rate and prints every phase over serial,
+ * longest first, with its share of the whole boot; it also closes the
+ * trace, so code that runs both at boot and later (a FAT mount, say) is only
+ * timed during boot.
+ *
+ * Boot runs on the BSP alone with interrupts off, so nothing here locks.
+ */
+
+#define BOOT_TRACE_MAX_PHASES 64 // Phases beyond this are not recorded
+#define BOOT_TRACE_MAX_DEPTH  8
+
+/** @brief Starts phase @p name (a string literal) inside the current one. */
+void boot_trace_begin(const char *name);
+
+/** @brief Ends the most recently begun phase. */
+void boot_trace_end(void);
+
+/** @brief Times @p stmt as phase @p name. */
+#define BOOT_TRACE(name, stmt) do { \
+    boot_trace_begin(name); \
+    stmt; \
+    boot_trace_end(); \
+} while (0)
+
+/** @brief Prints the sorted phase breakdown over serial and closes the trace. */
+void boot_trace_report(void);
+
+#endif // BOOT_TRACE_H
@@ -0,0 +1,53 @@
+#ifndef INITCALL_H
+#define INITCALL_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Deferred initialization, run in kernel threads after the scheduler
+ * starts.
+ *
+ * main() registers the init steps the first user program doesn't need with
+ * initcall_defer() and goes on to launch it as soon as the root file system
+ * is mounted. initcall_start() then creates a runner thread that works
+ * through the levels in order: every call of a level gets its own kernel
+ * thread, so the calls of one level run in parallel (on whichever CPUs the
+ * load balancer gives them), and a level starts only once all calls of the
+ * levels below it have returned. A call may therefore rely on earlier
+ * levels but not on its own.
+ *
+ * Each call's duration is logged over serial, like boot_trace's report for
+ * the synchronous part of boot.
+ */
+
+typedef enum initcall_level {
+    INITCALL_LEVEL_DEVICE = 0, // Drivers that nothing in early boot depends on
+    INITCALL_LEVEL_LATE,       // Anything that needs those devices
+    INITCALL_LEVEL_COUNT
+} initcall_level_t;
+
+#define INITCALL_MAX 16
+
+typedef void (*initcall_fn_t)(void);
+
+/**
+ * @brief Registers @p fn (named @p name, a string literal) to run at
+ * @p level. Call before initcall_start().
+ * @return false if the table is full or the level is invalid; the caller
+ * should then run @p fn itself.
+ */
+bool initcall_defer(initcall_level_t level, const char *name, initcall_fn_t fn);
+
+/**
+ * @brief Creates the runner thread; the calls start once the scheduler does.
+ * Without a thread the calls run here, synchronously, in level order.
+ */
+void initcall_start(void);
+
+/** @brief True once every call at @p level and below has returned. */
+bool initcall_level_done(initcall_level_t level);
+
+/** @brief Blocks the calling task until initcall_level_done(@p level). */
+void initcall_wait(initcall_level_t level);
+
+#endif // INITCALL_H
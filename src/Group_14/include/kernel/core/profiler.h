@@ -0,0 +1,56 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <libc/stdint.h>
+#include <kernel/cpu/isr_frame.h>
+
+/**
+ * @brief Statistical sampling profiler driven by the timer interrupt.
+ *
+ * While it runs, every Nth timer tick on each CPU records where that CPU was
+ * interrupted (EIP, privilege level and PID) in the CPU's own ring. The
+ * samples are read back with SYS_PROFILE, or printed over serial for
+ * scripts/profile_symbolize.sh to map onto kernel.bin's functions. A full
+ * ring keeps the newest samples and counts the overwritten ones as lost.
+ *
+ * Code that runs with interrupts disabled cannot be sampled: the tick waits
+ * for them to be re-enabled, so that time is charged to the instruction
+ * after the sti or popf.
+ */
+
+#define PROFILE_RING_SAMPLES 2048 // Per CPU; a power of two
+
+/** One sample, as PROFILE_READ returns them; part of the syscall ABI. */
+typedef struct profile_sample {
+    uint32_t eip;
+    uint32_t pid;       // Task that was interrupted; 0 for the idle task
+    uint8_t  cpu;
+    uint8_t  cpl;       // 0 in the kernel, 3 in user mode
+    uint16_t reserved;
+} profile_sample_t;
+
+/* SYS_PROFILE(op, arg2, arg3) operations */
+#define PROFILE_START 0 // (period): sample every period-th tick on each CPU; drops old samples
+#define PROFILE_STOP  1 // Stop sampling; the samples stay readable
+#define PROFILE_READ  2 // (buf, size): takes the oldest samples, CPU by CPU -> bytes filled
+#define PROFILE_DUMP  3 // Takes every sample and prints it to serial
+
+/** @brief Timer tick on this CPU, interrupted at @p frame. Interrupts off. */
+void profile_tick(const isr_frame_t *frame);
+
+/**
+ * @brief Starts sampling every @p period-th tick with empty rings.
+ * @return 0, -EINVAL for period 0, or -ENOMEM.
+ */
+int32_t profile_start(uint32_t period);
+
+/** @brief Stops sampling. */
+void profile_stop(void);
+
+/** @brief Prints and takes every recorded sample over serial. */
+void profile_dump(void);
+
+/** @brief SYS_PROFILE. */
+int32_t profile_ctl(uint32_t op, uint32_t arg2, uint32_t arg3);
+
+#endif // PROFILER_H
@@ -0,0 +1,83 @@
+#ifndef TRACEPOINT_H
+#define TRACEPOINT_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Static tracepoints with a per-CPU binary ring and a Chrome trace
+ * (Perfetto) JSON export.
+ *
+ * TRACEPOINT(id, a, b) marks an event in the code with two 32-bit
+ * arguments. While the id's bit is clear in g_tracepoint_mask, which is
+ * the default, a tracepoint costs one load and a branch that is not
+ * taken. Building with TRACEPOINTS=0 (CMake option UIAOS_TRACEPOINTS)
+ * compiles them out.
+ *
+ * An enabled tracepoint appends a timestamped record to this CPU's ring.
+ * The timestamp is the TSC when it drives the clock, otherwise
+ * clock_monotonic_ns(). A full ring drops its oldest records.
+ *
+ * tracepoint_dump() merges the rings in time order and prints them over
+ * serial as one Chrome trace JSON array, between "[Trace] JSON begin" and
+ * "[Trace] JSON end" lines; scripts/trace_extract.sh cuts it out of the
+ * log for chrome://tracing or ui.perfetto.dev. Each CPU is one thread
+ * row. Block transfers and vfs_open() are async begin/end pairs, so their
+ * latency reads straight off the timeline.
+ *
+ * The "trace" kernel command line flag enables every tracepoint once the
+ * scheduler is up, so the root mount shows in the trace.
+ */
+
+#ifndef TRACEPOINTS
+#define TRACEPOINTS 1
+#endif
+
+typedef enum tracepoint_id {
+    TP_SCHED_SWITCH = 0,  // (old pid, new pid)
+    TP_SCHED_WAKEUP,      // (pid, 0): scheduler_unblock_task()
+    TP_PAGE_FAULT,        // (address, error code)
+    TP_BUFFER_HIT,        // (lba, 0): buffer_get*() found the block cached
+    TP_BUFFER_MISS,       // (lba, 0): buffer_get*() had to read or wait for it
+    TP_BLOCK_SUBMIT,      // (lba, sectors | TP_BLOCK_WRITE): one block_device_transfer()
+    TP_BLOCK_COMPLETE,    // (lba, status)
+    TP_FAT_ALLOC,         // (first cluster, clusters): fat_allocate_extent()
+    TP_VFS_OPEN,          // (first 4 bytes of the last path component, next 4)
+    TP_VFS_OPEN_DONE,     // (1 if a file was opened, 0)
+    TP_COUNT
+} tracepoint_id_t;
+
+#define TP_BLOCK_WRITE  0x80000000u
+#define TRACEPOINT_ALL  ((1u << TP_COUNT) - 1)
+#define TRACEPOINT_RING_RECORDS 2048 // Per CPU; a power of two
+
+/* SYS_TRACEPOINT(op, arg2, arg3) operations */
+#define TRACEPOINT_ENABLE 0 // (mask of 1 << TP_*): set the enabled tracepoints -> previous mask
+#define TRACEPOINT_DUMP   1 // Print and drop every record as Chrome trace JSON over serial
+
+extern volatile uint32_t g_tracepoint_mask;
+
+/** @brief Appends tracepoint @p id to this CPU's ring. Use TRACEPOINT(). */
+void tracepoint_record(tracepoint_id_t id, uint32_t a, uint32_t b);
+
+#if TRACEPOINTS
+#define TRACEPOINT(id, a, b) do { \
+    if (__builtin_expect(g_tracepoint_mask & (1u << (id)), 0)) \
+        tracepoint_record((id), (uint32_t)(a), (uint32_t)(b)); \
+} while (0)
+#else
+#define TRACEPOINT(id, a, b) do { } while (0)
+#endif
+
+/**
+ * @brief Sets the enabled tracepoints; the rings are allocated on first use.
+ * @return The previous mask, or -ENOMEM (nothing is enabled then).
+ */
+int32_t tracepoint_enable(uint32_t mask);
+
+/** @brief Prints and drops every record as a Chrome trace over serial. */
+void tracepoint_dump(void);
+
+/** @brief SYS_TRACEPOINT. */
+int32_t tracepoint_ctl(uint32_t op, uint32_t arg2, uint32_t arg3);
+
+#endif // TRACEPOINT_H
@@ -29,6 +29,34 @@ struct dirent {
     // Add other fields like d_reclen if needed by userspace
 };
 
+/* One entry of a getdents batch: records follow each other in the buffer */
+struct dirent_rec {
+    uint32_t d_ino;
+    uint32_t d_off;       // Cookie resuming after this entry (lseek SEEK_SET on the directory)
+    uint16_t d_reclen;    // Bytes to the next record (name and padding included)
+    uint8_t  d_type;
+    char     d_name[];    // NUL-terminated
+};
+#define DIRENT_REC_LEN(name_len) \
+    ((__builtin_offsetof(struct dirent_rec, d_name) + (name_len) + 1 + 3) & ~(size_t)3)
+
+/* File attributes (stat/fstat) */
+#define VFS_S_IFMT   0170000
+#define VFS_S_IFIFO  0010000  // Pipes
+#define VFS_S_IFCHR  0020000  // The terminal descriptors
+#define VFS_S_IFDIR  0040000
+#define VFS_S_IFREG  0100000
+struct vfs_stat {
+    uint32_t st_ino;      // Driver file number (the page cache identity where there is one)
+    uint32_t st_mode;     // VFS_S_IF* type plus permission bits
+    uint32_t st_size;     // Bytes (0 for FAT directories)
+    uint32_t st_blksize;  // Allocation unit in bytes
+    uint32_t st_blocks;   // Allocation units in use
+    uint32_t st_attr;     // Driver attribute bits (FAT_ATTR_* on FAT, 0 elsewhere)
+    uint32_t st_mtime;    // Seconds since 1970-01-01 UTC, 0 if unknown
+    uint32_t st_ctime;    // Creation time, same units
+};
+
 
 #ifndef _UINT64_T_DEFINED // Add guards if these might be defined elsewhere later
 typedef unsigned long long uint64_t;
@@ -0,0 +1,58 @@
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Minimal ACPI table discovery for interrupt-controller topology.
+ *
+ * Only the RSDP, RSDT, MADT ("APIC") and HPET tables are parsed; the MADT
+ * is cached in an acpi_madt_info_t that SMP start-up and interrupt routing
+ * read from.
+ */
+
+#define ACPI_MADT_MAX_CPUS     16
+#define ACPI_MADT_MAX_IOAPICS  4
+#define ACPI_MADT_MAX_ISOS     16
+
+/** @brief One I/O APIC from the MADT. */
+typedef struct acpi_ioapic {
+    uint8_t   id;
+    uint32_t  phys_addr;
+    uint32_t  gsi_base;     // First global system interrupt it serves
+} acpi_ioapic_t;
+
+/** @brief ISA IRQ to GSI override (e.g. PIT IRQ0 -> GSI2). */
+typedef struct acpi_irq_override {
+    uint8_t   bus_irq;
+    uint32_t  gsi;
+    uint16_t  flags;        // MPS INTI polarity (bits 0-1) / trigger (bits 2-3)
+} acpi_irq_override_t;
+
+/** @brief Processor and interrupt-controller layout reported by the MADT. */
+typedef struct acpi_madt_info {
+    bool                 valid;
+    bool                 pcat_compat;                        // Legacy 8259 pair present
+    uint32_t             lapic_phys;
+    uint32_t             cpu_count;                          // Enabled processors
+    uint8_t              cpu_apic_ids[ACPI_MADT_MAX_CPUS];   // In MADT order
+    uint32_t             ioapic_count;
+    acpi_ioapic_t        ioapics[ACPI_MADT_MAX_IOAPICS];
+    uint32_t             override_count;
+    acpi_irq_override_t  overrides[ACPI_MADT_MAX_ISOS];
+} acpi_madt_info_t;
+
+/**
+ * @brief Locates the RSDP in the BIOS areas and parses the MADT.
+ * Safe to call more than once; later calls return the cached result.
+ * @return true if a valid MADT was found.
+ */
+bool acpi_init(void);
+
+/** @brief Cached MADT contents (valid == false if acpi_init() found none). */
+const acpi_madt_info_t *acpi_get_madt(void);
+
+/** @brief Physical base of the HPET register block, 0 if there is none (probes ACPI if needed). */
+uint32_t acpi_get_hpet_phys(void);
+
+#endif // ACPI_H
@@ -15,17 +15,18 @@
  
  /**
   * @brief Defines a single entry in the kernel's exception table.
-  * Each entry maps a specific kernel instruction address, which is known
-  * to potentially fault when accessing user memory (e.g., a MOV instruction
-  * in copy_from_user), to a "fixup" address within the same function.
-  * If a page fault occurs at `fault_addr`, the page fault handler should
-  * look up this table. If found, it modifies the EIP on the fault stack frame
-  * to point to `fixup_addr` and returns via `iret`, allowing the function
-  * to handle the fault (e.g., by returning an error code) instead of crashing.
+  * Each entry covers a range of kernel instructions known to potentially
+  * fault when accessing user memory (e.g., the rep movs sequence in
+  * copy_from_user) and names a "fixup" address within the same function.
+  * If a page fault occurs with EIP in [fault_addr, fault_end), the page fault
+  * handler modifies the EIP on the fault stack frame to point to `fixup_addr`
+  * and returns via `iret`, allowing the function to handle the fault (e.g.,
+  * by working out how far it got from its registers) instead of crashing.
   */
  typedef struct {
-     uint32_t fault_addr;  /**< Address of the kernel instruction *allowed* to fault (EIP). */
-     uint32_t fixup_addr;  /**< Address to jump to (via modified IRET) if a fault occurs at fault_addr. */
+     uint32_t fault_addr;  /**< First instruction address *allowed* to fault (EIP). */
+     uint32_t fault_end;   /**< One past the last instruction byte of the range. */
+     uint32_t fixup_addr;  /**< Address to jump to (via modified IRET) if a fault occurs in the range. */
  } exception_entry_t;
  
  /**
@@ -45,8 +46,8 @@
   * @brief Finds the fixup address corresponding to a faulting kernel instruction address.
   *
   * This function iterates through the exception table (between `__start_ex_table`
-  * and `__stop_ex_table`) searching for an entry whose `fault_addr` matches the
-  * provided `fault_eip`.
+  * and `__stop_ex_table`) searching for an entry whose [`fault_addr`, `fault_end`)
+  * range contains the provided `fault_eip`.
   *
   * @param fault_eip The EIP (instruction pointer) where the kernel page fault occurred.
   * @return The corresponding `fixup_addr` if an entry is found.
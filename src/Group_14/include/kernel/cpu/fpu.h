@@ -0,0 +1,65 @@
+#ifndef FPU_H
+#define FPU_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Lazy x87/SSE context management.
+ *
+ * Every context switch sets CR0.TS instead of saving and reloading FPU state.
+ * The first FPU/SSE instruction a task executes afterwards raises #NM
+ * (vector 7); the handler clears TS and loads that task's FXSAVE image
+ * (allocated on first use). Tasks that never touch the FPU never get a save
+ * area and never pay for FXSAVE/FXRSTOR.
+ *
+ * State is written back at switch-out only if the task used the FPU during
+ * that slice (TS still clear), so the in-memory image is always current and
+ * a task may migrate freely. If a task comes back to a CPU whose registers
+ * still hold its state, the #NM handler skips the restore as well.
+ */
+
+#define FPU_STATE_SIZE  512  // FXSAVE/FXRSTOR image (must be 16-byte aligned)
+
+struct tcb;
+
+/** @brief Per-task FPU save area; allocated on the task's first #NM. */
+typedef struct fpu_state {
+    uint8_t  raw[FPU_STATE_SIZE + 15]; // Aligned into by fpu_area()
+} fpu_state_t;
+
+/**
+ * @brief Detects FXSR/SSE, enables them in CR0/CR4 and installs the #NM handler.
+ * Must run after idt_init() and before the first task is scheduled.
+ */
+void fpu_init(void);
+
+/** @brief True if fpu_init() found a usable FXSAVE-capable FPU. */
+bool fpu_available(void);
+
+/** @brief True if fpu_init() also found SSE2 (copy_page()/clear_page() then use it). */
+bool fpu_has_sse2(void);
+
+/**
+ * @brief Lets kernel code use the FPU/XMM registers until kernel_fpu_end().
+ * Writes the live task state back to its save area first (its owner reloads
+ * it on the next #NM) and keeps interrupts off throughout, so nothing else
+ * on this CPU touches the registers meanwhile. Keep the region short; only
+ * valid once fpu_available().
+ * @return The interrupt state to hand to kernel_fpu_end().
+ */
+uintptr_t kernel_fpu_begin(void);
+
+/** @brief Ends a kernel_fpu_begin() region: sets CR0.TS again and restores interrupts. */
+void kernel_fpu_end(uintptr_t irq_flags);
+
+/**
+ * @brief Called by schedule() just before switching from @p old_task.
+ * Saves @p old_task's state if it used the FPU this slice, then sets CR0.TS
+ * so the next FPU instruction traps.
+ */
+void fpu_switch_out(struct tcb *old_task);
+
+/** @brief Drops a dying task's FPU ownership and frees its save area. */
+void fpu_release_task(struct tcb *task);
+
+#endif // FPU_H
@@ -21,6 +21,9 @@ extern "C" {
  #define GDT_USER_CODE_SELECTOR 0x18 | 0x03 // 3rd entry (index 3), RPL 3
  #define GDT_USER_DATA_SELECTOR 0x20 | 0x03 // 4th entry (index 4), RPL 3
 
+// Index 6: Per-CPU data segment (Base=&g_percpu[cpu], byte limit, DPL=0), kept in %fs
+#define GDT_PERCPU_SELECTOR 0x30 // (6 * 8) | 0
+
 
 struct gdt_entry {
     uint16_t limit_low;    // Lower 16 bits of the segment limit.
@@ -49,12 +52,21 @@ struct gdt_ptr {
  *   - User code segment (ring 3).
  *   - User data segment (ring 3).
  *   - TSS descriptor.
+ *   - Per-CPU data segment (loaded into %fs).
  *
  * After setting up the GDT, the function flushes it to update the CPU's segment registers
  * and loads the TSS.
  */
 void gdt_init(void);
 
+/**
+ * @brief Builds and loads the GDT and TSS of CPU @p cpu (0 = bootstrap CPU).
+ *
+ * Each CPU has its own table with the same layout as above. Application
+ * processors call this from their start-up path before taking interrupts.
+ */
+void gdt_init_cpu(uint32_t cpu);
+
 #ifdef __cplusplus
 }
 #endif
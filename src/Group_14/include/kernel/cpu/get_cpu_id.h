@@ -3,19 +3,28 @@
 #define GET_CPU_ID_H
 
 #include <kernel/core/types.h> 
+#include <kernel/cpu/percpu.h>
+
+// Maximum number of CPUs the kernel keeps per-CPU state for.
+#ifndef MAX_CPUS
+#define MAX_CPUS 4
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /**
- * @brief Retrieves the current CPU's identifier using the CPUID instruction.
+ * @brief Retrieves the current CPU's logical index.
  *
- * This function uses CPUID with EAX=1 to obtain the Local APIC ID from EBX (bits 24–31).
- * In an SMP environment, this value may be remapped if necessary.
+ * A single load from the per-CPU area in %fs (see percpu.h), valid from
+ * gdt_init_cpu() onwards on every CPU.
  *
- * @return The CPU's identifier (0 if CPUID is not supported or in uniprocessor systems).
+ * @return The CPU's logical index in [0, MAX_CPUS) (0 for the bootstrap CPU).
  */
-int get_cpu_id(void);
+static inline int get_cpu_id(void) {
+    return (int)percpu_read(cpu_id);
+}
 
 #ifdef __cplusplus
 }
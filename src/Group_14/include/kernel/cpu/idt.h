@@ -82,6 +82,11 @@ typedef struct interrupt_handler_info {
  */
 void idt_init(void);
 
+/**
+ * @brief Loads the already-initialized IDT on the calling CPU (used by APs).
+ */
+void idt_load(void);
+
 /**
  * @brief Registers a C handler function for a specific interrupt number.
  *
@@ -91,6 +96,31 @@ void idt_init(void);
  */
 void register_int_handler(int num, int_handler_t handler, void* data);
 
+/**
+ * @brief Reports an unhandled interrupt or exception and halts. Handlers that
+ * only claim some cases of their vector pass the rest on to it.
+ */
+void default_isr_handler(isr_frame_t* frame);
+
+/**
+ * @brief Acknowledges legacy IRQ @p irq_line (0-15) at whichever controller
+ * delivered it: the local APIC once idt_route_irqs_via_ioapic() succeeded,
+ * the 8259 pair otherwise. IRQ handlers call this instead of writing PIC ports.
+ */
+void irq_send_eoi(uint8_t irq_line);
+
+/**
+ * @brief Moves the keyboard (IRQ1) and ATA (IRQ14/15) interrupts from the
+ * 8259 PIC to the I/O APIC, delivered to @p dest_apic_id on their usual
+ * vectors, then masks the PIC. The PIT (IRQ0) is left masked: callers switch
+ * the scheduler tick to the local APIC timer first.
+ * @return false (PIC left in charge) if no I/O APIC is usable.
+ */
+bool idt_route_irqs_via_ioapic(uint8_t dest_apic_id);
+
+/** @brief True once legacy IRQs are delivered by the I/O APIC. */
+bool idt_irqs_via_ioapic(void);
+
 
 // Helper for optional delays (used in PIC init)
 static inline void io_wait(void) {
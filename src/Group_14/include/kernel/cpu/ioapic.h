@@ -0,0 +1,35 @@
+#ifndef IOAPIC_H
+#define IOAPIC_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief I/O APIC redirection of legacy ISA interrupts.
+ *
+ * The I/O APICs are taken from the ACPI MADT. ISA IRQs are translated to
+ * global system interrupts through the MADT interrupt source overrides,
+ * including their polarity and trigger mode. Interrupts delivered this way
+ * are acknowledged with lapic_eoi() (a single MMIO write) instead of 8259
+ * port writes.
+ */
+
+/**
+ * @brief Maps every I/O APIC listed in the MADT and masks all of its inputs.
+ * @return true if at least one I/O APIC is usable.
+ */
+bool ioapic_init(void);
+
+/** @brief True once ioapic_init() succeeded. */
+bool ioapic_present(void);
+
+/**
+ * @brief Routes ISA IRQ @p isa_irq to @p vector on the CPU with local APIC
+ * ID @p dest_apic_id (fixed delivery, physical destination) and unmasks it.
+ * @return false if no I/O APIC serves the IRQ's GSI.
+ */
+bool ioapic_route_isa_irq(uint8_t isa_irq, uint8_t vector, uint8_t dest_apic_id);
+
+/** @brief Masks ISA IRQ @p isa_irq at its I/O APIC. */
+void ioapic_mask_isa_irq(uint8_t isa_irq);
+
+#endif // IOAPIC_H
@@ -0,0 +1,41 @@
+#ifndef IRQ_STATS_H
+#define IRQ_STATS_H
+
+#include <libc/stdint.h>
+
+/**
+ * @brief Per-vector interrupt accounting.
+ *
+ * Every interrupt entry (isr_common_handler() and the dedicated timer and
+ * IPI entries in idt.c) reads the TSC on the way in and adds the cycles up
+ * to its exit, deferred softirq work included, to this CPU's counters for
+ * the vector. A reschedule on the way out is not counted. No lock is taken:
+ * each CPU writes only its own row, with interrupts off. SYS_IRQ_STATS sums
+ * the CPUs. Without a TSC-driven clock, calls are counted but cycle figures
+ * stay 0, as for syscall_stats.h.
+ */
+
+#define IRQ_STATS_VECTORS 256
+
+/** SYS_IRQ_STATS record; part of the syscall ABI, append fields at the end only. */
+typedef struct irq_stats {
+    uint32_t vector;
+    uint32_t count;
+    uint32_t reserved[2];
+    uint64_t total_cycles;
+    uint64_t max_cycles;
+} irq_stats_t;
+
+/** @brief Timestamp for irq_stats_account(): the TSC, or 0 without one. */
+uint64_t irq_stats_start(void);
+
+/** @brief Adds one interrupt on @p vector, begun at @p start, to this CPU's counters. Interrupts off. */
+void irq_stats_account(uint32_t vector, uint64_t start);
+
+/**
+ * @brief Sums @p vector's counters over all CPUs into @p out.
+ * @return 0, or -EINVAL for a vector out of range.
+ */
+int irq_stats_get(uint32_t vector, irq_stats_t *out);
+
+#endif // IRQ_STATS_H
@@ -0,0 +1,92 @@
+#ifndef LAPIC_H
+#define LAPIC_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Local APIC access (xAPIC, memory-mapped).
+ *
+ * The register page is mapped once through the kernel MMIO window and is the
+ * same physical page on every CPU; each CPU sees its own APIC behind it.
+ */
+
+// Register offsets
+#define LAPIC_REG_ID          0x020
+#define LAPIC_REG_VERSION     0x030
+#define LAPIC_REG_TPR         0x080
+#define LAPIC_REG_EOI         0x0B0
+#define LAPIC_REG_SVR         0x0F0
+#define LAPIC_REG_ESR         0x280
+#define LAPIC_REG_ICR_LO      0x300
+#define LAPIC_REG_ICR_HI      0x310
+#define LAPIC_REG_LVT_TIMER   0x320
+#define LAPIC_REG_LVT_LINT0   0x350
+#define LAPIC_REG_LVT_LINT1   0x360
+#define LAPIC_REG_LVT_ERROR   0x370
+#define LAPIC_REG_TIMER_INIT  0x380
+#define LAPIC_REG_TIMER_CUR   0x390
+#define LAPIC_REG_TIMER_DIV   0x3E0
+
+// Vectors owned by the local APIC
+#define LAPIC_TIMER_VECTOR     0xF0
+#define IPI_RESCHEDULE_VECTOR  0xF1
+#define IPI_TLB_SHOOTDOWN_VECTOR 0xF2 // See tlb.h
+#define LAPIC_SPURIOUS_VECTOR  0xFF
+
+/**
+ * @brief Maps the local APIC registers at @p phys_base and enables the
+ * APIC globally (IA32_APIC_BASE). Call once on the BSP.
+ * @return true if the APIC is usable.
+ */
+bool lapic_init(uintptr_t phys_base);
+
+/** @brief True once lapic_init() mapped the registers. */
+bool lapic_present(void);
+
+/**
+ * @brief Software-enables this CPU's APIC (SVR) with the spurious vector,
+ * clears the task priority and masks the timer and error entries. Call on
+ * every CPU.
+ * @param bsp True on the bootstrap CPU, which keeps 8259 interrupts flowing
+ * through LINT0 (virtual wire); APs mask LINT0/LINT1.
+ */
+void lapic_enable(bool bsp);
+
+/** @brief APIC ID of the calling CPU. */
+uint8_t lapic_id(void);
+
+/** @brief Signals end of interrupt to this CPU's APIC. */
+void lapic_eoi(void);
+
+/** @brief Sends a fixed IPI with @p vector to the CPU with APIC ID @p apic_id. */
+void lapic_send_ipi(uint8_t apic_id, uint8_t vector);
+
+/** @brief Sends an INIT IPI (assert) to @p apic_id. */
+void lapic_send_init(uint8_t apic_id);
+
+/** @brief Sends a STARTUP IPI; the AP starts at physical address vector_page << 12. */
+void lapic_send_startup(uint8_t apic_id, uint8_t vector_page);
+
+/**
+ * @brief Measures the APIC timer rate against the PIT. Run once on the BSP;
+ * all CPUs share the bus clock, so the result is reused by the APs.
+ * @return Timer counts (divide-by-16) per scheduler tick.
+ */
+uint32_t lapic_timer_calibrate(uint32_t tick_hz);
+
+/** @brief Starts this CPU's APIC timer in periodic mode on LAPIC_TIMER_VECTOR. */
+void lapic_timer_start_periodic(uint32_t counts_per_tick);
+
+/** @brief Fires LAPIC_TIMER_VECTOR once after @p counts (divide-by-16), then stops. */
+void lapic_timer_start_oneshot(uint32_t counts);
+
+/** @brief Counts left before the timer's next expiry (0 once a one-shot fired). */
+uint32_t lapic_timer_current_count(void);
+
+/**
+ * @brief Masks LINT0 on this CPU so 8259 output (virtual wire) is no longer
+ * accepted. Used once the I/O APIC delivers the legacy IRQs.
+ */
+void lapic_disable_extint(void);
+
+#endif // LAPIC_H
@@ -6,6 +6,12 @@
 
 // --- Common MSR Definitions ---
 #define MSR_EFER 0xC0000080 // Extended Feature Enable Register (for NXE, SCE, etc.)
+#define MSR_IA32_SYSENTER_CS  0x174 // Kernel CS for SYSENTER (SS = CS + 8, user CS/SS = CS + 16/24)
+#define MSR_IA32_SYSENTER_ESP 0x175 // Kernel ESP loaded by SYSENTER
+#define MSR_IA32_SYSENTER_EIP 0x176 // Kernel entry point for SYSENTER
+#define MSR_IA32_PMC0          0x0C1 // General-purpose counter 0 (counter n at +n)
+#define MSR_IA32_PERFEVTSEL0   0x186 // Event select for counter 0 (counter n at +n)
+#define MSR_IA32_PERF_GLOBAL_CTRL 0x38F // Per-counter enable bits (PMU version 2 and up)
 // Add other MSRs if needed, e.g.:
 // #define MSR_FS_BASE 0xC0000100
 // #define MSR_GS_BASE 0xC0000101
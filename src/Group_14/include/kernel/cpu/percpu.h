@@ -0,0 +1,89 @@
+#pragma once
+#ifndef PERCPU_H
+#define PERCPU_H
+
+#include <kernel/core/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Per-CPU data area.
+ *
+ * Each CPU's GDT carries a small ring-0 data segment (GDT_PERCPU_SELECTOR)
+ * whose base is that CPU's percpu_t. The kernel keeps it loaded in %fs, so a
+ * field is read with a single %fs-relative load: no CPUID (which exits to the
+ * hypervisor under virtualization), no APIC access and no lock.
+ *
+ * %fs is (re)loaded by gdt_init_cpu() and by every kernel entry stub; user
+ * mode never sees this selector (its DPL is 0).
+ */
+struct tcb;
+
+typedef struct percpu {
+    struct percpu *self;          // Linear address of this area
+    uint32_t       cpu_id;        // Logical CPU index
+    struct tcb    *current_task;  // Mirrors sched_cpu_t::current
+    void          *allocator;     // This CPU's cpu_allocator_t (percpu_alloc.c)
+    uintptr_t      active_pgd;    // Page directory (phys) in CR3; 0 until the first switch
+    uint32_t       kmap_depth;    // kmap_atomic() slots in use (paging.c)
+    uintptr_t      kmap_irq_flags; // Interrupt state saved by the outermost kmap_atomic()
+    uint32_t       softirq_pending; // Raised SOFTIRQ_* bits (softirq.c)
+    uint32_t       softirq_active;  // Non-zero while softirq_run_pending() runs handlers
+    uint32_t       preempt_count;   // The current task's locks and preempt_disable() depth (preempt.h)
+    uint32_t       rcu_qs;          // Quiescent states passed: context switches, idle/user ticks (rcu.h)
+    uint32_t       need_resched;    // Non-zero: switch at the next preemption point (preempt.h)
+} __attribute__((aligned(64))) percpu_t; // One cache line per CPU
+
+// Byte offset of need_resched, for the syscall exit stubs (checked in percpu.c)
+#define PERCPU_NEED_RESCHED_OFFSET 44
+
+/** @brief One area per CPU, indexed by logical CPU index. */
+extern percpu_t g_percpu[];
+
+/** @brief Set once the boot CPU has loaded %fs (gdt_init_cpu()). */
+extern bool g_percpu_ready;
+
+// Every field is one 32-bit word, so a plain movl covers them all.
+#define percpu_read(field) ({                                             \
+    __typeof__(((percpu_t *)0)->field) __pcpu_val;                        \
+    asm volatile("movl %%fs:%c1, %0"                                      \
+                 : "=r"(__pcpu_val)                                       \
+                 : "i"(__builtin_offsetof(percpu_t, field)));             \
+    __pcpu_val; })
+
+#define percpu_write(field, val) do {                                     \
+    __typeof__(((percpu_t *)0)->field) __pcpu_val = (val);                \
+    asm volatile("movl %0, %%fs:%c1"                                      \
+                 :                                                        \
+                 : "r"(__pcpu_val), "i"(__builtin_offsetof(percpu_t, field)) \
+                 : "memory");                                             \
+} while (0)
+
+// One addl: atomic against interrupts on this CPU, which is all a field needs
+#define percpu_add(field, val) do {                                       \
+    __typeof__(((percpu_t *)0)->field) __pcpu_val = (val);                \
+    asm volatile("addl %0, %%fs:%c1"                                      \
+                 :                                                        \
+                 : "ri"(__pcpu_val), "i"(__builtin_offsetof(percpu_t, field)) \
+                 : "memory", "cc");                                       \
+} while (0)
+
+/** @brief The calling CPU's area as an ordinary pointer. */
+static inline percpu_t *this_percpu(void) {
+    return percpu_read(self);
+}
+
+/**
+ * @brief Fills in the identity fields of CPU @p cpu's area and returns it.
+ * Called by gdt_init_cpu() before the segment is loaded; fields owned by
+ * other subsystems (current_task, allocator) are left untouched.
+ */
+percpu_t *percpu_init_cpu(uint32_t cpu);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PERCPU_H
@@ -0,0 +1,60 @@
+#ifndef PERCPU_COUNTER_H
+#define PERCPU_COUNTER_H
+
+#include <kernel/core/types.h>
+#include <kernel/cpu/get_cpu_id.h> // MAX_CPUS
+#include <kernel/sync/preempt.h>
+
+/**
+ * @brief Statistics counter with one cache line per CPU.
+ *
+ * Hot paths add to their own CPU's slot without a lock or a locked
+ * instruction, so counting never bounces a line between CPUs; readers sum
+ * the slots. A sum taken while others count is a snapshot, not an exact
+ * value at one instant, which is all statistics need. A zero-filled counter
+ * (static storage, memset) reads 0.
+ *
+ * Each slot is 64 bits, updated with addl/adcl: an interrupt on the same
+ * CPU between the two sees the low half already added and completes its own
+ * update before the adcl runs, so nested updates are never lost. Preemption
+ * is held off around the update so the task cannot move to another CPU
+ * between picking the slot and writing it.
+ */
+
+typedef struct {
+    volatile uint32_t lo;
+    volatile uint32_t hi;
+} __attribute__((aligned(64))) percpu_counter_slot_t;
+
+typedef struct percpu_counter {
+    percpu_counter_slot_t slots[MAX_CPUS];
+} percpu_counter_t;
+
+/** @brief Adds @p delta (negative to subtract) to this CPU's slot. Any context. */
+static inline void percpu_counter_add(percpu_counter_t *c, int32_t delta) {
+    preempt_disable();
+    // Before gdt_init() only the boot CPU runs and %fs is not set up yet
+    percpu_counter_slot_t *s = &c->slots[g_percpu_ready ? percpu_read(cpu_id) : 0];
+    asm volatile("addl %2, %0\n\t"
+                 "adcl %3, %1"
+                 : "+m"(s->lo), "+m"(s->hi)
+                 : "ri"((uint32_t)delta), "ri"(delta < 0 ? 0xFFFFFFFFu : 0u)
+                 : "cc");
+    preempt_enable();
+}
+
+static inline void percpu_counter_inc(percpu_counter_t *c) {
+    percpu_counter_add(c, 1);
+}
+
+static inline void percpu_counter_dec(percpu_counter_t *c) {
+    percpu_counter_add(c, -1);
+}
+
+/** @brief Sum of all CPUs' slots. */
+uint64_t percpu_counter_sum(const percpu_counter_t *c);
+
+/** @brief Zeroes every slot; only meaningful while nobody else counts. */
+void percpu_counter_reset(percpu_counter_t *c);
+
+#endif // PERCPU_COUNTER_H
@@ -0,0 +1,76 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Hardware performance counters on the architectural PMU.
+ *
+ * perf_init() reads the PMU's description from CPUID leaf 0xA. A task sets
+ * up the general-purpose counters for itself with SYS_PERF, and the counts
+ * are kept per task. When the task is switched out, perf_switch() adds the
+ * live counts to its perf_task_t and stops the counters. When it comes back,
+ * they are reprogrammed from zero. A task therefore only sees events from
+ * while it ran, in user mode, in the kernel, or both. Tasks that never ask
+ * for counters pay one NULL test per switch.
+ *
+ * Only the architectural PMU of Intel CPUs (CPUID leaf 0xA, version 1 and
+ * up) is driven. Without one, PERF_QUERY reports 0 counters and PERF_SET
+ * fails with -ENODEV.
+ */
+
+#define PERF_MAX_COUNTERS 4
+
+/* Events for PERF_SET; event n is architectural if bit n-1 of CPUID.0AH:EBX is clear */
+#define PERF_EVENT_NONE            0  // Frees the slot
+#define PERF_EVENT_CYCLES          1
+#define PERF_EVENT_INSTRUCTIONS    2
+#define PERF_EVENT_REF_CYCLES      3
+#define PERF_EVENT_LLC_REFERENCES  4
+#define PERF_EVENT_LLC_MISSES      5
+#define PERF_EVENT_BRANCHES        6
+#define PERF_EVENT_BRANCH_MISSES   7
+#define PERF_EVENT_DTLB_MISSES     8  // Model-specific: loads that walk the page tables (Intel family 6)
+
+/** Any other event, by its event select and unit mask from the vendor's tables. */
+#define PERF_RAW(event, umask) (0x80000000u | ((uint32_t)(umask) << 8) | (uint32_t)(event))
+#define PERF_USER   (1u << 16)  // Count in user mode; with neither flag, both modes count
+#define PERF_KERNEL (1u << 17)  // Count in the kernel
+
+/* SYS_PERF(op, arg2, arg3) operations, on the calling task */
+#define PERF_QUERY 0  // -> number of counter slots (0 without a PMU)
+#define PERF_SET   1  // (slot, event | flags): count that event in slot, from 0
+#define PERF_READ  2  // (uint64_t *buf, size): slot 0, 1, ... counts -> bytes filled
+#define PERF_RESET 3  // Zero every slot's count
+#define PERF_CLOSE 4  // Free every slot
+
+struct tcb;
+
+/** @brief Per-task counter state; allocated by the task's first PERF_SET. */
+typedef struct perf_task {
+    uint32_t evtsel[PERF_MAX_COUNTERS]; // IA32_PERFEVTSELx image; 0 while the slot is free
+    uint64_t count[PERF_MAX_COUNTERS];  // Events up to the last time the counters were folded in
+} perf_task_t;
+
+/** @brief Probes the PMU and sets up the BSP's counters. */
+void perf_init(void);
+
+/** @brief Stops every counter and enables them globally on the calling CPU (APs). */
+void perf_init_cpu(void);
+
+/** @brief Number of counter slots a task can program. */
+uint32_t perf_counters(void);
+
+/**
+ * @brief Called by the scheduler with interrupts off, just before switching
+ * from @p old_task to @p new_task on this CPU.
+ */
+void perf_switch(struct tcb *old_task, struct tcb *new_task);
+
+/** @brief Frees a dying task's counter state. */
+void perf_release_task(struct tcb *task);
+
+/** @brief SYS_PERF for the calling task @p task. */
+int32_t perf_ctl(struct tcb *task, uint32_t op, uint32_t arg2, uint32_t arg3);
+
+#endif // PERF_H
@@ -0,0 +1,43 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Multiprocessor start-up.
+ *
+ * smp_init() reads the processor list from the ACPI MADT and starts every
+ * enabled application processor with INIT/STARTUP IPIs. Each AP loads its
+ * own GDT/TSS, brings its scheduler state (idle task, run queues) online and
+ * waits for scheduler_start() on the BSP before it begins scheduling. Every
+ * CPU is ticked by its local APIC timer, calibrated once against the PIT;
+ * the BSP's timer also keeps the global clock (see tick.h).
+ *
+ * Without a usable MADT or local APIC the kernel simply stays uniprocessor
+ * on the PIT and the 8259 PIC.
+ */
+
+/**
+ * @brief Switches the BSP to its local APIC (timer and, when an I/O APIC
+ * exists, device interrupt routing) and starts the application processors.
+ * Call on the BSP after scheduler_init() and before scheduler_start(),
+ * with interrupts disabled.
+ */
+void smp_init(void);
+
+/** @brief Number of CPUs running kernel code (1 until APs are started). */
+uint32_t smp_cpu_count(void);
+
+/**
+ * @brief Asks logical CPU @p cpu_index to run schedule() at once.
+ * No-op when SMP is not active or @p cpu_index is the caller.
+ */
+void smp_send_reschedule(uint32_t cpu_index);
+
+/**
+ * @brief Sends fixed IPI @p vector to logical CPU @p cpu_index.
+ * No-op when SMP is not active or @p cpu_index is the caller.
+ */
+void smp_send_ipi(uint32_t cpu_index, uint8_t vector);
+
+#endif // SMP_H
@@ -0,0 +1,45 @@
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Deferred interrupt work.
+ *
+ * A hardware interrupt handler does the urgent part, sends its EOI and
+ * raises a softirq; the interrupt exit path in idt.c then runs the raised
+ * handlers on the way out of the outermost interrupt, with interrupts
+ * enabled, before it considers preemption. Pending bits are per CPU, so a softirq runs on
+ * the CPU that raised it.
+ *
+ * While handlers run, further interrupts nest but neither run softirqs
+ * nor switch tasks; a reschedule they ask for waits until the handlers
+ * finish. Handlers must not sleep.
+ */
+
+enum {
+    SOFTIRQ_TIMER,    // Driver timers (timer.h)
+    SOFTIRQ_SCHED,    // Sleep wheel expiry and reaper wakeups (scheduler.c)
+    SOFTIRQ_KEYBOARD, // Scancode decoding (keyboard.c)
+    SOFTIRQ_COUNT
+};
+
+typedef void (*softirq_handler_t)(void);
+
+/** @brief Installs the handler for softirq @p nr (at boot, before it is raised). */
+void softirq_register(uint32_t nr, softirq_handler_t handler);
+
+/** @brief Marks softirq @p nr pending on this CPU; callable from any context. */
+void softirq_raise(uint32_t nr);
+
+/**
+ * @brief Runs this CPU's pending softirqs. Called on interrupt exit (idt.c)
+ * with interrupts disabled; returns with them disabled. No-op when nested
+ * inside a running softirq.
+ */
+void softirq_run_pending(void);
+
+/** @brief True while this CPU is running softirq handlers. */
+bool softirq_in_progress(void);
+
+#endif // SOFTIRQ_H
@@ -12,6 +12,7 @@
 
 // Syscall numbers (ensure these match your definitions in hello.c and elsewhere)
 #define SYS_EXIT    1
+#define SYS_FORK    2 // () -> child PID in the parent, 0 in the child
 #define SYS_READ    3
 #define SYS_WRITE   4
 #define SYS_OPEN    5
@@ -20,8 +21,59 @@
 #define SYS_LSEEK   19
 #define SYS_GETPID  20
 #define SYS_READ_TERMINAL_LINE 21
+#define SYS_SCHED_STATS 22 // (pid or 0 for system totals, sched_task_stats_t *buf, size)
+#define SYS_CLOCK_GETTIME 23 // (clock id, clock_timespec_t *ts)
+#define SYS_WAITPID 24 // (pid or -1, int *status, options: WNOHANG)
+#define SYS_MMAP    25 // (const mmap_args_t *args) -> address or -errno
+#define SYS_MUNMAP  26 // (addr, length)
+#define SYS_BRK     27 // (new break, or 0 to query) -> resulting break; sbrk() is built on it in userspace
+#define SYS_BLOCK_STATS 28 // (device index, block_io_stats_t *buf, size)
+#define SYS_GETDENTS 29 // (fd, struct dirent_rec *buf, size) -> bytes filled, 0 at the end
+#define SYS_PREAD   30 // (fd, const pio_args_t *args) -> bytes read; the fd's position is unchanged
+#define SYS_PWRITE  31 // (fd, const pio_args_t *args) -> bytes written; the fd's position is unchanged
+#define SYS_READV   32 // (fd, const struct iovec *iov, iovcnt) -> bytes read into the buffers in order
+#define SYS_WRITEV  33 // (fd, const struct iovec *iov, iovcnt) -> bytes written from the buffers in order
+#define SYS_SENDFILE 34 // (const sendfile_args_t *args) -> bytes copied in the kernel from in_fd to out_fd
+#define SYS_COPY_FILE_RANGE 35 // (const copy_range_args_t *args) -> bytes copied between two files
+#define SYS_IO_SETUP 36 // (const io_ring_setup_args_t *args) -> 0; registers the batched I/O ring (io_ring.h)
+#define SYS_IO_ENTER 37 // (to_submit) -> SQEs consumed; their CQEs are posted before it returns
+#define SYS_STAT    38 // (const char *path, struct vfs_stat *buf) -> 0; answered from the lookup caches
+#define SYS_FSTAT   39 // (fd, struct vfs_stat *buf) -> 0
+#define SYS_SYSCALL_STATS 40 // (nr, syscall_stats_t *buf, size) -> bytes copied; see syscall_stats.h
+#define SYS_STRACE  41 // (op, arg, arg): STRACE_* on the caller's trace ring; see syscall_stats.h
+#define SYS_BATCH   42 // (syscall_batch_rec_t *recs, count, flags) -> records run; see below
+#define SYS_POLL    43 // (struct pollfd *fds, nfds, timeout_ms) -> fds with revents set, 0 on timeout; see poll.h
+#define SYS_PIPE    44 // (int fds[2]) -> 0; fds[0] reads what fds[1] writes (pipe.h)
+#define SYS_SHM_OPEN   45 // (const char *name, oflag, size) -> fd on a shared-memory object (shm.h)
+#define SYS_SHM_UNLINK 46 // (const char *name) -> 0; the object lives on while open or mapped
+#define SYS_FUTEX   47 // (uint32_t *uaddr, FUTEX_WAIT/FUTEX_WAKE, val) -> 0 / tasks woken; see futex.h
+#define SYS_THREAD_CREATE 48 // (entry, stack_top, arg) -> thread ID; entry(arg) runs beside the caller
+#define SYS_SPAWN   49 // (const spawn_args_t *args) -> child PID; fork+exec in one step (process.h)
+#define SYS_TTY_MODE 50 // (TTY_* mode bits, or -1 to query) -> previous mode; raw/cooked, echo, non-blocking (tty.h)
+#define SYS_IRQ_STATS 51 // (vector, irq_stats_t *buf, size) -> bytes copied; see irq_stats.h
+#define SYS_PROFILE 52 // (op, arg, arg): PROFILE_* on the sampling profiler; see profiler.h
+#define SYS_PERF    53 // (op, arg, arg): PERF_* on the caller's hardware counters; see perf.h
+#define SYS_TRACEPOINT 54 // (op, arg, arg): TRACEPOINT_* enable mask / Chrome trace dump; see tracepoint.h
+#define SYS_UNLINK  55 // (const char *path) -> 0; removes a file (or an empty directory)
+#define SYS_FSYNC   56 // (fd) -> 0 once the file's data and metadata are on disk; other files' dirty blocks stay cached
+#define SYS_FDATASYNC 57 // (fd) -> 0; as fsync, minus metadata its data can be read back without
 // Add other syscall numbers here as needed
 
+/**
+ * @brief One record of a SYS_BATCH array. The kernel runs the records in
+ * order as if each were its own trap and stores each result in ret.
+ * Only args[0..2] are passed today; args[3..5] must be 0. SYS_FORK and
+ * SYS_BATCH itself are refused with -EINVAL.
+ */
+typedef struct syscall_batch_rec {
+    uint32_t nr;
+    uint32_t args[6];
+    int32_t  ret;
+} syscall_batch_rec_t;
+
+#define SYSCALL_BATCH_MAX           64  // Records per SYS_BATCH call
+#define SYSCALL_BATCH_STOP_ON_ERROR 1   // flags: stop after the first negative ret
+
 /**
  * @brief Function pointer type for system call handlers.
  *
@@ -37,9 +89,20 @@ typedef int32_t (*syscall_fn_t)(uint32_t arg1_ebx, uint32_t arg2_ecx, uint32_t a
  */
 void syscall_init(void);
 
+/**
+ * @brief Enables the SYSENTER/SYSEXIT fast path on CPU @p cpu, if the CPU
+ * supports it. Must run on that CPU; syscall_init() covers the BSP.
+ *
+ * Fast-path ABI (the int 0x80 gate stays available with its usual ABI):
+ *   EAX = syscall number, EBX/ECX/EDX = arguments 1-3 (as for int 0x80),
+ *   ESI = user return address, EBP = user stack pointer.
+ *   Returns in EAX; ECX and EDX are clobbered, all other registers kept.
+ */
+void syscall_init_cpu(uint32_t cpu);
+
 /**
  * @brief The C-level system call dispatcher.
- * This function is called from the assembly interrupt handler (int 0x80).
+ * This function is called from the assembly entry stubs (int 0x80 and SYSENTER).
  * It identifies the syscall number and calls the appropriate handler.
  *
  * @param regs Pointer to the interrupt stack frame containing all saved registers.
@@ -0,0 +1,68 @@
+#ifndef SYSCALL_STATS_H
+#define SYSCALL_STATS_H
+
+#include <libc/stdint.h>
+
+/**
+ * @brief Per-syscall accounting and per-process syscall tracing.
+ *
+ * syscall_dispatcher() times every call with RDTSC (when the TSC drives the
+ * clock; otherwise cycle figures stay 0) and adds it to this CPU's
+ * counters, so no lock is taken on the syscall path. SYS_SYSCALL_STATS
+ * sums the CPUs. Durations are wall time in the kernel, so blocking calls
+ * include the time spent asleep.
+ *
+ * SYS_STRACE gives the calling process a ring of the last N calls it made,
+ * strace style. The ring can be read back, or printed to serial, and is
+ * printed when the process exits.
+ */
+
+#define SYSCALL_STATS_NR            64      // Syscalls numbered below this are counted
+#define SYSCALL_TRACE_MAX_ENTRIES   4096    // Largest ring SYS_STRACE accepts (a power of two)
+
+/** SYS_SYSCALL_STATS record; part of the syscall ABI, append fields at the end only. */
+typedef struct syscall_stats {
+    uint32_t nr;
+    uint32_t calls;
+    uint32_t errors;        // Calls that returned a negative errno
+    uint32_t reserved;
+    uint64_t total_cycles;
+    uint64_t max_cycles;
+} syscall_stats_t;
+
+/** One traced call, as SYS_STRACE STRACE_READ returns them. */
+typedef struct syscall_trace_rec {
+    uint32_t nr;
+    uint32_t args[3];       // EBX, ECX, EDX at entry
+    int32_t  ret;
+    uint32_t cpu;           // CPU the call returned on
+    uint64_t cycles;
+} syscall_trace_rec_t;
+
+/* SYS_STRACE(op, arg2, arg3) operations */
+#define STRACE_START 0      // (entries): start a fresh ring of that many records (power of two)
+#define STRACE_STOP  1      // Drop the ring
+#define STRACE_READ  2      // (buf, size): oldest records first -> bytes filled; the ring is kept
+#define STRACE_DUMP  3      // Print the ring to serial
+
+struct pcb;
+
+/** @brief Adds one call to this CPU's counters. Called with interrupts enabled or not. */
+void syscall_stats_account(uint32_t nr, int32_t ret, uint64_t cycles);
+
+/**
+ * @brief Sums syscall @p nr's counters over all CPUs into @p out.
+ * @return 0, or -EINVAL if @p nr is not counted.
+ */
+int syscall_stats_get(uint32_t nr, syscall_stats_t *out);
+
+/** @brief Appends a record to @p proc's ring (no-op without one). */
+void syscall_trace_record(struct pcb *proc, uint32_t nr, const uint32_t args[3], int32_t ret, uint64_t cycles);
+
+/** @brief SYS_STRACE for the calling process @p proc. */
+int32_t syscall_trace_ctl(struct pcb *proc, uint32_t op, uint32_t arg2, uint32_t arg3);
+
+/** @brief Prints @p proc's ring to serial and frees it (process teardown). */
+void syscall_trace_release(struct pcb *proc);
+
+#endif // SYSCALL_STATS_H
@@ -0,0 +1,34 @@
+#ifndef TSC_H
+#define TSC_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Reads the processor's time-stamp counter (RDTSC).
+ * @return Cycles since reset. Not serializing; callers that measure short
+ * intervals should expect a few cycles of reordering slop.
+ */
+static inline uint64_t read_tsc(void) {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/**
+ * @brief floor(log2(value)) for a 64-bit value, 0 for values 0 and 1.
+ * Uses BSR on the two halves so no 64-bit libgcc helpers are pulled in.
+ */
+static inline uint32_t tsc_log2(uint64_t value) {
+    uint32_t hi = (uint32_t)(value >> 32);
+    uint32_t lo = (uint32_t)value;
+    uint32_t bit;
+    if (hi) {
+        asm("bsrl %1, %0" : "=r"(bit) : "rm"(hi));
+        return bit + 32;
+    }
+    if (!lo) return 0;
+    asm("bsrl %1, %0" : "=r"(bit) : "rm"(lo));
+    return bit;
+}
+
+#endif // TSC_H
@@ -34,10 +34,16 @@ typedef struct tss_entry {
     uint16_t iomap_base; // The I/O Map Base Address Field (in TSS's)
 } __attribute__((packed)) tss_entry_t;
 
-// Initialize the TSS
+// Initialize the bootstrap CPU's TSS
 void tss_init(void);
 
-// Set the kernel stack pointer stored in the TSS
+// Initialize the TSS of CPU 'cpu' (does not load TR)
+void tss_init_cpu(uint32_t cpu);
+
+// TSS structure of CPU 'cpu' (for its GDT descriptor), NULL if out of range
+tss_entry_t *tss_get_entry(uint32_t cpu);
+
+// Set the kernel stack pointer stored in the calling CPU's TSS
 void tss_set_kernel_stack(uint32_t stack);
 
 // Verify that the TSS esp0 value is reasonable
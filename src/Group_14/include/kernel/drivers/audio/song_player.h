@@ -4,10 +4,50 @@
 #include <kernel/core/types.h>
 #include <kernel/drivers/audio/song.h>  // for Song struct
 
+/**
+ * The song player is a sequencer over the PC speaker: songs wait in a short
+ * queue, and a driver timer (timer.h) fires at every note edge to program
+ * the next note, so playing costs one timer callback per note and no task
+ * is tied up. Songs must stay valid until they have finished playing.
+ */
+
+#define SONG_QUEUE_LEN 8 // Songs waiting behind the one playing (a power of two)
+
+/**
+ * song_player_init
+ *   Sets up the sequencer; after timer_init().
+ */
+void song_player_init(void);
+
+/**
+ * queue_song
+ *   Appends the song to the queue and returns at once; it plays after the
+ *   songs ahead of it. Returns false if the queue is full.
+ */
+bool queue_song(Song *song);
+
 /**
  * play_song
- *   Plays the given song using the PC speaker device.
+ *   Queues the song and sleeps until it has finished (or was stopped).
  */
 void play_song(Song *song);
 
+/**
+ * play_song_async
+ *   Drops whatever is playing or queued and starts the song at once.
+ */
+void play_song_async(Song *song);
+
+/**
+ * stop_song
+ *   Ends the current song, drops the queue and silences the speaker.
+ */
+void stop_song(void);
+
+/**
+ * song_playing
+ *   True while a song is playing.
+ */
+bool song_playing(void);
+
 #endif
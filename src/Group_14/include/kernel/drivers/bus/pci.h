@@ -0,0 +1,71 @@
+#ifndef PCI_H
+#define PCI_H
+
+#include <kernel/core/types.h>
+
+/**
+ * PCI configuration space access (mechanism #1, ports 0xCF8/0xCFC).
+ *
+ * Enough to find a controller by class and hand its BARs to the driver;
+ * there is no device tree or hotplug.
+ */
+
+#define PCI_CONFIG_ADDRESS   0xCF8
+#define PCI_CONFIG_DATA      0xCFC
+
+// Configuration header offsets (type 0)
+#define PCI_VENDOR_ID        0x00
+#define PCI_DEVICE_ID        0x02
+#define PCI_COMMAND          0x04
+#define PCI_STATUS           0x06
+#define PCI_PROG_IF          0x09
+#define PCI_SUBCLASS         0x0A
+#define PCI_CLASS            0x0B
+#define PCI_HEADER_TYPE      0x0E
+#define PCI_BAR0             0x10
+#define PCI_INTERRUPT_LINE   0x3C
+
+// Command register bits
+#define PCI_COMMAND_IO          0x0001
+#define PCI_COMMAND_MEMORY      0x0002
+#define PCI_COMMAND_BUS_MASTER  0x0004
+
+#define PCI_BAR_IO           0x01 // BAR bit 0: I/O space
+#define PCI_VENDOR_NONE      0xFFFF
+
+// Mass storage class codes
+#define PCI_CLASS_STORAGE    0x01
+#define PCI_SUBCLASS_IDE     0x01
+#define PCI_SUBCLASS_SATA    0x06
+
+typedef struct {
+    uint8_t bus;
+    uint8_t slot;
+    uint8_t func;
+    uint16_t vendor_id;
+    uint16_t device_id;
+    uint8_t class_code;
+    uint8_t subclass;
+    uint8_t prog_if;
+    uint8_t irq_line;
+} pci_device_t;
+
+uint32_t pci_config_read32(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset);
+uint16_t pci_config_read16(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset);
+uint8_t  pci_config_read8(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset);
+void     pci_config_write32(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t value);
+void     pci_config_write16(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint16_t value);
+
+/**
+ * Find the index'th function (0 = first) with the given class and subclass.
+ * @return true and fills *out if found.
+ */
+bool pci_find_class(uint8_t class_code, uint8_t subclass, int index, pci_device_t *out);
+
+/** @brief Raw value of BAR n (0-5), type bits included. */
+uint32_t pci_read_bar(const pci_device_t *dev, int n);
+
+/** @brief Set bits in the command register (e.g. PCI_COMMAND_BUS_MASTER). */
+void pci_enable(const pci_device_t *dev, uint16_t command_bits);
+
+#endif // PCI_H
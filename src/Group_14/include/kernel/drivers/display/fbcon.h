@@ -0,0 +1,35 @@
+#ifndef FBCON_H
+#define FBCON_H
+
+#include <kernel/core/types.h>
+#include <kernel/arch/multiboot2.h>
+
+/**
+ * @brief Framebuffer console.
+ *
+ * Draws the terminal's VGA_COLS x VGA_ROWS character cells (character plus
+ * VGA attribute, exactly as in text mode) on a linear 32-bit RGB
+ * framebuffer, centred, with 8x16 glyphs. Everything is drawn into a back
+ * buffer in RAM first, from a cache of pre-rendered glyphs; only the cells
+ * that changed since the last present are drawn, and only their span of
+ * each text row is copied to the (uncached) framebuffer.
+ */
+
+/**
+ * @brief Maps the framebuffer of @p tag and allocates the back buffer.
+ * Needs paging and kmalloc. Fails (false) for anything but a 32-bit RGB
+ * framebuffer of at least the console's size below 4 GiB.
+ */
+bool fbcon_init(const struct multiboot_tag_framebuffer *tag);
+
+/**
+ * @brief Brings the screen up to date with @p cells.
+ * @param cells    VGA_ROWS rows of VGA_COLS cells, as shown.
+ * @param cursor   Cell index of the cursor, or -1 for none.
+ * @param scrolled Lines the contents moved up since the last call; the
+ *                 back buffer is moved along instead of redrawn. VGA_ROWS
+ *                 or more means unknown.
+ */
+void fbcon_present(const volatile uint16_t *cells, int cursor, int scrolled);
+
+#endif // FBCON_H
@@ -0,0 +1,12 @@
+#ifndef FONT8X8_H
+#define FONT8X8_H
+
+#include <kernel/core/types.h>
+
+#define FONT8X8_FIRST 0x20 // ' '
+#define FONT8X8_COUNT 95   // ' ' through '~'
+
+/** @brief Glyphs for FONT8X8_FIRST.., one byte per row, bit 0 the leftmost pixel. */
+extern const uint8_t g_font8x8[FONT8X8_COUNT][8];
+
+#endif // FONT8X8_H
@@ -10,7 +10,13 @@
 void serial_init(); // Optional initialization
 void serial_putchar(char c);
 void serial_write(const char *str);
+void serial_write_len(const char *data, size_t len);
 void serial_print_hex(uint32_t n); // Print hex value
 void serial_printf(const char *fmt, ...); // Printf-style serial output
 
+// After serial_enable_irq() the functions above only queue their bytes in a
+// ring that the COM1 transmit interrupt drains; before it they poll the UART.
+void serial_enable_irq(void); // Once the IDT is up, before IRQ routing is final
+void serial_flush_sync(void); // Panics: drain the ring by polling, poll from then on
+
 #endif // SERIAL_H
\ No newline at end of file
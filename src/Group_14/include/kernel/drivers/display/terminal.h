@@ -115,8 +115,8 @@ void terminal_printf(const char* format, ...) __attribute__((format(printf, 1, 2
 /**
  * @brief Processes a key event for interactive input editing.
  * This function is called by the keyboard driver's callback.
- * It handles line buffering for the SYS_READ_TERMINAL syscall and
- * can also manage the more complex multi-line input_state if active.
+ * Turns key presses into characters for the TTY line discipline (tty.h);
+ * Shift+PageUp/PageDown page the scrollback instead.
  * @param event The keyboard event.
  */
 void terminal_handle_key_event(const KeyEvent event);
@@ -166,15 +166,17 @@ void terminal_backspace(void);
 void terminal_write_bytes(const char* data, size_t size);
 
 /**
- * @brief Reads a line of input from the terminal, blocking until Enter is pressed.
- * This function is intended to be called by the SYS_READ_TERMINAL syscall handler.
- * It interacts with the internal line buffer populated by terminal_handle_key_event.
- * @param kbuf Kernel buffer to store the input line.
- * @param len Maximum number of bytes to read into kbuf (including null terminator).
- * @return The number of bytes read (excluding null terminator), or a negative error code.
- * Returns 0 for an empty line if Enter is pressed immediately.
+ * @brief Draws the console through fbcon from now on (fbcon_init() must have
+ * succeeded). The text window moves to RAM, boot output so far included.
  */
-ssize_t terminal_read_line_blocking(char *kbuf, size_t len);
+void terminal_use_framebuffer(void);
+
+/**
+ * @brief Brings the hardware cursor up to date after output.
+ * Writes only mark the cursor stale, which saves the slow CRTC port writes
+ * during bulk output; the scheduler tick (and idle entry) calls this.
+ */
+void terminal_tick(void);
 
 
 #endif // TERMINAL_H
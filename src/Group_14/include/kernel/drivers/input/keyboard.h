@@ -57,7 +57,11 @@ typedef struct {
 } KeyEvent;
 
 void      keyboard_init(void);
+// The event queue has one reader: keyboard_poll_event/keyboard_wait_event
+// must not be called from two places at once.
 bool      keyboard_poll_event(KeyEvent *ev);
+void      keyboard_wait_event(KeyEvent *ev);   // Blocks until an event arrives
+uint32_t  keyboard_events_dropped(void);       // Events lost to a full queue
 bool      keyboard_is_key_down(KeyCode key);
 uint8_t   keyboard_get_modifiers(void);
 void      keyboard_set_leds(bool scroll, bool num, bool caps);
@@ -0,0 +1,59 @@
+/**
+ * @file tty.h
+ * @brief The console TTY: line discipline and input queue behind fd 0.
+ *
+ * Key presses arrive from the keyboard IRQ as characters (tty_receive()).
+ * In cooked mode (the default) they are edited in a line buffer, echoed,
+ * and moved to the input queue a whole line at a time at Enter; Backspace,
+ * Ctrl+U (erase the line) and Ctrl+D (end of file on an empty line) are
+ * handled here. In raw mode every character goes to the queue at once.
+ *
+ * The input queue is a byte ring: a read takes as many bytes as it asks for
+ * (up to the end of one line when cooked), and what it leaves stays for the
+ * next. Any number of tasks may block reading; each new input wakes the
+ * longest-waiting one, and a reader that leaves bytes behind wakes the
+ * next, so one line is never handed to more than one task.
+ */
+
+#ifndef TTY_H
+#define TTY_H
+
+#include <kernel/core/types.h>
+#include <libc/stdbool.h>
+
+#define TTY_INPUT_SIZE 1024 // Input queue bytes, a power of two
+
+// Mode bits (tty_set_mode(), SYS_TTY_MODE); 0 is cooked, echoing and blocking
+#define TTY_RAW      0x01 // No line editing: each character is readable at once
+#define TTY_NOECHO   0x02 // Don't echo input to the console
+#define TTY_NONBLOCK 0x04 // Reads fail with -EAGAIN instead of blocking
+#define TTY_MODE_MASK (TTY_RAW | TTY_NOECHO | TTY_NONBLOCK)
+
+/** @brief Sets up the queue and the reader wait queue (before the keyboard). */
+void tty_init(void);
+
+/** @brief Feeds one input character through the line discipline (IRQ context). */
+void tty_receive(char c);
+
+/**
+ * @brief Reads up to @p len bytes of input into @p kbuf. Blocks until input
+ * is there unless TTY_NONBLOCK is set; cooked reads stop after a newline.
+ * @return Bytes read, 0 at end of file (Ctrl+D), -EAGAIN if nothing is
+ * there and reads don't block, or another negative errno.
+ */
+ssize_t tty_read(char *kbuf, size_t len);
+
+/** @brief True if a read would return without blocking. */
+bool tty_readable(void);
+
+/** @brief Current TTY_* mode bits. */
+uint32_t tty_get_mode(void);
+
+/**
+ * @brief Changes the mode. Going raw hands a half-typed line to the queue
+ * as it stands.
+ * @return The previous mode, or -EINVAL for unknown bits.
+ */
+int tty_set_mode(uint32_t mode);
+
+#endif // TTY_H
@@ -0,0 +1,33 @@
+#ifndef AHCI_H
+#define AHCI_H
+
+#include <kernel/core/types.h>
+#include <kernel/drivers/storage/block_device.h>
+
+/**
+ * AHCI (SATA) host controller driver.
+ *
+ * Disks on implemented ports are numbered in port order and opened as
+ * "sda", "sdb", ... through block_device_init(). Each port runs up to
+ * CAP.NCS command slots at once; with NCQ (READ/WRITE FPDMA QUEUED) the
+ * drive reorders them itself, otherwise the HBA executes them in turn.
+ * Completion is polled from PxCI/PxSACT, so callers on different CPUs can
+ * keep several commands in flight on one port.
+ */
+
+#define AHCI_MAX_DISKS 4 // sda..sdd
+
+// Probe the first AHCI controller and bring up its ports (call once at boot)
+void ahci_init(void);
+
+// Bind dev to the index'th AHCI disk ("sda" = 0)
+int ahci_device_init(int index, block_device_t *dev);
+
+// Read/write sectors; used by block_device_read/write for AHCI devices.
+// fua: the written data is on the medium when this returns.
+int ahci_transfer(block_device_t *dev, uint64_t lba, void *buffer, size_t count, bool write, bool fua);
+
+// Flush the drive's write cache; used by block_device_flush
+int ahci_flush(block_device_t *dev);
+
+#endif /* AHCI_H */
@@ -0,0 +1,13 @@
+#ifndef ATA_PIO_H
+#define ATA_PIO_H
+
+#include <kernel/core/types.h>
+
+// String-I/O sector transfers (ata_pio.asm): one rep ins/outs per call.
+// The 32-bit forms need a controller whose data port takes dword access.
+void ata_pio_read16(uint16_t port, void *buffer, uint32_t words);
+void ata_pio_write16(uint16_t port, const void *buffer, uint32_t words);
+void ata_pio_read32(uint16_t port, void *buffer, uint32_t dwords);
+void ata_pio_write32(uint16_t port, const void *buffer, uint32_t dwords);
+
+#endif /* ATA_PIO_H */
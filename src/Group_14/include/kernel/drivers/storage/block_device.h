@@ -19,6 +19,38 @@
 #define BLOCK_ERR_INTERNAL   -9 // Internal driver error
 #define BLOCK_ERR_IO         -10 // Generic I/O Error (e.g., DRQ not set when expected)
 
+// --- Transports ---
+#define BLOCK_TRANSPORT_ATA   0 // Legacy IDE ports (PIO / bus-master DMA)
+#define BLOCK_TRANSPORT_AHCI  1 // AHCI port, see ahci.h
+#define BLOCK_TRANSPORT_RAM   2 // Memory-backed disk, see ramdisk.h
+
+// --- I/O Statistics ---
+#define BLOCK_STATS_READ       0
+#define BLOCK_STATS_WRITE      1 // Plain and FUA writes
+#define BLOCK_STATS_FLUSH      2
+#define BLOCK_STATS_KINDS      3
+#define BLOCK_STATS_HIST_BUCKETS 32 // Bucket N: latency in [2^N, 2^(N+1)) TSC cycles
+#define BLOCK_MAX_DEVICES      8    // Devices listed by block_device_get_stats()
+
+/**
+ * @brief Per-device I/O accounting, readable via SYS_BLOCK_STATS. Operations
+ * are timed with RDTSC from entry to completion of block_device_read/write/
+ * flush, so they include waiting for the channel but not the request queue.
+ * Layout is part of the syscall ABI; append new fields at the end only.
+ */
+typedef struct block_io_stats {
+    char     name[8];                        // e.g. "hda", "sda"
+    uint32_t ops[BLOCK_STATS_KINDS];         // Completed operations
+    uint32_t errors[BLOCK_STATS_KINDS];      // Operations that failed
+    uint64_t sectors[2];                     // Sectors moved: [READ], [WRITE]
+    uint64_t bytes[2];
+    uint64_t cycles[BLOCK_STATS_KINDS];      // Total latency
+    uint32_t in_flight;                      // Operations in the driver right now
+    uint32_t max_in_flight;
+    uint32_t queued;                         // Requests waiting in the request queue (at read time)
+    uint32_t latency_hist[BLOCK_STATS_KINDS][BLOCK_STATS_HIST_BUCKETS];
+} block_io_stats_t;
+
 // --- Device Structure ---
 typedef struct {
     const char *device_name;   // e.g., "hda", "hdb"
@@ -28,11 +60,22 @@ typedef struct {
     // --- REORDERED FIELDS ---
     uint64_t total_sectors;    // Moved total_sectors up
     uint32_t sector_size;      // <<< MOVED UP: Now uint32_t before uint16_t
-    uint16_t multiple_sector_count; // Max sectors per READ/WRITE MULTIPLE cmd (0 if unsupported)
+    uint16_t multiple_sector_count; // Sectors per READ/WRITE MULTIPLE DRQ block (0 if unsupported)
     // --- END REORDER ---
     bool initialized;
     bool lba48_supported;
+    bool dma_supported;        // IDENTIFY reports DMA support
+    bool use_dma;              // Transfers go through the channel's bus-master engine
+    bool pio32;                // Data port takes 32-bit PIO (verified at IDENTIFY)
+    bool write_cache;          // Volatile write cache enabled: writes need a flush to be durable
+    bool fua_supported;        // WRITE ... FUA EXT commands (IDENTIFY word 84 bit 6)
+    volatile bool flush_pending; // Writes since the last flush may still sit in the cache
     spinlock_t *channel_lock;  // Pointer to the channel's lock (primary/secondary)
+    uint8_t transport;         // BLOCK_TRANSPORT_*
+    void *driver_data;         // Transport-private state (AHCI: the port, RAM: the disk)
+    struct block_queue *queue; // Request queue (block_queue.h); NULL = direct transfers only
+    spinlock_t stats_lock;
+    block_io_stats_t io_stats;
 } block_device_t;
 
 // --- Public API ---
@@ -40,17 +83,35 @@ typedef struct {
 // Initializes ATA channels (locks) - Call once at boot
 void ata_channels_init(void);
 
-// Initializes a specific block device structure (hda, hdb, etc.)
+// Initializes a specific block device structure (hda..hdd legacy, sda.. AHCI)
+// and gives it a request queue
 int block_device_init(const char *device, block_device_t *dev);
 
-// Reads sectors using best available method (MULTIPLE or single PIO)
+// Reads sectors using best available method (DMA, MULTIPLE or single PIO)
 // LBA is now uint64_t
 int block_device_read(block_device_t *dev, uint64_t lba, void *buffer, size_t count);
 
-// Writes sectors using best available method (MULTIPLE or single PIO)
-// LBA is now uint64_t
+// Writes sectors using best available method (DMA, MULTIPLE or single PIO)
+// LBA is now uint64_t. With a write cache the data may not be on the medium
+// until block_device_flush().
 int block_device_write(block_device_t *dev, uint64_t lba, const void *buffer, size_t count);
 
+// Writes sectors that are on the medium once this returns: FUA commands where
+// the device has them, otherwise a write followed by a cache flush
+int block_device_write_fua(block_device_t *dev, uint64_t lba, const void *buffer, size_t count);
+
+// Makes every write completed so far durable (FLUSH CACHE); returns at once
+// when nothing was written since the last flush or the device has no write cache
+int block_device_flush(block_device_t *dev);
+
+// Copies the I/O statistics of the index'th initialized device (0 = first)
+// @return BLOCK_ERR_OK, or BLOCK_ERR_NO_DEV past the last device
+int block_device_get_stats(uint32_t index, block_io_stats_t *out);
+
+// Prints every device's I/O statistics and latency histograms to serial
+void block_device_dump_stats(void);
+
 void ata_primary_irq_handler(isr_frame_t* frame); // <<< ADDED DECLARATION
+void ata_secondary_irq_handler(isr_frame_t* frame);
 
 #endif /* BLOCK_DEVICE_H */
\ No newline at end of file
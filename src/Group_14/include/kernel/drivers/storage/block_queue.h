@@ -0,0 +1,108 @@
+#ifndef BLOCK_QUEUE_H
+#define BLOCK_QUEUE_H
+
+#include <kernel/core/types.h>
+#include <kernel/drivers/storage/block_device.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/sync/wait_queue.h>
+
+/**
+ * Block request queue (one per block_device_t).
+ *
+ * Requests are submitted without waiting and dispatched by the kblockd
+ * kernel thread. A request adjacent to or overlapping a queued one in the
+ * same direction joins it, up to BLOCK_QUEUE_MAX_BYTES, and the joined
+ * requests move in one transfer.
+ *
+ * Dispatch is a deadline elevator. Queued transfers are kept sorted by LBA
+ * and served in one sweeping direction; a read waiting past
+ * BLOCK_QUEUE_READ_EXPIRE_MS (writes: BLOCK_QUEUE_WRITE_EXPIRE_MS) goes
+ * next instead. A transfer never passes an older one it overlaps, so
+ * reads and writes of the same sectors complete in submission order.
+ *
+ * Until the scheduler runs, or when the submitter cannot sleep, the
+ * submitter drains the queue itself, so its completion has normally run
+ * by the time block_queue_submit() returns.
+ */
+
+#define BLOCK_QUEUE_MAX_BYTES        (64 * 1024) // Largest merged transfer
+#define BLOCK_QUEUE_READ_EXPIRE_MS   500
+#define BLOCK_QUEUE_WRITE_EXPIRE_MS  5000
+
+typedef struct block_request block_request_t;
+
+// Completion callback: runs once per request, in task context (normally
+// kblockd). It must not start synchronous block I/O itself.
+typedef void (*block_request_done_t)(block_request_t *req, int status);
+
+struct block_request {
+    // Filled in by the submitter
+    uint64_t              lba;
+    size_t                count;     // Sectors
+    void                 *buffer;
+    bool                  write;
+    bool                  fua;       // Write: on the medium when done (block_device_write_fua)
+    block_request_done_t  done;
+    void                 *ctx;       // For the callback
+
+    // Queue-private
+    int                   status;
+    uint32_t              seq;       // Submission order of the transfer it heads
+    uint32_t              deadline;  // Tick by which it should be dispatched
+    uint64_t              unit_lba;  // Span of the merged transfer (head only)
+    size_t                unit_count;
+    block_request_t      *merge_next;              // Further requests in this transfer
+    block_request_t      *sort_prev, *sort_next;   // LBA-sorted transfers
+    block_request_t      *fifo_prev, *fifo_next;   // Per-direction submission order
+};
+
+typedef struct {
+    uint32_t submitted;    // Requests accepted
+    uint32_t merged;       // Requests folded into an already queued transfer
+    uint32_t dispatched;   // Transfers sent to the device
+    uint32_t expired;      // Transfers dispatched because their deadline passed
+    uint32_t queued;       // Requests currently waiting
+} block_queue_stats_t;
+
+typedef struct block_queue {
+    spinlock_t         lock;
+    block_device_t    *dev;
+    block_request_t   *sorted;          // Transfer heads by unit_lba
+    block_request_t   *fifo_head[2];    // [0] reads, [1] writes, oldest first
+    block_request_t   *fifo_tail[2];
+    uint64_t           head_pos;        // LBA just past the last dispatched transfer
+    uint32_t           next_seq;
+    bool               dispatching;     // Someone is running block_queue_run()
+    bool               on_run_list;     // Waiting for kblockd
+    struct block_queue *run_next;
+    wait_queue_t       sync_wq;         // block_queue_read/write waiters
+    block_queue_stats_t stats;
+} block_queue_t;
+
+/**
+ * @brief Creates the queue for an initialized device (dev->queue).
+ * @return BLOCK_ERR_OK, or BLOCK_ERR_INTERNAL if memory ran out (the device
+ *         then keeps working with direct, unqueued transfers).
+ */
+int block_queue_create(block_device_t *dev);
+
+/**
+ * @brief Queues @p req; req->done is called once it has completed.
+ * @return BLOCK_ERR_OK if queued (errors then arrive through the callback),
+ *         or a BLOCK_ERR_* code if the request was rejected outright.
+ */
+int block_queue_submit(block_device_t *dev, block_request_t *req);
+
+/** @brief Synchronous read through the queue (direct if it has none or the caller can't sleep). */
+int block_queue_read(block_device_t *dev, uint64_t lba, void *buffer, size_t count);
+
+/** @brief Synchronous write through the queue (direct if it has none or the caller can't sleep). */
+int block_queue_write(block_device_t *dev, uint64_t lba, const void *buffer, size_t count);
+
+/** @brief As block_queue_write(), but durable on return (FUA). */
+int block_queue_write_fua(block_device_t *dev, uint64_t lba, const void *buffer, size_t count);
+
+/** @brief Copies the queue's counters (zeroes if the device has no queue). */
+void block_queue_get_stats(block_device_t *dev, block_queue_stats_t *out);
+
+#endif /* BLOCK_QUEUE_H */
@@ -11,9 +11,18 @@
  // Buffer flags
  #define BUFFER_FLAG_VALID   0x01  // Buffer contains valid data
  #define BUFFER_FLAG_DIRTY   0x02  // Buffer has been modified, needs writing
- #define BUFFER_FLAG_LOCKED  0x04  // Buffer is locked for I/O
+ #define BUFFER_FLAG_LOCKED  0x04  // Read in flight; data not valid until it clears
  #define BUFFER_FLAG_ERROR   0x08  // Buffer has an I/O error
+ #define BUFFER_FLAG_VIEW    0x10  // Sector window into a larger block buffer (see parent)
+ #define BUFFER_FLAG_WRITEBACK 0x20 // Write to disk in flight (the block may be dirtied again meanwhile)
  #define MAX_BUFFER_BLOCK_SIZE      8192 
+ #define BUFFER_BULK_MAX_SECTORS    65536  // Largest buffer_read_bulk() request (one LBA48 command)
+ 
+ // Replacement policy, fixed at init (CMake UIAOS_BUFFER_CACHE_POLICY)
+ typedef enum {
+     BUFFER_POLICY_LRU = 0,   // Strict LRU
+     BUFFER_POLICY_2Q  = 1,   // Scan-resistant 2Q: first-use FIFO + hot LRU + ghost keys
+ } buffer_cache_policy_t;
  
  // Statistics structure
  typedef struct {
@@ -26,24 +35,59 @@
      uint32_t io_errors;      // I/O errors encountered
      uint32_t cached_buffers; // Current number of buffers in cache
      uint32_t dirty_buffers;  // Current number of dirty buffers
+     uint32_t readahead_blocks; // Blocks brought in by read-ahead
+     uint32_t pool_buffers;   // Buffers preallocated from the memory budget
+     uint32_t pool_free;      // Pool buffers not holding a block
+     buffer_cache_policy_t policy; // Replacement policy in use
+     uint32_t hits_in;        // Hits on the 2Q first-use FIFO
+     uint32_t hits_hot;       // Hits on the hot (LRU) list
+     uint32_t misses_in;      // Misses admitted to the FIFO (first use)
+     uint32_t misses_hot;     // Misses admitted straight to the hot list (2Q: ghost key found)
+     uint32_t in_buffers;     // Buffers on the FIFO
+     uint32_t hot_buffers;    // Buffers on the hot list
+     uint32_t coalesced;      // Misses that joined a read already in flight
  } buffer_cache_stats_t;
  
+ // Per-stream read-ahead state (zero-initialize; owned by e.g. an open file)
+ typedef struct {
+     uint32_t start_lba;      // First LBA of the last read
+     uint32_t next_lba;       // LBA just past the last read
+     uint32_t window;         // Sectors kept prefetched ahead (0 = not sequential)
+     uint32_t ahead_lba;      // LBA just past what has been prefetched
+ } buffer_readahead_t;
+ 
  // Buffer structure
  typedef struct buffer buffer_t;
+
+ // Completion of buffer_get_async(): buf is the referenced buffer (release it
+ // as usual), or NULL if the read failed
+ typedef void (*buffer_get_cb_t)(buffer_t *buf, void *ctx);
+ struct buffer_waiter;
  
  struct buffer {
      disk_t *disk;            // Disk this buffer belongs to
-     uint32_t block_number;   // Block number on disk
+     uint32_t block_number;   // First sector (LBA) covered by the buffer
+     uint32_t nr_sectors;     // Sectors covered (1 unless the disk has block geometry)
+     uint32_t size;           // Bytes of data (nr_sectors * sector_size)
+     uint32_t capacity;       // Bytes of the pool slot behind data (0 for views)
      uint8_t *data;           // Pointer to the data
      uint32_t flags;          // Buffer flags
      uint32_t ref_count;      // Reference count
+     uint32_t dirty_since;    // Tick of the clean -> dirty transition (flusher aging)
      
      // Hash table chain
      buffer_t *hash_next;
      
-     // LRU list pointers
+     // Replacement list pointers
      buffer_t *lru_prev;
      buffer_t *lru_next;
+     uint32_t lru_list;       // Replacement list the buffer is on (internal)
+
+     // Owning block buffer of a BUFFER_FLAG_VIEW buffer (holds one reference)
+     buffer_t *parent;
+
+     // buffer_get_async() callers waiting for the read (while LOCKED)
+     struct buffer_waiter *io_waiters;
  };
  
  // Initialize the buffer cache system
@@ -51,9 +95,40 @@
  
  // Register a disk with the buffer cache
  int buffer_register_disk(disk_t *disk);
+
+ // Look up a registered disk by name (resolve once, then pass the handle)
+ disk_t *buffer_find_disk(const char *device_name);
  
- // Get a buffer from the cache or disk
- buffer_t *buffer_get(const char *device_name, uint32_t block_number);
+ // Cache sectors_per_block-sector blocks from base_lba on (clamped to one
+ // pool page); 1 goes back to per-sector buffers
+ int buffer_set_block_geometry(disk_t *disk, uint32_t base_lba, uint32_t sectors_per_block);
+
+ // Get the sector-sized buffer for one LBA from the cache or disk
+ buffer_t *buffer_get(disk_t *disk, uint32_t block_number);
+
+ // Start getting the sector-sized buffer for one LBA without waiting for the disk;
+ // cb runs once it is ready, possibly before this returns. Misses on a block
+ // already being read join that read. cb may run in kblockd and must not
+ // block on the cache (no buffer_get, only buffer_get_async).
+ int buffer_get_async(disk_t *disk, uint32_t block_number, buffer_get_cb_t cb, void *ctx);
+
+ // Get the whole cached block containing an LBA (covers block_number..+nr_sectors)
+ buffer_t *buffer_get_block(disk_t *disk, uint32_t lba);
+ 
+ // Get the blocks covering [lba, lba + count) with one lookup pass and batched reads;
+ // returns how many entries of bufs were filled
+ size_t buffer_get_range(disk_t *disk, uint32_t lba, uint32_t count, buffer_t **bufs, size_t max_bufs);
+ 
+ // Copy [lba, lba + count) into dst without filling the cache: cached blocks are
+// copied from it, each uncached run is read straight into dst as one request
+// of up to BUFFER_BULK_MAX_SECTORS. For bulk data the cache would not keep anyway.
+int buffer_read_bulk(disk_t *disk, uint32_t lba, uint32_t count, void *dst);
+ 
+// Release buffers returned by buffer_get_range
+ void buffer_release_range(buffer_t **bufs, size_t n);
+ 
+ // Note a stream read of [lba, lba + nr_sectors) and prefetch ahead when sequential
+ void buffer_readahead(disk_t *disk, buffer_readahead_t *ra, uint32_t lba, uint32_t nr_sectors);
  
  // Release a buffer
  void buffer_release(buffer_t *buf);
@@ -61,16 +136,21 @@
  // Mark a buffer as dirty
  void buffer_mark_dirty(buffer_t *buf);
  
- // Flush a single buffer to disk
+ // Flush a single buffer to disk; durable on return (FUA write)
  int buffer_flush(buffer_t *buf);
  
- // Sync all dirty buffers to disk
+ // Sync all dirty buffers to disk, then flush the caches of the drives written
  void buffer_cache_sync(void);
+
+ // Write the dirty blocks overlapping [lba, lba + count) of one disk and wait for
+ // writes of them already in flight. The drive's cache is not flushed: a caller
+ // syncing several ranges issues one disk_flush() at the end (fsync).
+ int buffer_writeback_range(disk_t *disk, uint32_t lba, uint32_t count);
  
  // Get buffer cache statistics
  void buffer_cache_get_stats(buffer_cache_stats_t *stats);
  
  // Invalidate all buffers for a specific device
- void buffer_invalidate_device(const char *device_name);
+ void buffer_invalidate_device(disk_t *disk);
  
  #endif /* BUFFER_CACHE_H */
\ No newline at end of file
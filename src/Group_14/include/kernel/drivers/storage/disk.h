@@ -2,6 +2,7 @@
 #define DISK_H
 
 #include <kernel/drivers/storage/block_device.h> // Includes types like uint32_t, size_t, bool
+#include <kernel/drivers/storage/block_queue.h>  // block_request_t
 #include <kernel/fs/vfs/fs_errno.h>     // For error codes like FS_SUCCESS
 
 // --- Configuration ---
@@ -31,6 +32,8 @@ typedef struct disk {
     bool           initialized;     // Has this disk structure been initialized?
     bool           has_mbr;         // Was a valid MBR signature found?
     partition_t    partitions[MAX_PARTITIONS_PER_DISK]; // Parsed MBR partitions
+    uint32_t       cache_block_base;    // Buffer cache: first LBA cached in multi-sector blocks
+    uint32_t       cache_block_sectors; // Buffer cache: sectors per block from there on (1 = per-sector)
     // Add other disk-wide info if needed (e.g., disk GUID for GPT)
 } disk_t;
 
@@ -57,6 +60,7 @@ int disk_read_raw_sectors(disk_t *disk, uint64_t lba, void *buffer, size_t count
 
 /**
  * @brief Writes sectors directly to the underlying block device (ignores partitions).
+ * The data may stay in the drive's write cache until disk_flush().
  * @param disk Pointer to the initialized disk_t structure.
  * @param lba The starting Logical Block Address (absolute on disk).
  * @param buffer Pointer to the buffer containing data to write.
@@ -65,6 +69,26 @@ int disk_read_raw_sectors(disk_t *disk, uint64_t lba, void *buffer, size_t count
  */
 int disk_write_raw_sectors(disk_t *disk, uint64_t lba, const void *buffer, size_t count);
 
+/**
+ * @brief As disk_write_raw_sectors(), but the data is on the medium on return (FUA).
+ */
+int disk_write_raw_sectors_fua(disk_t *disk, uint64_t lba, const void *buffer, size_t count);
+
+/**
+ * @brief Flushes the drive's write cache, making every completed write durable.
+ * @param disk Pointer to the initialized disk_t structure.
+ * @return FS_SUCCESS on success, FS_ERR_IO if the drive failed the flush.
+ */
+int disk_flush(disk_t *disk);
+
+
+/**
+ * @brief Queues a raw (absolute LBA) request on the disk's request queue.
+ * @param disk Pointer to the initialized disk_t structure.
+ * @param req Request to submit; req->done reports its completion.
+ * @return FS_SUCCESS if queued, negative error code if rejected.
+ */
+int disk_submit_raw_sectors(disk_t *disk, block_request_t *req);
 
 /**
  * @brief Reads sectors from a specific partition.
@@ -0,0 +1,38 @@
+#ifndef RAMDISK_H
+#define RAMDISK_H
+
+#include <kernel/core/types.h>
+#include <kernel/drivers/storage/block_device.h>
+
+/**
+ * RAM-backed block devices, opened as "ram0".."ram3" through
+ * block_device_init() once ramdisk_create() has made them.
+ *
+ * Transfers are memory copies with no request queue, write cache or
+ * interrupt, which makes a ramdisk the zero-latency baseline for the
+ * buffer cache and filesystems above it, and fast scratch storage for
+ * data that need not survive a reboot.
+ */
+
+#define RAMDISK_MAX_DISKS     4                 // ram0..ram3
+#define RAMDISK_SECTOR_SIZE   512
+#define RAMDISK_CHUNK_ORDER   16                // Backing memory comes in 64 KiB buddy blocks
+#define RAMDISK_DEFAULT_SIZE  (4u * 1024 * 1024) // ram0 size for the "ramdisk" boot flag
+
+/**
+ * @brief Allocates ram<index> with @p size bytes (rounded up to a whole
+ * chunk), zero-filled, then copies @p image_len bytes of @p image (may be
+ * NULL) to its start, e.g. a filesystem image.
+ * @return BLOCK_ERR_OK; BLOCK_ERR_PARAMS for a bad index, an existing
+ *         disk or an image larger than the disk; BLOCK_ERR_INTERNAL if
+ *         memory ran out.
+ */
+int ramdisk_create(int index, size_t size, const void *image, size_t image_len);
+
+// Bind dev to ram<index>
+int ramdisk_device_init(int index, block_device_t *dev);
+
+// Copy sectors in or out; used by block_device_read/write for RAM devices
+int ramdisk_transfer(block_device_t *dev, uint64_t lba, void *buffer, size_t count, bool write);
+
+#endif /* RAMDISK_H */
@@ -0,0 +1,73 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief High-resolution monotonic clock.
+ *
+ * The TSC is calibrated once at boot against the HPET main counter (PIT
+ * channel 2 without an HPET) and converted to nanoseconds with a precomputed
+ * multiplier and shift, so reading the clock costs one RDTSC and two 32x32
+ * multiplies. The result is 64-bit and does not
+ * wrap in practice, unlike the 32-bit millisecond scheduler_get_ticks().
+ *
+ * All CPUs share the BSP's calibration and boot TSC value, which assumes the
+ * TSCs run in lockstep (true for QEMU and invariant-TSC hardware). Without a
+ * TSC the clock reads a 64-bit HPET counter when there is one, and falls back
+ * to scheduler ticks at 1/TARGET_FREQUENCY resolution otherwise.
+ */
+
+// Clock IDs accepted by SYS_CLOCK_GETTIME (values match POSIX/Linux)
+#define CLOCK_REALTIME          0
+#define CLOCK_MONOTONIC         1
+#define CLOCK_MONOTONIC_RAW     4
+#define CLOCK_BOOTTIME          7
+
+#define NSEC_PER_USEC           1000u
+#define NSEC_PER_MSEC           1000000u
+#define NSEC_PER_SEC            1000000000u
+
+/**
+ * @brief Time value returned by SYS_CLOCK_GETTIME.
+ * 64-bit fields on i386 too, like Linux's __kernel_timespec; part of the ABI.
+ */
+typedef struct clock_timespec {
+    int64_t tv_sec;
+    int64_t tv_nsec;
+} clock_timespec_t;
+
+/**
+ * @brief Calibrates the TSC against the HPET or the PIT. Call once on the
+ * BSP after init_pit() and hpet_init(); it busy-waits for a few tens of
+ * milliseconds.
+ */
+void clock_init(void);
+
+/** @brief True when the monotonic clock is driven by the TSC. */
+bool clock_tsc_active(void);
+
+/** @brief Calibrated TSC frequency in kHz, 0 without a TSC. */
+uint32_t clock_tsc_khz(void);
+
+/**
+ * @brief The TSC conversion: ns = ((tsc - *base) * *mult) >> *shift.
+ * All zero without a TSC.
+ */
+void clock_get_tsc_params(uint32_t *mult, uint32_t *shift, uint64_t *base);
+
+/** @brief Nanoseconds since clock_init(). Callable from any context. */
+uint64_t clock_monotonic_ns(void);
+
+/**
+ * @brief Converts a TSC cycle delta (e.g. sched_task_stats_t run_cycles) to
+ * nanoseconds. Returns 0 without a TSC.
+ */
+uint64_t clock_cycles_to_ns(uint64_t cycles);
+
+/**
+ * @brief Splits a nanosecond count into seconds and nanoseconds.
+ */
+void clock_ns_to_timespec(uint64_t ns, clock_timespec_t *ts);
+
+#endif // CLOCK_H
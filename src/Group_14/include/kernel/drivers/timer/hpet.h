@@ -0,0 +1,69 @@
+#ifndef HPET_H
+#define HPET_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief High Precision Event Timer (memory-mapped, found through ACPI).
+ *
+ * The HPET has one free-running main counter, at least 10 MHz and usually
+ * 64 bits wide, plus a few comparators. The counter serves as the boot
+ * clock reference (TSC calibration) and, without a TSC, as the monotonic
+ * clocksource. Comparator 0 in legacy replacement mode raises IRQ0 in place
+ * of the PIT and backs the global tick until the local APIC timer takes
+ * over (see tick.h).
+ *
+ * Everything here is a no-op or returns 0 while hpet_available() is false.
+ */
+
+/**
+ * @brief Maps the HPET named by the ACPI table and starts its main counter.
+ * Call once on the BSP, before user page directories are cloned.
+ * @return true if the HPET is usable.
+ */
+bool hpet_init(void);
+
+/** @brief True once hpet_init() found a working HPET. */
+bool hpet_available(void);
+
+/** @brief True if the main counter is 64 bits wide (else it wraps at 32). */
+bool hpet_counter_is_64bit(void);
+
+/** @brief Counter period in femtoseconds (10^-15 s), 0 without an HPET. */
+uint32_t hpet_period_fs(void);
+
+/** @brief Counter frequency in Hz, 0 without an HPET. */
+uint32_t hpet_frequency_hz(void);
+
+/** @brief The main counter; torn-read safe on i386. */
+uint64_t hpet_read_counter(void);
+
+/** @brief Low 32 bits of the main counter (one MMIO read). */
+uint32_t hpet_read_counter_lo(void);
+
+/** @brief Counter ticks in @p us microseconds. */
+uint32_t hpet_us_to_counts(uint32_t us);
+
+/** @brief Busy-waits for @p us microseconds on the main counter. */
+void hpet_delay_us(uint32_t us);
+
+/**
+ * @brief Puts comparator 0 in legacy replacement mode (IRQ0, the PIT's
+ * line, which the PIT no longer drives), 32-bit one-shot and edge-triggered,
+ * with its interrupt enabled but nothing armed yet.
+ * @return false if the HPET can't replace the PIT.
+ */
+bool hpet_event_init(void);
+
+/**
+ * @brief Arms comparator 0 to fire when the low counter word reaches
+ * @p deadline.
+ * @return false if the deadline was already (nearly) reached, in which case
+ * the interrupt may or may not come and the caller should treat it as expired.
+ */
+bool hpet_event_arm(uint32_t deadline);
+
+/** @brief Disables comparator 0's interrupt. */
+void hpet_event_stop(void);
+
+#endif // HPET_H
@@ -57,7 +57,8 @@ void init_pit(void);
  * get_pit_ticks
  *
  * Returns how many PIT ticks have elapsed since init_pit() was called.
- * If frequency=1000 Hz, each tick = 1 ms.
+ * If frequency=1000 Hz, each tick = 1 ms. The 32-bit count wraps after
+ * about 49 days; use clock_monotonic_ns() (clock.h) for precise intervals.
  */
 uint32_t get_pit_ticks(void);
 
@@ -80,7 +81,53 @@ void sleep_busy(uint32_t milliseconds);
  */
 void sleep_interrupt(uint32_t milliseconds);
 
+/**
+ * pit_start_oneshot
+ *
+ * Tickless idle: stops the periodic tick and programs channel 0 in mode 0
+ * (interrupt on terminal count) to fire once after 'ticks' scheduler ticks.
+ * The count is clamped to pit_max_oneshot_ticks(). The periodic tick resumes
+ * automatically when the one-shot fires or pit_stop_oneshot() is called.
+ * Call with interrupts disabled.
+ */
+void pit_start_oneshot(uint32_t ticks);
+
+/**
+ * pit_stop_oneshot
+ *
+ * Cancels an armed one-shot (e.g. when another IRQ woke the CPU first),
+ * credits the elapsed ticks to the scheduler clock and restores periodic
+ * mode. No-op when no one-shot is armed.
+ */
+void pit_stop_oneshot(void);
+
+/**
+ * pit_max_oneshot_ticks
+ *
+ * Longest one-shot the 16-bit counter can express, in scheduler ticks
+ * (54 at 1000 Hz).
+ */
+uint32_t pit_max_oneshot_ticks(void);
+
+/**
+ * pit_delay_us
+ *
+ * Busy-waits for 'us' microseconds by polling PIT channel 2 (the speaker
+ * channel), so it works with interrupts disabled and before the scheduler
+ * tick is running. Used for SMP start-up delays and LAPIC timer calibration.
+ */
+void pit_delay_us(uint32_t us);
+
+/**
+ * pit_disable_tick
+ *
+ * Stops the periodic channel 0 tick and masks IRQ0 once the local APIC
+ * timer drives the scheduler. Channel 2 (pit_delay_us) keeps working.
+ */
+void pit_disable_tick(void);
+
 /* Functions removed as the scheduler now controls its own readiness:
+
  * - pit_set_scheduler_ready()
  * - pit_is_scheduler_ready()
  */
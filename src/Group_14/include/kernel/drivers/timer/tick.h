@@ -0,0 +1,65 @@
+#ifndef TICK_H
+#define TICK_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Source of the global scheduler tick on the bootstrap CPU.
+ *
+ * At boot the PIT (IRQ0) drives scheduler_tick(). With an HPET,
+ * tick_use_hpet() moves it to HPET comparator 0, which takes over IRQ0 and
+ * re-arms itself one tick ahead on a fixed counter grid, so tickless idle
+ * can sleep for minutes instead of the PIT's 54 ms. Once the local APIC
+ * timer is calibrated, tick_use_lapic() hands the tick to the BSP's APIC
+ * timer and silences the PIT and HPET, so every CPU is ticked by its own
+ * APIC and a tick costs one MMIO EOI instead of 8259 port writes. Tickless
+ * idle goes through this interface so it arms whichever device currently
+ * owns the tick.
+ */
+
+/**
+ * @brief Moves the global tick to the calling (bootstrap) CPU's APIC timer.
+ * @param counts_per_tick Result of lapic_timer_calibrate().
+ */
+void tick_use_lapic(uint32_t counts_per_tick);
+
+/**
+ * @brief Moves the global tick from the PIT to HPET comparator 0. Call
+ * after hpet_init() and clock_init(); a no-op without a usable HPET.
+ */
+void tick_use_hpet(void);
+
+/** @brief True while HPET comparator 0 owns the global tick. */
+bool tick_hpet_active(void);
+
+/**
+ * @brief HPET comparator 0 expiry (IRQ0): credits the grid points that
+ * passed, re-arms the next one and runs scheduler_tick(). Called after the EOI.
+ */
+void tick_hpet_interrupt(void);
+
+/** @brief True once the BSP's APIC timer owns the global tick. */
+bool tick_lapic_active(void);
+
+/**
+ * @brief BSP APIC timer expiry: finishes an armed one-shot, then runs
+ * scheduler_tick(). Called after the EOI has been sent.
+ */
+void tick_lapic_interrupt(void);
+
+/** @brief Longest one-shot the current tick device can express, in ticks. */
+uint32_t tick_max_oneshot_ticks(void);
+
+/**
+ * @brief Stops the periodic tick and fires once after @p ticks ticks; the
+ * skipped ticks are credited when it fires. Call with interrupts disabled.
+ */
+void tick_start_oneshot(uint32_t ticks);
+
+/**
+ * @brief Cancels an armed one-shot, credits the ticks that elapsed and
+ * resumes the periodic tick. No-op when none is armed.
+ */
+void tick_stop_oneshot(void);
+
+#endif // TICK_H
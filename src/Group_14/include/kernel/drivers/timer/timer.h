@@ -0,0 +1,49 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <kernel/core/types.h>
+#include <kernel/drivers/timer/timer_wheel.h>
+
+/**
+ * @brief One-shot timers for drivers.
+ *
+ * A driver embeds a timer_entry_t and arms it for an absolute scheduler
+ * tick; the callback runs in softirq context (softirq.h) on the CPU that
+ * owns the global tick: after the tick interrupt's EOI, with interrupts
+ * enabled, so a driver can arm a timeout and return instead of polling
+ * with interrupts off. Callbacks must not sleep; they may re-arm their own
+ * timer or arm others.
+ *
+ * These timers have their own wheel, apart from the scheduler's sleep
+ * wheel (scheduler_timer_add()), whose callbacks run in SOFTIRQ_SCHED.
+ * Tickless idle wakes up for whichever deadline comes first.
+ */
+
+/** @brief Sets up the wheel and the softirq; before the tick starts. */
+void timer_init(void);
+
+/**
+ * @brief Arms @p timer to call @p cb(@p timer, @p arg) at tick @p deadline
+ * (see scheduler_get_ticks()); a deadline already past fires on the next
+ * tick. A timer that is still pending is moved to the new deadline.
+ */
+void timer_schedule(timer_entry_t *timer, uint32_t deadline, timer_callback_t cb, void *arg);
+
+/** @brief timer_schedule() @p ms milliseconds from now (at least one tick). */
+void timer_schedule_ms(timer_entry_t *timer, uint32_t ms, timer_callback_t cb, void *arg);
+
+/**
+ * @brief Disarms @p timer. If its callback is running on another CPU, waits
+ * for it to return, so the entry may be freed afterwards. From the timer's
+ * own callback this only drops a re-arm.
+ * @return true if the timer was pending (its callback will not run).
+ */
+bool timer_cancel(timer_entry_t *timer);
+
+/** @brief Global tick hook: raises the softirq when timers are armed. */
+void timer_tick(void);
+
+/** @brief Ticks after @p now until the first timer fires, or @p max_ticks (tickless idle). */
+uint32_t timer_ticks_to_next(uint32_t now, uint32_t max_ticks);
+
+#endif // TIMER_H
@@ -0,0 +1,95 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <kernel/core/types.h>
+#include <kernel/sync/spinlock.h>
+
+/**
+ * Hierarchical timer wheel (classic 8/6/6/6/6-bit cascading layout).
+ *
+ * Level 0 holds 256 one-tick slots; levels 1-4 hold 64 slots each, every
+ * slot covering 256, 2^14, 2^20 and 2^26 ticks respectively, which spans the
+ * full 32-bit tick range. Inserting and cancelling are O(1); advancing by one
+ * tick empties a single level-0 slot, with an occasional cascade of one
+ * higher-level slot every 256 ticks (amortized O(1) per tick).
+ *
+ * Entries are intrusive: embed a timer_entry_t in the owning object.
+ * The wheel does no locking of its own; callers serialize access with
+ * wheel->lock (all *_locked functions expect it held).
+ */
+
+#define TIMER_WHEEL_ROOT_BITS 8
+#define TIMER_WHEEL_LVL_BITS  6
+#define TIMER_WHEEL_ROOT_SIZE (1u << TIMER_WHEEL_ROOT_BITS)
+#define TIMER_WHEEL_LVL_SIZE  (1u << TIMER_WHEEL_LVL_BITS)
+#define TIMER_WHEEL_ROOT_MASK (TIMER_WHEEL_ROOT_SIZE - 1)
+#define TIMER_WHEEL_LVL_MASK  (TIMER_WHEEL_LVL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS    4 // Cascading levels above the root level
+
+struct timer_entry;
+typedef void (*timer_callback_t)(struct timer_entry *entry, void *arg);
+
+typedef struct timer_entry {
+    struct timer_entry  *next;      // Next in slot list / expired list
+    struct timer_entry  *prev;      // Previous in slot list (NULL if first)
+    struct timer_entry **slot;      // Slot head this entry is linked into
+    uint32_t             expires;   // Absolute tick at which the entry fires
+    timer_callback_t     callback;  // Invoked by the owner after collection
+    void                *arg;       // Opaque callback argument
+    bool                 pending;   // True while linked into the wheel
+} timer_entry_t;
+
+typedef struct timer_wheel {
+    timer_entry_t *root[TIMER_WHEEL_ROOT_SIZE];
+    timer_entry_t *levels[TIMER_WHEEL_LEVELS][TIMER_WHEEL_LVL_SIZE];
+    uint32_t       base_tick;  // Next tick to be processed
+    uint32_t       count;      // Pending entries
+    spinlock_t     lock;
+} timer_wheel_t;
+
+/**
+ * @brief Initializes an empty wheel whose clock starts at @p now.
+ */
+void timer_wheel_init(timer_wheel_t *wheel, uint32_t now);
+
+/**
+ * @brief Prepares an entry for use (not pending, no callback).
+ */
+void timer_entry_init(timer_entry_t *entry, timer_callback_t callback, void *arg);
+
+/**
+ * @brief Links @p entry into the wheel to fire at entry->expires.
+ * @note Deadlines already in the past fire on the next processed tick.
+ */
+void timer_wheel_add_locked(timer_wheel_t *wheel, timer_entry_t *entry);
+
+/**
+ * @brief Unlinks a pending entry. No-op if the entry is not pending.
+ * @return true if the entry was pending and has been removed.
+ */
+bool timer_wheel_remove_locked(timer_wheel_t *wheel, timer_entry_t *entry);
+
+/**
+ * @brief Advances the wheel clock up to and including tick @p now.
+ *
+ * Every entry whose deadline has passed is unlinked, marked not pending and
+ * chained through ->next onto the returned list. Callbacks are NOT invoked;
+ * the caller runs them after dropping wheel->lock.
+ *
+ * @return Singly linked list of expired entries (NULL if none).
+ */
+timer_entry_t *timer_wheel_collect_expired_locked(timer_wheel_t *wheel, uint32_t now);
+
+/**
+ * @brief Returns how many ticks after @p now the earliest pending entry fires.
+ *
+ * Only the root slots up to the next cascade boundary are scanned, so the
+ * result may undershoot (never overshoot) the real deadline. Used to program
+ * one-shot timer interrupts while idle.
+ *
+ * @return Ticks until the next expiry (at least 1), or @p max_ticks if no
+ *         entry is known to fire sooner.
+ */
+uint32_t timer_wheel_ticks_to_next_locked(timer_wheel_t *wheel, uint32_t now, uint32_t max_ticks);
+
+#endif // TIMER_WHEEL_H
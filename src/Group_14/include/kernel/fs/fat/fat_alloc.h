@@ -10,9 +10,37 @@
 // Allocates a new cluster and optionally links it from a previous one.
 uint32_t fat_allocate_cluster(fat_fs_t *fs, uint32_t previous_cluster);
 
+// Allocates up to count contiguous clusters as a chain, placed right after
+// previous_cluster when that space is free, and links it from there.
+// *allocated_out: clusters allocated. Returns the first one, or 0.
+uint32_t fat_allocate_extent(fat_fs_t *fs, uint32_t previous_cluster, uint32_t count, uint32_t *allocated_out);
+
+// Keeps the first keep_clusters clusters of a chain (at least one) and frees the rest.
+int fat_trim_cluster_chain(fat_fs_t *fs, uint32_t first_cluster, uint32_t keep_clusters);
+
 // Frees an entire cluster chain starting from a given cluster.
 int fat_free_cluster_chain(fat_fs_t *fs, uint32_t start_cluster);
 
+// Builds the free-cluster bitmap from the loaded FAT and seeds the allocation
+// hint from FSInfo (fs_info_sector 0: none). On failure allocation falls back
+// to scanning the FAT.
+int fat_free_map_init(fat_fs_t *fs, uint32_t fs_info_sector);
+
+// Frees the bitmap built by fat_free_map_init().
+void fat_free_map_destroy(fat_fs_t *fs);
+
+// Records that @p cluster's FAT entry became free (or in use); called by
+// fat_set_cluster_entry().
+void fat_free_map_update(fat_fs_t *fs, uint32_t cluster, bool now_free);
+
+// Records that clusters first .. first+count-1 are now free, of which
+// @p was_used were not before; called by fat_clear_cluster_range().
+void fat_free_map_free_range(fat_fs_t *fs, uint32_t first, uint32_t count, uint32_t was_used);
+
+// Writes the free count and allocation hint back to the FSInfo sector (FAT32)
+// through the buffer cache, if they changed.
+int fat_write_fsinfo(fat_fs_t *fs);
+
 // Creates a new file entry (including LFN and 8.3) in a parent directory.
 // Assumes parent directory exists and path resolves correctly up to the last component.
 // Does NOT allocate data clusters for the file itself (creates a 0-byte file).
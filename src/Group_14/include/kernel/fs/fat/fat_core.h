@@ -16,7 +16,8 @@
  #include <kernel/core/types.h>      // For kernel-specific types like size_t, off_t if not in stdint/def
  #include <kernel/fs/vfs/vfs.h>        // For vfs_driver_t, vnode_t, file_t, struct dirent
  #include <kernel/drivers/storage/disk.h>       // For disk_t definition
- #include <kernel/sync/spinlock.h>   // For spinlock_t
+ #include <kernel/drivers/storage/buffer_cache.h> // For buffer_readahead_t
+ #include <kernel/sync/mutex.h>      // For kmutex_t
  
  /* --- FAT Type Constants --- */
  #define FAT_TYPE_FAT12 1
@@ -34,6 +35,13 @@
  #define FAT_ATTR_LONG_NAME_MASK (FAT_ATTR_READ_ONLY | FAT_ATTR_HIDDEN | FAT_ATTR_SYSTEM | FAT_ATTR_VOLUME_ID | FAT_ATTR_DIRECTORY | FAT_ATTR_ARCHIVE)
  
  
+ /* --- In-Memory FAT Limits --- */
+ // FATs larger than this are not loaded at mount: entries are read in place
+ // through the buffer cache, with the last few sectors used kept pinned.
+ #define FAT_TABLE_RESIDENT_MAX  (1024 * 1024)
+ #define FAT_WINDOW_SLOTS        16  // Pinned FAT sectors in paged mode (slot = sector % slots)
+ 
+ 
  /* --- FAT Boot Sector / BIOS Parameter Block (BPB) --- */
  // Structure representing the FAT BPB, common fields first, then FAT32 extensions.
  typedef struct __attribute__((packed)) {
@@ -107,7 +115,7 @@
  typedef struct {
      // Disk and Locking
      disk_t    *disk_ptr;            // Pointer to the underlying disk device structure
-     spinlock_t lock;                // Spinlock to protect concurrent access to this structure and FAT table
+     kmutex_t   lock;                // Protects this structure and the FAT table; held across disk I/O, so it sleeps
  
      // Filesystem Geometry & Type (parsed from Boot Sector)
      uint8_t    type;                // FAT type (FAT_TYPE_FAT12, FAT_TYPE_FAT16, FAT_TYPE_FAT32)
@@ -124,22 +132,65 @@
      uint32_t   total_data_clusters; // Total number of data clusters available
      uint32_t   root_cluster;        // Cluster number of the root directory (FAT32 only, usually 2)
      uint32_t   eoc_marker;          // End-of-chain marker value for this FAT type (e.g., 0xFF8, 0xFFF8, 0x0FFFFFF8)
-     // FSINFO related fields (optional, could be added later for performance)
-     // uint32_t fs_info_sector;     // Sector number of FSINFO
-     // uint32_t free_cluster_count; // Cached count of free clusters
-     // uint32_t next_free_cluster;  // Hint for next free cluster search
+ 
+     // Free-cluster accounting (fat_alloc.c): built at mount, FSInfo written back at unmount
+     uint32_t   fs_info_sector;      // FSInfo sector (FAT32 only), 0 if none
+     uint32_t  *free_bitmap;         // Bit N set = cluster N is free; NULL = scan the FAT instead
+     uint32_t   free_bitmap_clusters;// Clusters covered by free_bitmap (0 .. N-1)
+     uint32_t   free_cluster_count;  // Free data clusters (exact while free_bitmap is set; paged FAT: FSInfo's, 0xFFFFFFFF if unknown)
+     uint32_t   next_free_hint;      // Cluster the next allocation search starts at
+     bool       fs_info_dirty;       // Count or hint changed since FSInfo was read
  
      // In-Memory FAT Table Cache
      void      *fat_table;           // Pointer to the cached FAT table in memory
      size_t     fat_table_size_bytes;// Size of the allocated fat_table buffer
      bool       fat_dirty;           // Flag indicating if the in-memory FAT needs flushing
+     uint32_t  *fat_dirty_sectors;   // Bit N set = FAT sector N changed since the last flush; NULL = compare all
+     bool       fat_paged;           // No fat_table: entries live in FAT 1's cached sectors (fat_utils.c)
+     buffer_t  *fat_window[FAT_WINDOW_SLOTS]; // Paged mode: referenced FAT 1 sectors, kept resident
+ 
+     struct fat_dcache *dcache;      // Name lookup cache (fat_dcache.c); NULL = lookups uncached
+     struct fat_dirindex_cache *dirindex; // Whole-directory indexes (fat_dirindex.c); NULL = scan directories
+     struct fat_vcache *vcache;      // Contexts of open files (fat_vcache.c); NULL = one context per open
+     uint8_t   *lookup_sector;       // fat_find_in_dir()'s sector buffer (under lock); NULL = allocate per call
  
  } fat_fs_t;
  
+ /* --- Cluster-Chain Extent Map --- */
+ // A run of clusters that follow each other on disk, as seen from the file.
+ typedef struct {
+     uint32_t file_index;            // Cluster index within the file
+     uint32_t disk_cluster;          // Cluster number on disk
+     uint32_t length;                // Clusters in the run
+ } fat_extent_t;
+ 
+ #define FAT_EXTENT_MAP_MAX 4096     // Extents cached per open file; the chain is walked past that
+ 
+ // Extents of a file's chain from its first cluster on, in file order with no
+ // gaps, filled lazily as reads and writes seek further (fat_io.c).
+ typedef struct {
+     fat_extent_t *extents;          // kmalloc'd, grown as needed; NULL until first use
+     uint32_t      count;
+     uint32_t      capacity;
+     uint32_t      first_cluster;    // Chain the map was built for
+ } fat_extent_map_t;
+ 
+ /* --- Write-Behind Buffer --- */
+ #define FAT_WRITE_BUFFER_BYTES (32 * 1024) // Appends held per open file before their clusters are allocated
+ 
+ // Appends not yet written: data[0..len) belongs at file offset `offset`,
+ // just below fctx->file_size, which already counts it (fat_io.c).
+ typedef struct {
+     uint8_t  *data;                 // kmalloc'd on the first buffered write; NULL until then
+     uint32_t  offset;
+     uint32_t  len;
+ } fat_write_buffer_t;
+ 
  /* --- FAT File/Directory Context Structure --- */
  // Holds runtime state for an opened file or directory within a FAT filesystem.
- // This structure is typically stored in file->vnode->data.
- typedef struct {
+ // This structure is typically stored in file->vnode->data. Regular files have
+ // one context shared by all their open handles (fat_vcache.c).
+ typedef struct fat_file_context {
      fat_fs_t *fs;                   // Pointer back to the filesystem instance this belongs to
  
      // File/Directory Identification & Metadata
@@ -148,13 +199,31 @@
      uint32_t dir_entry_cluster;     // Cluster number where the directory entry for this file/dir resides
      uint32_t dir_entry_offset;      // Byte offset within dir_entry_cluster of the 8.3 directory entry
      bool     is_directory;          // True if this context represents a directory
+     uint8_t  short_name[11];        // The entry's 8.3 name (with the entry location, the open-file key)
+     uint8_t  attr;                  // Entry attributes at open, with its timestamps below (fstat answers from these)
+     uint16_t write_time, write_date;
+     uint16_t creation_time, creation_date;
+ 
+     // Sharing (fs->lock)
+     uint32_t refcount;              // Open handles using this context
+     bool     unlinked;              // The entry was deleted while open: the last close frees the data instead
+     bool     vcache_hashed;         // Findable by later opens
+     struct fat_file_context *vcache_next;
+     kmutex_t   io_lock;             // Serializes writes, flushes and fallocate across the handles; taken before fs->lock
  
      // State Flags
-     bool     dirty;                 // True if metadata (size, first cluster) changed and needs update on close
+     bool     dirty;                 // True if metadata (size, first cluster) changed and needs update on close (writes leave the entry to it)
+     bool     preallocated;          // fat_fallocate_internal() reserved clusters; unused ones are freed on close
+     bool     entry_unsynced;        // The entry's size or first cluster reached the cache since the last fsync
+     uint32_t sync_first;            // File clusters [sync_first, sync_end) were written since the last fsync (fs->lock)
+     uint32_t sync_end;
  
      // Sequential I/O State (optimization, could be removed if lseek recalculates)
      // uint32_t current_cluster;    // Last cluster accessed for sequential read/write
      // uint32_t offset_in_cluster;  // Offset within the current_cluster
+     buffer_readahead_t readahead;   // Read-ahead stream for fat_read (advisory, updated unlocked)
+     fat_extent_map_t extent_map;    // Cached chain layout for seeks (fs->lock)
+     fat_write_buffer_t write_buffer; // Delayed appends (file->lock); flushed by read, fallocate and close
  
      // Readdir State (only relevant if is_directory is true)
      uint32_t readdir_current_cluster; // Cluster being scanned for readdir
@@ -186,5 +255,12 @@
   * @return The 32-bit cluster number (0 if entry is NULL or cluster fields are 0).
   */
  uint32_t fat_get_entry_cluster(const fat_dir_entry_t *e);
+
+ /**
+  * @brief Allocates/frees a file context from the FAT driver's slab cache
+  * (created by fat_register_driver()). Contents are undefined on alloc.
+  */
+ fat_file_context_t *fat_alloc_file_context(void);
+ void fat_free_file_context(fat_file_context_t *ctx);
  
  #endif /* FAT_CORE_H */
\ No newline at end of file
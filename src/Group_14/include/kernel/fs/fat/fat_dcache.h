@@ -0,0 +1,63 @@
+/**
+ * @file fat_dcache.h
+ * @brief Directory entry name cache for FAT path lookups.
+ *
+ * Caches the result of fat_find_in_dir() per (directory cluster, name):
+ * the 8.3 entry and its offsets, or that the name does not exist. Every
+ * function assumes the caller holds fs->lock.
+ */
+
+#ifndef FAT_DCACHE_H
+#define FAT_DCACHE_H
+
+#include <kernel/fs/fat/fat_core.h>
+#include <libc/stdint.h>
+#include <libc/stdbool.h>
+
+#define FAT_DCACHE_BUCKETS   64   // Hash sets
+#define FAT_DCACHE_WAYS      4    // Entries per set, replaced round robin
+#define FAT_DCACHE_NAME_MAX  48   // Longer names are looked up uncached
+
+typedef struct {
+    bool            valid;
+    bool            negative;          // The name is known not to exist
+    uint32_t        dir_cluster;
+    uint32_t        hash;
+    char            name[FAT_DCACHE_NAME_MAX];
+    fat_dir_entry_t entry;             // Positive entries only
+    uint32_t        entry_offset;
+    uint32_t        first_lfn_offset;
+} fat_dcache_entry_t;
+
+typedef struct fat_dcache {
+    fat_dcache_entry_t sets[FAT_DCACHE_BUCKETS][FAT_DCACHE_WAYS];
+    uint8_t            next_way[FAT_DCACHE_BUCKETS];
+    uint32_t           hits, negative_hits, misses;
+} fat_dcache_t;
+
+// Allocates fs->dcache (lookups stay uncached if memory runs out).
+void fat_dcache_init(fat_fs_t *fs);
+
+// Frees fs->dcache.
+void fat_dcache_destroy(fat_fs_t *fs);
+
+// Looks name up in dir_cluster. Returns true on a hit, with *result set to
+// FS_SUCCESS (outputs filled in as by fat_find_in_dir) or FS_ERR_NOT_FOUND.
+bool fat_dcache_lookup(fat_fs_t *fs, uint32_t dir_cluster, const char *name, int *result,
+                       fat_dir_entry_t *entry_out, uint32_t *entry_offset_out, uint32_t *first_lfn_offset_out);
+
+// Records a lookup result; entry NULL records that name does not exist.
+void fat_dcache_insert(fat_fs_t *fs, uint32_t dir_cluster, const char *name,
+                       const fat_dir_entry_t *entry, uint32_t entry_offset, uint32_t first_lfn_offset);
+
+// The 8.3 entry at entry_offset in dir_cluster was rewritten in place (size,
+// first cluster, ...): refresh cached copies of it.
+void fat_dcache_update(fat_fs_t *fs, uint32_t dir_cluster, uint32_t entry_offset, const fat_dir_entry_t *entry);
+
+// Entries were added to or removed from dir_cluster: forget all its names.
+void fat_dcache_invalidate_dir(fat_fs_t *fs, uint32_t dir_cluster);
+
+// Forgets every cached name (a directory changed, but which one is unknown).
+void fat_dcache_invalidate_all(fat_fs_t *fs);
+
+#endif // FAT_DCACHE_H
@@ -60,6 +60,21 @@
   */
  int fat_readdir_internal(file_t *dir_file, struct dirent *d_entry_out, size_t entry_index);
  
+ /**
+  * @brief Packs directory entries into @p buf as struct dirent_rec records.
+  *
+  * Resumes at @p cookie, the byte position in the directory reached by the
+  * previous call (0 = start), and leaves it just past the last whole
+  * record written. Entries are those fat_readdir_internal() returns, in
+  * the same order, so a listing is one pass over the directory however it
+  * is split between calls.
+  *
+  * @return Bytes written, 0 at the end of the directory.
+  * @return FS_ERR_INVALID_PARAM if the next record alone is larger than @p len.
+  * @return Other negative FS_ERR_* codes on error.
+  */
+ int fat_getdents_internal(file_t *dir_file, void *buf, size_t len, off_t *cookie);
+ 
  /**
   * @brief Deletes a file from the FAT filesystem.
   *
@@ -76,6 +91,22 @@
   * @return Other negative FS_ERR_* codes on error.
   */
  int fat_unlink_internal(void *fs_context, const char *path);
+
+ /**
+  * @brief Attributes of @p path without opening it. Implements VFS stat.
+  *
+  * Answered by the path lookup, so from the name cache when the entries are
+  * cached; a file that is open reports its current size and first cluster.
+  *
+  * @return FS_SUCCESS (0) on success, or a negative FS_ERR_* code from the lookup.
+  */
+ int fat_stat_internal(void *fs_context, const char *path, struct vfs_stat *st);
+
+ /**
+  * @brief Fills @p st from the 8.3 entry @p entry (the size and first
+  * cluster may be an open file's newer ones).
+  */
+ void fat_entry_to_stat(const fat_fs_t *fs, const fat_dir_entry_t *entry, struct vfs_stat *st);
  
  
  /* --- Internal Helper Functions (Potentially used by other FAT modules) --- */
@@ -110,7 +141,8 @@
   * @brief Resolves a full absolute path to its final directory entry.
   *
   * Traverses the directory structure from the root based on the path components.
-  * Handles "." and ".." components (basic implementation).
+  * Components come from path_walk (path_walk.h), read in place: "." and ".."
+  * are resolved lexically and nothing is allocated.
   *
   * @param fs Pointer to the fat_fs_t instance. Assumed locked by caller.
   * @param path The absolute path string (must start with '/').
@@ -164,6 +196,18 @@
                             uint32_t dir_cluster,
                             uint32_t dir_offset,
                             const fat_dir_entry_t *new_entry);
+
+ /**
+  * @brief Finds the LBA of the sector holding a directory entry.
+  *
+  * @param fs Pointer to the fat_fs_t instance. Assumed locked by caller.
+  * @param dir_cluster Cluster number of the directory (0: the FAT12/16 root).
+  * @param dir_offset Byte offset of the entry within the directory's data.
+  * @param lba_out Receives the sector's LBA.
+  * @return FS_SUCCESS, FS_ERR_INVALID_PARAM if the offset lies past the
+  *         directory's end, or another negative FS_ERR_* code.
+  */
+ int fat_dir_entry_lba(fat_fs_t *fs, uint32_t dir_cluster, uint32_t dir_offset, uint32_t *lba_out);
  
  /**
   * @brief Marks one or more directory entries as deleted.
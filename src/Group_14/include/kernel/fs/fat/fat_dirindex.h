@@ -0,0 +1,113 @@
+/**
+ * @file fat_dirindex.h
+ * @brief In-memory index of whole FAT directories.
+ *
+ * The first lookup, create or short-name check in a directory reads it
+ * once and records every name (8.3 and long, hashed), every run of free
+ * slots and the directory's cluster chain. Later operations on that
+ * directory answer from the index instead of scanning its sectors, and the
+ * directory writers keep it current. Every function assumes the caller
+ * holds fs->lock.
+ */
+
+#ifndef FAT_DIRINDEX_H
+#define FAT_DIRINDEX_H
+
+#include <kernel/fs/fat/fat_core.h>
+#include <libc/stdint.h>
+#include <libc/stdbool.h>
+
+#define FAT_DIRINDEX_SLOTS      4                  // Directories indexed at once, replaced LRU
+#define FAT_DIRINDEX_MAX_BYTES  (65536u * 32u)     // FAT's directory size limit; larger chains stay unindexed
+
+typedef struct {
+    uint8_t   sfn[11];           // Raw 8.3 name
+    bool      used;
+    char     *lfn;               // Long name (kmalloc'd), NULL if none
+    uint32_t  sfn_hash, lfn_hash;
+    uint32_t  pos;               // Byte position of the 8.3 entry in the directory
+    uint32_t  lfn_pos;           // ... of its first LFN slot (pos if none)
+    int32_t   sfn_next, lfn_next;// Hash chains (name indices, -1 ends)
+} fat_dirindex_name_t;
+
+typedef struct {
+    uint32_t  pos;               // Byte position of the first free slot
+    uint32_t  slots;
+    bool      at_end;            // Holds the end-of-directory mark: usable whatever its length
+} fat_dirindex_run_t;
+
+typedef struct fat_dirindex {
+    bool                 valid;
+    uint32_t             dir_cluster;
+    uint32_t             cluster_bytes;   // Bytes per chain element (the whole root on FAT12/16)
+    uint32_t             last_used;
+    uint32_t            *clusters;        // The directory's chain, in order
+    uint32_t             cluster_count, cluster_cap;
+    fat_dirindex_name_t *names;
+    uint32_t             name_count, name_cap; // Records handed out (live or on name_free)
+    uint32_t             live_names;
+    int32_t              name_free;       // Unused name records, chained through sfn_next
+    int32_t             *sfn_buckets, *lfn_buckets;
+    uint32_t             bucket_count;    // Power of two
+    fat_dirindex_run_t  *runs;            // Sorted by pos; never span two clusters
+    uint32_t             run_count, run_cap;
+} fat_dirindex_t;
+
+typedef struct fat_dirindex_cache {
+    fat_dirindex_t dirs[FAT_DIRINDEX_SLOTS];
+    uint32_t       clock;
+    uint32_t       builds, hits;
+} fat_dirindex_cache_t;
+
+// Allocates fs->dirindex (directories are scanned as before without it).
+void fat_dirindex_init(fat_fs_t *fs);
+
+// Frees fs->dirindex and every index in it.
+void fat_dirindex_destroy(fat_fs_t *fs);
+
+// Looks component up in dir_cluster exactly as fat_find_in_dir() would.
+// Returns true when answered, with *result FS_SUCCESS (outputs filled in)
+// or FS_ERR_NOT_FOUND; false means scan the directory instead.
+bool fat_dirindex_lookup(fat_fs_t *fs, uint32_t dir_cluster, const char *component, int *result,
+                         fat_dir_entry_t *entry_out, uint32_t *entry_offset_out, uint32_t *first_lfn_offset_out);
+
+// Whether an entry with this raw 8.3 name exists in dir_cluster. Returns
+// false if the directory could not be indexed (*exists then unset).
+bool fat_dirindex_short_name_exists(fat_fs_t *fs, uint32_t dir_cluster, const uint8_t short_name_raw[11], bool *exists);
+
+// Calls fn on every 8.3 name in dir_cluster that fat_raw_short_name_exists()
+// would find, until it returns true. Returns false if the directory could
+// not be indexed.
+bool fat_dirindex_for_each_short_name(fat_fs_t *fs, uint32_t dir_cluster,
+                                      bool (*fn)(const uint8_t sfn[11], void *ctx), void *ctx);
+
+// The first run of free slots find_free_directory_slot() would pick.
+// Returns false if there is none short of extending the directory, or the
+// directory could not be indexed.
+bool fat_dirindex_find_slot(fat_fs_t *fs, uint32_t dir_cluster, size_t needed_slots,
+                            uint32_t *slot_cluster_out, uint32_t *slot_offset_out);
+
+// num_entries entries were written at offset in dir_cluster (as passed to
+// write_directory_entries(); whole LFN + 8.3 groups).
+void fat_dirindex_note_write(fat_fs_t *fs, uint32_t dir_cluster, uint32_t offset,
+                             const void *entries, size_t num_entries);
+
+// num_entries entries at offset in dir_cluster now start with marker.
+void fat_dirindex_note_delete(fat_fs_t *fs, uint32_t dir_cluster, uint32_t offset,
+                              size_t num_entries, uint8_t marker);
+
+// new_cluster, zeroed, was linked after last_cluster, the end of
+// dir_cluster's chain.
+void fat_dirindex_note_extend(fat_fs_t *fs, uint32_t dir_cluster, uint32_t last_cluster, uint32_t new_cluster);
+
+// The 8.3 entry at offset in dir_cluster was rewritten in place.
+void fat_dirindex_note_update(fat_fs_t *fs, uint32_t dir_cluster, uint32_t offset, const fat_dir_entry_t *entry);
+
+// Drops the index of the directory whose chain holds cluster.
+void fat_dirindex_invalidate(fat_fs_t *fs, uint32_t cluster);
+
+// First cluster of the indexed directory whose chain holds cluster.
+// Returns false if no index covers it.
+bool fat_dirindex_owner(fat_fs_t *fs, uint32_t cluster, uint32_t *dir_cluster_out);
+
+#endif // FAT_DIRINDEX_H
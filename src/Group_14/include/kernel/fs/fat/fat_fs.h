@@ -41,5 +41,14 @@
   * @return Negative FS_ERR_* code on failure (e.g., invalid context, flush error).
   */
  int fat_unmount_internal(void *fs_context);
+
+ /**
+  * @brief Copies the FAT sectors in [first, first + count) changed since they
+  * were last flushed into the cached sectors of every on-disk FAT copy, for
+  * the caller to write back (fsync). Assumes fs->lock is held.
+  *
+  * @return FS_SUCCESS, or FS_ERR_IO if a sector could not be copied (it stays dirty).
+  */
+ int fat_flush_fat_range(fat_fs_t *fs, uint32_t first, uint32_t count);
  
  #endif /* FAT_FS_H */
\ No newline at end of file
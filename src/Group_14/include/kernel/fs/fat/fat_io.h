@@ -68,6 +68,57 @@
   */
  off_t fat_lseek_internal(file_t *file, off_t offset, int whence);
  
+ /**
+  * @brief Reserves disk space for an opened file. Implements VFS fallocate.
+  *
+  * Extends the file's cluster chain to cover 'length' bytes in as few
+  * contiguous extents as possible. The file size is unchanged; clusters
+  * still beyond the size when the file is closed are freed again.
+  *
+  * @param file Pointer to the VFS file_t structure (opened for writing).
+  * @param length Bytes the writer expects the file to reach.
+  * @return FS_SUCCESS, or a negative FS_ERR_* code (FS_ERR_NO_SPACE if the
+  * volume filled up; clusters reserved so far are kept).
+  */
+ int fat_fallocate_internal(file_t *file, off_t length);
+ 
+ /**
+  * @brief Identifies an open file for the page cache. Implements VFS identify.
+  *
+  * The first cluster is unique within the filesystem, so it serves as the
+  * file number. Empty files and directories have no stable identity.
+  *
+  * @param file Pointer to the VFS file_t structure.
+  * @param id_out Filled with the filesystem, first cluster and current size.
+  * @return FS_SUCCESS (0) on success, or a negative FS_ERR_* code.
+  */
+ int fat_identify_internal(file_t *file, vfs_file_id_t *id_out);
+
+ /**
+  * @brief Attributes of an open file. Implements VFS fstat.
+  *
+  * Answered from the context: the size and first cluster are current, the
+  * attributes and timestamps are the entry's as of the first open.
+  */
+ int fat_fstat_internal(file_t *file, struct vfs_stat *st);
+
+ /**
+  * @brief Makes an open file durable. Implements VFS fsync.
+  *
+  * Writes back only the file's own blocks: the clusters written since its
+  * last fsync, the FAT sectors that map them, and its directory entry's
+  * sector, then flushes the drive's write cache once. fsync also writes the
+  * FSInfo sector and the entry sector even when the entry is unchanged;
+  * fdatasync skips both unless the size or first cluster changed. A
+  * directory writes back all of its clusters (entries created or removed).
+  *
+  * @param file Pointer to the VFS file_t structure.
+  * @param datasync True for fdatasync.
+  * @return FS_SUCCESS, or a negative FS_ERR_* code (FS_ERR_IO if a write or
+  * the flush failed; what was not written stays pending for the next fsync).
+  */
+ int fat_fsync_internal(file_t *file, bool datasync);
+ 
  /**
   * @brief Closes an opened file. Implements VFS close.
   *
@@ -120,7 +171,29 @@
 
 
 
-                          
+
+ /**
+  * @brief Writes an open file's buffered appends to its clusters, allocating
+  * them now. The directory entry is still updated only at close.
+  * @param fs Pointer to the fat_fs_t instance.
+  * @param fctx The file's context.
+  * @return FS_SUCCESS, or a negative FS_ERR_* code (the buffered data past
+  *         what reached the disk is dropped, and the file cut to it).
+  */
+ int fat_flush_write_buffer(fat_fs_t *fs, fat_file_context_t *fctx);
+
+ /**
+  * @brief Drops an open file's data, for O_TRUNC on an open file or the
+  * last close of an unlinked one: buffered appends are discarded, the
+  * cluster chain freed, and size and first cluster set to 0. The directory
+  * entry is left to the caller.
+  * @param fs Pointer to the fat_fs_t instance.
+  * @param fctx The file's context.
+  * @return FS_SUCCESS, or the error from freeing the chain.
+  * @note Assumes caller holds fs->lock.
+  */
+ int fat_discard_file_data(fat_fs_t *fs, fat_file_context_t *fctx);
+
 int update_directory_entry_first_cluster_now(fat_fs_t *fs, fat_file_context_t *fctx);
 
 int update_directory_entry_size_now(fat_fs_t *fs, fat_file_context_t *fctx);
@@ -52,6 +52,17 @@
   */
  int fat_set_cluster_entry(fat_fs_t *fs, uint32_t cluster, uint32_t value);
  
+ /**
+  * @brief Marks the FAT entries of clusters first .. first+count-1 free.
+  * Clears them a FAT sector at a time, marking each touched sector dirty
+  * once, and updates the free-cluster accounting for the whole range.
+  * @param fs Pointer to the FAT filesystem context.
+  * @param first First cluster of the range (must be >= 2).
+  * @param count Number of clusters in the range.
+  * @return FS_SUCCESS on success, or a negative FS_ERR_* code on failure (e.g., range out of bounds, FAT sector unreadable).
+  */
+ int fat_clear_cluster_range(fat_fs_t *fs, uint32_t first, uint32_t count);
+ 
  /**
   * @brief Retrieves the raw value of a specific cluster entry from the in-memory FAT table.
   * @param fs Pointer to the FAT filesystem context.
@@ -61,6 +72,12 @@
   */
  int fat_get_cluster_entry(fat_fs_t *fs, uint32_t cluster, uint32_t *entry_value);
  
+ /**
+  * @brief Releases the FAT sectors pinned by a paged FAT (no-op otherwise).
+  * @param fs Pointer to the FAT filesystem context.
+  */
+ void fat_window_release(fat_fs_t *fs);
+ 
  
  // --- Filename Formatting and Comparison ---
  
@@ -99,6 +116,12 @@
   * @param fat_date Output pointer for the 16-bit FAT date value.
   */
  void fat_get_current_timestamp(uint16_t *fat_time, uint16_t *fat_date);
+
+ /**
+  * @brief Converts a FAT date/time pair to seconds since 1970-01-01 (the
+  * timestamps carry no zone; they are read as UTC). A zero date gives 0.
+  */
+ uint32_t fat_timestamp_to_unix(uint16_t fat_time, uint16_t fat_date);
  
  
  // --- Short Name Generation & Collision Check ---
@@ -0,0 +1,49 @@
+/**
+ * @file fat_vcache.h
+ * @brief Open-file context cache: one fat_file_context_t per open FAT file.
+ *
+ * Every open of a regular file that is already open shares its context
+ * (size, first cluster, extent map, write-behind buffer, dirty flag) instead
+ * of building a copy from the directory entry, so a write through one handle
+ * is seen by the others at once. Contexts are keyed by the 8.3 entry's
+ * location and name and counted; the last close writes the entry back.
+ * Directories keep a context per open (their readdir position lives there).
+ * Every function assumes the caller holds fs->lock.
+ */
+
+#ifndef FAT_VCACHE_H
+#define FAT_VCACHE_H
+
+#include <kernel/fs/fat/fat_core.h>
+#include <libc/stdint.h>
+#include <libc/stdbool.h>
+
+#define FAT_VCACHE_BUCKETS  64   // Hash chains of open contexts
+
+typedef struct fat_vcache {
+    fat_file_context_t *buckets[FAT_VCACHE_BUCKETS];
+    uint32_t            hits, misses;
+} fat_vcache_t;
+
+// Allocates fs->vcache (every open then gets a context of its own without it).
+void fat_vcache_init(fat_fs_t *fs);
+
+// Frees fs->vcache; contexts still open are left to their handles.
+void fat_vcache_destroy(fat_fs_t *fs);
+
+// The open context of the 8.3 entry short_name at (dir_cluster, dir_offset),
+// or NULL. take_ref adds a reference for a new handle.
+fat_file_context_t *fat_vcache_lookup(fat_fs_t *fs, uint32_t dir_cluster, uint32_t dir_offset,
+                                      const uint8_t short_name[11], bool take_ref);
+
+// Makes ctx (filled in, with short_name set and one reference) findable.
+void fat_vcache_insert(fat_fs_t *fs, fat_file_context_t *ctx);
+
+// Drops a handle's reference. Returns true if it was the last one, in which
+// case ctx is no longer findable and the caller closes it for good.
+bool fat_vcache_release(fat_fs_t *fs, fat_file_context_t *ctx);
+
+// The entry behind ctx was deleted: later opens must not find ctx.
+void fat_vcache_forget(fat_fs_t *fs, fat_file_context_t *ctx);
+
+#endif // FAT_VCACHE_H
@@ -0,0 +1,33 @@
+/**
+ * @file initramfs.h
+ * @brief Read-only filesystem over the boot initramfs (a "newc" cpio archive).
+ *
+ * Limine loads the archive as a Multiboot2 module; kernel.c hands its
+ * kernel mapping over with initramfs_set_image() and fs_init() mounts it on
+ * INITRAMFS_MOUNT_POINT. Reads copy straight out of the module pages, which
+ * stay reserved for the life of the kernel.
+ */
+
+#ifndef INITRAMFS_H
+#define INITRAMFS_H
+
+#include <kernel/fs/vfs/vfs.h>
+#include <libc/stddef.h>
+#include <libc/stdbool.h>
+
+#define INITRAMFS_FS_NAME      "initramfs"
+#define INITRAMFS_MOUNT_POINT  "/initrd"
+
+/** @brief Records the archive at @p image (@p size bytes) for the next mount. */
+void initramfs_set_image(const void *image, size_t size);
+
+/** @brief True once the boot module has been handed over. */
+bool initramfs_present(void);
+
+/** @brief Registers the initramfs driver with the VFS. */
+int initramfs_register_driver(void);
+
+/** @brief Unregisters the initramfs driver (it must not be mounted). */
+void initramfs_unregister_driver(void);
+
+#endif /* INITRAMFS_H */
@@ -0,0 +1,26 @@
+/**
+ * @file procfs.h
+ * @brief Read-only kernel statistics filesystem.
+ *
+ * fs_init() mounts it on PROCFS_MOUNT_POINT. Each file is a text report
+ * generated from the allocator, buffer cache and scheduler counters when it
+ * is opened, so one open sees one consistent snapshot however it is read;
+ * open it again for fresh numbers. Lines are "key: value" or a header line
+ * followed by one whitespace-separated row per object, for easy scraping.
+ */
+
+#ifndef PROCFS_H
+#define PROCFS_H
+
+#include <kernel/fs/vfs/vfs.h>
+
+#define PROCFS_FS_NAME      "procfs"
+#define PROCFS_MOUNT_POINT  "/proc"
+
+/** @brief Registers the procfs driver with the VFS. */
+int procfs_register_driver(void);
+
+/** @brief Unregisters the procfs driver (it must not be mounted). */
+void procfs_unregister_driver(void);
+
+#endif /* PROCFS_H */
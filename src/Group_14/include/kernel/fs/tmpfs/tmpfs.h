@@ -0,0 +1,62 @@
+/**
+ * @file tmpfs.h
+ * @brief In-memory filesystem (tmpfs) driver.
+ *
+ * Files live in page frames taken from frame_alloc() and vanish on unmount;
+ * directories are hash tables of their entries. No block device is involved,
+ * so the mount "device" is only a label.
+ */
+
+#ifndef TMPFS_H
+#define TMPFS_H
+
+#include <kernel/fs/vfs/vfs.h>
+#include <libc/stdint.h>
+#include <libc/stdbool.h>
+
+#define TMPFS_FS_NAME         "tmpfs"
+#define TMPFS_MOUNT_POINT     "/tmp"
+#define TMPFS_DIR_MIN_BUCKETS 8     // Buckets of a new directory
+#define TMPFS_DIR_MAX_BUCKETS 4096  // Growth stops here (getdents cookies hold the bucket in 16 bits)
+#define TMPFS_NAME_MAX        255
+
+typedef struct tmpfs_fs tmpfs_fs_t;
+
+/* A file or directory; an open file's vnode->data points at it */
+typedef struct tmpfs_node {
+    tmpfs_fs_t         *fs;
+    struct tmpfs_node  *parent;       // NULL for the root and once unlinked
+    struct tmpfs_node  *hash_next;    // Chain in the parent's bucket
+    uint32_t            hash;         // Of the name
+    uint32_t            ino;
+    uint32_t            open_count;   // Open handles; an unlinked node is freed at the last close
+    bool                is_dir;
+    char                name[TMPFS_NAME_MAX + 1];
+
+    /* Regular files */
+    uint32_t            size;
+    uintptr_t          *pages;        // Physical frame per page of data, 0 for a hole
+    uint32_t            page_slots;
+
+    /* Directories */
+    struct tmpfs_node **buckets;
+    uint32_t            bucket_count; // Power of two
+    uint32_t            entry_count;
+} tmpfs_node_t;
+
+/* One mount; fs->lock guards the whole tree and every file's data */
+struct tmpfs_fs {
+    spinlock_t    lock;
+    tmpfs_node_t *root;
+    uint32_t      next_ino;
+    uint32_t      open_count;         // Open handles on the mount (unmount refuses while > 0)
+    uint32_t      page_count;         // Frames holding file data
+};
+
+/** @brief Registers the tmpfs driver with the VFS. */
+int tmpfs_register_driver(void);
+
+/** @brief Unregisters the tmpfs driver (every tmpfs mount must be gone). */
+void tmpfs_unregister_driver(void);
+
+#endif /* TMPFS_H */
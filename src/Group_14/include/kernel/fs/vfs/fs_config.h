@@ -59,7 +59,9 @@ extern "C" {
 #define FS_MOUNT_OPTION_SYNCHRONOUS 0x02
 #define FS_MOUNT_OPTION_NOEXEC      0x04
 
- #define ROOT_DEVICE_NAME "hdb"
+ #ifndef ROOT_DEVICE_NAME
+ #define ROOT_DEVICE_NAME "hdb"  // "sda" etc. for a disk on an AHCI controller
+ #endif
  #define ROOT_FS_TYPE     "FAT"
 
 
@@ -0,0 +1,80 @@
+/**
+ * @file io_ring.h
+ * @brief Batched I/O submission/completion ring shared with userspace.
+ *
+ * The process lays out one block of its own memory as an io_ring_hdr_t,
+ * then sq_entries submission entries, then cq_entries completion entries
+ * (see IO_RING_BYTES), and registers it with SYS_IO_SETUP. It queues
+ * requests by filling SQEs and advancing sq_tail; one SYS_IO_ENTER then
+ * runs the whole batch and posts a CQE per request, advancing cq_tail. A
+ * full completion queue ends the batch early rather than dropping CQEs. The
+ * kernel owns sq_head and cq_tail, userspace owns sq_tail and cq_head; all
+ * four are free-running counters, indexed with the masks.
+ */
+
+#ifndef IO_RING_H
+#define IO_RING_H
+
+#include <libc/stdint.h>
+
+#define IO_RING_MAX_ENTRIES 256     // Per queue; both sizes are powers of two
+
+/* io_sqe_t.opcode */
+#define IO_OP_NOP    0
+#define IO_OP_READ   1   // fd, addr = buffer, len = bytes, off = position or -1 for the fd's own
+#define IO_OP_WRITE  2   // Same as READ
+#define IO_OP_OPEN   3   // addr = NUL-terminated path, len = O_* flags; res = new fd
+#define IO_OP_CLOSE  4   // fd
+#define IO_OP_FSYNC  5   // fd; as fsync(fd)
+
+/* Submission queue entry (32 bytes) */
+typedef struct io_sqe {
+    uint8_t  opcode;
+    uint8_t  flags;         // Must be 0
+    uint16_t reserved;
+    int32_t  fd;
+    uint32_t addr;
+    uint32_t len;
+    int32_t  off;
+    uint32_t user_data;     // Handed back in the completion
+    uint32_t pad[2];
+} io_sqe_t;
+
+/* Completion queue entry */
+typedef struct io_cqe {
+    uint32_t user_data;
+    int32_t  res;           // What the matching syscall would return (negative errno on failure)
+} io_cqe_t;
+
+/* Start of the ring block */
+typedef struct io_ring_hdr {
+    uint32_t sq_head;       // Next SQE the kernel takes (kernel-owned)
+    uint32_t sq_tail;       // One past the last queued SQE (user-owned)
+    uint32_t cq_head;       // Next CQE userspace reads (user-owned)
+    uint32_t cq_tail;       // One past the last posted CQE (kernel-owned)
+    uint32_t sq_mask;       // sq_entries - 1, set by SYS_IO_SETUP
+    uint32_t cq_mask;       // cq_entries - 1
+    uint32_t reserved[2];
+} io_ring_hdr_t;
+
+#define IO_RING_SQES_OFFSET          ((uint32_t)sizeof(io_ring_hdr_t))
+#define IO_RING_CQES_OFFSET(sq)      (IO_RING_SQES_OFFSET + (uint32_t)(sq) * (uint32_t)sizeof(io_sqe_t))
+#define IO_RING_BYTES(sq, cq)        (IO_RING_CQES_OFFSET(sq) + (uint32_t)(cq) * (uint32_t)sizeof(io_cqe_t))
+
+/* SYS_IO_SETUP argument */
+typedef struct io_ring_setup_args {
+    uint32_t ring;          // User address of the block, 4-byte aligned
+    uint32_t sq_entries;
+    uint32_t cq_entries;    // At least sq_entries
+} io_ring_setup_args_t;
+
+/* The kernel's copy of a registered ring (pcb_t.io_ring) */
+typedef struct io_ring {
+    uintptr_t base;
+    uint32_t  sq_entries;
+    uint32_t  cq_entries;
+    uint32_t  sq_head;      // Authoritative; written back to the header after each batch
+    uint32_t  cq_tail;
+} io_ring_t;
+
+#endif /* IO_RING_H */
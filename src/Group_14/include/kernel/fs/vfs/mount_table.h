@@ -38,7 +38,8 @@
  
  /**
   * @brief Removes a mount entry identified by the mount point string (thread-safe).
-  * Frees the mount_t structure and its associated mount_point string upon successful removal.
+  * Frees the mount_t structure and its associated mount_point string upon successful removal,
+  * after an RCU grace period (may sleep; see rcu.h).
   *
   * @param mount_point The exact mount point string (e.g., "/") to remove.
   * @return FS_SUCCESS (0) on success, -FS_ERR_NOT_FOUND if the mount point doesn't exist,
@@ -57,6 +58,20 @@
   */
  mount_t *mount_table_find(const char *mount_point);
  
+ /**
+  * @brief Finds the mount with the longest mount point that prefixes @p path
+  * at a component boundary (thread-safe, lock-free RCU reader). Costs one step per
+  * component of @p path, however many filesystems are mounted.
+  *
+  * @param path Absolute path to resolve.
+  * @param prefix_len_out If not NULL, receives the length of the part of
+  * @p path the mount point covers (1 for "/"): the path relative to the
+  * mount starts there.
+  * @return The best matching mount entry, or NULL if none covers the path.
+  * The caller MUST NOT free the returned pointer.
+  */
+ mount_t *mount_table_find_best(const char *path, size_t *prefix_len_out);
+ 
  /**
   * @brief Prints all current mount table entries to the kernel console (thread-safe).
   * Useful for debugging.
@@ -65,8 +80,8 @@
  
  /**
   * @brief Gets the head of the mount list for external iteration (lock-free read).
-  * NOTE: Iterating the returned list without external locking is NOT thread-safe
-  * if the list can be modified concurrently by other threads/CPUs.
+  * NOTE: Entries stay valid only inside rcu_read_lock()/rcu_read_unlock(), or
+  * while the caller otherwise knows they cannot be unmounted concurrently.
   *
   * @return Pointer to the first mount_t entry, or NULL if the list is empty.
   */
@@ -0,0 +1,53 @@
+#ifndef PATH_WALK_H
+#define PATH_WALK_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Zero-copy iterator over the components of a path.
+ *
+ * Yields (pointer, length) pairs into the caller's string, which must stay
+ * unchanged while it is walked. Repeated slashes and "." are skipped; ".."
+ * is resolved lexically, with no directory lookups: a component a later
+ * ".." cancels is never yielded, and ".." above the start is dropped, as
+ * in fs_util_normalize_path(). So "/a/./b/../c" yields "a" then "c".
+ *
+ * Whatever remains after a yielded component (path_walk_rest()) never
+ * climbs above it, so a mount lookup can hand the rest to the mounted
+ * filesystem as is.
+ */
+
+typedef struct path_walk {
+    const char *next;   // Where the search for the next component starts
+} path_walk_t;
+
+typedef struct path_comp {
+    const char *name;   // Not NUL-terminated
+    size_t      len;
+} path_comp_t;
+
+static inline void path_walk_init(path_walk_t *w, const char *path) {
+    w->next = path;
+}
+
+/** @brief The part of the path after the last yielded component. */
+static inline const char *path_walk_rest(const path_walk_t *w) {
+    return w->next;
+}
+
+/** @brief Stores the next component in @p out. @return false at the end of the path. */
+bool path_walk_next(path_walk_t *w, path_comp_t *out);
+
+/** @brief True if path_walk_next() would return false. */
+bool path_walk_done(const path_walk_t *w);
+
+/** @brief True if @p c spells the NUL-terminated @p name exactly. */
+static inline bool path_comp_eq(const path_comp_t *c, const char *name) {
+    size_t i = 0;
+    for (; i < c->len; i++) {
+        if (name[i] != c->name[i]) return false; // Also stops at name's NUL
+    }
+    return name[i] == '\0';
+}
+
+#endif // PATH_WALK_H
@@ -0,0 +1,60 @@
+/**
+ * @file pipe.h
+ * @brief Anonymous pipes: two open files over a ring of kernel pages.
+ *
+ * The ring holds up to PIPE_RING_SLOTS pages, each with the unread part of
+ * one write (or of several small ones appended together). Data is copied
+ * straight between the caller's buffer and a ring page, with no bounce buffer
+ * in between; sendfile/copy_file_range from a cached file into a pipe goes
+ * further and links the page-cache frames into the ring without copying.
+ *
+ * Reads block until data arrives or the last writer closes (then return 0);
+ * writes block for room and fail with -EPIPE once no reader is left. Writes
+ * of up to PIPE_BUF bytes are never interleaved with other writers' data.
+ * Both ends report readiness to poll() and wake pollers on every change.
+ */
+
+#ifndef PIPE_H
+#define PIPE_H
+
+#include <kernel/core/types.h>
+#include <kernel/fs/vfs/vfs.h>
+#include <libc/stdbool.h>
+
+#define PIPE_RING_SLOTS 16      // Ring pages per pipe (64 KiB), a power of two
+#define PIPE_BUF        4096    // Writes up to this size are atomic
+
+/**
+ * @brief Creates a pipe and opens both ends.
+ * @return 0 and the read (O_RDONLY) and write (O_WRONLY) files, or -ENOMEM.
+ */
+int pipe_create(file_t **read_end, file_t **write_end);
+
+/** @brief True if @p file is an end of a pipe. */
+bool pipe_is_pipe(const file_t *file);
+
+/**
+ * @brief Reads up to @p len bytes from the read end @p file, blocking while
+ * the pipe is empty and a writer is left.
+ * @param user @p buf is a user address (already through access_ok()).
+ * @return Bytes read, 0 at end of file, or a negative errno.
+ */
+ssize_t pipe_read(file_t *file, void *buf, size_t len, bool user);
+
+/**
+ * @brief Writes @p len bytes to the write end @p file, blocking for room.
+ * @return Bytes written (short only if the readers went away or a copy
+ * faulted), or a negative errno (-EPIPE without readers) if none were.
+ */
+ssize_t pipe_write(file_t *file, const void *buf, size_t len, bool user);
+
+/**
+ * @brief Moves up to @p count bytes of @p in at @p *pos into the write end
+ * @p file by linking page-cache frames into the ring (no copy). Advances
+ * @p *pos by the bytes moved.
+ * @return Bytes moved, a negative errno, or -ENOSYS before moving anything
+ * if @p in can't be cached (the caller copies instead).
+ */
+ssize_t pipe_splice_file(file_t *file, file_t *in, off_t *pos, size_t count);
+
+#endif /* PIPE_H */
@@ -0,0 +1,52 @@
+/**
+ * @file poll.h
+ * @brief poll(): wait until any of several descriptors is ready.
+ *
+ * Readiness comes from the driver's optional vfs_driver_t.poll op; files
+ * whose driver has none (regular files on FAT, tmpfs, initramfs) are always
+ * readable and writable, as POSIX requires. The terminal descriptors 0-2
+ * are answered by the terminal itself.
+ *
+ * A task can only be linked on one wait queue at a time, so pollers share a
+ * single queue: any source whose readiness may have changed calls
+ * vfs_poll_notify(), and every poller rescans its descriptors. Sources are
+ * few and change rarely (a completed terminal line, a pipe write), so the
+ * extra rescans cost less than per-source registration would.
+ */
+
+#ifndef POLL_H
+#define POLL_H
+
+#include <libc/stdint.h>
+
+#define POLLIN      0x0001  // Data to read
+#define POLLPRI     0x0002
+#define POLLOUT     0x0004  // Writing will not block
+#define POLLERR     0x0008  // Always reported, never requested
+#define POLLHUP     0x0010  // Peer closed (pipes)
+#define POLLNVAL    0x0020  // fd is not open
+
+#define POLL_MAX_FDS 256    // Most entries one SYS_POLL accepts
+
+/** SYS_POLL entry; same layout as Linux's struct pollfd. */
+struct pollfd {
+    int32_t fd;             // Negative entries are skipped (revents 0)
+    int16_t events;
+    int16_t revents;
+};
+
+/** @brief Sets up the shared poll wait queue; called from vfs_init(). */
+void vfs_poll_init(void);
+
+/** @brief Wakes every task blocked in poll() so it rescans its descriptors. */
+void vfs_poll_notify(void);
+
+/**
+ * @brief Fills in revents for @p nfds kernel-side entries, blocking until at
+ * least one is ready or @p timeout_ms passes (negative: no limit, 0: just
+ * check).
+ * @return Number of entries with non-zero revents (0 on timeout).
+ */
+int vfs_poll_wait(struct pollfd *fds, uint32_t nfds, int32_t timeout_ms);
+
+#endif /* POLL_H */
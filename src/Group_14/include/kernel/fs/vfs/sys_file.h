@@ -38,8 +38,60 @@ extern "C" {
 typedef struct sys_file {
     file_t *vfs_file;
     int flags;
+    volatile uint32_t refcount; // fd table slots pointing here (fork shares them)
 } sys_file_t;
 
+/**
+ * @brief A process's descriptor table (pcb_t.fdt). Slot i holds fd i;
+ * open_map has a bit set for each slot in use. When full it is replaced by
+ * a copy twice its size (up to MAX_FD). The replaced table stays allocated
+ * on 'retired' until the process exits, so a lock-free reader still holding
+ * it reads valid memory.
+ */
+typedef struct fd_table {
+    uint32_t          max_fds;   // Slots: a multiple of 32
+    uint32_t          next_fd;   // Every fd below this is in use
+    sys_file_t      **fd;
+    uint32_t         *open_map;
+    struct fd_table  *retired;   // Smaller tables this one replaced
+} fd_table_t;
+#define FD_TABLE_MIN_FDS 32 // Size of a process's first table
+
+/* One buffer of a readv/writev call */
+struct iovec {
+    void   *iov_base;
+    size_t  iov_len;
+};
+#define UIO_MAXIOV 1024 // Most buffers one readv/writev takes
+
+/**
+ * @brief Buffer and position of SYS_PREAD/SYS_PWRITE, passed by pointer
+ * (like mmap_args_t) since the syscall ABI only carries three registers.
+ */
+typedef struct pio_args {
+    uint32_t buf;
+    uint32_t count;
+    int32_t  offset;    // File position; the descriptor's own is left alone
+} pio_args_t;
+
+/** @brief Arguments of SYS_SENDFILE (by pointer, like pio_args_t). */
+typedef struct sendfile_args {
+    int32_t  out_fd;
+    int32_t  in_fd;
+    uint32_t offset_ptr; // User int32_t *: read from there and updated, in_fd's position untouched; 0 = use it
+    uint32_t count;
+} sendfile_args_t;
+
+/** @brief Arguments of SYS_COPY_FILE_RANGE (by pointer, like pio_args_t). */
+typedef struct copy_range_args {
+    int32_t  fd_in;
+    uint32_t off_in_ptr;  // User int32_t *, or 0 for fd_in's position (as for sendfile)
+    int32_t  fd_out;
+    uint32_t off_out_ptr; // User int32_t *, or 0 for fd_out's position
+    uint32_t len;
+    uint32_t flags;       // Must be 0
+} copy_range_args_t;
+
 
 // === Function Prototypes === (Unchanged)
 int sys_open(const char *pathname, int flags, int mode);
@@ -47,6 +99,31 @@ ssize_t sys_read(int fd, void *kbuf, size_t count);
 ssize_t sys_write(int fd, const void *kbuf, size_t count);
 int sys_close(int fd);
 off_t sys_lseek(int fd, off_t offset, int whence);
+ssize_t sys_getdents(int fd, void *kbuf, size_t count);
+ssize_t sys_pread(int fd, void *kbuf, size_t count, off_t offset);
+ssize_t sys_pwrite(int fd, const void *kbuf, size_t count, off_t offset);
+
+// Pipes (pipe.h)
+int sys_pipe(int fds[2]); // fds[0] is the read end, fds[1] the write end
+bool sys_file_is_pipe(int fd); // Lock-free; a hint for picking the I/O path
+ssize_t sys_pipe_io(int fd, void *buf, size_t count, bool write, bool user); // May block
+
+// Shared memory (shm.h): @p name is a kernel copy; returns the new fd
+int sys_shm_open(const char *name, int flags, size_t size);
+
+// Descriptor tables (pcb_t.fdt)
+struct pcb;
+int fd_table_clone(struct pcb *child, struct pcb *parent); // fork: child gets every fd, referenced; 0 or -ENOMEM
+void fd_table_close_all(struct pcb *proc); // exit: drops every fd and frees the table
+int fd_table_dup2(struct pcb *proc, int oldfd, int newfd); // newfd (closed first if open), -EBADF or -ENOMEM
+int fd_table_close(struct pcb *proc, int fd); // 0 or -EBADF; for a process other than the caller
+
+// Reference counting for open files shared between fd tables
+void sys_file_get(sys_file_t *sf);
+int sys_file_put(sys_file_t *sf); // Closes the VFS file when the last reference goes
+sys_file_t *sys_file_get_fd(int fd); // Current process's fd, referenced; NULL if bad
+sys_file_t *sys_file_open_kernel(const char *path, int flags); // No fd; one reference
+void sys_file_cache_init(void); // Creates the sys_file_t cache; call before the first open
 
 
 #ifdef __cplusplus
@@ -7,7 +7,7 @@
 #include <libc/stdint.h>    // For uint32_t and friends
 #include <libc/stdbool.h>   // For bool
 #include <kernel/core/types.h>
-#include <kernel/sync/spinlock.h>       // <<< ADDED: Include for spinlock_t
+#include <kernel/sync/mutex.h>          // kmutex_t
 
 #ifdef __cplusplus
 extern "C" {
@@ -35,9 +35,16 @@ typedef struct file {
     vnode_t    *vnode;    // Underlying vnode pointer
     uint32_t    flags;    // Open flags
     off_t       offset;   // Current file offset (protected by lock)
-    spinlock_t  lock;     // <<< ADDED: Lock to protect file offset and concurrent driver access
+    kmutex_t    lock;     // Protects the offset and serializes driver calls; held across disk I/O, so it sleeps
 } file_t;
 
+/* Identity of the file behind an open handle, stable across opens */
+typedef struct vfs_file_id {
+    const void *fs;       // Mount context (the driver's mount() return value)
+    uint32_t    ino;      // Driver-unique file number within that mount
+    uint32_t    size;     // File size in bytes when identified
+} vfs_file_id_t;
+
 /* VFS driver interface */
 typedef struct vfs_driver {
     const char *fs_name;  // Filesystem name (e.g., "FAT32")
@@ -57,6 +64,14 @@ typedef struct vfs_driver {
     off_t (*lseek)(file_t *file, off_t offset, int whence);
     int (*readdir)(file_t *dir_file, struct dirent *d_entry_out, size_t entry_index); // Add this
     int (*unlink)(void *fs_context, const char *path); // Add this
+    int (*identify)(file_t *file, vfs_file_id_t *id_out); // Optional; enables the page cache
+    int (*fallocate)(file_t *file, off_t length); // Optional; reserves space for length bytes, size unchanged
+    int (*getdents)(file_t *dir_file, void *buf, size_t len, off_t *cookie); // Optional; struct dirent_rec batch from *cookie on
+    int (*mkdir)(void *fs_context, const char *path); // Optional; creates an empty directory
+    int (*stat)(void *fs_context, const char *path, struct vfs_stat *st); // Optional; attributes without opening
+    int (*fstat)(file_t *file, struct vfs_stat *st); // Optional; attributes of an open file
+    int (*poll)(file_t *file); // Optional; POLL* readiness mask (poll.h), none means always ready
+    int (*fsync)(file_t *file, bool datasync); // Optional; makes the file durable, metadata only as far as its data needs
     struct vfs_driver *next;
 } vfs_driver_t;;
 
@@ -73,12 +88,27 @@ int vfs_unregister_driver(vfs_driver_t *driver);
 vfs_driver_t *vfs_get_driver(const char *fs_name);
 int vfs_mount_root(const char *mount_point, const char *fs_name, const char *device);
 int vfs_unmount_root(void);
+int vfs_mount(const char *mount_point, const char *fs_name, const char *device); /* Any absolute mount point */
+int vfs_unmount(const char *mount_point);
 int vfs_shutdown(void);
 file_t *vfs_open(const char *path, int flags);
+file_t *vfs_open_vnode(vnode_t *node, int flags); /* Handle for a driver-built vnode (pipes); vfs_close frees both */
 int vfs_close(file_t *file);
 int vfs_read(file_t *file, void *buf, size_t len);
+int vfs_pread(file_t *file, void *buf, size_t len, off_t offset); /* Reads at offset; file->offset unchanged */
+int vfs_pwrite(file_t *file, const void *buf, size_t len, off_t offset); /* Writes at offset; file->offset unchanged */
+int vfs_pread_uncached(file_t *file, void *buf, size_t len, off_t offset); /* Driver read, no page cache; caller holds file->lock */
 int vfs_write(file_t *file, const void *buf, size_t len);
 off_t vfs_lseek(file_t *file, off_t offset, int whence);
+int vfs_identify(file_t *file, vfs_file_id_t *id_out); /* -FS_ERR_NOT_SUPPORTED if the driver can't */
+int vfs_fallocate(file_t *file, off_t length); /* Preallocation hint; -FS_ERR_NOT_SUPPORTED if the driver can't */
+int vfs_getdents(file_t *dir_file, void *buf, size_t len); /* Bytes of struct dirent_rec, 0 at the end; resumes at file->offset */
+int vfs_mkdir(const char *path); /* -FS_ERR_NOT_SUPPORTED if the driver can't */
+int vfs_unlink(const char *path); /* -FS_ERR_NOT_SUPPORTED if the driver can't */
+int vfs_stat(const char *path, struct vfs_stat *st); /* Falls back to open + fstat without a driver stat op */
+int vfs_fstat(file_t *file, struct vfs_stat *st); /* -FS_ERR_NOT_SUPPORTED if the driver can't */
+int vfs_fsync(file_t *file, bool datasync); /* fsync/fdatasync; -FS_ERR_INVALID_PARAM if the driver can't */
+int vfs_poll(file_t *file); /* POLL* mask; POLLIN|POLLOUT without a driver poll op */
 
 
 #ifdef __cplusplus
@@ -7,6 +7,7 @@
  
  #include <kernel/drivers/display/terminal.h> // For terminal_printf
  #include <kernel/drivers/display/serial.h> // For serial_printf
+ #include <kernel/lib/klog.h> // For klog_flush_sync
  
  // --- Standard Stringification Macros ---
  // These are necessary to correctly convert __LINE__ (an integer) into a string literal
@@ -20,6 +21,8 @@
  #ifndef KERNEL_PANIC_HALT // Guard against potential redefinition
  #define KERNEL_PANIC_HALT(msg) do { \
      asm volatile ("cli"); /* Disable interrupts FIRST */ \
+     serial_flush_sync(); /* Queued log first; synchronous output from here */ \
+     klog_flush_sync(); \
      /* Minimal user message */ \
      terminal_write("\n[KERNEL PANIC] System Halted.\n"); \
      /* Detailed debug info to serial */ \
@@ -0,0 +1,85 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Fixed-size bitmaps over arrays of 32-bit words.
+ *
+ * The caller owns the storage (BITMAP_WORDS(nbits) words). Bit 0 is the
+ * least significant bit of word 0. The search functions skip whole words
+ * and locate the bit with BSF, so a scan costs one compare per 32 bits.
+ * Bits at and above nbits in the last word must stay clear; the searches
+ * never report them.
+ *
+ * Nothing here is atomic: callers serialise access themselves.
+ */
+
+#define BITMAP_BITS_PER_WORD 32u
+#define BITMAP_WORDS(nbits)  (((nbits) + BITMAP_BITS_PER_WORD - 1) / BITMAP_BITS_PER_WORD)
+
+/** @brief Index of the lowest set bit of a non-zero word. */
+static inline uint32_t bitmap_bsf(uint32_t word) {
+    uint32_t bit;
+    asm("bsfl %1, %0" : "=r"(bit) : "rm"(word) : "cc");
+    return bit;
+}
+
+static inline void bitmap_set(uint32_t *map, uint32_t bit) {
+    map[bit / BITMAP_BITS_PER_WORD] |= 1u << (bit % BITMAP_BITS_PER_WORD);
+}
+
+static inline void bitmap_clear(uint32_t *map, uint32_t bit) {
+    map[bit / BITMAP_BITS_PER_WORD] &= ~(1u << (bit % BITMAP_BITS_PER_WORD));
+}
+
+static inline bool bitmap_test(const uint32_t *map, uint32_t bit) {
+    return (map[bit / BITMAP_BITS_PER_WORD] >> (bit % BITMAP_BITS_PER_WORD)) & 1u;
+}
+
+/** @brief Clears all @p nbits bits. */
+static inline void bitmap_zero(uint32_t *map, uint32_t nbits) {
+    for (uint32_t i = 0; i < BITMAP_WORDS(nbits); i++) map[i] = 0;
+}
+
+/**
+ * @brief First set bit at or after @p start.
+ * @return Its index, or @p nbits if there is none.
+ */
+static inline uint32_t bitmap_find_next_set(const uint32_t *map, uint32_t nbits, uint32_t start) {
+    if (start >= nbits) return nbits;
+    uint32_t i = start / BITMAP_BITS_PER_WORD;
+    uint32_t word = map[i] & (~0u << (start % BITMAP_BITS_PER_WORD));
+    while (!word) {
+        if (++i >= BITMAP_WORDS(nbits)) return nbits;
+        word = map[i];
+    }
+    uint32_t bit = i * BITMAP_BITS_PER_WORD + bitmap_bsf(word);
+    return bit < nbits ? bit : nbits;
+}
+
+/**
+ * @brief First clear bit at or after @p start.
+ * @return Its index, or @p nbits if every bit from @p start on is set.
+ */
+static inline uint32_t bitmap_find_next_zero(const uint32_t *map, uint32_t nbits, uint32_t start) {
+    if (start >= nbits) return nbits;
+    uint32_t i = start / BITMAP_BITS_PER_WORD;
+    uint32_t word = ~map[i] & (~0u << (start % BITMAP_BITS_PER_WORD));
+    while (!word) {
+        if (++i >= BITMAP_WORDS(nbits)) return nbits;
+        word = ~map[i];
+    }
+    uint32_t bit = i * BITMAP_BITS_PER_WORD + bitmap_bsf(word);
+    return bit < nbits ? bit : nbits;
+}
+
+static inline uint32_t bitmap_find_first_set(const uint32_t *map, uint32_t nbits) {
+    return bitmap_find_next_set(map, nbits, 0);
+}
+
+static inline uint32_t bitmap_find_first_zero(const uint32_t *map, uint32_t nbits) {
+    return bitmap_find_next_zero(map, nbits, 0);
+}
+
+#endif // BITMAP_H
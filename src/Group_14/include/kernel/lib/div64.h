@@ -0,0 +1,31 @@
+#ifndef DIV64_H
+#define DIV64_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief 64-bit by 32-bit unsigned division without libgcc's __udivdi3.
+ *
+ * Two chained DIVL instructions: the high half first, its remainder then
+ * becomes the upper word of the second dividend, so neither quotient can
+ * overflow.
+ *
+ * @param dividend  Value to divide.
+ * @param divisor   Non-zero divisor.
+ * @param remainder Optional; receives dividend % divisor.
+ * @return dividend / divisor.
+ */
+static inline uint64_t div_u64_rem(uint64_t dividend, uint32_t divisor, uint32_t *remainder) {
+    uint32_t hi = (uint32_t)(dividend >> 32);
+    uint32_t lo = (uint32_t)dividend;
+    uint32_t q_hi = 0, q_lo, rem = 0;
+    if (hi >= divisor) {
+        q_hi = hi / divisor;
+        hi %= divisor;
+    }
+    asm("divl %4" : "=a"(q_lo), "=d"(rem) : "a"(lo), "d"(hi), "rm"(divisor));
+    if (remainder) *remainder = rem;
+    return ((uint64_t)q_hi << 32) | q_lo;
+}
+
+#endif // DIV64_H
@@ -0,0 +1,28 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <kernel/core/types.h>
+#include <libc/stdarg.h>
+
+/**
+ * @brief The kernel's printf engine (terminal_printf, serial_printf, klog,
+ * snprintf).
+ *
+ * Format: %[0][#][width][l|ll]conv with conv one of s c d i u x X o p %.
+ * Every conversion takes exactly one 32-bit argument, %ld and %lld included
+ * (there is no 64-bit formatting). %p prints 0x and eight hex digits; '#'
+ * prefixes non-zero %x/%o with 0x/0. Anything else after '%' is printed
+ * as is. Output stops at @p size - 1 characters and is always terminated.
+ *
+ * @return Characters stored, not counting the terminator.
+ */
+int _vsnprintf(char *str, size_t size, const char *fmt, va_list args);
+
+/**
+ * @brief Finds the next conversion of @p fmt that takes an argument, parsed
+ * exactly as _vsnprintf does. Returns the position after it and stores its
+ * conversion character in @p conv, or returns NULL at the end.
+ */
+const char *format_next_arg(const char *fmt, char *conv);
+
+#endif // FORMAT_H
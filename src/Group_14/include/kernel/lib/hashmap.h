@@ -0,0 +1,54 @@
+#ifndef HASHMAP_H
+#define HASHMAP_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Open-addressed hash map from 32-bit keys to pointers.
+ *
+ * The caller provides the slot array (a power of two in size), so a map
+ * costs no allocation and can live in static storage or inside the object
+ * that owns it. Collisions probe linearly; removal shifts the following
+ * entries of the run back instead of leaving tombstones, so lookups never
+ * get slower after deletes and a miss ends at the first empty slot.
+ *
+ * A NULL value marks an empty slot and cannot be stored. Keep the load
+ * below about 3/4: hashmap_put() refuses to fill the last slot, but runs
+ * grow long well before that. Not thread-safe.
+ */
+
+typedef struct {
+    uint32_t key;
+    void    *value;                 // NULL: empty
+} hashmap_slot_t;
+
+typedef struct {
+    hashmap_slot_t *slots;
+    uint32_t        mask;           // Slot count - 1
+    uint32_t        shift;          // 32 - log2(slot count)
+    uint32_t        count;
+} hashmap_t;
+
+/** @brief Fibonacci hash: the top bits of key * 2^32/phi pick the home slot. */
+static inline uint32_t hashmap_slot_of(const hashmap_t *map, uint32_t key) {
+    return map->shift < 32 ? (key * 0x9E3779B9u) >> map->shift : 0;
+}
+
+/**
+ * @brief Sets up @p map over @p slots, 2^@p order entries, all empty.
+ */
+void hashmap_init(hashmap_t *map, hashmap_slot_t *slots, uint32_t order);
+
+/** @brief The value stored for @p key, or NULL. */
+void *hashmap_get(const hashmap_t *map, uint32_t key);
+
+/**
+ * @brief Stores @p value (non-NULL) for @p key, replacing any previous one.
+ * @return false if the map is full (one slot always stays empty).
+ */
+bool hashmap_put(hashmap_t *map, uint32_t key, void *value);
+
+/** @brief Removes @p key. @return Its value, or NULL if it was not there. */
+void *hashmap_remove(hashmap_t *map, uint32_t key);
+
+#endif // HASHMAP_H
@@ -0,0 +1,97 @@
+#ifndef KLOG_H
+#define KLOG_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Binary kernel log.
+ *
+ * klog_debug() and friends do not format anything: each call stores a
+ * record (timestamp, level, the format string's address as its id, the
+ * argument words and copies of any %s strings) in the calling CPU's ring,
+ * with interrupts off but no lock. A drain thread merges the rings by
+ * timestamp, formats the records with _vsnprintf and writes them to the
+ * serial port. A full ring drops records (and says how many later).
+ *
+ * Levels above KLOG_LEVEL are removed by the preprocessor, arguments
+ * included. The format follows _vsnprintf, where every conversion takes one
+ * 32-bit argument; %s strings are copied (up to KLOG_MAX_STR bytes), so the
+ * caller's buffer may go away right after the call.
+ *
+ * Each call site keeps a descriptor of its format (argument count and
+ * which arguments are strings), worked out on its first call, so a record
+ * is built without parsing the format again.
+ *
+ * Until klog_init()'s drain thread runs, and after klog_flush_sync(),
+ * records are formatted and written at once.
+ */
+
+#define KLOG_LVL_ERR   0
+#define KLOG_LVL_WARN  1
+#define KLOG_LVL_INFO  2
+#define KLOG_LVL_DEBUG 3
+
+#ifndef KLOG_LEVEL
+#ifdef KLOG_LEVEL_DEBUG
+#define KLOG_LEVEL KLOG_LVL_DEBUG
+#else
+#define KLOG_LEVEL KLOG_LVL_INFO
+#endif
+#endif
+
+#define KLOG_MAX_RECORD 256 // Bytes per record, header and strings included
+#define KLOG_MAX_STR    64  // Bytes kept of each %s argument
+#define KLOG_MAX_WORDS  24  // Arguments recorded per call; later ones are dropped
+
+/**
+ * @brief A call site's format descriptor: 0 until its first call, then
+ * KLOG_DESC_VALID | argument count << KLOG_DESC_NWORDS_SHIFT | a mask of the
+ * %s arguments. One word, so CPUs that race to fill it in agree.
+ */
+typedef struct klog_site {
+    volatile uint32_t desc;
+} klog_site_t;
+
+#define KLOG_DESC_VALID        0x80000000u
+#define KLOG_DESC_NWORDS_SHIFT 24
+#define KLOG_DESC_STR_MASK     0x00FFFFFFu
+
+/** @brief Logs one record; @p site may be NULL (the format is parsed every time). */
+void klog_write(klog_site_t *site, int level, const char *fmt, ...);
+
+#define KLOG_AT_SITE(level, fmt, ...) do { \
+    static klog_site_t klog_site_; \
+    klog_write(&klog_site_, level, fmt, ##__VA_ARGS__); \
+} while (0)
+
+#if KLOG_LEVEL >= KLOG_LVL_ERR
+#define klog_err(fmt, ...) KLOG_AT_SITE(KLOG_LVL_ERR, fmt, ##__VA_ARGS__)
+#else
+#define klog_err(fmt, ...) ((void)0)
+#endif
+#if KLOG_LEVEL >= KLOG_LVL_WARN
+#define klog_warn(fmt, ...) KLOG_AT_SITE(KLOG_LVL_WARN, fmt, ##__VA_ARGS__)
+#else
+#define klog_warn(fmt, ...) ((void)0)
+#endif
+#if KLOG_LEVEL >= KLOG_LVL_INFO
+#define klog_info(fmt, ...) KLOG_AT_SITE(KLOG_LVL_INFO, fmt, ##__VA_ARGS__)
+#else
+#define klog_info(fmt, ...) ((void)0)
+#endif
+#if KLOG_LEVEL >= KLOG_LVL_DEBUG
+#define klog_debug(fmt, ...) KLOG_AT_SITE(KLOG_LVL_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define klog_debug(fmt, ...) ((void)0)
+#endif
+
+/** @brief Starts the drain thread; records stay synchronous until it runs. */
+void klog_init(void);
+
+/**
+ * @brief Panics: formats every queued record now, without locks, and keeps
+ * klog synchronous from then on.
+ */
+void klog_flush_sync(void);
+
+#endif // KLOG_H
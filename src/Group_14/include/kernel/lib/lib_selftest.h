@@ -0,0 +1,20 @@
+#ifndef LIB_SELFTEST_H
+#define LIB_SELFTEST_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Boot-time unit tests for the kernel/lib containers (bitmap,
+ * hashmap, ring, minheap).
+ *
+ * Runs on the boot CPU in well under a millisecond and reports one serial
+ * line, plus one per failed check:
+ *
+ *   [LibTest] bitmap=ok hashmap=ok ring=ok minheap=ok
+ *   [LibTest] FAIL <suite>: <check> (lib_selftest.c:<line>)
+ */
+
+/** @return Number of failed checks; 0 if everything passed. */
+uint32_t lib_selftest_run(void);
+
+#endif // LIB_SELFTEST_H
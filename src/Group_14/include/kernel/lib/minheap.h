@@ -0,0 +1,56 @@
+#ifndef MINHEAP_H
+#define MINHEAP_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Intrusive binary min-heap.
+ *
+ * Embed a minheap_node in the object and order objects with a less()
+ * callback, as with rb_tree. The heap is an array of node pointers the
+ * caller provides; each node remembers its array index, so an arbitrary
+ * node can be removed or re-keyed in O(log n), which timer and deadline
+ * queues need. The minimum is at index 0. Not thread-safe.
+ */
+
+struct minheap_node {
+    uint32_t index;                 // Position in the heap array; MINHEAP_NOT_QUEUED if not in one
+};
+
+#define MINHEAP_NOT_QUEUED 0xFFFFFFFFu
+
+/** @brief Returns true if @p a must come out before @p b. */
+typedef bool (*minheap_less_func)(const struct minheap_node *a, const struct minheap_node *b);
+
+typedef struct {
+    struct minheap_node **nodes;
+    uint32_t              count;
+    uint32_t              capacity;
+    minheap_less_func     less;
+} minheap_t;
+
+void minheap_init(minheap_t *heap, struct minheap_node **nodes, uint32_t capacity,
+                  minheap_less_func less);
+
+/** @return false if the heap is full. */
+bool minheap_push(minheap_t *heap, struct minheap_node *node);
+
+/** @brief The smallest node, or NULL if the heap is empty. */
+static inline struct minheap_node *minheap_peek(const minheap_t *heap) {
+    return heap->count ? heap->nodes[0] : NULL;
+}
+
+/** @brief Removes and returns the smallest node, or NULL. */
+struct minheap_node *minheap_pop(minheap_t *heap);
+
+/** @brief Removes @p node, which must be in @p heap. */
+void minheap_remove(minheap_t *heap, struct minheap_node *node);
+
+/** @brief Restores the order after @p node's key changed in place. */
+void minheap_update(minheap_t *heap, struct minheap_node *node);
+
+static inline bool minheap_node_queued(const struct minheap_node *node) {
+    return node->index != MINHEAP_NOT_QUEUED;
+}
+
+#endif // MINHEAP_H
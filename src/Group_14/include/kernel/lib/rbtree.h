@@ -31,9 +31,13 @@
      return (struct rb_node *)(n->parent_color & ~1UL);
  }
  
+ /** Recomputes a node's cached subtree summary from the node and its children */
+ typedef void (*rb_augment_func)(struct rb_node *node);
+ 
  /** A red-black tree structure */
  struct rb_tree {
      struct rb_node *root;
+     rb_augment_func augment;   // NULL for a plain tree
  };
  
  // --- Core RB Tree API (Implementation in rbtree.c) ---
@@ -41,6 +45,19 @@
  /** Initialize a red-black tree */
  void rb_tree_init(struct rb_tree *T);
  
+ /** Initialize a tree whose nodes cache a per-subtree value.
+  *
+  * Insert, remove and rotations call \p augment on every node whose subtree
+  * changed, children before parents.
+  */
+ void rb_tree_init_augmented(struct rb_tree *T, rb_augment_func augment);
+ 
+ /** Re-run the augment callback from \p node up to the root
+  *
+  * Needed after changing a node's key data in place without re-inserting it.
+  */
+ void rb_tree_augment_propagate(struct rb_tree *T, struct rb_node *node);
+ 
  /** Returns true if the red-black tree is empty */
  static inline bool
  rb_tree_is_empty(const struct rb_tree *T) {
@@ -98,6 +115,21 @@
   */
  struct vma_struct* rbtree_find_overlap(struct rb_node *root, uintptr_t start, uintptr_t end);
  
+ /**
+  * @brief Augment callback for VMA trees: caches the lowest vm_start, highest
+  * vm_end and largest gap between neighbouring VMAs within each subtree.
+  */
+ void rbtree_vma_augment(struct rb_node *node);
+ 
+ /**
+  * @brief Finds the lowest address a >= lo with [a, a + length) free and
+  * a + length <= hi, in O(log n) using the cached subtree gaps.
+  *
+  * @param root The root of a VMA tree initialized with rbtree_vma_augment.
+  * @return The address, or 0 if no such gap exists.
+  */
+ uintptr_t rbtree_find_gap(struct rb_node *root, uintptr_t lo, uintptr_t hi, size_t length);
+ 
  // --- Traversal ---
  
  typedef void (*rbtree_visit_func)(struct vma_struct *vma_node, void *data);
@@ -0,0 +1,131 @@
+#ifndef RING_H
+#define RING_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Lock-free bounded rings of pointers.
+ *
+ * Both kinds take caller-provided slot storage of a power-of-two size and
+ * count positions with free-running 32-bit indices (wraparound is fine:
+ * only differences are compared).
+ *
+ *  - spsc_ring_t: one producer and one consumer, each on any CPU or in an
+ *    interrupt handler. x86 keeps stores in order and loads in order, so
+ *    publishing a slot is a compiler barrier and a store of the index.
+ *  - mpsc_ring_t: any number of producers (tasks, IRQs, other CPUs) and one
+ *    consumer. Producers claim a position with LOCK CMPXCHG; every slot
+ *    carries a sequence number that says whose turn it is (Vyukov's bounded
+ *    queue), so the consumer never sees a claimed slot before its value.
+ *
+ * A producer that is interrupted between claim and publish holds up the
+ * consumer, not other producers. Use the rings only from contexts that
+ * cannot deadlock on that (the interrupted producer always resumes).
+ */
+
+#define RING_BARRIER() asm volatile("" ::: "memory")
+
+/* --- Single producer, single consumer --- */
+
+typedef struct {
+    void            **slots;
+    uint32_t          mask;
+    volatile uint32_t head;         // Next position to fill (producer)
+    volatile uint32_t tail;         // Next position to drain (consumer)
+} spsc_ring_t;
+
+/** @brief Sets up @p ring over @p slots, 2^@p order entries. */
+static inline void spsc_ring_init(spsc_ring_t *ring, void **slots, uint32_t order) {
+    ring->slots = slots;
+    ring->mask = (1u << order) - 1;
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+/** @return false if the ring is full. */
+static inline bool spsc_ring_push(spsc_ring_t *ring, void *value) {
+    uint32_t head = ring->head;
+    if (head - ring->tail > ring->mask) return false;
+    ring->slots[head & ring->mask] = value;
+    RING_BARRIER();
+    ring->head = head + 1;
+    return true;
+}
+
+/** @return false if the ring is empty. */
+static inline bool spsc_ring_pop(spsc_ring_t *ring, void **value) {
+    uint32_t tail = ring->tail;
+    if (tail == ring->head) return false;
+    RING_BARRIER();
+    *value = ring->slots[tail & ring->mask];
+    RING_BARRIER();
+    ring->tail = tail + 1;
+    return true;
+}
+
+static inline uint32_t spsc_ring_count(const spsc_ring_t *ring) {
+    return ring->head - ring->tail;
+}
+
+/* --- Multiple producers, single consumer --- */
+
+typedef struct {
+    volatile uint32_t seq;          // == pos: free for pos; == pos + 1: holds pos
+    void             *value;
+} mpsc_ring_slot_t;
+
+typedef struct {
+    mpsc_ring_slot_t *slots;
+    uint32_t          mask;
+    volatile uint32_t head;         // Next position to claim (producers)
+    volatile uint32_t tail;         // Next position to drain (consumer)
+} mpsc_ring_t;
+
+static inline void mpsc_ring_init(mpsc_ring_t *ring, mpsc_ring_slot_t *slots, uint32_t order) {
+    ring->slots = slots;
+    ring->mask = (1u << order) - 1;
+    ring->head = 0;
+    ring->tail = 0;
+    for (uint32_t i = 0; i <= ring->mask; i++) slots[i].seq = i;
+}
+
+/** @return false if the ring is full. */
+static inline bool mpsc_ring_push(mpsc_ring_t *ring, void *value) {
+    uint32_t pos = ring->head;
+    for (;;) {
+        mpsc_ring_slot_t *slot = &ring->slots[pos & ring->mask];
+        int32_t diff = (int32_t)(slot->seq - pos);
+        if (diff < 0) return false; // The consumer has not drained it yet
+        if (diff > 0) {             // Another producer claimed pos
+            pos = ring->head;
+            continue;
+        }
+        uint32_t seen;
+        asm volatile("lock cmpxchgl %2, %1"
+                     : "=a"(seen), "+m"(ring->head)
+                     : "r"(pos + 1), "0"(pos)
+                     : "memory", "cc");
+        if (seen == pos) {
+            slot->value = value;
+            RING_BARRIER();
+            slot->seq = pos + 1;
+            return true;
+        }
+        pos = seen;
+    }
+}
+
+/** @return false if the ring is empty or the next value is not published yet. */
+static inline bool mpsc_ring_pop(mpsc_ring_t *ring, void **value) {
+    uint32_t pos = ring->tail;
+    mpsc_ring_slot_t *slot = &ring->slots[pos & ring->mask];
+    if (slot->seq != pos + 1) return false;
+    RING_BARRIER();
+    *value = slot->value;
+    RING_BARRIER();
+    slot->seq = pos + ring->mask + 1;
+    ring->tail = pos + 1;
+    return true;
+}
+
+#endif // RING_H
@@ -30,9 +30,9 @@
   * @param n The number of bytes to copy.
   * @return A pointer to the destination memory area dest.
   *
-  * @note If using GCC or Clang, this will typically use the highly optimized
-  * compiler builtin for best performance. The C implementation below
-  * serves as a fallback or reference.
+  * @note If using GCC or Clang, constant-size copies are expanded inline by
+  * the compiler builtin; the rest call the rep movsd implementation in
+  * kernel/lib/string_asm.asm.
   */
  #ifdef __GNUC__
  // Use compiler builtin for GCC/Clang for optimized memcpy
@@ -54,6 +54,18 @@
   */
  void *memmove(void *dest, const void *src, size_t n);
  
+ /**
+  * @brief Copies one 4 KiB page from @p src to @p dest (@p dest page-aligned).
+  * Uses SSE2 non-temporal stores when the CPU has them.
+  */
+ void copy_page(void *dest, const void *src);
+
+ /**
+  * @brief Zeroes one 4 KiB page at @p dest (page-aligned), with SSE2
+  * non-temporal stores when the CPU has them.
+  */
+ void clear_page(void *dest);
+ 
  /**
   * @brief Scans the initial n bytes of the memory area pointed to by s
   * for the first instance of c (interpreted as an unsigned char).
@@ -0,0 +1,35 @@
+#ifndef ALLOC_BENCH_H
+#define ALLOC_BENCH_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Boot-time allocator benchmarks.
+ *
+ * Runs fixed-size, mixed-size, producer/consumer and fragmentation
+ * workloads against kmalloc, slab_alloc, buddy_alloc and frame_alloc on the
+ * boot CPU and reports each as one serial line:
+ *
+ *   [AllocBench] alloc=<name> workload=<name> ops=<n> cycles_per_op=<n> frag_peak_pct=<n>
+ *
+ * cycles_per_op is RDTSC cycles per alloc or free. frag_peak_pct is the
+ * highest buddy fragmentation seen while the workload held its blocks:
+ * 100 * (1 - largest free block / free bytes), from buddy_get_stats().
+ *
+ * Enabled at every boot with -DUIAOS_ALLOC_BENCH=ON, or per boot with the
+ * "allocbench" kernel command line flag.
+ */
+
+/** Blocks a workload holds at once. */
+#define ALLOC_BENCH_SLOTS        512
+
+/** Rounds each workload runs; every round fills and drains the slots. */
+#define ALLOC_BENCH_ROUNDS       16
+
+/**
+ * @brief Runs every workload and prints the results. Call after the memory
+ * subsystems are up, before user processes start.
+ */
+void alloc_bench_run(void);
+
+#endif // ALLOC_BENCH_H
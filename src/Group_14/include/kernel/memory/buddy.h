@@ -9,6 +9,31 @@
 #define MAX_ORDER 23
 // Example: If PAGE_SIZE is 4KB (2^12), max order might relate to page allocations.
 #define MIN_BLOCK_SIZE (1 << MIN_ORDER)
+
+// --- Mobility Grouping ---
+/**
+ * @brief How long the owner of a block is expected to keep it.
+ *
+ * The heap is divided into pageblocks of 1 << PAGEBLOCK_ORDER bytes, each
+ * tagged with one type, and every type has its own free lists. Freed
+ * blocks return to the lists of their pageblock's type, so kernel objects
+ * that live for the whole uptime end up packed into a few pageblocks
+ * instead of pinning one page in each of many, and large blocks keep
+ * forming where user pages come and go. A type whose lists are empty
+ * steals from the others (largest block first) and takes over the whole
+ * pageblock when at least half of it is free.
+ *
+ * Nothing is migrated: "movable" pages are the ones released wholesale
+ * when a mapping or a process goes away.
+ */
+typedef enum {
+    MIGRATE_UNMOVABLE = 0, // Slabs, page tables, kmalloc, DMA and driver buffers
+    MIGRATE_RECLAIMABLE,   // Caches a shrinker can drop (page cache)
+    MIGRATE_MOVABLE,       // User pages: anonymous, COW copies, tmpfs and shm
+    MIGRATE_TYPES
+} buddy_migratetype_t;
+
+#define PAGEBLOCK_ORDER 22 // 4MB: one user large page
 // --- API ---
 
 
@@ -69,7 +94,15 @@ typedef struct {
     uint64_t alloc_count;     // Total successful allocations
     uint64_t free_count;      // Total frees
     uint64_t failed_alloc_count; // Total failed allocations
-    // Add more detailed stats if needed (e.g., per-order counts)
+    size_t largest_free_block; // Size of the largest free block (0 if none)
+    uint32_t free_blocks[MIGRATE_TYPES][MAX_ORDER + 1]; // Free blocks per list
+    uint32_t pageblocks[MIGRATE_TYPES];  // Pageblocks currently tagged with each type
+    uint32_t fallback_count;   // Allocations served from another type's lists
+    uint32_t claim_count;      // Pageblocks taken over by a stealing type
+    // Per order: -1000 if a block that large is free; otherwise 0..1000, where
+    // values near 0 mean a failure would be from lack of memory and values
+    // near 1000 mean it would be from fragmentation (free memory in pieces).
+    int16_t frag_index[MAX_ORDER + 1];
 } buddy_stats_t;
 
 /**
@@ -91,10 +124,29 @@ size_t buddy_total_space(void);
 void buddy_get_stats(buddy_stats_t *stats);
 
 
+/** @brief Raw block (no header) for a kernel-internal MIGRATE_UNMOVABLE user. */
 void* buddy_alloc_raw(int order);
 
+/** @brief buddy_alloc_raw() from the free lists of @p migratetype. */
+void *buddy_alloc_raw_mt(int order, int migratetype);
+
+/** @brief buddy_alloc_raw_mt() that fails instead of asking the shrinkers. */
+void *buddy_try_alloc_raw(int order, int migratetype);
+
 void buddy_free_raw(void* block_addr_virt, int order);
 
+/** @brief Batch forms of the raw calls: one buddy lock hold for the whole batch. */
+size_t buddy_alloc_raw_batch(int order, int migratetype, void **blocks, size_t count);
+
+void buddy_free_raw_batch(void *const *blocks, size_t count, int order);
+
+/**
+ * @brief Type of the pageblock holding @p block_virt, which is where the
+ * block goes when it is freed. Lock-free; a retag racing with the read
+ * only makes the answer stale.
+ */
+int buddy_block_migratetype(const void *block_virt);
+
 
 
 
@@ -3,6 +3,7 @@
 
 #include <kernel/core/types.h>      // For uintptr_t, size_t, bool
 #include <kernel/arch/multiboot2.h>
+#include <kernel/memory/buddy.h>   // MIGRATE_* mobility types
 
 // Define flags for frame status (optional, can use ref_count ranges)
 #define FRAME_AVAILABLE 0x00 // Implied if ref_count is 0 and allocatable
@@ -36,13 +37,52 @@ int frame_init(struct multiboot_tag_mmap *mmap_tag,
                uintptr_t buddy_heap_phys_start, uintptr_t buddy_heap_phys_end);
 
 /**
- * @brief Allocates a single physical page frame (e.g., 4KB).
+ * @brief Allocates a single physical page frame (e.g., 4KB) for a kernel
+ * (MIGRATE_UNMOVABLE) owner such as a page table or kernel stack.
  * Calls the underlying page allocator (buddy) and sets the reference count to 1.
  *
  * @return Physical address of the allocated frame, or 0 (NULL) if OOM.
  */
 uintptr_t frame_alloc(void);
 
+/**
+ * @brief frame_alloc() for an owner of @p migratetype: MIGRATE_MOVABLE for
+ * user pages, MIGRATE_RECLAIMABLE for cache pages a shrinker can drop.
+ */
+uintptr_t frame_alloc_mt(int migratetype);
+
+/**
+ * @brief Like frame_alloc(), but the frame is filled with zeroes.
+ *
+ * @return Physical address of the zeroed frame, or 0 if OOM.
+ */
+uintptr_t frame_alloc_zeroed(void);
+
+/**
+ * @brief frame_alloc_zeroed() for an owner of @p migratetype. Movable
+ * requests take a frame the idle task already cleared when one is
+ * available, so a user page fault does not pay for the memset.
+ */
+uintptr_t frame_alloc_zeroed_mt(int migratetype);
+
+/**
+ * @brief Allocates a 4MB-aligned run of PAGES_PER_TABLE zeroed frames for a
+ * user large page, without reclaim. Each frame has its own refcount of 1
+ * and is released with put_frame() like any other, so the page can be
+ * split into 4KB mappings later.
+ *
+ * @return Physical address of the first frame, or 0 if no 4MB block is free.
+ */
+uintptr_t frame_alloc_huge(void);
+
+/**
+ * @brief Zeroes up to @p max_frames free frames for movable frame_alloc_zeroed_mt() calls.
+ * Called from the idle loop with interrupts enabled.
+ *
+ * @return Number of frames added to the pool (0 when it is full).
+ */
+size_t frame_zero_pool_refill(size_t max_frames);
+
 /**
  * @brief Increments the reference count for a given physical frame.
  * Use this when a new PTE starts pointing to this frame (sharing).
@@ -82,6 +122,46 @@ static inline void frame_free(uintptr_t phys_addr) {
 }
 
 void frame_incref(uintptr_t phys_addr); // +++ ADD THIS LINE +++
+
+/**
+ * @brief Allocates @p count frames in one go (all or nothing), taking the
+ * buddy lock once per refill batch instead of once per frame.
+ *
+ * @param count      Number of frames.
+ * @param frames_out Array of at least @p count entries for the physical addresses.
+ * @return @p count on success, 0 on OOM (no frames allocated).
+ */
+size_t frame_alloc_bulk(size_t count, uintptr_t *frames_out);
+
+/**
+ * @brief Drops one reference from each frame in @p frames (see put_frame).
+ */
+void put_frames_bulk(const uintptr_t *frames, size_t count);
+
+/**
+ * @brief Adds one reference to each of @p count contiguous frames starting
+ * at @p phys_start (e.g. all frames behind a shared 4MB PDE).
+ */
+void frame_incref_range(uintptr_t phys_start, size_t count);
+
+/**
+ * @brief Drops one reference from each of @p count contiguous frames
+ * starting at @p phys_start (see put_frame).
+ */
+void put_frames_range(uintptr_t phys_start, size_t count);
+
+/**
+ * @brief Sets the live-PTE count of the user page table at @p pt_phys; done
+ * when the table is allocated (0) or filled by a copy.
+ */
+void frame_pt_live_set(uintptr_t pt_phys, uint32_t count);
+
+/**
+ * @brief Adjusts the live-PTE count of the user page table at @p pt_phys by
+ * @p delta (PTEs made present or cleared) and returns the new count, so the
+ * unmap path frees a table that emptied without scanning its entries.
+ */
+uint32_t frame_pt_live_add(uintptr_t pt_phys, int32_t delta);
 // <<< END ADDED >>>
 
 
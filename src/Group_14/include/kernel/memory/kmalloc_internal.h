@@ -44,4 +44,52 @@ typedef struct kmalloc_header {
 
 #define KALLOC_HEADER_SIZE sizeof(kmalloc_header_t)
 
+// --- Slab Size Classes ---
+// Class i holds a header plus a power-of-two user size, 32 << i bytes. Shared
+// by the per-CPU caches (percpu_alloc.c) and the global slab mode (kmalloc.c).
+#define KMALLOC_SMALLEST_CLASS_SHIFT 5  // 32-byte user size
+#define KMALLOC_LARGEST_CLASS_SHIFT  11 // 2048-byte user size
+#define KMALLOC_NUM_SIZE_CLASSES     (KMALLOC_LARGEST_CLASS_SHIFT - KMALLOC_SMALLEST_CLASS_SHIFT + 1)
+#define KMALLOC_CLASS_USER_SIZE(i)   ((size_t)1 << (KMALLOC_SMALLEST_CLASS_SHIFT + (i)))
+#define KMALLOC_CLASS_TOTAL_SIZE(i)  ALIGN_UP(KALLOC_HEADER_SIZE + KMALLOC_CLASS_USER_SIZE(i), KMALLOC_MIN_ALIGNMENT)
+
+// Max *user* size handled by slabs: the largest class.
+#define SLAB_ALLOC_MAX_USER_SIZE     KMALLOC_CLASS_USER_SIZE(KMALLOC_NUM_SIZE_CLASSES - 1)
+
+// Total sizes up to the fourth class are classified with one table load
+// indexed by (size + 7) >> 3; larger ones with BSR on the user size.
+#define KMALLOC_SIZE_TABLE_CLASSES   4
+#define KMALLOC_SIZE_TABLE_MAX       KMALLOC_CLASS_TOTAL_SIZE(KMALLOC_SIZE_TABLE_CLASSES - 1)
+#define KMALLOC_SIZE_TABLE_SLOT(sz)  (((sz) + 7) >> 3)
+
+// KMALLOC_STATIC_SIZE_TABLE=1 (CMake: UIAOS_KMALLOC_STATIC_SIZE_TABLE) emits
+// the table as initialized rodata; 0 fills it in kmalloc_init() instead.
+#ifndef KMALLOC_STATIC_SIZE_TABLE
+#define KMALLOC_STATIC_SIZE_TABLE 1
+#endif
+
+#if KMALLOC_STATIC_SIZE_TABLE
+extern const uint8_t g_kmalloc_size_index[KMALLOC_SIZE_TABLE_SLOT(KMALLOC_SIZE_TABLE_MAX) + 1];
+#else
+extern uint8_t g_kmalloc_size_index[KMALLOC_SIZE_TABLE_SLOT(KMALLOC_SIZE_TABLE_MAX) + 1];
+#endif
+
+/**
+ * @brief Size class for an allocation of @p total_size bytes (header
+ * included, aligned), or -1 if it exceeds the largest class.
+ */
+static inline int kmalloc_size_class(size_t total_size) {
+    if (total_size <= KMALLOC_SIZE_TABLE_MAX) {
+        return g_kmalloc_size_index[KMALLOC_SIZE_TABLE_SLOT(total_size)];
+    }
+    size_t user_size = total_size - KALLOC_HEADER_SIZE; // > 2^(SMALLEST + TABLE_CLASSES - 1)
+    if (user_size > SLAB_ALLOC_MAX_USER_SIZE) return -1;
+    uint32_t msb;
+    asm("bsrl %1, %0" : "=r"(msb) : "rm"((uint32_t)(user_size - 1)));
+    return (int)msb + 1 - KMALLOC_SMALLEST_CLASS_SHIFT; // ceil(log2(user_size)) - SMALLEST
+}
+
+/** @brief Fills g_kmalloc_size_index when it isn't generated at compile time. */
+void kmalloc_size_table_init(void);
+
 #endif // KMALLOC_INTERNAL_H
\ No newline at end of file
@@ -4,10 +4,12 @@
 
 #include <kernel/core/types.h>
 #include <kernel/memory/paging.h>     // Include for PAGE_SIZE, KERNEL_SPACE_VIRT_START etc.
-#include <kernel/sync/spinlock.h>
+#include <kernel/sync/rwlock.h>
 #include <kernel/fs/vfs/vfs.h>        // Include for file_t definition used in vma_struct
 #include <kernel/lib/rbtree.h>     // Include for rb_node and rb_tree definitions
 
+struct sys_file;
+
 // Define temporary mapping address if not already defined elsewhere (e.g., paging.h)
 #ifndef TEMP_MAP_ADDR_PF
 #define TEMP_MAP_ADDR_PF (KERNEL_SPACE_VIRT_START - 5u * PAGE_SIZE) // Example address
@@ -34,6 +36,45 @@
 
 // Add more flags as needed (e.g., VM_LOCKED, VM_IO, VM_GUARD)
 
+// Default fault-around window (pages, including the faulting one) for new VMAs
+#define FAULT_AROUND_PAGES 16
+
+/**
+ * Demand faults in private writable anonymous VMAs (heap, anonymous mmap)
+ * map the aligned 4MB around the fault with one PSE page when the VMA
+ * covers all of it and a 4MB buddy block is free. fork() shares such a
+ * page read-only; partial unmaps and COW copies split it back into a page
+ * table of the same frames. Cleared by the "nohuge" boot flag.
+ */
+extern bool g_mm_huge_pages;
+
+// --- mmap() ABI (values match Linux) ---
+#define PROT_NONE       0x0
+#define PROT_READ       0x1
+#define PROT_WRITE      0x2
+#define PROT_EXEC       0x4
+
+#define MAP_SHARED      0x01
+#define MAP_PRIVATE     0x02
+#define MAP_FIXED       0x10
+#define MAP_ANONYMOUS   0x20
+
+// mmap() without MAP_FIXED places mappings in [MMAP_BASE_VIRT, user stack).
+#define MMAP_BASE_VIRT  0x40000000u
+
+/**
+ * @brief Arguments of SYS_MMAP, passed by pointer (like Linux's old_mmap on
+ * i386) since the syscall ABI only carries three registers.
+ */
+typedef struct mmap_args {
+    uint32_t addr;      // Hint, or exact address with MAP_FIXED
+    uint32_t length;
+    uint32_t prot;      // PROT_*
+    uint32_t flags;     // MAP_*
+    int32_t  fd;        // Ignored with MAP_ANONYMOUS
+    uint32_t offset;    // File offset, page-aligned
+} mmap_args_t;
+
 
 /**
  * @brief Virtual Memory Area (VMA) structure.
@@ -44,12 +85,37 @@ typedef struct vma_struct {
     uintptr_t vm_end;           // End virtual address (exclusive, page-aligned)
     uint32_t vm_flags;          // Flags describing the VMA (VM_READ, VM_WRITE, etc.)
     uint32_t page_prot;         // Page protection flags (PTE flags: PAGE_PRESENT, PAGE_RW, PAGE_USER, PAGE_NX_BIT etc.)
-    file_t* vm_file;            // File backing the VMA (NULL for anonymous)
+    struct sys_file *vm_file;   // Open file backing the VMA (NULL for anonymous); the VMA holds a reference
     size_t vm_offset;           // Offset within the backing file (in bytes)
+    size_t vm_file_bytes;       // File bytes mapped from vm_start; the rest of the VMA reads as zero (ELF .bss)
+    uint32_t vm_fault_around;   // Pages one demand fault may map around the faulting page (<= 1 = just that page)
     struct rb_node rb_node;     // Node for Red-Black tree linkage
+    // Subtree summary kept by rbtree_vma_augment(): lets mmap find free ranges in O(log n)
+    uintptr_t rb_subtree_min_start;
+    uintptr_t rb_subtree_max_end;
+    uintptr_t rb_subtree_gap;   // Largest hole between neighbouring VMAs in the subtree
     struct mm_struct *vm_mm;    // Pointer back to the owning mm_struct
+    struct vma_struct *vm_next_dead; // Unlinked VMAs freed once mm->lock is dropped (their file close may sleep)
 } vma_struct_t;
 
+/**
+ * @brief Page fault counters of one address space (or, summed, of the
+ * system), kept by handle_vma_fault() and read through /proc/faults.
+ */
+typedef struct mm_fault_stats {
+    uint32_t minor;        // Handled without reading a file
+    uint32_t major;        // Read the page from its file or from swap
+    uint32_t cow_copies;   // Write faults that copied a shared frame
+    uint32_t cow_reuses;   // Write faults on an unshared frame, made writable in place (refcount 1)
+    uint32_t zero_fills;   // Fresh zeroed frames mapped, fault-around ones included
+    uint32_t fault_around; // Neighbouring pages mapped by fault-around
+    uint32_t huge_pages;   // Faults that mapped a whole 4MB page (anonymous memory)
+    uint64_t cycles;       // TSC cycles spent in handle_vma_fault(), failed faults included
+} mm_fault_stats_t;
+
+// Recent find_vma() hits remembered per mm (faults tend to hit the same few VMAs)
+#define MM_VMACACHE_SIZE 4
+
 /**
  * @brief Memory Management structure for a process.
  * Contains the VMA tree, page directory pointer, and other memory-related info.
@@ -57,8 +123,16 @@ typedef struct vma_struct {
 typedef struct mm_struct {
     struct rb_tree vma_tree;    // Red-Black tree organizing VMAs for efficient lookup
     uint32_t *pgd_phys;         // Physical address of the process's page directory
-    spinlock_t lock;            // Lock protecting this mm_struct (especially the VMA tree)
+    rwlock_t lock;              // VMA tree and page tables: shared for lookups and faults, exclusive for changes
     int map_count;              // Number of VMAs in the tree
+    // Last VMAs found by find_vma(); filled under the shared lock, cleared
+    // under the exclusive lock whenever the tree changes.
+    vma_struct_t *vmacache[MM_VMACACHE_SIZE];
+    uint32_t vmacache_next;     // Slot the next miss replaces
+
+    spinlock_t fault_stats_lock;      // fault_stats: threads of the process fault on several CPUs
+    mm_fault_stats_t fault_stats;
+    uintptr_t swap_hand;        // Where reclaim from this mm's own faults resumes its sweep (swap.h)
 
     // Optional fields for tracking specific memory regions
     uintptr_t start_code, end_code; // Virtual address range of executable code
@@ -70,6 +144,11 @@ typedef struct mm_struct {
 
 // --- Function Signatures ---
 
+/**
+ * @brief Creates the vma_struct_t slab cache. Call once after kmalloc_init().
+ */
+void mm_cache_init(void);
+
 /**
  * @brief Creates and initializes a new mm_struct.
  * @param pgd_phys Physical address of the process's page directory.
@@ -85,6 +164,16 @@ mm_struct_t *create_mm(uint32_t* pgd_phys);
  */
 void destroy_mm(mm_struct_t *mm);
 
+/**
+ * @brief Copies an mm_struct for fork(): same VMAs and brk/stack layout.
+ * @param src The parent's memory structure.
+ * @param pgd_phys The child's page directory, already cloned from src's
+ * with paging_clone_directory() (frames shared copy-on-write).
+ * @return The new mm_struct, or NULL on allocation failure. Page tables are
+ * not touched on failure.
+ */
+mm_struct_t *clone_mm(mm_struct_t *src, uint32_t *pgd_phys);
+
 /**
  * @brief Finds the VMA that contains a given virtual address.
  * @param mm Pointer to the process's mm_struct.
@@ -101,13 +190,35 @@ vma_struct_t *find_vma(mm_struct_t *mm, uintptr_t addr);
  * @param end End virtual address (page-aligned, exclusive).
  * @param vm_flags Flags for the new VMA.
  * @param page_prot Page protection flags for the underlying pages.
- * @param file File backing the VMA (NULL for anonymous).
- * @param offset Offset within the file (if file-backed).
+ * @param file File backing the VMA (NULL for anonymous). The VMA takes its own reference.
+ * @param offset Offset within the file (if file-backed). The whole VMA is
+ * file data; a caller that needs a zero tail trims vm_file_bytes afterwards.
  * @return Pointer to the newly created or merged vma_struct on success, NULL on failure (e.g., overlap, allocation failure).
  */
 vma_struct_t* insert_vma(mm_struct_t *mm, uintptr_t start, uintptr_t end,
                          uint32_t vm_flags, uint32_t page_prot,
-                         file_t* file, size_t offset);
+                         struct sys_file *file, size_t offset);
+
+/**
+ * @brief Creates a mapping for mmap(). Pages are filled on first touch:
+ * zeroed for anonymous mappings, read from @p file otherwise.
+ * Without MAP_FIXED the first free range at or above MMAP_BASE_VIRT is used;
+ * MAP_FIXED replaces whatever was mapped in [addr, addr + length).
+ * Shared writable mappings are only taken for shared-memory objects (see
+ * shm.h) opened O_RDWR, whose frames every mapping and fork() child shares;
+ * file pages are never written back, so other files refuse them.
+ *
+ * @param mm The process's memory structure.
+ * @param addr Page-aligned address; required with MAP_FIXED, otherwise ignored.
+ * @param length Length in bytes (rounded up to whole pages).
+ * @param prot PROT_* bits.
+ * @param flags MAP_SHARED or MAP_PRIVATE, optionally MAP_FIXED / MAP_ANONYMOUS.
+ * @param file Backing file (NULL with MAP_ANONYMOUS).
+ * @param offset Page-aligned offset into @p file.
+ * @return Start address of the mapping, or a negative errno cast to uintptr_t.
+ */
+uintptr_t do_mmap(mm_struct_t *mm, uintptr_t addr, size_t length, uint32_t prot,
+                  uint32_t flags, struct sys_file *file, size_t offset);
 
 /**
  * @brief Removes/modifies VMAs overlapping a given range.
@@ -122,18 +233,90 @@ vma_struct_t* insert_vma(mm_struct_t *mm, uintptr_t start, uintptr_t end,
  */
 int remove_vma_range(mm_struct_t *mm, uintptr_t start, size_t length); // <-- Added for munmap
 
+/**
+ * @brief Moves the program break to @p brk, growing or shrinking the VM_HEAP
+ * VMA. Growing only extends the VMA; pages are zero-filled on first touch.
+ * Shrinking unmaps the pages past the new break.
+ * @param mm The process's memory structure.
+ * @param brk Requested break; must lie in [start_brk, USER_STACK_BOTTOM_VIRT].
+ * @return The break after the call: @p brk on success, the old break if the
+ * request was out of range or would overlap another mapping (Linux semantics,
+ * so brk(0) queries the current break).
+ */
+uintptr_t do_brk(mm_struct_t *mm, uintptr_t brk);
+
 /**
  * @brief Handles a page fault within the context of a VMA.
  * Implements demand paging (allocating/mapping frames for anonymous or file-backed pages)
  * and Copy-on-Write (COW) for private writable mappings.
  *
+ * Looks the VMA up and updates the PTE under @p mm's lock held shared, so
+ * an munmap, the swap clock or a fork copying the table can't change
+ * either in between. A fault that
+ * must sleep (disk reads, reclaim) drops the lock for it, then looks the
+ * VMA up and reads the PTE again.
+ *
  * @param mm The process's memory structure.
- * @param vma The VMA covering the faulting address.
  * @param address The exact virtual address that caused the fault.
  * @param error_code The page fault error code provided by the CPU.
- * @return 0 if the fault was handled successfully, negative error code otherwise.
+ * @return 0 if the fault was handled, else a negated FS_ERR_* code:
+ * FS_ERR_NOT_FOUND when no VMA covers @p address, FS_ERR_PERMISSION_DENIED
+ * when the VMA does not allow the access.
+ */
+int handle_vma_fault(mm_struct_t *mm, uintptr_t address, uint32_t error_code);
+
+/**
+ * @brief Pins the user page holding @p addr so the kernel can read or fill
+ * it in place (through kmap_atomic) instead of via a bounce buffer.
+ * Faults the page in the way a user access would, breaking COW first when
+ * @p write, then takes a frame reference, so the frame outlives a racing
+ * munmap or exit. Release with put_frame().
+ *
+ * @return The page's physical frame, or 0 if @p addr isn't mapped with that access.
+ */
+uintptr_t mm_pin_user_page(mm_struct_t *mm, uintptr_t addr, bool write);
+
+/**
+ * @brief As mm_pin_user_page(), also storing the covering VMA's vm_flags in
+ * *@p vm_flags (when non-NULL) on success.
+ */
+uintptr_t mm_pin_user_page_flags(mm_struct_t *mm, uintptr_t addr, bool write, uint32_t *vm_flags);
+
+/**
+ * @brief The frame currently mapped at @p addr, or 0 if none. Neither faults
+ * nor pins, so it is safe with interrupts off; the answer may be stale as
+ * soon as it returns unless the caller holds a reference on the frame.
+ */
+uintptr_t mm_user_page_frame(mm_struct_t *mm, uintptr_t addr);
+
+/**
+ * @brief Copies the fault counters of @p mm, or the system-wide totals
+ * (every fault since boot, whatever its process) when @p mm is NULL.
+ */
+void mm_get_fault_stats(mm_struct_t *mm, mm_fault_stats_t *out);
+
+struct swap_victim;
+
+/**
+ * @brief Advances the swap clock over @p mm from *@p hand (see swap.h).
+ * Visits present pages of private writable VMAs until @p budget runs out
+ * or @p max_out pages were unmapped: an accessed page loses its accessed
+ * bit, an unreferenced one whose frame only this PTE holds gets a swap
+ * entry instead and is described in @p out. Shoots down the TLB entries it
+ * changed. Leaves *@p hand where the next sweep starts, 0 after the last
+ * VMA. Takes mm->lock exclusively; the caller must be allowed to keep @p mm
+ * alive (the reaper, or a thread of the process).
+ * @return Pages in @p out; their frames now belong to the caller.
+ */
+uint32_t mm_swap_scan(mm_struct_t *mm, uintptr_t *hand, uint32_t *budget,
+                      struct swap_victim *out, uint32_t max_out, uint32_t *second_chance);
+
+/**
+ * @brief Puts a victim's frame back after its writeback failed, if its PTE
+ * still holds the swap entry. Returns true if it did (the frame reference
+ * and the PTE's slot reference are then both settled).
  */
-int handle_vma_fault(mm_struct_t *mm, vma_struct_t *vma, uintptr_t address, uint32_t error_code);
+bool mm_swap_restore(mm_struct_t *mm, const struct swap_victim *victim);
 
 
 #endif // MM_H
@@ -0,0 +1,63 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include <kernel/core/types.h>
+#include <kernel/fs/vfs/vfs.h>
+
+/**
+ * @brief Cache of file pages shared by read(), mappings and exec.
+ *
+ * Each cached page holds a file's bytes at one page-aligned offset (up to
+ * EOF, zero past it). vfs_read()/vfs_pread() copy out of these pages, so hot
+ * files are served without asking the driver, and faults on read-only
+ * file-backed VMAs (executable text and rodata) map the same frames instead
+ * of reading private copies: every process running the same executable
+ * shares one frame per page, and the frames a read() warmed up are the ones
+ * exec maps. Pages are keyed by the file's vfs_file_id_t, which stays the
+ * same across opens; drivers without an identify hook simply bypass the cache.
+ *
+ * The cache holds one frame reference per page and each mapping holds
+ * another. A page whose only reference is the cache's is unused and is the
+ * first to go when the cache is full. Writing, truncating or unlinking a
+ * file drops its pages from the cache; processes that still map them keep
+ * their frames until they unmap.
+ */
+
+/** Pages the cache keeps before it starts evicting unused ones. */
+#define PAGE_CACHE_MAX_PAGES     1024
+
+/** @brief Registers the cache's shrinker; unused pages go under memory pressure. */
+void page_cache_init(void);
+
+/**
+ * @brief Returns a frame holding @p len bytes of @p file at page-aligned
+ * @p offset, zero-filled past them. The caller owns one reference and must
+ * map the frame read-only. It is the cached frame when @p len covers the
+ * file's bytes in that page, else a private copy of it. Returns 0 when the
+ * file can't be cached or on failure; the caller then reads a private page
+ * itself. May sleep on I/O.
+ */
+uintptr_t page_cache_get_page(file_t *file, off_t offset, size_t len);
+
+/**
+ * @brief Like page_cache_get_page() but never reads or copies: returns the
+ * cached frame with a reference for the caller, or 0 if the page isn't
+ * cached. Used by fault-around, which must not block on I/O for speculative pages.
+ */
+uintptr_t page_cache_lookup(file_t *file, off_t offset, size_t len);
+
+/**
+ * @brief Copies up to @p len bytes of @p file at @p offset out of cached
+ * pages, reading the missing ones into the cache. The caller holds
+ * file->lock. Returns the bytes copied (0 at EOF), or -FS_ERR_NOT_SUPPORTED
+ * when the file can't be cached (or nothing could be): read the driver then.
+ */
+int page_cache_read(file_t *file, void *buf, size_t len, off_t offset);
+
+/** @brief Drops every cached page of file @p id->ino on mount @p id->fs. */
+void page_cache_invalidate_file(const vfs_file_id_t *id);
+
+/** @brief Drops every cached page on mount context @p fs. */
+void page_cache_invalidate_fs(const void *fs);
+
+#endif // PAGE_CACHE_H
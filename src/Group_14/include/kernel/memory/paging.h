@@ -123,8 +123,27 @@
  #define KERNEL_TEMP_MAP_SIZE  (KERNEL_TEMP_MAP_END - KERNEL_TEMP_MAP_START)
  #define KERNEL_TEMP_MAP_COUNT (KERNEL_TEMP_MAP_SIZE / PAGE_SIZE) // Number of temp slots (4096)
 
+ // The first slots of the temp area are fixed per-CPU kmap_atomic() slots,
+ // KMAP_SLOTS_PER_CPU for each CPU, never handed out by paging_temp_map().
+ #define KMAP_SLOTS_PER_CPU    8
+ #define KERNEL_KMAP_START     KERNEL_TEMP_MAP_START
+
  #define KERNEL_STACK_VADDR_START 0xE0000000
 
+ // --- Kernel Direct Map ---
+ // Low physical memory [0, g_direct_map_phys_end) stays mapped at
+ // KERNEL_SPACE_VIRT_START + phys with global 4MB pages, so translating a
+ // lowmem frame to a kernel pointer is an addition. It ends where the kernel
+ // stack range begins; frames above it (highmem) need paging_temp_map().
+ #define KERNEL_DIRECT_MAP_MAX_SIZE (KERNEL_STACK_VADDR_START - KERNEL_SPACE_VIRT_START)
+
+ // --- Device MMIO Window ---
+ // Permanent uncached mappings for device registers (LAPIC, IOAPIC) and
+ // firmware tables, handed out by paging_map_mmio(). Sits between the
+ // temporary mapping area and the recursive mapping.
+ #define KERNEL_MMIO_VIRT_START 0xFF000000u
+ #define KERNEL_MMIO_VIRT_END   0xFFC00000u
+
  // --- CPU Features / Control Register Bits / MSRs ---
  // CR4 Bits
  #define CR4_PSE (1 << 4) // Page Size Extension (Enable 4MB pages)
@@ -134,6 +153,7 @@
  // CPUID Feature Bits (EDX from basic features, Leaf 1)
  #define CPUID_FEAT_EDX_PSE (1 << 3)  // Processor supports Page Size Extension
  #define CPUID_FEAT_EDX_PAE (1 << 6)  // Processor supports PAE
+ #define CPUID_FEAT_EDX_PGE (1 << 13) // Processor supports global pages
 
  // CPUID Feature Bits (EDX from extended features, Leaf 0x80000001)
  #define CPUID_FEAT_EDX_NX (1 << 20) // Processor supports NX bit (Execute Disable)
@@ -147,6 +167,7 @@
 #define PAGE_FAULT_PRESENT  (1 << 0) // P bit: 0=Not Present, 1=Protection Violation
 #define PAGE_FAULT_WRITE    (1 << 1) // W/R bit: 0=Read, 1=Write
 #define PAGE_FAULT_USER     (1 << 2) // U/S bit: 0=Supervisor, 1=User
+#define PAGE_FAULT_IFETCH   (1 << 4) // I/D bit: instruction fetch (reported with NX enabled)
 
 
  typedef struct registers {
@@ -168,9 +189,21 @@
  // --- Global Paging Variables (Defined in paging.c) ---
  extern bool g_pse_supported;               // True if CPU supports 4MB pages (PSE)
  extern bool g_nx_supported;                // True if CPU supports No-Execute (via EFER)
+ extern bool g_pge_supported;               // True if CR4.PGE is on; kernel mappings get PAGE_GLOBAL
+ extern uintptr_t g_direct_map_phys_end;    // End of the lowmem direct map (4MB aligned)
  extern uint32_t* g_kernel_page_directory_virt; // Virtual address of the kernel's page directory
  extern uint32_t g_kernel_page_directory_phys; // Physical address of the kernel's page directory
 
+ /*
+  * Whether the page table in slot @p pd_idx of @p pd_phys keeps a live-PTE
+  * count (frame_pt_live_set/add): the user half of process directories,
+  * except slot 0, the identity table they share with the kernel directory.
+  * paging_unmap_range() frees a counted table once its count drops to 0.
+  */
+ static inline bool paging_pt_counted(uint32_t *pd_phys, uint32_t pd_idx) {
+     return pd_idx != 0 && pd_idx < KERNEL_PDE_INDEX && (uintptr_t)pd_phys != g_kernel_page_directory_phys;
+ }
+
 
  // --- Public Paging Function Prototypes ---
 
@@ -188,11 +221,14 @@
  int paging_map_range(uint32_t *page_directory_phys, uintptr_t virt_start_addr, uintptr_t phys_start_addr, size_t memsz, uint32_t flags);
  int paging_unmap_range(uint32_t *page_directory_phys, uintptr_t virt_start_addr, size_t memsz);
  int paging_map_single_4k(uint32_t *page_directory_phys, uintptr_t vaddr, uintptr_t paddr, uint32_t flags);
+ // Turns a user 4MB PDE into a page table of the same frames and flags; returns the table's phys or 0
+ uintptr_t paging_split_large_pde(uint32_t *page_directory_phys, uint32_t *pd_virt, uint32_t pd_idx);
 
  // Utilities and Process Management
  void page_fault_handler(registers_t *regs);
- void paging_free_user_space(uint32_t *page_directory_phys);
- uintptr_t paging_clone_directory(uint32_t* src_pd_phys);
+ void paging_free_user_space(uint32_t *page_directory_phys); // Whole user half of a dying PD: frames, PTs, one flush
+ struct rwlock;
+ uintptr_t paging_clone_directory(uint32_t* src_pd_phys, struct rwlock *src_lock); // Taken exclusively per page table; NULL if unshared
  int paging_get_physical_address(uint32_t *page_directory_phys, uintptr_t vaddr, uintptr_t *paddr);
  void copy_kernel_pde_entries(uint32_t *new_pd_virt);
 
@@ -200,6 +236,23 @@
  void paging_invalidate_page(void *vaddr); // Implemented in ASM
  void tlb_flush_range(void* start, size_t size);
 
+ // --- Kernel Direct Map Helpers ---
+ /** @brief True if @p phys_addr is reachable through the direct map. */
+ static inline bool paging_phys_is_direct(uintptr_t phys_addr) {
+     return phys_addr < g_direct_map_phys_end;
+ }
+
+ /** @brief Kernel pointer for a lowmem physical address (see paging_phys_is_direct). */
+ static inline void *paging_phys_to_virt(uintptr_t phys_addr) {
+     return (void *)(KERNEL_SPACE_VIRT_START + phys_addr);
+ }
+
+ /** @brief True if @p vaddr lies inside the direct map. */
+ static inline bool paging_virt_is_direct(const void *vaddr) {
+     uintptr_t v = (uintptr_t)vaddr;
+     return v >= KERNEL_SPACE_VIRT_START && v - KERNEL_SPACE_VIRT_START < g_direct_map_phys_end;
+ }
+
  // --- NEW Dynamic Temporary Mapping ---
  /**
   * @brief Initializes the dynamic temporary virtual address allocator.
@@ -211,6 +264,10 @@
   * @brief Temporarily maps a physical page into a dynamically allocated kernel
   * virtual address from the KERNEL_TEMP_MAP range.
   *
+  * Lowmem frames are not remapped: their direct-map address is returned
+  * without touching a PTE or the TLB. The direct map is always writable, so
+  * PTE_KERNEL_READONLY_FLAGS only takes effect for highmem frames.
+  *
   * @param phys_addr The physical address of the page frame to map (must be page-aligned).
   * @param flags     The desired page table entry flags (e.g., PTE_KERNEL_DATA_FLAGS).
   * @return A kernel virtual address where the page is mapped, or NULL on failure
@@ -222,9 +279,40 @@
   * @brief Unmaps a previously allocated temporary virtual address.
   *
   * @param temp_vaddr The virtual address returned by paging_temp_map.
+  * Direct-map addresses are accepted and left mapped.
   */
  void paging_temp_unmap(void* temp_vaddr);
 
+ /**
+  * @brief Maps a physical page into one of this CPU's fixed kmap slots.
+  *
+  * Slots are used as a stack: a map is one PTE write and one INVLPG in the
+  * pre-allocated temp-area page table, with no lock and no search. Lowmem
+  * frames return their direct-map address and touch nothing.
+  * Interrupts stay disabled from the outermost kmap_atomic() until the
+  * matching kunmap_atomic(), so the caller must not sleep in between and
+  * must unmap in reverse order. At most KMAP_SLOTS_PER_CPU may be nested.
+  *
+  * @param phys_addr Page-aligned physical address.
+  * @return Kernel virtual address of the page (never NULL).
+  */
+ void* kmap_atomic(uintptr_t phys_addr);
+
+ /** @brief Releases the most recent kmap_atomic() mapping, @p vaddr. */
+ void kunmap_atomic(void* vaddr);
+
+ /**
+  * @brief Maps a physical device/firmware range into the kernel MMIO window.
+  * Mappings are uncached, kernel-only and permanent. Must be called before
+  * user page directories are cloned so every address space sees the PDE.
+  *
+  * @param phys_addr Physical start (need not be page-aligned).
+  * @param size      Length in bytes.
+  * @return Virtual address corresponding to @p phys_addr, or NULL if the
+  * window is exhausted or mapping failed.
+  */
+ void* paging_map_mmio(uintptr_t phys_addr, size_t size);
+
  int paging_get_physical_address_and_flags(uint32_t *page_directory_phys,
     uintptr_t vaddr,
     uintptr_t *paddr_out,
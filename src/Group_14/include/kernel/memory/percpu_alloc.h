@@ -14,6 +14,9 @@ extern "C" {
  */
 void percpu_kmalloc_init(void);
 
+/** @brief Pass as 'cpu_id' to allocate from the calling CPU's caches (via %fs). */
+#define PERCPU_ALLOC_THIS_CPU (-1)
+
 /**
  * @brief Allocates 'total_required_size' bytes from the per-CPU slab caches for 'cpu_id'.
  *
@@ -22,7 +25,7 @@ void percpu_kmalloc_init(void);
  * The caller (kmalloc) is responsible for adding the header.
  *
  * @param total_required_size The total size needed (user size + header, aligned).
- * @param cpu_id The ID of the CPU requesting the allocation.
+ * @param cpu_id The ID of the CPU requesting the allocation, or PERCPU_ALLOC_THIS_CPU.
  * @param out_cache Optional output pointer to store the slab_cache_t* used.
  * @return Pointer to the raw allocated memory block (start of slab object), or NULL on failure.
  */
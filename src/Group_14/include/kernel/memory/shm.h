@@ -0,0 +1,55 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include <kernel/core/types.h>
+#include <kernel/fs/vfs/vfs.h>
+#include <libc/stdbool.h>
+
+/**
+ * @brief Named shared-memory objects (shm_open/shm_unlink).
+ *
+ * An object is a fixed-size array of page frames, allocated zeroed on first
+ * touch and kept until the object goes away. shm_open() returns an fd on
+ * it; mmap(MAP_SHARED) of that fd maps the object's own frames, so every
+ * process mapping it (and every fork() child) sees the same memory. Each
+ * mapped page holds one frame reference and the object holds another, so
+ * unlink and close never pull pages out from under a live mapping.
+ *
+ * The object lives while it is linked under its name or open (a mapping
+ * keeps its file open).
+ */
+
+#define SHM_NAME_MAX    32                  // Name bytes including the NUL
+#define SHM_MAX_OBJECTS 32                  // Objects linked at once
+#define SHM_MAX_BYTES   (16u * 1024 * 1024) // Largest object
+
+/** @brief Sets up the name table; called once at boot. */
+void shm_init(void);
+
+/**
+ * @brief Opens (with O_CREAT: creates) the object @p name.
+ * @param flags O_RDONLY or O_RDWR, plus O_CREAT / O_EXCL.
+ * @param size Bytes to create it with (rounded up to pages); ignored when
+ * it already exists.
+ * @return A file with the given access, or NULL with @p *err set (-ENOENT,
+ * -EEXIST, -EINVAL, -ENOSPC, -ENOMEM).
+ */
+file_t *shm_open_file(const char *name, int flags, size_t size, int *err);
+
+/** @brief Removes @p name; the object stays while open. 0 or -ENOENT. */
+int shm_unlink(const char *name);
+
+/** @brief True if @p file is open on a shared-memory object. */
+bool shm_is_shm(const file_t *file);
+
+/** @brief Size of the object behind @p file in bytes (a page multiple). */
+size_t shm_size(const file_t *file);
+
+/**
+ * @brief Frame holding byte @p offset of the object, allocated zeroed on
+ * first use. The caller gets its own reference (the mapping's).
+ * @return The frame, or 0 past the end or out of memory.
+ */
+uintptr_t shm_get_page(file_t *file, size_t offset);
+
+#endif // SHM_H
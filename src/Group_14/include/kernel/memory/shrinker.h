@@ -0,0 +1,60 @@
+#ifndef SHRINKER_H
+#define SHRINKER_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Memory pressure reclaim through registered shrinkers.
+ *
+ * Caches that hold memory they could give back (slab depots, page cache)
+ * register a shrinker. Reclaim happens in two ways:
+ *
+ *  - Direct: a buddy allocation that fails calls shrink_memory() with
+ *    may_block == false and retries once. The caller may hold arbitrary
+ *    locks, so shrinkers must then only trylock and must not sleep or do I/O.
+ *  - Background: when free buddy space drops below the low watermark the
+ *    housekeeping (reaper) thread is kicked and reclaims with
+ *    may_block == true until free space is back above the high watermark.
+ *
+ * Shrinkers are registered once at init and stay registered.
+ */
+
+/** Low watermark: 1/32 of the managed heap free. */
+#define SHRINK_WMARK_LOW_DIV     32
+/** High watermark: 1/16 of the managed heap free. */
+#define SHRINK_WMARK_HIGH_DIV    16
+
+typedef struct shrinker {
+    const char *name;
+    /** Bytes the shrinker could free right now (an estimate; 0 = skip it). */
+    size_t (*count)(void);
+    /**
+     * Frees up to about @p target bytes. With @p may_block false it must not
+     * sleep, do I/O or spin on a lock. Returns the bytes freed.
+     */
+    size_t (*scan)(size_t target, bool may_block);
+    struct shrinker *next;   // Registry link (owned by shrinker.c)
+} shrinker_t;
+
+/** @brief Adds @p shrinker to the registry. The structure must stay alive. */
+void shrinker_register(shrinker_t *shrinker);
+
+/**
+ * @brief Asks the shrinkers for @p target bytes. Returns the bytes freed
+ * (0 if another CPU is already reclaiming).
+ */
+size_t shrink_memory(size_t target, bool may_block);
+
+/**
+ * @brief Called by the buddy allocator with its free byte count after an
+ * allocation; flags background reclaim below the low watermark.
+ */
+void shrinker_note_free(size_t free_bytes);
+
+/** @brief True while free space is below the low watermark and not yet reclaimed. */
+bool shrinker_background_pending(void);
+
+/** @brief Reclaims until the high watermark is reached. Thread context only. */
+void shrinker_background_reclaim(void);
+
+#endif // SHRINKER_H
@@ -3,6 +3,7 @@
 
 #include <kernel/core/types.h> // Includes size_t, bool,stdint.h, etc.
 #include <kernel/sync/spinlock.h> // Include spinlock header
+#include <kernel/cpu/get_cpu_id.h> // For MAX_CPUS
 
 #ifdef __cplusplus
 extern "C" {
@@ -11,13 +12,39 @@ extern "C" {
 // Forward declaration for slab_t used internally by slab.c
 typedef struct slab slab_t;
 
+// Objects per magazine; sized so a magazine plus its buddy header fill a 64-byte block.
+#define SLAB_MAGAZINE_ROUNDS 12
+
+// Full magazines the depot keeps before further ones are flushed to the slabs.
+#define SLAB_DEPOT_MAX_FULL 4
+
+// Forward declaration for the magazine type used internally by slab.c
+typedef struct slab_magazine slab_magazine_t;
+
+/**
+ * @brief One CPU's magazines of free objects in a cache.
+ *
+ * Only the owning CPU touches this, with interrupts disabled, so the fast
+ * paths of slab_alloc()/slab_free() take no lock. 'loaded' is popped and
+ * pushed; 'previous' is swapped in when 'loaded' runs empty or full, so a
+ * CPU bouncing around a magazine boundary doesn't go to the depot each time.
+ */
+typedef struct slab_cpu {
+    slab_magazine_t *loaded;    // Magazine allocations pop and frees push.
+    slab_magazine_t *previous;  // Full or empty; swapped with 'loaded'.
+    unsigned long alloc_count;  // Objects allocated on this CPU.
+    unsigned long free_count;   // Objects freed on this CPU.
+} __attribute__((aligned(64))) slab_cpu_t; // One cache line per CPU
+
 /**
  * @brief Structure representing a slab cache.
  */
 typedef struct slab_cache {
+    struct slab_cache *next;    // Link in the list of all caches (slab_dump_stats).
     const char *name;           // Debug name for the cache.
     size_t user_obj_size;       // Size requested by the user.
     size_t internal_slot_size;  // Actual size allocated per object (user + metadata like footer).
+    size_t link_offset;         // Offset of the free-list link in a free slot (past the user area if constructed).
     size_t alignment;           // Alignment required for objects in this cache.
     unsigned int objs_per_slab_max; // Max possible objects per slab (calculated once).
 
@@ -30,17 +57,21 @@ typedef struct slab_cache {
     unsigned int color_next;    // Next color offset to use for a new slab.
     unsigned int color_range;   // Range of color offsets (e.g., cache line size).
 
-    // Statistics
-    unsigned long alloc_count;  // Total objects allocated.
-    unsigned long free_count;   // Total objects freed back.
+    // Magazine depot (protected by 'lock').
+    slab_magazine_t *depot_full;  // Full magazines, linked through 'next'.
+    slab_magazine_t *depot_empty; // Empty magazines, linked through 'next'.
+    unsigned int depot_nr_full;   // Magazines on depot_full.
 
     // Concurrency Control
-    spinlock_t lock;            // Spinlock to protect cache metadata and lists.
+    spinlock_t lock;            // Spinlock to protect cache metadata, lists and the depot.
 
-    // Optional: Constructor/Destructor function pointers
+    // Optional: Constructor/Destructor function pointers (see slab_create)
     void (*constructor)(void *obj);
     void (*destructor)(void *obj);
 
+    // Per-CPU magazine layer (also holds the statistics).
+    slab_cpu_t cpu[MAX_CPUS];
+
 } slab_cache_t;
 
 
@@ -55,8 +86,11 @@ typedef struct slab_cache {
  * @param obj_size Size of each object requested by the user.
  * @param align    Required alignment for objects (power of 2), or 0 for default.
  * @param color_range Range for slab coloring offset (e.g., 64 for L1 cache line), 0 to disable.
- * @param constructor Optional constructor function (can be NULL).
- * @param destructor Optional destructor function (can be NULL).
+ * @param constructor Optional constructor (can be NULL). Runs once per object
+ *                    when its slab is built, to set up invariant fields such as
+ *                    locks; objects must be freed back in that state.
+ * @param destructor Optional destructor (can be NULL). Runs once per object
+ *                    when its slab is returned to the buddy system.
  * @return Pointer to the created slab_cache_t, or NULL on failure.
  */
 slab_cache_t *slab_create(const char *name, size_t obj_size, size_t align,
@@ -66,8 +100,11 @@ slab_cache_t *slab_create(const char *name, size_t obj_size, size_t align,
 /**
  * slab_alloc
  *
- * Allocates one object from the cache. Writes metadata (e.g., footer canary).
- * Calls constructor if provided. Thread-safe via internal locking.
+ * Allocates one object from the cache. With a constructor, the object is
+ * already constructed; otherwise its contents are undefined.
+ * Pops the calling CPU's magazine without locking; only when both of its
+ * magazines are empty does it take the cache lock to swap in a full one from
+ * the depot or refill a magazine from the slabs. Safe in any context.
  *
  * @param cache Pointer to the slab cache.
  * @return Pointer to the allocated object (start of user area), or NULL on failure.
@@ -78,7 +115,9 @@ void *slab_alloc(slab_cache_t *cache);
  * slab_free
  *
  * Frees an object back into its slab cache. Checks metadata (e.g., footer canary).
- * Calls destructor if provided. Thread-safe via internal locking.
+ * The object goes onto the calling CPU's
+ * magazine; full magazines go to the depot, or back to the slabs once the
+ * depot holds SLAB_DEPOT_MAX_FULL. Safe in any context.
  *
  * @param cache Pointer to the slab cache (recommended, but can be NULL if metadata reliable).
  * @param obj   Pointer to the object (start of user area) previously allocated.
@@ -98,7 +137,8 @@ void slab_destroy(slab_cache_t *cache);
 /**
  * slab_cache_stats
  *
- * Retrieves allocation and free counts. Thread-safe via internal locking.
+ * Retrieves allocation and free counts, summed over all CPUs. The sum is a
+ * snapshot: other CPUs may be counting while it is read.
  *
  * @param cache      Pointer to the slab cache.
  * @param out_alloc  Pointer to store the total allocation count (can be NULL).
@@ -106,6 +146,31 @@ void slab_destroy(slab_cache_t *cache);
  */
 void slab_cache_stats(slab_cache_t *cache, unsigned long *out_alloc, unsigned long *out_free);
 
+/**
+ * slab_dump_stats
+ *
+ * Prints the name, slot size and counts of every cache to the serial port.
+ * The counts are a snapshot: other CPUs may allocate or free meanwhile.
+ */
+void slab_dump_stats(void);
+
+/**
+ * slab_for_each_cache
+ *
+ * Calls @p fn on every live cache with the cache list locked and interrupts
+ * off, so @p fn must not sleep, allocate, or create or destroy a cache.
+ */
+void slab_for_each_cache(void (*fn)(slab_cache_t *cache, void *arg), void *arg);
+
+/**
+ * slab_shrinker_init
+ *
+ * Registers the shrinker that flushes the caches' depot magazines back to
+ * their slabs under memory pressure, returning empty slabs to the buddy
+ * system. Call once after kmalloc_init().
+ */
+void slab_shrinker_init(void);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,142 @@
+#ifndef SWAP_H
+#define SWAP_H
+
+#include <kernel/core/types.h>
+#include <kernel/memory/paging.h>
+
+struct mm_struct;
+
+/**
+ * @brief Swap space for anonymous memory.
+ *
+ * One swap area, on a block device given at boot with "swap=<device>": the
+ * device's MBR partition of type SWAP_PARTITION_TYPE, or the whole device
+ * if it has no partition table. It is cut into page-sized slots; slot 0 is
+ * never handed out, so an entry is never 0.
+ *
+ * A swapped-out page leaves a swap entry in its PTE: the slot number in the
+ * address bits with SWAP_PTE_MARK set and PAGE_PRESENT clear. The entry
+ * counts as a live PTE of its page table (frame_pt_live_add), fork() copies
+ * it and takes another slot reference, unmapping drops it. A fault on it
+ * reads the slot back (vma_fault() in mm.c), together with neighbouring
+ * slots that the same page table refers to.
+ *
+ * Pages are picked by a CLOCK sweep over the PTEs of private writable VMAs
+ * (mm_swap_scan()): a page the CPU marked accessed since the hand last
+ * passed gets a second chance and loses the bit, an unreferenced one whose
+ * frame nobody else holds is written out. The sweep runs from background
+ * reclaim (a shrinker asked only when may_block is set) over every process,
+ * and from a fault that finds no free frame over the faulting process.
+ * Evictions are serialized; 4MB pages and shared or pinned frames stay.
+ *
+ * A slot stays readable while its page is being written: the fault path
+ * then maps the frame under writeback read-only instead of reading the disk.
+ */
+
+/** MBR partition type of a swap area (the Linux swap code). */
+#define SWAP_PARTITION_TYPE  0x82
+
+/** Bit marking a non-present PTE as a swap entry. */
+#define SWAP_PTE_MARK        0x002u
+
+/** Pages written back per eviction batch. */
+#define SWAP_CLUSTER         16
+
+/** PTEs a background scan looks at per call. */
+#define SWAP_SCAN_BUDGET     2048
+
+/** Largest slot number an entry can hold (20 address bits). */
+#define SWAP_MAX_SLOTS       (1u << 20)
+
+static inline bool pte_is_swap(uint32_t pte) {
+    return (pte & (PAGE_PRESENT | SWAP_PTE_MARK)) == SWAP_PTE_MARK;
+}
+
+static inline uint32_t swap_entry_slot(uint32_t entry) {
+    return entry / PAGE_SIZE;
+}
+
+static inline uint32_t swap_slot_entry(uint32_t slot) {
+    return (slot * PAGE_SIZE) | SWAP_PTE_MARK;
+}
+
+/** @brief Replaces @p old with @p new_pte if the entry still holds it. */
+static inline bool pte_cmpxchg(volatile uint32_t *pte, uint32_t old, uint32_t new_pte) {
+    uint32_t seen;
+    asm volatile("lock cmpxchgl %2, %1"
+                 : "=a"(seen), "+m"(*pte)
+                 : "r"(new_pte), "0"(old)
+                 : "memory", "cc");
+    return seen == old;
+}
+
+/** A page the clock unmapped for writeback (mm_swap_scan() in mm.c). */
+typedef struct swap_victim {
+    uintptr_t addr;      // User page
+    uint32_t  pte;       // Its PTE before the swap entry replaced it
+    uint32_t  entry;
+} swap_victim_t;
+
+typedef struct swap_stats {
+    char     device[8];     // Empty while no area is active
+    uint32_t nr_slots;      // Usable slots
+    uint32_t nr_used;
+    uint32_t swapouts;      // Pages written out
+    uint32_t swapins;       // Pages read back, read-ahead included
+    uint32_t readahead;     // Of those, read for a neighbouring fault
+    uint32_t wb_hits;       // Faults served from a frame still being written
+    uint32_t second_chance; // Accessed bits the clock cleared
+    uint32_t io_errors;
+} swap_stats_t;
+
+/** @brief Registers the swap shrinker. Call before the other shrinkers. */
+void swap_shrinker_init(void);
+
+/**
+ * @brief Activates @p device (a name for disk_init()) as the swap area.
+ * @return FS_SUCCESS, or a negative FS_ERR_* code (nothing is activated).
+ */
+int swap_on(const char *device);
+
+/** @brief True once a swap area is active (swap entries may exist). */
+bool swap_active(void);
+
+/**
+ * @brief A new entry for the frame at @p phys, which is about to be unmapped.
+ * The slot has one reference for the PTE and one for the writeback, and
+ * reads of it find @p phys until its writeback is done. 0 if the area
+ * is full (or absent).
+ */
+uint32_t swap_alloc_entry(uintptr_t phys);
+
+/** @brief Takes back an entry from swap_alloc_entry() that no PTE holds. */
+void swap_cancel_entry(uint32_t entry);
+
+/** @brief Another PTE holds @p entry (fork). False if its count is saturated. */
+bool swap_dup(uint32_t entry);
+
+/** @brief Drops one PTE's reference to @p entry; the last frees the slot. */
+void swap_free(uint32_t entry);
+
+/**
+ * @brief The frame @p entry is being written from, with a reference for the
+ * caller, or 0. Map it read-only: it is still the writeback's.
+ */
+uintptr_t swap_writeback_frame(uint32_t entry);
+
+/**
+ * @brief Reads the page @p entry names into the frame at @p phys. May sleep.
+ * @return FS_SUCCESS, FS_ERR_NOT_FOUND if the slot was freed meanwhile
+ * (a racing unmap or swap-in), or an I/O error.
+ */
+int swap_read_page(uint32_t entry, uintptr_t phys, bool readahead);
+
+/**
+ * @brief Swaps out up to @p nr_pages cold pages of @p mm, the faulting
+ * process's own address space. Returns the pages written. May sleep.
+ */
+uint32_t swap_reclaim_mm(struct mm_struct *mm, uint32_t nr_pages);
+
+void swap_get_stats(swap_stats_t *out);
+
+#endif // SWAP_H
@@ -0,0 +1,84 @@
+#ifndef TLB_H
+#define TLB_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief TLB shootdown across CPUs.
+ *
+ * A page table change must be invalidated on every CPU that may have cached
+ * the old entry. For user addresses that is only the CPUs whose CR3 holds the
+ * changed page directory (tracked in percpu_t::active_pgd). Kernel addresses
+ * are shared by every address space, so those requests go to all CPUs.
+ * Remote CPUs get IPI_TLB_SHOOTDOWN_VECTOR (lapic.h) and acknowledge once
+ * they have flushed. Ranges longer than TLB_FULL_FLUSH_PAGES are flushed with a CR3 reload (or a
+ * CR4.PGE toggle for global kernel entries) instead of one INVLPG per page.
+ *
+ * A CPU spinning on a spinlock_t or rwlock_t with interrupts disabled still
+ * services requests through tlb_poll(), so holding a lock while shooting
+ * down cannot deadlock against a CPU that waits for that lock.
+ */
+
+/** Ranges with more pages than this are flushed whole. */
+#define TLB_FULL_FLUSH_PAGES     32
+
+/** Frames a batch holds back before it must flush. */
+#define TLB_BATCH_FRAMES         32
+
+/**
+ * @brief Invalidations gathered while editing one address space.
+ *
+ * Unmapping code records each cleared PTE with tlb_batch_add_page() and
+ * hands the old frames to tlb_batch_free_frame(). They are only returned
+ * to the frame allocator after the flush, so no CPU can still reach a freed
+ * frame through a stale TLB entry. One shootdown covers the whole batch.
+ */
+typedef struct tlb_batch {
+    uint32_t  *pgd_phys;   // Address space being edited (NULL = kernel range)
+    uintptr_t  start;      // Pending range [start, end); empty when start == end
+    uintptr_t  end;
+    uint32_t   nr_frames;
+    uintptr_t  frames[TLB_BATCH_FRAMES];
+} tlb_batch_t;
+
+/**
+ * @brief Registers the shootdown IPI handler (BSP, first call) and marks
+ * CPU @p cpu as able to receive requests. Call on that CPU once its local
+ * APIC and IDT are live.
+ */
+void tlb_init_cpu(uint32_t cpu);
+
+/**
+ * @brief Invalidates [start, end) in address space @p pgd_phys (NULL for
+ * kernel addresses) on every CPU that may cache it, including the caller.
+ * Returns once all targeted CPUs have flushed. Any context.
+ */
+void tlb_shootdown(uint32_t *pgd_phys, uintptr_t start, uintptr_t end);
+
+/** @brief Starts an empty batch for address space @p pgd_phys. */
+void tlb_batch_init(tlb_batch_t *batch, uint32_t *pgd_phys);
+
+/** @brief Records that the PTE (or PDE) mapping @p vaddr was changed. */
+void tlb_batch_add_page(tlb_batch_t *batch, uintptr_t vaddr);
+
+/**
+ * @brief Defers put_frame(@p frame_phys) until the batch is flushed.
+ * Flushes early when the batch is full.
+ */
+void tlb_batch_free_frame(tlb_batch_t *batch, uintptr_t frame_phys);
+
+/** @brief Shoots down the pending range, then frees the deferred frames. */
+void tlb_batch_flush(tlb_batch_t *batch);
+
+// Bit per CPU with a request outstanding; read by tlb_poll() in lock spin loops.
+extern volatile uint32_t g_tlb_pending_cpus;
+
+/** @brief Services a pending request for the calling CPU, if any. */
+void tlb_service_pending(void);
+
+/** @brief Cheap check for spin loops: one load when nothing is pending. */
+static inline void tlb_poll(void) {
+    if (g_tlb_pending_cpus) tlb_service_pending();
+}
+
+#endif // TLB_H
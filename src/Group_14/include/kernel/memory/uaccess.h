@@ -52,4 +52,18 @@ size_t copy_to_user(userptr_t u_dst, const_kernelptr_t k_src, size_t n) __attrib
 extern size_t _raw_copy_from_user(void *k_dst, const void *u_src, size_t n);
 extern size_t _raw_copy_to_user(void *u_dst, const void *k_src, size_t n);
 
+/**
+ * @brief copy_from_user() without the access_ok() walk, for a range the
+ * caller has already checked (e.g. a loop over one validated buffer).
+ * Faults are still recovered; returns the bytes NOT copied.
+ */
+static inline size_t __copy_from_user(kernelptr_t k_dst, const_userptr_t u_src, size_t n) {
+    return _raw_copy_from_user((void*)k_dst, (const void*)u_src, n);
+}
+
+/** @brief copy_to_user() for a range that already passed access_ok(). */
+static inline size_t __copy_to_user(userptr_t u_dst, const_kernelptr_t k_src, size_t n) {
+    return _raw_copy_to_user((void*)u_dst, (const void*)k_src, n);
+}
+
 #endif // UACCESS_H
\ No newline at end of file
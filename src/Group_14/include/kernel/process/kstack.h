@@ -0,0 +1,37 @@
+#ifndef KSTACK_H
+#define KSTACK_H
+
+#include <kernel/core/types.h>
+#include <libc/stdbool.h>
+
+/**
+ * @brief Kernel stacks for processes and threads.
+ *
+ * Each stack is PROCESS_KSTACK_SIZE of mapped memory in its own slot of the
+ * kernel stack region, with an unmapped guard page below it, so running off
+ * the bottom faults instead of overwriting a neighbour. Freed stacks stay
+ * mapped on a LIFO cache (up to KSTACK_CACHE_MAX of them) and the next
+ * kstack_alloc() takes one off in O(1); only a miss allocates and maps
+ * frames.
+ */
+
+#define KSTACK_CACHE_MAX 16 // Free stacks kept mapped; beyond that they are unmapped
+#define KSTACK_PREFILL   4  // Stacks mapped by kstack_init()
+
+/** @brief Maps the first KSTACK_PREFILL stacks; called once at boot. */
+void kstack_init(void);
+
+/**
+ * @brief Hands out a kernel stack.
+ * @return Its top (one past the highest usable byte, 16-byte aligned), or
+ * NULL when out of frames or stack slots. Contents are undefined.
+ */
+uint32_t *kstack_alloc(void);
+
+/** @brief Returns a stack from kstack_alloc() by its top; NULL is ignored. */
+void kstack_free(uint32_t *top);
+
+/** @brief True if @p addr lies in the guard page of a kernel stack slot. */
+bool kstack_is_guard(uintptr_t addr);
+
+#endif // KSTACK_H
@@ -0,0 +1,27 @@
+#ifndef PID_H
+#define PID_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Process and thread IDs.
+ *
+ * IDs 1..PID_MAX-1 come from a bitmap. Allocation moves forward from the
+ * last ID handed out and wraps, so a freed ID is reused only after the
+ * rest of the space has gone round; a second-level bitmap of full words
+ * bounds the search. Kernel threads take IDs counting down from
+ * REAPER_TASK_PID instead and never touch the bitmap.
+ *
+ * A process's ID stays taken while its PCB exists (exit records
+ * included), an extra thread's until its TCB is reaped.
+ */
+
+#define PID_MAX 32768 // One past the largest ID; a multiple of 1024
+
+/** @brief Takes a free ID; 0 when all are in use. Any context. */
+uint32_t pid_alloc(void);
+
+/** @brief Returns @p pid to the pool; 0 and out-of-range IDs are ignored. */
+void pid_free(uint32_t pid);
+
+#endif // PID_H
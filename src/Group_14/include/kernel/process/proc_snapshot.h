@@ -0,0 +1,79 @@
+#ifndef PROC_SNAPSHOT_H
+#define PROC_SNAPSHOT_H
+
+#include <kernel/core/types.h>
+#include <libc/stdbool.h>
+
+struct mm_struct;
+
+/**
+ * @brief Pre-initialized address spaces of programs, for fast start.
+ *
+ * The first creation of a process from a path builds a snapshot: an address
+ * space that belongs to no process, holding the program's segment VMAs
+ * (from the ELF headers), the heap and stack VMAs, and its text pages
+ * faulted in, plus the entry point. Every process created from the path
+ * after that, spawned or launched from the kernel, copies the snapshot the
+ * way fork() copies a parent: page tables duplicated, frames shared
+ * copy-on-write, VMAs cloned. No ELF is opened or parsed again, and the
+ * text is mapped before its first instruction runs.
+ *
+ * A snapshot is keyed by path and identified by the file's inode number,
+ * mtime and size; a stat of the path that disagrees replaces it. The
+ * argument stack page and the vvar pages are per process and never part of
+ * a snapshot.
+ *
+ * At most PROC_SNAPSHOT_MAX programs are kept, the least recently used
+ * going first. The snapshot shrinker drops the unused ones under memory
+ * pressure (their page tables, and the page cache pages they keep mapped).
+ */
+
+#define PROC_SNAPSHOT_MAX            8
+#define PROC_SNAPSHOT_PREFAULT_PAGES 64 // Text pages mapped into a new snapshot
+
+typedef struct proc_snapshot {
+    struct mm_struct *mm;           // VMAs, brk and stack layout
+    uint32_t         *pd_phys;      // Its own page directory
+    uint32_t          entry_point;
+    uint32_t          nr_prefaulted;
+    // Private to proc_snapshot.c
+    uint32_t          refcount;     // The cache's, and one per process being built from it
+    uint32_t          last_use;
+    uint32_t          st_ino, st_mtime, st_size;
+    char              path[];
+} proc_snapshot_t;
+
+typedef struct proc_snapshot_stats {
+    uint32_t cached;
+    uint32_t hits;
+    uint32_t builds;
+    uint32_t stale;                 // Replaced because the file changed
+    uint32_t evictions;             // LRU replacements and shrinker drops
+} proc_snapshot_stats_t;
+
+/** @brief Registers the snapshot shrinker; called once at boot. */
+void proc_snapshot_init(void);
+
+/**
+ * @brief The snapshot of @p path, built now if there is none or the file
+ * changed, with a reference for the caller. May sleep.
+ * @return The snapshot, or NULL with a negative errno in @p *err.
+ */
+proc_snapshot_t *proc_snapshot_get(const char *path, int *err);
+
+/** @brief Drops a reference from proc_snapshot_get(). */
+void proc_snapshot_put(proc_snapshot_t *snap);
+
+/** @brief Drops every snapshot no process is being built from. */
+void proc_snapshot_drop_all(void);
+
+void proc_snapshot_get_stats(proc_snapshot_stats_t *out);
+
+/**
+ * @brief Loads the ELF at @p path into the empty @p mm (segment, heap and
+ * stack VMAs, brk) and returns its entry point in @p *entry_point. (process.c)
+ * @return 0, or a negative errno.
+ */
+int process_build_image(const char *path, struct mm_struct *mm, uint32_t *entry_point);
+
+#endif // PROC_SNAPSHOT_H
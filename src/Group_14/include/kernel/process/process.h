@@ -5,17 +5,22 @@
 
 #include <kernel/core/types.h>      // Include necessary base types
 #include <kernel/memory/paging.h>      // Include for PAGE_SIZE, KERNEL_SPACE_VIRT_START, registers_t
+#include <kernel/cpu/isr_frame.h>      // isr_frame_t for process_fork()
 // #include <kernel/fs/vfs/fs_limits.h>   // Define MAX_FD directly below instead
 
 // Forward declare mm_struct to avoid circular dependency with mm.h if needed
 struct mm_struct;
 // Forward declare sys_file if needed, OR include sys_file.h if it only contains declarations/typedefs
 struct sys_file;
+struct fd_table;
+struct io_ring;
+struct syscall_trace;
 
 // === Configuration Constants ===
 
-// Define the maximum number of open file descriptors per process
-#define MAX_FD 16 // <<<--- DEFINE MAX_FD HERE (adjust value as needed)
+// Most file descriptors one process can have open; its table grows up to
+// this on demand (see fd_table_t in sys_file.h)
+#define MAX_FD 1024
 
 // Define the size for the kernel stack allocated per process
 // (Must be page-aligned and > 0)
@@ -27,10 +32,39 @@ struct sys_file;
 #define USER_STACK_TOP_VIRT_ADDR (KERNEL_SPACE_VIRT_START)        // Stack grows down from just below kernel space
 #define USER_STACK_BOTTOM_VIRT  (USER_STACK_TOP_VIRT_ADDR - USER_STACK_SIZE) // Lowest valid stack address
 
+// process_waitpid() options
+#define WNOHANG                 1  // Return 0 instead of blocking if no child has exited
+
+// process_spawn() limits and file actions
+#define SPAWN_MAX_ARGS          32   // argv or envp entries, not counting the NULL
+#define SPAWN_ARG_BYTES         2048 // argv and envp strings together, NULs included
+#define SPAWN_MAX_FD_ACTIONS    16
+#define SPAWN_FD_CLOSE          0    // close(fd)
+#define SPAWN_FD_DUP2           1    // dup2(fd, newfd)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/** @brief One file action of a spawn, applied in the child in array order. */
+typedef struct spawn_fd_action {
+    uint32_t op;        // SPAWN_FD_*
+    int32_t  fd;
+    int32_t  newfd;     // SPAWN_FD_DUP2 only
+} spawn_fd_action_t;
+
+/**
+ * @brief Arguments of SYS_SPAWN, passed by pointer (like mmap_args_t) since
+ * the syscall ABI only carries three registers. All fields are user addresses.
+ */
+typedef struct spawn_args {
+    uint32_t path;          // const char *
+    uint32_t argv;          // const char *const *, NULL-terminated; 0 = { path }
+    uint32_t envp;          // const char *const *, NULL-terminated; 0 = empty
+    uint32_t fd_actions;    // const spawn_fd_action_t *
+    uint32_t nr_fd_actions;
+} spawn_args_t;
+
 // Define process states if you use them
 typedef enum {
     PROC_INITIALIZING,
@@ -48,10 +82,17 @@ typedef struct pcb {
     uint32_t entry_point;           // Virtual address of the program's entry point
     void *user_stack_top;           // Virtual address for the initial user ESP setting
 
-    // Per-process file descriptor table
-    struct sys_file *fd_table[MAX_FD]; // MAX_FD is now defined above
+    // Per-process file descriptor table: NULL until the first open, then
+    // grown on demand. Lookups read it without the lock; changes take it.
+    struct fd_table *fdt;
     spinlock_t       fd_table_lock;
 
+    // Batched I/O ring registered with SYS_IO_SETUP (NULL if none; not inherited by fork)
+    struct io_ring  *io_ring;
+
+    // SYS_STRACE ring of recent syscalls (NULL when not tracing; not inherited by fork)
+    struct syscall_trace *strace;
+
     // Kernel Stack Info (Used when process is in kernel mode)
     uint32_t kernel_stack_phys_base; // Physical address of the base frame (for potential debugging/info)
     uint32_t *kernel_stack_vaddr_top; // Virtual address of the top of the kernel stack (highest address + 1)
@@ -63,10 +104,21 @@ typedef struct pcb {
     // Memory Management Info
     struct mm_struct *mm;           // Pointer to the memory structure (VMAs, page dir etc.)
 
+    // Live TCBs running in this process; the last one to be reaped tears it down
+    volatile uint32_t nr_threads;
+
     // Process State & Scheduling Info (Examples - Adapt to your design)
     process_state_t state;          // e.g., PROC_RUNNING, PROC_READY, PROC_SLEEPING - Uncomment if used
     // int priority;
     struct pcb *next;               // For linking in scheduler queues
+
+    // Process tree (guarded by the process tree lock in process.c)
+    uint32_t    ppid;               // Parent PID at fork time, 0 if created by the kernel
+    struct pcb *parent;             // NULL once orphaned; nobody waits for it then
+    struct pcb *children;           // First child, linked through 'sibling'
+    struct pcb *sibling;
+    bool        exited;             // Resources released, PCB kept for the parent's waitpid()
+    uint32_t    exit_code;
     // struct tcb *tcb;              // Link to associated Task Control Block if separate
 
     // === CPU Context ===
@@ -90,6 +142,19 @@ typedef struct pcb {
  */
 pcb_t *create_user_process(const char *path);
 
+/**
+ * @brief create_user_process() with the program's arguments: @p argv and
+ * @p envp (NULL-terminated; NULL = empty) are copied onto the first user
+ * stack page in the System V layout, so _start finds ESP -> argc, followed
+ * by argv[], NULL, envp[], NULL.
+ *
+ * @param err If not NULL, receives the negative errno on failure
+ * (-E2BIG when the arguments don't fit the page).
+ * @return The new PCB (not yet scheduled), or NULL on failure.
+ */
+pcb_t *create_user_process_args(const char *path, const char *const argv[],
+                                const char *const envp[], int *err);
+
 /**
  * @brief Destroys a process and frees all associated resources.
  * Frees memory space (VMAs, page tables, frames), kernel stack, page directory, and PCB.
@@ -99,6 +164,62 @@ pcb_t *create_user_process(const char *path);
  */
 void destroy_process(pcb_t *pcb);
 
+/**
+ * @brief Duplicates the calling process (fork()).
+ * The child shares every user frame copy-on-write, gets copies of the VMAs and
+ * the fd table (open files are shared, not reopened) and is scheduled to
+ * resume from @p frame with EAX = 0.
+ *
+ * @param frame The parent's syscall frame at the top of its kernel stack.
+ * @return The child's PID, or a negative errno on failure.
+ */
+int32_t process_fork(isr_frame_t *frame);
+
+/**
+ * @brief Waits for a child of the calling process to exit and reaps it.
+ *
+ * @param pid Child to wait for, or -1 for any child.
+ * @param status If not NULL, receives the exit status as (code & 0xff) << 8.
+ * @param options 0 or WNOHANG.
+ * @return The reaped child's PID, 0 with WNOHANG if no child has exited yet,
+ * or -ECHILD if there is no such child.
+ */
+int32_t process_waitpid(int32_t pid, int *status, uint32_t options);
+
+/**
+ * @brief Starts @p path as a child of the calling process (posix_spawn()),
+ * without the fork/exec pair: the child gets a fresh address space, a copy
+ * of the caller's fd table with @p actions applied to it in order, and is
+ * scheduled at once. Its exit status is collected with process_waitpid().
+ *
+ * @param argv, envp Kernel copies, NULL-terminated; see create_user_process_args().
+ * @return The child's PID, or a negative errno (the child is not created).
+ */
+int32_t process_spawn(const char *path, const char *const argv[], const char *const envp[],
+                      const spawn_fd_action_t *actions, uint32_t nr_actions);
+
+/**
+ * @brief Starts another thread in the calling process (thread_create()).
+ * The thread shares the address space, fd table and PID, and enters user
+ * mode at @p entry with ESP at @p stack_top holding a zero return address
+ * and @p arg, as if called as entry(arg). exit() ends only the calling
+ * thread; the process exits once its last thread has.
+ *
+ * @param frame The caller's syscall frame; the thread starts from a copy.
+ * @return The new thread's ID (a fresh PID-space number), or a negative errno.
+ */
+int32_t process_thread_create(isr_frame_t *frame, uintptr_t entry, uintptr_t stack_top, uint32_t arg);
+
+/**
+ * @brief Called by the reaper for a task's process once it has exited.
+ * Frees every resource. The PCB itself is kept as a record for the parent's
+ * waitpid() when the parent is still alive, otherwise it is freed too.
+ *
+ * @param pcb The exited process.
+ * @param exit_code The code the task exited with.
+ */
+void process_exit_release(pcb_t *pcb, uint32_t exit_code);
+
 /**
  * @brief Gets the PCB of the currently running process.
  * Relies on the scheduler providing the current task/thread control block.
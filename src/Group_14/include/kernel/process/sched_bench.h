@@ -0,0 +1,44 @@
+#ifndef SCHED_BENCH_H
+#define SCHED_BENCH_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Scheduler stress and latency benchmark on synthetic task mixes.
+ *
+ * Each mix starts groups of kernel threads of one kind and priority:
+ * CPU-bound loops, sleepers (sleep_ms of 1..SCHED_BENCH_SLEEP_MAX_MS) and
+ * yielders (yield() in a loop), runs them for SCHED_BENCH_MS and reports
+ * over serial, one line per mix and one per group:
+ *
+ *   [SchedBench] mix=<name> ms=<n> switches_per_s=<n> late_p50_us=<n> late_p90_us=<n>
+ *                late_p99_us=<n> late_max_us=<n> wake_p50_us=<n> wake_p99_us=<n>
+ *   [SchedBench] mix=<name> group=<kind> prio=<n> tasks=<n> ops_per_s=<n>
+ *                share_pct=<n> ticks_min=<n> ticks_max=<n> jain_permille=<n>
+ *
+ * switches_per_s counts every context switch in the system. late_* is how
+ * long after its deadline a sleeper got to run again, exact per sample;
+ * wake_* is the scheduler's own wakeup-to-run histogram (power-of-two
+ * buckets, so an upper bound). ops are loop iterations, yields or
+ * completed sleeps. share_pct is the group's part of all runtime_ticks of
+ * the mix, jain_permille Jain's fairness index over its tasks' ticks
+ * (1000: all equal).
+ *
+ * Run with the "schedbench" kernel command line flag (every mix) or
+ * "schedbench=<mix>"; it starts with the scheduler and competes with
+ * whatever else runs, so combine it with bench=<program> for quiet runs.
+ */
+
+#define SCHED_BENCH_MS            2000  // Per mix
+#define SCHED_BENCH_SLEEP_MAX_MS  5
+#define SCHED_BENCH_MAX_TASKS     16
+#define SCHED_BENCH_MAX_SAMPLES   4096  // Sleeper lateness samples kept per mix
+
+/**
+ * @brief Creates the benchmark's controller thread; it runs once the
+ * scheduler starts. @p mix names one mix, NULL runs all of them.
+ * @return false if the mix is unknown or the thread could not be created.
+ */
+bool sched_bench_start(const char *mix);
+
+#endif // SCHED_BENCH_H
@@ -3,6 +3,10 @@
 #define SCHEDULER_H
 
 #include <kernel/process/process.h> // Include process header for pcb_t definition
+#include <kernel/drivers/timer/timer_wheel.h>
+#include <kernel/lib/rbtree.h>
+#include <kernel/cpu/fpu.h>
+#include <kernel/cpu/percpu.h>
 #include <libc/stdint.h>
 #include <libc/stdbool.h> // Ensure bool is included
 
@@ -16,6 +20,42 @@ typedef enum {
     TASK_EXITING    // Intermediate state during termination (optional)
 } task_state_e; // Changed name to avoid conflict if task_state_t is used elsewhere
 
+// --- Per-Task Scheduling Statistics ---
+// Latency histograms are log2-bucketed in TSC cycles: bucket N counts samples
+// in [2^N, 2^(N+1)), the last bucket also holds everything larger.
+#define SCHED_HIST_BUCKETS 32
+
+/**
+ * @brief CPU accounting for one task, readable via SYS_SCHED_STATS.
+ * Layout is part of the syscall ABI; append new fields at the end only.
+ */
+typedef struct sched_task_stats {
+    uint32_t pid;
+    uint32_t nr_switches;      // Times this task was switched in
+    uint32_t nr_voluntary;     // Switched out after blocking, sleeping, yielding or exiting
+    uint32_t nr_involuntary;   // Switched out by preemption while still runnable
+    uint32_t nr_wakeups;       // Sleep/block wakeups that were later run
+    uint32_t runtime_ticks;    // Timer ticks charged while running
+    uint64_t run_cycles;       // TSC cycles spent on a CPU
+    uint64_t wait_cycles;      // TSC cycles spent READY in a run queue
+    uint32_t wakeup_hist[SCHED_HIST_BUCKETS]; // Wakeup-to-run latency
+    uint32_t wait_hist[SCHED_HIST_BUCKETS];   // Run queue wait per switch-in
+} sched_task_stats_t;
+
+// --- Priorities (0 = highest) ---
+// Priority levels are tracked in a single 32-bit ready bitmap, so up to 32
+// levels can be selected with one BSF instead of a walk over every queue.
+#ifndef SCHED_PRIORITY_LEVELS
+#define SCHED_PRIORITY_LEVELS   32
+#endif
+#if SCHED_PRIORITY_LEVELS > 32 || SCHED_PRIORITY_LEVELS < 2
+#error "SCHED_PRIORITY_LEVELS must be between 2 and 32 (one ready-bitmap word)"
+#endif
+#define SCHED_DEFAULT_PRIORITY  (SCHED_PRIORITY_LEVELS / 2)
+#define SCHED_IDLE_PRIORITY     (SCHED_PRIORITY_LEVELS - 1)
+#define SCHED_REAPER_PRIORITY   (SCHED_IDLE_PRIORITY - 1) // Runs only when nothing else wants the CPU
+#define SCHED_KERNEL_PRIORITY   0
+
 // --- Enhanced Task Control Block (TCB) ---
 typedef struct tcb {
     // Core Task Info & Links
@@ -25,39 +65,84 @@ typedef struct tcb {
 
     // Execution Context
     uint32_t      *esp;          // Saved kernel stack pointer
+    uint32_t      *kernel_stack_top; // Own kstack_alloc() stack (kthreads, extra user threads); NULL: the process's
+    fpu_state_t   *fpu_state;    // FXSAVE image; NULL until the task first uses the FPU
+    struct perf_task *perf;      // PMU counter slots (perf.h); NULL until the task programs one
 
     // State & Scheduling Parameters
     task_state_e   state;        // Current state
     bool           in_run_queue; // <<< ADDED: True if task is currently in a run queue
     bool           has_run;      // True if task has executed at least once
+    bool           kernel_thread; // Ring-0 only (idle, reaper, kthreads): never enters user mode
     uint8_t        priority;     // Task priority (0=highest)
+    uint8_t        cpu;          // CPU whose run queues own this task
+    volatile bool  on_cpu;       // Switched in and not yet fully switched out (context_switch clears it)
     uint32_t       time_slice_ticks; // Current time slice allocation in ticks
     uint32_t       ticks_remaining; // Ticks left in current time slice
+    uint32_t       preempt_count;   // percpu preempt_count while switched out (preempt.h)
 
     // Statistics & Sleep
     uint32_t       runtime_ticks;  // Total runtime in ticks
+    sched_task_stats_t stats;      // Switch counts, cycles and latency histograms
+    uint64_t       ready_since_tsc; // When the task last became READY
+    uint64_t       run_start_tsc;  // When the task was last switched in
+    bool           woken;          // Became READY through a wakeup, not preemption
+    bool           yielded;        // Next switch-out was requested via yield()
     uint32_t       wakeup_time;    // Absolute tick count when to wake up (if SLEEPING)
+    timer_entry_t  sleep_timer;    // Sleep wheel link (pending while SLEEPING)
+    timer_entry_t  wait_timer;     // Deadline of a timed wait (pending while BLOCKED in one)
+
+    // Fair-share class (SCHED_CLASS_FAIR builds only)
+    uint32_t       vruntime;       // Weighted runtime; compare wrap-safely
+    struct rb_node sched_node;     // Link in the per-CPU vruntime timeline
+
+
     uint32_t       exit_code;      // Exit code when ZOMBIE
 
     // Wait Queue Links (used for BLOCKED state on mutexes, semaphores, etc.)
     struct tcb    *wait_prev;    // Previous in wait list (NULL if first or not waiting)
     struct tcb    *wait_next;    // Next in wait list (NULL if last or not waiting)
     void          *wait_reason;  // Pointer to object being waited on (optional context)
+    uintptr_t      wait_key;     // Tag matched by wake_up_key() (a futex's address)
+    void          *wait_key_space; // Scope of wait_key (a private futex's mm, else NULL)
 
-    // All Tasks List Link
-    struct tcb    *all_tasks_next; // Next TCB in the global list of all tasks
+    // All Tasks List and PID Hash Links
+    struct tcb    *all_tasks_next;  // Next TCB in the global list of all tasks
+    struct tcb   **all_tasks_pprev; // The link pointing at us, for O(1) removal
+    struct tcb    *pid_hash_next;   // Next TCB in our PID hash bucket (idle tasks are not hashed)
 
 } tcb_t;
 
+/** @brief Top of the kernel stack @p task enters the kernel on. */
+static inline uint32_t *task_kernel_stack_top(const tcb_t *task) {
+    return task->kernel_stack_top ? task->kernel_stack_top : task->process->kernel_stack_vaddr_top;
+}
+
 
 // --- Constants ---
 #define IDLE_TASK_PID 0 // Special PID for the idle task
+#define REAPER_TASK_PID 0x7FFFFFFFu // Zombie reaper kernel thread (far above process PIDs)
 
 // --- Public Function Prototypes ---
 
 /** @brief Initializes the scheduler subsystem. */
 void scheduler_init(void);
 
+/**
+ * @brief Brings a CPU's scheduling state online (idle task + run queues).
+ * @param cpu_index Index of the CPU (0..MAX_CPUS-1).
+ * @note The bootstrap CPU is initialized by scheduler_init().
+ */
+void scheduler_init_cpu(uint32_t cpu_index);
+
+/**
+ * @brief Periodic load-balance pass for the calling CPU.
+ * @details Pulls half of the queue-length difference from the busiest CPU
+ * when the imbalance is large enough. Run from scheduler_tick().
+ */
+void scheduler_balance(void);
+
+
 /**
  * @brief Creates a TCB for a given process and adds it to the scheduler.
  * @param pcb Pointer to the Process Control Block to schedule.
@@ -65,6 +150,37 @@ void scheduler_init(void);
  */
 int scheduler_add_task(pcb_t *pcb);
 
+/**
+ * @brief Schedules a child created by process_fork(). pcb->kernel_esp_for_switch
+ * must point at the copied syscall frame at the top of the child's kernel stack;
+ * the child inherits the caller's priority.
+ * @return 0 on success, negative error code on failure.
+ */
+int scheduler_add_forked_task(pcb_t *pcb);
+
+/**
+ * @brief Schedules another thread of @p pcb (see process_thread_create()).
+ * @param kstack_top kstack_alloc() stack, owned by the thread from now on.
+ * @param frame_esp Copied syscall frame at the top of that stack, entered
+ * the way a forked child's is.
+ * @return 0 on success, negative error code on failure.
+ */
+int scheduler_add_thread(pcb_t *pcb, uint32_t tid, uint32_t *kstack_top, uint32_t frame_esp);
+
+/**
+ * @brief Starts a ring-0 thread running @p fn(@p arg) in the kernel address
+ * space.
+ * @details PIDs count down from REAPER_TASK_PID (the reaper is the first).
+ * Returning from @p fn is the same as calling kthread_exit().
+ * @param priority SCHED_*_PRIORITY; SCHED_REAPER_PRIORITY runs only when
+ * the CPU is otherwise idle.
+ * @return The new thread's TCB, or NULL if allocation failed.
+ */
+tcb_t *kthread_create(void (*fn)(void *), void *arg, uint8_t priority);
+
+/** @brief Ends the calling kernel thread; the reaper frees its stack. */
+void kthread_exit(void) __attribute__((noreturn));
+
 /**
  * @brief Core scheduler function. Selects next task, performs context switch.
  * @note Called with interrupts disabled.
@@ -77,7 +193,7 @@ void yield(void);
 /**
  * @brief Puts the current task to sleep for a specified duration.
  * @param ms Duration in milliseconds. Task state becomes SLEEPING.
- * @note The task will be woken up by the scheduler_tick handler.
+ * @note The task is woken up from the tick's SOFTIRQ_SCHED handler.
  */
 void sleep_ms(uint32_t ms);
 
@@ -88,18 +204,51 @@ void sleep_ms(uint32_t ms);
  */
 void remove_current_task_with_code(uint32_t code);
 
-/** @brief Returns a volatile pointer to the currently running task's TCB. */
-volatile tcb_t *get_current_task_volatile(void);
+/**
+ * @brief Returns a volatile pointer to the currently running task's TCB.
+ * @note One %fs-relative load; schedule() keeps the per-CPU copy in step
+ * with the CPU's run-queue state.
+ */
+static inline volatile tcb_t *get_current_task_volatile(void) {
+    return percpu_read(current_task);
+}
 
 /** @brief Returns a non-volatile pointer to the currently running task's TCB. */
-tcb_t *get_current_task(void);
+static inline tcb_t *get_current_task(void) {
+    return percpu_read(current_task);
+}
 
-/** @brief Frees resources associated with ZOMBIE tasks. */
-void scheduler_cleanup_zombies(void);
+/**
+ * @brief Frees every ZOMBIE task handed off to the reaper so far.
+ * @details Zombies are queued by schedule() once their CPU has switched
+ * away from them, so teardown (destroy_process, page tables, frames) runs
+ * in the low-priority reaper thread instead of on the exiting path.
+ * @return Number of tasks freed.
+ */
+uint32_t scheduler_cleanup_zombies(void);
 
 /** @brief Retrieves basic scheduler statistics. */
 void debug_scheduler_stats(uint32_t *out_task_count, uint32_t *out_switches);
 
+/**
+ * @brief Calls @p fn once per process that has an address space, through
+ * its main task, with the task list locked and interrupts off: @p fn must
+ * not sleep or allocate. A process whose main task has exited is skipped.
+ */
+void scheduler_for_each_process(void (*fn)(pcb_t *proc, void *arg), void *arg);
+
+/**
+ * @brief Copies a task's accounting snapshot.
+ * @param pid Task to query; the system-wide totals are returned for
+ * IDLE_TASK_PID (nothing else has that PID once the scheduler runs).
+ * @param out Destination snapshot.
+ * @return 0 on success, -1 if no task has @p pid.
+ */
+int scheduler_get_task_stats(uint32_t pid, sched_task_stats_t *out);
+
+/** @brief Prints per-task and system-wide scheduler statistics to serial. */
+void scheduler_dump_stats(void);
+
 /** @brief Checks if the scheduler is ready for preemptive context switching. */
 bool scheduler_is_ready(void);
 
@@ -107,28 +256,72 @@ bool scheduler_is_ready(void);
 void scheduler_start(void);
 
 /**
- * @brief Scheduler's timer tick routine.
- * @details Called by the timer interrupt handler. Updates ticks, checks
- * sleeping tasks, manages time slices, and triggers preemption.
+ * @brief Enters the scheduler on an application processor.
+ * @details Switches from the AP's boot stack to its idle task. The CPU must
+ * have been brought online with scheduler_init_cpu() and g_scheduler_ready
+ * must already be set by the bootstrap CPU. Does not return.
+ */
+void scheduler_start_cpu(void) __attribute__((noreturn));
+
+/**
+ * @brief Scheduler's timer tick routine (global system clock).
+ * @details Called by the PIT interrupt handler on the bootstrap CPU. Updates
+ * ticks and does the local accounting below; the sleep wheel and other
+ * deferrable work run afterwards in SOFTIRQ_SCHED, with interrupts enabled.
  * @note Must be called with interrupts disabled.
  */
 void scheduler_tick(void);
 
+/**
+ * @brief Per-CPU part of the tick: balancing, time slices and preemption.
+ * @details Called directly by the local APIC timer on application
+ * processors, which do not own the global clock. Preemption is only
+ * flagged (need_resched(), preempt.h); the interrupt exit path does the switch.
+ * @note Must be called with interrupts disabled.
+ */
+void scheduler_tick_local(void);
+
 /**
  * @brief Returns the current system tick count.
  * @return The volatile tick count.
  */
 uint32_t scheduler_get_ticks(void);
 
+/**
+ * @brief Credits ticks that passed while the periodic timer was stopped.
+ * @details Used by the tickless idle path; only advances the clock (no time
+ * slice accounting, since only idle tasks ran in that window).
+ * @note Must be called with interrupts disabled.
+ */
+void scheduler_advance_ticks(uint32_t ticks);
+
+/** @brief Converts milliseconds to scheduler ticks, rounding a nonzero delay up to one tick. */
+uint32_t scheduler_ms_to_ticks(uint32_t ms);
+
+/**
+ * @brief Arms @p entry on the scheduler's tick wheel to fire at entry->expires.
+ * @details The entry must have been set up with timer_entry_init(). Callbacks
+ * run from the global tick with interrupts disabled and must not sleep.
+ */
+void scheduler_timer_add(timer_entry_t *entry);
+
+/**
+ * @brief Disarms a timer added with scheduler_timer_add().
+ * @details If the timer already fired, waits until its callback has returned,
+ * so the entry may be reused or freed afterwards. Never call it from a timer
+ * callback.
+ * @return true if the timer was still pending (its callback will not run).
+ */
+bool scheduler_timer_cancel(timer_entry_t *entry);
+
 
 // --- External Declarations ---
 extern volatile bool g_scheduler_ready;
 
-extern volatile bool g_need_reschedule;
-
 // --- External Assembly Function Prototypes ---
 extern void jump_to_user_mode(uint32_t *kernel_stack_ptr, uint32_t *page_directory_phys);
-extern void context_switch(uint32_t **old_esp_ptr, uint32_t *new_esp, uint32_t *new_page_directory);
+extern void context_switch(uint32_t **old_esp_ptr, uint32_t *new_esp, uint32_t *new_page_directory,
+                           volatile bool *old_on_cpu);
 
 /**
  * @brief Makes a previously blocked task ready and enqueues it.
@@ -137,5 +330,11 @@ extern void context_switch(uint32_t **old_esp_ptr, uint32_t *new_esp, uint32_t *
  */
  void scheduler_unblock_task(tcb_t *task);
 
+/**
+ * @brief Changes a task's priority, moving it between run queues if queued.
+ * @details Used for priority inheritance by sleeping locks. Raises
+ * need_resched() if the task now outranks the one running on this CPU.
+ */
+void scheduler_set_task_priority(tcb_t *task, uint8_t priority);
 
 #endif // SCHEDULER_H
\ No newline at end of file
@@ -0,0 +1,65 @@
+/**
+ * @file vvar.h
+ * @brief Read-only kernel data pages mapped into every user process (vvar).
+ *
+ * Two pages sit at VVAR_BASE_VIRT, below the user stack: the first is one
+ * frame shared by all processes (scheduler tick count and the TSC
+ * calibration), the second is private to the process (its PID). Userspace
+ * reads them directly instead of making a syscall; userspace/lib/vvar.h
+ * mirrors the layouts, which are ABI: append new fields at the end only and
+ * bump VVAR_VERSION.
+ */
+
+#ifndef VVAR_H
+#define VVAR_H
+
+#include <libc/stdint.h>
+
+struct pcb;
+
+#define VVAR_VERSION        1
+#define VVAR_PAGES          2
+#define VVAR_BASE_VIRT      0xBFFF8000u                 // Two pages, then a guard page below the user stack
+#define VVAR_DATA_VIRT      VVAR_BASE_VIRT              // vvar_data_t
+#define VVAR_PROC_VIRT      (VVAR_BASE_VIRT + 0x1000u)  // vvar_proc_t
+
+/** Shared by every process. Only ticks changes after boot. */
+typedef struct vvar_data {
+    uint32_t version;       // VVAR_VERSION
+    volatile uint32_t ticks; // scheduler_get_ticks(): 32-bit, wraps
+    uint32_t tick_hz;       // Ticks per second
+    uint32_t tsc_khz;       // 0 without a TSC: the monotonic clock runs on ticks
+    uint32_t tsc_mult;      // ns = ((tsc - tsc_base) * tsc_mult) >> tsc_shift, as clock_cycles_to_ns()
+    uint32_t tsc_shift;
+    uint64_t tsc_base;      // TSC value at clock time 0
+} vvar_data_t;
+
+/** Private to one process. */
+typedef struct vvar_proc {
+    uint32_t pid;
+    uint32_t ppid;          // At creation; not updated if the parent exits
+} vvar_proc_t;
+
+/**
+ * @brief Allocates the shared page and publishes the clock calibration.
+ * Call once after clock_init(), before the first process is created.
+ */
+void vvar_init(void);
+
+/** @brief Publishes the tick count; called from the scheduler tick. */
+void vvar_update_ticks(uint32_t ticks);
+
+/**
+ * @brief Maps both vvar pages into @p proc (its mm must exist).
+ * @return 0, or a negative errno.
+ */
+int vvar_map_process(struct pcb *proc);
+
+/**
+ * @brief Gives a forked @p child its own private page in place of the
+ * parent's one it inherited from paging_clone_directory().
+ * @return 0, or a negative errno.
+ */
+int vvar_fork_process(struct pcb *child);
+
+#endif /* VVAR_H */
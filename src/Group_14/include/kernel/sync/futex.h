@@ -0,0 +1,42 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <kernel/core/types.h>
+
+/**
+ * @brief Fast userspace mutexes: the kernel half of a lock whose
+ * uncontended path is a plain atomic on a user word.
+ *
+ * Only a contended lock enters the kernel, to sleep on the word
+ * (futex_wait) or to wake its sleepers (futex_wake). A word in a private
+ * mapping is keyed by (mm, address), so it still matches after a COW break
+ * gives it a new frame. A word in a MAP_SHARED mapping is keyed by its
+ * physical address, so processes mapping the same shm page at different
+ * addresses still meet; its frame is pinned while the key is in use.
+ * Wakeups may be spurious, so callers re-check the word.
+ */
+
+#define FUTEX_WAIT 0    // Sleep while *uaddr == val
+#define FUTEX_WAKE 1    // Wake up to val sleepers on uaddr
+
+#define FUTEX_HASH_BITS    6
+#define FUTEX_HASH_BUCKETS (1u << FUTEX_HASH_BITS) // Wait queues shared by all keys
+
+/** @brief Initializes the hash buckets; called once at boot. */
+void futex_init(void);
+
+/**
+ * @brief Sleeps on the user word @p uaddr if it still holds @p val. The
+ * check and the queueing are atomic with respect to futex_wake().
+ * @return 0 once woken (possibly spuriously), -EAGAIN if the word changed,
+ * -EINVAL if unaligned, -EFAULT if it is not readable.
+ */
+int futex_wait(uintptr_t uaddr, uint32_t val);
+
+/**
+ * @brief Wakes up to @p count tasks sleeping on @p uaddr, oldest first.
+ * @return Number of tasks woken, or -EINVAL / -EFAULT as futex_wait().
+ */
+int futex_wake(uintptr_t uaddr, uint32_t count);
+
+#endif // FUTEX_H
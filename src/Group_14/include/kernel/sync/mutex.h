@@ -0,0 +1,51 @@
+#ifndef MUTEX_H
+#define MUTEX_H
+
+#include <kernel/core/types.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/sync/wait_queue.h>
+
+/**
+ * @brief Sleeping mutual-exclusion lock.
+ *
+ * Unlike spinlock_t, contended lockers block on a wait queue with interrupts
+ * enabled, so other tasks keep running while a long section (disk I/O, FAT
+ * chain walks) is held. Must only be taken from task context, never from an
+ * IRQ handler. Before the scheduler runs (early boot) it degrades to a
+ * spinning lock.
+ *
+ * With priority inheritance enabled, a waiter that outranks the owner lends
+ * the owner its priority until the next unlock. Inheritance is one level deep:
+ * the owner's priority is restored to what it had at lock time.
+ */
+typedef struct kmutex {
+    spinlock_t    lock;            // Protects locked/owner/owner_priority
+    bool          locked;
+    tcb_t        *owner;           // Holder (NULL if taken before the scheduler ran)
+    uint8_t       owner_priority;  // Owner's priority when it took the mutex
+    bool          inherit;         // Priority inheritance enabled
+    wait_queue_t  waiters;
+} kmutex_t;
+
+/**
+ * @brief Initializes an unlocked mutex.
+ * @param inherit Enable priority inheritance for this mutex.
+ */
+void kmutex_init(kmutex_t *m, bool inherit);
+
+/** @brief Acquires the mutex, sleeping while another task holds it. */
+void kmutex_lock(kmutex_t *m);
+
+/**
+ * @brief Acquires the mutex only if it is free.
+ * @return true on success.
+ */
+bool kmutex_trylock(kmutex_t *m);
+
+/** @brief Releases the mutex and wakes one waiter. Caller must be the owner. */
+void kmutex_unlock(kmutex_t *m);
+
+/** @brief True if the current task holds @p m. */
+bool kmutex_is_owner(kmutex_t *m);
+
+#endif // MUTEX_H
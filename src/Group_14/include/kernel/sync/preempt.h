@@ -0,0 +1,127 @@
+#ifndef PREEMPT_H
+#define PREEMPT_H
+
+#include <kernel/core/types.h>
+#include <kernel/cpu/percpu.h>
+
+/**
+ * @brief Kernel preemption control.
+ *
+ * Every CPU counts why its current task must not be switched out right
+ * now: held spinlocks and preempt_disable() sections. The count belongs to
+ * the task, not the CPU: schedule() parks it in the tcb and loads the next
+ * task's, so a task that blocks inside a syscall finds its own again.
+ *
+ * Syscalls run with interrupts enabled, so devices and the tick are served
+ * while one is in progress. What a reschedule request does to the syscall
+ * is a compile-time choice (CMake option UIAOS_PREEMPT_FULL):
+ *
+ *  - Voluntary (default): the syscall keeps the CPU until it blocks,
+ *    reaches a cond_resched() point or returns to user mode. The syscall
+ *    itself counts as PREEMPT_SYSCALL_OFFSET, which holds off the
+ *    interrupt exit path but not cond_resched().
+ *  - Full (PREEMPT_FULL=1): the switch also happens on interrupt return to
+ *    kernel mode whenever the count is zero, and when preempt_enable()
+ *    (spinlock release included) brings it back to zero.
+ *
+ * Kernel threads run with a count of zero and are preempted on interrupt
+ * return in both modes. Nothing switches while interrupts are disabled or
+ * softirq handlers run, whatever the count says.
+ */
+
+#ifndef PREEMPT_FULL
+#define PREEMPT_FULL 0
+#endif
+
+#define PREEMPT_LOCK_MASK      0x0000FFFFu // Held spinlocks and preempt_disable() depth
+#define PREEMPT_SYSCALL_OFFSET 0x00010000u // Inside a syscall (voluntary mode only)
+
+#define EFLAGS_IF_BIT          0x200u
+
+/** @brief Switches to another task if one is waiting; see preemptible(). (scheduler.c) */
+void preempt_schedule(void);
+
+/**
+ * @brief A switch was requested on this CPU (a wakeup, an expired slice or
+ * a reschedule IPI). The flag is per CPU: a remote wakeup raises it on its
+ * target through the IPI, never here.
+ */
+static inline bool need_resched(void) {
+    return g_percpu_ready && percpu_read(need_resched) != 0;
+}
+
+static inline void set_need_resched(void) {
+    if (g_percpu_ready) percpu_write(need_resched, 1);
+}
+
+static inline void clear_need_resched(void) {
+    if (g_percpu_ready) percpu_write(need_resched, 0);
+}
+
+static inline uint32_t preempt_count(void) {
+    return percpu_read(preempt_count);
+}
+
+static inline bool irqs_enabled(void) {
+    uintptr_t flags;
+    asm volatile("pushfl; popl %0" : "=r"(flags));
+    return (flags & EFLAGS_IF_BIT) != 0;
+}
+
+/** @brief Nothing on this CPU forbids a switch: no lock, interrupts on, no softirq. */
+static inline bool preemptible(void) {
+    return preempt_count() == 0 && irqs_enabled() && !percpu_read(softirq_active);
+}
+
+/**
+ * @brief Enters a section the current task must not be switched out of.
+ * Before gdt_init() there is no %fs area and only the boot context, so the
+ * count starts once g_percpu_ready is set.
+ */
+static inline void preempt_disable(void) {
+    if (g_percpu_ready) percpu_add(preempt_count, 1);
+    asm volatile("" ::: "memory");
+}
+
+/** @brief Leaves a preempt_disable() section without checking for a switch. */
+static inline void preempt_enable_no_resched(void) {
+    asm volatile("" ::: "memory");
+    if (g_percpu_ready) percpu_add(preempt_count, (uint32_t)-1);
+}
+
+/** @brief Leaves a preempt_disable() section; with PREEMPT_FULL, the last one switches if asked to. */
+static inline void preempt_enable(void) {
+    preempt_enable_no_resched();
+#if PREEMPT_FULL
+    if (need_resched() && preemptible()) preempt_schedule();
+#endif
+}
+
+/**
+ * @brief Voluntary preemption point for long kernel loops: switches if a
+ * reschedule is pending and no lock is held. Free when nothing is pending.
+ */
+static inline void cond_resched(void) {
+    if (need_resched() && (preempt_count() & PREEMPT_LOCK_MASK) == 0 &&
+        irqs_enabled() && !percpu_read(softirq_active)) {
+        preempt_schedule();
+    }
+}
+
+/** @brief Syscall dispatch entry: interrupts on for the handler (syscall.c). */
+static inline void preempt_syscall_enter(void) {
+#if !PREEMPT_FULL
+    percpu_add(preempt_count, PREEMPT_SYSCALL_OFFSET);
+#endif
+    asm volatile("sti" ::: "memory");
+}
+
+/** @brief Syscall dispatch exit: interrupts off again for the return stub. */
+static inline void preempt_syscall_exit(void) {
+    asm volatile("cli" ::: "memory");
+#if !PREEMPT_FULL
+    percpu_add(preempt_count, (uint32_t)-PREEMPT_SYSCALL_OFFSET);
+#endif
+}
+
+#endif // PREEMPT_H
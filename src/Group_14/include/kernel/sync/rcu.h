@@ -0,0 +1,69 @@
+#ifndef RCU_H
+#define RCU_H
+
+#include <kernel/core/types.h>
+#include <kernel/sync/preempt.h>
+
+/**
+ * @brief Quiescent-state-based read-copy-update for read-mostly structures.
+ *
+ * Readers bracket their accesses with rcu_read_lock()/rcu_read_unlock(),
+ * which only hold off preemption: no lock, no locked instruction, nothing
+ * written to shared memory. A read section must not sleep.
+ *
+ * Writers serialize among themselves with their own lock, build the new
+ * version of what they change off to the side, publish it with
+ * rcu_assign_pointer() and free what they unlinked only after
+ * synchronize_rcu(): once every other CPU has passed a quiescent state,
+ * where it cannot be inside a read section. Quiescent states are context
+ * switches (schedule()), ticks that interrupt user mode or kernel code
+ * holding no lock, and running the idle task. On one CPU nothing can be
+ * mid-read while the writer runs, so synchronize_rcu() returns at once.
+ *
+ * x86 keeps stores in order and loads in order, so publishing and
+ * dereferencing only need to stop the compiler from reordering.
+ */
+
+static inline void rcu_read_lock(void) {
+    preempt_disable();
+}
+
+static inline void rcu_read_unlock(void) {
+    preempt_enable();
+}
+
+/** @brief Loads an RCU-protected pointer inside a read section. */
+#define rcu_dereference(p) ({                                             \
+    __typeof__(p) __rcu_p = *(__typeof__(p) volatile *)&(p);              \
+    asm volatile("" ::: "memory");                                        \
+    __rcu_p; })
+
+/** @brief Publishes @p v in @p p once everything written to it before is visible. */
+#define rcu_assign_pointer(p, v) do {                                     \
+    asm volatile("" ::: "memory");                                        \
+    *(__typeof__(p) volatile *)&(p) = (v);                                \
+} while (0)
+
+/** @brief Counts a quiescent state for this CPU (schedule(), scheduler tick). */
+static inline void rcu_note_quiescent(void) {
+    if (g_percpu_ready) percpu_add(rcu_qs, 1);
+}
+
+/**
+ * @brief Tick hook: the interrupted context was quiescent if it held no
+ * lock or read section and was not a softirq handler.
+ */
+static inline void rcu_tick(void) {
+    if ((preempt_count() & PREEMPT_LOCK_MASK) == 0 && !percpu_read(softirq_active)) {
+        rcu_note_quiescent();
+    }
+}
+
+/**
+ * @brief Waits until every read section that may have seen an unlinked
+ * object has ended. Sleeps when the caller may, spins otherwise; must not
+ * be called inside a read section.
+ */
+void synchronize_rcu(void);
+
+#endif // RCU_H
@@ -0,0 +1,42 @@
+#ifndef RWLOCK_H
+#define RWLOCK_H
+
+#include <kernel/core/types.h>
+#include <kernel/sync/spinlock.h> // local_irq_save/local_irq_restore
+
+/**
+ * @brief Reader-writer spinlock for read-mostly data.
+ *
+ * Any number of readers may hold the lock at once; a writer holds it alone.
+ * A waiting writer sets RWLOCK_WRITER_WAITING, which stops new readers from
+ * entering, so a steady stream of readers cannot starve it. Like spinlock_t,
+ * both sides disable local interrupts while held and must not sleep.
+ * Zero-filled storage is a valid unlocked lock.
+ *
+ * Read locks do not nest safely with a waiting writer: a CPU that already
+ * holds the read lock must not take it again.
+ */
+#define RWLOCK_WRITER           0x1u   // Held by a writer
+#define RWLOCK_WRITER_WAITING   0x2u   // A writer is spinning; readers back off
+#define RWLOCK_READER           0x4u   // Increment per reader holding the lock
+
+typedef struct rwlock {
+    volatile uint32_t state;
+} rwlock_t;
+
+/** @brief Initializes @p lock to the unlocked state. */
+void rwlock_init(rwlock_t *lock);
+
+/** @brief Acquires @p lock shared, disabling local interrupts. */
+uintptr_t rwlock_read_acquire_irqsave(rwlock_t *lock);
+
+/** @brief Drops a shared hold and restores the interrupt state. */
+void rwlock_read_release_irqrestore(rwlock_t *lock, uintptr_t flags);
+
+/** @brief Acquires @p lock exclusively, disabling local interrupts. */
+uintptr_t rwlock_write_acquire_irqsave(rwlock_t *lock);
+
+/** @brief Drops an exclusive hold and restores the interrupt state. */
+void rwlock_write_release_irqrestore(rwlock_t *lock, uintptr_t flags);
+
+#endif // RWLOCK_H
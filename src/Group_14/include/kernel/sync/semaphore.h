@@ -0,0 +1,36 @@
+#ifndef SEMAPHORE_H
+#define SEMAPHORE_H
+
+#include <kernel/core/types.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/sync/wait_queue.h>
+
+/**
+ * @brief Counting semaphore whose down() sleeps instead of spinning.
+ *
+ * ksem_up() may be called from IRQ context (e.g. a completion interrupt);
+ * ksem_down() only from task context. Before the scheduler runs, down()
+ * busy-waits instead of sleeping.
+ */
+typedef struct ksemaphore {
+    spinlock_t    lock;     // Protects count
+    int32_t       count;
+    wait_queue_t  waiters;
+} ksemaphore_t;
+
+/** @brief Initializes a semaphore with @p initial available units. */
+void ksem_init(ksemaphore_t *sem, int32_t initial);
+
+/** @brief Takes one unit, sleeping until one is available. */
+void ksem_down(ksemaphore_t *sem);
+
+/**
+ * @brief Takes one unit only if available.
+ * @return true on success.
+ */
+bool ksem_try_down(ksemaphore_t *sem);
+
+/** @brief Returns one unit and wakes one sleeper. IRQ-safe. */
+void ksem_up(ksemaphore_t *sem);
+
+#endif // SEMAPHORE_H
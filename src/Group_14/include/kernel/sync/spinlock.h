@@ -4,13 +4,32 @@
 #include <kernel/core/types.h> // For uintptr_t, bool
 
 /**
- * @brief Basic spinlock structure.
- * Uses a volatile integer as the lock flag.
- * 0 = unlocked, 1 = locked.
+ * @brief FIFO ticket spinlock.
+ *
+ * An acquirer takes the next ticket with one locked XADD and then only reads
+ * the lock until 'owner' reaches its ticket, so CPUs are served in arrival
+ * order and waiters do not keep stealing the cache line with locked writes.
+ * Release is a plain store to 'owner', which only the holder writes.
+ * The lock is unlocked when owner == next, so zero-filled storage is a valid
+ * unlocked lock.
+ *
+ * With SPINLOCK_STATS (CMake option UIAOS_SPINLOCK_STATS) every lock also
+ * counts acquisitions, contended acquisitions, cycles spent spinning and the
+ * longest hold. Locks given a name with spinlock_init_named() are listed by
+ * spinlock_dump_stats().
  */
-typedef struct {
-    volatile uint32_t locked; // Use uint32_t for atomic operations
-    // Optional: Debugging info (owner CPU, etc.) could be added here.
+typedef struct spinlock {
+    volatile uint16_t owner;  // Ticket currently being served
+    volatile uint16_t next;   // Next ticket to hand out
+#if SPINLOCK_STATS
+    const char       *name;
+    uint32_t          acquires;
+    uint32_t          contended;       // Acquisitions that had to wait
+    uint64_t          spin_cycles;     // TSC cycles spent waiting in total
+    uint64_t          max_hold_cycles; // Longest acquire-to-release interval
+    uint64_t          hold_start;
+    struct spinlock  *stats_next;      // Named-lock registry link
+#endif
 } spinlock_t;
 
 /**
@@ -20,6 +39,19 @@ typedef struct {
  */
 void spinlock_init(spinlock_t *lock);
 
+/**
+ * @brief Initializes a long-lived lock and, with SPINLOCK_STATS, registers
+ * it under @p name for spinlock_dump_stats(). Same as spinlock_init()
+ * otherwise. Do not use for locks embedded in objects that get freed.
+ */
+void spinlock_init_named(spinlock_t *lock, const char *name);
+
+/**
+ * @brief Prints the statistics of every named lock to the serial log.
+ * Prints a notice only when SPINLOCK_STATS is off.
+ */
+void spinlock_dump_stats(void);
+
 /**
  * @brief Acquires the spinlock, disabling local interrupts.
  *
@@ -32,6 +64,17 @@ void spinlock_init(spinlock_t *lock);
  */
 uintptr_t spinlock_acquire_irqsave(spinlock_t *lock);
 
+/**
+ * @brief Takes the lock only if it is free right now, disabling local
+ * interrupts on success. For paths that may run with the lock already held
+ * further up the stack (memory reclaim).
+ *
+ * @param lock Pointer to the spinlock_t structure.
+ * @param flags Receives the previous interrupt state on success.
+ * @return true if the lock was taken; interrupts are left as they were otherwise.
+ */
+bool spinlock_try_acquire_irqsave(spinlock_t *lock, uintptr_t *flags);
+
 /**
  * @brief Releases the spinlock and restores the previous interrupt state.
  *
@@ -0,0 +1,112 @@
+#ifndef WAIT_QUEUE_H
+#define WAIT_QUEUE_H
+
+#include <kernel/core/types.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/process/scheduler.h>
+
+/**
+ * @brief FIFO queue of tasks blocked on some condition.
+ *
+ * Waiters are linked through tcb_t.wait_prev/wait_next, and tcb_t.wait_reason
+ * points at the queue while a task is linked, so waiting never allocates.
+ * A wakeup hands the task straight to its run queue; if it outranks the task
+ * currently running, need_resched() is raised so the switch happens on the
+ * way out of the waking IRQ or syscall instead of at the next timer tick.
+ */
+typedef struct wait_queue {
+    tcb_t      *head;
+    tcb_t      *tail;
+    spinlock_t  lock;
+} wait_queue_t;
+
+/** @brief Initializes an empty wait queue. */
+void wait_queue_init(wait_queue_t *wq);
+
+/**
+ * @brief Links the current task onto @p wq and marks it TASK_BLOCKED.
+ * @return Saved interrupt flags; interrupts stay disabled until finish_wait().
+ */
+uintptr_t prepare_to_wait(wait_queue_t *wq);
+
+/**
+ * @brief Undoes prepare_to_wait() after the task ran again or the condition held.
+ * Unlinks the task if no wakeup arrived and restores the saved interrupt flags.
+ */
+void finish_wait(wait_queue_t *wq, uintptr_t flags);
+
+/**
+ * @brief Wakes the longest-waiting task on @p wq.
+ * @return true if a task was woken.
+ */
+bool wake_up_one(wait_queue_t *wq);
+
+/**
+ * @brief Wakes every task on @p wq.
+ * @return Number of tasks woken.
+ */
+uint32_t wake_up_all(wait_queue_t *wq);
+
+/**
+ * @brief Wakes up to @p max tasks on @p wq whose tcb_t.wait_key_space is
+ * @p space and wait_key is @p key, oldest first, for queues shared by
+ * several wait conditions. Waiters set both before prepare_to_wait().
+ * @return Number of tasks woken.
+ */
+uint32_t wake_up_key(wait_queue_t *wq, const void *space, uintptr_t key, uint32_t max);
+
+/**
+ * @brief schedule() for a task queued by prepare_to_wait(), with a deadline.
+ *
+ * If @p deadline (absolute scheduler tick) passes first, the task is taken
+ * off its wait queue and woken anyway. Call it where wait_event() would call
+ * schedule(), with interrupts still disabled.
+ *
+ * @return true once the deadline has passed.
+ */
+bool wait_queue_block_until(uint32_t deadline);
+
+/** @brief True if at least one task is waiting (racy hint, no lock taken). */
+static inline bool wait_queue_active(const wait_queue_t *wq) {
+    return wq->head != NULL;
+}
+
+/**
+ * @brief Blocks the current task until @p condition is true.
+ *
+ * The condition is re-evaluated after the task is queued, so a wakeup that
+ * races with the check is never lost. Wakers must make the condition true
+ * before calling wake_up_one()/wake_up_all(). Must not be used by the idle
+ * task or from interrupt context.
+ */
+#define wait_event(wq, condition)                                   \
+    do {                                                            \
+        for (;;) {                                                  \
+            uintptr_t __wq_flags = prepare_to_wait(wq);             \
+            if (condition) { finish_wait(wq, __wq_flags); break; }  \
+            schedule();                                             \
+            finish_wait(wq, __wq_flags);                            \
+        }                                                           \
+    } while (0)
+
+/**
+ * @brief wait_event() that gives up after @p timeout_ms milliseconds.
+ *
+ * @p timed_out (a bool lvalue) is set to true only if the deadline passed
+ * with the condition still false.
+ */
+#define wait_event_timeout(wq, condition, timeout_ms, timed_out)               \
+    do {                                                                        \
+        uint32_t __wq_deadline = scheduler_get_ticks() +                        \
+                                 scheduler_ms_to_ticks(timeout_ms);             \
+        (timed_out) = false;                                                    \
+        for (;;) {                                                              \
+            uintptr_t __wq_flags = prepare_to_wait(wq);                         \
+            if (condition) { finish_wait(wq, __wq_flags); break; }              \
+            bool __wq_expired = wait_queue_block_until(__wq_deadline);          \
+            finish_wait(wq, __wq_flags);                                        \
+            if (__wq_expired) { (timed_out) = !(condition); break; }            \
+        }                                                                       \
+    } while (0)
+
+#endif // WAIT_QUEUE_H
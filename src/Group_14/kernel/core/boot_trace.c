@@ -0,0 +1,135 @@
+/**
+ * @file boot_trace.c
+ * @brief Boot phase timestamps and the sorted timing report.
+ */
+
+#include <kernel/core/boot_trace.h>
+#include <kernel/cpu/tsc.h>
+#include <kernel/cpu/cpuid.h>
+#include <kernel/lib/div64.h>
+#include <kernel/drivers/timer/clock.h>   // clock_cycles_to_ns
+#include <kernel/drivers/display/serial.h>
+
+#define CPUID_FEATURE_TSC (1u << 4)
+#define BOOT_TRACE_PATH_MAX 96
+
+typedef struct boot_phase {
+    const char *name;
+    uint64_t    start;   // TSC
+    uint64_t    end;     // TSC, 0 while the phase is open
+    int8_t      parent;  // Index of the enclosing phase, -1 at top level
+    uint8_t     depth;
+} boot_phase_t;
+
+static boot_phase_t s_phases[BOOT_TRACE_MAX_PHASES];
+static uint32_t     s_count = 0;
+static int8_t       s_open[BOOT_TRACE_MAX_DEPTH]; // Open phases, innermost last; -1 if not recorded
+static uint32_t     s_depth = 0;
+static uint64_t     s_origin = 0;  // TSC at the first boot_trace_begin()
+static int          s_has_tsc = -1; // Probed on first use
+static bool         s_closed = false;
+
+static uint64_t boot_trace_now(void) {
+    if (s_has_tsc < 0) {
+        uint32_t eax, ebx, ecx, edx;
+        cpuid(1, &eax, &ebx, &ecx, &edx);
+        s_has_tsc = (edx & CPUID_FEATURE_TSC) != 0;
+    }
+    return s_has_tsc ? read_tsc() : 0;
+}
+
+void boot_trace_begin(const char *name) {
+    if (s_closed) return;
+    uint64_t now = boot_trace_now();
+    if (s_count == 0 && s_depth == 0) s_origin = now;
+    if (s_depth >= BOOT_TRACE_MAX_DEPTH) {
+        s_depth++; // Keeps begin/end paired; nothing is recorded this deep
+        return;
+    }
+    int8_t index = -1;
+    if (s_count < BOOT_TRACE_MAX_PHASES) {
+        index = (int8_t)s_count++;
+        boot_phase_t *p = &s_phases[index];
+        p->name = name;
+        p->start = now;
+        p->end = 0;
+        p->parent = s_depth ? s_open[s_depth - 1] : -1;
+        p->depth = (uint8_t)s_depth;
+    }
+    s_open[s_depth++] = index;
+}
+
+void boot_trace_end(void) {
+    if (s_closed || s_depth == 0) return;
+    s_depth--;
+    if (s_depth >= BOOT_TRACE_MAX_DEPTH) return;
+    int8_t index = s_open[s_depth];
+    if (index >= 0) s_phases[index].end = boot_trace_now();
+}
+
+static uint32_t cycles_to_us(uint64_t cycles) {
+    return (uint32_t)div_u64_rem(clock_cycles_to_ns(cycles), NSEC_PER_USEC, NULL);
+}
+
+// "outer > inner" for phase @p index.
+static void phase_path(uint32_t index, char *buf, size_t size) {
+    int8_t chain[BOOT_TRACE_MAX_DEPTH];
+    uint32_t n = 0;
+    for (int8_t i = (int8_t)index; i >= 0 && n < BOOT_TRACE_MAX_DEPTH; i = s_phases[i].parent) chain[n++] = i;
+
+    size_t len = 0;
+    while (n-- > 0 && len + 1 < size) {
+        const char *name = s_phases[chain[n]].name;
+        if (len && len + 3 < size) {
+            buf[len++] = ' '; buf[len++] = '>'; buf[len++] = ' ';
+        }
+        while (*name && len + 1 < size) buf[len++] = *name++;
+    }
+    buf[len] = '\0';
+}
+
+void boot_trace_report(void) {
+    if (s_closed) return;
+    uint64_t now = boot_trace_now();
+    s_closed = true;
+    if (!s_has_tsc || !clock_tsc_active()) {
+        serial_write("[Boot Trace] No calibrated TSC; boot phases were not timed.\n");
+        return;
+    }
+
+    uint32_t total_us = cycles_to_us(now - s_origin);
+    if (total_us == 0) total_us = 1;
+    uint32_t us[BOOT_TRACE_MAX_PHASES];
+    uint8_t order[BOOT_TRACE_MAX_PHASES];
+    uint32_t top_us = 0;
+    for (uint32_t i = 0; i < s_count; i++) {
+        uint64_t end = s_phases[i].end ? s_phases[i].end : now; // Still open: runs to the report
+        us[i] = cycles_to_us(end - s_phases[i].start);
+        if (s_phases[i].depth == 0) top_us += us[i];
+        // Insertion sort, longest first; at most 64 entries
+        uint32_t j = i;
+        while (j > 0 && us[order[j - 1]] < us[i]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = (uint8_t)i;
+    }
+
+    serial_printf("[Boot Trace] %lu phases in %lu.%03lu ms since main(), longest first:\n",
+                  (unsigned long)s_count, (unsigned long)(total_us / 1000), (unsigned long)(total_us % 1000));
+    char path[BOOT_TRACE_PATH_MAX];
+    for (uint32_t k = 0; k < s_count; k++) {
+        uint32_t i = order[k];
+        uint32_t permille = (uint32_t)div_u64_rem((uint64_t)us[i] * 1000, total_us, NULL);
+        phase_path(i, path, sizeof(path));
+        serial_printf("  %6lu.%03lu ms %3lu.%lu%%  %s\n",
+                      (unsigned long)(us[i] / 1000), (unsigned long)(us[i] % 1000),
+                      (unsigned long)(permille / 10), (unsigned long)(permille % 10), path);
+    }
+    uint32_t other_us = (total_us > top_us) ? total_us - top_us : 0;
+    serial_printf("  %6lu.%03lu ms outside any phase\n",
+                  (unsigned long)(other_us / 1000), (unsigned long)(other_us % 1000));
+    if (s_count == BOOT_TRACE_MAX_PHASES) {
+        serial_printf("  (phase table full at %u entries; later phases not recorded)\n", BOOT_TRACE_MAX_PHASES);
+    }
+}
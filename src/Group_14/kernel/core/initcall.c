@@ -0,0 +1,101 @@
+/**
+ * @file initcall.c
+ * @brief Deferred init calls: one runner thread, one worker thread per call.
+ */
+
+#include <kernel/core/initcall.h>
+#include <kernel/process/scheduler.h>     // kthread_create
+#include <kernel/sync/wait_queue.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/lib/div64.h>
+#include <kernel/drivers/timer/clock.h>   // clock_monotonic_ns
+#include <kernel/drivers/display/serial.h>
+
+typedef struct initcall {
+    const char      *name;
+    initcall_fn_t    fn;
+    initcall_level_t level;
+} initcall_t;
+
+// The table is filled before initcall_start() and only read afterwards.
+static initcall_t        s_calls[INITCALL_MAX];
+static uint32_t          s_count = 0;
+static spinlock_t        s_running_lock;
+static volatile uint32_t s_running = 0;     // Workers of the current level still busy (s_running_lock)
+static volatile uint32_t s_levels_done = 0; // Levels below this one have finished
+static wait_queue_t      s_done_wq;         // Woken when a worker or a level finishes
+
+bool initcall_defer(initcall_level_t level, const char *name, initcall_fn_t fn) {
+    if ((uint32_t)level >= INITCALL_LEVEL_COUNT || !fn || s_count >= INITCALL_MAX) return false;
+    s_calls[s_count++] = (initcall_t){ .name = name, .fn = fn, .level = level };
+    return true;
+}
+
+static void initcall_run_one(const initcall_t *call) {
+    uint64_t start = clock_monotonic_ns();
+    call->fn();
+    uint32_t us = (uint32_t)div_u64_rem(clock_monotonic_ns() - start, NSEC_PER_USEC, NULL);
+    serial_printf("[Initcall] %s took %lu.%03lu ms (level %d)\n", call->name,
+                  (unsigned long)(us / 1000), (unsigned long)(us % 1000), (int)call->level);
+}
+
+// Drops one reference to the current level; the last one wakes the runner.
+static void initcall_put_running(void) {
+    uintptr_t flags = spinlock_acquire_irqsave(&s_running_lock);
+    bool last = --s_running == 0;
+    spinlock_release_irqrestore(&s_running_lock, flags);
+    if (last) wake_up_all(&s_done_wq);
+}
+
+static void initcall_worker(void *arg) {
+    initcall_run_one((const initcall_t *)arg);
+    initcall_put_running();
+}
+
+static void initcall_runner(void *arg) {
+    (void)arg;
+    uint64_t start = clock_monotonic_ns();
+    for (uint32_t level = 0; level < INITCALL_LEVEL_COUNT; level++) {
+        // The runner holds one reference while it spawns, so no worker
+        // can see the count reach 0 before the whole level is out
+        s_running = 1;
+        for (uint32_t i = 0; i < s_count; i++) {
+            if (s_calls[i].level != level) continue;
+            uintptr_t flags = spinlock_acquire_irqsave(&s_running_lock);
+            s_running++;
+            spinlock_release_irqrestore(&s_running_lock, flags);
+            if (!kthread_create(initcall_worker, &s_calls[i], SCHED_DEFAULT_PRIORITY)) {
+                initcall_worker(&s_calls[i]); // No thread: run it in line
+            }
+        }
+        initcall_put_running();
+        wait_event(&s_done_wq, s_running == 0);
+        s_levels_done = level + 1;
+        wake_up_all(&s_done_wq);
+    }
+    uint32_t us = (uint32_t)div_u64_rem(clock_monotonic_ns() - start, NSEC_PER_USEC, NULL);
+    serial_printf("[Initcall] %lu deferred calls done in %lu.%03lu ms\n", (unsigned long)s_count,
+                  (unsigned long)(us / 1000), (unsigned long)(us % 1000));
+}
+
+void initcall_start(void) {
+    spinlock_init_named(&s_running_lock, "initcall");
+    wait_queue_init(&s_done_wq);
+    if (kthread_create(initcall_runner, NULL, SCHED_DEFAULT_PRIORITY)) return;
+
+    serial_write("[Initcall] Warning: No runner thread; running deferred calls now.\n");
+    for (uint32_t level = 0; level < INITCALL_LEVEL_COUNT; level++) {
+        for (uint32_t i = 0; i < s_count; i++) {
+            if (s_calls[i].level == level) initcall_run_one(&s_calls[i]);
+        }
+        s_levels_done = level + 1;
+    }
+}
+
+bool initcall_level_done(initcall_level_t level) {
+    return s_levels_done > (uint32_t)level;
+}
+
+void initcall_wait(initcall_level_t level) {
+    wait_event(&s_done_wq, initcall_level_done(level));
+}
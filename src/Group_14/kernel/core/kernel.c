@@ -21,6 +21,7 @@
 #include <kernel/arch/multiboot2.h>
 #include <kernel/core/types.h>
 #include <kernel/lib/string.h>       // Kernel's string functions
+#include <kernel/lib/lib_selftest.h> // lib_selftest_run()
 #include <libc/stdint.h>  // Kernel's fixed-width integers
 #include <libc/stddef.h>  // Kernel's NULL, offsetof
 
@@ -29,22 +30,47 @@
 #include <kernel/cpu/gdt.h>
 #include <kernel/cpu/tss.h>
 #include <kernel/cpu/idt.h>
+#include <kernel/cpu/fpu.h>
+#include <kernel/cpu/perf.h>
+#include <kernel/core/tracepoint.h>
+#include <kernel/cpu/smp.h>
 #include <kernel/memory/paging.h>
 #include <kernel/memory/frame.h>
 #include <kernel/memory/buddy.h>
 #include <kernel/memory/slab.h>
 #include <kernel/memory/percpu_alloc.h> 
 #include <kernel/memory/kmalloc.h>
+#include <kernel/memory/mm.h>           // mm_cache_init()
+#include <kernel/memory/shm.h>          // shm_init()
+#include <kernel/memory/swap.h>         // swap_shrinker_init(), swap_on()
+#include <kernel/process/kstack.h>      // kstack_init()
+#include <kernel/process/proc_snapshot.h> // proc_snapshot_init()
+#include <kernel/memory/alloc_bench.h>  // alloc_bench_run()
+#include <kernel/process/sched_bench.h> // sched_bench_start()
 #include <kernel/process/process.h>
 #include <kernel/process/scheduler.h>
+#include <kernel/process/vvar.h>
+#include <kernel/sync/futex.h>
 #include <kernel/cpu/syscall.h>
 #include <kernel/fs/vfs/vfs.h>
 #include <kernel/fs/vfs/mount.h>
 #include <kernel/fs/vfs/fs_init.h>
 #include <kernel/fs/vfs/fs_errno.h>
+#include <kernel/fs/vfs/fs_limits.h>     // MAX_PATH_LEN
+#include <kernel/fs/vfs/mount_table.h>   // mount_table_find()
+#include <kernel/fs/vfs/sys_file.h>      // O_RDONLY
+#include <kernel/fs/initramfs/initramfs.h>
+#include <kernel/drivers/storage/ramdisk.h>  // ramdisk_create()
 
 // === Drivers ===
+#include <kernel/core/boot_trace.h>
+#include <kernel/core/initcall.h>
 #include <kernel/drivers/timer/pit.h>
+#include <kernel/drivers/timer/timer.h>
+#include <kernel/drivers/timer/hpet.h>
+#include <kernel/drivers/timer/tick.h>
+#include <kernel/drivers/audio/song_player.h>
+#include <kernel/drivers/timer/clock.h>
 #include <kernel/drivers/input/keyboard.h>      // For keyboard_init()
 #include <kernel/drivers/input/keymap.h>        // For keymap_load()
 #include <kernel/drivers/input/keyboard_hw.h>   // For KBC_CMD_*, KBC_SR_* (KBC hardware definitions)
@@ -52,7 +78,9 @@
 
 // === Utilities ===
 #include <kernel/drivers/display/serial.h>         // Essential for early/debug logging
+#include <kernel/drivers/display/fbcon.h>          // fbcon_init()
 #include <kernel/lib/assert.h>         // KERNEL_ASSERT, KERNEL_PANIC_HALT
+#include <kernel/lib/klog.h>           // klog_init
 
 // === Constants ===
 #define KERNEL_VERSION_STRING "4.3.4" // Updated version
@@ -85,6 +113,10 @@ static bool parse_memory_map_for_heap(struct multiboot_tag_mmap *mmap_tag,
                                       uintptr_t *out_total_mem_span,
                                       uintptr_t *out_heap_base, size_t *out_heap_size);
 static bool initialize_memory_management(uint32_t mb_info_phys);
+static bool kernel_cmdline_has_flag(const char *flag);
+static bool kernel_cmdline_get(const char *key, char *buf, size_t size);
+static bool boot_module_range(uintptr_t *start_out, uintptr_t *end_out);
+static void initramfs_handover(void);
 static void launch_program(const char *path_on_disk, const char *program_description);
 
 
@@ -134,6 +166,18 @@ static struct multiboot_tag *find_multiboot_tag_virt(uintptr_t mb_info_virt, uin
 //-----------------------------------------------------------------------------
 // Memory Initialization
 //-----------------------------------------------------------------------------
+/**
+ * @brief Page-aligned physical range of the first Multiboot module (the
+ * initramfs), read before paging through the physical tag walk.
+ */
+static bool boot_module_range(uintptr_t *start_out, uintptr_t *end_out) {
+    struct multiboot_tag_module *tag = (struct multiboot_tag_module *)find_multiboot_tag_phys(g_multiboot_info_phys_addr_global, MULTIBOOT_TAG_TYPE_MODULE);
+    if (!tag || tag->mod_end <= tag->mod_start) return false;
+    *start_out = PAGE_ALIGN_DOWN(tag->mod_start);
+    *end_out = PAGE_ALIGN_UP(tag->mod_end);
+    return true;
+}
+
 #ifndef MIN
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 #endif
@@ -148,6 +192,63 @@ static inline uintptr_t safe_add_base_len(uintptr_t base, uint64_t len) {
     return base + (uintptr_t)len;
 }
 
+/**
+ * @brief True if @p flag is one of the space-separated words on the
+ * Multiboot command line. Needs the info structure mapped (Stage 4.5).
+ */
+static bool kernel_cmdline_has_flag(const char *flag) {
+    struct multiboot_tag_string *tag = (struct multiboot_tag_string *)find_multiboot_tag_virt(g_multiboot_info_virt_addr_global, MULTIBOOT_TAG_TYPE_CMDLINE);
+    if (!tag) return false;
+    size_t flag_len = strlen(flag);
+    const char *p = tag->string;
+    const char *end = (const char *)tag + tag->size;
+    while (p < end && *p) {
+        while (p < end && *p == ' ') p++;
+        const char *word = p;
+        while (p < end && *p && *p != ' ') p++;
+        if ((size_t)(p - word) == flag_len && strncmp(word, flag, flag_len) == 0) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Copies the value of the first "@p key=value" word on the command
+ * line into @p buf. False if there is none or it does not fit.
+ */
+static bool kernel_cmdline_get(const char *key, char *buf, size_t size) {
+    struct multiboot_tag_string *tag = (struct multiboot_tag_string *)find_multiboot_tag_virt(g_multiboot_info_virt_addr_global, MULTIBOOT_TAG_TYPE_CMDLINE);
+    if (!tag || size == 0) return false;
+    size_t key_len = strlen(key);
+    const char *p = tag->string;
+    const char *end = (const char *)tag + tag->size;
+    while (p < end && *p) {
+        while (p < end && *p == ' ') p++;
+        const char *word = p;
+        while (p < end && *p && *p != ' ') p++;
+        size_t len = (size_t)(p - word);
+        if (len <= key_len || word[key_len] != '=' || strncmp(word, key, key_len) != 0) continue;
+        len -= key_len + 1;
+        if (len >= size) return false;
+        memcpy(buf, word + key_len + 1, len);
+        buf[len] = '\0';
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Moves the console to the framebuffer when the bootloader set a
+ * graphics mode (there is no text mode to draw in then). Needs paging.
+ */
+static void console_init_framebuffer(void) {
+    struct multiboot_tag_framebuffer *tag = (struct multiboot_tag_framebuffer *)find_multiboot_tag_virt(g_multiboot_info_virt_addr_global, MULTIBOOT_TAG_TYPE_FRAMEBUFFER);
+    if (!tag || tag->common.framebuffer_type == MULTIBOOT_FRAMEBUFFER_TYPE_EGA_TEXT) return;
+    if (fbcon_init(tag)) {
+        terminal_use_framebuffer();
+        terminal_write("  [OK] Console moved to the framebuffer.\n");
+    }
+}
+
 static bool parse_memory_map_for_heap(struct multiboot_tag_mmap *mmap_tag,
                                       uintptr_t *out_total_mem_span,
                                       uintptr_t *out_heap_base, size_t *out_heap_size)
@@ -160,6 +261,8 @@ static bool parse_memory_map_for_heap(struct multiboot_tag_mmap *mmap_tag,
     uintptr_t mmap_end_addr = (uintptr_t)mmap_tag + mmap_tag->size;
     uintptr_t kernel_phys_start_addr = (uintptr_t)&_kernel_start_phys;
     uintptr_t kernel_phys_end_addr = ALIGN_UP((uintptr_t)&_kernel_end_phys, PAGE_SIZE); 
+    uintptr_t module_start = 0, module_end = 0;
+    bool have_module = boot_module_range(&module_start, &module_end);
 
     terminal_printf("  Kernel Physical Range: [%#010lx - %#010lx)\n", kernel_phys_start_addr, kernel_phys_end_addr);
 
@@ -183,6 +286,18 @@ static bool parse_memory_map_for_heap(struct multiboot_tag_mmap *mmap_tag,
                     current_candidate_len64 = 0;
                 }
             }
+            // The initramfs module stays where Limine put it: keep the larger side of the region around it
+            uintptr_t candidate_end = safe_add_base_len(current_candidate_start, current_candidate_len64);
+            if (have_module && current_candidate_start < module_end && candidate_end > module_start) {
+                uint64_t below = (module_start > current_candidate_start) ? module_start - current_candidate_start : 0;
+                uint64_t above = (candidate_end > module_end) ? candidate_end - module_end : 0;
+                if (above >= below) {
+                    current_candidate_start = module_end;
+                    current_candidate_len64 = above;
+                } else {
+                    current_candidate_len64 = below;
+                }
+            }
             if (current_candidate_len64 >= MIN_USABLE_HEAP_SIZE) {
                 if (current_candidate_len64 > best_candidate_size64) {
                     best_candidate_base = current_candidate_start;
@@ -228,23 +343,29 @@ static bool initialize_memory_management(uint32_t mb_info_phys) {
     terminal_write("  Stage 0: Parsing Multiboot memory map...\n");
     struct multiboot_tag_mmap *mmap_tag_phys = (struct multiboot_tag_mmap *)find_multiboot_tag_phys(mb_info_phys, MULTIBOOT_TAG_TYPE_MMAP);
     if (!mmap_tag_phys) KERNEL_PANIC_HALT("Multiboot MMAP tag not found!");
+    boot_trace_begin("multiboot mmap");
     if (!parse_memory_map_for_heap(mmap_tag_phys, &total_phys_memory_span, &initial_heap_phys_base, &initial_heap_size)) {
         KERNEL_PANIC_HALT("Failed to parse memory map or find suitable heap for buddy allocator!");
     }
+    boot_trace_end();
 
     terminal_write("  Stage 1+2: Initializing Page Directory & Early Maps...\n");
     uintptr_t pd_phys;
+    boot_trace_begin("early paging");
     if (paging_initialize_directory(&pd_phys) != 0) KERNEL_PANIC_HALT("Failed to initialize Page Directory!");
     if (paging_setup_early_maps(pd_phys, kernel_phys_start, (uintptr_t)&_kernel_end_phys, initial_heap_phys_base, initial_heap_size) != 0) {
         KERNEL_PANIC_HALT("Failed to setup early paging maps!");
     }
+    boot_trace_end();
 
     terminal_write("  Stage 3: Initializing Buddy Allocator...\n");
-    buddy_init((void *)initial_heap_phys_base, initial_heap_size); 
+    BOOT_TRACE("buddy_init", buddy_init((void *)initial_heap_phys_base, initial_heap_size));
     terminal_printf("    Buddy Allocator: Initial Free Space: %zu KB\n", buddy_free_space() / 1024);
 
     terminal_write("  Stage 4: Finalizing and Activating Paging...\n");
+    boot_trace_begin("paging activate");
     if (paging_finalize_and_activate(pd_phys, total_phys_memory_span) != 0) KERNEL_PANIC_HALT("Failed to activate paging!");
+    boot_trace_end();
 
     terminal_write("  Stage 4.5: Mapping Multiboot Info to Kernel VAS...\n");
     uintptr_t mb_info_phys_page = PAGE_ALIGN_DOWN(g_multiboot_info_phys_addr_global);
@@ -253,7 +374,8 @@ static bool initialize_memory_management(uint32_t mb_info_phys) {
     size_t mb_pages_to_map = ALIGN_UP(mb_total_struct_size, PAGE_SIZE) / PAGE_SIZE;
     if (mb_pages_to_map == 0 && mb_total_struct_size > 0) mb_pages_to_map = 1;
 
-    if (paging_map_range((uint32_t*)g_kernel_page_directory_phys, mb_info_virt_page, mb_info_phys_page,
+    if (!paging_phys_is_direct(mb_info_phys_page + mb_pages_to_map * PAGE_SIZE - 1) &&
+        paging_map_range((uint32_t*)g_kernel_page_directory_phys, mb_info_virt_page, mb_info_phys_page,
                          mb_pages_to_map * PAGE_SIZE, PTE_KERNEL_READONLY_FLAGS) != 0) { 
         KERNEL_PANIC_HALT("Failed to map Multiboot info structure!");
     }
@@ -264,12 +386,19 @@ static bool initialize_memory_management(uint32_t mb_info_phys) {
     terminal_write("  Stage 6: Initializing Frame Allocator...\n");
     struct multiboot_tag_mmap *mmap_tag_virt = (struct multiboot_tag_mmap *)find_multiboot_tag_virt(g_multiboot_info_virt_addr_global, MULTIBOOT_TAG_TYPE_MMAP);
     if (!mmap_tag_virt) KERNEL_PANIC_HALT("Cannot find MMAP tag via virtual address for Frame Allocator!");
+    boot_trace_begin("frame_init");
     if (frame_init(mmap_tag_virt, kernel_phys_start, kernel_phys_end_aligned, initial_heap_phys_base, initial_heap_phys_base + initial_heap_size) != 0) {
         KERNEL_PANIC_HALT("Frame Allocator initialization failed!");
     }
+    boot_trace_end();
 
     terminal_write("  Stage 7: Initializing Kmalloc...\n");
+    boot_trace_begin("kmalloc");
     kmalloc_init(); 
+    mm_cache_init();
+    swap_shrinker_init(); // First, so that reclaim asks it last
+    slab_shrinker_init();
+    boot_trace_end();
 
     terminal_write("  Stage 8: Initializing Temporary VA Mapper...\n");
     if (paging_temp_map_init() != 0) KERNEL_PANIC_HALT("Failed to initialize temporary VA mapper!");
@@ -280,10 +409,104 @@ static bool initialize_memory_management(uint32_t mb_info_phys) {
 }
 
 
+/**
+ * @brief Gives the initramfs module to its VFS driver through the direct
+ * map. The heap and the early allocator were kept off its frames.
+ */
+static void initramfs_handover(void) {
+    struct multiboot_tag_module *tag = (struct multiboot_tag_module *)find_multiboot_tag_virt(g_multiboot_info_virt_addr_global, MULTIBOOT_TAG_TYPE_MODULE);
+    if (!tag || tag->mod_end <= tag->mod_start) return;
+    if (!paging_phys_is_direct(tag->mod_end - 1)) {
+        terminal_printf("  [WARN] initramfs at %#lx is outside the direct map; ignored.\n", (unsigned long)tag->mod_start);
+        return;
+    }
+    initramfs_set_image(paging_phys_to_virt(tag->mod_start), tag->mod_end - tag->mod_start);
+    terminal_printf("  initramfs module: %lu bytes at phys %#lx\n",
+                    (unsigned long)(tag->mod_end - tag->mod_start), (unsigned long)tag->mod_start);
+}
+
+
+//-----------------------------------------------------------------------------
+// Deferred Keyboard Bring-up
+//-----------------------------------------------------------------------------
+/**
+ * @brief Writes the KBC configuration byte once more and drains the output
+ * buffer, in case the controller was disturbed after keyboard_init().
+ * Runs with interrupts off so the IRQ1 handler doesn't take the bytes.
+ */
+static void kbc_force_config(void) {
+    terminal_write("[Kernel] Re-checking and forcing KBC configuration...\n");
+    
+    uint8_t current_kbc_config_val_before_force = 0;
+    outb(KBC_CMD_PORT, KBC_CMD_READ_CONFIG); 
+    for(volatile int d_wait1=0; d_wait1 < 15000; ++d_wait1) { asm volatile("pause"); } 
+    if (inb(KBC_STATUS_PORT) & KBC_SR_OBF) { 
+      current_kbc_config_val_before_force = inb(KBC_DATA_PORT); 
+    }
+    serial_printf("   Read KBC Config Byte (before final write): 0x%x\n", current_kbc_config_val_before_force);
+
+    uint8_t desired_final_kbc_config = 0x41; 
+    
+    serial_printf("   Forcing KBC Config Byte to 0x%x (Command 0x60)...\n", desired_final_kbc_config);
+    for(volatile int t_cmd=0; (inb(KBC_STATUS_PORT) & KBC_SR_IBF) && t_cmd<100000; ++t_cmd) { asm volatile("pause"); }
+    outb(KBC_CMD_PORT, KBC_CMD_WRITE_CONFIG); 
+
+    for(volatile int t_data=0; (inb(KBC_STATUS_PORT) & KBC_SR_IBF) && t_data<100000; ++t_data) { asm volatile("pause"); }
+    outb(KBC_DATA_PORT, desired_final_kbc_config); 
+    
+    for(volatile int d_kbc=0; d_kbc < 25000; ++d_kbc) { asm volatile("pause");} 
+
+    // *** MODIFIED/ENHANCED FIX: Loop to clear ALL bytes from KBC output buffer after final config write ***
+    int obf_clear_count = 0;
+    uint8_t kbc_status_check_flush;
+    serial_printf("   [KERNEL FIX] Attempting to clear KBC output buffer...\n");
+    while ((kbc_status_check_flush = inb(KBC_STATUS_PORT)) & KBC_SR_OBF) { 
+        uint8_t discarded_byte = inb(KBC_DATA_PORT); 
+        obf_clear_count++;
+        serial_printf("     Cleared byte %d from KBC OBF: 0x%x (status was 0x%x)\n", obf_clear_count, discarded_byte, kbc_status_check_flush);
+        if (obf_clear_count >= KBC_MAX_FLUSH) { 
+            serial_printf("   [KERNEL WARNING] KBC OBF clear loop maxed out at %d reads!\n", KBC_MAX_FLUSH);
+            break;
+        }
+        for(volatile int d_obf_loop=0; d_obf_loop < 5000; ++d_obf_loop) { asm volatile("pause");} 
+    }
+    if (obf_clear_count > 0) {
+        serial_printf("   [KERNEL FIX] Total %d bytes cleared from KBC output buffer.\n", obf_clear_count);
+    } else {
+        serial_printf("   [KERNEL INFO] KBC output buffer was already clear or became clear quickly.\n");
+    }
+    
+    uint8_t final_kbc_status_check = inb(KBC_STATUS_PORT); 
+    serial_printf("   KBC Status register *after* explicit config write AND ROBUST OBF CLEAR: 0x%x\n", final_kbc_status_check);
+}
+
+// Keyboard probing waits on device ACKs; nothing before the first user
+// program needs it, so it runs as a deferred initcall.
+static void keyboard_initcall(void) {
+    keyboard_init();
+    keymap_load(KEYMAP_NORWEGIAN);
+    uintptr_t irq_flags = local_irq_save();
+    kbc_force_config();
+    local_irq_restore(irq_flags);
+}
+
 //-----------------------------------------------------------------------------
 // Initial Process Launch Helper
 //-----------------------------------------------------------------------------
 static void launch_program(const char *path_on_disk, const char *program_description) {
+    // The initramfs copy loads at memory speed; fall back to the disk
+    char initrd_path[MAX_PATH_LEN];
+    if (mount_table_find(INITRAMFS_MOUNT_POINT) &&
+        strlen(INITRAMFS_MOUNT_POINT) + strlen(path_on_disk) < sizeof(initrd_path)) {
+        strcpy(initrd_path, INITRAMFS_MOUNT_POINT);
+        strcat(initrd_path, path_on_disk);
+        file_t *probe = vfs_open(initrd_path, O_RDONLY);
+        if (probe) {
+            vfs_close(probe);
+            path_on_disk = initrd_path;
+        }
+    }
+
     terminal_printf("[Kernel] Attempting to launch %s from '%s'...\n", program_description, path_on_disk);
     pcb_t *proc_pcb = create_user_process(path_on_disk);
 
@@ -306,8 +529,9 @@ static void launch_program(const char *path_on_disk, const char *program_descrip
 void main(uint32_t magic, uint32_t mb_info_phys_addr) {
     g_multiboot_info_phys_addr_global = mb_info_phys_addr; 
 
-    serial_init();    
-    terminal_init();  
+    boot_trace_begin("early boot");
+    BOOT_TRACE("serial_init", serial_init());
+    BOOT_TRACE("terminal_init", terminal_init());
 
     terminal_printf("\n=== UiAOS Kernel Booting (Version: %s) ===\n", KERNEL_VERSION_STRING);
     terminal_printf("[Boot] Author: Tor Martin Kohle\n");
@@ -322,16 +546,70 @@ void main(uint32_t magic, uint32_t mb_info_phys_addr) {
     terminal_printf("  Multiboot magic OK (Info at phys %#lx).\n", (unsigned long)mb_info_phys_addr);
 
     terminal_write("[Kernel] Initializing core systems (pre-interrupts)...\n");
-    gdt_init(); 
-    initialize_memory_management(g_multiboot_info_phys_addr_global); 
-    idt_init();    
-    init_pit();    
-    keyboard_init(); 
-    keymap_load(KEYMAP_NORWEGIAN); 
-    scheduler_init();
+    boot_trace_end();
+    BOOT_TRACE("gdt_init", gdt_init());
+    BOOT_TRACE("memory management", initialize_memory_management(g_multiboot_info_phys_addr_global));
+    BOOT_TRACE("framebuffer console", console_init_framebuffer());
+    BOOT_TRACE("idt_init", idt_init());
+    BOOT_TRACE("fpu_init", fpu_init());
+    BOOT_TRACE("perf_init", perf_init());
+    BOOT_TRACE("timer_init", timer_init());
+    BOOT_TRACE("song_player_init", song_player_init());
+    BOOT_TRACE("init_pit", init_pit());
+    BOOT_TRACE("hpet_init", hpet_init());
+    BOOT_TRACE("clock_init", clock_init());
+    BOOT_TRACE("tick_use_hpet", tick_use_hpet());
+    BOOT_TRACE("vvar_init", vvar_init());
+    BOOT_TRACE("shm_init", shm_init());
+    BOOT_TRACE("kstack_init", kstack_init());
+    BOOT_TRACE("proc_snapshot_init", proc_snapshot_init());
+    BOOT_TRACE("futex_init", futex_init());
+    if (!initcall_defer(INITCALL_LEVEL_DEVICE, "keyboard", keyboard_initcall)) {
+        BOOT_TRACE("keyboard", keyboard_initcall());
+    }
+    BOOT_TRACE("serial_enable_irq", serial_enable_irq());
+    BOOT_TRACE("scheduler_init", scheduler_init());
+    BOOT_TRACE("klog_init", klog_init());
+    BOOT_TRACE("smp_init", smp_init());
+    if (kernel_cmdline_has_flag("trace") && tracepoint_enable(TRACEPOINT_ALL) < 0) {
+        terminal_write("  [WARN] No memory for the tracepoint rings.\n");
+    }
+    if (kernel_cmdline_has_flag("nohuge")) g_mm_huge_pages = false; // 4KB user pages only
+
+    if (lib_selftest_run() != 0) {
+        terminal_write("  [WARN] kernel/lib container self-tests failed (see serial log).\n");
+    }
+
+#if ALLOC_BENCH
+    alloc_bench_run();
+#else
+    if (kernel_cmdline_has_flag("allocbench")) alloc_bench_run();
+#endif
+    // "schedbench" runs every scheduler mix once the scheduler starts, "schedbench=<mix>" one
+    char sched_mix[16];
+    bool sched_bench = kernel_cmdline_get("schedbench", sched_mix, sizeof(sched_mix));
+    if ((sched_bench || kernel_cmdline_has_flag("schedbench")) &&
+        !sched_bench_start(sched_bench ? sched_mix : NULL)) {
+        terminal_write("  [WARN] Scheduler benchmark not started (unknown mix or no thread).\n");
+    }
+
+    // Scratch/benchmark disk, opened as "ram0" through disk_init()
+    if (kernel_cmdline_has_flag("ramdisk") &&
+        ramdisk_create(0, RAMDISK_DEFAULT_SIZE, NULL, 0) != BLOCK_ERR_OK) {
+        terminal_write("  [WARN] Could not create ram0.\n");
+    }
+
+    // Swap area for anonymous memory: "swap=<device>" (see swap.h)
+    char swap_dev[16];
+    if (kernel_cmdline_get("swap", swap_dev, sizeof(swap_dev)) && swap_on(swap_dev) != FS_SUCCESS) {
+        terminal_printf("  [WARN] Could not enable swap on %s.\n", swap_dev);
+    }
+
+    BOOT_TRACE("initramfs_handover", initramfs_handover());
 
     terminal_write("[Kernel] Initializing Filesystem Layer...\n");
-    bool fs_ready = (fs_init() == FS_SUCCESS); 
+    bool fs_ready;
+    BOOT_TRACE("fs_init", fs_ready = (fs_init() == FS_SUCCESS));
     if (fs_ready) {
         terminal_write("  [OK] Filesystem initialized and root mounted.\n");
     } else {
@@ -340,63 +618,25 @@ void main(uint32_t magic, uint32_t mb_info_phys_addr) {
     serial_printf("[Kernel Debug] KBC Status after fs_init(): 0x%08x\n", inb(KBC_STATUS_PORT));
 
 
-    if (fs_ready) {
-        launch_program(INITIAL_TEST_PROGRAM_PATH, "Test Suite");
+    // "bench=<path>" runs that program alone, so nothing competes with it
+    // (scripts/bench_qemu.sh boots the benchmark ISO this way)
+    char bench_path[MAX_PATH_LEN];
+    if (fs_ready && kernel_cmdline_get("bench", bench_path, sizeof(bench_path))) {
+        BOOT_TRACE("launch benchmark", launch_program(bench_path, "Benchmark"));
+    } else if (fs_ready) {
+        BOOT_TRACE("launch test suite", launch_program(INITIAL_TEST_PROGRAM_PATH, "Test Suite"));
         serial_printf("[Kernel Debug] KBC Status after hello.elf launch: 0x%08x\n", inb(KBC_STATUS_PORT));
 
-        launch_program(SYSTEM_SHELL_PATH, "System Shell");
+        BOOT_TRACE("launch shell", launch_program(SYSTEM_SHELL_PATH, "System Shell"));
     } else {
         terminal_write("  [Kernel] Skipping user process launch due to FS init failure.\n");
     }
 
-    // --- Re-check and Force KBC Configuration (with OBF clear) ---
-    terminal_write("[Kernel] Re-checking and forcing KBC configuration before interrupts...\n");
-    
-    uint8_t current_kbc_config_val_before_force = 0;
-    outb(KBC_CMD_PORT, KBC_CMD_READ_CONFIG); 
-    for(volatile int d_wait1=0; d_wait1 < 15000; ++d_wait1) { asm volatile("pause"); } 
-    if (inb(KBC_STATUS_PORT) & KBC_SR_OBF) { 
-      current_kbc_config_val_before_force = inb(KBC_DATA_PORT); 
-    }
-    serial_printf("   Read KBC Config Byte (before final write): 0x%x\n", current_kbc_config_val_before_force);
-
-    uint8_t desired_final_kbc_config = 0x41; 
-    
-    serial_printf("   Forcing KBC Config Byte to 0x%x (Command 0x60)...\n", desired_final_kbc_config);
-    for(volatile int t_cmd=0; (inb(KBC_STATUS_PORT) & KBC_SR_IBF) && t_cmd<100000; ++t_cmd) { asm volatile("pause"); }
-    outb(KBC_CMD_PORT, KBC_CMD_WRITE_CONFIG); 
-
-    for(volatile int t_data=0; (inb(KBC_STATUS_PORT) & KBC_SR_IBF) && t_data<100000; ++t_data) { asm volatile("pause"); }
-    outb(KBC_DATA_PORT, desired_final_kbc_config); 
-    
-    for(volatile int d_kbc=0; d_kbc < 25000; ++d_kbc) { asm volatile("pause");} 
-
-    // *** MODIFIED/ENHANCED FIX: Loop to clear ALL bytes from KBC output buffer after final config write ***
-    int obf_clear_count = 0;
-    uint8_t kbc_status_check_flush;
-    serial_printf("   [KERNEL FIX] Attempting to clear KBC output buffer...\n");
-    while ((kbc_status_check_flush = inb(KBC_STATUS_PORT)) & KBC_SR_OBF) { 
-        uint8_t discarded_byte = inb(KBC_DATA_PORT); 
-        obf_clear_count++;
-        serial_printf("     Cleared byte %d from KBC OBF: 0x%x (status was 0x%x)\n", obf_clear_count, discarded_byte, kbc_status_check_flush);
-        if (obf_clear_count >= KBC_MAX_FLUSH) { 
-            serial_printf("   [KERNEL WARNING] KBC OBF clear loop maxed out at %d reads!\n", KBC_MAX_FLUSH);
-            break;
-        }
-        for(volatile int d_obf_loop=0; d_obf_loop < 5000; ++d_obf_loop) { asm volatile("pause");} 
-    }
-    if (obf_clear_count > 0) {
-        serial_printf("   [KERNEL FIX] Total %d bytes cleared from KBC output buffer.\n", obf_clear_count);
-    } else {
-        serial_printf("   [KERNEL INFO] KBC output buffer was already clear or became clear quickly.\n");
-    }
-    
-    uint8_t final_kbc_status_check = inb(KBC_STATUS_PORT); 
-    serial_printf("   KBC Status register *after* explicit config write AND ROBUST OBF CLEAR: 0x%x\n", final_kbc_status_check);
-    // --- End KBC Re-check ---
 
     terminal_write("[Kernel] Finalizing setup and enabling interrupts...\n");
-    syscall_init();    
+    BOOT_TRACE("syscall_init", syscall_init());
+    initcall_start();
+    boot_trace_report();
 
     terminal_printf("\n[Kernel] Initialization complete. UiAOS %s operational. Enabling interrupts.\n", KERNEL_VERSION_STRING);
     terminal_write("================================================================================\n\n");
@@ -408,8 +648,9 @@ void main(uint32_t magic, uint32_t mb_info_phys_addr) {
         "mov $0x10, %%ax\n"
         "mov %%ax, %%ds\n"
         "mov %%ax, %%es\n"
-        "mov %%ax, %%fs\n"
         "mov %%ax, %%gs\n"
+        "mov $0x30, %%ax\n"     // GDT_PERCPU_SELECTOR
+        "mov %%ax, %%fs\n"
         : : : "ax"
     );
 
@@ -0,0 +1,152 @@
+/**
+ * @file profiler.c
+ * @brief Per-CPU sample rings filled from the timer tick.
+ */
+
+#include <kernel/core/profiler.h>
+#include <kernel/cpu/get_cpu_id.h>
+#include <kernel/process/scheduler.h>     // get_current_task
+#include <kernel/memory/kmalloc.h>
+#include <kernel/memory/uaccess.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/fs/vfs/fs_errno.h>
+#include <kernel/drivers/display/serial.h>
+
+#define PROFILE_RING_MASK  (PROFILE_RING_SAMPLES - 1)
+#define PROFILE_CHUNK      32 // Samples taken per lock hold when reading
+
+typedef struct profile_ring {
+    spinlock_t       lock;
+    uint32_t         head;  // Samples ever written
+    uint32_t         tail;  // Samples ever taken or lost
+    uint32_t         lost;  // Overwritten before they were taken
+    profile_sample_t samples[PROFILE_RING_SAMPLES];
+} profile_ring_t;
+
+// Allocated by the first profile_start() and kept, so a stopped profile can still be read
+static profile_ring_t   *s_rings[MAX_CPUS];
+static volatile uint32_t s_period = 0;        // 0 while stopped
+static uint32_t          s_countdown[MAX_CPUS]; // Ticks to the next sample; own CPU only
+
+void profile_tick(const isr_frame_t *frame) {
+    uint32_t period = s_period;
+    if (!period) return;
+    int cpu = get_cpu_id();
+    profile_ring_t *ring = s_rings[cpu];
+    if (!ring || ++s_countdown[cpu] < period) return;
+    s_countdown[cpu] = 0;
+
+    tcb_t *task = get_current_task();
+    uintptr_t flags = spinlock_acquire_irqsave(&ring->lock);
+    profile_sample_t *s = &ring->samples[ring->head & PROFILE_RING_MASK];
+    s->eip = frame->eip;
+    s->pid = task ? task->pid : 0;
+    s->cpu = (uint8_t)cpu;
+    s->cpl = (uint8_t)(frame->cs & 3);
+    s->reserved = 0;
+    if (++ring->head - ring->tail > PROFILE_RING_SAMPLES) {
+        ring->tail++;
+        ring->lost++;
+    }
+    spinlock_release_irqrestore(&ring->lock, flags);
+}
+
+// Moves up to @p max of @p ring's oldest samples to @p out.
+static uint32_t ring_take(profile_ring_t *ring, profile_sample_t *out, uint32_t max) {
+    uintptr_t flags = spinlock_acquire_irqsave(&ring->lock);
+    uint32_t n = ring->head - ring->tail;
+    if (n > max) n = max;
+    for (uint32_t i = 0; i < n; i++) out[i] = ring->samples[(ring->tail + i) & PROFILE_RING_MASK];
+    ring->tail += n;
+    spinlock_release_irqrestore(&ring->lock, flags);
+    return n;
+}
+
+int32_t profile_start(uint32_t period) {
+    if (period == 0) return -EINVAL;
+    s_period = 0;
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        profile_ring_t *ring = s_rings[cpu];
+        if (!ring) {
+            ring = kmalloc(sizeof(*ring));
+            if (!ring) return -ENOMEM;
+            spinlock_init_named(&ring->lock, "profile");
+            ring->head = ring->tail = 0;
+            s_rings[cpu] = ring;
+        }
+        uintptr_t flags = spinlock_acquire_irqsave(&ring->lock);
+        ring->tail = ring->head;
+        ring->lost = 0;
+        spinlock_release_irqrestore(&ring->lock, flags);
+        s_countdown[cpu] = 0;
+    }
+    s_period = period;
+    serial_printf("[Profile] Sampling every %lu ticks\n", (unsigned long)period);
+    return 0;
+}
+
+void profile_stop(void) {
+    s_period = 0;
+}
+
+void profile_dump(void) {
+    uint32_t total = 0, lost = 0;
+    profile_sample_t chunk[PROFILE_CHUNK];
+    serial_printf("[Profile] Dump begin, period %lu (S cpu pid cpl eip)\n", (unsigned long)s_period);
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        profile_ring_t *ring = s_rings[cpu];
+        if (!ring) continue;
+        uint32_t n;
+        while ((n = ring_take(ring, chunk, PROFILE_CHUNK)) != 0) {
+            for (uint32_t i = 0; i < n; i++) {
+                serial_printf("[Profile] S %u %lu %u %08lx\n", chunk[i].cpu, (unsigned long)chunk[i].pid,
+                              chunk[i].cpl, (unsigned long)chunk[i].eip);
+            }
+            total += n;
+        }
+        lost += ring->lost;
+    }
+    serial_printf("[Profile] Dump end, %lu samples, %lu lost\n", (unsigned long)total, (unsigned long)lost);
+}
+
+// PROFILE_READ: fills the user buffer CPU by CPU, a chunk at a time, without
+// holding a ring lock across the copy.
+static int32_t profile_read(userptr_t buf, uint32_t size) {
+    uint32_t room = size / sizeof(profile_sample_t);
+    if (room == 0) return 0;
+    if (!access_ok(VERIFY_WRITE, buf, room * sizeof(profile_sample_t))) return -EFAULT;
+    profile_sample_t chunk[PROFILE_CHUNK];
+    uint32_t done = 0;
+    for (int cpu = 0; cpu < MAX_CPUS && done < room; cpu++) {
+        profile_ring_t *ring = s_rings[cpu];
+        if (!ring) continue;
+        while (done < room) {
+            uint32_t want = room - done;
+            uint32_t n = ring_take(ring, chunk, want < PROFILE_CHUNK ? want : PROFILE_CHUNK);
+            if (n == 0) break;
+            if (__copy_to_user((userptr_t)((profile_sample_t *)buf + done), (const_kernelptr_t)chunk,
+                               n * sizeof(profile_sample_t)) != 0) {
+                return done ? (int32_t)(done * sizeof(profile_sample_t)) : -EFAULT;
+            }
+            done += n;
+        }
+    }
+    return (int32_t)(done * sizeof(profile_sample_t));
+}
+
+int32_t profile_ctl(uint32_t op, uint32_t arg2, uint32_t arg3) {
+    switch (op) {
+    case PROFILE_START:
+        return profile_start(arg2);
+    case PROFILE_STOP:
+        profile_stop();
+        return 0;
+    case PROFILE_READ:
+        return profile_read((userptr_t)arg2, arg3);
+    case PROFILE_DUMP:
+        profile_dump();
+        return 0;
+    default:
+        return -EINVAL;
+    }
+}
@@ -0,0 +1,210 @@
+/**
+ * @file tracepoint.c
+ * @brief Per-CPU tracepoint rings and their Chrome trace JSON export.
+ */
+
+#include <kernel/core/tracepoint.h>
+#include <kernel/cpu/get_cpu_id.h>
+#include <kernel/cpu/tsc.h>
+#include <kernel/process/scheduler.h>     // get_current_task
+#include <kernel/memory/kmalloc.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/fs/vfs/fs_errno.h>
+#include <kernel/lib/div64.h>
+#include <kernel/drivers/timer/clock.h>   // clock_tsc_active, clock_cycles_to_ns
+#include <kernel/drivers/display/serial.h>
+
+#define TRACE_RING_MASK (TRACEPOINT_RING_RECORDS - 1)
+
+typedef struct trace_rec {
+    uint64_t ts;        // TSC cycles or ns, see s_ts_is_tsc
+    uint32_t a, b;
+    uint32_t pid;
+    uint8_t  id;
+    uint8_t  cpu;
+    uint16_t reserved;
+} trace_rec_t;
+
+typedef struct trace_ring {
+    spinlock_t  lock;
+    uint32_t    head;   // Records ever written
+    uint32_t    tail;   // Records ever dumped or lost
+    uint32_t    lost;   // Overwritten before a dump
+    trace_rec_t recs[TRACEPOINT_RING_RECORDS];
+} trace_ring_t;
+
+typedef struct tp_desc {
+    const char *name;   // Begin/end pairs share a name
+    const char *cat;
+    char        phase;  // Chrome trace phase: 'i' instant, 'b'/'e' async begin/end
+    const char *arg_a;  // Argument names; NULL: not shown
+    const char *arg_b;
+} tp_desc_t;
+
+static const tp_desc_t s_desc[TP_COUNT] = {
+    [TP_SCHED_SWITCH]   = { "sched_switch", "sched", 'i', "prev_pid", "next_pid" },
+    [TP_SCHED_WAKEUP]   = { "sched_wakeup", "sched", 'i', "pid",      NULL },
+    [TP_PAGE_FAULT]     = { "page_fault",   "mm",    'i', "addr",     "error" },
+    [TP_BUFFER_HIT]     = { "buffer_hit",   "cache", 'i', "lba",      NULL },
+    [TP_BUFFER_MISS]    = { "buffer_miss",  "cache", 'i', "lba",      NULL },
+    [TP_BLOCK_SUBMIT]   = { "block_io",     "block", 'b', "lba",      "sectors" },
+    [TP_BLOCK_COMPLETE] = { "block_io",     "block", 'e', "lba",      "status" },
+    [TP_FAT_ALLOC]      = { "fat_alloc",    "fat",   'i', "cluster",  "count" },
+    [TP_VFS_OPEN]       = { "vfs_open",     "vfs",   'b', NULL,       NULL },
+    [TP_VFS_OPEN_DONE]  = { "vfs_open",     "vfs",   'e', "ok",       NULL },
+};
+
+volatile uint32_t g_tracepoint_mask = 0;
+static trace_ring_t *s_rings[MAX_CPUS];  // Allocated by the first enable and kept
+static bool          s_ts_is_tsc = false;
+
+void tracepoint_record(tracepoint_id_t id, uint32_t a, uint32_t b) {
+    uintptr_t irq_flags = local_irq_save();
+    int cpu = get_cpu_id();
+    trace_ring_t *ring = s_rings[cpu];
+    if (ring) {
+        tcb_t *task = get_current_task();
+        spinlock_acquire_irqsave(&ring->lock);
+        trace_rec_t *r = &ring->recs[ring->head & TRACE_RING_MASK];
+        r->ts = s_ts_is_tsc ? read_tsc() : clock_monotonic_ns();
+        r->a = a;
+        r->b = b;
+        r->pid = task ? task->pid : 0;
+        r->id = (uint8_t)id;
+        r->cpu = (uint8_t)cpu;
+        r->reserved = 0;
+        if (++ring->head - ring->tail > TRACEPOINT_RING_RECORDS) {
+            ring->tail++;
+            ring->lost++;
+        }
+        spinlock_release_irqrestore(&ring->lock, irq_flags);
+        return;
+    }
+    local_irq_restore(irq_flags);
+}
+
+int32_t tracepoint_enable(uint32_t mask) {
+    mask &= TRACEPOINT_ALL;
+    uint32_t old = g_tracepoint_mask;
+    if (mask) {
+        for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+            if (s_rings[cpu]) continue;
+            trace_ring_t *ring = kmalloc(sizeof(*ring));
+            if (!ring) return -ENOMEM;
+            spinlock_init_named(&ring->lock, "tracepoint");
+            ring->head = ring->tail = ring->lost = 0;
+            if (cpu == 0) s_ts_is_tsc = clock_tsc_active(); // Fixed for the lifetime of the rings
+            s_rings[cpu] = ring;
+        }
+        asm volatile("" ::: "memory"); // Rings in place before any tracepoint fires
+    }
+    g_tracepoint_mask = mask;
+    return (int32_t)old;
+}
+
+static bool ring_take(trace_ring_t *ring, trace_rec_t *out) {
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&ring->lock);
+    bool have = ring->head != ring->tail;
+    if (have) *out = ring->recs[ring->tail++ & TRACE_RING_MASK];
+    spinlock_release_irqrestore(&ring->lock, irq_flags);
+    return have;
+}
+
+// Copies the printable bytes of @p word, low byte first, for a vfs_open name.
+static void unpack_name(uint32_t word, char *out) {
+    for (int i = 0; i < 4; i++) {
+        char c = (char)(word >> (8 * i));
+        out[i] = (c == '"' || c == '\\' || (c != 0 && (c < ' ' || c > '~'))) ? '?' : c;
+    }
+}
+
+static void print_record(const trace_rec_t *r, uint64_t origin) {
+    const tp_desc_t *d = &s_desc[r->id];
+    uint64_t delta = r->ts - origin;
+    uint32_t ns_rem;
+    uint32_t us = (uint32_t)div_u64_rem(s_ts_is_tsc ? clock_cycles_to_ns(delta) : delta, NSEC_PER_USEC, &ns_rem);
+
+    serial_printf(",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%lu.%03lu,\"pid\":0,\"tid\":%u",
+                  d->name, d->cat, d->phase, (unsigned long)us, (unsigned long)ns_rem, r->cpu);
+    if (d->phase == 'i') {
+        serial_write(",\"s\":\"t\"");
+    } else {
+        // Blocks pair up by LBA, opens by the task that is opening
+        uint32_t id = (r->id == TP_BLOCK_SUBMIT || r->id == TP_BLOCK_COMPLETE) ? r->a : r->pid;
+        serial_printf(",\"id\":\"%#lx\"", (unsigned long)id);
+    }
+    serial_printf(",\"args\":{\"task\":%lu", (unsigned long)r->pid);
+    if (r->id == TP_VFS_OPEN) {
+        char name[9] = { 0 };
+        unpack_name(r->a, name);
+        unpack_name(r->b, name + 4);
+        serial_printf(",\"name\":\"%s\"", name);
+    } else if (r->id == TP_PAGE_FAULT) {
+        serial_printf(",\"addr\":\"%#lx\",\"error\":%lu", (unsigned long)r->a, (unsigned long)r->b);
+    } else if (r->id == TP_BLOCK_SUBMIT) {
+        serial_printf(",\"lba\":%lu,\"sectors\":%lu,\"write\":%u", (unsigned long)r->a,
+                      (unsigned long)(r->b & ~TP_BLOCK_WRITE), (r->b & TP_BLOCK_WRITE) ? 1 : 0);
+    } else {
+        if (d->arg_a) serial_printf(",\"%s\":%lu", d->arg_a, (unsigned long)r->a);
+        if (d->arg_b) serial_printf(",\"%s\":%ld", d->arg_b, (long)r->b);
+    }
+    serial_write("}}");
+}
+
+void tracepoint_dump(void) {
+    // The dump's own activity stays out of the trace; other CPUs pause too
+    uint32_t mask = g_tracepoint_mask;
+    g_tracepoint_mask = 0;
+
+    trace_rec_t next[MAX_CPUS];
+    bool have[MAX_CPUS];
+    uint32_t lost = 0;
+    bool any = false;
+    uint64_t origin = 0;
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        have[cpu] = s_rings[cpu] && ring_take(s_rings[cpu], &next[cpu]);
+        if (have[cpu] && (!any || next[cpu].ts < origin)) origin = next[cpu].ts;
+        any |= have[cpu];
+        if (s_rings[cpu]) lost += s_rings[cpu]->lost;
+    }
+
+    serial_write("[Trace] JSON begin\n");
+    serial_write("[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"UiAOS kernel\"}}");
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (!s_rings[cpu]) continue;
+        serial_printf(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"CPU %d\"}}",
+                      cpu, cpu);
+    }
+
+    // Merge the per-CPU rings, oldest record first
+    uint32_t printed = 0;
+    for (;;) {
+        int best = -1;
+        for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+            if (have[cpu] && (best < 0 || next[cpu].ts < next[best].ts)) best = cpu;
+        }
+        if (best < 0) break;
+        print_record(&next[best], origin);
+        printed++;
+        have[best] = ring_take(s_rings[best], &next[best]);
+    }
+    serial_write("]\n");
+    serial_printf("[Trace] JSON end, %lu records, %lu lost\n", (unsigned long)printed, (unsigned long)lost);
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (s_rings[cpu]) s_rings[cpu]->lost = 0;
+    }
+    g_tracepoint_mask = mask;
+}
+
+int32_t tracepoint_ctl(uint32_t op, uint32_t arg2, uint32_t arg3) {
+    (void)arg3;
+    switch (op) {
+    case TRACEPOINT_ENABLE:
+        return tracepoint_enable(arg2);
+    case TRACEPOINT_DUMP:
+        tracepoint_dump();
+        return 0;
+    default:
+        return -EINVAL;
+    }
+}
@@ -0,0 +1,268 @@
+/**
+ * @file acpi.c
+ * @brief RSDP/RSDT/MADT parsing for CPU and I/O APIC discovery, plus the HPET table.
+ */
+
+#include <kernel/cpu/acpi.h>
+#include <kernel/memory/paging.h>
+#include <kernel/lib/string.h>
+#include <kernel/drivers/display/serial.h>
+
+#define ACPI_INFO(fmt, ...)  serial_printf("[ACPI INFO ] " fmt "\n", ##__VA_ARGS__)
+#define ACPI_ERROR(fmt, ...) serial_printf("[ACPI ERROR] %s:%d: " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
+
+#define ACPI_EBDA_SEGMENT_PTR   0x40E      // BDA word holding the EBDA segment
+#define ACPI_EBDA_SEARCH_LEN    1024
+#define ACPI_BIOS_AREA_START    0xE0000
+#define ACPI_BIOS_AREA_END      0x100000
+
+#define MADT_FLAG_PCAT_COMPAT   (1u << 0)
+#define MADT_CPU_ENABLED        (1u << 0)
+
+#define MADT_ENTRY_LAPIC        0
+#define MADT_ENTRY_IOAPIC       1
+#define MADT_ENTRY_ISO          2
+#define MADT_ENTRY_LAPIC_ADDR   5
+
+typedef struct __attribute__((packed)) {
+    char      signature[8];     // "RSD PTR "
+    uint8_t   checksum;
+    char      oem_id[6];
+    uint8_t   revision;
+    uint32_t  rsdt_address;
+} acpi_rsdp_t;
+
+typedef struct __attribute__((packed)) {
+    char      signature[4];
+    uint32_t  length;
+    uint8_t   revision;
+    uint8_t   checksum;
+    char      oem_id[6];
+    char      oem_table_id[8];
+    uint32_t  oem_revision;
+    uint32_t  creator_id;
+    uint32_t  creator_revision;
+} acpi_sdt_header_t;
+
+typedef struct __attribute__((packed)) {
+    acpi_sdt_header_t header;
+    uint32_t  lapic_address;
+    uint32_t  flags;
+} acpi_madt_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t   type;
+    uint8_t   length;
+} madt_entry_header_t;
+
+typedef struct __attribute__((packed)) {
+    madt_entry_header_t h;
+    uint8_t   acpi_processor_id;
+    uint8_t   apic_id;
+    uint32_t  flags;
+} madt_lapic_t;
+
+typedef struct __attribute__((packed)) {
+    madt_entry_header_t h;
+    uint8_t   ioapic_id;
+    uint8_t   reserved;
+    uint32_t  ioapic_address;
+    uint32_t  gsi_base;
+} madt_ioapic_t;
+
+typedef struct __attribute__((packed)) {
+    madt_entry_header_t h;
+    uint8_t   bus;
+    uint8_t   source_irq;
+    uint32_t  gsi;
+    uint16_t  flags;
+} madt_iso_t;
+
+typedef struct __attribute__((packed)) {
+    madt_entry_header_t h;
+    uint16_t  reserved;
+    uint64_t  lapic_address;
+} madt_lapic_addr_t;
+
+// "HPET" table (the base address is a Generic Address Structure)
+typedef struct __attribute__((packed)) {
+    acpi_sdt_header_t header;
+    uint32_t  event_timer_block_id;
+    uint8_t   address_space_id;   // 0 = system memory
+    uint8_t   register_bit_width;
+    uint8_t   register_bit_offset;
+    uint8_t   access_size;
+    uint64_t  base_address;
+    uint8_t   hpet_number;
+    uint16_t  min_clock_tick;
+    uint8_t   page_protection;
+} acpi_hpet_t;
+
+static acpi_madt_info_t s_madt;
+static uint32_t s_hpet_phys = 0;
+static bool s_acpi_probed = false;
+
+//============================================================================
+// Helpers
+//============================================================================
+static bool acpi_checksum_ok(const void *data, uint32_t length) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++) sum += bytes[i];
+    return sum == 0;
+}
+
+static const acpi_rsdp_t *acpi_scan_rsdp(uintptr_t start, uintptr_t end) {
+    for (uintptr_t p = start; p + sizeof(acpi_rsdp_t) <= end; p += 16) {
+        const acpi_rsdp_t *rsdp = (const acpi_rsdp_t *)p;
+        if (memcmp(rsdp->signature, "RSD PTR ", 8) == 0 && acpi_checksum_ok(rsdp, sizeof(acpi_rsdp_t))) {
+            return rsdp;
+        }
+    }
+    return NULL;
+}
+
+/** @brief The BIOS areas live in the identity-mapped first megabyte. */
+static const acpi_rsdp_t *acpi_find_rsdp(void) {
+    // A plain dereference of a constant this low trips GCC's null-page bounds check
+    uint16_t ebda_seg;
+    asm volatile("movw (%1), %0" : "=r"(ebda_seg) : "r"((uintptr_t)ACPI_EBDA_SEGMENT_PTR) : "memory");
+    uintptr_t ebda = (uintptr_t)ebda_seg << 4;
+    if (ebda >= 0x80000 && ebda < 0xA0000) {
+        const acpi_rsdp_t *rsdp = acpi_scan_rsdp(ebda, ebda + ACPI_EBDA_SEARCH_LEN);
+        if (rsdp) return rsdp;
+    }
+    return acpi_scan_rsdp(ACPI_BIOS_AREA_START, ACPI_BIOS_AREA_END);
+}
+
+/**
+ * @brief Maps a whole system description table through the MMIO window and
+ * validates its checksum. Tables usually sit at the top of RAM, well outside
+ * the identity-mapped low region.
+ */
+static const acpi_sdt_header_t *acpi_map_table(uint32_t phys) {
+    const acpi_sdt_header_t *hdr = (const acpi_sdt_header_t *)paging_map_mmio(phys, sizeof(acpi_sdt_header_t));
+    if (!hdr) return NULL;
+
+    uint32_t length = hdr->length;
+    if (length < sizeof(acpi_sdt_header_t) || length > 0x100000) return NULL;
+    // Remap only if the table runs past the pages mapped for the header.
+    uintptr_t mapped_end = PAGE_ALIGN_UP((uintptr_t)hdr + sizeof(acpi_sdt_header_t));
+    if ((uintptr_t)hdr + length > mapped_end) {
+        hdr = (const acpi_sdt_header_t *)paging_map_mmio(phys, length);
+        if (!hdr) return NULL;
+    }
+    if (!acpi_checksum_ok(hdr, length)) {
+        ACPI_ERROR("Bad checksum on table at P=%#lx", (unsigned long)phys);
+        return NULL;
+    }
+    return hdr;
+}
+
+static void acpi_parse_madt(const acpi_madt_t *madt) {
+    s_madt.lapic_phys = madt->lapic_address;
+    s_madt.pcat_compat = (madt->flags & MADT_FLAG_PCAT_COMPAT) != 0;
+
+    const uint8_t *p = (const uint8_t *)madt + sizeof(acpi_madt_t);
+    const uint8_t *end = (const uint8_t *)madt + madt->header.length;
+    while (p + sizeof(madt_entry_header_t) <= end) {
+        const madt_entry_header_t *eh = (const madt_entry_header_t *)p;
+        if (eh->length < sizeof(madt_entry_header_t) || p + eh->length > end) break;
+
+        switch (eh->type) {
+            case MADT_ENTRY_LAPIC: {
+                const madt_lapic_t *e = (const madt_lapic_t *)p;
+                if ((e->flags & MADT_CPU_ENABLED) && s_madt.cpu_count < ACPI_MADT_MAX_CPUS) {
+                    s_madt.cpu_apic_ids[s_madt.cpu_count++] = e->apic_id;
+                }
+                break;
+            }
+            case MADT_ENTRY_IOAPIC: {
+                const madt_ioapic_t *e = (const madt_ioapic_t *)p;
+                if (s_madt.ioapic_count < ACPI_MADT_MAX_IOAPICS) {
+                    acpi_ioapic_t *io = &s_madt.ioapics[s_madt.ioapic_count++];
+                    io->id = e->ioapic_id;
+                    io->phys_addr = e->ioapic_address;
+                    io->gsi_base = e->gsi_base;
+                }
+                break;
+            }
+            case MADT_ENTRY_ISO: {
+                const madt_iso_t *e = (const madt_iso_t *)p;
+                if (s_madt.override_count < ACPI_MADT_MAX_ISOS) {
+                    acpi_irq_override_t *o = &s_madt.overrides[s_madt.override_count++];
+                    o->bus_irq = e->source_irq;
+                    o->gsi = e->gsi;
+                    o->flags = e->flags;
+                }
+                break;
+            }
+            case MADT_ENTRY_LAPIC_ADDR: {
+                const madt_lapic_addr_t *e = (const madt_lapic_addr_t *)p;
+                if ((uint32_t)(e->lapic_address >> 32) == 0) s_madt.lapic_phys = (uint32_t)e->lapic_address;
+                break;
+            }
+            default:
+                break;
+        }
+        p += eh->length;
+    }
+    s_madt.valid = s_madt.cpu_count > 0;
+}
+
+//============================================================================
+// Public API
+//============================================================================
+bool acpi_init(void) {
+    if (s_acpi_probed) return s_madt.valid;
+    s_acpi_probed = true;
+    memset(&s_madt, 0, sizeof(s_madt));
+
+    const acpi_rsdp_t *rsdp = acpi_find_rsdp();
+    if (!rsdp) {
+        ACPI_INFO("No RSDP found; assuming a uniprocessor PC.");
+        return false;
+    }
+
+    const acpi_sdt_header_t *rsdt = acpi_map_table(rsdp->rsdt_address);
+    if (!rsdt || memcmp(rsdt->signature, "RSDT", 4) != 0) {
+        ACPI_ERROR("RSDT at P=%#lx missing or invalid", (unsigned long)rsdp->rsdt_address);
+        return false;
+    }
+
+    uint32_t entries = (rsdt->length - sizeof(acpi_sdt_header_t)) / sizeof(uint32_t);
+    const uint32_t *table_phys = (const uint32_t *)((const uint8_t *)rsdt + sizeof(acpi_sdt_header_t));
+    for (uint32_t i = 0; i < entries; i++) {
+        const acpi_sdt_header_t *hdr = acpi_map_table(table_phys[i]);
+        if (!hdr) continue;
+        if (memcmp(hdr->signature, "APIC", 4) == 0 && !s_madt.valid) {
+            acpi_parse_madt((const acpi_madt_t *)hdr);
+        } else if (memcmp(hdr->signature, "HPET", 4) == 0 && !s_hpet_phys &&
+                   hdr->length >= sizeof(acpi_hpet_t)) {
+            const acpi_hpet_t *hpet = (const acpi_hpet_t *)hdr;
+            // Memory-mapped and below 4 GiB, or of no use to a 32-bit kernel
+            if (hpet->address_space_id == 0 && (uint32_t)(hpet->base_address >> 32) == 0) {
+                s_hpet_phys = (uint32_t)hpet->base_address;
+                ACPI_INFO("HPET block at P=%#lx", (unsigned long)s_hpet_phys);
+            }
+        }
+    }
+
+    if (!s_madt.valid) {
+        ACPI_INFO("No usable MADT; assuming a uniprocessor PC.");
+        return false;
+    }
+    ACPI_INFO("MADT: %lu CPU(s), %lu I/O APIC(s), %lu override(s), LAPIC P=%#lx",
+              (unsigned long)s_madt.cpu_count, (unsigned long)s_madt.ioapic_count,
+              (unsigned long)s_madt.override_count, (unsigned long)s_madt.lapic_phys);
+    return true;
+}
+
+const acpi_madt_info_t *acpi_get_madt(void) {
+    return &s_madt;
+}
+
+uint32_t acpi_get_hpet_phys(void) {
+    acpi_init();
+    return s_hpet_phys;
+}
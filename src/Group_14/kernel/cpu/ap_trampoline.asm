@@ -0,0 +1,86 @@
+; ap_trampoline.asm
+; Real-mode entry point for application processors.
+;
+; smp.c copies everything between ap_trampoline_start and ap_trampoline_end
+; to AP_TRAMPOLINE_PHYS and fills in the parameter block before sending the
+; STARTUP IPI. The code runs at that copy, so every absolute address below is
+; computed relative to AP_TRAMPOLINE_PHYS rather than the link address.
+;
+; The AP switches to flat protected mode with a private GDT, then loads the
+; BSP's CR4/CR3/CR0 (enabling paging on the kernel page directory) and calls
+;     void entry(uint32_t cpu_index)
+; on its own kernel stack. The first 4MB are identity-mapped, so both this
+; page and the kernel image stay reachable across the paging switch.
+
+AP_TRAMPOLINE_PHYS  equ 0x8000     ; Must match smp.c (SIPI vector 0x08)
+
+%define TRAMP(label) (AP_TRAMPOLINE_PHYS + ((label) - ap_trampoline_start))
+
+global ap_trampoline_start
+global ap_trampoline_end
+global ap_trampoline_params
+
+section .text
+
+bits 16
+ap_trampoline_start:
+    cli
+    cld
+    xor     ax, ax
+    mov     ds, ax
+    lgdt    [TRAMP(tramp_gdt_ptr)]
+
+    mov     eax, cr0
+    or      eax, 1                  ; CR0.PE
+    mov     cr0, eax
+    jmp     dword 0x08:TRAMP(tramp_pm32)
+
+bits 32
+tramp_pm32:
+    mov     ax, 0x10
+    mov     ds, ax
+    mov     es, ax
+    mov     fs, ax
+    mov     gs, ax
+    mov     ss, ax
+
+    mov     eax, [TRAMP(tp_cr4)]    ; PSE/PGE/OSFXSR as on the BSP
+    mov     cr4, eax
+    mov     eax, [TRAMP(tp_cr3)]    ; Kernel page directory
+    mov     cr3, eax
+    mov     eax, [TRAMP(tp_cr0)]    ; PG/WP/NE/MP as on the BSP
+    mov     cr0, eax
+
+    mov     esp, [TRAMP(tp_stack)]
+    xor     ebp, ebp
+    push    dword [TRAMP(tp_cpu_index)]
+    mov     eax, [TRAMP(tp_entry)]
+    call    eax                     ; Does not return
+
+.hang:
+    cli
+    hlt
+    jmp     .hang
+
+align 8
+tramp_gdt:
+    dq 0x0000000000000000           ; Null
+    dq 0x00CF9A000000FFFF           ; 0x08: flat 32-bit code
+    dq 0x00CF92000000FFFF           ; 0x10: flat 32-bit data
+tramp_gdt_end:
+
+tramp_gdt_ptr:
+    dw tramp_gdt_end - tramp_gdt - 1
+    dd TRAMP(tramp_gdt)
+
+; Parameter block (layout mirrors ap_trampoline_params_t in smp.c)
+align 4
+ap_trampoline_params:
+tp_cr0:         dd 0
+tp_cr3:         dd 0
+tp_cr4:         dd 0
+tp_stack:       dd 0
+tp_entry:       dd 0
+tp_cpu_index:   dd 0
+
+ap_trampoline_end:
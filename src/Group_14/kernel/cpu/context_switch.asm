@@ -17,6 +17,7 @@ KERNEL_CODE_SEG equ 0x08
 ;   [ebp+8]  = old_esp_ptr (uint32_t**) - Address where old task's ESP should be saved. NULL if no save needed.
 ;   [ebp+12] = new_esp (uint32_t*)      - Kernel ESP value for the new task to restore.
 ;   [ebp+16] = new_page_directory (uint32_t*) - Physical address of new PD, or NULL if no switch needed.
+;   [ebp+20] = old_on_cpu (bool*)        - Old task's on_cpu flag, cleared once its stack is left. May be NULL.
 ;-----------------------------------------------------------------------------
 context_switch:
     ; --- Function Prologue ---
@@ -110,7 +111,16 @@ context_switch:
 
 .skip_cr3_load:
     ; --- Switch Kernel Stack Pointer ---
+    mov edx, [ebp + 20]   ; EDX = old_on_cpu, read while the old stack is still ours
     mov esp, [ebp + 12]   ; ESP = new_esp (Should point to stack frame prepared for idle task)
+
+    ; --- Release the Old Task ---
+    ; Its context is saved and nothing below touches its stack (EBP is only
+    ; reloaded by POPAD), so another CPU may resume it from here on.
+    test edx, edx
+    jz .skip_on_cpu_clear
+    mov byte [edx], 0
+.skip_on_cpu_clear:
     
     ; DEBUG: Log what we're about to restore
     push eax
@@ -40,9 +40,9 @@
      // Iterate through the table using the linker-defined symbols.
      // The symbols refer to the start and end addresses of the array of entries.
      for (exception_entry_t *entry = __start_ex_table; entry < __stop_ex_table; ++entry) {
-         if (entry->fault_addr == fault_eip) {
-             EXTABLE_DEBUG_PRINTK(" -> Found entry: fault=0x%x -> fixup=0x%x\n",
-                                  entry->fault_addr, entry->fixup_addr);
+         if (fault_eip >= entry->fault_addr && fault_eip < entry->fault_end) {
+             EXTABLE_DEBUG_PRINTK(" -> Found entry: fault=[0x%x-0x%x) -> fixup=0x%x\n",
+                                  entry->fault_addr, entry->fault_end, entry->fixup_addr);
              KERNEL_ASSERT(entry->fixup_addr != 0, "Exception table entry has NULL fixup address!");
              return entry->fixup_addr; // Return the handler address
          }
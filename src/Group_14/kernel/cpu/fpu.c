@@ -0,0 +1,202 @@
+/**
+ * @file fpu.c
+ * @brief Lazy FPU/SSE state switching driven by CR0.TS and the #NM trap.
+ */
+
+#include <kernel/cpu/fpu.h>
+#include <kernel/cpu/cpuid.h>
+#include <kernel/cpu/idt.h>
+#include <kernel/cpu/get_cpu_id.h>
+#include <kernel/process/scheduler.h>
+#include <kernel/memory/kmalloc.h>
+#include <kernel/sync/spinlock.h>   // local_irq_save/restore
+#include <kernel/lib/string.h>
+#include <kernel/lib/assert.h>
+#include <kernel/drivers/display/serial.h>
+
+#define FPU_INFO(fmt, ...)  serial_printf("[FPU  INFO ] " fmt "\n", ##__VA_ARGS__)
+#define FPU_ERROR(fmt, ...) serial_printf("[FPU  ERROR] %s:%d: " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
+
+#define FPU_NM_VECTOR      7
+
+#define CR0_MP             (1u << 1)  // WAIT/FWAIT honour TS
+#define CR0_EM             (1u << 2)  // Emulate FPU (must be clear)
+#define CR0_TS             (1u << 3)  // Task switched: next FPU use raises #NM
+#define CR0_NE             (1u << 5)  // Native x87 error reporting (#MF)
+#define CR4_OSFXSR         (1u << 9)  // FXSAVE/FXRSTOR + SSE enabled
+#define CR4_OSXMMEXCPT     (1u << 10) // Unmasked SSE exceptions raise #XM
+
+#define CPUID_EDX_FPU      (1u << 0)
+#define CPUID_EDX_FXSR     (1u << 24)
+#define CPUID_EDX_SSE      (1u << 25)
+#define CPUID_EDX_SSE2     (1u << 26)
+
+static bool s_fpu_ready = false;
+static bool s_fpu_sse2 = false;
+static struct tcb *s_fpu_owner[MAX_CPUS];  // Task whose state is live in this CPU's registers
+static fpu_state_t s_fpu_initial_state;     // Clean FNINIT image handed to first-time users
+
+//============================================================================
+// Helpers
+//============================================================================
+static inline uint32_t read_cr0(void) {
+    uint32_t v;
+    asm volatile("mov %%cr0, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr0(uint32_t v) {
+    asm volatile("mov %0, %%cr0" :: "r"(v) : "memory");
+}
+
+static inline uint32_t read_cr4(void) {
+    uint32_t v;
+    asm volatile("mov %%cr4, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr4(uint32_t v) {
+    asm volatile("mov %0, %%cr4" :: "r"(v) : "memory");
+}
+
+static inline void fpu_set_ts(void) { write_cr0(read_cr0() | CR0_TS); }
+static inline void fpu_clts(void) { asm volatile("clts" ::: "memory"); }
+
+static inline void *fpu_area(fpu_state_t *state) {
+    return (void *)(((uintptr_t)state->raw + 15) & ~(uintptr_t)15);
+}
+
+static inline void fpu_fxsave(fpu_state_t *state) {
+    asm volatile("fxsave (%0)" :: "r"(fpu_area(state)) : "memory");
+}
+
+static inline void fpu_fxrstor(fpu_state_t *state) {
+    asm volatile("fxrstor (%0)" :: "r"(fpu_area(state)) : "memory");
+}
+
+static inline uint32_t fpu_cpu_index(void) {
+    int id = get_cpu_id();
+    if (id < 0 || id >= MAX_CPUS) id = 0;
+    return (uint32_t)id;
+}
+
+//============================================================================
+// #NM Handler
+//============================================================================
+/**
+ * @brief Device-not-available trap: the current task touched the FPU with TS
+ * set. Give it its own state (or a clean one) and let the instruction retry.
+ */
+static void fpu_nm_handler(isr_frame_t *frame) {
+    (void)frame;
+    fpu_clts();
+
+    tcb_t *current = g_scheduler_ready ? get_current_task() : NULL;
+    uint32_t cpu = fpu_cpu_index();
+    if (!current) {
+        asm volatile("fninit");
+        s_fpu_owner[cpu] = NULL;
+        return;
+    }
+
+    // Registers still hold our state from the last time we ran here.
+    if (s_fpu_owner[cpu] == current) return;
+
+    if (!current->fpu_state) {
+        current->fpu_state = (fpu_state_t *)kmalloc(sizeof(fpu_state_t));
+        if (!current->fpu_state) {
+            FPU_ERROR("No memory for FPU state of PID %lu; terminating task.", current->pid);
+            s_fpu_owner[cpu] = NULL;
+            remove_current_task_with_code(0xDEAD0007);
+        }
+        memcpy(fpu_area(current->fpu_state), fpu_area(&s_fpu_initial_state), FPU_STATE_SIZE);
+    }
+    fpu_fxrstor(current->fpu_state);
+    // Any other CPU that still lists us as owner now holds a stale copy.
+    for (uint32_t c = 0; c < MAX_CPUS; c++) {
+        if (c != cpu && s_fpu_owner[c] == current) s_fpu_owner[c] = NULL;
+    }
+    s_fpu_owner[cpu] = current;
+}
+
+//============================================================================
+// Public API
+//============================================================================
+void fpu_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_EDX_FPU) || !(edx & CPUID_EDX_FXSR)) {
+        // Leave EM set so any FPU use faults loudly instead of corrupting state.
+        write_cr0((read_cr0() | CR0_EM) & ~CR0_TS);
+        FPU_INFO("No FXSAVE-capable FPU; FPU/SSE use stays disabled.");
+        return;
+    }
+
+    write_cr0((read_cr0() & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE);
+    uint32_t cr4 = read_cr4() | CR4_OSFXSR;
+    if (edx & CPUID_EDX_SSE) cr4 |= CR4_OSXMMEXCPT;
+    write_cr4(cr4);
+
+    // Capture a clean image once; first-time users are restored from it,
+    // which also resets MXCSR (FNINIT alone leaves it untouched).
+    asm volatile("fninit");
+    memset(&s_fpu_initial_state, 0, sizeof(s_fpu_initial_state));
+    fpu_fxsave(&s_fpu_initial_state);
+
+    memset(s_fpu_owner, 0, sizeof(s_fpu_owner));
+    register_int_handler(FPU_NM_VECTOR, fpu_nm_handler, NULL);
+    s_fpu_ready = true;
+    s_fpu_sse2 = (edx & CPUID_EDX_SSE) && (edx & CPUID_EDX_SSE2);
+    fpu_set_ts();
+    FPU_INFO("Lazy FPU switching enabled (SSE %s, SSE2 %s).",
+             (edx & CPUID_EDX_SSE) ? "yes" : "no", s_fpu_sse2 ? "yes" : "no");
+}
+
+bool fpu_available(void) {
+    return s_fpu_ready;
+}
+
+bool fpu_has_sse2(void) {
+    return s_fpu_sse2;
+}
+
+uintptr_t kernel_fpu_begin(void) {
+    uintptr_t irq_flags = local_irq_save();
+    uint32_t cpu = fpu_cpu_index();
+    if (!(read_cr0() & CR0_TS)) {
+        // The registers are live for their owner this slice: save before clobbering
+        tcb_t *owner = s_fpu_owner[cpu];
+        if (owner && owner->fpu_state) fpu_fxsave(owner->fpu_state);
+    } else {
+        fpu_clts();
+    }
+    s_fpu_owner[cpu] = NULL; // Whoever uses the FPU next reloads from memory
+    return irq_flags;
+}
+
+void kernel_fpu_end(uintptr_t irq_flags) {
+    fpu_set_ts();
+    local_irq_restore(irq_flags);
+}
+
+void fpu_switch_out(struct tcb *old_task) {
+    if (!s_fpu_ready) return;
+    // TS clear means the #NM handler ran for old_task during this slice.
+    if (!(read_cr0() & CR0_TS)) {
+        if (old_task && old_task->fpu_state && s_fpu_owner[fpu_cpu_index()] == old_task) {
+            fpu_fxsave(old_task->fpu_state);
+        }
+        fpu_set_ts();
+    }
+}
+
+void fpu_release_task(struct tcb *task) {
+    if (!task) return;
+    for (uint32_t c = 0; c < MAX_CPUS; c++) {
+        if (s_fpu_owner[c] == task) s_fpu_owner[c] = NULL;
+    }
+    if (task->fpu_state) {
+        kfree(task->fpu_state);
+        task->fpu_state = NULL;
+    }
+}
@@ -15,6 +15,16 @@
 #include <kernel/lib/assert.h>
 #include <kernel/drivers/display/terminal.h>
 #include <kernel/drivers/storage/block_device.h> // For ata_primary_irq_handler prototype
+#include <kernel/process/scheduler.h>             // For schedule()
+#include <kernel/cpu/lapic.h>                     // LAPIC timer / IPI vectors, lapic_eoi
+#include <kernel/cpu/ioapic.h>
+#include <kernel/cpu/softirq.h>                   // softirq_run_pending on IRQ exit
+#include <kernel/sync/preempt.h>                  // preempt_count: no switch inside a voluntary-mode syscall
+#include <kernel/cpu/irq_stats.h>
+#include <kernel/cpu/get_cpu_id.h>
+#include <kernel/drivers/timer/tick.h>            // tick_lapic_interrupt
+#include <kernel/core/profiler.h>                 // profile_tick
+#include <kernel/sync/spinlock.h>                 // local_irq_save/restore
 
 //============================================================================
 // Definitions and Constants
@@ -35,6 +45,7 @@
 static struct idt_entry idt_entries[IDT_ENTRIES] __attribute__((aligned(16)));
 static struct idt_ptr idtp;
 static interrupt_handler_info_t interrupt_c_handlers[IDT_ENTRIES];
+static bool s_irqs_via_ioapic = false; // Set once legacy IRQs are routed through the I/O APIC
 
 //============================================================================
 // External Assembly Routines (from isr_stubs.asm, irq_stubs.asm, syscall.asm)
@@ -53,6 +64,9 @@ extern void irq4();  extern void irq5();  extern void irq6();  extern void irq7(
 extern void irq8();  extern void irq9();  extern void irq10(); extern void irq11();
 extern void irq12(); extern void irq13(); extern void irq14(); extern void irq15();
 
+// Local APIC Stubs (timer, reschedule IPI, spurious)
+extern void irq_lapic_timer(); extern void irq_ipi_reschedule(); extern void irq_ipi_tlb_shootdown(); extern void irq_lapic_spurious();
+
 // Syscall Handler Stub
 extern void syscall_handler_asm();
 
@@ -107,14 +121,51 @@ static void pic_send_eoi_vector(uint32_t vector) {
     outb(PIC1_COMMAND, PIC_EOI); // Always send EOI to Master PIC for any IRQ 0-15
 }
 
+void irq_send_eoi(uint8_t irq_line) {
+    if (s_irqs_via_ioapic) {
+        lapic_eoi(); // One MMIO write; also retires level-triggered I/O APIC entries
+        return;
+    }
+    pic_send_eoi_vector(IRQ0_VECTOR + irq_line);
+}
+
+bool idt_route_irqs_via_ioapic(uint8_t dest_apic_id) {
+    if (!ioapic_present()) return false;
+
+    // Devices keep their PIC-era vectors, so handlers need no changes.
+    static const uint8_t routed_irqs[] = { 1, 4, 14, 15 }; // Keyboard, COM1, primary and secondary ATA
+    for (size_t i = 0; i < sizeof(routed_irqs); i++) {
+        uint8_t irq = routed_irqs[i];
+        if (!ioapic_route_isa_irq(irq, (uint8_t)(IRQ0_VECTOR + irq), dest_apic_id)) {
+            for (size_t j = 0; j < i; j++) ioapic_mask_isa_irq(routed_irqs[j]);
+            return false;
+        }
+    }
+
+    // Silence the 8259s and stop accepting their virtual-wire output; the
+    // PIT is replaced by the local APIC timer.
+    uintptr_t irq_flags = local_irq_save();
+    outb(PIC1_DATA, 0xFF); io_wait();
+    outb(PIC2_DATA, 0xFF); io_wait();
+    lapic_disable_extint();
+    s_irqs_via_ioapic = true;
+    local_irq_restore(irq_flags);
+    terminal_write("[IDT] Legacy IRQs now routed through the I/O APIC; 8259 PIC masked.\n");
+    return true;
+}
+
+bool idt_irqs_via_ioapic(void) {
+    return s_irqs_via_ioapic;
+}
+
 
 static void pic_unmask_required_irqs(void) {
-    serial_write("[PIC] Unmasking required IRQs (IRQ0-Timer, IRQ1-Keyboard, IRQ2-Cascade, IRQ14-ATA)...\n");
+    serial_write("[PIC] Unmasking required IRQs (IRQ0-Timer, IRQ1-Keyboard, IRQ2-Cascade, IRQ4-COM1, IRQ14-ATA)...\n");
     uint8_t mask1_current = inb(PIC1_DATA);
     uint8_t mask2_current = inb(PIC2_DATA);
     serial_printf("  [PIC] Current masks before unmask: Master=0x%02x, Slave=0x%02x\n", mask1_current, mask2_current);
 
-    uint8_t master_irqs_to_unmask = (1 << 0) | (1 << 1) | (1 << 2); // IRQ0, IRQ1, IRQ2
+    uint8_t master_irqs_to_unmask = (1 << 0) | (1 << 1) | (1 << 2) | (1 << 4); // IRQ0, IRQ1, IRQ2, IRQ4
     uint8_t slave_irqs_to_unmask = (1 << (14 - 8)); // IRQ14 (which is line 6 on slave)
 
     uint8_t new_mask1 = mask1_current & ~master_irqs_to_unmask;
@@ -207,20 +258,43 @@ void default_isr_handler(isr_frame_t* frame) {
     // *** MODIFIED: Send EOI here if it's an unhandled hardware IRQ ***
     if (frame->int_no >= IRQ0_VECTOR && frame->int_no < (IRQ0_VECTOR + 16)) {
         serial_write(" [Default ISR] Unhandled IRQ, sending EOI before panic.\n");
-        pic_send_eoi_vector(frame->int_no); // Use the vector-based EOI sender
+        irq_send_eoi((uint8_t)(frame->int_no - IRQ0_VECTOR));
     }
 
     terminal_write(" System Halted.\n");
+    asm volatile ("cli");
+    serial_flush_sync();
     while (1) { asm volatile ("cli; hlt"); }
 }
 
 
+/**
+ * @brief Common tail of every hardware interrupt, after the handler's EOI.
+ *
+ * Deferred work the handler raised runs next, with interrupts enabled.
+ * An IRQ handler that woke a higher-priority task (e.g. via wake_up_one)
+ * asks for preemption; switch now rather than at the next timer tick,
+ * unless the interrupted task's preempt count forbids it (preempt.h). The
+ * request then stays pending for its next preemption point.
+ * The interrupt is accounted before the switch, so the cycles another task
+ * runs for are not charged to @p vector.
+ */
+static void irq_exit(uint32_t vector, uint64_t start) {
+    softirq_run_pending();
+    irq_stats_account(vector, start);
+    if (need_resched() && g_scheduler_ready && !softirq_in_progress() && preempt_count() == 0) {
+        clear_need_resched();
+        schedule();
+    }
+}
+
 /**
  * @brief Common C-level interrupt handler called by assembly stubs.
  * Dispatches to specific registered C handlers or the default handler.
  * Specific C handlers are now responsible for sending their own EOI.
  */
 void isr_common_handler(isr_frame_t* frame) {
+    uint64_t start = irq_stats_start();
     if (!frame) { KERNEL_PANIC_HALT("isr_common_handler received NULL frame!"); }
 
     uint32_t vector = frame->int_no;
@@ -240,11 +314,52 @@ void isr_common_handler(isr_frame_t* frame) {
         // The default_isr_handler will send EOI if 'vector' is an IRQ before panicking.
         default_isr_handler(frame);
     }
+
+    bool is_irq = (vector >= IRQ0_VECTOR && vector < (IRQ0_VECTOR + 16)) ||
+                  vector == LAPIC_TIMER_VECTOR || vector == IPI_RESCHEDULE_VECTOR;
+    if (is_irq) {
+        irq_exit(vector, start);
+    } else {
+        irq_stats_account(vector, start);
+    }
+
     // EOI is no longer sent here from the common stub if a specific C handler was called.
     // It's the responsibility of the specific handler (e.g., pit_irq_handler, keyboard_irq1_handler)
     // or default_isr_handler (for unhandled IRQs).
 }
 
+//============================================================================
+// Hot Vector Entries
+//============================================================================
+// The APIC timer and the reschedule IPI are by far the most frequent
+// interrupts, so irq_stubs.asm sends them straight here instead of through
+// isr_common_handler's vector check and handler table.
+
+/**
+ * @brief Local APIC timer tick. The BSP's timer drives the global clock;
+ * on APs only local accounting runs.
+ */
+void isr_lapic_timer_entry(isr_frame_t* frame) {
+    uint64_t start = irq_stats_start();
+    lapic_eoi();
+    profile_tick(frame);
+    if (get_cpu_id() == 0) {
+        tick_lapic_interrupt();
+    } else {
+        scheduler_tick_local();
+    }
+    irq_exit(LAPIC_TIMER_VECTOR, start);
+}
+
+/** @brief Reschedule IPI: irq_exit() calls schedule() on the way out. */
+void isr_ipi_reschedule_entry(isr_frame_t* frame) {
+    (void)frame;
+    uint64_t start = irq_stats_start();
+    lapic_eoi();
+    set_need_resched();
+    irq_exit(IPI_RESCHEDULE_VECTOR, start);
+}
+
 
 //============================================================================
 // Public Initialization Function
@@ -288,6 +403,11 @@ void idt_init(void) {
         idt_set_gate_internal(IRQ0_VECTOR + i, (uint32_t)irq_stub_table[i], KERNEL_CS_SELECTOR, IDT_FLAG_INTERRUPT_GATE);
     }
 
+    idt_set_gate_internal(LAPIC_TIMER_VECTOR, (uint32_t)irq_lapic_timer, KERNEL_CS_SELECTOR, IDT_FLAG_INTERRUPT_GATE);
+    idt_set_gate_internal(IPI_RESCHEDULE_VECTOR, (uint32_t)irq_ipi_reschedule, KERNEL_CS_SELECTOR, IDT_FLAG_INTERRUPT_GATE);
+    idt_set_gate_internal(IPI_TLB_SHOOTDOWN_VECTOR, (uint32_t)irq_ipi_tlb_shootdown, KERNEL_CS_SELECTOR, IDT_FLAG_INTERRUPT_GATE);
+    idt_set_gate_internal(LAPIC_SPURIOUS_VECTOR, (uint32_t)irq_lapic_spurious, KERNEL_CS_SELECTOR, IDT_FLAG_INTERRUPT_GATE);
+
     terminal_write("[IDT] Registering System Call handler...\n");
     idt_set_gate_internal(SYSCALL_VECTOR, (uint32_t)syscall_handler_asm, KERNEL_CS_SELECTOR, IDT_FLAG_SYSCALL_GATE);
     serial_printf("[IDT] Registered syscall handler at vector 0x%x\n", SYSCALL_VECTOR);
@@ -295,6 +415,7 @@ void idt_init(void) {
     terminal_write("[IDT] Registering ATA Primary IRQ handler (Vector 46).\n");
     KERNEL_ASSERT(ata_primary_irq_handler != NULL, "ata_primary_irq_handler is NULL");
     register_int_handler(IRQ14_VECTOR, ata_primary_irq_handler, NULL);
+    register_int_handler(IRQ15_VECTOR, ata_secondary_irq_handler, NULL);
 
     serial_printf("[IDT] Loading IDTR: Limit=0x%hx Base=%#010lx (Virt Addr)\n",
                     idtp.limit, (unsigned long)idtp.base);
@@ -303,4 +424,9 @@ void idt_init(void) {
     terminal_write("[IDT] IDT initialized and loaded.\n");
     pic_unmask_required_irqs();
     terminal_write("[IDT] Setup complete.\n");
+}
+
+void idt_load(void) {
+    // The table is shared; application processors only need IDTR pointed at it.
+    asm volatile("lidt (%0)" : : "r"(&idtp) : "memory");
 }
\ No newline at end of file
@@ -0,0 +1,149 @@
+/**
+ * @file ioapic.c
+ * @brief I/O APIC programming for ISA interrupt routing.
+ */
+
+#include <kernel/cpu/ioapic.h>
+#include <kernel/cpu/acpi.h>
+#include <kernel/memory/paging.h>
+#include <kernel/drivers/display/serial.h>
+
+#define IOAPIC_INFO(fmt, ...)  serial_printf("[IOAPIC INFO ] " fmt "\n", ##__VA_ARGS__)
+#define IOAPIC_ERROR(fmt, ...) serial_printf("[IOAPIC ERROR] %s:%d: " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
+
+// Indirect register access: select in IOREGSEL, then read/write IOWIN.
+#define IOAPIC_IOREGSEL         0x00
+#define IOAPIC_IOWIN            0x10
+
+#define IOAPIC_REG_ID           0x00
+#define IOAPIC_REG_VERSION      0x01
+#define IOAPIC_REG_REDTBL(n)    (0x10 + 2 * (n))
+
+#define IOAPIC_REDIR_MASKED     (1u << 16)
+#define IOAPIC_REDIR_LEVEL      (1u << 15)
+#define IOAPIC_REDIR_ACTIVE_LOW (1u << 13)
+
+// MPS INTI flags carried by MADT interrupt source overrides
+#define MPS_POLARITY_MASK       0x3
+#define MPS_POLARITY_LOW        0x3
+#define MPS_TRIGGER_MASK        0xC
+#define MPS_TRIGGER_LEVEL       0xC
+
+typedef struct ioapic {
+    volatile uint32_t *regs;
+    uint32_t           gsi_base;
+    uint32_t           redir_count;
+} ioapic_t;
+
+static ioapic_t s_ioapics[ACPI_MADT_MAX_IOAPICS];
+static uint32_t s_ioapic_count = 0;
+
+//============================================================================
+// Register Access
+//============================================================================
+static uint32_t ioapic_read(const ioapic_t *io, uint32_t reg) {
+    io->regs[IOAPIC_IOREGSEL / 4] = reg;
+    return io->regs[IOAPIC_IOWIN / 4];
+}
+
+static void ioapic_write(const ioapic_t *io, uint32_t reg, uint32_t value) {
+    io->regs[IOAPIC_IOREGSEL / 4] = reg;
+    io->regs[IOAPIC_IOWIN / 4] = value;
+}
+
+//============================================================================
+// Helpers
+//============================================================================
+/** @brief Finds the I/O APIC serving @p gsi and the input number within it. */
+static ioapic_t *ioapic_for_gsi(uint32_t gsi, uint32_t *out_pin) {
+    for (uint32_t i = 0; i < s_ioapic_count; i++) {
+        ioapic_t *io = &s_ioapics[i];
+        if (gsi >= io->gsi_base && gsi < io->gsi_base + io->redir_count) {
+            *out_pin = gsi - io->gsi_base;
+            return io;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Translates an ISA IRQ to its GSI and redirection-entry mode bits.
+ * Without an override ISA interrupts are identity-mapped, edge-triggered and
+ * active-high.
+ */
+static uint32_t isa_irq_to_gsi(uint8_t isa_irq, uint32_t *out_mode) {
+    const acpi_madt_info_t *madt = acpi_get_madt();
+    *out_mode = 0;
+    for (uint32_t i = 0; i < madt->override_count; i++) {
+        const acpi_irq_override_t *o = &madt->overrides[i];
+        if (o->bus_irq != isa_irq) continue;
+        if ((o->flags & MPS_POLARITY_MASK) == MPS_POLARITY_LOW) *out_mode |= IOAPIC_REDIR_ACTIVE_LOW;
+        if ((o->flags & MPS_TRIGGER_MASK) == MPS_TRIGGER_LEVEL) *out_mode |= IOAPIC_REDIR_LEVEL;
+        return o->gsi;
+    }
+    return isa_irq;
+}
+
+//============================================================================
+// Public API
+//============================================================================
+bool ioapic_init(void) {
+    if (s_ioapic_count) return true;
+    const acpi_madt_info_t *madt = acpi_get_madt();
+    if (!madt->valid) return false;
+
+    for (uint32_t i = 0; i < madt->ioapic_count; i++) {
+        const acpi_ioapic_t *desc = &madt->ioapics[i];
+        volatile uint32_t *regs = (volatile uint32_t *)paging_map_mmio(desc->phys_addr, PAGE_SIZE);
+        if (!regs) {
+            IOAPIC_ERROR("Failed to map I/O APIC %u at P=%#lx", desc->id, (unsigned long)desc->phys_addr);
+            continue;
+        }
+
+        ioapic_t *io = &s_ioapics[s_ioapic_count++];
+        io->regs = regs;
+        io->gsi_base = desc->gsi_base;
+        io->redir_count = ((ioapic_read(io, IOAPIC_REG_VERSION) >> 16) & 0xFF) + 1;
+
+        // Start with every input masked; drivers' IRQs are routed explicitly.
+        for (uint32_t pin = 0; pin < io->redir_count; pin++) {
+            ioapic_write(io, IOAPIC_REG_REDTBL(pin), IOAPIC_REDIR_MASKED);
+            ioapic_write(io, IOAPIC_REG_REDTBL(pin) + 1, 0);
+        }
+        IOAPIC_INFO("I/O APIC %u at P=%#lx V=%p: GSI %lu-%lu",
+                    desc->id, (unsigned long)desc->phys_addr, (void *)regs,
+                    (unsigned long)io->gsi_base, (unsigned long)(io->gsi_base + io->redir_count - 1));
+    }
+    return s_ioapic_count > 0;
+}
+
+bool ioapic_present(void) {
+    return s_ioapic_count > 0;
+}
+
+bool ioapic_route_isa_irq(uint8_t isa_irq, uint8_t vector, uint8_t dest_apic_id) {
+    uint32_t mode;
+    uint32_t gsi = isa_irq_to_gsi(isa_irq, &mode);
+    uint32_t pin;
+    ioapic_t *io = ioapic_for_gsi(gsi, &pin);
+    if (!io) {
+        IOAPIC_ERROR("No I/O APIC serves IRQ %u (GSI %lu)", isa_irq, (unsigned long)gsi);
+        return false;
+    }
+
+    // Destination first, so the entry never fires towards a stale CPU.
+    ioapic_write(io, IOAPIC_REG_REDTBL(pin) + 1, (uint32_t)dest_apic_id << 24);
+    ioapic_write(io, IOAPIC_REG_REDTBL(pin), mode | vector);
+    IOAPIC_INFO("IRQ %u -> GSI %lu -> vector 0x%x on APIC ID %u%s",
+                isa_irq, (unsigned long)gsi, vector, dest_apic_id,
+                (mode & IOAPIC_REDIR_LEVEL) ? " (level)" : "");
+    return true;
+}
+
+void ioapic_mask_isa_irq(uint8_t isa_irq) {
+    uint32_t mode;
+    uint32_t pin;
+    ioapic_t *io = ioapic_for_gsi(isa_irq_to_gsi(isa_irq, &mode), &pin);
+    if (!io) return;
+    ioapic_write(io, IOAPIC_REG_REDTBL(pin), ioapic_read(io, IOAPIC_REG_REDTBL(pin)) | IOAPIC_REDIR_MASKED);
+}
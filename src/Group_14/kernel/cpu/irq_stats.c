@@ -0,0 +1,48 @@
+/**
+ * @file irq_stats.c
+ * @brief Per-CPU, per-vector interrupt entry-to-exit cycle counters.
+ */
+
+#include <kernel/cpu/irq_stats.h>
+#include <kernel/cpu/get_cpu_id.h>
+#include <kernel/cpu/tsc.h>
+#include <kernel/drivers/timer/clock.h>   // clock_tsc_active
+#include <kernel/fs/vfs/fs_errno.h>
+#include <kernel/lib/string.h>
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_cycles;     // One interrupt never gets near 2^32 cycles
+    uint64_t total_cycles;
+} irq_counter_t;
+
+// Indexed [cpu][vector]; each CPU only writes its own row, with interrupts off
+static irq_counter_t s_counters[MAX_CPUS][IRQ_STATS_VECTORS];
+
+uint64_t irq_stats_start(void) {
+    return clock_tsc_active() ? read_tsc() : 0;
+}
+
+void irq_stats_account(uint32_t vector, uint64_t start) {
+    if (vector >= IRQ_STATS_VECTORS) return;
+    irq_counter_t *c = &s_counters[get_cpu_id()][vector];
+    c->count++;
+    if (!start) return;
+    uint64_t delta = read_tsc() - start;
+    uint32_t cycles = (delta >> 32) ? 0xFFFFFFFFu : (uint32_t)delta;
+    c->total_cycles += cycles;
+    if (cycles > c->max_cycles) c->max_cycles = cycles;
+}
+
+int irq_stats_get(uint32_t vector, irq_stats_t *out) {
+    if (vector >= IRQ_STATS_VECTORS) return -EINVAL;
+    memset(out, 0, sizeof(*out));
+    out->vector = vector;
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        const irq_counter_t *c = &s_counters[cpu][vector];
+        out->count += c->count;
+        out->total_cycles += c->total_cycles;
+        if (c->max_cycles > out->max_cycles) out->max_cycles = c->max_cycles;
+    }
+    return 0;
+}
@@ -12,6 +12,8 @@ default rel
 ; External C / ASM helpers
 ; --------------------------------------------------------------------------
 extern  isr_common_handler      ; void isr_common_handler(isr_frame_t*)
+extern  isr_lapic_timer_entry   ; Hot vectors skip the generic dispatch (idt.c)
+extern  isr_ipi_reschedule_entry
 
 ; serial_putc_asm will be used if any debug flag is set
 ; Ensure DEBUG_IRQ_STUBS and DEBUG_IRQ1_DIRECT are defined in your Makefile/CMake if needed
@@ -28,7 +30,11 @@ extern  isr_common_handler      ; void isr_common_handler(isr_frame_t*)
 ; Segments & constants
 ; --------------------------------------------------------------------------
 KERNEL_DS       equ     0x10            ; must match your GDT data‑segment
+KERNEL_PERCPU   equ     0x30            ; per-CPU data segment (GDT_PERCPU_SELECTOR), kept in FS
 IRQ_BASE_VEC    equ     32              ; PIC remap base (0x20)
+LAPIC_TIMER_VEC equ     0xF0            ; must match lapic.h
+IPI_RESCHED_VEC equ     0xF1
+IPI_TLB_VEC     equ     0xF2
 
 ; --------------------------------------------------------------------------
 ; Public IRQ labels (used by idt.c)
@@ -38,6 +44,44 @@ IRQ_BASE_VEC    equ     32              ; PIC remap base (0x20)
     global  irq %+ i
 %assign i i+1
 %endrep
+global  irq_lapic_timer
+global  irq_ipi_reschedule
+global  irq_ipi_tlb_shootdown
+global  irq_lapic_spurious
+
+; --------------------------------------------------------------------------
+; Builds the isr_frame_t below the vector and error code already pushed,
+; calls C handler %1 with a pointer to it and unwinds it again, leaving
+; ESP at the hardware interrupt frame for the caller's iret.
+; --------------------------------------------------------------------------
+%macro IRQ_FRAME_CALL 1
+    push    ds                      ; Save segment registers
+    push    es
+    push    fs
+    push    gs
+    pusha                           ; Save all general purpose registers (EDI, ESI, EBP, ESP_orig, EBX, EDX, ECX, EAX)
+
+    mov     ax, KERNEL_DS           ; Load kernel data segment selector
+    mov     ds, ax
+    mov     es, ax
+    mov     gs, ax
+    mov     ax, KERNEL_PERCPU       ; FS -> this CPU's per-CPU area
+    mov     fs, ax
+    cld                             ; C code assumes DF=0; the interrupted code may have set it
+
+    mov     eax, esp                ; ESP now points to the top of the saved registers (start of isr_frame_t)
+    push    eax                     ; Pass pointer to isr_frame_t as argument
+    call    %1                      ; Call the C handler
+    add     esp, 4                  ; Clean up argument from stack
+
+    popa                            ; Restore general purpose registers
+    pop     gs                      ; Restore segment registers
+    pop     fs
+    pop     es
+    pop     ds
+
+    add     esp, 8                  ; Pop int‑no (vector #) + fake error‑code
+%endmacro
 
 ; --------------------------------------------------------------------------
 ; Helper macro for general IRQs (excluding IRQ1 which has a special stub)
@@ -71,6 +115,28 @@ irq1:
 %assign i i+1
 %endrep
 
+; --- Local APIC vectors ---
+irq_lapic_timer:
+    push    dword 0
+    push    dword LAPIC_TIMER_VEC
+    IRQ_FRAME_CALL isr_lapic_timer_entry
+    iret
+
+irq_ipi_reschedule:
+    push    dword 0
+    push    dword IPI_RESCHED_VEC
+    IRQ_FRAME_CALL isr_ipi_reschedule_entry
+    iret
+
+irq_ipi_tlb_shootdown:
+    push    dword 0
+    push    dword IPI_TLB_VEC
+    jmp     irq_common_stub
+
+; Spurious APIC interrupts must not be acknowledged with an EOI.
+irq_lapic_spurious:
+    iret
+
 ; --------------------------------------------------------------------------
 ; Common stub for IRQs – builds stack frame & jumps to C
 ; --------------------------------------------------------------------------
@@ -81,30 +147,7 @@ irq_common_stub:
     call    serial_putc_asm
     popa
 %endif
-    push    ds                      ; Save segment registers
-    push    es
-    push    fs
-    push    gs
-    pusha                           ; Save all general purpose registers (EDI, ESI, EBP, ESP_orig, EBX, EDX, ECX, EAX)
-
-    mov     ax, KERNEL_DS           ; Load kernel data segment selector
-    mov     ds, ax
-    mov     es, ax
-    mov     fs, ax
-    mov     gs, ax
-
-    mov     eax, esp                ; ESP now points to the top of the saved registers (start of isr_frame_t)
-    push    eax                     ; Pass pointer to isr_frame_t as argument
-    call    isr_common_handler      ; Call the C common handler
-    add     esp, 4                  ; Clean up argument from stack
-
-    popa                            ; Restore general purpose registers
-    pop     gs                      ; Restore segment registers
-    pop     fs
-    pop     es
-    pop     ds
-
-    add     esp, 8                  ; Pop int‑no (vector #) + fake error‑code
+    IRQ_FRAME_CALL isr_common_handler
 
 %ifdef DEBUG_IRQ_STUBS
     pusha
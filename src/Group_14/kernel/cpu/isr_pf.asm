@@ -8,6 +8,7 @@ bits 32
 
 ; ***** ADD THIS DEFINITION *****
 KERNEL_DS      equ 0x10         ; must match your GDT data‑segment and other stubs
+KERNEL_PERCPU  equ 0x30         ; per-CPU data segment (GDT_PERCPU_SELECTOR), kept in FS
 ; *******************************
 
 global isr14                    ; exposed to IDT setup
@@ -42,8 +43,10 @@ isr14:
     mov ax, KERNEL_DS   ; Use the defined KERNEL_DS
     mov ds, ax
     mov es, ax
-    mov fs, ax
     mov gs, ax
+    mov ax, KERNEL_PERCPU ; FS -> this CPU's per-CPU area
+    mov fs, ax
+    cld                   ; C code assumes DF=0
 
     ; --- Check if fault occurred in Kernel (CPL=0) or User mode (CPL=3) ---
     ; CS is at [ESP + 60] relative to current ESP after all pushes
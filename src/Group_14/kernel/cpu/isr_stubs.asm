@@ -21,6 +21,7 @@ global isr10, isr11, isr12, isr13, isr16, isr17, isr18, isr19
 ; ISR9 and ISR15 are often reserved or specific, add if needed.
 
 KERNEL_DS equ 0x10 ; Must match your GDT data-segment selector
+KERNEL_PERCPU equ 0x30 ; Per-CPU data segment (GDT_PERCPU_SELECTOR), kept in FS
 
 ; Common macro for ISRs WITHOUT an error code pushed by CPU
 ; We push a dummy error code 0.
@@ -103,8 +104,10 @@ common_interrupt_stub:
     mov     ax, KERNEL_DS           ; Load kernel data segment selector
     mov     ds, ax
     mov     es, ax
-    mov     fs, ax
     mov     gs, ax
+    mov     ax, KERNEL_PERCPU       ; FS -> this CPU's per-CPU area
+    mov     fs, ax
+    cld                             ; C code assumes DF=0; the interrupted code may have set it
 
     mov     eax, esp                ; ESP now points to the start of isr_frame_t
     push    eax                     ; Pass pointer to isr_frame_t as argument
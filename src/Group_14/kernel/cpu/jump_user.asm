@@ -44,4 +44,31 @@ jump_to_user_mode:
     cli
 .halt_loop:
     hlt
-    jmp .halt_loop
\ No newline at end of file
+    jmp .halt_loop
+; -----------------------------------------------------------------------------
+; user_first_entry -- First code a new process runs (scheduler_add_task)
+; context_switch "returns" here with ESP at the IRET frame built by
+; prepare_initial_kernel_stack(); CR3 is already the process's.
+; -----------------------------------------------------------------------------
+global user_first_entry
+
+user_first_entry:
+    cli             ; context_switch restored IF=1; nothing may run on the bare frame
+    iret
+
+; -----------------------------------------------------------------------------
+; fork_child_return -- First code a forked child runs (scheduler_add_forked_task)
+; context_switch "returns" here with ESP at the isr_frame_t copied from the
+; parent's syscall. Unwind it exactly like the tail of syscall_handler_asm.
+; -----------------------------------------------------------------------------
+global fork_child_return
+
+fork_child_return:
+    cli             ; context_switch restored IF=1; no interrupts on a half-unwound frame
+    popa            ; EAX already 0 in the copy
+    pop gs
+    pop fs
+    pop es
+    pop ds
+    add esp, 8      ; int_no, err_code
+    iret
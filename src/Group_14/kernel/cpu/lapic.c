@@ -0,0 +1,164 @@
+/**
+ * @file lapic.c
+ * @brief Local APIC register access, IPIs and the APIC timer.
+ */
+
+#include <kernel/cpu/lapic.h>
+#include <kernel/cpu/msr.h>
+#include <kernel/memory/paging.h>
+#include <kernel/drivers/timer/pit.h>
+#include <kernel/drivers/display/serial.h>
+
+#define LAPIC_INFO(fmt, ...)  serial_printf("[LAPIC INFO ] " fmt "\n", ##__VA_ARGS__)
+#define LAPIC_ERROR(fmt, ...) serial_printf("[LAPIC ERROR] %s:%d: " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
+
+#define MSR_IA32_APIC_BASE        0x1B
+#define APIC_BASE_GLOBAL_ENABLE   (1u << 11)
+
+#define LAPIC_SVR_ENABLE          (1u << 8)
+#define LAPIC_LVT_MASKED          (1u << 16)
+#define LAPIC_TIMER_PERIODIC      (1u << 17)
+#define LAPIC_TIMER_DIV_16        0x3
+#define LAPIC_LVT_EXTINT          (7u << 8)
+#define LAPIC_LVT_NMI             (4u << 8)
+
+#define ICR_DELIVERY_FIXED        (0u << 8)
+#define ICR_DELIVERY_INIT         (5u << 8)
+#define ICR_DELIVERY_STARTUP      (6u << 8)
+#define ICR_DELIVERY_PENDING      (1u << 12)
+#define ICR_LEVEL_ASSERT          (1u << 14)
+
+#define LAPIC_CALIBRATE_US        10000 // 10 ms sample
+
+static volatile uint32_t *s_lapic = NULL;
+
+//============================================================================
+// Register Access
+//============================================================================
+static inline uint32_t lapic_read(uint32_t reg) {
+    return s_lapic[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    s_lapic[reg / 4] = value;
+    (void)s_lapic[LAPIC_REG_ID / 4]; // Read back to post the write
+}
+
+static void lapic_icr_wait(void) {
+    while (lapic_read(LAPIC_REG_ICR_LO) & ICR_DELIVERY_PENDING) {
+        asm volatile("pause");
+    }
+}
+
+static void lapic_send_icr(uint8_t apic_id, uint32_t low) {
+    lapic_icr_wait();
+    lapic_write(LAPIC_REG_ICR_HI, (uint32_t)apic_id << 24);
+    lapic_write(LAPIC_REG_ICR_LO, low);
+    lapic_icr_wait();
+}
+
+//============================================================================
+// Public API
+//============================================================================
+bool lapic_init(uintptr_t phys_base) {
+    if (s_lapic) return true;
+
+    uint64_t base_msr = rdmsr(MSR_IA32_APIC_BASE);
+    if (!phys_base) phys_base = (uintptr_t)(base_msr & 0xFFFFF000u);
+    if (!(base_msr & APIC_BASE_GLOBAL_ENABLE)) {
+        wrmsr(MSR_IA32_APIC_BASE, base_msr | APIC_BASE_GLOBAL_ENABLE);
+    }
+
+    s_lapic = (volatile uint32_t *)paging_map_mmio(phys_base, PAGE_SIZE);
+    if (!s_lapic) {
+        LAPIC_ERROR("Failed to map LAPIC registers at P=%#lx", (unsigned long)phys_base);
+        return false;
+    }
+    LAPIC_INFO("LAPIC at P=%#lx V=%p, BSP APIC ID %u, version 0x%lx",
+               (unsigned long)phys_base, (void *)s_lapic, lapic_id(),
+               (unsigned long)(lapic_read(LAPIC_REG_VERSION) & 0xFF));
+    return true;
+}
+
+bool lapic_present(void) {
+    return s_lapic != NULL;
+}
+
+void lapic_enable(bool bsp) {
+    lapic_write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+    lapic_write(LAPIC_REG_TPR, 0);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_REG_LVT_ERROR, LAPIC_LVT_MASKED);
+    if (bsp) {
+        // Virtual-wire mode: 8259 interrupts keep arriving through LINT0.
+        lapic_write(LAPIC_REG_LVT_LINT0, LAPIC_LVT_EXTINT);
+        lapic_write(LAPIC_REG_LVT_LINT1, LAPIC_LVT_NMI);
+    } else {
+        lapic_write(LAPIC_REG_LVT_LINT0, LAPIC_LVT_MASKED);
+        lapic_write(LAPIC_REG_LVT_LINT1, LAPIC_LVT_MASKED);
+    }
+    // Writing ESR twice clears any error latched before we enabled it.
+    lapic_write(LAPIC_REG_ESR, 0);
+    lapic_write(LAPIC_REG_ESR, 0);
+    lapic_eoi();
+}
+
+uint8_t lapic_id(void) {
+    return (uint8_t)(lapic_read(LAPIC_REG_ID) >> 24);
+}
+
+void lapic_eoi(void) {
+    s_lapic[LAPIC_REG_EOI / 4] = 0;
+}
+
+void lapic_send_ipi(uint8_t apic_id, uint8_t vector) {
+    lapic_send_icr(apic_id, ICR_DELIVERY_FIXED | ICR_LEVEL_ASSERT | vector);
+}
+
+void lapic_send_init(uint8_t apic_id) {
+    lapic_send_icr(apic_id, ICR_DELIVERY_INIT | ICR_LEVEL_ASSERT);
+}
+
+void lapic_send_startup(uint8_t apic_id, uint8_t vector_page) {
+    lapic_send_icr(apic_id, ICR_DELIVERY_STARTUP | vector_page);
+}
+
+uint32_t lapic_timer_calibrate(uint32_t tick_hz) {
+    if (tick_hz == 0) tick_hz = 1;
+
+    lapic_write(LAPIC_REG_TIMER_DIV, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_REG_TIMER_INIT, 0xFFFFFFFFu);
+    pit_delay_us(LAPIC_CALIBRATE_US);
+    uint32_t elapsed = 0xFFFFFFFFu - lapic_read(LAPIC_REG_TIMER_CUR);
+    lapic_write(LAPIC_REG_TIMER_INIT, 0);
+
+    // elapsed covers 1/100 s; scale to one tick without 64-bit division.
+    uint32_t per_tick = (elapsed <= 0xFFFFFFFFu / 100) ? (elapsed * 100) / tick_hz
+                                                       : (elapsed / tick_hz) * 100;
+    if (per_tick == 0) per_tick = 1;
+    LAPIC_INFO("Timer calibrated: %lu counts per %lu Hz tick (div 16)",
+               (unsigned long)per_tick, (unsigned long)tick_hz);
+    return per_tick;
+}
+
+void lapic_timer_start_periodic(uint32_t counts_per_tick) {
+    lapic_write(LAPIC_REG_TIMER_DIV, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_PERIODIC | LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_REG_TIMER_INIT, counts_per_tick);
+}
+
+void lapic_timer_start_oneshot(uint32_t counts) {
+    if (counts == 0) counts = 1;
+    lapic_write(LAPIC_REG_TIMER_DIV, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_VECTOR); // Mode 00: one-shot
+    lapic_write(LAPIC_REG_TIMER_INIT, counts);
+}
+
+uint32_t lapic_timer_current_count(void) {
+    return lapic_read(LAPIC_REG_TIMER_CUR);
+}
+
+void lapic_disable_extint(void) {
+    lapic_write(LAPIC_REG_LVT_LINT0, LAPIC_LVT_MASKED);
+}
@@ -0,0 +1,20 @@
+/**
+ * @file percpu.c
+ * @brief Storage for the per-CPU areas reached through %fs.
+ */
+
+#include <kernel/cpu/percpu.h>
+#include <kernel/cpu/get_cpu_id.h> // MAX_CPUS
+
+_Static_assert(__builtin_offsetof(percpu_t, need_resched) == PERCPU_NEED_RESCHED_OFFSET,
+               "Update PERCPU_NEED_RESCHED in syscall.asm");
+
+percpu_t g_percpu[MAX_CPUS];
+bool g_percpu_ready = false;
+
+percpu_t *percpu_init_cpu(uint32_t cpu) {
+    percpu_t *area = &g_percpu[cpu];
+    area->self = area;
+    area->cpu_id = cpu;
+    return area;
+}
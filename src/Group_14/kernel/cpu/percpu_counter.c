@@ -0,0 +1,28 @@
+/**
+ * @file percpu_counter.c
+ * @brief Readers of the per-CPU statistics counters; see percpu_counter.h.
+ */
+
+#include <kernel/cpu/percpu_counter.h>
+
+uint64_t percpu_counter_sum(const percpu_counter_t *c) {
+    uint64_t sum = 0;
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        const percpu_counter_slot_t *s = &c->slots[cpu];
+        uint32_t hi, lo;
+        // The owner may carry into hi between our two loads; read hi again
+        do {
+            hi = s->hi;
+            lo = s->lo;
+        } while (hi != s->hi);
+        sum += ((uint64_t)hi << 32) | lo;
+    }
+    return sum;
+}
+
+void percpu_counter_reset(percpu_counter_t *c) {
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        c->slots[cpu].lo = 0;
+        c->slots[cpu].hi = 0;
+    }
+}
@@ -0,0 +1,205 @@
+/**
+ * @file perf.c
+ * @brief Per-task virtualized PMU counters (IA32_PERFEVTSELx / IA32_PMCx).
+ */
+
+#include <kernel/cpu/perf.h>
+#include <kernel/cpu/cpuid.h>
+#include <kernel/cpu/msr.h>
+#include <kernel/process/scheduler.h>
+#include <kernel/memory/kmalloc.h>
+#include <kernel/memory/uaccess.h>
+#include <kernel/sync/spinlock.h>   // local_irq_save/restore
+#include <kernel/fs/vfs/fs_errno.h>
+#include <kernel/lib/string.h>
+#include <kernel/drivers/display/serial.h>
+
+#define PERF_INFO(fmt, ...)  serial_printf("[PERF INFO ] " fmt "\n", ##__VA_ARGS__)
+
+#define EVTSEL_USR          (1u << 16) // Same bits as PERF_USER / PERF_KERNEL
+#define EVTSEL_OS           (1u << 17)
+#define EVTSEL_EN           (1u << 22)
+#define PERF_RAW_FLAG       0x80000000u
+#define PERF_CODE_MASK      0xFFFFu    // Unit mask << 8 | event select
+#define PERF_EVENT_COUNT    9
+
+// Unit mask << 8 | event select, indexed by PERF_EVENT_*
+static const uint16_t s_event_codes[PERF_EVENT_COUNT] = {
+    [PERF_EVENT_CYCLES]         = 0x003C,
+    [PERF_EVENT_INSTRUCTIONS]   = 0x00C0,
+    [PERF_EVENT_REF_CYCLES]     = 0x013C,
+    [PERF_EVENT_LLC_REFERENCES] = 0x4F2E,
+    [PERF_EVENT_LLC_MISSES]     = 0x412E,
+    [PERF_EVENT_BRANCHES]       = 0x00C4,
+    [PERF_EVENT_BRANCH_MISSES]  = 0x00C5,
+    [PERF_EVENT_DTLB_MISSES]    = 0x0108, // DTLB_LOAD_MISSES, Nehalem through Skylake
+};
+
+static uint32_t s_counters = 0;         // Slots in use: min(CPU's counters, PERF_MAX_COUNTERS)
+static uint32_t s_version = 0;
+static uint64_t s_counter_mask = 0;     // Counter width
+static uint32_t s_event_missing = 0;    // CPUID.0AH:EBX; bit set: architectural event not counted
+static uint32_t s_event_bits = 0;       // Valid bits in s_event_missing
+static bool     s_intel_family6 = false;
+
+void perf_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(0, &eax, &ebx, &ecx, &edx);
+    bool intel = ebx == 0x756E6547 && edx == 0x49656E69 && ecx == 0x6C65746E; // "GenuineIntel"
+    if (eax < 0xA) {
+        PERF_INFO("No architectural PMU");
+        return;
+    }
+    uint32_t sig;
+    cpuid(1, &sig, &ebx, &ecx, &edx);
+    s_intel_family6 = intel && ((sig >> 8) & 0xF) == 6;
+
+    cpuid(0xA, &eax, &ebx, &ecx, &edx);
+    uint32_t version = eax & 0xFF;
+    uint32_t count = (eax >> 8) & 0xFF;
+    uint32_t width = (eax >> 16) & 0xFF;
+    if (version == 0 || count == 0 || width < 32) {
+        PERF_INFO("No architectural PMU (version %lu, %lu counters)", (unsigned long)version, (unsigned long)count);
+        return;
+    }
+    s_version = version;
+    s_counter_mask = width >= 64 ? ~0ull : (1ull << width) - 1;
+    s_event_missing = ebx;
+    s_event_bits = eax >> 24;
+    s_counters = count < PERF_MAX_COUNTERS ? count : PERF_MAX_COUNTERS;
+    perf_init_cpu();
+    PERF_INFO("PMU version %lu: %lu of %lu counters, %lu bits wide",
+              (unsigned long)version, (unsigned long)s_counters, (unsigned long)count, (unsigned long)width);
+}
+
+void perf_init_cpu(void) {
+    if (!s_counters) return;
+    for (uint32_t i = 0; i < s_counters; i++) wrmsr(MSR_IA32_PERFEVTSEL0 + i, 0);
+    if (s_version >= 2) {
+        wrmsr(MSR_IA32_PERF_GLOBAL_CTRL, rdmsr(MSR_IA32_PERF_GLOBAL_CTRL) | ((1u << s_counters) - 1));
+    }
+}
+
+uint32_t perf_counters(void) {
+    return s_counters;
+}
+
+// Adds the live counts to @p p and stops its counters. Interrupts off.
+static void counters_fold(perf_task_t *p) {
+    for (uint32_t i = 0; i < s_counters; i++) {
+        if (!p->evtsel[i]) continue;
+        wrmsr(MSR_IA32_PERFEVTSEL0 + i, 0);
+        p->count[i] += rdmsr(MSR_IA32_PMC0 + i) & s_counter_mask;
+    }
+}
+
+// Starts @p p's counters from zero. Interrupts off.
+static void counters_load(const perf_task_t *p) {
+    for (uint32_t i = 0; i < s_counters; i++) {
+        if (!p->evtsel[i]) continue;
+        wrmsr(MSR_IA32_PMC0 + i, 0);
+        wrmsr(MSR_IA32_PERFEVTSEL0 + i, p->evtsel[i]);
+    }
+}
+
+void perf_switch(tcb_t *old_task, tcb_t *new_task) {
+    if (old_task && old_task->perf) counters_fold(old_task->perf);
+    if (new_task->perf) counters_load(new_task->perf);
+}
+
+void perf_release_task(tcb_t *task) {
+    kfree(task->perf);
+    task->perf = NULL;
+}
+
+/** @brief IA32_PERFEVTSELx image for PERF_SET's @p config. */
+static int perf_encode(uint32_t config, uint32_t *evtsel) {
+    if (config & ~(PERF_RAW_FLAG | PERF_USER | PERF_KERNEL | PERF_CODE_MASK)) return -EINVAL;
+    uint32_t code = config & PERF_CODE_MASK;
+    if (!(config & PERF_RAW_FLAG)) {
+        if (code == PERF_EVENT_NONE || code >= PERF_EVENT_COUNT) return -EINVAL;
+        if (code == PERF_EVENT_DTLB_MISSES) {
+            if (!s_intel_family6) return -ENODEV;
+        } else if (code - 1 >= s_event_bits || (s_event_missing & (1u << (code - 1)))) {
+            return -ENODEV;
+        }
+        code = s_event_codes[code];
+    }
+    uint32_t mode = config & (PERF_USER | PERF_KERNEL);
+    *evtsel = code | (mode ? mode : EVTSEL_USR | EVTSEL_OS) | EVTSEL_EN;
+    return 0;
+}
+
+static int32_t perf_set(tcb_t *task, uint32_t slot, uint32_t config) {
+    if (!s_counters) return -ENODEV;
+    if (slot >= s_counters) return -EINVAL;
+    uint32_t evtsel = 0;
+    if (config != PERF_EVENT_NONE) {
+        int err = perf_encode(config, &evtsel);
+        if (err) return err;
+    }
+    perf_task_t *p = task->perf;
+    if (!p) {
+        if (!evtsel) return 0;
+        p = kmalloc(sizeof(*p));
+        if (!p) return -ENOMEM;
+        memset(p, 0, sizeof(*p));
+    }
+    uintptr_t irq_flags = local_irq_save();
+    counters_fold(p);
+    p->evtsel[slot] = evtsel;
+    p->count[slot] = 0;
+    counters_load(p);
+    task->perf = p;
+    local_irq_restore(irq_flags);
+    return 0;
+}
+
+static int32_t perf_read(tcb_t *task, userptr_t buf, uint32_t size) {
+    uint32_t n = size / sizeof(uint64_t);
+    if (n > s_counters) n = s_counters;
+    if (n == 0) return 0;
+    if (!access_ok(VERIFY_WRITE, buf, n * sizeof(uint64_t))) return -EFAULT;
+    uint64_t counts[PERF_MAX_COUNTERS] = { 0 };
+    perf_task_t *p = task->perf;
+    if (p) {
+        uintptr_t irq_flags = local_irq_save();
+        counters_fold(p);
+        memcpy(counts, p->count, sizeof(counts));
+        counters_load(p);
+        local_irq_restore(irq_flags);
+    }
+    if (__copy_to_user(buf, (const_kernelptr_t)counts, n * sizeof(uint64_t)) != 0) return -EFAULT;
+    return (int32_t)(n * sizeof(uint64_t));
+}
+
+int32_t perf_ctl(tcb_t *task, uint32_t op, uint32_t arg2, uint32_t arg3) {
+    perf_task_t *p = task->perf;
+    uintptr_t irq_flags;
+    switch (op) {
+    case PERF_QUERY:
+        return (int32_t)s_counters;
+    case PERF_SET:
+        return perf_set(task, arg2, arg3);
+    case PERF_READ:
+        return perf_read(task, (userptr_t)arg2, arg3);
+    case PERF_RESET:
+        if (!p) return 0;
+        irq_flags = local_irq_save();
+        counters_fold(p);
+        memset(p->count, 0, sizeof(p->count));
+        counters_load(p);
+        local_irq_restore(irq_flags);
+        return 0;
+    case PERF_CLOSE:
+        if (!p) return 0;
+        irq_flags = local_irq_save();
+        counters_fold(p);
+        task->perf = NULL;
+        local_irq_restore(irq_flags);
+        kfree(p);
+        return 0;
+    default:
+        return -EINVAL;
+    }
+}
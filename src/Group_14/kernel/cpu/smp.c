@@ -0,0 +1,204 @@
+/**
+ * @file smp.c
+ * @brief Application processor start-up (INIT/SIPI) and inter-processor interrupts.
+ */
+
+#include <kernel/cpu/smp.h>
+#include <kernel/cpu/acpi.h>
+#include <kernel/cpu/lapic.h>
+#include <kernel/cpu/ioapic.h>
+#include <kernel/cpu/gdt.h>
+#include <kernel/cpu/idt.h>
+#include <kernel/cpu/get_cpu_id.h>
+#include <kernel/cpu/syscall.h>
+#include <kernel/cpu/perf.h>
+#include <kernel/process/scheduler.h>
+#include <kernel/memory/kmalloc.h>
+#include <kernel/memory/paging.h>
+#include <kernel/memory/tlb.h>
+#include <kernel/drivers/timer/pit.h>
+#include <kernel/drivers/timer/tick.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/lib/string.h>
+#include <kernel/lib/assert.h>
+#include <kernel/drivers/display/serial.h>
+
+#define SMP_INFO(fmt, ...)  serial_printf("[SMP  INFO ] " fmt "\n", ##__VA_ARGS__)
+#define SMP_ERROR(fmt, ...) serial_printf("[SMP  ERROR] %s:%d: " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
+
+#define AP_TRAMPOLINE_PHYS      0x8000   // Must match ap_trampoline.asm; reserved low memory
+#define AP_BOOT_STACK_SIZE      8192     // Only used until the AP switches to its idle task
+#define AP_INIT_DELAY_US        10000
+#define AP_SIPI_DELAY_US        200
+#define AP_START_TIMEOUT_MS     100
+
+/** @brief Filled in by the BSP inside the copied trampoline (see ap_trampoline.asm). */
+typedef struct __attribute__((packed)) ap_trampoline_params {
+    uint32_t cr0;
+    uint32_t cr3;
+    uint32_t cr4;
+    uint32_t stack;
+    uint32_t entry;
+    uint32_t cpu_index;
+} ap_trampoline_params_t;
+
+extern uint8_t ap_trampoline_start[];
+extern uint8_t ap_trampoline_end[];
+extern uint8_t ap_trampoline_params[];
+
+static uint8_t           s_cpu_apic_id[MAX_CPUS];  // Logical index -> APIC ID
+static volatile uint32_t s_cpus_online = 1;
+static volatile bool     s_ap_ready = false;
+static uint32_t          s_lapic_counts_per_tick = 0;
+static bool              s_smp_active = false;
+
+//============================================================================
+// Helpers
+//============================================================================
+static inline uint32_t read_cr0(void) {
+    uint32_t v;
+    asm volatile("mov %%cr0, %0" : "=r"(v));
+    return v;
+}
+
+static inline uint32_t read_cr4(void) {
+    uint32_t v;
+    asm volatile("mov %%cr4, %0" : "=r"(v));
+    return v;
+}
+
+//============================================================================
+// AP Entry
+//============================================================================
+/** @brief Called by the trampoline on the AP's boot stack with paging enabled. */
+static __attribute__((noreturn, used)) void smp_ap_main(uint32_t cpu_index) {
+    gdt_init_cpu(cpu_index);
+    idt_load();
+    lapic_enable(false);
+    syscall_init_cpu(cpu_index);
+    tlb_init_cpu(cpu_index);
+    perf_init_cpu();
+    scheduler_init_cpu(cpu_index);
+
+    asm volatile("lock incl %0" : "+m"(s_cpus_online) : : "memory", "cc");
+    s_ap_ready = true;
+
+    while (!g_scheduler_ready) {
+        asm volatile("pause");
+    }
+    lapic_timer_start_periodic(s_lapic_counts_per_tick);
+    scheduler_start_cpu();
+}
+
+/**
+ * @brief Starts one AP with the INIT, STARTUP, STARTUP sequence and waits
+ * for it to report in from smp_ap_main().
+ */
+static bool smp_start_ap(uint32_t cpu_index, uint8_t apic_id) {
+    uint8_t *stack = (uint8_t *)kmalloc(AP_BOOT_STACK_SIZE);
+    if (!stack) {
+        SMP_ERROR("No memory for boot stack of CPU %lu", (unsigned long)cpu_index);
+        return false;
+    }
+
+    ap_trampoline_params_t *params = (ap_trampoline_params_t *)
+        (AP_TRAMPOLINE_PHYS + (uintptr_t)(ap_trampoline_params - ap_trampoline_start));
+    params->cr0 = read_cr0();
+    params->cr3 = g_kernel_page_directory_phys;
+    params->cr4 = read_cr4();
+    params->stack = ((uintptr_t)stack + AP_BOOT_STACK_SIZE) & ~(uintptr_t)15;
+    params->entry = (uint32_t)(uintptr_t)smp_ap_main;
+    params->cpu_index = cpu_index;
+
+    // The AP learns its index from the trampoline; gdt_init_cpu() then
+    // publishes it in the AP's per-CPU area for get_cpu_id().
+    s_cpu_apic_id[cpu_index] = apic_id;
+    s_ap_ready = false;
+    asm volatile("" ::: "memory");
+
+    lapic_send_init(apic_id);
+    pit_delay_us(AP_INIT_DELAY_US);
+    for (int attempt = 0; attempt < 2 && !s_ap_ready; attempt++) {
+        lapic_send_startup(apic_id, (uint8_t)(AP_TRAMPOLINE_PHYS >> 12));
+        pit_delay_us(AP_SIPI_DELAY_US);
+    }
+    for (uint32_t ms = 0; ms < AP_START_TIMEOUT_MS && !s_ap_ready; ms++) {
+        pit_delay_us(1000);
+    }
+
+    if (!s_ap_ready) {
+        // The stack stays allocated in case the AP is merely slow.
+        SMP_ERROR("CPU %lu (APIC ID %u) did not start", (unsigned long)cpu_index, apic_id);
+        return false;
+    }
+    SMP_INFO("CPU %lu (APIC ID %u) started", (unsigned long)cpu_index, apic_id);
+    return true;
+}
+
+//============================================================================
+// Public API
+//============================================================================
+void smp_init(void) {
+    if (!acpi_init()) return;
+    const acpi_madt_info_t *madt = acpi_get_madt();
+    if (!lapic_init(madt->lapic_phys)) return;
+
+    uint8_t bsp_apic_id = lapic_id();
+    s_cpu_apic_id[0] = bsp_apic_id;
+    lapic_enable(true);
+
+    tlb_init_cpu(0);
+    s_lapic_counts_per_tick = lapic_timer_calibrate(TARGET_FREQUENCY);
+
+    // The BSP is ticked by its own APIC timer from here on, like the APs.
+    // With an I/O APIC the device IRQs follow and the 8259 is retired;
+    // otherwise they keep arriving through the PIC and LINT0.
+    tick_use_lapic(s_lapic_counts_per_tick);
+    if (ioapic_init()) {
+        if (!idt_route_irqs_via_ioapic(bsp_apic_id)) {
+            SMP_ERROR("I/O APIC routing failed; legacy IRQs stay on the 8259 PIC");
+        }
+    }
+
+    if (madt->cpu_count < 2) {
+        SMP_INFO("Single CPU reported by the MADT; staying uniprocessor.");
+        return;
+    }
+
+    size_t tramp_size = (size_t)(ap_trampoline_end - ap_trampoline_start);
+    KERNEL_ASSERT(tramp_size <= PAGE_SIZE, "AP trampoline larger than one page");
+    memcpy((void *)AP_TRAMPOLINE_PHYS, ap_trampoline_start, tramp_size);
+    s_smp_active = true;
+
+    // Indices are handed out in MADT order and never reused, so an AP that
+    // reports in late still owns a unique slot.
+    uint32_t next_index = 1;
+    for (uint32_t i = 0; i < madt->cpu_count; i++) {
+        uint8_t apic_id = madt->cpu_apic_ids[i];
+        if (apic_id == bsp_apic_id) continue;
+        if (next_index >= MAX_CPUS) {
+            SMP_INFO("MAX_CPUS (%d) reached; ignoring remaining processors.", MAX_CPUS);
+            break;
+        }
+        smp_start_ap(next_index++, apic_id);
+    }
+
+    SMP_INFO("%lu of %lu CPU(s) online", (unsigned long)s_cpus_online, (unsigned long)madt->cpu_count);
+}
+
+uint32_t smp_cpu_count(void) {
+    return s_cpus_online;
+}
+
+void smp_send_reschedule(uint32_t cpu_index) {
+    smp_send_ipi(cpu_index, IPI_RESCHEDULE_VECTOR);
+}
+
+void smp_send_ipi(uint32_t cpu_index, uint8_t vector) {
+    if (!s_smp_active || cpu_index >= MAX_CPUS) return;
+    uintptr_t irq_flags = local_irq_save(); // ICR_HI/ICR_LO must not be split by an IRQ
+    if ((int)cpu_index != get_cpu_id()) {
+        lapic_send_ipi(s_cpu_apic_id[cpu_index], vector);
+    }
+    local_irq_restore(irq_flags);
+}
@@ -0,0 +1,46 @@
+/**
+ * @file softirq.c
+ * @brief Per-CPU deferred interrupt work, run on interrupt exit.
+ */
+
+#include <kernel/cpu/softirq.h>
+#include <kernel/cpu/percpu.h>
+#include <kernel/sync/spinlock.h> // local_irq_save/restore
+#include <kernel/lib/assert.h>
+
+#define SOFTIRQ_MAX_PASSES 4 // Re-raised work beyond this waits for the next interrupt
+
+static softirq_handler_t s_handlers[SOFTIRQ_COUNT];
+
+void softirq_register(uint32_t nr, softirq_handler_t handler) {
+    KERNEL_ASSERT(nr < SOFTIRQ_COUNT && handler != NULL, "softirq_register: bad softirq");
+    s_handlers[nr] = handler;
+}
+
+void softirq_raise(uint32_t nr) {
+    uintptr_t flags = local_irq_save(); // The bits belong to this CPU
+    percpu_write(softirq_pending, percpu_read(softirq_pending) | (1u << nr));
+    local_irq_restore(flags);
+}
+
+void softirq_run_pending(void) {
+    if (percpu_read(softirq_active) || !percpu_read(softirq_pending)) return;
+
+    percpu_write(softirq_active, 1);
+    for (int pass = 0; pass < SOFTIRQ_MAX_PASSES; pass++) {
+        uint32_t pending = percpu_read(softirq_pending);
+        if (!pending) break;
+        percpu_write(softirq_pending, 0);
+
+        asm volatile("sti" ::: "memory");
+        for (uint32_t nr = 0; pending; nr++, pending >>= 1) {
+            if ((pending & 1) && s_handlers[nr]) s_handlers[nr]();
+        }
+        asm volatile("cli" ::: "memory");
+    }
+    percpu_write(softirq_active, 0);
+}
+
+bool softirq_in_progress(void) {
+    return percpu_read(softirq_active) != 0;
+}
@@ -41,17 +41,24 @@
 ; -----------------------------------------------------------------------------
 
 %define KERNEL_DATA_SELECTOR 0x10
-; USER_DATA_SELECTOR is not directly used here, but defined for completeness if needed.
-; %define USER_DATA_SELECTOR   0x23
+%define KERNEL_PERCPU_SELECTOR 0x30 ; GDT_PERCPU_SELECTOR, kept in FS while in the kernel
+%define USER_CODE_SELECTOR   0x1B   ; GDT_USER_CODE_SELECTOR (SYSEXIT derives the same from SYSENTER_CS)
+%define USER_DATA_SELECTOR   0x23   ; GDT_USER_DATA_SELECTOR
+%define EFLAGS_IF            0x200
+%define EFLAGS_TF            0x100
+%define EFLAGS_NT            0x4000
+%define EFLAGS_FIXED         0x2    ; Bit 1 always reads as 1
+%define PERCPU_NEED_RESCHED  44     ; PERCPU_NEED_RESCHED_OFFSET: percpu_t.need_resched, via FS
 
     extern syscall_dispatcher     ; C-level syscall handler
     extern schedule             ; <<< ADDED: External C scheduler function
-    extern g_need_reschedule    ; <<< ADDED: External C reschedule flag variable (volatile bool -> byte)
     ; extern serial_putc_asm        ; Optional: for ultra-low-level debug
     ; extern serial_print_hex_asm   ; Optional: for ultra-low-level debug
 
     section .text
     global syscall_handler_asm
+    global sysenter_entry_asm
+    global sysenter_flags_clean
 
 syscall_handler_asm:
     ; --- 1. Construct part of the isr_frame_t: Push error code (dummy) and int_no ---
@@ -73,8 +80,10 @@ syscall_handler_asm:
     mov ax, KERNEL_DATA_SELECTOR
     mov ds, ax
     mov es, ax
-    mov fs, ax
     mov gs, ax
+    mov ax, KERNEL_PERCPU_SELECTOR
+    mov fs, ax
+    cld                     ; C code (rep movs/stos in memcpy) assumes DF=0; user code may set it
 
     ; --- 5. Call C-level Dispatcher ---
     mov eax, esp            ; EAX = pointer to the on-stack isr_frame_t
@@ -87,15 +96,14 @@ syscall_handler_asm:
     ; --- 6. Store Syscall Return Value into the Stack Frame ---
     mov [esp + 28], eax     ; Write return value into the EAX slot of the PUSHA frame
 
-    ; --- *** 7. CHECK RESCHEDULE FLAG (Interrupts are still OFF from int 0x80) *** ---
+    ; --- *** 7. CHECK RESCHEDULE FLAG (Interrupts OFF again: the dispatcher only enables them around the handler) *** ---
 check_reschedule:
-    ; Access the global C variable (byte for bool)
-    mov al, byte [g_need_reschedule]
-    test al, al                      ; Check if the flag is non-zero
-    jz .no_reschedule_needed         ; If zero, skip the schedule call
+    ; This CPU's flag, through the per-CPU segment loaded above
+    cmp dword [fs:PERCPU_NEED_RESCHED], 0
+    je .no_reschedule_needed         ; If zero, skip the schedule call
 
     ; Reschedule is needed:
-    mov byte [g_need_reschedule], 0  ; Clear the flag (no lock needed, IF=0)
+    mov dword [fs:PERCPU_NEED_RESCHED], 0 ; Clear the flag (no lock needed, IF=0)
     call schedule                    ; Call the C scheduler function. It handles context switch.
 
 .no_reschedule_needed:
@@ -112,3 +120,87 @@ check_reschedule:
     ; --- 10. Return to User Mode ---
     iret                    ; Pops EIP_user, CS_user, EFLAGS_user, [ESP_user], [SS_user]
                             ; Returns control to the user process with EAX holding the result.
+
+; -----------------------------------------------------------------------------
+; sysenter_entry_asm -- SYSENTER fast path (see syscall_init_cpu in syscall.c)
+;
+; User ABI: EAX = number, EBX/ECX/EDX = args, ESI = return EIP, EBP = user ESP.
+; SYSENTER loads CS/SS = kernel, EIP = this label, ESP = the CPU's entry stack
+; (whose top word is &TSS.esp0) and clears IF; nothing of the user context is
+; saved by the CPU. The stub builds the same isr_frame_t as the int 0x80 path
+; (so handlers may inspect or rewrite it), then leaves with SYSEXIT using the
+; frame's EIP/ESP. ECX and EDX are consumed by SYSEXIT and therefore clobbered
+; for the caller.
+;
+; SYSENTER keeps TF and NT, which an interrupt gate would have cleared: the
+; stub saves the user's EFLAGS and clears them before anything else runs, and
+; a frame carrying either leaves through IRET, since SYSEXIT would take the
+; single-step trap in ring 0. Until sysenter_flags_clean, a user TF raises #DB
+; on every instruction; debug_handler (syscall.c) drops those.
+; -----------------------------------------------------------------------------
+sysenter_entry_asm:
+    mov esp, [esp]          ; Entry stack top holds &TSS.esp0
+    mov esp, [esp]          ; Switch to the task's kernel stack
+
+    ; --- 1. Synthesize the hardware part of a ring-3 trap frame ---
+    push dword USER_DATA_SELECTOR   ; SS_user
+    push ebp                        ; ESP_user
+    pushfd
+    or dword [esp], EFLAGS_IF       ; User code runs with IF=1; SYSENTER cleared it
+    push dword EFLAGS_FIXED
+    popfd                           ; TF, NT, AC, DF off for the kernel
+sysenter_flags_clean:
+    push dword USER_CODE_SELECTOR   ; CS_user
+    push esi                        ; EIP_user (return address)
+    push dword 0                    ; Dummy Error Code
+    push dword 0x80                 ; Same int_no as the gate, for handlers that look
+
+    ; --- 2. Save segments and GPRs exactly like syscall_handler_asm ---
+    push ds
+    push es
+    push fs
+    push gs
+    pusha
+
+    mov ax, KERNEL_DATA_SELECTOR
+    mov ds, ax
+    mov es, ax
+    mov gs, ax
+    mov ax, KERNEL_PERCPU_SELECTOR
+    mov fs, ax
+    cld
+
+    ; --- 3. Dispatch ---
+    mov eax, esp
+    push eax
+    call syscall_dispatcher
+    add  esp, 4
+    mov [esp + 28], eax     ; Return value into the EAX slot of the PUSHA frame
+
+    ; --- 4. Reschedule check (IF 0 again after the dispatcher) ---
+    cmp dword [fs:PERCPU_NEED_RESCHED], 0
+    je .sysenter_no_resched
+    mov dword [fs:PERCPU_NEED_RESCHED], 0
+    call schedule
+
+.sysenter_no_resched:
+    ; --- 5. Restore and leave through SYSEXIT (EIP <- EDX, ESP <- ECX) ---
+    popa
+    pop gs
+    pop fs
+    pop es
+    pop ds
+    add esp, 8              ; int_no, err_code
+    test dword [esp + 8], EFLAGS_TF | EFLAGS_NT
+    jnz .sysenter_iret      ; Restore them through IRET (NT is clear now, so no task return)
+    pop edx                 ; EIP_user
+    add esp, 4              ; CS_user
+    and dword [esp], ~EFLAGS_IF ; Keep IF off until the STI below
+    popfd
+    pop ecx                 ; ESP_user
+    add esp, 4              ; SS_user
+    sti                     ; Interrupt shadow: IF takes effect after SYSEXIT
+    sysexit
+
+.sysenter_iret:
+    iret                    ; The frame is a complete ring-3 IRET frame
@@ -8,6 +8,7 @@
 // --- Includes ---
 #include <kernel/cpu/syscall.h>
 #include <kernel/drivers/display/terminal.h>
+#include <kernel/drivers/input/tty.h>
 #include <kernel/process/process.h>
 #include <kernel/process/scheduler.h>
 #include <kernel/fs/vfs/sys_file.h>
@@ -17,9 +18,30 @@
 #include <kernel/fs/vfs/fs_errno.h>
 #include <kernel/fs/vfs/fs_limits.h>
 #include <kernel/fs/vfs/vfs.h>
+#include <kernel/fs/vfs/io_ring.h>
+#include <kernel/fs/vfs/poll.h>
+#include <kernel/fs/vfs/pipe.h>
+#include <kernel/sync/futex.h>
+#include <kernel/sync/preempt.h>
 #include <kernel/lib/assert.h>
 #include <kernel/drivers/display/serial.h>
 #include <kernel/memory/paging.h>
+#include <kernel/memory/mm.h>
+#include <kernel/memory/shm.h>
+#include <kernel/memory/frame.h>
+#include <kernel/cpu/msr.h>
+#include <kernel/cpu/tss.h>
+#include <kernel/cpu/gdt.h>
+#include <kernel/cpu/idt.h>
+#include <kernel/cpu/get_cpu_id.h>
+#include <kernel/cpu/syscall_stats.h>
+#include <kernel/cpu/irq_stats.h>
+#include <kernel/core/profiler.h>
+#include <kernel/core/tracepoint.h>
+#include <kernel/cpu/perf.h>
+#include <kernel/cpu/tsc.h>
+#include <kernel/drivers/timer/clock.h>
+#include <kernel/drivers/storage/block_device.h>
 #include <libc/limits.h>
 #include <libc/stdbool.h>
 #include <libc/stddef.h>
@@ -40,6 +62,12 @@
 #endif
 #define MAX_RW_CHUNK_SIZE PAGE_SIZE
 #endif
+#ifndef USER_IO_MAX_RUN
+#define USER_IO_MAX_RUN 16 // Pinned user pages one VFS call may cover (read/write paths)
+#endif
+#ifndef MAX_COPY_CHUNK_SIZE
+#define MAX_COPY_CHUNK_SIZE (8 * MAX_RW_CHUNK_SIZE) // sendfile/copy_file_range: no user copies, so go bigger
+#endif
 #ifndef MAX_INPUT_LENGTH
 #define MAX_INPUT_LENGTH 256 // Should match terminal.h
 #endif
@@ -50,9 +78,32 @@
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 #endif
 
+#define CPUID_FEATURE_SEP (1u << 11) // CPUID.1:EDX - SYSENTER/SYSEXIT
+#define DEBUG_VECTOR      1
+#define SYSENTER_STACK_WORDS 256   // Room for a #DB or NMI taken on the entry instruction
+
 // --- Static Data ---
 static syscall_fn_t syscall_table[MAX_SYSCALLS];
 
+// SYSENTER entry stub (syscall.asm); EFLAGS.TF and NT are clear from sysenter_flags_clean on
+extern void sysenter_entry_asm(void);
+extern void sysenter_flags_clean(void);
+
+/**
+ * SYSENTER_ESP target. SYSENTER leaves TF set, so a user that single-steps
+ * into it takes #DB on the entry instruction, before the stub has switched
+ * stacks; that frame lands here. The top word points at the CPU's TSS.esp0,
+ * from which the stub loads the task's kernel stack.
+ */
+typedef struct {
+    uint32_t  stack[SYSENTER_STACK_WORDS];
+    uintptr_t tss_esp0;   // Address of the CPU's TSS.esp0
+} __attribute__((aligned(16))) sysenter_stack_t;
+
+static sysenter_stack_t s_sysenter_stack[MAX_CPUS];
+
+static void debug_handler(isr_frame_t *frame);
+
 // --- Forward Declarations of Syscall Implementations ---
 static int32_t sys_exit_impl(uint32_t code, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
 static int32_t sys_read_impl(uint32_t fd, uint32_t user_buf_ptr, uint32_t count, isr_frame_t *regs);
@@ -65,6 +116,43 @@ static int32_t sys_puts_impl(uint32_t user_str_ptr, uint32_t arg2, uint32_t arg3
 static int32_t sys_not_implemented(uint32_t arg1, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
 static int strncpy_from_user_safe(const_userptr_t u_src, char *k_dst, size_t maxlen);
 static int32_t sys_read_terminal_line_impl(uint32_t user_buf_ptr, uint32_t count, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_sched_stats_impl(uint32_t pid, uint32_t user_buf_ptr, uint32_t size, isr_frame_t *regs);
+static int32_t sys_clock_gettime_impl(uint32_t clock_id, uint32_t user_ts_ptr, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_fork_impl(uint32_t arg1, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_waitpid_impl(uint32_t pid, uint32_t user_status_ptr, uint32_t options, isr_frame_t *regs);
+static int32_t sys_mmap_impl(uint32_t user_args_ptr, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_munmap_impl(uint32_t addr, uint32_t length, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_brk_impl(uint32_t brk, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_block_stats_impl(uint32_t index, uint32_t user_buf_ptr, uint32_t size, isr_frame_t *regs);
+static int32_t sys_getdents_impl(uint32_t fd, uint32_t user_buf_ptr, uint32_t count, isr_frame_t *regs);
+static int32_t sys_pread_impl(uint32_t fd, uint32_t user_args_ptr, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_pwrite_impl(uint32_t fd, uint32_t user_args_ptr, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_readv_impl(uint32_t fd, uint32_t user_iov_ptr, uint32_t iovcnt, isr_frame_t *regs);
+static int32_t sys_writev_impl(uint32_t fd, uint32_t user_iov_ptr, uint32_t iovcnt, isr_frame_t *regs);
+static int32_t sys_sendfile_impl(uint32_t user_args_ptr, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_copy_file_range_impl(uint32_t user_args_ptr, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_io_setup_impl(uint32_t user_args_ptr, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_io_enter_impl(uint32_t to_submit, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_stat_impl(uint32_t user_pathname_ptr, uint32_t user_stat_ptr, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_fstat_impl(uint32_t fd, uint32_t user_stat_ptr, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_unlink_impl(uint32_t user_pathname_ptr, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_fsync_impl(uint32_t fd, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_fdatasync_impl(uint32_t fd, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_syscall_stats_impl(uint32_t nr, uint32_t user_buf_ptr, uint32_t size, isr_frame_t *regs);
+static int32_t sys_strace_impl(uint32_t op, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_batch_impl(uint32_t user_recs_ptr, uint32_t count, uint32_t flags, isr_frame_t *regs);
+static int32_t sys_poll_impl(uint32_t user_fds_ptr, uint32_t nfds, uint32_t timeout_arg, isr_frame_t *regs);
+static int32_t sys_pipe_impl(uint32_t user_fds_ptr, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_shm_open_impl(uint32_t user_name_ptr, uint32_t oflag, uint32_t size, isr_frame_t *regs);
+static int32_t sys_shm_unlink_impl(uint32_t user_name_ptr, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_futex_impl(uint32_t uaddr, uint32_t op, uint32_t val, isr_frame_t *regs);
+static int32_t sys_thread_create_impl(uint32_t entry, uint32_t stack_top, uint32_t arg, isr_frame_t *regs);
+static int32_t sys_spawn_impl(uint32_t user_args_ptr, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_tty_mode_impl(uint32_t mode, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_irq_stats_impl(uint32_t vector, uint32_t user_buf_ptr, uint32_t size, isr_frame_t *regs);
+static int32_t sys_profile_impl(uint32_t op, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_perf_impl(uint32_t op, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
+static int32_t sys_tracepoint_impl(uint32_t op, uint32_t arg2, uint32_t arg3, isr_frame_t *regs);
 
 
 
@@ -85,9 +173,96 @@ void syscall_init(void) {
     syscall_table[SYS_GETPID] = sys_getpid_impl;
     syscall_table[SYS_PUTS]   = sys_puts_impl;
     syscall_table[SYS_READ_TERMINAL_LINE] = sys_read_terminal_line_impl;
+    syscall_table[SYS_SCHED_STATS] = sys_sched_stats_impl;
+    syscall_table[SYS_CLOCK_GETTIME] = sys_clock_gettime_impl;
+    syscall_table[SYS_FORK]   = sys_fork_impl;
+    syscall_table[SYS_WAITPID] = sys_waitpid_impl;
+    syscall_table[SYS_MMAP]   = sys_mmap_impl;
+    syscall_table[SYS_MUNMAP] = sys_munmap_impl;
+    syscall_table[SYS_BRK]    = sys_brk_impl;
+    syscall_table[SYS_BLOCK_STATS] = sys_block_stats_impl;
+    syscall_table[SYS_GETDENTS] = sys_getdents_impl;
+    syscall_table[SYS_PREAD]  = sys_pread_impl;
+    syscall_table[SYS_PWRITE] = sys_pwrite_impl;
+    syscall_table[SYS_READV]  = sys_readv_impl;
+    syscall_table[SYS_WRITEV] = sys_writev_impl;
+    syscall_table[SYS_SENDFILE] = sys_sendfile_impl;
+    syscall_table[SYS_COPY_FILE_RANGE] = sys_copy_file_range_impl;
+    syscall_table[SYS_IO_SETUP] = sys_io_setup_impl;
+    syscall_table[SYS_IO_ENTER] = sys_io_enter_impl;
+    syscall_table[SYS_STAT]   = sys_stat_impl;
+    syscall_table[SYS_FSTAT]  = sys_fstat_impl;
+    syscall_table[SYS_SYSCALL_STATS] = sys_syscall_stats_impl;
+    syscall_table[SYS_STRACE] = sys_strace_impl;
+    syscall_table[SYS_BATCH]  = sys_batch_impl;
+    syscall_table[SYS_POLL]   = sys_poll_impl;
+    syscall_table[SYS_PIPE]   = sys_pipe_impl;
+    syscall_table[SYS_SHM_OPEN]   = sys_shm_open_impl;
+    syscall_table[SYS_SHM_UNLINK] = sys_shm_unlink_impl;
+    syscall_table[SYS_FUTEX]  = sys_futex_impl;
+    syscall_table[SYS_THREAD_CREATE] = sys_thread_create_impl;
+    syscall_table[SYS_SPAWN]  = sys_spawn_impl;
+    syscall_table[SYS_TTY_MODE] = sys_tty_mode_impl;
+    syscall_table[SYS_IRQ_STATS] = sys_irq_stats_impl;
+    syscall_table[SYS_PROFILE] = sys_profile_impl;
+    syscall_table[SYS_PERF]    = sys_perf_impl;
+    syscall_table[SYS_TRACEPOINT] = sys_tracepoint_impl;
+    syscall_table[SYS_UNLINK]  = sys_unlink_impl;
+    syscall_table[SYS_FSYNC]   = sys_fsync_impl;
+    syscall_table[SYS_FDATASYNC] = sys_fdatasync_impl;
 
     KERNEL_ASSERT(syscall_table[SYS_EXIT] == sys_exit_impl, "SYS_EXIT assignment sanity check failed!");
     serial_write("[Syscall] Table initialized.\n");
+    register_int_handler(DEBUG_VECTOR, debug_handler, NULL);
+    syscall_init_cpu(0);
+}
+
+/**
+ * @brief True if SYSENTER/SYSEXIT work on this CPU. Early Pentium Pro parts
+ * (family 6, model < 3, stepping < 3) report SEP without implementing it.
+ */
+static bool cpu_has_sysenter(void) {
+    uint32_t eax, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+    if (!(edx & CPUID_FEATURE_SEP)) return false;
+    uint32_t family = (eax >> 8) & 0xF, model = (eax >> 4) & 0xF, stepping = eax & 0xF;
+    return !(family == 6 && model < 3 && stepping < 3);
+}
+
+/**
+ * @brief #DB handler. Single-step traps between sysenter_entry_asm and the
+ * point where the stub clears TF are the user's own TF carried across
+ * SYSENTER; the stub saves it and the exit path restores it, so they are
+ * dropped. A user task that single-steps has no debugger to report to and is
+ * terminated; a #DB anywhere else in the kernel is a bug.
+ */
+static void debug_handler(isr_frame_t *frame) {
+    if ((frame->cs & 0x3) == 0) {
+        if (frame->eip >= (uint32_t)(uintptr_t)sysenter_entry_asm &&
+            frame->eip <= (uint32_t)(uintptr_t)sysenter_flags_clean) {
+            return;
+        }
+        default_isr_handler(frame);
+        return;
+    }
+    serial_write("[Syscall] Debug trap in user mode; terminating task.\n");
+    remove_current_task_with_code(0xDEAD0001);
+}
+
+void syscall_init_cpu(uint32_t cpu) {
+    if (!cpu_has_sysenter()) {
+        if (cpu == 0) serial_write("[Syscall] SYSENTER not supported; int 0x80 only.\n");
+        return;
+    }
+    // SYSENTER_ESP points at a small per-CPU entry stack whose top word holds
+    // &TSS.esp0: the stub loads the current task's kernel stack top through
+    // it, so context switches need no MSR writes.
+    sysenter_stack_t *entry = &s_sysenter_stack[cpu];
+    entry->tss_esp0 = (uintptr_t)&tss_get_entry(cpu)->esp0;
+    wrmsr(MSR_IA32_SYSENTER_CS, KERNEL_CODE_SELECTOR);
+    wrmsr(MSR_IA32_SYSENTER_ESP, (uint32_t)(uintptr_t)&entry->tss_esp0);
+    wrmsr(MSR_IA32_SYSENTER_EIP, (uint32_t)(uintptr_t)sysenter_entry_asm);
+    if (cpu == 0) serial_write("[Syscall] SYSENTER fast path enabled.\n");
 }
 
 //-----------------------------------------------------------------------------
@@ -102,25 +277,21 @@ static int strncpy_from_user_safe(const_userptr_t u_src, char *k_dst, size_t max
     if (!u_src || (uintptr_t)u_src >= KERNEL_SPACE_VIRT_START) {
         return -EFAULT;
     }
-    // access_ok is called by copy_from_user, no need to duplicate here if copy_from_user is robust.
-    // However, checking for at least 1 byte readability upfront can be a quick filter.
-    if (!access_ok(VERIFY_READ, u_src, 1)) { // Check at least one byte can be touched by access_ok
-        return -EFAULT;
-    }
-
+    // Copy up to the end of each user page in one go: access rights only change
+    // at page boundaries, so a chunk never reaches past the page holding the NUL
     size_t len = 0;
-    while (len < maxlen -1) { // Leave space for null terminator
-        char current_char;
-        // Cast u_src for pointer arithmetic if needed by copy_from_user's second param type if it's just `const void*`
-        if (copy_from_user((kernelptr_t)&current_char, (const_userptr_t)((const char*)u_src + len), 1) != 0) {
+    while (len < maxlen - 1) { // Leave space for null terminator
+        const char *at = (const char *)u_src + len;
+        size_t chunk = MIN(PAGE_SIZE - ((uintptr_t)at & (PAGE_SIZE - 1)), maxlen - 1 - len);
+        if (!access_ok(VERIFY_READ, (const_userptr_t)at, chunk) ||
+            __copy_from_user((kernelptr_t)(k_dst + len), (const_userptr_t)at, chunk) != 0) {
             k_dst[len] = '\0'; // Null-terminate on partial copy due to fault
             return -EFAULT;
         }
-        k_dst[len] = current_char;
-        if (current_char == '\0') {
+        if (memchr(k_dst + len, '\0', chunk)) {
             return 0; // Success, null terminator copied
         }
-        len++;
+        len += chunk;
     }
 
     k_dst[len] = '\0'; // Maxlen-1 chars copied, ensure null termination
@@ -157,149 +328,594 @@ static int32_t sys_exit_impl(uint32_t code, uint32_t arg2, uint32_t arg3, isr_fr
     return 0;
 }
 
+/**
+ * @brief read_terminal_line(buf, count): one line of terminal input (see
+ * tty_read()) without its newline, NUL-terminated; at most count - 1 bytes.
+ */
 static int32_t sys_read_terminal_line_impl(uint32_t user_buf_ptr, uint32_t count_arg, uint32_t arg3, isr_frame_t *regs) {
     (void)arg3; (void)regs;
-
     userptr_t user_buf = (userptr_t)user_buf_ptr;
     size_t count = (size_t)count_arg;
-    ssize_t bytes_read_for_user = 0; // Actual number of chars (excl NUL) for user
-    char* k_line_buffer = NULL;
 
-    if (count == 0) return -EINVAL; 
+    if (count == 0) return -EINVAL;
     if (!access_ok(VERIFY_WRITE, user_buf, count)) return -EFAULT;
 
-    size_t kernel_buffer_size = MIN(count > 0 ? count : MAX_INPUT_LENGTH, MAX_INPUT_LENGTH);
-    if (kernel_buffer_size == 0) kernel_buffer_size = 1;
+    char line[MAX_INPUT_LENGTH];
+    ssize_t n = tty_read(line, MIN(count, sizeof(line)) - 1);
+    if (n < 0) return (int32_t)n;
+    if (n > 0 && line[n - 1] == '\n') n--;
+    line[n] = '\0';
+    if (copy_to_user(user_buf, (const_kernelptr_t)line, (size_t)n + 1) != 0) return -EFAULT;
+    return (int32_t)n;
+}
 
-    k_line_buffer = kmalloc(kernel_buffer_size);
-    if (!k_line_buffer) return -ENOMEM;
+/**
+ * @brief True if @p fd is the terminal: 0-2 with no file opened over them.
+ */
+static bool fd_is_terminal(int fd) {
+    if (fd < STDIN_FILENO || fd > STDERR_FILENO) return false;
+    sys_file_t *sf = sys_file_get_fd(fd);
+    if (!sf) return true;
+    sys_file_put(sf);
+    return false;
+}
 
-    ssize_t bytes_from_terminal_device = terminal_read_line_blocking(k_line_buffer, kernel_buffer_size);
+/**
+ * @brief read(0, ...) on the terminal: tty_read() may block, so the bytes
+ * come through a stack buffer rather than the pinned-page path; a read
+ * returns what the TTY had, like a short read on a pipe.
+ */
+static ssize_t tty_read_user(userptr_t user_buf, size_t count) {
+    char kbuf[MAX_INPUT_LENGTH];
+    ssize_t n = tty_read(kbuf, MIN(count, sizeof(kbuf)));
+    if (n > 0 && copy_to_user(user_buf, (const_kernelptr_t)kbuf, (size_t)n) != 0) return -EFAULT;
+    return n;
+}
 
-    if (bytes_from_terminal_device < 0) { 
-        kfree(k_line_buffer);
-        return bytes_from_terminal_device;
-    }
+/** @brief tty_mode(mode): sets the TTY_* bits of tty.h, or only reads them if mode is -1. */
+static int32_t sys_tty_mode_impl(uint32_t mode, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg2; (void)arg3; (void)regs;
+    if ((int32_t)mode == -1) return (int32_t)tty_get_mode();
+    return tty_set_mode(mode);
+}
 
-    bytes_read_for_user = MIN((size_t)bytes_from_terminal_device, count - 1);
 
-    if (copy_to_user(user_buf, (const_kernelptr_t)k_line_buffer, bytes_read_for_user) != 0) {
-        kfree(k_line_buffer);
-        return -EFAULT; 
+/** One transfer between a descriptor and the user pages user_io() pins. */
+typedef struct user_io_req {
+    int          fd;
+    const off_t *pos;   // File position for positioned I/O, or NULL for the fd's own
+    bool         write; // User memory -> file (else file -> user memory)
+} user_io_req_t;
+
+/** @brief Moves @p len bytes between the descriptor and kernel view @p kaddr, @p done bytes in. */
+static ssize_t user_io_chunk(const user_io_req_t *req, void *kaddr, size_t len, size_t done) {
+    if (!req->write) {
+        return req->pos ? sys_pread(req->fd, kaddr, len, *req->pos + (off_t)done)
+                        : sys_read(req->fd, kaddr, len);
+    }
+    if (!req->pos && (req->fd == STDOUT_FILENO || req->fd == STDERR_FILENO)) {
+        terminal_write_bytes((const char *)kaddr, len);
+        return (ssize_t)len;
     }
+    return req->pos ? sys_pwrite(req->fd, kaddr, len, *req->pos + (off_t)done)
+                    : sys_write(req->fd, kaddr, len);
+}
 
-    // Create a null terminator in kernel space
-    char null_terminator = '\0';
-    if (copy_to_user((userptr_t)((char*)user_buf + bytes_read_for_user), (const_kernelptr_t)&null_terminator, 1) != 0) {
-        kfree(k_line_buffer);
-        return -EFAULT; 
+/**
+ * @brief Reads or writes @p count bytes of @p fd straight into or out of the
+ * user range at @p uaddr (already checked with access_ok). The user pages
+ * are pinned and reached through the kernel's own view of their frames, so
+ * the VFS fills or drains them in place: no bounce buffer and no second copy.
+ * Physically adjacent lowmem pages go to the VFS as one call, up to
+ * USER_IO_MAX_RUN pages, so large transfers aren't cut at every page.
+ * Stops at the first short transfer.
+ * @return Bytes moved; a negative errno only if none were.
+ */
+static ssize_t user_io(const user_io_req_t *req, uintptr_t uaddr, size_t count) {
+    // Pipes block, which the kmap_atomic() views below can't; they copy
+    // between the user range and their ring pages themselves
+    if (sys_file_is_pipe(req->fd)) {
+        return req->pos ? -ESPIPE : sys_pipe_io(req->fd, (void *)uaddr, count, req->write, true);
+    }
+    if (!req->write && !req->pos && req->fd == STDIN_FILENO && fd_is_terminal(req->fd)) {
+        return tty_read_user((userptr_t)uaddr, count);
     }
 
-    // Corrected: Move kfree after the serial_write calls that use k_line_buffer
-    serial_write("[Terminal] terminal_read_line_blocking: Copied bytes: '"); 
-    serial_write(k_line_buffer);  
-    serial_write("'\n");           
-    kfree(k_line_buffer); 
+    pcb_t *current_proc = get_current_process();
+    if (!current_proc || !current_proc->mm) return -EFAULT;
+    mm_struct_t *mm = current_proc->mm;
 
-    return (int32_t)bytes_read_for_user; 
+    uintptr_t frames[USER_IO_MAX_RUN];
+    ssize_t total = 0;
+    while ((size_t)total < count) {
+        uintptr_t addr = uaddr + (size_t)total;
+
+        // Pin the longest run of contiguous frames the direct map covers
+        uint32_t nr_frames = 0;
+        size_t run_len = 0;
+        while (nr_frames < USER_IO_MAX_RUN && (size_t)total + run_len < count) {
+            uintptr_t at = addr + run_len;
+            uintptr_t phys = mm_pin_user_page(mm, at, !req->write);
+            if (!phys) break;
+            if (nr_frames > 0 && (phys != frames[nr_frames - 1] + PAGE_SIZE || !paging_phys_is_direct(phys))) {
+                put_frame(phys); // Starts the next run
+                break;
+            }
+            frames[nr_frames++] = phys;
+            run_len += MIN(PAGE_SIZE - (at & (PAGE_SIZE - 1)), count - (size_t)total - run_len);
+            if (!paging_phys_is_direct(phys)) break; // Highmem: one kmap slot, one page
+        }
+        if (nr_frames == 0) {
+            if (total == 0) total = -EFAULT;
+            break;
+        }
+
+        uint8_t *kaddr = (uint8_t *)kmap_atomic(frames[0]);
+        ssize_t moved = user_io_chunk(req, kaddr + (addr & (PAGE_SIZE - 1)), run_len, (size_t)total);
+        kunmap_atomic(kaddr);
+        for (uint32_t i = 0; i < nr_frames; i++) put_frame(frames[i]);
+
+        if (moved <= 0) {
+            if (moved < 0 && total == 0) total = moved;
+            break;
+        }
+        total += moved;
+        if ((size_t)moved < run_len) break;
+    }
+    return total;
 }
 
+static ssize_t read_into_user(int fd, userptr_t user_buf, size_t count, const off_t *pos) {
+    user_io_req_t req = { .fd = fd, .pos = pos, .write = false };
+    return user_io(&req, (uintptr_t)user_buf, count);
+}
+
+static ssize_t write_from_user(int fd, const_userptr_t user_buf, size_t count, const off_t *pos) {
+    user_io_req_t req = { .fd = fd, .pos = pos, .write = true };
+    return user_io(&req, (uintptr_t)user_buf, count);
+}
 
 static int32_t sys_read_impl(uint32_t fd_arg, uint32_t user_buf_ptr, uint32_t count_arg, isr_frame_t *regs) {
     (void)regs;
     int fd = (int)fd_arg;
     userptr_t user_buf = (userptr_t)user_buf_ptr;
     size_t count = (size_t)count_arg;
-    ssize_t total_read = 0;
-    char* kbuf = NULL;
 
     if ((ssize_t)count < 0) return -EINVAL;
     if (count == 0) return 0;
     if (!access_ok(VERIFY_WRITE, user_buf, count)) return -EFAULT;
 
-    size_t chunk_alloc_size = MIN(MAX_RW_CHUNK_SIZE, count);
-    kbuf = kmalloc(chunk_alloc_size);
-    if (!kbuf) return -ENOMEM;
+    return read_into_user(fd, user_buf, count, NULL);
+}
+
+static int32_t sys_write_impl(uint32_t fd_arg, uint32_t user_buf_ptr, uint32_t count_arg, isr_frame_t *regs) {
+    (void)regs;
+    int fd = (int)fd_arg;
+    const_userptr_t user_buf = (const_userptr_t)user_buf_ptr;
+    size_t count = (size_t)count_arg;
 
-    while (total_read < (ssize_t)count) {
-        size_t current_chunk_size = MIN(chunk_alloc_size, count - (size_t)total_read);
-        KERNEL_ASSERT(current_chunk_size > 0, "Read chunk size zero");
+    if ((ssize_t)count < 0) return -EINVAL;
+    if (count == 0) return 0;
+    if (!access_ok(VERIFY_READ, user_buf, count)) return -EFAULT;
 
-        ssize_t bytes_read_this_chunk = sys_read(fd, kbuf, current_chunk_size);
+    return write_from_user(fd, user_buf, count, NULL);
+}
 
-        if (bytes_read_this_chunk < 0) {
-            if (total_read > 0) break;
-            total_read = bytes_read_this_chunk;
-            break;
+/**
+ * @brief pread/pwrite(fd, &args): I/O at args.offset that neither uses nor
+ * moves the descriptor's position, so tasks sharing it don't serialize.
+ */
+static int32_t positioned_rw(int fd, uint32_t user_args_ptr, bool is_write) {
+    pio_args_t args;
+    if (copy_from_user((kernelptr_t)&args, (const_userptr_t)user_args_ptr, sizeof(args)) != 0) return -EFAULT;
+
+    size_t count = (size_t)args.count;
+    off_t pos = (off_t)args.offset;
+    if ((ssize_t)count < 0 || pos < 0 || pos > LONG_MAX - (off_t)count) return -EINVAL;
+    if (fd == STDIN_FILENO || fd == STDOUT_FILENO || fd == STDERR_FILENO) return -ESPIPE; // The terminal has no position
+    if (count == 0) return 0;
+    if (!access_ok(is_write ? VERIFY_READ : VERIFY_WRITE, (const_userptr_t)args.buf, count)) return -EFAULT;
+
+    ssize_t total = is_write ? write_from_user(fd, (const_userptr_t)args.buf, count, &pos)
+                             : read_into_user(fd, (userptr_t)args.buf, count, &pos);
+    return (int32_t)total;
+}
+
+static int32_t sys_pread_impl(uint32_t fd_arg, uint32_t user_args_ptr, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg3; (void)regs;
+    return positioned_rw((int)fd_arg, user_args_ptr, false);
+}
+
+static int32_t sys_pwrite_impl(uint32_t fd_arg, uint32_t user_args_ptr, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg3; (void)regs;
+    return positioned_rw((int)fd_arg, user_args_ptr, true);
+}
+
+/**
+ * @brief readv/writev: the buffers are copied in and checked once up front,
+ * then each one is transferred in place (see user_io()), so a vector of
+ * records costs one VFS call each. Stops at the first short transfer;
+ * returns the bytes moved, or a negative errno if none were.
+ */
+static int32_t vectored_rw(int fd, uint32_t user_iov_ptr, uint32_t iovcnt, bool is_write) {
+    if (iovcnt > UIO_MAXIOV) return -EINVAL;
+    if (iovcnt == 0) return 0;
+
+    size_t iov_bytes = (size_t)iovcnt * sizeof(struct iovec);
+    struct iovec *iov = kmalloc(iov_bytes);
+    if (!iov) return -ENOMEM;
+    if (copy_from_user((kernelptr_t)iov, (const_userptr_t)user_iov_ptr, iov_bytes) != 0) {
+        kfree(iov);
+        return -EFAULT;
+    }
+
+    size_t total_len = 0;
+    for (uint32_t i = 0; i < iovcnt; i++) {
+        size_t len = iov[i].iov_len;
+        if ((ssize_t)len < 0 || len > (size_t)INT32_MAX - total_len) { kfree(iov); return -EINVAL; }
+        if (len && !access_ok(is_write ? VERIFY_READ : VERIFY_WRITE, (const_userptr_t)iov[i].iov_base, len)) {
+            kfree(iov);
+            return -EFAULT;
         }
-        if (bytes_read_this_chunk == 0) break;
+        total_len += len;
+    }
 
-        if (copy_to_user((userptr_t)((char*)user_buf + total_read), (const_kernelptr_t)kbuf, (size_t)bytes_read_this_chunk) != 0) {
-            if (total_read > 0) break;
-            total_read = -EFAULT;
+    ssize_t total = 0;
+    for (uint32_t i = 0; i < iovcnt; i++) {
+        size_t len = iov[i].iov_len;
+        if (len == 0) continue;
+        ssize_t moved = is_write ? write_from_user(fd, (const_userptr_t)iov[i].iov_base, len, NULL)
+                                 : read_into_user(fd, (userptr_t)iov[i].iov_base, len, NULL);
+        if (moved < 0) {
+            if (total == 0) total = moved;
             break;
         }
-        total_read += bytes_read_this_chunk;
-        if ((size_t)bytes_read_this_chunk < current_chunk_size) break;
+        total += moved;
+        if ((size_t)moved < len) break;
     }
-    if (kbuf) kfree(kbuf);
-    return total_read;
+    kfree(iov);
+    return (int32_t)total;
 }
 
-static int32_t sys_write_impl(uint32_t fd_arg, uint32_t user_buf_ptr, uint32_t count_arg, isr_frame_t *regs) {
+static int32_t sys_readv_impl(uint32_t fd_arg, uint32_t user_iov_ptr, uint32_t iovcnt, isr_frame_t *regs) {
     (void)regs;
-    int fd = (int)fd_arg;
-    const_userptr_t user_buf = (const_userptr_t)user_buf_ptr;
-    size_t count = (size_t)count_arg;
-    ssize_t total_written = 0;
-    char* kbuf = NULL;
+    return vectored_rw((int)fd_arg, user_iov_ptr, iovcnt, false);
+}
 
-    if ((ssize_t)count < 0) return -EINVAL;
-    if (count == 0) return 0;
-    if (!access_ok(VERIFY_READ, user_buf, count)) return -EFAULT;
+static int32_t sys_writev_impl(uint32_t fd_arg, uint32_t user_iov_ptr, uint32_t iovcnt, isr_frame_t *regs) {
+    (void)regs;
+    return vectored_rw((int)fd_arg, user_iov_ptr, iovcnt, true);
+}
 
-    size_t chunk_alloc_size = MIN(MAX_RW_CHUNK_SIZE, count);
-    kbuf = kmalloc(chunk_alloc_size);
-    if (!kbuf) return -ENOMEM;
+/**
+ * @brief Moves up to @p count bytes of @p fd_in into the pipe @p fd_out by
+ * linking page-cache pages into its ring (pipe_splice_file()), no copy.
+ * @return Bytes moved, or -ENOSYS if @p fd_in can't be spliced from.
+ */
+static ssize_t splice_to_pipe(int fd_in, off_t *in_pos, int fd_out, size_t count) {
+    sys_file_t *sf_in = sys_file_get_fd(fd_in);
+    if (!sf_in) return -ENOSYS; // The copy path reports the bad fd
+    sys_file_t *sf_out = sys_file_get_fd(fd_out);
+
+    ssize_t ret = -ENOSYS;
+    if (sf_out && (sf_out->flags & O_ACCMODE) == O_WRONLY && (sf_in->flags & O_ACCMODE) != O_WRONLY &&
+        pipe_is_pipe(sf_out->vfs_file) && !pipe_is_pipe(sf_in->vfs_file)) {
+        off_t pos = in_pos ? *in_pos : vfs_lseek(sf_in->vfs_file, 0, SEEK_CUR);
+        if (pos >= 0) {
+            ret = pipe_splice_file(sf_out->vfs_file, sf_in->vfs_file, &pos, count);
+            if (ret > 0 && in_pos) *in_pos = pos;
+            else if (ret > 0) vfs_lseek(sf_in->vfs_file, pos, SEEK_SET);
+        }
+    }
+    if (sf_out) sys_file_put(sf_out);
+    sys_file_put(sf_in);
+    return ret;
+}
+
+/**
+ * @brief Moves up to @p count bytes from @p fd_in to @p fd_out through one
+ * kernel buffer, so the data never crosses into user space and back. Reads
+ * come from the page cache where the file is cached.
+ * @param in_pos, out_pos Positions to use and advance, or NULL for the fds' own.
+ * @return Bytes copied; a negative errno only if nothing was.
+ */
+static ssize_t copy_between_fds(int fd_in, off_t *in_pos, int fd_out, off_t *out_pos, size_t count) {
+    if (!out_pos && sys_file_is_pipe(fd_out)) {
+        ssize_t spliced = splice_to_pipe(fd_in, in_pos, fd_out, count);
+        if (spliced != -ENOSYS) return spliced;
+    }
 
-    while (total_written < (ssize_t)count) {
-        size_t current_chunk_size = MIN(chunk_alloc_size, count - (size_t)total_written);
-        KERNEL_ASSERT(current_chunk_size > 0, "Write chunk size zero");
+    size_t chunk_alloc_size = MIN(MAX_COPY_CHUNK_SIZE, count);
+    char *kbuf = kmalloc(chunk_alloc_size);
+    if (!kbuf) return -ENOMEM;
 
-        size_t not_copied_from_user = copy_from_user((kernelptr_t)kbuf, (const_userptr_t)((const char*)user_buf + total_written), current_chunk_size);
-        size_t copied_this_chunk_from_user = current_chunk_size - not_copied_from_user;
+    ssize_t total = 0;
+    while ((size_t)total < count) {
+        size_t want = MIN(chunk_alloc_size, count - (size_t)total);
+        ssize_t nread = in_pos ? sys_pread(fd_in, kbuf, want, *in_pos) : sys_read(fd_in, kbuf, want);
+        if (nread <= 0) {
+            if (nread < 0 && total == 0) total = nread;
+            break;
+        }
 
-        if (copied_this_chunk_from_user > 0) {
-            ssize_t bytes_written_this_chunk;
-            if (fd == STDOUT_FILENO || fd == STDERR_FILENO) {
-                terminal_write_bytes(kbuf, copied_this_chunk_from_user);
-                bytes_written_this_chunk = copied_this_chunk_from_user;
+        ssize_t written = 0;
+        ssize_t write_err = 0;
+        while (written < nread) {
+            ssize_t w;
+            if (!out_pos && (fd_out == STDOUT_FILENO || fd_out == STDERR_FILENO)) {
+                terminal_write_bytes(kbuf + written, (size_t)(nread - written));
+                w = nread - written;
+            } else if (out_pos) {
+                w = sys_pwrite(fd_out, kbuf + written, (size_t)(nread - written), *out_pos + (off_t)written);
             } else {
-                bytes_written_this_chunk = sys_write(fd, kbuf, copied_this_chunk_from_user);
+                w = sys_write(fd_out, kbuf + written, (size_t)(nread - written));
             }
-
-            if (bytes_written_this_chunk < 0) {
-                if (total_written > 0) break;
-                total_written = bytes_written_this_chunk;
+            if (w <= 0) {
+                write_err = w;
                 break;
             }
-            total_written += bytes_written_this_chunk;
-            if ((size_t)bytes_written_this_chunk < copied_this_chunk_from_user) break;
+            written += w;
+        }
+        // Leave fd_in just past what reached fd_out
+        if (in_pos) *in_pos += (off_t)written;
+        else if (written < nread) sys_lseek(fd_in, -(off_t)(nread - written), SEEK_CUR);
+        if (out_pos) *out_pos += (off_t)written;
+
+        total += written;
+        if (total == 0 && write_err < 0) total = write_err;
+        if (written < nread || (size_t)nread < want) break;
+    }
+    kfree(kbuf);
+    return total;
+}
+
+/** @brief Reads the optional user position at @p user_ptr into @p *pos. */
+static int get_user_pos(uint32_t user_ptr, off_t *pos) {
+    int32_t value;
+    if (copy_from_user((kernelptr_t)&value, (const_userptr_t)user_ptr, sizeof(value)) != 0) return -EFAULT;
+    if (value < 0) return -EINVAL;
+    *pos = (off_t)value;
+    return 0;
+}
+
+static int put_user_pos(uint32_t user_ptr, off_t pos) {
+    int32_t value = (int32_t)pos;
+    return copy_to_user((userptr_t)user_ptr, (const_kernelptr_t)&value, sizeof(value)) != 0 ? -EFAULT : 0;
+}
+
+/**
+ * @brief sendfile(&args): copies args.count bytes from in_fd to out_fd
+ * (stdout included) without a round trip through user memory.
+ */
+static int32_t sys_sendfile_impl(uint32_t user_args_ptr, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg2; (void)arg3; (void)regs;
+    sendfile_args_t args;
+    if (copy_from_user((kernelptr_t)&args, (const_userptr_t)user_args_ptr, sizeof(args)) != 0) return -EFAULT;
+    if ((int32_t)args.count < 0) return -EINVAL;
+    if (args.count == 0) return 0;
+
+    off_t pos = 0;
+    if (args.offset_ptr) {
+        int err = get_user_pos(args.offset_ptr, &pos);
+        if (err) return err;
+        if (pos > LONG_MAX - (off_t)args.count) return -EINVAL;
+    }
+    ssize_t copied = copy_between_fds(args.in_fd, args.offset_ptr ? &pos : NULL, args.out_fd, NULL, args.count);
+    if (args.offset_ptr && put_user_pos(args.offset_ptr, pos) != 0 && copied >= 0) return -EFAULT;
+    return (int32_t)copied;
+}
+
+/**
+ * @brief copy_file_range(&args): copies args.len bytes between two open
+ * files in the kernel. An overlapping range within one file is refused.
+ */
+static int32_t sys_copy_file_range_impl(uint32_t user_args_ptr, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg2; (void)arg3; (void)regs;
+    copy_range_args_t args;
+    if (copy_from_user((kernelptr_t)&args, (const_userptr_t)user_args_ptr, sizeof(args)) != 0) return -EFAULT;
+    if (args.flags != 0 || (int32_t)args.len < 0) return -EINVAL;
+
+    off_t in_pos = 0, out_pos = 0;
+    int err = 0;
+    if (args.off_in_ptr && (err = get_user_pos(args.off_in_ptr, &in_pos)) != 0) return err;
+    if (args.off_out_ptr && (err = get_user_pos(args.off_out_ptr, &out_pos)) != 0) return err;
+
+    // Both ends must be open files (the terminal descriptors aren't)
+    sys_file_t *sf_in = sys_file_get_fd(args.fd_in);
+    sys_file_t *sf_out = sys_file_get_fd(args.fd_out);
+    if (!sf_in || !sf_out) {
+        err = -EBADF;
+    } else {
+        off_t in_start = args.off_in_ptr ? in_pos : vfs_lseek(sf_in->vfs_file, 0, SEEK_CUR);
+        off_t out_start = args.off_out_ptr ? out_pos : vfs_lseek(sf_out->vfs_file, 0, SEEK_CUR);
+        vfs_file_id_t id_in, id_out;
+        if (in_start < 0 || out_start < 0 ||
+            in_start > LONG_MAX - (off_t)args.len || out_start > LONG_MAX - (off_t)args.len) {
+            err = -EINVAL;
+        } else if (vfs_identify(sf_in->vfs_file, &id_in) == 0 && vfs_identify(sf_out->vfs_file, &id_out) == 0 &&
+                   id_in.fs == id_out.fs && id_in.ino == id_out.ino &&
+                   in_start < out_start + (off_t)args.len && out_start < in_start + (off_t)args.len) {
+            err = -EINVAL;
+        }
+    }
+    if (sf_in) sys_file_put(sf_in);
+    if (sf_out) sys_file_put(sf_out);
+    if (err) return err;
+    if (args.len == 0) return 0;
+
+    ssize_t copied = copy_between_fds(args.fd_in, args.off_in_ptr ? &in_pos : NULL,
+                                      args.fd_out, args.off_out_ptr ? &out_pos : NULL, args.len);
+    if (args.off_in_ptr && put_user_pos(args.off_in_ptr, in_pos) != 0 && copied >= 0) copied = -EFAULT;
+    if (args.off_out_ptr && put_user_pos(args.off_out_ptr, out_pos) != 0 && copied >= 0) copied = -EFAULT;
+    return (int32_t)copied;
+}
+
+static int32_t fsync_fd(int fd, bool datasync); // With the other fd syscalls below
+
+/** @brief Runs one ring submission the way the matching syscall would. */
+static int32_t io_ring_exec(const io_sqe_t *sqe) {
+    if (sqe->flags != 0) return -EINVAL;
+    switch (sqe->opcode) {
+    case IO_OP_NOP:
+        return 0;
+    case IO_OP_READ:
+    case IO_OP_WRITE: {
+        bool is_write = (sqe->opcode == IO_OP_WRITE);
+        size_t count = (size_t)sqe->len;
+        off_t pos = (off_t)sqe->off;
+        if ((ssize_t)count < 0 || pos < -1 || (pos >= 0 && pos > LONG_MAX - (off_t)count)) return -EINVAL;
+        if (pos >= 0 && sqe->fd >= STDIN_FILENO && sqe->fd <= STDERR_FILENO) return -ESPIPE;
+        if (count == 0) return 0;
+        if (!access_ok(is_write ? VERIFY_READ : VERIFY_WRITE, (const_userptr_t)sqe->addr, count)) return -EFAULT;
+        const off_t *at = (pos >= 0) ? &pos : NULL;
+        return (int32_t)(is_write ? write_from_user(sqe->fd, (const_userptr_t)sqe->addr, count, at)
+                                  : read_into_user(sqe->fd, (userptr_t)sqe->addr, count, at));
+    }
+    case IO_OP_OPEN: {
+        char k_pathname[MAX_SYSCALL_STR_LEN];
+        int copy_err = strncpy_from_user_safe((const_userptr_t)sqe->addr, k_pathname, sizeof(k_pathname));
+        if (copy_err != 0) return copy_err;
+        return sys_open(k_pathname, (int)sqe->len, 0);
+    }
+    case IO_OP_CLOSE:
+        return sys_close(sqe->fd);
+    case IO_OP_FSYNC:
+        return fsync_fd(sqe->fd, false);
+    default:
+        return -EINVAL;
+    }
+}
+
+/**
+ * @brief io_setup(&args): registers the caller's ring block (see io_ring.h)
+ * and resets its counters. A second call replaces the first ring.
+ */
+static int32_t sys_io_setup_impl(uint32_t user_args_ptr, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg2; (void)arg3; (void)regs;
+    pcb_t *current_proc = get_current_process();
+    if (!current_proc) return -EINVAL;
+
+    io_ring_setup_args_t args;
+    if (copy_from_user((kernelptr_t)&args, (const_userptr_t)user_args_ptr, sizeof(args)) != 0) return -EFAULT;
+    uint32_t sq = args.sq_entries, cq = args.cq_entries;
+    if (sq == 0 || sq > IO_RING_MAX_ENTRIES || (sq & (sq - 1)) != 0) return -EINVAL;
+    if (cq < sq || cq > IO_RING_MAX_ENTRIES || (cq & (cq - 1)) != 0) return -EINVAL;
+    if ((args.ring & 3) != 0) return -EINVAL;
+    if (!access_ok(VERIFY_WRITE, (const_userptr_t)args.ring, IO_RING_BYTES(sq, cq))) return -EFAULT;
+
+    io_ring_hdr_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.sq_mask = sq - 1;
+    hdr.cq_mask = cq - 1;
+    if (copy_to_user((userptr_t)args.ring, (const_kernelptr_t)&hdr, sizeof(hdr)) != 0) return -EFAULT;
+
+    io_ring_t *ring = kmalloc(sizeof(io_ring_t));
+    if (!ring) return -ENOMEM;
+    ring->base = args.ring;
+    ring->sq_entries = sq;
+    ring->cq_entries = cq;
+    ring->sq_head = 0;
+    ring->cq_tail = 0;
+    kfree(current_proc->io_ring);
+    current_proc->io_ring = ring;
+    return 0;
+}
+
+/**
+ * @brief io_enter(to_submit): runs up to @p to_submit queued SQEs in order,
+ * posting each result as a CQE, then publishes sq_head and cq_tail. Every
+ * completion is posted before the call returns. Stops early when the
+ * completion queue is full.
+ * @return SQEs consumed; -EBUSY if the CQ had no room for even one.
+ */
+static int32_t sys_io_enter_impl(uint32_t to_submit, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg2; (void)arg3; (void)regs;
+    pcb_t *current_proc = get_current_process();
+    io_ring_t *ring = current_proc ? current_proc->io_ring : NULL;
+    if (!ring) return -EINVAL;
+    // One check for the whole block; the per-entry copies below skip it
+    if (!access_ok(VERIFY_WRITE, (const_userptr_t)ring->base, IO_RING_BYTES(ring->sq_entries, ring->cq_entries))) return -EFAULT;
+
+    io_ring_hdr_t hdr;
+    if (__copy_from_user((kernelptr_t)&hdr, (const_userptr_t)ring->base, sizeof(hdr)) != 0) return -EFAULT;
+    uint32_t queued = hdr.sq_tail - ring->sq_head;
+    if (queued > ring->sq_entries) return -EINVAL; // sq_tail ran past what the ring holds
+    if (to_submit > queued) to_submit = queued;
+
+    uintptr_t sqes = ring->base + IO_RING_SQES_OFFSET;
+    uintptr_t cqes = ring->base + IO_RING_CQES_OFFSET(ring->sq_entries);
+    uint32_t submitted = 0;
+    int32_t err = 0;
+    while (submitted < to_submit) {
+        if (ring->cq_tail - hdr.cq_head >= ring->cq_entries) {
+            if (submitted == 0) err = -EBUSY;
+            break;
         }
+        io_sqe_t sqe;
+        uintptr_t sqe_at = sqes + (ring->sq_head & (ring->sq_entries - 1)) * sizeof(io_sqe_t);
+        if (__copy_from_user((kernelptr_t)&sqe, (const_userptr_t)sqe_at, sizeof(sqe)) != 0) {
+            err = -EFAULT;
+            break;
+        }
+        ring->sq_head++;
+        submitted++;
+
+        io_cqe_t cqe = { .user_data = sqe.user_data, .res = io_ring_exec(&sqe) };
+        uintptr_t cqe_at = cqes + (ring->cq_tail & (ring->cq_entries - 1)) * sizeof(io_cqe_t);
+        if (__copy_to_user((userptr_t)cqe_at, (const_kernelptr_t)&cqe, sizeof(cqe)) != 0) {
+            err = -EFAULT;
+            break;
+        }
+        ring->cq_tail++;
+    }
+
+    // The CQEs are in place before the tail that covers them is
+    asm volatile("" ::: "memory");
+    if (__copy_to_user((userptr_t)(ring->base + offsetof(io_ring_hdr_t, sq_head)), (const_kernelptr_t)&ring->sq_head, sizeof(uint32_t)) != 0 ||
+        __copy_to_user((userptr_t)(ring->base + offsetof(io_ring_hdr_t, cq_tail)), (const_kernelptr_t)&ring->cq_tail, sizeof(uint32_t)) != 0) {
+        return -EFAULT;
+    }
+    return submitted ? (int32_t)submitted : err;
+}
+
+/**
+ * @brief Lists the directory open on @p fd into the user buffer: as many
+ * whole struct dirent_rec records as fit, resuming where the previous call
+ * stopped (lseek SEEK_SET to a record's d_off resumes after that record).
+ * @return Bytes filled, 0 at the end, -EINVAL if one record does not fit.
+ */
+static int32_t sys_getdents_impl(uint32_t fd_arg, uint32_t user_buf_ptr, uint32_t count_arg, isr_frame_t *regs) {
+    (void)regs;
+    int fd = (int)fd_arg;
+    userptr_t user_buf = (userptr_t)user_buf_ptr;
+    size_t count = (size_t)count_arg;
+    ssize_t total = 0;
+
+    if ((ssize_t)count <= 0) return -EINVAL;
+    if (!access_ok(VERIFY_WRITE, user_buf, count)) return -EFAULT;
+
+    size_t chunk_alloc_size = MIN(MAX_RW_CHUNK_SIZE, count);
+    char *kbuf = kmalloc(chunk_alloc_size);
+    if (!kbuf) return -ENOMEM;
 
-        if (not_copied_from_user > 0) {
-             if (total_written > 0) break;
-             total_written = -EFAULT;
-             break;
+    // Each chunk holds whole records, so they never straddle two
+    while (total < (ssize_t)count) {
+        size_t current_chunk_size = MIN(chunk_alloc_size, count - (size_t)total);
+        ssize_t filled = sys_getdents(fd, kbuf, current_chunk_size);
+        if (filled < 0) {
+            // A record too big for the space left just ends this batch
+            if (total == 0) total = (filled == FS_ERR_INVALID_PARAM) ? -EINVAL : filled;
+            break;
         }
-        if (copied_this_chunk_from_user == 0 && not_copied_from_user == 0 && current_chunk_size > 0) {
-            if (total_written > 0) break;
-            total_written = -EFAULT;
+        if (filled == 0) break;
+        if (__copy_to_user((userptr_t)((char*)user_buf + total), (const_kernelptr_t)kbuf, (size_t)filled) != 0) {
+            if (total == 0) total = -EFAULT;
             break;
         }
+        total += filled;
     }
-    if (kbuf) kfree(kbuf);
-    return total_written;
+    kfree(kbuf);
+    return (int32_t)total;
 }
 
 static int32_t sys_open_impl(uint32_t user_pathname_ptr, uint32_t flags_arg, uint32_t mode_arg, isr_frame_t *regs) {
@@ -315,6 +931,236 @@ static int32_t sys_open_impl(uint32_t user_pathname_ptr, uint32_t flags_arg, uin
     return sys_open(k_pathname, flags, mode);
 }
 
+/** @brief Maps an FS_ERR_* code (the VFS hands back both signs) to a negative errno. */
+static int32_t fs_err_to_errno(int err) {
+    if (err > 0) err = -err;
+    switch (err) {
+    case FS_SUCCESS:             return 0;
+    case FS_ERR_NOT_FOUND:       return -ENOENT;
+    case FS_ERR_NOT_A_DIRECTORY: return -ENOTDIR;
+    case FS_ERR_NAMETOOLONG:     return -ENAMETOOLONG;
+    case FS_ERR_INVALID_PARAM:   return -EINVAL;
+    case FS_ERR_OUT_OF_MEMORY:   return -ENOMEM;
+    case FS_ERR_BAD_F:           return -EBADF;
+    case FS_ERR_NOT_SUPPORTED:   return -ENOSYS;
+    default:                     return -EIO;
+    }
+}
+
+/** @brief stat(path, buf): attributes of @p path without opening it. */
+static int32_t sys_stat_impl(uint32_t user_pathname_ptr, uint32_t user_stat_ptr, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg3; (void)regs;
+    char k_pathname[MAX_SYSCALL_STR_LEN];
+    int copy_err = strncpy_from_user_safe((const_userptr_t)user_pathname_ptr, k_pathname, sizeof(k_pathname));
+    if (copy_err != 0) return copy_err;
+
+    struct vfs_stat st;
+    int err = vfs_stat(k_pathname, &st);
+    if (err != 0) return fs_err_to_errno(err);
+    if (copy_to_user((userptr_t)user_stat_ptr, (const_kernelptr_t)&st, sizeof(st)) != 0) return -EFAULT;
+    return 0;
+}
+
+/** @brief fstat(fd, buf): attributes of the file open on @p fd. */
+static int32_t sys_fstat_impl(uint32_t fd_arg, uint32_t user_stat_ptr, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg3; (void)regs;
+    int fd = (int)fd_arg;
+    struct vfs_stat st;
+    memset(&st, 0, sizeof(st));
+
+    sys_file_t *sf = sys_file_get_fd(fd);
+    if (sf) {
+        int err = vfs_fstat(sf->vfs_file, &st);
+        sys_file_put(sf);
+        if (err != 0) return fs_err_to_errno(err);
+    } else if (fd >= STDIN_FILENO && fd <= STDERR_FILENO) {
+        st.st_mode = VFS_S_IFCHR | 0620; // The terminal
+    } else {
+        return -EBADF;
+    }
+    if (copy_to_user((userptr_t)user_stat_ptr, (const_kernelptr_t)&st, sizeof(st)) != 0) return -EFAULT;
+    return 0;
+}
+
+/** @brief unlink(path): removes the file (or empty directory) at @p path. */
+static int32_t sys_unlink_impl(uint32_t user_pathname_ptr, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg2; (void)arg3; (void)regs;
+    char k_pathname[MAX_SYSCALL_STR_LEN];
+    int copy_err = strncpy_from_user_safe((const_userptr_t)user_pathname_ptr, k_pathname, sizeof(k_pathname));
+    if (copy_err != 0) return copy_err;
+
+    int err = vfs_unlink(k_pathname);
+    return err != 0 ? fs_err_to_errno(err) : 0;
+}
+
+/** @brief fsync()/fdatasync() of @p fd; the terminal has nothing to sync. */
+static int32_t fsync_fd(int fd, bool datasync) {
+    sys_file_t *sf = sys_file_get_fd(fd);
+    if (!sf) return (fd >= STDIN_FILENO && fd <= STDERR_FILENO) ? -EINVAL : -EBADF;
+    int err = vfs_fsync(sf->vfs_file, datasync);
+    sys_file_put(sf);
+    return err != 0 ? fs_err_to_errno(err) : 0;
+}
+
+/** @brief fsync(fd): writes back the file's data and metadata and flushes the drive. */
+static int32_t sys_fsync_impl(uint32_t fd, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg2; (void)arg3; (void)regs;
+    return fsync_fd((int)fd, false);
+}
+
+/** @brief fdatasync(fd): fsync without metadata the data does not depend on. */
+static int32_t sys_fdatasync_impl(uint32_t fd, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg2; (void)arg3; (void)regs;
+    return fsync_fd((int)fd, true);
+}
+
+/**
+ * @brief poll(fds, nfds, timeout_ms): waits until one of the descriptors is
+ * ready (see poll.h). A negative timeout waits indefinitely, 0 only checks.
+ * Bad descriptors report POLLNVAL in their entry rather than failing the call.
+ */
+static int32_t sys_poll_impl(uint32_t user_fds_ptr, uint32_t nfds, uint32_t timeout_arg, isr_frame_t *regs) {
+    (void)regs;
+    if (nfds > POLL_MAX_FDS) return -EINVAL;
+    int32_t timeout_ms = (int32_t)timeout_arg;
+    if (nfds == 0) {
+        // poll(NULL, 0, ms) is the classic portable sleep
+        if (timeout_ms > 0) sleep_ms((uint32_t)timeout_ms);
+        return 0;
+    }
+
+    size_t bytes = nfds * sizeof(struct pollfd);
+    struct pollfd *kfds = kmalloc(bytes);
+    if (!kfds) return -ENOMEM;
+    int32_t ret;
+    if (copy_from_user((kernelptr_t)kfds, (const_userptr_t)user_fds_ptr, bytes) != 0) {
+        ret = -EFAULT;
+    } else {
+        ret = vfs_poll_wait(kfds, nfds, timeout_ms);
+        if (copy_to_user((userptr_t)user_fds_ptr, (const_kernelptr_t)kfds, bytes) != 0) ret = -EFAULT;
+    }
+    kfree(kfds);
+    return ret;
+}
+
+/** @brief pipe(fds): fds[0] gets the read end, fds[1] the write end. */
+static int32_t sys_pipe_impl(uint32_t user_fds_ptr, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg2; (void)arg3; (void)regs;
+    int kfds[2];
+    if (!access_ok(VERIFY_WRITE, (const_userptr_t)user_fds_ptr, sizeof(kfds))) return -EFAULT;
+    int err = sys_pipe(kfds);
+    if (err < 0) return err;
+    if (copy_to_user((userptr_t)user_fds_ptr, (const_kernelptr_t)kfds, sizeof(kfds)) != 0) {
+        sys_close(kfds[0]);
+        sys_close(kfds[1]);
+        return -EFAULT;
+    }
+    return 0;
+}
+
+static int32_t sys_shm_open_impl(uint32_t user_name_ptr, uint32_t oflag, uint32_t size, isr_frame_t *regs) {
+    (void)regs;
+    char k_name[SHM_NAME_MAX];
+    int copy_err = strncpy_from_user_safe((const_userptr_t)user_name_ptr, k_name, sizeof(k_name));
+    if (copy_err != 0) return copy_err;
+    return sys_shm_open(k_name, (int)oflag, (size_t)size);
+}
+
+static int32_t sys_shm_unlink_impl(uint32_t user_name_ptr, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg2; (void)arg3; (void)regs;
+    char k_name[SHM_NAME_MAX];
+    int copy_err = strncpy_from_user_safe((const_userptr_t)user_name_ptr, k_name, sizeof(k_name));
+    if (copy_err != 0) return copy_err;
+    return shm_unlink(k_name);
+}
+
+static int32_t sys_futex_impl(uint32_t uaddr, uint32_t op, uint32_t val, isr_frame_t *regs) {
+    (void)regs;
+    switch (op) {
+    case FUTEX_WAIT: return futex_wait((uintptr_t)uaddr, val);
+    case FUTEX_WAKE: return futex_wake((uintptr_t)uaddr, val);
+    default:         return -EINVAL;
+    }
+}
+
+/**
+ * @brief thread_create(entry, stack_top, arg): see process_thread_create().
+ * The caller owns the new thread's user stack and must keep it mapped.
+ */
+static int32_t sys_thread_create_impl(uint32_t entry, uint32_t stack_top, uint32_t arg, isr_frame_t *regs) {
+    return process_thread_create(regs, (uintptr_t)entry, (uintptr_t)stack_top, arg);
+}
+
+/** @brief Kernel copies of one spawn's arguments (too big for the kernel stack). */
+typedef struct spawn_kbuf {
+    char               path[MAX_SYSCALL_STR_LEN];
+    const char        *argv[SPAWN_MAX_ARGS + 1];
+    const char        *envp[SPAWN_MAX_ARGS + 1];
+    spawn_fd_action_t  actions[SPAWN_MAX_FD_ACTIONS];
+    char               strings[SPAWN_ARG_BYTES]; // argv and envp strings, packed
+} spawn_kbuf_t;
+
+/**
+ * @brief Copies the NULL-terminated user string vector at @p user_vec into
+ * @p kvec, packing the strings at *pool (advanced past them).
+ * @return 0, -EFAULT, or -E2BIG past SPAWN_MAX_ARGS entries or the pool's end.
+ */
+static int copy_user_strv(uint32_t user_vec, const char **kvec, char **pool, size_t *pool_left) {
+    uint32_t n = 0;
+    for (;; n++) {
+        uint32_t user_str;
+        if (copy_from_user((kernelptr_t)&user_str, (const_userptr_t)(user_vec + n * sizeof(uint32_t)), sizeof(user_str)) != 0) {
+            return -EFAULT;
+        }
+        if (!user_str) break;
+        if (n == SPAWN_MAX_ARGS || *pool_left == 0) return -E2BIG;
+        int copy_err = strncpy_from_user_safe((const_userptr_t)user_str, *pool, *pool_left);
+        if (copy_err == -ENAMETOOLONG) return -E2BIG;
+        if (copy_err != 0) return copy_err;
+        size_t len = strlen(*pool) + 1;
+        kvec[n] = *pool;
+        *pool += len;
+        *pool_left -= len;
+    }
+    kvec[n] = NULL;
+    return 0;
+}
+
+/**
+ * @brief spawn(&args): see process_spawn(). Everything is copied in before
+ * the child is built, so a bad pointer fails the call and creates nothing.
+ */
+static int32_t sys_spawn_impl(uint32_t user_args_ptr, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg2; (void)arg3; (void)regs;
+    spawn_args_t args;
+    if (copy_from_user((kernelptr_t)&args, (const_userptr_t)user_args_ptr, sizeof(args)) != 0) return -EFAULT;
+    if (args.nr_fd_actions > SPAWN_MAX_FD_ACTIONS) return -EINVAL;
+
+    spawn_kbuf_t *kb = (spawn_kbuf_t *)kmalloc(sizeof(spawn_kbuf_t));
+    if (!kb) return -ENOMEM;
+    char *pool = kb->strings;
+    size_t pool_left = sizeof(kb->strings);
+    int32_t result = strncpy_from_user_safe((const_userptr_t)args.path, kb->path, sizeof(kb->path));
+    if (result == 0) {
+        if (args.argv) {
+            result = copy_user_strv(args.argv, kb->argv, &pool, &pool_left);
+        } else {
+            kb->argv[0] = kb->path;
+            kb->argv[1] = NULL;
+        }
+    }
+    kb->envp[0] = NULL;
+    if (result == 0 && args.envp) result = copy_user_strv(args.envp, kb->envp, &pool, &pool_left);
+    if (result == 0 && args.nr_fd_actions &&
+        copy_from_user((kernelptr_t)kb->actions, (const_userptr_t)args.fd_actions,
+                       args.nr_fd_actions * sizeof(spawn_fd_action_t)) != 0) {
+        result = -EFAULT;
+    }
+    if (result == 0) result = process_spawn(kb->path, kb->argv, kb->envp, kb->actions, args.nr_fd_actions);
+    kfree(kb);
+    return result;
+}
+
 static int32_t sys_close_impl(uint32_t fd_arg, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
     (void)arg2; (void)arg3; (void)regs;
     int fd = (int)fd_arg;
@@ -336,6 +1182,193 @@ static int32_t sys_getpid_impl(uint32_t arg1, uint32_t arg2, uint32_t arg3, isr_
     return (int32_t)current_proc->pid;
 }
 
+/**
+ * @brief Copies scheduler accounting for @p pid (0 = system-wide totals).
+ * Copies at most @p size bytes so older callers with a shorter struct work.
+ * @return Number of bytes copied, or a negative errno.
+ */
+static int32_t sys_sched_stats_impl(uint32_t pid, uint32_t user_buf_ptr, uint32_t size, isr_frame_t *regs) {
+    (void)regs;
+    userptr_t user_buf = (userptr_t)user_buf_ptr;
+    if (size == 0) return -EINVAL;
+    size_t copy_len = MIN((size_t)size, sizeof(sched_task_stats_t));
+    if (!access_ok(VERIFY_WRITE, user_buf, copy_len)) return -EFAULT;
+
+    sched_task_stats_t *stats = kmalloc(sizeof(sched_task_stats_t));
+    if (!stats) return -ENOMEM;
+    if (scheduler_get_task_stats(pid, stats) != 0) { kfree(stats); return -ESRCH; }
+
+    int32_t result = (int32_t)copy_len;
+    if (__copy_to_user(user_buf, (const_kernelptr_t)stats, copy_len) != 0) result = -EFAULT;
+    kfree(stats);
+    return result;
+}
+
+/**
+ * @brief Copies up to @p size bytes of block device @p index's I/O
+ * statistics (block_io_stats_t) to the user buffer; devices are numbered
+ * from 0 in the order they were initialized.
+ * @return Bytes copied, or -ENODEV past the last device.
+ */
+static int32_t sys_block_stats_impl(uint32_t index, uint32_t user_buf_ptr, uint32_t size, isr_frame_t *regs) {
+    (void)regs;
+    userptr_t user_buf = (userptr_t)user_buf_ptr;
+    if (size == 0) return -EINVAL;
+    size_t copy_len = MIN((size_t)size, sizeof(block_io_stats_t));
+    if (!access_ok(VERIFY_WRITE, user_buf, copy_len)) return -EFAULT;
+
+    block_io_stats_t *stats = kmalloc(sizeof(block_io_stats_t));
+    if (!stats) return -ENOMEM;
+    if (block_device_get_stats(index, stats) != BLOCK_ERR_OK) { kfree(stats); return -ENODEV; }
+
+    int32_t result = (int32_t)copy_len;
+    if (__copy_to_user(user_buf, (const_kernelptr_t)stats, copy_len) != 0) result = -EFAULT;
+    kfree(stats);
+    return result;
+}
+
+/**
+ * @brief Copies up to @p size bytes of syscall @p nr's counters
+ * (syscall_stats_t, summed over the CPUs) to the user buffer.
+ * @return Bytes copied, or -EINVAL for a syscall number that is not counted.
+ */
+static int32_t sys_syscall_stats_impl(uint32_t nr, uint32_t user_buf_ptr, uint32_t size, isr_frame_t *regs) {
+    (void)regs;
+    userptr_t user_buf = (userptr_t)user_buf_ptr;
+    if (size == 0) return -EINVAL;
+    size_t copy_len = MIN((size_t)size, sizeof(syscall_stats_t));
+    if (!access_ok(VERIFY_WRITE, user_buf, copy_len)) return -EFAULT;
+
+    syscall_stats_t stats;
+    if (syscall_stats_get(nr, &stats) != 0) return -EINVAL;
+    if (__copy_to_user(user_buf, (const_kernelptr_t)&stats, copy_len) != 0) return -EFAULT;
+    return (int32_t)copy_len;
+}
+
+/**
+ * @brief Copies up to @p size bytes of interrupt @p vector's counters
+ * (irq_stats_t, summed over the CPUs) to the user buffer.
+ * @return Bytes copied, or -EINVAL for a vector above 255.
+ */
+static int32_t sys_irq_stats_impl(uint32_t vector, uint32_t user_buf_ptr, uint32_t size, isr_frame_t *regs) {
+    (void)regs;
+    userptr_t user_buf = (userptr_t)user_buf_ptr;
+    if (size == 0) return -EINVAL;
+    size_t copy_len = MIN((size_t)size, sizeof(irq_stats_t));
+    if (!access_ok(VERIFY_WRITE, user_buf, copy_len)) return -EFAULT;
+
+    irq_stats_t stats;
+    if (irq_stats_get(vector, &stats) != 0) return -EINVAL;
+    if (__copy_to_user(user_buf, (const_kernelptr_t)&stats, copy_len) != 0) return -EFAULT;
+    return (int32_t)copy_len;
+}
+
+/** @brief profile(op, arg, arg) on the system-wide profiler; see profiler.h. */
+static int32_t sys_profile_impl(uint32_t op, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
+    (void)regs;
+    return profile_ctl(op, arg2, arg3);
+}
+
+/** @brief perf(op, arg, arg) on the calling task's counters; see perf.h. */
+static int32_t sys_perf_impl(uint32_t op, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
+    (void)regs;
+    return perf_ctl(get_current_task(), op, arg2, arg3);
+}
+
+/** @brief tracepoint(op, arg, arg) on the system-wide tracepoints; see tracepoint.h. */
+static int32_t sys_tracepoint_impl(uint32_t op, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
+    (void)regs;
+    return tracepoint_ctl(op, arg2, arg3);
+}
+
+/** @brief strace(op, arg, arg) on the calling process; see syscall_stats.h. */
+static int32_t sys_strace_impl(uint32_t op, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
+    (void)regs;
+    return syscall_trace_ctl(get_current_process(), op, arg2, arg3);
+}
+
+/**
+ * @brief Reads clock @p clock_id into the user's clock_timespec_t.
+ * The monotonic IDs all return clock_monotonic_ns(); there is no suspend, so
+ * BOOTTIME equals MONOTONIC. CLOCK_REALTIME needs an RTC and is rejected.
+ */
+static int32_t sys_clock_gettime_impl(uint32_t clock_id, uint32_t user_ts_ptr, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg3; (void)regs;
+    userptr_t user_ts = (userptr_t)user_ts_ptr;
+    if (clock_id != CLOCK_MONOTONIC && clock_id != CLOCK_MONOTONIC_RAW && clock_id != CLOCK_BOOTTIME) return -EINVAL;
+    if (!access_ok(VERIFY_WRITE, user_ts, sizeof(clock_timespec_t))) return -EFAULT;
+
+    clock_timespec_t ts;
+    clock_ns_to_timespec(clock_monotonic_ns(), &ts);
+    if (__copy_to_user(user_ts, (const_kernelptr_t)&ts, sizeof(ts)) != 0) return -EFAULT;
+    return 0;
+}
+
+static int32_t sys_fork_impl(uint32_t arg1, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg1; (void)arg2; (void)arg3;
+    return process_fork(regs);
+}
+
+/**
+ * @brief waitpid(pid, status, options): see process_waitpid().
+ * @p user_status_ptr may be 0; it is checked before blocking.
+ */
+static int32_t sys_waitpid_impl(uint32_t pid, uint32_t user_status_ptr, uint32_t options, isr_frame_t *regs) {
+    (void)regs;
+    userptr_t user_status = (userptr_t)user_status_ptr;
+    if (options & ~(uint32_t)WNOHANG) return -EINVAL;
+    if (user_status && !access_ok(VERIFY_WRITE, user_status, sizeof(int))) return -EFAULT;
+
+    int status = 0;
+    int32_t result = process_waitpid((int32_t)pid, &status, options);
+    if (result > 0 && user_status &&
+        copy_to_user(user_status, (const_kernelptr_t)&status, sizeof(status)) != 0) {
+        return -EFAULT; // Reaped anyway; the status is lost
+    }
+    return result;
+}
+
+/**
+ * @brief mmap(&args): see do_mmap(). Returns the mapping's address, or a
+ * negative errno (never a valid user address: those stay below 0xC0000000).
+ */
+static int32_t sys_mmap_impl(uint32_t user_args_ptr, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg2; (void)arg3; (void)regs;
+    pcb_t *current_proc = get_current_process();
+    if (!current_proc->mm) return -EINVAL;
+
+    mmap_args_t args;
+    if (copy_from_user((kernelptr_t)&args, (const_userptr_t)user_args_ptr, sizeof(args)) != 0) return -EFAULT;
+
+    sys_file_t *sf = NULL;
+    if (!(args.flags & MAP_ANONYMOUS)) {
+        sf = sys_file_get_fd(args.fd);
+        if (!sf) return -EBADF;
+    }
+    uintptr_t result = do_mmap(current_proc->mm, args.addr, args.length, args.prot, args.flags, sf, args.offset);
+    if (sf) sys_file_put(sf); // The VMA holds its own reference
+    return (int32_t)result;
+}
+
+static int32_t sys_munmap_impl(uint32_t addr, uint32_t length, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg3; (void)regs;
+    pcb_t *current_proc = get_current_process();
+    if (!current_proc->mm) return -EINVAL;
+    if ((addr % PAGE_SIZE) || length == 0 || addr >= KERNEL_SPACE_VIRT_START ||
+        length > KERNEL_SPACE_VIRT_START - addr) {
+        return -EINVAL;
+    }
+    return remove_vma_range(current_proc->mm, addr, PAGE_ALIGN_UP(length)) == 0 ? 0 : -EINVAL;
+}
+
+static int32_t sys_brk_impl(uint32_t brk, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
+    (void)arg2; (void)arg3; (void)regs;
+    pcb_t *current_proc = get_current_process();
+    if (!current_proc->mm) return -EINVAL;
+    // Like Linux, failure is reported by returning the unchanged break.
+    return (int32_t)do_brk(current_proc->mm, (uintptr_t)brk);
+}
+
 static int32_t sys_puts_impl(uint32_t user_str_ptr_arg, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
     (void)arg2; (void)arg3; (void)regs;
     const_userptr_t user_str_ptr = (const_userptr_t)user_str_ptr_arg;
@@ -353,6 +1386,58 @@ static int32_t sys_puts_impl(uint32_t user_str_ptr_arg, uint32_t arg2, uint32_t
 //-----------------------------------------------------------------------------
 // Main Syscall Dispatcher
 //-----------------------------------------------------------------------------
+/** @brief Runs syscall @p nr through the table, with accounting and tracing. */
+static int32_t syscall_invoke(pcb_t *current_proc, uint32_t nr, uint32_t arg1, uint32_t arg2, uint32_t arg3, isr_frame_t *regs) {
+    int32_t ret_val;
+    bool timed = clock_tsc_active();
+    uint64_t start = timed ? read_tsc() : 0;
+    if (nr < MAX_SYSCALLS && syscall_table[nr] != NULL) {
+        ret_val = syscall_table[nr](arg1, arg2, arg3, regs);
+    } else {
+        ret_val = -ENOSYS;
+    }
+    uint64_t cycles = timed ? read_tsc() - start : 0;
+    syscall_stats_account(nr, ret_val, cycles);
+    if (current_proc && current_proc->strace) {
+        const uint32_t args[3] = { arg1, arg2, arg3 };
+        syscall_trace_record(current_proc, nr, args, ret_val, cycles);
+    }
+    return ret_val;
+}
+
+/**
+ * @brief batch(recs, count, flags): runs up to @p count syscall_batch_rec_t
+ * records in order, storing each result in its ret field. The array is
+ * checked once up front. With SYSCALL_BATCH_STOP_ON_ERROR the first
+ * negative result ends the batch.
+ * @return Records run (including a failed last one), or a negative errno if
+ * the array itself is bad.
+ */
+static int32_t sys_batch_impl(uint32_t user_recs_ptr, uint32_t count, uint32_t flags, isr_frame_t *regs) {
+    if (count == 0) return 0;
+    if (count > SYSCALL_BATCH_MAX || (flags & ~(uint32_t)SYSCALL_BATCH_STOP_ON_ERROR)) return -EINVAL;
+    syscall_batch_rec_t *recs = (syscall_batch_rec_t *)user_recs_ptr;
+    if (!access_ok(VERIFY_READ | VERIFY_WRITE, (const_userptr_t)recs, count * sizeof(syscall_batch_rec_t))) return -EFAULT;
+
+    pcb_t *current_proc = get_current_process();
+    uint32_t done = 0;
+    while (done < count) {
+        syscall_batch_rec_t rec;
+        if (__copy_from_user((kernelptr_t)&rec, (const_userptr_t)&recs[done], sizeof(rec)) != 0) break;
+
+        int32_t ret;
+        if (rec.nr == SYS_FORK || rec.nr == SYS_BATCH || rec.args[3] || rec.args[4] || rec.args[5]) {
+            ret = -EINVAL; // fork would resume the child mid-batch
+        } else {
+            ret = syscall_invoke(current_proc, rec.nr, rec.args[0], rec.args[1], rec.args[2], regs);
+        }
+        if (__copy_to_user((userptr_t)&recs[done].ret, (const_kernelptr_t)&ret, sizeof(ret)) != 0) break;
+        done++;
+        if (ret < 0 && (flags & SYSCALL_BATCH_STOP_ON_ERROR)) break;
+    }
+    return done ? (int32_t)done : -EFAULT;
+}
+
 int32_t syscall_dispatcher(isr_frame_t *regs) {
     KERNEL_ASSERT(regs != NULL, "Syscall dispatcher received NULL registers!");
 
@@ -369,11 +1454,10 @@ int32_t syscall_dispatcher(isr_frame_t *regs) {
         return -EFAULT; 
     }
 
-    if (syscall_num < MAX_SYSCALLS && syscall_table[syscall_num] != NULL) {
-        ret_val = syscall_table[syscall_num](arg1_ebx, arg2_ecx, arg3_edx, regs);
-    } else {
-        ret_val = -ENOSYS;
-    }
+    // The entry stubs run with interrupts off; the handler does not (preempt.h)
+    preempt_syscall_enter();
+    ret_val = syscall_invoke(current_proc, syscall_num, arg1_ebx, arg2_ecx, arg3_edx, regs);
+    preempt_syscall_exit();
 
     regs->eax = (uint32_t)ret_val;
     return ret_val;
@@ -0,0 +1,145 @@
+/**
+ * @file syscall_stats.c
+ * @brief Per-CPU syscall counters and the per-process SYS_STRACE ring.
+ */
+
+#include <kernel/cpu/syscall_stats.h>
+#include <kernel/cpu/get_cpu_id.h>
+#include <kernel/process/process.h>
+#include <kernel/memory/kmalloc.h>
+#include <kernel/memory/uaccess.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/fs/vfs/fs_errno.h>
+#include <kernel/lib/string.h>
+#include <kernel/drivers/display/serial.h>
+
+typedef struct {
+    uint32_t calls;
+    uint32_t errors;
+    uint64_t total_cycles;
+    uint64_t max_cycles;
+} syscall_counter_t;
+
+// Indexed [cpu][nr]; each CPU only writes its own row, with interrupts off
+static syscall_counter_t s_counters[MAX_CPUS][SYSCALL_STATS_NR];
+
+/** The ring behind pcb_t.strace: records[seq & mask], seq counts every record ever written. */
+typedef struct syscall_trace {
+    uint32_t mask;
+    uint32_t seq;
+    syscall_trace_rec_t records[];
+} syscall_trace_t;
+
+void syscall_stats_account(uint32_t nr, int32_t ret, uint64_t cycles) {
+    if (nr >= SYSCALL_STATS_NR) return;
+    // The call may have migrated; count it where it finished
+    uintptr_t irq_flags = local_irq_save();
+    syscall_counter_t *c = &s_counters[get_cpu_id()][nr];
+    c->calls++;
+    if (ret < 0) c->errors++;
+    c->total_cycles += cycles;
+    if (cycles > c->max_cycles) c->max_cycles = cycles;
+    local_irq_restore(irq_flags);
+}
+
+int syscall_stats_get(uint32_t nr, syscall_stats_t *out) {
+    if (nr >= SYSCALL_STATS_NR) return -EINVAL;
+    memset(out, 0, sizeof(*out));
+    out->nr = nr;
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        const syscall_counter_t *c = &s_counters[cpu][nr];
+        out->calls += c->calls;
+        out->errors += c->errors;
+        out->total_cycles += c->total_cycles;
+        if (c->max_cycles > out->max_cycles) out->max_cycles = c->max_cycles;
+    }
+    return 0;
+}
+
+void syscall_trace_record(pcb_t *proc, uint32_t nr, const uint32_t args[3], int32_t ret, uint64_t cycles) {
+    syscall_trace_t *trace = proc->strace;
+    if (!trace) return;
+    syscall_trace_rec_t *rec = &trace->records[trace->seq & trace->mask];
+    rec->nr = nr;
+    rec->args[0] = args[0];
+    rec->args[1] = args[1];
+    rec->args[2] = args[2];
+    rec->ret = ret;
+    rec->cpu = (uint32_t)get_cpu_id();
+    rec->cycles = cycles;
+    trace->seq++;
+}
+
+/** @brief Records still in the ring and the sequence number of the oldest. */
+static uint32_t trace_window(const syscall_trace_t *trace, uint32_t *first) {
+    uint32_t held = trace->seq > trace->mask ? trace->mask + 1 : trace->seq;
+    *first = trace->seq - held;
+    return held;
+}
+
+static void trace_dump(const pcb_t *proc) {
+    const syscall_trace_t *trace = proc->strace;
+    uint32_t first;
+    uint32_t held = trace_window(trace, &first);
+    serial_printf("[strace] PID %lu: last %lu of %lu calls\n", (unsigned long)proc->pid,
+                  (unsigned long)held, (unsigned long)trace->seq);
+    for (uint32_t i = 0; i < held; i++) {
+        const syscall_trace_rec_t *rec = &trace->records[(first + i) & trace->mask];
+        serial_printf("[strace]  #%lu sys%lu(%#lx, %#lx, %#lx) = %ld  [%lu cycles, cpu %lu]\n",
+                      (unsigned long)(first + i), (unsigned long)rec->nr,
+                      (unsigned long)rec->args[0], (unsigned long)rec->args[1], (unsigned long)rec->args[2],
+                      (long)rec->ret, (unsigned long)(rec->cycles > 0xFFFFFFFFu ? 0xFFFFFFFFu : rec->cycles),
+                      (unsigned long)rec->cpu);
+    }
+}
+
+int32_t syscall_trace_ctl(pcb_t *proc, uint32_t op, uint32_t arg2, uint32_t arg3) {
+    syscall_trace_t *trace = proc->strace;
+    switch (op) {
+    case STRACE_START: {
+        uint32_t entries = arg2;
+        if (entries == 0 || entries > SYSCALL_TRACE_MAX_ENTRIES || (entries & (entries - 1))) return -EINVAL;
+        syscall_trace_t *fresh = kmalloc(sizeof(*fresh) + entries * sizeof(syscall_trace_rec_t));
+        if (!fresh) return -ENOMEM;
+        fresh->mask = entries - 1;
+        fresh->seq = 0;
+        proc->strace = fresh;
+        kfree(trace);
+        return 0;
+    }
+    case STRACE_STOP:
+        proc->strace = NULL;
+        kfree(trace);
+        return 0;
+    case STRACE_READ: {
+        if (!trace) return -EINVAL;
+        userptr_t buf = (userptr_t)arg2;
+        uint32_t first;
+        uint32_t held = trace_window(trace, &first);
+        uint32_t count = arg3 / sizeof(syscall_trace_rec_t);
+        if (count > held) count = held;
+        if (count == 0) return 0;
+        if (!access_ok(VERIFY_WRITE, buf, count * sizeof(syscall_trace_rec_t))) return -EFAULT;
+        for (uint32_t i = 0; i < count; i++) {
+            const syscall_trace_rec_t *rec = &trace->records[(first + i) & trace->mask];
+            if (__copy_to_user((userptr_t)((syscall_trace_rec_t *)buf + i), (const_kernelptr_t)rec, sizeof(*rec)) != 0) {
+                return i ? (int32_t)(i * sizeof(*rec)) : -EFAULT;
+            }
+        }
+        return (int32_t)(count * sizeof(syscall_trace_rec_t));
+    }
+    case STRACE_DUMP:
+        if (!trace) return -EINVAL;
+        trace_dump(proc);
+        return 0;
+    default:
+        return -EINVAL;
+    }
+}
+
+void syscall_trace_release(pcb_t *proc) {
+    if (!proc->strace) return;
+    trace_dump(proc);
+    kfree(proc->strace);
+    proc->strace = NULL;
+}
@@ -2,33 +2,57 @@
 #include <kernel/drivers/display/terminal.h>
 #include <kernel/core/types.h>
 #include <kernel/lib/string.h>  // for memset
+#include <kernel/cpu/get_cpu_id.h> // for MAX_CPUS, get_cpu_id
 
-// We define the actual TSS structure here.
-tss_entry_t tss;
+// One TSS per CPU: ESP0 is the kernel stack of whatever runs on that CPU.
+static tss_entry_t tss[MAX_CPUS];
+
+/** @brief TSS of the calling CPU. */
+static inline tss_entry_t *this_cpu_tss(void) {
+    int id = get_cpu_id();
+    if (id < 0 || id >= MAX_CPUS) id = 0;
+    return &tss[id];
+}
+
+tss_entry_t *tss_get_entry(uint32_t cpu) {
+    return (cpu < MAX_CPUS) ? &tss[cpu] : NULL;
+}
 
 /**
- * tss_init - Zeroes out the TSS and sets up essential fields.
+ * tss_init_cpu - Zeroes out CPU @p cpu's TSS and sets up essential fields.
  *
  * This function does not load the TSS into TR; that is done
  * by calling tss_flush() AFTER the GDT is loaded.
  */
-void tss_init(void) {
+void tss_init_cpu(uint32_t cpu) {
+    if (cpu >= MAX_CPUS) return;
+    tss_entry_t *t = &tss[cpu];
+
     // Clear all fields
-    memset(&tss, 0, sizeof(tss_entry_t));
+    memset(t, 0, sizeof(tss_entry_t));
 
     // The kernel data segment selector (index=2 => 0x10).
     // This is used when we enter ring 0 from ring 3 or an interrupt.
-    tss.ss0 = 0x10; // KERNEL_DATA_SELECTOR
+    t->ss0 = 0x10; // KERNEL_DATA_SELECTOR
 
     // Initial ESP0 is 0 (will be updated before use)
-    tss.esp0 = 0;
-    terminal_printf("[TSS] Initial ESP0 set to 0 (will be updated before use)\n");
+    t->esp0 = 0;
 
     // No I/O bitmap => set base after TSS, so no extra bits.
-    tss.iomap_base = sizeof(tss_entry_t);
+    t->iomap_base = sizeof(tss_entry_t);
 
     // We do NOT call tss_flush here (the GDT might not be loaded yet).
-    terminal_write("TSS initialized.\n");
+    if (cpu == 0) {
+        terminal_printf("[TSS] Initial ESP0 set to 0 (will be updated before use)\n");
+        terminal_write("TSS initialized.\n");
+    }
+}
+
+/**
+ * tss_init - Initializes the bootstrap CPU's TSS.
+ */
+void tss_init(void) {
+    tss_init_cpu(0);
 }
 
 /**
@@ -50,7 +74,7 @@ void tss_set_kernel_stack(uint32_t stack) {
         terminal_printf("[TSS WARNING] Setting ESP0 to non-kernel space address: %p\n",
                       (void*)(uintptr_t)stack);
     }
-    tss.esp0 = stack;
+    this_cpu_tss()->esp0 = stack;
     // terminal_printf("[TSS] ESP0 updated to %p\n", (void*)(uintptr_t)stack); // Reduce verbosity maybe
 }
 
@@ -60,21 +84,22 @@ void tss_set_kernel_stack(uint32_t stack) {
  * Returns true if ESP0 is non-zero and appears to be in kernel space
  */
 bool tss_debug_check_esp0(void) {
+    tss_entry_t *t = this_cpu_tss();
     // Check that ESP0 is non-zero
-    if (tss.esp0 == 0) {
+    if (t->esp0 == 0) {
         terminal_printf("[TSS Debug] ERROR: ESP0 is ZERO!\n");
         return false;
     }
 
     // Check that ESP0 is in kernel space (higher half)
     // Check if it's within a reasonable range (e.g., not just barely above C0000000)
-    if (tss.esp0 < 0xC0100000) { // Adjusted lower bound check
+    if (t->esp0 < 0xC0100000) { // Adjusted lower bound check
         terminal_printf("[TSS Debug] ERROR: ESP0 (%p) is suspiciously low in kernel space!\n",
-                      (void*)(uintptr_t)tss.esp0);
+                      (void*)(uintptr_t)t->esp0);
         return false;
     }
 
-    terminal_printf("[TSS Debug] ESP0 looks valid: %p\n", (void*)(uintptr_t)tss.esp0);
+    terminal_printf("[TSS Debug] ESP0 looks valid: %p\n", (void*)(uintptr_t)t->esp0);
     return true;
 }
 
@@ -82,5 +107,5 @@ bool tss_debug_check_esp0(void) {
  * tss_get_esp0 - Returns the current esp0 value from the TSS <<< ADDED
  */
 uint32_t tss_get_esp0(void) {
-    return tss.esp0;
+    return this_cpu_tss()->esp0;
 }
\ No newline at end of file
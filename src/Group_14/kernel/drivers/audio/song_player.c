@@ -1,21 +1,122 @@
 #include <kernel/drivers/audio/song_player.h>
 #include <kernel/drivers/audio/pc_speaker.h>
-#include <kernel/drivers/timer/pit.h>
-#include <kernel/drivers/display/terminal.h>
+#include <kernel/drivers/timer/timer.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/sync/wait_queue.h>
+#include <kernel/process/scheduler.h>   // get_current_task
 
-void play_song(Song *song) {
-    if (!song || !song->notes || song->length == 0)
-        return;
+#define SONG_QUEUE_MASK (SONG_QUEUE_LEN - 1)
+
+// Sequencer state, all under s_song_lock. Songs are numbered in queue
+// order: s_queued counts those ever accepted, s_ended those that finished
+// or were dropped, so song number n is over once s_ended > n.
+static spinlock_t    s_song_lock;
+static wait_queue_t  s_song_waiters;   // play_song() callers
+static timer_entry_t s_note_timer;     // Fires at the end of the current note
+static Song         *s_queue[SONG_QUEUE_LEN];
+static uint32_t      s_queue_head, s_queue_tail;
+static Song         *s_current;
+static uint32_t      s_next_note;      // Index in s_current of the next note
+static uint32_t      s_queued;
+static volatile uint32_t s_ended;
 
-    for (uint32_t i = 0; i < song->length; i++) {
-        Note n = song->notes[i];
+static void note_edge(timer_entry_t *timer, void *arg);
 
-        if (n.frequency == 0)
+// Moves to the next note (or song), programs the speaker and arms the
+// timer for the note's end; lock held. Returns how many songs ended.
+static uint32_t sequencer_step_locked(void) {
+    uint32_t ended = 0;
+    while (!s_current || s_next_note >= s_current->length) {
+        if (s_current) {
+            s_current = NULL;
+            ended++;
+        }
+        if (s_queue_head == s_queue_tail) {
             stop_sound();
-        else
-            play_sound(n.frequency);
+            return ended;
+        }
+        s_current = s_queue[s_queue_head++ & SONG_QUEUE_MASK];
+        s_next_note = 0;
+    }
 
-        sleep_interrupt(n.duration);
+    Note n = s_current->notes[s_next_note++];
+    if (n.frequency == 0)
         stop_sound();
+    else
+        play_sound(n.frequency); // Reprograms channel 2; the speaker stays on between notes
+    timer_schedule_ms(&s_note_timer, n.duration, note_edge, NULL);
+    return ended;
+}
+
+static void songs_ended(uint32_t ended) {
+    if (!ended) return;
+    s_ended += ended;
+    if (wait_queue_active(&s_song_waiters)) wake_up_all(&s_song_waiters);
+}
+
+// Timer softirq: the current note is over
+static void note_edge(timer_entry_t *timer, void *arg) {
+    (void)timer; (void)arg;
+    uintptr_t flags = spinlock_acquire_irqsave(&s_song_lock);
+    uint32_t ended = sequencer_step_locked();
+    songs_ended(ended);
+    spinlock_release_irqrestore(&s_song_lock, flags);
+}
+
+void song_player_init(void) {
+    spinlock_init_named(&s_song_lock, "song_player");
+    wait_queue_init(&s_song_waiters);
+}
+
+// Queues @p song; its number goes to @p ticket. False if the queue is full.
+static bool queue_song_ticket(Song *song, uint32_t *ticket) {
+    if (!song || !song->notes || song->length == 0)
+        return false;
+
+    uintptr_t flags = spinlock_acquire_irqsave(&s_song_lock);
+    if (s_queue_tail - s_queue_head >= SONG_QUEUE_LEN) {
+        spinlock_release_irqrestore(&s_song_lock, flags);
+        return false;
     }
+    s_queue[s_queue_tail++ & SONG_QUEUE_MASK] = song;
+    *ticket = s_queued++;
+    if (!s_current) songs_ended(sequencer_step_locked()); // Idle: start now
+    spinlock_release_irqrestore(&s_song_lock, flags);
+    return true;
+}
+
+bool queue_song(Song *song) {
+    uint32_t ticket;
+    return queue_song_ticket(song, &ticket);
+}
+
+void play_song(Song *song) {
+    uint32_t ticket;
+    if (!queue_song_ticket(song, &ticket) || !get_current_task())
+        return;
+    wait_event(&s_song_waiters, (int32_t)(s_ended - ticket) > 0);
+}
+
+void play_song_async(Song *song) {
+    stop_song();
+    queue_song(song);
+}
+
+void stop_song(void) {
+    // Before taking the lock, which a callback already running needs. One
+    // that slips in re-arms the timer; that edge finds the queue empty (or
+    // at worst cuts short the first note of a song queued right after)
+    timer_cancel(&s_note_timer);
+
+    uintptr_t flags = spinlock_acquire_irqsave(&s_song_lock);
+    uint32_t dropped = (s_current ? 1 : 0) + (s_queue_tail - s_queue_head);
+    s_current = NULL;
+    s_queue_head = s_queue_tail;
+    stop_sound();
+    songs_ended(dropped);
+    spinlock_release_irqrestore(&s_song_lock, flags);
+}
+
+bool song_playing(void) {
+    return s_current != NULL;
 }
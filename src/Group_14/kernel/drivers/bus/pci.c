@@ -0,0 +1,81 @@
+/**
+ * @file pci.c
+ * @brief PCI configuration space access and class lookup.
+ *
+ * @details Uses configuration mechanism #1. Every function is probed by brute
+ * force on first lookup; with no hotplug that is done once per driver init.
+ */
+
+#include <kernel/drivers/bus/pci.h>
+#include <kernel/lib/port_io.h>
+
+static inline uint32_t pci_address(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    return 0x80000000u | ((uint32_t)bus << 16) | ((uint32_t)(slot & 0x1F) << 11) |
+           ((uint32_t)(func & 0x07) << 8) | (offset & 0xFC);
+}
+
+uint32_t pci_config_read32(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    outl(PCI_CONFIG_ADDRESS, pci_address(bus, slot, func, offset));
+    return inl(PCI_CONFIG_DATA);
+}
+
+uint16_t pci_config_read16(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    return (uint16_t)(pci_config_read32(bus, slot, func, offset) >> ((offset & 2) * 8));
+}
+
+uint8_t pci_config_read8(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    return (uint8_t)(pci_config_read32(bus, slot, func, offset) >> ((offset & 3) * 8));
+}
+
+void pci_config_write32(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t value) {
+    outl(PCI_CONFIG_ADDRESS, pci_address(bus, slot, func, offset));
+    outl(PCI_CONFIG_DATA, value);
+}
+
+void pci_config_write16(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint16_t value) {
+    // A 16-bit data port access leaves the neighbouring (e.g. RW1C status) half alone
+    outl(PCI_CONFIG_ADDRESS, pci_address(bus, slot, func, offset));
+    outw((uint16_t)(PCI_CONFIG_DATA + (offset & 2)), value);
+}
+
+bool pci_find_class(uint8_t class_code, uint8_t subclass, int index, pci_device_t *out) {
+    for (uint32_t bus = 0; bus < 256; bus++) {
+        for (uint8_t slot = 0; slot < 32; slot++) {
+            if (pci_config_read16((uint8_t)bus, slot, 0, PCI_VENDOR_ID) == PCI_VENDOR_NONE) continue;
+            bool multi = pci_config_read8((uint8_t)bus, slot, 0, PCI_HEADER_TYPE) & 0x80;
+
+            for (uint8_t func = 0; func < (multi ? 8 : 1); func++) {
+                uint16_t vendor = pci_config_read16((uint8_t)bus, slot, func, PCI_VENDOR_ID);
+                if (vendor == PCI_VENDOR_NONE) continue;
+                if (pci_config_read8((uint8_t)bus, slot, func, PCI_CLASS) != class_code ||
+                    pci_config_read8((uint8_t)bus, slot, func, PCI_SUBCLASS) != subclass) continue;
+                if (index-- > 0) continue;
+
+                if (out) {
+                    out->bus = (uint8_t)bus;
+                    out->slot = slot;
+                    out->func = func;
+                    out->vendor_id = vendor;
+                    out->device_id = pci_config_read16((uint8_t)bus, slot, func, PCI_DEVICE_ID);
+                    out->class_code = class_code;
+                    out->subclass = subclass;
+                    out->prog_if = pci_config_read8((uint8_t)bus, slot, func, PCI_PROG_IF);
+                    out->irq_line = pci_config_read8((uint8_t)bus, slot, func, PCI_INTERRUPT_LINE);
+                }
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+uint32_t pci_read_bar(const pci_device_t *dev, int n) {
+    if (!dev || n < 0 || n > 5) return 0;
+    return pci_config_read32(dev->bus, dev->slot, dev->func, (uint8_t)(PCI_BAR0 + n * 4));
+}
+
+void pci_enable(const pci_device_t *dev, uint16_t command_bits) {
+    if (!dev) return;
+    uint16_t cmd = pci_config_read16(dev->bus, dev->slot, dev->func, PCI_COMMAND);
+    pci_config_write16(dev->bus, dev->slot, dev->func, PCI_COMMAND, cmd | command_bits);
+}
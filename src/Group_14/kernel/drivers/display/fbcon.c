@@ -0,0 +1,168 @@
+/**
+ * @file fbcon.c
+ * @brief Framebuffer console: the terminal's text cells on a linear framebuffer.
+ */
+
+#include <kernel/drivers/display/fbcon.h>
+#include <kernel/drivers/display/font8x8.h>
+#include <kernel/drivers/display/terminal.h> // VGA_COLS, VGA_ROWS
+#include <kernel/drivers/display/serial.h>
+#include <kernel/memory/kmalloc.h>
+#include <kernel/memory/paging.h>            // paging_map_mmio
+#include <kernel/lib/string.h>
+
+#define GLYPH_W          8
+#define GLYPH_H          16   // The 8x8 font with every row doubled
+#define BACK_W           (VGA_COLS * GLYPH_W)
+#define BACK_H           (VGA_ROWS * GLYPH_H)
+#define CURSOR_LINES     2    // Underline cursor at the bottom of the cell
+#define FBCON_CACHE_SIZE 256  // Glyph cache slots, power of two
+#define FBCON_STALE      0xFFFFFFFFu // Never a cell value
+#define FBCON_CURSOR     0x10000u    // Cell flag in s_shadow: drawn with the cursor
+
+// One pre-rendered cell: a character in one attribute, in framebuffer pixels.
+typedef struct glyph_slot {
+    uint32_t key; // Cell value (character | attribute << 8), or FBCON_STALE
+    uint32_t px[GLYPH_H][GLYPH_W];
+} glyph_slot_t;
+
+static uint8_t      *s_fb = NULL;      // Console's top-left pixel in the framebuffer
+static uint32_t      s_fb_pitch = 0;   // Bytes per framebuffer line
+static uint32_t     *s_back = NULL;    // BACK_W x BACK_H pixels
+static glyph_slot_t *s_cache = NULL;
+static uint32_t      s_palette[16];    // VGA colours in framebuffer format
+static uint32_t      s_shadow[VGA_ROWS * VGA_COLS]; // What s_back shows per cell
+
+// The standard VGA text palette, as 0xRRGGBB
+static const uint32_t s_vga_rgb[16] = {
+    0x000000, 0x0000AA, 0x00AA00, 0x00AAAA, 0xAA0000, 0xAA00AA, 0xAA5500, 0xAAAAAA,
+    0x555555, 0x5555FF, 0x55FF55, 0x55FFFF, 0xFF5555, 0xFF55FF, 0xFFFF55, 0xFFFFFF,
+};
+
+static uint32_t fbcon_pack(uint32_t value8, uint8_t pos, uint8_t size) {
+    if (size == 0) return 0;
+    if (size < 8) value8 >>= (8 - size);
+    return value8 << pos;
+}
+
+static const glyph_slot_t *fbcon_glyph(uint16_t cell) {
+    glyph_slot_t *slot = &s_cache[((cell * 0x9E37u) >> 8) & (FBCON_CACHE_SIZE - 1)];
+    if (slot->key == cell) return slot;
+
+    uint8_t ch = (uint8_t)(cell & 0xFF);
+    uint32_t fg = s_palette[(cell >> 8) & 0x0F];
+    uint32_t bg = s_palette[(cell >> 12) & 0x0F];
+    const uint8_t *rows = (ch >= FONT8X8_FIRST && ch < FONT8X8_FIRST + FONT8X8_COUNT)
+                          ? g_font8x8[ch - FONT8X8_FIRST] : g_font8x8[0];
+    for (int y = 0; y < GLYPH_H; y++) {
+        uint8_t bits = rows[y / 2];
+        for (int x = 0; x < GLYPH_W; x++) {
+            slot->px[y][x] = (bits & (1u << x)) ? fg : bg;
+        }
+    }
+    slot->key = cell;
+    return slot;
+}
+
+static void fbcon_draw_cell(int row, int col, uint32_t value) {
+    const glyph_slot_t *glyph = fbcon_glyph((uint16_t)value);
+    uint32_t *dst = s_back + (size_t)row * GLYPH_H * BACK_W + (size_t)col * GLYPH_W;
+    for (int y = 0; y < GLYPH_H; y++) {
+        memcpy(dst + (size_t)y * BACK_W, glyph->px[y], sizeof(glyph->px[y]));
+    }
+    if (value & FBCON_CURSOR) {
+        uint32_t fg = s_palette[(value >> 8) & 0x0F];
+        for (int y = GLYPH_H - CURSOR_LINES; y < GLYPH_H; y++) {
+            for (int x = 0; x < GLYPH_W; x++) dst[(size_t)y * BACK_W + x] = fg;
+        }
+    }
+}
+
+void fbcon_present(const volatile uint16_t *cells, int cursor, int scrolled) {
+    if (!s_fb) return;
+    int dirty_lo[VGA_ROWS], dirty_hi[VGA_ROWS]; // Changed column span per row
+
+    if (scrolled > 0 && scrolled < VGA_ROWS) {
+        // Move the back buffer with the text; every row then has to reach the screen
+        size_t kept_rows = VGA_ROWS - scrolled;
+        memmove(s_back, s_back + (size_t)scrolled * GLYPH_H * BACK_W,
+                kept_rows * GLYPH_H * BACK_W * sizeof(uint32_t));
+        memmove(s_shadow, s_shadow + (size_t)scrolled * VGA_COLS, kept_rows * VGA_COLS * sizeof(uint32_t));
+        for (size_t i = kept_rows * VGA_COLS; i < VGA_ROWS * VGA_COLS; i++) s_shadow[i] = FBCON_STALE;
+        for (int row = 0; row < VGA_ROWS; row++) { dirty_lo[row] = 0; dirty_hi[row] = VGA_COLS; }
+    } else {
+        for (int row = 0; row < VGA_ROWS; row++) { dirty_lo[row] = VGA_COLS; dirty_hi[row] = 0; }
+    }
+
+    for (int row = 0; row < VGA_ROWS; row++) {
+        for (int col = 0; col < VGA_COLS; col++) {
+            int i = row * VGA_COLS + col;
+            uint32_t value = cells[i] | (i == cursor ? FBCON_CURSOR : 0);
+            if (s_shadow[i] == value) continue;
+            fbcon_draw_cell(row, col, value);
+            s_shadow[i] = value;
+            if (col < dirty_lo[row]) dirty_lo[row] = col;
+            if (col + 1 > dirty_hi[row]) dirty_hi[row] = col + 1;
+        }
+    }
+
+    // Copy each row's dirty span to the framebuffer, one pixel line at a time
+    for (int row = 0; row < VGA_ROWS; row++) {
+        if (dirty_hi[row] <= dirty_lo[row]) continue;
+        size_t x0 = (size_t)dirty_lo[row] * GLYPH_W;
+        size_t bytes = (size_t)(dirty_hi[row] - dirty_lo[row]) * GLYPH_W * sizeof(uint32_t);
+        for (int y = row * GLYPH_H; y < (row + 1) * GLYPH_H; y++) {
+            memcpy(s_fb + (size_t)y * s_fb_pitch + x0 * sizeof(uint32_t),
+                   s_back + (size_t)y * BACK_W + x0, bytes);
+        }
+    }
+}
+
+bool fbcon_init(const struct multiboot_tag_framebuffer *tag) {
+    if (!tag) return false;
+    const struct multiboot_tag_framebuffer_common *fb = &tag->common;
+    if (fb->framebuffer_type != MULTIBOOT_FRAMEBUFFER_TYPE_RGB || fb->framebuffer_bpp != 32) {
+        serial_printf("[FBCon] Framebuffer type %u, %u bpp: not supported.\n",
+                      (unsigned)fb->framebuffer_type, (unsigned)fb->framebuffer_bpp);
+        return false;
+    }
+    if ((fb->framebuffer_addr >> 32) != 0 || fb->framebuffer_width < BACK_W || fb->framebuffer_height < BACK_H) {
+        serial_printf("[FBCon] Framebuffer %lux%lu: not usable.\n",
+                      (unsigned long)fb->framebuffer_width, (unsigned long)fb->framebuffer_height);
+        return false;
+    }
+
+    s_back = (uint32_t *)kmalloc((size_t)BACK_W * BACK_H * sizeof(uint32_t));
+    s_cache = (glyph_slot_t *)kmalloc(sizeof(glyph_slot_t) * FBCON_CACHE_SIZE);
+    size_t fb_size = (size_t)fb->framebuffer_pitch * fb->framebuffer_height;
+    uint8_t *front = s_back && s_cache ? (uint8_t *)paging_map_mmio((uintptr_t)fb->framebuffer_addr, fb_size) : NULL;
+    if (!front) {
+        if (s_back) kfree(s_back);
+        if (s_cache) kfree(s_cache);
+        s_back = NULL;
+        s_cache = NULL;
+        serial_write("[FBCon] Out of memory or MMIO space.\n");
+        return false;
+    }
+
+    for (int i = 0; i < 16; i++) {
+        uint32_t rgb = s_vga_rgb[i];
+        s_palette[i] = fbcon_pack((rgb >> 16) & 0xFF, tag->framebuffer_red_field_position, tag->framebuffer_red_mask_size)
+                     | fbcon_pack((rgb >> 8) & 0xFF, tag->framebuffer_green_field_position, tag->framebuffer_green_mask_size)
+                     | fbcon_pack(rgb & 0xFF, tag->framebuffer_blue_field_position, tag->framebuffer_blue_mask_size);
+    }
+    for (int i = 0; i < FBCON_CACHE_SIZE; i++) s_cache[i].key = FBCON_STALE;
+    for (int i = 0; i < VGA_ROWS * VGA_COLS; i++) s_shadow[i] = FBCON_STALE;
+
+    // Black border around the centred console
+    for (uint32_t y = 0; y < fb->framebuffer_height; y++) {
+        memset(front + (size_t)y * fb->framebuffer_pitch, 0, (size_t)fb->framebuffer_width * sizeof(uint32_t));
+    }
+    s_fb_pitch = fb->framebuffer_pitch;
+    s_fb = front + (size_t)((fb->framebuffer_height - BACK_H) / 2) * s_fb_pitch
+                 + (size_t)((fb->framebuffer_width - BACK_W) / 2) * sizeof(uint32_t);
+    serial_printf("[FBCon] %lux%lu framebuffer at %#lx, console %dx%d cells.\n",
+                  (unsigned long)fb->framebuffer_width, (unsigned long)fb->framebuffer_height,
+                  (unsigned long)fb->framebuffer_addr, VGA_COLS, VGA_ROWS);
+    return true;
+}
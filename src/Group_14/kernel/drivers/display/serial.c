@@ -1,33 +1,172 @@
 #include <kernel/drivers/display/serial.h>
 #include <kernel/lib/port_io.h> // For inb/outb
 #include <kernel/drivers/display/terminal.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/cpu/idt.h>     // register_int_handler, irq_send_eoi, IRQ4_VECTOR
+#include <kernel/lib/format.h>     // _vsnprintf
 #include <libc/stdarg.h>
 
+// 16550 registers (offsets from SERIAL_COM1_BASE)
+#define UART_DATA 0 // THR on write
+#define UART_IER  1 // Interrupt Enable
+#define UART_IIR  2 // Interrupt Identification on read, FIFO Control on write
+#define UART_LCR  3 // Line Control
+#define UART_MCR  4 // Modem Control
+#define UART_LSR  5 // Line Status
+
 // LSR (Line Status Register) flags
-#define LSR_TX_EMPTY 0x20 // Transmitter Holding Register Empty
+#define LSR_TX_EMPTY 0x20 // Transmitter Holding Register (with FIFO: the whole FIFO) Empty
+
+#define IER_THRE      0x02 // Interrupt when the transmit FIFO runs empty
+#define MCR_DTR_RTS   0x03
+#define MCR_OUT2      0x08 // Gates the UART's interrupt line on PC hardware
+#define UART_FIFO_LEN 16   // Bytes the transmit FIFO takes after LSR_TX_EMPTY
+
+//----------------------------------------------------------------------------
+// Transmit ring
+//----------------------------------------------------------------------------
+// Writers only copy into memory: each one reserves its bytes by moving
+// s_tx_reserve with a locked CMPXCHG, fills them with interrupts off, and
+// publishes them by moving s_tx_commit in reservation order (a writer waits
+// for the ones that reserved before it, which are only copying). The COM1
+// THRE interrupt moves committed bytes into the UART FIFO, UART_FIFO_LEN
+// at a time; s_tx_lock serialises that consumer side only. Counters run
+// freely and are reduced with SERIAL_TX_RING_MASK on access.
+// Until serial_enable_irq() runs, and for good once serial_flush_sync()
+// has (panics), every write goes straight to the UART by polling.
+#define SERIAL_TX_RING_SIZE 16384 // Power of two
+#define SERIAL_TX_RING_MASK (SERIAL_TX_RING_SIZE - 1)
+
+static char              s_tx_ring[SERIAL_TX_RING_SIZE];
+static volatile uint32_t s_tx_reserve = 0; // End of the reserved bytes
+static volatile uint32_t s_tx_commit = 0;  // End of the bytes ready to send
+static volatile uint32_t s_tx_tail = 0;    // Next byte for the UART
+static volatile bool     s_tx_busy = false; // A THRE interrupt is on its way
+static volatile bool     s_tx_irq = false;  // Writes are buffered
+static spinlock_t        s_tx_lock;
 
 // Wait until the serial port is ready to send
 static int is_transmit_empty() {
-  return inb(SERIAL_COM1_BASE + 5) & LSR_TX_EMPTY;
+  return inb(SERIAL_COM1_BASE + UART_LSR) & LSR_TX_EMPTY;
 }
 
-// Send a single character
-void serial_putchar(char c) {
+static void uart_putc_poll(char c) {
   while (is_transmit_empty() == 0); // Wait until ready
-  outb(SERIAL_COM1_BASE, c);
+  outb(SERIAL_COM1_BASE + UART_DATA, c);
+}
+
+static inline bool tx_reserve_cas(uint32_t old, uint32_t new_val) {
+  uint32_t prev;
+  asm volatile("lock cmpxchgl %2, %1"
+               : "=a"(prev), "+m"(s_tx_reserve)
+               : "r"(new_val), "0"(old)
+               : "memory", "cc");
+  return prev == old;
+}
+
+// Moves committed bytes into the FIFO while it has room; s_tx_lock held.
+static void tx_fill_fifo(void) {
+  if (!is_transmit_empty()) return;
+  for (int i = 0; i < UART_FIFO_LEN && s_tx_tail != s_tx_commit; i++) {
+    outb(SERIAL_COM1_BASE + UART_DATA, s_tx_ring[s_tx_tail & SERIAL_TX_RING_MASK]);
+    s_tx_tail++;
+  }
+}
 
-  // If sending newline, also send carriage return for compatibility
-  if (c == '\n') {
-    while (is_transmit_empty() == 0);
-    outb(SERIAL_COM1_BASE, '\r');
+// Polls committed bytes out until @p needed bytes of the ring are free.
+// For a writer that found the ring full (interrupts off for too long).
+static void tx_make_room(uint32_t needed) {
+  uintptr_t flags = spinlock_acquire_irqsave(&s_tx_lock);
+  while (SERIAL_TX_RING_SIZE - (s_tx_reserve - s_tx_tail) < needed) {
+    if (s_tx_tail != s_tx_commit) {
+      uart_putc_poll(s_tx_ring[s_tx_tail & SERIAL_TX_RING_MASK]);
+      s_tx_tail++;
+    } else {
+      asm volatile("pause" ::: "memory"); // Earlier writers are still copying
+    }
   }
+  spinlock_release_irqrestore(&s_tx_lock, flags);
+}
+
+// Queues @p len bytes of @p str, turning each '\n' into "\n\r".
+static void serial_tx_write(const char *str, size_t len) {
+  if (!s_tx_irq) {
+    for (size_t i = 0; i < len; i++) {
+      uart_putc_poll(str[i]);
+      if (str[i] == '\n') uart_putc_poll('\r'); // CR after LF for terminal compatibility
+    }
+    return;
+  }
+
+  uint32_t needed = len;
+  for (size_t i = 0; i < len; i++) {
+    if (str[i] == '\n') needed++;
+  }
+  if (needed == 0) return;
+  if (needed > SERIAL_TX_RING_SIZE) needed = SERIAL_TX_RING_SIZE; // Tail of a huge write is dropped
+
+  uintptr_t irq_flags = local_irq_save(); // A writer must not be interrupted between reserve and commit
+  uint32_t start;
+  for (;;) {
+    start = s_tx_reserve;
+    if (SERIAL_TX_RING_SIZE - (start - s_tx_tail) < needed) {
+      tx_make_room(needed);
+      continue;
+    }
+    if (tx_reserve_cas(start, start + needed)) break;
+  }
+
+  uint32_t pos = start;
+  for (size_t i = 0; i < len && pos - start < needed; i++) {
+    s_tx_ring[pos++ & SERIAL_TX_RING_MASK] = str[i];
+    if (str[i] == '\n' && pos - start < needed) s_tx_ring[pos++ & SERIAL_TX_RING_MASK] = '\r';
+  }
+
+  while (s_tx_commit != start) asm volatile("pause" ::: "memory");
+  asm volatile("" ::: "memory"); // Bytes before the commit (x86 keeps store order)
+  s_tx_commit = start + needed;
+
+  // Start the transmitter unless an interrupt will pick the bytes up
+  if (!s_tx_busy) {
+    spinlock_acquire_irqsave(&s_tx_lock);
+    if (!s_tx_busy) {
+      tx_fill_fifo();
+      s_tx_busy = true; // Either bytes went out or the FIFO was busy: THRE follows
+    }
+    spinlock_release_irqrestore(&s_tx_lock, irq_flags);
+  } else {
+    local_irq_restore(irq_flags);
+  }
+}
+
+static void serial_irq4_handler(isr_frame_t *frame) {
+  (void)frame;
+  (void)inb(SERIAL_COM1_BASE + UART_IIR); // Reading IIR acknowledges THRE
+  uintptr_t flags = spinlock_acquire_irqsave(&s_tx_lock);
+  if (s_tx_tail == s_tx_commit) {
+    s_tx_busy = false; // Nothing left: the next writer restarts the FIFO
+  } else {
+    tx_fill_fifo();
+    s_tx_busy = true;
+  }
+  spinlock_release_irqrestore(&s_tx_lock, flags);
+  irq_send_eoi(4);
+}
+
+// Send a single character
+void serial_putchar(char c) {
+  serial_tx_write(&c, 1);
 }
 
 // Send a null-terminated string
 void serial_write(const char *str) {
-  for (size_t i = 0; str[i] != '\0'; i++) {
-    serial_putchar(str[i]);
-  }
+  size_t len = 0;
+  while (str[len] != '\0') len++;
+  serial_tx_write(str, len);
+}
+
+void serial_write_len(const char *data, size_t len) {
+  serial_tx_write(data, len);
 }
 
 void serial_print_hex(uint32_t n) {
@@ -41,31 +180,45 @@ void serial_print_hex(uint32_t n) {
   serial_write(buf); // Write the hex string
 }
 
-// Optional: Basic Initialization (can set baud rate, etc., but often works with defaults in QEMU)
-// Forward declaration for _vsnprintf from terminal.c
-extern int _vsnprintf(char *str, size_t size, const char *fmt, va_list args);
-
 void serial_printf(const char *fmt, ...) {
     char buf[256];
     va_list args;
     va_start(args, fmt);
     int len = _vsnprintf(buf, sizeof(buf), fmt, args);
     va_end(args);
-    
-    for (int i = 0; i < len; ++i) {
-        serial_putchar(buf[i]);
-    }
+
+    if (len > (int)sizeof(buf) - 1) len = sizeof(buf) - 1;
+    if (len > 0) serial_tx_write(buf, (size_t)len);
+}
+
+void serial_flush_sync(void) {
+  // In a panic another CPU may hold the lock for good, and nothing may run
+  // again: push everything committed out by polling, and poll from now on.
+  s_tx_irq = false;
+  outb(SERIAL_COM1_BASE + UART_IER, 0);
+  while (s_tx_tail != s_tx_commit) {
+    uart_putc_poll(s_tx_ring[s_tx_tail & SERIAL_TX_RING_MASK]);
+    s_tx_tail++;
+  }
+}
+
+void serial_enable_irq(void) {
+  register_int_handler(IRQ4_VECTOR, serial_irq4_handler, NULL);
+  outb(SERIAL_COM1_BASE + UART_MCR, MCR_DTR_RTS | MCR_OUT2);
+  outb(SERIAL_COM1_BASE + UART_IER, IER_THRE);
+  s_tx_irq = true;
+  serial_write("[Serial] COM1 transmit is interrupt driven.\n");
 }
 
 void serial_init() {
-   // Basic init - QEMU often defaults work fine
-   // Example: Set baud rate divisor (requires accessing other registers)
-   // outb(SERIAL_COM1_BASE + 3, 0x80); // Enable DLAB (set baud rate divisor)
-   // outb(SERIAL_COM1_BASE + 0, 0x03); // Set divisor to 3 (lo byte) 38400 baud
-   // outb(SERIAL_COM1_BASE + 1, 0x00); //                  (hi byte)
-   // outb(SERIAL_COM1_BASE + 3, 0x03); // 8 bits, no parity, one stop bit (8N1)
-   // outb(SERIAL_COM1_BASE + 2, 0xC7); // Enable FIFO, clear them, with 14-byte threshold
-   // outb(SERIAL_COM1_BASE + 4, 0x0B); // IRQs enabled, RTS/DSR set
-   terminal_write("[Serial] COM1 Initialized (basic).\n"); // Log to screen
+   spinlock_init_named(&s_tx_lock, "serial_tx");
+   outb(SERIAL_COM1_BASE + UART_IER, 0x00); // No interrupts until serial_enable_irq()
+   outb(SERIAL_COM1_BASE + UART_LCR, 0x80); // Enable DLAB (set baud rate divisor)
+   outb(SERIAL_COM1_BASE + UART_DATA, 0x03); // Set divisor to 3 (lo byte) 38400 baud
+   outb(SERIAL_COM1_BASE + UART_IER, 0x00); //                  (hi byte)
+   outb(SERIAL_COM1_BASE + UART_LCR, 0x03); // 8 bits, no parity, one stop bit (8N1)
+   outb(SERIAL_COM1_BASE + UART_IIR, 0xC7); // Enable FIFO, clear them, with 14-byte threshold
+   outb(SERIAL_COM1_BASE + UART_MCR, MCR_DTR_RTS);
+   terminal_write("[Serial] COM1 Initialized (38400 8N1, FIFO on).\n"); // Log to screen
    serial_write("[Serial] COM1 output working.\n"); // Test serial output itself
-}
\ No newline at end of file
+}
@@ -11,15 +11,16 @@
  #include <kernel/core/types.h>          // For pid_t, ssize_t, etc.
  #include <kernel/sync/spinlock.h>
  #include <kernel/drivers/display/serial.h>         // For serial_write, serial_print_hex, serial_putchar
+ #include <kernel/drivers/display/fbcon.h>          // fbcon_present (framebuffer console)
  #include <kernel/lib/assert.h>
- #include <kernel/process/scheduler.h>      // For get_current_task, schedule, tcb_t, TASK_BLOCKED, TASK_READY, scheduler_unblock_task
- #include <kernel/fs/vfs/fs_errno.h>       // For error codes like -EINTR if interrupting sleep
+ #include <kernel/drivers/input/tty.h>       // tty_receive (keyboard input goes to the line discipline)
  
  #include <libc/stdarg.h>
  #include <libc/stdbool.h>
  #include <libc/stddef.h>
  #include <libc/stdint.h>
  #include <kernel/lib/string.h>         // Kernel's string functions
+ #include <kernel/lib/format.h>         // _vsnprintf
  
  /* ------------------------------------------------------------------------- */
  /* Utility Macros                                                            */
@@ -46,6 +47,10 @@
  #define VGA_REG_CURSOR_LO   0x0F
  #define VGA_REG_CURSOR_START 0x0A
  #define VGA_REG_CURSOR_END   0x0B
+ #define VGA_REG_START_HI     0x0C
+ #define VGA_REG_START_LO     0x0D
+ #define VGA_WINDOW_ROWS     ((32 * 1024) / (VGA_COLS * 2)) // Text rows in the 32 KiB at 0xB8000
+ #define SCROLLBACK_LINES    256 // Power of two
  #define CURSOR_SCANLINE_START 14 // Typiske verdier for en blokkmarkør
  #define CURSOR_SCANLINE_END   15
  
@@ -69,24 +74,29 @@
  /* ------------------------------------------------------------------------- */
  static spinlock_t terminal_lock;
  static uint8_t    terminal_color = VGA_RGB(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
- static volatile uint16_t * const vga_buffer = (volatile uint16_t *)VGA_ADDRESS; 
+ static volatile uint16_t *vga_buffer = (volatile uint16_t *)VGA_ADDRESS; // fb_window once on a framebuffer
  static int        cursor_x = 0;
  static int        cursor_y = 0;
+ static int        vga_top = 0;        // Window row shown as screen row 0
+ static int        vga_hist_rows = 0;  // Rows right above vga_top that still hold the last lines scrolled off
+ static int        view_offset = 0;    // Lines the view is scrolled back, 0 when live
+ static uint16_t   scrollback[SCROLLBACK_LINES][VGA_COLS];
+ static uint32_t   scrollback_count = 0; // Lines ever scrolled off
+ static int        vga_start_row = 0;  // Window row at the top of the display
+ 
+ // Framebuffer console: the text window lives in RAM and fbcon draws it
+ static bool       fb_console = false;
+ static uint16_t   fb_window[VGA_WINDOW_ROWS * VGA_COLS];
+ static int        fb_scrolled = 0;    // Lines scrolled since the last fbcon_present
  static uint8_t    cursor_visible = 1; 
+ static volatile bool cursor_dirty = false; // Output moved the cursor; terminal_tick() updates the hardware
+ static int        hw_cursor_pos = -1;      // What the CRTC was last told, -1 before the first update
+ static int        hw_cursor_shown = -1;
  static AnsiState  ansi_state = ANSI_STATE_NORMAL;
  static bool       ansi_private = false;
  static int        ansi_params[4]; 
  static int        ansi_param_count = 0;
  
- /* ------------------------------------------------------------------------- */
- /* Single-Line Input Buffer for SYS_READ_TERMINAL                            */
- /* ------------------------------------------------------------------------- */
- static char       s_line_buffer[MAX_INPUT_LENGTH];
- static volatile size_t s_line_buffer_len = 0;
- static volatile bool s_line_ready_for_read = false;
- static volatile tcb_t *s_waiting_task = NULL; 
- static spinlock_t s_line_buffer_lock;
- 
  /* ------------------------------------------------------------------------- */
  /* Interactive multi-line input (Separate from single-line syscall input)    */
  /* ------------------------------------------------------------------------- */
@@ -103,49 +113,6 @@
  
  static terminal_input_state_t input_state; 
  
- // --- Static Helper Function: itoa_simple ---
- static int itoa_simple(size_t val, char *buf, int base) {
-     char *p = buf;
-     char *p1, *p2;
-     uint32_t ud = val; 
-     int digits = 0;
- 
-     if (base != 10) { 
-         if (buf) {
-             buf[0] = '?'; 
-             buf[1] = '\0';
-         }
-         return 1;
-     }
- 
-     if (val == 0) {
-         if (buf) {
-             buf[0] = '0';
-             buf[1] = '\0';
-         }
-         return 1;
-     }
- 
-     do {
-         if (p - buf >= 11) break; 
-         *p++ = (ud % base) + '0';
-         digits++;
-     } while (ud /= base);
- 
-     *p = '\0'; 
- 
-     p1 = buf;
-     p2 = p - 1;
-     while (p1 < p2) {
-         char tmp = *p1;
-         *p1 = *p2;
-         *p2 = tmp;
-         p1++;
-         p2--;
-     }
-     return digits;
- }
- 
  /* ------------------------------------------------------------------------- */
  /* Forward declarations for other static functions                           */
  /* ------------------------------------------------------------------------- */
@@ -155,6 +122,7 @@
  static void put_char_at(char c, uint8_t color, int x, int y);
  static void clear_row(int row, uint8_t color);
  static void scroll_terminal(void);
+ static void scrollback_show(int lines);
  static void __attribute__((unused)) redraw_input(void); 
  static void __attribute__((unused)) update_desired_column(void); 
  static void __attribute__((unused)) insert_character(char c);
@@ -163,10 +131,6 @@
  static void terminal_putchar_internal(char c); 
  static void terminal_clear_internal(void); 
  
- int _vsnprintf(char *str, size_t size, const char *fmt, va_list args);
- // *** MODIFIED _format_number signature ***
- static int _format_number(unsigned long num, bool is_negative, int base, bool upper, // Changed from unsigned long long
-                           int min_width, bool zero_pad, char *buf, int buf_sz);
  
  /* ------------------------------------------------------------------------- */
  /* Helpers                                                                   */
@@ -198,38 +162,83 @@
      if (local_cursor_y < 0)            { local_cursor_y = 0; }
      if (local_cursor_x >= VGA_COLS)    { local_cursor_x = VGA_COLS - 1; }
      if (local_cursor_y >= VGA_ROWS)    { local_cursor_y = VGA_ROWS - 1; }
+ 
+     if (fb_console) {
+         bool fb_shown = cursor_visible && !input_state.is_active && view_offset == 0;
+         fbcon_present(vga_buffer + (size_t)vga_start_row * VGA_COLS,
+                       fb_shown ? local_cursor_y * VGA_COLS + local_cursor_x : -1, fb_scrolled);
+         fb_scrolled = 0;
+         cursor_dirty = false;
+         return;
+     }
      
-     uint16_t pos = (uint16_t)(local_cursor_y * VGA_COLS + local_cursor_x);
-     outb(VGA_CMD_PORT, VGA_REG_CURSOR_LO); outb(VGA_DATA_PORT, (uint8_t)(pos & 0xFF));
-     outb(VGA_CMD_PORT, VGA_REG_CURSOR_HI); outb(VGA_DATA_PORT, (uint8_t)((pos >> 8) & 0xFF));
+     // Port writes are slow: only the registers that change are written
+     uint16_t pos = (uint16_t)((vga_top + local_cursor_y) * VGA_COLS + local_cursor_x);
+     if (pos != hw_cursor_pos) {
+         outb(VGA_CMD_PORT, VGA_REG_CURSOR_LO); outb(VGA_DATA_PORT, (uint8_t)(pos & 0xFF));
+         outb(VGA_CMD_PORT, VGA_REG_CURSOR_HI); outb(VGA_DATA_PORT, (uint8_t)((pos >> 8) & 0xFF));
+         hw_cursor_pos = pos;
+     }
  
-     if (cursor_visible && !input_state.is_active) { 
-         enable_hardware_cursor();
-     } else {
-         disable_hardware_cursor();
+     int shown = (cursor_visible && !input_state.is_active && view_offset == 0);
+     if (shown != hw_cursor_shown) {
+         if (shown) { enable_hardware_cursor(); } else { disable_hardware_cursor(); }
+         hw_cursor_shown = shown;
      }
+     cursor_dirty = false;
  }
  
  /* ------------------------------------------------------------------------- */
  /* Low-level VGA buffer access                                               */
  /* ------------------------------------------------------------------------- */
+ // The screen is a VGA_ROWS-row view into the whole 32 KiB text window: the
+ // CRTC start address picks the window row shown at the top (vga_top).
+ static inline volatile uint16_t *screen_row(int y) {
+     return vga_buffer + (size_t)(vga_top + y) * VGA_COLS;
+ }
+ 
+ static void vga_set_start_row(int row) {
+     vga_start_row = row;
+     if (fb_console) { return; }
+     uint16_t pos = (uint16_t)(row * VGA_COLS);
+     outb(VGA_CMD_PORT, VGA_REG_START_HI); outb(VGA_DATA_PORT, (uint8_t)((pos >> 8) & 0xFF));
+     outb(VGA_CMD_PORT, VGA_REG_START_LO); outb(VGA_DATA_PORT, (uint8_t)(pos & 0xFF));
+ }
+ 
  static void put_char_at(char c, uint8_t color, int x, int y) {
      if (x < 0 || x >= VGA_COLS || y < 0 || y >= VGA_ROWS) {
          return;
      }
-     vga_buffer[y * VGA_COLS + x] = vga_entry(c, color);
+     screen_row(y)[x] = vga_entry(c, color);
  }
  
  static void clear_row(int row, uint8_t color) {
      if (row < 0 || row >= VGA_ROWS) { return; }
      uint16_t entry = vga_entry(' ', color);
-     size_t idx = (size_t)row * VGA_COLS;
-     for (int col = 0; col < VGA_COLS; ++col) { vga_buffer[idx + col] = entry; }
+     volatile uint16_t *cells = screen_row(row);
+     for (int col = 0; col < VGA_COLS; ++col) { cells[col] = entry; }
  }
  
+ // A scroll moves the view down one window row and rewrites the start
+ // address; only at the end of the window are the visible rows copied back
+ // to its top. The line that leaves the screen goes to the scrollback ring.
  static void scroll_terminal(void) {
-     memmove((void*)vga_buffer, (const void*)(vga_buffer + VGA_COLS), (VGA_ROWS - 1) * VGA_COLS * sizeof(uint16_t));
-     clear_row(VGA_ROWS - 1, terminal_color); 
+     volatile uint16_t *top = screen_row(0);
+     uint16_t *saved = scrollback[scrollback_count & (SCROLLBACK_LINES - 1)];
+     for (int col = 0; col < VGA_COLS; ++col) { saved[col] = top[col]; }
+     scrollback_count++;
+ 
+     if (vga_top + VGA_ROWS < VGA_WINDOW_ROWS) {
+         vga_top++;
+         vga_hist_rows++;
+     } else {
+         memcpy((void*)vga_buffer, (const void*)screen_row(1), (VGA_ROWS - 1) * VGA_COLS * sizeof(uint16_t));
+         vga_top = 0;
+         vga_hist_rows = 0;
+     }
+     clear_row(VGA_ROWS - 1, terminal_color); // Old contents of that window row, still off screen
+     vga_set_start_row(vga_top);
+     if (fb_scrolled < VGA_ROWS) { fb_scrolled++; }
      if (cursor_y > 0) cursor_y--; 
      
      if (input_state.is_active && input_state.start_row > 0) {
@@ -237,6 +246,37 @@
      }
  }
  
+ /*
+  * Shows the screen as it was @p lines scrolled-off lines ago (0 is live).
+  * While those lines are still right above vga_top this is a start address
+  * write; otherwise the page is drawn from the scrollback ring into window
+  * rows the live screen does not use, which it clears before reaching them.
+  */
+ static void scrollback_show(int lines) {
+     int avail = (scrollback_count < SCROLLBACK_LINES) ? (int)scrollback_count : SCROLLBACK_LINES;
+     if (lines > avail) lines = avail;
+     if (lines < 0) lines = 0;
+     view_offset = lines;
+     fb_scrolled = VGA_ROWS; // New contents, not a scroll
+ 
+     if (lines <= vga_hist_rows) {
+         vga_set_start_row(vga_top - lines);
+     } else {
+         int page = (vga_top + 2 * VGA_ROWS <= VGA_WINDOW_ROWS) ? vga_top + VGA_ROWS : 0;
+         if (page == 0 && vga_hist_rows > vga_top - VGA_ROWS) { vga_hist_rows = vga_top - VGA_ROWS; }
+         for (int y = 0; y < VGA_ROWS; ++y) {
+             int back = lines - y; // > 0: that many lines above the live screen
+             const volatile uint16_t *src = (back > 0)
+                 ? scrollback[(scrollback_count - (uint32_t)back) & (SCROLLBACK_LINES - 1)]
+                 : screen_row(-back);
+             volatile uint16_t *dst = vga_buffer + (size_t)(page + y) * VGA_COLS;
+             for (int col = 0; col < VGA_COLS; ++col) { dst[col] = src[col]; }
+         }
+         vga_set_start_row(page);
+     }
+     update_hardware_cursor();
+ }
+ 
  /* ------------------------------------------------------------------------- */
  /* ANSI escape parser                                                        */
  /* ------------------------------------------------------------------------- */
@@ -346,6 +386,8 @@
  /* Core output - intern, antar lås holdes                                     */
  /* ------------------------------------------------------------------------- */
  static void terminal_putchar_internal(char c) {
+     if (view_offset) { scrollback_show(0); } // Output brings the view back to the live screen
+ 
      if (ansi_state != ANSI_STATE_NORMAL || c == '\033') {
          process_ansi_code(c);
          if (ansi_state != ANSI_STATE_NORMAL || c == '\033') {
@@ -398,34 +440,90 @@
      serial_putchar(c);
  }
  
+ // Stores a run of printable characters straight into the cells, a row at a time.
+ static void terminal_put_run(const char *s, size_t n) {
+     while (n > 0) {
+         size_t chunk = MIN(n, (size_t)(VGA_COLS - cursor_x));
+         volatile uint16_t *cells = screen_row(cursor_y) + cursor_x;
+         for (size_t i = 0; i < chunk; ++i) { cells[i] = vga_entry(s[i], terminal_color); }
+         cursor_x += (int)chunk;
+         s += chunk;
+         n -= chunk;
+         if (cursor_x >= VGA_COLS) {
+             cursor_x = 0;
+             cursor_y++;
+         }
+         while (cursor_y >= VGA_ROWS) {
+             scroll_terminal();
+         }
+     }
+ }
+ 
+ /*
+  * Bulk output, lock held. Runs of printable characters outside an escape
+  * sequence go to the VGA cells and the serial port in one piece; control
+  * characters and escape sequences take the per-character path. The
+  * hardware cursor is only marked stale (see terminal_tick()).
+  */
+ static void terminal_write_locked(const char *data, size_t len) {
+     size_t i = 0;
+     while (i < len) {
+         size_t end = i;
+         if (ansi_state == ANSI_STATE_NORMAL) {
+             while (end < len && data[end] >= ' ' && data[end] <= '~') { end++; }
+         }
+         if (end == i) {
+             terminal_putchar_internal(data[i++]);
+             continue;
+         }
+         if (view_offset) { scrollback_show(0); }
+         terminal_put_run(data + i, end - i);
+         serial_write_len(data + i, end - i);
+         i = end;
+     }
+     cursor_dirty = true;
+ }
+ 
  /* ------------------------------------------------------------------------- */
  /* Public Output Wrappers (tar lås)                                          */
  /* ------------------------------------------------------------------------- */
  
+ // No tick brings the display up to date while interrupts are off (early
+ // boot, panics), so the writer does it.
+ static inline void terminal_write_done(uintptr_t irq_flags) {
+     if (!(irq_flags & 0x200)) { update_hardware_cursor(); }
+ }
+ 
  void terminal_putchar(char c) {
      uintptr_t flags = spinlock_acquire_irqsave(&terminal_lock);
      terminal_putchar_internal(c);
-     update_hardware_cursor(); 
+     cursor_dirty = true;
+     terminal_write_done(flags);
      spinlock_release_irqrestore(&terminal_lock, flags);
  }
  
  void terminal_write(const char *str) {
      if (!str) { return; }
+     size_t len = strlen(str);
      uintptr_t flags = spinlock_acquire_irqsave(&terminal_lock);
-     for (size_t i = 0; str[i]; ++i) {
-         terminal_putchar_internal(str[i]);
-     }
-     update_hardware_cursor();
+     terminal_write_locked(str, len);
+     terminal_write_done(flags);
      spinlock_release_irqrestore(&terminal_lock, flags);
  }
  
  void terminal_write_len(const char *data, size_t size) {
      if (!data || !size) { return; }
      uintptr_t flags = spinlock_acquire_irqsave(&terminal_lock);
-     for (size_t i = 0; i < size; ++i) {
-         terminal_putchar_internal(data[i]);
-     }
-     update_hardware_cursor();
+     terminal_write_locked(data, size);
+     terminal_write_done(flags);
+     spinlock_release_irqrestore(&terminal_lock, flags);
+ }
+ 
+ void terminal_tick(void) {
+     if (!cursor_dirty) { return; }
+     uintptr_t flags;
+     if (!spinlock_try_acquire_irqsave(&terminal_lock, &flags)) { return; } // Mid-write: next tick
+     if (cursor_dirty) { update_hardware_cursor(); }
      spinlock_release_irqrestore(&terminal_lock, flags);
  }
  
@@ -433,161 +531,18 @@
  /* printf implementasjon                                                     */
  /* ------------------------------------------------------------------------- */
  
- // *** MODIFIED _format_number to use unsigned long (32-bit on i386) ***
- static int _format_number(unsigned long val_ul, bool is_negative, int base, bool upper,
-                           int min_width, bool zero_pad, char *buf, int buf_sz) {
-     if (buf_sz < 2) { return 0; } 
-     char tmp_buf[33]; // Max for 32-bit binary + null
-     int i = 0;
-     const char *digits_map = upper ? "0123456789ABCDEF" : "0123456789abcdef";
- 
-     if (base < 2 || base > 16) base = 10; 
- 
-     if (val_ul == 0) {
-         tmp_buf[i++] = '0';
-     } else {
-         while (val_ul > 0 && i < (int)sizeof(tmp_buf) -1) {
-             tmp_buf[i++] = digits_map[val_ul % base]; // 32-bit % int -> no __umoddi3
-             val_ul /= base;                      // 32-bit / int -> no __udivdi3
-         }
-     }
-     int num_digits = i;
-     int sign_len = (is_negative && base == 10) ? 1 : 0;
-     int total_content_len = num_digits + sign_len;
-     int padding_len = (min_width > total_content_len) ? (min_width - total_content_len) : 0;
- 
-     if (total_content_len + padding_len >= buf_sz) { 
-         if (buf_sz > 5) { strncpy(buf, "[OVF]", (size_t)buf_sz); buf[buf_sz-1] = '\0'; return buf_sz-1; }
-         else { buf[0] = '\0'; return 0; }
-     }
- 
-     int current_pos = 0;
-     char pad_char = ' ';
-     if (zero_pad && !is_negative) { 
-         pad_char = '0';
-     }
-      if (zero_pad && is_negative && base == 10) { 
-         buf[current_pos++] = '-';
-         sign_len = 0; 
-     }
- 
-     for (int k = 0; k < padding_len; ++k) buf[current_pos++] = pad_char;
-     if (sign_len) buf[current_pos++] = '-';
-     while (i > 0) buf[current_pos++] = tmp_buf[--i];
- 
-     buf[current_pos] = '\0';
-     return current_pos;
- }
- 
- // *** MODIFIED _vsnprintf to handle unsigned long and avoid long long where possible ***
- int _vsnprintf(char *str, size_t size, const char *fmt, va_list args) {
-     if (!str || !size) { if (size == 1 && str) str[0] = '\0'; return 0; }
- 
-     size_t written_chars = 0;
-     char temp_num_buf[34]; 
- 
-     while (*fmt && written_chars < size - 1) {
-         if (*fmt != '%') {
-             str[written_chars++] = *fmt++;
-             continue;
-         }
-         fmt++; 
- 
-         bool zero_pad = false;
-         int min_width = 0;
-         bool is_long = false;
-         // bool is_long_long = false; // Avoid if possible
-         bool alt_form = false; 
- 
-         if (*fmt == '0') { zero_pad = true; fmt++; }
-         if (*fmt == '#') { alt_form = true; fmt++; }
- 
-         while (*fmt >= '0' && *fmt <= '9') {
-             min_width = min_width * 10 + (*fmt - '0');
-             fmt++;
-         }
- 
-         if (*fmt == 'l') {
-             is_long = true; fmt++;
-             if (*fmt == 'l') { 
-                 // is_long_long = true; // Mark it, but try to avoid 64-bit math
-                 serial_write("Warning: %ll specifier used, may truncate or cause issues without libgcc 64bit support.\n");
-                 fmt++; 
-             }
-         }
- 
-         const char *s_val;
-         int len_s;
-         unsigned long ul_val; // Use unsigned long for most numeric conversions
-         long l_val;
-         bool neg;
- 
-         switch (*fmt) {
-             case 's':
-                 s_val = va_arg(args, const char *);
-                 if (!s_val) s_val = "(null)";
-                 len_s = strlen(s_val);
-                 // Padding for string (left-pad with spaces)
-                 if(min_width > len_s) {
-                     for(int k=0; k < (min_width - len_s) && written_chars < size -1; ++k) str[written_chars++] = ' ';
-                 }
-                 for (int k=0; k<len_s && written_chars < size -1; ++k) str[written_chars++] = s_val[k];
-                 break;
-             case 'c': str[written_chars++] = (char)va_arg(args, int); break;
-             case 'd': case 'i':
-                 // Assume long long is not commonly needed for kernel messages, try to use long
-                 if (is_long) { l_val = va_arg(args, long); } // Handles %ld
-                 else { l_val = va_arg(args, int); }        // Handles %d
-                 neg = l_val < 0;
-                 // Be careful with MIN_INT
-                 ul_val = neg ? ((l_val == (-2147483647L - 1L)) ? 2147483648UL : (unsigned long)-l_val) : (unsigned long)l_val;
-                 len_s = _format_number(ul_val, neg, 10, false, min_width, zero_pad, temp_num_buf, sizeof(temp_num_buf));
-                 for (int k=0; k<len_s && written_chars < size -1; ++k) str[written_chars++] = temp_num_buf[k];
-                 break;
-             case 'u': case 'x': case 'X': case 'o':
-                 // Assume long long is not commonly needed
-                 if (is_long) { ul_val = va_arg(args, unsigned long); } // Handles %lu, %lx etc.
-                 else { ul_val = va_arg(args, unsigned int); }         // Handles %u, %x etc.
-                 
-                 int base = (*fmt == 'u') ? 10 : ((*fmt == 'o') ? 8 : 16);
-                 bool upper = (*fmt == 'X');
-                 if (alt_form && ul_val != 0 && written_chars < size - 1) {
-                     if (base == 16 && written_chars < size -2) { str[written_chars++] = '0'; str[written_chars++] = upper ? 'X' : 'x';}
-                     else if (base == 8 && written_chars < size -1) { str[written_chars++] = '0';}
-                 }
-                 len_s = _format_number(ul_val, false, base, upper, min_width, zero_pad, temp_num_buf, sizeof(temp_num_buf));
-                 for (int k=0; k<len_s && written_chars < size -1; ++k) str[written_chars++] = temp_num_buf[k];
-                 break;
-             case 'p': // Pointer
-                 ul_val = (unsigned long)(uintptr_t)va_arg(args, void*); // Pointers are 32-bit
-                 if (written_chars < size -1) str[written_chars++] = '0';
-                 if (written_chars < size -1) str[written_chars++] = 'x';
-                 int ptr_w = sizeof(void*) * 2; 
-                 // if (min_width < ptr_w) min_width = ptr_w; // Ensure full pointer width
-                 len_s = _format_number(ul_val, false, 16, false, ptr_w, true, temp_num_buf, sizeof(temp_num_buf)); // Pointers zero-padded
-                 for (int k=0; k<len_s && written_chars < size -1; ++k) str[written_chars++] = temp_num_buf[k];
-                 break;
-             case '%': str[written_chars++] = '%'; break;
-             default: if(written_chars < size -1) str[written_chars++] = '%'; if(*fmt && written_chars < size -1) str[written_chars++] = *fmt; break;
-         }
-         if(*fmt) fmt++; 
-     }
-     str[written_chars] = '\0';
-     return (int)written_chars;
- }
- 
  void terminal_printf(const char *fmt, ...) {
      char buf[PRINTF_BUFFER_SIZE];
      va_list args;
      va_start(args, fmt);
      int len = _vsnprintf(buf, sizeof(buf), fmt, args);
      va_end(args);
+     if (len <= 0) { return; }
+     if (len > (int)sizeof(buf) - 1) { len = sizeof(buf) - 1; }
  
      uintptr_t irq_flags = spinlock_acquire_irqsave(&terminal_lock);
-     for (int i = 0; i < len; ++i) {
-         terminal_putchar_internal(buf[i]);
-     }
-     update_hardware_cursor();
+     terminal_write_locked(buf, (size_t)len);
+     terminal_write_done(irq_flags);
      spinlock_release_irqrestore(&terminal_lock, irq_flags);
  }
  
@@ -595,6 +550,11 @@
  /* Terminal control                                                          */
  /* ------------------------------------------------------------------------- */
  static void terminal_clear_internal(void) { 
+     fb_scrolled = VGA_ROWS;
+     vga_top = 0;
+     vga_hist_rows = 0;
+     view_offset = 0;
+     vga_set_start_row(0);
      for (int y = 0; y < VGA_ROWS; ++y) {
          clear_row(y, terminal_color);
      }
@@ -645,16 +605,22 @@
  /* ------------------------------------------------------------------------- */
  void terminal_init(void) {
      spinlock_init(&terminal_lock);
-     spinlock_init(&s_line_buffer_lock); 
-     s_line_buffer_len = 0;
-     s_line_ready_for_read = false;
-     s_waiting_task = NULL;
-     memset(s_line_buffer, 0, MAX_INPUT_LENGTH);
+     tty_init();
  
      terminal_clear_internal(); 
      input_state.is_active = false; 
      update_hardware_cursor();   
-     serial_write("[Terminal] Initialized (VGA + Serial + Single-line input buffer)\n");
+     serial_write("[Terminal] Initialized (VGA + Serial + TTY input)\n");
+ }
+ 
+ void terminal_use_framebuffer(void) {
+     uintptr_t flags = spinlock_acquire_irqsave(&terminal_lock);
+     for (size_t i = 0; i < VGA_WINDOW_ROWS * VGA_COLS; ++i) { fb_window[i] = vga_buffer[i]; } // Boot log so far
+     vga_buffer = fb_window;
+     fb_console = true;
+     fb_scrolled = VGA_ROWS;
+     update_hardware_cursor();
+     spinlock_release_irqrestore(&terminal_lock, flags);
  }
  
  /* ------------------------------------------------------------------------- */
@@ -665,196 +631,32 @@
         return;
     }
 
-    // This outer lock protects s_line_buffer, s_line_buffer_len, 
-    // s_line_ready_for_read, and s_waiting_task.
-    uintptr_t line_buf_irq_flags = spinlock_acquire_irqsave(&s_line_buffer_lock);
-
-    char char_to_add = 0;
-    bool is_newline = false;
+    // Shift+PageUp/PageDown page through the scrollback, half a screen at a time
+    if ((event.code == KEY_PAGE_UP || event.code == KEY_PAGE_DOWN) && (event.modifiers & MOD_SHIFT)) {
+        uintptr_t view_flags = spinlock_acquire_irqsave(&terminal_lock);
+        int step = (event.code == KEY_PAGE_UP) ? VGA_ROWS / 2 : -(VGA_ROWS / 2);
+        scrollback_show(view_offset + step);
+        spinlock_release_irqrestore(&terminal_lock, view_flags);
+        return;
+    }
 
-    // Determine the character to process, converting KeyCode to char if applicable
-    // and handling special keys like Enter and Backspace.
-    if (event.code == KEY_ENTER || event.code == '\n') { // Check for KEY_ENTER or if keymap produces '\n'
-        char_to_add = '\n';
-        is_newline = true;
+    // Key presses become characters for the line discipline (echo happens there)
+    char c = 0;
+    if (event.code == KEY_ENTER) {
+        c = '\n';
     } else if (event.code == KEY_BACKSPACE) {
-        char_to_add = '\b';
+        c = '\b';
+    } else if (event.code == KEY_TAB) {
+        c = '\t';
     } else if (event.code > 0 && event.code < 0x80) { // Printable ASCII range from keymap
-        char_to_add = apply_modifiers_extended((char)event.code, event.modifiers);
-        // Check if the modified character itself is a newline (e.g., Ctrl+J if mapped)
-        if (char_to_add == '\n') {
-            is_newline = true;
+        c = apply_modifiers_extended((char)event.code, event.modifiers);
+        if ((event.modifiers & MOD_CTRL) && ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))) {
+            c &= 0x1F; // Ctrl+letter: the control character (Ctrl+D is 0x04)
         }
     }
-    // Note: apply_modifiers_extended should handle shift, caps etc. for printable characters.
-    // If KEY_ENTER or KEY_BACKSPACE are > 0x80, this logic is fine.
-    // If they are mapped to '\n' and '\b' directly by the keymap, the first condition handles it.
-
-    // If a character was processed (printable, newline, or backspace)
-    if (char_to_add != 0) {
-        
-        // Serial logging for debug (uncomment and adapt as needed)
-        /*
-        serial_write("[Terminal KeyEvt] Char='");
-        if (is_newline) { serial_write("\\n"); }
-        else if (char_to_add == '\b') { serial_write("\\b"); }
-        else if (char_to_add >= ' ' && char_to_add <= '~') { serial_putchar(char_to_add); }
-        else { serial_print_hex((uint8_t)char_to_add); }
-        serial_write("', Mod=0x"); serial_print_hex(event.modifiers); serial_write("\n");
-        */
-
-        if (is_newline) {
-            s_line_buffer[s_line_buffer_len] = '\0'; // Null-terminate the completed line
-            s_line_ready_for_read = true;            // Signal that the line is ready
-            
-            // serial_write("[Terminal] Newline. Buffer: '"); serial_write(s_line_buffer);
-            // serial_write("', Len: "); 
-            // char len_str[12]; itoa_simple(s_line_buffer_len, len_str, 10); serial_write(len_str); 
-            // serial_write("\n");
-
-            tcb_t* task_to_unblock = (tcb_t*)s_waiting_task; // Copy before potentially clearing
-            
-            if (task_to_unblock) {
-                s_waiting_task = NULL; // Clear s_waiting_task *while still holding the lock*
-                                       // to prevent races if the unblocked task re-enters read quickly.
-            }
-            
-            // Release the line buffer lock BEFORE calling the scheduler or terminal output functions
-            spinlock_release_irqrestore(&s_line_buffer_lock, line_buf_irq_flags);
-            
-            if (task_to_unblock) {
-                // serial_write("[Terminal] Unblocking waiting task PID: ");
-                // if (task_to_unblock->process) serial_print_hex(task_to_unblock->process->pid); else serial_write("UNKNOWN");
-                // serial_write("\n");
-                scheduler_unblock_task(task_to_unblock); // This might yield/schedule
-            } else {
-                // serial_write("[Terminal] Line ready, but no task was waiting.\n");
-            }
-
-            // Echo newline to terminal (needs terminal_lock, acquired separately)
-            uintptr_t term_out_irq_flags = spinlock_acquire_irqsave(&terminal_lock);
-            terminal_putchar_internal('\n'); 
-            update_hardware_cursor();
-            spinlock_release_irqrestore(&terminal_lock, term_out_irq_flags);
-
-            return; // Exit after handling newline
-
-        } else if (char_to_add == '\b') { // Backspace
-            if (s_line_buffer_len > 0) {
-                s_line_buffer_len--;
-                s_line_buffer[s_line_buffer_len] = '\0'; // Null-terminate the shortened string
-                
-                // Release line buffer lock BEFORE terminal output
-                spinlock_release_irqrestore(&s_line_buffer_lock, line_buf_irq_flags);
-
-                // Echo backspace, space, backspace to terminal
-                uintptr_t term_out_irq_flags = spinlock_acquire_irqsave(&terminal_lock);
-                terminal_putchar_internal('\b'); 
-                terminal_putchar_internal(' ');  
-                terminal_putchar_internal('\b'); 
-                update_hardware_cursor();
-                spinlock_release_irqrestore(&terminal_lock, term_out_irq_flags);
-                
-                // serial_write("[Terminal] Backspace. Buffer len: "); 
-                // char len_str[12]; itoa_simple(s_line_buffer_len, len_str, 10); serial_write(len_str);
-                // serial_write("\n");
-                return; // Exit after handling backspace
-            }
-            // If buffer is empty, nothing to backspace. Just release lock.
-            spinlock_release_irqrestore(&s_line_buffer_lock, line_buf_irq_flags);
-            return;
-
-        } else { // Regular character (printable)
-            if (s_line_buffer_len < MAX_INPUT_LENGTH - 1) {
-                s_line_buffer[s_line_buffer_len++] = char_to_add;
-                // Optionally keep s_line_buffer null-terminated during input for easier debugging,
-                // but terminal_read_line_blocking is responsible for final null termination
-                // before copying to user.
-                // s_line_buffer[s_line_buffer_len] = '\0'; 
-                
-                // Release line buffer lock BEFORE terminal output
-                spinlock_release_irqrestore(&s_line_buffer_lock, line_buf_irq_flags);
-                
-                // Echo character to terminal output
-                uintptr_t term_out_irq_flags = spinlock_acquire_irqsave(&terminal_lock);
-                terminal_putchar_internal(char_to_add); 
-                update_hardware_cursor(); 
-                spinlock_release_irqrestore(&terminal_lock, term_out_irq_flags);
-                
-                return; // Exit after handling character
-            } else {
-                // serial_write("[Terminal WARNING] Single-line input buffer full. Char discarded.\n");
-                // Buffer full, just release lock
-                spinlock_release_irqrestore(&s_line_buffer_lock, line_buf_irq_flags);
-                return;
-            }
-        }
-    } else {
-        // char_to_add was 0 (e.g., a modifier key press like Shift alone, or unhandled special key)
-        // No action needed for the line buffer.
-        spinlock_release_irqrestore(&s_line_buffer_lock, line_buf_irq_flags);
-    }
+    if (c != 0) tty_receive(c);
 }
  
- /* ------------------------------------------------------------------------- */
- /* Blocking Terminal Read for Syscall                                        */
- /* ------------------------------------------------------------------------- */
- ssize_t terminal_read_line_blocking(char *kbuf, size_t len) {
-     if (!kbuf || len == 0) {
-         return -EINVAL; 
-     }
- 
-     serial_write("[Terminal] terminal_read_line_blocking: Enter\n");
-     ssize_t bytes_copied = 0;
- 
-     while (true) {
-         uintptr_t line_buf_irq_flags = spinlock_acquire_irqsave(&s_line_buffer_lock);
- 
-         if (s_line_ready_for_read) {
-             serial_write("[Terminal] terminal_read_line_blocking: Line is ready.\n");
-             size_t copy_len = MIN(s_line_buffer_len, len - 1); 
-             memcpy(kbuf, s_line_buffer, copy_len);
-             kbuf[copy_len] = '\0'; 
-             bytes_copied = (ssize_t)copy_len; 
- 
-             s_line_ready_for_read = false;
-             s_line_buffer_len = 0;
-             memset(s_line_buffer, 0, MAX_INPUT_LENGTH); 
- 
-             spinlock_release_irqrestore(&s_line_buffer_lock, line_buf_irq_flags);
-             
-             serial_write("[Terminal] terminal_read_line_blocking: Copied bytes: '");
-             serial_write(kbuf); 
-             serial_write("'\n");
-             return bytes_copied; 
-         } else {
-             serial_write("[Terminal] terminal_read_line_blocking: Line not ready, blocking task.\n");
-             tcb_t *current_task_non_volatile = (tcb_t*)get_current_task(); 
-             if (!current_task_non_volatile) {
-                 spinlock_release_irqrestore(&s_line_buffer_lock, line_buf_irq_flags);
-                 serial_write("[Terminal] terminal_read_line_blocking: ERROR - No current task to block!\n");
-                 return -EFAULT; 
-             }
- 
-             if (s_waiting_task != NULL && s_waiting_task != current_task_non_volatile) {
-                 spinlock_release_irqrestore(&s_line_buffer_lock, line_buf_irq_flags);
-                 serial_write("[Terminal] terminal_read_line_blocking: ERROR - Another task is already waiting!\n");
-                 return -EBUSY; 
-             }
- 
-             s_waiting_task = current_task_non_volatile; 
-             current_task_non_volatile->state = TASK_BLOCKED; 
- 
-             spinlock_release_irqrestore(&s_line_buffer_lock, line_buf_irq_flags);
- 
-             serial_write("[Terminal] terminal_read_line_blocking: Calling schedule().\n");
-             schedule(); 
-             serial_write("[Terminal] terminal_read_line_blocking: Woke up from schedule(). Re-checking line.\n");
-         }
-     }
-     return -EIO; 
- }
- 
  /* ------------------------------------------------------------------------- */
  /* Multi-line input editor (Stubs - ikke fullt implementert)                 */
  /* ------------------------------------------------------------------------- */
@@ -913,10 +715,8 @@
  void terminal_write_bytes(const char* data, size_t size) {
      if (!data || size == 0) { return; }
      uintptr_t flags = spinlock_acquire_irqsave(&terminal_lock);
-     for (size_t i = 0; i < size; ++i) {
-         terminal_putchar_internal(data[i]);
-     }
-     update_hardware_cursor(); 
+     terminal_write_locked(data, size);
+     terminal_write_done(flags);
      spinlock_release_irqrestore(&terminal_lock, flags);
  }
  
@@ -10,14 +10,16 @@
 #include <kernel/drivers/input/keyboard.h>
 #include <kernel/drivers/input/keyboard_hw.h> // Should define KB_RESP_ACK, etc.
 #include <kernel/core/types.h>
-#include <kernel/cpu/idt.h>          // For PIC_EOI, outb, PIC1_COMMAND, PIC2_COMMAND constants
+#include <kernel/cpu/idt.h>          // For register_int_handler, irq_send_eoi
 #include <kernel/lib/port_io.h>      // For outb, inb
 #include <kernel/cpu/isr_frame.h>
+#include <kernel/cpu/softirq.h>       // Decoding runs in SOFTIRQ_KEYBOARD
 #include <kernel/drivers/display/terminal.h>
 #include <kernel/drivers/timer/pit.h>          // For get_pit_ticks()
 #include <kernel/lib/string.h>
 #include <kernel/drivers/display/serial.h>
 #include <kernel/sync/spinlock.h>
+#include <kernel/sync/wait_queue.h>   // Readers blocked in keyboard_wait_event
 #include <kernel/lib/assert.h>
 #include <libc/stdbool.h>
 #include <libc/stdint.h>
@@ -27,7 +29,10 @@
 //============================================================================
 // Definitions and Constants
 //============================================================================
-#define KB_BUFFER_SIZE 256
+#define KB_BUFFER_SIZE 256 // Power of two
+#define KB_BUFFER_MASK (KB_BUFFER_SIZE - 1)
+#define KB_RAW_SIZE 64     // Power of two
+#define KB_RAW_MASK (KB_RAW_SIZE - 1)
 #define KBC_WAIT_TIMEOUT 300000 
 #define KBC_MAX_FLUSH 100       
 
@@ -47,10 +52,21 @@ volatile uint32_t g_keyboard_irq_fire_count = 0;
 static struct {
     bool      key_states[KEY_COUNT];
     uint8_t   modifiers;
+    // Event ring: the keyboard softirq is the only producer (moves
+    // buf_head), the reader the only consumer (moves buf_tail), so neither
+    // side takes a lock. The indices run freely and are masked on access.
     KeyEvent  buffer[KB_BUFFER_SIZE];
-    uint8_t   buf_head;
-    uint8_t   buf_tail;
-    spinlock_t buffer_lock;
+    volatile uint32_t buf_head;
+    volatile uint32_t buf_tail;
+    volatile uint32_t dropped;     // Scancodes or events that found their ring full
+    // Scancodes read by IRQ1 and not yet decoded, the same scheme one stage
+    // earlier: IRQ1 produces, the softirq on the CPU it raised consumes.
+    // IRQ1 is routed to a single CPU, so there is one of each.
+    uint8_t   raw[KB_RAW_SIZE];
+    volatile uint32_t raw_head;
+    volatile uint32_t raw_tail;
+    wait_queue_t event_waiters;    // keyboard_wait_event() callers
+    spinlock_t config_lock;        // Keymap and callback updates
     uint16_t  current_keymap[128];
     bool      extended_code_active;
     void      (*event_callback)(KeyEvent);
@@ -60,6 +76,8 @@ static struct {
 // Forward Declarations
 //============================================================================
 static void keyboard_irq1_handler(isr_frame_t *frame);
+static void keyboard_softirq(void);
+static void keyboard_process_scancode(uint8_t scancode);
 static inline void kbc_wait_for_send_ready(void);
 static inline void kbc_wait_for_recv_ready(void);
 static uint8_t kbc_read_data(void);
@@ -69,17 +87,6 @@ static bool kbc_expect_ack(const char* command_name);
 static void kbc_flush_output_buffer(const char* context);
 static void very_short_delay(void);
 extern void terminal_handle_key_event(KeyEvent event);
-static inline void pic_send_eoi(uint8_t irq);
-
-//============================================================================
-// PIC EOI Helper
-//============================================================================
-static inline void pic_send_eoi(uint8_t irq) {
-    if (irq >= 8 && irq <= 15) { 
-        outb(PIC2_COMMAND, PIC_EOI); 
-    }
-    outb(PIC1_COMMAND, PIC_EOI); 
-}
 
 //============================================================================
 // KBC Helper Functions
@@ -136,28 +143,55 @@ static bool kbc_expect_ack(const char* command_name) {
 //============================================================================
 // Interrupt Handler
 //============================================================================
+// Top half: takes the byte off the controller and leaves the decoding to
+// keyboard_softirq(), which runs with interrupts enabled on the way out.
 static void keyboard_irq1_handler(isr_frame_t *frame) {
     g_keyboard_irq_fire_count++;
     (void)frame; 
     uint8_t status_from_kbc = inb(KBC_STATUS_PORT);
 
     if (!(status_from_kbc & KBC_SR_OBF)) {
-        pic_send_eoi(1); 
+        irq_send_eoi(1); 
         return; 
     }
     uint8_t scancode = inb(KBC_DATA_PORT);
 
+    uint32_t head = keyboard_state.raw_head;
+    if (head - keyboard_state.raw_tail < KB_RAW_SIZE) {
+        keyboard_state.raw[head & KB_RAW_MASK] = scancode;
+        asm volatile("" ::: "memory"); // Byte before head
+        keyboard_state.raw_head = head + 1;
+        softirq_raise(SOFTIRQ_KEYBOARD);
+    } else {
+        keyboard_state.dropped++;
+    }
+    irq_send_eoi(1);
+}
+
+// Bottom half: decodes every scancode that arrived since the last run
+static void keyboard_softirq(void) {
+    uint32_t tail = keyboard_state.raw_tail;
+    while (tail != keyboard_state.raw_head) {
+        asm volatile("" ::: "memory"); // Head before the byte
+        uint8_t scancode = keyboard_state.raw[tail & KB_RAW_MASK];
+        asm volatile("" ::: "memory");
+        keyboard_state.raw_tail = ++tail;
+        keyboard_process_scancode(scancode);
+    }
+}
+
+// Translation, modifier state, the event ring and the callback, in the
+// order the scancodes came in
+static void keyboard_process_scancode(uint8_t scancode) {
     bool is_break_code;
     KeyCode kc = KEY_UNKNOWN;
 
     if (scancode == SCANCODE_PAUSE_PREFIX) {
         keyboard_state.extended_code_active = false; 
-        pic_send_eoi(1); 
         return; 
     }
     if (scancode == SCANCODE_EXTENDED_PREFIX) { 
         keyboard_state.extended_code_active = true;
-        pic_send_eoi(1); 
         return; 
     }
 
@@ -188,7 +222,6 @@ static void keyboard_irq1_handler(isr_frame_t *frame) {
     }
 
     if ((kc == KEY_UNKNOWN || kc == 0) && base_scancode != 0) {
-        pic_send_eoi(1); 
         return;
     }
     
@@ -219,18 +252,19 @@ static void keyboard_irq1_handler(isr_frame_t *frame) {
         .timestamp = get_pit_ticks() 
     };
 
-    uintptr_t buffer_irq_flags = spinlock_acquire_irqsave(&keyboard_state.buffer_lock);
-    uint8_t next_head = (keyboard_state.buf_head + 1) % KB_BUFFER_SIZE;
-    if (next_head == keyboard_state.buf_tail) {
-        keyboard_state.buf_tail = (keyboard_state.buf_tail + 1) % KB_BUFFER_SIZE;
+    // A full ring keeps what the reader has not seen yet and counts the drop
+    uint32_t head = keyboard_state.buf_head;
+    if (head - keyboard_state.buf_tail < KB_BUFFER_SIZE) {
+        keyboard_state.buffer[head & KB_BUFFER_MASK] = event;
+        asm volatile("" ::: "memory"); // Event before head (x86 keeps store order)
+        keyboard_state.buf_head = head + 1;
+        if (wait_queue_active(&keyboard_state.event_waiters)) {
+            wake_up_one(&keyboard_state.event_waiters);
+        }
+    } else {
+        keyboard_state.dropped++;
     }
-    keyboard_state.buffer[keyboard_state.buf_head] = event;
-    keyboard_state.buf_head = next_head;
-    spinlock_release_irqrestore(&keyboard_state.buffer_lock, buffer_irq_flags);
 
-    // Send EOI before calling callback to ensure interrupts continue even if callback blocks
-    pic_send_eoi(1);
-    
     if (keyboard_state.event_callback) {
         keyboard_state.event_callback(event);
     } 
@@ -275,7 +309,8 @@ void keyboard_recheck_kbc_config(void) {
 void keyboard_init(void) {
     terminal_printf("[KB Init v%s] Initializing keyboard driver...\n", "6.5.2"); 
     memset(&keyboard_state, 0, sizeof(keyboard_state));
-    spinlock_init(&keyboard_state.buffer_lock);
+    spinlock_init(&keyboard_state.config_lock);
+    wait_queue_init(&keyboard_state.event_waiters);
 
     memcpy(keyboard_state.current_keymap, DEFAULT_KEYMAP_US, sizeof(keyboard_state.current_keymap));
     serial_write("  [KB Init] Default US keymap (Set 1 style) loaded. Device will use Set 2. KBC Translation will be ON (config 0x41).\n");
@@ -397,6 +432,7 @@ void keyboard_init(void) {
         terminal_write("  [KB WARNING] FINAL CHECK: Scancode Translation is DISABLED (Config Bit 6 is CLEAR)! Expected ON for 0x41.\n");
     }
 
+    softirq_register(SOFTIRQ_KEYBOARD, keyboard_softirq);
     register_int_handler(IRQ1_VECTOR, keyboard_irq1_handler, NULL);
     serial_write("  [KB Init] IRQ1 handler registered.\n");
 
@@ -411,15 +447,27 @@ void keyboard_init(void) {
 //============================================================================
 bool keyboard_poll_event(KeyEvent* event) {
     KERNEL_ASSERT(event != NULL, "NULL event pointer to keyboard_poll_event");
-    bool event_found = false;
-    uintptr_t irq_flags = spinlock_acquire_irqsave(&keyboard_state.buffer_lock); 
-    if (keyboard_state.buf_head != keyboard_state.buf_tail) {
-        *event = keyboard_state.buffer[keyboard_state.buf_tail];
-        keyboard_state.buf_tail = (keyboard_state.buf_tail + 1) % KB_BUFFER_SIZE;
-        event_found = true;
+    uint32_t tail = keyboard_state.buf_tail;
+    if (tail == keyboard_state.buf_head) {
+        return false;
     }
-    spinlock_release_irqrestore(&keyboard_state.buffer_lock, irq_flags);
-    return event_found;
+    asm volatile("" ::: "memory"); // Head before the event
+    *event = keyboard_state.buffer[tail & KB_BUFFER_MASK];
+    asm volatile("" ::: "memory"); // Event copied before the slot is handed back
+    keyboard_state.buf_tail = tail + 1;
+    return true;
+}
+
+void keyboard_wait_event(KeyEvent* event) {
+    KERNEL_ASSERT(event != NULL, "NULL event pointer to keyboard_wait_event");
+    while (!keyboard_poll_event(event)) {
+        wait_event(&keyboard_state.event_waiters,
+                   keyboard_state.buf_head != keyboard_state.buf_tail);
+    }
+}
+
+uint32_t keyboard_events_dropped(void) {
+    return keyboard_state.dropped;
 }
 
 bool keyboard_is_key_down(KeyCode key) {
@@ -443,9 +491,9 @@ void keyboard_set_leds(bool scroll, bool num, bool caps) {
 
 void keyboard_set_keymap(const uint16_t* keymap) {
     KERNEL_ASSERT(keymap != NULL, "NULL keymap passed to keyboard_set_keymap");
-    uintptr_t irq_flags = spinlock_acquire_irqsave(&keyboard_state.buffer_lock); 
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&keyboard_state.config_lock); 
     memcpy(keyboard_state.current_keymap, keymap, sizeof(keyboard_state.current_keymap));
-    spinlock_release_irqrestore(&keyboard_state.buffer_lock, irq_flags);
+    spinlock_release_irqrestore(&keyboard_state.config_lock, irq_flags);
     terminal_write("[KB] Keymap updated.\n");
 }
 
@@ -459,9 +507,9 @@ void keyboard_set_repeat_rate(uint8_t delay, uint8_t speed) {
 }
 
 void keyboard_register_callback(void (*callback)(KeyEvent)) {
-    uintptr_t irq_flags = spinlock_acquire_irqsave(&keyboard_state.buffer_lock); 
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&keyboard_state.config_lock); 
     keyboard_state.event_callback = callback;
-    spinlock_release_irqrestore(&keyboard_state.buffer_lock, irq_flags);
+    spinlock_release_irqrestore(&keyboard_state.config_lock, irq_flags);
 }
 
 char apply_modifiers_extended(char c, uint8_t modifiers) {
@@ -0,0 +1,166 @@
+/**
+ * @file tty.c
+ * @brief Console TTY: cooked/raw line discipline over a byte input queue.
+ */
+
+#include <kernel/drivers/input/tty.h>
+#include <kernel/drivers/display/terminal.h> // terminal_write_len (echo), MAX_INPUT_LENGTH
+#include <kernel/sync/spinlock.h>
+#include <kernel/sync/wait_queue.h>
+#include <kernel/process/scheduler.h>        // get_current_task
+#include <kernel/fs/vfs/poll.h>              // vfs_poll_notify
+#include <kernel/fs/vfs/fs_errno.h>
+
+#define TTY_INPUT_MASK (TTY_INPUT_SIZE - 1)
+
+#define CTRL_D 0x04 // End of file
+#define CTRL_U 0x15 // Erase the line
+
+// s_tty_lock covers everything below; readers wait on s_readers
+static spinlock_t        s_tty_lock;
+static wait_queue_t      s_readers;
+static char              s_input[TTY_INPUT_SIZE];
+static volatile uint32_t s_head = 0;   // Free-running: bytes queued
+static volatile uint32_t s_tail = 0;   //               bytes read
+static volatile bool     s_eof = false; // A Ctrl+D waits at s_eof_pos
+static uint32_t          s_eof_pos = 0;
+static char              s_line[MAX_INPUT_LENGTH]; // Cooked line being edited
+static uint32_t          s_line_len = 0;
+static volatile uint32_t s_mode = 0;
+
+void tty_init(void) {
+    spinlock_init_named(&s_tty_lock, "tty");
+    wait_queue_init(&s_readers);
+}
+
+// Appends @p len bytes to the queue, dropping what doesn't fit; lock held.
+static void tty_queue_locked(const char *buf, uint32_t len) {
+    uint32_t room = TTY_INPUT_SIZE - (s_head - s_tail);
+    if (len > room) len = room;
+    for (uint32_t i = 0; i < len; i++) s_input[s_head++ & TTY_INPUT_MASK] = buf[i];
+}
+
+// Moves the edited line (and @p nl, if not 0) to the queue; lock held.
+static void tty_flush_line_locked(char nl) {
+    tty_queue_locked(s_line, s_line_len);
+    if (nl) tty_queue_locked(&nl, 1);
+    s_line_len = 0;
+}
+
+static bool tty_readable_locked(void) {
+    return s_head != s_tail || s_eof;
+}
+
+// New input is in the queue: the oldest reader takes it and passes on any rest
+static void tty_wake_readers(void) {
+    if (wait_queue_active(&s_readers)) wake_up_one(&s_readers);
+    vfs_poll_notify(); // fd 0 just became readable
+}
+
+void tty_receive(char c) {
+    char echo[3];
+    uint32_t echo_len = 0;
+    bool woke_input = false;
+
+    uintptr_t flags = spinlock_acquire_irqsave(&s_tty_lock);
+    uint32_t mode = s_mode;
+    if (mode & TTY_RAW) {
+        tty_queue_locked(&c, 1);
+        woke_input = true;
+        if (c >= ' ' && c <= '~') echo[echo_len++] = c;
+    } else if (c == '\n' || c == '\r') {
+        tty_flush_line_locked('\n');
+        woke_input = true;
+        echo[echo_len++] = '\n';
+    } else if (c == '\b' || c == 0x7F) {
+        if (s_line_len > 0) {
+            s_line_len--;
+            echo[echo_len++] = '\b'; echo[echo_len++] = ' '; echo[echo_len++] = '\b';
+        }
+    } else if (c == CTRL_U) {
+        uint32_t erased = s_line_len;
+        s_line_len = 0;
+        spinlock_release_irqrestore(&s_tty_lock, flags);
+        if (!(mode & TTY_NOECHO)) {
+            while (erased--) terminal_write_len("\b \b", 3);
+        }
+        return;
+    } else if (c == CTRL_D) {
+        if (s_line_len > 0) {
+            tty_flush_line_locked(0); // Hands over the line as typed, no newline
+            woke_input = true;
+        } else if (!s_eof) {
+            s_eof = true;
+            s_eof_pos = s_head;
+            woke_input = true;
+        }
+    } else if (s_line_len < MAX_INPUT_LENGTH - 1) {
+        s_line[s_line_len++] = c;
+        if ((c >= ' ' && c <= '~') || c == '\t') echo[echo_len++] = c;
+    }
+    spinlock_release_irqrestore(&s_tty_lock, flags);
+
+    if (echo_len && !(mode & TTY_NOECHO)) terminal_write_len(echo, echo_len);
+    if (woke_input) tty_wake_readers();
+}
+
+// Takes up to @p len bytes off the queue (not past a pending EOF, and not
+// past a newline when cooked); lock held and tty_readable_locked().
+static size_t tty_take_locked(char *kbuf, size_t len, bool cooked) {
+    uint32_t end = s_eof ? s_eof_pos : s_head;
+    if (s_tail == end) { // Only the EOF is left: consume it
+        s_eof = false;
+        return 0;
+    }
+    size_t n = 0;
+    while (n < len && s_tail != end) {
+        char c = s_input[s_tail++ & TTY_INPUT_MASK];
+        kbuf[n++] = c;
+        if (cooked && c == '\n') break;
+    }
+    return n;
+}
+
+ssize_t tty_read(char *kbuf, size_t len) {
+    if (!kbuf) return -EINVAL;
+    if (len == 0) return 0;
+
+    for (;;) {
+        uintptr_t flags = spinlock_acquire_irqsave(&s_tty_lock);
+        uint32_t mode = s_mode;
+        if (tty_readable_locked()) {
+            size_t n = tty_take_locked(kbuf, len, !(mode & TTY_RAW));
+            bool more = tty_readable_locked();
+            spinlock_release_irqrestore(&s_tty_lock, flags);
+            if (more && wait_queue_active(&s_readers)) wake_up_one(&s_readers); // Pass the rest on
+            return (ssize_t)n;
+        }
+        spinlock_release_irqrestore(&s_tty_lock, flags);
+
+        if (mode & TTY_NONBLOCK) return -EAGAIN;
+        if (!get_current_task()) return -EFAULT;
+        wait_event(&s_readers, tty_readable_locked());
+    }
+}
+
+bool tty_readable(void) {
+    return tty_readable_locked(); // Racy hint; a read re-checks under the lock
+}
+
+uint32_t tty_get_mode(void) {
+    return s_mode;
+}
+
+int tty_set_mode(uint32_t mode) {
+    if (mode & ~(uint32_t)TTY_MODE_MASK) return -EINVAL;
+
+    uintptr_t flags = spinlock_acquire_irqsave(&s_tty_lock);
+    uint32_t old = s_mode;
+    bool flushed = (mode & TTY_RAW) && !(old & TTY_RAW) && s_line_len > 0;
+    if (flushed) tty_flush_line_locked(0);
+    s_mode = mode;
+    spinlock_release_irqrestore(&s_tty_lock, flags);
+
+    if (flushed) tty_wake_readers();
+    return (int)old;
+}
@@ -0,0 +1,546 @@
+/**
+ * @file ahci.c
+ * @brief AHCI (SATA) host controller driver.
+ *
+ * Finds the first PCI AHCI function, takes its ports out of reset and binds
+ * SATA disks to block_device_t as sda, sdb, ... Commands are built in per-
+ * slot command tables with PRD entries pointing straight at the caller's
+ * buffer (translated page by page), so no bounce copy is needed.
+ *
+ * A port lock only covers slot allocation and issue; callers then poll
+ * their own slots with interrupts enabled, so several transfers (from one
+ * large request or from several CPUs) can be outstanding at once. With NCQ
+ * the drive may complete them in any order. Writes go to the drive's cache;
+ * FUA writes set the FPDMA FUA bit or use WRITE DMA FUA EXT, and
+ * ahci_flush() makes the rest durable.
+ */
+
+ #include <kernel/drivers/storage/ahci.h>
+ #include <kernel/drivers/storage/buffer_cache.h> // MAX_BUFFER_BLOCK_SIZE
+ #include <kernel/drivers/bus/pci.h>
+ #include <kernel/drivers/display/terminal.h>
+ #include <kernel/memory/buddy.h>
+ #include <kernel/memory/paging.h>
+ #include <kernel/sync/spinlock.h>
+ #include <kernel/lib/string.h>
+ #include <kernel/lib/assert.h>
+
+ // --- HBA Registers (ABAR) ---
+ #define AHCI_CAP            0x00
+ #define AHCI_GHC            0x04
+ #define AHCI_IS             0x08
+ #define AHCI_PI             0x0C
+ #define AHCI_CAP_SNCQ       (1u << 30)
+ #define AHCI_GHC_AE         (1u << 31)
+ #define AHCI_PORT_BASE      0x100
+ #define AHCI_PORT_SIZE      0x80
+ #define AHCI_MMIO_SIZE      (AHCI_PORT_BASE + 32 * AHCI_PORT_SIZE)
+
+ // --- Port Registers ---
+ #define AHCI_PxCLB          0x00
+ #define AHCI_PxCLBU         0x04
+ #define AHCI_PxFB           0x08
+ #define AHCI_PxFBU          0x0C
+ #define AHCI_PxIS           0x10
+ #define AHCI_PxIE           0x14
+ #define AHCI_PxCMD          0x18
+ #define AHCI_PxTFD          0x20
+ #define AHCI_PxSIG          0x24
+ #define AHCI_PxSSTS         0x28
+ #define AHCI_PxSERR         0x30
+ #define AHCI_PxSACT         0x34
+ #define AHCI_PxCI           0x38
+ #define AHCI_PxCMD_ST       (1u << 0)
+ #define AHCI_PxCMD_SUD      (1u << 1)
+ #define AHCI_PxCMD_POD      (1u << 2)
+ #define AHCI_PxCMD_FRE      (1u << 4)
+ #define AHCI_PxCMD_FR       (1u << 14)
+ #define AHCI_PxCMD_CR       (1u << 15)
+ #define AHCI_PxIS_ERR       ((1u << 30) | (1u << 29) | (1u << 28) | (1u << 27)) // TFES, HBFS, HBDS, IFS
+ #define AHCI_SSTS_DET_OK    0x3  // Device present, PHY up
+ #define AHCI_SIG_ATA        0x00000101u
+
+ // --- ATA Commands used over AHCI ---
+ #define AHCI_ATA_IDENTIFY        0xEC
+ #define AHCI_ATA_READ_DMA_EXT    0x25
+ #define AHCI_ATA_WRITE_DMA_EXT   0x35
+ #define AHCI_ATA_WRITE_DMA_FUA_EXT 0x3D
+ #define AHCI_ATA_READ_FPDMA      0x60 // NCQ
+ #define AHCI_ATA_WRITE_FPDMA     0x61 // NCQ
+ #define AHCI_ATA_FLUSH_EXT       0xEA
+ #define AHCI_FIS_REG_H2D         0x27
+ #define AHCI_ATA_DEV_LBA         0x40
+ #define AHCI_ATA_DEV_FUA         0x80 // FPDMA: force unit access
+
+ // --- Sizing ---
+ #define AHCI_MAX_SLOTS           32
+ #define AHCI_PRDT_ENTRIES        24   // 64 KiB spans at most 17 pages
+ #define AHCI_CMD_TABLE_SIZE      (0x80 + AHCI_PRDT_ENTRIES * 16) // 512, keeps 128 B alignment
+ #define AHCI_TABLES_ORDER        14   // 32 tables * 512 B
+ #define AHCI_MAX_BYTES_PER_CMD   (64u * 1024u)
+ #define AHCI_PRD_MAX_BYTES       (4u * 1024u * 1024u)
+ #define AHCI_TIMEOUT_LOOPS       30000000 // Polls without progress before a port is reset
+
+ // Command list entry
+ typedef struct {
+     uint16_t flags;            // CFL (FIS length in dwords) | W (bit 6) | C (bit 10)
+     uint16_t prdtl;            // PRD entries in the table
+     volatile uint32_t prdbc;   // Bytes transferred (HBA writes)
+     uint32_t ctba;             // Command table base (128 B aligned)
+     uint32_t ctbau;
+     uint32_t reserved[4];
+ } ahci_cmd_header_t;
+
+ #define AHCI_CMD_FLAG_WRITE      (1u << 6)
+ #define AHCI_CMD_FLAG_CLEAR_BUSY (1u << 10)
+
+ // PRD entry in a command table
+ typedef struct {
+     uint32_t dba;
+     uint32_t dbau;
+     uint32_t reserved;
+     uint32_t dbc;              // Byte count - 1 (bit 0 must be set: even lengths)
+ } ahci_prd_t;
+
+ typedef struct {
+     volatile uint8_t *regs;    // Port register block
+     spinlock_t lock;           // Slot allocation, issue and recovery
+     ahci_cmd_header_t *cmd_list; // 32 headers, 1 KiB aligned
+     uint8_t *fis;              // Received FIS area, 256 B aligned
+     uint8_t *tables;           // AHCI_CMD_TABLE_SIZE per slot
+     uint32_t tables_phys;
+     uint32_t slots;            // Usable slots (NCQ also bounded by queue depth)
+     volatile uint32_t busy;    // Slots owned by a caller
+     volatile uint32_t epoch;   // Bumped by recovery: slots issued earlier failed
+     bool ncq;
+     int port_no;
+ } ahci_port_t;
+
+ static volatile uint8_t *g_ahci_abar = NULL;
+ static uint32_t g_ahci_cap = 0;
+ static ahci_port_t g_ahci_ports[AHCI_MAX_DISKS];
+ static int g_ahci_disk_count = 0;
+
+ static inline uint32_t port_read(const ahci_port_t *p, uint32_t reg) {
+     return *(volatile uint32_t *)(p->regs + reg);
+ }
+
+ static inline void port_write(ahci_port_t *p, uint32_t reg, uint32_t value) {
+     *(volatile uint32_t *)(p->regs + reg) = value;
+ }
+
+ static inline uint32_t direct_phys(const void *v) {
+     return (uint32_t)((uintptr_t)v - KERNEL_SPACE_VIRT_START);
+ }
+
+ /**
+  * @brief Physical address of a kernel virtual address (direct map, else a
+  * page table walk, e.g. for kernel stacks).
+  */
+ static bool ahci_virt_to_phys(uintptr_t v, uint32_t *phys) {
+     if (paging_virt_is_direct((const void *)v)) {
+         *phys = (uint32_t)(v - KERNEL_SPACE_VIRT_START);
+         return true;
+     }
+     uintptr_t p = 0;
+     if (paging_get_physical_address((uint32_t *)(uintptr_t)g_kernel_page_directory_phys, v, &p) != 0) return false;
+     *phys = (uint32_t)p;
+     return true;
+ }
+
+ static bool ahci_wait_clear(ahci_port_t *p, uint32_t reg, uint32_t mask) {
+     for (uint32_t i = 0; i < AHCI_TIMEOUT_LOOPS; i++) {
+         if (!(port_read(p, reg) & mask)) return true;
+         asm volatile ("pause");
+     }
+     return false;
+ }
+
+ static void ahci_port_stop(ahci_port_t *p) {
+     port_write(p, AHCI_PxCMD, port_read(p, AHCI_PxCMD) & ~AHCI_PxCMD_ST);
+     if (!ahci_wait_clear(p, AHCI_PxCMD, AHCI_PxCMD_CR)) {
+         terminal_printf("[AHCI] Port %d: command engine did not stop.\n", p->port_no);
+     }
+     port_write(p, AHCI_PxCMD, port_read(p, AHCI_PxCMD) & ~AHCI_PxCMD_FRE);
+     (void)ahci_wait_clear(p, AHCI_PxCMD, AHCI_PxCMD_FR);
+ }
+
+ static void ahci_port_start(ahci_port_t *p) {
+     (void)ahci_wait_clear(p, AHCI_PxCMD, AHCI_PxCMD_CR);
+     port_write(p, AHCI_PxCMD, port_read(p, AHCI_PxCMD) | AHCI_PxCMD_FRE);
+     port_write(p, AHCI_PxCMD, port_read(p, AHCI_PxCMD) | AHCI_PxCMD_ST);
+ }
+
+ /**
+  * @brief Error recovery: restart the command engine, which aborts every
+  * outstanding command on the port. Assumes p->lock is held.
+  */
+ static void ahci_port_recover(ahci_port_t *p) {
+     terminal_printf("[AHCI] Port %d: error (IS=%#lx, TFD=%#lx, SERR=%#lx), restarting.\n",
+                     p->port_no, (unsigned long)port_read(p, AHCI_PxIS),
+                     (unsigned long)port_read(p, AHCI_PxTFD), (unsigned long)port_read(p, AHCI_PxSERR));
+     ahci_port_stop(p);
+     port_write(p, AHCI_PxSERR, 0xFFFFFFFFu);
+     port_write(p, AHCI_PxIS, 0xFFFFFFFFu);
+     p->busy = 0;
+     p->epoch++;
+     ahci_port_start(p);
+ }
+
+ /**
+  * @brief Fill slot's command header, FIS and PRD table.
+  * @param queued Build an NCQ (FPDMA) command: tag = slot, count in FEATURES.
+  * @param fua    Set force unit access on a queued write (non-queued FUA has its own opcode).
+  */
+ static int ahci_build_command(ahci_port_t *p, uint32_t slot, uint8_t command, uint64_t lba,
+                               uint32_t sectors, void *buffer, size_t bytes, bool write, bool queued, bool fua) {
+     uint8_t *table = p->tables + slot * AHCI_CMD_TABLE_SIZE;
+     ahci_prd_t *prdt = (ahci_prd_t *)(table + 0x80);
+     memset(table, 0, AHCI_CMD_TABLE_SIZE);
+
+     // PRD entries: one per physically contiguous run of the buffer
+     uint32_t nprd = 0;
+     uintptr_t v = (uintptr_t)buffer;
+     size_t left = bytes;
+     if (v & 1) return BLOCK_ERR_PARAMS; // DMA needs word alignment
+     while (left > 0) {
+         uint32_t phys;
+         if (!ahci_virt_to_phys(v, &phys)) return BLOCK_ERR_PARAMS;
+         size_t chunk = PAGE_SIZE - (v & (PAGE_SIZE - 1));
+         if (chunk > left) chunk = left;
+
+         ahci_prd_t *last = nprd ? &prdt[nprd - 1] : NULL;
+         if (last && last->dba + last->dbc + 1 == phys && last->dbc + 1 + chunk <= AHCI_PRD_MAX_BYTES) {
+             last->dbc += (uint32_t)chunk;
+         } else {
+             if (nprd == AHCI_PRDT_ENTRIES) return BLOCK_ERR_PARAMS;
+             prdt[nprd].dba = phys;
+             prdt[nprd].dbc = (uint32_t)chunk - 1;
+             nprd++;
+         }
+         v += chunk;
+         left -= chunk;
+     }
+
+     uint8_t *fis = table;
+     fis[0] = AHCI_FIS_REG_H2D;
+     fis[1] = 0x80; // Command, not control
+     fis[2] = command;
+     fis[4] = (uint8_t)lba;
+     fis[5] = (uint8_t)(lba >> 8);
+     fis[6] = (uint8_t)(lba >> 16);
+     fis[8] = (uint8_t)(lba >> 24);
+     fis[9] = (uint8_t)(lba >> 32);
+     fis[10] = (uint8_t)(lba >> 40);
+     if (command != AHCI_ATA_IDENTIFY) fis[7] = AHCI_ATA_DEV_LBA;
+     if (queued) {
+         fis[3] = (uint8_t)sectors;
+         fis[11] = (uint8_t)(sectors >> 8);
+         fis[12] = (uint8_t)(slot << 3);
+         if (write && fua) fis[7] |= AHCI_ATA_DEV_FUA;
+     } else {
+         fis[12] = (uint8_t)sectors;
+         fis[13] = (uint8_t)(sectors >> 8);
+     }
+
+     ahci_cmd_header_t *hdr = &p->cmd_list[slot];
+     hdr->flags = 5 | (write ? AHCI_CMD_FLAG_WRITE : 0) | AHCI_CMD_FLAG_CLEAR_BUSY; // H2D FIS is 5 dwords
+     hdr->prdtl = (uint16_t)nprd;
+     hdr->prdbc = 0;
+     hdr->ctba = p->tables_phys + slot * AHCI_CMD_TABLE_SIZE;
+     hdr->ctbau = 0;
+     return BLOCK_ERR_OK;
+ }
+
+ /** @brief Lowest free slot, or -1. Assumes p->lock is held. */
+ static int ahci_alloc_slot(ahci_port_t *p) {
+     for (uint32_t s = 0; s < p->slots; s++) {
+         if (!(p->busy & (1u << s))) return (int)s;
+     }
+     return -1;
+ }
+
+ /**
+  * @brief Run one non-queued command to completion (IDENTIFY, FLUSH).
+  * In NCQ mode the port must have nothing else outstanding.
+  */
+ static int ahci_exec(ahci_port_t *p, uint8_t command, void *buffer, size_t bytes) {
+     int slot;
+     uint32_t epoch;
+     for (;;) {
+         uintptr_t irq_flags = spinlock_acquire_irqsave(&p->lock);
+         slot = (p->ncq && p->busy) ? -1 : ahci_alloc_slot(p);
+         if (slot >= 0) {
+             int ret = ahci_build_command(p, (uint32_t)slot, command, 0, 0, buffer, bytes, false, false, false);
+             if (ret != BLOCK_ERR_OK) {
+                 spinlock_release_irqrestore(&p->lock, irq_flags);
+                 return ret;
+             }
+             p->busy |= 1u << slot;
+             epoch = p->epoch;
+             __asm__ volatile ("" ::: "memory");
+             port_write(p, AHCI_PxCI, 1u << slot);
+             spinlock_release_irqrestore(&p->lock, irq_flags);
+             break;
+         }
+         spinlock_release_irqrestore(&p->lock, irq_flags);
+         asm volatile ("pause");
+     }
+
+     int ret = BLOCK_ERR_TIMEOUT;
+     for (uint32_t i = 0; i < AHCI_TIMEOUT_LOOPS; i++) {
+         if (p->epoch != epoch) { ret = BLOCK_ERR_IO; break; }
+         if (port_read(p, AHCI_PxIS) & AHCI_PxIS_ERR) { ret = BLOCK_ERR_DEV_ERR; break; }
+         if (!(port_read(p, AHCI_PxCI) & (1u << slot))) { ret = BLOCK_ERR_OK; break; }
+         asm volatile ("pause");
+     }
+
+     uintptr_t irq_flags = spinlock_acquire_irqsave(&p->lock);
+     if (p->epoch == epoch) {
+         if (ret != BLOCK_ERR_OK) ahci_port_recover(p);
+         else p->busy &= ~(1u << slot);
+     }
+     spinlock_release_irqrestore(&p->lock, irq_flags);
+     __asm__ volatile ("" ::: "memory");
+     return ret;
+ }
+
+ /**
+  * @brief Reads or writes count sectors, keeping as many commands of up to
+  * AHCI_MAX_BYTES_PER_CMD in flight as there are free slots. A FUA write
+  * without FUA commands is followed by a cache flush.
+  */
+ int ahci_transfer(block_device_t *dev, uint64_t lba, void *buffer, size_t count, bool write, bool fua) {
+     KERNEL_ASSERT(dev && dev->initialized && buffer && count > 0, "Invalid parameters to ahci_transfer");
+     KERNEL_ASSERT(lba < dev->total_sectors && count <= dev->total_sectors - lba, "Transfer out of bounds");
+     ahci_port_t *p = (ahci_port_t *)dev->driver_data;
+
+     size_t per_cmd = AHCI_MAX_BYTES_PER_CMD / dev->sector_size;
+     if (per_cmd == 0) per_cmd = 1;
+     fua = fua && write;
+     bool fua_cmd = fua && (p->ncq || dev->fua_supported); // FPDMA always has the FUA bit
+     uint8_t command = p->ncq ? (write ? AHCI_ATA_WRITE_FPDMA : AHCI_ATA_READ_FPDMA)
+                              : (write ? (fua_cmd ? AHCI_ATA_WRITE_DMA_FUA_EXT : AHCI_ATA_WRITE_DMA_EXT)
+                                       : AHCI_ATA_READ_DMA_EXT);
+     if (write && !fua) dev->flush_pending = true;
+
+     size_t issued = 0;       // Sectors handed to commands
+     uint32_t mine = 0;       // Our slots in flight
+     uint32_t epoch = p->epoch;
+     uint32_t idle_loops = 0;
+     int ret = BLOCK_ERR_OK;
+     int issue_err = BLOCK_ERR_OK; // Stops issuing; commands already out are still reaped
+
+     while (ret == BLOCK_ERR_OK && (issued < count || mine)) {
+         // Fill free slots
+         if (issued < count) {
+             uintptr_t irq_flags = spinlock_acquire_irqsave(&p->lock);
+             if (p->epoch != epoch) ret = BLOCK_ERR_IO;
+             while (ret == BLOCK_ERR_OK && issued < count) {
+                 int slot = ahci_alloc_slot(p);
+                 if (slot < 0) break;
+                 size_t n = count - issued;
+                 if (n > per_cmd) n = per_cmd;
+                 issue_err = ahci_build_command(p, (uint32_t)slot, command, lba + issued, (uint32_t)n,
+                                                (uint8_t *)buffer + issued * dev->sector_size,
+                                                n * dev->sector_size, write, p->ncq, fua_cmd);
+                 if (issue_err != BLOCK_ERR_OK) {
+                     issued = count;
+                     break;
+                 }
+                 p->busy |= 1u << slot;
+                 mine |= 1u << slot;
+                 __asm__ volatile ("" ::: "memory");
+                 if (p->ncq) port_write(p, AHCI_PxSACT, 1u << slot);
+                 port_write(p, AHCI_PxCI, 1u << slot);
+                 issued += n;
+             }
+             spinlock_release_irqrestore(&p->lock, irq_flags);
+             if (ret != BLOCK_ERR_OK) break;
+         }
+
+         // Reap finished slots
+         uint32_t pending = port_read(p, AHCI_PxCI) | (p->ncq ? port_read(p, AHCI_PxSACT) : 0);
+         bool failed = (port_read(p, AHCI_PxIS) & AHCI_PxIS_ERR) != 0;
+         uint32_t done = mine & ~pending;
+         if (failed || done || ++idle_loops >= AHCI_TIMEOUT_LOOPS) {
+             uintptr_t irq_flags = spinlock_acquire_irqsave(&p->lock);
+             if (p->epoch != epoch) {
+                 ret = BLOCK_ERR_IO; // Someone else's recovery aborted our commands
+             } else if (failed || !done) {
+                 ret = failed ? BLOCK_ERR_DEV_ERR : BLOCK_ERR_TIMEOUT;
+                 ahci_port_recover(p);
+             } else {
+                 p->busy &= ~done;
+                 mine &= ~done;
+             }
+             spinlock_release_irqrestore(&p->lock, irq_flags);
+             idle_loops = 0;
+         } else {
+             asm volatile ("pause");
+         }
+     }
+     __asm__ volatile ("" ::: "memory");
+
+     // On a port error the recovery released every slot, ours included
+     if (ret == BLOCK_ERR_OK) ret = issue_err;
+     if (ret != BLOCK_ERR_OK) {
+         terminal_printf("[AHCI %s] %s of %lu sectors at LBA %llu failed (err %d).\n",
+                         dev->device_name, write ? "Write" : "Read", (unsigned long)count, lba, ret);
+         return ret;
+     }
+
+     if (fua && !fua_cmd && dev->write_cache) ret = ahci_flush(dev);
+     return ret;
+ }
+
+ /**
+  * @brief FLUSH CACHE EXT: everything written before it is on the medium.
+  */
+ int ahci_flush(block_device_t *dev) {
+     ahci_port_t *p = (ahci_port_t *)dev->driver_data;
+     dev->flush_pending = false; // Writes completing from here on need another flush
+     int ret = ahci_exec(p, AHCI_ATA_FLUSH_EXT, NULL, 0);
+     if (ret != BLOCK_ERR_OK) {
+         dev->flush_pending = true;
+         terminal_printf("[AHCI %s] Cache flush failed (err %d).\n", dev->device_name, ret);
+     }
+     return ret;
+ }
+
+ /**
+  * @brief IDENTIFY the disk on a port and fill in the block device geometry.
+  */
+ static int ahci_identify(ahci_port_t *p, block_device_t *dev) {
+     uint16_t *id = buddy_alloc_raw(9); // 512 B, direct-mapped
+     if (!id) return BLOCK_ERR_INTERNAL;
+
+     int ret = ahci_exec(p, AHCI_ATA_IDENTIFY, id, 512);
+     if (ret != BLOCK_ERR_OK) {
+         buddy_free_raw(id, 9);
+         return ret;
+     }
+
+     dev->lba48_supported = (id[83] & (1 << 10)) != 0;
+     dev->dma_supported = true;
+     dev->write_cache = (id[85] & (1 << 5)) != 0;
+     dev->fua_supported = dev->lba48_supported && (id[84] & (1 << 6)) != 0;
+     dev->flush_pending = false;
+     dev->total_sectors = dev->lba48_supported ?
+         ((uint64_t)id[100] | ((uint64_t)id[101] << 16) | ((uint64_t)id[102] << 32) | ((uint64_t)id[103] << 48)) :
+         ((uint32_t)id[60] | ((uint32_t)id[61] << 16));
+     dev->sector_size = 512;
+     if ((id[106] & 0x4000) && !(id[106] & 0x8000) && (id[106] & (1 << 12))) {
+         uint32_t bytes = ((uint32_t)id[117] | ((uint32_t)id[118] << 16)) * 2;
+         if (bytes >= 512 && bytes <= MAX_BUFFER_BLOCK_SIZE && (bytes & (bytes - 1)) == 0) dev->sector_size = bytes;
+     }
+
+     // NCQ: IDENTIFY word 76 bit 8, queue depth in word 75 (minus one)
+     if ((g_ahci_cap & AHCI_CAP_SNCQ) && (id[76] & (1 << 8))) {
+         uint32_t depth = (id[75] & 0x1F) + 1;
+         p->ncq = true;
+         if (p->slots > depth) p->slots = depth;
+     }
+     buddy_free_raw(id, 9);
+
+     if (dev->total_sectors == 0) return BLOCK_ERR_NO_DEV;
+     return BLOCK_ERR_OK;
+ }
+
+ /**
+  * @brief Give a port its command list, FIS area and tables, and start it.
+  */
+ static bool ahci_port_setup(ahci_port_t *p) {
+     uint8_t *base = buddy_alloc_raw(12);              // Command list (1 KiB) + FIS area
+     uint8_t *tables = buddy_alloc_raw(AHCI_TABLES_ORDER);
+     if (!base || !tables || !paging_virt_is_direct(base) || !paging_virt_is_direct(tables)) {
+         if (base) buddy_free_raw(base, 12);
+         if (tables) buddy_free_raw(tables, AHCI_TABLES_ORDER);
+         return false;
+     }
+     memset(base, 0, PAGE_SIZE);
+     memset(tables, 0, 1u << AHCI_TABLES_ORDER);
+     p->cmd_list = (ahci_cmd_header_t *)base;
+     p->fis = base + 1024;
+     p->tables = tables;
+     p->tables_phys = direct_phys(tables);
+     spinlock_init(&p->lock);
+
+     ahci_port_stop(p);
+     port_write(p, AHCI_PxCLB, direct_phys(p->cmd_list));
+     port_write(p, AHCI_PxCLBU, 0);
+     port_write(p, AHCI_PxFB, direct_phys(p->fis));
+     port_write(p, AHCI_PxFBU, 0);
+     port_write(p, AHCI_PxSERR, 0xFFFFFFFFu);
+     port_write(p, AHCI_PxIS, 0xFFFFFFFFu);
+     port_write(p, AHCI_PxIE, 0); // Completion is polled
+     port_write(p, AHCI_PxCMD, port_read(p, AHCI_PxCMD) | AHCI_PxCMD_SUD | AHCI_PxCMD_POD);
+     ahci_port_start(p);
+     return true;
+ }
+
+ void ahci_init(void) {
+     pci_device_t hba;
+     if (!pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_SATA, 0, &hba) || hba.prog_if != 0x01) {
+         terminal_write("[AHCI] No AHCI controller found.\n");
+         return;
+     }
+     uint32_t bar5 = pci_read_bar(&hba, 5);
+     if ((bar5 & PCI_BAR_IO) || (bar5 & ~0xFu) == 0) {
+         terminal_write("[AHCI] Controller has no memory BAR5; skipping.\n");
+         return;
+     }
+     pci_enable(&hba, PCI_COMMAND_MEMORY | PCI_COMMAND_BUS_MASTER);
+     g_ahci_abar = paging_map_mmio(bar5 & ~0xFu, AHCI_MMIO_SIZE);
+     if (!g_ahci_abar) {
+         terminal_write("[AHCI] Failed to map controller registers.\n");
+         return;
+     }
+
+     volatile uint32_t *ghc = (volatile uint32_t *)(g_ahci_abar + AHCI_GHC);
+     *ghc |= AHCI_GHC_AE;
+     g_ahci_cap = *(volatile uint32_t *)(g_ahci_abar + AHCI_CAP);
+     uint32_t pi = *(volatile uint32_t *)(g_ahci_abar + AHCI_PI);
+     uint32_t slots = ((g_ahci_cap >> 8) & 0x1F) + 1;
+
+     terminal_printf("[AHCI] Controller %04x:%04x, %lu slots, NCQ:%d, ports %#lx.\n",
+                     hba.vendor_id, hba.device_id, (unsigned long)slots,
+                     (g_ahci_cap & AHCI_CAP_SNCQ) != 0, (unsigned long)pi);
+
+     for (int port_no = 0; port_no < 32 && g_ahci_disk_count < AHCI_MAX_DISKS; port_no++) {
+         if (!(pi & (1u << port_no))) continue;
+         ahci_port_t *p = &g_ahci_ports[g_ahci_disk_count];
+         memset(p, 0, sizeof(*p));
+         p->regs = g_ahci_abar + AHCI_PORT_BASE + port_no * AHCI_PORT_SIZE;
+         p->port_no = port_no;
+         p->slots = slots;
+
+         if ((port_read(p, AHCI_PxSSTS) & 0xF) != AHCI_SSTS_DET_OK) continue;
+         if (port_read(p, AHCI_PxSIG) != AHCI_SIG_ATA) continue; // ATAPI, port multipliers: not handled
+         if (!ahci_port_setup(p)) {
+             terminal_printf("[AHCI] Port %d: no memory for command structures.\n", port_no);
+             continue;
+         }
+         terminal_printf("[AHCI] Port %d: SATA disk -> sd%c.\n", port_no, 'a' + g_ahci_disk_count);
+         g_ahci_disk_count++;
+     }
+ }
+
+ int ahci_device_init(int index, block_device_t *dev) {
+     if (!dev || index < 0 || index >= g_ahci_disk_count) return BLOCK_ERR_NO_DEV;
+     ahci_port_t *p = &g_ahci_ports[index];
+
+     dev->transport = BLOCK_TRANSPORT_AHCI;
+     dev->driver_data = p;
+     dev->use_dma = true;
+     int ret = ahci_identify(p, dev);
+     if (ret != BLOCK_ERR_OK) {
+         terminal_printf("[AHCI] %s: IDENTIFY failed (err %d).\n", dev->device_name, ret);
+         return ret;
+     }
+     dev->initialized = true;
+     terminal_printf("[AHCI] %s: %llu sectors of %lu bytes, LBA48:%d, NCQ:%d, %lu slots.\n",
+                     dev->device_name, dev->total_sectors, (unsigned long)dev->sector_size,
+                     dev->lba48_supported, p->ncq, (unsigned long)p->slots);
+     return BLOCK_ERR_OK;
+ }
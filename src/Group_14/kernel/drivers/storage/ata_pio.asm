@@ -0,0 +1,65 @@
+; ata_pio.asm
+; String I/O for ATA PIO data transfers.
+;
+; One rep ins/outs moves a whole sector, where a C loop of inw/outw issues a
+; separate port instruction (and, under a hypervisor, a separate exit) per
+; word. The 32-bit variants halve the count again on controllers whose data
+; port accepts dword access (block_device.c verifies this at IDENTIFY).
+
+section .text
+global ata_pio_read16
+global ata_pio_write16
+global ata_pio_read32
+global ata_pio_write32
+
+;-----------------------------------------------------------------------------
+; void ata_pio_read16(uint16_t port, void *buffer, uint32_t words)
+;-----------------------------------------------------------------------------
+ata_pio_read16:
+    push edi
+    movzx edx, word [esp + 8]   ; port
+    mov edi, [esp + 12]         ; buffer
+    mov ecx, [esp + 16]         ; words
+    cld
+    rep insw
+    pop edi
+    ret
+
+;-----------------------------------------------------------------------------
+; void ata_pio_write16(uint16_t port, const void *buffer, uint32_t words)
+;-----------------------------------------------------------------------------
+ata_pio_write16:
+    push esi
+    movzx edx, word [esp + 8]   ; port
+    mov esi, [esp + 12]         ; buffer
+    mov ecx, [esp + 16]         ; words
+    cld
+    rep outsw
+    pop esi
+    ret
+
+;-----------------------------------------------------------------------------
+; void ata_pio_read32(uint16_t port, void *buffer, uint32_t dwords)
+;-----------------------------------------------------------------------------
+ata_pio_read32:
+    push edi
+    movzx edx, word [esp + 8]   ; port
+    mov edi, [esp + 12]         ; buffer
+    mov ecx, [esp + 16]         ; dwords
+    cld
+    rep insd
+    pop edi
+    ret
+
+;-----------------------------------------------------------------------------
+; void ata_pio_write32(uint16_t port, const void *buffer, uint32_t dwords)
+;-----------------------------------------------------------------------------
+ata_pio_write32:
+    push esi
+    movzx edx, word [esp + 8]   ; port
+    mov esi, [esp + 12]         ; buffer
+    mov ecx, [esp + 16]         ; dwords
+    cld
+    rep outsd
+    pop esi
+    ret
@@ -1,6 +1,12 @@
 /**
  * @file block_device.c
- * @brief ATA PIO Block Device Driver (IRQ for R/W with Polling Assist, Polling for IDENTIFY)
+ * @brief ATA Block Device Driver (bus-master DMA where the PCI IDE controller
+ *        offers it, PIO otherwise; polling for IDENTIFY)
+ *
+ * Tasks that may sleep wait for command completion on the channel's wait
+ * queue, woken by the channel IRQ, and only hold the channel's sleeping
+ * mutex meanwhile. Early boot and callers running with interrupts off keep
+ * the old behaviour: channel spinlock held, completion polled.
  *
  * Author: Group 14 (UiA) & Gemini
  * Version: 5.4 - Fixed build errors from debug prints and unused variables.
@@ -8,6 +14,10 @@
 
  #include <kernel/drivers/storage/block_device.h>
  #include <kernel/drivers/storage/buffer_cache.h> // <<< ADD THIS INCLUDE
+ #include <kernel/drivers/storage/ahci.h>   // sdX devices
+ #include <kernel/drivers/storage/ramdisk.h> // ramN devices
+ #include <kernel/drivers/storage/block_queue.h> // Per-device request queue
+ #include <kernel/drivers/storage/ata_pio.h> // rep insw/outsw sector transfers
  #include <kernel/lib/port_io.h>      // For inb, outb, inw, outw
  #include <kernel/drivers/display/terminal.h>     // For terminal_printf/write
  #include <kernel/sync/spinlock.h>     // For spinlock_t and functions
@@ -16,8 +26,18 @@
  #include <kernel/fs/vfs/fs_errno.h>     // For error codes (FS_ERR_*, BLOCK_ERR_*)
  #include <libc/limits.h>  // For UINTPTR_MAX
  #include <kernel/cpu/isr_frame.h>    // Include the frame definition
+ #include <kernel/cpu/idt.h>          // For irq_send_eoi
  #include <kernel/lib/assert.h>       // KERNEL_ASSERT (Optional, but recommended)
  #include <kernel/drivers/input/keyboard_hw.h> // <<< ADDED for KBC_STATUS_PORT constant for debug prints
+ #include <kernel/drivers/bus/pci.h>  // Locating the bus-master IDE function
+ #include <kernel/memory/buddy.h>     // DMA bounce buffers and PRD tables
+ #include <kernel/memory/paging.h>    // KERNEL_SPACE_VIRT_START, paging_virt_is_direct
+ #include <kernel/sync/mutex.h>       // Per-channel I/O mutex
+ #include <kernel/sync/wait_queue.h>  // Sleeping on the channel IRQ
+ #include <kernel/process/scheduler.h> // g_scheduler_ready, get_current_task
+ #include <kernel/drivers/display/serial.h> // block_device_dump_stats
+ #include <kernel/cpu/tsc.h>          // Latency timing
+ #include <kernel/core/tracepoint.h>
  // --- ATA Register Definitions ---
  #define ATA_REG_DATA        0
  #define ATA_REG_ERROR        1
@@ -56,6 +76,17 @@
  #define ATA_CMD_WRITE_MULTIPLE_EXT 0x3A
  #define ATA_CMD_FLUSH_CACHE       0xE7
  #define ATA_CMD_FLUSH_CACHE_EXT   0xEA
+ #define ATA_CMD_READ_DMA          0xC8
+ #define ATA_CMD_READ_DMA_EXT      0x25
+ #define ATA_CMD_WRITE_DMA         0xCA
+ #define ATA_CMD_WRITE_DMA_EXT     0x35
+ #define ATA_CMD_WRITE_DMA_FUA_EXT 0x3D
+ #define ATA_CMD_WRITE_MULTIPLE_FUA_EXT 0xCE
+
+ // --- Transfer Limits ---
+ #define ATA_MAX_SECTORS_LBA28     256     // Sector count 0 encodes the maximum
+ #define ATA_MAX_SECTORS_LBA48     65536
+ #define ATA_MAX_MULTIPLE          128     // Largest DRQ block IDENTIFY word 47 may report
 
  // --- Device Selection Bits ---
  #define ATA_DEV_MASTER        0xA0
@@ -71,25 +102,71 @@
  // --- Timeout Values ---
  #define ATA_TIMEOUT_PIO        1500000 // Base timeout loops for polling status waits
  #define ATA_IRQ_WAIT_MULTIPLIER   20   // Multiplier for IRQ wait loop
-
- // --- Global Locks per Channel ---
- static spinlock_t g_ata_primary_lock;
- static spinlock_t g_ata_secondary_lock;
-
- // IRQ Handling Flags (Specific to Primary Channel for now)
- static volatile bool g_ata_primary_irq_fired = false;
- static volatile uint8_t g_ata_primary_last_status = 0;
- static volatile uint8_t g_ata_primary_last_error = 0;
+ #define ATA_IRQ_TIMEOUT_MS     5000   // Sleeping wait before BSY is checked for a lost IRQ
+
+ // --- Bus-Master IDE Registers (BAR4 of the IDE function, 8 ports per channel) ---
+ #define ATA_BM_REG_COMMAND    0
+ #define ATA_BM_REG_STATUS     2
+ #define ATA_BM_REG_PRDT       4
+ #define ATA_BM_CMD_START      0x01
+ #define ATA_BM_CMD_READ       0x08 // Direction: device -> memory
+ #define ATA_BM_SR_ACTIVE      0x01
+ #define ATA_BM_SR_ERR         0x02 // Write 1 to clear
+ #define ATA_BM_SR_IRQ         0x04 // Drive raised INTRQ; write 1 to clear
+ #define ATA_BM_SR_DRV0_DMA    0x20
+ #define ATA_BM_SR_DRV1_DMA    0x40
+ #define ATA_PRD_EOT           0x8000
+ #define ATA_DMA_BUF_ORDER     16   // 64 KiB: one full PRD entry, and buddy blocks are aligned to their size
+ #define ATA_DMA_BUF_SIZE      (1u << ATA_DMA_BUF_ORDER)
+
+ // Physical Region Descriptor: one entry per DMA'd memory region
+ typedef struct __attribute__((packed)) {
+     uint32_t phys_addr;
+     uint16_t byte_count;       // 0 means 64 KiB
+     uint16_t flags;            // ATA_PRD_EOT on the last entry
+ } ata_prd_t;
+
+ // --- Per-Channel State ---
+ typedef struct {
+     spinlock_t lock;           // Held, with io_mutex, by callers that poll
+     kmutex_t io_mutex;         // Serializes commands on the channel
+     uint16_t io_base;
+     // IRQ handoff
+     wait_queue_t irq_wq;       // Sleeping submitter, woken by ata_channel_irq()
+     volatile bool irq_fired;
+     volatile uint8_t last_status;
+     volatile uint8_t last_error;
+     volatile uint8_t last_bm_status; // Bus-master status as the IRQ found (and cleared) it
+     // Bus-master DMA engine (bm_base 0 = PIO only). Transfers bounce through
+     // dma_buf, so callers' buffers need not be physically contiguous.
+     uint16_t bm_base;
+     ata_prd_t *prdt;
+     uint32_t prdt_phys;
+     uint8_t *dma_buf;
+     uint32_t dma_buf_phys;
+ } ata_channel_t;
+
+ static ata_channel_t g_ata_channels[2]; // [0] primary, [1] secondary
+ static bool g_ata_pci_controller = false; // Legacy ports belong to a PCI IDE function (32-bit PIO candidate)
+
+ static inline ata_channel_t *ata_channel_of(const block_device_t *dev) {
+     return &g_ata_channels[dev->io_base == ATA_PRIMARY_IO ? 0 : 1];
+ }
 
  // --- Internal Helper Prototypes ---
  static int ata_poll_status(uint16_t io_base, uint8_t wait_mask, uint8_t wait_value, uint32_t timeout, const char* context);
  static void ata_delay_400ns(uint16_t ctrl_base);
  static int ata_select_drive(block_device_t *dev);
+ static int ata_identify_read(block_device_t *dev, uint16_t *identify_data, bool pio32); // Uses polling
  static int ata_identify(block_device_t *dev); // Uses polling
  static int ata_set_multiple_mode(block_device_t *dev); // Uses polling
- static void ata_setup_lba(block_device_t *dev, uint64_t lba, size_t count);
+ static void ata_setup_lba(block_device_t *dev, uint64_t lba, size_t count, bool lba48);
  static int ata_pio_transfer_block(block_device_t *dev, void *buffer, size_t sectors_in_block, bool write);
- static int block_device_transfer(block_device_t *dev, uint64_t lba, void *buffer, size_t count, bool write); // Uses IRQ wait
+ static int block_device_transfer(block_device_t *dev, uint64_t lba, void *buffer, size_t count, bool write, bool fua); // Uses IRQ wait
+ static int ata_flush_cache(block_device_t *dev, ata_channel_t *ch, bool can_sleep);
+ static void ata_dma_init(void);
+ static int ata_dma_transfer(block_device_t *dev, ata_channel_t *ch, uint64_t lba, uint8_t *buffer,
+                             size_t count, bool write, bool fua, bool can_sleep, size_t *moved);
 
  // --- Wait Functions ---
 
@@ -126,6 +203,74 @@
      (void)inb(ctrl_base + ATA_REG_ALTSTATUS);
  }
 
+ /**
+  * @brief True if the caller may sleep until a command's IRQ: the scheduler
+  * runs, interrupts are on, and it is not the idle task.
+  */
+ static bool ata_caller_may_sleep(void) {
+     if (!g_scheduler_ready) return false;
+     uint32_t eflags;
+     asm volatile("pushf; pop %0" : "=r"(eflags));
+     tcb_t *current = get_current_task();
+     return (eflags & 0x200) && current && current->pid != IDLE_TASK_PID;
+ }
+
+ /**
+  * @brief Takes a channel for one request. Sleeping callers hold only
+  * io_mutex; the rest also take the spinlock (interrupts off) as before.
+  * A holder may sleep until its IRQ, which a caller spinning here with
+  * interrupts off could keep this CPU from taking; so once the scheduler
+  * runs, a non-sleeping caller only takes a free channel and never waits.
+  * @param irq_flags Receives the interrupt flags for ata_channel_release().
+  * @return BLOCK_ERR_OK, or BLOCK_ERR_LOCKED if the channel is busy.
+  */
+ static int ata_channel_acquire(ata_channel_t *ch, bool can_sleep, uintptr_t *irq_flags) {
+     *irq_flags = 0;
+     if (can_sleep) {
+         kmutex_lock(&ch->io_mutex);
+         return BLOCK_ERR_OK;
+     }
+     while (!kmutex_trylock(&ch->io_mutex)) {
+         if (g_scheduler_ready) return BLOCK_ERR_LOCKED;
+         asm volatile("pause");
+     }
+     *irq_flags = spinlock_acquire_irqsave(&ch->lock);
+     return BLOCK_ERR_OK;
+ }
+
+ static void ata_channel_release(ata_channel_t *ch, bool can_sleep, uintptr_t irq_flags) {
+     if (!can_sleep) spinlock_release_irqrestore(&ch->lock, irq_flags);
+     kmutex_unlock(&ch->io_mutex);
+ }
+
+ /**
+  * @brief Waits for the command just issued to finish (INTRQ, or BSY clear
+  * when polling). Sleeping callers block on irq_wq; if no IRQ arrives within
+  * ATA_IRQ_TIMEOUT_MS the status register decides whether it was lost.
+  * @return Final status register value, or -1 on timeout.
+  */
+ static int ata_wait_completion(block_device_t *dev, ata_channel_t *ch, bool can_sleep, const char *context) {
+     if (can_sleep) {
+         bool timed_out;
+         wait_event_timeout(&ch->irq_wq, ch->irq_fired, ATA_IRQ_TIMEOUT_MS, timed_out);
+         if (!timed_out) return ch->last_status;
+         uint8_t status = inb(dev->io_base + ATA_REG_STATUS);
+         if (status & ATA_SR_BSY) return -1;
+         terminal_printf("[ATA %s %s] No IRQ within %u ms, but the drive is done (Status=%#x).\n",
+                         dev->device_name, context, ATA_IRQ_TIMEOUT_MS, status);
+         return status;
+     }
+
+     uint32_t wait_loops = ATA_TIMEOUT_PIO * ATA_IRQ_WAIT_MULTIPLIER;
+     while (wait_loops--) {
+         if (ch->irq_fired) return ch->last_status;
+         uint8_t status = inb(dev->io_base + ATA_REG_STATUS);
+         if (!(status & ATA_SR_BSY)) return status;
+         asm volatile ("pause");
+     }
+     return ch->irq_fired ? ch->last_status : -1;
+ }
+
  // --- Core Operations --- (ata_select_drive, ata_identify, ata_set_multiple_mode, ata_setup_lba remain unchanged)
  /**
   * @brief Selects the specified drive on the channel and waits for it to be ready using polling.
@@ -174,12 +319,10 @@
  }
 
  /**
- * @brief Issues the IDENTIFY DEVICE command and parses key information using polling.
- * Includes fix for parsing logical sector size from words 117-118.
+ * @brief Issues the IDENTIFY DEVICE command and reads its 256 words using
+ * polling, through 16- or 32-bit data port accesses.
  */
-static int ata_identify(block_device_t *dev) {
-    KERNEL_ASSERT(dev != NULL, "NULL dev in ata_identify");
-
+static int ata_identify_read(block_device_t *dev, uint16_t *identify_data, bool pio32) {
     int ret = ata_select_drive(dev);
     if (ret != BLOCK_ERR_OK) return ret;
 
@@ -219,8 +362,8 @@ static int ata_identify(block_device_t *dev) {
     }
 
     // Read IDENTIFY data (512 bytes = 256 words)
-    uint16_t identify_data[256];
-    for (int i = 0; i < 256; i++) { identify_data[i] = inw(dev->io_base + ATA_REG_DATA); }
+    if (pio32) ata_pio_read32(dev->io_base + ATA_REG_DATA, identify_data, 128);
+    else ata_pio_read16(dev->io_base + ATA_REG_DATA, identify_data, 256);
 
     // Final status check after reading data
     ret = ata_poll_status(dev->io_base, ATA_SR_BSY, 0x00, ATA_TIMEOUT_PIO, "IdentifyPostReadBSYClear");
@@ -230,6 +373,30 @@ static int ata_identify(block_device_t *dev) {
         terminal_printf("[ATA IDENTIFY %s] Error/Fault after reading data (Status=%#x).\n", dev->device_name, status);
         return BLOCK_ERR_DEV_FAULT;
     }
+    return BLOCK_ERR_OK;
+}
+
+ /**
+ * @brief Issues the IDENTIFY DEVICE command and parses key information using polling.
+ * Includes fix for parsing logical sector size from words 117-118.
+ */
+static int ata_identify(block_device_t *dev) {
+    KERNEL_ASSERT(dev != NULL, "NULL dev in ata_identify");
+
+    uint16_t identify_data[256];
+    int ret = ata_identify_read(dev, identify_data, false);
+    if (ret != BLOCK_ERR_OK) return ret;
+
+    // 32-bit PIO: only PCI controllers may take dword data port accesses.
+    // Reading IDENTIFY again that way and getting the same words proves it.
+    dev->pio32 = false;
+    if (g_ata_pci_controller) {
+        uint16_t identify_data32[256];
+        if (ata_identify_read(dev, identify_data32, true) == BLOCK_ERR_OK &&
+            memcmp(identify_data, identify_data32, sizeof(identify_data)) == 0) {
+            dev->pio32 = true;
+        }
+    }
 
     // --- Parse data ---
 
@@ -267,6 +434,14 @@ static int ata_identify(block_device_t *dev) {
     // LBA48 Support (Word 83, bit 10)
     dev->lba48_supported = (identify_data[83] & (1 << 10)) != 0;
 
+    // DMA Support (Word 49, bit 8)
+    dev->dma_supported = (identify_data[49] & (1 << 8)) != 0;
+
+    // Write cache enabled (Word 85, bit 5); FUA writes (Word 84 bit 6, LBA48 commands only)
+    dev->write_cache = (identify_data[85] & (1 << 5)) != 0;
+    dev->fua_supported = dev->lba48_supported && (identify_data[84] & (1 << 6)) != 0;
+    dev->flush_pending = false;
+
     // Total Sectors (Words 100-103 for LBA48, Words 60-61 for LBA28)
     // Note: Using direct cast relies on compiler handling potential unaligned access on some archs.
     // Safer approach might be memcpy into a local uint64_t/uint32_t.
@@ -283,11 +458,11 @@ static int ata_identify(block_device_t *dev) {
     dev->multiple_sector_count = 0;
     if (identify_data[88] & 0x0001) { // Check if "multiple sector setting is valid" bit is set
         uint16_t mult_count = identify_data[47] & 0x00FF; // Count is in low byte of Word 47
-        if (mult_count > 0 && mult_count <= 16) { // Standard allows up to 16
+        if (mult_count > 0 && mult_count <= ATA_MAX_MULTIPLE) {
             dev->multiple_sector_count = mult_count;
             terminal_printf("[ATA IDENTIFY %s] Supports MULTIPLE mode (Preferred Count=%u)\n", dev->device_name, dev->multiple_sector_count);
         } else if (mult_count > 0) {
-             terminal_printf("[ATA IDENTIFY %s] Supports MULTIPLE mode but count %u > 16, ignoring.\n", dev->device_name, mult_count);
+             terminal_printf("[ATA IDENTIFY %s] Supports MULTIPLE mode but count %u > %u, ignoring.\n", dev->device_name, mult_count, ATA_MAX_MULTIPLE);
         }
     }
 
@@ -299,7 +474,7 @@ static int ata_identify(block_device_t *dev) {
   */
  static int ata_set_multiple_mode(block_device_t *dev) {
       KERNEL_ASSERT(dev != NULL, "NULL dev in ata_set_multiple_mode");
-      if (dev->multiple_sector_count == 0 || dev->multiple_sector_count > 16) return BLOCK_ERR_OK;
+      if (dev->multiple_sector_count == 0 || dev->multiple_sector_count > ATA_MAX_MULTIPLE) return BLOCK_ERR_OK;
       int ret = ata_select_drive(dev);
       if (ret != BLOCK_ERR_OK) return ret;
       outb(dev->io_base + ATA_REG_SECCOUNT0, dev->multiple_sector_count);
@@ -318,15 +493,16 @@ static int ata_identify(block_device_t *dev) {
  }
 
  /**
-  * @brief Sets up the LBA address and sector count registers for a PIO command.
+  * @brief Sets up the LBA address and sector count registers for a command;
+  * lba48 selects the EXT register layout (the caller picked an EXT command).
   */
- static void ata_setup_lba(block_device_t *dev, uint64_t lba, size_t count) {
+ static void ata_setup_lba(block_device_t *dev, uint64_t lba, size_t count, bool lba48) {
      KERNEL_ASSERT(dev != NULL && count > 0, "Invalid params in ata_setup_lba");
      uint8_t dev_select_base = (dev->is_slave ? ATA_DEV_SLAVE : ATA_DEV_MASTER) | ATA_DEV_LBA;
-     bool needs_lba48 = dev->lba48_supported && (lba + count -1 >= 0x10000000ULL || count > 256);
-     if (needs_lba48) {
-         KERNEL_ASSERT(count <= 65536, "LBA48 count exceeds 65536");
-         uint16_t sc = (count == 65536) ? 0 : (uint16_t)count;
+     if (lba48) {
+         KERNEL_ASSERT(dev->lba48_supported, "LBA48 command on an LBA28 device");
+         KERNEL_ASSERT(count <= ATA_MAX_SECTORS_LBA48, "LBA48 count exceeds 65536");
+         uint16_t sc = (count == ATA_MAX_SECTORS_LBA48) ? 0 : (uint16_t)count;
          outb(dev->io_base + ATA_REG_HDDEVSEL, dev_select_base);
          outb(dev->io_base + ATA_REG_SECCOUNT1, (uint8_t)(sc >> 8));
          outb(dev->io_base + ATA_REG_LBA3, (uint8_t)(lba >> 24));
@@ -338,8 +514,8 @@ static int ata_identify(block_device_t *dev) {
          outb(dev->io_base + ATA_REG_LBA2, (uint8_t)(lba >> 16));
      } else {
          KERNEL_ASSERT(lba + count <= 0x10000000ULL, "LBA28 address/count exceeds limit");
-         KERNEL_ASSERT(count <= 256, "LBA28 count exceeds 256");
-         uint8_t sc = (count == 256) ? 0 : (uint8_t)count;
+         KERNEL_ASSERT(count <= ATA_MAX_SECTORS_LBA28, "LBA28 count exceeds 256");
+         uint8_t sc = (count == ATA_MAX_SECTORS_LBA28) ? 0 : (uint8_t)count;
          uint8_t dev_select = dev_select_base | ((uint8_t)((lba >> 24) & 0x0F));
          outb(dev->io_base + ATA_REG_HDDEVSEL, dev_select);
          outb(dev->io_base + ATA_REG_SECCOUNT0, sc);
@@ -378,11 +554,14 @@ static int ata_identify(block_device_t *dev) {
           }
           // <<<--- End Moved Check --->>>
 
-          uint16_t *buf_words = (uint16_t *)((uint8_t *)buffer + sector * dev->sector_size);
-          if (write) {
-              for (size_t i = 0; i < words_per_sector; i++) outw(data_port, buf_words[i]);
+          // One string instruction per sector
+          uint8_t *sector_buf = (uint8_t *)buffer + sector * dev->sector_size;
+          if (dev->pio32) {
+              if (write) ata_pio_write32(data_port, sector_buf, words_per_sector / 2);
+              else ata_pio_read32(data_port, sector_buf, words_per_sector / 2);
           } else {
-              for (size_t i = 0; i < words_per_sector; i++) buf_words[i] = inw(data_port);
+              if (write) ata_pio_write16(data_port, sector_buf, words_per_sector);
+              else ata_pio_read16(data_port, sector_buf, words_per_sector);
           }
           // After transferring a sector (especially for MULTIPLE mode), a delay or status check might be needed
           // before the next IRQ/DRQ signal for the *next* sector in the block. The current hybrid wait handles the
@@ -391,16 +570,176 @@ static int ata_identify(block_device_t *dev) {
       return BLOCK_ERR_OK;
  }
 
+ // --- Bus-Master DMA ---
+
+ /**
+  * @brief Finds the PCI IDE function and sets up DMA for each legacy-mode
+  * channel: bus mastering on, one PRD entry and a 64 KiB bounce buffer.
+  * Channels without it (or without memory for it) stay on PIO.
+  */
+ static void ata_dma_init(void) {
+     pci_device_t ide;
+     if (!pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, 0, &ide)) {
+         terminal_write("[ATA DMA] No PCI IDE controller found; using PIO.\n");
+         return;
+     }
+     g_ata_pci_controller = !(ide.prog_if & 0x05); // Both channels on the legacy ports
+     uint32_t bar4 = pci_read_bar(&ide, 4);
+     if (!(ide.prog_if & 0x80) || !(bar4 & PCI_BAR_IO) || (bar4 & 0xFFFC) == 0) {
+         terminal_printf("[ATA DMA] IDE controller %04x:%04x is not bus-master capable; using PIO.\n",
+                         ide.vendor_id, ide.device_id);
+         return;
+     }
+     pci_enable(&ide, PCI_COMMAND_IO | PCI_COMMAND_BUS_MASTER);
+     uint16_t bm_base = (uint16_t)(bar4 & 0xFFFC);
+
+     for (int i = 0; i < 2; i++) {
+         ata_channel_t *ch = &g_ata_channels[i];
+         // The driver only knows the legacy ports; a native-mode channel lives elsewhere
+         if (ide.prog_if & (1u << (i * 2))) continue;
+
+         uint8_t *buf = buddy_alloc_raw(ATA_DMA_BUF_ORDER);
+         ata_prd_t *prdt = buddy_alloc_raw(MIN_ORDER); // Never crosses 64 KiB, as the spec requires
+         if (!buf || !prdt || !paging_virt_is_direct(buf) || !paging_virt_is_direct(prdt)) {
+             if (buf) buddy_free_raw(buf, ATA_DMA_BUF_ORDER);
+             if (prdt) buddy_free_raw(prdt, MIN_ORDER);
+             terminal_printf("[ATA DMA] Channel %d: no DMA-able memory; using PIO.\n", i);
+             continue;
+         }
+         ch->dma_buf = buf;
+         ch->dma_buf_phys = (uint32_t)((uintptr_t)buf - KERNEL_SPACE_VIRT_START);
+         ch->prdt = prdt;
+         ch->prdt_phys = (uint32_t)((uintptr_t)prdt - KERNEL_SPACE_VIRT_START);
+         ch->bm_base = (uint16_t)(bm_base + i * 8);
+         outb(ch->bm_base + ATA_BM_REG_COMMAND, 0);
+         terminal_printf("[ATA DMA] Channel %d: bus-master registers at %#x.\n", i, ch->bm_base);
+     }
+ }
+
+ /**
+  * @brief Moves count sectors by bus-master DMA, up to 64 KiB per command.
+  * Completion is the drive's INTRQ: sleeping callers are woken by the IRQ
+  * handler, the rest poll the latch in the bus-master status register.
+  * *moved reports how many sectors made it before any error. FUA writes use
+  * WRITE DMA FUA EXT, so the caller must have checked dev->fua_supported.
+  */
+ static int ata_dma_transfer(block_device_t *dev, ata_channel_t *ch, uint64_t lba, uint8_t *buffer,
+                             size_t count, bool write, bool fua, bool can_sleep, size_t *moved) {
+     size_t max_sectors = ATA_DMA_BUF_SIZE / dev->sector_size;
+     uint8_t dir = write ? 0 : ATA_BM_CMD_READ;
+     *moved = 0;
+
+     while (*moved < count) {
+         size_t n = count - *moved;
+         if (n > max_sectors) n = max_sectors;
+         uint64_t current_lba = lba + *moved;
+         size_t bytes = n * dev->sector_size;
+         uint8_t *current_buffer = buffer + *moved * dev->sector_size;
+
+         bool use_lba48 = dev->lba48_supported && (fua || current_lba + n - 1 >= 0x10000000ULL);
+         if (!use_lba48 && current_lba + n > 0x10000000ULL) return BLOCK_ERR_BOUNDS;
+         uint8_t command = write ? (fua ? ATA_CMD_WRITE_DMA_FUA_EXT : use_lba48 ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_WRITE_DMA)
+                                 : (use_lba48 ? ATA_CMD_READ_DMA_EXT : ATA_CMD_READ_DMA);
+
+         if (write) memcpy(ch->dma_buf, current_buffer, bytes);
+         ch->prdt->phys_addr = ch->dma_buf_phys;
+         ch->prdt->byte_count = (uint16_t)(bytes & 0xFFFF); // 64 KiB encodes as 0
+         ch->prdt->flags = ATA_PRD_EOT;
+
+         // Engine stopped with the direction set, table loaded, stale IRQ/error cleared
+         outb(ch->bm_base + ATA_BM_REG_COMMAND, dir);
+         outl(ch->bm_base + ATA_BM_REG_PRDT, ch->prdt_phys);
+         outb(ch->bm_base + ATA_BM_REG_STATUS,
+              inb(ch->bm_base + ATA_BM_REG_STATUS) | ATA_BM_SR_IRQ | ATA_BM_SR_ERR);
+
+         int ret = ata_select_drive(dev);
+         if (ret != BLOCK_ERR_OK) return ret;
+         ata_setup_lba(dev, current_lba, n, use_lba48);
+         ch->irq_fired = false;
+         outb(dev->io_base + ATA_REG_COMMAND, command);
+         outb(ch->bm_base + ATA_BM_REG_COMMAND, dir | ATA_BM_CMD_START);
+
+         uint8_t bm_status = 0;
+         bool done = false;
+         if (can_sleep) {
+             bool timed_out;
+             wait_event_timeout(&ch->irq_wq, ch->irq_fired, ATA_IRQ_TIMEOUT_MS, timed_out);
+             bm_status = inb(ch->bm_base + ATA_BM_REG_STATUS);
+             done = !timed_out || (bm_status & (ATA_BM_SR_IRQ | ATA_BM_SR_ERR));
+         } else {
+             uint32_t wait_loops = ATA_TIMEOUT_PIO * ATA_IRQ_WAIT_MULTIPLIER;
+             while (wait_loops--) {
+                 bm_status = inb(ch->bm_base + ATA_BM_REG_STATUS);
+                 if (ch->irq_fired || (bm_status & (ATA_BM_SR_IRQ | ATA_BM_SR_ERR))) { done = true; break; }
+                 asm volatile ("pause");
+             }
+         }
+         if (ch->irq_fired) bm_status |= ch->last_bm_status; // The handler already cleared the latch
+
+         // The engine must be stopped even on success; reading status acknowledges INTRQ
+         outb(ch->bm_base + ATA_BM_REG_COMMAND, dir);
+         uint8_t status = inb(dev->io_base + ATA_REG_STATUS);
+         outb(ch->bm_base + ATA_BM_REG_STATUS,
+              inb(ch->bm_base + ATA_BM_REG_STATUS) | ATA_BM_SR_IRQ | ATA_BM_SR_ERR);
+
+         if (!done) {
+             terminal_printf("[ATA %s DMA %s] Timeout (Cmd %#x, LBA %llu, BM Status=%#x, Status=%#x)\n",
+                             dev->device_name, write ? "Write" : "Read", command, current_lba, bm_status, status);
+             return BLOCK_ERR_TIMEOUT;
+         }
+         if (status & ATA_SR_BSY) {
+             int poll_result = ata_poll_status(dev->io_base, ATA_SR_BSY, 0x00, ATA_TIMEOUT_PIO, "DmaDoneBSY");
+             if (poll_result < 0) return BLOCK_ERR_TIMEOUT;
+             status = (uint8_t)poll_result;
+         }
+         if ((bm_status & ATA_BM_SR_ERR) || (status & (ATA_SR_ERR | ATA_SR_DF))) {
+             uint8_t error = (status & ATA_SR_ERR) ? inb(dev->io_base + ATA_REG_ERROR) : 0;
+             terminal_printf("[ATA %s DMA %s] Error (Cmd %#x, LBA %llu, BM Status=%#x, Status=%#x, Error=%#x)\n",
+                             dev->device_name, write ? "Write" : "Read", command, current_lba, bm_status, status, error);
+             if (status & ATA_SR_ERR) return BLOCK_ERR_DEV_ERR;
+             if (status & ATA_SR_DF) return BLOCK_ERR_DEV_FAULT;
+             return BLOCK_ERR_IO;
+         }
+
+         if (!write) memcpy(current_buffer, ch->dma_buf, bytes);
+         *moved += n;
+     }
+     return BLOCK_ERR_OK;
+ }
+
 
  // --- Public API ---
 
+ // Initialized devices in init order, for block_device_get_stats()
+ static block_device_t *g_block_devices[BLOCK_MAX_DEVICES];
+ static uint32_t g_block_device_count = 0;
+ static spinlock_t g_block_devices_lock;
+ 
+ static void block_device_register(block_device_t *dev) {
+     uintptr_t irq_flags = spinlock_acquire_irqsave(&g_block_devices_lock);
+     bool known = false;
+     for (uint32_t i = 0; i < g_block_device_count; i++) {
+         if (g_block_devices[i] == dev) known = true;
+     }
+     if (!known && g_block_device_count < BLOCK_MAX_DEVICES) g_block_devices[g_block_device_count++] = dev;
+     spinlock_release_irqrestore(&g_block_devices_lock, irq_flags);
+ }
+ 
  /**
-  * @brief Initializes the ATA channel locks. Call once during kernel init.
+  * @brief Initializes the ATA channels (locks, DMA engines). Call once during
+  * kernel init, before the first block_device_init().
   */
  void ata_channels_init(void) {
-     spinlock_init(&g_ata_primary_lock);
-     spinlock_init(&g_ata_secondary_lock);
+     for (int i = 0; i < 2; i++) {
+         spinlock_init(&g_ata_channels[i].lock);
+         kmutex_init(&g_ata_channels[i].io_mutex, true);
+         wait_queue_init(&g_ata_channels[i].irq_wq);
+     }
+     g_ata_channels[0].io_base = ATA_PRIMARY_IO;
+     g_ata_channels[1].io_base = ATA_SECONDARY_IO;
+     spinlock_init_named(&g_block_devices_lock, "block_devices");
      terminal_write("[ATA] Channel locks initialized.\n");
+     ata_dma_init();
  }
 
  /**
@@ -410,6 +749,21 @@ static int ata_identify(block_device_t *dev) {
      if (!device || !dev) return BLOCK_ERR_PARAMS;
      memset(dev, 0, sizeof(block_device_t));
      dev->device_name = device;
+     spinlock_init(&dev->stats_lock);
+     strncpy(dev->io_stats.name, device, sizeof(dev->io_stats.name) - 1);
+     if (strncmp(device, "sd", 2) == 0 && device[2] >= 'a' && device[2] <= 'z' && device[3] == '\0') {
+         int ahci_ret = ahci_device_init(device[2] - 'a', dev);
+         if (ahci_ret == BLOCK_ERR_OK) {
+             block_queue_create(dev); // Without one, I/O stays direct
+             block_device_register(dev);
+         }
+         return ahci_ret;
+     }
+     if (strncmp(device, "ram", 3) == 0 && device[3] >= '0' && device[3] <= '9' && device[4] == '\0') {
+         int ram_ret = ramdisk_device_init(device[3] - '0', dev);
+         if (ram_ret == BLOCK_ERR_OK) block_device_register(dev); // Copies are synchronous; no queue
+         return ram_ret;
+     }
      bool primary_channel = true;
      bool is_slave = false;
      if (strcmp(device, "hda") == 0) {}
@@ -420,15 +774,18 @@ static int ata_identify(block_device_t *dev) {
      dev->io_base = primary_channel ? ATA_PRIMARY_IO : ATA_SECONDARY_IO;
      dev->control_base = primary_channel ? ATA_PRIMARY_CTRL : ATA_SECONDARY_CTRL;
      dev->is_slave = is_slave;
-     dev->channel_lock = primary_channel ? &g_ata_primary_lock : &g_ata_secondary_lock;
+     dev->channel_lock = &ata_channel_of(dev)->lock;
      terminal_printf("[BlockDev Init] Probing '%s' (IO:%#x, Ctrl:%#x, Slave:%d)...\n", device, dev->io_base, dev->control_base, dev->is_slave);
 
-     uintptr_t irq_flags = spinlock_acquire_irqsave(dev->channel_lock);
+     // IDENTIFY polls, so the channel is taken the non-sleeping way
+     uintptr_t irq_flags;
+     int ret = ata_channel_acquire(ata_channel_of(dev), false, &irq_flags);
+     if (ret != BLOCK_ERR_OK) return ret;
 
      // --- Debug Print BEFORE ata_identify ---
      terminal_printf("[BlockDev Debug] KBC Status before ata_identify: 0x%x\n", inb(KBC_STATUS_PORT));
      // --- End Debug Print ---
-     int ret = ata_identify(dev);
+     ret = ata_identify(dev);
      // --- Debug Print AFTER ata_identify ---
      terminal_printf("[BlockDev Debug] KBC Status after ata_identify: 0x%x\n", inb(KBC_STATUS_PORT));
      // --- End Debug Print ---
@@ -448,132 +805,176 @@ static int ata_identify(block_device_t *dev) {
           }
      }
      dev->initialized = (ret == BLOCK_ERR_OK);
-     spinlock_release_irqrestore(dev->channel_lock, irq_flags);
+     if (dev->initialized && dev->dma_supported && ata_channel_of(dev)->bm_base) {
+         uint16_t bm_status_port = ata_channel_of(dev)->bm_base + ATA_BM_REG_STATUS;
+         outb(bm_status_port, inb(bm_status_port) | (is_slave ? ATA_BM_SR_DRV1_DMA : ATA_BM_SR_DRV0_DMA));
+         dev->use_dma = true;
+     }
+     ata_channel_release(ata_channel_of(dev), false, irq_flags);
      if (!dev->initialized) { terminal_printf("[BlockDev Init] Failed for '%s' during IDENTIFY (err %d).\n", device, ret); return ret; }
      // <<< FIX: Use %llu for uint64_t, %u for uint16_t, %lu for uint32_t >>>
      terminal_printf("[BlockDev Init] OK: '%s' LBA48:%d Sectors:%llu\n",
         device, dev->lba48_supported, dev->total_sectors);
-terminal_printf("    -> Mult:%u SectorSize:%lu\n", // Use %u for uint16_t, %lu for uint32_t
-        dev->multiple_sector_count, (unsigned long)dev->sector_size);
+terminal_printf("    -> Mult:%u SectorSize:%lu DMA:%d PIO32:%d WCache:%d FUA:%d\n", // Use %u for uint16_t, %lu for uint32_t
+        dev->multiple_sector_count, (unsigned long)dev->sector_size, dev->use_dma, dev->pio32,
+        dev->write_cache, dev->fua_supported);
+     block_queue_create(dev); // Without one, I/O stays direct
+     block_device_register(dev);
      return BLOCK_ERR_OK;
  }
 
 
  /**
-  * @brief Reads or writes sectors to/from a block device using PIO with hybrid IRQ/Polling wait.
+  * @brief Issues FLUSH CACHE (EXT) and waits for it. Caller holds the channel.
+  */
+ static int ata_flush_cache(block_device_t *dev, ata_channel_t *ch, bool can_sleep) {
+     int ret = ata_select_drive(dev);
+     if (ret != BLOCK_ERR_OK) {
+         terminal_printf("[ATA %s Flush] Select drive failed before FlushCache (Err %d).\n", dev->device_name, ret);
+         return ret;
+     }
+
+     dev->flush_pending = false; // Writes completing from here on need another flush
+     uint8_t flush_cmd = dev->lba48_supported ? ATA_CMD_FLUSH_CACHE_EXT : ATA_CMD_FLUSH_CACHE;
+     ch->irq_fired = false; ch->last_status = 0; ch->last_error = 0;
+     outb(dev->io_base + ATA_REG_COMMAND, flush_cmd);
+     ata_delay_400ns(dev->control_base);
+
+     int wait_result = ata_wait_completion(dev, ch, can_sleep, "FlushCache");
+     if (wait_result < 0) {
+         terminal_printf("[ATA %s Flush] FlushCache timeout.\n", dev->device_name);
+         ret = BLOCK_ERR_TIMEOUT;
+     } else {
+         uint8_t final_stat = (uint8_t)wait_result;
+         if ((final_stat & ATA_SR_BSY) || (final_stat & (ATA_SR_ERR | ATA_SR_DF))) {
+             uint8_t final_err = (final_stat & ATA_SR_ERR) ? inb(dev->io_base + ATA_REG_ERROR) : 0;
+             terminal_printf("[ATA %s Flush] FlushCache error/fault/busy (Status=%#x, Error=%#x).\n", dev->device_name, final_stat, final_err);
+             ret = (final_stat & ATA_SR_ERR) ? BLOCK_ERR_DEV_ERR : BLOCK_ERR_DEV_FAULT;
+         }
+     }
+     if (ret != BLOCK_ERR_OK) dev->flush_pending = true;
+     return ret;
+ }
+
+ /**
+  * @brief Reads or writes sectors to/from a block device: bus-master DMA when
+  * the device uses it, PIO for the rest (or after a DMA failure, which also
+  * turns DMA off for the device). Each command's completion is awaited with
+  * ata_wait_completion(), sleeping when the caller can. A FUA write uses the
+  * FUA EXT commands where it can and flushes the cache after the rest; plain
+  * writes leave the flush to block_device_flush().
   */
-  static int block_device_transfer(block_device_t *dev, uint64_t lba, void *buffer, size_t count, bool write) {
+  static int block_device_transfer(block_device_t *dev, uint64_t lba, void *buffer, size_t count, bool write, bool fua) {
      KERNEL_ASSERT(dev && dev->initialized && buffer && count > 0, "Invalid parameters to block_device_transfer");
      KERNEL_ASSERT(dev->sector_size > 0 && (dev->sector_size % 2 == 0), "Invalid sector size");
      KERNEL_ASSERT(lba < dev->total_sectors && count <= dev->total_sectors - lba, "Transfer out of bounds");
+     TRACEPOINT(TP_BLOCK_SUBMIT, lba, count | (write ? TP_BLOCK_WRITE : 0));
 
-     volatile bool* irq_fired_flag;
-     volatile uint8_t* last_status_flag;
-     volatile uint8_t* last_error_flag;
-     bool primary_channel = (dev->io_base == ATA_PRIMARY_IO);
-     if (primary_channel) {
-         irq_fired_flag = &g_ata_primary_irq_fired;
-         last_status_flag = &g_ata_primary_last_status;
-         last_error_flag = &g_ata_primary_last_error;
-     } else {
-         terminal_printf("[ATA %s RW] Error: Secondary channel IRQ handling not implemented.\n", dev->device_name);
-         return BLOCK_ERR_UNSUPPORTED;
-     }
+     ata_channel_t *ch = ata_channel_of(dev);
+     bool can_sleep = ata_caller_may_sleep();
+     const char *rw = write ? "Write" : "Read";
 
-     uintptr_t irq_flags = spinlock_acquire_irqsave(dev->channel_lock);
-     int final_ret = BLOCK_ERR_OK;
+     uintptr_t irq_flags;
+     int final_ret = ata_channel_acquire(ch, can_sleep, &irq_flags);
+     if (final_ret != BLOCK_ERR_OK) return final_ret;
      size_t sectors_remaining = count;
      uint64_t current_lba = lba;
      uint8_t *current_buffer = (uint8_t *)buffer;
+     fua = fua && write;
+     bool needs_flush = false; // Part of a FUA write went out without a FUA command
+     if (write && !fua) dev->flush_pending = true;
+
+     // DMA first; whatever it could not move goes through the PIO loop below
+     if (dev->use_dma && ch->bm_base) {
+         size_t moved = 0;
+         bool dma_fua = fua && dev->fua_supported;
+         needs_flush = fua && !dma_fua;
+         int dma_ret = ata_dma_transfer(dev, ch, lba, current_buffer, count, write, dma_fua, can_sleep, &moved);
+         if (dma_ret != BLOCK_ERR_OK) {
+             terminal_printf("[ATA %s] DMA failed (err %d) after %lu sectors; falling back to PIO.\n",
+                             dev->device_name, dma_ret, (unsigned long)moved);
+             dev->use_dma = false;
+         }
+         sectors_remaining -= moved;
+         current_lba += moved;
+         current_buffer += moved * dev->sector_size;
+     }
 
      while (sectors_remaining > 0) {
-         int current_ret = BLOCK_ERR_OK;
-         bool use_lba48 = dev->lba48_supported && (current_lba + sectors_remaining -1 >= 0x10000000ULL);
-         size_t max_sectors_per_ata_cmd = use_lba48 ? 65536 : 256;
-         bool use_multiple_this_cmd = (dev->multiple_sector_count > 0) && (sectors_remaining >= dev->multiple_sector_count);
-         size_t sectors_this_cmd = use_multiple_this_cmd ? dev->multiple_sector_count : 1;
+         // One command covers as much as the address mode allows; the drive then
+         // moves it in DRQ blocks of multiple_sector_count sectors (1 without
+         // MULTIPLE, the last block may be shorter), one interrupt per block.
+         size_t sectors_this_cmd = dev->lba48_supported ? ATA_MAX_SECTORS_LBA48 : ATA_MAX_SECTORS_LBA28;
          if (sectors_this_cmd > sectors_remaining) sectors_this_cmd = sectors_remaining;
-         if (sectors_this_cmd > max_sectors_per_ata_cmd) sectors_this_cmd = max_sectors_per_ata_cmd;
-         use_multiple_this_cmd = use_multiple_this_cmd && (sectors_this_cmd >= dev->multiple_sector_count);
+         // The only PIO FUA command is WRITE MULTIPLE FUA EXT
+         bool pio_fua = fua && dev->fua_supported && dev->multiple_sector_count > 0;
+         if (fua && !pio_fua) needs_flush = true;
+         bool use_lba48 = dev->lba48_supported && (pio_fua || current_lba + sectors_this_cmd - 1 >= 0x10000000ULL ||
+                                                   sectors_this_cmd > ATA_MAX_SECTORS_LBA28);
+         bool use_multiple_this_cmd = pio_fua || ((dev->multiple_sector_count > 1) && (sectors_this_cmd > 1));
+         size_t block_sectors = use_multiple_this_cmd ? dev->multiple_sector_count : 1;
 
          uint8_t command;
-         if (write) command = use_multiple_this_cmd ? (use_lba48 ? ATA_CMD_WRITE_MULTIPLE_EXT:ATA_CMD_WRITE_MULTIPLE) : (use_lba48 ? ATA_CMD_WRITE_PIO_EXT:ATA_CMD_WRITE_PIO);
+         if (pio_fua) command = ATA_CMD_WRITE_MULTIPLE_FUA_EXT;
+         else if (write) command = use_multiple_this_cmd ? (use_lba48 ? ATA_CMD_WRITE_MULTIPLE_EXT:ATA_CMD_WRITE_MULTIPLE) : (use_lba48 ? ATA_CMD_WRITE_PIO_EXT:ATA_CMD_WRITE_PIO);
          else       command = use_multiple_this_cmd ? (use_lba48 ? ATA_CMD_READ_MULTIPLE_EXT :ATA_CMD_READ_MULTIPLE)  : (use_lba48 ? ATA_CMD_READ_PIO_EXT  :ATA_CMD_READ_PIO);
          if (!use_lba48 && (current_lba + sectors_this_cmd > 0x10000000ULL)) { final_ret = BLOCK_ERR_BOUNDS; break; }
 
-         current_ret = ata_select_drive(dev);
+         int current_ret = ata_select_drive(dev);
          if (current_ret != BLOCK_ERR_OK) { final_ret = current_ret; break; }
 
-         ata_setup_lba(dev, current_lba, sectors_this_cmd);
-         *irq_fired_flag = false;
-         *last_status_flag = 0;
-         *last_error_flag = 0;
+         ata_setup_lba(dev, current_lba, sectors_this_cmd, use_lba48);
+         ch->irq_fired = false;
+         ch->last_status = 0;
+         ch->last_error = 0;
 
          outb(dev->io_base + ATA_REG_COMMAND, command);
          ata_delay_400ns(dev->control_base);
 
-         // --- Hybrid Wait for IRQ or BSY Clear ---
-         uint32_t wait_loops = ATA_TIMEOUT_PIO * ATA_IRQ_WAIT_MULTIPLIER;
-         bool timed_out = true;
-         // <<< FIX: Remove unused variable >>>
-         // bool command_done_polling = false;
-         uint8_t polled_status = 0;
-
-         while(wait_loops--) {
-             if (*irq_fired_flag) { // Check IRQ flag first
-                 timed_out = false;
+         // A read interrupts as each block is ready; a write asks for its first
+         // block through DRQ alone, then interrupts after each one it has taken.
+         int wait_result = write ? ata_poll_status(dev->io_base, ATA_SR_BSY, 0x00, ATA_TIMEOUT_PIO, "WriteDRQ")
+                                 : ata_wait_completion(dev, ch, can_sleep, "RW Read");
+         size_t sectors_done = 0;
+         for (;;) {
+             if (wait_result < 0) {
+                 terminal_printf("[ATA %s RW %s] Timeout waiting for the drive (Cmd %#x, LBA %llu, Status=%#x)\n",
+                                 dev->device_name, rw, command, current_lba + sectors_done,
+                                 inb(dev->io_base + ATA_REG_STATUS));
+                 current_ret = BLOCK_ERR_TIMEOUT;
                  break;
              }
-             // If no IRQ, poll status register (non-blocking read)
-             polled_status = inb(dev->io_base + ATA_REG_STATUS);
-             if (!(polled_status & ATA_SR_BSY)) { // Check if BSY is clear
-                 // BSY clear means command finished or errored
-                 // <<< FIX: Remove assignment to unused variable >>>
-                 // command_done_polling = true;
-                 timed_out = false; // Consider it not a timeout if BSY cleared
+
+             uint8_t final_status = (uint8_t)wait_result;
+             if (final_status & (ATA_SR_ERR | ATA_SR_DF)) {
+                 uint8_t final_error = (final_status & ATA_SR_ERR) ? inb(dev->io_base + ATA_REG_ERROR) : 0;
+                 terminal_printf("[ATA %s RW %s] Error/Fault detected (Cmd %#x, LBA %llu, Status=%#x, Error=%#x)\n",
+                                 dev->device_name, rw, command, current_lba + sectors_done, final_status, final_error);
+                 current_ret = (final_status & ATA_SR_ERR) ? BLOCK_ERR_DEV_ERR : BLOCK_ERR_DEV_FAULT;
                  break;
              }
-             asm volatile ("pause"); // Yield CPU slice slightly
-         }
-         // Final check for IRQ flag after loop
-         if (!timed_out) { /* Already done */ }
-         else if (*irq_fired_flag) {
-             terminal_printf("[ATA %s RW %s] IRQ detected *after* wait loop finished (Cmd %#x, LBA %llu).\n",
-                             dev->device_name, write ? "Write" : "Read", command, current_lba);
-             timed_out = false; // Treat as success
-         }
-
-         if (timed_out) {
-             terminal_printf("[ATA %s RW %s] Timeout waiting for IRQ/BSY Clear (Cmd %#x, LBA %llu)\n",
-                             dev->device_name, write ? "Write" : "Read", command, current_lba);
-             final_ret = BLOCK_ERR_TIMEOUT;
-             *last_status_flag = inb(dev->io_base + ATA_REG_STATUS); // Read status on timeout
-              terminal_printf(" -> Last Status before timeout: %#x\n", *last_status_flag);
-             break; // Exit outer transfer loop
-         }
-
-         // --- Command Completed (via IRQ or BSY Poll) - Check Final Status ---
-         uint8_t final_status = *irq_fired_flag ? *last_status_flag : polled_status;
-         uint8_t final_error = *irq_fired_flag ? *last_error_flag : ((final_status & ATA_SR_ERR) ? inb(dev->io_base + ATA_REG_ERROR) : 0);
-
-         if (final_status & (ATA_SR_ERR | ATA_SR_DF)) {
-             terminal_printf("[ATA %s RW %s] Error/Fault detected (Cmd %#x, LBA %llu, Status=%#x, Error=%#x)\n",
-                             dev->device_name, write ? "Write" : "Read", command, current_lba, final_status, final_error);
-             final_ret = (final_status & ATA_SR_ERR) ? BLOCK_ERR_DEV_ERR : BLOCK_ERR_DEV_FAULT;
-             break; // Exit outer loop
-         }
+             if (sectors_done == sectors_this_cmd) break; // A write's last interrupt: data is on disk
 
-         // --- Transfer Data ---
-         if (command != ATA_CMD_FLUSH_CACHE && command != ATA_CMD_FLUSH_CACHE_EXT) {
-             // Check DRQ bit - MUST be set for successful R/W completion
+             // DRQ MUST be set before any data moves
              if (!(final_status & ATA_SR_DRQ)) {
                  terminal_printf("[ATA %s RW %s] Command done but DRQ not set! (Cmd %#x, LBA %llu, Status=%#x)\n",
-                                 dev->device_name, write ? "Write" : "Read", command, current_lba, final_status);
-                 final_ret = BLOCK_ERR_IO; break;
+                                 dev->device_name, rw, command, current_lba + sectors_done, final_status);
+                 current_ret = BLOCK_ERR_IO;
+                 break;
              }
-             current_ret = ata_pio_transfer_block(dev, current_buffer, sectors_this_cmd, write);
-             if (current_ret != BLOCK_ERR_OK) { final_ret = current_ret; break; }
+
+             // --- Transfer Data ---
+             size_t n = sectors_this_cmd - sectors_done;
+             if (n > block_sectors) n = block_sectors;
+             ch->irq_fired = false;
+             current_ret = ata_pio_transfer_block(dev, current_buffer + sectors_done * dev->sector_size, n, write);
+             if (current_ret != BLOCK_ERR_OK) break;
+             sectors_done += n;
+
+             if (!write && sectors_done == sectors_this_cmd) break; // No interrupt after a read's last block
+             wait_result = ata_wait_completion(dev, ch, can_sleep, write ? "RW Write" : "RW Read");
          }
+         if (current_ret != BLOCK_ERR_OK) { final_ret = current_ret; break; }
 
          // Advance state
          sectors_remaining -= sectors_this_cmd;
@@ -581,62 +982,171 @@ terminal_printf("    -> Mult:%u SectorSize:%lu\n", // Use %u for uint16_t, %lu f
          current_buffer += sectors_this_cmd * dev->sector_size;
      } // End while(sectors_remaining > 0)
 
-     // --- Final Cache Flush --- (Logic remains similar, uses hybrid wait)
-     if (write && final_ret == BLOCK_ERR_OK) {
-         *irq_fired_flag = false; *last_status_flag = 0; *last_error_flag = 0;
-         int sel_ret = ata_select_drive(dev);
-         if (sel_ret == BLOCK_ERR_OK) {
-             uint8_t flush_cmd = dev->lba48_supported ? ATA_CMD_FLUSH_CACHE_EXT : ATA_CMD_FLUSH_CACHE;
-             outb(dev->io_base + ATA_REG_COMMAND, flush_cmd);
-             ata_delay_400ns(dev->control_base);
+     // --- Cache flush for the part of a FUA write that plain commands carried ---
+     if (needs_flush && dev->write_cache && final_ret == BLOCK_ERR_OK) final_ret = ata_flush_cache(dev, ch, can_sleep);
 
-             uint32_t wait_loops = ATA_TIMEOUT_PIO * ATA_IRQ_WAIT_MULTIPLIER;
-             bool timed_out = true;
-             // <<< FIX: Remove unused variable >>>
-             // bool cmd_done_poll = false;
-             uint8_t poll_stat = 0;
-             while(wait_loops--) {
-                 if (*irq_fired_flag) { timed_out = false; break; }
-                 poll_stat = inb(dev->io_base + ATA_REG_STATUS);
-                 if (!(poll_stat & ATA_SR_BSY)) { /*cmd_done_poll = true;*/ timed_out = false; break; } // Removed assignment
-                 asm volatile("pause");
-             }
-             if (!timed_out || *irq_fired_flag) { timed_out = false; } // Final IRQ check
-
-             if (timed_out) {
-                 terminal_printf("[ATA %s RW Write] FlushCache timeout.\n", dev->device_name);
-                 final_ret = BLOCK_ERR_TIMEOUT;
-             } else {
-                 uint8_t final_stat = *irq_fired_flag ? *last_status_flag : poll_stat;
-                 uint8_t final_err = *irq_fired_flag ? *last_error_flag : ((final_stat & ATA_SR_ERR) ? inb(dev->io_base + ATA_REG_ERROR) : 0);
-                 if ((final_stat & ATA_SR_BSY) || (final_stat & (ATA_SR_ERR | ATA_SR_DF))) {
-                     terminal_printf("[ATA %s RW Write] FlushCache error/fault/busy (Status=%#x, Error=%#x).\n", dev->device_name, final_stat, final_err);
-                     final_ret = (final_stat & ATA_SR_ERR) ? BLOCK_ERR_DEV_ERR : BLOCK_ERR_DEV_FAULT;
-                 }
-             }
-         } else {
-             terminal_printf("[ATA %s RW Write] Select drive failed before FlushCache (Err %d).\n", dev->device_name, sel_ret);
-             if (final_ret == BLOCK_ERR_OK) final_ret = sel_ret;
-         }
+     ata_channel_release(ch, can_sleep, irq_flags);
+     TRACEPOINT(TP_BLOCK_COMPLETE, lba, final_ret);
+     return final_ret;
+ }
+
+ // --- I/O statistics ---
+
+ /**
+  * @brief Marks an operation as entering the driver.
+  * @return Its start time (TSC) for block_stats_end().
+  */
+ static uint64_t block_stats_begin(block_device_t *dev) {
+     uintptr_t irq_flags = spinlock_acquire_irqsave(&dev->stats_lock);
+     block_io_stats_t *st = &dev->io_stats;
+     if (++st->in_flight > st->max_in_flight) st->max_in_flight = st->in_flight;
+     spinlock_release_irqrestore(&dev->stats_lock, irq_flags);
+     return read_tsc();
+ }
+
+ /**
+  * @brief Accounts a finished operation of @p kind covering @p count sectors.
+  */
+ static void block_stats_end(block_device_t *dev, int kind, size_t count, uint64_t start, int ret) {
+     uint64_t cycles = read_tsc() - start;
+     uint32_t bucket = tsc_log2(cycles);
+     if (bucket >= BLOCK_STATS_HIST_BUCKETS) bucket = BLOCK_STATS_HIST_BUCKETS - 1;
+
+     uintptr_t irq_flags = spinlock_acquire_irqsave(&dev->stats_lock);
+     block_io_stats_t *st = &dev->io_stats;
+     st->in_flight--;
+     st->ops[kind]++;
+     st->cycles[kind] += cycles;
+     st->latency_hist[kind][bucket]++;
+     if (ret != BLOCK_ERR_OK) st->errors[kind]++;
+     else if (kind != BLOCK_STATS_FLUSH) {
+         st->sectors[kind] += count;
+         st->bytes[kind] += (uint64_t)count * dev->sector_size;
      }
+     spinlock_release_irqrestore(&dev->stats_lock, irq_flags);
+ }
 
-     // Release Lock and Return
-     spinlock_release_irqrestore(dev->channel_lock, irq_flags);
-     return final_ret;
+ static int block_device_rw(block_device_t *dev, uint64_t lba, void *buffer, size_t count, bool write, bool fua) {
+     if (!dev) return BLOCK_ERR_PARAMS;
+     uint64_t start = block_stats_begin(dev);
+     int ret;
+     if (dev->transport == BLOCK_TRANSPORT_AHCI) ret = ahci_transfer(dev, lba, buffer, count, write, fua);
+     else if (dev->transport == BLOCK_TRANSPORT_RAM) ret = ramdisk_transfer(dev, lba, buffer, count, write);
+     else ret = block_device_transfer(dev, lba, buffer, count, write, fua);
+     block_stats_end(dev, write ? BLOCK_STATS_WRITE : BLOCK_STATS_READ, count, start, ret);
+     return ret;
  }
 
  /**
   * @brief Reads sectors from the block device. Public wrapper.
   */
  int block_device_read(block_device_t *dev, uint64_t lba, void *buffer, size_t count) {
-     return block_device_transfer(dev, lba, buffer, count, false);
+     return block_device_rw(dev, lba, buffer, count, false, false);
  }
 
  /**
   * @brief Writes sectors to the block device. Public wrapper.
   */
  int block_device_write(block_device_t *dev, uint64_t lba, const void *buffer, size_t count) {
-     return block_device_transfer(dev, lba, (void *)buffer, count, true);
+     return block_device_rw(dev, lba, (void *)buffer, count, true, false);
+ }
+
+ /**
+  * @brief Writes sectors through to the medium (FUA). Public wrapper.
+  */
+ int block_device_write_fua(block_device_t *dev, uint64_t lba, const void *buffer, size_t count) {
+     return block_device_rw(dev, lba, (void *)buffer, count, true, true);
+ }
+
+ /**
+  * @brief Flushes the device's write cache if anything was written since the
+  * last flush. Only flushes actually sent to the drive are counted.
+  */
+ int block_device_flush(block_device_t *dev) {
+     if (!dev || !dev->initialized) return BLOCK_ERR_PARAMS;
+     if (!dev->write_cache || !dev->flush_pending) return BLOCK_ERR_OK;
+
+     uint64_t start = block_stats_begin(dev);
+     int ret;
+     if (dev->transport == BLOCK_TRANSPORT_AHCI) {
+         ret = ahci_flush(dev);
+     } else {
+         ata_channel_t *ch = ata_channel_of(dev);
+         bool can_sleep = ata_caller_may_sleep();
+         uintptr_t irq_flags;
+         ret = ata_channel_acquire(ch, can_sleep, &irq_flags);
+         if (ret == BLOCK_ERR_OK) {
+             ret = ata_flush_cache(dev, ch, can_sleep);
+             ata_channel_release(ch, can_sleep, irq_flags);
+         }
+     }
+     block_stats_end(dev, BLOCK_STATS_FLUSH, 0, start, ret);
+     return ret;
+ }
+
+ int block_device_get_stats(uint32_t index, block_io_stats_t *out) {
+     if (!out) return BLOCK_ERR_PARAMS;
+     uintptr_t list_flags = spinlock_acquire_irqsave(&g_block_devices_lock);
+     block_device_t *dev = (index < g_block_device_count) ? g_block_devices[index] : NULL;
+     spinlock_release_irqrestore(&g_block_devices_lock, list_flags);
+     if (!dev) return BLOCK_ERR_NO_DEV;
+
+     uintptr_t irq_flags = spinlock_acquire_irqsave(&dev->stats_lock);
+     *out = dev->io_stats;
+     spinlock_release_irqrestore(&dev->stats_lock, irq_flags);
+     if (dev->queue) {
+         block_queue_stats_t qs;
+         block_queue_get_stats(dev, &qs);
+         out->queued = qs.queued;
+     }
+     return BLOCK_ERR_OK;
+ }
+
+ static void block_dump_histogram(const char *name, const uint32_t *hist) {
+     serial_printf("    %s (log2 cycles: count):", name);
+     for (uint32_t b = 0; b < BLOCK_STATS_HIST_BUCKETS; b++) {
+         if (hist[b]) serial_printf(" %lu:%lu", (unsigned long)b, (unsigned long)hist[b]);
+     }
+     serial_printf("\n");
+ }
+
+ void block_device_dump_stats(void) {
+     static const char *const kind_names[BLOCK_STATS_KINDS] = { "Read", "Write", "Flush" };
+     serial_printf("--- Block device statistics ---\n");
+     block_io_stats_t st;
+     for (uint32_t i = 0; block_device_get_stats(i, &st) == BLOCK_ERR_OK; i++) {
+         // Byte and cycle totals are printed in units of 1024 to stay within %lu.
+         serial_printf("  %s: in_flight=%lu max_in_flight=%lu queued=%lu read=%luK written=%luK bytes\n",
+                       st.name, (unsigned long)st.in_flight, (unsigned long)st.max_in_flight,
+                       (unsigned long)st.queued, (unsigned long)(st.bytes[BLOCK_STATS_READ] >> 10),
+                       (unsigned long)(st.bytes[BLOCK_STATS_WRITE] >> 10));
+         for (int k = 0; k < BLOCK_STATS_KINDS; k++) {
+             if (!st.ops[k]) continue;
+             serial_printf("    %s: ops=%lu errors=%lu total=%luK avg=%luK cycles\n", kind_names[k],
+                           (unsigned long)st.ops[k], (unsigned long)st.errors[k],
+                           (unsigned long)(st.cycles[k] >> 10),
+                           (unsigned long)(st.cycles[k] >> 10) / st.ops[k]);
+             block_dump_histogram(kind_names[k], st.latency_hist[k]);
+         }
+     }
+ }
+
+ /**
+  * @brief Records a channel's completion: status (which acknowledges the
+  * drive), error, and the bus-master IRQ latch; then wakes the submitter.
+  */
+ static void ata_channel_irq(ata_channel_t *ch) {
+     if (ch->bm_base) {
+         uint8_t bm_status = inb(ch->bm_base + ATA_BM_REG_STATUS);
+         ch->last_bm_status = bm_status;
+         if (bm_status & ATA_BM_SR_IRQ) outb(ch->bm_base + ATA_BM_REG_STATUS, bm_status);
+     }
+     uint8_t status = inb(ch->io_base + ATA_REG_STATUS);
+     uint8_t error = (status & ATA_SR_ERR) ? inb(ch->io_base + ATA_REG_ERROR) : 0;
+     ch->last_status = status;
+     ch->last_error = error;
+     ch->irq_fired = true;
+     wake_up_all(&ch->irq_wq);
  }
 
  /**
@@ -644,10 +1154,16 @@ terminal_printf("    -> Mult:%u SectorSize:%lu\n", // Use %u for uint16_t, %lu f
   */
   void ata_primary_irq_handler(isr_frame_t* frame) {
       (void)frame; // Frame not used currently
-      uint8_t status = inb(ATA_PRIMARY_IO + ATA_REG_STATUS);
-      uint8_t error = (status & ATA_SR_ERR) ? inb(ATA_PRIMARY_IO + ATA_REG_ERROR) : 0;
-      g_ata_primary_last_status = status;
-      g_ata_primary_last_error = error;
-      g_ata_primary_irq_fired = true;
+      ata_channel_irq(&g_ata_channels[0]);
       // serial_write('!'); // Minimal debug signal
+      irq_send_eoi(14);
+  }
+
+ /**
+  * @brief Secondary ATA IRQ Handler (IRQ 15 -> Vector 47).
+  */
+  void ata_secondary_irq_handler(isr_frame_t* frame) {
+      (void)frame;
+      ata_channel_irq(&g_ata_channels[1]);
+      irq_send_eoi(15);
   }
\ No newline at end of file
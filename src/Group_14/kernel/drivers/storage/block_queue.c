@@ -0,0 +1,451 @@
+/**
+ * @file block_queue.c
+ * @brief Per-device block request queue: merging plus a deadline elevator,
+ *        dispatched by the kblockd kernel thread.
+ *
+ * A queued "transfer" is the request that opened it (its head) plus the
+ * requests merged into it, chained through merge_next in submission order.
+ * Only heads are linked on the sorted and FIFO lists. A request is merged
+ * only into a transfer it alone overlaps, so the seq of a transfer (that of
+ * its oldest request) orders it correctly against every transfer it
+ * overlaps, and the elevator never dispatches a transfer while an older
+ * overlapping one is still queued.
+ */
+
+#include <kernel/drivers/storage/block_queue.h>
+#include <kernel/drivers/display/terminal.h>
+#include <kernel/memory/kmalloc.h>
+#include <kernel/process/scheduler.h>
+#include <kernel/lib/string.h>
+#include <kernel/lib/assert.h>
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+// kblockd: one thread drains every queue put on the run list
+static tcb_t *s_kblockd_task = NULL;
+static wait_queue_t s_kblockd_wq;
+static spinlock_t s_run_lock;
+static block_queue_t *s_run_head = NULL;
+static block_queue_t *s_run_tail = NULL;
+
+static void block_queue_run(block_queue_t *q);
+
+//============================================================================
+// Helpers
+//============================================================================
+
+static inline int block_dir(const block_request_t *req) {
+    return req->write ? 1 : 0;
+}
+
+static inline uint64_t unit_end(const block_request_t *unit) {
+    return unit->unit_lba + unit->unit_count;
+}
+
+static inline bool spans_overlap(uint64_t a_lba, size_t a_count, uint64_t b_lba, size_t b_count) {
+    return a_lba < b_lba + b_count && b_lba < a_lba + a_count;
+}
+
+static int block_queue_transfer(block_device_t *dev, uint64_t lba, void *buffer, size_t count, bool write, bool fua) {
+    if (!write) return block_device_read(dev, lba, buffer, count);
+    return fua ? block_device_write_fua(dev, lba, buffer, count)
+               : block_device_write(dev, lba, buffer, count);
+}
+
+/**
+ * True if the caller can leave its requests to kblockd and sleep: the
+ * thread exists, the scheduler runs, interrupts are on, not the idle task.
+ */
+static bool block_queue_can_defer(void) {
+    if (!s_kblockd_task || !g_scheduler_ready) return false;
+    uint32_t eflags;
+    asm volatile("pushf; pop %0" : "=r"(eflags));
+    tcb_t *current = get_current_task();
+    return (eflags & 0x200) && current && current->pid != IDLE_TASK_PID;
+}
+
+//============================================================================
+// Queue lists (q->lock held)
+//============================================================================
+
+static void sorted_insert_locked(block_queue_t *q, block_request_t *unit) {
+    block_request_t *prev = NULL;
+    block_request_t *next = q->sorted;
+    while (next && next->unit_lba <= unit->unit_lba) {
+        prev = next;
+        next = next->sort_next;
+    }
+    unit->sort_prev = prev;
+    unit->sort_next = next;
+    if (prev) prev->sort_next = unit;
+    else q->sorted = unit;
+    if (next) next->sort_prev = unit;
+}
+
+static void sorted_unlink_locked(block_queue_t *q, block_request_t *unit) {
+    if (unit->sort_prev) unit->sort_prev->sort_next = unit->sort_next;
+    else q->sorted = unit->sort_next;
+    if (unit->sort_next) unit->sort_next->sort_prev = unit->sort_prev;
+    unit->sort_prev = unit->sort_next = NULL;
+}
+
+static void fifo_append_locked(block_queue_t *q, block_request_t *unit) {
+    int dir = block_dir(unit);
+    unit->fifo_next = NULL;
+    unit->fifo_prev = q->fifo_tail[dir];
+    if (q->fifo_tail[dir]) q->fifo_tail[dir]->fifo_next = unit;
+    else q->fifo_head[dir] = unit;
+    q->fifo_tail[dir] = unit;
+}
+
+static void fifo_unlink_locked(block_queue_t *q, block_request_t *unit) {
+    int dir = block_dir(unit);
+    if (unit->fifo_prev) unit->fifo_prev->fifo_next = unit->fifo_next;
+    else q->fifo_head[dir] = unit->fifo_next;
+    if (unit->fifo_next) unit->fifo_next->fifo_prev = unit->fifo_prev;
+    else q->fifo_tail[dir] = unit->fifo_prev;
+    unit->fifo_prev = unit->fifo_next = NULL;
+}
+
+/**
+ * Folds @p req into the one queued transfer it touches, if that transfer
+ * goes the same way (FUA or not), the result stays within @p max_sectors, and req
+ * overlaps no other transfer.
+ */
+static bool block_queue_try_merge_locked(block_queue_t *q, block_request_t *req, size_t max_sectors) {
+    uint64_t end = req->lba + req->count;
+    block_request_t *overlap = NULL;
+    block_request_t *adjacent = NULL;
+
+    for (block_request_t *u = q->sorted; u && u->unit_lba <= end; u = u->sort_next) {
+        if (spans_overlap(u->unit_lba, u->unit_count, req->lba, req->count)) {
+            if (overlap) return false; // Spans several transfers
+            overlap = u;
+        } else if (!adjacent && u->write == req->write && u->fua == req->fua &&
+                   (unit_end(u) == req->lba || u->unit_lba == end)) {
+            adjacent = u;
+        }
+    }
+
+    block_request_t *target = overlap ? overlap : adjacent;
+    if (!target || target->write != req->write || target->fua != req->fua) return false;
+    uint64_t lo = MIN(target->unit_lba, req->lba);
+    uint64_t hi = MAX(unit_end(target), end);
+    if (hi - lo > max_sectors) return false;
+
+    block_request_t *tail = target;
+    while (tail->merge_next) tail = tail->merge_next;
+    tail->merge_next = req;
+    target->unit_count = (size_t)(hi - lo);
+    if (lo != target->unit_lba) {
+        target->unit_lba = lo;
+        sorted_unlink_locked(q, target);
+        sorted_insert_locked(q, target);
+    }
+    q->stats.merged++;
+    return true;
+}
+
+static void block_queue_insert_locked(block_queue_t *q, block_request_t *req) {
+    uint32_t expire_ms = req->write ? BLOCK_QUEUE_WRITE_EXPIRE_MS : BLOCK_QUEUE_READ_EXPIRE_MS;
+    req->unit_lba = req->lba;
+    req->unit_count = req->count;
+    req->seq = q->next_seq++;
+    req->deadline = scheduler_get_ticks() + scheduler_ms_to_ticks(expire_ms);
+    sorted_insert_locked(q, req);
+    fifo_append_locked(q, req);
+}
+
+static void block_queue_remove_locked(block_queue_t *q, block_request_t *unit) {
+    sorted_unlink_locked(q, unit);
+    fifo_unlink_locked(q, unit);
+    for (block_request_t *r = unit; r; r = r->merge_next) q->stats.queued--;
+}
+
+//============================================================================
+// Elevator (q->lock held)
+//============================================================================
+
+// True if no older queued transfer overlaps @p unit
+static bool block_queue_eligible_locked(block_queue_t *q, const block_request_t *unit) {
+    for (block_request_t *u = q->sorted; u && u->unit_lba < unit_end(unit); u = u->sort_next) {
+        if (u != unit && (int32_t)(u->seq - unit->seq) < 0 &&
+            spans_overlap(u->unit_lba, u->unit_count, unit->unit_lba, unit->unit_count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Oldest queued transfer, which nothing can be waiting in front of
+static block_request_t *block_queue_oldest_locked(block_queue_t *q) {
+    block_request_t *r = q->fifo_head[0];
+    block_request_t *w = q->fifo_head[1];
+    if (!r) return w;
+    if (!w) return r;
+    return (int32_t)(r->seq - w->seq) < 0 ? r : w;
+}
+
+/**
+ * Next transfer to dispatch: an expired read, then an expired write, then
+ * the first eligible transfer at or past the head position (wrapping once).
+ */
+static block_request_t *block_queue_pick_locked(block_queue_t *q) {
+    if (!q->sorted) return NULL;
+
+    uint32_t now = scheduler_get_ticks();
+    bool expired_blocked = false;
+    for (int dir = 0; dir < 2; dir++) {
+        block_request_t *oldest = q->fifo_head[dir];
+        if (!oldest || (int32_t)(now - oldest->deadline) < 0) continue;
+        if (block_queue_eligible_locked(q, oldest)) {
+            q->stats.expired++;
+            return oldest;
+        }
+        expired_blocked = true;
+    }
+    // An expired transfer waits on an older overlapping one: clear the way
+    if (expired_blocked) return block_queue_oldest_locked(q);
+
+    for (block_request_t *u = q->sorted; u; u = u->sort_next) {
+        if (u->unit_lba >= q->head_pos && block_queue_eligible_locked(q, u)) return u;
+    }
+    for (block_request_t *u = q->sorted; u && u->unit_lba < q->head_pos; u = u->sort_next) {
+        if (block_queue_eligible_locked(q, u)) return u;
+    }
+    return block_queue_oldest_locked(q);
+}
+
+//============================================================================
+// Dispatch
+//============================================================================
+
+/**
+ * Runs one transfer and completes its requests. A merged transfer goes
+ * through a bounce buffer; if that fails (or no memory), its requests are
+ * retried one by one so a bad sector only fails the requests covering it.
+ */
+static void block_queue_execute(block_queue_t *q, block_request_t *unit) {
+    block_device_t *dev = q->dev;
+    uint32_t sector_size = dev->sector_size;
+
+    if (!unit->merge_next) {
+        unit->status = block_queue_transfer(dev, unit->lba, unit->buffer, unit->count, unit->write, unit->fua);
+    } else {
+        uint8_t *bounce = kmalloc(unit->unit_count * sector_size);
+        int status = BLOCK_ERR_INTERNAL;
+        if (bounce) {
+            if (unit->write) {
+                // Submission order: where writes overlap, the later data wins
+                for (block_request_t *r = unit; r; r = r->merge_next) {
+                    memcpy(bounce + (size_t)(r->lba - unit->unit_lba) * sector_size, r->buffer, r->count * sector_size);
+                }
+            }
+            status = block_queue_transfer(dev, unit->unit_lba, bounce, unit->unit_count, unit->write, unit->fua);
+            if (status == BLOCK_ERR_OK && !unit->write) {
+                for (block_request_t *r = unit; r; r = r->merge_next) {
+                    memcpy(r->buffer, bounce + (size_t)(r->lba - unit->unit_lba) * sector_size, r->count * sector_size);
+                }
+            }
+            kfree(bounce);
+        }
+        for (block_request_t *r = unit; r; r = r->merge_next) {
+            r->status = (status == BLOCK_ERR_OK) ? status
+                       : block_queue_transfer(dev, r->lba, r->buffer, r->count, r->write, r->fua);
+        }
+    }
+
+    block_request_t *r = unit;
+    while (r) {
+        block_request_t *next = r->merge_next; // r may be gone once done() returns
+        r->done(r, r->status);
+        r = next;
+    }
+}
+
+/**
+ * Dispatches until the queue is empty. Only one context runs a queue at a
+ * time; anyone else finds it dispatching and leaves the work to it.
+ */
+static void block_queue_run(block_queue_t *q) {
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&q->lock);
+    if (q->dispatching) {
+        spinlock_release_irqrestore(&q->lock, irq_flags);
+        return;
+    }
+    q->dispatching = true;
+
+    block_request_t *unit;
+    while ((unit = block_queue_pick_locked(q)) != NULL) {
+        block_queue_remove_locked(q, unit);
+        q->head_pos = unit_end(unit);
+        q->stats.dispatched++;
+        spinlock_release_irqrestore(&q->lock, irq_flags);
+
+        block_queue_execute(q, unit);
+
+        irq_flags = spinlock_acquire_irqsave(&q->lock);
+    }
+    q->dispatching = false;
+    spinlock_release_irqrestore(&q->lock, irq_flags);
+}
+
+static void kblockd_kick(block_queue_t *q) {
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_run_lock);
+    if (!q->on_run_list) {
+        q->on_run_list = true;
+        q->run_next = NULL;
+        if (s_run_tail) s_run_tail->run_next = q;
+        else s_run_head = q;
+        s_run_tail = q;
+    }
+    spinlock_release_irqrestore(&s_run_lock, irq_flags);
+    wake_up_one(&s_kblockd_wq);
+}
+
+static __attribute__((noreturn)) void kblockd_loop(void *arg) {
+    (void)arg;
+    for (;;) {
+        wait_event(&s_kblockd_wq, s_run_head != NULL);
+
+        uintptr_t irq_flags = spinlock_acquire_irqsave(&s_run_lock);
+        block_queue_t *q = s_run_head;
+        if (q) {
+            s_run_head = q->run_next;
+            if (!s_run_head) s_run_tail = NULL;
+            q->run_next = NULL;
+            q->on_run_list = false;
+        }
+        spinlock_release_irqrestore(&s_run_lock, irq_flags);
+
+        if (q) block_queue_run(q);
+    }
+}
+
+//============================================================================
+// Public API
+//============================================================================
+
+int block_queue_create(block_device_t *dev) {
+    KERNEL_ASSERT(dev != NULL && dev->initialized, "block_queue_create: device not initialized");
+    if (dev->queue) return BLOCK_ERR_OK;
+
+    if (!s_kblockd_task) {
+        spinlock_init(&s_run_lock);
+        wait_queue_init(&s_kblockd_wq);
+        // Runs once the scheduler starts; until then submitters dispatch inline
+        s_kblockd_task = kthread_create(kblockd_loop, NULL, SCHED_DEFAULT_PRIORITY);
+        if (!s_kblockd_task) terminal_write("[BlockQueue] Warning: No kblockd thread; requests run in the submitter.\n");
+    }
+
+    block_queue_t *q = (block_queue_t *)kmalloc(sizeof(block_queue_t));
+    if (!q) {
+        terminal_printf("[BlockQueue] Error: No memory for the '%s' queue; using direct transfers.\n", dev->device_name);
+        return BLOCK_ERR_INTERNAL;
+    }
+    memset(q, 0, sizeof(*q));
+    spinlock_init(&q->lock);
+    wait_queue_init(&q->sync_wq);
+    q->dev = dev;
+    dev->queue = q;
+    return BLOCK_ERR_OK;
+}
+
+int block_queue_submit(block_device_t *dev, block_request_t *req) {
+    if (!dev || !dev->initialized || !req || !req->buffer || req->count == 0 || !req->done) return BLOCK_ERR_PARAMS;
+    if (req->lba >= dev->total_sectors || req->count > dev->total_sectors - req->lba) return BLOCK_ERR_BOUNDS;
+
+    req->status = BLOCK_ERR_OK;
+    req->merge_next = NULL;
+    req->sort_prev = req->sort_next = NULL;
+    req->fifo_prev = req->fifo_next = NULL;
+
+    block_queue_t *q = dev->queue;
+    if (!q) {
+        req->status = block_queue_transfer(dev, req->lba, req->buffer, req->count, req->write, req->fua);
+        req->done(req, req->status);
+        return BLOCK_ERR_OK;
+    }
+
+    size_t max_sectors = BLOCK_QUEUE_MAX_BYTES / dev->sector_size;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&q->lock);
+    q->stats.submitted++;
+    q->stats.queued++;
+    if (!block_queue_try_merge_locked(q, req, max_sectors)) {
+        block_queue_insert_locked(q, req);
+    }
+    spinlock_release_irqrestore(&q->lock, irq_flags);
+
+    if (block_queue_can_defer()) kblockd_kick(q);
+    else block_queue_run(q);
+    return BLOCK_ERR_OK;
+}
+
+// Completion state of a synchronous request, on the waiter's stack
+typedef struct {
+    block_queue_t *q;
+    int            status;
+    volatile bool  done;
+} block_sync_t;
+
+static void block_sync_done(block_request_t *req, int status) {
+    block_sync_t *sync = (block_sync_t *)req->ctx;
+    block_queue_t *q = sync->q;
+    sync->status = status;
+    sync->done = true; // The waiter may return (and drop req/sync) from here on
+    wake_up_all(&q->sync_wq);
+}
+
+static int block_queue_rw_sync(block_device_t *dev, uint64_t lba, void *buffer, size_t count, bool write, bool fua) {
+    block_queue_t *q = dev ? dev->queue : NULL;
+    // kblockd would wait on itself: its callbacks go straight to the device.
+    // So does a caller that can't sleep: the context dispatching the queue
+    // may be asleep in the driver, waiting for an IRQ this CPU can't take.
+    if (!q || !block_queue_can_defer() || get_current_task() == s_kblockd_task) {
+        return block_queue_transfer(dev, lba, buffer, count, write, fua);
+    }
+
+    block_sync_t sync = { q, BLOCK_ERR_OK, false };
+    block_request_t req;
+    memset(&req, 0, sizeof(req));
+    req.lba = lba;
+    req.count = count;
+    req.buffer = buffer;
+    req.write = write;
+    req.fua = fua;
+    req.done = block_sync_done;
+    req.ctx = &sync;
+
+    int ret = block_queue_submit(dev, &req);
+    if (ret != BLOCK_ERR_OK) return ret;
+
+    wait_event(&q->sync_wq, sync.done);
+    return sync.status;
+}
+
+int block_queue_read(block_device_t *dev, uint64_t lba, void *buffer, size_t count) {
+    return block_queue_rw_sync(dev, lba, buffer, count, false, false);
+}
+
+int block_queue_write(block_device_t *dev, uint64_t lba, const void *buffer, size_t count) {
+    return block_queue_rw_sync(dev, lba, (void *)buffer, count, true, false);
+}
+
+int block_queue_write_fua(block_device_t *dev, uint64_t lba, const void *buffer, size_t count) {
+    return block_queue_rw_sync(dev, lba, (void *)buffer, count, true, true);
+}
+
+void block_queue_get_stats(block_device_t *dev, block_queue_stats_t *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    block_queue_t *q = dev ? dev->queue : NULL;
+    if (!q) return;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&q->lock);
+    *out = q->stats;
+    spinlock_release_irqrestore(&q->lock, irq_flags);
+}
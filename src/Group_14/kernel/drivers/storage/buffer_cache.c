@@ -8,41 +8,157 @@
 
  #include <kernel/drivers/storage/buffer_cache.h>
  #include <kernel/memory/kmalloc.h>
+ #include <kernel/memory/slab.h>
+ #include <kernel/memory/buddy.h>
  #include <kernel/drivers/display/terminal.h>
  #include <kernel/drivers/storage/disk.h>
  #include <kernel/fs/vfs/fs_errno.h>
  #include <kernel/sync/spinlock.h>
+ #include <kernel/sync/wait_queue.h>
+ #include <kernel/cpu/percpu_counter.h>
+ #include <kernel/sync/preempt.h>       // cond_resched() between write-backs
+ #include <kernel/process/scheduler.h>
+ #include <kernel/drivers/timer/pit.h>
+ #include <kernel/core/tracepoint.h>
  #include <kernel/lib/string.h>
  #include <kernel/core/types.h>
  
  // Configuration
- #define BUFFER_CACHE_HASH_SIZE     256     // Power of 2 recommended for hash distribution
+ #define BUFFER_HASH_MIN_SIZE       512     // Initial bucket count (power of 2)
+ #define BUFFER_HASH_MAX_SIZE       16384   // Bucket count stops doubling here
  #define DEFAULT_BUFFER_BLOCK_SIZE  512     // Standard sector size
  #define MAX_BUFFER_BLOCK_SIZE      8192    // Maximum allowed buffer size
  #define MIN_BUFFER_BLOCK_SIZE      128     // Minimum allowed buffer size
- #define BUFFER_PADDING             16      // Safety padding for buffers
  #define MAX_SECTORS_PER_IO         128     // Maximum sectors in a single I/O operation
- 
- // Cache statistics (optional)
+ #ifndef BUFFER_CACHE_BUDGET_KB
+ #define BUFFER_CACHE_BUDGET_KB     1024    // Memory for cached data, fixed at init
+ #endif
+ #define BUFFER_POOL_FRAME_ORDER    12      // Pool frames are buddy pages
+ #define BUFFER_POOL_FRAME_SIZE     (1u << BUFFER_POOL_FRAME_ORDER) // Largest slot; caps block size
+ #define BUFFER_POOL_SMALL_SHARE    8       // 1 in 8 frames is split into sector slots
+ #define BUFFER_RA_BOUNCE_ORDER     16      // Read-ahead transfers land in one 64 KiB buffer
+ #define BUFFER_RA_BOUNCE_SIZE      (1u << BUFFER_RA_BOUNCE_ORDER)
+ #define BUFFER_RA_MIN_WINDOW       16      // Sectors prefetched once a stream looks sequential
+ #define BUFFER_DIRTY_EXPIRE_MS     1000    // The flusher writes buffers dirty for this long
+ #define BUFFER_FLUSH_INTERVAL_MS   100     // Flusher wakeup period while dirty buffers exist
+ #define BUFFER_FLUSH_BATCH         32      // Buffers per LBA-sorted write-back batch
+ #define BUFFER_SYNC_MAX_DISKS      8       // Disks a write-back pass flushes at its end
+ #define BUFFER_DIRTY_BACKGROUND_PCT 10     // Above this share of the pool, write back regardless of age
+ #define BUFFER_DIRTY_THROTTLE_PCT  40      // Above this share, writers wait for a flusher pass
+ #define BUFFER_MS_TO_TICKS(ms)     (((ms) * TARGET_FREQUENCY) / 1000)
+ #define BUFFER_2Q_IN_SHARE         4       // 2Q: the first-use FIFO keeps 1/4 of the pool
+ #define BUFFER_2Q_GHOST_SHARE      2       // 2Q: remember 1 key per 2 pool buffers
+ #ifdef BUFFER_CACHE_POLICY_LRU
+ #define BUFFER_CACHE_DEFAULT_POLICY BUFFER_POLICY_LRU
+ #else
+ #define BUFFER_CACHE_DEFAULT_POLICY BUFFER_POLICY_2Q
+ #endif
+ 
+ // Cache statistics. Per-CPU counters: several are bumped outside cache_lock,
+ // and none of them should bounce a cache line on every lookup.
  static struct {
-     uint32_t hits;          // Cache hits
-     uint32_t misses;        // Cache misses
-     uint32_t reads;         // Disk reads performed
-     uint32_t writes;        // Disk writes performed
-     uint32_t evictions;     // Number of buffers evicted
-     uint32_t alloc_failures;// Memory allocation failures
-     uint32_t io_errors;     // I/O errors encountered
+     percpu_counter_t hits;          // Cache hits
+     percpu_counter_t misses;        // Cache misses
+     percpu_counter_t reads;         // Disk reads performed
+     percpu_counter_t writes;        // Disk writes performed
+     percpu_counter_t evictions;     // Number of buffers evicted
+     percpu_counter_t alloc_failures;// Memory allocation failures
+     percpu_counter_t io_errors;     // I/O errors encountered
+     percpu_counter_t readahead_blocks; // Blocks brought in by read-ahead
+     percpu_counter_t hits_in;       // Hits per replacement list
+     percpu_counter_t hits_hot;
+     percpu_counter_t misses_in;     // Demand misses per list the block was admitted to
+     percpu_counter_t misses_hot;
+     percpu_counter_t coalesced;     // Misses that joined a read in flight
  } cache_stats;
  
  // Lock for the entire buffer cache
  static spinlock_t cache_lock;
- 
- // Hash table of buffer pointers
- static buffer_t *buffer_hash_table[BUFFER_CACHE_HASH_SIZE];
- 
- // LRU list for buffer replacement
- static buffer_t *lru_head = NULL;  // Most recently used
- static buffer_t *lru_tail = NULL;  // Least recently used
+
+ // Sector views only; cached buffers come from the pool below
+ static slab_cache_t *buffer_slab = NULL;
+
+ // Buffer pool: every header is bound to one data slot for life. Small slots
+ // hold a DEFAULT_BUFFER_BLOCK_SIZE sector, frame slots anything up to a page.
+ // A miss pops a free slot of its class or recycles the LRU one; nothing on
+ // the miss path allocates.
+ enum { POOL_SMALL, POOL_FRAME, POOL_CLASSES };
+ static struct {
+     buffer_t *headers;                 // All slot headers (one array)
+     uint32_t slots;                    // Headers in use by the pool
+     buffer_t *free_list[POOL_CLASSES]; // Unused slots, chained via hash_next
+     uint32_t free_count[POOL_CLASSES];
+ } buffer_pool;
+ static void buffer_pool_init(void); // Defined with the recycling code below
+
+ // Write-back flusher thread. Sync requests and throttled writers wait on it
+ // by sequence number, so a wakeup can never be lost between check and sleep.
+ static tcb_t *s_flusher_task = NULL;
+ static wait_queue_t s_flusher_wq;       // The flusher waits here for dirty buffers
+ static wait_queue_t s_sync_wq;          // buffer_cache_sync() callers
+ static wait_queue_t s_throttle_wq;      // Writers over the dirty limit
+ static volatile uint32_t s_sync_seq = 0;   // Full write-backs requested
+ static volatile uint32_t s_sync_done = 0;  // Requests covered by a finished full pass
+ static volatile uint32_t s_flush_passes = 0;
+ static volatile uint32_t dirty_count = 0;  // Dirty buffers in the cache
+ static volatile uint32_t s_evict_writes = 0; // Evicted dirty blocks being written in place (s_io_wq)
+ static void buffer_flusher_loop(void *arg) __attribute__((noreturn)); // With the sync code
+ 
+ // Reads in flight: the block sits in the hash LOCKED, so concurrent misses
+ // find it and wait (s_io_wq) or queue a buffer_waiter_t instead of reading again
+ typedef struct buffer_waiter {
+     struct buffer_waiter *next;
+     buffer_get_cb_t cb;
+     void *ctx;
+     uint32_t lba;            // Sector asked for (a view is handed out inside blocks)
+ } buffer_waiter_t;
+ typedef struct {
+     block_request_t req;
+     buffer_t *buf;
+     int attempts;
+ } buffer_read_t;
+ #define BUFFER_READ_ATTEMPTS 3
+ static wait_queue_t s_io_wq;
+ enum { BUFFER_CLAIM_FAILED = -1, BUFFER_CLAIM_READY, BUFFER_CLAIM_READ, BUFFER_CLAIM_IN_FLIGHT };
+ 
+ // Read-ahead bounce buffer; one prefetch runs at a time, others just skip
+ static uint8_t *ra_bounce = NULL;
+ static volatile uint32_t ra_busy = 0;
+ 
+ // Hash table of buffer pointers, keyed by (disk, block_number). Doubles when
+ // the cache holds more buffers than buckets.
+ static buffer_t *buffer_hash_initial[BUFFER_HASH_MIN_SIZE];
+ static buffer_t **buffer_hash_table = buffer_hash_initial;
+ static uint32_t buffer_hash_size = BUFFER_HASH_MIN_SIZE;
+ static uint32_t cached_count = 0; // Buffers in the hash table (views excluded)
+ 
+ // Replacement lists (head = most recently used). Plain LRU keeps everything
+ // on the hot list. 2Q admits first-use blocks to a FIFO instead and only
+ // promotes a block that misses again soon after falling out of it (its key
+ // is kept in the ghost ring), so a one-pass scan just cycles the FIFO and
+ // leaves hot metadata alone.
+ enum { BUFFER_LIST_NONE, BUFFER_LIST_IN, BUFFER_LIST_HOT, BUFFER_LIST_COUNT };
+ static struct {
+     buffer_t *head;
+     buffer_t *tail;
+     uint32_t count;
+ } lru_lists[BUFFER_LIST_COUNT]; // [BUFFER_LIST_NONE] unused
+ static buffer_cache_policy_t cache_policy = BUFFER_CACHE_DEFAULT_POLICY;
+ static uint32_t lru_in_target = 0; // 2Q: FIFO is drained first above this many buffers
+ 
+ // 2Q ghost ring: keys of blocks recently pushed out of the FIFO, chained
+ // per bucket by index; the oldest key is overwritten first
+ typedef struct {
+     disk_t *disk;            // NULL = unused
+     uint32_t block_number;
+     int32_t next;            // Next entry in the bucket, -1 = end
+ } buffer_ghost_t;
+ static struct {
+     buffer_ghost_t *entries;
+     int32_t *buckets;        // Chain heads, -1 = empty
+     uint32_t size;           // Ring entries (= buckets, power of 2)
+     uint32_t next;           // Ring slot overwritten next
+ } ghost;
  
  // Device registry - simple implementation
  #define MAX_REGISTERED_DISKS 8
@@ -53,30 +169,22 @@
  } disk_registry;
  
  /**
-  * Compute a high-quality hash for buffer lookup
+  * Hash (disk, block_number) into the current table: golden-ratio multiply of
+  * the block, the disk address folded in, then the murmur3 finalizer.
   */
- static uint32_t buffer_hash(const char *device_name, uint32_t block_number) {
-     if (!device_name) return block_number % BUFFER_CACHE_HASH_SIZE;
- 
-     // FNV-1a hash algorithm
-     uint32_t hash = 2166136261u; // FNV offset basis
- 
-     // Hash the device name
-     for (const char *p = device_name; *p; p++) {
-         hash ^= (uint8_t)(*p);
-         hash *= 16777619u; // FNV prime
-     }
- 
-     // Mix in the block number
-     hash ^= (block_number & 0xFF);
-     hash *= 16777619u;
-     hash ^= ((block_number >> 8) & 0xFF);
-     hash *= 16777619u;
-     hash ^= ((block_number >> 16) & 0xFF);
-     hash *= 16777619u;
-     hash ^= ((block_number >> 24) & 0xFF);
+ static inline uint32_t buffer_hash_mix(const disk_t *disk, uint32_t block_number) {
+     uint32_t h = block_number * 0x9E3779B1u;
+     h ^= (uint32_t)(uintptr_t)disk >> 4;
+     h ^= h >> 16;
+     h *= 0x85EBCA6Bu;
+     h ^= h >> 13;
+     h *= 0xC2B2AE35u;
+     h ^= h >> 16;
+     return h;
+ }
  
-     return hash % BUFFER_CACHE_HASH_SIZE;
+ static inline uint32_t buffer_hash(const disk_t *disk, uint32_t block_number) {
+     return buffer_hash_mix(disk, block_number) & (buffer_hash_size - 1);
  }
  
  /**
@@ -87,9 +195,9 @@
          return -FS_ERR_INVALID_PARAM;
      }
  
-     // Validate sector size
+     // Validate sector size (a sector must fit a pool frame)
      if (disk->blk_dev.sector_size < MIN_BUFFER_BLOCK_SIZE ||
-         disk->blk_dev.sector_size > MAX_BUFFER_BLOCK_SIZE) {
+         disk->blk_dev.sector_size > BUFFER_POOL_FRAME_SIZE) {
          terminal_printf("[BufferCache] Invalid sector size %u for device '%s'.\n",
                         disk->blk_dev.sector_size, disk->blk_dev.device_name);
          return -FS_ERR_INVALID_PARAM;
@@ -114,6 +222,8 @@
      }
  
      // Add to registry
+     disk->cache_block_base = 0;
+     disk->cache_block_sectors = 1;
      disk_registry.disks[disk_registry.count++] = disk;
  
      spinlock_release_irqrestore(&disk_registry.lock, irq_state);
@@ -124,7 +234,7 @@
  /**
   * Lookup a disk by device name
   */
- static disk_t *get_disk_by_name(const char *device_name) {
+ disk_t *buffer_find_disk(const char *device_name) {
      if (!device_name) return NULL;
  
      uintptr_t irq_state = spinlock_acquire_irqsave(&disk_registry.lock);
@@ -141,22 +251,60 @@
      return found_disk;
  }
  
+ /**
+  * Find the cache block containing lba under the disk's block geometry
+  */
+ static uint32_t block_extent(const disk_t *disk, uint32_t lba, uint32_t *nr_sectors) {
+     uint32_t start = lba, sectors = 1;
+     uint32_t base = disk->cache_block_base;
+     uint32_t per_block = disk->cache_block_sectors;
+     if (per_block > 1 && lba >= base) {
+         // per_block is a power of two (buffer_set_block_geometry)
+         start = base + ((lba - base) & ~(per_block - 1));
+         sectors = per_block;
+     }
+ 
+     // The last block of the disk may be short
+     if ((uint64_t)start + sectors > disk->blk_dev.total_sectors &&
+         start < disk->blk_dev.total_sectors) {
+         sectors = (uint32_t)(disk->blk_dev.total_sectors - start);
+     }
+     *nr_sectors = sectors;
+     return start;
+ }
+ 
  /**
   * Initialize the buffer cache system
   */
  void buffer_cache_init(void) {
      // Initialize locks
-     spinlock_init(&cache_lock);
+     spinlock_init_named(&cache_lock, "buffer_cache");
      spinlock_init(&disk_registry.lock);
  
      // Initialize hash table
-     memset(buffer_hash_table, 0, sizeof(buffer_hash_table));
+     memset(buffer_hash_initial, 0, sizeof(buffer_hash_initial));
  
      // Initialize disk registry
      disk_registry.count = 0;
  
      // Clear statistics
      memset(&cache_stats, 0, sizeof(cache_stats));
+
+     if (!buffer_slab) buffer_slab = slab_create("buffer_t", sizeof(buffer_t), 0, 0, NULL, NULL);
+     if (!buffer_slab) terminal_write("[BufferCache] Error: Failed to create buffer_t cache.\n");
+
+     if (!buffer_pool.headers) buffer_pool_init();
+     if (!ra_bounce) ra_bounce = buddy_alloc_raw(BUFFER_RA_BOUNCE_ORDER); // NULL just disables read-ahead
+ 
+     if (!s_flusher_task) {
+         wait_queue_init(&s_flusher_wq);
+         wait_queue_init(&s_sync_wq);
+         wait_queue_init(&s_throttle_wq);
+         wait_queue_init(&s_io_wq);
+         // Runs once the scheduler starts; until then buffer_cache_sync() works inline
+         s_flusher_task = kthread_create(buffer_flusher_loop, NULL, SCHED_DEFAULT_PRIORITY);
+         if (!s_flusher_task) terminal_write("[BufferCache] Warning: No flusher thread; write-back stays synchronous.\n");
+     }
  
      terminal_write("[BufferCache] Initialized buffer cache system.\n");
  }
@@ -165,16 +313,11 @@
   * Lookup a buffer in the cache (internal helper)
   * Assumes cache_lock is already held
   */
- static buffer_t *buffer_lookup_internal(const char *device_name, uint32_t block_number) {
-     if (!device_name) return NULL;
- 
-     uint32_t index = buffer_hash(device_name, block_number);
-     buffer_t *buf = buffer_hash_table[index];
+ static buffer_t *buffer_lookup_internal(const disk_t *disk, uint32_t block_number) {
+     buffer_t *buf = buffer_hash_table[buffer_hash(disk, block_number)];
  
      while (buf) {
-         if (buf->block_number == block_number &&
-             buf->disk &&
-             strcmp(buf->disk->blk_dev.device_name, device_name) == 0) {
+         if (buf->block_number == block_number && buf->disk == disk) {
              return buf;
          }
          buf = buf->hash_next;
@@ -184,47 +327,182 @@
  }
  
  /**
-  * LRU list management: move buffer to front of LRU list
+  * Unlink a ghost entry from its bucket chain
   * Assumes cache_lock is already held
   */
- static void lru_make_most_recent(buffer_t *buf) {
-     if (!buf || buf == lru_head) return;
+ static void ghost_unlink(int32_t idx) {
+     buffer_ghost_t *g = &ghost.entries[idx];
+     int32_t *pp = &ghost.buckets[buffer_hash_mix(g->disk, g->block_number) & (ghost.size - 1)];
+     while (*pp != -1 && *pp != idx) pp = &ghost.entries[*pp].next;
+     if (*pp == idx) *pp = g->next;
+     g->disk = NULL;
+ }
  
-     // Remove from current position
-     if (buf->lru_prev) buf->lru_prev->lru_next = buf->lru_next;
-     if (buf->lru_next) buf->lru_next->lru_prev = buf->lru_prev;
-     if (buf == lru_tail) lru_tail = buf->lru_prev;
+ /**
+  * Remember the key of a block leaving the 2Q FIFO
+  * Assumes cache_lock is already held
+  */
+ static void ghost_remember(const buffer_t *buf) {
+     int32_t idx = (int32_t)ghost.next;
+     ghost.next = (ghost.next + 1) & (ghost.size - 1);
+     buffer_ghost_t *g = &ghost.entries[idx];
+     if (g->disk) ghost_unlink(idx);
+ 
+     g->disk = buf->disk;
+     g->block_number = buf->block_number;
+     int32_t *head = &ghost.buckets[buffer_hash_mix(g->disk, g->block_number) & (ghost.size - 1)];
+     g->next = *head;
+     *head = idx;
+ }
  
-     // Add to head
-     buf->lru_prev = NULL;
-     buf->lru_next = lru_head;
-     if (lru_head) lru_head->lru_prev = buf;
-     lru_head = buf;
+ /**
+  * Forget a remembered key; true if it was there (the block is re-referenced)
+  * Assumes cache_lock is already held
+  */
+ static bool ghost_take(const disk_t *disk, uint32_t block_number) {
+     int32_t idx = ghost.buckets[buffer_hash_mix(disk, block_number) & (ghost.size - 1)];
+     while (idx != -1) {
+         buffer_ghost_t *g = &ghost.entries[idx];
+         if (g->disk == disk && g->block_number == block_number) {
+             ghost_unlink(idx);
+             return true;
+         }
+         idx = g->next;
+     }
+     return false;
+ }
  
-     // If list was empty, set tail
-     if (!lru_tail) lru_tail = buf;
+ /**
+  * Link a buffer at the head of a replacement list
+  * Assumes cache_lock is already held
+  */
+ static void lru_link_head(buffer_t *buf, uint32_t list) {
+     buf->lru_list = list;
+     buf->lru_prev = NULL;
+     buf->lru_next = lru_lists[list].head;
+     if (lru_lists[list].head) lru_lists[list].head->lru_prev = buf;
+     lru_lists[list].head = buf;
+     if (!lru_lists[list].tail) lru_lists[list].tail = buf;
+     lru_lists[list].count++;
  }
  
  /**
-  * Remove a buffer from the LRU list
+  * Remove a buffer from its replacement list
   * Assumes cache_lock is already held
   */
  static void lru_remove(buffer_t *buf) {
-     if (!buf) return;
+     if (!buf || buf->lru_list == BUFFER_LIST_NONE) return;
+     uint32_t list = buf->lru_list;
  
      if (buf->lru_prev) {
          buf->lru_prev->lru_next = buf->lru_next;
      } else {
-         lru_head = buf->lru_next;
+         lru_lists[list].head = buf->lru_next;
      }
  
      if (buf->lru_next) {
          buf->lru_next->lru_prev = buf->lru_prev;
      } else {
-         lru_tail = buf->lru_prev;
+         lru_lists[list].tail = buf->lru_prev;
      }
  
      buf->lru_prev = buf->lru_next = NULL;
+     buf->lru_list = BUFFER_LIST_NONE;
+     lru_lists[list].count--;
+ }
+ 
+ /**
+  * Note a hit: hot buffers move to the front. 2Q FIFO buffers keep their
+  * place, since repeat touches during one stay count as a single use.
+  * Assumes cache_lock is already held
+  */
+ static void lru_make_most_recent(buffer_t *buf) {
+     if (!buf || buf->lru_list == BUFFER_LIST_NONE) return;
+ 
+     if (buf->lru_list == BUFFER_LIST_IN) {
+         percpu_counter_inc(&cache_stats.hits_in);
+         return;
+     }
+     percpu_counter_inc(&cache_stats.hits_hot);
+     if (buf == lru_lists[BUFFER_LIST_HOT].head) return;
+     lru_remove(buf);
+     lru_link_head(buf, BUFFER_LIST_HOT);
+ }
+ 
+ /**
+  * Put a freshly inserted buffer on the list the policy admits it to.
+  * Prefetched blocks are not references, so they never consume a ghost key.
+  * Assumes cache_lock is already held
+  */
+ static void lru_admit(buffer_t *buf, bool demand) {
+     uint32_t list = BUFFER_LIST_HOT;
+     if (cache_policy == BUFFER_POLICY_2Q &&
+         (!demand || !ghost_take(buf->disk, buf->block_number))) {
+         list = BUFFER_LIST_IN;
+     }
+     if (demand) {
+         if (list == BUFFER_LIST_IN) percpu_counter_inc(&cache_stats.misses_in);
+         else percpu_counter_inc(&cache_stats.misses_hot);
+     }
+     lru_link_head(buf, list);
+ }
+ 
+ /**
+  * Pick and unlink the replacement victim: the least recently used
+  * unreferenced buffer whose slot holds size bytes (and is clean, if asked).
+  * 2Q drains the FIFO while it is over its share, and otherwise the hot list
+  * first; FIFO victims leave their key in the ghost ring.
+  * Assumes cache_lock is already held
+  */
+ static buffer_t *lru_pick_victim(size_t size, bool clean_only) {
+     uint32_t order[2] = { BUFFER_LIST_HOT, BUFFER_LIST_IN };
+     if (lru_lists[BUFFER_LIST_IN].count > lru_in_target) {
+         order[0] = BUFFER_LIST_IN;
+         order[1] = BUFFER_LIST_HOT;
+     }
+ 
+     for (int k = 0; k < 2; k++) {
+         for (buffer_t *buf = lru_lists[order[k]].tail; buf; buf = buf->lru_prev) {
+             if (buf->ref_count != 0 || buf->capacity < size) continue;
+             if (clean_only && (buf->flags & BUFFER_FLAG_DIRTY)) continue;
+             if (order[k] == BUFFER_LIST_IN) ghost_remember(buf);
+             lru_remove(buf);
+             return buf;
+         }
+     }
+     return NULL;
+ }
+ 
+ /**
+  * Double the hash table once it holds more buffers than buckets.
+  * Assumes cache_lock is already held; on allocation failure the old table
+  * just keeps longer chains.
+  */
+ static void buffer_hash_maybe_grow(void) {
+     if (cached_count <= buffer_hash_size || buffer_hash_size >= BUFFER_HASH_MAX_SIZE) return;
+ 
+     uint32_t new_size = buffer_hash_size * 2;
+     buffer_t **new_table = kmalloc(sizeof(buffer_t *) * new_size);
+     if (!new_table) return;
+     memset(new_table, 0, sizeof(buffer_t *) * new_size);
+ 
+     buffer_t **old_table = buffer_hash_table;
+     uint32_t old_size = buffer_hash_size;
+     buffer_hash_table = new_table;
+     buffer_hash_size = new_size;
+ 
+     for (uint32_t i = 0; i < old_size; i++) {
+         buffer_t *buf = old_table[i];
+         while (buf) {
+             buffer_t *next = buf->hash_next;
+             uint32_t index = buffer_hash(buf->disk, buf->block_number);
+             buf->hash_next = new_table[index];
+             new_table[index] = buf;
+             buf = next;
+         }
+     }
+ 
+     if (old_table != buffer_hash_initial) kfree(old_table);
  }
  
  /**
@@ -232,11 +510,13 @@
   * Assumes cache_lock is already held
   */
  static void buffer_insert_internal(buffer_t *buf) {
-     if (!buf || !buf->disk || !buf->disk->blk_dev.device_name) return;
+     if (!buf || !buf->disk) return;
  
-     uint32_t index = buffer_hash(buf->disk->blk_dev.device_name, buf->block_number);
+     uint32_t index = buffer_hash(buf->disk, buf->block_number);
      buf->hash_next = buffer_hash_table[index];
      buffer_hash_table[index] = buf;
+     cached_count++;
+     buffer_hash_maybe_grow();
  }
  
  /**
@@ -244,15 +524,16 @@
   * Assumes cache_lock is already held
   */
  static void buffer_remove_internal(buffer_t *buf) {
-     if (!buf || !buf->disk || !buf->disk->blk_dev.device_name) return;
+     if (!buf || !buf->disk) return;
  
-     uint32_t index = buffer_hash(buf->disk->blk_dev.device_name, buf->block_number);
+     uint32_t index = buffer_hash(buf->disk, buf->block_number);
      buffer_t **pp = &buffer_hash_table[index];
  
      while (*pp) {
          if (*pp == buf) {
              *pp = buf->hash_next;
              buf->hash_next = NULL;
+             cached_count--;
              return;
          }
          pp = &((*pp)->hash_next);
@@ -260,102 +541,175 @@
  }
  
  /**
-  * Evict the LRU buffer (if possible), flush if dirty, remove from cache, and free it.
-  * Returns 0 on success (eviction performed), negative error code if no suitable victim.
-  * Handles its own locking internally (acquire, release).
+  * Take a free pool slot that can hold size bytes, preferring sector slots
+  * for sector-sized buffers so pages stay available for blocks.
+  * Assumes cache_lock is already held
   */
- static int evict_lru_buffer_and_free(void) {
-     uintptr_t irq_flags_cache = spinlock_acquire_irqsave(&cache_lock);
+ static buffer_t *buffer_pool_pop(size_t size) {
+     int cls;
+     if (size <= DEFAULT_BUFFER_BLOCK_SIZE && buffer_pool.free_list[POOL_SMALL]) {
+         cls = POOL_SMALL;
+     } else if (size <= BUFFER_POOL_FRAME_SIZE && buffer_pool.free_list[POOL_FRAME]) {
+         cls = POOL_FRAME;
+     } else {
+         return NULL;
+     }
  
-     buffer_t *victim = lru_tail;
- 
-     while (victim) {
-         if (victim->ref_count == 0) {
-             // Found a candidate
-             bool needs_flush = (victim->flags & BUFFER_FLAG_DIRTY);
-             disk_t* disk_to_write = victim->disk;
-             uint32_t block_to_write = victim->block_number;
-             size_t sector_size = 0;
-             void* data_to_write = NULL; // Temporary buffer
- 
-             if (needs_flush) {
-                 // Validate the disk
-                 if (!disk_to_write || !disk_to_write->initialized) {
-                     terminal_printf("[Evict] Error: Victim disk invalid for block %u.\n",
-                                     block_to_write);
-                     // Try previous victim
-                     victim = victim->lru_prev;
-                     continue;
-                 }
+     buffer_t *buf = buffer_pool.free_list[cls];
+     buffer_pool.free_list[cls] = buf->hash_next;
+     buffer_pool.free_count[cls]--;
+     buf->hash_next = NULL;
+     return buf;
+ }
  
-                 sector_size = disk_to_write->blk_dev.sector_size;
-                 if (sector_size == 0) {
-                     sector_size = DEFAULT_BUFFER_BLOCK_SIZE;
-                 }
+ /**
+  * Return a slot to the pool (buffer already out of the hash and LRU)
+  * Assumes cache_lock is already held
+  */
+ static void buffer_pool_push(buffer_t *buf) {
+     int cls = (buf->capacity == BUFFER_POOL_FRAME_SIZE) ? POOL_FRAME : POOL_SMALL;
+     if (buf->flags & BUFFER_FLAG_DIRTY) dirty_count--; // Dropped unwritten (invalidate)
+     buf->disk = NULL;
+     buf->flags = 0;
+     buf->ref_count = 0;
+     buf->hash_next = buffer_pool.free_list[cls];
+     buffer_pool.free_list[cls] = buf;
+     buffer_pool.free_count[cls]++;
+ }
  
-                 // Allocate a temporary buffer to hold dirty data
-                 data_to_write = kmalloc(sector_size);
-                 if (!data_to_write) {
-                     terminal_printf("[Evict] Error: kmalloc failed for flush buffer.\n");
-                     // Cannot flush this one; try previous
-                     victim = victim->lru_prev;
-                     continue;
-                 }
+ /**
+  * Carve the pool out of the budget: page frames from the buddy allocator,
+  * one in BUFFER_POOL_SMALL_SHARE split into sector slots, plus one header
+  * array. Runs with fewer frames if memory is short.
+  */
+ static void buffer_pool_init(void) {
+     uint32_t frames = (BUFFER_CACHE_BUDGET_KB * 1024u) / BUFFER_POOL_FRAME_SIZE;
+     if (frames < 2) frames = 2;
+     uint32_t small_frames = frames / BUFFER_POOL_SMALL_SHARE;
+     if (small_frames == 0) small_frames = 1;
+     uint32_t per_frame = BUFFER_POOL_FRAME_SIZE / DEFAULT_BUFFER_BLOCK_SIZE;
+     uint32_t max_slots = small_frames * per_frame + (frames - small_frames);
+ 
+     buffer_pool.headers = kmalloc(sizeof(buffer_t) * max_slots);
+     if (!buffer_pool.headers) {
+         terminal_write("[BufferCache] Error: Failed to allocate buffer pool headers.\n");
+         return;
+     }
+     memset(buffer_pool.headers, 0, sizeof(buffer_t) * max_slots);
+ 
+     uint32_t got_frames = 0;
+     for (uint32_t f = 0; f < frames; f++) {
+         uint8_t *frame = buddy_alloc_raw(BUFFER_POOL_FRAME_ORDER);
+         if (!frame) break;
+         got_frames++;
+ 
+         bool split = (f < small_frames);
+         uint32_t count = split ? per_frame : 1;
+         uint32_t capacity = split ? DEFAULT_BUFFER_BLOCK_SIZE : BUFFER_POOL_FRAME_SIZE;
+         for (uint32_t i = 0; i < count; i++) {
+             buffer_t *buf = &buffer_pool.headers[buffer_pool.slots++];
+             buf->data = frame + i * capacity;
+             buf->capacity = capacity;
+             buffer_pool_push(buf);
+         }
+     }
  
-                 memcpy(data_to_write, victim->data, sector_size);
-                 // Mark clean in cache metadata (under lock)
-                 victim->flags &= ~BUFFER_FLAG_DIRTY;
-             }
+     terminal_printf("[BufferCache] Pool: %lu sector + %lu page buffers in %lu KiB.\n",
+                     (unsigned long)buffer_pool.free_count[POOL_SMALL], (unsigned long)buffer_pool.free_count[POOL_FRAME],
+                     (unsigned long)(got_frames * (BUFFER_POOL_FRAME_SIZE / 1024u)));
+ 
+     if (cache_policy != BUFFER_POLICY_2Q) return;
+ 
+     // 2Q sizing follows the pool: FIFO share and ghost ring (rounded up to a power of 2)
+     lru_in_target = buffer_pool.slots / BUFFER_2Q_IN_SHARE;
+     ghost.size = 16;
+     while (ghost.size < buffer_pool.slots / BUFFER_2Q_GHOST_SHARE) ghost.size *= 2;
+     ghost.entries = kmalloc(sizeof(buffer_ghost_t) * ghost.size);
+     ghost.buckets = kmalloc(sizeof(int32_t) * ghost.size);
+     if (!ghost.entries || !ghost.buckets) {
+         if (ghost.entries) kfree(ghost.entries);
+         if (ghost.buckets) kfree(ghost.buckets);
+         ghost.entries = NULL;
+         ghost.buckets = NULL;
+         cache_policy = BUFFER_POLICY_LRU; // Without the ghost ring nothing could be promoted
+         terminal_write("[BufferCache] Warning: No memory for 2Q ghost keys; using LRU.\n");
+         return;
+     }
+     memset(ghost.entries, 0, sizeof(buffer_ghost_t) * ghost.size);
+     memset(ghost.buckets, 0xFF, sizeof(int32_t) * ghost.size); // All -1
+     terminal_printf("[BufferCache] 2Q replacement: FIFO of %lu, %lu ghost keys.\n",
+                     (unsigned long)lru_in_target, (unsigned long)ghost.size);
+ }
  
-             // Remove from LRU and hash while holding lock
-             lru_remove(victim);
-             buffer_remove_internal(victim);
-             cache_stats.evictions++;
+ /**
+  * Take a slot for a prefetch: a free one, else the replacement victim among
+  * clean unreferenced buffers. Never writes back, so read-ahead cannot turn
+  * into write traffic. Assumes cache_lock is already held
+  */
+ static buffer_t *buffer_pool_take_clean(size_t size) {
+     buffer_t *buf = buffer_pool_pop(size);
+     if (buf) return buf;
  
-             // Keep pointer to free outside lock
-             buffer_t *victim_to_free = victim;
+     buf = lru_pick_victim(size, true);
+     if (buf) {
+         buffer_remove_internal(buf);
+         percpu_counter_inc(&cache_stats.evictions);
+     }
+     return buf;
+ }
  
-             // Release lock before doing I/O
-             spinlock_release_irqrestore(&cache_lock, irq_flags_cache);
+ /**
+  * Recycle the replacement victim among unreferenced buffers whose slot can
+  * hold size bytes: write it back if dirty, drop it from the cache and return the
+  * slot to the pool. Returns false if every fitting buffer is referenced.
+  * Handles its own locking internally (acquire, release).
+  */
+ static bool buffer_pool_recycle(size_t size) {
+     uintptr_t irq_flags_cache = spinlock_acquire_irqsave(&cache_lock);
  
-             // Perform Disk I/O if needed
-             if (needs_flush && data_to_write && disk_to_write) {
-                int write_result = disk_write_raw_sectors(disk_to_write, block_to_write,
-                    data_to_write, 1);
-
-                 if (write_result != 0) {
-                     terminal_printf("[Evict] Flush FAILED (Error %d) for block %u.\n",
-                                     write_result, block_to_write);
-                     cache_stats.io_errors++;
-                 } else {
-                     cache_stats.writes++;
-                 }
-             }
+     buffer_t *victim = lru_pick_victim(size, false);
+     if (!victim) {
+         spinlock_release_irqrestore(&cache_lock, irq_flags_cache);
+         return false;
+     }
  
-             if (data_to_write) {
-                 kfree(data_to_write);
-             }
+     bool needs_flush = (victim->flags & BUFFER_FLAG_DIRTY);
+     if (needs_flush) {
+         dirty_count--;
+         s_evict_writes++; // Out of the hash now: buffer_writeback_range() waits on the count instead
+     }
+     victim->flags &= ~BUFFER_FLAG_DIRTY;
+     buffer_remove_internal(victim);
+     percpu_counter_inc(&cache_stats.evictions);
  
-             // Free the victim memory outside the lock
-             kfree(victim_to_free->data);
-             kfree(victim_to_free);
+     // Release lock before doing I/O
+     spinlock_release_irqrestore(&cache_lock, irq_flags_cache);
  
-             return 0; // Success
+     // Unreachable from the cache now, so the slot is written in place
+     if (needs_flush) {
+         int write_result = disk_write_raw_sectors(victim->disk, victim->block_number,
+                                                   victim->data, victim->nr_sectors);
+         if (write_result != 0) {
+             terminal_printf("[Evict] Flush FAILED (Error %d) for block %u.\n",
+                             write_result, victim->block_number);
+             percpu_counter_inc(&cache_stats.io_errors);
+         } else {
+             percpu_counter_inc(&cache_stats.writes);
          }
- 
-         // Move to previous LRU entry
-         victim = victim->lru_prev;
      }
  
-     // No suitable buffer found
+     irq_flags_cache = spinlock_acquire_irqsave(&cache_lock);
+     buffer_pool_push(victim);
+     if (needs_flush) s_evict_writes--;
      spinlock_release_irqrestore(&cache_lock, irq_flags_cache);
-     return -FS_ERR_NO_RESOURCES;
+     if (needs_flush) wake_up_all(&s_io_wq);
+     return true;
  }
  
  /**
   * Perform safe read of disk sectors with retries
   */
- static int safe_disk_read(disk_t *disk, uint32_t start_sector, void *buffer, size_t sector_size) {
+ static int safe_disk_read(disk_t *disk, uint32_t start_sector, void *buffer, size_t sector_count) {
      if (!disk || !buffer) return -FS_ERR_INVALID_PARAM;
  
      // Retry parameters
@@ -364,7 +718,7 @@
      int result = -1;
  
      while (retries < max_retries) {
-        result = disk_read_raw_sectors(disk, start_sector, buffer, 1);
+        result = disk_read_raw_sectors(disk, start_sector, buffer, sector_count);
          if (result == 0) {
              break; // Success
          }
@@ -378,152 +732,654 @@
      if (result != 0) {
          terminal_printf("[BufferCache] Error: Failed to read sector %u from '%s' after %d retries.\n",
                          start_sector, disk->blk_dev.device_name, max_retries);
-         cache_stats.io_errors++;
+         percpu_counter_inc(&cache_stats.io_errors);
      } else {
-         cache_stats.reads++;
+         percpu_counter_inc(&cache_stats.reads);
      }
  
      return result;
  }
  
  /**
-  * Get a buffer (allocate new or return cached)
+  * True if the caller may sleep: the scheduler runs, interrupts are on (so
+  * no spinlock is held; they are all irqsave) and it is not the idle task.
   */
- buffer_t *buffer_get(const char *device_name, uint32_t block_number) {
-     if (!device_name) {
-         terminal_write("[BufferCache] Error: NULL device name in buffer_get().\n");
-         return NULL;
-     }
+ static bool buffer_may_sleep(void) {
+     if (!g_scheduler_ready) return false;
+     uint32_t eflags;
+     asm volatile("pushf; pop %0" : "=r"(eflags));
+     tcb_t *current = get_current_task();
+     return (eflags & 0x200) && current && current->pid != IDLE_TASK_PID;
+ }
  
-     disk_t *disk = get_disk_by_name(device_name);
-     if (!disk || !disk->initialized) {
-         terminal_printf("[BufferCache] Error: Device '%s' not found or not initialized.\n", device_name);
-         return NULL;
-     }
+ /**
+  * Drop one reference (cache_lock held). A buffer whose read failed is out of
+  * the hash already and goes back to the pool with its last reference.
+  */
+ static void buffer_put_locked(buffer_t *buf) {
+     if (buf->ref_count > 0) buf->ref_count--;
+     if (buf->ref_count == 0 && (buf->flags & BUFFER_FLAG_ERROR)) buffer_pool_push(buf);
+ }
+ 
+ /**
+  * Find the block containing lba, or claim a free slot for it. A claimed slot
+  * goes into the hash LOCKED right away, so a concurrent miss on the same
+  * block joins this read instead of issuing its own. *out carries a
+  * reference for the caller either way; a waiter, if given, is queued on the
+  * buffer while its data is not valid yet.
+  * @return BUFFER_CLAIM_READY (valid data), BUFFER_CLAIM_READ (the caller
+  *         must read it, then buffer_read_complete()), BUFFER_CLAIM_IN_FLIGHT
+  *         (someone else is reading it) or BUFFER_CLAIM_FAILED.
+  */
+ static int buffer_claim_block(disk_t *disk, uint32_t lba, buffer_waiter_t *waiter, buffer_t **out) {
+     const char *device_name = disk->blk_dev.device_name;
+ 
+     uint32_t nr_sectors;
+     uint32_t block_number = block_extent(disk, lba, &nr_sectors);
  
      // Check sector size
      if (disk->blk_dev.sector_size < MIN_BUFFER_BLOCK_SIZE ||
-         disk->blk_dev.sector_size > MAX_BUFFER_BLOCK_SIZE) {
+         disk->blk_dev.sector_size > BUFFER_POOL_FRAME_SIZE) {
          terminal_printf("[BufferCache] Error: Invalid sector size %u for device '%s'.\n",
                          disk->blk_dev.sector_size, device_name);
+         return BUFFER_CLAIM_FAILED;
+     }
+ 
+     uintptr_t irq_state = spinlock_acquire_irqsave(&cache_lock);
+ 
+     buffer_t *buf = buffer_lookup_internal(disk, block_number);
+     int claim;
+     if (!buf) {
+         percpu_counter_inc(&cache_stats.misses);
+         size_t data_size = (size_t)nr_sectors * disk->blk_dev.sector_size;
+         buffer_t *slot = buffer_pool_pop(data_size);
+         while (!slot) {
+             spinlock_release_irqrestore(&cache_lock, irq_state);
+ 
+             if (!buffer_pool_recycle(data_size)) {
+                 percpu_counter_inc(&cache_stats.alloc_failures);
+                 terminal_printf("[BufferCache] Error: No free buffer for block %lu on '%s' (all in use).\n",
+                                 (unsigned long)block_number, device_name);
+                 return BUFFER_CLAIM_FAILED;
+             }
+ 
+             irq_state = spinlock_acquire_irqsave(&cache_lock);
+ 
+             // Someone may have claimed the block while the lock was dropped
+             buf = buffer_lookup_internal(disk, block_number);
+             if (buf) break;
+             slot = buffer_pool_pop(data_size);
+         }
+         if (!buf) {
+             slot->disk = disk;
+             slot->block_number = block_number;
+             slot->nr_sectors = nr_sectors;
+             slot->size = (uint32_t)data_size;
+             slot->ref_count = 0;
+             slot->flags = BUFFER_FLAG_LOCKED;
+             slot->lru_prev = slot->lru_next = NULL;
+             slot->lru_list = BUFFER_LIST_NONE;
+             slot->parent = NULL;
+             slot->io_waiters = NULL;
+             buffer_insert_internal(slot); // Not on a replacement list until valid
+             buf = slot;
+         }
+         claim = (buf == slot) ? BUFFER_CLAIM_READ : -2; // -2: raced, classified below
+     } else {
+         claim = -2;
+     }
+ 
+     if (claim != BUFFER_CLAIM_READ) {
+         if (buf->flags & BUFFER_FLAG_LOCKED) {
+             claim = BUFFER_CLAIM_IN_FLIGHT;
+             percpu_counter_inc(&cache_stats.coalesced);
+         } else {
+             claim = BUFFER_CLAIM_READY;
+             lru_make_most_recent(buf);
+             percpu_counter_inc(&cache_stats.hits);
+         }
+     }
+     buf->ref_count++;
+     if (waiter && claim != BUFFER_CLAIM_READY) {
+         waiter->next = buf->io_waiters;
+         buf->io_waiters = waiter;
+     }
+ 
+     spinlock_release_irqrestore(&cache_lock, irq_state);
+     *out = buf;
+     return claim;
+ }
+ 
+ /**
+  * Sector view into a cached block for the getter of lba; takes over the
+  * getter's block reference (dropped again if no view can be made).
+  */
+ static buffer_t *buffer_make_view(buffer_t *block, uint32_t lba) {
+     if (block->nr_sectors == 1) return block;
+ 
+     buffer_t *view = (buffer_t *)slab_alloc(buffer_slab);
+     if (!view) {
+         percpu_counter_inc(&cache_stats.alloc_failures);
+         buffer_release(block);
          return NULL;
      }
  
-     // Acquire cache lock
+     memset(view, 0, sizeof(buffer_t));
+     view->disk = block->disk;
+     view->block_number = lba;
+     view->nr_sectors = 1;
+     view->size = block->disk->blk_dev.sector_size;
+     view->data = block->data + (size_t)(lba - block->block_number) * view->size;
+     view->flags = BUFFER_FLAG_VALID | BUFFER_FLAG_VIEW;
+     view->ref_count = 1;
+     view->parent = block; // Keeps the reference taken above
+     return view;
+ }
+ 
+ /**
+  * Finish the read of a claimed block: make it valid (or, on failure, drop
+  * it from the hash so the next getter retries), wake synchronous waiters
+  * and run the asynchronous ones. Each waiter's reference passes to its
+  * callback, or is dropped here on failure.
+  */
+ static void buffer_read_complete(buffer_t *buf, int read_result) {
      uintptr_t irq_state = spinlock_acquire_irqsave(&cache_lock);
+     buffer_waiter_t *waiters = buf->io_waiters;
+     buf->io_waiters = NULL;
+     if (read_result == 0) {
+         buf->flags = BUFFER_FLAG_VALID;
+         lru_admit(buf, true);
+     } else {
+         buffer_remove_internal(buf);
+         buf->flags = BUFFER_FLAG_ERROR; // Back to the pool with its last reference
+     }
+     spinlock_release_irqrestore(&cache_lock, irq_state);
  
-     // Check if buffer is already in cache
-     buffer_t *buf = buffer_lookup_internal(device_name, block_number);
-     if (buf) {
-         // Found in cache
-         buf->ref_count++;
-         lru_make_most_recent(buf);
+     wake_up_all(&s_io_wq);
+ 
+     while (waiters) {
+         buffer_waiter_t *w = waiters;
+         waiters = w->next;
+         if (read_result == 0) {
+             w->cb(buffer_make_view(buf, w->lba), w->ctx);
+         } else {
+             buffer_release(buf);
+             w->cb(NULL, w->ctx);
+         }
+         kfree(w);
+     }
+ }
+ 
+ // Sleep (or spin, if we cannot sleep) until a block's read in flight is over
+ static void buffer_wait_unlocked(buffer_t *buf) {
+     if (buffer_may_sleep()) {
+         wait_event(&s_io_wq, !(__atomic_load_n(&buf->flags, __ATOMIC_ACQUIRE) & BUFFER_FLAG_LOCKED));
+     } else {
+         while (__atomic_load_n(&buf->flags, __ATOMIC_ACQUIRE) & BUFFER_FLAG_LOCKED) asm volatile("pause");
+     }
+ }
+
+ // Sleep until a block's write in flight is over. A caller that cannot sleep
+ // does not wait: the writer may be the task it would spin against.
+ static void buffer_wait_written(buffer_t *buf) {
+     if (buffer_may_sleep()) {
+         wait_event(&s_io_wq, !(__atomic_load_n(&buf->flags, __ATOMIC_ACQUIRE) & BUFFER_FLAG_WRITEBACK));
+     }
+ }
+ 
+ /**
+  * Get the block buffer containing lba (allocate new or return cached). A
+  * miss on a block another task is reading waits for that read.
+  */
+ buffer_t *buffer_get_block(disk_t *disk, uint32_t lba) {
+     if (!disk || !disk->initialized) {
+         terminal_write("[BufferCache] Error: NULL or uninitialized disk in buffer_get().\n");
+         return NULL;
+     }
+ 
+     buffer_t *buf;
+     int claim = buffer_claim_block(disk, lba, NULL, &buf);
+     if (claim == BUFFER_CLAIM_FAILED) return NULL;
+     TRACEPOINT(claim == BUFFER_CLAIM_READY ? TP_BUFFER_HIT : TP_BUFFER_MISS, lba, 0);
+ 
+     if (claim == BUFFER_CLAIM_READ) {
+         int read_result = safe_disk_read(disk, buf->block_number, buf->data, buf->nr_sectors);
+         buffer_read_complete(buf, read_result);
+     } else if (claim == BUFFER_CLAIM_IN_FLIGHT) {
+         buffer_wait_unlocked(buf);
+     }
+ 
+     if (buf->flags & BUFFER_FLAG_ERROR) {
+         terminal_printf("[BufferCache] Error: Failed to read block %u from device '%s'.\n",
+                         buf->block_number, disk->blk_dev.device_name);
+         uintptr_t irq_state = spinlock_acquire_irqsave(&cache_lock);
+         buffer_put_locked(buf);
          spinlock_release_irqrestore(&cache_lock, irq_state);
-         cache_stats.hits++;
-         return buf;
+         return NULL;
      }
+     return buf;
+ }
  
-     // Not found in cache
-     cache_stats.misses++;
+ /**
+  * Get the sector-sized buffer for one LBA. Inside a multi-sector region this
+  * is a view into the cached block, so both paths see the same bytes.
+  */
+ buffer_t *buffer_get(disk_t *disk, uint32_t block_number) {
+     buffer_t *block = buffer_get_block(disk, block_number);
+     if (!block) return NULL;
+     return buffer_make_view(block, block_number);
+ }
  
-     // Try to allocate the buffer_t
-     buf = (buffer_t *)kmalloc(sizeof(buffer_t));
-     if (!buf) {
-         terminal_write("[BufferCache] kmalloc failed for buffer_t, attempting eviction...\n");
-         // Release lock before eviction
+ /**
+  * Request completion for buffer_get_async() reads, normally run by kblockd.
+  * Failures are resubmitted up to BUFFER_READ_ATTEMPTS times, like
+  * safe_disk_read() does for synchronous misses.
+  */
+ static void buffer_async_read_done(block_request_t *req, int status) {
+     buffer_read_t *rd = (buffer_read_t *)req->ctx;
+     buffer_t *buf = rd->buf;
+ 
+     if (status != 0 && ++rd->attempts < BUFFER_READ_ATTEMPTS) {
+         terminal_printf("[BufferCache] Retry %d: Reading sector %lu from '%s'...\n",
+                         rd->attempts, (unsigned long)buf->block_number, buf->disk->blk_dev.device_name);
+         if (disk_submit_raw_sectors(buf->disk, &rd->req) == FS_SUCCESS) return;
+     }
+ 
+     if (status != 0) {
+         terminal_printf("[BufferCache] Error: Failed to read sector %lu from '%s' after %d attempts.\n",
+                         (unsigned long)buf->block_number, buf->disk->blk_dev.device_name, rd->attempts);
+         percpu_counter_inc(&cache_stats.io_errors);
+     } else {
+         percpu_counter_inc(&cache_stats.reads);
+     }
+     kfree(rd);
+     buffer_read_complete(buf, status);
+ }
+ 
+ /**
+  * Start getting the sector buffer for block_number. Cached blocks complete
+  * at once; a miss queues its read on the disk's request queue (or joins the
+  * one in flight) and cb runs from the completion.
+  */
+ int buffer_get_async(disk_t *disk, uint32_t block_number, buffer_get_cb_t cb, void *ctx) {
+     if (!disk || !disk->initialized || !cb) return -FS_ERR_INVALID_PARAM;
+ 
+     buffer_waiter_t *waiter = (buffer_waiter_t *)kmalloc(sizeof(buffer_waiter_t));
+     if (!waiter) {
+         percpu_counter_inc(&cache_stats.alloc_failures);
+         return -FS_ERR_OUT_OF_MEMORY;
+     }
+     waiter->next = NULL;
+     waiter->cb = cb;
+     waiter->ctx = ctx;
+     waiter->lba = block_number;
+ 
+     buffer_t *buf;
+     int claim = buffer_claim_block(disk, block_number, waiter, &buf);
+     if (claim == BUFFER_CLAIM_FAILED) {
+         kfree(waiter);
+         return -FS_ERR_OUT_OF_MEMORY;
+     }
+     if (claim == BUFFER_CLAIM_READY) {
+         kfree(waiter);
+         cb(buffer_make_view(buf, block_number), ctx);
+         return FS_SUCCESS;
+     }
+     if (claim == BUFFER_CLAIM_IN_FLIGHT) return FS_SUCCESS; // The reader runs our waiter
+ 
+     buffer_read_t *rd = (buffer_read_t *)kmalloc(sizeof(buffer_read_t));
+     if (rd) {
+         memset(rd, 0, sizeof(*rd));
+         rd->buf = buf;
+         rd->req.lba = buf->block_number;
+         rd->req.count = buf->nr_sectors;
+         rd->req.buffer = buf->data;
+         rd->req.write = false;
+         rd->req.done = buffer_async_read_done;
+         rd->req.ctx = rd;
+         if (disk_submit_raw_sectors(disk, &rd->req) == FS_SUCCESS) return FS_SUCCESS;
+         kfree(rd);
+     }
+     // No request memory or queue: read it here instead
+     buffer_read_complete(buf, safe_disk_read(disk, buf->block_number, buf->data, buf->nr_sectors));
+     return FS_SUCCESS;
+ }
+ 
+ // Slot taken by buffer_get_range() for a miss: neither valid nor being read by anyone else
+ static inline bool buffer_is_private_miss(const buffer_t *buf) {
+     return (buf->flags & (BUFFER_FLAG_VALID | BUFFER_FLAG_LOCKED)) == 0;
+ }
+ 
+ /**
+  * Read a run of adjacent blocks (private slots, not yet in the cache) with
+  * one transfer. bounce must hold the whole run unless it is a single block,
+  * which is read in place.
+  */
+ static int buffer_read_run(disk_t *disk, buffer_t **run, uint32_t nblocks, uint32_t run_sectors, uint8_t *bounce) {
+     uint8_t *dest = (nblocks == 1) ? run[0]->data : bounce;
+     int read_result = disk_read_raw_sectors(disk, run[0]->block_number, dest, run_sectors);
+     if (read_result != 0) {
+         percpu_counter_inc(&cache_stats.io_errors);
+         return read_result;
+     }
+     percpu_counter_inc(&cache_stats.reads);
+ 
+     if (nblocks > 1) {
+         for (uint32_t i = 0; i < nblocks; i++) {
+             memcpy(run[i]->data, bounce, run[i]->size);
+             bounce += run[i]->size;
+         }
+     }
+     return 0;
+ }
+ 
+ /**
+  * Read the uncached blocks of [lba, lba + count) into the cache, one
+  * multi-sector transfer per run of adjacent missing blocks.
+  */
+ static void buffer_prefetch(disk_t *disk, uint32_t lba, uint32_t count) {
+     if (!ra_bounce) return;
+     if (__atomic_exchange_n(&ra_busy, 1, __ATOMIC_ACQUIRE)) {
+         return; // Another prefetch owns the bounce buffer; this one is only a hint
+     }
+ 
+     uint32_t sector_size = disk->blk_dev.sector_size;
+     uint32_t max_run = BUFFER_RA_BOUNCE_SIZE / sector_size;
+     if (max_run > MAX_SECTORS_PER_IO) max_run = MAX_SECTORS_PER_IO;
+     uint64_t end = (uint64_t)lba + count;
+     if (end > disk->blk_dev.total_sectors) end = disk->blk_dev.total_sectors;
+ 
+     uint32_t pos = lba;
+     while (pos < end) {
+         buffer_t *run[MAX_SECTORS_PER_IO];
+         uint32_t nblocks = 0, run_sectors = 0;
+ 
+         uintptr_t irq_state = spinlock_acquire_irqsave(&cache_lock);
+         while (pos < end && nblocks < MAX_SECTORS_PER_IO) {
+             uint32_t nr_sectors;
+             uint32_t start = block_extent(disk, pos, &nr_sectors);
+             if (buffer_lookup_internal(disk, start)) {
+                 if (nblocks) break; // The run must stay contiguous
+                 pos = start + nr_sectors;
+                 continue;
+             }
+             if (run_sectors + nr_sectors > max_run) break;
+             buffer_t *buf = buffer_pool_take_clean((size_t)nr_sectors * sector_size);
+             if (!buf) break;
+ 
+             buf->disk = disk;
+             buf->block_number = start;
+             buf->nr_sectors = nr_sectors;
+             buf->size = nr_sectors * sector_size;
+             buf->ref_count = 0;
+             buf->flags = 0;
+             buf->parent = NULL;
+             run[nblocks++] = buf;
+             run_sectors += nr_sectors;
+             pos = start + nr_sectors;
+         }
          spinlock_release_irqrestore(&cache_lock, irq_state);
  
-         // Attempt eviction
-         if (evict_lru_buffer_and_free() == 0) {
-             // Eviction succeeded, re-acquire lock & retry allocation
-             irq_state = spinlock_acquire_irqsave(&cache_lock);
-             buf = (buffer_t *)kmalloc(sizeof(buffer_t));
+         if (nblocks == 0) break; // Pool exhausted by referenced/dirty buffers
+ 
+         int read_result = buffer_read_run(disk, run, nblocks, run_sectors, ra_bounce);
+ 
+         irq_state = spinlock_acquire_irqsave(&cache_lock);
+         for (uint32_t i = 0; i < nblocks; i++) {
+             buffer_t *buf = run[i];
+             if (read_result != 0 || buffer_lookup_internal(disk, buf->block_number)) {
+                 buffer_pool_push(buf); // Failed, or a demand miss beat us to it
+                 continue;
+             }
+             buf->flags = BUFFER_FLAG_VALID;
+             buffer_insert_internal(buf);
+             lru_admit(buf, false);
+             percpu_counter_inc(&cache_stats.readahead_blocks);
+         }
+         spinlock_release_irqrestore(&cache_lock, irq_state);
+ 
+         if (read_result != 0) break;
+     }
+ 
+     __atomic_store_n(&ra_busy, 0, __ATOMIC_RELEASE);
+ }
+ 
+ /**
+  * Get the blocks covering [lba, lba + count) in LBA order, with one lock
+  * hold for the lookups and one transfer per run of adjacent missing blocks.
+  * Returns how many leading entries of bufs were filled (fewer than the range
+  * needs only on I/O failure, pool exhaustion or reaching max_bufs); release
+  * them with buffer_release_range().
+  */
+ size_t buffer_get_range(disk_t *disk, uint32_t lba, uint32_t count, buffer_t **bufs, size_t max_bufs) {
+     if (!disk || !disk->initialized || !bufs || count == 0 || max_bufs == 0) return 0;
+ 
+     uint32_t sector_size = disk->blk_dev.sector_size;
+     uint32_t max_run = BUFFER_RA_BOUNCE_SIZE / sector_size;
+     if (max_run > MAX_SECTORS_PER_IO) max_run = MAX_SECTORS_PER_IO;
+     uint64_t end = (uint64_t)lba + count;
+     if (end > disk->blk_dev.total_sectors) end = disk->blk_dev.total_sectors;
+ 
+     // Pass 1: hits take a reference, misses get a private pool slot
+     size_t n = 0, missing = 0;
+     uint32_t pos = lba;
+     uintptr_t irq_state = spinlock_acquire_irqsave(&cache_lock);
+     while (pos < end && n < max_bufs) {
+         uint32_t nr_sectors;
+         uint32_t start = block_extent(disk, pos, &nr_sectors);
+         buffer_t *buf = buffer_lookup_internal(disk, start);
+         if (buf) {
+             buf->ref_count++;
+             if (buf->flags & BUFFER_FLAG_LOCKED) {
+                 percpu_counter_inc(&cache_stats.coalesced); // Someone is reading it; waited for after pass 2
+             } else {
+                 lru_make_most_recent(buf);
+                 percpu_counter_inc(&cache_stats.hits);
+             }
          } else {
-             // Eviction failed or no buffers to evict
-             irq_state = spinlock_acquire_irqsave(&cache_lock);
+             buf = buffer_pool_take_clean((size_t)nr_sectors * sector_size);
+             if (!buf) break; // The tail goes through buffer_get_block below
+             buf->disk = disk;
+             buf->block_number = start;
+             buf->nr_sectors = nr_sectors;
+             buf->size = nr_sectors * sector_size;
+             buf->ref_count = 1;
+             buf->flags = 0; // Not VALID: marks the slot as still to be read
+             buf->parent = NULL;
+             percpu_counter_inc(&cache_stats.misses);
+             missing++;
          }
+         bufs[n++] = buf;
+         pos = start + nr_sectors;
+     }
+     spinlock_release_irqrestore(&cache_lock, irq_state);
  
-         if (!buf) {
-             terminal_write("[BufferCache] kmalloc failed for buffer_t even after eviction.\n");
-             spinlock_release_irqrestore(&cache_lock, irq_state);
-             return NULL;
+     // Pass 2: read runs of adjacent missing blocks
+     uint8_t *bounce = NULL;
+     bool own_ra_bounce = false;
+     if (missing > 1) {
+         if (ra_bounce && !__atomic_exchange_n(&ra_busy, 1, __ATOMIC_ACQUIRE)) {
+             bounce = ra_bounce;
+             own_ra_bounce = true;
+         } else {
+             bounce = kmalloc(BUFFER_RA_BOUNCE_SIZE); // NULL: fall back to block-at-a-time
          }
      }
  
-     memset(buf, 0, sizeof(buffer_t));
-     buf->disk = disk;
-     buf->block_number = block_number;
-     buf->ref_count = 1;
-     buf->flags = 0;
+     size_t filled = n;
+     for (size_t i = 0; i < n && missing; ) {
+         if (!buffer_is_private_miss(bufs[i])) { i++; continue; }
+         size_t j = i;
+         uint32_t run_sectors = 0;
+         do {
+             run_sectors += bufs[j]->nr_sectors;
+             j++;
+         } while (bounce && j < n && buffer_is_private_miss(bufs[j]) &&
+                  run_sectors + bufs[j]->nr_sectors <= max_run);
+ 
+         if (buffer_read_run(disk, &bufs[i], (uint32_t)(j - i), run_sectors, bounce) != 0) {
+             filled = i;
+             break;
+         }
  
-     // Allocate buffer->data
-     size_t sector_size = disk->blk_dev.sector_size;
-     buf->data = kmalloc(sector_size + BUFFER_PADDING);
-     if (!buf->data) {
-         terminal_write("[BufferCache] kmalloc failed for buffer data, attempting eviction...\n");
-         // Free the buf struct itself before we try eviction
-         kfree(buf);
+         irq_state = spinlock_acquire_irqsave(&cache_lock);
+         for (size_t k = i; k < j; k++) {
+             buffer_t *raced = buffer_lookup_internal(disk, bufs[k]->block_number);
+             if (raced) { // A concurrent miss beat us to it (maybe still reading)
+                 buffer_pool_push(bufs[k]);
+                 raced->ref_count++;
+                 bufs[k] = raced;
+                 continue;
+             }
+             bufs[k]->flags = BUFFER_FLAG_VALID;
+             buffer_insert_internal(bufs[k]);
+             lru_admit(bufs[k], true);
+         }
          spinlock_release_irqrestore(&cache_lock, irq_state);
+         missing -= (j - i);
+         i = j;
+     }
  
-         if (evict_lru_buffer_and_free() == 0) {
-             // Retake lock and retry
-             irq_state = spinlock_acquire_irqsave(&cache_lock);
-             buf = (buffer_t *)kmalloc(sizeof(buffer_t));
+     if (own_ra_bounce) __atomic_store_n(&ra_busy, 0, __ATOMIC_RELEASE);
+     else if (bounce) kfree(bounce);
+ 
+     // Blocks other tasks were reading: wait for them, a failure ends the range
+     for (size_t k = 0; k < filled; k++) {
+         if (bufs[k]->flags & BUFFER_FLAG_LOCKED) buffer_wait_unlocked(bufs[k]);
+         if (bufs[k]->flags & BUFFER_FLAG_ERROR) { filled = k; break; }
+     }
+ 
+     // Anything past a failed read is dropped: hits lose their reference, slots go back
+     if (filled < n) {
+         uint32_t failed_lba = bufs[filled]->block_number;
+         irq_state = spinlock_acquire_irqsave(&cache_lock);
+         for (size_t k = filled; k < n; k++) {
+             if (buffer_is_private_miss(bufs[k])) buffer_pool_push(bufs[k]);
+             else buffer_put_locked(bufs[k]);
+             bufs[k] = NULL;
+         }
+         spinlock_release_irqrestore(&cache_lock, irq_state);
+         terminal_printf("[BufferCache] Error: Range read failed at block %lu on '%s'.\n",
+                         (unsigned long)failed_lba, disk->blk_dev.device_name);
+         return filled;
+     }
+ 
+     // Pool ran dry in pass 1: finish through the single-block path (may recycle dirty slots)
+     while (pos < end && n < max_bufs) {
+         buffer_t *buf = buffer_get_block(disk, pos);
+         if (!buf) break;
+         bufs[n++] = buf;
+         pos = buf->block_number + buf->nr_sectors;
+     }
+     return n;
+ }
+ 
+ /**
+  * Copy [lba, lba + count) into dst, bypassing the cache for what it does not
+  * hold. Blocks in the cache (dirty ones included) are copied from it, so the
+  * caller sees the same bytes as buffer_get(); every run of uncached sectors
+  * between them is one disk request straight into dst and nothing is admitted.
+  */
+ int buffer_read_bulk(disk_t *disk, uint32_t lba, uint32_t count, void *dst) {
+     if (!disk || !disk->initialized || !dst) return -FS_ERR_INVALID_PARAM;
+     if (lba >= disk->blk_dev.total_sectors || count > disk->blk_dev.total_sectors - lba) {
+         return -FS_ERR_OUT_OF_BOUNDS;
+     }
+ 
+     uint32_t sector_size = disk->blk_dev.sector_size;
+     uint8_t *out = (uint8_t *)dst;
+     uint32_t pos = lba, end = lba + count;
+     while (pos < end) {
+         buffer_t *hit = NULL;
+         uint32_t run = 0; // Uncached sectors from pos
+ 
+         uintptr_t irq_state = spinlock_acquire_irqsave(&cache_lock);
+         while (pos + run < end && run < BUFFER_BULK_MAX_SECTORS) {
+             uint32_t nr_sectors;
+             uint32_t start = block_extent(disk, pos + run, &nr_sectors);
+             buffer_t *buf = buffer_lookup_internal(disk, start);
              if (buf) {
-                 memset(buf, 0, sizeof(buffer_t));
-                 buf->disk = disk;
-                 buf->block_number = block_number;
-                 buf->ref_count = 1;
-                 buf->flags = 0;
-                 buf->data = kmalloc(sector_size + BUFFER_PADDING);
+                 if (run == 0) {
+                     buf->ref_count++;
+                     hit = buf;
+                 }
+                 break;
              }
-         } else {
-             // Could not evict
-             irq_state = spinlock_acquire_irqsave(&cache_lock);
+             run = start + nr_sectors - pos;
          }
+         spinlock_release_irqrestore(&cache_lock, irq_state);
  
-         if (!buf || !buf->data) {
-             terminal_write("[BufferCache] kmalloc failed for buffer data even after eviction.\n");
-             if (buf) {
-                 // if buf->data is NULL, free buf
-                 kfree(buf);
+         if (hit) {
+             if (hit->flags & BUFFER_FLAG_LOCKED) buffer_wait_unlocked(hit);
+             uint32_t n = 0;
+             if (!(hit->flags & BUFFER_FLAG_ERROR)) { // A failed read left the hash: next pass reads it
+                 n = hit->block_number + hit->nr_sectors - pos;
+                 if (n > end - pos) n = end - pos;
+                 memcpy(out, hit->data + (size_t)(pos - hit->block_number) * sector_size, (size_t)n * sector_size);
              }
+             irq_state = spinlock_acquire_irqsave(&cache_lock);
+             buffer_put_locked(hit);
              spinlock_release_irqrestore(&cache_lock, irq_state);
-             return NULL;
+             pos += n;
+             out += (size_t)n * sector_size;
+             continue;
          }
+ 
+         if (run > end - pos) run = end - pos;
+         if (run > BUFFER_BULK_MAX_SECTORS) run = BUFFER_BULK_MAX_SECTORS;
+         int read_result = safe_disk_read(disk, pos, out, run);
+         if (read_result != 0) return read_result;
+         pos += run;
+         out += (size_t)run * sector_size;
      }
+     return FS_SUCCESS;
+ }
  
-     // Zero data area (including padding)
-     memset(buf->data, 0, sector_size + BUFFER_PADDING);
+ /**
+  * Release buffers returned by buffer_get_range()
+  */
+ void buffer_release_range(buffer_t **bufs, size_t n) {
+     if (!bufs) return;
  
-     // Release lock for disk I/O
+     uintptr_t irq_state = spinlock_acquire_irqsave(&cache_lock);
+     for (size_t i = 0; i < n; i++) {
+         if (bufs[i]) buffer_put_locked(bufs[i]);
+     }
      spinlock_release_irqrestore(&cache_lock, irq_state);
+ }
  
-     // Read data from disk
-     int read_result = safe_disk_read(disk, block_number, buf->data, disk->blk_dev.sector_size);
- 
-     // Re-acquire lock
-     irq_state = spinlock_acquire_irqsave(&cache_lock);
- 
-     if (read_result != 0) {
-         // Read failed, free buffer
-         kfree(buf->data);
-         kfree(buf);
-         spinlock_release_irqrestore(&cache_lock, irq_state);
-         terminal_printf("[BufferCache] Error: Failed to read block %u from device '%s'.\n",
-                         block_number, device_name);
-         return NULL;
+ /**
+  * Note a read of [lba, lba + nr_sectors) on a stream and keep the window
+  * after it prefetched. Exactly continuing the last read doubles the window
+  * (capped at one bounce transfer); anything but a re-read of the current
+  * range resets the stream. The next window is fetched once the reader is
+  * within half a window of the prefetched end.
+  */
+ void buffer_readahead(disk_t *disk, buffer_readahead_t *ra, uint32_t lba, uint32_t nr_sectors) {
+     if (!disk || !ra || nr_sectors == 0 || !ra_bounce) return;
+ 
+     uint32_t max_window = BUFFER_RA_BOUNCE_SIZE / disk->blk_dev.sector_size;
+     if (max_window > MAX_SECTORS_PER_IO) max_window = MAX_SECTORS_PER_IO;
+ 
+     if (lba == ra->next_lba && ra->next_lba != 0) {
+         ra->window = ra->window ? ra->window * 2 : BUFFER_RA_MIN_WINDOW;
+         if (ra->window > max_window) ra->window = max_window;
+     } else if (!(lba >= ra->start_lba && lba < ra->next_lba)) {
+         ra->window = 0;
+         ra->ahead_lba = 0;
      }
+     ra->start_lba = lba;
+     if (lba + nr_sectors > ra->next_lba || ra->window == 0) ra->next_lba = lba + nr_sectors;
  
-     // Mark buffer as valid
-     buf->flags |= BUFFER_FLAG_VALID;
+     if (ra->window == 0) return;
+     if (ra->ahead_lba < ra->next_lba) ra->ahead_lba = ra->next_lba;
+     if (ra->ahead_lba - ra->next_lba > ra->window / 2) return;
  
-     // Insert into hash table and LRU list
-     buffer_insert_internal(buf);
-     lru_make_most_recent(buf);
- 
-     spinlock_release_irqrestore(&cache_lock, irq_state);
-     return buf;
+     uint32_t target = ra->next_lba + ra->window;
+     if (target > ra->ahead_lba) {
+         buffer_prefetch(disk, ra->ahead_lba, target - ra->ahead_lba);
+         ra->ahead_lba = target;
+     }
  }
  
  /**
@@ -532,10 +1388,18 @@
  void buffer_release(buffer_t *buf) {
      if (!buf) return;
  
+     if (buf->flags & BUFFER_FLAG_VIEW) {
+         // A view is private to its getter: drop it and the block reference it held
+         buffer_t *block = buf->parent;
+         slab_free(buffer_slab, buf);
+         buffer_release(block);
+         return;
+     }
+ 
      uintptr_t irq_state = spinlock_acquire_irqsave(&cache_lock);
  
      if (buf->ref_count > 0) {
-         buf->ref_count--;
+         buffer_put_locked(buf);
      } else {
          terminal_printf("[BufferCache] Warning: Releasing buffer with ref_count=0 (block %u on '%s').\n",
                          buf->block_number,
@@ -545,17 +1409,47 @@
      spinlock_release_irqrestore(&cache_lock, irq_state);
  }
  
+ static inline uint32_t dirty_limit(uint32_t pct) {
+     return (buffer_pool.slots * pct) / 100;
+ }
+ 
+ /**
+  * True if the caller may sleep on the flusher: it is running, we are not it,
+  * and interrupts are on (so no spinlock is held; they are all irqsave).
+  */
+ static bool buffer_may_wait_for_flusher(void) {
+     return s_flusher_task && buffer_may_sleep() && get_current_task() != s_flusher_task;
+ }
+ 
+ /**
+  * Make a writer that pushed the dirty share past BUFFER_DIRTY_THROTTLE_PCT
+  * wait for one flusher pass, so dirtying cannot outrun the disk.
+  */
+ static void buffer_dirty_throttle(void) {
+     if (dirty_count <= dirty_limit(BUFFER_DIRTY_THROTTLE_PCT)) return;
+     if (!buffer_may_wait_for_flusher()) return;
+ 
+     uint32_t pass = s_flush_passes;
+     wake_up_one(&s_flusher_wq);
+     wait_event(&s_throttle_wq, s_flush_passes != pass);
+ }
+ 
  /**
   * Mark a buffer as dirty
   */
  void buffer_mark_dirty(buffer_t *buf) {
      if (!buf) return;
+     if (buf->flags & BUFFER_FLAG_VIEW) buf = buf->parent;
  
      uintptr_t irq_state = spinlock_acquire_irqsave(&cache_lock);
  
      // Only mark valid buffers as dirty
      if (buf->flags & BUFFER_FLAG_VALID) {
-         buf->flags |= BUFFER_FLAG_DIRTY;
+         if (!(buf->flags & BUFFER_FLAG_DIRTY)) {
+             buf->flags |= BUFFER_FLAG_DIRTY;
+             buf->dirty_since = scheduler_get_ticks();
+             dirty_count++;
+         }
      } else {
          terminal_printf("[BufferCache] Warning: Attempted to mark invalid buffer as dirty (%u on '%s').\n",
                          buf->block_number,
@@ -563,18 +1457,29 @@
      }
  
      spinlock_release_irqrestore(&cache_lock, irq_state);
+ 
+     buffer_dirty_throttle();
  }
  
  /**
-  * Flush a single buffer to disk
+  * Write a dirty buffer back. Without fua the data may sit in the drive's
+  * write cache until the disk is flushed.
   */
- int buffer_flush(buffer_t *buf) {
+ static int buffer_write_out(buffer_t *buf, bool fua) {
      if (!buf || !buf->disk) {
          return -FS_ERR_INVALID_PARAM;
      }
+     if (buf->flags & BUFFER_FLAG_VIEW) buf = buf->parent;
  
      // Check if buffer needs flushing
      uintptr_t irq_state = spinlock_acquire_irqsave(&cache_lock);
+
+     // One write of a block at a time, so an older copy cannot land after a newer one
+     while ((buf->flags & BUFFER_FLAG_WRITEBACK) && buffer_may_sleep()) {
+         spinlock_release_irqrestore(&cache_lock, irq_state);
+         buffer_wait_written(buf);
+         irq_state = spinlock_acquire_irqsave(&cache_lock);
+     }
  
      if (!(buf->flags & BUFFER_FLAG_DIRTY) || !(buf->flags & BUFFER_FLAG_VALID)) {
          // Nothing to flush
@@ -584,7 +1489,8 @@
  
      disk_t *disk = buf->disk;
      uint32_t block = buf->block_number;
-     size_t buffer_size = disk->blk_dev.sector_size;
+     uint32_t nr_sectors = buf->nr_sectors;
+     size_t buffer_size = buf->size;
  
      // Copy data to temporary buffer for writing outside the lock
      void *temp_data = kmalloc(buffer_size);
@@ -595,29 +1501,71 @@
  
      memcpy(temp_data, buf->data, buffer_size);
      buf->flags &= ~BUFFER_FLAG_DIRTY; // Mark clean now under lock
+     buf->flags |= BUFFER_FLAG_WRITEBACK;
+     dirty_count--;
  
      spinlock_release_irqrestore(&cache_lock, irq_state);
  
      // Write to disk without holding the lock
-     int write_result = disk_write_raw_sectors(disk, block, temp_data, 1);
+     int write_result = fua ? disk_write_raw_sectors_fua(disk, block, temp_data, nr_sectors)
+                            : disk_write_raw_sectors(disk, block, temp_data, nr_sectors);
      kfree(temp_data);
+
+     irq_state = spinlock_acquire_irqsave(&cache_lock);
+     buf->flags &= ~BUFFER_FLAG_WRITEBACK;
+     spinlock_release_irqrestore(&cache_lock, irq_state);
+     wake_up_all(&s_io_wq);
  
      if (write_result != 0) {
-         cache_stats.io_errors++;
+         percpu_counter_inc(&cache_stats.io_errors);
          terminal_printf("[BufferCache] Error: Failed to write block %u to disk '%s'.\n",
                          block, disk->blk_dev.device_name);
          return -FS_ERR_IO;
      }
  
-     cache_stats.writes++;
+     percpu_counter_inc(&cache_stats.writes);
  
      return 0;
  }
  
  /**
-  * Sync all dirty buffers
+  * Flush a single buffer to disk; it is on the medium once this returns
   */
- void buffer_cache_sync(void) {
+ int buffer_flush(buffer_t *buf) {
+     return buffer_write_out(buf, true);
+ }
+ 
+ // Disks written by one write-back pass: each gets one cache flush at its end
+ typedef struct {
+     disk_t *disks[BUFFER_SYNC_MAX_DISKS];
+     uint32_t count;
+ } buffer_flush_set_t;
+ 
+ static void flush_set_add(buffer_flush_set_t *set, disk_t *disk) {
+     for (uint32_t i = 0; i < set->count; i++) {
+         if (set->disks[i] == disk) return;
+     }
+     if (set->count == BUFFER_SYNC_MAX_DISKS) {
+         disk_flush(disk); // More disks than slots: this one is flushed right away
+         return;
+     }
+     set->disks[set->count++] = disk;
+ }
+ 
+ static int flush_set_flush(buffer_flush_set_t *set) {
+     int errors = 0;
+     for (uint32_t i = 0; i < set->count; i++) {
+         if (disk_flush(set->disks[i]) != FS_SUCCESS) errors++;
+     }
+     set->count = 0;
+     return errors;
+ }
+ 
+ /**
+  * Sync all dirty buffers from the calling context (before the flusher runs,
+  * or when the caller cannot sleep)
+  */
+ static void buffer_cache_sync_inline(void) {
      terminal_write("[BufferCache] Starting full cache sync...\n");
  
      int total_flushed = 0;
@@ -627,7 +1575,8 @@
      uintptr_t irq_state = spinlock_acquire_irqsave(&cache_lock);
  
      // Create a copy of all dirty buffers to avoid long lock hold
-     buffer_t **dirty_buffers = kmalloc(sizeof(buffer_t*) * BUFFER_CACHE_HASH_SIZE);
+     // (sized for the whole cache, so it never needs to grow)
+     buffer_t **dirty_buffers = kmalloc(sizeof(buffer_t*) * (cached_count + 1));
      if (!dirty_buffers) {
          spinlock_release_irqrestore(&cache_lock, irq_state);
          terminal_write("[BufferCache] Error: Failed to allocate memory for sync.\n");
@@ -637,32 +1586,13 @@
      int dirty_count = 0;
  
      // Scan all hash buckets
-     for (uint32_t i = 0; i < BUFFER_CACHE_HASH_SIZE; i++) {
+     for (uint32_t i = 0; i < buffer_hash_size; i++) {
          buffer_t *buf = buffer_hash_table[i];
          while (buf) {
              if ((buf->flags & BUFFER_FLAG_DIRTY) && (buf->flags & BUFFER_FLAG_VALID)) {
                  // Increment ref count to prevent eviction during sync
                  buf->ref_count++;
                  dirty_buffers[dirty_count++] = buf;
- 
-                 // Resize array if needed (unlikely, but just in case)
-                 if (dirty_count >= (int)BUFFER_CACHE_HASH_SIZE && i < BUFFER_CACHE_HASH_SIZE - 1) {
-                     buffer_t **new_array = kmalloc(sizeof(buffer_t*) * BUFFER_CACHE_HASH_SIZE * 2);
-                     if (!new_array) {
-                         // Decrement ref counts for buffers we've already found
-                         for (int j = 0; j < dirty_count; j++) {
-                             dirty_buffers[j]->ref_count--;
-                         }
-                         spinlock_release_irqrestore(&cache_lock, irq_state);
-                         kfree(dirty_buffers);
-                         terminal_write("[BufferCache] Error: Failed to resize dirty buffer array.\n");
-                         return;
-                     }
-                     // Copy to new array
-                     memcpy(new_array, dirty_buffers, sizeof(buffer_t*) * dirty_count);
-                     kfree(dirty_buffers);
-                     dirty_buffers = new_array;
-                 }
              }
              buf = buf->hash_next;
          }
@@ -670,15 +1600,17 @@
  
      spinlock_release_irqrestore(&cache_lock, irq_state);
  
-     // Flush each dirty buffer
+     // Write each dirty buffer, then flush the disks' caches once
+     buffer_flush_set_t flush_set = { .count = 0 };
      for (int i = 0; i < dirty_count; i++) {
          buffer_t *buf = dirty_buffers[i];
  
-         int flush_result = buffer_flush(buf);
+         int flush_result = buffer_write_out(buf, false);
          if (flush_result != 0) {
              errors++;
          } else {
              total_flushed++;
+             flush_set_add(&flush_set, buf->disk);
          }
  
          // Release the extra reference we added
@@ -687,13 +1619,177 @@
              buf->ref_count--;
          }
          spinlock_release_irqrestore(&cache_lock, irq_state);
+         cond_resched(); // A large cache takes many writes
      }
  
      kfree(dirty_buffers);
+     errors += flush_set_flush(&flush_set);
  
      terminal_printf("[BufferCache] Sync complete: %d flushed, %d errors.\n", total_flushed, errors);
  }
  
+ // Insertion sort by (disk, LBA): batches are small, and LBA order keeps the head moving one way
+ static void batch_sort_lba(buffer_t **batch, uint32_t n) {
+     for (uint32_t i = 1; i < n; i++) {
+         buffer_t *key = batch[i];
+         uint32_t j = i;
+         while (j > 0 && (batch[j - 1]->disk > key->disk ||
+                          (batch[j - 1]->disk == key->disk && batch[j - 1]->block_number > key->block_number))) {
+             batch[j] = batch[j - 1];
+             j--;
+         }
+         batch[j] = key;
+     }
+ }
+ 
+ /**
+  * Write back dirty buffers in batches sorted by (disk, LBA): all of them, or
+  * only those dirty for BUFFER_DIRTY_EXPIRE_MS unless the dirty share is
+  * above BUFFER_DIRTY_BACKGROUND_PCT. Each disk written is flushed once at the
+  * end, which bounds how long written data sits in a volatile drive cache.
+  * Returns the number written.
+  */
+ static uint32_t buffer_writeback(bool all) {
+     uint32_t written = 0;
+     buffer_flush_set_t flush_set = { .count = 0 };
+     uint32_t rounds = cached_count / BUFFER_FLUSH_BATCH + 1; // Bounded even if writers keep up
+ 
+     while (rounds--) {
+         buffer_t *batch[BUFFER_FLUSH_BATCH];
+         uint32_t n = 0;
+         uint32_t now = scheduler_get_ticks();
+ 
+         uintptr_t irq_state = spinlock_acquire_irqsave(&cache_lock);
+         bool over_limit = dirty_count > dirty_limit(BUFFER_DIRTY_BACKGROUND_PCT);
+         for (uint32_t list = BUFFER_LIST_IN; list < BUFFER_LIST_COUNT; list++) {
+             for (buffer_t *buf = lru_lists[list].tail; buf && n < BUFFER_FLUSH_BATCH; buf = buf->lru_prev) {
+                 if (!(buf->flags & BUFFER_FLAG_DIRTY)) continue;
+                 if (!all && !over_limit &&
+                     now - buf->dirty_since < BUFFER_MS_TO_TICKS(BUFFER_DIRTY_EXPIRE_MS)) continue;
+                 buf->ref_count++; // Pinned until written
+                 batch[n++] = buf;
+             }
+         }
+         spinlock_release_irqrestore(&cache_lock, irq_state);
+ 
+         if (n == 0) break;
+ 
+         batch_sort_lba(batch, n);
+ 
+         for (uint32_t i = 0; i < n; i++) {
+             if (buffer_write_out(batch[i], false) == 0) {
+                 written++;
+                 flush_set_add(&flush_set, batch[i]->disk);
+             }
+             buffer_release(batch[i]);
+         }
+ 
+         if (n < BUFFER_FLUSH_BATCH) break;
+         cond_resched();
+     }
+     flush_set_flush(&flush_set);
+     return written;
+ }
+ 
+ static __attribute__((noreturn)) void buffer_flusher_loop(void *arg) {
+     (void)arg;
+     for (;;) {
+         wait_event(&s_flusher_wq, s_sync_seq != s_sync_done || dirty_count > 0);
+ 
+         uint32_t sync_target = s_sync_seq;
+         bool full = (sync_target != s_sync_done);
+         buffer_writeback(full);
+         if (full) {
+             s_sync_done = sync_target;
+             wake_up_all(&s_sync_wq);
+         }
+         s_flush_passes++;
+         wake_up_all(&s_throttle_wq);
+ 
+         // Let younger buffers age; a sync or throttled writer waits at most one interval
+         if (dirty_count > 0 && s_sync_seq == s_sync_done) sleep_ms(BUFFER_FLUSH_INTERVAL_MS);
+     }
+ }
+ 
+ /**
+  * Sync all dirty buffers: hand the work to the flusher and wait for a full
+  * pass that started after this call.
+  */
+ void buffer_cache_sync(void) {
+     if (!buffer_may_wait_for_flusher()) {
+         buffer_cache_sync_inline();
+         return;
+     }
+ 
+     uintptr_t irq_state = spinlock_acquire_irqsave(&cache_lock);
+     uint32_t ticket = ++s_sync_seq;
+     spinlock_release_irqrestore(&cache_lock, irq_state);
+ 
+     wake_up_one(&s_flusher_wq);
+     wait_event(&s_sync_wq, (int32_t)(s_sync_done - ticket) >= 0);
+ }
+
+ /**
+  * Write the dirty blocks of disk overlapping [lba, lba + count) in LBA-sorted
+  * batches, and wait out writes of them already in flight (the flusher's, and
+  * evictions, which take blocks out of the hash while they are written). A
+  * range no larger than the cache is looked up block by block, a larger one
+  * by walking the replacement lists, so the cost is bounded by both.
+  */
+ int buffer_writeback_range(disk_t *disk, uint32_t lba, uint32_t count) {
+     if (!disk || count == 0) return -FS_ERR_INVALID_PARAM;
+     uint32_t end = (count > UINT32_MAX - lba) ? UINT32_MAX : lba + count;
+     uint32_t next = lba;                                    // Lookup cursor
+     uint32_t rounds = cached_count / BUFFER_FLUSH_BATCH + 1; // List walks, bounded like buffer_writeback()
+     int errors = 0;
+ 
+     for (;;) {
+         buffer_t *batch[BUFFER_FLUSH_BATCH];
+         uint32_t n = 0;
+         bool more;
+ 
+         uintptr_t irq_state = spinlock_acquire_irqsave(&cache_lock);
+         if (end - next <= cached_count) {
+             while (next < end && n < BUFFER_FLUSH_BATCH) {
+                 uint32_t sectors;
+                 uint32_t start = block_extent(disk, next, &sectors);
+                 buffer_t *buf = buffer_lookup_internal(disk, start);
+                 if (buf && (buf->flags & (BUFFER_FLAG_DIRTY | BUFFER_FLAG_WRITEBACK))) {
+                     buf->ref_count++; // Pinned until written
+                     batch[n++] = buf;
+                 }
+                 next = start + sectors;
+             }
+             more = next < end;
+         } else {
+             for (uint32_t list = BUFFER_LIST_IN; list < BUFFER_LIST_COUNT; list++) {
+                 for (buffer_t *buf = lru_lists[list].tail; buf && n < BUFFER_FLUSH_BATCH; buf = buf->lru_prev) {
+                     if (buf->disk != disk || buf->block_number >= end ||
+                         buf->block_number + buf->nr_sectors <= lba) continue;
+                     if (!(buf->flags & (BUFFER_FLAG_DIRTY | BUFFER_FLAG_WRITEBACK))) continue;
+                     buf->ref_count++;
+                     batch[n++] = buf;
+                 }
+             }
+             more = (n == BUFFER_FLUSH_BATCH) && --rounds > 0;
+         }
+         spinlock_release_irqrestore(&cache_lock, irq_state);
+ 
+         // buffer_write_out() waits for a write in flight first, and is done if that left the block clean
+         batch_sort_lba(batch, n);
+         for (uint32_t i = 0; i < n; i++) {
+             if (buffer_write_out(batch[i], false) != 0) errors++;
+             buffer_release(batch[i]);
+         }
+ 
+         if (!more) break;
+         cond_resched();
+     }
+ 
+     if (s_evict_writes && buffer_may_sleep()) wait_event(&s_io_wq, s_evict_writes == 0);
+     return errors ? -FS_ERR_IO : 0;
+ }
+ 
  /**
   * Get buffer cache statistics
   */
@@ -702,25 +1798,36 @@
  
      uintptr_t irq_state = spinlock_acquire_irqsave(&cache_lock);
  
-     stats->hits = cache_stats.hits;
-     stats->misses = cache_stats.misses;
-     stats->reads = cache_stats.reads;
-     stats->writes = cache_stats.writes;
-     stats->evictions = cache_stats.evictions;
-     stats->alloc_failures = cache_stats.alloc_failures;
-     stats->io_errors = cache_stats.io_errors;
+     stats->hits = (uint32_t)percpu_counter_sum(&cache_stats.hits);
+     stats->misses = (uint32_t)percpu_counter_sum(&cache_stats.misses);
+     stats->reads = (uint32_t)percpu_counter_sum(&cache_stats.reads);
+     stats->writes = (uint32_t)percpu_counter_sum(&cache_stats.writes);
+     stats->evictions = (uint32_t)percpu_counter_sum(&cache_stats.evictions);
+     stats->alloc_failures = (uint32_t)percpu_counter_sum(&cache_stats.alloc_failures);
+     stats->io_errors = (uint32_t)percpu_counter_sum(&cache_stats.io_errors);
+     stats->readahead_blocks = (uint32_t)percpu_counter_sum(&cache_stats.readahead_blocks);
+     stats->policy = cache_policy;
+     stats->hits_in = (uint32_t)percpu_counter_sum(&cache_stats.hits_in);
+     stats->hits_hot = (uint32_t)percpu_counter_sum(&cache_stats.hits_hot);
+     stats->misses_in = (uint32_t)percpu_counter_sum(&cache_stats.misses_in);
+     stats->misses_hot = (uint32_t)percpu_counter_sum(&cache_stats.misses_hot);
+     stats->coalesced = (uint32_t)percpu_counter_sum(&cache_stats.coalesced);
+     stats->in_buffers = lru_lists[BUFFER_LIST_IN].count;
+     stats->hot_buffers = lru_lists[BUFFER_LIST_HOT].count;
+     stats->pool_buffers = buffer_pool.slots;
+     stats->pool_free = buffer_pool.free_count[POOL_SMALL] + buffer_pool.free_count[POOL_FRAME];
  
      // Count current buffers
      stats->cached_buffers = 0;
      stats->dirty_buffers = 0;
  
-     buffer_t *buf = lru_head;
-     while (buf) {
-         stats->cached_buffers++;
-         if (buf->flags & BUFFER_FLAG_DIRTY) {
-             stats->dirty_buffers++;
+     for (uint32_t list = BUFFER_LIST_IN; list < BUFFER_LIST_COUNT; list++) {
+         for (buffer_t *buf = lru_lists[list].head; buf; buf = buf->lru_next) {
+             stats->cached_buffers++;
+             if (buf->flags & BUFFER_FLAG_DIRTY) {
+                 stats->dirty_buffers++;
+             }
          }
-         buf = buf->lru_next;
      }
  
      spinlock_release_irqrestore(&cache_lock, irq_state);
@@ -729,20 +1836,20 @@
  /**
   * Invalidate all buffers for a specific device
   */
- void buffer_invalidate_device(const char *device_name) {
-     if (!device_name) return;
+ void buffer_invalidate_device(disk_t *disk) {
+     if (!disk) return;
  
      uintptr_t irq_state = spinlock_acquire_irqsave(&cache_lock);
  
      int invalidated = 0;
  
      // Check all hash buckets
-     for (uint32_t i = 0; i < BUFFER_CACHE_HASH_SIZE; i++) {
+     for (uint32_t i = 0; i < buffer_hash_size; i++) {
          buffer_t **pp = &buffer_hash_table[i];
          while (*pp) {
              buffer_t *buf = *pp;
  
-             if (buf->disk && strcmp(buf->disk->blk_dev.device_name, device_name) == 0) {
+             if (buf->disk == disk) {
                  // Check if buffer can be invalidated
                  if (buf->ref_count > 0) {
                      // Skip buffers still in use
@@ -750,13 +1857,13 @@
                  } else {
                      // Remove from hash table
                      *pp = buf->hash_next;
+                     cached_count--;
  
                      // Remove from LRU list
                      lru_remove(buf);
  
-                     // Free the buffer
-                     kfree(buf->data);
-                     kfree(buf);
+                     // Back to the pool
+                     buffer_pool_push(buf);
  
                      invalidated++;
                  }
@@ -769,6 +1876,68 @@
      spinlock_release_irqrestore(&cache_lock, irq_state);
  
      terminal_printf("[BufferCache] Invalidated %d buffers for device '%s'.\n",
-                     invalidated, device_name);
+                     invalidated, disk->blk_dev.device_name);
+ }
+ 
+
+ /**
+  * Switch a disk to multi-sector blocks from base_lba on (e.g. one FAT cluster
+  * per buffer). The block size is the largest power of two dividing
+  * sectors_per_block within a pool frame and MAX_SECTORS_PER_IO, so
+  * blocks never straddle the caller's allocation units.
+  * Cached buffers of the disk are written back and dropped first, since their
+  * extents would overlap the new blocks; fails with -FS_ERR_BUSY if any are
+  * still referenced.
+  */
+ int buffer_set_block_geometry(disk_t *disk, uint32_t base_lba, uint32_t sectors_per_block) {
+     if (!disk || !disk->initialized || sectors_per_block == 0) return -FS_ERR_INVALID_PARAM;
+     const char *device_name = disk->blk_dev.device_name;
+ 
+     // Blocks live in pool frames, which are smaller than MAX_BUFFER_BLOCK_SIZE
+     uint32_t limit = BUFFER_POOL_FRAME_SIZE / disk->blk_dev.sector_size;
+     if (limit > MAX_SECTORS_PER_IO) limit = MAX_SECTORS_PER_IO;
+     uint32_t per_block = 1;
+     while (per_block * 2 <= limit && sectors_per_block % (per_block * 2) == 0) {
+         per_block *= 2;
+     }
+ 
+     buffer_cache_sync();
+ 
+     uintptr_t irq_state = spinlock_acquire_irqsave(&cache_lock);
+ 
+     int busy = 0;
+     for (uint32_t i = 0; i < buffer_hash_size; i++) {
+         buffer_t **pp = &buffer_hash_table[i];
+         while (*pp) {
+             buffer_t *buf = *pp;
+             if (buf->disk != disk) {
+                 pp = &buf->hash_next;
+             } else if (buf->ref_count > 0 || (buf->flags & BUFFER_FLAG_DIRTY)) {
+                 busy++; // In use, or dirtied again since the sync
+                 pp = &buf->hash_next;
+             } else {
+                 *pp = buf->hash_next;
+                 cached_count--;
+                 lru_remove(buf);
+                 buffer_pool_push(buf);
+             }
+         }
+     }
+ 
+     if (busy == 0) {
+         disk->cache_block_base = base_lba;
+         disk->cache_block_sectors = per_block;
+     }
+ 
+     spinlock_release_irqrestore(&cache_lock, irq_state);
+ 
+     if (busy) {
+         terminal_printf("[BufferCache] Cannot change block geometry of '%s': %d buffers in use.\n",
+                         device_name, busy);
+         return -FS_ERR_BUSY;
+     }
+ 
+     terminal_printf("[BufferCache] '%s': %lu-sector blocks from LBA %lu.\n",
+                     device_name, (unsigned long)per_block, (unsigned long)base_lba);
+     return 0;
  }
- 
\ No newline at end of file
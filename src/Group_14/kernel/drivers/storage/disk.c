@@ -6,6 +6,7 @@
 
  #include <kernel/drivers/storage/disk.h>
  #include <kernel/drivers/storage/block_device.h>   // Underlying device operations
+ #include <kernel/drivers/storage/block_queue.h>    // Request queue in front of it
  #include <kernel/drivers/display/terminal.h>       // Logging
  #include <kernel/fs/vfs/fs_errno.h>       // Error codes
  #include <kernel/memory/kmalloc.h>        // For temporary buffer allocation
@@ -129,8 +130,8 @@
           return FS_ERR_OUT_OF_BOUNDS;
      }
  
-     // Delegate directly to the block device function
-     int ret = block_device_read(&disk->blk_dev, lba, buffer, count);
+     // Through the device's request queue, where it may merge with others
+     int ret = block_queue_read(&disk->blk_dev, lba, buffer, count);
      if (ret != FS_SUCCESS) {
          // <<< FIX: Use %lu for size_t, %llu for uint64_t >>>
          terminal_printf("[Disk] read_raw: Block device read failed for %lu sectors at LBA %llu.\n", (unsigned long)count, lba);
@@ -145,9 +146,10 @@
   * @param lba The starting Logical Block Address (absolute on disk).
   * @param buffer Pointer to the buffer containing data to write.
   * @param count Number of sectors to write.
+  * @param fua Write through the drive's cache (durable on return).
   * @return FS_SUCCESS on success, negative error code on failure.
   */
- int disk_write_raw_sectors(disk_t *disk, uint64_t lba, const void *buffer, size_t count) {
+ static int disk_write_raw(disk_t *disk, uint64_t lba, const void *buffer, size_t count, bool fua) {
      if (!disk || !disk->initialized || !buffer || count == 0) {
          // <<< FIX: Use %lu for size_t >>>
          terminal_printf("[Disk] write_raw: Error - Invalid parameters (disk=%p, init=%d, buf=%p, count=%lu).\n",
@@ -163,16 +165,59 @@
           return FS_ERR_OUT_OF_BOUNDS;
      }
  
-     // Delegate directly to the block device function
-     int ret = block_device_write(&disk->blk_dev, lba, buffer, count);
+     // Through the device's request queue, where it may merge with others
+     int ret = fua ? block_queue_write_fua(&disk->blk_dev, lba, buffer, count)
+                   : block_queue_write(&disk->blk_dev, lba, buffer, count);
      if (ret != FS_SUCCESS) {
          // <<< FIX: Use %lu for size_t, %llu for uint64_t >>>
          terminal_printf("[Disk] write_raw: Block device write failed for %lu sectors at LBA %llu.\n", (unsigned long)count, lba);
      }
      return ret;
  }
+
+ int disk_write_raw_sectors(disk_t *disk, uint64_t lba, const void *buffer, size_t count) {
+     return disk_write_raw(disk, lba, buffer, count, false);
+ }
+
+ /**
+  * @brief Writes sectors that are durable once this returns (FUA, or write + flush).
+  */
+ int disk_write_raw_sectors_fua(disk_t *disk, uint64_t lba, const void *buffer, size_t count) {
+     return disk_write_raw(disk, lba, buffer, count, true);
+ }
+
+ /**
+  * @brief Flushes the drive's write cache (no-op if nothing was written since the last flush).
+  * @param disk Pointer to the initialized disk_t structure.
+  * @return FS_SUCCESS on success, negative error code on failure.
+  */
+ int disk_flush(disk_t *disk) {
+     if (!disk || !disk->initialized) return FS_ERR_INVALID_PARAM;
+     int ret = block_device_flush(&disk->blk_dev);
+     if (ret != BLOCK_ERR_OK) {
+         terminal_printf("[Disk] flush: Cache flush failed on '%s' (err %d).\n", disk->blk_dev.device_name, ret);
+         return FS_ERR_IO;
+     }
+     return FS_SUCCESS;
+ }
  
  
+ /**
+  * @brief Queues a raw request without waiting for it (see block_queue.h).
+  * @param disk Pointer to the initialized disk_t structure.
+  * @param req Request to submit; req->done reports its completion.
+  * @return FS_SUCCESS if queued, negative error code if rejected.
+  */
+ int disk_submit_raw_sectors(disk_t *disk, block_request_t *req) {
+     if (!disk || !disk->initialized || !req) {
+         terminal_printf("[Disk] submit_raw: Error - Invalid parameters (disk=%p, req=%p).\n", disk, req);
+         return FS_ERR_INVALID_PARAM;
+     }
+     int ret = block_queue_submit(&disk->blk_dev, req);
+     if (ret == BLOCK_ERR_BOUNDS) return FS_ERR_OUT_OF_BOUNDS;
+     return (ret == BLOCK_ERR_OK) ? FS_SUCCESS : FS_ERR_INVALID_PARAM;
+ }
+
  /**
   * @brief Reads sectors from a specific partition.
   * Translates the partition-relative LBA to an absolute disk LBA and performs bounds checks.
@@ -0,0 +1,102 @@
+/**
+ * @file ramdisk.c
+ * @brief RAM-backed block devices (ram0..ram3).
+ *
+ * A disk's memory is an array of RAMDISK_CHUNK_ORDER buddy blocks, so a
+ * large disk needs no physically contiguous region. Sector N lives in
+ * chunk N / (chunk sectors); a transfer copies chunk by chunk. Concurrent
+ * transfers need no lock: like a drive, overlapping writes land in some
+ * order and a disk is never freed once created.
+ */
+
+ #include <kernel/drivers/storage/ramdisk.h>
+ #include <kernel/drivers/display/terminal.h>
+ #include <kernel/memory/buddy.h>
+ #include <kernel/memory/kmalloc.h>
+ #include <kernel/lib/string.h>
+
+ #define RAMDISK_CHUNK_SIZE     (1u << RAMDISK_CHUNK_ORDER)
+ #define RAMDISK_CHUNK_SECTORS  (RAMDISK_CHUNK_SIZE / RAMDISK_SECTOR_SIZE)
+ #define RAMDISK_SECTOR_SHIFT   9 // log2(RAMDISK_SECTOR_SIZE)
+
+ typedef struct {
+     bool      present;
+     uint32_t  chunk_count;
+     uint8_t **chunks;
+ } ramdisk_t;
+
+ static ramdisk_t g_ramdisks[RAMDISK_MAX_DISKS];
+
+ int ramdisk_create(int index, size_t size, const void *image, size_t image_len) {
+     if (index < 0 || index >= RAMDISK_MAX_DISKS || size == 0) return BLOCK_ERR_PARAMS;
+     ramdisk_t *rd = &g_ramdisks[index];
+     if (rd->present || image_len > size) return BLOCK_ERR_PARAMS;
+
+     uint32_t chunk_count = (uint32_t)((size + RAMDISK_CHUNK_SIZE - 1) >> RAMDISK_CHUNK_ORDER);
+     uint8_t **chunks = kmalloc(chunk_count * sizeof(uint8_t *));
+     if (!chunks) return BLOCK_ERR_INTERNAL;
+     size_t got = buddy_alloc_raw_batch(RAMDISK_CHUNK_ORDER, MIGRATE_UNMOVABLE, (void **)chunks, chunk_count);
+     if (got < chunk_count) {
+         terminal_printf("[RAMDISK] ram%d: only %lu of %lu chunks available.\n",
+                         index, (unsigned long)got, (unsigned long)chunk_count);
+         buddy_free_raw_batch((void *const *)chunks, got, RAMDISK_CHUNK_ORDER);
+         kfree(chunks);
+         return BLOCK_ERR_INTERNAL;
+     }
+
+     const uint8_t *src = (const uint8_t *)image;
+     for (uint32_t i = 0; i < chunk_count; i++) {
+         size_t offset = (size_t)i << RAMDISK_CHUNK_ORDER;
+         size_t from_image = 0;
+         if (src && offset < image_len) {
+             from_image = image_len - offset;
+             if (from_image > RAMDISK_CHUNK_SIZE) from_image = RAMDISK_CHUNK_SIZE;
+             memcpy(chunks[i], src + offset, from_image);
+         }
+         memset(chunks[i] + from_image, 0, RAMDISK_CHUNK_SIZE - from_image);
+     }
+
+     rd->chunks = chunks;
+     rd->chunk_count = chunk_count;
+     rd->present = true;
+     terminal_printf("[RAMDISK] ram%d: %lu KiB (%lu bytes from image).\n", index,
+                     (unsigned long)(chunk_count * (RAMDISK_CHUNK_SIZE / 1024)), (unsigned long)image_len);
+     return BLOCK_ERR_OK;
+ }
+
+ int ramdisk_device_init(int index, block_device_t *dev) {
+     if (!dev || index < 0 || index >= RAMDISK_MAX_DISKS || !g_ramdisks[index].present) return BLOCK_ERR_NO_DEV;
+     ramdisk_t *rd = &g_ramdisks[index];
+
+     dev->transport = BLOCK_TRANSPORT_RAM;
+     dev->driver_data = rd;
+     dev->sector_size = RAMDISK_SECTOR_SIZE;
+     dev->total_sectors = (uint64_t)rd->chunk_count * RAMDISK_CHUNK_SECTORS;
+     dev->lba48_supported = true;
+     dev->initialized = true;
+     terminal_printf("[RAMDISK] %s: %llu sectors of %lu bytes.\n",
+                     dev->device_name, dev->total_sectors, (unsigned long)dev->sector_size);
+     return BLOCK_ERR_OK;
+ }
+
+ int ramdisk_transfer(block_device_t *dev, uint64_t lba, void *buffer, size_t count, bool write) {
+     if (!dev || !dev->initialized || !buffer || count == 0) return BLOCK_ERR_PARAMS;
+     if (lba >= dev->total_sectors || count > dev->total_sectors - lba) return BLOCK_ERR_BOUNDS;
+     ramdisk_t *rd = (ramdisk_t *)dev->driver_data;
+
+     uint8_t *buf = (uint8_t *)buffer;
+     uint32_t sector = (uint32_t)lba; // The whole disk is in kernel memory, so it fits
+     while (count > 0) {
+         uint32_t in_chunk = sector % RAMDISK_CHUNK_SECTORS;
+         size_t n = RAMDISK_CHUNK_SECTORS - in_chunk;
+         if (n > count) n = count;
+         uint8_t *mem = rd->chunks[sector / RAMDISK_CHUNK_SECTORS] + ((size_t)in_chunk << RAMDISK_SECTOR_SHIFT);
+         size_t bytes = n << RAMDISK_SECTOR_SHIFT;
+         if (write) memcpy(mem, buf, bytes);
+         else       memcpy(buf, mem, bytes);
+         buf += bytes;
+         sector += (uint32_t)n;
+         count -= n;
+     }
+     return BLOCK_ERR_OK;
+ }
@@ -0,0 +1,171 @@
+/**
+ * @file clock.c
+ * @brief TSC-based monotonic nanosecond clock, calibrated against the HPET
+ * or the PIT.
+ */
+
+#include <kernel/drivers/timer/clock.h>
+#include <kernel/drivers/timer/pit.h>
+#include <kernel/drivers/timer/hpet.h>
+#include <kernel/cpu/tsc.h>
+#include <kernel/cpu/cpuid.h>
+#include <kernel/lib/div64.h>
+#include <kernel/process/scheduler.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/drivers/display/serial.h>
+
+#define CLOCK_INFO(fmt, ...)  serial_printf("[Clock INFO ] " fmt "\n", ##__VA_ARGS__)
+
+#define CPUID_FEATURE_TSC       (1u << 4)
+#define CLOCK_CALIBRATE_US      10000   // Length of one timed window
+#define FSEC_PER_NSEC           1000000u
+#define CLOCK_CALIBRATE_RUNS    3
+
+// Conversion ns = (cycles * s_mult) >> s_shift, with s_mult kept in 32 bits.
+static uint32_t s_tsc_khz = 0;
+static uint32_t s_mult = 0;
+static uint32_t s_shift = 0;
+static uint64_t s_tsc_base = 0;
+
+// HPET fallback without a TSC: ns = (counts * s_hpet_mult) >> s_hpet_shift.
+static uint32_t s_hpet_mult = 0;
+static uint32_t s_hpet_shift = 0;
+static uint64_t s_hpet_base = 0;
+
+// Tick fallback: extends the 32-bit scheduler tick counter to 64 bits.
+static spinlock_t s_tick_lock;
+static uint32_t   s_last_ticks = 0;
+static uint32_t   s_tick_wraps = 0;
+
+//============================================================================
+// Helpers
+//============================================================================
+static bool cpu_has_tsc(void) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    return (edx & CPUID_FEATURE_TSC) != 0;
+}
+
+/**
+ * @brief TSC cycles in one timed window, measured on the HPET when there is
+ * one and on PIT channel 2 otherwise. The shortest of several runs is kept,
+ * since an interrupt or a host preemption can only stretch a window.
+ */
+static uint32_t measure_window_cycles(void) {
+    uint32_t best = 0xFFFFFFFFu;
+    bool hpet = hpet_available();
+    for (int run = 0; run < CLOCK_CALIBRATE_RUNS; run++) {
+        uint64_t start = read_tsc();
+        if (hpet) hpet_delay_us(CLOCK_CALIBRATE_US);
+        else pit_delay_us(CLOCK_CALIBRATE_US);
+        uint64_t delta = read_tsc() - start;
+        uint32_t cycles = (delta >> 32) ? 0xFFFFFFFFu : (uint32_t)delta;
+        if (cycles < best) best = cycles;
+    }
+    return best;
+}
+
+/**
+ * @brief Picks the largest shift (at most 32) for which
+ * mult = (num << shift) / den still fits in 32 bits; num is below 2^32.
+ */
+static void compute_mult_shift(uint32_t num, uint32_t den, uint32_t *mult, uint32_t *shift) {
+    uint32_t s = 32;
+    while (s > 0 && (uint32_t)(((uint64_t)num << s) >> 32) >= den) s--;
+    *shift = s;
+    *mult = (uint32_t)div_u64_rem((uint64_t)num << s, den, NULL);
+}
+
+// (count * mult) >> shift as a 64x32 multiply split at 32 bits, so the
+// product never needs 96 bits.
+static uint64_t scale_count(uint64_t count, uint32_t mult, uint32_t shift) {
+    uint32_t hi = (uint32_t)(count >> 32);
+    uint32_t lo = (uint32_t)count;
+    uint64_t ns = ((uint64_t)lo * mult) >> shift;
+    if (hi) ns += ((uint64_t)hi * mult) << (32 - shift);
+    return ns;
+}
+
+// Without a TSC a 64-bit HPET counter is the next best clocksource; a 32-bit
+// one would wrap within minutes with nothing to notice.
+static void use_hpet_clocksource(void) {
+    if (!hpet_available() || !hpet_counter_is_64bit()) {
+        CLOCK_INFO("Monotonic clock runs on the %lu Hz scheduler tick.", (unsigned long)TARGET_FREQUENCY);
+        return;
+    }
+    compute_mult_shift(hpet_period_fs(), FSEC_PER_NSEC, &s_hpet_mult, &s_hpet_shift);
+    s_hpet_base = hpet_read_counter();
+    CLOCK_INFO("Monotonic clock runs on the HPET (mult %lu, shift %lu)",
+               (unsigned long)s_hpet_mult, (unsigned long)s_hpet_shift);
+}
+
+static uint64_t tick_ns(void) {
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_tick_lock);
+    uint32_t ticks = scheduler_get_ticks();
+    if (ticks < s_last_ticks) s_tick_wraps++;
+    s_last_ticks = ticks;
+    uint64_t total = ((uint64_t)s_tick_wraps << 32) | ticks;
+    spinlock_release_irqrestore(&s_tick_lock, irq_flags);
+    return total * (NSEC_PER_SEC / TARGET_FREQUENCY);
+}
+
+//============================================================================
+// Public API
+//============================================================================
+void clock_init(void) {
+    spinlock_init(&s_tick_lock);
+    if (!cpu_has_tsc()) {
+        CLOCK_INFO("No TSC.");
+        use_hpet_clocksource();
+        return;
+    }
+
+    uintptr_t irq_flags = local_irq_save();
+    uint32_t cycles = measure_window_cycles();
+    s_tsc_base = read_tsc();
+    local_irq_restore(irq_flags);
+
+    uint32_t khz = cycles / (CLOCK_CALIBRATE_US / 1000);
+    if (khz == 0) {
+        CLOCK_INFO("TSC calibration failed (%lu cycles per window).", (unsigned long)cycles);
+        use_hpet_clocksource();
+        return;
+    }
+    compute_mult_shift(NSEC_PER_MSEC, khz, &s_mult, &s_shift);
+    s_tsc_khz = khz;
+    CLOCK_INFO("TSC calibrated against the %s at %lu.%03lu MHz (mult %lu, shift %lu)",
+               hpet_available() ? "HPET" : "PIT",
+               (unsigned long)(khz / 1000), (unsigned long)(khz % 1000),
+               (unsigned long)s_mult, (unsigned long)s_shift);
+}
+
+bool clock_tsc_active(void) {
+    return s_tsc_khz != 0;
+}
+
+uint32_t clock_tsc_khz(void) {
+    return s_tsc_khz;
+}
+
+void clock_get_tsc_params(uint32_t *mult, uint32_t *shift, uint64_t *base) {
+    *mult = s_mult;
+    *shift = s_shift;
+    *base = s_tsc_base;
+}
+
+uint64_t clock_cycles_to_ns(uint64_t cycles) {
+    if (!s_tsc_khz) return 0;
+    return scale_count(cycles, s_mult, s_shift);
+}
+
+uint64_t clock_monotonic_ns(void) {
+    if (s_tsc_khz) return clock_cycles_to_ns(read_tsc() - s_tsc_base);
+    if (s_hpet_mult) return scale_count(hpet_read_counter() - s_hpet_base, s_hpet_mult, s_hpet_shift);
+    return tick_ns();
+}
+
+void clock_ns_to_timespec(uint64_t ns, clock_timespec_t *ts) {
+    uint32_t nsec;
+    ts->tv_sec = (int64_t)div_u64_rem(ns, NSEC_PER_SEC, &nsec);
+    ts->tv_nsec = nsec;
+}
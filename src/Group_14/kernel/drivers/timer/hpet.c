@@ -0,0 +1,164 @@
+/**
+ * @file hpet.c
+ * @brief HPET main counter and comparator 0.
+ */
+
+#include <kernel/drivers/timer/hpet.h>
+#include <kernel/cpu/acpi.h>
+#include <kernel/memory/paging.h>
+#include <kernel/lib/div64.h>
+#include <kernel/drivers/display/serial.h>
+
+#define HPET_INFO(fmt, ...)  serial_printf("[HPET INFO ] " fmt "\n", ##__VA_ARGS__)
+#define HPET_ERROR(fmt, ...) serial_printf("[HPET ERROR] %s:%d: " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
+
+// Register offsets (all registers are 64-bit; i386 accesses them as dword halves)
+#define HPET_REG_GCAP_ID        0x000
+#define HPET_REG_PERIOD         0x004 // High half of GCAP_ID
+#define HPET_REG_GEN_CONF       0x010
+#define HPET_REG_MAIN_CNT_LO    0x0F0
+#define HPET_REG_MAIN_CNT_HI    0x0F4
+#define HPET_REG_T0_CONF        0x100
+#define HPET_REG_T0_CMP         0x108
+
+#define HPET_GCAP_COUNT_SIZE    (1u << 13)
+#define HPET_GCAP_LEG_RT        (1u << 15)
+#define HPET_CONF_ENABLE        (1u << 0)
+#define HPET_CONF_LEG_RT        (1u << 1)
+
+#define HPET_TN_INT_TYPE_LEVEL  (1u << 1)
+#define HPET_TN_INT_ENB         (1u << 2)
+#define HPET_TN_TYPE_PERIODIC   (1u << 3)
+#define HPET_TN_VAL_SET         (1u << 6)
+#define HPET_TN_32MODE          (1u << 8)
+#define HPET_TN_FSB_EN          (1u << 14)
+
+#define HPET_MMIO_SIZE          0x400
+#define HPET_MAX_PERIOD_FS      100000000u // 100 ns: the spec's 10 MHz minimum
+#define HPET_FS_PER_US          1000000000u
+#define HPET_MIN_DELTA          16 // Counts closer than this are taken as already reached
+
+static volatile uint32_t *s_hpet = NULL;
+static uint32_t           s_period_fs = 0;
+static uint32_t           s_freq_hz = 0;
+static bool               s_counter_64 = false;
+
+//============================================================================
+// Register Access
+//============================================================================
+static inline uint32_t hpet_read(uint32_t reg) {
+    return s_hpet[reg / 4];
+}
+
+static inline void hpet_write(uint32_t reg, uint32_t value) {
+    s_hpet[reg / 4] = value;
+}
+
+//============================================================================
+// Public API
+//============================================================================
+bool hpet_init(void) {
+    uint32_t phys = acpi_get_hpet_phys();
+    if (!phys) return false;
+
+    s_hpet = (volatile uint32_t *)paging_map_mmio(phys, HPET_MMIO_SIZE);
+    if (!s_hpet) {
+        HPET_ERROR("Could not map the HPET at P=%#lx", (unsigned long)phys);
+        return false;
+    }
+    uint32_t period = hpet_read(HPET_REG_PERIOD);
+    if (period == 0 || period > HPET_MAX_PERIOD_FS) {
+        HPET_ERROR("Bad counter period %lu fs; HPET not used", (unsigned long)period);
+        s_hpet = NULL;
+        return false;
+    }
+    uint32_t cap = hpet_read(HPET_REG_GCAP_ID);
+    s_counter_64 = (cap & HPET_GCAP_COUNT_SIZE) != 0;
+    s_period_fs = period;
+    s_freq_hz = (uint32_t)div_u64_rem(1000000000000000ull + period / 2, period, NULL);
+
+    // Comparator 0 stays quiet until hpet_event_init(); the counter runs from here on.
+    hpet_write(HPET_REG_T0_CONF, hpet_read(HPET_REG_T0_CONF) & ~HPET_TN_INT_ENB);
+    hpet_write(HPET_REG_GEN_CONF, hpet_read(HPET_REG_GEN_CONF) | HPET_CONF_ENABLE);
+
+    HPET_INFO("%lu Hz, %u-bit counter, %lu comparators%s",
+              (unsigned long)s_freq_hz, s_counter_64 ? 64 : 32,
+              (unsigned long)(((cap >> 8) & 0x1F) + 1),
+              (cap & HPET_GCAP_LEG_RT) ? ", legacy replacement" : "");
+    return true;
+}
+
+bool hpet_available(void) {
+    return s_hpet != NULL;
+}
+
+bool hpet_counter_is_64bit(void) {
+    return s_counter_64;
+}
+
+uint32_t hpet_period_fs(void) {
+    return s_period_fs;
+}
+
+uint32_t hpet_frequency_hz(void) {
+    return s_freq_hz;
+}
+
+uint64_t hpet_read_counter(void) {
+    if (!s_hpet) return 0;
+    if (!s_counter_64) return hpet_read(HPET_REG_MAIN_CNT_LO);
+    // The low word may carry into the high one between the two reads
+    uint32_t hi, lo;
+    do {
+        hi = hpet_read(HPET_REG_MAIN_CNT_HI);
+        lo = hpet_read(HPET_REG_MAIN_CNT_LO);
+    } while (hi != hpet_read(HPET_REG_MAIN_CNT_HI));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+uint32_t hpet_read_counter_lo(void) {
+    return s_hpet ? hpet_read(HPET_REG_MAIN_CNT_LO) : 0;
+}
+
+uint32_t hpet_us_to_counts(uint32_t us) {
+    if (!s_period_fs) return 0;
+    return (uint32_t)div_u64_rem((uint64_t)us * HPET_FS_PER_US, s_period_fs, NULL);
+}
+
+void hpet_delay_us(uint32_t us) {
+    if (!s_hpet) return;
+    uint32_t counts = hpet_us_to_counts(us);
+    uint32_t start = hpet_read_counter_lo();
+    while (hpet_read_counter_lo() - start < counts) {
+        asm volatile("pause");
+    }
+}
+
+bool hpet_event_init(void) {
+    if (!s_hpet) return false;
+    if (!(hpet_read(HPET_REG_GCAP_ID) & HPET_GCAP_LEG_RT)) {
+        HPET_INFO("No legacy replacement route; comparator 0 not used");
+        return false;
+    }
+    uint32_t conf = hpet_read(HPET_REG_T0_CONF);
+    conf &= ~(HPET_TN_INT_TYPE_LEVEL | HPET_TN_TYPE_PERIODIC | HPET_TN_VAL_SET | HPET_TN_FSB_EN);
+    conf |= HPET_TN_32MODE;
+    hpet_write(HPET_REG_T0_CONF, conf);
+    // Far behind the counter, so nothing fires before the first hpet_event_arm()
+    hpet_write(HPET_REG_T0_CMP, hpet_read_counter_lo() - 1);
+    hpet_write(HPET_REG_T0_CONF, conf | HPET_TN_INT_ENB);
+    hpet_write(HPET_REG_GEN_CONF, hpet_read(HPET_REG_GEN_CONF) | HPET_CONF_LEG_RT);
+    return true;
+}
+
+bool hpet_event_arm(uint32_t deadline) {
+    if (!s_hpet) return false;
+    hpet_write(HPET_REG_T0_CMP, deadline);
+    // A match that is passed before the write lands never fires
+    return (int32_t)(deadline - hpet_read_counter_lo()) >= HPET_MIN_DELTA;
+}
+
+void hpet_event_stop(void) {
+    if (!s_hpet) return;
+    hpet_write(HPET_REG_T0_CONF, hpet_read(HPET_REG_T0_CONF) & ~HPET_TN_INT_ENB);
+}
@@ -8,6 +8,8 @@
  */
 
  #include <kernel/drivers/timer/pit.h>
+ #include <kernel/drivers/timer/tick.h> // HPET comparator 0 shares IRQ0
+ #include <kernel/core/profiler.h>        // profile_tick
  #include <kernel/cpu/idt.h>       // Needed for register_int_handler and PIC/EOI defines
  #include <kernel/cpu/isr_frame.h>  // Include the frame definition
  #include <kernel/drivers/display/terminal.h>
@@ -23,18 +25,14 @@
  #define TARGET_FREQUENCY 1000 // Default to 1000 Hz if not defined
  #endif
 
- // PIC EOI definitions (can also be from idt.h or a dedicated pic.h)
- #ifndef PIC_EOI
- #define PIC_EOI      0x20      /* End-of-interrupt command code */
- #endif
- #ifndef PIC1_COMMAND
- #define PIC1_COMMAND 0x20
- #endif
- #ifndef PIC2_COMMAND
- #define PIC2_COMMAND 0xA0
- #endif
  #define IRQ_PIT 0         // Timer is IRQ line 0 on the master PIC
 
+ // Tickless idle state. While a one-shot is armed the periodic tick is
+ // stopped and g_tick_count is caught up when the one-shot ends.
+ static volatile bool s_oneshot_armed = false;
+ static uint32_t      s_oneshot_ticks = 0;  // Ticks covered by the armed one-shot
+ static uint32_t      s_oneshot_count = 0;  // PIT counts programmed for it
+
  // --- Revised Workaround Helper ---
  static inline uint32_t calculate_ticks_32bit(uint32_t ms, uint32_t freq_hz) {
      if (ms == 0) return 0;
@@ -83,41 +81,46 @@
      return total_ticks;
  }
 
-/**
- * @brief Sends End-Of-Interrupt (EOI) to the PIC(s).
- * @param irq_line The IRQ line number (0-15) that was serviced.
- */
-static inline void pic_send_eoi_line(uint8_t irq_line)
-{
-    if (irq_line >= 8) { // IRQ 8-15 are on the slave PIC
-        outb(PIC2_COMMAND, PIC_EOI);
-    }
-    outb(PIC1_COMMAND, PIC_EOI); // Always send EOI to master PIC
-}
-
  /**
   * PIT IRQ handler:
   * Performs essential timekeeping (implicitly via scheduler_tick's start),
   * ACKs the interrupt with the PIC *before* potentially rescheduling,
   * then calls the scheduler logic which might switch tasks.
   */
+ static void set_pit_frequency(uint32_t freq);
+
  static void pit_irq_handler(isr_frame_t *frame) {
-     (void)frame;    // Mark frame as unused if not directly accessed
+     profile_tick(frame); // Where IRQ0 interrupted this CPU, when the profiler runs
+
+     // In HPET legacy replacement mode IRQ0 comes from HPET comparator 0
+     if (tick_hpet_active()) {
+         irq_send_eoi(IRQ_PIT);
+         tick_hpet_interrupt();
+         return;
+     }
+
+     // One-shot expiry: restore the periodic tick and account for the ticks
+     // that were skipped while idle (the final one is counted by scheduler_tick).
+     if (s_oneshot_armed) {
+         s_oneshot_armed = false;
+         set_pit_frequency(TARGET_FREQUENCY);
+         if (s_oneshot_ticks > 1) scheduler_advance_ticks(s_oneshot_ticks - 1);
+     }
 
      // As per the latest advice:
      // 1. Timekeeping / scheduler-tick bookkeeping (scheduler_tick() handles g_tick_count++)
      // 2. ACK the interrupt **before** doing anything that may reschedule.
-     // 3. Hand control to the scheduler (scheduler_tick() may call schedule()).
+     // 3. Hand control to the scheduler (scheduler_tick() may ask irq_exit() to reschedule).
 
      // Increment tick count (this happens as the first step in scheduler_tick)
      // If scheduler_tick() were not called, and this handler directly called schedule(),
      // then g_tick_count++ would happen here.
 
-     pic_send_eoi_line(IRQ_PIT); // Send EOI for IRQ 0 (timer) *BEFORE* scheduler_tick
+     irq_send_eoi(IRQ_PIT); // Send EOI for IRQ 0 (timer) *BEFORE* scheduler_tick
 
      // Now, call the scheduler's tick processing.
-     // This function handles g_tick_count increment, waking sleeping tasks,
-     // managing time slices, and potentially calling schedule().
+     // This function handles g_tick_count increment and time slices; waking
+     // sleeping tasks is deferred to SOFTIRQ_SCHED.
      scheduler_tick();
  }
 
@@ -144,12 +147,101 @@ static inline void pic_send_eoi_line(uint8_t irq_line)
       io_wait(); // Short delay
  }
 
+ uint32_t pit_max_oneshot_ticks(void) {
+     return 0xFFFFu / DIVIDER;
+ }
+
+ void pit_start_oneshot(uint32_t ticks) {
+     uint32_t max_ticks = pit_max_oneshot_ticks();
+     if (ticks == 0) ticks = 1;
+     if (ticks > max_ticks) ticks = max_ticks;
+
+     uint32_t count = ticks * DIVIDER;
+     s_oneshot_ticks = ticks;
+     s_oneshot_count = count;
+     s_oneshot_armed = true;
+
+     outb(PIT_CMD_PORT, 0x30); // Channel 0, lobyte/hibyte, mode 0 (interrupt on terminal count)
+     io_wait();
+     outb(PIT_CHANNEL0_PORT, (uint8_t)(count & 0xFF));
+     io_wait();
+     outb(PIT_CHANNEL0_PORT, (uint8_t)((count >> 8) & 0xFF)); // Counting starts here
+ }
+
+ void pit_stop_oneshot(void) {
+     uint32_t eflags;
+     asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+
+     // Another interrupt ended the idle period early: charge only the ticks
+     // that actually elapsed, then fall back to periodic mode.
+     if (s_oneshot_armed) {
+         outb(PIT_CMD_PORT, 0xC2); // Read-back: latch channel 0 status and count
+         uint8_t status = inb(PIT_CHANNEL0_PORT);
+         uint32_t remaining = inb(PIT_CHANNEL0_PORT);
+         remaining |= (uint32_t)inb(PIT_CHANNEL0_PORT) << 8;
+
+         s_oneshot_armed = false;
+         set_pit_frequency(TARGET_FREQUENCY);
+         uint32_t ticks;
+         if (status & 0x80) {
+             // OUT is high: the one-shot already reached terminal count and its
+             // IRQ0 is pending. Credit it as the IRQ handler would; the pending
+             // interrupt's scheduler_tick() counts the final tick.
+             ticks = s_oneshot_ticks - 1;
+         } else {
+             uint32_t elapsed = (remaining <= s_oneshot_count) ? (s_oneshot_count - remaining) : s_oneshot_count;
+             ticks = elapsed / DIVIDER;
+         }
+         if (ticks) scheduler_advance_ticks(ticks);
+     }
+
+     if (eflags & 0x200) asm volatile("sti");
+ }
+
+ void pit_delay_us(uint32_t us) {
+     // Channel 2 counts independently of channel 0 and the IRQ path; its
+     // OUT line is readable in bit 5 of port 0x61 and goes high at terminal count.
+     while (us > 0) {
+         uint32_t chunk = (us > 50000) ? 50000 : us; // 50 ms keeps the count in 16 bits
+         us -= chunk;
+         uint32_t count = (chunk * (PIT_BASE_FREQUENCY / 1000)) / 1000;
+         if (count == 0) count = 1;
+
+         uint8_t port61 = inb(PC_SPEAKER_PORT);
+         outb(PC_SPEAKER_PORT, port61 & ~0x03);   // Gate low, speaker off
+         outb(PIT_CMD_PORT, 0xB0);                // Channel 2, lobyte/hibyte, mode 0
+         outb(PIT_CHANNEL2_PORT, (uint8_t)(count & 0xFF));
+         outb(PIT_CHANNEL2_PORT, (uint8_t)((count >> 8) & 0xFF));
+         outb(PC_SPEAKER_PORT, (port61 & ~0x02) | 0x01); // Gate high: start counting
+         while (!(inb(PC_SPEAKER_PORT) & 0x20)) {
+             asm volatile("pause");
+         }
+         outb(PC_SPEAKER_PORT, port61);
+     }
+ }
+
  void init_pit(void) {
      register_int_handler(IRQ0_VECTOR, pit_irq_handler, NULL); // IRQ0 is vector 32
      set_pit_frequency(TARGET_FREQUENCY);
      terminal_printf("[PIT] Initialized (Target Frequency: %lu Hz)\n", (unsigned long)TARGET_FREQUENCY);
  }
 
+ void pit_disable_tick(void) {
+     uint32_t eflags;
+     asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+
+     s_oneshot_armed = false;
+     outb(PIC1_DATA, inb(PIC1_DATA) | (1u << IRQ_PIT)); // Mask IRQ0 at the master PIC
+     io_wait();
+     outb(PIT_CMD_PORT, 0x30); // Channel 0, mode 0: one final terminal count, then idle
+     io_wait();
+     outb(PIT_CHANNEL0_PORT, 0xFF);
+     io_wait();
+     outb(PIT_CHANNEL0_PORT, 0xFF);
+
+     if (eflags & 0x200) asm volatile("sti");
+ }
+
  void sleep_busy(uint32_t milliseconds) {
      uint32_t ticks_to_wait = calculate_ticks_32bit(milliseconds, TARGET_FREQUENCY);
      uint32_t start = get_pit_ticks();
@@ -0,0 +1,169 @@
+/**
+ * @file tick.c
+ * @brief Global scheduler tick on the PIT, the HPET or the bootstrap CPU's
+ * APIC timer.
+ */
+
+#include <kernel/drivers/timer/tick.h>
+#include <kernel/drivers/timer/pit.h>
+#include <kernel/drivers/timer/hpet.h>
+#include <kernel/cpu/lapic.h>
+#include <kernel/process/scheduler.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/drivers/display/terminal.h>
+
+static bool          s_lapic_tick = false;
+static uint32_t      s_counts_per_tick = 0;
+// Tickless idle state for the APIC timer (the PIT keeps its own in pit.c).
+static volatile bool s_oneshot_armed = false;
+static uint32_t      s_oneshot_ticks = 0;
+
+// HPET tick: comparator 0 fires on grid points s_hpet_last + n * counts per
+// tick (low counter word). Every ended wait counts the grid points passed
+// since s_hpet_last, so idle one-shots and late interrupts need no extra state.
+static volatile bool s_hpet_tick = false;
+static uint32_t      s_hpet_counts_per_tick = 0;
+static uint32_t      s_hpet_last = 0;
+
+//============================================================================
+// HPET
+//============================================================================
+// Grid points passed since s_hpet_last; moves s_hpet_last up to the latest.
+static uint32_t hpet_tick_elapsed(void) {
+    uint32_t ticks = (hpet_read_counter_lo() - s_hpet_last) / s_hpet_counts_per_tick;
+    s_hpet_last += ticks * s_hpet_counts_per_tick;
+    return ticks;
+}
+
+// Arms comparator 0 @p ticks grid points ahead; returns the ticks that
+// passed meanwhile (each missed deadline falls back to the next grid point).
+static uint32_t hpet_tick_arm(uint32_t ticks) {
+    uint32_t missed = 0;
+    while (!hpet_event_arm(s_hpet_last + ticks * s_hpet_counts_per_tick)) {
+        missed += hpet_tick_elapsed();
+        ticks = 1;
+    }
+    return missed;
+}
+
+void tick_use_hpet(void) {
+    if (!hpet_available() || s_lapic_tick) return;
+    uint32_t counts = hpet_us_to_counts(1000000u / TARGET_FREQUENCY);
+    if (counts == 0) return;
+
+    uintptr_t irq_flags = local_irq_save();
+    if (!hpet_event_init()) {
+        local_irq_restore(irq_flags);
+        return;
+    }
+    s_hpet_counts_per_tick = counts;
+    s_hpet_last = hpet_read_counter_lo();
+    s_hpet_tick = true;
+    uint32_t missed = hpet_tick_arm(1);
+    if (missed) scheduler_advance_ticks(missed);
+    local_irq_restore(irq_flags);
+    terminal_printf("[Tick] Scheduler tick moved from the PIT to the HPET (%lu Hz, %lu counts per tick).\n",
+                    (unsigned long)TARGET_FREQUENCY, (unsigned long)counts);
+}
+
+bool tick_hpet_active(void) {
+    return s_hpet_tick;
+}
+
+void tick_hpet_interrupt(void) {
+    uint32_t ticks = hpet_tick_elapsed();
+    if (ticks == 0) return; // Stale: tick_stop_oneshot() already re-armed
+    ticks += hpet_tick_arm(1);
+    // The final tick is counted by scheduler_tick(), the skipped ones here
+    if (ticks > 1) scheduler_advance_ticks(ticks - 1);
+    scheduler_tick();
+}
+
+//============================================================================
+// Local APIC
+//============================================================================
+
+void tick_use_lapic(uint32_t counts_per_tick) {
+    uintptr_t irq_flags = local_irq_save();
+    s_counts_per_tick = counts_per_tick ? counts_per_tick : 1;
+    pit_disable_tick();
+    if (s_hpet_tick) {
+        s_hpet_tick = false;
+        hpet_event_stop();
+    }
+    s_lapic_tick = true;
+    lapic_timer_start_periodic(s_counts_per_tick);
+    local_irq_restore(irq_flags);
+    terminal_printf("[Tick] Scheduler tick moved from the PIT to the local APIC timer (%lu Hz).\n",
+                    (unsigned long)TARGET_FREQUENCY);
+}
+
+bool tick_lapic_active(void) {
+    return s_lapic_tick;
+}
+
+void tick_lapic_interrupt(void) {
+    // One-shot expiry: restore the periodic tick and account for the ticks
+    // that were skipped while idle (the final one is counted by scheduler_tick).
+    if (s_oneshot_armed) {
+        s_oneshot_armed = false;
+        lapic_timer_start_periodic(s_counts_per_tick);
+        if (s_oneshot_ticks > 1) scheduler_advance_ticks(s_oneshot_ticks - 1);
+    }
+    scheduler_tick();
+}
+
+uint32_t tick_max_oneshot_ticks(void) {
+    if (s_lapic_tick) return 0xFFFFFFFFu / s_counts_per_tick;
+    // Comparisons of the low counter word hold for half its range
+    if (s_hpet_tick) return 0x7FFFFFFFu / s_hpet_counts_per_tick - 1;
+    return pit_max_oneshot_ticks();
+}
+
+void tick_start_oneshot(uint32_t ticks) {
+    uint32_t max_ticks = tick_max_oneshot_ticks();
+    if (ticks == 0) ticks = 1;
+    if (ticks > max_ticks) ticks = max_ticks;
+    if (s_hpet_tick) {
+        // A missed deadline re-arms one tick out; the interrupt credits the rest
+        uint32_t missed = hpet_tick_arm(ticks);
+        if (missed) scheduler_advance_ticks(missed);
+        return;
+    }
+    if (!s_lapic_tick) {
+        pit_start_oneshot(ticks);
+        return;
+    }
+
+    s_oneshot_ticks = ticks;
+    s_oneshot_armed = true;
+    lapic_timer_start_oneshot(ticks * s_counts_per_tick);
+}
+
+void tick_stop_oneshot(void) {
+    if (s_hpet_tick) {
+        uintptr_t irq_flags = local_irq_save();
+        uint32_t ticks = hpet_tick_elapsed();
+        ticks += hpet_tick_arm(1);
+        if (ticks) scheduler_advance_ticks(ticks);
+        local_irq_restore(irq_flags);
+        return;
+    }
+    if (!s_lapic_tick) {
+        pit_stop_oneshot();
+        return;
+    }
+    uintptr_t irq_flags = local_irq_save();
+    // Another interrupt ended the idle period early: charge only the ticks
+    // that actually elapsed, then fall back to periodic mode.
+    if (s_oneshot_armed) {
+        uint32_t programmed = s_oneshot_ticks * s_counts_per_tick;
+        uint32_t remaining = lapic_timer_current_count();
+        uint32_t elapsed = (remaining <= programmed) ? (programmed - remaining) : programmed;
+        s_oneshot_armed = false;
+        lapic_timer_start_periodic(s_counts_per_tick);
+        uint32_t ticks = elapsed / s_counts_per_tick;
+        if (ticks) scheduler_advance_ticks(ticks);
+    }
+    local_irq_restore(irq_flags);
+}
@@ -0,0 +1,81 @@
+/**
+ * @file timer.c
+ * @brief Driver timers: a timer wheel drained from the timer softirq.
+ */
+
+#include <kernel/drivers/timer/timer.h>
+#include <kernel/cpu/softirq.h>
+#include <kernel/process/scheduler.h> // scheduler_get_ticks, scheduler_ms_to_ticks
+#include <kernel/sync/spinlock.h>
+#include <kernel/lib/assert.h>
+
+static timer_wheel_t               s_timers;
+static timer_entry_t *volatile     s_running = NULL; // Callback in progress (softirq side)
+
+// Runs every timer that is due; softirq context, interrupts enabled.
+static void timer_softirq(void) {
+    uintptr_t flags = spinlock_acquire_irqsave(&s_timers.lock);
+    timer_entry_t *expired = timer_wheel_collect_expired_locked(&s_timers, scheduler_get_ticks());
+    while (expired) {
+        timer_entry_t *entry = expired;
+        expired = entry->next;
+        entry->next = NULL;
+        timer_callback_t cb = entry->callback;
+        s_running = entry;
+        spinlock_release_irqrestore(&s_timers.lock, flags);
+
+        cb(entry, entry->arg);
+
+        flags = spinlock_acquire_irqsave(&s_timers.lock);
+        s_running = NULL;
+    }
+    spinlock_release_irqrestore(&s_timers.lock, flags);
+}
+
+void timer_init(void) {
+    timer_wheel_init(&s_timers, scheduler_get_ticks());
+    softirq_register(SOFTIRQ_TIMER, timer_softirq);
+}
+
+void timer_schedule(timer_entry_t *timer, uint32_t deadline, timer_callback_t cb, void *arg) {
+    KERNEL_ASSERT(timer != NULL && cb != NULL, "timer_schedule: NULL timer or callback");
+    uintptr_t flags = spinlock_acquire_irqsave(&s_timers.lock);
+    timer_wheel_remove_locked(&s_timers, timer);
+    // An empty wheel is not advanced by the tick; bring its clock up to date
+    // so the next collection doesn't walk every tick it slept through.
+    if (s_timers.count == 0) s_timers.base_tick = scheduler_get_ticks();
+    timer->callback = cb;
+    timer->arg = arg;
+    timer->expires = deadline;
+    timer_wheel_add_locked(&s_timers, timer);
+    spinlock_release_irqrestore(&s_timers.lock, flags);
+}
+
+void timer_schedule_ms(timer_entry_t *timer, uint32_t ms, timer_callback_t cb, void *arg) {
+    timer_schedule(timer, scheduler_get_ticks() + scheduler_ms_to_ticks(ms), cb, arg);
+}
+
+bool timer_cancel(timer_entry_t *timer) {
+    KERNEL_ASSERT(timer != NULL, "timer_cancel: NULL timer");
+    uintptr_t flags = spinlock_acquire_irqsave(&s_timers.lock);
+    bool removed = timer_wheel_remove_locked(&s_timers, timer);
+    spinlock_release_irqrestore(&s_timers.lock, flags);
+
+    // Its callback may be running on the tick CPU: let it finish, unless
+    // that is us (a callback cancelling itself).
+    if (!removed && !softirq_in_progress()) {
+        while (s_running == timer) asm volatile("pause" ::: "memory");
+    }
+    return removed;
+}
+
+void timer_tick(void) {
+    if (s_timers.count) softirq_raise(SOFTIRQ_TIMER); // Racy read: an add shows up next tick
+}
+
+uint32_t timer_ticks_to_next(uint32_t now, uint32_t max_ticks) {
+    uintptr_t flags = spinlock_acquire_irqsave(&s_timers.lock);
+    uint32_t ticks = timer_wheel_ticks_to_next_locked(&s_timers, now, max_ticks);
+    spinlock_release_irqrestore(&s_timers.lock, flags);
+    return ticks;
+}
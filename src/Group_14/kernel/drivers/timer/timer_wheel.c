@@ -0,0 +1,181 @@
+/**
+ * @file timer_wheel.c
+ * @brief Hierarchical cascading timer wheel.
+ *
+ * @details Backs the scheduler's sleep queue and kernel timers. Deadlines are
+ * absolute 32-bit tick values compared with wrap-safe signed differences,
+ * so the wheel keeps working across tick counter wraparound.
+ */
+
+#include <kernel/drivers/timer/timer_wheel.h>
+#include <kernel/lib/string.h>
+#include <kernel/lib/assert.h>
+
+//============================================================================
+// Slot list helpers
+//============================================================================
+static inline void slot_push(timer_entry_t **slot, timer_entry_t *entry) {
+    entry->prev = NULL;
+    entry->next = *slot;
+    if (*slot) (*slot)->prev = entry;
+    *slot = entry;
+    entry->slot = slot;
+}
+
+static inline void slot_unlink(timer_entry_t *entry) {
+    if (entry->prev) entry->prev->next = entry->next;
+    else *entry->slot = entry->next;
+    if (entry->next) entry->next->prev = entry->prev;
+    entry->next = NULL;
+    entry->prev = NULL;
+    entry->slot = NULL;
+}
+
+/** @brief Picks the slot for an entry relative to the wheel's current base tick. */
+static timer_entry_t **slot_for(timer_wheel_t *wheel, uint32_t expires) {
+    uint32_t delta = expires - wheel->base_tick;
+
+    if ((int32_t)delta < 0) {
+        // Already due: fire when the current base tick is processed.
+        return &wheel->root[wheel->base_tick & TIMER_WHEEL_ROOT_MASK];
+    }
+    if (delta < TIMER_WHEEL_ROOT_SIZE) {
+        return &wheel->root[expires & TIMER_WHEEL_ROOT_MASK];
+    }
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        uint32_t shift = TIMER_WHEEL_ROOT_BITS + (uint32_t)level * TIMER_WHEEL_LVL_BITS;
+        bool last = (level == TIMER_WHEEL_LEVELS - 1);
+        if (last || delta < (1u << (shift + TIMER_WHEEL_LVL_BITS))) {
+            return &wheel->levels[level][(expires >> shift) & TIMER_WHEEL_LVL_MASK];
+        }
+    }
+    return NULL; // Unreachable
+}
+
+/**
+ * @brief Re-buckets every entry of one higher-level slot.
+ * @return The slot index that was cascaded (0 means the level wrapped).
+ */
+static uint32_t cascade(timer_wheel_t *wheel, int level) {
+    uint32_t shift = TIMER_WHEEL_ROOT_BITS + (uint32_t)level * TIMER_WHEEL_LVL_BITS;
+    uint32_t index = (wheel->base_tick >> shift) & TIMER_WHEEL_LVL_MASK;
+
+    timer_entry_t *entry = wheel->levels[level][index];
+    wheel->levels[level][index] = NULL;
+    while (entry) {
+        timer_entry_t *next = entry->next;
+        slot_push(slot_for(wheel, entry->expires), entry);
+        entry = next;
+    }
+    return index;
+}
+
+//============================================================================
+// Public API
+//============================================================================
+void timer_wheel_init(timer_wheel_t *wheel, uint32_t now) {
+    KERNEL_ASSERT(wheel != NULL, "timer_wheel_init: NULL wheel");
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->base_tick = now;
+    spinlock_init(&wheel->lock);
+}
+
+void timer_entry_init(timer_entry_t *entry, timer_callback_t callback, void *arg) {
+    KERNEL_ASSERT(entry != NULL, "timer_entry_init: NULL entry");
+    entry->next = NULL;
+    entry->prev = NULL;
+    entry->slot = NULL;
+    entry->expires = 0;
+    entry->callback = callback;
+    entry->arg = arg;
+    entry->pending = false;
+}
+
+void timer_wheel_add_locked(timer_wheel_t *wheel, timer_entry_t *entry) {
+    KERNEL_ASSERT(wheel && entry, "timer_wheel_add_locked: NULL argument");
+    KERNEL_ASSERT(!entry->pending, "timer_wheel_add_locked: entry already pending");
+
+    slot_push(slot_for(wheel, entry->expires), entry);
+    entry->pending = true;
+    wheel->count++;
+}
+
+bool timer_wheel_remove_locked(timer_wheel_t *wheel, timer_entry_t *entry) {
+    KERNEL_ASSERT(wheel && entry, "timer_wheel_remove_locked: NULL argument");
+    if (!entry->pending) return false;
+
+    slot_unlink(entry);
+    entry->pending = false;
+    KERNEL_ASSERT(wheel->count > 0, "timer_wheel_remove_locked: count underflow");
+    wheel->count--;
+    return true;
+}
+
+timer_entry_t *timer_wheel_collect_expired_locked(timer_wheel_t *wheel, uint32_t now) {
+    KERNEL_ASSERT(wheel != NULL, "timer_wheel_collect_expired_locked: NULL wheel");
+    timer_entry_t *expired = NULL;
+
+    while ((int32_t)(now - wheel->base_tick) >= 0) {
+        if (wheel->count == 0) {
+            // Nothing pending: jump the clock instead of walking empty slots.
+            wheel->base_tick = now + 1;
+            break;
+        }
+
+        uint32_t index = wheel->base_tick & TIMER_WHEEL_ROOT_MASK;
+        if (index == 0) {
+            for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+                if (cascade(wheel, level) != 0) break;
+            }
+        }
+
+        timer_entry_t *entry = wheel->root[index];
+        wheel->root[index] = NULL;
+        while (entry) {
+            timer_entry_t *next = entry->next;
+            entry->prev = NULL;
+            entry->slot = NULL;
+            entry->pending = false;
+            wheel->count--;
+            entry->next = expired;
+            expired = entry;
+            entry = next;
+        }
+        wheel->base_tick++;
+    }
+    return expired;
+}
+
+uint32_t timer_wheel_ticks_to_next_locked(timer_wheel_t *wheel, uint32_t now, uint32_t max_ticks) {
+    KERNEL_ASSERT(wheel != NULL, "timer_wheel_ticks_to_next_locked: NULL wheel");
+    if (wheel->count == 0) return max_ticks;
+
+    uint32_t best = max_ticks;
+    uint32_t tick = wheel->base_tick;
+
+    // Sitting on a boundary whose cascade has not run yet: the level-1 slot
+    // for this block still holds entries that may fire within it.
+    if ((tick & TIMER_WHEEL_ROOT_MASK) == 0) {
+        uint32_t index = (tick >> TIMER_WHEEL_ROOT_BITS) & TIMER_WHEEL_LVL_MASK;
+        if (index == 0) return 1; // Multi-level cascade pending; don't guess
+        for (timer_entry_t *entry = wheel->levels[0][index]; entry; entry = entry->next) {
+            int32_t delta = (int32_t)(entry->expires - now);
+            if (delta <= 0) return 1;
+            if ((uint32_t)delta < best) best = (uint32_t)delta;
+        }
+    }
+
+    // Higher levels only hold entries at or beyond the next cascade boundary,
+    // so stop there rather than guess at their contents.
+    do {
+        int32_t delta = (int32_t)(tick - now);
+        if (delta >= (int32_t)best) return best;
+        if (wheel->root[tick & TIMER_WHEEL_ROOT_MASK]) return delta > 0 ? (uint32_t)delta : 1;
+        tick++;
+    } while ((tick & TIMER_WHEEL_ROOT_MASK) != 0);
+
+    int32_t delta = (int32_t)(tick - now);
+    if (delta <= 0) return 1;
+    return (uint32_t)delta < best ? (uint32_t)delta : best;
+}
+
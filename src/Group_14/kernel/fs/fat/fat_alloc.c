@@ -18,6 +18,8 @@
 #include <kernel/drivers/display/terminal.h>       // terminal_printf for logging
 #include <kernel/memory/kmalloc.h>        // kmalloc/kfree
 #include <kernel/lib/assert.h>         // KERNEL_ASSERT
+#include <kernel/lib/klog.h>           // klog_debug (FAT_ALLOC_DEBUG)
+#include <kernel/core/tracepoint.h>
 #include <kernel/lib/string.h>         // strlen, strcpy, memset, memcpy, strcmp
 
 // --- Standard Type Includes ---
@@ -26,19 +28,329 @@
 // #include "libc/stddef.h" // Typically brought in by other headers like string.h if needed for size_t
 
 // --- Logging Macros ---
-#ifdef KLOG_LEVEL_DEBUG
-#define FAT_ALLOC_DEBUG(fmt, ...) serial_printf("[fat_alloc:DBG] %s: " fmt "\n", __func__, ##__VA_ARGS__)
-#else
-#define FAT_ALLOC_DEBUG(fmt, ...) ((void)0)
-#endif
+#define FAT_ALLOC_DEBUG(fmt, ...) klog_debug("[fat_alloc:DBG] %s: " fmt "\n", __func__, ##__VA_ARGS__) // Elided below KLOG_LVL_DEBUG
 #define FAT_ALLOC_INFO(fmt, ...)  serial_printf("[fat_alloc:INFO] %s: " fmt "\n", __func__, ##__VA_ARGS__)
 #define FAT_ALLOC_WARN(fmt, ...)  serial_printf("[fat_alloc:WARN] %s: " fmt "\n", __func__, ##__VA_ARGS__)
 #define FAT_ALLOC_ERROR(fmt, ...) serial_printf("[fat_alloc:ERR] %s:%d: " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
 // --- End Logging Macros ---
 
 
+// Free runs examined per extent search before settling for the longest seen
+#define FAT_EXTENT_MAX_RUNS        64
+
+// --- FSInfo Sector (FAT32) ---
+#define FAT_FSINFO_LEAD_SIG        0x41615252
+#define FAT_FSINFO_STRUCT_SIG      0x61417272
+#define FAT_FSINFO_TRAIL_SIG       0xAA550000
+#define FAT_FSINFO_LEAD_OFFSET     0
+#define FAT_FSINFO_STRUCT_OFFSET   484
+#define FAT_FSINFO_FREE_OFFSET     488
+#define FAT_FSINFO_NEXT_OFFSET     492
+#define FAT_FSINFO_TRAIL_OFFSET    508
+#define FAT_FSINFO_UNKNOWN         0xFFFFFFFF
+
+/** @brief Index of the lowest set bit of a non-zero word. */
+static inline uint32_t fat_bsf32(uint32_t word)
+{
+    uint32_t bit;
+    asm("bsfl %1, %0" : "=r"(bit) : "rm"(word));
+    return bit;
+}
+
+static inline uint32_t fsinfo_get32(const uint8_t *sector, size_t offset)
+{
+    uint32_t v;
+    memcpy(&v, sector + offset, sizeof(v));
+    return v;
+}
+
+static inline void fsinfo_put32(uint8_t *sector, size_t offset, uint32_t v)
+{
+    memcpy(sector + offset, &v, sizeof(v));
+}
+
+/**
+ * @brief Reads the FSInfo sector and returns its next-free hint.
+ * @param free_out If not NULL, receives the recorded free count.
+ * @return The hint, or FAT_FSINFO_UNKNOWN if the sector is missing or invalid
+ *         (*free_out is then FAT_FSINFO_UNKNOWN too).
+ */
+static uint32_t fat_read_fsinfo_hint(fat_fs_t *fs, uint32_t *free_out)
+{
+    if (free_out) *free_out = FAT_FSINFO_UNKNOWN;
+    buffer_t *buf = buffer_get(fs->disk_ptr, fs->fs_info_sector);
+    if (!buf) {
+        FAT_ALLOC_WARN("Failed to read FSInfo sector %lu.", (unsigned long)fs->fs_info_sector);
+        return FAT_FSINFO_UNKNOWN;
+    }
+    const uint8_t *data = (const uint8_t *)buf->data;
+    uint32_t hint = FAT_FSINFO_UNKNOWN;
+    if (fsinfo_get32(data, FAT_FSINFO_LEAD_OFFSET) == FAT_FSINFO_LEAD_SIG &&
+        fsinfo_get32(data, FAT_FSINFO_STRUCT_OFFSET) == FAT_FSINFO_STRUCT_SIG &&
+        fsinfo_get32(data, FAT_FSINFO_TRAIL_OFFSET) == FAT_FSINFO_TRAIL_SIG) {
+        hint = fsinfo_get32(data, FAT_FSINFO_NEXT_OFFSET);
+        if (free_out) *free_out = fsinfo_get32(data, FAT_FSINFO_FREE_OFFSET);
+    } else {
+        FAT_ALLOC_WARN("FSInfo sector %lu has bad signatures; ignoring it.", (unsigned long)fs->fs_info_sector);
+        fs->fs_info_sector = 0;
+    }
+    buffer_release(buf);
+    return hint;
+}
+
+/**
+ * @brief Builds the free-cluster bitmap with one pass over the in-memory FAT.
+ * A paged FAT gets no bitmap (that pass would read the whole FAT): the free
+ * count and hint are taken from FSInfo and allocation scans from the hint.
+ * @note Called at mount, before the filesystem is visible.
+ */
+int fat_free_map_init(fat_fs_t *fs, uint32_t fs_info_sector)
+{
+    KERNEL_ASSERT(fs != NULL && (fs->fat_table != NULL || fs->fat_paged), "FAT table must be loaded first");
+    if (fs->type != FAT_TYPE_FAT16 && fs->type != FAT_TYPE_FAT32) return FS_ERR_NOT_SUPPORTED;
+
+    if (fs->fat_paged) {
+        fs->fs_info_sector = fs_info_sector;
+        fs->free_cluster_count = FAT_FSINFO_UNKNOWN;
+        fs->next_free_hint = 2;
+        if (fs->fs_info_sector) {
+            uint32_t hint = fat_read_fsinfo_hint(fs, &fs->free_cluster_count);
+            if (hint >= 2 && hint <= fs->total_data_clusters + 1) fs->next_free_hint = hint;
+            if (fs->free_cluster_count > fs->total_data_clusters) fs->free_cluster_count = FAT_FSINFO_UNKNOWN;
+        }
+        FAT_ALLOC_INFO("Paged FAT: no bitmap; FSInfo free count %lu, search starts at %lu.",
+                       (unsigned long)fs->free_cluster_count, (unsigned long)fs->next_free_hint);
+        return FS_SUCCESS;
+    }
+
+    // Data clusters are 2 .. total_data_clusters + 1, as far as the FAT has entries for them
+    size_t entry_size = (fs->type == FAT_TYPE_FAT32) ? 4 : 2;
+    uint32_t clusters = fs->total_data_clusters + 2;
+    if (clusters > fs->fat_table_size_bytes / entry_size) clusters = (uint32_t)(fs->fat_table_size_bytes / entry_size);
+
+    uint32_t words = (clusters + 31) / 32;
+    uint32_t *bitmap = kmalloc(words * sizeof(uint32_t));
+    if (!bitmap) {
+        FAT_ALLOC_WARN("No memory for a %lu-cluster free bitmap; allocation will scan the FAT.", (unsigned long)clusters);
+        return FS_ERR_OUT_OF_MEMORY;
+    }
+    memset(bitmap, 0, words * sizeof(uint32_t));
+
+    uint32_t free_count = 0;
+    const uint32_t *fat32 = (const uint32_t *)fs->fat_table;
+    const uint16_t *fat16 = (const uint16_t *)fs->fat_table;
+    for (uint32_t c = 2; c < clusters; c++) {
+        bool is_free = (fs->type == FAT_TYPE_FAT32) ? (fat32[c] & 0x0FFFFFFF) == 0 : fat16[c] == 0;
+        if (is_free) {
+            bitmap[c >> 5] |= 1u << (c & 31);
+            free_count++;
+        }
+    }
+
+    fs->free_bitmap = bitmap;
+    fs->free_bitmap_clusters = clusters;
+    fs->free_cluster_count = free_count;
+    fs->fs_info_sector = fs_info_sector;
+    fs->next_free_hint = 2;
+    if (fs->fs_info_sector) {
+        uint32_t hint = fat_read_fsinfo_hint(fs, NULL);
+        if (hint >= 2 && hint < clusters) fs->next_free_hint = hint;
+    }
+    // Write the exact count back even if nothing gets allocated
+    fs->fs_info_dirty = true;
+    FAT_ALLOC_INFO("%lu of %lu clusters free, search starts at %lu.", (unsigned long)free_count,
+                   (unsigned long)(clusters - 2), (unsigned long)fs->next_free_hint);
+    return FS_SUCCESS;
+}
+
+void fat_free_map_destroy(fat_fs_t *fs)
+{
+    if (!fs || !fs->free_bitmap) return;
+    kfree(fs->free_bitmap);
+    fs->free_bitmap = NULL;
+    fs->free_bitmap_clusters = 0;
+}
+
+/**
+ * @brief Keeps the bitmap and free count in step with a FAT entry change.
+ * @note Assumes caller holds fs->lock.
+ */
+void fat_free_map_update(fat_fs_t *fs, uint32_t cluster, bool now_free)
+{
+    if (!fs->free_bitmap && fs->fat_paged && cluster >= 2) {
+        // No bitmap: keep FSInfo's count (if it had one) and the hint moving
+        if (fs->free_cluster_count != FAT_FSINFO_UNKNOWN) {
+            if (now_free) fs->free_cluster_count++;
+            else if (fs->free_cluster_count > 0) fs->free_cluster_count--;
+        }
+        if (!now_free) fs->next_free_hint = (cluster <= fs->total_data_clusters) ? cluster + 1 : 2;
+        fs->fs_info_dirty = true;
+        return;
+    }
+    if (!fs->free_bitmap || cluster < 2 || cluster >= fs->free_bitmap_clusters) return;
+    uint32_t *word = &fs->free_bitmap[cluster >> 5];
+    uint32_t bit = 1u << (cluster & 31);
+    bool was_free = (*word & bit) != 0;
+    if (was_free == now_free) return;
+
+    if (now_free) {
+        *word |= bit;
+        fs->free_cluster_count++;
+    } else {
+        *word &= ~bit;
+        fs->free_cluster_count--;
+        // Rotate: the next search starts after the cluster just taken
+        fs->next_free_hint = (cluster + 1 < fs->free_bitmap_clusters) ? cluster + 1 : 2;
+    }
+    fs->fs_info_dirty = true;
+}
+
+/** @brief Number of set bits in a word. */
+static inline uint32_t fat_popcount32(uint32_t word)
+{
+    word = word - ((word >> 1) & 0x55555555u);
+    word = (word & 0x33333333u) + ((word >> 2) & 0x33333333u);
+    word = (word + (word >> 4)) & 0x0F0F0F0Fu;
+    return (word * 0x01010101u) >> 24;
+}
+
+/**
+ * @brief fat_free_map_update() for a whole range turned free, a bitmap
+ * word at a time.
+ * @note Assumes caller holds fs->lock.
+ */
+void fat_free_map_free_range(fat_fs_t *fs, uint32_t first, uint32_t count, uint32_t was_used)
+{
+    if (count == 0) return;
+    if (!fs->free_bitmap && fs->fat_paged) {
+        if (fs->free_cluster_count != FAT_FSINFO_UNKNOWN) fs->free_cluster_count += was_used;
+        if (was_used) fs->fs_info_dirty = true;
+        return;
+    }
+    if (!fs->free_bitmap || first < 2 || first >= fs->free_bitmap_clusters) return;
+
+    uint32_t end = (count < fs->free_bitmap_clusters - first) ? first + count : fs->free_bitmap_clusters;
+    uint32_t freed = 0;
+    for (uint32_t c = first; c < end; ) {
+        uint32_t lo = c & 31;
+        uint32_t n = (end - c < 32 - lo) ? end - c : 32 - lo;
+        uint32_t mask = (n == 32) ? 0xFFFFFFFFu : (((1u << n) - 1) << lo);
+        uint32_t *word = &fs->free_bitmap[c >> 5];
+        freed += fat_popcount32(~*word & mask);
+        *word |= mask;
+        c += n;
+    }
+    if (freed) {
+        fs->free_cluster_count += freed;
+        fs->fs_info_dirty = true;
+    }
+}
+
+/**
+ * @brief Updates the FSInfo free count and next-free hint through the buffer cache.
+ * @note Assumes caller holds fs->lock, or that the filesystem is unmounting.
+ */
+int fat_write_fsinfo(fat_fs_t *fs)
+{
+    KERNEL_ASSERT(fs != NULL, "NULL fs pointer");
+    if (!fs->fs_info_sector || (!fs->free_bitmap && !fs->fat_paged) || !fs->fs_info_dirty) return FS_SUCCESS;
+
+    buffer_t *buf = buffer_get(fs->disk_ptr, fs->fs_info_sector);
+    if (!buf) {
+        FAT_ALLOC_ERROR("Failed to read FSInfo sector %lu.", (unsigned long)fs->fs_info_sector);
+        return FS_ERR_IO;
+    }
+    uint8_t *data = (uint8_t *)buf->data;
+    fsinfo_put32(data, FAT_FSINFO_FREE_OFFSET, fs->free_cluster_count);
+    fsinfo_put32(data, FAT_FSINFO_NEXT_OFFSET, fs->next_free_hint);
+    buffer_mark_dirty(buf);
+    buffer_release(buf);
+    fs->fs_info_dirty = false;
+    FAT_ALLOC_DEBUG("FSInfo: free=%lu next=%lu", (unsigned long)fs->free_cluster_count, (unsigned long)fs->next_free_hint);
+    return FS_SUCCESS;
+}
+
 /**
- * @brief Finds the first available (zero-entry) cluster in the FAT table.
+ * @brief Finds a free cluster in the bitmap, a word at a time, starting at
+ * the rotating hint and wrapping around once.
+ * @return The cluster number (>=2), or 0 if the volume is full.
+ */
+static uint32_t find_free_cluster_bitmap(fat_fs_t *fs)
+{
+    if (fs->free_cluster_count == 0) return 0;
+
+    uint32_t words = (fs->free_bitmap_clusters + 31) / 32;
+    uint32_t start = fs->next_free_hint;
+    if (start < 2 || start >= fs->free_bitmap_clusters) start = 2;
+
+    // Bits for clusters 0, 1 and past the end are never set
+    uint32_t w = start >> 5;
+    uint32_t word = fs->free_bitmap[w] & (~0u << (start & 31));
+    for (uint32_t scanned = 0; scanned <= words; scanned++) {
+        if (word) return (w << 5) + fat_bsf32(word);
+        w = (w + 1 == words) ? 0 : w + 1;
+        word = fs->free_bitmap[w];
+    }
+    FAT_ALLOC_ERROR("Free count is %lu but the bitmap is empty.", (unsigned long)fs->free_cluster_count);
+    return 0;
+}
+
+/**
+ * @brief First cluster at or after @p from whose bitmap bit means free
+ * (@p want_free) or in use (!@p want_free).
+ * @return The cluster, or fs->free_bitmap_clusters if there is none.
+ */
+static uint32_t free_map_find(const fat_fs_t *fs, uint32_t from, bool want_free)
+{
+    uint32_t limit = fs->free_bitmap_clusters;
+    if (from >= limit) return limit;
+    uint32_t words = (limit + 31) / 32;
+    uint32_t w = from >> 5;
+    uint32_t word = (want_free ? fs->free_bitmap[w] : ~fs->free_bitmap[w]) & (~0u << (from & 31));
+    while (!word) {
+        if (++w == words) return limit;
+        word = want_free ? fs->free_bitmap[w] : ~fs->free_bitmap[w];
+    }
+    uint32_t cluster = (w << 5) + fat_bsf32(word);
+    return (cluster < limit) ? cluster : limit; // Bits past the end read as in use
+}
+
+/**
+ * @brief Finds a free run of up to @p want clusters, preferring one that
+ * starts at @p goal: runs are examined from @p goal upwards, wrapping to
+ * cluster 2, and the first run of @p want (or the longest of the first
+ * FAT_EXTENT_MAX_RUNS) wins.
+ * @return First cluster of the run (0 if the volume is full); its usable
+ *         length, at most @p want, in *len_out.
+ */
+static uint32_t find_free_extent(fat_fs_t *fs, uint32_t goal, uint32_t want, uint32_t *len_out)
+{
+    uint32_t limit = fs->free_bitmap_clusters;
+    if (goal < 2 || goal >= limit) goal = 2;
+    uint32_t best = 0, best_len = 0, runs = 0;
+
+    for (int pass = 0; pass < 2 && best_len < want && runs < FAT_EXTENT_MAX_RUNS; pass++) {
+        uint32_t cluster = pass ? 2 : goal;
+        uint32_t end = pass ? goal : limit;
+        while (cluster < end && best_len < want && runs < FAT_EXTENT_MAX_RUNS) {
+            uint32_t start = free_map_find(fs, cluster, true);
+            if (start >= end) break;
+            uint32_t stop = free_map_find(fs, start, false);
+            if (stop - start > best_len) {
+                best = start;
+                best_len = stop - start;
+            }
+            runs++;
+            cluster = stop;
+        }
+    }
+    *len_out = (best_len < want) ? best_len : want;
+    return best;
+}
+
+/**
+ * @brief Finds an available (zero-entry) cluster: from the free bitmap when
+ * one was built at mount, otherwise by scanning the FAT from cluster 2.
  * @param fs Pointer to the FAT filesystem structure.
  * @return The cluster number if found (>=2), or 0 on error or if no free cluster.
  * @note Assumes caller holds fs->lock.
@@ -47,16 +359,24 @@ static uint32_t find_free_cluster(fat_fs_t *fs)
 {
     KERNEL_ASSERT(fs != NULL, "NULL fs pointer");
 
-    if (!fs->fat_table) {
+    if (!fs->fat_table && !fs->fat_paged) {
         FAT_ALLOC_ERROR("FAT table not loaded.");
         return 0;
     }
 
-    // Start search from cluster 2 up to the last data cluster.
+    if (fs->free_bitmap) {
+        uint32_t cluster = find_free_cluster_bitmap(fs);
+        if (cluster == 0) FAT_ALLOC_WARN("No free clusters found on device.");
+        return cluster;
+    }
+
+    // Search from the hint up to the last data cluster, then wrap to cluster 2.
     // fs->total_data_clusters is count of data clusters, so highest cluster num is total_data_clusters + 1.
     uint32_t last_search_cluster = fs->total_data_clusters + 1;
+    uint32_t start = fs->next_free_hint;
+    if (start < 2 || start > last_search_cluster) start = 2;
 
-    for (uint32_t cluster_num = 2; cluster_num <= last_search_cluster; cluster_num++) {
+    for (uint32_t scanned = 0, cluster_num = start; scanned <= last_search_cluster - 2; scanned++) {
         uint32_t entry_value;
         if (fat_get_cluster_entry(fs, cluster_num, &entry_value) != FS_SUCCESS) {
             FAT_ALLOC_ERROR("Failed to read FAT entry for cluster %lu", (unsigned long)cluster_num);
@@ -67,6 +387,7 @@ static uint32_t find_free_cluster(fat_fs_t *fs)
             FAT_ALLOC_DEBUG("Found free cluster: %lu", (unsigned long)cluster_num);
             return cluster_num;
         }
+        cluster_num = (cluster_num == last_search_cluster) ? 2 : cluster_num + 1;
     }
 
     FAT_ALLOC_WARN("No free clusters found on device.");
@@ -75,57 +396,110 @@ static uint32_t find_free_cluster(fat_fs_t *fs)
 
 
 /**
- * @brief Allocates a new cluster, marks it as EOC, and optionally links it from a previous cluster.
- * @param fs Pointer to the FAT filesystem structure.
- * @param previous_cluster The cluster number to link from (0 if this is the first cluster).
- * @return The newly allocated cluster number (>=2), or 0 on failure.
+ * @brief Allocates up to @p count clusters as one contiguous, linked chain
+ * ending in EOC, then links it from @p previous_cluster (0: a new chain).
+ * The search starts just past @p previous_cluster, so a growing file stays
+ * contiguous when the space after it is free. Without a free bitmap one
+ * cluster is allocated per call.
+ * @param allocated_out Receives the number of clusters allocated (may be < count).
+ * @return The first new cluster (>=2), or 0 on failure or if the volume is full.
  * @note Assumes caller holds fs->lock.
  */
-uint32_t fat_allocate_cluster(fat_fs_t *fs, uint32_t previous_cluster)
+uint32_t fat_allocate_extent(fat_fs_t *fs, uint32_t previous_cluster, uint32_t count, uint32_t *allocated_out)
 {
-    KERNEL_ASSERT(fs != NULL, "FAT filesystem context cannot be NULL");
+    KERNEL_ASSERT(fs != NULL && allocated_out != NULL, "Invalid arguments to fat_allocate_extent");
+    *allocated_out = 0;
 
-    if (!fs->fat_table) {
+    if (!fs->fat_table && !fs->fat_paged) {
         FAT_ALLOC_ERROR("FAT table not loaded.");
         return 0;
     }
+    if (count == 0) count = 1;
 
-    uint32_t new_cluster = find_free_cluster(fs);
-    if (new_cluster < 2) { // find_free_cluster returns 0 on error or no space, cluster < 2 is invalid
-        FAT_ALLOC_WARN("find_free_cluster failed or no space available.");
-        return 0;
+    uint32_t first, run = 1;
+    if (fs->free_bitmap) {
+        uint32_t goal = (previous_cluster >= 2) ? previous_cluster + 1 : fs->next_free_hint;
+        first = find_free_extent(fs, goal, count, &run);
+    } else {
+        first = find_free_cluster(fs);
     }
-    FAT_ALLOC_DEBUG("Found free cluster %lu to allocate.", (unsigned long)new_cluster);
-
-    // Mark the new cluster as End-Of-Chain in the FAT
-    if (fat_set_cluster_entry(fs, new_cluster, fs->eoc_marker) != FS_SUCCESS) {
-        FAT_ALLOC_ERROR("Failed to mark cluster %lu as EOC.", (unsigned long)new_cluster);
-        // Technically, the cluster is still marked free if this fails immediately, but it's an error state.
+    if (first < 2 || run == 0) { // 0 on error or no space, cluster < 2 is invalid
+        FAT_ALLOC_WARN("No free clusters available.");
         return 0;
     }
-    FAT_ALLOC_DEBUG("Marked cluster %lu as EOC.", (unsigned long)new_cluster);
+    FAT_ALLOC_DEBUG("Found %lu free clusters at %lu.", (unsigned long)run, (unsigned long)first);
+
+    // Link the run in one pass: first -> first+1 -> ... -> EOC
+    for (uint32_t i = 0; i < run; i++) {
+        uint32_t value = (i + 1 < run) ? first + i + 1 : fs->eoc_marker;
+        if (fat_set_cluster_entry(fs, first + i, value) != FS_SUCCESS) {
+            FAT_ALLOC_ERROR("Failed to set FAT entry for cluster %lu.", (unsigned long)(first + i));
+            while (i-- > 0) fat_set_cluster_entry(fs, first + i, 0); // Best effort rollback
+            return 0;
+        }
+    }
 
-    // If there's a previous cluster, link it to the new one
+    // If there's a previous cluster, link it to the new run
     if (previous_cluster >= 2) {
-        FAT_ALLOC_DEBUG("Linking previous cluster %lu to new cluster %lu.", (unsigned long)previous_cluster, (unsigned long)new_cluster);
-        if (fat_set_cluster_entry(fs, previous_cluster, new_cluster) != FS_SUCCESS) {
-            FAT_ALLOC_ERROR("Failed to link cluster %lu -> %lu.", (unsigned long)previous_cluster, (unsigned long)new_cluster);
-            // Rollback: Mark the new_cluster as free again since linking failed.
-            fat_set_cluster_entry(fs, new_cluster, 0); // Best effort rollback
+        FAT_ALLOC_DEBUG("Linking previous cluster %lu to new cluster %lu.", (unsigned long)previous_cluster, (unsigned long)first);
+        if (fat_set_cluster_entry(fs, previous_cluster, first) != FS_SUCCESS) {
+            FAT_ALLOC_ERROR("Failed to link cluster %lu -> %lu.", (unsigned long)previous_cluster, (unsigned long)first);
+            // Rollback: Mark the new run as free again since linking failed.
+            for (uint32_t i = 0; i < run; i++) fat_set_cluster_entry(fs, first + i, 0);
             return 0;
         }
-        FAT_ALLOC_DEBUG("Successfully linked cluster %lu -> %lu.", (unsigned long)previous_cluster, (unsigned long)new_cluster);
-    } else {
-        FAT_ALLOC_DEBUG("No valid previous cluster (%lu), allocating as a new chain start.", (unsigned long)previous_cluster);
     }
 
-    FAT_ALLOC_INFO("Successfully allocated cluster %lu.", (unsigned long)new_cluster);
-    return new_cluster;
+    FAT_ALLOC_INFO("Allocated %lu cluster(s) from %lu.", (unsigned long)run, (unsigned long)first);
+    TRACEPOINT(TP_FAT_ALLOC, first, run);
+    *allocated_out = run;
+    return first;
+}
+
+/**
+ * @brief Allocates a new cluster, marks it as EOC, and optionally links it from a previous cluster.
+ * @param fs Pointer to the FAT filesystem structure.
+ * @param previous_cluster The cluster number to link from (0 if this is the first cluster).
+ * @return The newly allocated cluster number (>=2), or 0 on failure.
+ * @note Assumes caller holds fs->lock.
+ */
+uint32_t fat_allocate_cluster(fat_fs_t *fs, uint32_t previous_cluster)
+{
+    uint32_t allocated;
+    return fat_allocate_extent(fs, previous_cluster, 1, &allocated);
+}
+
+/**
+ * @brief Cuts a chain after its first @p keep_clusters clusters (at least
+ * one is kept) and frees the rest, e.g. unused preallocated space.
+ * @note Assumes caller holds fs->lock.
+ */
+int fat_trim_cluster_chain(fat_fs_t *fs, uint32_t first_cluster, uint32_t keep_clusters)
+{
+    KERNEL_ASSERT(fs != NULL, "FAT filesystem context cannot be NULL");
+    if (first_cluster < 2) return FS_ERR_INVALID_PARAM;
+
+    uint32_t last = first_cluster;
+    for (uint32_t i = 1; i < keep_clusters; i++) {
+        uint32_t next;
+        if (fat_get_next_cluster(fs, last, &next) != FS_SUCCESS) return FS_ERR_IO;
+        if (next < 2 || next >= fs->eoc_marker) return FS_SUCCESS; // Chain is no longer than that
+        last = next;
+    }
+
+    uint32_t tail;
+    if (fat_get_next_cluster(fs, last, &tail) != FS_SUCCESS) return FS_ERR_IO;
+    if (tail < 2 || tail >= fs->eoc_marker) return FS_SUCCESS;
+    if (fat_set_cluster_entry(fs, last, fs->eoc_marker) != FS_SUCCESS) return FS_ERR_IO;
+    FAT_ALLOC_DEBUG("Trimming chain after cluster %lu (freeing from %lu).", (unsigned long)last, (unsigned long)tail);
+    return fat_free_cluster_chain(fs, tail);
 }
 
 
 /**
  * @brief Frees an entire cluster chain in the FAT, starting from a given cluster.
+ * The chain is followed link by link, but each stretch of clusters that lie
+ * back to back on disk is freed with one fat_clear_cluster_range() call.
  * @param fs Pointer to the FAT filesystem structure.
  * @param start_cluster The first cluster in the chain to free. Must be >= 2.
  * @return FS_SUCCESS if successful, or an error code.
@@ -140,12 +514,13 @@ int fat_free_cluster_chain(fat_fs_t *fs, uint32_t start_cluster)
         FAT_ALLOC_ERROR("Cannot free reserved/invalid cluster %lu", (unsigned long)start_cluster);
         return FS_ERR_INVALID_PARAM;
     }
-    if (!fs->fat_table) {
+    if (!fs->fat_table && !fs->fat_paged) {
         FAT_ALLOC_ERROR("FAT table not loaded.");
         return FS_ERR_IO;
     }
 
     uint32_t current_cluster = start_cluster;
+    uint32_t run_start = 0, run_length = 0; // Clusters followed so far that lie back to back on disk
     int result = FS_SUCCESS;
 
     while (current_cluster >= 2 && current_cluster < fs->eoc_marker) {
@@ -160,13 +535,19 @@ int fat_free_cluster_chain(fat_fs_t *fs, uint32_t start_cluster)
         }
         FAT_ALLOC_DEBUG("Next cluster in chain is %lu.", (unsigned long)next_cluster_val);
 
-        // Mark current cluster as free (0)
-        if (fat_set_cluster_entry(fs, current_cluster, 0) != FS_SUCCESS) {
-            FAT_ALLOC_WARN("Error writing FAT entry to free cluster %lu.", (unsigned long)current_cluster);
-            if (result == FS_SUCCESS) result = FS_ERR_IO; // Preserve earlier error if any
-            break;
+        // Extend the run, or free the finished one and start another here
+        if (run_length > 0 && current_cluster == run_start + run_length) {
+            run_length++;
+        } else {
+            if (run_length > 0 && fat_clear_cluster_range(fs, run_start, run_length) != FS_SUCCESS) {
+                FAT_ALLOC_WARN("Error writing FAT entries to free clusters %lu+%lu.", (unsigned long)run_start, (unsigned long)run_length);
+                result = FS_ERR_IO;
+                run_length = 0;
+                break;
+            }
+            run_start = current_cluster;
+            run_length = 1;
         }
-        FAT_ALLOC_DEBUG("Marked cluster %lu as free.", (unsigned long)current_cluster);
 
         current_cluster = next_cluster_val;
 
@@ -178,6 +559,12 @@ int fat_free_cluster_chain(fat_fs_t *fs, uint32_t start_cluster)
         }
     }
 
+    // Free the last run, also when the walk stopped early (as far as it got)
+    if (run_length > 0 && fat_clear_cluster_range(fs, run_start, run_length) != FS_SUCCESS) {
+        FAT_ALLOC_WARN("Error writing FAT entries to free clusters %lu+%lu.", (unsigned long)run_start, (unsigned long)run_length);
+        if (result == FS_SUCCESS) result = FS_ERR_IO; // Preserve earlier error if any
+    }
+
     if (result == FS_SUCCESS) {
         FAT_ALLOC_DEBUG("Chain free process completed successfully for start_cluster %lu.", (unsigned long)start_cluster);
     } else {
@@ -251,9 +638,10 @@ int fat_create_file(fat_fs_t        *fs,
     }
     // FAT_ALLOC_DEBUG("Generated short name: '%.11s'", short_name_raw); // Raw, not null-terminated
 
-    fat_lfn_entry_t lfn_entries_buf[FAT_MAX_LFN_ENTRIES];
+    // LFN entries followed by the SFN entry, written as one group
+    fat_dir_entry_t entry_group[FAT_MAX_LFN_ENTRIES + 1];
     uint8_t lfn_checksum = fat_calculate_lfn_checksum(short_name_raw);
-    int num_lfn_slots = fat_generate_lfn_entries(filename, lfn_checksum, lfn_entries_buf, FAT_MAX_LFN_ENTRIES);
+    int num_lfn_slots = fat_generate_lfn_entries(filename, lfn_checksum, (fat_lfn_entry_t *)entry_group, FAT_MAX_LFN_ENTRIES);
     if (num_lfn_slots < 0) {
         FAT_ALLOC_ERROR("Failed to generate LFN entries for '%s' (err %d).", filename, num_lfn_slots);
         return num_lfn_slots;
@@ -289,23 +677,14 @@ int fat_create_file(fat_fs_t        *fs,
     sfn_entry_to_write.write_time = current_fat_time;
     sfn_entry_to_write.write_date = current_fat_date;
 
-    // 6. Write LFN entries (if any) then the SFN entry
-    uint32_t current_write_offset = free_slot_offset_start;
-    if (num_lfn_slots > 0) {
-        FAT_ALLOC_DEBUG("Writing %d LFN entries...", num_lfn_slots);
-        ret = write_directory_entries(fs, free_slot_dir_cluster, current_write_offset, lfn_entries_buf, (size_t)num_lfn_slots);
-        if (ret != FS_SUCCESS) {
-            FAT_ALLOC_ERROR("Failed to write LFN entries (err %d).", ret);
-            // TODO: Consider rollback of any directory extensions made by find_free_directory_slot.
-            return ret;
-        }
-        current_write_offset += num_lfn_slots * sizeof(fat_dir_entry_t);
-    }
-    FAT_ALLOC_DEBUG("Writing SFN entry at offset %lu...", (unsigned long)current_write_offset);
-    ret = write_directory_entries(fs, free_slot_dir_cluster, current_write_offset, &sfn_entry_to_write, 1);
+    // 6. Write the LFN entries (if any) and the SFN entry in one go
+    uint32_t current_write_offset = free_slot_offset_start + num_lfn_slots * sizeof(fat_dir_entry_t);
+    entry_group[num_lfn_slots] = sfn_entry_to_write;
+    FAT_ALLOC_DEBUG("Writing %d LFN entries, SFN entry at offset %lu...", num_lfn_slots, (unsigned long)current_write_offset);
+    ret = write_directory_entries(fs, free_slot_dir_cluster, free_slot_offset_start, entry_group, total_slots_to_write);
     if (ret != FS_SUCCESS) {
-        FAT_ALLOC_ERROR("Failed to write SFN entry (err %d).", ret);
-        // TODO: Consider rollback.
+        FAT_ALLOC_ERROR("Failed to write directory entries (err %d).", ret);
+        // TODO: Consider rollback of any directory extensions made by find_free_directory_slot.
         return ret;
     }
 
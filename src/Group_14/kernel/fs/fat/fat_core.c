@@ -14,6 +14,7 @@
  #include <kernel/drivers/display/terminal.h>   // For logging
  #include <kernel/lib/string.h>     // For memset (if needed, though struct init covers it)
  #include <kernel/lib/assert.h>     // For KERNEL_ASSERT
+ #include <kernel/memory/slab.h>     // File context cache
  
  /* --- VFS Driver Function Declarations --- */
  // These functions are implemented in other fat_*.c files but need to be
@@ -26,6 +27,7 @@
  // Implemented in fat_dir.c
  extern vnode_t *fat_open_internal(void *fs_context, const char *path, int flags);
  extern int      fat_readdir_internal(file_t *dir_file, struct dirent *d_entry_out, size_t entry_index);
+ extern int      fat_getdents_internal(file_t *dir_file, void *buf, size_t len, off_t *cookie);
  extern int      fat_unlink_internal(void *fs_context, const char *path);
  
  // Implemented in fat_io.c
@@ -33,6 +35,8 @@
  extern int   fat_write_internal(file_t *file, const void *buf, size_t len);
  extern int   fat_close_internal(file_t *file);
  extern off_t fat_lseek_internal(file_t *file, off_t offset, int whence);
+ extern int   fat_fallocate_internal(file_t *file, off_t length);
+ extern int   fat_identify_internal(file_t *file, vfs_file_id_t *id_out);
  
  /* --- Static VFS Driver Structure --- */
  // Defines the FAT filesystem driver interface for the VFS.
@@ -47,11 +51,28 @@
      .lseek   = fat_lseek_internal,    // Lseek function pointer
      .readdir = fat_readdir_internal,  // Readdir function pointer
      .unlink  = fat_unlink_internal,   // Unlink function pointer
-     // Add .mkdir, .rmdir, .stat, etc. here if/when implemented
+     .identify = fat_identify_internal, // File identity for the page cache
+     .fallocate = fat_fallocate_internal, // Space reservation for writers that know their size
+     .getdents = fat_getdents_internal, // Batched directory listing
+     .stat    = fat_stat_internal,     // Attributes from the lookup caches
+     .fstat   = fat_fstat_internal,    // Attributes of an open file
+     .fsync   = fat_fsync_internal,    // Writes back one file's blocks, not the whole cache
+     // Add .mkdir, .rmdir, etc. here if/when implemented
      .next    = NULL                 // Linked list pointer for VFS internal use
  };
  
+ // Per-open file contexts (vnode->data)
+ static slab_cache_t *fat_file_ctx_cache = NULL;
+
  /* --- Public Function Implementations --- */
+
+ fat_file_context_t *fat_alloc_file_context(void) {
+     return (fat_file_context_t *)slab_alloc(fat_file_ctx_cache);
+ }
+
+ void fat_free_file_context(fat_file_context_t *ctx) {
+     slab_free(fat_file_ctx_cache, ctx);
+ }
  
  /**
   * @brief Registers the FAT filesystem driver with the VFS.
@@ -59,6 +80,13 @@
  int fat_register_driver(void)
  {
      terminal_write("[FAT Core] Registering FAT filesystem driver with VFS...\n");
+     if (!fat_file_ctx_cache) {
+         fat_file_ctx_cache = slab_create("fat_file_context_t", sizeof(fat_file_context_t), 0, 0, NULL, NULL);
+         if (!fat_file_ctx_cache) {
+             terminal_write("[FAT Core] Error: Failed to create file context cache.\n");
+             return FS_ERR_OUT_OF_MEMORY;
+         }
+     }
      // The structure is statically initialized, just need to register it.
      int result = vfs_register_driver(&fat_vfs_driver);
      if (result == 0) {
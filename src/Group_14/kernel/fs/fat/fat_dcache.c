@@ -0,0 +1,141 @@
+/**
+ * @file fat_dcache.c
+ * @brief Directory entry name cache for FAT path lookups.
+ *
+ * A small set-associative table per mounted volume. Lookups of a name in a
+ * directory hash (dir_cluster, name) to one set and compare its ways, so a
+ * repeated open resolves each path component without reading directory
+ * sectors. Names are compared exactly as given: another spelling of the same
+ * file is simply a separate entry, and both go when the directory changes.
+ */
+
+#include <kernel/fs/fat/fat_dcache.h>
+#include <kernel/fs/fat/fat_core.h>
+#include <kernel/fs/vfs/fs_errno.h>
+#include <kernel/memory/kmalloc.h>
+#include <kernel/lib/string.h>
+
+static uint32_t fat_dcache_hash(uint32_t dir_cluster, const char *name, size_t *len_out)
+{
+    uint32_t h = 2166136261u ^ dir_cluster; // FNV-1a over the name, seeded with the directory
+    size_t len = 0;
+    for (; name[len]; len++) {
+        h ^= (uint8_t)name[len];
+        h *= 16777619u;
+    }
+    *len_out = len;
+    return h;
+}
+
+void fat_dcache_init(fat_fs_t *fs)
+{
+    fs->dcache = kmalloc(sizeof(fat_dcache_t));
+    if (fs->dcache) memset(fs->dcache, 0, sizeof(fat_dcache_t));
+}
+
+void fat_dcache_destroy(fat_fs_t *fs)
+{
+    kfree(fs->dcache);
+    fs->dcache = NULL;
+}
+
+/** @brief The cached entry for (dir_cluster, name), or NULL. */
+static fat_dcache_entry_t *fat_dcache_find(fat_dcache_t *dc, uint32_t dir_cluster, const char *name, uint32_t hash)
+{
+    fat_dcache_entry_t *set = dc->sets[hash % FAT_DCACHE_BUCKETS];
+    for (int way = 0; way < FAT_DCACHE_WAYS; way++) {
+        fat_dcache_entry_t *e = &set[way];
+        if (e->valid && e->hash == hash && e->dir_cluster == dir_cluster && strcmp(e->name, name) == 0) return e;
+    }
+    return NULL;
+}
+
+bool fat_dcache_lookup(fat_fs_t *fs, uint32_t dir_cluster, const char *name, int *result,
+                       fat_dir_entry_t *entry_out, uint32_t *entry_offset_out, uint32_t *first_lfn_offset_out)
+{
+    fat_dcache_t *dc = fs->dcache;
+    if (!dc) return false;
+    size_t len;
+    uint32_t hash = fat_dcache_hash(dir_cluster, name, &len);
+    if (len >= FAT_DCACHE_NAME_MAX) return false;
+
+    fat_dcache_entry_t *e = fat_dcache_find(dc, dir_cluster, name, hash);
+    if (!e) {
+        dc->misses++;
+        return false;
+    }
+    if (e->negative) {
+        dc->negative_hits++;
+        *result = FS_ERR_NOT_FOUND;
+        return true;
+    }
+    dc->hits++;
+    memcpy(entry_out, &e->entry, sizeof(*entry_out));
+    *entry_offset_out = e->entry_offset;
+    if (first_lfn_offset_out) *first_lfn_offset_out = e->first_lfn_offset;
+    *result = FS_SUCCESS;
+    return true;
+}
+
+void fat_dcache_insert(fat_fs_t *fs, uint32_t dir_cluster, const char *name,
+                       const fat_dir_entry_t *entry, uint32_t entry_offset, uint32_t first_lfn_offset)
+{
+    fat_dcache_t *dc = fs->dcache;
+    if (!dc) return;
+    size_t len;
+    uint32_t hash = fat_dcache_hash(dir_cluster, name, &len);
+    if (len >= FAT_DCACHE_NAME_MAX) return;
+
+    fat_dcache_entry_t *e = fat_dcache_find(dc, dir_cluster, name, hash);
+    if (!e) {
+        uint32_t set = hash % FAT_DCACHE_BUCKETS;
+        e = &dc->sets[set][dc->next_way[set]];
+        dc->next_way[set] = (uint8_t)((dc->next_way[set] + 1) % FAT_DCACHE_WAYS);
+    }
+    e->valid = true;
+    e->negative = (entry == NULL);
+    e->dir_cluster = dir_cluster;
+    e->hash = hash;
+    memcpy(e->name, name, len + 1);
+    if (entry) memcpy(&e->entry, entry, sizeof(e->entry));
+    e->entry_offset = entry_offset;
+    e->first_lfn_offset = first_lfn_offset;
+}
+
+void fat_dcache_update(fat_fs_t *fs, uint32_t dir_cluster, uint32_t entry_offset, const fat_dir_entry_t *entry)
+{
+    fat_dcache_t *dc = fs->dcache;
+    if (!dc) return;
+    for (int set = 0; set < FAT_DCACHE_BUCKETS; set++) {
+        for (int way = 0; way < FAT_DCACHE_WAYS; way++) {
+            fat_dcache_entry_t *e = &dc->sets[set][way];
+            if (!e->valid || e->negative || e->dir_cluster != dir_cluster || e->entry_offset != entry_offset) continue;
+            if (memcmp(e->entry.name, entry->name, sizeof(entry->name)) != 0) {
+                // Renamed or deleted through this path: the directory's names changed
+                fat_dcache_invalidate_dir(fs, dir_cluster);
+                return;
+            }
+            memcpy(&e->entry, entry, sizeof(e->entry));
+        }
+    }
+}
+
+void fat_dcache_invalidate_dir(fat_fs_t *fs, uint32_t dir_cluster)
+{
+    fat_dcache_t *dc = fs->dcache;
+    if (!dc) return;
+    for (int set = 0; set < FAT_DCACHE_BUCKETS; set++) {
+        for (int way = 0; way < FAT_DCACHE_WAYS; way++) {
+            if (dc->sets[set][way].dir_cluster == dir_cluster) dc->sets[set][way].valid = false;
+        }
+    }
+}
+
+void fat_dcache_invalidate_all(fat_fs_t *fs)
+{
+    fat_dcache_t *dc = fs->dcache;
+    if (!dc) return;
+    for (int set = 0; set < FAT_DCACHE_BUCKETS; set++) {
+        for (int way = 0; way < FAT_DCACHE_WAYS; way++) dc->sets[set][way].valid = false;
+    }
+}
@@ -13,11 +13,15 @@
 #include <kernel/fs/fat/fat_alloc.h>  // Cluster allocation (fat_allocate_cluster, fat_free_cluster_chain)
                         // *** ADDED: Include fat_create_file declaration ***
 #include <kernel/fs/vfs/fs_util.h>    // fs_util_split_path
+#include <kernel/fs/vfs/path_walk.h>  // fat_lookup_path components
 #include <kernel/fs/fat/fat_utils.h>  // FAT entry access, LBA conversion, name formatting etc.
 #include <kernel/fs/fat/fat_lfn.h>    // LFN specific helpers (checksum, reconstruct, generate)
+#include <kernel/fs/fat/fat_dcache.h> // Name lookup cache
+#include <kernel/fs/fat/fat_dirindex.h> // Whole-directory indexes
+#include <kernel/fs/fat/fat_vcache.h> // Contexts shared by a file's open handles
 #include <kernel/fs/fat/fat_io.h>     // read_cluster_cached, write_cluster_cached (indirectly via helpers)
 #include <kernel/drivers/storage/buffer_cache.h> // Buffer cache access (buffer_get, buffer_release, etc.)
-#include <kernel/sync/spinlock.h>   // Locking primitives
+#include <kernel/sync/mutex.h>      // Locking primitives
 #include <kernel/drivers/display/terminal.h>   // Logging (printk equivalent)
 #include <kernel/fs/vfs/sys_file.h>   // O_* flags definitions (O_CREAT, O_TRUNC, etc.)
 #include <kernel/memory/kmalloc.h>    // Kernel memory allocation
@@ -26,6 +30,7 @@
 #include <kernel/core/types.h>      // struct dirent, uint*_t etc.
 #include <kernel/lib/string.h>     // memcpy, memcmp, memset, strlen, strchr, strrchr, strtok
 #include <kernel/lib/assert.h>     // KERNEL_ASSERT
+#include <kernel/lib/klog.h>       // klog_debug (FAT_DEBUG_LOG)
 
 // --- Local Definitions ---
 // (Keep DT_* defines as before)
@@ -46,14 +51,14 @@ extern vfs_driver_t fat_vfs_driver;
 
 // --- Static Helper Prototypes ---
 static void fat_format_short_name_impl(const uint8_t name_8_3[11], char *out_name);
+static void fat_find_in_dir_remember(fat_fs_t *fs, uint32_t dir_cluster, const char *component, int result,
+                                     const fat_dir_entry_t *entry, uint32_t entry_offset,
+                                     const uint32_t *first_lfn_offset);
+static void fat_dir_forget_names(fat_fs_t *fs, bool owner_known, uint32_t owner);
 
 // --- Logging Macros ---
 // (Keep logging macros as before)
-#ifdef KLOG_LEVEL_DEBUG
-#define FAT_DEBUG_LOG(fmt, ...) serial_printf("[fat_dir:DEBUG] (%s) " fmt "\n", __func__, ##__VA_ARGS__)
-#else
-#define FAT_DEBUG_LOG(fmt, ...) do {} while(0)
-#endif
+#define FAT_DEBUG_LOG(fmt, ...) klog_debug("[fat_dir:DEBUG] (%s) " fmt "\n", __func__, ##__VA_ARGS__) // Elided below KLOG_LVL_DEBUG
 #define FAT_INFO_LOG(fmt, ...)  terminal_printf("[fat_dir:INFO]  (%s) " fmt "\n", __func__, ##__VA_ARGS__)
 #define FAT_WARN_LOG(fmt, ...)  terminal_printf("[fat_dir:WARN]  (%s) " fmt "\n", __func__, ##__VA_ARGS__)
 #define FAT_ERROR_LOG(fmt, ...) terminal_printf("[fat_dir:ERROR] (%s:%d) " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
@@ -91,7 +96,7 @@ static void fat_format_short_name_impl(const uint8_t name_8_3[11], char *out_nam
          return NULL;
      }
 
-     uintptr_t irq_flags = spinlock_acquire_irqsave(&fs->lock);
+     kmutex_lock(&fs->lock);
      FAT_DEBUG_LOG("Lock acquired.");
 
      fat_dir_entry_t entry;
@@ -104,6 +109,7 @@ static void fat_format_short_name_impl(const uint8_t name_8_3[11], char *out_nam
      bool truncated = false;
      vnode_t *vnode = NULL;
      fat_file_context_t *file_ctx = NULL;
+     bool shared_ctx = false; // file_ctx is the context other handles already use
      int ret_err = FS_SUCCESS; // Assume success initially
 
      // --- 1. Lookup the path using fat_lookup_path ---
@@ -145,6 +151,16 @@ static void fat_format_short_name_impl(const uint8_t name_8_3[11], char *out_nam
                  goto open_fail_locked;
              }
              FAT_INFO_LOG("Handling O_TRUNC for existing file '%s', original size=%lu", path, (unsigned long)entry.file_size);
+             // Already open: the shared context holds the current chain (the entry may lag behind it)
+             fat_file_context_t *open_ctx = fat_vcache_lookup(fs, entry_dir_cluster, entry_offset_in_dir, entry.name, false);
+             if (open_ctx) {
+                 int discard_res = fat_discard_file_data(fs, open_ctx);
+                 if (discard_res != FS_SUCCESS) {
+                     FAT_WARN_LOG("Freeing the open file's chain failed for '%s' (err %d).", path, discard_res);
+                 }
+                 entry.first_cluster_low = 0; // Freed above; the entry is still written below
+                 entry.first_cluster_high = 0;
+             }
              if (entry.file_size > 0) {
                  int trunc_res = fat_truncate_file(fs, &entry, entry_dir_cluster, entry_offset_in_dir);
                  if (trunc_res != FS_SUCCESS) {
@@ -207,13 +223,23 @@ static void fat_format_short_name_impl(const uint8_t name_8_3[11], char *out_nam
      // --- 3. Allocation & Setup ---
      FAT_DEBUG_LOG("Step 3: Allocating vnode and file context structure...");
      vnode = kmalloc(sizeof(vnode_t));
-     file_ctx = kmalloc(sizeof(fat_file_context_t));
+     if (!(entry.attr & FAT_ATTR_DIRECTORY)) {
+         // Directories keep a context per open: their readdir position lives in it
+         file_ctx = fat_vcache_lookup(fs, entry_dir_cluster, entry_offset_in_dir, entry.name, true);
+         shared_ctx = (file_ctx != NULL);
+     }
+     if (!file_ctx) file_ctx = fat_alloc_file_context();
      if (!vnode || !file_ctx) {
-         FAT_ERROR_LOG("kmalloc failed (vnode=%p, file_ctx=%p). Out of memory.", vnode, file_ctx);
+         FAT_ERROR_LOG("Allocation failed (vnode=%p, file_ctx=%p). Out of memory.", vnode, file_ctx);
          ret_err = FS_ERR_OUT_OF_MEMORY;
          goto open_fail_locked;
      }
      memset(vnode, 0, sizeof(*vnode));
+     if (shared_ctx) {
+         FAT_DEBUG_LOG("Sharing open context %p (now %lu handles)", file_ctx, (unsigned long)file_ctx->refcount);
+         if (created || truncated) file_ctx->dirty = true;
+         goto link_vnode;
+     }
      memset(file_ctx, 0, sizeof(*file_ctx));
      FAT_DEBUG_LOG("Allocation successful: vnode=%p, file_ctx=%p", vnode, file_ctx);
 
@@ -233,18 +259,28 @@ static void fat_format_short_name_impl(const uint8_t name_8_3[11], char *out_nam
      }
      file_ctx->readdir_current_offset = 0;
      file_ctx->readdir_last_index = (size_t)-1; // Initialize readdir state
+     memcpy(file_ctx->short_name, entry.name, sizeof(file_ctx->short_name));
+     file_ctx->attr                = entry.attr;
+     file_ctx->write_time          = entry.write_time;
+     file_ctx->write_date          = entry.write_date;
+     file_ctx->creation_time       = entry.creation_time;
+     file_ctx->creation_date       = entry.creation_date;
+     file_ctx->refcount = 1;
+     kmutex_init(&file_ctx->io_lock, false);
+     if (!file_ctx->is_directory) fat_vcache_insert(fs, file_ctx);
      FAT_DEBUG_LOG("Context populated: first_cluster=%lu, size=%lu, is_dir=%d, dirty=%d",
                    (unsigned long)file_ctx->first_cluster, (unsigned long)file_ctx->file_size,
                    file_ctx->is_directory, file_ctx->dirty);
 
      // --- 5. Link context to Vnode ---
+ link_vnode:
      FAT_DEBUG_LOG("Step 5: Linking context %p to vnode %p...", file_ctx, vnode);
      vnode->data = file_ctx;
      vnode->fs_driver = &fat_vfs_driver; // Assuming fat_vfs_driver is the global driver struct
 
      // --- Success ---
      FAT_DEBUG_LOG("Step 6: Success Path.");
-     spinlock_release_irqrestore(&fs->lock, irq_flags);
+     kmutex_unlock(&fs->lock);
      FAT_DEBUG_LOG("Lock released.");
      FAT_INFO_LOG("Open successful: path='%s', vnode=%p, size=%lu", path ? path : "<NULL>", vnode, (unsigned long)file_ctx->file_size);
      return vnode;
@@ -254,8 +290,10 @@ static void fat_format_short_name_impl(const uint8_t name_8_3[11], char *out_nam
      FAT_DEBUG_LOG("Step F: Failure Path Entered (ret_err=%d).", ret_err);
      FAT_ERROR_LOG("Open failed: path='%s', error=%d (%s)", path ? path : "<NULL>", ret_err, fs_strerror(ret_err)); // Log the final error
      if (vnode) { FAT_DEBUG_LOG("Freeing vnode %p", vnode); kfree(vnode); }
-     if (file_ctx) { FAT_DEBUG_LOG("Freeing file_ctx %p", file_ctx); kfree(file_ctx); }
-     spinlock_release_irqrestore(&fs->lock, irq_flags);
+     if (file_ctx && shared_ctx) {
+         fat_vcache_release(fs, file_ctx); // Only drops this open's reference: others hold it
+     } else if (file_ctx) { FAT_DEBUG_LOG("Freeing file_ctx %p", file_ctx); fat_free_file_context(file_ctx); }
+     kmutex_unlock(&fs->lock);
      FAT_DEBUG_LOG("Lock released.");
      return NULL;
  }
@@ -287,7 +325,7 @@ int fat_readdir_internal(file_t *dir_file, struct dirent *d_entry_out, size_t en
     fat_fs_t *fs = fctx->fs;
     FAT_DEBUG_LOG("Context valid: fs=%p, first_cluster=%lu", fs, (unsigned long)fctx->first_cluster);
 
-    uintptr_t irq_flags = spinlock_acquire_irqsave(&fs->lock);
+    kmutex_lock(&fs->lock);
 
     // --- State Management ---
     FAT_DEBUG_LOG("Checking readdir state: requested_idx=%lu, last_idx=%lu, current_cluster=%lu, current_offset=%lu",
@@ -314,7 +352,7 @@ int fat_readdir_internal(file_t *dir_file, struct dirent *d_entry_out, size_t en
     } else if (entry_index != fctx->readdir_last_index + 1) {
         FAT_WARN_LOG("Non-sequential index requested (%lu requested, %lu expected). Seeking not implemented, failing.", // Now uses DEBUG log
                      (unsigned long)entry_index, (unsigned long)(fctx->readdir_last_index + 1));
-        spinlock_release_irqrestore(&fs->lock, irq_flags);
+        kmutex_unlock(&fs->lock);
         return FS_ERR_INVALID_PARAM;
     }
 
@@ -322,7 +360,7 @@ int fat_readdir_internal(file_t *dir_file, struct dirent *d_entry_out, size_t en
      uint8_t *sector_buffer = kmalloc(fs->bytes_per_sector);
     if (!sector_buffer) {
         FAT_ERROR_LOG("Failed to allocate %u bytes for sector buffer.", fs->bytes_per_sector);
-        spinlock_release_irqrestore(&fs->lock, irq_flags);
+        kmutex_unlock(&fs->lock);
         return FS_ERR_OUT_OF_MEMORY;
     }
     FAT_DEBUG_LOG("Allocated sector buffer at %p (%u bytes).", sector_buffer, fs->bytes_per_sector);
@@ -482,7 +520,178 @@ readdir_done:
     FAT_DEBUG_LOG("Exiting: Releasing lock, freeing buffer %p, returning status %d (%s).",
                    sector_buffer, ret, fs_strerror(ret));
     kfree(sector_buffer);
-    spinlock_release_irqrestore(&fs->lock, irq_flags);
+    kmutex_unlock(&fs->lock);
+    return ret;
+}
+
+// ==========================================================================
+// == fat_getdents_internal ==
+// ==========================================================================
+int fat_getdents_internal(file_t *dir_file, void *buf, size_t len, off_t *cookie)
+{
+    if (!dir_file || !dir_file->vnode || !dir_file->vnode->data || !buf || !cookie) return FS_ERR_INVALID_PARAM;
+    fat_file_context_t *fctx = (fat_file_context_t*)dir_file->vnode->data;
+    if (!fctx->fs || !fctx->is_directory) return FS_ERR_NOT_A_DIRECTORY;
+    fat_fs_t *fs = fctx->fs;
+    if (*cookie < 0 || (*cookie % sizeof(fat_dir_entry_t)) != 0) return FS_ERR_INVALID_PARAM;
+
+    const bool fixed_root = (fs->type != FAT_TYPE_FAT32 && fctx->first_cluster == 0);
+    const uint32_t element_bytes = fixed_root ? (uint32_t)fs->root_dir_sectors * fs->bytes_per_sector
+                                              : fs->cluster_size_bytes;
+    const size_t entries_per_sector = fs->bytes_per_sector / sizeof(fat_dir_entry_t);
+    uint32_t pos = (uint32_t)*cookie;               // Byte position in the directory
+    uint32_t next_cookie = pos;
+
+    uint8_t *sector_buffer = kmalloc(fs->bytes_per_sector);
+    if (!sector_buffer) return FS_ERR_OUT_OF_MEMORY;
+
+    kmutex_lock(&fs->lock);
+
+    // Walk the chain to the cluster holding the cookie
+    uint32_t cluster = fixed_root ? 0 : fctx->first_cluster;
+    uint32_t element_base = 0;
+    int ret = FS_SUCCESS;
+    bool at_end = fixed_root ? (pos >= element_bytes) : (cluster < 2);
+    while (!at_end && !fixed_root && pos - element_base >= element_bytes) {
+        uint32_t next_c;
+        ret = fat_get_next_cluster(fs, cluster, &next_c);
+        if (ret != FS_SUCCESS) break;
+        if (next_c >= fs->eoc_marker) at_end = true;
+        else cluster = next_c;
+        element_base += element_bytes;
+    }
+
+    fat_lfn_entry_t lfn_collector[FAT_MAX_LFN_ENTRIES];
+    int lfn_count = 0;
+    uint32_t group_pos = pos;                       // Where the entry being assembled starts
+    size_t used = 0;
+    bool full = false;
+
+    while (ret == FS_SUCCESS && !at_end && !full) {
+        uint32_t offset = pos - element_base;
+        ret = read_directory_sector(fs, cluster, offset / fs->bytes_per_sector, sector_buffer);
+        if (ret != FS_SUCCESS) break;
+
+        for (size_t e_i = (offset % fs->bytes_per_sector) / sizeof(fat_dir_entry_t); e_i < entries_per_sector; e_i++) {
+            fat_dir_entry_t *dent = (fat_dir_entry_t*)(sector_buffer + e_i * sizeof(fat_dir_entry_t));
+            uint32_t entry_pos = pos;
+
+            if (dent->name[0] == FAT_DIR_ENTRY_UNUSED) {
+                // Stay on the end mark: entries created later are listed by the next call
+                next_cookie = entry_pos;
+                at_end = true;
+                break;
+            }
+            pos += sizeof(fat_dir_entry_t);
+            if (dent->name[0] == FAT_DIR_ENTRY_DELETED || dent->name[0] == FAT_DIR_ENTRY_KANJI) { lfn_count = 0; continue; }
+            if ((dent->attr & FAT_ATTR_VOLUME_ID) && !(dent->attr & FAT_ATTR_LONG_NAME)) { lfn_count = 0; continue; }
+
+            if ((dent->attr & FAT_ATTR_LONG_NAME_MASK) == FAT_ATTR_LONG_NAME) {
+                if (lfn_count == 0) group_pos = entry_pos;
+                if (lfn_count < FAT_MAX_LFN_ENTRIES) lfn_collector[lfn_count++] = *(fat_lfn_entry_t*)dent;
+                else lfn_count = 0;
+                continue;
+            }
+
+            // An 8.3 entry: one record, named as fat_readdir_internal() names it
+            if (lfn_count == 0) group_pos = entry_pos;
+            char final_name[FAT_MAX_LFN_CHARS];
+            final_name[0] = '\0';
+            if (lfn_count > 0 && lfn_collector[0].checksum == fat_calculate_lfn_checksum(dent->name)) {
+                fat_reconstruct_lfn(lfn_collector, lfn_count, final_name, sizeof(final_name));
+            }
+            lfn_count = 0;
+            if (final_name[0] == '\0') fat_format_short_name_impl(dent->name, final_name);
+
+            size_t name_len = strlen(final_name);
+            if (name_len > MAX_FILENAME_LEN) name_len = MAX_FILENAME_LEN;
+            size_t reclen = DIRENT_REC_LEN(name_len);
+            if (used + reclen > len) {
+                // Resume at the start of this entry's LFN run
+                next_cookie = group_pos;
+                full = true;
+                break;
+            }
+            struct dirent_rec *rec = (struct dirent_rec*)((uint8_t*)buf + used);
+            rec->d_ino = fat_get_entry_cluster(dent);
+            rec->d_off = pos;
+            rec->d_reclen = (uint16_t)reclen;
+            rec->d_type = (dent->attr & FAT_ATTR_DIRECTORY) ? DT_DIR : DT_REG;
+            memcpy(rec->d_name, final_name, name_len);
+            memset(rec->d_name + name_len, 0, reclen - __builtin_offsetof(struct dirent_rec, d_name) - name_len);
+            used += reclen;
+            next_cookie = pos;
+        }
+        if (at_end || full) break;
+
+        // Next sector, then next cluster
+        if (pos - element_base >= element_bytes) {
+            if (fixed_root) {
+                next_cookie = pos;
+                at_end = true;
+                break;
+            }
+            uint32_t next_c;
+            ret = fat_get_next_cluster(fs, cluster, &next_c);
+            if (ret != FS_SUCCESS) break;
+            element_base += element_bytes;
+            if (next_c >= fs->eoc_marker) {
+                next_cookie = pos;
+                at_end = true;
+                break;
+            }
+            cluster = next_c;
+        }
+    }
+
+    kmutex_unlock(&fs->lock);
+    kfree(sector_buffer);
+
+    if (ret != FS_SUCCESS && used == 0) return ret;
+    if (full && used == 0) return FS_ERR_INVALID_PARAM;
+    *cookie = (off_t)next_cookie;
+    return (int)used;
+}
+
+void fat_entry_to_stat(const fat_fs_t *fs, const fat_dir_entry_t *entry, struct vfs_stat *st)
+{
+    bool is_dir = (entry->attr & FAT_ATTR_DIRECTORY) != 0;
+    uint32_t mode = is_dir ? (VFS_S_IFDIR | 0755) : (VFS_S_IFREG | 0644);
+    if (entry->attr & FAT_ATTR_READ_ONLY) mode &= ~(uint32_t)0222;
+
+    st->st_ino = fat_get_entry_cluster(entry);
+    st->st_mode = mode;
+    st->st_size = is_dir ? 0 : entry->file_size;
+    st->st_blksize = fs->cluster_size_bytes;
+    st->st_blocks = (fs->cluster_size_bytes && !is_dir)
+                    ? entry->file_size / fs->cluster_size_bytes + (entry->file_size % fs->cluster_size_bytes != 0)
+                    : 0;
+    st->st_attr = entry->attr;
+    st->st_mtime = fat_timestamp_to_unix(entry->write_time, entry->write_date);
+    st->st_ctime = fat_timestamp_to_unix(entry->creation_time, entry->creation_date);
+}
+
+int fat_stat_internal(void *fs_context, const char *path, struct vfs_stat *st)
+{
+    fat_fs_t *fs = (fat_fs_t *)fs_context;
+    if (!fs || !path || !st) return FS_ERR_INVALID_PARAM;
+
+    fat_dir_entry_t entry;
+    uint32_t entry_dir_cluster = 0, entry_offset = 0;
+    kmutex_lock(&fs->lock);
+    int ret = fat_lookup_path(fs, path, &entry, NULL, 0, &entry_dir_cluster, &entry_offset);
+    if (ret == FS_SUCCESS && !(entry.attr & FAT_ATTR_DIRECTORY)) {
+        // Writers leave the entry to the last close: an open context is ahead of it
+        fat_file_context_t *open_ctx = fat_vcache_lookup(fs, entry_dir_cluster, entry_offset, entry.name, false);
+        if (open_ctx) {
+            entry.file_size = open_ctx->file_size;
+            entry.first_cluster_low = (uint16_t)(open_ctx->first_cluster & 0xFFFF);
+            entry.first_cluster_high = (uint16_t)(open_ctx->first_cluster >> 16);
+        }
+    }
+    kmutex_unlock(&fs->lock);
+
+    if (ret == FS_SUCCESS) fat_entry_to_stat(fs, &entry, st);
     return ret;
 }
 
@@ -494,7 +703,7 @@ int fat_unlink_internal(void *fs_context, const char *path)
      fat_fs_t *fs = (fat_fs_t*)fs_context;
      if (!fs || !path) return FS_ERR_INVALID_PARAM;
 
-     uintptr_t irq_flags = spinlock_acquire_irqsave(&fs->lock);
+     kmutex_lock(&fs->lock);
      int ret = FS_SUCCESS; // Assume success initially
 
      // 1. Split path into parent directory path and final component name
@@ -553,7 +762,18 @@ int fat_unlink_internal(void *fs_context, const char *path)
      }
 
      // --- Free cluster chain ---
-     uint32_t file_cluster = fat_get_entry_cluster(&entry_to_delete);
+     // An open file's chain is the shared context's (the entry may lag behind it); the last close frees any more
+     fat_file_context_t *open_ctx = fat_vcache_lookup(fs, parent_cluster, entry_offset, entry_to_delete.name, false);
+     uint32_t file_cluster = open_ctx ? 0 : fat_get_entry_cluster(&entry_to_delete);
+     if (open_ctx) {
+         int free_res = fat_discard_file_data(fs, open_ctx);
+         if (free_res != FS_SUCCESS) {
+             FAT_WARN_LOG("Warning: Error freeing cluster chain for '%s' (err %d).", path, free_res);
+             ret = free_res;
+         }
+         fat_vcache_forget(fs, open_ctx);
+         open_ctx->unlinked = true;
+     }
      if (file_cluster >= 2) { // Only free if file actually has clusters allocated
          int free_res = fat_free_cluster_chain(fs, file_cluster);
          if (free_res != FS_SUCCESS) {
@@ -591,7 +811,7 @@ int fat_unlink_internal(void *fs_context, const char *path)
      // Fall through to return FS_SUCCESS unless an error occurred and wasn't fatal
 
  unlink_fail_locked:
-     spinlock_release_irqrestore(&fs->lock, irq_flags);
+     kmutex_unlock(&fs->lock);
      return ret; // Return final status
  }
 
@@ -621,12 +841,24 @@ int fat_find_in_dir(fat_fs_t *fs,
     if (lfn_out && lfn_max_len > 0) lfn_out[0] = '\0';
     if (first_lfn_offset_out) *first_lfn_offset_out = (uint32_t)-1;
 
-    uint8_t *sector_data = kmalloc(fs->bytes_per_sector);
+    int cached_result;
+    if (fat_dcache_lookup(fs, dir_cluster, component, &cached_result,
+                          entry_out, entry_offset_in_dir_out, first_lfn_offset_out)) {
+        return cached_result;
+    }
+    if (fat_dirindex_lookup(fs, dir_cluster, component, &cached_result,
+                            entry_out, entry_offset_in_dir_out, first_lfn_offset_out)) {
+        fat_find_in_dir_remember(fs, dir_cluster, component, cached_result,
+                                 entry_out, *entry_offset_in_dir_out, first_lfn_offset_out);
+        return cached_result;
+    }
+
+    // fs->lock is held, so the volume's scan buffer is ours until we return
+    uint8_t *sector_data = fs->lookup_sector ? fs->lookup_sector : kmalloc(fs->bytes_per_sector);
     if (!sector_data) {
         FAT_ERROR_LOG("ERROR: Failed to allocate sector buffer (%u bytes)", fs->bytes_per_sector);
         return FS_ERR_OUT_OF_MEMORY;
     }
-    FAT_DEBUG_LOG("Allocated sector buffer at %p", sector_data);
 
     fat_lfn_entry_t lfn_collector[FAT_MAX_LFN_ENTRIES];
     int lfn_count = 0;
@@ -718,12 +950,38 @@ int fat_find_in_dir(fat_fs_t *fs,
     } // End while loop
 
 find_done:
-    FAT_DEBUG_LOG("Exit: Freeing buffer %p, returning status %d (%s)",
-                  sector_data, ret, fs_strerror(ret));
-    kfree(sector_data);
+    FAT_DEBUG_LOG("Exit: returning status %d (%s)", ret, fs_strerror(ret));
+    if (sector_data != fs->lookup_sector) kfree(sector_data);
+    fat_find_in_dir_remember(fs, dir_cluster, component, ret,
+                             entry_out, *entry_offset_in_dir_out, first_lfn_offset_out);
     return ret;
 }
 
+/** @brief Enters a fat_find_in_dir() result into the lookup cache. */
+static void fat_find_in_dir_remember(fat_fs_t *fs, uint32_t dir_cluster, const char *component, int result,
+                                     const fat_dir_entry_t *entry, uint32_t entry_offset,
+                                     const uint32_t *first_lfn_offset)
+{
+    if (result == FS_SUCCESS) {
+        fat_dcache_insert(fs, dir_cluster, component, entry, entry_offset,
+                          first_lfn_offset ? *first_lfn_offset : (uint32_t)-1);
+    } else if (result == FS_ERR_NOT_FOUND) {
+        fat_dcache_insert(fs, dir_cluster, component, NULL, 0, (uint32_t)-1);
+    }
+}
+
+/**
+ * @brief Drops cached lookups after entries changed in a directory cluster.
+ * The writers are handed the cluster the entries live in, which for a long
+ * directory need not be its first; unless an index said which directory
+ * that is (owner), every cached name goes.
+ */
+static void fat_dir_forget_names(fat_fs_t *fs, bool owner_known, uint32_t owner)
+{
+    if (owner_known) fat_dcache_invalidate_dir(fs, owner);
+    else fat_dcache_invalidate_all(fs);
+}
+
 
 // ==========================================================================
 // == fat_lookup_path - Definition should remain here ==
@@ -739,7 +997,12 @@ int fat_lookup_path(fat_fs_t *fs, const char *path,
 
     FAT_DEBUG_LOG("Received path from VFS: '%s'", path);
 
-    if (path[0] == '\0' || strcmp(path, "/") == 0) {
+    // Components are read in place; "." and ".." are already resolved
+    path_walk_t walk;
+    path_comp_t comp;
+    path_walk_init(&walk, path);
+
+    if (path_walk_done(&walk)) {
         FAT_DEBUG_LOG("Handling as root directory.");
         memset(entry_out, 0, sizeof(*entry_out));
         entry_out->attr = FAT_ATTR_DIRECTORY;
@@ -757,11 +1020,9 @@ int fat_lookup_path(fat_fs_t *fs, const char *path,
         return FS_SUCCESS;
     }
 
-    char *path_copy = kmalloc(strlen(path) + 1);
-    if (!path_copy) return FS_ERR_OUT_OF_MEMORY;
-    strcpy(path_copy, path);
-
-    char *component = strtok(path_copy, "/");
+    // The caches and name comparisons take NUL-terminated names: each
+    // component is terminated in this one buffer, no allocation per lookup
+    char component[FAT_MAX_LFN_CHARS];
     uint32_t current_dir_cluster = (fs->type == FAT_TYPE_FAT32) ? fs->root_cluster : 0;
     fat_dir_entry_t current_entry;
     memset(&current_entry, 0, sizeof(current_entry));
@@ -769,9 +1030,10 @@ int fat_lookup_path(fat_fs_t *fs, const char *path,
     uint32_t previous_dir_cluster = 0;
     int ret = FS_ERR_NOT_FOUND;
 
-    while (component != NULL) {
-        if (strcmp(component, ".") == 0) { component = strtok(NULL, "/"); continue; }
-        if (strcmp(component, "..") == 0) { ret = FS_ERR_NOT_SUPPORTED; goto lookup_done; }
+    while (path_walk_next(&walk, &comp)) {
+        if (comp.len >= sizeof(component)) { ret = FS_ERR_NAMETOOLONG; goto lookup_done; }
+        memcpy(component, comp.name, comp.len);
+        component[comp.len] = '\0';
 
         previous_dir_cluster = current_dir_cluster;
         uint32_t component_entry_offset;
@@ -780,8 +1042,7 @@ int fat_lookup_path(fat_fs_t *fs, const char *path,
                                              &component_entry_offset, NULL);
         if (find_comp_res != FS_SUCCESS) { ret = find_comp_res; goto lookup_done; }
 
-        char* next_component = strtok(NULL, "/");
-        if (next_component == NULL) {
+        if (path_walk_done(&walk)) {
             memcpy(entry_out, &current_entry, sizeof(*entry_out));
             *entry_dir_cluster_out = previous_dir_cluster;
             *entry_offset_in_dir_out = component_entry_offset;
@@ -792,12 +1053,10 @@ int fat_lookup_path(fat_fs_t *fs, const char *path,
         if (!(current_entry.attr & FAT_ATTR_DIRECTORY)) { ret = FS_ERR_NOT_A_DIRECTORY; goto lookup_done; }
         current_dir_cluster = fat_get_entry_cluster(&current_entry);
         if (fs->type != FAT_TYPE_FAT32 && current_dir_cluster == 0 && previous_dir_cluster != 0) { ret = FS_ERR_INVALID_FORMAT; goto lookup_done; }
-        component = next_component;
     }
 
 lookup_done:
     FAT_DEBUG_LOG("Exit: Path='%s', returning status %d (%s)", path, ret, fs_strerror(ret));
-    kfree(path_copy);
     return ret;
 }
 
@@ -841,13 +1100,42 @@ int read_directory_sector(fat_fs_t *fs, uint32_t cluster,
         return FS_ERR_INVALID_PARAM;
     }
 
-    buffer_t* b = buffer_get(fs->disk_ptr->blk_dev.device_name, lba);
+    buffer_t* b = buffer_get(fs->disk_ptr, lba);
     if (!b) return FS_ERR_IO;
     memcpy(buffer, b->data, fs->bytes_per_sector);
     buffer_release(b);
     return FS_SUCCESS;
 }
 
+/**
+ * @brief Finds the LBA of the sector holding the entry at @p dir_offset of
+ * a directory, following its cluster chain. Assumes fs->lock is held.
+ */
+int fat_dir_entry_lba(fat_fs_t *fs, uint32_t dir_cluster, uint32_t dir_offset, uint32_t *lba_out)
+{
+    uint32_t sector_offset_in_chain = dir_offset / fs->bytes_per_sector;
+    if (dir_cluster == 0 && fs->type != FAT_TYPE_FAT32) {
+         if (sector_offset_in_chain >= fs->root_dir_sectors) return FS_ERR_INVALID_PARAM;
+         *lba_out = fs->root_dir_start_lba + sector_offset_in_chain;
+         return FS_SUCCESS;
+    }
+    if (dir_cluster < 2) return FS_ERR_INVALID_PARAM;
+
+    uint32_t current_cluster = dir_cluster;
+    uint32_t cluster_hop_count = sector_offset_in_chain / fs->sectors_per_cluster;
+    for (uint32_t i = 0; i < cluster_hop_count; i++) {
+         uint32_t next_cluster;
+         int ret = fat_get_next_cluster(fs, current_cluster, &next_cluster);
+         if (ret != FS_SUCCESS) return ret;
+         if (next_cluster >= fs->eoc_marker) return FS_ERR_INVALID_PARAM;
+         current_cluster = next_cluster;
+    }
+    uint32_t cluster_lba = fat_cluster_to_lba(fs, current_cluster);
+    if (cluster_lba == 0) return FS_ERR_IO;
+    *lba_out = cluster_lba + sector_offset_in_chain % fs->sectors_per_cluster;
+    return FS_SUCCESS;
+}
+
 // ==========================================================================
 // == update_directory_entry - Definition should remain here ==
 // ==========================================================================
@@ -861,41 +1149,22 @@ int update_directory_entry(fat_fs_t *fs,
     KERNEL_ASSERT(fs->bytes_per_sector > 0, "Invalid bytes_per_sector");
 
     size_t sector_size = fs->bytes_per_sector;
-    uint32_t sector_offset_in_chain = dir_offset / sector_size;
     size_t offset_in_sector = dir_offset % sector_size;
 
     KERNEL_ASSERT(offset_in_sector % sizeof(fat_dir_entry_t) == 0, "Directory entry offset misaligned");
     KERNEL_ASSERT(offset_in_sector + sizeof(fat_dir_entry_t) <= sector_size, "Directory entry update crosses sector boundary");
 
     uint32_t lba;
-    int ret = FS_SUCCESS;
-    if (dir_cluster == 0 && fs->type != FAT_TYPE_FAT32) {
-         if (sector_offset_in_chain >= fs->root_dir_sectors) return FS_ERR_INVALID_PARAM;
-         lba = fs->root_dir_start_lba + sector_offset_in_chain;
-    } else if (dir_cluster >= 2) {
-         uint32_t current_cluster = dir_cluster;
-         uint32_t sectors_per_cluster = fs->sectors_per_cluster;
-         uint32_t cluster_hop_count = sector_offset_in_chain / sectors_per_cluster;
-         uint32_t sector_in_final_cluster = sector_offset_in_chain % sectors_per_cluster;
-         for (uint32_t i = 0; i < cluster_hop_count; i++) {
-             uint32_t next_cluster;
-             ret = fat_get_next_cluster(fs, current_cluster, &next_cluster);
-             if (ret != FS_SUCCESS) return ret;
-             if (next_cluster >= fs->eoc_marker) return FS_ERR_INVALID_PARAM;
-             current_cluster = next_cluster;
-         }
-         uint32_t cluster_lba = fat_cluster_to_lba(fs, current_cluster);
-         if (cluster_lba == 0) return FS_ERR_IO;
-         lba = cluster_lba + sector_in_final_cluster;
-    } else {
-        return FS_ERR_INVALID_PARAM;
-    }
+    int ret = fat_dir_entry_lba(fs, dir_cluster, dir_offset, &lba);
+    if (ret != FS_SUCCESS) return ret;
 
-    buffer_t* b = buffer_get(fs->disk_ptr->blk_dev.device_name, lba);
+    buffer_t* b = buffer_get(fs->disk_ptr, lba);
     if (!b) return FS_ERR_IO;
     memcpy(b->data + offset_in_sector, new_entry, sizeof(fat_dir_entry_t));
     buffer_mark_dirty(b);
     buffer_release(b);
+    fat_dcache_update(fs, dir_cluster, dir_offset, new_entry);
+    fat_dirindex_note_update(fs, dir_cluster, dir_offset, new_entry);
     return FS_SUCCESS;
 }
 
@@ -916,6 +1185,8 @@ int mark_directory_entries_deleted(fat_fs_t *fs,
     int result = FS_SUCCESS;
     size_t entries_marked = 0;
     uint32_t current_offset = first_entry_offset;
+    uint32_t owner;
+    bool owner_known = fat_dirindex_owner(fs, dir_cluster, &owner);
 
     while (entries_marked < num_entries) {
         uint32_t sector_offset_in_chain = current_offset / sector_size;
@@ -943,7 +1214,7 @@ int mark_directory_entries_deleted(fat_fs_t *fs,
              lba = cluster_lba + sector_in_final_cluster;
          } else { result = FS_ERR_INVALID_PARAM; break; }
 
-        buffer_t* b = buffer_get(fs->disk_ptr->blk_dev.device_name, lba);
+        buffer_t* b = buffer_get(fs->disk_ptr, lba);
         if (!b) { result = FS_ERR_IO; break; }
 
         bool buffer_dirtied = false;
@@ -960,6 +1231,9 @@ int mark_directory_entries_deleted(fat_fs_t *fs,
         if (result != FS_SUCCESS) break;
     }
 mark_fail:
+    if (result == FS_SUCCESS) fat_dirindex_note_delete(fs, dir_cluster, first_entry_offset, num_entries, marker);
+    else fat_dirindex_invalidate(fs, dir_cluster);
+    fat_dir_forget_names(fs, owner_known, owner);
     return result;
 }
 
@@ -981,6 +1255,8 @@ int write_directory_entries(fat_fs_t *fs, uint32_t dir_cluster,
     const uint8_t *src_buf = (const uint8_t *)entries_buf;
     size_t bytes_written = 0;
     int result = FS_SUCCESS;
+    uint32_t owner;
+    bool owner_known = fat_dirindex_owner(fs, dir_cluster, &owner);
 
     while (bytes_written < total_bytes) {
         uint32_t current_abs_offset = dir_offset + (uint32_t)bytes_written;
@@ -1009,7 +1285,7 @@ int write_directory_entries(fat_fs_t *fs, uint32_t dir_cluster,
              lba = cluster_lba + sector_in_final_cluster;
          } else { result = FS_ERR_INVALID_PARAM; break; }
 
-        buffer_t* b = buffer_get(fs->disk_ptr->blk_dev.device_name, lba);
+        buffer_t* b = buffer_get(fs->disk_ptr, lba);
         if (!b) { result = FS_ERR_IO; break; }
 
         size_t bytes_to_write_this_sector = sector_size - offset_in_sector;
@@ -1025,6 +1301,9 @@ int write_directory_entries(fat_fs_t *fs, uint32_t dir_cluster,
         bytes_written += bytes_to_write_this_sector;
     }
 write_fail:
+    if (result == FS_SUCCESS) fat_dirindex_note_write(fs, dir_cluster, dir_offset, entries_buf, num_entries);
+    else fat_dirindex_invalidate(fs, dir_cluster);
+    fat_dir_forget_names(fs, owner_known, owner);
     return result;
 }
 
@@ -1040,6 +1319,11 @@ int find_free_directory_slot(fat_fs_t    *fs,
     FAT_DEBUG_LOG("Enter: Searching for %lu slots in dir_cluster %lu", (unsigned long)needed_slots, (unsigned long)parent_dir_cluster);
     KERNEL_ASSERT(fs && needed_slots && out_slot_cluster && out_slot_offset, "find_free_directory_slot: bad args");
 
+    // An indexed directory knows its free runs; it is only scanned when it must grow
+    if (fat_dirindex_find_slot(fs, parent_dir_cluster, needed_slots, out_slot_cluster, out_slot_offset)) {
+        return FS_SUCCESS;
+    }
+
     const bool fixed_root = (fs->type != FAT_TYPE_FAT32 && parent_dir_cluster == 0);
     const uint32_t bytes_per_entry = sizeof(fat_dir_entry_t);
     uint32_t cur_cluster   = parent_dir_cluster;
@@ -1190,7 +1474,7 @@ int find_free_directory_slot(fat_fs_t    *fs,
         }
         for (uint32_t s = 0; s < fs->sectors_per_cluster; ++s) {
             FAT_DEBUG_LOG("Zeroing sector %lu (LBA %lu) of new cluster %lu", (unsigned long)s, (unsigned long)(lba+s), (unsigned long)new_clu);
-            buffer_t *b = buffer_get(fs->disk_ptr->blk_dev.device_name, lba + s);
+            buffer_t *b = buffer_get(fs->disk_ptr, lba + s);
             if (!b) {
                 FAT_ERROR_LOG("Failed to get buffer for LBA %lu during zeroing!", (unsigned long)(lba+s));
                 status = FS_ERR_IO;
@@ -1202,6 +1486,8 @@ int find_free_directory_slot(fat_fs_t    *fs,
         }
         FAT_DEBUG_LOG("New cluster %lu zeroed successfully.", (unsigned long)new_clu);
 
+        fat_dirindex_note_extend(fs, parent_dir_cluster, last_cluster, new_clu);
+
         // Success! The free slot starts at the beginning of the new cluster
         *out_slot_cluster = new_clu;
         *out_slot_offset  = 0;
@@ -0,0 +1,719 @@
+/**
+ * @file fat_dirindex.c
+ * @brief In-memory index of whole FAT directories.
+ *
+ * Building an index walks the directory the way fat_find_in_dir() and
+ * find_free_directory_slot() do, so answers from it are the ones a scan
+ * would give. Positions are byte offsets into the directory as a whole
+ * (chain element * cluster_bytes + offset); callers get the (cluster,
+ * offset within that cluster) form the scanning code has always returned.
+ * Whenever a change does not fit the index cleanly it is dropped and the
+ * next access rebuilds it.
+ */
+
+#include <kernel/fs/fat/fat_dirindex.h>
+#include <kernel/fs/fat/fat_core.h>
+#include <kernel/fs/fat/fat_dir.h>
+#include <kernel/fs/fat/fat_lfn.h>
+#include <kernel/fs/fat/fat_utils.h>
+#include <kernel/drivers/storage/buffer_cache.h>
+#include <kernel/fs/vfs/fs_errno.h>
+#include <kernel/memory/kmalloc.h>
+#include <kernel/lib/string.h>
+#include <libc/ctype.h>
+
+#define FAT_DIRINDEX_ENTRY  ((uint32_t)sizeof(fat_dir_entry_t))
+
+// LFN entries seen since the last 8.3 entry (kmalloc'd: too big for the stack
+// under fat_find_in_dir's own collector)
+typedef struct {
+    fat_lfn_entry_t entries[FAT_MAX_LFN_ENTRIES];
+    int             count;
+    uint32_t        start_pos;
+    char            name[FAT_MAX_LFN_CHARS];
+} fat_dirindex_lfn_t;
+
+static uint32_t fat_dirindex_hash_sfn(const uint8_t sfn[11])
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 11; i++) {
+        h ^= sfn[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Case-folded, as fat_compare_lfn() compares
+static uint32_t fat_dirindex_hash_lfn(const char *name)
+{
+    uint32_t h = 2166136261u;
+    for (; *name; name++) {
+        h ^= (uint8_t)toupper((unsigned char)*name);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static bool fat_dirindex_grow(void **array, uint32_t *cap, uint32_t count, size_t elem_size)
+{
+    if (count < *cap) return true;
+    uint32_t new_cap = *cap ? *cap * 2 : 8;
+    void *grown = kmalloc(new_cap * elem_size);
+    if (!grown) return false;
+    if (*array) {
+        memcpy(grown, *array, count * elem_size);
+        kfree(*array);
+    }
+    *array = grown;
+    *cap = new_cap;
+    return true;
+}
+
+static void fat_dirindex_free(fat_dirindex_t *ix)
+{
+    for (uint32_t i = 0; i < ix->name_count; i++) {
+        if (ix->names[i].used) kfree(ix->names[i].lfn);
+    }
+    kfree(ix->clusters);
+    kfree(ix->names);
+    kfree(ix->sfn_buckets);
+    kfree(ix->lfn_buckets);
+    kfree(ix->runs);
+    memset(ix, 0, sizeof(*ix));
+}
+
+/* --- Names --- */
+
+// Rehashes every live name into bucket_count buckets
+static int fat_dirindex_set_buckets(fat_dirindex_t *ix, uint32_t bucket_count)
+{
+    int32_t *sfn_buckets = kmalloc(bucket_count * sizeof(int32_t));
+    int32_t *lfn_buckets = kmalloc(bucket_count * sizeof(int32_t));
+    if (!sfn_buckets || !lfn_buckets) {
+        kfree(sfn_buckets);
+        kfree(lfn_buckets);
+        return FS_ERR_OUT_OF_MEMORY;
+    }
+    memset(sfn_buckets, 0xFF, bucket_count * sizeof(int32_t));
+    memset(lfn_buckets, 0xFF, bucket_count * sizeof(int32_t));
+    for (uint32_t i = 0; i < ix->name_count; i++) {
+        fat_dirindex_name_t *n = &ix->names[i];
+        if (!n->used) continue;
+        n->sfn_next = sfn_buckets[n->sfn_hash & (bucket_count - 1)];
+        sfn_buckets[n->sfn_hash & (bucket_count - 1)] = (int32_t)i;
+        if (n->lfn) {
+            n->lfn_next = lfn_buckets[n->lfn_hash & (bucket_count - 1)];
+            lfn_buckets[n->lfn_hash & (bucket_count - 1)] = (int32_t)i;
+        }
+    }
+    kfree(ix->sfn_buckets);
+    kfree(ix->lfn_buckets);
+    ix->sfn_buckets = sfn_buckets;
+    ix->lfn_buckets = lfn_buckets;
+    ix->bucket_count = bucket_count;
+    return FS_SUCCESS;
+}
+
+static int fat_dirindex_add_name(fat_dirindex_t *ix, const uint8_t sfn[11], const char *lfn,
+                                 uint32_t pos, uint32_t lfn_pos)
+{
+    char *lfn_copy = NULL;
+    if (lfn) {
+        size_t len = strlen(lfn) + 1;
+        lfn_copy = kmalloc(len);
+        if (!lfn_copy) return FS_ERR_OUT_OF_MEMORY;
+        memcpy(lfn_copy, lfn, len);
+    }
+
+    int32_t idx;
+    if (ix->name_free >= 0) {
+        idx = ix->name_free;
+        ix->name_free = ix->names[idx].sfn_next;
+    } else {
+        if (!fat_dirindex_grow((void **)&ix->names, &ix->name_cap, ix->name_count, sizeof(fat_dirindex_name_t))) {
+            kfree(lfn_copy);
+            return FS_ERR_OUT_OF_MEMORY;
+        }
+        idx = (int32_t)ix->name_count++;
+    }
+
+    fat_dirindex_name_t *n = &ix->names[idx];
+    uint32_t mask = ix->bucket_count - 1;
+    memcpy(n->sfn, sfn, 11);
+    n->used = true;
+    n->lfn = lfn_copy;
+    n->pos = pos;
+    n->lfn_pos = lfn_pos;
+    n->sfn_hash = fat_dirindex_hash_sfn(sfn);
+    n->sfn_next = ix->sfn_buckets[n->sfn_hash & mask];
+    ix->sfn_buckets[n->sfn_hash & mask] = idx;
+    n->lfn_next = -1;
+    if (lfn_copy) {
+        n->lfn_hash = fat_dirindex_hash_lfn(lfn_copy);
+        n->lfn_next = ix->lfn_buckets[n->lfn_hash & mask];
+        ix->lfn_buckets[n->lfn_hash & mask] = idx;
+    }
+    ix->live_names++;
+
+    if (ix->live_names > 2 * ix->bucket_count) {
+        fat_dirindex_set_buckets(ix, ix->bucket_count * 2); // Longer chains if this fails
+    }
+    return FS_SUCCESS;
+}
+
+static void fat_dirindex_unlink(int32_t *head, fat_dirindex_name_t *names, int32_t idx, bool lfn_chain)
+{
+    for (int32_t *link = head; *link >= 0;
+         link = lfn_chain ? &names[*link].lfn_next : &names[*link].sfn_next) {
+        if (*link == idx) {
+            *link = lfn_chain ? names[idx].lfn_next : names[idx].sfn_next;
+            return;
+        }
+    }
+}
+
+static void fat_dirindex_remove_name(fat_dirindex_t *ix, int32_t idx)
+{
+    fat_dirindex_name_t *n = &ix->names[idx];
+    uint32_t mask = ix->bucket_count - 1;
+    fat_dirindex_unlink(&ix->sfn_buckets[n->sfn_hash & mask], ix->names, idx, false);
+    if (n->lfn) {
+        fat_dirindex_unlink(&ix->lfn_buckets[n->lfn_hash & mask], ix->names, idx, true);
+        kfree(n->lfn);
+    }
+    memset(n, 0, sizeof(*n));
+    n->sfn_next = ix->name_free;
+    ix->name_free = idx;
+    ix->live_names--;
+}
+
+// Removes the names lying in [a, b). Returns the slots they took, or -1 if
+// a name straddles either edge.
+static int32_t fat_dirindex_drop_names(fat_dirindex_t *ix, uint32_t a, uint32_t b)
+{
+    int32_t slots = 0;
+    for (uint32_t i = 0; i < ix->name_count; i++) {
+        fat_dirindex_name_t *n = &ix->names[i];
+        if (!n->used) continue;
+        uint32_t start = n->lfn_pos, end = n->pos + FAT_DIRINDEX_ENTRY;
+        if (end <= a || start >= b) continue;
+        if (start < a || end > b) return -1;
+        slots += (int32_t)((end - start) / FAT_DIRINDEX_ENTRY);
+        fat_dirindex_remove_name(ix, (int32_t)i);
+    }
+    return slots;
+}
+
+// Feeds one in-use entry through the LFN collector the way fat_find_in_dir() does
+static int fat_dirindex_take_entry(fat_dirindex_t *ix, fat_dirindex_lfn_t *lfn,
+                                   const fat_dir_entry_t *de, uint32_t pos)
+{
+    if (de->name[0] == FAT_DIR_ENTRY_KANJI) {
+        // Skipped by lookups, but its 8.3 name is taken
+        lfn->count = 0;
+        return fat_dirindex_add_name(ix, de->name, NULL, pos, pos);
+    }
+    if ((de->attr & FAT_ATTR_VOLUME_ID) && !(de->attr & FAT_ATTR_LONG_NAME)) {
+        lfn->count = 0;
+        return FS_SUCCESS;
+    }
+    if ((de->attr & FAT_ATTR_LONG_NAME_MASK) == FAT_ATTR_LONG_NAME) {
+        if (lfn->count == 0) lfn->start_pos = pos;
+        if (lfn->count < FAT_MAX_LFN_ENTRIES) lfn->entries[lfn->count++] = *(const fat_lfn_entry_t *)de;
+        else lfn->count = 0;
+        return FS_SUCCESS;
+    }
+
+    const char *long_name = NULL;
+    uint32_t lfn_pos = pos;
+    if (lfn->count > 0 && lfn->entries[0].checksum == fat_calculate_lfn_checksum(de->name)) {
+        fat_reconstruct_lfn(lfn->entries, lfn->count, lfn->name, sizeof(lfn->name));
+        long_name = lfn->name;
+        lfn_pos = lfn->start_pos;
+    }
+    lfn->count = 0;
+    return fat_dirindex_add_name(ix, de->name, long_name, pos, lfn_pos);
+}
+
+/* --- Free runs --- */
+
+static uint32_t fat_dirindex_run_end(const fat_dirindex_run_t *r)
+{
+    return r->pos + r->slots * FAT_DIRINDEX_ENTRY;
+}
+
+static int fat_dirindex_insert_run(fat_dirindex_t *ix, uint32_t at, uint32_t pos, uint32_t slots, bool at_end)
+{
+    if (!fat_dirindex_grow((void **)&ix->runs, &ix->run_cap, ix->run_count, sizeof(fat_dirindex_run_t))) {
+        return FS_ERR_OUT_OF_MEMORY;
+    }
+    memmove(&ix->runs[at + 1], &ix->runs[at], (ix->run_count - at) * sizeof(fat_dirindex_run_t));
+    ix->runs[at].pos = pos;
+    ix->runs[at].slots = slots;
+    ix->runs[at].at_end = at_end;
+    ix->run_count++;
+    return FS_SUCCESS;
+}
+
+static void fat_dirindex_delete_runs(fat_dirindex_t *ix, uint32_t at, uint32_t count)
+{
+    memmove(&ix->runs[at], &ix->runs[at + count], (ix->run_count - at - count) * sizeof(fat_dirindex_run_t));
+    ix->run_count -= count;
+}
+
+// Free slots of [a, b) the runs cover
+static uint32_t fat_dirindex_free_slots_in(const fat_dirindex_t *ix, uint32_t a, uint32_t b)
+{
+    uint32_t slots = 0;
+    for (uint32_t i = 0; i < ix->run_count; i++) {
+        uint32_t lo = ix->runs[i].pos, hi = fat_dirindex_run_end(&ix->runs[i]);
+        if (lo < a) lo = a;
+        if (hi > b) hi = b;
+        if (lo < hi) slots += (hi - lo) / FAT_DIRINDEX_ENTRY;
+    }
+    return slots;
+}
+
+// Takes [a, b) out of the runs. Fails if that would leave nowhere holding
+// the end-of-directory mark.
+static int fat_dirindex_carve(fat_dirindex_t *ix, uint32_t a, uint32_t b)
+{
+    for (uint32_t i = 0; i < ix->run_count; ) {
+        fat_dirindex_run_t r = ix->runs[i];
+        uint32_t end = fat_dirindex_run_end(&r);
+        if (end <= a || r.pos >= b) {
+            i++;
+            continue;
+        }
+        if (r.at_end && end <= b) return FS_ERR_NO_SPACE; // The mark moves into the next cluster
+
+        fat_dirindex_delete_runs(ix, i, 1);
+        if (r.pos < a) {
+            int ret = fat_dirindex_insert_run(ix, i++, r.pos, (a - r.pos) / FAT_DIRINDEX_ENTRY, false);
+            if (ret != FS_SUCCESS) return ret;
+        }
+        if (b < end) {
+            int ret = fat_dirindex_insert_run(ix, i++, b, (end - b) / FAT_DIRINDEX_ENTRY, r.at_end);
+            if (ret != FS_SUCCESS) return ret;
+        }
+    }
+    return FS_SUCCESS;
+}
+
+// Adds [a, b) to the runs, joining neighbours in the same cluster
+static int fat_dirindex_add_free(fat_dirindex_t *ix, uint32_t a, uint32_t b)
+{
+    uint32_t cb = ix->cluster_bytes;
+    while (a < b) {
+        uint32_t element = a / cb;
+        uint32_t piece_end = (element + 1) * cb;
+        if (piece_end > b) piece_end = b;
+
+        uint32_t i = 0;
+        while (i < ix->run_count &&
+               (ix->runs[i].pos / cb < element || fat_dirindex_run_end(&ix->runs[i]) < a)) i++;
+        uint32_t lo = a, hi = piece_end, j = i;
+        bool at_end = false;
+        while (j < ix->run_count && ix->runs[j].pos <= piece_end && ix->runs[j].pos / cb == element) {
+            if (ix->runs[j].pos < lo) lo = ix->runs[j].pos;
+            if (fat_dirindex_run_end(&ix->runs[j]) > hi) hi = fat_dirindex_run_end(&ix->runs[j]);
+            at_end |= ix->runs[j].at_end;
+            j++;
+        }
+        if (j > i) {
+            ix->runs[i].pos = lo;
+            ix->runs[i].slots = (hi - lo) / FAT_DIRINDEX_ENTRY;
+            ix->runs[i].at_end = at_end;
+            fat_dirindex_delete_runs(ix, i + 1, j - i - 1);
+        } else {
+            int ret = fat_dirindex_insert_run(ix, i, lo, (hi - lo) / FAT_DIRINDEX_ENTRY, false);
+            if (ret != FS_SUCCESS) return ret;
+        }
+        a = piece_end;
+    }
+    return FS_SUCCESS;
+}
+
+/* --- Building --- */
+
+static int fat_dirindex_add_cluster(fat_dirindex_t *ix, uint32_t cluster)
+{
+    if ((ix->cluster_count + 1) * (uint64_t)ix->cluster_bytes > FAT_DIRINDEX_MAX_BYTES) return FS_ERR_OVERFLOW;
+    if (!fat_dirindex_grow((void **)&ix->clusters, &ix->cluster_cap, ix->cluster_count, sizeof(uint32_t))) {
+        return FS_ERR_OUT_OF_MEMORY;
+    }
+    ix->clusters[ix->cluster_count++] = cluster;
+    return FS_SUCCESS;
+}
+
+static int fat_dirindex_build(fat_fs_t *fs, fat_dirindex_t *ix, uint32_t dir_cluster)
+{
+    const bool fixed_root = (fs->type != FAT_TYPE_FAT32 && dir_cluster == 0);
+    memset(ix, 0, sizeof(*ix));
+    ix->dir_cluster = dir_cluster;
+    ix->cluster_bytes = fixed_root ? (uint32_t)fs->root_dir_sectors * fs->bytes_per_sector : fs->cluster_size_bytes;
+    ix->name_free = -1;
+    if (ix->cluster_bytes == 0) return FS_ERR_INVALID_PARAM;
+
+    int ret = fat_dirindex_set_buckets(ix, 64);
+    if (ret == FS_SUCCESS) ret = fat_dirindex_add_cluster(ix, dir_cluster);
+    if (ret != FS_SUCCESS) return ret;
+
+    uint8_t *sector_data = kmalloc(fs->bytes_per_sector);
+    fat_dirindex_lfn_t *lfn = kmalloc(sizeof(*lfn));
+    if (!sector_data || !lfn) {
+        kfree(sector_data);
+        kfree(lfn);
+        return FS_ERR_OUT_OF_MEMORY;
+    }
+    lfn->count = 0;
+
+    const uint32_t entries_per_sector = fs->bytes_per_sector / FAT_DIRINDEX_ENTRY;
+    uint32_t cluster = dir_cluster;
+    uint32_t offset = 0;                 // Within the current chain element
+    uint32_t run_pos = 0, run_slots = 0;
+    bool ended = false;
+
+    while (ret == FS_SUCCESS && !ended) {
+        uint32_t base = (ix->cluster_count - 1) * ix->cluster_bytes;
+        ret = read_directory_sector(fs, cluster, offset / fs->bytes_per_sector, sector_data);
+        if (ret != FS_SUCCESS) break;
+
+        for (uint32_t e = 0; e < entries_per_sector && ret == FS_SUCCESS; e++) {
+            const fat_dir_entry_t *de = (const fat_dir_entry_t *)(sector_data + e * FAT_DIRINDEX_ENTRY);
+            uint32_t pos = base + offset + e * FAT_DIRINDEX_ENTRY;
+
+            if (de->name[0] == FAT_DIR_ENTRY_UNUSED || de->name[0] == FAT_DIR_ENTRY_DELETED) {
+                if (run_slots == 0) run_pos = pos;
+                run_slots++;
+                lfn->count = 0;
+                if (de->name[0] == FAT_DIR_ENTRY_UNUSED) {
+                    // Everything from here to the end of the element counts as free
+                    run_slots = (base + ix->cluster_bytes - run_pos) / FAT_DIRINDEX_ENTRY;
+                    ret = fat_dirindex_insert_run(ix, ix->run_count, run_pos, run_slots, true);
+                    run_slots = 0;
+                    ended = true;
+                    break;
+                }
+                continue;
+            }
+            if (run_slots) {
+                ret = fat_dirindex_insert_run(ix, ix->run_count, run_pos, run_slots, false);
+                run_slots = 0;
+                if (ret != FS_SUCCESS) break;
+            }
+            ret = fat_dirindex_take_entry(ix, lfn, de, pos);
+        }
+        if (ret != FS_SUCCESS || ended) break;
+
+        offset += fs->bytes_per_sector;
+        if (offset < ix->cluster_bytes) continue;
+        if (run_slots) {
+            // Runs end with their cluster, as find_free_directory_slot() counts them
+            ret = fat_dirindex_insert_run(ix, ix->run_count, run_pos, run_slots, false);
+            run_slots = 0;
+            if (ret != FS_SUCCESS) break;
+        }
+        if (fixed_root) break;
+
+        uint32_t next;
+        ret = fat_get_next_cluster(fs, cluster, &next);
+        if (ret != FS_SUCCESS || next >= fs->eoc_marker) break;
+        ret = fat_dirindex_add_cluster(ix, next);
+        cluster = next;
+        offset = 0;
+    }
+
+    // Record the rest of the chain past the end mark, so writes there are recognised
+    while (ret == FS_SUCCESS && ended && !fixed_root) {
+        uint32_t next;
+        ret = fat_get_next_cluster(fs, cluster, &next);
+        if (ret != FS_SUCCESS || next >= fs->eoc_marker) break;
+        ret = fat_dirindex_add_cluster(ix, next);
+        cluster = next;
+    }
+
+    kfree(sector_data);
+    kfree(lfn);
+    return ret;
+}
+
+/* --- Lookup --- */
+
+void fat_dirindex_init(fat_fs_t *fs)
+{
+    fs->dirindex = kmalloc(sizeof(fat_dirindex_cache_t));
+    if (fs->dirindex) memset(fs->dirindex, 0, sizeof(fat_dirindex_cache_t));
+}
+
+void fat_dirindex_destroy(fat_fs_t *fs)
+{
+    fat_dirindex_cache_t *dc = fs->dirindex;
+    if (!dc) return;
+    for (int i = 0; i < FAT_DIRINDEX_SLOTS; i++) {
+        if (dc->dirs[i].valid) fat_dirindex_free(&dc->dirs[i]);
+    }
+    kfree(dc);
+    fs->dirindex = NULL;
+}
+
+/** @brief The index of dir_cluster, built now if needed; NULL if it cannot be. */
+static fat_dirindex_t *fat_dirindex_get(fat_fs_t *fs, uint32_t dir_cluster)
+{
+    fat_dirindex_cache_t *dc = fs->dirindex;
+    if (!dc) return NULL;
+    if (dir_cluster == 0 ? fs->type == FAT_TYPE_FAT32 : dir_cluster < 2) return NULL;
+
+    fat_dirindex_t *victim = &dc->dirs[0];
+    for (int i = 0; i < FAT_DIRINDEX_SLOTS; i++) {
+        fat_dirindex_t *ix = &dc->dirs[i];
+        if (ix->valid && ix->dir_cluster == dir_cluster) {
+            ix->last_used = ++dc->clock;
+            return ix;
+        }
+        if (victim->valid && (!ix->valid || ix->last_used < victim->last_used)) victim = ix;
+    }
+
+    if (victim->valid) fat_dirindex_free(victim);
+    if (fat_dirindex_build(fs, victim, dir_cluster) != FS_SUCCESS) {
+        fat_dirindex_free(victim);
+        return NULL;
+    }
+    victim->valid = true;
+    victim->last_used = ++dc->clock;
+    dc->builds++;
+    return victim;
+}
+
+/** @brief The valid index whose chain holds cluster, with that cluster's chain element. */
+static fat_dirindex_t *fat_dirindex_holding(fat_fs_t *fs, uint32_t cluster, uint32_t *element_out)
+{
+    fat_dirindex_cache_t *dc = fs->dirindex;
+    if (!dc) return NULL;
+    for (int i = 0; i < FAT_DIRINDEX_SLOTS; i++) {
+        fat_dirindex_t *ix = &dc->dirs[i];
+        if (!ix->valid) continue;
+        for (uint32_t e = 0; e < ix->cluster_count; e++) {
+            if (ix->clusters[e] != cluster) continue;
+            if (element_out) *element_out = e;
+            return ix;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Maps (cluster, offset) as the directory writers take them (hopping
+ * offset / cluster_bytes elements from cluster) to an index and position.
+ * An index that cannot place the offset is dropped.
+ */
+static fat_dirindex_t *fat_dirindex_locate(fat_fs_t *fs, uint32_t cluster, uint32_t offset,
+                                           uint32_t span, uint32_t *pos_out)
+{
+    uint32_t element;
+    fat_dirindex_t *ix = fat_dirindex_holding(fs, cluster, &element);
+    if (!ix) return NULL;
+    uint32_t pos = element * ix->cluster_bytes + offset;
+    if (pos + span > ix->cluster_count * ix->cluster_bytes) {
+        fat_dirindex_free(ix);
+        return NULL;
+    }
+    *pos_out = pos;
+    return ix;
+}
+
+bool fat_dirindex_lookup(fat_fs_t *fs, uint32_t dir_cluster, const char *component, int *result,
+                         fat_dir_entry_t *entry_out, uint32_t *entry_offset_out, uint32_t *first_lfn_offset_out)
+{
+    fat_dirindex_t *ix = fat_dirindex_get(fs, dir_cluster);
+    if (!ix) return false;
+
+    // A scan stops at the first entry matching either way; take the earliest
+    uint8_t sfn[11];
+    format_filename(component, (char *)sfn);
+    uint32_t mask = ix->bucket_count - 1;
+    uint32_t hash = fat_dirindex_hash_sfn(sfn);
+    fat_dirindex_name_t *best = NULL;
+    for (int32_t i = ix->sfn_buckets[hash & mask]; i >= 0; i = ix->names[i].sfn_next) {
+        fat_dirindex_name_t *n = &ix->names[i];
+        if (n->sfn_hash != hash || n->sfn[0] == FAT_DIR_ENTRY_KANJI || memcmp(n->sfn, sfn, 11) != 0) continue;
+        if (!best || n->pos < best->pos) best = n;
+    }
+    hash = fat_dirindex_hash_lfn(component);
+    for (int32_t i = ix->lfn_buckets[hash & mask]; i >= 0; i = ix->names[i].lfn_next) {
+        fat_dirindex_name_t *n = &ix->names[i];
+        if (n->lfn_hash != hash || fat_compare_lfn(component, n->lfn) != 0) continue;
+        if (!best || n->pos < best->pos) best = n;
+    }
+    fat_dirindex_cache_t *dc = fs->dirindex;
+    if (!best) {
+        dc->hits++;
+        *result = FS_ERR_NOT_FOUND;
+        return true;
+    }
+
+    // The entry itself comes from the buffer cache, so it is never stale
+    uint32_t cluster = ix->clusters[best->pos / ix->cluster_bytes];
+    uint32_t offset = best->pos % ix->cluster_bytes;
+    uint32_t lba = (fs->type != FAT_TYPE_FAT32 && cluster == 0) ? fs->root_dir_start_lba
+                                                                : fat_cluster_to_lba(fs, cluster);
+    if (lba == 0) return false;
+    buffer_t *b = buffer_get(fs->disk_ptr, lba + offset / fs->bytes_per_sector);
+    if (!b) return false;
+    memcpy(entry_out, b->data + offset % fs->bytes_per_sector, sizeof(*entry_out));
+    buffer_release(b);
+    if (memcmp(entry_out->name, best->sfn, 11) != 0) {
+        fat_dirindex_free(ix);
+        return false;
+    }
+
+    dc->hits++;
+    *entry_offset_out = offset;
+    if (first_lfn_offset_out) {
+        *first_lfn_offset_out = (best->lfn_pos != best->pos) ? best->lfn_pos % ix->cluster_bytes : (uint32_t)-1;
+    }
+    *result = FS_SUCCESS;
+    return true;
+}
+
+bool fat_dirindex_short_name_exists(fat_fs_t *fs, uint32_t dir_cluster, const uint8_t short_name_raw[11], bool *exists)
+{
+    fat_dirindex_t *ix = fat_dirindex_get(fs, dir_cluster);
+    if (!ix) return false;
+    uint32_t hash = fat_dirindex_hash_sfn(short_name_raw);
+    *exists = false;
+    for (int32_t i = ix->sfn_buckets[hash & (ix->bucket_count - 1)]; i >= 0; i = ix->names[i].sfn_next) {
+        if (ix->names[i].sfn_hash == hash && memcmp(ix->names[i].sfn, short_name_raw, 11) == 0) {
+            *exists = true;
+            break;
+        }
+    }
+    fs->dirindex->hits++;
+    return true;
+}
+
+bool fat_dirindex_for_each_short_name(fat_fs_t *fs, uint32_t dir_cluster,
+                                      bool (*fn)(const uint8_t sfn[11], void *ctx), void *ctx)
+{
+    fat_dirindex_t *ix = fat_dirindex_get(fs, dir_cluster);
+    if (!ix) return false;
+    for (uint32_t i = 0; i < ix->name_count; i++) {
+        if (ix->names[i].used && fn(ix->names[i].sfn, ctx)) break;
+    }
+    fs->dirindex->hits++;
+    return true;
+}
+
+bool fat_dirindex_find_slot(fat_fs_t *fs, uint32_t dir_cluster, size_t needed_slots,
+                            uint32_t *slot_cluster_out, uint32_t *slot_offset_out)
+{
+    fat_dirindex_t *ix = fat_dirindex_get(fs, dir_cluster);
+    if (!ix) return false;
+    for (uint32_t i = 0; i < ix->run_count; i++) {
+        const fat_dirindex_run_t *r = &ix->runs[i];
+        if (r->slots < needed_slots && !r->at_end) continue;
+        *slot_cluster_out = ix->clusters[r->pos / ix->cluster_bytes];
+        *slot_offset_out = r->pos % ix->cluster_bytes;
+        fs->dirindex->hits++;
+        return true;
+    }
+    return false;
+}
+
+/* --- Keeping indexes current --- */
+
+void fat_dirindex_note_write(fat_fs_t *fs, uint32_t dir_cluster, uint32_t offset,
+                             const void *entries, size_t num_entries)
+{
+    uint32_t a;
+    uint32_t span = (uint32_t)num_entries * FAT_DIRINDEX_ENTRY;
+    fat_dirindex_t *ix = fat_dirindex_locate(fs, dir_cluster, offset, span, &a);
+    if (!ix) return;
+    uint32_t b = a + span;
+
+    // Only free slots and whole names may be overwritten (creates only ever
+    // write free slots, which spares them the walk over every name)
+    uint32_t free_slots = fat_dirindex_free_slots_in(ix, a, b);
+    int32_t name_slots = (free_slots == num_entries) ? 0 : fat_dirindex_drop_names(ix, a, b);
+    if (name_slots < 0 || free_slots + (uint32_t)name_slots != num_entries || fat_dirindex_carve(ix, a, b) != FS_SUCCESS) {
+        fat_dirindex_free(ix);
+        return;
+    }
+
+    fat_dirindex_lfn_t *lfn = kmalloc(sizeof(*lfn));
+    if (!lfn) {
+        fat_dirindex_free(ix);
+        return;
+    }
+    lfn->count = 0;
+    int ret = FS_SUCCESS;
+    const fat_dir_entry_t *de = entries;
+    for (size_t i = 0; i < num_entries && ret == FS_SUCCESS; i++, de++) {
+        uint32_t pos = a + (uint32_t)i * FAT_DIRINDEX_ENTRY;
+        if (de->name[0] == FAT_DIR_ENTRY_UNUSED) {
+            ret = FS_ERR_INVALID_PARAM; // Moves the end of the directory
+        } else if (de->name[0] == FAT_DIR_ENTRY_DELETED) {
+            lfn->count = 0;
+            ret = fat_dirindex_add_free(ix, pos, pos + FAT_DIRINDEX_ENTRY);
+        } else {
+            ret = fat_dirindex_take_entry(ix, lfn, de, pos);
+        }
+    }
+    // LFN entries left over belong to an 8.3 entry outside this write
+    if (ret != FS_SUCCESS || lfn->count > 0) fat_dirindex_free(ix);
+    kfree(lfn);
+}
+
+void fat_dirindex_note_delete(fat_fs_t *fs, uint32_t dir_cluster, uint32_t offset,
+                              size_t num_entries, uint8_t marker)
+{
+    uint32_t a;
+    uint32_t span = (uint32_t)num_entries * FAT_DIRINDEX_ENTRY;
+    fat_dirindex_t *ix = fat_dirindex_locate(fs, dir_cluster, offset, span, &a);
+    if (!ix) return;
+    if (marker != FAT_DIR_ENTRY_DELETED || fat_dirindex_drop_names(ix, a, a + span) < 0 ||
+        fat_dirindex_add_free(ix, a, a + span) != FS_SUCCESS) {
+        fat_dirindex_free(ix);
+    }
+}
+
+void fat_dirindex_note_extend(fat_fs_t *fs, uint32_t dir_cluster, uint32_t last_cluster, uint32_t new_cluster)
+{
+    fat_dirindex_t *ix = fat_dirindex_holding(fs, dir_cluster, NULL);
+    if (!ix) return;
+    // Only a chain scanned right to its end, with no end mark, grows like this
+    if (ix->clusters[ix->cluster_count - 1] != last_cluster ||
+        (ix->run_count > 0 && ix->runs[ix->run_count - 1].at_end) ||
+        fat_dirindex_add_cluster(ix, new_cluster) != FS_SUCCESS ||
+        fat_dirindex_insert_run(ix, ix->run_count, (ix->cluster_count - 1) * ix->cluster_bytes,
+                                ix->cluster_bytes / FAT_DIRINDEX_ENTRY, true) != FS_SUCCESS) {
+        fat_dirindex_free(ix);
+    }
+}
+
+void fat_dirindex_note_update(fat_fs_t *fs, uint32_t dir_cluster, uint32_t offset, const fat_dir_entry_t *entry)
+{
+    uint32_t pos;
+    fat_dirindex_t *ix = fat_dirindex_locate(fs, dir_cluster, offset, FAT_DIRINDEX_ENTRY, &pos);
+    if (!ix) return;
+    // Sizes, clusters and times are not indexed; only a changed name matters
+    uint32_t hash = fat_dirindex_hash_sfn(entry->name);
+    for (int32_t i = ix->sfn_buckets[hash & (ix->bucket_count - 1)]; i >= 0; i = ix->names[i].sfn_next) {
+        if (ix->names[i].pos == pos && memcmp(ix->names[i].sfn, entry->name, 11) == 0) return;
+    }
+    fat_dirindex_free(ix);
+}
+
+void fat_dirindex_invalidate(fat_fs_t *fs, uint32_t cluster)
+{
+    fat_dirindex_t *ix = fat_dirindex_holding(fs, cluster, NULL);
+    if (ix) fat_dirindex_free(ix);
+}
+
+bool fat_dirindex_owner(fat_fs_t *fs, uint32_t cluster, uint32_t *dir_cluster_out)
+{
+    fat_dirindex_t *ix = fat_dirindex_holding(fs, cluster, NULL);
+    if (!ix) return false;
+    *dir_cluster_out = ix->dir_cluster;
+    return true;
+}
@@ -8,16 +8,26 @@
  #include <kernel/fs/fat/fat_fs.h>     // Our function declarations
  #include <kernel/fs/fat/fat_core.h>   // Core FAT structures and constants
  #include <kernel/fs/fat/fat_utils.h>  // fat_cluster_to_lba (needed for geometry checks?) - maybe not needed here directly
+ #include <kernel/fs/fat/fat_alloc.h>  // Free-cluster bitmap and FSInfo
+ #include <kernel/fs/fat/fat_dcache.h> // Name lookup cache
+ #include <kernel/fs/fat/fat_dirindex.h> // Whole-directory indexes
+ #include <kernel/fs/fat/fat_vcache.h> // Shared contexts of open files
  #include <kernel/drivers/storage/disk.h>       // For reading boot sector, FAT sectors
  #include <kernel/drivers/storage/buffer_cache.h> // Buffer cache for disk I/O
  #include <kernel/memory/kmalloc.h>    // Kernel memory allocation
  #include <kernel/drivers/display/terminal.h>   // Logging
- #include <kernel/sync/spinlock.h>   // Spinlock initialization
+ #include <kernel/sync/mutex.h>      // kmutex_init
  #include <kernel/fs/vfs/fs_errno.h>   // Filesystem error codes
  #include <kernel/lib/string.h>     // memcpy, memset, memcmp
  #include <kernel/lib/assert.h>     // KERNEL_ASSERT
+ #include <kernel/core/boot_trace.h> // BOOT_TRACE around the FAT load
  #include <libc/limits.h> // For SIZE_MAX
  
+ #define MIN(a, b) (((a) < (b)) ? (a) : (b))
+ 
+ // FAT sectors fetched per buffer_get_range call by load/flush
+ #define FAT_TABLE_IO_CHUNK 64
+ 
  
  /* --- Static Helper Prototypes --- */
  
@@ -34,6 +44,14 @@
   * @return FS_SUCCESS or negative error code.
   */
  static int flush_fat_table(fat_fs_t *fs);
+ static int flush_fat_sectors(fat_fs_t *fs, uint32_t first, uint32_t count, int *written);
+ 
+ /**
+  * @brief Allocates the (cleared) dirty-sector bitmap for the FAT.
+  * @return FS_SUCCESS; without memory the bitmap stays NULL and flushes
+  *         compare every sector instead.
+  */
+ static int fat_alloc_dirty_sectors(fat_fs_t *fs);
  
  
  /* --- VFS Mount/Unmount Implementations --- */
@@ -61,26 +79,25 @@
          goto mount_fail;
      }
      memset(fs, 0, sizeof(*fs));
-     spinlock_init(&fs->lock); // Initialize the lock early
+     kmutex_init(&fs->lock, false); // Initialize the lock early
      fs->fat_table = NULL; // Ensure fat_table is NULL initially for cleanup logic
      fs->fat_dirty = false; // Initialize dirty flag
  
-     // 2. Read Boot Sector (LBA 0) using Buffer Cache
-     //    Buffer cache implicitly looks up the disk_t based on device_name.
-     bs_buf = buffer_get(device_name, 0);
+     // 2. Resolve the device name once; all later buffer cache calls use the handle
+     fs->disk_ptr = buffer_find_disk(device_name);
+     if (!fs->disk_ptr) {
+          terminal_printf("[FAT Mount] Error: Device '%s' is not registered with the buffer cache.\n", device_name);
+          result = FS_ERR_NOT_FOUND;
+          goto mount_fail;
+     }
+
+     //    Read Boot Sector (LBA 0) using Buffer Cache
+     bs_buf = buffer_get(fs->disk_ptr, 0);
      if (!bs_buf) {
          terminal_printf("[FAT Mount] Error: Failed to read boot sector (LBA 0) for device '%s' via buffer cache.\n", device_name);
          result = FS_ERR_IO;
          goto mount_fail;
      }
-     // Ensure the buffer cache found the underlying disk structure
-     if (!bs_buf->disk) {
-          terminal_printf("[FAT Mount] Error: Buffer cache lookup failed for device '%s' (disk_t is NULL).\n", device_name);
-          result = FS_ERR_INTERNAL; // Or perhaps FS_ERR_INVALID_PARAM if device isn't registered
-          goto mount_fail;
-     }
-     // Store the pointer to the disk structure
-     fs->disk_ptr = bs_buf->disk;
  
      // 3. Parse and Validate Boot Sector / BPB
      // Copy to a local struct to avoid alignment issues and release buffer early.
@@ -189,13 +206,34 @@
       }
  
      // 6. Load FAT Table into Memory
-     result = load_fat_table(fs);
+     BOOT_TRACE("load_fat_table", result = load_fat_table(fs));
      if (result != FS_SUCCESS) {
          terminal_printf("[FAT Mount] Error: Failed to load FAT table for device '%s' (code %d).\n", device_name, result);
          // load_fat_table frees fs->fat_table on failure
          goto mount_fail; // fs itself will be freed below
      }
  
+     // 6b. Free-cluster bitmap, allocation hint from FSInfo (FAT32)
+     if (fat_free_map_init(fs, (fs->type == FAT_TYPE_FAT32) ? bpb.fs_info_sector : 0) != FS_SUCCESS) {
+         terminal_printf("[FAT Mount] Warning: No free-cluster bitmap for '%s'; allocation scans the FAT.\n", device_name);
+     }
+ 
+     // 6c. Name lookup cache and directory indexes (directories are scanned without them),
+     //     the open-file table (without it every open gets a context of its own) and the
+     //     sector buffer lookups scan directories with (else allocated per lookup)
+     fat_dcache_init(fs);
+     fat_dirindex_init(fs);
+     fat_vcache_init(fs);
+     fs->lookup_sector = kmalloc(fs->bytes_per_sector);
+ 
+     // 7. Cache the data region a cluster per buffer (read/write_cluster_cached
+     //    then cost one lookup and one multi-sector transfer per cluster)
+     int geo_result = buffer_set_block_geometry(fs->disk_ptr, fs->first_data_sector, fs->sectors_per_cluster);
+     if (geo_result != 0) {
+         terminal_printf("[FAT Mount] Warning: Keeping per-sector buffers for '%s' (code %d).\n",
+                         device_name, geo_result);
+     }
+ 
      // --- Mount Successful ---
      terminal_printf("[FAT Mount] Mount successful for device '%s'. Type: FAT%d\n",
                       device_name, (fs->type == FAT_TYPE_FAT12) ? 12 : (fs->type == FAT_TYPE_FAT16 ? 16 : 32));
@@ -213,6 +251,13 @@
          if (fs->fat_table) {
              kfree(fs->fat_table);
          }
+         kfree(fs->fat_dirty_sectors);
+         fat_window_release(fs);
+         fat_free_map_destroy(fs);
+         fat_dcache_destroy(fs);
+         fat_dirindex_destroy(fs);
+         fat_vcache_destroy(fs);
+         kfree(fs->lookup_sector);
          kfree(fs); // Free the main fs structure
      }
      // fs_set_errno(result); // Set thread-local errno maybe
@@ -236,12 +281,12 @@
  
      // Acquire lock to ensure exclusive access during unmount
      // This prevents races if another thread tries accessing the FS during unmount.
-     uintptr_t irq_flags = spinlock_acquire_irqsave(&fs->lock);
+     kmutex_lock(&fs->lock);
  
      int result = FS_SUCCESS;
  
-     // 1. Flush the in-memory FAT table if it exists and is dirty
-     if (fs->fat_table) {
+     // 1. Flush the in-memory FAT table if it exists and is dirty (paged: mirror FAT 1 to the copies)
+     if (fs->fat_table || fs->fat_paged) {
          result = flush_fat_table(fs); // flush_fat_table handles fs->fat_dirty check internally
          if (result != FS_SUCCESS) {
               terminal_printf("[FAT Unmount] Warning: Failed to flush FAT table for %s (err %d). Continuing unmount.\n",
@@ -251,7 +296,23 @@
          // Free the FAT table memory regardless of flush success
          kfree(fs->fat_table);
          fs->fat_table = NULL;
+         fat_window_release(fs);
+         kfree(fs->fat_dirty_sectors);
+         fs->fat_dirty_sectors = NULL;
+     }
+ 
+     // 1b. Free count and next-free hint back to FSInfo, then drop the bitmap
+     int fsinfo_result = fat_write_fsinfo(fs);
+     if (fsinfo_result != FS_SUCCESS) {
+         terminal_printf("[FAT Unmount] Warning: Failed to update FSInfo for %s (err %d).\n", dev_name, fsinfo_result);
+         if (result == FS_SUCCESS) result = fsinfo_result;
      }
+     fat_free_map_destroy(fs);
+     fat_dcache_destroy(fs);
+     fat_dirindex_destroy(fs);
+     fat_vcache_destroy(fs);
+     kfree(fs->lookup_sector);
+     fs->lookup_sector = NULL;
  
      // 2. Optionally sync the entire buffer cache for the device. Good practice.
      //    This ensures directory entries, data blocks etc. are written out.
@@ -262,9 +323,14 @@
      }
  
      // 3. Release the lock before freeing the context structure itself
-     spinlock_release_irqrestore(&fs->lock, irq_flags);
+     kmutex_unlock(&fs->lock);
+ 
+     // 4. Back to per-sector buffers for whatever uses the device next
+     if (fs->disk_ptr) {
+         buffer_set_block_geometry(fs->disk_ptr, 0, 1);
+     }
  
-     // 4. Free the filesystem context structure
+     // 5. Free the filesystem context structure
      kfree(fs);
  
      terminal_printf("[FAT Unmount] Unmount complete for %s.\n", dev_name);
@@ -302,13 +368,16 @@
      terminal_printf("[FAT Load FAT] Calculated FAT table size: %u bytes (%u sectors).\n",
                       (unsigned int)fs->fat_table_size_bytes, fs->fat_size_sectors);
  
-     // Allocate memory for the FAT table
-     fs->fat_table = kmalloc(fs->fat_table_size_bytes);
+     // Allocate memory for the FAT table; large FATs (or no memory) stay on disk, paged in by sector
+     if (fs->fat_table_size_bytes <= FAT_TABLE_RESIDENT_MAX) {
+         fs->fat_table = kmalloc(fs->fat_table_size_bytes);
+     }
      if (!fs->fat_table) {
-         terminal_printf("[FAT Load FAT] Error: Failed to allocate %u bytes for FAT table.\n",
+         terminal_printf("[FAT Load FAT] FAT of %u bytes not loaded; entries are read through the buffer cache.\n",
                           (unsigned int)fs->fat_table_size_bytes);
-         fs->fat_table_size_bytes = 0; // Reset size
-         return FS_ERR_OUT_OF_MEMORY;
+         fs->fat_paged = true;
+         fs->fat_dirty = false;
+         return fat_alloc_dirty_sectors(fs);
      }
  
      // Read FAT sectors using buffer cache
@@ -316,10 +385,13 @@
                       fs->fat_size_sectors, fs->fat_start_lba);
      uint8_t* current_fat_ptr = (uint8_t*)fs->fat_table;
  
-     for (uint32_t sector_index = 0; sector_index < fs->fat_size_sectors; sector_index++) {
+     // A chunk of sectors per buffer cache call: one lookup pass, batched disk reads
+     for (uint32_t sector_index = 0; sector_index < fs->fat_size_sectors; ) {
          uint32_t lba = fs->fat_start_lba + sector_index;
-         buffer_t* sector_buf = buffer_get(fs->disk_ptr->blk_dev.device_name, lba);
-         if (!sector_buf) {
+         uint32_t chunk = MIN(fs->fat_size_sectors - sector_index, FAT_TABLE_IO_CHUNK);
+         buffer_t *bufs[FAT_TABLE_IO_CHUNK];
+         size_t got = buffer_get_range(fs->disk_ptr, lba, chunk, bufs, FAT_TABLE_IO_CHUNK);
+         if (got == 0) {
              terminal_printf("[FAT Load FAT] Error: Failed to get buffer for FAT sector %u (LBA %u).\n", sector_index, lba);
              kfree(fs->fat_table); // Clean up allocation
              fs->fat_table = NULL;
@@ -327,32 +399,146 @@
              return FS_ERR_IO;
          }
  
-         // Copy data from buffer cache to our allocated FAT table buffer
-         memcpy(current_fat_ptr, sector_buf->data, fs->bytes_per_sector);
- 
-         // Release the buffer cache block
-         buffer_release(sector_buf);
- 
-         // Advance pointer in our FAT table buffer
-         current_fat_ptr += fs->bytes_per_sector;
+         // Copy data from buffer cache to our allocated FAT table buffer (the FAT
+         // lies before the data region, so every buffer is one sector)
+         for (size_t i = 0; i < got; i++) {
+             memcpy(current_fat_ptr, bufs[i]->data, fs->bytes_per_sector);
+             current_fat_ptr += fs->bytes_per_sector;
+         }
+         buffer_release_range(bufs, got);
+         sector_index += (uint32_t)got;
      }
  
      fs->fat_dirty = false; // Mark FAT as clean initially after loading
+     fat_alloc_dirty_sectors(fs);
      terminal_write("[FAT Load FAT] FAT table loaded successfully.\n");
      return FS_SUCCESS;
  }
  
+ /**
+  * @brief Copies FAT sectors [first, first + count) into every on-disk FAT
+  * copy, through the buffer cache. The source is the in-memory table, or for a
+  * paged FAT the cached sectors of FAT 1 itself (which are then only mirrored
+  * into the other copies). Sectors whose cached contents already match are
+  * left clean.
+  * @return Number of failures (0 on success); *written counts the sectors dirtied.
+  */
+ static int flush_fat_sectors(fat_fs_t *fs, uint32_t first, uint32_t count, int *written)
+ {
+     int errors = 0;
+     const uint8_t *fat_bytes = (const uint8_t *)fs->fat_table;
+     uint8_t first_copy = fs->fat_paged ? 1 : 0;
+ 
+     for (uint32_t i = first; i < first + count; ) {
+         uint32_t chunk = MIN(first + count - i, FAT_TABLE_IO_CHUNK);
+         buffer_t *src[FAT_TABLE_IO_CHUNK];
+         if (fs->fat_paged) {
+             chunk = (uint32_t)buffer_get_range(fs->disk_ptr, fs->fat_start_lba + i, chunk, src, FAT_TABLE_IO_CHUNK);
+             if (chunk == 0) {
+                 terminal_printf("[FAT Flush FAT] Error: Failed to read FAT sector %lu.\n", (unsigned long)i);
+                 errors++;
+                 i++;
+                 continue;
+             }
+         }
+ 
+         for (uint8_t copy = first_copy; copy < fs->num_fats; copy++) {
+             uint32_t copy_lba = fs->fat_start_lba + (uint32_t)copy * fs->fat_size_sectors;
+             buffer_t *bufs[FAT_TABLE_IO_CHUNK];
+             size_t got = buffer_get_range(fs->disk_ptr, copy_lba + i, chunk, bufs, FAT_TABLE_IO_CHUNK);
+             if (got < chunk) {
+                 terminal_printf("[FAT Flush FAT] Error: Failed to get buffer for LBA %lu (FAT %u sector %lu).\n",
+                                 (unsigned long)(copy_lba + i + got), (unsigned int)copy, (unsigned long)(i + got));
+                 errors++; // Flush what was got; the run stays dirty
+             }
+ 
+             for (size_t k = 0; k < got; k++) {
+                 const uint8_t *fat_sector = fs->fat_paged ? src[k]->data
+                                                           : fat_bytes + (size_t)(i + k) * fs->bytes_per_sector;
+                 // Only write if they differ
+                 if (memcmp(bufs[k]->data, fat_sector, fs->bytes_per_sector) != 0) {
+                     memcpy(bufs[k]->data, fat_sector, fs->bytes_per_sector);
+                     buffer_mark_dirty(bufs[k]);
+                     (*written)++;
+                 }
+             }
+             if (got) buffer_release_range(bufs, got);
+         }
+ 
+         if (fs->fat_paged) buffer_release_range(src, chunk);
+         i += chunk;
+     }
+     return errors;
+ }
+ 
+ /**
+  * @brief Allocates the (cleared) dirty-sector bitmap for the FAT.
+  */
+ static int fat_alloc_dirty_sectors(fat_fs_t *fs)
+ {
+     // Track changed sectors so a flush writes only those; without it, flush compares them all
+     size_t dirty_words = (fs->fat_size_sectors + 31) / 32;
+     fs->fat_dirty_sectors = kmalloc(dirty_words * sizeof(uint32_t));
+     if (fs->fat_dirty_sectors) memset(fs->fat_dirty_sectors, 0, dirty_words * sizeof(uint32_t));
+     return FS_SUCCESS;
+ }
+ 
+ /**
+  * @brief Flushes the sectors in [first, end) marked in the dirty-sector bitmap,
+  * a run at a time, and clears their bits; without a bitmap, compares them all.
+  * @return Number of failures; *written counts the sectors dirtied.
+  */
+ static int flush_dirty_fat_sectors(fat_fs_t *fs, uint32_t first, uint32_t end, int *written)
+ {
+     if (!fs->fat_dirty_sectors) return flush_fat_sectors(fs, first, end - first, written);
+ 
+     int errors = 0;
+     uint32_t *dirty = fs->fat_dirty_sectors;
+     uint32_t sector = first;
+     while (sector < end) {
+         if (!(dirty[sector / 32] & (1u << (sector % 32)))) {
+             sector = (dirty[sector / 32] >> (sector % 32)) ? sector + 1 : (sector | 31) + 1; // Skip clean words
+             continue;
+         }
+         uint32_t run_end = sector + 1;
+         while (run_end < end && (dirty[run_end / 32] & (1u << (run_end % 32)))) run_end++;
+ 
+         int run_errors = flush_fat_sectors(fs, sector, run_end - sector, written);
+         if (run_errors == 0) {
+             for (uint32_t s = sector; s < run_end; s++) dirty[s / 32] &= ~(1u << (s % 32));
+         }
+         errors += run_errors;
+         sector = run_end;
+     }
+     return errors;
+ }
+ 
+ /**
+  * @brief Brings FAT sectors [first, first + count) that changed since their
+  * last flush into every FAT copy's cached sectors (fsync). fs->fat_dirty is
+  * left as it is: other sectors may still be pending. Caller holds fs->lock.
+  */
+ int fat_flush_fat_range(fat_fs_t *fs, uint32_t first, uint32_t count)
+ {
+     if ((!fs->fat_table && !fs->fat_paged) || !fs->fat_dirty || first >= fs->fat_size_sectors) return FS_SUCCESS;
+     uint32_t end = (count < fs->fat_size_sectors - first) ? first + count : fs->fat_size_sectors;
+     int sectors_written = 0;
+     return flush_dirty_fat_sectors(fs, first, end, &sectors_written) ? FS_ERR_IO : FS_SUCCESS;
+ }
+ 
  /**
   * @brief Flushes the in-memory FAT table back to disk via buffer cache if modified.
-  * (Implementation based on original fat.c flush_fat_table_v2 with comparison)
+  *
+  * With a dirty-sector bitmap only the runs of sectors changed since the last
+  * flush are written, to each of the num_fats copies; without one (it could
+  * not be allocated) every sector is compared against the cache.
   */
  static int flush_fat_table(fat_fs_t *fs)
  {
-     // Corrected: Added message string to KERNEL_ASSERT
      KERNEL_ASSERT(fs != NULL, "FS context cannot be NULL in flush_fat_table");
      // Assumes caller holds lock if concurrent modification is possible
  
-     if (!fs->fat_table || !fs->fat_dirty) {
+     if ((!fs->fat_table && !fs->fat_paged) || !fs->fat_dirty) {
          // Nothing to flush (not loaded, or not modified)
          return FS_SUCCESS;
      }
@@ -362,37 +548,8 @@
          return FS_ERR_INTERNAL; // Indicates FS struct wasn't properly initialized
      }
  
-     terminal_printf("[FAT Flush FAT] Flushing %u modified FAT sectors via buffer cache...\n", fs->fat_size_sectors);
      int sectors_written = 0;
-     int errors_encountered = 0;
-     const uint8_t *current_fat_ptr = (const uint8_t *)fs->fat_table;
- 
-     // Iterate through each sector of the FAT table
-     for (uint32_t i = 0; i < fs->fat_size_sectors; i++) {
-         uint32_t target_lba = fs->fat_start_lba + i;
-         const uint8_t *fat_sector_in_memory = current_fat_ptr + (i * fs->bytes_per_sector);
- 
-         // Get the corresponding buffer from the cache
-         // This might read from disk if not present, but that's okay.
-         buffer_t *cached_buf = buffer_get(fs->disk_ptr->blk_dev.device_name, target_lba);
-         if (!cached_buf) {
-             terminal_printf("[FAT Flush FAT] Error: Failed to get buffer for LBA %u (FAT sector %u).\n", target_lba, i);
-             errors_encountered++;
-             continue; // Try to flush subsequent sectors
-         }
- 
-         // --- Optimization: Compare in-memory FAT sector with cached buffer ---
-         // Only write if they differ. memcmp returns 0 if identical.
-         if (memcmp(cached_buf->data, fat_sector_in_memory, fs->bytes_per_sector) != 0) {
-             // Contents differ - update the cache buffer and mark it dirty
-             memcpy(cached_buf->data, fat_sector_in_memory, fs->bytes_per_sector);
-             buffer_mark_dirty(cached_buf);
-             sectors_written++;
-         }
- 
-         // Release the buffer (decrements ref count)
-         buffer_release(cached_buf);
-     }
+     int errors_encountered = flush_dirty_fat_sectors(fs, 0, fs->fat_size_sectors, &sectors_written);
  
      // Only clear the dirty flag if no errors occurred during the flush attempt
      if (errors_encountered == 0) {
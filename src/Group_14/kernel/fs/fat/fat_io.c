@@ -23,8 +23,11 @@
 #include <kernel/fs/fat/fat_utils.h>      // fat_cluster_to_lba, fat_get_current_timestamp (placeholder)
 #include <kernel/fs/fat/fat_alloc.h>      // fat_get_next_cluster, fat_allocate_cluster
 #include <kernel/fs/fat/fat_dir.h>        // update_directory_entry (needed for close/flush), read_directory_sector (used in close)
+#include <kernel/fs/fat/fat_dcache.h>     // fat_dcache_update after in-place entry updates
+#include <kernel/fs/fat/fat_vcache.h>     // Contexts shared by a file's open handles
+#include <kernel/fs/fat/fat_fs.h>         // fat_flush_fat_range for fsync
 #include <kernel/drivers/storage/buffer_cache.h>   // buffer_get, buffer_release, buffer_mark_dirty
-#include <kernel/sync/spinlock.h>       // spinlock_t, spinlock_acquire_irqsave, spinlock_release_irqrestore
+#include <kernel/sync/mutex.h>          // kmutex_lock, kmutex_unlock
 #include <kernel/drivers/display/serial.h>         // serial_write, serial_print_hex
 #include <kernel/fs/vfs/sys_file.h>       // O_* flags, SEEK_* defines
 #include <kernel/memory/kmalloc.h>        // Kernel memory allocation (kfree - needed by helpers)
@@ -43,6 +46,10 @@
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 #endif
 
+// Reads of at least this much that start on a cluster boundary go through
+// buffer_read_bulk() when their clusters are contiguous on disk
+#define FAT_BULK_READ_MIN_BYTES (64 * 1024)
+
 /* --- Cluster I/O Helpers --- */
 
 /**
@@ -81,30 +88,29 @@ int read_cluster_cached(fat_fs_t *fs, uint32_t cluster, uint32_t offset_in_locat
     KERNEL_ASSERT(sector_size > 0, "Invalid sector size");
     KERNEL_ASSERT(location_size > 0, "Invalid location size");
 
-    uint32_t start_sector_in_location = offset_in_location / sector_size;
-    uint32_t end_sector_in_location   = (offset_in_location + len - 1) / sector_size;
-
     size_t bytes_read_total = 0;
     uint8_t *dest_ptr = (uint8_t *)buf;
 
-    for (uint32_t sec_idx = start_sector_in_location; sec_idx <= end_sector_in_location; sec_idx++) {
-        uint32_t current_lba = start_lba + sec_idx;
+    // One buffer per cache block: a whole cluster in the data region, a sector elsewhere
+    while (bytes_read_total < len) {
+        uint32_t pos = offset_in_location + (uint32_t)bytes_read_total;
+        uint32_t current_lba = start_lba + pos / sector_size;
         // serial_write("[FAT_IO] Reading LBA: 0x"); serial_print_hex(current_lba); serial_write("\n");
 
-        buffer_t* b = buffer_get(fs->disk_ptr->blk_dev.device_name, current_lba);
+        buffer_t* b = buffer_get_block(fs->disk_ptr, current_lba);
         if (!b) {
             serial_printf("[FAT_IO_ERR] read_cluster_cached: Buffer get failed for LBA 0x%lx\n", (unsigned long)current_lba);
             return FS_ERR_IO;
         }
 
-        size_t offset_within_this_sector = (sec_idx == start_sector_in_location) ? (offset_in_location % sector_size) : 0;
-        size_t bytes_to_copy_from_this_sector = MIN(sector_size - offset_within_this_sector, len - bytes_read_total);
+        size_t offset_within_this_block = (size_t)(current_lba - b->block_number) * sector_size + pos % sector_size;
+        size_t bytes_to_copy_from_this_block = MIN(b->size - offset_within_this_block, len - bytes_read_total);
 
-        memcpy(dest_ptr, b->data + offset_within_this_sector, bytes_to_copy_from_this_sector);
+        memcpy(dest_ptr, b->data + offset_within_this_block, bytes_to_copy_from_this_block);
         buffer_release(b);
 
-        dest_ptr += bytes_to_copy_from_this_sector;
-        bytes_read_total += bytes_to_copy_from_this_sector;
+        dest_ptr += bytes_to_copy_from_this_block;
+        bytes_read_total += bytes_to_copy_from_this_block;
     }
 
     KERNEL_ASSERT(bytes_read_total == len, "Bytes read mismatch");
@@ -125,9 +131,6 @@ int write_cluster_cached(fat_fs_t *fs, uint32_t cluster, uint32_t offset_in_clus
     uint32_t sector_size = fs->bytes_per_sector;
     KERNEL_ASSERT(sector_size > 0, "Invalid sector size");
 
-    uint32_t start_sector_in_cluster = offset_in_cluster / sector_size;
-    uint32_t end_sector_in_cluster   = (offset_in_cluster + len - 1) / sector_size;
-
     uint32_t cluster_lba = fat_cluster_to_lba(fs, cluster);
     if (cluster_lba == 0) {
         serial_printf("[FAT_IO_ERR] write_cluster_cached: Invalid LBA for cluster 0x%lx\n", (unsigned long)cluster);
@@ -139,25 +142,26 @@ int write_cluster_cached(fat_fs_t *fs, uint32_t cluster, uint32_t offset_in_clus
     const uint8_t *src_ptr = (const uint8_t *)buf;
     int result = FS_SUCCESS;
 
-    for (uint32_t sec_idx = start_sector_in_cluster; sec_idx <= end_sector_in_cluster; sec_idx++) {
-        uint32_t current_lba = cluster_lba + sec_idx;
+    while (bytes_written_total < len) {
+        uint32_t pos = offset_in_cluster + (uint32_t)bytes_written_total;
+        uint32_t current_lba = cluster_lba + pos / sector_size;
         // serial_write("[FAT_IO] Writing LBA: 0x"); serial_print_hex(current_lba); serial_write("\n");
 
-        buffer_t* b = buffer_get(fs->disk_ptr->blk_dev.device_name, current_lba);
+        buffer_t* b = buffer_get_block(fs->disk_ptr, current_lba);
         if (!b) {
             serial_printf("[FAT_IO_ERR] write_cluster_cached: Buffer get failed for LBA 0x%lx\n", (unsigned long)current_lba);
             result = FS_ERR_IO; goto write_cluster_cleanup;
         }
 
-        size_t offset_within_this_sector = (sec_idx == start_sector_in_cluster) ? (offset_in_cluster % sector_size) : 0;
-        size_t bytes_to_copy_to_this_sector = MIN(sector_size - offset_within_this_sector, len - bytes_written_total);
+        size_t offset_within_this_block = (size_t)(current_lba - b->block_number) * sector_size + pos % sector_size;
+        size_t bytes_to_copy_to_this_block = MIN(b->size - offset_within_this_block, len - bytes_written_total);
 
-        memcpy(b->data + offset_within_this_sector, src_ptr, bytes_to_copy_to_this_sector);
+        memcpy(b->data + offset_within_this_block, src_ptr, bytes_to_copy_to_this_block);
         buffer_mark_dirty(b);
         buffer_release(b);
 
-        src_ptr += bytes_to_copy_to_this_sector;
-        bytes_written_total += bytes_to_copy_to_this_sector;
+        src_ptr += bytes_to_copy_to_this_block;
+        bytes_written_total += bytes_to_copy_to_this_block;
     }
 
 write_cluster_cleanup:
@@ -172,6 +176,153 @@ write_cluster_cleanup:
 }
 
 
+/**
+ * @brief Counts the clusters from @p cluster on that follow each other on disk
+ * (at most @p max), walking the chain. *last receives the final one of the run.
+ */
+static uint32_t fat_contiguous_run(fat_fs_t *fs, uint32_t cluster, uint32_t max, uint32_t *last)
+{
+    uint32_t run = 1;
+    kmutex_lock(&fs->lock);
+    while (run < max) {
+        uint32_t next_cluster;
+        if (fat_get_next_cluster(fs, cluster, &next_cluster) != FS_SUCCESS || next_cluster != cluster + 1) break;
+        cluster = next_cluster;
+        run++;
+    }
+    kmutex_unlock(&fs->lock);
+    *last = cluster;
+    return run;
+}
+
+/** @brief Clusters needed to hold @p bytes (at least one). */
+static inline uint32_t fat_clusters_for_bytes(fat_fs_t *fs, size_t bytes)
+{
+    uint32_t clusters = (uint32_t)((bytes + fs->cluster_size_bytes - 1) / fs->cluster_size_bytes);
+    return clusters ? clusters : 1;
+}
+
+/** @brief Forgets the context's cached chain layout (the chain was cut or replaced). */
+static void fat_extent_map_reset(fat_file_context_t *fctx)
+{
+    kfree(fctx->extent_map.extents);
+    memset(&fctx->extent_map, 0, sizeof(fctx->extent_map));
+}
+
+/** @brief Starts a new one-cluster extent, growing the array if needed. */
+static bool fat_extent_map_append(fat_extent_map_t *map, uint32_t file_index, uint32_t disk_cluster)
+{
+    if (map->count == map->capacity) {
+        if (map->capacity >= FAT_EXTENT_MAP_MAX) return false;
+        uint32_t new_capacity = map->capacity ? MIN(map->capacity * 2, FAT_EXTENT_MAP_MAX) : 8;
+        fat_extent_t *grown = kmalloc(new_capacity * sizeof(fat_extent_t));
+        if (!grown) return false;
+        if (map->count) memcpy(grown, map->extents, map->count * sizeof(fat_extent_t));
+        kfree(map->extents);
+        map->extents = grown;
+        map->capacity = new_capacity;
+    }
+    map->extents[map->count].file_index = file_index;
+    map->extents[map->count].disk_cluster = disk_cluster;
+    map->extents[map->count].length = 1;
+    map->count++;
+    return true;
+}
+
+/** @brief The mapped extent holding file cluster @p index, or NULL if the map ends before it. */
+static fat_extent_t *fat_extent_map_find(fat_extent_map_t *map, uint32_t index)
+{
+    if (map->count == 0) return NULL;
+    fat_extent_t *last = &map->extents[map->count - 1];
+    if (index >= last->file_index + last->length) return NULL;
+    // Last extent starting at or before index
+    uint32_t lo = 0, hi = map->count - 1;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi + 1) / 2;
+        if (map->extents[mid].file_index <= index) lo = mid; else hi = mid - 1;
+    }
+    return &map->extents[lo];
+}
+
+/**
+ * @brief Finds the disk cluster holding cluster @p index of the file.
+ *
+ * Indices already mapped are found by binary search of the context's extent
+ * map. Past its end the chain is walked from the last mapped cluster, and
+ * the clusters passed are added to the map, so each link is read at most
+ * once per open file. Takes fs->lock.
+ *
+ * @param cluster_out Disk cluster at @p index, or the chain's last cluster if it ends sooner.
+ * @param index_out   File cluster index of *cluster_out (less than @p index if the chain ended).
+ * @return FS_SUCCESS, or FS_ERR_IO if a FAT entry could not be read.
+ */
+static int fat_map_file_cluster(fat_fs_t *fs, fat_file_context_t *fctx, uint32_t index,
+                                uint32_t *cluster_out, uint32_t *index_out)
+{
+    int result = FS_SUCCESS;
+    kmutex_lock(&fs->lock);
+    fat_extent_map_t *map = &fctx->extent_map;
+
+    if (map->first_cluster != fctx->first_cluster) {
+        fat_extent_map_reset(fctx);
+        map->first_cluster = fctx->first_cluster;
+    }
+
+    uint32_t cur = fctx->first_cluster;
+    uint32_t cur_index = 0;
+    bool recording = map->count > 0 || fat_extent_map_append(map, 0, cur);
+    if (map->count > 0) {
+        fat_extent_t *hit = fat_extent_map_find(map, index);
+        if (hit) {
+            *cluster_out = hit->disk_cluster + (index - hit->file_index);
+            *index_out = index;
+            kmutex_unlock(&fs->lock);
+            return FS_SUCCESS;
+        }
+        fat_extent_t *last = &map->extents[map->count - 1];
+        cur = last->disk_cluster + last->length - 1;
+        cur_index = last->file_index + last->length - 1;
+    }
+
+    while (cur_index < index) {
+        uint32_t next;
+        if (fat_get_next_cluster(fs, cur, &next) != FS_SUCCESS) { result = FS_ERR_IO; break; }
+        if (next < 2 || next >= fs->eoc_marker) break;
+        cur_index++;
+        if (recording) {
+            if (next == cur + 1) map->extents[map->count - 1].length++;
+            else recording = fat_extent_map_append(map, cur_index, next); // Map full: stop recording
+        }
+        cur = next;
+    }
+    kmutex_unlock(&fs->lock);
+
+    *cluster_out = cur;
+    *index_out = cur_index;
+    return result;
+}
+
+/**
+ * @brief Counts the clusters from file cluster @p index on (at most @p max)
+ * that lie back to back on disk, using the extent map.
+ * @return The run length, or 0 if the map cannot answer (it is full, or the
+ *         chain has a read error); the caller then walks the chain itself.
+ */
+static uint32_t fat_map_file_run(fat_fs_t *fs, fat_file_context_t *fctx, uint32_t index, uint32_t max)
+{
+    uint32_t cluster, reached;
+    if (max == 0) return 0;
+    // Map the whole range first, so a run is not cut at the map's current end
+    if (fat_map_file_cluster(fs, fctx, index + max - 1, &cluster, &reached) != FS_SUCCESS || reached < index) return 0;
+
+    uint32_t run = 0;
+    kmutex_lock(&fs->lock);
+    fat_extent_t *hit = fat_extent_map_find(&fctx->extent_map, index);
+    if (hit) run = MIN(hit->file_index + hit->length - index, max);
+    kmutex_unlock(&fs->lock);
+    return run;
+}
+
 /* --- VFS Operation Implementations --- */
 
 /**
@@ -194,15 +345,23 @@ int fat_read_internal(file_t *file, void *buf, size_t len)
         return FS_ERR_IS_A_DIRECTORY;
     }
 
-    uintptr_t irq_flags;
     int result = FS_SUCCESS;
     size_t total_bytes_read = 0;
 
-    irq_flags = spinlock_acquire_irqsave(&fs->lock);
+    // Buffered appends the read reaches (through any handle) go to disk first
+    fat_write_buffer_t *wb = &fctx->write_buffer;
+    kmutex_lock(&fctx->io_lock);
+    if (wb->len && file->offset >= 0 && (uint64_t)file->offset + len > wb->offset) {
+        result = fat_flush_write_buffer(fs, fctx);
+    }
+    kmutex_unlock(&fctx->io_lock);
+    if (result != FS_SUCCESS) return result;
+
+    kmutex_lock(&fs->lock);
     off_t current_offset = file->offset;
     uint32_t file_size = fctx->file_size;
     uint32_t first_cluster = fctx->first_cluster;
-    spinlock_release_irqrestore(&fs->lock, irq_flags);
+    kmutex_unlock(&fs->lock);
 
     // serial_printf("[FAT_IO] fat_read: Offset=0x%llx, ReqLen=0x%zx, FileSize=0x%lx, FirstClu=0x%lx\n", (unsigned long long)current_offset, len, (unsigned long)file_size, (unsigned long)first_cluster);
 
@@ -234,23 +393,20 @@ int fat_read_internal(file_t *file, void *buf, size_t len)
     uint32_t current_cluster_num = first_cluster;
     uint32_t cluster_index_to_seek = (uint32_t)(current_offset / cluster_size);
     uint32_t offset_in_first_read_cluster = (uint32_t)(current_offset % cluster_size);
+    uint32_t current_cluster_index = cluster_index_to_seek;
 
-    // Traverse cluster chain to the starting cluster for the read
-    for (uint32_t i = 0; i < cluster_index_to_seek; i++) {
-        uint32_t next_cluster;
-        irq_flags = spinlock_acquire_irqsave(&fs->lock);
-        result = fat_get_next_cluster(fs, current_cluster_num, &next_cluster);
-        spinlock_release_irqrestore(&fs->lock, irq_flags);
-
+    // Find the starting cluster for the read
+    if (cluster_index_to_seek > 0) {
+        uint32_t reached_index;
+        result = fat_map_file_cluster(fs, fctx, cluster_index_to_seek, &current_cluster_num, &reached_index);
         if (result != FS_SUCCESS) {
             serial_printf("[FAT_IO_ERR] fat_read: Seek failed getting next cluster from 0x%lx\n", (unsigned long)current_cluster_num);
             return FS_ERR_IO;
         }
-        if (next_cluster >= fs->eoc_marker) {
+        if (reached_index < cluster_index_to_seek) {
             serial_write("[FAT_IO_ERR] fat_read: Seek failed - EOC found prematurely\n");
             return FS_ERR_CORRUPT;
         }
-        current_cluster_num = next_cluster;
     }
     // serial_write("[FAT_IO] fat_read: Seeked to StartClu=0x"); serial_print_hex(current_cluster_num); serial_write(", OffsetInClu=0x"); serial_print_hex(offset_in_first_read_cluster); serial_write("\n");
 
@@ -265,6 +421,39 @@ int fat_read_internal(file_t *file, void *buf, size_t len)
         size_t bytes_to_read_this_cluster = MIN(cluster_size - current_offset_in_cluster, len - total_bytes_read);
         // serial_printf("[FAT_IO] fat_read: Reading 0x%zx bytes from Clu=0x%lx, Offset=0x%lx\n", bytes_to_read_this_cluster, (unsigned long)current_cluster_num, (unsigned long)current_offset_in_cluster);
 
+        // Whole clusters back to back on disk: one large request, past the cache
+        size_t bytes_left = len - total_bytes_read;
+        if (current_offset_in_cluster == 0 && bytes_left >= FAT_BULK_READ_MIN_BYTES) {
+            uint32_t max_clusters = MIN((uint32_t)(bytes_left / cluster_size),
+                                        BUFFER_BULK_MAX_SECTORS / fs->sectors_per_cluster);
+            uint32_t last_cluster;
+            uint32_t run = fat_map_file_run(fs, fctx, current_cluster_index, max_clusters);
+            if (run > 0) last_cluster = current_cluster_num + run - 1;
+            else run = fat_contiguous_run(fs, current_cluster_num, max_clusters, &last_cluster);
+            uint32_t run_lba = fat_cluster_to_lba(fs, current_cluster_num);
+            if (run > 1 && run_lba != 0) {
+                int bulk_result = buffer_read_bulk(fs->disk_ptr, run_lba, run * fs->sectors_per_cluster,
+                                                   (uint8_t*)buf + total_bytes_read);
+                if (bulk_result != FS_SUCCESS) {
+                    serial_printf("[FAT_IO_ERR] fat_read: buffer_read_bulk failed with %d at cluster 0x%lx\n", bulk_result, (unsigned long)current_cluster_num);
+                    result = FS_ERR_IO; goto cleanup_read;
+                }
+                // Carry on from the run's last cluster as if it alone had been read
+                bytes_to_read_this_cluster = (size_t)run * cluster_size;
+                current_cluster_num = last_cluster;
+                current_cluster_index += run - 1;
+                goto cluster_done;
+            }
+        }
+
+        // Let the buffer cache see the stream; sequential reads get prefetched ahead
+        uint32_t cluster_lba = fat_cluster_to_lba(fs, current_cluster_num);
+        if (cluster_lba != 0) {
+            uint32_t first_sector = current_offset_in_cluster / fs->bytes_per_sector;
+            uint32_t last_sector = (current_offset_in_cluster + (uint32_t)bytes_to_read_this_cluster - 1) / fs->bytes_per_sector;
+            buffer_readahead(fs->disk_ptr, &fctx->readahead, cluster_lba + first_sector, last_sector - first_sector + 1);
+        }
+
         result = read_cluster_cached(fs, current_cluster_num, current_offset_in_cluster, (uint8_t*)buf + total_bytes_read, bytes_to_read_this_cluster);
 
         if (result < 0) {
@@ -276,21 +465,19 @@ int fat_read_internal(file_t *file, void *buf, size_t len)
             result = FS_ERR_IO; goto cleanup_read;
         }
 
+cluster_done:
         total_bytes_read += bytes_to_read_this_cluster;
         current_offset_in_cluster = 0; // Subsequent reads from a cluster start at its beginning
 
         if (total_bytes_read < len) { // Need to move to the next cluster
-            uint32_t next_cluster;
-            irq_flags = spinlock_acquire_irqsave(&fs->lock);
-            result = fat_get_next_cluster(fs, current_cluster_num, &next_cluster);
-            spinlock_release_irqrestore(&fs->lock, irq_flags);
+            uint32_t next_cluster, reached_index;
+            result = fat_map_file_cluster(fs, fctx, current_cluster_index + 1, &next_cluster, &reached_index);
 
             if (result != FS_SUCCESS) {
                 serial_printf("[FAT_IO_ERR] fat_read: Failed to get next cluster after 0x%lx\n", (unsigned long)current_cluster_num);
                 result = FS_ERR_IO; goto cleanup_read;
             }
-            current_cluster_num = next_cluster;
-            if (current_cluster_num >= fs->eoc_marker) { // Reached EOC marker
+            if (reached_index <= current_cluster_index) { // Reached EOC marker
                 // This means we've read all allocated clusters, but `len` (derived from file_size) might have expected more.
                 // This implies a mismatch between file_size and actual chain length.
                 // However, we should return the bytes read so far as per file_size and EOF logic handled earlier.
@@ -299,6 +486,8 @@ int fat_read_internal(file_t *file, void *buf, size_t len)
                 serial_printf("[FAT_IO_WARN] fat_read: EOC 0x%lx reached mid-read; file might be corrupt or size mismatch. Read 0x%zx of 0x%zx bytes.\n", (unsigned long)current_cluster_num, total_bytes_read, len);
                 break; 
             }
+            current_cluster_num = next_cluster;
+            current_cluster_index++;
         }
     }
     result = FS_SUCCESS; // If loop completed or broke due to EOC (which is not an error for read itself)
@@ -309,6 +498,51 @@ cleanup_read:
 }
 
 
+/**
+ * @brief Records the context's size and first cluster in its directory entry
+ * (through the buffer cache) and clears fctx->dirty. Caller holds fs->lock.
+ */
+static int fat_write_file_entry(fat_fs_t *fs, fat_file_context_t *fctx)
+{
+    // serial_printf("[FAT_IO] fat_write_file_entry: Updating dir entry (DirClu=0x%lx, DirOff=0x%lx)\n", (unsigned long)fctx->dir_entry_cluster, (unsigned long)fctx->dir_entry_offset);
+    int update_result;
+    fat_dir_entry_t existing_entry; // Temporary stack storage
+    uint8_t *sector_buf = kmalloc(fs->bytes_per_sector); // Buffer for sector read/write
+    if (!sector_buf) {
+        serial_write("[FAT_IO_ERR] fat_write_file_entry: Failed to alloc sector_buf for dir update\n");
+        return FS_ERR_OUT_OF_MEMORY;
+    }
+
+    // Read the sector containing the directory entry
+    int read_sec_res = read_directory_sector(fs, fctx->dir_entry_cluster, fctx->dir_entry_offset / fs->bytes_per_sector, sector_buf);
+    if (read_sec_res == FS_SUCCESS) {
+        memcpy(&existing_entry, sector_buf + (fctx->dir_entry_offset % fs->bytes_per_sector), sizeof(fat_dir_entry_t));
+
+        // Update fields from context
+        existing_entry.file_size = fctx->file_size;
+        existing_entry.first_cluster_low = (uint16_t)(fctx->first_cluster & 0xFFFF);
+        existing_entry.first_cluster_high = (uint16_t)((fctx->first_cluster >> 16) & 0xFFFF);
+
+        // TODO: Update timestamps (write_time, write_date, last_access_date)
+        // fat_get_current_timestamp(&existing_entry.write_time, &existing_entry.write_date);
+        // existing_entry.last_access_date = existing_entry.write_date; // Or specific access date logic
+
+        // Write the modified entry back
+        update_result = update_directory_entry(fs, fctx->dir_entry_cluster, fctx->dir_entry_offset, &existing_entry);
+        if (update_result == FS_SUCCESS) {
+            fctx->dirty = false; // Clear dirty flag ONLY on successful write-back
+            fctx->entry_unsynced = true;
+        } else {
+            serial_printf("[FAT_IO_ERR] fat_write_file_entry: Failed to update directory entry (err %d)\n", update_result);
+        }
+    } else {
+        serial_printf("[FAT_IO_ERR] fat_write_file_entry: Failed to read dir sector for update (err %d)\n", read_sec_res);
+        update_result = read_sec_res;
+    }
+    kfree(sector_buf);
+    return update_result;
+}
+
 /**
  * @brief Closes an opened file. Updates directory entry if modified.
  */
@@ -321,52 +555,47 @@ int fat_close_internal(file_t *file)
 
     // serial_printf("[FAT_IO] fat_close: Closing fctx=0x%p, dirty=0x%x\n", fctx, (unsigned int)fctx->dirty);
 
+    // Handles still sharing the context keep it, and its pending state, open
+    kmutex_lock(&fs->lock);
+    bool last_handle = fat_vcache_release(fs, fctx);
+    if (last_handle && fctx->unlinked) {
+        // The entry is gone: free what was written since instead of recording it
+        fat_discard_file_data(fs, fctx);
+    }
+    kmutex_unlock(&fs->lock);
+    if (!last_handle || fctx->unlinked) {
+        if (last_handle) {
+            kfree(fctx->write_buffer.data);
+            fat_extent_map_reset(fctx);
+            fat_free_file_context(fctx);
+        }
+        file->vnode->data = NULL;
+        return FS_SUCCESS;
+    }
+
+    // Buffered appends get their clusters now; the entry below then records them
+    int flush_result = fat_flush_write_buffer(fs, fctx);
+    kfree(fctx->write_buffer.data);
+    fctx->write_buffer.data = NULL;
+
     int update_result = FS_SUCCESS;
-    uintptr_t irq_flags = spinlock_acquire_irqsave(&fs->lock);
 
-    if (fctx->dirty) {
-        // serial_printf("[FAT_IO] fat_close: Context dirty. Updating dir entry (DirClu=0x%lx, DirOff=0x%lx)\n", (unsigned long)fctx->dir_entry_cluster, (unsigned long)fctx->dir_entry_offset);
-        
-        // This part updates the directory entry on disk with new size, first cluster, and timestamps.
-        // It's crucial for data integrity.
-        fat_dir_entry_t existing_entry; // Temporary stack storage
-        uint8_t *sector_buf = kmalloc(fs->bytes_per_sector); // Buffer for sector read/write
-        if (!sector_buf) {
-            serial_write("[FAT_IO_ERR] fat_close: Failed to alloc sector_buf for dir update\n");
-            update_result = FS_ERR_OUT_OF_MEMORY;
-        } else {
-            // Read the sector containing the directory entry
-            int read_sec_res = read_directory_sector(fs, fctx->dir_entry_cluster, fctx->dir_entry_offset / fs->bytes_per_sector, sector_buf);
-            if (read_sec_res == FS_SUCCESS) {
-                memcpy(&existing_entry, sector_buf + (fctx->dir_entry_offset % fs->bytes_per_sector), sizeof(fat_dir_entry_t));
-
-                // Update fields from context
-                existing_entry.file_size = fctx->file_size;
-                existing_entry.first_cluster_low = (uint16_t)(fctx->first_cluster & 0xFFFF);
-                existing_entry.first_cluster_high = (uint16_t)((fctx->first_cluster >> 16) & 0xFFFF);
-                
-                // TODO: Update timestamps (write_time, write_date, last_access_date)
-                // fat_get_current_timestamp(&existing_entry.write_time, &existing_entry.write_date);
-                // existing_entry.last_access_date = existing_entry.write_date; // Or specific access date logic
-
-                // Write the modified entry back
-                update_result = update_directory_entry(fs, fctx->dir_entry_cluster, fctx->dir_entry_offset, &existing_entry);
-                if (update_result == FS_SUCCESS) {
-                    fctx->dirty = false; // Clear dirty flag ONLY on successful write-back
-                    // serial_write("[FAT_IO] fat_close: Directory entry update successful.\n");
-                } else {
-                    serial_printf("[FAT_IO_ERR] fat_close: Failed to update directory entry (err %d)\n", update_result);
-                }
-            } else {
-                serial_printf("[FAT_IO_ERR] fat_close: Failed to read dir sector for update (err %d)\n", read_sec_res);
-                update_result = read_sec_res;
-            }
-            kfree(sector_buf);
+    kmutex_lock(&fs->lock);
+
+    // Give back preallocated clusters the file did not grow into
+    if (fctx->preallocated && fctx->first_cluster >= 2) {
+        int trim_res = fat_trim_cluster_chain(fs, fctx->first_cluster, fat_clusters_for_bytes(fs, fctx->file_size));
+        if (trim_res != FS_SUCCESS) {
+            serial_printf("[FAT_IO_ERR] fat_close: Failed to trim preallocated clusters (err %d)\n", trim_res);
         }
     }
-    spinlock_release_irqrestore(&fs->lock, irq_flags);
+    fat_extent_map_reset(fctx);
+
+    if (fctx->dirty) update_result = fat_write_file_entry(fs, fctx);
+    kmutex_unlock(&fs->lock);
+    if (flush_result != FS_SUCCESS && update_result == FS_SUCCESS) update_result = flush_result;
 
-    kfree(fctx);
+    fat_free_file_context(fctx);
     file->vnode->data = NULL;
 
     // serial_printf("[FAT_IO] fat_close: Exit. Result=%d\n", update_result);
@@ -374,53 +603,39 @@ int fat_close_internal(file_t *file)
 }
 
 
-/**
- * @brief Writes data to an opened file. Implements VFS write.
- * Handles cluster allocation, EOF extension, and updating file metadata.
- */
-int fat_write_internal(file_t *file, const void *buf, size_t len)
+/** @brief Adds file clusters [first, end) to those the next fsync writes back. Caller holds fs->lock. */
+static void fat_sync_range_add(fat_file_context_t *fctx, uint32_t first, uint32_t end)
 {
-    if (!file || !file->vnode || !file->vnode->data || (!buf && len > 0)) {
-        serial_write("[FAT_IO_ERR] fat_write: Invalid parameters\n");
-        return FS_ERR_INVALID_PARAM;
-    }
-    if (len == 0) return 0;
-
-    fat_file_context_t *fctx = (fat_file_context_t*)file->vnode->data;
-    KERNEL_ASSERT(fctx->fs != NULL, "FAT context missing FS pointer");
-    fat_fs_t *fs = fctx->fs;
-
-    if (fctx->is_directory) {
-        serial_write("[FAT_IO_ERR] fat_write: Cannot write to a directory\n");
-        return FS_ERR_IS_A_DIRECTORY;
-    }
-    if (!(file->flags & (O_WRONLY | O_RDWR))) {
-        serial_write("[FAT_IO_ERR] fat_write: File not opened for writing\n");
-        return FS_ERR_PERMISSION_DENIED;
+    if (fctx->sync_first == fctx->sync_end) {
+        fctx->sync_first = first;
+        fctx->sync_end = end;
+        return;
     }
+    if (first < fctx->sync_first) fctx->sync_first = first;
+    if (end > fctx->sync_end) fctx->sync_end = end;
+}
 
-    uintptr_t irq_flags;
+/**
+ * @brief Writes @p len bytes at @p current_offset straight to the file's
+ * clusters, allocating and linking clusters as the chain runs out (each
+ * allocation takes as much of the remaining write as fits contiguously).
+ * Grows fctx->file_size in memory; the directory entry is written at close.
+ * @param written_out Bytes that reached the file, also on failure.
+ * @return FS_SUCCESS or a negative FS_ERR_* code.
+ */
+static int fat_write_at(fat_fs_t *fs, fat_file_context_t *fctx, off_t current_offset,
+                        const void *buf, size_t len, size_t *written_out)
+{
     int result = FS_SUCCESS;
     size_t total_bytes_written = 0;
     bool file_metadata_changed = false; // Tracks if first_cluster or file_size changes
+    *written_out = 0;
 
-    // Determine write position
-    irq_flags = spinlock_acquire_irqsave(&fs->lock);
-    off_t current_offset = file->offset;
-    uint32_t file_size_before_write = fctx->file_size;
-    uint32_t first_cluster_before_write = fctx->first_cluster; // For checking if it's newly allocated
-    
-    if (file->flags & O_APPEND) { current_offset = (off_t)file_size_before_write; }
-    
-    if (current_offset < 0) {
-        spinlock_release_irqrestore(&fs->lock, irq_flags);
-        serial_write("[FAT_IO_ERR] fat_write: Negative file offset\n");
-        return FS_ERR_INVALID_PARAM;
-    }
+    kmutex_lock(&fs->lock);
     uint32_t current_first_cluster = fctx->first_cluster; // Use this for the rest of the write logic
-    spinlock_release_irqrestore(&fs->lock, irq_flags);
+    kmutex_unlock(&fs->lock);
 
-    // serial_printf("[FAT_IO] fat_write: Offset=0x%llx, ReqLen=0x%zx, FileSize=0x%lx, FirstClu=0x%lx\n", (unsigned long long)current_offset, len, (unsigned long)file_size_before_write, (unsigned long)current_first_cluster);
+    // serial_printf("[FAT_IO] fat_write: Offset=0x%llx, ReqLen=0x%zx, FirstClu=0x%lx\n", (unsigned long long)current_offset, len, (unsigned long)current_first_cluster);
 
     size_t cluster_size = fs->cluster_size_bytes;
     if (cluster_size == 0) {
@@ -435,31 +650,19 @@ int fat_write_internal(file_t *file, const void *buf, size_t len)
             return FS_ERR_INVALID_PARAM;
         }
         // serial_printf("[FAT_IO] fat_write: Allocating initial cluster for empty file (Offset: %lld).\n", (long long)current_offset);
-        irq_flags = spinlock_acquire_irqsave(&fs->lock);
-        uint32_t new_cluster = fat_allocate_cluster(fs, 0); // Allocate and mark as EOC
+        kmutex_lock(&fs->lock);
+        uint32_t allocated;
+        uint32_t new_cluster = fat_allocate_extent(fs, 0, fat_clusters_for_bytes(fs, len), &allocated); // As much of the write as fits contiguously
         if (new_cluster < 2) {
-            spinlock_release_irqrestore(&fs->lock, irq_flags);
+            kmutex_unlock(&fs->lock);
             serial_write("[FAT_IO_ERR] fat_write: Failed to allocate initial cluster (no space?)\n");
             return FS_ERR_NO_SPACE;
         }
         fctx->first_cluster = new_cluster;
         current_first_cluster = new_cluster; // Update local working copy
         file_metadata_changed = true;
-        fctx->dirty = true; // Context is dirty due to new first cluster
-
-        // Immediately update the directory entry with the new first cluster.
-        // This is crucial to prevent data loss if system crashes before close.
-        int rc_update_clu = update_directory_entry_first_cluster_now(fs, fctx);
-        if (rc_update_clu != FS_SUCCESS) {
-            serial_printf("[FAT_IO_ERR] fat_write: Failed to update dir entry for new first_cluster %lu! Rolling back.\n", (unsigned long)new_cluster);
-            fat_free_cluster_chain(fs, new_cluster); // Free the just-allocated cluster
-            fctx->first_cluster = 0;                 // Revert context
-            current_first_cluster = 0;
-            spinlock_release_irqrestore(&fs->lock, irq_flags);
-            return rc_update_clu;
-        }
-        // serial_printf("[FAT_IO] fat_write: Allocated initial cluster 0x%lx and updated dir entry.\n", (unsigned long)new_cluster);
-        spinlock_release_irqrestore(&fs->lock, irq_flags);
+        fctx->dirty = true; // Context is dirty due to new first cluster; close writes it to the entry
+        kmutex_unlock(&fs->lock);
     }
     KERNEL_ASSERT(current_first_cluster >= 2 || len == 0, "First cluster invalid after initial check/alloc for non-zero write");
 
@@ -468,24 +671,37 @@ int fat_write_internal(file_t *file, const void *buf, size_t len)
     uint32_t current_cluster_num = current_first_cluster;
     uint32_t cluster_index_to_seek = (uint32_t)(current_offset / cluster_size);
     uint32_t offset_in_first_write_cluster = (uint32_t)(current_offset % cluster_size);
+    uint32_t last_write_cluster_index = (uint32_t)((current_offset + len - 1) / cluster_size);
 
-    for (uint32_t i = 0; i < cluster_index_to_seek; i++) {
+    // Jump as far as the existing chain goes, then extend it one link at a time
+    uint32_t seek_start_index = 0;
+    if (cluster_index_to_seek > 0) {
+        result = fat_map_file_cluster(fs, fctx, cluster_index_to_seek, &current_cluster_num, &seek_start_index);
+        if (result != FS_SUCCESS) {
+            serial_printf("[FAT_IO_ERR] fat_write: Seek/Extend: Error getting next cluster from 0x%lx\n", (unsigned long)current_cluster_num);
+            result = FS_ERR_IO; goto cleanup_write;
+        }
+    }
+
+    for (uint32_t i = seek_start_index; i < cluster_index_to_seek; i++) {
         uint32_t next_cluster;
         bool allocated_new_in_seek = false;
         
-        irq_flags = spinlock_acquire_irqsave(&fs->lock);
+        kmutex_lock(&fs->lock);
         int find_result = fat_get_next_cluster(fs, current_cluster_num, &next_cluster);
         if (find_result != FS_SUCCESS) {
-            spinlock_release_irqrestore(&fs->lock, irq_flags);
+            kmutex_unlock(&fs->lock);
             serial_printf("[FAT_IO_ERR] fat_write: Seek/Extend: Error getting next cluster from 0x%lx\n", (unsigned long)current_cluster_num);
             result = FS_ERR_IO; goto cleanup_write;
         }
 
         if (next_cluster >= fs->eoc_marker) { // Need to allocate a new cluster
             // serial_printf("[FAT_IO] fat_write: Seek/Extend: Allocating new cluster after 0x%lx\n", (unsigned long)current_cluster_num);
-            next_cluster = fat_allocate_cluster(fs, current_cluster_num); // Allocates AND links
+            // Allocates AND links, with the rest of the gap and the write in one extent if it can
+            uint32_t allocated;
+            next_cluster = fat_allocate_extent(fs, current_cluster_num, last_write_cluster_index - i, &allocated);
             if (next_cluster < 2) {
-                spinlock_release_irqrestore(&fs->lock, irq_flags);
+                kmutex_unlock(&fs->lock);
                 serial_write("[FAT_IO_ERR] fat_write: Seek/Extend: Failed to allocate cluster (no space?)\n");
                 result = FS_ERR_NO_SPACE; goto cleanup_write;
             }
@@ -493,7 +709,7 @@ int fat_write_internal(file_t *file, const void *buf, size_t len)
             file_metadata_changed = true; // File structure changed
             allocated_new_in_seek = true;
         }
-        spinlock_release_irqrestore(&fs->lock, irq_flags);
+        kmutex_unlock(&fs->lock);
         current_cluster_num = next_cluster;
         // if (allocated_new_in_seek) serial_printf("[FAT_IO] fat_write: Seek/Extend: Allocated new cluster 0x%lx\n", (unsigned long)current_cluster_num);
     }
@@ -529,11 +745,13 @@ int fat_write_internal(file_t *file, const void *buf, size_t len)
             bool allocated_new_in_loop = false;
             int alloc_res = FS_SUCCESS;
             
-            irq_flags = spinlock_acquire_irqsave(&fs->lock);
+            kmutex_lock(&fs->lock);
             int find_res = fat_get_next_cluster(fs, current_cluster_num, &next_cluster);
             if (find_res == FS_SUCCESS && next_cluster >= fs->eoc_marker) { // End of chain, need to allocate
                 // serial_printf("[FAT_IO] fat_write: Allocating next cluster after 0x%lx (EOC found)\n", (unsigned long)current_cluster_num);
-                next_cluster = fat_allocate_cluster(fs, current_cluster_num);
+                uint32_t allocated;
+                next_cluster = fat_allocate_extent(fs, current_cluster_num,
+                                                   fat_clusters_for_bytes(fs, len - total_bytes_written), &allocated);
                 if (next_cluster < 2) {
                     alloc_res = FS_ERR_NO_SPACE;
                     serial_write("[FAT_IO_ERR] fat_write: Failed to allocate next cluster (no space?)\n");
@@ -547,7 +765,7 @@ int fat_write_internal(file_t *file, const void *buf, size_t len)
                 serial_printf("[FAT_IO_ERR] fat_write: Failed to get next cluster after 0x%lx during write loop\n", (unsigned long)current_cluster_num);
             }
             // If find_res == FS_SUCCESS and next_cluster is valid data cluster, we just use it.
-            spinlock_release_irqrestore(&fs->lock, irq_flags);
+            kmutex_unlock(&fs->lock);
 
             if (alloc_res != FS_SUCCESS) {
                 result = alloc_res;
@@ -561,23 +779,17 @@ int fat_write_internal(file_t *file, const void *buf, size_t len)
     result = FS_SUCCESS;
 
 cleanup_write:
-    // Update file offset and size in context
-    irq_flags = spinlock_acquire_irqsave(&fs->lock);
-    off_t final_offset = current_offset + total_bytes_written;
-    file->offset = final_offset; // Update VFS file handle offset
-
-    if ((uint64_t)final_offset > file_size_before_write) {
+    // Grow the in-memory size; the directory entry follows at close
+    kmutex_lock(&fs->lock);
+    uint64_t final_offset = (uint64_t)current_offset + total_bytes_written;
+    if (final_offset > fctx->file_size) {
         fctx->file_size = (uint32_t)final_offset;
         file_metadata_changed = true; // File size changed
+    }
 
-        // Immediately update the directory entry with the new file size.
-        // serial_printf("[FAT_IO] fat_write: Updating dir entry size to 0x%lx.\n", (unsigned long)fctx->file_size);
-        int rc_update_size = update_directory_entry_size_now(fs, fctx);
-        if (rc_update_size != FS_SUCCESS) {
-            serial_printf("[FAT IO ERROR] fat_write_internal: Failed to update dir entry size! (err %d)\n", rc_update_size);
-            // If write itself was successful, this error becomes the primary error.
-            if (result == FS_SUCCESS) result = rc_update_size;
-        }
+    if (total_bytes_written > 0) {
+        fat_sync_range_add(fctx, (uint32_t)(current_offset / cluster_size),
+                           (uint32_t)((final_offset - 1) / cluster_size) + 1);
     }
 
     // If first cluster or file size changed, or if FAT chain was modified, context is dirty.
@@ -586,13 +798,338 @@ cleanup_write:
         // serial_write("[FAT_IO] fat_write: Marked context dirty due to metadata change.\n");
     }
     // TODO: Timestamp update logic would go here and set fctx->dirty = true;
-    spinlock_release_irqrestore(&fs->lock, irq_flags);
+    kmutex_unlock(&fs->lock);
 
+    *written_out = total_bytes_written;
+    return result;
+}
+
+/**
+ * @brief Drops an open file's data: buffered appends, the cluster chain,
+ * the size and the cached chain layout.
+ */
+int fat_discard_file_data(fat_fs_t *fs, fat_file_context_t *fctx)
+{
+    int result = FS_SUCCESS;
+    fctx->write_buffer.len = 0;
+    if (fctx->first_cluster >= 2) result = fat_free_cluster_chain(fs, fctx->first_cluster);
+    fctx->first_cluster = 0;
+    fctx->file_size = 0;
+    fctx->preallocated = false;
+    fctx->dirty = true;
+    fat_extent_map_reset(fctx);
+    return result;
+}
+
+/* --- Write-Behind Buffer --- */
+
+/**
+ * @brief Writes the context's buffered appends to disk. Clusters for the
+ * whole run are allocated now, as one extent where free space allows. If
+ * the write fails the file ends where its data on disk does.
+ * @return FS_SUCCESS or a negative FS_ERR_* code.
+ */
+int fat_flush_write_buffer(fat_fs_t *fs, fat_file_context_t *fctx)
+{
+    fat_write_buffer_t *wb = &fctx->write_buffer;
+    if (wb->len == 0) return FS_SUCCESS;
+
+    uint32_t offset = wb->offset;
+    uint32_t len = wb->len;
+    wb->len = 0;
+
+    size_t written;
+    int result = fat_write_at(fs, fctx, (off_t)offset, wb->data, len, &written);
+    if (result != FS_SUCCESS) {
+        serial_printf("[FAT_IO_ERR] fat_flush_write_buffer: Lost 0x%lx buffered bytes at 0x%lx (err %d)\n",
+                      (unsigned long)(len - written), (unsigned long)(offset + written), result);
+        kmutex_lock(&fs->lock);
+        fctx->file_size = offset + (uint32_t)written;
+        fctx->dirty = true;
+        kmutex_unlock(&fs->lock);
+    }
+    return result;
+}
+
+/**
+ * @brief Buffers an append of @p len bytes at the end of the file.
+ * @return true if the data was taken; false to write it through instead
+ *         (not an append, too large, out of memory, or the volume may be
+ *         too full for the clusters a later flush would need).
+ */
+static bool fat_write_buffer_append(fat_fs_t *fs, fat_file_context_t *fctx, off_t offset,
+                                    const void *buf, size_t len, int *result)
+{
+    fat_write_buffer_t *wb = &fctx->write_buffer;
+    *result = FS_SUCCESS;
+    if (len >= FAT_WRITE_BUFFER_BYTES) return false;
+
+    kmutex_lock(&fs->lock);
+    bool append = (uint64_t)offset == fctx->file_size && (uint64_t)offset + len <= 0xFFFFFFFFu;
+    // The free count is exact only while the bitmap is kept
+    bool may_not_fit = fs->free_bitmap && fat_clusters_for_bytes(fs, wb->len + len) > fs->free_cluster_count;
+    kmutex_unlock(&fs->lock);
+    if (!append || may_not_fit) return false;
+
+    if (wb->len + len > FAT_WRITE_BUFFER_BYTES) {
+        *result = fat_flush_write_buffer(fs, fctx);
+        if (*result != FS_SUCCESS) return true;
+    }
+    if (!wb->data) {
+        wb->data = kmalloc(FAT_WRITE_BUFFER_BYTES);
+        if (!wb->data) return false;
+    }
+    if (wb->len == 0) wb->offset = (uint32_t)offset;
+    memcpy(wb->data + wb->len, buf, len);
+    wb->len += (uint32_t)len;
+
+    kmutex_lock(&fs->lock);
+    fctx->file_size = (uint32_t)offset + (uint32_t)len;
+    fctx->dirty = true;
+    kmutex_unlock(&fs->lock);
+    return true;
+}
+
+/**
+ * @brief Writes data to an opened file. Implements VFS write.
+ * Appends smaller than the write-behind buffer are collected there and
+ * reach the disk, in one allocation, when it fills or the file is read
+ * past them, preallocated or closed. Other writes go straight through.
+ */
+int fat_write_internal(file_t *file, const void *buf, size_t len)
+{
+    if (!file || !file->vnode || !file->vnode->data || (!buf && len > 0)) {
+        serial_write("[FAT_IO_ERR] fat_write: Invalid parameters\n");
+        return FS_ERR_INVALID_PARAM;
+    }
+    if (len == 0) return 0;
+
+    fat_file_context_t *fctx = (fat_file_context_t*)file->vnode->data;
+    KERNEL_ASSERT(fctx->fs != NULL, "FAT context missing FS pointer");
+    fat_fs_t *fs = fctx->fs;
+
+    if (fctx->is_directory) {
+        serial_write("[FAT_IO_ERR] fat_write: Cannot write to a directory\n");
+        return FS_ERR_IS_A_DIRECTORY;
+    }
+    if (!(file->flags & (O_WRONLY | O_RDWR))) {
+        serial_write("[FAT_IO_ERR] fat_write: File not opened for writing\n");
+        return FS_ERR_PERMISSION_DENIED;
+    }
+
+    // One writer at a time per file, whichever handle it comes through
+    kmutex_lock(&fctx->io_lock);
+
+    // Determine write position
+    kmutex_lock(&fs->lock);
+    off_t current_offset = (file->flags & O_APPEND) ? (off_t)fctx->file_size : file->offset;
+    kmutex_unlock(&fs->lock);
+    if (current_offset < 0) {
+        kmutex_unlock(&fctx->io_lock);
+        serial_write("[FAT_IO_ERR] fat_write: Negative file offset\n");
+        return FS_ERR_INVALID_PARAM;
+    }
+    // The VFS advances file->offset by the bytes written, from where they went
+    file->offset = current_offset;
+
+    int result;
+    size_t total_bytes_written = len;
+    if (!fat_write_buffer_append(fs, fctx, current_offset, buf, len, &result)) {
+        result = fat_flush_write_buffer(fs, fctx);
+        if (result == FS_SUCCESS) {
+            result = fat_write_at(fs, fctx, current_offset, buf, len, &total_bytes_written);
+        }
+    }
+    kmutex_unlock(&fctx->io_lock);
     // serial_printf("[FAT_IO] fat_write: Exit. TotalWritten=0x%zx, Result=%d\n", total_bytes_written, result);
     return (result < 0) ? result : (int)total_bytes_written;
 }
 
 
+/**
+ * @brief Reserves clusters so the file's chain covers @p length bytes
+ * without changing its size. The chain is extended after its last cluster
+ * in contiguous extents, so a writer that knows its final size gets an
+ * unfragmented file; clusters left unused are freed at close.
+ */
+static int fat_fallocate_serialized(file_t *file, off_t length)
+{
+    if (!file || !file->vnode || !file->vnode->data || length < 0) return FS_ERR_INVALID_PARAM;
+    fat_file_context_t *fctx = (fat_file_context_t*)file->vnode->data;
+    KERNEL_ASSERT(fctx->fs != NULL, "FAT context missing FS pointer");
+    fat_fs_t *fs = fctx->fs;
+
+    if (fctx->is_directory) return FS_ERR_IS_A_DIRECTORY;
+    if (!(file->flags & (O_WRONLY | O_RDWR))) return FS_ERR_PERMISSION_DENIED;
+    if (length == 0) return FS_SUCCESS;
+
+    // Place buffered appends first, so the reservation extends their clusters
+    int result = fat_flush_write_buffer(fs, fctx);
+    if (result != FS_SUCCESS) return result;
+
+    uint32_t wanted = fat_clusters_for_bytes(fs, (size_t)length);
+    kmutex_lock(&fs->lock);
+
+    uint32_t have = 0, last = 0;
+    if (fctx->first_cluster < 2) {
+        uint32_t allocated;
+        uint32_t first = fat_allocate_extent(fs, 0, wanted, &allocated);
+        if (first < 2) {
+            kmutex_unlock(&fs->lock);
+            return FS_ERR_NO_SPACE;
+        }
+        fctx->first_cluster = first;
+        fctx->dirty = true;
+        result = update_directory_entry_first_cluster_now(fs, fctx);
+        if (result != FS_SUCCESS) {
+            fat_free_cluster_chain(fs, first);
+            fctx->first_cluster = 0;
+            fat_extent_map_reset(fctx);
+            kmutex_unlock(&fs->lock);
+            return result;
+        }
+        have = allocated;
+        last = first + allocated - 1;
+    } else {
+        // Find the end of the existing chain
+        last = fctx->first_cluster;
+        have = 1;
+        for (;;) {
+            uint32_t next;
+            if (fat_get_next_cluster(fs, last, &next) != FS_SUCCESS) { result = FS_ERR_IO; break; }
+            if (next < 2 || next >= fs->eoc_marker) break;
+            last = next;
+            have++;
+        }
+    }
+
+    fctx->preallocated = true;
+    while (result == FS_SUCCESS && have < wanted) {
+        uint32_t allocated;
+        uint32_t first = fat_allocate_extent(fs, last, wanted - have, &allocated);
+        if (first < 2) { result = FS_ERR_NO_SPACE; break; }
+        have += allocated;
+        last = first + allocated - 1;
+    }
+    kmutex_unlock(&fs->lock);
+    return result;
+}
+
+/** @brief fat_fallocate_serialized() under the context's io_lock, which other handles may share. */
+int fat_fallocate_internal(file_t *file, off_t length)
+{
+    if (!file || !file->vnode || !file->vnode->data) return FS_ERR_INVALID_PARAM;
+    fat_file_context_t *fctx = (fat_file_context_t*)file->vnode->data;
+    kmutex_lock(&fctx->io_lock);
+    int result = fat_fallocate_serialized(file, length);
+    kmutex_unlock(&fctx->io_lock);
+    return result;
+}
+
+
+/* --- fsync --- */
+
+/**
+ * @brief Writes back @p run clusters from @p cluster, then the FAT sectors
+ * holding their entries in every FAT copy. Takes fs->lock.
+ */
+static int fat_sync_clusters(fat_fs_t *fs, uint32_t cluster, uint32_t run)
+{
+    int result = FS_SUCCESS;
+    uint32_t lba = fat_cluster_to_lba(fs, cluster);
+    if (lba == 0 || buffer_writeback_range(fs->disk_ptr, lba, run * fs->sectors_per_cluster) != 0) result = FS_ERR_IO;
+
+    size_t entry_size = (fs->type == FAT_TYPE_FAT16 ? 2 : (fs->type == FAT_TYPE_FAT32 ? 4 : 0));
+    if (entry_size == 0) return result; // FAT12 chains are never written
+    uint32_t first_sector = (uint32_t)(((size_t)cluster * entry_size) / fs->bytes_per_sector);
+    uint32_t last_sector = (uint32_t)(((size_t)(cluster + run - 1) * entry_size) / fs->bytes_per_sector);
+    uint32_t sectors = last_sector - first_sector + 1;
+
+    kmutex_lock(&fs->lock);
+    if (fat_flush_fat_range(fs, first_sector, sectors) != FS_SUCCESS) result = FS_ERR_IO;
+    kmutex_unlock(&fs->lock);
+
+    for (uint8_t copy = 0; copy < fs->num_fats; copy++) {
+        uint32_t copy_lba = fs->fat_start_lba + (uint32_t)copy * fs->fat_size_sectors + first_sector;
+        if (buffer_writeback_range(fs->disk_ptr, copy_lba, sectors) != 0) result = FS_ERR_IO;
+    }
+    return result;
+}
+
+/**
+ * @brief Makes the file durable without touching other files' dirty blocks:
+ * the clusters written since the last fsync, the FAT sectors that map them,
+ * the entry's sector and (fsync only) FSInfo, then one drive cache flush.
+ */
+int fat_fsync_internal(file_t *file, bool datasync)
+{
+    if (!file || !file->vnode || !file->vnode->data) return FS_ERR_INVALID_PARAM;
+    fat_file_context_t *fctx = (fat_file_context_t*)file->vnode->data;
+    KERNEL_ASSERT(fctx->fs != NULL, "FAT context missing FS pointer");
+    fat_fs_t *fs = fctx->fs;
+    disk_t *disk = fs->disk_ptr;
+
+    // Under the locks, buffered appends and the entry reach the cache and the
+    // blocks to write are picked; the writes happen unlocked, where they may sleep
+    kmutex_lock(&fctx->io_lock);
+    int result = fat_flush_write_buffer(fs, fctx);
+    kmutex_lock(&fs->lock);
+    if (result == FS_SUCCESS && fctx->dirty && !fctx->is_directory) result = fat_write_file_entry(fs, fctx);
+
+    uint32_t first = fctx->sync_first, end = fctx->sync_end;
+    if (fctx->is_directory) {
+        first = 0; // Entries anywhere in it may have been created or removed
+        end = UINT32_MAX;
+    }
+    fctx->sync_first = fctx->sync_end = 0;
+    uint32_t first_cluster = fctx->first_cluster;
+    bool entry_changed = fctx->entry_unsynced;
+    fctx->entry_unsynced = false;
+
+    uint32_t entry_lba = 0, fsinfo_lba = 0;
+    if (!fctx->is_directory && (entry_changed || !datasync)) {
+        int lba_res = fat_dir_entry_lba(fs, fctx->dir_entry_cluster, fctx->dir_entry_offset, &entry_lba);
+        if (lba_res != FS_SUCCESS) {
+            entry_lba = 0;
+            if (result == FS_SUCCESS) result = lba_res;
+        }
+    }
+    if (!datasync && fat_write_fsinfo(fs) == FS_SUCCESS) fsinfo_lba = fs->fs_info_sector;
+    kmutex_unlock(&fs->lock);
+    kmutex_unlock(&fctx->io_lock);
+
+    if (fctx->is_directory && first_cluster == 0 && fs->type != FAT_TYPE_FAT32) {
+        // The FAT12/16 root directory is a fixed region, not a chain
+        if (buffer_writeback_range(disk, fs->root_dir_start_lba, fs->root_dir_sectors) != 0) result = FS_ERR_IO;
+    } else if (first_cluster >= 2 && first < end) {
+        // One cluster early: the link into the first cluster written may be new
+        uint32_t index = first ? first - 1 : 0;
+        while (index < end) {
+            uint32_t cluster, reached, last;
+            if (fat_map_file_cluster(fs, fctx, index, &cluster, &reached) != FS_SUCCESS) { result = FS_ERR_IO; break; }
+            if (reached < index) break; // The chain is shorter now (truncated since the write)
+            uint32_t max = MIN(end - index, BUFFER_BULK_MAX_SECTORS / fs->sectors_per_cluster);
+            uint32_t run = fat_map_file_run(fs, fctx, index, max);
+            if (run == 0) run = fat_contiguous_run(fs, cluster, max, &last);
+            if (fat_sync_clusters(fs, cluster, run) != FS_SUCCESS) result = FS_ERR_IO;
+            index += run;
+        }
+    }
+    if (entry_lba && buffer_writeback_range(disk, entry_lba, 1) != 0) result = FS_ERR_IO;
+    if (fsinfo_lba && buffer_writeback_range(disk, fsinfo_lba, 1) != 0) result = FS_ERR_IO;
+    if (disk_flush(disk) != FS_SUCCESS) result = FS_ERR_IO;
+
+    if (result != FS_SUCCESS && !fctx->is_directory) {
+        // Keep what may not have reached the disk for the next fsync
+        kmutex_lock(&fs->lock);
+        if (first < end) fat_sync_range_add(fctx, first, end);
+        if (entry_changed) fctx->entry_unsynced = true;
+        kmutex_unlock(&fs->lock);
+    }
+    return result;
+}
+
+
 /**
  * @brief Sets the file offset for the next read or write operation.
  */
@@ -601,9 +1138,9 @@ off_t fat_lseek_internal(file_t *file, off_t offset, int whence) {
     fat_file_context_t *fctx = (fat_file_context_t*)file->vnode->data;
     KERNEL_ASSERT(fctx->fs != NULL, "FAT context missing FS pointer");
 
-    uintptr_t irq_flags = spinlock_acquire_irqsave(&fctx->fs->lock);
+    kmutex_lock(&fctx->fs->lock);
     off_t file_size = (off_t)fctx->file_size; // Read under lock
-    spinlock_release_irqrestore(&fctx->fs->lock, irq_flags);
+    kmutex_unlock(&fctx->fs->lock);
 
     off_t current_offset = file->offset; // Current offset from file_t, not fctx
     off_t new_offset;
@@ -642,6 +1179,47 @@ off_t fat_lseek_internal(file_t *file, off_t offset, int whence) {
     return new_offset;
 }
 
+int fat_identify_internal(file_t *file, vfs_file_id_t *id_out) {
+    if (!file || !file->vnode || !file->vnode->data || !id_out) { return FS_ERR_BAD_F; }
+    fat_file_context_t *fctx = (fat_file_context_t*)file->vnode->data;
+    KERNEL_ASSERT(fctx->fs != NULL, "FAT context missing FS pointer");
+
+    kmutex_lock(&fctx->fs->lock);
+    uint32_t first_cluster = fctx->first_cluster;
+    uint32_t file_size = fctx->file_size;
+    bool is_directory = fctx->is_directory;
+    kmutex_unlock(&fctx->fs->lock);
+
+    if (is_directory || first_cluster < 2) { return FS_ERR_NOT_SUPPORTED; }
+    id_out->fs = fctx->fs; // Same pointer fat_mount_internal() handed to the VFS
+    id_out->ino = first_cluster;
+    id_out->size = file_size;
+    return FS_SUCCESS;
+}
+
+int fat_fstat_internal(file_t *file, struct vfs_stat *st) {
+    if (!file || !file->vnode || !file->vnode->data || !st) { return FS_ERR_BAD_F; }
+    fat_file_context_t *fctx = (fat_file_context_t*)file->vnode->data;
+    KERNEL_ASSERT(fctx->fs != NULL, "FAT context missing FS pointer");
+
+    fat_dir_entry_t entry;
+    memset(&entry, 0, sizeof(entry));
+    kmutex_lock(&fctx->fs->lock);
+    entry.attr = fctx->attr;
+    entry.file_size = fctx->file_size;
+    entry.first_cluster_low = (uint16_t)(fctx->first_cluster & 0xFFFF);
+    entry.first_cluster_high = (uint16_t)(fctx->first_cluster >> 16);
+    entry.write_time = fctx->write_time;
+    entry.write_date = fctx->write_date;
+    entry.creation_time = fctx->creation_time;
+    entry.creation_date = fctx->creation_date;
+    kmutex_unlock(&fctx->fs->lock);
+
+    if (fctx->is_directory) entry.attr |= FAT_ATTR_DIRECTORY;
+    fat_entry_to_stat(fctx->fs, &entry, st);
+    return FS_SUCCESS;
+}
+
 
 /**
  * @brief Immediately updates the first cluster field of a directory entry on disk.
@@ -718,7 +1296,7 @@ int update_directory_entry_first_cluster_now(fat_fs_t *fs, fat_file_context_t *f
 
     // Now, get the buffer for the target LBA, modify, mark dirty, and release.
     // serial_printf("[FAT_IO_Update] Modifying directory sector at LBA %lu\n", (unsigned long)target_lba);
-    buffer_t* b = buffer_get(fs->disk_ptr->blk_dev.device_name, target_lba);
+    buffer_t* b = buffer_get(fs->disk_ptr, target_lba);
     if (!b) {
         serial_printf("[FAT_IO_ERR] DirEntry Update: Failed to get buffer for LBA %lu\n", (unsigned long)target_lba);
         return FS_ERR_IO;
@@ -730,9 +1308,11 @@ int update_directory_entry_first_cluster_now(fat_fs_t *fs, fat_file_context_t *f
     entry_in_buffer->first_cluster_high = (uint16_t)((fctx->first_cluster >> 16) & 0xFFFF);
     // Timestamps (like modification time) should also be updated here or in a combined function.
     // For now, only cluster is updated as per function name.
+    fat_dcache_update(fs, fctx->dir_entry_cluster, fctx->dir_entry_offset, entry_in_buffer);
 
     buffer_mark_dirty(b);
     buffer_release(b); // This will eventually write it to disk.
+    fctx->entry_unsynced = true;
 
     // serial_printf("[FAT_IO_Update] DirEntry FirstCluster successfully updated on disk (via cache) for LBA %lu.\n", (unsigned long)target_lba);
     return FS_SUCCESS;
@@ -794,7 +1374,7 @@ int update_directory_entry_size_now(fat_fs_t *fs, fat_file_context_t *fctx) {
 
     // Read-Modify-Write the directory sector via buffer cache
     // serial_printf("[FAT_IO_Update] Modifying directory sector for size at LBA %lu\n", (unsigned long)target_lba);
-    buffer_t* b = buffer_get(fs->disk_ptr->blk_dev.device_name, target_lba);
+    buffer_t* b = buffer_get(fs->disk_ptr, target_lba);
     if (!b) {
         serial_printf("[FAT_IO_ERR] DirEntry Update: Failed to get buffer for LBA %lu (size update)\n", (unsigned long)target_lba);
         return FS_ERR_IO;
@@ -802,10 +1382,12 @@ int update_directory_entry_size_now(fat_fs_t *fs, fat_file_context_t *fctx) {
 
     fat_dir_entry_t* entry_in_buffer = (fat_dir_entry_t*)(b->data + offset_in_dir_sector);
     entry_in_buffer->file_size = fctx->file_size;
+    fat_dcache_update(fs, fctx->dir_entry_cluster, fctx->dir_entry_offset, entry_in_buffer);
     // TODO: Update modification timestamps here as well.
 
     buffer_mark_dirty(b);
     buffer_release(b);
+    fctx->entry_unsynced = true;
 
     // serial_printf("[FAT_IO_Update] DirEntry FileSize successfully updated on disk (via cache) for LBA %lu.\n", (unsigned long)target_lba);
     return FS_SUCCESS;
@@ -11,12 +11,15 @@
 #include <kernel/fs/fat/fat_core.h>   // For fat_fs_t definition, logging macros if defined here
 #include <kernel/fs/fat/fat_fs.h>     // For fat_dir_entry_t, FAT_DIR_ENTRY_UNUSED/DELETED macros etc.
 #include <kernel/fs/fat/fat_dir.h>    // NEEDED for read_directory_sector declaration
+#include <kernel/fs/fat/fat_alloc.h>  // fat_free_map_update
+#include <kernel/fs/fat/fat_dirindex.h> // Indexed short-name checks
 #include <kernel/lib/string.h>     // For strlen, strcmp, memset, memcpy, strchr, strrchr
 #include <libc/ctype.h> // For toupper
 #include <libc/stdio.h> // For sprintf/snprintf (if used by itoa)
 #include <kernel/fs/vfs/fs_errno.h>   // Filesystem error codes
 #include <kernel/drivers/display/terminal.h>   // Logging (terminal_printf)
 #include <kernel/lib/assert.h>     // KERNEL_ASSERT
+#include <kernel/lib/klog.h>       // klog_debug (FAT_DEBUG_LOG)
 #include <kernel/memory/kmalloc.h>    // For kmalloc/kfree used in helpers
 #include <libc/stdbool.h> // For bool
 #include <libc/stdint.h>  // For uint*_t
@@ -30,7 +33,7 @@
 #endif
 
 #if FAT_DEBUG_LEVEL >= 1
-#define FAT_DEBUG_LOG(fmt, ...) serial_printf("[fat_utils:DEBUG] (%s) " fmt "\n", __func__, ##__VA_ARGS__)
+#define FAT_DEBUG_LOG(fmt, ...) klog_debug("[fat_utils:DEBUG] (%s) " fmt "\n", __func__, ##__VA_ARGS__)
 #else
 #define FAT_DEBUG_LOG(fmt, ...) do {} while(0)
 #endif
@@ -68,11 +71,52 @@ uint32_t fat_cluster_to_lba(fat_fs_t *fs, uint32_t cluster) {
     return (uint32_t)lba;
 }
 
+/**
+ * @brief Locates the FAT entry of @p cluster: in the resident table, or, for
+ * a paged FAT, in its FAT 1 sector, which is read into the pinned window
+ * (replacing the sector in the same slot) if it is not there already.
+ * @param buf_out Receives the window buffer holding the entry (NULL if resident).
+ * @return Pointer to the entry, or NULL if its sector could not be read.
+ */
+static void *fat_entry_location(fat_fs_t *fs, uint32_t cluster, size_t entry_size, buffer_t **buf_out)
+{
+    size_t offset = (size_t)cluster * entry_size;
+    *buf_out = NULL;
+    if (!fs->fat_paged) return (uint8_t*)fs->fat_table + offset;
+
+    uint32_t sector = (uint32_t)(offset / fs->bytes_per_sector);
+    uint32_t lba = fs->fat_start_lba + sector;
+    buffer_t **slot = &fs->fat_window[sector % FAT_WINDOW_SLOTS];
+    if (!*slot || (*slot)->block_number != lba) {
+        buffer_t *buf = buffer_get(fs->disk_ptr, lba); // FAT sectors lie before the data region: one sector per buffer
+        if (!buf) {
+            FAT_ERROR_LOG("Failed to read FAT sector %lu (LBA %lu).", (unsigned long)sector, (unsigned long)lba);
+            return NULL;
+        }
+        if (*slot) buffer_release(*slot);
+        *slot = buf;
+    }
+    *buf_out = *slot;
+    return (*slot)->data + (offset % fs->bytes_per_sector);
+}
+
+/**
+ * @brief Releases the FAT sectors pinned by a paged FAT.
+ */
+void fat_window_release(fat_fs_t *fs) {
+    for (int i = 0; i < FAT_WINDOW_SLOTS; i++) {
+        if (fs->fat_window[i]) {
+            buffer_release(fs->fat_window[i]);
+            fs->fat_window[i] = NULL;
+        }
+    }
+}
+
 /**
  * @brief Retrieves the next cluster in the chain from the FAT table.
  */
 int fat_get_next_cluster(fat_fs_t *fs, uint32_t current_cluster, uint32_t *next_cluster) {
-    KERNEL_ASSERT(fs != NULL && fs->fat_table != NULL && next_cluster != NULL, "Invalid arguments to fat_get_next_cluster");
+    KERNEL_ASSERT(fs != NULL && (fs->fat_table != NULL || fs->fat_paged) && next_cluster != NULL, "Invalid arguments to fat_get_next_cluster");
 
     // Calculate max valid cluster index based on FAT size and type
     size_t fat_size_bytes = (size_t)fs->fat_size_sectors * fs->bytes_per_sector;
@@ -97,12 +141,13 @@ int fat_get_next_cluster(fat_fs_t *fs, uint32_t current_cluster, uint32_t *next_
     }
 
     // Read the entry based on FAT type
+    buffer_t *window_buf;
+    void *entry = fat_entry_location(fs, current_cluster, entry_size, &window_buf);
+    if (!entry) return FS_ERR_IO;
     if (fs->type == FAT_TYPE_FAT32) {
-        uint32_t *FAT32 = (uint32_t*)fs->fat_table;
-        *next_cluster = FAT32[current_cluster] & 0x0FFFFFFF; // Mask out reserved bits
+        *next_cluster = *(uint32_t*)entry & 0x0FFFFFFF; // Mask out reserved bits
     } else { // FAT_TYPE_FAT16
-        uint16_t *FAT16 = (uint16_t*)fs->fat_table;
-        *next_cluster = FAT16[current_cluster];
+        *next_cluster = *(uint16_t*)entry;
     }
     return FS_SUCCESS;
 }
@@ -112,9 +157,8 @@ int fat_get_next_cluster(fat_fs_t *fs, uint32_t current_cluster, uint32_t *next_
  */
 int fat_get_cluster_entry(fat_fs_t *fs, uint32_t cluster, uint32_t *entry_value) {
     KERNEL_ASSERT(fs != NULL && entry_value != NULL, "NULL fs or entry_value pointer");
-    KERNEL_ASSERT(fs->fat_table != NULL, "FAT table not loaded");
+    KERNEL_ASSERT(fs->fat_table != NULL || fs->fat_paged, "FAT table not loaded");
 
-    size_t fat_offset;
     size_t fat_size_bytes = (size_t)fs->fat_size_sectors * fs->bytes_per_sector;
     size_t entry_size = (fs->type == FAT_TYPE_FAT16 ? 2 : (fs->type == FAT_TYPE_FAT32 ? 4 : 0));
     if (entry_size == 0) {
@@ -130,14 +174,15 @@ int fat_get_cluster_entry(fat_fs_t *fs, uint32_t cluster, uint32_t *entry_value)
         return FS_ERR_INVALID_PARAM;
     }
 
+    buffer_t *window_buf;
+    void *entry = fat_entry_location(fs, cluster, entry_size, &window_buf);
+    if (!entry) return FS_ERR_IO;
     switch (fs->type) {
         case FAT_TYPE_FAT16:
-            fat_offset = cluster * 2;
-            *entry_value = (uint32_t)(*(uint16_t*)((uint8_t*)fs->fat_table + fat_offset));
+            *entry_value = (uint32_t)(*(uint16_t*)entry);
             break;
         case FAT_TYPE_FAT32:
-            fat_offset = cluster * 4;
-            *entry_value = (*(uint32_t*)((uint8_t*)fs->fat_table + fat_offset)) & 0x0FFFFFFF; // Mask reserved bits
+            *entry_value = (*(uint32_t*)entry) & 0x0FFFFFFF; // Mask reserved bits
             break;
         default: // Includes FAT12
             FAT_ERROR_LOG("Unsupported FAT type %d in get_cluster_entry", fs->type);
@@ -150,7 +195,7 @@ int fat_get_cluster_entry(fat_fs_t *fs, uint32_t cluster, uint32_t *entry_value)
  * @brief Updates the FAT entry for a given cluster with a new value.
  */
 int fat_set_cluster_entry(fat_fs_t *fs, uint32_t cluster, uint32_t value) {
-    KERNEL_ASSERT(fs != NULL && fs->fat_table != NULL, "Invalid arguments to fat_set_cluster_entry");
+    KERNEL_ASSERT(fs != NULL && (fs->fat_table != NULL || fs->fat_paged), "Invalid arguments to fat_set_cluster_entry");
 
     size_t fat_size_bytes = (size_t)fs->fat_size_sectors * fs->bytes_per_sector;
     size_t entry_size = (fs->type == FAT_TYPE_FAT16 ? 2 : (fs->type == FAT_TYPE_FAT32 ? 4 : 0));
@@ -168,20 +213,89 @@ int fat_set_cluster_entry(fat_fs_t *fs, uint32_t cluster, uint32_t value) {
         return FS_ERR_INVALID_PARAM;
     }
 
-    // Modify the in-memory FAT table
+    // Modify the in-memory FAT table (paged: FAT 1's cached sector, written back by the cache)
+    buffer_t *window_buf;
+    void *entry = fat_entry_location(fs, cluster, entry_size, &window_buf);
+    if (!entry) return FS_ERR_IO;
+    bool was_free, now_free;
     if (fs->type == FAT_TYPE_FAT32) {
-        uint32_t *FAT32 = (uint32_t*)fs->fat_table;
+        uint32_t *FAT32 = (uint32_t*)entry;
+        was_free = (*FAT32 & 0x0FFFFFFF) == 0;
+        now_free = (value & 0x0FFFFFFF) == 0;
         // Preserve reserved bits (top 4 bits) when writing
-        FAT32[cluster] = (FAT32[cluster] & 0xF0000000) | (value & 0x0FFFFFFF);
+        *FAT32 = (*FAT32 & 0xF0000000) | (value & 0x0FFFFFFF);
     } else { // FAT_TYPE_FAT16
-        uint16_t *FAT16 = (uint16_t*)fs->fat_table;
-        FAT16[cluster] = (uint16_t)value;
+        uint16_t *FAT16 = (uint16_t*)entry;
+        was_free = *FAT16 == 0;
+        now_free = (uint16_t)value == 0;
+        *FAT16 = (uint16_t)value;
     }
+    if (window_buf) buffer_mark_dirty(window_buf);
+    if (was_free != now_free) fat_free_map_update(fs, cluster, now_free);
 
     fs->fat_dirty = true; // Mark FAT as modified, needs flushing later
+    if (fs->fat_dirty_sectors) {
+        uint32_t sector = (uint32_t)(((size_t)cluster * entry_size) / fs->bytes_per_sector);
+        fs->fat_dirty_sectors[sector / 32] |= 1u << (sector % 32);
+    }
     return FS_SUCCESS;
 }
 
+/**
+ * @brief Frees the FAT entries of a cluster range, one FAT sector at a time.
+ */
+int fat_clear_cluster_range(fat_fs_t *fs, uint32_t first, uint32_t count) {
+    KERNEL_ASSERT(fs != NULL && (fs->fat_table != NULL || fs->fat_paged), "Invalid arguments to fat_clear_cluster_range");
+    if (count == 0) return FS_SUCCESS;
+
+    size_t fat_size_bytes = (size_t)fs->fat_size_sectors * fs->bytes_per_sector;
+    size_t entry_size = (fs->type == FAT_TYPE_FAT16 ? 2 : (fs->type == FAT_TYPE_FAT32 ? 4 : 0));
+    if (entry_size == 0) {
+        FAT_ERROR_LOG("FAT12 clear_cluster_range not implemented.");
+        return FS_ERR_NOT_SUPPORTED;
+    }
+    uint32_t max_cluster_index = (fat_size_bytes / entry_size) - 1;
+    if (first < 2 || first > max_cluster_index || count - 1 > max_cluster_index - first) {
+        FAT_ERROR_LOG("Cluster range %lu+%lu out of valid range (2-%lu) for clear_cluster_range.",
+                      (unsigned long)first, (unsigned long)count, (unsigned long)max_cluster_index);
+        return FS_ERR_INVALID_PARAM;
+    }
+
+    uint32_t entries_per_sector = fs->bytes_per_sector / entry_size;
+    uint32_t cluster = first, end = first + count, was_used = 0;
+    int result = FS_SUCCESS;
+    while (cluster < end) {
+        // Entries from cluster to the end of its FAT sector (or of the range)
+        uint32_t sector = cluster / entries_per_sector;
+        uint32_t n = (sector + 1) * entries_per_sector - cluster;
+        if (n > end - cluster) n = end - cluster;
+
+        buffer_t *window_buf;
+        void *entry = fat_entry_location(fs, cluster, entry_size, &window_buf);
+        if (!entry) { result = FS_ERR_IO; break; }
+        if (fs->type == FAT_TYPE_FAT32) {
+            uint32_t *FAT32 = (uint32_t*)entry;
+            for (uint32_t i = 0; i < n; i++) {
+                if (FAT32[i] & 0x0FFFFFFF) was_used++;
+                FAT32[i] &= 0xF0000000; // Preserve reserved bits (top 4 bits)
+            }
+        } else { // FAT_TYPE_FAT16
+            uint16_t *FAT16 = (uint16_t*)entry;
+            for (uint32_t i = 0; i < n; i++) {
+                if (FAT16[i]) was_used++;
+            }
+            memset(FAT16, 0, n * sizeof(uint16_t));
+        }
+        if (window_buf) buffer_mark_dirty(window_buf);
+        if (fs->fat_dirty_sectors) fs->fat_dirty_sectors[sector / 32] |= 1u << (sector % 32);
+        cluster += n;
+    }
+
+    fat_free_map_free_range(fs, first, cluster - first, was_used);
+    if (cluster > first) fs->fat_dirty = true; // Mark FAT as modified, needs flushing later
+    return result;
+}
+
 /* --- Filename Formatting and Comparison --- */
 
 /**
@@ -262,22 +376,24 @@ int fat_compare_8_3(const char* component, const uint8_t name_8_3[11]) {
 /* --- Short Name Generation & Collision Check --- */
 
 /**
- * @brief Checks if a directory entry with the exact raw 11-byte short name exists.
+ * @brief Calls fn on every live 8.3 name in a directory (the names a new
+ * entry must not collide with) until fn returns true.
+ * @return FS_SUCCESS, or the I/O error that cut the walk short.
  */
-bool fat_raw_short_name_exists(fat_fs_t *fs, uint32_t dir_cluster, const uint8_t short_name_raw[11]) {
-    KERNEL_ASSERT(fs != NULL && short_name_raw != NULL, "NULL fs or name pointer");
-    // Assumes caller holds fs->lock if concurrent modification is possible
+static int fat_for_each_short_name(fat_fs_t *fs, uint32_t dir_cluster,
+                                   bool (*fn)(const uint8_t sfn[11], void *ctx), void *ctx)
+{
+    if (fat_dirindex_for_each_short_name(fs, dir_cluster, fn, ctx)) return FS_SUCCESS;
 
     uint32_t current_cluster = dir_cluster;
     bool scanning_fixed_root = (fs->type != FAT_TYPE_FAT32 && dir_cluster == 0);
     uint32_t current_byte_offset = 0;
-    bool found = false;
     int io_error = FS_SUCCESS;
 
     uint8_t *sector_data = kmalloc(fs->bytes_per_sector);
     if (!sector_data) {
         FAT_ERROR_LOG("Failed to allocate sector buffer.");
-        return true; // Fail safe: Assume it exists if we can't check.
+        return FS_ERR_OUT_OF_MEMORY;
     }
 
     while (true) {
@@ -292,15 +408,12 @@ bool fat_raw_short_name_exists(fat_fs_t *fs, uint32_t dir_cluster, const uint8_t
 
         for (size_t e_idx = 0; e_idx < entries_per_sector; e_idx++) {
             fat_dir_entry_t *de = (fat_dir_entry_t*)(sector_data + e_idx * sizeof(fat_dir_entry_t));
-            if (de->name[0] == FAT_DIR_ENTRY_UNUSED) { goto check_done; }
+            if (de->name[0] == FAT_DIR_ENTRY_UNUSED) { goto scan_done; }
             if (de->name[0] == FAT_DIR_ENTRY_DELETED) continue;
             if ((de->attr & FAT_ATTR_VOLUME_ID) && !(de->attr & FAT_ATTR_LONG_NAME)) continue;
             if ((de->attr & FAT_ATTR_LONG_NAME_MASK) == FAT_ATTR_LONG_NAME) continue;
 
-            if (memcmp(de->name, short_name_raw, 11) == 0) {
-                found = true;
-                goto check_done;
-            }
+            if (fn(de->name, ctx)) goto scan_done;
         }
 
         current_byte_offset += fs->bytes_per_sector;
@@ -314,13 +427,106 @@ bool fat_raw_short_name_exists(fat_fs_t *fs, uint32_t dir_cluster, const uint8_t
         }
     }
 
-check_done:
+scan_done:
     kfree(sector_data);
+    return io_error;
+}
+
+typedef struct {
+    const uint8_t *name;
+    bool           found;
+} fat_sfn_match_t;
+
+static bool fat_sfn_match(const uint8_t sfn[11], void *ctx)
+{
+    fat_sfn_match_t *m = ctx;
+    if (memcmp(sfn, m->name, 11) != 0) return false;
+    m->found = true;
+    return true;
+}
+
+/**
+ * @brief Checks if a directory entry with the exact raw 11-byte short name exists.
+ */
+bool fat_raw_short_name_exists(fat_fs_t *fs, uint32_t dir_cluster, const uint8_t short_name_raw[11]) {
+    KERNEL_ASSERT(fs != NULL && short_name_raw != NULL, "NULL fs or name pointer");
+    // Assumes caller holds fs->lock if concurrent modification is possible
+
+    bool indexed_exists;
+    if (fat_dirindex_short_name_exists(fs, dir_cluster, short_name_raw, &indexed_exists)) {
+        return indexed_exists;
+    }
+
+    fat_sfn_match_t match = { short_name_raw, false };
+    int io_error = fat_for_each_short_name(fs, dir_cluster, fat_sfn_match, &match);
     if (io_error != FS_SUCCESS) {
         FAT_ERROR_LOG("I/O error %d during short name check.", io_error);
-        return true; // Fail safe
+        return true; // Fail safe: Assume it exists if we can't check.
     }
-    return found;
+    return match.found;
+}
+
+#define FAT_SFN_MAX_TAIL     999999  // Largest N in NAME~N.EXT
+#define FAT_SFN_TAIL_BITMAP  1024    // Tails 1..1023 tracked one by one; beyond, only the largest
+
+// The ~N tails already taken for one BASE.EXT, gathered in a single directory pass
+typedef struct {
+    uint8_t  base[8], ext[3];
+    bool     base_taken;                     // BASE.EXT itself exists
+    uint8_t  used[FAT_SFN_TAIL_BITMAP / 8];
+    uint32_t max_tail;
+} fat_sfn_tails_t;
+
+/**
+ * @brief Builds BASE~N.EXT exactly as the generator always has: the base cut
+ * to 8 - len("~N") characters (at least 1), then the tail, then the extension.
+ */
+static int fat_sfn_with_tail(const uint8_t base[8], const uint8_t ext[3], int n, uint8_t candidate[11])
+{
+    char num_suffix[8]; // ~ + 6 digits + null
+    num_suffix[0] = '~';
+    int num_len = _itoa_simple(n, num_suffix + 1, sizeof(num_suffix) - 1);
+    if (num_len < 0) {
+        FAT_ERROR_LOG("Failed to convert suffix number %d to string.", n);
+        return FS_ERR_INTERNAL; // Should not happen
+    }
+    int suffix_len = 1 + num_len; // Length including '~'
+
+    // Determine how many base characters to keep
+    int base_chars_to_keep = 8 - suffix_len;
+    if (base_chars_to_keep < 1) base_chars_to_keep = 1; // Keep at least 1 char
+
+    memcpy(candidate, base, base_chars_to_keep); // Copy truncated base
+    memcpy(candidate + base_chars_to_keep, num_suffix, suffix_len); // Copy suffix
+    // Pad remaining base name part with spaces if needed
+    for (int k = base_chars_to_keep + suffix_len; k < 8; ++k) {
+        candidate[k] = ' ';
+    }
+    memcpy(candidate + 8, ext, 3); // Copy original extension
+    return FS_SUCCESS;
+}
+
+/** @brief Records sfn in the tail set if it is a BASE.EXT or BASE~N.EXT the generator could have made. */
+static bool fat_sfn_note_tail(const uint8_t sfn[11], void *ctx)
+{
+    fat_sfn_tails_t *t = ctx;
+    if (memcmp(sfn + 8, t->ext, 3) != 0) return false;
+    if (memcmp(sfn, t->base, 8) == 0) {
+        t->base_taken = true;
+        return false;
+    }
+
+    // Generated tails fill the name to its last character: "~" then digits, no leading zero
+    int tilde = 7;
+    while (tilde > 0 && sfn[tilde] >= '0' && sfn[tilde] <= '9') tilde--;
+    if (tilde < 1 || tilde == 7 || sfn[tilde] != '~' || sfn[tilde + 1] == '0') return false;
+    if (memcmp(sfn, t->base, tilde) != 0) return false;
+
+    uint32_t n = 0;
+    for (int k = tilde + 1; k < 8; k++) n = n * 10 + (uint32_t)(sfn[k] - '0');
+    if (n < FAT_SFN_TAIL_BITMAP) t->used[n / 8] |= (uint8_t)(1u << (n % 8));
+    if (n > t->max_tail) t->max_tail = n;
+    return false;
 }
 
 /**
@@ -367,41 +573,44 @@ int fat_generate_short_name(fat_fs_t   *fs,
     }
     // Pad remaining ext with spaces if needed (already done by init)
 
-    // 3. Try BASE    .EXT first
+    // 3. One pass over the directory finds which of BASE.EXT and BASE~N.EXT are taken
+    fat_sfn_tails_t tails;
+    memset(&tails, 0, sizeof(tails));
+    memcpy(tails.base, base, 8);
+    memcpy(tails.ext, ext, 3);
+    int scan_res = fat_for_each_short_name(fs, parent_dir_cluster, fat_sfn_note_tail, &tails);
+    if (scan_res != FS_SUCCESS) {
+        FAT_ERROR_LOG("I/O error %d while collecting short names.", scan_res);
+        return scan_res;
+    }
+
     uint8_t candidate[11];
-    memcpy(candidate, base, 8);
-    memcpy(candidate + 8, ext, 3);
-    if (!fat_raw_short_name_exists(fs, parent_dir_cluster, candidate)) {
+    if (!tails.base_taken) {
+        memcpy(candidate, base, 8);
+        memcpy(candidate + 8, ext, 3);
         memcpy(short_name_out, candidate, 11);
         FAT_DEBUG_LOG("Generated unique 8.3: '%.11s' (no suffix needed)", candidate);
         return FS_SUCCESS;
     }
 
-    // 4. Try BASE~N.EXT variations (1 <= N <= 999999)
-    char num_suffix[8]; // ~ + 6 digits + null
-    for (int n = 1; n <= 999999; ++n) {
-        num_suffix[0] = '~';
-        int num_len = _itoa_simple(n, num_suffix + 1, sizeof(num_suffix) - 1);
-        if (num_len < 0) {
-            FAT_ERROR_LOG("Failed to convert suffix number %d to string.", n);
-            return FS_ERR_INTERNAL; // Should not happen
-        }
-        int suffix_len = 1 + num_len; // Length including '~'
-
-        // Determine how many base characters to keep
-        int base_chars_to_keep = 8 - suffix_len;
-        if (base_chars_to_keep < 1) base_chars_to_keep = 1; // Keep at least 1 char
-
-        // Construct the trial name
-        memcpy(candidate, base, base_chars_to_keep); // Copy truncated base
-        memcpy(candidate + base_chars_to_keep, num_suffix, suffix_len); // Copy suffix
-        // Pad remaining base name part with spaces if needed
-        for (int k = base_chars_to_keep + suffix_len; k < 8; ++k) {
-            candidate[k] = ' ';
-        }
-        memcpy(candidate + 8, ext, 3); // Copy original extension
+    // 4. Lowest free ~N below the bitmap's end, else one past the largest taken
+    int n = 0;
+    for (int k = 1; k < FAT_SFN_TAIL_BITMAP; ++k) {
+        if (!(tails.used[k / 8] & (1u << (k % 8)))) { n = k; break; }
+    }
+    if (n == 0 && tails.max_tail < FAT_SFN_MAX_TAIL) n = (int)tails.max_tail + 1;
+    if (n != 0) {
+        int res = fat_sfn_with_tail(tails.base, tails.ext, n, candidate);
+        if (res != FS_SUCCESS) return res;
+        memcpy(short_name_out, candidate, 11);
+        FAT_DEBUG_LOG("Generated unique 8.3: '%.11s' (using suffix ~%d)", candidate, n);
+        return FS_SUCCESS;
+    }
 
-        // Check uniqueness
+    // 5. ~FAT_SFN_MAX_TAIL is taken as well: look for a hole above the bitmap one name at a time
+    for (n = FAT_SFN_TAIL_BITMAP; n < FAT_SFN_MAX_TAIL; ++n) {
+        int res = fat_sfn_with_tail(tails.base, tails.ext, n, candidate);
+        if (res != FS_SUCCESS) return res;
         if (!fat_raw_short_name_exists(fs, parent_dir_cluster, candidate)) {
             memcpy(short_name_out, candidate, 11);
             FAT_DEBUG_LOG("Generated unique 8.3: '%.11s' (using suffix ~%d)", candidate, n);
@@ -409,7 +618,7 @@ int fat_generate_short_name(fat_fs_t   *fs,
         }
     }
 
-    FAT_ERROR_LOG("Could not generate unique short name for '%s' after %d attempts.", long_name, 999999);
+    FAT_ERROR_LOG("Could not generate unique short name for '%s' after %d attempts.", long_name, FAT_SFN_MAX_TAIL);
     return FS_ERR_NO_SPACE; // Or FS_ERR_FILE_EXISTS? NO_SPACE seems more appropriate
 }
 
@@ -450,6 +659,30 @@ void fat_get_current_timestamp(uint16_t *fat_time, uint16_t *fat_date) {
     FAT_DEBUG_LOG("Returning fixed timestamp: Date=0x%04x, Time=0x%04x", *fat_date, *fat_time);
 }
 
+/**
+ * @brief Converts a FAT date/time pair to seconds since the Unix epoch.
+ */
+uint32_t fat_timestamp_to_unix(uint16_t fat_time, uint16_t fat_date) {
+    if (fat_date == 0) return 0;
+    static const uint16_t days_before_month[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+
+    uint32_t year = 1980u + (fat_date >> 9);
+    uint32_t month = (fat_date >> 5) & 0x0F;
+    uint32_t day = fat_date & 0x1F;
+    if (month < 1 || month > 12) month = 1;
+    if (day < 1) day = 1;
+
+    // 1980 is 3652 days after the epoch; 2100 is the only non-leap fourth year in FAT's range
+    uint32_t years = year - 1980u;
+    bool leap = (year % 4u) == 0 && year != 2100u;
+    uint32_t days = 3652u + years * 365u + (years + 3u) / 4u - (year > 2100u ? 1u : 0u);
+    days += days_before_month[month - 1] + (day - 1);
+    if (month > 2 && leap) days++;
+
+    uint32_t seconds = (uint32_t)(fat_time >> 11) * 3600u + ((fat_time >> 5) & 0x3F) * 60u + (fat_time & 0x1F) * 2u;
+    return days * 86400u + seconds;
+}
+
 
 /* --- Static Helper Implementation for itoa --- */
 /**
@@ -0,0 +1,84 @@
+/**
+ * @file fat_vcache.c
+ * @brief Open-file context cache for FAT.
+ *
+ * A chained hash table per mounted volume. Directory entry offsets are
+ * relative to the cluster holding the entry, so (directory, offset) alone can
+ * name two entries of a multi-cluster directory; the 8.3 name, unique within
+ * a directory, completes the key.
+ */
+
+#include <kernel/fs/fat/fat_vcache.h>
+#include <kernel/fs/fat/fat_core.h>
+#include <kernel/memory/kmalloc.h>
+#include <kernel/lib/string.h>
+
+static uint32_t fat_vcache_bucket(uint32_t dir_cluster, uint32_t dir_offset)
+{
+    uint32_t h = dir_cluster * 2654435761u ^ (dir_offset / sizeof(fat_dir_entry_t));
+    return (h ^ (h >> 16)) % FAT_VCACHE_BUCKETS;
+}
+
+void fat_vcache_init(fat_fs_t *fs)
+{
+    fs->vcache = kmalloc(sizeof(fat_vcache_t));
+    if (fs->vcache) memset(fs->vcache, 0, sizeof(fat_vcache_t));
+}
+
+void fat_vcache_destroy(fat_fs_t *fs)
+{
+    kfree(fs->vcache);
+    fs->vcache = NULL;
+}
+
+fat_file_context_t *fat_vcache_lookup(fat_fs_t *fs, uint32_t dir_cluster, uint32_t dir_offset,
+                                      const uint8_t short_name[11], bool take_ref)
+{
+    fat_vcache_t *vc = fs->vcache;
+    if (!vc) return NULL;
+    fat_file_context_t *ctx = vc->buckets[fat_vcache_bucket(dir_cluster, dir_offset)];
+    for (; ctx; ctx = ctx->vcache_next) {
+        if (ctx->dir_entry_cluster == dir_cluster && ctx->dir_entry_offset == dir_offset &&
+            memcmp(ctx->short_name, short_name, 11) == 0) break;
+    }
+    if (!take_ref) return ctx;
+    if (ctx) {
+        ctx->refcount++;
+        vc->hits++;
+    } else {
+        vc->misses++;
+    }
+    return ctx;
+}
+
+void fat_vcache_insert(fat_fs_t *fs, fat_file_context_t *ctx)
+{
+    fat_vcache_t *vc = fs->vcache;
+    if (!vc) return;
+    fat_file_context_t **head = &vc->buckets[fat_vcache_bucket(ctx->dir_entry_cluster, ctx->dir_entry_offset)];
+    ctx->vcache_next = *head;
+    *head = ctx;
+    ctx->vcache_hashed = true;
+}
+
+void fat_vcache_forget(fat_fs_t *fs, fat_file_context_t *ctx)
+{
+    fat_vcache_t *vc = fs->vcache;
+    if (!vc || !ctx->vcache_hashed) return;
+    fat_file_context_t **link = &vc->buckets[fat_vcache_bucket(ctx->dir_entry_cluster, ctx->dir_entry_offset)];
+    while (*link && *link != ctx) link = &(*link)->vcache_next;
+    if (*link) *link = ctx->vcache_next;
+    ctx->vcache_next = NULL;
+    ctx->vcache_hashed = false;
+}
+
+bool fat_vcache_release(fat_fs_t *fs, fat_file_context_t *ctx)
+{
+    if (ctx->refcount > 1) {
+        ctx->refcount--;
+        return false;
+    }
+    ctx->refcount = 0;
+    fat_vcache_forget(fs, ctx);
+    return true;
+}
@@ -0,0 +1,448 @@
+/**
+ * @file initramfs.c
+ * @brief Read-only VFS driver for the boot initramfs.
+ *
+ * The archive is the portable "newc" cpio format (`cpio -o -H newc`): a
+ * 110-byte ASCII header per member, then its NUL-terminated name and its
+ * data, each padded to 4 bytes, up to the "TRAILER!!!" member. Mounting
+ * indexes the members once into an array sorted by path, so an open is a
+ * binary search and a read is a memcpy from the module; nothing is copied
+ * at mount time and no disk is touched.
+ */
+
+#include <kernel/fs/initramfs/initramfs.h>
+#include <kernel/fs/vfs/vfs.h>
+#include <kernel/fs/vfs/sys_file.h>    // O_* flags
+#include <kernel/fs/vfs/fs_errno.h>
+#include <kernel/memory/kmalloc.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/drivers/display/terminal.h>
+#include <kernel/lib/string.h>
+#include <libc/limits.h>               // INT_MAX, LONG_MAX
+
+#ifndef DT_DIR
+#define DT_DIR     4
+#endif
+#ifndef DT_REG
+#define DT_REG     8
+#endif
+
+#define CPIO_NEWC_MAGIC     "070701"
+#define CPIO_HEADER_SIZE    110
+#define CPIO_TRAILER        "TRAILER!!!"
+#define CPIO_MODE_TYPE_MASK 0170000
+#define CPIO_MODE_DIR       0040000
+#define CPIO_MODE_REG       0100000
+
+#define CPIO_ALIGN4(x)      (((x) + 3u) & ~(size_t)3u)
+
+typedef struct initramfs_fs initramfs_fs_t;
+
+/* One archive member; an open file's vnode->data points at it */
+typedef struct initramfs_entry {
+    initramfs_fs_t *fs;
+    const char     *path;      // Inside the image, NUL-terminated, no leading "./" or "/"
+    size_t          path_len;
+    const uint8_t  *data;      // Inside the image
+    uint32_t        size;
+    uint32_t        ino;
+    bool            is_dir;
+} initramfs_entry_t;
+
+struct initramfs_fs {
+    initramfs_entry_t  root;
+    initramfs_entry_t *entries;   // Sorted by path
+    uint32_t           count;
+    uint32_t           open_count;
+    spinlock_t         lock;      // open_count
+};
+
+/* The boot module, set by kernel.c before fs_init() */
+static const uint8_t *s_image = NULL;
+static size_t         s_image_size = 0;
+
+static vfs_driver_t initramfs_vfs_driver;
+
+void initramfs_set_image(const void *image, size_t size)
+{
+    s_image = (const uint8_t *)image;
+    s_image_size = size;
+}
+
+bool initramfs_present(void)
+{
+    return s_image != NULL && s_image_size >= CPIO_HEADER_SIZE;
+}
+
+/* --- Archive parsing --- */
+
+/** @brief Parses one 8-digit hex header field. */
+static bool cpio_hex(const uint8_t *field, uint32_t *out)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        uint8_t c = field[i];
+        uint32_t d;
+        if (c >= '0' && c <= '9') d = c - '0';
+        else if (c >= 'a' && c <= 'f') d = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') d = c - 'A' + 10;
+        else return false;
+        v = (v << 4) | d;
+    }
+    *out = v;
+    return true;
+}
+
+/**
+ * @brief Decodes the member at *pos and advances past it.
+ * @return 1 for a member, 0 at the trailer (or a clean end of image),
+ *         FS_ERR_CORRUPT if the header or its sizes do not fit the image.
+ */
+static int cpio_next(size_t *pos, const char **name_out, uint32_t *mode_out,
+                     const uint8_t **data_out, uint32_t *size_out)
+{
+    size_t off = *pos;
+    if (off + CPIO_HEADER_SIZE > s_image_size) return 0;
+    const uint8_t *hdr = s_image + off;
+    if (memcmp(hdr, CPIO_NEWC_MAGIC, 6) != 0) return FS_ERR_CORRUPT;
+
+    uint32_t mode, filesize, namesize;
+    if (!cpio_hex(hdr + 14, &mode) || !cpio_hex(hdr + 54, &filesize) || !cpio_hex(hdr + 94, &namesize)) {
+        return FS_ERR_CORRUPT;
+    }
+    size_t name_off = off + CPIO_HEADER_SIZE;
+    if (namesize == 0 || namesize > s_image_size - name_off) return FS_ERR_CORRUPT;
+    const char *name = (const char *)(s_image + name_off);
+    if (name[namesize - 1] != '\0') return FS_ERR_CORRUPT;
+
+    size_t data_off = CPIO_ALIGN4(name_off + namesize);
+    if (data_off > s_image_size || filesize > s_image_size - data_off) return FS_ERR_CORRUPT;
+    if (strcmp(name, CPIO_TRAILER) == 0) return 0;
+
+    *name_out = name;
+    *mode_out = mode;
+    *data_out = s_image + data_off;
+    *size_out = filesize;
+    *pos = CPIO_ALIGN4(data_off + filesize);
+    return 1;
+}
+
+/** @brief @p name without its leading "./" and "/" (empty for the archive root). */
+static const char *cpio_strip(const char *name)
+{
+    for (;;) {
+        if (name[0] == '/') name++;
+        else if (name[0] == '.' && name[1] == '/') name += 2;
+        else if (name[0] == '.' && name[1] == '\0') return name + 1;
+        else return name;
+    }
+}
+
+/** @brief strcmp() of an entry path against the @p len bytes at @p key. */
+static int initramfs_path_cmp(const char *path, const char *key, size_t len)
+{
+    int c = strncmp(path, key, len);
+    if (c != 0) return c;
+    return path[len] == '\0' ? 0 : 1;
+}
+
+static initramfs_entry_t *initramfs_lookup(initramfs_fs_t *fs, const char *path)
+{
+    while (*path == '/') path++;
+    size_t len = strlen(path);
+    while (len > 0 && path[len - 1] == '/') len--;
+    if (len == 0) return &fs->root;
+
+    uint32_t lo = 0, hi = fs->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int c = initramfs_path_cmp(fs->entries[mid].path, path, len);
+        if (c == 0) return &fs->entries[mid];
+        if (c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return NULL;
+}
+
+/* --- Mount --- */
+
+static void *initramfs_mount(const char *device)
+{
+    (void)device; // The image comes from the boot module, not a block device
+    if (!initramfs_present()) return NULL;
+
+    // Pass 1: count the members we keep
+    uint32_t count = 0;
+    size_t pos = 0;
+    const char *name;
+    uint32_t mode, size;
+    const uint8_t *data;
+    int r;
+    while ((r = cpio_next(&pos, &name, &mode, &data, &size)) > 0) {
+        uint32_t type = mode & CPIO_MODE_TYPE_MASK;
+        if ((type == CPIO_MODE_REG || type == CPIO_MODE_DIR) && cpio_strip(name)[0] != '\0') count++;
+    }
+    if (r < 0) {
+        terminal_printf("[initramfs] Error: Archive is corrupt at offset %lu.\n", (unsigned long)pos);
+        return NULL;
+    }
+
+    initramfs_fs_t *fs = kmalloc(sizeof(initramfs_fs_t));
+    if (!fs) return NULL;
+    memset(fs, 0, sizeof(*fs));
+    spinlock_init(&fs->lock);
+    fs->root.fs = fs;
+    fs->root.path = "";
+    fs->root.is_dir = true;
+    if (count) {
+        fs->entries = kmalloc(count * sizeof(initramfs_entry_t));
+        if (!fs->entries) {
+            kfree(fs);
+            return NULL;
+        }
+    }
+
+    // Pass 2: index them, kept sorted by insertion (boot archives are small)
+    pos = 0;
+    while (fs->count < count && cpio_next(&pos, &name, &mode, &data, &size) > 0) {
+        uint32_t type = mode & CPIO_MODE_TYPE_MASK;
+        const char *path = cpio_strip(name);
+        if ((type != CPIO_MODE_REG && type != CPIO_MODE_DIR) || path[0] == '\0') continue;
+
+        initramfs_entry_t e = {
+            .fs = fs, .path = path, .path_len = strlen(path),
+            .data = data, .size = size, .ino = fs->count + 1, .is_dir = (type == CPIO_MODE_DIR),
+        };
+        uint32_t i = fs->count++;
+        while (i > 0 && strcmp(fs->entries[i - 1].path, path) > 0) {
+            fs->entries[i] = fs->entries[i - 1];
+            i--;
+        }
+        fs->entries[i] = e;
+    }
+    terminal_printf("[initramfs] Indexed %lu entries (%lu bytes).\n", (unsigned long)fs->count, (unsigned long)s_image_size);
+    return fs;
+}
+
+static int initramfs_unmount(void *fs_context)
+{
+    initramfs_fs_t *fs = (initramfs_fs_t *)fs_context;
+    if (!fs) return FS_ERR_INVALID_PARAM;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&fs->lock);
+    bool busy = (fs->open_count != 0);
+    spinlock_release_irqrestore(&fs->lock, irq_flags);
+    if (busy) return FS_ERR_BUSY;
+
+    kfree(fs->entries);
+    kfree(fs);
+    return FS_SUCCESS;
+}
+
+/* --- Files --- */
+
+static vnode_t *initramfs_open(void *fs_context, const char *path, int flags)
+{
+    initramfs_fs_t *fs = (initramfs_fs_t *)fs_context;
+    if (!fs || !path) return NULL;
+    if ((flags & O_ACCMODE) != O_RDONLY || (flags & (O_TRUNC | O_APPEND))) return NULL; // Read-only
+
+    initramfs_entry_t *entry = initramfs_lookup(fs, path);
+    if (!entry) return NULL;
+    if ((flags & O_CREAT) && (flags & O_EXCL)) return NULL;
+
+    vnode_t *vnode = kmalloc(sizeof(vnode_t));
+    if (!vnode) return NULL;
+    vnode->data = entry;
+    vnode->fs_driver = &initramfs_vfs_driver;
+
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&fs->lock);
+    fs->open_count++;
+    spinlock_release_irqrestore(&fs->lock, irq_flags);
+    return vnode;
+}
+
+static int initramfs_close(file_t *file)
+{
+    if (!file || !file->vnode || !file->vnode->data) return FS_ERR_BAD_F;
+    initramfs_fs_t *fs = ((initramfs_entry_t *)file->vnode->data)->fs;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&fs->lock);
+    fs->open_count--;
+    spinlock_release_irqrestore(&fs->lock, irq_flags);
+    file->vnode->data = NULL;
+    return FS_SUCCESS;
+}
+
+static int initramfs_read(file_t *file, void *buf, size_t len)
+{
+    if (!file || !file->vnode || !file->vnode->data) return FS_ERR_BAD_F;
+    initramfs_entry_t *entry = (initramfs_entry_t *)file->vnode->data;
+    if (entry->is_dir) return FS_ERR_IS_A_DIRECTORY;
+    if (file->offset < 0) return FS_ERR_INVALID_PARAM;
+
+    uint32_t pos = (uint32_t)file->offset;
+    if (pos >= entry->size) return 0;
+    if (len > entry->size - pos) len = entry->size - pos;
+    if (len > (size_t)INT_MAX) len = (size_t)INT_MAX;
+    memcpy(buf, entry->data + pos, len); // The image never changes: no lock needed
+    return (int)len;
+}
+
+static int initramfs_write(file_t *file, const void *buf, size_t len)
+{
+    (void)file; (void)buf; (void)len;
+    return FS_ERR_READ_ONLY;
+}
+
+static off_t initramfs_lseek(file_t *file, off_t offset, int whence)
+{
+    if (!file || !file->vnode || !file->vnode->data) return (off_t)FS_ERR_BAD_F;
+    initramfs_entry_t *entry = (initramfs_entry_t *)file->vnode->data;
+
+    off_t base;
+    if (whence == SEEK_SET) base = 0;
+    else if (whence == SEEK_CUR) base = file->offset;
+    else if (whence == SEEK_END && !entry->is_dir) base = (off_t)entry->size;
+    else return (off_t)FS_ERR_INVALID_PARAM;
+
+    if (offset > 0 && base > LONG_MAX - offset) return (off_t)FS_ERR_OVERFLOW;
+    if (base + offset < 0) return (off_t)FS_ERR_INVALID_PARAM;
+    return base + offset;
+}
+
+/* --- Directories --- */
+
+/** @brief True if @p e sits directly in directory @p dir. */
+static bool initramfs_is_child(const initramfs_entry_t *dir, const initramfs_entry_t *e)
+{
+    const char *rest = e->path;
+    if (dir->path_len) {
+        if (e->path_len <= dir->path_len + 1 || strncmp(e->path, dir->path, dir->path_len) != 0 ||
+            e->path[dir->path_len] != '/') {
+            return false;
+        }
+        rest = e->path + dir->path_len + 1;
+    }
+    return strchr(rest, '/') == NULL;
+}
+
+static int initramfs_readdir(file_t *dir_file, struct dirent *d_entry_out, size_t entry_index)
+{
+    if (!dir_file || !dir_file->vnode || !dir_file->vnode->data || !d_entry_out) return FS_ERR_INVALID_PARAM;
+    initramfs_entry_t *dir = (initramfs_entry_t *)dir_file->vnode->data;
+    if (!dir->is_dir) return FS_ERR_NOT_A_DIRECTORY;
+
+    initramfs_fs_t *fs = dir->fs;
+    size_t seen = 0;
+    for (uint32_t i = 0; i < fs->count; i++) {
+        initramfs_entry_t *e = &fs->entries[i];
+        if (!initramfs_is_child(dir, e) || seen++ != entry_index) continue;
+        const char *base = dir->path_len ? e->path + dir->path_len + 1 : e->path;
+        strncpy(d_entry_out->d_name, base, MAX_FILENAME_LEN);
+        d_entry_out->d_name[MAX_FILENAME_LEN] = '\0';
+        d_entry_out->d_ino = e->ino;
+        d_entry_out->d_type = e->is_dir ? DT_DIR : DT_REG;
+        return FS_SUCCESS;
+    }
+    return FS_ERR_NOT_FOUND;
+}
+
+/** @brief Cookies are indices into fs->entries; d_off is the next one. */
+static int initramfs_getdents(file_t *dir_file, void *buf, size_t len, off_t *cookie)
+{
+    if (!dir_file || !dir_file->vnode || !dir_file->vnode->data || !buf || !cookie) return FS_ERR_INVALID_PARAM;
+    initramfs_entry_t *dir = (initramfs_entry_t *)dir_file->vnode->data;
+    if (!dir->is_dir) return FS_ERR_NOT_A_DIRECTORY;
+    if (*cookie < 0) return FS_ERR_INVALID_PARAM;
+
+    initramfs_fs_t *fs = dir->fs;
+    size_t used = 0;
+    uint32_t i = (uint32_t)*cookie;
+    for (; i < fs->count; i++) {
+        initramfs_entry_t *e = &fs->entries[i];
+        if (!initramfs_is_child(dir, e)) continue;
+        const char *base = dir->path_len ? e->path + dir->path_len + 1 : e->path;
+        size_t name_len = strlen(base);
+        if (name_len > MAX_FILENAME_LEN) name_len = MAX_FILENAME_LEN;
+        size_t reclen = DIRENT_REC_LEN(name_len);
+        if (used + reclen > len) break;
+
+        struct dirent_rec *rec = (struct dirent_rec *)((uint8_t *)buf + used);
+        rec->d_ino = e->ino;
+        rec->d_off = i + 1;
+        rec->d_reclen = (uint16_t)reclen;
+        rec->d_type = e->is_dir ? DT_DIR : DT_REG;
+        memcpy(rec->d_name, base, name_len);
+        memset(rec->d_name + name_len, 0, reclen - __builtin_offsetof(struct dirent_rec, d_name) - name_len);
+        used += reclen;
+    }
+
+    if (i < fs->count && used == 0) return FS_ERR_INVALID_PARAM; // Next record does not fit
+    *cookie = (off_t)i;
+    return (int)used;
+}
+
+static int initramfs_unlink(void *fs_context, const char *path)
+{
+    (void)fs_context; (void)path;
+    return FS_ERR_READ_ONLY;
+}
+
+/* --- Attributes --- */
+
+static void initramfs_fill_stat(const initramfs_entry_t *entry, struct vfs_stat *st)
+{
+    st->st_ino = entry->ino;
+    st->st_mode = entry->is_dir ? (VFS_S_IFDIR | 0555) : (VFS_S_IFREG | 0444);
+    st->st_size = entry->is_dir ? 0 : entry->size;
+    st->st_blksize = 4;   // Members are packed at 4-byte alignment
+    st->st_blocks = entry->is_dir ? 0 : (entry->size + 3) / 4;
+}
+
+static int initramfs_stat(void *fs_context, const char *path, struct vfs_stat *st)
+{
+    initramfs_fs_t *fs = (initramfs_fs_t *)fs_context;
+    if (!fs || !path || !st) return FS_ERR_INVALID_PARAM;
+    initramfs_entry_t *entry = initramfs_lookup(fs, path);
+    if (!entry) return FS_ERR_NOT_FOUND;
+    initramfs_fill_stat(entry, st);
+    return FS_SUCCESS;
+}
+
+static int initramfs_fstat(file_t *file, struct vfs_stat *st)
+{
+    if (!file || !file->vnode || !file->vnode->data || !st) return FS_ERR_BAD_F;
+    initramfs_fill_stat((const initramfs_entry_t *)file->vnode->data, st);
+    return FS_SUCCESS;
+}
+
+/* --- Registration --- */
+
+static vfs_driver_t initramfs_vfs_driver = {
+    .fs_name  = INITRAMFS_FS_NAME,
+    .mount    = initramfs_mount,
+    .unmount  = initramfs_unmount,
+    .open     = initramfs_open,
+    .read     = initramfs_read,
+    .write    = initramfs_write,
+    .close    = initramfs_close,
+    .lseek    = initramfs_lseek,
+    .readdir  = initramfs_readdir,
+    .unlink   = initramfs_unlink,
+    .getdents = initramfs_getdents,
+    .stat     = initramfs_stat,
+    .fstat    = initramfs_fstat,
+    // No .identify: the image is already in memory, the page cache would only copy it
+    .next     = NULL
+};
+
+int initramfs_register_driver(void)
+{
+    int result = vfs_register_driver(&initramfs_vfs_driver);
+    if (result != 0) terminal_printf("[initramfs] Error: Failed to register driver (VFS error code: %d)\n", result);
+    return result;
+}
+
+void initramfs_unregister_driver(void)
+{
+    vfs_unregister_driver(&initramfs_vfs_driver);
+}
@@ -0,0 +1,510 @@
+/**
+ * @file procfs.c
+ * @brief Read-only VFS driver for generated kernel statistics.
+ *
+ * The tree is one flat directory of the files in s_proc_files. Opening a
+ * file runs its generator into a kmalloc'ed buffer owned by the open file;
+ * reads and seeks then work on that snapshot alone, and close frees it.
+ * Nothing is generated for stat(), which reports a size of 0 like any
+ * procfs; fstat() on an open file gives the size of its snapshot.
+ */
+
+#include <kernel/fs/procfs/procfs.h>
+#include <kernel/fs/vfs/vfs.h>
+#include <kernel/fs/vfs/sys_file.h>    // O_* flags
+#include <kernel/fs/vfs/fs_errno.h>
+#include <kernel/memory/kmalloc.h>
+#include <kernel/memory/buddy.h>
+#include <kernel/memory/slab.h>
+#include <kernel/memory/percpu_alloc.h>
+#include <kernel/memory/mm.h>              // mm_get_fault_stats
+#include <kernel/memory/swap.h>            // swap_get_stats
+#include <kernel/drivers/storage/buffer_cache.h>
+#include <kernel/process/scheduler.h>
+#include <kernel/process/process.h>        // pcb_t
+#include <kernel/process/proc_snapshot.h>  // proc_snapshot_get_stats
+#include <kernel/lib/div64.h>
+#include <kernel/cpu/get_cpu_id.h>     // MAX_CPUS
+#include <kernel/cpu/smp.h>            // smp_cpu_count
+#include <kernel/sync/spinlock.h>
+#include <kernel/drivers/display/terminal.h>
+#include <kernel/lib/format.h>         // _vsnprintf
+#include <kernel/lib/string.h>
+#include <libc/stdarg.h>
+#include <libc/limits.h>               // INT_MAX, LONG_MAX
+
+#ifndef DT_DIR
+#define DT_DIR     4
+#endif
+#ifndef DT_REG
+#define DT_REG     8
+#endif
+
+#define PROCFS_TEXT_MAX  8192  // Largest report; /proc/slabinfo grows with the caches
+#define PROCFS_ROOT_INO  1
+
+/* The text being generated; output past the end is dropped */
+typedef struct proc_buf {
+    char  *data;
+    size_t len;
+    size_t size;
+} proc_buf_t;
+
+typedef struct proc_file_def {
+    const char *name;
+    void      (*generate)(proc_buf_t *out);
+} proc_file_def_t;
+
+/* An open file or the open root; vnode->data points at it */
+typedef struct proc_open {
+    const proc_file_def_t *def;   // NULL for the root directory
+    char                  *text;
+    size_t                 len;
+} proc_open_t;
+
+typedef struct procfs {
+    uint32_t   open_count;
+    spinlock_t lock;      // open_count
+} procfs_t;
+
+static vfs_driver_t procfs_vfs_driver;
+static procfs_t    *s_procfs = NULL;   // The mount; close finds it here
+
+static void proc_printf(proc_buf_t *out, const char *fmt, ...)
+{
+    if (out->len + 1 >= out->size) return;
+    va_list args;
+    va_start(args, fmt);
+    out->len += (size_t)_vsnprintf(out->data + out->len, out->size - out->len, fmt, args);
+    va_end(args);
+}
+
+/* --- Generators --- */
+
+static void proc_gen_meminfo(proc_buf_t *out)
+{
+    buddy_stats_t buddy;
+    buddy_get_stats(&buddy);
+    proc_printf(out, "BuddyTotal: %lu kB\n", (unsigned long)(buddy.total_bytes / 1024));
+    proc_printf(out, "BuddyFree: %lu kB\n", (unsigned long)(buddy.free_bytes / 1024));
+    proc_printf(out, "BuddyLargestFree: %lu kB\n", (unsigned long)(buddy.largest_free_block / 1024));
+    proc_printf(out, "BuddyAllocs: %lu\n", (unsigned long)buddy.alloc_count);   // Low 32 bits
+    proc_printf(out, "BuddyFrees: %lu\n", (unsigned long)buddy.free_count);
+    proc_printf(out, "BuddyFailed: %lu\n", (unsigned long)buddy.failed_alloc_count);
+
+    uint32_t allocs = 0, frees = 0;
+    kmalloc_get_global_stats(&allocs, &frees);
+    proc_printf(out, "KmallocAllocs: %lu\n", (unsigned long)allocs);
+    proc_printf(out, "KmallocFrees: %lu\n", (unsigned long)frees);
+
+    uint32_t cpus = smp_cpu_count();
+    if (cpus > MAX_CPUS) cpus = MAX_CPUS;
+    for (uint32_t cpu = 0; cpu < cpus; cpu++) {
+        if (percpu_get_stats((int)cpu, &allocs, &frees) != 0) continue;
+        proc_printf(out, "PercpuCpu%lu: %lu allocs %lu frees\n",
+                    (unsigned long)cpu, (unsigned long)allocs, (unsigned long)frees);
+    }
+}
+
+/* Mobility grouping first, then free blocks per order and type with the
+   order's fragmentation index (see buddy_stats_t) */
+static void proc_gen_buddyinfo(proc_buf_t *out)
+{
+    buddy_stats_t buddy;
+    buddy_get_stats(&buddy);
+    proc_printf(out, "pageblocks: %lu unmovable %lu reclaimable %lu movable\n",
+                (unsigned long)buddy.pageblocks[MIGRATE_UNMOVABLE],
+                (unsigned long)buddy.pageblocks[MIGRATE_RECLAIMABLE],
+                (unsigned long)buddy.pageblocks[MIGRATE_MOVABLE]);
+    proc_printf(out, "fallbacks: %lu\n", (unsigned long)buddy.fallback_count);
+    proc_printf(out, "claims: %lu\n", (unsigned long)buddy.claim_count);
+    proc_printf(out, "order unmovable reclaimable movable frag\n");
+    for (int order = MIN_ORDER; order <= MAX_ORDER; order++) {
+        proc_printf(out, "%d %lu %lu %lu %d\n", order,
+                    (unsigned long)buddy.free_blocks[MIGRATE_UNMOVABLE][order],
+                    (unsigned long)buddy.free_blocks[MIGRATE_RECLAIMABLE][order],
+                    (unsigned long)buddy.free_blocks[MIGRATE_MOVABLE][order],
+                    (int)buddy.frag_index[order]);
+    }
+}
+
+static void proc_slab_line(slab_cache_t *cache, void *arg)
+{
+    unsigned long allocs = 0, frees = 0;
+    slab_cache_stats(cache, &allocs, &frees);
+    proc_printf((proc_buf_t *)arg, "%s %lu %lu %lu %lu %lu\n", cache->name,
+                (unsigned long)cache->user_obj_size, (unsigned long)cache->internal_slot_size,
+                allocs, frees, allocs - frees);
+}
+
+static void proc_gen_slabinfo(proc_buf_t *out)
+{
+    proc_printf(out, "name size slot allocs frees in_use\n");
+    slab_for_each_cache(proc_slab_line, out);
+}
+
+static void proc_gen_bcache(proc_buf_t *out)
+{
+    buffer_cache_stats_t s;
+    buffer_cache_get_stats(&s);
+    proc_printf(out, "policy: %s\n", s.policy == BUFFER_POLICY_2Q ? "2q" : "lru");
+    proc_printf(out, "hits: %lu\n", (unsigned long)s.hits);
+    proc_printf(out, "misses: %lu\n", (unsigned long)s.misses);
+    proc_printf(out, "hits_in: %lu\n", (unsigned long)s.hits_in);
+    proc_printf(out, "hits_hot: %lu\n", (unsigned long)s.hits_hot);
+    proc_printf(out, "misses_in: %lu\n", (unsigned long)s.misses_in);
+    proc_printf(out, "misses_hot: %lu\n", (unsigned long)s.misses_hot);
+    proc_printf(out, "coalesced: %lu\n", (unsigned long)s.coalesced);
+    proc_printf(out, "reads: %lu\n", (unsigned long)s.reads);
+    proc_printf(out, "writes: %lu\n", (unsigned long)s.writes);
+    proc_printf(out, "readahead_blocks: %lu\n", (unsigned long)s.readahead_blocks);
+    proc_printf(out, "evictions: %lu\n", (unsigned long)s.evictions);
+    proc_printf(out, "alloc_failures: %lu\n", (unsigned long)s.alloc_failures);
+    proc_printf(out, "io_errors: %lu\n", (unsigned long)s.io_errors);
+    proc_printf(out, "cached_buffers: %lu\n", (unsigned long)s.cached_buffers);
+    proc_printf(out, "dirty_buffers: %lu\n", (unsigned long)s.dirty_buffers);
+    proc_printf(out, "in_buffers: %lu\n", (unsigned long)s.in_buffers);
+    proc_printf(out, "hot_buffers: %lu\n", (unsigned long)s.hot_buffers);
+    proc_printf(out, "pool_buffers: %lu\n", (unsigned long)s.pool_buffers);
+    proc_printf(out, "pool_free: %lu\n", (unsigned long)s.pool_free);
+}
+
+static void proc_gen_sched(proc_buf_t *out)
+{
+    uint32_t tasks = 0, switches = 0;
+    debug_scheduler_stats(&tasks, &switches);
+    proc_printf(out, "cpus: %lu\n", (unsigned long)smp_cpu_count());
+    proc_printf(out, "tasks: %lu\n", (unsigned long)tasks);
+    proc_printf(out, "switches: %lu\n", (unsigned long)switches);
+
+    sched_task_stats_t totals;
+    if (scheduler_get_task_stats(IDLE_TASK_PID, &totals) == 0) {
+        proc_printf(out, "voluntary: %lu\n", (unsigned long)totals.nr_voluntary);
+        proc_printf(out, "involuntary: %lu\n", (unsigned long)totals.nr_involuntary);
+        proc_printf(out, "wakeups: %lu\n", (unsigned long)totals.nr_wakeups);
+        proc_printf(out, "runtime_ticks: %lu\n", (unsigned long)totals.runtime_ticks);
+    }
+}
+
+static void proc_fault_line(proc_buf_t *out, const char *who, uint32_t pid, const mm_fault_stats_t *f)
+{
+    uint32_t kcycles = (uint32_t)div_u64_rem(f->cycles, 1000, NULL);
+    if (who) proc_printf(out, "%s", who);
+    else proc_printf(out, "%lu", (unsigned long)pid);
+    proc_printf(out, " %lu %lu %lu %lu %lu %lu %lu %lu\n", (unsigned long)f->minor, (unsigned long)f->major,
+                (unsigned long)f->cow_copies, (unsigned long)f->cow_reuses, (unsigned long)f->zero_fills,
+                (unsigned long)f->fault_around, (unsigned long)f->huge_pages, (unsigned long)kcycles);
+}
+
+static void proc_fault_process(pcb_t *proc, void *arg)
+{
+    mm_fault_stats_t f;
+    mm_get_fault_stats(proc->mm, &f);
+    proc_fault_line((proc_buf_t *)arg, NULL, proc->pid, &f);
+}
+
+/* The system-wide line first, then one per process */
+static void proc_gen_faults(proc_buf_t *out)
+{
+    mm_fault_stats_t f;
+    mm_get_fault_stats(NULL, &f);
+    proc_printf(out, "pid minor major cow_copies cow_reuses zero_fills fault_around huge kcycles\n");
+    proc_fault_line(out, "all", 0, &f);
+    scheduler_for_each_process(proc_fault_process, out);
+}
+
+/* The swap area (device "none" while swap is off) and its traffic */
+static void proc_gen_swaps(proc_buf_t *out)
+{
+    swap_stats_t st;
+    swap_get_stats(&st);
+    proc_printf(out, "device: %s\n", st.device[0] ? st.device : "none");
+    proc_printf(out, "slots: %lu used %lu\n", (unsigned long)st.nr_slots, (unsigned long)st.nr_used);
+    proc_printf(out, "swapouts: %lu\n", (unsigned long)st.swapouts);
+    proc_printf(out, "swapins: %lu\n", (unsigned long)st.swapins);
+    proc_printf(out, "readahead: %lu\n", (unsigned long)st.readahead);
+    proc_printf(out, "writeback_hits: %lu\n", (unsigned long)st.wb_hits);
+    proc_printf(out, "second_chance: %lu\n", (unsigned long)st.second_chance);
+    proc_printf(out, "io_errors: %lu\n", (unsigned long)st.io_errors);
+}
+
+/* Program snapshots (proc_snapshot.h) and how often processes started from one */
+static void proc_gen_snapshots(proc_buf_t *out)
+{
+    proc_snapshot_stats_t st;
+    proc_snapshot_get_stats(&st);
+    proc_printf(out, "hits: %lu\n", (unsigned long)st.hits);
+    proc_printf(out, "builds: %lu\n", (unsigned long)st.builds);
+    proc_printf(out, "stale: %lu\n", (unsigned long)st.stale);
+    proc_printf(out, "evictions: %lu\n", (unsigned long)st.evictions);
+    proc_printf(out, "cached: %lu\n", (unsigned long)st.cached);
+}
+
+static const proc_file_def_t s_proc_files[] = {
+    { "meminfo",  proc_gen_meminfo },
+    { "buddyinfo", proc_gen_buddyinfo },
+    { "slabinfo", proc_gen_slabinfo },
+    { "bcache",   proc_gen_bcache },
+    { "sched",    proc_gen_sched },
+    { "faults",   proc_gen_faults },
+    { "swaps",    proc_gen_swaps },
+    { "snapshots", proc_gen_snapshots },
+};
+
+#define PROC_FILE_COUNT (sizeof(s_proc_files) / sizeof(s_proc_files[0]))
+
+/** @brief The file at @p path; *is_root is set for the directory itself. */
+static const proc_file_def_t *procfs_lookup(const char *path, bool *is_root)
+{
+    while (*path == '/') path++;
+    size_t len = strlen(path);
+    while (len > 0 && path[len - 1] == '/') len--;
+    *is_root = (len == 0);
+    if (len == 0) return NULL;
+
+    for (uint32_t i = 0; i < PROC_FILE_COUNT; i++) {
+        if (strncmp(s_proc_files[i].name, path, len) == 0 && s_proc_files[i].name[len] == '\0') {
+            return &s_proc_files[i];
+        }
+    }
+    return NULL;
+}
+
+static uint32_t procfs_ino(const proc_file_def_t *def)
+{
+    return def ? (uint32_t)(def - s_proc_files) + PROCFS_ROOT_INO + 1 : PROCFS_ROOT_INO;
+}
+
+/* --- Mount --- */
+
+static void *procfs_mount(const char *device)
+{
+    (void)device; // Nothing backs it
+    if (s_procfs) return NULL; // One instance: the counters are global anyway
+
+    procfs_t *fs = kmalloc(sizeof(procfs_t));
+    if (!fs) return NULL;
+    memset(fs, 0, sizeof(*fs));
+    spinlock_init(&fs->lock);
+    s_procfs = fs;
+    return fs;
+}
+
+static int procfs_unmount(void *fs_context)
+{
+    procfs_t *fs = (procfs_t *)fs_context;
+    if (!fs) return FS_ERR_INVALID_PARAM;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&fs->lock);
+    bool busy = (fs->open_count != 0);
+    spinlock_release_irqrestore(&fs->lock, irq_flags);
+    if (busy) return FS_ERR_BUSY;
+
+    s_procfs = NULL;
+    kfree(fs);
+    return FS_SUCCESS;
+}
+
+/* --- Files --- */
+
+static vnode_t *procfs_open(void *fs_context, const char *path, int flags)
+{
+    procfs_t *fs = (procfs_t *)fs_context;
+    if (!fs || !path) return NULL;
+    if ((flags & O_ACCMODE) != O_RDONLY || (flags & (O_TRUNC | O_APPEND))) return NULL; // Read-only
+
+    bool is_root;
+    const proc_file_def_t *def = procfs_lookup(path, &is_root);
+    if (!def && !is_root) return NULL;
+    if ((flags & O_CREAT) && (flags & O_EXCL)) return NULL;
+
+    proc_open_t *po = kmalloc(sizeof(proc_open_t));
+    vnode_t *vnode = kmalloc(sizeof(vnode_t));
+    if (!po || !vnode) goto fail;
+    po->def = def;
+    po->text = NULL;
+    po->len = 0;
+    if (def) {
+        proc_buf_t out = { .data = kmalloc(PROCFS_TEXT_MAX), .len = 0, .size = PROCFS_TEXT_MAX };
+        if (!out.data) goto fail;
+        out.data[0] = '\0';
+        def->generate(&out);
+        po->text = out.data;
+        po->len = out.len;
+    }
+    vnode->data = po;
+    vnode->fs_driver = &procfs_vfs_driver;
+
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&fs->lock);
+    fs->open_count++;
+    spinlock_release_irqrestore(&fs->lock, irq_flags);
+    return vnode;
+
+fail:
+    kfree(vnode);
+    kfree(po);
+    return NULL;
+}
+
+static int procfs_close(file_t *file)
+{
+    if (!file || !file->vnode || !file->vnode->data) return FS_ERR_BAD_F;
+    proc_open_t *po = (proc_open_t *)file->vnode->data;
+    kfree(po->text);
+    kfree(po);
+    file->vnode->data = NULL;
+
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_procfs->lock);
+    s_procfs->open_count--;
+    spinlock_release_irqrestore(&s_procfs->lock, irq_flags);
+    return FS_SUCCESS;
+}
+
+static int procfs_read(file_t *file, void *buf, size_t len)
+{
+    if (!file || !file->vnode || !file->vnode->data) return FS_ERR_BAD_F;
+    proc_open_t *po = (proc_open_t *)file->vnode->data;
+    if (!po->def) return FS_ERR_IS_A_DIRECTORY;
+    if (file->offset < 0) return FS_ERR_INVALID_PARAM;
+
+    size_t pos = (size_t)file->offset;
+    if (pos >= po->len) return 0;
+    if (len > po->len - pos) len = po->len - pos;
+    if (len > (size_t)INT_MAX) len = (size_t)INT_MAX;
+    memcpy(buf, po->text + pos, len); // The snapshot belongs to this file alone
+    return (int)len;
+}
+
+static int procfs_write(file_t *file, const void *buf, size_t len)
+{
+    (void)file; (void)buf; (void)len;
+    return FS_ERR_READ_ONLY;
+}
+
+static off_t procfs_lseek(file_t *file, off_t offset, int whence)
+{
+    if (!file || !file->vnode || !file->vnode->data) return (off_t)FS_ERR_BAD_F;
+    proc_open_t *po = (proc_open_t *)file->vnode->data;
+
+    off_t base;
+    if (whence == SEEK_SET) base = 0;
+    else if (whence == SEEK_CUR) base = file->offset;
+    else if (whence == SEEK_END && po->def) base = (off_t)po->len;
+    else return (off_t)FS_ERR_INVALID_PARAM;
+
+    if (offset > 0 && base > LONG_MAX - offset) return (off_t)FS_ERR_OVERFLOW;
+    if (base + offset < 0) return (off_t)FS_ERR_INVALID_PARAM;
+    return base + offset;
+}
+
+/* --- Directory --- */
+
+static int procfs_readdir(file_t *dir_file, struct dirent *d_entry_out, size_t entry_index)
+{
+    if (!dir_file || !dir_file->vnode || !dir_file->vnode->data || !d_entry_out) return FS_ERR_INVALID_PARAM;
+    if (((proc_open_t *)dir_file->vnode->data)->def) return FS_ERR_NOT_A_DIRECTORY;
+    if (entry_index >= PROC_FILE_COUNT) return FS_ERR_NOT_FOUND;
+
+    const proc_file_def_t *def = &s_proc_files[entry_index];
+    strncpy(d_entry_out->d_name, def->name, MAX_FILENAME_LEN);
+    d_entry_out->d_name[MAX_FILENAME_LEN] = '\0';
+    d_entry_out->d_ino = procfs_ino(def);
+    d_entry_out->d_type = DT_REG;
+    return FS_SUCCESS;
+}
+
+/** @brief Cookies are indices into s_proc_files; d_off is the next one. */
+static int procfs_getdents(file_t *dir_file, void *buf, size_t len, off_t *cookie)
+{
+    if (!dir_file || !dir_file->vnode || !dir_file->vnode->data || !buf || !cookie) return FS_ERR_INVALID_PARAM;
+    if (((proc_open_t *)dir_file->vnode->data)->def) return FS_ERR_NOT_A_DIRECTORY;
+    if (*cookie < 0) return FS_ERR_INVALID_PARAM;
+
+    size_t used = 0;
+    uint32_t i = (uint32_t)*cookie;
+    for (; i < PROC_FILE_COUNT; i++) {
+        const proc_file_def_t *def = &s_proc_files[i];
+        size_t name_len = strlen(def->name);
+        size_t reclen = DIRENT_REC_LEN(name_len);
+        if (used + reclen > len) break;
+
+        struct dirent_rec *rec = (struct dirent_rec *)((uint8_t *)buf + used);
+        rec->d_ino = procfs_ino(def);
+        rec->d_off = i + 1;
+        rec->d_reclen = (uint16_t)reclen;
+        rec->d_type = DT_REG;
+        memcpy(rec->d_name, def->name, name_len);
+        memset(rec->d_name + name_len, 0, reclen - __builtin_offsetof(struct dirent_rec, d_name) - name_len);
+        used += reclen;
+    }
+
+    if (i < PROC_FILE_COUNT && used == 0) return FS_ERR_INVALID_PARAM; // Next record does not fit
+    *cookie = (off_t)i;
+    return (int)used;
+}
+
+static int procfs_unlink(void *fs_context, const char *path)
+{
+    (void)fs_context; (void)path;
+    return FS_ERR_READ_ONLY;
+}
+
+/* --- Attributes --- */
+
+static void procfs_fill_stat(const proc_file_def_t *def, size_t size, struct vfs_stat *st)
+{
+    st->st_ino = procfs_ino(def);
+    st->st_mode = def ? (VFS_S_IFREG | 0444) : (VFS_S_IFDIR | 0555);
+    st->st_size = size;
+    st->st_blksize = PROCFS_TEXT_MAX;
+    st->st_blocks = 0;   // Takes no storage
+}
+
+static int procfs_stat(void *fs_context, const char *path, struct vfs_stat *st)
+{
+    if (!fs_context || !path || !st) return FS_ERR_INVALID_PARAM;
+    bool is_root;
+    const proc_file_def_t *def = procfs_lookup(path, &is_root);
+    if (!def && !is_root) return FS_ERR_NOT_FOUND;
+    procfs_fill_stat(def, 0, st);
+    return FS_SUCCESS;
+}
+
+static int procfs_fstat(file_t *file, struct vfs_stat *st)
+{
+    if (!file || !file->vnode || !file->vnode->data || !st) return FS_ERR_BAD_F;
+    const proc_open_t *po = (const proc_open_t *)file->vnode->data;
+    procfs_fill_stat(po->def, po->len, st);
+    return FS_SUCCESS;
+}
+
+/* --- Registration --- */
+
+static vfs_driver_t procfs_vfs_driver = {
+    .fs_name  = PROCFS_FS_NAME,
+    .mount    = procfs_mount,
+    .unmount  = procfs_unmount,
+    .open     = procfs_open,
+    .read     = procfs_read,
+    .write    = procfs_write,
+    .close    = procfs_close,
+    .lseek    = procfs_lseek,
+    .readdir  = procfs_readdir,
+    .unlink   = procfs_unlink,
+    .getdents = procfs_getdents,
+    .stat     = procfs_stat,
+    .fstat    = procfs_fstat,
+    // No .identify: every open is a new snapshot, the page cache must not keep one
+    .next     = NULL
+};
+
+int procfs_register_driver(void)
+{
+    int result = vfs_register_driver(&procfs_vfs_driver);
+    if (result != 0) terminal_printf("[procfs] Error: Failed to register driver (VFS error code: %d)\n", result);
+    return result;
+}
+
+void procfs_unregister_driver(void)
+{
+    vfs_unregister_driver(&procfs_vfs_driver);
+}
@@ -0,0 +1,636 @@
+/**
+ * @file tmpfs.c
+ * @brief In-memory filesystem driver.
+ *
+ * Each mount is a tree of tmpfs_node_t. A regular file keeps an array of
+ * physical frames, one per page of data, allocated zeroed on the first write
+ * to that page (unwritten pages read back as zeroes without taking memory);
+ * the data is reached through kmap_atomic(). A directory is a chained hash
+ * table of its children keyed by name, doubled as it fills. One spinlock per
+ * mount guards the tree and all file data, so no operation ever sleeps.
+ */
+
+#include <kernel/fs/tmpfs/tmpfs.h>
+#include <kernel/fs/vfs/vfs.h>
+#include <kernel/fs/vfs/sys_file.h>    // O_* flags
+#include <kernel/fs/vfs/fs_errno.h>
+#include <kernel/memory/frame.h>       // frame_alloc_zeroed_mt, put_frame
+#include <kernel/memory/paging.h>      // PAGE_SIZE, kmap_atomic
+#include <kernel/memory/kmalloc.h>
+#include <kernel/memory/slab.h>
+#include <kernel/drivers/display/terminal.h>
+#include <kernel/lib/string.h>
+#include <libc/limits.h>               // LONG_MAX
+
+#ifndef DT_DIR
+#define DT_DIR     4
+#endif
+#ifndef DT_REG
+#define DT_REG     8
+#endif
+
+// getdents/lseek cookie of a directory: bucket in the high half, chain position in the low
+#define TMPFS_COOKIE(bucket, pos)  ((off_t)(((uint32_t)(bucket) << 16) | (uint32_t)(pos)))
+#define TMPFS_COOKIE_BUCKET(c)     ((uint32_t)(c) >> 16)
+#define TMPFS_COOKIE_POS(c)        ((uint32_t)(c) & 0xFFFFu)
+
+static slab_cache_t *tmpfs_node_cache = NULL;
+static vfs_driver_t tmpfs_vfs_driver;
+
+/* --- Nodes --- */
+
+static uint32_t tmpfs_hash(const char *name, size_t len)
+{
+    uint32_t h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/** @brief A new, unlinked node named @p name (caller holds fs->lock, or the fs is private). */
+static tmpfs_node_t *tmpfs_node_alloc(tmpfs_fs_t *fs, const char *name, size_t len, bool is_dir)
+{
+    tmpfs_node_t *node = (tmpfs_node_t *)slab_alloc(tmpfs_node_cache);
+    if (!node) return NULL;
+    memset(node, 0, sizeof(*node));
+    node->fs = fs;
+    node->ino = fs->next_ino++;
+    node->is_dir = is_dir;
+    memcpy(node->name, name, len);
+    node->name[len] = '\0';
+    node->hash = tmpfs_hash(name, len);
+    return node;
+}
+
+/** @brief Frees the first @p keep pages onwards of a file's data. */
+static void tmpfs_truncate_pages(tmpfs_node_t *node, uint32_t keep)
+{
+    for (uint32_t i = keep; i < node->page_slots; i++) {
+        if (node->pages[i]) {
+            put_frame(node->pages[i]);
+            node->pages[i] = 0;
+            node->fs->page_count--;
+        }
+    }
+}
+
+/** @brief Frees @p node and, for a directory, everything below it. */
+static void tmpfs_node_free(tmpfs_node_t *node)
+{
+    if (node->is_dir) {
+        for (uint32_t b = 0; b < node->bucket_count; b++) {
+            tmpfs_node_t *child = node->buckets[b];
+            while (child) {
+                tmpfs_node_t *next = child->hash_next;
+                tmpfs_node_free(child);
+                child = next;
+            }
+        }
+        kfree(node->buckets);
+    } else {
+        tmpfs_truncate_pages(node, 0);
+        kfree(node->pages);
+    }
+    slab_free(tmpfs_node_cache, node);
+}
+
+/* --- Directories --- */
+
+static tmpfs_node_t *tmpfs_dir_find(tmpfs_node_t *dir, const char *name, size_t len, uint32_t hash)
+{
+    if (!dir->buckets) return NULL;
+    for (tmpfs_node_t *n = dir->buckets[hash & (dir->bucket_count - 1)]; n; n = n->hash_next) {
+        if (n->hash == hash && strncmp(n->name, name, len) == 0 && n->name[len] == '\0') return n;
+    }
+    return NULL;
+}
+
+/** @brief Rehashes @p dir into twice the buckets; on failure it keeps the old table. */
+static void tmpfs_dir_grow(tmpfs_node_t *dir)
+{
+    uint32_t new_count = dir->bucket_count * 2;
+    tmpfs_node_t **new_buckets = kmalloc(new_count * sizeof(tmpfs_node_t *));
+    if (!new_buckets) return;
+    memset(new_buckets, 0, new_count * sizeof(tmpfs_node_t *));
+    for (uint32_t b = 0; b < dir->bucket_count; b++) {
+        tmpfs_node_t *n = dir->buckets[b];
+        while (n) {
+            tmpfs_node_t *next = n->hash_next;
+            uint32_t idx = n->hash & (new_count - 1);
+            n->hash_next = new_buckets[idx];
+            new_buckets[idx] = n;
+            n = next;
+        }
+    }
+    kfree(dir->buckets);
+    dir->buckets = new_buckets;
+    dir->bucket_count = new_count;
+}
+
+static int tmpfs_dir_insert(tmpfs_node_t *dir, tmpfs_node_t *child)
+{
+    if (!dir->buckets) {
+        dir->buckets = kmalloc(TMPFS_DIR_MIN_BUCKETS * sizeof(tmpfs_node_t *));
+        if (!dir->buckets) return FS_ERR_OUT_OF_MEMORY;
+        memset(dir->buckets, 0, TMPFS_DIR_MIN_BUCKETS * sizeof(tmpfs_node_t *));
+        dir->bucket_count = TMPFS_DIR_MIN_BUCKETS;
+    } else if (dir->entry_count >= dir->bucket_count * 2 && dir->bucket_count < TMPFS_DIR_MAX_BUCKETS) {
+        tmpfs_dir_grow(dir);
+    }
+    uint32_t idx = child->hash & (dir->bucket_count - 1);
+    child->hash_next = dir->buckets[idx];
+    dir->buckets[idx] = child;
+    child->parent = dir;
+    dir->entry_count++;
+    return FS_SUCCESS;
+}
+
+static void tmpfs_dir_remove(tmpfs_node_t *dir, tmpfs_node_t *child)
+{
+    tmpfs_node_t **link = &dir->buckets[child->hash & (dir->bucket_count - 1)];
+    while (*link && *link != child) link = &(*link)->hash_next;
+    if (*link) {
+        *link = child->hash_next;
+        dir->entry_count--;
+    }
+    child->hash_next = NULL;
+    child->parent = NULL;
+}
+
+/**
+ * @brief Resolves @p path (relative to the mount, "/" is the root).
+ * @return FS_SUCCESS with *node_out set, or FS_ERR_NOT_FOUND; when only the
+ *         last component is missing, *parent_out, *name_out and *len_out
+ *         give the directory and name a create would use. Caller holds fs->lock.
+ */
+static int tmpfs_resolve(tmpfs_fs_t *fs, const char *path, tmpfs_node_t **node_out,
+                         tmpfs_node_t **parent_out, const char **name_out, size_t *len_out)
+{
+    tmpfs_node_t *cur = fs->root;
+    const char *p = path;
+    *parent_out = NULL;
+
+    for (;;) {
+        while (*p == '/') p++;
+        if (*p == '\0') {
+            *node_out = cur;
+            return FS_SUCCESS;
+        }
+        const char *name = p;
+        while (*p && *p != '/') p++;
+        size_t len = (size_t)(p - name);
+        if (len > TMPFS_NAME_MAX) return FS_ERR_NAMETOOLONG;
+        if (!cur->is_dir) return FS_ERR_NOT_A_DIRECTORY;
+
+        tmpfs_node_t *next;
+        if (len == 1 && name[0] == '.') {
+            next = cur;
+        } else if (len == 2 && name[0] == '.' && name[1] == '.') {
+            next = cur->parent ? cur->parent : cur; // ".." of the root stays in the mount
+        } else {
+            next = tmpfs_dir_find(cur, name, len, tmpfs_hash(name, len));
+        }
+        if (!next) {
+            const char *rest = p;
+            while (*rest == '/') rest++;
+            if (*rest == '\0') {
+                *parent_out = cur;
+                *name_out = name;
+                *len_out = len;
+            }
+            return FS_ERR_NOT_FOUND;
+        }
+        cur = next;
+    }
+}
+
+/* --- Mount --- */
+
+static void *tmpfs_mount(const char *device)
+{
+    (void)device; // Only a label: there is nothing to read
+    tmpfs_fs_t *fs = kmalloc(sizeof(tmpfs_fs_t));
+    if (!fs) return NULL;
+    memset(fs, 0, sizeof(*fs));
+    spinlock_init(&fs->lock);
+    fs->next_ino = 1;
+    fs->root = tmpfs_node_alloc(fs, "", 0, true);
+    if (!fs->root) {
+        kfree(fs);
+        return NULL;
+    }
+    return fs;
+}
+
+static int tmpfs_unmount(void *fs_context)
+{
+    tmpfs_fs_t *fs = (tmpfs_fs_t *)fs_context;
+    if (!fs) return FS_ERR_INVALID_PARAM;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&fs->lock);
+    bool busy = (fs->open_count != 0);
+    spinlock_release_irqrestore(&fs->lock, irq_flags);
+    if (busy) return FS_ERR_BUSY;
+
+    tmpfs_node_free(fs->root);
+    kfree(fs);
+    return FS_SUCCESS;
+}
+
+/* --- Open / close --- */
+
+static vnode_t *tmpfs_open(void *fs_context, const char *path, int flags)
+{
+    tmpfs_fs_t *fs = (tmpfs_fs_t *)fs_context;
+    if (!fs || !path) return NULL;
+    bool writing = (flags & O_ACCMODE) != O_RDONLY;
+
+    vnode_t *vnode = kmalloc(sizeof(vnode_t));
+    if (!vnode) return NULL;
+
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&fs->lock);
+    tmpfs_node_t *node, *parent;
+    const char *name;
+    size_t len;
+    int result = tmpfs_resolve(fs, path, &node, &parent, &name, &len);
+
+    if (result == FS_SUCCESS) {
+        if ((flags & O_CREAT) && (flags & O_EXCL)) result = FS_ERR_FILE_EXISTS;
+        else if (node->is_dir && (writing || (flags & (O_TRUNC | O_APPEND)))) result = FS_ERR_IS_A_DIRECTORY;
+        else if ((flags & O_TRUNC) && writing) {
+            tmpfs_truncate_pages(node, 0);
+            node->size = 0;
+        }
+    } else if (result == FS_ERR_NOT_FOUND && parent && (flags & O_CREAT)) {
+        node = tmpfs_node_alloc(fs, name, len, false);
+        if (!node) result = FS_ERR_OUT_OF_MEMORY;
+        else if ((result = tmpfs_dir_insert(parent, node)) != FS_SUCCESS) slab_free(tmpfs_node_cache, node);
+    }
+
+    if (result == FS_SUCCESS) {
+        node->open_count++;
+        fs->open_count++;
+    }
+    spinlock_release_irqrestore(&fs->lock, irq_flags);
+
+    if (result != FS_SUCCESS) {
+        kfree(vnode);
+        return NULL;
+    }
+    vnode->data = node;
+    vnode->fs_driver = &tmpfs_vfs_driver;
+    return vnode;
+}
+
+/** @brief Drops the handle; the VFS frees the vnode itself. */
+static int tmpfs_close(file_t *file)
+{
+    if (!file || !file->vnode || !file->vnode->data) return FS_ERR_BAD_F;
+    tmpfs_node_t *node = (tmpfs_node_t *)file->vnode->data;
+    tmpfs_fs_t *fs = node->fs;
+
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&fs->lock);
+    node->open_count--;
+    fs->open_count--;
+    bool orphan = (node->open_count == 0 && !node->parent && node != fs->root);
+    spinlock_release_irqrestore(&fs->lock, irq_flags);
+
+    if (orphan) tmpfs_node_free(node); // Unlinked while open; nothing else can reach it
+    file->vnode->data = NULL;
+    return FS_SUCCESS;
+}
+
+/* --- Data --- */
+
+static int tmpfs_read(file_t *file, void *buf, size_t len)
+{
+    if (!file || !file->vnode || !file->vnode->data) return FS_ERR_BAD_F;
+    tmpfs_node_t *node = (tmpfs_node_t *)file->vnode->data;
+    if (node->is_dir) return FS_ERR_IS_A_DIRECTORY;
+    if (file->offset < 0) return FS_ERR_INVALID_PARAM;
+    if (len > (size_t)INT_MAX) len = (size_t)INT_MAX;
+
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&node->fs->lock);
+    uint32_t pos = (uint32_t)file->offset;
+    if (pos >= node->size) {
+        spinlock_release_irqrestore(&node->fs->lock, irq_flags);
+        return 0;
+    }
+    if (len > node->size - pos) len = node->size - pos;
+
+    uint8_t *dst = (uint8_t *)buf;
+    size_t done = 0;
+    while (done < len) {
+        uint32_t page = pos / PAGE_SIZE;
+        uint32_t in_page = pos % PAGE_SIZE;
+        size_t chunk = PAGE_SIZE - in_page;
+        if (chunk > len - done) chunk = len - done;
+
+        uintptr_t frame = (page < node->page_slots) ? node->pages[page] : 0;
+        if (frame) {
+            uint8_t *kaddr = (uint8_t *)kmap_atomic(frame);
+            memcpy(dst + done, kaddr + in_page, chunk);
+            kunmap_atomic(kaddr);
+        } else {
+            memset(dst + done, 0, chunk); // Hole
+        }
+        done += chunk;
+        pos += chunk;
+    }
+    spinlock_release_irqrestore(&node->fs->lock, irq_flags);
+    return (int)done;
+}
+
+/** @brief Makes room in node->pages for @p slots page entries (caller holds fs->lock). */
+static int tmpfs_reserve_slots(tmpfs_node_t *node, uint32_t slots)
+{
+    if (slots <= node->page_slots) return FS_SUCCESS;
+    uint32_t new_slots = node->page_slots ? node->page_slots : 4;
+    while (new_slots < slots) new_slots *= 2;
+    uintptr_t *pages = kmalloc(new_slots * sizeof(uintptr_t));
+    if (!pages) return FS_ERR_OUT_OF_MEMORY;
+    if (node->page_slots) memcpy(pages, node->pages, node->page_slots * sizeof(uintptr_t));
+    memset(pages + node->page_slots, 0, (new_slots - node->page_slots) * sizeof(uintptr_t));
+    kfree(node->pages);
+    node->pages = pages;
+    node->page_slots = new_slots;
+    return FS_SUCCESS;
+}
+
+static int tmpfs_write(file_t *file, const void *buf, size_t len)
+{
+    if (!file || !file->vnode || !file->vnode->data) return FS_ERR_BAD_F;
+    tmpfs_node_t *node = (tmpfs_node_t *)file->vnode->data;
+    if (node->is_dir) return FS_ERR_IS_A_DIRECTORY;
+    if (len > (size_t)INT_MAX) len = (size_t)INT_MAX;
+
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&node->fs->lock);
+    if (file->flags & O_APPEND) file->offset = (off_t)node->size; // The VFS advances from here
+    if (file->offset < 0) {
+        spinlock_release_irqrestore(&node->fs->lock, irq_flags);
+        return FS_ERR_INVALID_PARAM;
+    }
+    uint32_t pos = (uint32_t)file->offset;
+    if (len > (size_t)(LONG_MAX - file->offset)) len = (size_t)(LONG_MAX - file->offset);
+    if (len == 0) {
+        spinlock_release_irqrestore(&node->fs->lock, irq_flags);
+        return FS_ERR_OVERFLOW;
+    }
+
+    uint32_t end_page = (uint32_t)((pos + len - 1) / PAGE_SIZE);
+    int result = tmpfs_reserve_slots(node, end_page + 1);
+    if (result != FS_SUCCESS) {
+        spinlock_release_irqrestore(&node->fs->lock, irq_flags);
+        return result;
+    }
+
+    const uint8_t *src = (const uint8_t *)buf;
+    size_t done = 0;
+    while (done < len) {
+        uint32_t page = pos / PAGE_SIZE;
+        uint32_t in_page = pos % PAGE_SIZE;
+        size_t chunk = PAGE_SIZE - in_page;
+        if (chunk > len - done) chunk = len - done;
+
+        uintptr_t frame = node->pages[page];
+        if (!frame) {
+            frame = frame_alloc_zeroed_mt(MIGRATE_MOVABLE); // Bytes around the write must read back as zero
+            if (!frame) break;
+            node->pages[page] = frame;
+            node->fs->page_count++;
+        }
+        uint8_t *kaddr = (uint8_t *)kmap_atomic(frame);
+        memcpy(kaddr + in_page, src + done, chunk);
+        kunmap_atomic(kaddr);
+        done += chunk;
+        pos += chunk;
+    }
+    if (pos > node->size) node->size = pos;
+    spinlock_release_irqrestore(&node->fs->lock, irq_flags);
+    return done ? (int)done : FS_ERR_NO_SPACE;
+}
+
+static off_t tmpfs_lseek(file_t *file, off_t offset, int whence)
+{
+    if (!file || !file->vnode || !file->vnode->data) return (off_t)FS_ERR_BAD_F;
+    tmpfs_node_t *node = (tmpfs_node_t *)file->vnode->data;
+
+    off_t base;
+    if (whence == SEEK_SET) base = 0;
+    else if (whence == SEEK_CUR) base = file->offset;
+    else if (whence == SEEK_END && !node->is_dir) {
+        uintptr_t irq_flags = spinlock_acquire_irqsave(&node->fs->lock);
+        base = (off_t)node->size;
+        spinlock_release_irqrestore(&node->fs->lock, irq_flags);
+    } else return (off_t)FS_ERR_INVALID_PARAM;
+
+    if (offset > 0 && base > LONG_MAX - offset) return (off_t)FS_ERR_OVERFLOW;
+    if (base + offset < 0) return (off_t)FS_ERR_INVALID_PARAM;
+    return base + offset;
+}
+
+/* --- Directory listing --- */
+
+/** @brief The entry at chain position @p pos of bucket @p bucket, or NULL. */
+static tmpfs_node_t *tmpfs_dir_at(tmpfs_node_t *dir, uint32_t bucket, uint32_t pos)
+{
+    tmpfs_node_t *n = dir->buckets[bucket];
+    while (n && pos--) n = n->hash_next;
+    return n;
+}
+
+static int tmpfs_readdir(file_t *dir_file, struct dirent *d_entry_out, size_t entry_index)
+{
+    if (!dir_file || !dir_file->vnode || !dir_file->vnode->data || !d_entry_out) return FS_ERR_INVALID_PARAM;
+    tmpfs_node_t *dir = (tmpfs_node_t *)dir_file->vnode->data;
+    if (!dir->is_dir) return FS_ERR_NOT_A_DIRECTORY;
+
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&dir->fs->lock);
+    int result = FS_ERR_NOT_FOUND;
+    if (entry_index < dir->entry_count) {
+        size_t seen = 0;
+        for (uint32_t b = 0; b < dir->bucket_count && result != FS_SUCCESS; b++) {
+            for (tmpfs_node_t *n = dir->buckets[b]; n; n = n->hash_next) {
+                if (seen++ != entry_index) continue;
+                strncpy(d_entry_out->d_name, n->name, MAX_FILENAME_LEN);
+                d_entry_out->d_name[MAX_FILENAME_LEN] = '\0';
+                d_entry_out->d_ino = n->ino;
+                d_entry_out->d_type = n->is_dir ? DT_DIR : DT_REG;
+                result = FS_SUCCESS;
+                break;
+            }
+        }
+    }
+    spinlock_release_irqrestore(&dir->fs->lock, irq_flags);
+    return result;
+}
+
+static int tmpfs_getdents(file_t *dir_file, void *buf, size_t len, off_t *cookie)
+{
+    if (!dir_file || !dir_file->vnode || !dir_file->vnode->data || !buf || !cookie) return FS_ERR_INVALID_PARAM;
+    tmpfs_node_t *dir = (tmpfs_node_t *)dir_file->vnode->data;
+    if (!dir->is_dir) return FS_ERR_NOT_A_DIRECTORY;
+    if (*cookie < 0) return FS_ERR_INVALID_PARAM;
+
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&dir->fs->lock);
+    uint32_t bucket = TMPFS_COOKIE_BUCKET(*cookie);
+    uint32_t pos = TMPFS_COOKIE_POS(*cookie);
+    size_t used = 0;
+    bool full = false;
+
+    for (; bucket < dir->bucket_count && !full; bucket++, pos = 0) {
+        for (tmpfs_node_t *n = tmpfs_dir_at(dir, bucket, pos); n; n = n->hash_next, pos++) {
+            size_t name_len = strlen(n->name);
+            size_t reclen = DIRENT_REC_LEN(name_len);
+            if (used + reclen > len) {
+                full = true;
+                break;
+            }
+            struct dirent_rec *rec = (struct dirent_rec *)((uint8_t *)buf + used);
+            rec->d_ino = n->ino;
+            rec->d_off = (uint32_t)TMPFS_COOKIE(bucket, pos + 1);
+            rec->d_reclen = (uint16_t)reclen;
+            rec->d_type = n->is_dir ? DT_DIR : DT_REG;
+            memcpy(rec->d_name, n->name, name_len);
+            memset(rec->d_name + name_len, 0, reclen - __builtin_offsetof(struct dirent_rec, d_name) - name_len);
+            used += reclen;
+        }
+        if (full) break;
+    }
+    spinlock_release_irqrestore(&dir->fs->lock, irq_flags);
+
+    if (full && used == 0) return FS_ERR_INVALID_PARAM;
+    *cookie = TMPFS_COOKIE(bucket, pos);
+    return (int)used;
+}
+
+/* --- Namespace --- */
+
+static int tmpfs_unlink(void *fs_context, const char *path)
+{
+    tmpfs_fs_t *fs = (tmpfs_fs_t *)fs_context;
+    if (!fs || !path) return FS_ERR_INVALID_PARAM;
+
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&fs->lock);
+    tmpfs_node_t *node, *parent;
+    const char *name;
+    size_t len;
+    int result = tmpfs_resolve(fs, path, &node, &parent, &name, &len);
+    bool orphan = false;
+    if (result == FS_SUCCESS) {
+        if (node == fs->root) result = FS_ERR_PERMISSION_DENIED;
+        else if (node->is_dir && node->entry_count) result = FS_ERR_BUSY; // Not empty
+        else {
+            tmpfs_dir_remove(node->parent, node);
+            orphan = (node->open_count == 0); // Otherwise the last close frees it
+        }
+    }
+    spinlock_release_irqrestore(&fs->lock, irq_flags);
+
+    if (orphan) tmpfs_node_free(node);
+    return result;
+}
+
+static int tmpfs_mkdir(void *fs_context, const char *path)
+{
+    tmpfs_fs_t *fs = (tmpfs_fs_t *)fs_context;
+    if (!fs || !path) return FS_ERR_INVALID_PARAM;
+
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&fs->lock);
+    tmpfs_node_t *node, *parent;
+    const char *name;
+    size_t len;
+    int result = tmpfs_resolve(fs, path, &node, &parent, &name, &len);
+    if (result == FS_SUCCESS) {
+        result = FS_ERR_FILE_EXISTS;
+    } else if (result == FS_ERR_NOT_FOUND && parent) {
+        node = tmpfs_node_alloc(fs, name, len, true);
+        if (!node) result = FS_ERR_OUT_OF_MEMORY;
+        else if ((result = tmpfs_dir_insert(parent, node)) != FS_SUCCESS) slab_free(tmpfs_node_cache, node);
+    }
+    spinlock_release_irqrestore(&fs->lock, irq_flags);
+    return result;
+}
+
+/* --- Attributes --- */
+
+/** @brief Fills @p st from @p node. Caller holds fs->lock. */
+static void tmpfs_fill_stat(const tmpfs_node_t *node, struct vfs_stat *st)
+{
+    st->st_ino = node->ino;
+    st->st_mode = node->is_dir ? (VFS_S_IFDIR | 0777) : (VFS_S_IFREG | 0666);
+    st->st_size = node->is_dir ? 0 : node->size;
+    st->st_blksize = PAGE_SIZE;
+    if (!node->is_dir) {
+        for (uint32_t i = 0; i < node->page_slots; i++) {
+            if (node->pages[i]) st->st_blocks++; // Holes take no frame
+        }
+    }
+}
+
+static int tmpfs_stat(void *fs_context, const char *path, struct vfs_stat *st)
+{
+    tmpfs_fs_t *fs = (tmpfs_fs_t *)fs_context;
+    if (!fs || !path || !st) return FS_ERR_INVALID_PARAM;
+
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&fs->lock);
+    tmpfs_node_t *node, *parent;
+    const char *name;
+    size_t len;
+    int result = tmpfs_resolve(fs, path, &node, &parent, &name, &len);
+    if (result == FS_SUCCESS) tmpfs_fill_stat(node, st);
+    spinlock_release_irqrestore(&fs->lock, irq_flags);
+    return result;
+}
+
+static int tmpfs_fstat(file_t *file, struct vfs_stat *st)
+{
+    if (!file || !file->vnode || !file->vnode->data || !st) return FS_ERR_BAD_F;
+    tmpfs_node_t *node = (tmpfs_node_t *)file->vnode->data;
+
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&node->fs->lock);
+    tmpfs_fill_stat(node, st);
+    spinlock_release_irqrestore(&node->fs->lock, irq_flags);
+    return FS_SUCCESS;
+}
+
+/* --- Registration --- */
+
+static vfs_driver_t tmpfs_vfs_driver = {
+    .fs_name  = TMPFS_FS_NAME,
+    .mount    = tmpfs_mount,
+    .unmount  = tmpfs_unmount,
+    .open     = tmpfs_open,
+    .read     = tmpfs_read,
+    .write    = tmpfs_write,
+    .close    = tmpfs_close,
+    .lseek    = tmpfs_lseek,
+    .readdir  = tmpfs_readdir,
+    .unlink   = tmpfs_unlink,
+    .getdents = tmpfs_getdents,
+    .mkdir    = tmpfs_mkdir,
+    .stat     = tmpfs_stat,
+    .fstat    = tmpfs_fstat,
+    // No .identify: the data is already in memory, the page cache would only copy it
+    .next     = NULL
+};
+
+int tmpfs_register_driver(void)
+{
+    if (!tmpfs_node_cache) {
+        tmpfs_node_cache = slab_create("tmpfs_node_t", sizeof(tmpfs_node_t), 0, 0, NULL, NULL);
+        if (!tmpfs_node_cache) {
+            terminal_write("[tmpfs] Error: Failed to create node cache.\n");
+            return FS_ERR_OUT_OF_MEMORY;
+        }
+    }
+    int result = vfs_register_driver(&tmpfs_vfs_driver);
+    if (result != 0) terminal_printf("[tmpfs] Error: Failed to register driver (VFS error code: %d)\n", result);
+    return result;
+}
+
+void tmpfs_unregister_driver(void)
+{
+    vfs_unregister_driver(&tmpfs_vfs_driver);
+}
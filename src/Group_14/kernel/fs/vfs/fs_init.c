@@ -10,8 +10,14 @@
  #include <kernel/fs/vfs/fs_init.h>
  #include <kernel/fs/vfs/vfs.h>            // VFS core API
  #include <kernel/fs/fat/fat_core.h>           // FAT filesystem driver (needs prototypes for register/unregister)
+ #include <kernel/fs/tmpfs/tmpfs.h>         // In-memory filesystem for /tmp
+ #include <kernel/fs/initramfs/initramfs.h> // Boot archive on /initrd
+ #include <kernel/fs/procfs/procfs.h>       // Kernel statistics on /proc
  #include <kernel/drivers/storage/disk.h>           // Disk device abstraction
+ #include <kernel/drivers/storage/block_device.h>   // ata_channels_init()
+ #include <kernel/drivers/storage/ahci.h>           // ahci_init()
  #include <kernel/drivers/storage/buffer_cache.h>   // Buffer cache registration/API
+ #include <kernel/memory/page_cache.h>     // page_cache_init()
  #include <kernel/drivers/display/terminal.h>       // Kernel logging/debugging
  #include <kernel/fs/vfs/fs_errno.h>       // Filesystem error codes
  #include <kernel/fs/vfs/fs_config.h>   // Not including as ROOT_* defines are missing
@@ -53,11 +59,13 @@
       int ret = FS_SUCCESS;
   
       // 1. Initialize Buffer Cache (Should happen before disk registration)
-      //    Assuming buffer_cache_init() is called elsewhere during kernel boot.
+      buffer_cache_init();
+      page_cache_init();
   
       // 2. Initialize VFS Layer
       terminal_write("[FS_INIT] Initializing VFS layer...\n");
       vfs_init(); // Initialize mount table, file descriptor table etc.
+      sys_file_cache_init();
   
       // 3. Register Filesystem Drivers
       terminal_write("[FS_INIT] Registering FAT filesystem driver...\n");
@@ -69,6 +77,31 @@
       }
       terminal_write("[FS_INIT] FAT driver registered successfully.\n");
   
+      ret = tmpfs_register_driver();
+      if (ret != FS_SUCCESS) {
+          terminal_printf("[FS_INIT] Error: tmpfs driver registration failed (code %d).\n", ret);
+          fat_unregister_driver();
+          vfs_shutdown();
+          return ret;
+      }
+      ret = initramfs_register_driver();
+      if (ret != FS_SUCCESS) {
+          terminal_printf("[FS_INIT] Error: initramfs driver registration failed (code %d).\n", ret);
+          tmpfs_unregister_driver();
+          fat_unregister_driver();
+          vfs_shutdown();
+          return ret;
+      }
+      ret = procfs_register_driver();
+      if (ret != FS_SUCCESS) {
+          terminal_printf("[FS_INIT] Error: procfs driver registration failed (code %d).\n", ret);
+          initramfs_unregister_driver();
+          tmpfs_unregister_driver();
+          fat_unregister_driver();
+          vfs_shutdown();
+          return ret;
+      }
+ 
       // Add registration for other potential FS drivers here...
   
       // 4. Initialize and Register the Root Disk Device
@@ -82,6 +115,9 @@
            return FS_ERR_INVALID_PARAM;
       }
   
+      ata_channels_init(); // Channel locks and DMA engines, before any drive is probed
+      ahci_init();         // SATA disks as sda, sdb, ...
+ 
       terminal_printf("[FS_INIT Debug] KBC Status before disk_init: 0x%x\n", inb(KBC_STATUS_PORT));
       // *** FIRST (and only) disk_init call for the root disk ***
       ret = disk_init(&s_root_disk, root_device_name);
@@ -125,6 +161,22 @@
           return ret; // Propagate mount error
       }
   
+      // 6. Scratch space in memory; the system still works from disk without it
+      ret = vfs_mount(TMPFS_MOUNT_POINT, TMPFS_FS_NAME, "tmpfs");
+      if (ret != FS_SUCCESS) {
+          terminal_printf("[FS_INIT] Warning: Failed to mount tmpfs on %s (code %d).\n", TMPFS_MOUNT_POINT, ret);
+      }
+      if (initramfs_present()) {
+          ret = vfs_mount(INITRAMFS_MOUNT_POINT, INITRAMFS_FS_NAME, "initramfs");
+          if (ret != FS_SUCCESS) {
+              terminal_printf("[FS_INIT] Warning: Failed to mount initramfs on %s (code %d).\n", INITRAMFS_MOUNT_POINT, ret);
+          }
+      }
+      ret = vfs_mount(PROCFS_MOUNT_POINT, PROCFS_FS_NAME, "proc");
+      if (ret != FS_SUCCESS) {
+          terminal_printf("[FS_INIT] Warning: Failed to mount procfs on %s (code %d).\n", PROCFS_MOUNT_POINT, ret);
+      }
+ 
       s_fs_initialized = true;
       terminal_write("[FS_INIT] File system initialization complete.\n");
       terminal_write("[FS_INIT] Current mount points:\n");
@@ -160,6 +212,17 @@
      terminal_write("[FS_SHUTDOWN] Shutting down file system...\n");
      int final_ret = FS_SUCCESS; // Track if any step fails
  
+     // 1. Unmount /tmp, /initrd and /proc first: the root cannot go while a mount is nested below it
+     if (mount_table_find(TMPFS_MOUNT_POINT) && vfs_unmount(TMPFS_MOUNT_POINT) != FS_SUCCESS) {
+         terminal_write("[FS_SHUTDOWN] Warning: tmpfs unmount failed (files still open?).\n");
+     }
+     if (mount_table_find(INITRAMFS_MOUNT_POINT) && vfs_unmount(INITRAMFS_MOUNT_POINT) != FS_SUCCESS) {
+         terminal_write("[FS_SHUTDOWN] Warning: initramfs unmount failed (files still open?).\n");
+     }
+     if (mount_table_find(PROCFS_MOUNT_POINT) && vfs_unmount(PROCFS_MOUNT_POINT) != FS_SUCCESS) {
+         terminal_write("[FS_SHUTDOWN] Warning: procfs unmount failed (files still open?).\n");
+     }
+ 
      // 1. Unmount Root Filesystem (and implicitly any others via VFS shutdown)
      terminal_write("[FS_SHUTDOWN] Unmounting root filesystem...\n");
      int unmount_result = vfs_unmount_root(); // Should handle unmounting "/"
@@ -172,7 +235,9 @@
      // 2. Unregister Filesystem Drivers
      terminal_write("[FS_SHUTDOWN] Unregistering FAT driver...\n");
      fat_unregister_driver(); // Calls function declared in fat.h, implemented in fat_core.c
-     // Unregister other drivers here...
+     tmpfs_unregister_driver();
+     initramfs_unregister_driver();
+     procfs_unregister_driver();
  
      // 3. Unregister Disks from Buffer Cache (Optional but good practice)
      // if (buffer_unregister_disk) { // Check if function exists
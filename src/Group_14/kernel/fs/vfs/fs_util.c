@@ -1,4 +1,5 @@
 #include <kernel/fs/vfs/fs_util.h>
+#include <kernel/fs/vfs/path_walk.h>
 #include <kernel/lib/string.h>  // Your custom string functions (e.g., strlen, strcpy, strcmp, strrchr, strtok)
 #include <kernel/core/types.h> 
 /*----------------------------------------------------------------------------
@@ -17,7 +18,8 @@ bool fs_util_is_absolute(const char *path) {
  *----------------------------------------------------------------------------
  * This function normalizes a file path. It removes redundant slashes and
  * resolves the special components "." (current directory) and ".." (parent).
- * The algorithm uses a simple stack-like approach.
+ * The components come from path_walk, which already resolves both, so this
+ * only joins them.
  *----------------------------------------------------------------------------
  */
 int fs_util_normalize_path(const char *path, char *normalized, size_t max_len) {
@@ -25,70 +27,29 @@ int fs_util_normalize_path(const char *path, char *normalized, size_t max_len) {
         return -1;
     }
 
-    // Temporary buffer for tokenization; assumes FS_MAX_PATH_LENGTH is sufficient.
-    char temp[4096];
-    size_t path_len = strlen(path);
-    if (path_len >= sizeof(temp)) {
-        return -1;
-    }
-    strcpy(temp, path);
-
-    // Array of pointers for components (maximum possible components)
-    char *components[4096 / 2];
-    size_t comp_count = 0;
-
-    // Tokenize using '/' as delimiter.
-    // Note: If you have your own strtok implementation in your libc, use that.
-    char *token = strtok(temp, "/");
-    while (token != NULL) {
-        if (strcmp(token, ".") == 0) {
-            // Skip current directory markers.
-        } else if (strcmp(token, "..") == 0) {
-            if (comp_count > 0) {
-                comp_count--; // Pop last component
-            }
-        } else {
-            components[comp_count++] = token;
-        }
-        token = strtok(NULL, "/");
-    }
-
-    // Reconstruct the normalized path.
     size_t pos = 0;
-    if (fs_util_is_absolute(path)) {
-        if (pos < max_len - 1) {
-            normalized[pos++] = '/';
-        } else {
+    bool absolute = fs_util_is_absolute(path);
+    path_walk_t walk;
+    path_comp_t comp;
+    path_walk_init(&walk, path);
+    while (path_walk_next(&walk, &comp)) {
+        bool slash = absolute || pos > 0;
+        if (pos + slash + comp.len >= max_len) {
             return -1;
         }
+        if (slash) normalized[pos++] = '/';
+        memcpy(&normalized[pos], comp.name, comp.len);
+        pos += comp.len;
     }
 
-    for (size_t i = 0; i < comp_count; i++) {
-        size_t token_len = strlen(components[i]);
-        if (pos + token_len >= max_len - 1) {
-            return -1;
-        }
-        strcpy(&normalized[pos], components[i]);
-        pos += token_len;
-        if (i < comp_count - 1) {
-            if (pos < max_len - 1) {
-                normalized[pos++] = '/';
-            } else {
-                return -1;
-            }
-        }
-    }
-
-    // Ensure the result is null-terminated.
-    normalized[pos] = '\0';
-
     // Special case: empty normalized path means root.
     if (pos == 0) {
         if (max_len < 2) return -1;
-        normalized[0] = '/';
-        normalized[1] = '\0';
+        normalized[pos++] = '/';
     }
 
+    // Ensure the result is null-terminated.
+    normalized[pos] = '\0';
     return 0;
 }
 
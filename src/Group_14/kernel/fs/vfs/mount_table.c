@@ -3,25 +3,218 @@
  *
  * Provides thread-safe operations to add, remove, find, and list mount points.
  * Ensures proper memory management for mount point strings.
+ *
+ * Besides the list (kept for listing and unmount-all), mount points are held
+ * in a tree of path components, so resolving a path to its mount costs one
+ * step per component of the path, whatever the number of mounts. Paths are
+ * split with path_walk: "/mnt/x/../y" finds the mount of "/mnt/y".
+ *
+ * Lookups run on every open, mounts change rarely: readers walk both
+ * structures under RCU (rcu.h) with no lock, writers copy what they change.
  */
 
  #include <kernel/fs/vfs/mount_table.h>
  #include <kernel/fs/vfs/mount.h>          // For mount_t definition
  #include <kernel/memory/kmalloc.h>        // For memory allocation (kmalloc/kfree)
  #include <kernel/drivers/display/terminal.h>       // For logging/debug output
+ #include <kernel/drivers/display/serial.h>         // serial_printf
  #include <kernel/lib/string.h>         // For strcmp
  #include <kernel/core/types.h>
- #include <kernel/sync/spinlock.h>       // For spinlock synchronization
+ #include <kernel/sync/spinlock.h>       // Serializes writers
+ #include <kernel/sync/rcu.h>            // Lookups take no lock at all
  #include <kernel/fs/vfs/fs_errno.h>       // For FS_ERR_* error codes
+ #include <kernel/fs/vfs/path_walk.h>      // Components, "." and ".." resolved in place
  
  // --- Globals ---
  
- // Head of the singly linked list of mount points
+ // Head of the singly linked list of mount points (RCU)
  static mount_t *g_mount_list_head = NULL;
  
- // Spinlock to protect access to the global mount list
+ // Serializes add and remove. Readers (lookups, listing) use RCU instead:
+ // writers never change anything a reader can reach in place, but publish
+ // a new copy and free the old one after a grace period.
  static spinlock_t g_mount_table_lock;
  
+ struct mount_node;
+ 
+ // A node's children, sorted by name (byte order, shorter first on a tie).
+ // Replaced as a whole on every add or remove, never edited in place.
+ typedef struct mount_children {
+     uint32_t                count;
+     struct mount_children  *retired_next;  // Writer's list of copies to free
+     struct mount_node      *nodes[];
+ } mount_children_t;
+ 
+ // One path component of a mount point; a node with a mount ends one.
+ typedef struct mount_node {
+     char               *name;          // Component (heap-allocated); NULL for the root
+     size_t              name_len;
+     mount_t            *mount;         // Mounted exactly here, or NULL (RCU)
+     mount_children_t   *children;      // NULL without children (RCU)
+     struct mount_node  *retired_next;  // Writer's list of pruned nodes to free
+ } mount_node_t;
+ 
+ // What a writer unlinked; freed once no reader can still see it
+ typedef struct {
+     mount_node_t     *nodes;
+     mount_children_t *arrays;
+     mount_t          *mount;
+ } mount_retired_t;
+ 
+ // "/": the root of the component tree
+ static mount_node_t g_mount_root;
+ 
+ // --- Component Tree ---
+ 
+ static int mount_component_cmp(const mount_node_t *node, const char *name, size_t len) {
+     size_t common = (node->name_len < len) ? node->name_len : len;
+     int c = memcmp(node->name, name, common);
+     if (c != 0) return c;
+     return (node->name_len < len) ? -1 : (node->name_len > len);
+ }
+ 
+ /**
+  * @brief Binary-searches @p node's children for a component. Safe in a
+  * read section and under the writer lock.
+  * @param pos_out Receives the child's index, or where it would be inserted.
+  */
+ static mount_node_t *mount_node_child(const mount_node_t *node, const char *name, size_t len, uint32_t *pos_out) {
+     const mount_children_t *kids = rcu_dereference(node->children);
+     uint32_t lo = 0, hi = kids ? kids->count : 0;
+     while (lo < hi) {
+         uint32_t mid = (lo + hi) / 2;
+         int c = mount_component_cmp(kids->nodes[mid], name, len);
+         if (c == 0) {
+             if (pos_out) *pos_out = mid;
+             return kids->nodes[mid];
+         }
+         if (c < 0) lo = mid + 1; else hi = mid;
+     }
+     if (pos_out) *pos_out = lo;
+     return NULL;
+ }
+ 
+ /**
+  * @brief Publishes @p node's children with @p add inserted at @p pos (when
+  * not NULL) or the child at @p pos removed. The old array goes to @p retired.
+  * @return false if out of memory; nothing changed then.
+  */
+ static bool mount_node_set_children(mount_node_t *node, uint32_t pos, mount_node_t *add, mount_retired_t *retired) {
+     mount_children_t *old = node->children;
+     uint32_t count = old ? old->count : 0;
+     uint32_t new_count = add ? count + 1 : count - 1;
+     mount_children_t *kids = NULL;
+     if (new_count) {
+         kids = kmalloc(sizeof(mount_children_t) + new_count * sizeof(mount_node_t *));
+         if (!kids) return false;
+         kids->count = new_count;
+         kids->retired_next = NULL;
+         if (pos) memcpy(kids->nodes, old->nodes, pos * sizeof(mount_node_t *));
+         if (add) {
+             kids->nodes[pos] = add;
+             memcpy(&kids->nodes[pos + 1], &old->nodes[pos], (count - pos) * sizeof(mount_node_t *));
+         } else {
+             memcpy(&kids->nodes[pos], &old->nodes[pos + 1], (count - pos - 1) * sizeof(mount_node_t *));
+         }
+     }
+     rcu_assign_pointer(node->children, kids);
+     if (old) {
+         old->retired_next = retired->arrays;
+         retired->arrays = old;
+     }
+     return true;
+ }
+ 
+ /** @brief Adds an empty child for a component at @p pos. @return It, or NULL if out of memory. */
+ static mount_node_t *mount_node_insert(mount_node_t *node, uint32_t pos, const char *name, size_t len,
+                                        mount_retired_t *retired) {
+     mount_node_t *child = kmalloc(sizeof(mount_node_t));
+     char *child_name = kmalloc(len + 1);
+     if (!child || !child_name) {
+         kfree(child);
+         kfree(child_name);
+         return NULL;
+     }
+     memset(child, 0, sizeof(*child));
+     memcpy(child_name, name, len);
+     child_name[len] = '\0';
+     child->name = child_name;
+     child->name_len = len;
+     // The child is complete before the array that makes it reachable is published
+     if (!mount_node_set_children(node, pos, child, retired)) {
+         kfree(child_name);
+         kfree(child);
+         return NULL;
+     }
+     return child;
+ }
+ 
+ /**
+  * @brief The node for a mount point path, or NULL if it has none.
+  * With @p create, missing nodes are added (NULL then means out of memory).
+  */
+ static mount_node_t *mount_node_walk(const char *mount_point, bool create, mount_retired_t *retired) {
+     mount_node_t *node = &g_mount_root;
+     path_walk_t walk;
+     path_comp_t c;
+     path_walk_init(&walk, mount_point);
+     while (path_walk_next(&walk, &c)) {
+         uint32_t pos;
+         mount_node_t *child = mount_node_child(node, c.name, c.len, &pos);
+         if (!child && create) child = mount_node_insert(node, pos, c.name, c.len, retired);
+         if (!child) return NULL;
+         node = child;
+     }
+     return node;
+ }
+ 
+ /**
+  * @brief Unlinks the nodes below @p node along @p path that no longer lead
+  * to a mount, handing them to @p retired. @return true if @p node itself
+  * is now unused.
+  */
+ static bool mount_node_prune(mount_node_t *node, const char *path, mount_retired_t *retired) {
+     path_walk_t walk;
+     path_comp_t c;
+     path_walk_init(&walk, path);
+     if (path_walk_next(&walk, &c)) {
+         uint32_t pos;
+         mount_node_t *child = mount_node_child(node, c.name, c.len, &pos);
+         // Out of memory for the smaller array only leaves an empty node behind
+         if (child && mount_node_prune(child, path_walk_rest(&walk), retired) &&
+             mount_node_set_children(node, pos, NULL, retired)) {
+             child->retired_next = retired->nodes;
+             retired->nodes = child;
+         }
+     }
+     return node != &g_mount_root && !node->mount && !node->children;
+ }
+ 
+ /**
+  * @brief Frees what a writer unlinked, after every reader that may still
+  * hold it is done. Call without the writer lock.
+  */
+ static void mount_retired_free(mount_retired_t *retired) {
+     if (!retired->nodes && !retired->arrays && !retired->mount) return;
+     synchronize_rcu();
+     while (retired->arrays) {
+         mount_children_t *next = retired->arrays->retired_next;
+         kfree(retired->arrays);
+         retired->arrays = next;
+     }
+     while (retired->nodes) {
+         mount_node_t *next = retired->nodes->retired_next;
+         kfree(retired->nodes->name);
+         kfree(retired->nodes);
+         retired->nodes = next;
+     }
+     if (retired->mount) {
+         kfree((void *)retired->mount->mount_point); // Cast away constness for kfree
+         kfree(retired->mount);
+         retired->mount = NULL;
+     }
+ }
+ 
  // --- Initialization ---
  
  /**
@@ -30,6 +223,7 @@
   */
  void mount_table_init(void) {
      g_mount_list_head = NULL;
+     memset(&g_mount_root, 0, sizeof(g_mount_root));
      spinlock_init(&g_mount_table_lock);
      terminal_write("[MountTable] Initialized.\n");
  }
@@ -52,26 +246,32 @@
          return -FS_ERR_INVALID_PARAM;
      }
  
+     mount_retired_t retired = { NULL, NULL, NULL };
      uintptr_t irq_flags = spinlock_acquire_irqsave(&g_mount_table_lock);
  
-     // Check for duplicate mount point
-     mount_t *iter = g_mount_list_head;
-     while (iter) {
-         if (strcmp(iter->mount_point, mnt->mount_point) == 0) {
-             spinlock_release_irqrestore(&g_mount_table_lock, irq_flags);
-             serial_printf("[MountTable] Error: Mount point '%s' already exists.\n", mnt->mount_point);
-             // Caller is responsible for freeing the passed 'mnt' and its 'mount_point' string
-             // if adding failed due to duplication.
-             return -FS_ERR_FILE_EXISTS;
+     // Check for duplicate mount point ("/mnt" and "/mnt/" name the same node)
+     mount_node_t *node = mount_node_walk(mnt->mount_point, true, &retired);
+     if (!node || node->mount) {
+         if (!node) mount_node_prune(&g_mount_root, mnt->mount_point, &retired); // Drop the part that was added
+         spinlock_release_irqrestore(&g_mount_table_lock, irq_flags);
+         mount_retired_free(&retired);
+         if (!node) {
+             serial_printf("[MountTable] Error: Out of memory adding mount point '%s'.\n", mnt->mount_point);
+             return -FS_ERR_OUT_OF_MEMORY;
          }
-         iter = iter->next;
+         serial_printf("[MountTable] Error: Mount point '%s' already exists.\n", mnt->mount_point);
+         // Caller is responsible for freeing the passed 'mnt' and its 'mount_point' string
+         // if adding failed due to duplication.
+         return -FS_ERR_FILE_EXISTS;
      }
  
-     // Add to front of the list
+     // Add to front of the list; mnt is complete before either link publishes it
      mnt->next = g_mount_list_head;
-     g_mount_list_head = mnt;
+     rcu_assign_pointer(node->mount, mnt);
+     rcu_assign_pointer(g_mount_list_head, mnt);
  
      spinlock_release_irqrestore(&g_mount_table_lock, irq_flags);
+     mount_retired_free(&retired); // Children arrays replaced on the way down
  
      serial_printf("[MountTable] Added mount: '%s' -> %s\n", mnt->mount_point, mnt->fs_name);
      return FS_SUCCESS;
@@ -79,7 +279,8 @@
  
  /**
   * @brief Removes a mount entry identified by the given mount point string.
-  * Frees the mount_t structure AND the dynamically allocated mount_point string.
+  * Frees the mount_t structure AND the dynamically allocated mount_point
+  * string, after a grace period: lookups that found it may still read it.
   *
   * @param mount_point The mount point string (e.g., "/").
   * @return FS_SUCCESS on success, FS_ERR_NOT_FOUND if not found, or other error code.
@@ -91,41 +292,37 @@
      }
  
      int result = -FS_ERR_NOT_FOUND; // Assume not found initially
+     mount_retired_t retired = { NULL, NULL, NULL };
      uintptr_t irq_flags = spinlock_acquire_irqsave(&g_mount_table_lock);
  
+     mount_node_t *node = mount_node_walk(mount_point, false, &retired);
+     mount_t *target = node ? node->mount : NULL;
      mount_t **prev_next_ptr = &g_mount_list_head;
      mount_t *curr = g_mount_list_head;
  
-     while (curr) {
-         if (strcmp(curr->mount_point, mount_point) == 0) {
-             // Found the entry
-             *prev_next_ptr = curr->next; // Unlink from list
- 
-             // IMPORTANT: Free the allocated mount_point string first
-             // Check for NULL before freeing, although mount_table_add validates it.
-             if (curr->mount_point) {
-                 kfree((void *)curr->mount_point); // Cast away constness for kfree
-             } else {
-                  serial_printf("[MountTable] Warning: Mount entry being removed has NULL mount_point string.\n");
-             }
- 
-             // Free the mount_t structure itself
-             kfree(curr);
- 
-             serial_printf("[MountTable] Removed mount: '%s'\n", mount_point);
+     while (curr && target) {
+         if (curr == target) {
+             // Unlink; a reader standing on curr still finds the rest through curr->next
+             rcu_assign_pointer(*prev_next_ptr, curr->next);
+             rcu_assign_pointer(node->mount, NULL);
+             mount_node_prune(&g_mount_root, mount_point, &retired);
+             retired.mount = curr;
              result = FS_SUCCESS;
-             goto exit_remove; // Exit loop once found and removed
+             break;
          }
          prev_next_ptr = &curr->next;
          curr = curr->next;
      }
  
- exit_remove:
      spinlock_release_irqrestore(&g_mount_table_lock, irq_flags);
  
      if (result == -FS_ERR_NOT_FOUND) {
           serial_printf("[MountTable] Mount point '%s' not found for removal.\n", mount_point);
+     } else {
+          // mount_point may be the entry's own string, which is freed below
+          serial_printf("[MountTable] Removed mount: '%s'\n", mount_point);
      }
+     mount_retired_free(&retired);
      return result;
  }
  
@@ -140,25 +337,57 @@
      // If NULL is passed, conceptually return the list head for iteration.
      // This is a slight abuse of the function's name, but avoids needing a separate getter.
      if (mount_point == NULL) {
-          // Return head without locking - RACY! Caller beware.
-          // A safer approach would require locking or a dedicated getter.
-          return g_mount_list_head;
+          // Return head without a read section - RACY! Caller beware.
+          return rcu_dereference(g_mount_list_head);
      }
  
-     mount_t *found = NULL;
-     uintptr_t irq_flags = spinlock_acquire_irqsave(&g_mount_table_lock);
+     rcu_read_lock();
+     mount_node_t *node = &g_mount_root;
+     path_walk_t walk;
+     path_comp_t c;
+     path_walk_init(&walk, mount_point);
+     while (node && path_walk_next(&walk, &c)) {
+         node = mount_node_child(node, c.name, c.len, NULL);
+     }
+     mount_t *found = node ? rcu_dereference(node->mount) : NULL;
+     rcu_read_unlock();
+     return found;
+ }
  
-     mount_t *iter = g_mount_list_head;
-     while (iter) {
-         if (strcmp(iter->mount_point, mount_point) == 0) {
-             found = iter; // Found the entry
-             break;
+ /**
+  * @brief Finds the most specific (longest matching prefix) mount for an absolute path.
+  * Walks the component tree once, remembering the deepest mount passed. Runs
+  * in an RCU read section: no lock, no shared write, so lookups on different
+  * CPUs never touch each other's cache lines.
+  *
+  * @param path Absolute path (e.g., "/mnt/data/file.txt").
+  * @param prefix_len_out If not NULL, receives how many bytes of @p path the
+  *        mount point covers (1 for "/"; else up to its last component).
+  * @return The best matching mount entry, or NULL if none covers the path.
+  */
+ mount_t *mount_table_find_best(const char *path, size_t *prefix_len_out) {
+     if (!path || path[0] != '/') return NULL;
+ 
+     rcu_read_lock();
+     mount_node_t *node = &g_mount_root;
+     mount_t *best_match = rcu_dereference(node->mount);
+     size_t best_len = 1;
+     path_walk_t walk;
+     path_comp_t c;
+     path_walk_init(&walk, path);
+     while (path_walk_next(&walk, &c)) {
+         node = mount_node_child(node, c.name, c.len, NULL);
+         if (!node) break;
+         mount_t *mnt = rcu_dereference(node->mount);
+         if (mnt) {
+             best_match = mnt;
+             best_len = (size_t)(path_walk_rest(&walk) - path);
          }
-         iter = iter->next;
      }
+     rcu_read_unlock();
  
-     spinlock_release_irqrestore(&g_mount_table_lock, irq_flags);
-     return found;
+     if (best_match && prefix_len_out) *prefix_len_out = best_len;
+     return best_match;
  }
  
  /**
@@ -168,8 +397,8 @@
  void mount_table_list(void) {
      terminal_write("[MountTable] Current Mount Entries:\n");
  
-     uintptr_t irq_flags = spinlock_acquire_irqsave(&g_mount_table_lock);
-     mount_t *iter = g_mount_list_head;
+     rcu_read_lock();
+     mount_t *iter = rcu_dereference(g_mount_list_head);
  
      if (!iter) {
          terminal_write("  (none)\n");
@@ -181,25 +410,23 @@
              terminal_printf("     FS Name:     %s\n", iter->fs_name ? iter->fs_name : "<NULL>");
              terminal_printf("     FS Context:  0x%p\n", iter->fs_context);
              // terminal_printf("     Next Ptr:    0x%p\n", iter->next); // Debug pointer itself
-             iter = iter->next;
+             iter = rcu_dereference(iter->next);
          }
          if (count == 0) { // Should match (!iter) case, but double-check
               terminal_write("  (none)\n");
          }
      }
  
-     spinlock_release_irqrestore(&g_mount_table_lock, irq_flags);
+     rcu_read_unlock();
  }
  
  /**
   * @brief Gets the head of the mount list for external iteration.
-  * NOTE: Iterating this list without external locking is inherently unsafe
-  * if entries can be added/removed concurrently.
+  * NOTE: The entries stay valid only inside an RCU read section (rcu.h)
+  * or while the caller otherwise knows they cannot be unmounted.
   *
   * @return Pointer to the first mount_t entry, or NULL if the list is empty.
   */
  mount_t *mount_table_get_head(void) {
-     // We could acquire/release lock here, but it doesn't protect the caller during iteration.
-     // Returning the raw head pointer. Caller must be aware of concurrency implications.
-     return g_mount_list_head;
+     return rcu_dereference(g_mount_list_head);
  }
\ No newline at end of file
@@ -0,0 +1,56 @@
+/**
+ * @file path_walk.c
+ * @brief Lexical path component iterator; see path_walk.h.
+ */
+
+#include <kernel/fs/vfs/path_walk.h>
+
+/** @brief The raw component at or after @p p (any spelling), or NULL at the end. */
+static const char *path_raw_component(const char *p, size_t *len_out) {
+    while (*p == '/') p++;
+    if (*p == '\0') return NULL;
+    size_t len = 0;
+    while (p[len] && p[len] != '/') len++;
+    *len_out = len;
+    return p;
+}
+
+static inline bool path_is_dot(const char *c, size_t len) {
+    return len == 1 && c[0] == '.';
+}
+
+static inline bool path_is_dotdot(const char *c, size_t len) {
+    return len == 2 && c[0] == '.' && c[1] == '.';
+}
+
+/** @brief True if a ".." in @p rest climbs above the point where it starts. */
+static bool path_climbs_out(const char *rest) {
+    int depth = 0;
+    size_t len;
+    for (const char *c = path_raw_component(rest, &len); c; c = path_raw_component(c + len, &len)) {
+        if (path_is_dot(c, len)) continue;
+        if (!path_is_dotdot(c, len)) depth++;
+        else if (--depth < 0) return true;
+    }
+    return false;
+}
+
+bool path_walk_next(path_walk_t *w, path_comp_t *out) {
+    size_t len;
+    for (const char *c = path_raw_component(w->next, &len); c; c = path_raw_component(c + len, &len)) {
+        // Every ".." either cancels a component skipped here or is above the start
+        if (path_is_dot(c, len) || path_is_dotdot(c, len)) continue;
+        if (path_climbs_out(c + len)) continue; // Cancelled by a later ".."
+        out->name = c;
+        out->len = len;
+        w->next = c + len;
+        return true;
+    }
+    return false;
+}
+
+bool path_walk_done(const path_walk_t *w) {
+    path_walk_t probe = *w;
+    path_comp_t c;
+    return !path_walk_next(&probe, &c);
+}
@@ -0,0 +1,371 @@
+/**
+ * @file pipe.c
+ * @brief Anonymous pipes over a ring of page frames (see pipe.h).
+ *
+ * The mutex serializes every ring change and the copies into and out of
+ * ring pages, which may fault on user memory and so must be able to sleep.
+ * head, tail, readers and writers are also read without it, as wakeup
+ * conditions and by poll(), which runs with interrupts off; the real checks
+ * are repeated under the mutex.
+ */
+
+#include <kernel/fs/vfs/pipe.h>
+#include <kernel/fs/vfs/poll.h>
+#include <kernel/fs/vfs/sys_file.h>
+#include <kernel/fs/vfs/fs_errno.h>
+#include <kernel/memory/frame.h>
+#include <kernel/memory/kmalloc.h>
+#include <kernel/memory/paging.h>
+#include <kernel/memory/page_cache.h>
+#include <kernel/memory/uaccess.h>
+#include <kernel/sync/mutex.h>
+#include <kernel/sync/wait_queue.h>
+#include <kernel/lib/string.h>
+
+#ifndef MIN
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+
+#define PIPE_BOUNCE_SIZE 256    // Stack bounce for user copies to highmem ring pages
+
+typedef struct pipe_slot {
+    uintptr_t frame;            // Ring page (0 when the slot is free)
+    uint16_t  offset;           // First unread byte
+    uint16_t  len;              // Unread bytes
+    bool      spliced;          // A page-cache frame: read-only, never appended to
+} pipe_slot_t;
+
+typedef struct pipe {
+    kmutex_t          mutex;
+    wait_queue_t      read_wait;    // Readers waiting for data or the last writer's close
+    wait_queue_t      write_wait;   // Writers waiting for room or the last reader's close
+    pipe_slot_t       slots[PIPE_RING_SLOTS];
+    volatile uint32_t head;         // Slots ever filled (free-running; index with % PIPE_RING_SLOTS)
+    volatile uint32_t tail;         // Slots ever drained
+    volatile uint32_t readers;      // Open read ends
+    volatile uint32_t writers;      // Open write ends
+    uintptr_t         spare;        // One drained page kept for the next write
+} pipe_t;
+
+static int pipe_close(file_t *file);
+static int pipe_poll(file_t *file);
+static int pipe_fstat(file_t *file, struct vfs_stat *st);
+
+// Never registered or mounted: pipe_create() builds the vnodes itself.
+// read/write stay NULL since vfs_read() calls them under file->lock and
+// pipes block; sys_file routes pipe I/O to pipe_read()/pipe_write().
+static vfs_driver_t s_pipe_driver = {
+    .fs_name = "pipefs",
+    .close   = pipe_close,
+    .fstat   = pipe_fstat,
+    .poll    = pipe_poll,
+};
+
+static inline pipe_t *file_pipe(const file_t *file) {
+    return (pipe_t *)file->vnode->data;
+}
+
+static inline pipe_slot_t *pipe_slot(pipe_t *p, uint32_t n) {
+    return &p->slots[n % PIPE_RING_SLOTS];
+}
+
+/** @brief Bytes a write can add without blocking. */
+static size_t pipe_space(pipe_t *p) {
+    uint32_t used = p->head - p->tail;
+    size_t space = (size_t)(PIPE_RING_SLOTS - used) * PAGE_SIZE;
+    if (used) {
+        const pipe_slot_t *last = pipe_slot(p, p->head - 1);
+        if (!last->spliced) space += PAGE_SIZE - (last->offset + last->len);
+    }
+    return space;
+}
+
+static void pipe_wake(wait_queue_t *wq) {
+    if (wait_queue_active(wq)) wake_up_all(wq);
+    vfs_poll_notify();
+}
+
+/**
+ * @brief Copies @p len bytes between ring page @p frame at @p off and
+ * @p buf. User copies may fault and sleep, which kmap_atomic() forbids, so
+ * for highmem frames they go through a small bounce buffer.
+ * @return 0, or -EFAULT if the user range faulted.
+ */
+static int pipe_copy(uintptr_t frame, uint32_t off, void *buf, size_t len, bool to_pipe, bool user) {
+    if (!user) {
+        uint8_t *page = (uint8_t *)kmap_atomic(frame);
+        if (to_pipe) memcpy(page + off, buf, len);
+        else memcpy(buf, page + off, len);
+        kunmap_atomic(page);
+        return 0;
+    }
+    if (paging_phys_is_direct(frame)) {
+        uint8_t *page = (uint8_t *)paging_phys_to_virt(frame) + off;
+        size_t left = to_pipe ? __copy_from_user((kernelptr_t)page, (const_userptr_t)buf, len)
+                              : __copy_to_user((userptr_t)buf, (const_kernelptr_t)page, len);
+        return left ? -EFAULT : 0;
+    }
+
+    uint8_t bounce[PIPE_BOUNCE_SIZE];
+    for (size_t done = 0; done < len; ) {
+        size_t n = MIN(sizeof(bounce), len - done);
+        uint8_t *ubuf = (uint8_t *)buf + done;
+        if (to_pipe && __copy_from_user((kernelptr_t)bounce, (const_userptr_t)ubuf, n) != 0) return -EFAULT;
+        uint8_t *page = (uint8_t *)kmap_atomic(frame);
+        if (to_pipe) memcpy(page + off + done, bounce, n);
+        else memcpy(bounce, page + off + done, n);
+        kunmap_atomic(page);
+        if (!to_pipe && __copy_to_user((userptr_t)ubuf, (const_kernelptr_t)bounce, n) != 0) return -EFAULT;
+        done += n;
+    }
+    return 0;
+}
+
+/** @brief Frees a drained slot's page, keeping one of the pipe's own as the spare. Mutex held. */
+static void pipe_release_slot(pipe_t *p, pipe_slot_t *slot) {
+    if (!slot->spliced && !p->spare) p->spare = slot->frame;
+    else put_frame(slot->frame);
+    slot->frame = 0;
+}
+
+/**
+ * @brief Appends up to @p len bytes to the ring: first into the last page's
+ * free tail, then into fresh pages. Mutex held.
+ * @return Bytes added, or a negative errno if none were.
+ */
+static ssize_t pipe_fill(pipe_t *p, const uint8_t *src, size_t len, bool user) {
+    size_t done = 0;
+    if (p->head != p->tail) {
+        pipe_slot_t *last = pipe_slot(p, p->head - 1);
+        size_t end = (size_t)last->offset + last->len;
+        if (!last->spliced && end < PAGE_SIZE) {
+            size_t n = MIN(PAGE_SIZE - end, len);
+            if (pipe_copy(last->frame, (uint32_t)end, (void *)src, n, true, user) != 0) return -EFAULT;
+            last->len = (uint16_t)(last->len + n);
+            done = n;
+        }
+    }
+    while (done < len && p->head - p->tail < PIPE_RING_SLOTS) {
+        uintptr_t frame = p->spare;
+        p->spare = 0;
+        if (!frame) frame = frame_alloc();
+        if (!frame) return done ? (ssize_t)done : -ENOMEM;
+
+        size_t n = MIN((size_t)PAGE_SIZE, len - done);
+        if (pipe_copy(frame, 0, (void *)(src + done), n, true, user) != 0) {
+            p->spare = frame;
+            return done ? (ssize_t)done : -EFAULT;
+        }
+        pipe_slot_t *slot = pipe_slot(p, p->head);
+        slot->frame = frame;
+        slot->offset = 0;
+        slot->len = (uint16_t)n;
+        slot->spliced = false;
+        p->head++; // Published only once the page holds its bytes
+        done += n;
+    }
+    return (ssize_t)done;
+}
+
+int pipe_create(file_t **read_end, file_t **write_end) {
+    pipe_t *p = (pipe_t *)kmalloc(sizeof(pipe_t));
+    vnode_t *rnode = (vnode_t *)kmalloc(sizeof(vnode_t));
+    vnode_t *wnode = (vnode_t *)kmalloc(sizeof(vnode_t));
+    if (!p || !rnode || !wnode) goto fail;
+
+    memset(p, 0, sizeof(*p));
+    kmutex_init(&p->mutex, false);
+    wait_queue_init(&p->read_wait);
+    wait_queue_init(&p->write_wait);
+    p->readers = 1;
+    p->writers = 1;
+    rnode->data = p;
+    rnode->fs_driver = &s_pipe_driver;
+    wnode->data = p;
+    wnode->fs_driver = &s_pipe_driver;
+
+    file_t *rfile = vfs_open_vnode(rnode, O_RDONLY);
+    if (!rfile) goto fail;
+    file_t *wfile = vfs_open_vnode(wnode, O_WRONLY);
+    if (!wfile) {
+        p->writers = 0;
+        vfs_close(rfile); // Last end: frees p and rnode
+        kfree(wnode);
+        return -ENOMEM;
+    }
+    *read_end = rfile;
+    *write_end = wfile;
+    return 0;
+
+fail:
+    if (p) kfree(p);
+    if (rnode) kfree(rnode);
+    if (wnode) kfree(wnode);
+    return -ENOMEM;
+}
+
+bool pipe_is_pipe(const file_t *file) {
+    return file && file->vnode && file->vnode->fs_driver == &s_pipe_driver;
+}
+
+ssize_t pipe_read(file_t *file, void *buf, size_t len, bool user) {
+    pipe_t *p = file_pipe(file);
+    if (len == 0) return 0;
+
+    kmutex_lock(&p->mutex);
+    while (p->head == p->tail) {
+        if (p->writers == 0) {
+            kmutex_unlock(&p->mutex);
+            return 0; // End of file
+        }
+        kmutex_unlock(&p->mutex);
+        wait_event(&p->read_wait, p->head != p->tail || p->writers == 0);
+        kmutex_lock(&p->mutex);
+    }
+
+    size_t done = 0;
+    ssize_t err = 0;
+    uint32_t tail_before = p->tail;
+    while (done < len && p->tail != p->head) {
+        pipe_slot_t *slot = pipe_slot(p, p->tail);
+        size_t n = MIN((size_t)slot->len, len - done);
+        if (pipe_copy(slot->frame, slot->offset, (uint8_t *)buf + done, n, false, user) != 0) {
+            err = -EFAULT;
+            break;
+        }
+        slot->offset = (uint16_t)(slot->offset + n);
+        slot->len = (uint16_t)(slot->len - n);
+        done += n;
+        if (slot->len == 0) {
+            pipe_release_slot(p, slot);
+            p->tail++;
+        }
+    }
+    bool freed = p->tail != tail_before;
+    kmutex_unlock(&p->mutex);
+
+    if (freed) pipe_wake(&p->write_wait);
+    return done ? (ssize_t)done : err;
+}
+
+ssize_t pipe_write(file_t *file, const void *buf, size_t len, bool user) {
+    pipe_t *p = file_pipe(file);
+    // Small writes wait for room for all of it, so they land in one piece
+    size_t need = len <= PIPE_BUF ? len : 1;
+    size_t done = 0;
+    ssize_t err = 0;
+
+    kmutex_lock(&p->mutex);
+    while (done < len) {
+        if (p->readers == 0) {
+            err = -EPIPE;
+            break;
+        }
+        if (pipe_space(p) < need) {
+            kmutex_unlock(&p->mutex);
+            if (done) pipe_wake(&p->read_wait); // Let readers drain what is in before we sleep
+            wait_event(&p->write_wait, pipe_space(p) >= need || p->readers == 0);
+            kmutex_lock(&p->mutex);
+            continue;
+        }
+        ssize_t n = pipe_fill(p, (const uint8_t *)buf + done, len - done, user);
+        if (n < 0) {
+            err = n;
+            break;
+        }
+        done += (size_t)n;
+    }
+    kmutex_unlock(&p->mutex);
+
+    if (done) pipe_wake(&p->read_wait);
+    return done ? (ssize_t)done : err;
+}
+
+ssize_t pipe_splice_file(file_t *file, file_t *in, off_t *pos, size_t count) {
+    vfs_file_id_t id;
+    if (vfs_identify(in, &id) != 0 || *pos < 0) return -ENOSYS;
+    pipe_t *p = file_pipe(file);
+
+    size_t done = 0;
+    ssize_t err = 0;
+    kmutex_lock(&p->mutex);
+    while (done < count && (uint32_t)*pos < id.size) {
+        if (p->readers == 0) {
+            err = -EPIPE;
+            break;
+        }
+        if (p->head - p->tail == PIPE_RING_SLOTS) {
+            kmutex_unlock(&p->mutex);
+            if (done) pipe_wake(&p->read_wait);
+            wait_event(&p->write_wait, p->head - p->tail < PIPE_RING_SLOTS || p->readers == 0);
+            kmutex_lock(&p->mutex);
+            continue;
+        }
+
+        off_t page_off = *pos & ~(off_t)(PAGE_SIZE - 1);
+        size_t in_page = (size_t)(*pos - page_off);
+        size_t page_bytes = MIN((size_t)PAGE_SIZE, (size_t)(id.size - (uint32_t)page_off));
+        uintptr_t frame = page_cache_get_page(in, page_off, page_bytes);
+        if (!frame) {
+            if (done == 0) err = -EIO;
+            break;
+        }
+        size_t n = MIN(page_bytes - in_page, count - done);
+        pipe_slot_t *slot = pipe_slot(p, p->head);
+        slot->frame = frame; // The page cache's reference becomes the ring's
+        slot->offset = (uint16_t)in_page;
+        slot->len = (uint16_t)n;
+        slot->spliced = true;
+        p->head++;
+        *pos += (off_t)n;
+        done += n;
+    }
+    kmutex_unlock(&p->mutex);
+
+    if (done) pipe_wake(&p->read_wait);
+    return done ? (ssize_t)done : err;
+}
+
+static int pipe_close(file_t *file) {
+    pipe_t *p = file_pipe(file);
+    bool reader = (file->flags & O_ACCMODE) == O_RDONLY;
+
+    kmutex_lock(&p->mutex);
+    if (reader) p->readers--;
+    else p->writers--;
+    bool last = p->readers == 0 && p->writers == 0;
+    // The other side sees EOF or EPIPE. Woken before the unlock: once it is
+    // released the other end may close too and free the pipe
+    if (!last) pipe_wake(reader ? &p->write_wait : &p->read_wait);
+    kmutex_unlock(&p->mutex);
+    if (!last) return FS_SUCCESS;
+
+    for (uint32_t n = p->tail; n != p->head; n++) put_frame(pipe_slot(p, n)->frame);
+    if (p->spare) put_frame(p->spare);
+    kfree(p);
+    return FS_SUCCESS;
+}
+
+static int pipe_poll(file_t *file) {
+    pipe_t *p = file_pipe(file);
+    if ((file->flags & O_ACCMODE) == O_RDONLY) {
+        int mask = p->head != p->tail ? POLLIN : 0;
+        if (p->writers == 0) mask |= POLLHUP;
+        return mask;
+    }
+    if (p->readers == 0) return POLLERR;
+    return pipe_space(p) >= PIPE_BUF ? POLLOUT : 0;
+}
+
+static int pipe_fstat(file_t *file, struct vfs_stat *st) {
+    pipe_t *p = file_pipe(file);
+    kmutex_lock(&p->mutex);
+    uint32_t buffered = 0;
+    for (uint32_t n = p->tail; n != p->head; n++) buffered += pipe_slot(p, n)->len;
+    kmutex_unlock(&p->mutex);
+
+    st->st_mode = VFS_S_IFIFO | 0600;
+    st->st_size = buffered;
+    st->st_blksize = PAGE_SIZE;
+    return FS_SUCCESS;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file poll.c
+ * @brief Readiness scanning and the shared poll wait queue (see poll.h).
+ */
+
+#include <kernel/fs/vfs/poll.h>
+#include <kernel/fs/vfs/vfs.h>
+#include <kernel/fs/vfs/sys_file.h>
+#include <kernel/drivers/input/tty.h>
+#include <kernel/sync/wait_queue.h>
+#include <kernel/process/scheduler.h>
+#include <libc/stdbool.h>
+
+#define POLL_ALWAYS (POLLERR | POLLHUP | POLLNVAL) // Reported whether asked for or not
+
+static wait_queue_t s_poll_waiters;
+
+void vfs_poll_init(void) {
+    wait_queue_init(&s_poll_waiters);
+}
+
+void vfs_poll_notify(void) {
+    if (wait_queue_active(&s_poll_waiters)) wake_up_all(&s_poll_waiters);
+}
+
+/** @brief Current readiness of one descriptor (POLL* bits, not yet masked). */
+static int16_t fd_ready(int32_t fd) {
+    sys_file_t *sf = sys_file_get_fd(fd);
+    if (!sf) {
+        // The terminal descriptors have no file behind them
+        if (fd == 0) return tty_readable() ? POLLIN : 0;
+        if (fd == 1 || fd == 2) return POLLOUT;
+        return POLLNVAL;
+    }
+    int16_t mask = (int16_t)vfs_poll(sf->vfs_file);
+    sys_file_put(sf);
+    return mask;
+}
+
+/** @brief One pass over @p fds. @return Entries with non-zero revents. */
+static int poll_scan(struct pollfd *fds, uint32_t nfds) {
+    int ready = 0;
+    for (uint32_t i = 0; i < nfds; i++) {
+        fds[i].revents = 0;
+        if (fds[i].fd < 0) continue;
+        fds[i].revents = (int16_t)(fd_ready(fds[i].fd) & (fds[i].events | POLL_ALWAYS));
+        if (fds[i].revents) ready++;
+    }
+    return ready;
+}
+
+int vfs_poll_wait(struct pollfd *fds, uint32_t nfds, int32_t timeout_ms) {
+    int ready = poll_scan(fds, nfds);
+    if (ready || timeout_ms == 0) return ready;
+
+    uint32_t deadline = timeout_ms > 0 ? scheduler_get_ticks() + scheduler_ms_to_ticks((uint32_t)timeout_ms) : 0;
+    for (;;) {
+        // Queued before the rescan, so a notify between the two is not lost
+        uintptr_t irq_flags = prepare_to_wait(&s_poll_waiters);
+        ready = poll_scan(fds, nfds);
+        if (ready) {
+            finish_wait(&s_poll_waiters, irq_flags);
+            return ready;
+        }
+        bool expired = false;
+        if (timeout_ms > 0) {
+            expired = wait_queue_block_until(deadline);
+        } else {
+            schedule();
+        }
+        finish_wait(&s_poll_waiters, irq_flags);
+        if (expired) return poll_scan(fds, nfds);
+    }
+}
@@ -37,7 +37,7 @@
  * - For zero-byte files, this function returns a non-NULL pointer (minimal
  * 1-byte allocation) but sets *file_size to 0. Callers MUST check the
  * returned size.
- * - Returns NULL if any error occurs (invalid path, open failed, seek failed,
+ * - Returns NULL if any error occurs (invalid path, open failed, sizing failed,
  * size exceeds limit, allocation failed, read failed, short read).
  *
  * @param path The null-terminated path to the file within the VFS. Must not be NULL.
@@ -52,6 +52,7 @@ void *read_file(const char *path, size_t *file_size) {
     void *buffer = NULL;
     file_t *file = NULL;
     off_t size_check = -1;
+    struct vfs_stat st;
     size_t size = 0;
     int ret = 0; // Generic return code variable
 
@@ -73,12 +74,23 @@ void *read_file(const char *path, size_t *file_size) {
     }
     LOG_DEBUG("vfs_open succeeded for '%s'. file=%p", path, file);
 
-    // 3. Determine file size by seeking to the end
-    LOG_DEBUG("Seeking to end of file '%s' (file=%p)", path, file);
-    size_check = vfs_lseek(file, 0, SEEK_END);
-    if (size_check < 0) {
-        LOG_ERROR("vfs_lseek(SEEK_END) failed for '%s'. Error code: %ld", path, size_check);
-        goto cleanup;
+    // 3. Determine file size from the open file's attributes (no seeking, no disk)
+    LOG_DEBUG("Getting attributes of '%s' (file=%p)", path, file);
+    ret = vfs_fstat(file, &st);
+    if (ret == 0) {
+        size_check = (off_t)st.st_size;
+    } else {
+        // Drivers without fstat: seek to the end and back
+        size_check = vfs_lseek(file, 0, SEEK_END);
+        if (size_check < 0) {
+            LOG_ERROR("vfs_lseek(SEEK_END) failed for '%s'. Error code: %ld", path, size_check);
+            goto cleanup;
+        }
+        ret = vfs_lseek(file, 0, SEEK_SET);
+        if (ret != 0) {
+            LOG_ERROR("vfs_lseek(SEEK_SET) failed for '%s'. Error code: %d", path, ret);
+            goto cleanup;
+        }
     }
     size = (size_t)size_check;
     LOG_INFO("Determined size for '%s' is %d bytes.", path, size);
@@ -90,16 +102,7 @@ void *read_file(const char *path, size_t *file_size) {
          goto cleanup;
     }
 
-    // 5. Seek back to the beginning
-    LOG_DEBUG("Seeking to beginning of file '%s' (file=%p)", path, file);
-    ret = vfs_lseek(file, 0, SEEK_SET);
-    if (ret != 0) {
-        LOG_ERROR("vfs_lseek(SEEK_SET) failed for '%s'. Error code: %d", path, ret);
-        goto cleanup;
-    }
-    LOG_DEBUG("Seek to beginning successful for '%s'.", path);
-
-    // 6. Handle zero-byte file case
+    // 5. Handle zero-byte file case
     if (size == 0) {
         LOG_WARN("File '%s' has size 0. Returning minimal buffer.", path);
         // Allocate 1 byte to return a non-NULL pointer, clearly indicating
@@ -115,7 +118,7 @@ void *read_file(const char *path, size_t *file_size) {
         goto cleanup; // Skip the read, proceed to close and return.
     }
 
-    // 7. Allocate buffer for file content
+    // 6. Allocate buffer for file content
     LOG_DEBUG("Allocating %d bytes for '%s'.", size, path);
     buffer = kmalloc(size);
     if (!buffer) {
@@ -124,7 +127,7 @@ void *read_file(const char *path, size_t *file_size) {
     }
     LOG_DEBUG("Allocation successful for '%s', buffer=%p.", path, buffer);
 
-    // 8. Read the entire file content
+    // 7. Read the entire file content
     LOG_DEBUG("Reading %d bytes from '%s' into buffer %p.", size, path, buffer);
     ret = vfs_read(file, buffer, size);
     if (ret < 0) {
@@ -133,7 +136,7 @@ void *read_file(const char *path, size_t *file_size) {
     }
     LOG_DEBUG("vfs_read returned %d.", ret);
 
-    // 9. Check if the number of bytes read matches the expected size
+    // 8. Check if the number of bytes read matches the expected size
     if ((size_t)ret != size) {
         LOG_ERROR("Short read detected for '%s'! Expected %d bytes, but vfs_read returned %d.",
                   path, size, ret);
@@ -13,8 +13,11 @@
 
  #include <kernel/fs/vfs/sys_file.h>
  #include <kernel/fs/vfs/vfs.h>
+ #include <kernel/fs/vfs/pipe.h>    // Pipe ends bypass vfs_read/vfs_write (they block)
+ #include <kernel/memory/shm.h>     // shm_open_file()
  #include <kernel/drivers/display/terminal.h>       // For high-level console output (e.g., STDOUT)
  #include <kernel/memory/kmalloc.h>
+ #include <kernel/memory/slab.h>     // sys_file_t cache
  #include <kernel/lib/string.h>
  #include <kernel/core/types.h>
  #include <kernel/fs/vfs/fs_errno.h>       // Defines positive errno constants (EBADF, ENOENT, etc.)
@@ -43,30 +46,284 @@
  #endif
  
  
- // Internal helper to find and assign a file descriptor.
- // Assumes proc->fd_table_lock is held.
- static int assign_fd_locked(pcb_t *proc, sys_file_t *sf) {
-     for (int fd = 0; fd < MAX_FD; fd++) {
-         if (proc->fd_table[fd] == NULL) {
-             proc->fd_table[fd] = sf;
+ static slab_cache_t *s_sys_file_cache = NULL;
+
+ void sys_file_cache_init(void) {
+     if (!s_sys_file_cache) s_sys_file_cache = slab_create("sys_file_t", sizeof(sys_file_t), 0, 0, NULL, NULL);
+     if (!s_sys_file_cache) serial_write("[SysFile ERROR] Failed to create sys_file_t cache\n");
+ }
+
+ /**
+  * @brief Adds a reference to an open file (a second fd table slot, e.g. fork).
+  */
+ void sys_file_get(sys_file_t *sf) {
+     uint32_t one = 1;
+     asm volatile("lock xaddl %0, %1" : "+r"(one), "+m"(sf->refcount) : : "memory", "cc");
+ }
+
+ /**
+  * @brief Drops a reference; the last one closes the VFS file and frees @p sf.
+  * @return vfs_close()'s result for the last reference, 0 otherwise.
+  */
+ int sys_file_put(sys_file_t *sf) {
+     uint32_t old = (uint32_t)-1;
+     asm volatile("lock xaddl %0, %1" : "+r"(old), "+m"(sf->refcount) : : "memory", "cc");
+     KERNEL_ASSERT(old != 0, "sys_file_put: refcount underflow");
+     if (old != 1) return 0;
+     int vfs_ret = vfs_close(sf->vfs_file); // vfs_close handles its own internal locking.
+     slab_free(s_sys_file_cache, sf);
+     return vfs_ret;
+ }
+
+ //============================================================================
+ // Descriptor Table
+ //============================================================================
+ // Changes (install, close, grow) take proc->fd_table_lock. Lookups don't:
+ // a table only ever gets replaced by a bigger copy, never freed while the
+ // process lives, and its slots are plain word stores.
+
+ static fd_table_t *fd_table_alloc(uint32_t max_fds) {
+     size_t bytes = sizeof(fd_table_t) + max_fds * sizeof(sys_file_t *) + (max_fds / 32) * sizeof(uint32_t);
+     fd_table_t *fdt = (fd_table_t *)kmalloc(bytes);
+     if (!fdt) return NULL;
+     memset(fdt, 0, bytes);
+     fdt->max_fds = max_fds;
+     fdt->fd = (sys_file_t **)(fdt + 1);
+     fdt->open_map = (uint32_t *)(fdt->fd + max_fds);
+     return fdt;
+ }
+
+ /** @brief Frees @p fdt and the tables it replaced. */
+ static void fd_table_free(fd_table_t *fdt) {
+     while (fdt) {
+         fd_table_t *retired = fdt->retired;
+         kfree(fdt);
+         fdt = retired;
+     }
+ }
+
+ /** @brief Lowest free fd at or above @p start, or -1 if the table is full. */
+ static int fd_find_free(const fd_table_t *fdt, uint32_t start) {
+     for (uint32_t w = start / 32; w < fdt->max_fds / 32; w++) {
+         uint32_t free_bits = ~fdt->open_map[w];
+         if (w == start / 32) free_bits &= ~0u << (start % 32);
+         if (free_bits) {
+             uint32_t bit;
+             asm("bsfl %1, %0" : "=r"(bit) : "rm"(free_bits) : "cc");
+             return (int)(w * 32 + bit);
+         }
+     }
+     return -1;
+ }
+
+ /** @brief Makes the bigger @p fdt (empty) proc's table, copying the fds over. Lock held. */
+ static void fd_table_replace_locked(pcb_t *proc, fd_table_t *fdt) {
+     fd_table_t *old = proc->fdt;
+     if (old) {
+         memcpy(fdt->fd, old->fd, old->max_fds * sizeof(sys_file_t *));
+         memcpy(fdt->open_map, old->open_map, (old->max_fds / 32) * sizeof(uint32_t));
+         fdt->next_fd = old->next_fd;
+         fdt->retired = old;
+     }
+     asm volatile("" ::: "memory"); // Slots are in place before lock-free readers can see the table
+     proc->fdt = fdt;
+ }
+
+ /**
+  * @brief Installs @p sf at the lowest free fd of @p proc, growing the table
+  * (allocated outside the lock) when it is full.
+  * @return The fd, -EMFILE at MAX_FD, or -ENOMEM.
+  */
+ static int fd_install(pcb_t *proc, sys_file_t *sf) {
+     fd_table_t *spare = NULL;
+     for (;;) {
+         uintptr_t irq_flags = spinlock_acquire_irqsave(&proc->fd_table_lock);
+         fd_table_t *fdt = proc->fdt;
+         if (spare && (!fdt || spare->max_fds > fdt->max_fds)) {
+             fd_table_replace_locked(proc, spare);
+             fdt = spare;
+             spare = NULL;
+         }
+         int fd = fdt ? fd_find_free(fdt, fdt->next_fd) : -1;
+         if (fd >= 0) {
+             fdt->fd[fd] = sf;
+             fdt->open_map[fd / 32] |= 1u << (fd % 32);
+             fdt->next_fd = (uint32_t)fd + 1;
+             spinlock_release_irqrestore(&proc->fd_table_lock, irq_flags);
+             if (spare) kfree(spare); // Another open grew the table first
              SF_DETAILED_LOG("Assigned fd %d to sys_file %p", fd, sf);
              return fd;
          }
+         uint32_t want = fdt ? fdt->max_fds * 2 : FD_TABLE_MIN_FDS;
+         spinlock_release_irqrestore(&proc->fd_table_lock, irq_flags);
+
+         if (spare) kfree(spare);
+         if (want > MAX_FD) {
+             SF_LOG("No free file descriptors (EMFILE) for PID %lu", (unsigned long)proc->pid);
+             return -EMFILE;
+         }
+         spare = fd_table_alloc(want);
+         if (!spare) return -ENOMEM;
      }
-     SF_LOG("No free file descriptors (EMFILE) for PID %lu", (unsigned long)proc->pid);
-     return EMFILE; // Return positive EMFILE for internal error checking
  }
- 
- // Internal helper to retrieve a sys_file_t from an fd.
- // Assumes proc->fd_table_lock is held.
- static sys_file_t* get_sys_file_locked(pcb_t *proc, int fd) {
-     if (fd < 0 || fd >= MAX_FD || proc->fd_table[fd] == NULL) {
+
+ /**
+  * @brief The open file behind @p fd in @p proc, or NULL. The caller holds
+  * fd_table_lock: the pointer is only good until a close() can drop the fd's
+  * reference, so take one (sys_file_get_fd()) before using it unlocked.
+  */
+ static sys_file_t *fd_lookup(pcb_t *proc, int fd) {
+     fd_table_t *fdt = *(fd_table_t * volatile *)&proc->fdt;
+     if (!fdt || fd < 0 || (uint32_t)fd >= fdt->max_fds) {
          SF_DETAILED_LOG("Invalid or unassigned fd %d", fd);
          return NULL;
      }
-     return proc->fd_table[fd];
+     return ((sys_file_t * volatile *)fdt->fd)[fd];
  }
- 
+
+ /** @brief Empties slot @p fd; returns what it held (NULL if nothing). Lock held. */
+ static sys_file_t *fd_remove_locked(pcb_t *proc, int fd) {
+     fd_table_t *fdt = proc->fdt;
+     if (!fdt || fd < 0 || (uint32_t)fd >= fdt->max_fds) return NULL;
+     sys_file_t *sf = fdt->fd[fd];
+     if (!sf) return NULL;
+     fdt->fd[fd] = NULL;
+     fdt->open_map[fd / 32] &= ~(1u << (fd % 32));
+     if ((uint32_t)fd < fdt->next_fd) fdt->next_fd = (uint32_t)fd;
+     return sf;
+ }
+
+ int fd_table_clone(pcb_t *child, pcb_t *parent) {
+     for (;;) {
+         fd_table_t *src = *(fd_table_t * volatile *)&parent->fdt;
+         if (!src) return 0;
+         uint32_t max_fds = src->max_fds;
+         fd_table_t *fdt = fd_table_alloc(max_fds);
+         if (!fdt) return -ENOMEM;
+
+         uintptr_t irq_flags = spinlock_acquire_irqsave(&parent->fd_table_lock);
+         src = parent->fdt;
+         if (src->max_fds != max_fds) { // Grew meanwhile: size again
+             spinlock_release_irqrestore(&parent->fd_table_lock, irq_flags);
+             kfree(fdt);
+             continue;
+         }
+         for (uint32_t fd = 0; fd < max_fds; fd++) {
+             if (src->fd[fd]) sys_file_get(src->fd[fd]);
+         }
+         memcpy(fdt->fd, src->fd, max_fds * sizeof(sys_file_t *));
+         memcpy(fdt->open_map, src->open_map, (max_fds / 32) * sizeof(uint32_t));
+         fdt->next_fd = src->next_fd;
+         spinlock_release_irqrestore(&parent->fd_table_lock, irq_flags);
+
+         child->fdt = fdt;
+         return 0;
+     }
+ }
+
+ void fd_table_close_all(pcb_t *proc) {
+     uintptr_t irq_flags = spinlock_acquire_irqsave(&proc->fd_table_lock);
+     for (int fd = 0; proc->fdt && (uint32_t)fd < proc->fdt->max_fds; fd++) {
+         sys_file_t *sf = fd_remove_locked(proc, fd);
+         if (!sf) continue;
+         // Drop the reference outside the lock: the last one closes the VFS file
+         spinlock_release_irqrestore(&proc->fd_table_lock, irq_flags);
+         SF_LOG("Closing fd %d of PID %lu (sys_file_t* %p)", fd, (unsigned long)proc->pid, sf);
+         int vfs_ret = sys_file_put(sf);
+         if (vfs_ret < 0) {
+             serial_printf("   [Proc %lu] Warning: vfs_close for fd %d returned error %d.\n",
+                            (unsigned long)proc->pid, fd, vfs_ret);
+         }
+         irq_flags = spinlock_acquire_irqsave(&proc->fd_table_lock);
+     }
+     fd_table_t *fdt = proc->fdt;
+     proc->fdt = NULL;
+     spinlock_release_irqrestore(&proc->fd_table_lock, irq_flags);
+     fd_table_free(fdt);
+ }
+
+ /**
+  * @brief Points @p newfd of @p proc at oldfd's file, closing what newfd held.
+  * Grows the table (allocated outside the lock, as in fd_install) when
+  * newfd lies beyond it.
+  */
+ int fd_table_dup2(pcb_t *proc, int oldfd, int newfd) {
+     if (newfd < 0 || newfd >= MAX_FD) return -EBADF;
+     fd_table_t *spare = NULL;
+     for (;;) {
+         uintptr_t irq_flags = spinlock_acquire_irqsave(&proc->fd_table_lock);
+         fd_table_t *fdt = proc->fdt;
+         if (spare && fdt && spare->max_fds > fdt->max_fds) {
+             fd_table_replace_locked(proc, spare);
+             fdt = spare;
+             spare = NULL;
+         }
+         sys_file_t *sf = fd_lookup(proc, oldfd);
+         if (!sf || (uint32_t)newfd < fdt->max_fds) {
+             sys_file_t *replaced = NULL;
+             if (sf && oldfd != newfd) {
+                 sys_file_get(sf);
+                 replaced = fd_remove_locked(proc, newfd);
+                 fdt->fd[newfd] = sf;
+                 fdt->open_map[newfd / 32] |= 1u << (newfd % 32);
+             }
+             spinlock_release_irqrestore(&proc->fd_table_lock, irq_flags);
+             if (spare) kfree(spare);
+             if (replaced) sys_file_put(replaced); // Outside the lock: may close the VFS file
+             return sf ? newfd : -EBADF;
+         }
+         uint32_t want = fdt->max_fds * 2;
+         while (want <= (uint32_t)newfd) want *= 2; // Stays <= MAX_FD: newfd < MAX_FD
+         spinlock_release_irqrestore(&proc->fd_table_lock, irq_flags);
+
+         if (spare) kfree(spare);
+         spare = fd_table_alloc(want);
+         if (!spare) return -ENOMEM;
+     }
+ }
+
+ int fd_table_close(pcb_t *proc, int fd) {
+     uintptr_t irq_flags = spinlock_acquire_irqsave(&proc->fd_table_lock);
+     sys_file_t *sf = fd_remove_locked(proc, fd);
+     spinlock_release_irqrestore(&proc->fd_table_lock, irq_flags);
+     if (!sf) return -EBADF;
+     return sys_file_put(sf);
+ }
+
+ /**
+  * @brief Looks up @p fd in the calling process and takes a reference on it,
+  * so the file stays open even if the fd is closed meanwhile.
+  * @return The referenced file (drop with sys_file_put()), or NULL for a bad fd.
+  */
+ sys_file_t *sys_file_get_fd(int fd) {
+     pcb_t *current_proc = get_current_process();
+     if (!current_proc) return NULL;
+     uintptr_t irq_flags = spinlock_acquire_irqsave(&current_proc->fd_table_lock);
+     sys_file_t *sf = fd_lookup(current_proc, fd);
+     if (sf) sys_file_get(sf);
+     spinlock_release_irqrestore(&current_proc->fd_table_lock, irq_flags);
+     return sf;
+ }
+
+ /**
+  * @brief Opens @p path for kernel use without an fd, e.g. an executable
+  * whose VMAs keep it open.
+  * @return A file with one reference (drop with sys_file_put()), or NULL.
+  */
+ sys_file_t *sys_file_open_kernel(const char *path, int flags) {
+     file_t *vfs_file = vfs_open(path, flags);
+     if (!vfs_file) return NULL;
+     sys_file_t *sf = (sys_file_t *)slab_alloc(s_sys_file_cache);
+     if (!sf) {
+         vfs_close(vfs_file);
+         return NULL;
+     }
+     sf->vfs_file = vfs_file;
+     sf->flags = flags;
+     sf->refcount = 1;
+     return sf;
+ }
+
  /**
   * @brief Implements the sys_open_impl logic.
   * Translates a user-provided path and flags into a VFS file operation,
@@ -96,24 +353,22 @@
          return -ENOENT; // Common error if file not found and O_CREAT not set or failed.
      }
  
-     sys_file_t *sf = (sys_file_t *)kmalloc(sizeof(sys_file_t));
+     sys_file_t *sf = (sys_file_t *)slab_alloc(s_sys_file_cache);
      if (!sf) {
          vfs_close(vfs_file); // Clean up allocated VFS file
-         SF_LOG("sys_open: kmalloc for sys_file_t failed for path '%s'", pathname);
+         SF_LOG("sys_open: slab_alloc for sys_file_t failed for path '%s'", pathname);
          return -ENOMEM;
      }
      sf->vfs_file = vfs_file;
      sf->flags = flags;
+     sf->refcount = 1;
  
-     uintptr_t irq_flags = spinlock_acquire_irqsave(&current_proc->fd_table_lock);
-     int fd_or_err = assign_fd_locked(current_proc, sf);
-     spinlock_release_irqrestore(&current_proc->fd_table_lock, irq_flags);
- 
-     if (fd_or_err == EMFILE) { // assign_fd_locked returns positive EMFILE
+     int fd_or_err = fd_install(current_proc, sf);
+     if (fd_or_err < 0) { // -EMFILE, or -ENOMEM growing the table
          vfs_close(vfs_file);
-         kfree(sf);
-         SF_LOG("sys_open: No free FDs (EMFILE) for path '%s'", pathname);
-         return -EMFILE; // Convert to negative errno
+         slab_free(s_sys_file_cache, sf);
+         SF_LOG("sys_open: No free FDs (%d) for path '%s'", fd_or_err, pathname);
+         return fd_or_err;
      }
  
      SF_LOG("sys_open: Success. Path '%s' -> fd %d", pathname, fd_or_err);
@@ -130,23 +385,22 @@
      if (kbuf == NULL && count != 0) return -EFAULT;
      if (count == 0) return 0;
  
-     pcb_t *current_proc = get_current_process();
-     if (!current_proc) return -EFAULT;
- 
-     uintptr_t irq_flags = spinlock_acquire_irqsave(&current_proc->fd_table_lock);
-     sys_file_t *sf = get_sys_file_locked(current_proc, fd);
-     spinlock_release_irqrestore(&current_proc->fd_table_lock, irq_flags);
+     // Hold a reference throughout: another thread may close fd mid-read
+     sys_file_t *sf = sys_file_get_fd(fd);
  
      if (!sf) return -EBADF;
  
      // Check if file was opened with read permission
      if (!((sf->flags & O_ACCMODE) == O_RDONLY || (sf->flags & O_ACCMODE) == O_RDWR)) {
          SF_LOG("sys_read: fd %d not opened for reading (flags 0x%x)", fd, sf->flags);
+         sys_file_put(sf);
          return -EACCES;
      }
  
-     ssize_t bytes_read = vfs_read(sf->vfs_file, kbuf, count);
+     ssize_t bytes_read = pipe_is_pipe(sf->vfs_file) ? pipe_read(sf->vfs_file, kbuf, count, false)
+                                                     : vfs_read(sf->vfs_file, kbuf, count);
      SF_LOG("sys_read: fd %d, vfs_read returned %d", fd, (int)bytes_read);
+     sys_file_put(sf);
      return bytes_read; // vfs_read returns bytes read (>=0) or negative FS_ERR_*
  }
  
@@ -160,26 +414,176 @@
      if (kbuf == NULL && count != 0) return -EFAULT;
      if (count == 0) return 0;
  
-     pcb_t *current_proc = get_current_process();
-     if (!current_proc) return -EFAULT;
- 
-     uintptr_t irq_flags = spinlock_acquire_irqsave(&current_proc->fd_table_lock);
-     sys_file_t *sf = get_sys_file_locked(current_proc, fd);
-     spinlock_release_irqrestore(&current_proc->fd_table_lock, irq_flags);
+     sys_file_t *sf = sys_file_get_fd(fd); // Held throughout, as in sys_read
  
      if (!sf) return -EBADF;
  
      // Check if file was opened with write permission
      if (!((sf->flags & O_ACCMODE) == O_WRONLY || (sf->flags & O_ACCMODE) == O_RDWR)) {
          SF_LOG("sys_write: fd %d not opened for writing (flags 0x%x)", fd, sf->flags);
+         sys_file_put(sf);
          return -EACCES;
      }
  
-     ssize_t bytes_written = vfs_write(sf->vfs_file, kbuf, count);
+     ssize_t bytes_written = pipe_is_pipe(sf->vfs_file) ? pipe_write(sf->vfs_file, kbuf, count, false)
+                                                        : vfs_write(sf->vfs_file, kbuf, count);
      SF_LOG("sys_write: fd %d, vfs_write returned %d", fd, (int)bytes_written);
+     sys_file_put(sf);
      return bytes_written; // vfs_write returns bytes written (>=0) or negative FS_ERR_*
  }
  
+ /**
+  * @brief Reads at @p offset into a kernel buffer, leaving the descriptor's
+  * position alone, so tasks sharing it need not serialize on lseek+read.
+  * @return Number of bytes read, or negative error on failure.
+  */
+ ssize_t sys_pread(int fd, void *kbuf, size_t count, off_t offset) {
+     SF_LOG("sys_pread: fd=%d, count=%lu, offset=%ld", fd, (unsigned long)count, (long)offset);
+     if (kbuf == NULL && count != 0) return -EFAULT;
+     if (offset < 0) return -EINVAL;
+     if (count == 0) return 0;
+ 
+     sys_file_t *sf = sys_file_get_fd(fd);
+ 
+     if (!sf) return -EBADF;
+     ssize_t bytes_read;
+     if (!((sf->flags & O_ACCMODE) == O_RDONLY || (sf->flags & O_ACCMODE) == O_RDWR)) {
+         bytes_read = -EACCES;
+     } else if (pipe_is_pipe(sf->vfs_file)) {
+         bytes_read = -ESPIPE;
+     } else {
+         bytes_read = vfs_pread(sf->vfs_file, kbuf, count, offset);
+     }
+     SF_LOG("sys_pread: fd %d, vfs_pread returned %d", fd, (int)bytes_read);
+     sys_file_put(sf);
+     return bytes_read;
+ }
+ 
+ /**
+  * @brief Writes a kernel buffer at @p offset, leaving the descriptor's
+  * position alone (O_APPEND files still append, as on Linux).
+  * @return Number of bytes written, or negative error on failure.
+  */
+ ssize_t sys_pwrite(int fd, const void *kbuf, size_t count, off_t offset) {
+     SF_LOG("sys_pwrite: fd=%d, count=%lu, offset=%ld", fd, (unsigned long)count, (long)offset);
+     if (kbuf == NULL && count != 0) return -EFAULT;
+     if (offset < 0) return -EINVAL;
+     if (count == 0) return 0;
+ 
+     sys_file_t *sf = sys_file_get_fd(fd);
+ 
+     if (!sf) return -EBADF;
+     ssize_t bytes_written;
+     if (!((sf->flags & O_ACCMODE) == O_WRONLY || (sf->flags & O_ACCMODE) == O_RDWR)) {
+         bytes_written = -EACCES;
+     } else if (pipe_is_pipe(sf->vfs_file)) {
+         bytes_written = -ESPIPE;
+     } else {
+         bytes_written = vfs_pwrite(sf->vfs_file, kbuf, count, offset);
+     }
+     SF_LOG("sys_pwrite: fd %d, vfs_pwrite returned %d", fd, (int)bytes_written);
+     sys_file_put(sf);
+     return bytes_written;
+ }
+ 
+ /**
+  * @brief Creates a pipe and installs its read end at @p fds[0] and its
+  * write end at @p fds[1] (the lowest free fds, in that order).
+  * @return 0, or a negative errno with no fd installed.
+  */
+ int sys_pipe(int fds[2]) {
+     pcb_t *current_proc = get_current_process();
+     if (!current_proc) return -EFAULT;
+
+     file_t *ends[2];
+     int err = pipe_create(&ends[0], &ends[1]);
+     if (err < 0) return err;
+
+     sys_file_t *sf[2];
+     sf[0] = (sys_file_t *)slab_alloc(s_sys_file_cache);
+     sf[1] = (sys_file_t *)slab_alloc(s_sys_file_cache);
+     if (!sf[0] || !sf[1]) {
+         if (sf[0]) slab_free(s_sys_file_cache, sf[0]);
+         if (sf[1]) slab_free(s_sys_file_cache, sf[1]);
+         vfs_close(ends[0]);
+         vfs_close(ends[1]);
+         return -ENOMEM;
+     }
+     for (int i = 0; i < 2; i++) {
+         sf[i]->vfs_file = ends[i];
+         sf[i]->flags = i == 0 ? O_RDONLY : O_WRONLY;
+         sf[i]->refcount = 1;
+     }
+
+     fds[0] = fd_install(current_proc, sf[0]);
+     if (fds[0] < 0) {
+         err = fds[0];
+         sys_file_put(sf[0]);
+         sys_file_put(sf[1]);
+         return err;
+     }
+     fds[1] = fd_install(current_proc, sf[1]);
+     if (fds[1] < 0) {
+         err = fds[1];
+         sys_close(fds[0]);
+         sys_file_put(sf[1]);
+         return err;
+     }
+     SF_LOG("sys_pipe: fds %d (read) and %d (write)", fds[0], fds[1]);
+     return 0;
+ }
+
+ bool sys_file_is_pipe(int fd) {
+     sys_file_t *sf = sys_file_get_fd(fd);
+     if (!sf) return false;
+     bool is_pipe = pipe_is_pipe(sf->vfs_file);
+     sys_file_put(sf);
+     return is_pipe;
+ }
+
+ /**
+  * @brief Reads or writes the pipe end on @p fd, holding a reference for
+  * the whole call since it may block while another task closes the fd.
+  * @param user @p buf is a user address that already passed access_ok().
+  * @return Bytes moved, or a negative errno.
+  */
+ ssize_t sys_pipe_io(int fd, void *buf, size_t count, bool write, bool user) {
+     sys_file_t *sf = sys_file_get_fd(fd);
+     if (!sf) return -EBADF;
+     ssize_t ret;
+     if (!pipe_is_pipe(sf->vfs_file)) {
+         ret = -EINVAL;
+     } else if ((sf->flags & O_ACCMODE) != (write ? O_WRONLY : O_RDONLY)) {
+         ret = -EACCES;
+     } else {
+         ret = write ? pipe_write(sf->vfs_file, buf, count, user) : pipe_read(sf->vfs_file, buf, count, user);
+     }
+     sys_file_put(sf);
+     return ret;
+ }
+
+ int sys_shm_open(const char *name, int flags, size_t size) {
+     pcb_t *current_proc = get_current_process();
+     if (!current_proc) return -EFAULT;
+
+     int err = 0;
+     file_t *vfile = shm_open_file(name, flags, size, &err);
+     if (!vfile) return err;
+     sys_file_t *sf = (sys_file_t *)slab_alloc(s_sys_file_cache);
+     if (!sf) {
+         vfs_close(vfile);
+         return -ENOMEM;
+     }
+     sf->vfs_file = vfile;
+     sf->flags = flags & O_ACCMODE;
+     sf->refcount = 1;
+
+     int fd = fd_install(current_proc, sf);
+     if (fd < 0) sys_file_put(sf);
+     SF_LOG("sys_shm_open: '%s' -> fd %d", name, fd);
+     return fd;
+ }
+
  /**
   * @brief Implements the sys_close_impl logic.
   * Closes a file descriptor, releasing associated VFS resources.
@@ -193,22 +597,13 @@
      sys_file_t *sf_to_close = NULL;
  
      uintptr_t irq_flags = spinlock_acquire_irqsave(&current_proc->fd_table_lock);
-     if (fd < 0 || fd >= MAX_FD) {
-         spinlock_release_irqrestore(&current_proc->fd_table_lock, irq_flags);
-         return -EBADF;
-     }
-     sf_to_close = current_proc->fd_table[fd];
-     if (!sf_to_close) {
-         spinlock_release_irqrestore(&current_proc->fd_table_lock, irq_flags);
-         return -EBADF;
-     }
-     current_proc->fd_table[fd] = NULL; // Clear FD entry under lock
+     sf_to_close = fd_remove_locked(current_proc, fd); // Clear FD entry under lock
      spinlock_release_irqrestore(&current_proc->fd_table_lock, irq_flags);
+     if (!sf_to_close) return -EBADF;
  
      KERNEL_ASSERT(sf_to_close != NULL, "sf_to_close became NULL post-lock");
  
-     int vfs_ret = vfs_close(sf_to_close->vfs_file); // vfs_close handles its own internal locking.
-     kfree(sf_to_close);
+     int vfs_ret = sys_file_put(sf_to_close); // Other processes may still share it
  
      SF_LOG("sys_close: fd %d, vfs_close returned %d", fd, vfs_ret);
      // POSIX close typically returns 0 on success or -EBADF.
@@ -225,21 +620,37 @@
  off_t sys_lseek(int fd, off_t offset, int whence) {
      SF_LOG("sys_lseek: fd=%d, offset=%ld, whence=%d", fd, (long)offset, whence);
  
-     pcb_t *current_proc = get_current_process();
-     if (!current_proc) return -EFAULT;
- 
-     uintptr_t irq_flags = spinlock_acquire_irqsave(&current_proc->fd_table_lock);
-     sys_file_t *sf = get_sys_file_locked(current_proc, fd);
-     spinlock_release_irqrestore(&current_proc->fd_table_lock, irq_flags);
- 
-     if (!sf) return -EBADF;
- 
      // Basic whence validation (VFS layer also validates)
      if (whence != SEEK_SET && whence != SEEK_CUR && whence != SEEK_END) {
          return -EINVAL;
      }
  
-     off_t new_pos = vfs_lseek(sf->vfs_file, offset, whence);
+     sys_file_t *sf = sys_file_get_fd(fd);
+ 
+     if (!sf) return -EBADF;
+ 
+     off_t new_pos = pipe_is_pipe(sf->vfs_file) ? -ESPIPE : vfs_lseek(sf->vfs_file, offset, whence);
      SF_LOG("sys_lseek: fd %d, vfs_lseek returned %ld", fd, (long)new_pos);
+     sys_file_put(sf);
      return new_pos; // vfs_lseek returns new offset (>=0) or negative FS_ERR_*
+ }
+ 
+ /**
+  * @brief Implements the sys_getdents_impl logic.
+  * Fills a kernel buffer with struct dirent_rec records from the directory
+  * open on fd, continuing where the previous call (or lseek) left it.
+  * @return Bytes filled (0 at the end), or negative error on failure.
+  */
+ ssize_t sys_getdents(int fd, void *kbuf, size_t count) {
+     SF_LOG("sys_getdents: fd=%d, count=%lu", fd, (unsigned long)count);
+     if (kbuf == NULL) return -EFAULT;
+ 
+     sys_file_t *sf = sys_file_get_fd(fd);
+ 
+     if (!sf) return -EBADF;
+ 
+     ssize_t filled = vfs_getdents(sf->vfs_file, kbuf, count);
+     SF_LOG("sys_getdents: fd %d, vfs_getdents returned %d", fd, (int)filled);
+     sys_file_put(sf);
+     return filled; // Bytes filled (>=0) or negative FS_ERR_*
  }
\ No newline at end of file
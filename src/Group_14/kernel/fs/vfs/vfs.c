@@ -12,8 +12,9 @@
  * Key Aspects & Considerations:
  * - Mount Point Resolution: Uses longest prefix matching.
  * - Driver Management: Simple linked list for registered drivers.
- * - Locking: Uses spinlocks for global driver list, mount table, and now
- * per-file structures (file_t) to protect offset/state during I/O.
+ * - Locking: RCU readers (rcu.h) for the read-mostly driver list and mount
+ * table, spinlocks for their writers, and a sleeping mutex per open file
+ * (file_t) to protect offset/state during I/O with interrupts enabled.
  * - Error Handling: Primarily propagates errors from underlying drivers or
  * returns standard FS_ERR_* / POSIX errno codes.
  * - Missing Features: Permissions, ownership, directory creation/deletion,
@@ -22,6 +23,7 @@
 
  #include <kernel/fs/vfs/vfs.h>           // Declares vfs_driver_t, file_t, vnode_t etc. (MUST define file_t.lock)
  #include <kernel/memory/kmalloc.h>       // Kernel memory allocation
+ #include <kernel/memory/slab.h>          // file_t cache
  #include <kernel/drivers/display/terminal.h>      // Kernel logging/printing
  #include <kernel/lib/string.h>        // Kernel string functions (strcmp, strlen, strncpy, etc.)
  #include <kernel/core/types.h>         // Core types (ssize_t, off_t, etc.)
@@ -30,13 +32,18 @@
  #include <kernel/fs/vfs/fs_limits.h>     // MAX_PATH_LEN definition
  #include <kernel/fs/vfs/mount.h>         // mount_t definition
  #include <kernel/fs/vfs/mount_table.h>   // Global mount table functions
+ #include <kernel/fs/vfs/poll.h>          // POLL* masks, vfs_poll_init
  #include <kernel/sync/spinlock.h>      // Spinlock definitions and functions
+ #include <kernel/sync/rcu.h>           // Driver lookups take no lock
  #include <libc/limits.h>   // LONG_MAX, LONG_MIN etc. (Assumed available)
  #include <libc/stddef.h>   // NULL, size_t (Assumed available)
  #include <libc/stdbool.h>  // bool (Assumed available)
  #include <libc/stdarg.h>   // varargs for printf (Assumed available)
  #include <kernel/lib/assert.h>        // KERNEL_ASSERT
+ #include <kernel/lib/klog.h>          // klog_debug (VFS_DEBUG_LOG)
+ #include <kernel/memory/page_cache.h>  // Dropping cached pages of modified files
  #include <kernel/drivers/display/serial.h>        // Serial logging for critical paths
+ #include <kernel/core/tracepoint.h>
 
  /* Define SEEK macros if not already defined (should be in sys_file.h ideally) */
  #ifndef SEEK_SET
@@ -69,7 +76,7 @@
  #define VFS_LOG(fmt, ...) ((void)0)
  #endif
  #if VFS_DEBUG_LEVEL >= 2
- #define VFS_DEBUG_LOG(fmt, ...) terminal_printf("[VFS DEBUG] %s:%d: " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
+ #define VFS_DEBUG_LOG(fmt, ...) klog_debug("[VFS DEBUG] %s:%d: " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
  #else
  #define VFS_DEBUG_LOG(fmt, ...) ((void)0)
  #endif
@@ -82,15 +89,16 @@
  // Linked list of registered filesystem drivers
  static vfs_driver_t *driver_list = NULL;
 
- // Spinlock to protect access to the driver_list
+ // Serializes (un)registration; lookups walk driver_list under RCU. Drivers
+ // are static objects, so only unregistration has to wait for readers.
  static spinlock_t vfs_driver_lock;
 
 
  /* --- Forward Declarations --- */
 
  static int check_driver_validity(vfs_driver_t *driver);
- static mount_t *find_best_mount_for_path(const char *path);
- static const char *get_relative_path(const char *path, mount_t *mnt);
+ static mount_t *find_best_mount_for_path(const char *path, size_t *prefix_len_out);
+ static const char *get_relative_path(const char *path, mount_t *mnt, size_t prefix_len);
  static int add_mount_entry(const char *mp, const char *fs, void *ctx, vfs_driver_t *drv);
  static int vfs_mount_internal(const char *mp, const char *fs, const char *dev);
  static int vfs_unmount_internal(const char *mp);
@@ -103,10 +111,20 @@
  /**
   * @brief Initializes the VFS layer. Must be called once during kernel boot.
   */
+ // Open file handles; each object's lock is initialized once by the constructor
+ static slab_cache_t *s_file_cache = NULL;
+
+ static void file_ctor(void *obj) {
+     kmutex_init(&((file_t *)obj)->lock, false);
+ }
+
  void vfs_init(void) {
      spinlock_init(&vfs_driver_lock);
+     if (!s_file_cache) s_file_cache = slab_create("file_t", sizeof(file_t), 0, 0, file_ctor, NULL);
+     if (!s_file_cache) VFS_ERROR("vfs_init: Failed to create file_t cache");
      driver_list = NULL;
      mount_table_init(); // Initialize the separate mount table manager
+     vfs_poll_init();
      VFS_LOG("Virtual File System initialized");
  }
 
@@ -159,9 +177,9 @@
          current = current->next;
      }
 
-     // Add to head
+     // Add to head, linked before it is published
      driver->next = driver_list;
-     driver_list = driver;
+     rcu_assign_pointer(driver_list, driver);
 
      spinlock_release_irqrestore(&vfs_driver_lock, irq_flags);
 
@@ -186,7 +204,7 @@
 
      while (curr) {
          if (curr == driver) {
-             *prev_next_ptr = curr->next;
+             rcu_assign_pointer(*prev_next_ptr, curr->next);
              found = true;
              break;
          }
@@ -198,6 +216,7 @@
 
      if (found) {
          VFS_LOG("Unregistered driver: %s", driver->fs_name);
+         synchronize_rcu(); // A lookup may still be standing on it
          driver->next = NULL;
          return FS_SUCCESS;
      } else {
@@ -215,19 +234,19 @@
          return NULL;
      }
 
-     uintptr_t irq_flags = spinlock_acquire_irqsave(&vfs_driver_lock);
+     rcu_read_lock();
 
-     vfs_driver_t *curr = driver_list;
+     vfs_driver_t *curr = rcu_dereference(driver_list);
      vfs_driver_t *found_driver = NULL;
      while (curr) {
          if (curr->fs_name && strcmp(curr->fs_name, fs_name) == 0) {
              found_driver = curr;
              break;
          }
-         curr = curr->next;
+         curr = rcu_dereference(curr->next);
      }
 
-     spinlock_release_irqrestore(&vfs_driver_lock, irq_flags);
+     rcu_read_unlock();
 
      if (!found_driver) {
         VFS_DEBUG_LOG("Driver '%s' not found", fs_name);
@@ -240,20 +259,21 @@
   */
  void vfs_list_drivers(void) {
      VFS_LOG("Registered filesystem drivers:");
-     uintptr_t irq_flags = spinlock_acquire_irqsave(&vfs_driver_lock);
-     if (!driver_list) {
+     rcu_read_lock();
+     vfs_driver_t *head = rcu_dereference(driver_list);
+     if (!head) {
          VFS_LOG("  (none)");
      } else {
-         vfs_driver_t *curr = driver_list;
+         vfs_driver_t *curr = head;
          int count = 0;
          while (curr) {
              VFS_LOG("  %d: %s", ++count, curr->fs_name ? curr->fs_name : "[INVALID NAME]");
-             curr = curr->next;
+             curr = rcu_dereference(curr->next);
          }
          if (count == 0) { VFS_LOG("  (list head not null, but no drivers found - list corrupted?)"); }
          else { VFS_LOG("Total drivers: %d", count); }
      }
-     spinlock_release_irqrestore(&vfs_driver_lock, irq_flags);
+     rcu_read_unlock();
  }
 
  /*---------------------------------------------------------------------------
@@ -307,38 +327,13 @@
 
  /**
   * @brief Finds the most specific (longest matching prefix) mount entry for a given absolute path.
+  * @param prefix_len_out Receives how much of @p path the mount point covers.
   */
-  static mount_t *find_best_mount_for_path(const char *path) {
+  static mount_t *find_best_mount_for_path(const char *path, size_t *prefix_len_out) {
      KERNEL_ASSERT(path && path[0] == '/', "find_best_mount_for_path: Invalid path");
      VFS_DEBUG_LOG("find_best_mount_for_path: Searching for path: '%s'", path);
 
-     mount_t *best_match = NULL;
-     size_t best_len = 0;
-     // Read access to mount table (locking handled by mount_table_get_head/iteration if needed)
-     // Assuming mount table reads are safe or infrequent for now.
-     mount_t *curr = mount_table_get_head();
-
-     while (curr) {
-         KERNEL_ASSERT(curr->mount_point && curr->mount_point[0] == '/', "Invalid mount entry in list");
-         size_t current_mount_point_len = strlen(curr->mount_point);
-         VFS_DEBUG_LOG("  Checking mount point: '%s' (len %lu)", curr->mount_point, (unsigned long)current_mount_point_len);
-
-         if (strncmp(path, curr->mount_point, current_mount_point_len) == 0) {
-             bool is_exact_match = (path[current_mount_point_len] == '\0');
-             bool is_subdir_match = (path[current_mount_point_len] == '/');
-             bool is_root_mount = (current_mount_point_len == 1); // '/' is the only 1-char valid mount point
-
-             if (is_exact_match || is_subdir_match || (is_root_mount && !is_exact_match)) {
-                 if (current_mount_point_len >= best_len) {
-                     VFS_DEBUG_LOG("    -> Found new best match '%s' (len %lu >= %lu)",
-                                   curr->mount_point, (unsigned long)current_mount_point_len, (unsigned long)best_len);
-                     best_match = curr;
-                     best_len = current_mount_point_len;
-                 }
-             }
-         }
-         curr = curr->next;
-     }
+     mount_t *best_match = mount_table_find_best(path, prefix_len_out);
 
      if (best_match) { VFS_DEBUG_LOG("find_best_mount_for_path: Found best match: '%s'", best_match->mount_point); }
      else { VFS_LOG("find_best_mount_for_path: No suitable mount point found for path '%s'.", path); }
@@ -347,16 +342,16 @@
 
  /**
   * @brief Calculates the path relative to a given mount point.
+  * @param prefix_len The covered length find_best_mount_for_path reported, so
+  *        the mount point need not be compared against the path again.
   */
-  static const char *get_relative_path(const char *path, mount_t *mnt) {
+  static const char *get_relative_path(const char *path, mount_t *mnt, size_t prefix_len) {
      KERNEL_ASSERT(path && mnt && mnt->mount_point, "get_relative_path: Invalid input");
-     size_t mount_point_len = strlen(mnt->mount_point);
-     KERNEL_ASSERT(strncmp(path, mnt->mount_point, mount_point_len) == 0, "Path does not start with mount point");
 
-     const char *relative_path_start = path + mount_point_len;
+     const char *relative_path_start = path + prefix_len;
 
      // Handle root mount ("/") correctly
-     if (mount_point_len == 1 && mnt->mount_point[0] == '/') {
+     if (prefix_len == 1 && mnt->mount_point[0] == '/' && mnt->mount_point[1] == '\0') {
          return (*relative_path_start == '\0') ? "/" : relative_path_start;
      }
      // Handle other mounts
@@ -511,6 +506,27 @@
      return vfs_unmount_internal("/");
  }
 
+ /**
+  * @brief Mounts @p dev (@p fs_type) on @p mp, below the root (e.g. tmpfs on /tmp).
+  * The mount point is matched by path prefix, so it need not exist as a directory.
+  */
+ int vfs_mount(const char *mp, const char *fs_type, const char *dev) {
+     if (!mp || mp[0] != '/' || !fs_type || !dev) return -FS_ERR_INVALID_PARAM;
+     if (strcmp(mp, "/") != 0 && mount_table_find("/") == NULL) {
+         VFS_ERROR("vfs_mount: Root must be mounted before '%s'", mp);
+         return -FS_ERR_NOT_INIT;
+     }
+     return vfs_mount_internal(mp, fs_type, dev);
+ }
+
+ /**
+  * @brief Unmounts the filesystem on @p mp (refused while a mount is nested below it).
+  */
+ int vfs_unmount(const char *mp) {
+     if (!mp || mp[0] != '/') return -FS_ERR_INVALID_PARAM;
+     return vfs_unmount_internal(mp);
+ }
+
  /**
   * @brief Lists all mounted filesystems.
   */
@@ -564,7 +580,7 @@
 
      // Clear the driver list
      uintptr_t irq_flags = spinlock_acquire_irqsave(&vfs_driver_lock);
-     driver_list = NULL;
+     rcu_assign_pointer(driver_list, NULL);
      spinlock_release_irqrestore(&vfs_driver_lock, irq_flags);
 
      if (final_result == FS_SUCCESS) { VFS_LOG("VFS shutdown complete"); }
@@ -576,18 +592,19 @@
   * File Operations (VFS Public API Implementation with Locking)
   *---------------------------------------------------------------------------*/
 
- file_t *vfs_open(const char *path, int flags) {
+ static file_t *vfs_open_path(const char *path, int flags) {
      serial_write("[vfs_open] Enter. Path='"); serial_write(path ? path : "NULL");
      serial_write("', Flags=0x"); serial_print_hex((uint32_t)flags); serial_write("\n");
 
      if (!path || path[0] != '/') { /* ... error logging ... */ return NULL; }
 
      // 1. Find mount point and driver
-     mount_t *mnt = find_best_mount_for_path(path);
+     size_t prefix_len = 0;
+     mount_t *mnt = find_best_mount_for_path(path, &prefix_len);
      if (!mnt) { /* ... error logging ... */ return NULL; }
      vfs_driver_t *driver = vfs_get_driver(mnt->fs_name);
      if (!driver) { /* ... error logging ... */ return NULL; }
-     const char *relative_path = get_relative_path(path, mnt);
+     const char *relative_path = get_relative_path(path, mnt, prefix_len);
      if (!relative_path) { /* ... error logging ... */ return NULL; }
 
      serial_write("[vfs_open] Using mount='"); serial_write(mnt->mount_point);
@@ -601,6 +618,8 @@
      vnode_t *node = driver->open(mnt->fs_context, relative_path, flags);
      serial_write("[vfs_open] <<< driver->open returned node="); serial_print_hex((uintptr_t)node); serial_write("\n");
      if (!node) { /* ... error logging ... */ return NULL; }
+     // Truncation frees the old data, which another file may reuse
+     if (flags & O_TRUNC) page_cache_invalidate_fs(mnt->fs_context);
 
      // 3. Validate vnode
      if (node->fs_driver != driver) {
@@ -609,7 +628,7 @@
      }
 
      // 4. Allocate file handle
-     file_t *file = (file_t *)kmalloc(sizeof(file_t));
+     file_t *file = (file_t *)slab_alloc(s_file_cache);
      if (!file) {
         /* ... error logging and cleanup ... */
         return NULL;
@@ -619,23 +638,65 @@
      file->vnode = node;
      file->flags = flags;
      file->offset = 0;
-     spinlock_init(&file->lock); // <<< INITIALIZE LOCK >>>
+     // file->lock is already initialized (file_ctor) and unlocked
 
      serial_write("[vfs_open] Success. file="); serial_print_hex((uintptr_t)file); /* ... */ serial_write("\n");
      return file;
  }
 
+ /**
+  * @brief Packs up to 8 bytes of @p path's last component into two words,
+  * low byte first, for the TP_VFS_OPEN tracepoint.
+  */
+ static void vfs_trace_name(const char *path, uint32_t words[2]) {
+     words[0] = words[1] = 0;
+     if (!path) return;
+     const char *name = path;
+     for (const char *p = path; *p; p++) {
+         if (*p == '/' && p[1]) name = p + 1;
+     }
+     for (int i = 0; i < 8 && name[i] && name[i] != '/'; i++) {
+         words[i / 4] |= (uint32_t)(uint8_t)name[i] << (8 * (i % 4));
+     }
+ }
+
+ file_t *vfs_open(const char *path, int flags) {
+     if (TRACEPOINTS && (g_tracepoint_mask & (1u << TP_VFS_OPEN))) {
+         uint32_t name[2];
+         vfs_trace_name(path, name);
+         TRACEPOINT(TP_VFS_OPEN, name[0], name[1]);
+     }
+     file_t *file = vfs_open_path(path, flags);
+     TRACEPOINT(TP_VFS_OPEN_DONE, file != NULL, 0);
+     return file;
+ }
+
+ /**
+  * @brief Opens a handle on a vnode a driver built itself, with no path or
+  * mount behind it (pipe ends). The handle owns @p node from here on:
+  * vfs_close() calls the driver's close and frees it, as for vfs_open().
+  */
+ file_t *vfs_open_vnode(vnode_t *node, int flags) {
+     if (!node || !node->fs_driver) return NULL;
+     file_t *file = (file_t *)slab_alloc(s_file_cache);
+     if (!file) return NULL;
+     file->vnode = node;
+     file->flags = flags;
+     file->offset = 0;
+     return file;
+ }
+
  int vfs_close(file_t *file) {
      if (!file) { VFS_ERROR("NULL file handle passed to vfs_close"); return -FS_ERR_INVALID_PARAM; }
-     if (!file->vnode) { VFS_ERROR("vfs_close: File handle %p has NULL vnode!", file); kfree(file); return -FS_ERR_BAD_F; }
-     if (!file->vnode->fs_driver) { VFS_ERROR("vfs_close: Vnode %p has NULL fs_driver!", file->vnode); kfree(file->vnode); kfree(file); return -FS_ERR_BAD_F; }
+     if (!file->vnode) { VFS_ERROR("vfs_close: File handle %p has NULL vnode!", file); slab_free(s_file_cache, file); return -FS_ERR_BAD_F; }
+     if (!file->vnode->fs_driver) { VFS_ERROR("vfs_close: Vnode %p has NULL fs_driver!", file->vnode); kfree(file->vnode); slab_free(s_file_cache, file); return -FS_ERR_BAD_F; }
 
      vfs_driver_t* driver = file->vnode->fs_driver;
      VFS_DEBUG_LOG("vfs_close: Closing file handle %p (vnode: %p, driver: %s)", file, file->vnode, driver->fs_name ? driver->fs_name : "[N/A]");
 
      int result = FS_SUCCESS;
      // --- Acquire Lock (Optional but safer if driver close touches shared vnode state) ---
-     // spinlock_acquire_irqsave(&file->lock); // Consider if driver->close needs protection
+     // kmutex_lock(&file->lock); // Consider if driver->close needs protection
 
      if (driver->close) {
          result = driver->close(file); // Driver cleans up vnode->data
@@ -645,11 +706,11 @@
      }
 
      // --- Release Lock (if acquired above) ---
-     // spinlock_release_irqrestore(&file->lock, irq_flags);
+     // kmutex_unlock(&file->lock);
 
      // VFS layer frees its own structures
      kfree(file->vnode);
-     kfree(file); // Free the file struct itself
+     slab_free(s_file_cache, file); // Free the file struct itself (lock released, still constructed)
 
      return result; // Return result from driver close
  }
@@ -662,10 +723,13 @@
     if (!file->vnode->fs_driver->read) return -FS_ERR_NOT_SUPPORTED;
 
     // === Acquire Lock ===
-    uintptr_t irq_flags = spinlock_acquire_irqsave(&file->lock);
+    kmutex_lock(&file->lock);
 
     VFS_DEBUG_LOG("vfs_read: START file=%p, offset=%ld, len=%lu", file, (long)file->offset, (unsigned long)len);
-    int bytes_read = file->vnode->fs_driver->read(file, buf, len); // Driver uses current file->offset
+    int bytes_read = page_cache_read(file, buf, len, file->offset);
+    if (bytes_read == -FS_ERR_NOT_SUPPORTED) {
+        bytes_read = file->vnode->fs_driver->read(file, buf, len); // Driver uses current file->offset
+    }
 
     if (bytes_read > 0) {
         // Check for offset overflow before adding
@@ -683,7 +747,44 @@
     }
 
     // === Release Lock ===
-    spinlock_release_irqrestore(&file->lock, irq_flags);
+    kmutex_unlock(&file->lock);
+    return bytes_read;
+ }
+
+ /**
+  * @brief Reads @p len bytes at @p offset without moving the file position,
+  * from the page cache where the file can be cached. Used by page faults on
+  * file-backed mappings and by the ELF loader.
+  */
+ int vfs_pread(file_t *file, void *buf, size_t len, off_t offset) {
+    if (!file || !file->vnode || !file->vnode->fs_driver) return -FS_ERR_BAD_F;
+    if (!buf && len > 0) return -FS_ERR_INVALID_PARAM;
+    if (offset < 0) return -FS_ERR_INVALID_PARAM;
+    if (len == 0) return 0;
+    if (!file->vnode->fs_driver->read) return -FS_ERR_NOT_SUPPORTED;
+
+    kmutex_lock(&file->lock);
+    int bytes_read = page_cache_read(file, buf, len, offset);
+    if (bytes_read == -FS_ERR_NOT_SUPPORTED) bytes_read = vfs_pread_uncached(file, buf, len, offset);
+    kmutex_unlock(&file->lock);
+
+    if (bytes_read < 0) VFS_ERROR("vfs_pread: FAIL file=%p, offset=%ld, driver error %d", file, (long)offset, bytes_read);
+    return bytes_read;
+ }
+
+ /**
+  * @brief Driver read of @p len bytes at @p offset, bypassing the page cache
+  * (which fills its pages with it). Drivers only read at file->offset, so it
+  * is swapped in and back; the caller holds file->lock.
+  */
+ int vfs_pread_uncached(file_t *file, void *buf, size_t len, off_t offset) {
+    if (!file || !file->vnode || !file->vnode->fs_driver) return -FS_ERR_BAD_F;
+    if (!file->vnode->fs_driver->read) return -FS_ERR_NOT_SUPPORTED;
+
+    off_t saved_offset = file->offset;
+    file->offset = offset;
+    int bytes_read = file->vnode->fs_driver->read(file, buf, len);
+    file->offset = saved_offset;
     return bytes_read;
  }
 
@@ -699,8 +800,12 @@
     }
     if (!file->vnode->fs_driver->write) return -FS_ERR_NOT_SUPPORTED;
 
+    // Identify before writing: a write can change the size the cache keyed on
+    vfs_file_id_t id;
+    bool identified = (vfs_identify(file, &id) == 0);
+
     // === Acquire Lock ===
-    uintptr_t irq_flags = spinlock_acquire_irqsave(&file->lock);
+    kmutex_lock(&file->lock);
 
     VFS_DEBUG_LOG("vfs_write: START file=%p, offset=%ld, len=%lu", file, (long)file->offset, (unsigned long)len);
     int bytes_written = file->vnode->fs_driver->write(file, buf, len); // Driver uses current file->offset
@@ -714,6 +819,7 @@
              file->offset += bytes_written; // Update offset *after* successful write
         }
         VFS_DEBUG_LOG("vfs_write: OK file=%p, wrote %d bytes, new offset=%ld", file, bytes_written, (long)file->offset);
+        if (identified) page_cache_invalidate_file(&id);
     } else if (bytes_written == 0) {
         VFS_DEBUG_LOG("vfs_write: Wrote 0 bytes file=%p (requested %lu)", file, (unsigned long)len);
     } else {
@@ -721,7 +827,35 @@
     }
 
     // === Release Lock ===
-    spinlock_release_irqrestore(&file->lock, irq_flags);
+    kmutex_unlock(&file->lock);
+    return bytes_written;
+ }
+
+ /**
+  * @brief Writes @p len bytes at @p offset without moving the file position;
+  * like vfs_pread(), the driver's write is pointed there under the file lock.
+  */
+ int vfs_pwrite(file_t *file, const void *buf, size_t len, off_t offset) {
+    if (!file || !file->vnode || !file->vnode->fs_driver) return -FS_ERR_BAD_F;
+    if (!buf && len > 0) return -FS_ERR_INVALID_PARAM;
+    if (offset < 0) return -FS_ERR_INVALID_PARAM;
+    if (len == 0) return 0;
+    int access_mode = file->flags & O_ACCMODE;
+    if (access_mode != O_WRONLY && access_mode != O_RDWR) return -FS_ERR_PERMISSION_DENIED;
+    if (!file->vnode->fs_driver->write) return -FS_ERR_NOT_SUPPORTED;
+
+    vfs_file_id_t id;
+    bool identified = (vfs_identify(file, &id) == 0);
+
+    kmutex_lock(&file->lock);
+    off_t saved_offset = file->offset;
+    file->offset = offset;
+    int bytes_written = file->vnode->fs_driver->write(file, buf, len);
+    file->offset = saved_offset;
+    if (bytes_written > 0 && identified) page_cache_invalidate_file(&id);
+    kmutex_unlock(&file->lock);
+
+    if (bytes_written < 0) VFS_ERROR("vfs_pwrite: FAIL file=%p, offset=%ld, driver error %d", file, (long)offset, bytes_written);
     return bytes_written;
  }
 
@@ -732,7 +866,7 @@
     if (!file->vnode->fs_driver->lseek) { return (off_t)-FS_ERR_NOT_SUPPORTED; }
 
     // === Acquire Lock ===
-    uintptr_t irq_flags = spinlock_acquire_irqsave(&file->lock);
+    kmutex_lock(&file->lock);
 
     VFS_DEBUG_LOG("vfs_lseek: START file=%p, current=%ld, req offset=%ld, whence=%d",
                   file, (long)file->offset, (long)offset, whence);
@@ -748,10 +882,55 @@
     }
 
     // === Release Lock ===
-    spinlock_release_irqrestore(&file->lock, irq_flags);
+    kmutex_unlock(&file->lock);
     return new_offset; // Return result from driver
  }
 
+ /**
+  * @brief Fills @p id_out with the identity of the file behind @p file,
+  * the same for every open of that file (see vfs_file_id_t).
+  */
+ int vfs_identify(file_t *file, vfs_file_id_t *id_out) {
+    if (!file || !file->vnode || !file->vnode->fs_driver || !id_out) return -FS_ERR_BAD_F;
+    if (!file->vnode->fs_driver->identify) return -FS_ERR_NOT_SUPPORTED;
+    return file->vnode->fs_driver->identify(file, id_out);
+ }
+
+ /**
+  * @brief Tells the driver the file will grow to @p length bytes, so it can
+  * reserve the space up front (contiguously where it can). Size is unchanged.
+  */
+ int vfs_fallocate(file_t *file, off_t length) {
+    if (!file || !file->vnode || !file->vnode->fs_driver) return -FS_ERR_BAD_F;
+    if (length < 0) return -FS_ERR_INVALID_PARAM;
+    if (!file->vnode->fs_driver->fallocate) return -FS_ERR_NOT_SUPPORTED;
+
+    kmutex_lock(&file->lock);
+    int result = file->vnode->fs_driver->fallocate(file, length);
+    kmutex_unlock(&file->lock);
+    return result;
+ }
+
+ /**
+  * @brief Fills @p buf with as many whole struct dirent_rec records as fit,
+  * starting at the directory cookie in dir_file->offset, and advances the
+  * cookie past them (lseek SEEK_SET to a d_off resumes there).
+  * @return Bytes filled, 0 at the end of the directory, -FS_ERR_INVALID_PARAM
+  *         if even the next record does not fit, or another negative error.
+  */
+ int vfs_getdents(file_t *dir_file, void *buf, size_t len) {
+    if (!dir_file || !buf) return -FS_ERR_INVALID_PARAM;
+    if (!dir_file->vnode || !dir_file->vnode->fs_driver) return -FS_ERR_BAD_F;
+    if (!dir_file->vnode->fs_driver->getdents) return -FS_ERR_NOT_SUPPORTED;
+
+    kmutex_lock(&dir_file->lock);
+    off_t cookie = dir_file->offset;
+    int result = dir_file->vnode->fs_driver->getdents(dir_file, buf, len, &cookie);
+    if (result >= 0) dir_file->offset = cookie;
+    kmutex_unlock(&dir_file->lock);
+    return result;
+ }
+
  /**
   * @brief Reads a directory entry via the appropriate driver.
   * @param dir_file Open file handle representing the directory.
@@ -791,13 +970,14 @@
      VFS_DEBUG_LOG("vfs_unlink: path='%s'", path);
  
      // 1. Resolve path to mount point and driver
-     mount_t *mnt = find_best_mount_for_path(path);
+     size_t prefix_len = 0;
+     mount_t *mnt = find_best_mount_for_path(path, &prefix_len);
      if (!mnt) { VFS_ERROR("vfs_unlink: No mount point for path '%s'", path); return -FS_ERR_NOT_FOUND; }
  
      vfs_driver_t *driver = vfs_get_driver(mnt->fs_name);
      if (!driver) { VFS_ERROR("vfs_unlink: Driver '%s' not found for mount '%s'", mnt->fs_name, mnt->mount_point); return -FS_ERR_INTERNAL; }
  
-     const char *relative_path = get_relative_path(path, mnt);
+     const char *relative_path = get_relative_path(path, mnt, prefix_len);
      if (!relative_path) { VFS_ERROR("vfs_unlink: Failed to get relative path for '%s'", path); return -FS_ERR_INTERNAL; }
  
      // 2. Check if driver supports unlink
@@ -809,12 +989,88 @@
      // TODO: Add locking around operations that modify directory structure if needed for SMP
      int result = driver->unlink(mnt->fs_context, relative_path);
  
-     if (result == FS_SUCCESS) { VFS_LOG("vfs_unlink: Driver unlinked '%s' relative to '%s'", relative_path, mnt->mount_point); }
+     if (result == FS_SUCCESS) {
+         VFS_LOG("vfs_unlink: Driver unlinked '%s' relative to '%s'", relative_path, mnt->mount_point);
+         page_cache_invalidate_fs(mnt->fs_context); // Its clusters can now back another file
+     }
      else { VFS_ERROR("vfs_unlink: Driver failed to unlink '%s' (err %d)", path, result); }
      return result;
  }
+
+ /**
+  * @brief Creates an empty directory at @p path.
+  * @return FS_SUCCESS, -FS_ERR_NOT_SUPPORTED if the filesystem has no mkdir, or a driver error.
+  */
+ int vfs_mkdir(const char *path) {
+     if (!path || path[0] != '/') return -FS_ERR_INVALID_PARAM;
+
+     size_t prefix_len = 0;
+     mount_t *mnt = find_best_mount_for_path(path, &prefix_len);
+     if (!mnt) return -FS_ERR_NOT_FOUND;
+     vfs_driver_t *driver = vfs_get_driver(mnt->fs_name);
+     if (!driver) return -FS_ERR_INTERNAL;
+     const char *relative_path = get_relative_path(path, mnt, prefix_len);
+     if (!relative_path) return -FS_ERR_INTERNAL;
+     if (!driver->mkdir) return -FS_ERR_NOT_SUPPORTED;
+
+     int result = driver->mkdir(mnt->fs_context, relative_path);
+     if (result != FS_SUCCESS) VFS_ERROR("vfs_mkdir: Driver failed to create '%s' (err %d)", path, result);
+     return result;
+ }
  
  
+ /**
+  * @brief Fills @p st with the attributes of @p path. Drivers with a stat op
+  * answer from their lookup caches without an open; others are opened.
+  */
+ int vfs_stat(const char *path, struct vfs_stat *st) {
+     if (!path || path[0] != '/' || !st) return -FS_ERR_INVALID_PARAM;
+
+     size_t prefix_len = 0;
+     mount_t *mnt = find_best_mount_for_path(path, &prefix_len);
+     if (!mnt) return -FS_ERR_NOT_FOUND;
+     vfs_driver_t *driver = vfs_get_driver(mnt->fs_name);
+     if (!driver) return -FS_ERR_INTERNAL;
+     const char *relative_path = get_relative_path(path, mnt, prefix_len);
+     if (!relative_path) return -FS_ERR_INTERNAL;
+
+     memset(st, 0, sizeof(*st));
+     if (driver->stat) return driver->stat(mnt->fs_context, relative_path, st);
+
+     file_t *file = vfs_open(path, O_RDONLY);
+     if (!file) return -FS_ERR_NOT_FOUND;
+     int result = vfs_fstat(file, st);
+     vfs_close(file);
+     return result;
+ }
+
+ /** @brief Fills @p st with the attributes of the file open on @p file. */
+ int vfs_fstat(file_t *file, struct vfs_stat *st) {
+    if (!file || !file->vnode || !file->vnode->fs_driver || !st) return -FS_ERR_BAD_F;
+    if (!file->vnode->fs_driver->fstat) return -FS_ERR_NOT_SUPPORTED;
+    memset(st, 0, sizeof(*st));
+    return file->vnode->fs_driver->fstat(file, st);
+ }
+
+ /**
+  * @brief Makes what was written through @p file durable (fsync, or with
+  * @p datasync fdatasync). Files of drivers without an fsync op (pipes,
+  * memory-backed files) have nothing to write back and cannot be synced.
+  */
+ int vfs_fsync(file_t *file, bool datasync) {
+    if (!file || !file->vnode || !file->vnode->fs_driver) return -FS_ERR_BAD_F;
+    if (!file->vnode->fs_driver->fsync) return -FS_ERR_INVALID_PARAM;
+    return file->vnode->fs_driver->fsync(file, datasync);
+ }
+
+ /** @brief Readiness of @p file for poll(); regular files never block. */
+ int vfs_poll(file_t *file) {
+    if (!file || !file->vnode || !file->vnode->fs_driver) return POLLNVAL;
+    if (!file->vnode->fs_driver->poll) return POLLIN | POLLOUT;
+    return file->vnode->fs_driver->poll(file);
+ }
+
+
  /*---------------------------------------------------------------------------
   * VFS Status and Utility Functions
   *---------------------------------------------------------------------------*/
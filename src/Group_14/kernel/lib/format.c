@@ -0,0 +1,194 @@
+/**
+ * @file format.c
+ * @brief printf-style formatting shared by the terminal, serial port and klog.
+ */
+
+#include <kernel/lib/format.h>
+#include <kernel/lib/string.h>
+
+static const char s_digits_lower[] = "0123456789abcdef";
+static const char s_digits_upper[] = "0123456789ABCDEF";
+
+// "00".."99": decimal conversion takes two digits per division by 100
+static const char s_dec_pairs[200] = {
+    '0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+    '1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+    '2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+    '3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+    '4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+    '5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+    '6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+    '7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+    '8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+    '9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9',
+};
+
+// Output cursor: characters past cap - 1 are dropped.
+typedef struct {
+    char  *buf;
+    size_t len;
+    size_t cap;
+} fmt_out_t;
+
+static inline void out_char(fmt_out_t *out, char c) {
+    if (out->len < out->cap - 1) out->buf[out->len++] = c;
+}
+
+static void out_chars(fmt_out_t *out, const char *s, size_t n) {
+    size_t room = out->cap - 1 - out->len;
+    if (n > room) n = room;
+    memcpy(out->buf + out->len, s, n);
+    out->len += n;
+}
+
+static void out_fill(fmt_out_t *out, char c, int n) {
+    while (n-- > 0) out_char(out, c);
+}
+
+/*
+ * Writes the digits of @p val backwards, ending just before @p end, and
+ * returns where they start. Base 16 and 8 shift; base 10 divides by a
+ * constant 100, which the compiler turns into a multiplication.
+ */
+static char *format_digits(char *end, uint32_t val, int base, bool upper) {
+    char *p = end;
+    if (base == 16) {
+        const char *digits = upper ? s_digits_upper : s_digits_lower;
+        do { *--p = digits[val & 0xF]; val >>= 4; } while (val);
+    } else if (base == 8) {
+        do { *--p = (char)('0' + (val & 7)); val >>= 3; } while (val);
+    } else {
+        while (val >= 100) {
+            uint32_t pair = (val % 100) * 2;
+            val /= 100;
+            *--p = s_dec_pairs[pair + 1];
+            *--p = s_dec_pairs[pair];
+        }
+        if (val >= 10) {
+            *--p = s_dec_pairs[val * 2 + 1];
+            *--p = s_dec_pairs[val * 2];
+        } else {
+            *--p = (char)('0' + val);
+        }
+    }
+    return p;
+}
+
+static void out_number(fmt_out_t *out, uint32_t val, bool negative, int base, bool upper,
+                       int min_width, bool zero_pad) {
+    char tmp[12]; // 32 bits in octal is 11 digits
+    char *end = tmp + sizeof(tmp);
+    char *digits = format_digits(end, val, base, upper);
+    int len = (int)(end - digits) + (negative ? 1 : 0);
+    int pad = (min_width > len) ? min_width - len : 0;
+
+    if (zero_pad) {
+        if (negative) out_char(out, '-');
+        out_fill(out, '0', pad);
+    } else {
+        out_fill(out, ' ', pad);
+        if (negative) out_char(out, '-');
+    }
+    out_chars(out, digits, (size_t)(end - digits));
+}
+
+// Parses "[0][#][width][l|ll]" after a '%'.
+static const char *format_parse_spec(const char *fmt, bool *zero_pad, bool *alt_form, int *min_width) {
+    *zero_pad = false;
+    *alt_form = false;
+    *min_width = 0;
+    if (*fmt == '0') { *zero_pad = true; fmt++; }
+    if (*fmt == '#') { *alt_form = true; fmt++; }
+    while (*fmt >= '0' && *fmt <= '9') {
+        *min_width = *min_width * 10 + (*fmt - '0');
+        fmt++;
+    }
+    if (*fmt == 'l') { fmt++; if (*fmt == 'l') fmt++; } // Arguments are 32 bits either way
+    return fmt;
+}
+
+const char *format_next_arg(const char *fmt, char *conv) {
+    bool zero_pad, alt_form;
+    int min_width;
+    while (*fmt) {
+        if (*fmt++ != '%') continue;
+        fmt = format_parse_spec(fmt, &zero_pad, &alt_form, &min_width);
+        char c = *fmt;
+        if (!c) return NULL;
+        fmt++;
+        switch (c) {
+            case 's': case 'c': case 'd': case 'i': case 'u':
+            case 'x': case 'X': case 'o': case 'p':
+                *conv = c;
+                return fmt;
+            default:
+                break; // "%%" and unknown conversions take no argument
+        }
+    }
+    return NULL;
+}
+
+int _vsnprintf(char *str, size_t size, const char *fmt, va_list args) {
+    if (!str || !size) { return 0; }
+    fmt_out_t out = { str, 0, size };
+
+    while (*fmt && out.len < size - 1) {
+        if (*fmt != '%') {
+            // Copy the literal text up to the next conversion in one go
+            const char *run = fmt;
+            while (*fmt && *fmt != '%') fmt++;
+            out_chars(&out, run, (size_t)(fmt - run));
+            continue;
+        }
+        bool zero_pad, alt_form;
+        int min_width;
+        fmt = format_parse_spec(fmt + 1, &zero_pad, &alt_form, &min_width);
+
+        switch (*fmt) {
+            case 's': {
+                const char *s = va_arg(args, const char *);
+                if (!s) s = "(null)";
+                size_t len = strlen(s);
+                if (min_width > (int)len) out_fill(&out, ' ', min_width - (int)len);
+                out_chars(&out, s, len);
+                break;
+            }
+            case 'c':
+                out_char(&out, (char)va_arg(args, int));
+                break;
+            case 'd': case 'i': {
+                int32_t val = va_arg(args, int32_t);
+                uint32_t mag = (val < 0) ? 0u - (uint32_t)val : (uint32_t)val; // INT32_MIN too
+                out_number(&out, mag, val < 0, 10, false, min_width, zero_pad);
+                break;
+            }
+            case 'u': case 'x': case 'X': case 'o': {
+                uint32_t val = va_arg(args, uint32_t);
+                int base = (*fmt == 'u') ? 10 : ((*fmt == 'o') ? 8 : 16);
+                bool upper = (*fmt == 'X');
+                if (alt_form && val != 0) {
+                    if (base == 16) { out_char(&out, '0'); out_char(&out, upper ? 'X' : 'x'); }
+                    else if (base == 8) { out_char(&out, '0'); }
+                }
+                out_number(&out, val, false, base, upper, min_width, zero_pad);
+                break;
+            }
+            case 'p':
+                out_char(&out, '0');
+                out_char(&out, 'x');
+                out_number(&out, (uint32_t)(uintptr_t)va_arg(args, void *), false, 16, false,
+                           (int)sizeof(void *) * 2, true);
+                break;
+            case '%':
+                out_char(&out, '%');
+                break;
+            default:
+                out_char(&out, '%');
+                if (*fmt) out_char(&out, *fmt);
+                break;
+        }
+        if (*fmt) fmt++;
+    }
+    str[out.len] = '\0';
+    return (int)out.len;
+}
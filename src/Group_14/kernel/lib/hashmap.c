@@ -0,0 +1,55 @@
+/*
+ * Open-addressed hash map with linear probing and backward-shift deletion;
+ * see hashmap.h.
+ */
+
+#include <kernel/lib/hashmap.h>
+
+void hashmap_init(hashmap_t *map, hashmap_slot_t *slots, uint32_t order) {
+    map->slots = slots;
+    map->mask = (1u << order) - 1;
+    map->shift = 32 - order;
+    map->count = 0;
+    for (uint32_t i = 0; i <= map->mask; i++) slots[i].value = NULL;
+}
+
+// Slot holding @p key, or the empty slot that ends its probe run
+static uint32_t hashmap_probe(const hashmap_t *map, uint32_t key) {
+    uint32_t i = hashmap_slot_of(map, key);
+    while (map->slots[i].value && map->slots[i].key != key) i = (i + 1) & map->mask;
+    return i;
+}
+
+void *hashmap_get(const hashmap_t *map, uint32_t key) {
+    return map->slots[hashmap_probe(map, key)].value;
+}
+
+bool hashmap_put(hashmap_t *map, uint32_t key, void *value) {
+    uint32_t i = hashmap_probe(map, key);
+    if (!map->slots[i].value) {
+        if (map->count >= map->mask) return false;
+        map->slots[i].key = key;
+        map->count++;
+    }
+    map->slots[i].value = value;
+    return true;
+}
+
+void *hashmap_remove(hashmap_t *map, uint32_t key) {
+    uint32_t hole = hashmap_probe(map, key);
+    void *value = map->slots[hole].value;
+    if (!value) return NULL;
+    map->count--;
+
+    // Pull back every later entry of the run whose home slot is not
+    // between the hole and itself, so no probe stops early at the hole.
+    for (uint32_t i = (hole + 1) & map->mask; map->slots[i].value; i = (i + 1) & map->mask) {
+        uint32_t home = hashmap_slot_of(map, map->slots[i].key);
+        if (((i - home) & map->mask) >= ((i - hole) & map->mask)) {
+            map->slots[hole] = map->slots[i];
+            hole = i;
+        }
+    }
+    map->slots[hole].value = NULL;
+    return value;
+}
@@ -0,0 +1,225 @@
+/**
+ * @file klog.c
+ * @brief Binary kernel log: per-CPU record rings and their drain thread.
+ */
+
+#include <kernel/lib/klog.h>
+#include <kernel/lib/string.h>            // memcpy
+#include <kernel/lib/div64.h>             // div_u64_rem
+#include <kernel/lib/format.h>            // _vsnprintf, format_next_arg
+#include <kernel/drivers/display/serial.h>
+#include <kernel/drivers/display/terminal.h>
+#include <kernel/drivers/timer/clock.h>   // clock_monotonic_ns
+#include <kernel/cpu/get_cpu_id.h>        // get_cpu_id, MAX_CPUS
+#include <kernel/sync/spinlock.h>         // local_irq_save/restore
+#include <kernel/process/scheduler.h>     // kthread_create, sleep_ms
+#include <libc/stdarg.h>
+
+#define KLOG_RING_SIZE  8192 // Bytes per CPU, power of two
+#define KLOG_RING_MASK  (KLOG_RING_SIZE - 1)
+#define KLOG_ALIGN      16   // Records start on this boundary, so a pad header always fits
+#define KLOG_DRAIN_MS   20
+#define KLOG_LINE_MAX   256
+
+// One log call. words[] holds one word per conversion of fmt, in order; a
+// %s word is the offset of the string's copy from the record start.
+typedef struct klog_record {
+    uint64_t    ns;        // clock_monotonic_ns() at the call
+    const char *fmt;       // Format id; NULL marks padding up to the ring's end
+    uint16_t    size;      // Bytes, a multiple of KLOG_ALIGN
+    uint8_t     level;
+    uint8_t     nwords;
+    uint32_t    words[];   // Argument words, then the copied strings
+} klog_record_t;
+
+_Static_assert(KLOG_MAX_WORDS <= 24, "The site descriptor's string mask has 24 bits");
+_Static_assert(sizeof(klog_record_t) + KLOG_MAX_WORDS * sizeof(uint32_t) <= KLOG_MAX_RECORD / 2,
+               "Half a record is left for strings");
+
+// Single producer (its CPU, interrupts off) and single consumer (the drain
+// thread, or a panicking CPU): head and tail are each written by one side.
+typedef struct klog_ring {
+    volatile uint32_t head;      // Free-running byte counts
+    volatile uint32_t tail;
+    volatile uint32_t dropped;   // Producer only
+    uint32_t          reported;  // Consumer only: drops already announced
+    uint8_t           buf[KLOG_RING_SIZE] __attribute__((aligned(KLOG_ALIGN)));
+} klog_ring_t;
+
+static klog_ring_t   s_rings[MAX_CPUS];
+static volatile bool s_klog_async = false;
+
+static const char *const s_level_names[] = { "ERR", "WRN", "INF", "DBG" };
+
+// Works out a format's descriptor (see klog_site_t).
+static uint32_t klog_describe(const char *fmt) {
+    uint32_t nwords = 0, strings = 0;
+    char conv;
+    for (const char *p = fmt; nwords < KLOG_MAX_WORDS && (p = format_next_arg(p, &conv)); nwords++) {
+        if (conv == 's') strings |= 1u << nwords;
+    }
+    return KLOG_DESC_VALID | (nwords << KLOG_DESC_NWORDS_SHIFT) | strings;
+}
+
+// Builds the record for one call in @p rec (KLOG_MAX_RECORD bytes); returns its size.
+static uint32_t klog_encode(klog_record_t *rec, int level, const char *fmt, uint32_t desc, va_list ap) {
+    uint32_t nwords = (desc >> KLOG_DESC_NWORDS_SHIFT) & 0x7F;
+    rec->fmt = fmt;
+    rec->level = (uint8_t)level;
+    rec->nwords = (uint8_t)nwords;
+
+    uint32_t used = sizeof(*rec) + nwords * sizeof(uint32_t);
+    for (uint32_t i = 0; i < nwords; i++) {
+        if (!(desc & (1u << i))) {
+            rec->words[i] = va_arg(ap, uint32_t);
+            continue;
+        }
+        const char *s = va_arg(ap, const char *);
+        if (!s) s = "(null)";
+        uint32_t room = KLOG_MAX_RECORD - used;
+        if (room > KLOG_MAX_STR) room = KLOG_MAX_STR;
+        uint32_t len = 0;
+        while (len + 1 < room && s[len]) len++;
+        char *copy = (char *)rec + used;
+        memcpy(copy, s, len);
+        copy[len] = '\0';
+        rec->words[i] = used;
+        used += len + 1;
+    }
+    used = (used + KLOG_ALIGN - 1) & ~(uint32_t)(KLOG_ALIGN - 1);
+    rec->size = (uint16_t)used;
+    return used;
+}
+
+static int klog_snprintf(char *buf, size_t size, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = _vsnprintf(buf, size, fmt, ap);
+    va_end(ap);
+    return n;
+}
+
+// Formats one record (strings already patched to pointers) to the serial port.
+static void klog_emit(int level, uint64_t ns, const char *fmt, va_list ap) {
+    char line[KLOG_LINE_MAX];
+    uint32_t nsec;
+    uint32_t sec = (uint32_t)div_u64_rem(ns, 1000000000u, &nsec);
+    const char *name = (level >= 0 && level <= KLOG_LVL_DEBUG) ? s_level_names[level] : "???";
+    int n = klog_snprintf(line, sizeof(line), "[%5lu.%06lu %s] ", (unsigned long)sec, (unsigned long)(nsec / 1000), name);
+    _vsnprintf(line + n, sizeof(line) - n, fmt, ap);
+    serial_write(line);
+}
+
+static void klog_ring_put(klog_ring_t *ring, const klog_record_t *rec, uint32_t size) {
+    uint32_t head = ring->head;
+    uint32_t pad = KLOG_RING_SIZE - (head & KLOG_RING_MASK);
+    if (pad >= size) pad = 0; // Fits before the end
+    if (KLOG_RING_SIZE - (head - ring->tail) < pad + size) {
+        ring->dropped++;
+        return;
+    }
+    if (pad) {
+        klog_record_t *p = (klog_record_t *)&ring->buf[head & KLOG_RING_MASK];
+        p->fmt = NULL;
+        p->size = (uint16_t)pad;
+    }
+    memcpy(&ring->buf[(head + pad) & KLOG_RING_MASK], rec, size);
+    asm volatile("" ::: "memory"); // Record before head (x86 keeps store order)
+    ring->head = head + pad + size;
+}
+
+void klog_write(klog_site_t *site, int level, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    if (!s_klog_async) {
+        klog_emit(level, clock_monotonic_ns(), fmt, ap);
+        va_end(ap);
+        return;
+    }
+    uint32_t rec_buf[KLOG_MAX_RECORD / sizeof(uint32_t)];
+    klog_record_t *rec = (klog_record_t *)rec_buf;
+    uint32_t desc = site ? site->desc : 0;
+    if (!desc) {
+        desc = klog_describe(fmt);
+        if (site) site->desc = desc;
+    }
+    uint32_t size = klog_encode(rec, level, fmt, desc, ap);
+    va_end(ap);
+
+    uintptr_t flags = local_irq_save(); // The CPU's ring has one writer at a time
+    rec->ns = clock_monotonic_ns();      // Stamped here, so each ring stays in time order
+    klog_ring_put(&s_rings[get_cpu_id()], rec, size);
+    local_irq_restore(flags);
+}
+
+// Returns the ring's oldest record, skipping padding, or NULL if it is empty.
+static klog_record_t *klog_ring_peek(klog_ring_t *ring) {
+    while (ring->tail != ring->head) {
+        asm volatile("" ::: "memory"); // head before the record
+        klog_record_t *rec = (klog_record_t *)&ring->buf[ring->tail & KLOG_RING_MASK];
+        if (rec->fmt) return rec;
+        ring->tail += rec->size;
+    }
+    return NULL;
+}
+
+// Formats the oldest record of all rings; false if there was none.
+static bool klog_drain_one(void) {
+    klog_ring_t *oldest_ring = NULL;
+    klog_record_t *oldest = NULL;
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        klog_record_t *rec = klog_ring_peek(&s_rings[cpu]);
+        if (rec && (!oldest || rec->ns < oldest->ns)) {
+            oldest = rec;
+            oldest_ring = &s_rings[cpu];
+        }
+    }
+    if (!oldest) return false;
+
+    uint32_t local_buf[KLOG_MAX_RECORD / sizeof(uint32_t)];
+    klog_record_t *rec = (klog_record_t *)local_buf;
+    memcpy(rec, oldest, oldest->size);
+    asm volatile("" ::: "memory"); // Copied out before the producer may reuse it
+    oldest_ring->tail += oldest->size;
+
+    uint32_t strings = klog_describe(rec->fmt);
+    for (uint32_t i = 0; i < rec->nwords; i++) {
+        if (strings & (1u << i)) rec->words[i] = (uint32_t)(uintptr_t)((char *)rec + rec->words[i]);
+    }
+    // i386 cdecl: a va_list is a pointer to consecutive argument words
+    klog_emit(rec->level, rec->ns, rec->fmt, (va_list)(void *)rec->words);
+    return true;
+}
+
+static void klog_drain_all(void) {
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        klog_ring_t *ring = &s_rings[cpu];
+        uint32_t dropped = ring->dropped;
+        if (dropped != ring->reported) {
+            serial_printf("[klog] CPU %d: %lu records dropped (ring full)\n",
+                          cpu, (unsigned long)(dropped - ring->reported));
+            ring->reported = dropped;
+        }
+    }
+    while (klog_drain_one()) { }
+}
+
+static void klog_drain_loop(void *arg) {
+    (void)arg;
+    s_klog_async = true;
+    for (;;) {
+        klog_drain_all();
+        sleep_ms(KLOG_DRAIN_MS);
+    }
+}
+
+void klog_init(void) {
+    if (!kthread_create(klog_drain_loop, NULL, SCHED_DEFAULT_PRIORITY)) {
+        terminal_write("[klog] Warning: No drain thread; log records stay synchronous.\n");
+    }
+}
+
+void klog_flush_sync(void) {
+    s_klog_async = false;
+    klog_drain_all();
+}
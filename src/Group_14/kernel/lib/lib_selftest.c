@@ -0,0 +1,213 @@
+/**
+ * @file lib_selftest.c
+ * @brief Boot-time unit tests for the kernel/lib containers.
+ */
+
+#include <kernel/lib/lib_selftest.h>
+#include <kernel/lib/bitmap.h>
+#include <kernel/lib/hashmap.h>
+#include <kernel/lib/ring.h>
+#include <kernel/lib/minheap.h>
+#include <kernel/drivers/display/serial.h>
+
+static uint32_t s_failures;
+
+#define CHECK(suite, cond) \
+    do { \
+        if (!(cond)) { \
+            serial_printf("[LibTest] FAIL %s: %s (lib_selftest.c:%d)\n", suite, #cond, __LINE__); \
+            s_failures++; \
+        } \
+    } while (0)
+
+//============================================================================
+// Bitmap
+//============================================================================
+
+#define TEST_BITS 100 // Not a word multiple: the tail of the last word is outside
+
+static void test_bitmap(void) {
+    uint32_t map[BITMAP_WORDS(TEST_BITS)];
+    bitmap_zero(map, TEST_BITS);
+    CHECK("bitmap", bitmap_find_first_set(map, TEST_BITS) == TEST_BITS);
+    CHECK("bitmap", bitmap_find_first_zero(map, TEST_BITS) == 0);
+
+    bitmap_set(map, 0);
+    bitmap_set(map, 31);
+    bitmap_set(map, 32);
+    bitmap_set(map, 99);
+    CHECK("bitmap", bitmap_test(map, 31) && bitmap_test(map, 32) && !bitmap_test(map, 33));
+    CHECK("bitmap", bitmap_find_first_set(map, TEST_BITS) == 0);
+    CHECK("bitmap", bitmap_find_next_set(map, TEST_BITS, 1) == 31);
+    CHECK("bitmap", bitmap_find_next_set(map, TEST_BITS, 33) == 99);
+    CHECK("bitmap", bitmap_find_next_set(map, TEST_BITS, TEST_BITS) == TEST_BITS);
+    CHECK("bitmap", bitmap_find_first_zero(map, TEST_BITS) == 1);
+    CHECK("bitmap", bitmap_find_next_zero(map, TEST_BITS, 31) == 33);
+
+    for (uint32_t i = 0; i < TEST_BITS; i++) bitmap_set(map, i);
+    CHECK("bitmap", bitmap_find_first_zero(map, TEST_BITS) == TEST_BITS);
+    bitmap_clear(map, 64);
+    CHECK("bitmap", bitmap_find_first_zero(map, TEST_BITS) == 64);
+    CHECK("bitmap", bitmap_find_next_zero(map, TEST_BITS, 65) == TEST_BITS);
+}
+
+//============================================================================
+// Hash map
+//============================================================================
+
+#define TEST_MAP_ORDER 7
+#define TEST_MAP_KEYS  96 // 3/4 load
+
+static void test_hashmap(void) {
+    static hashmap_slot_t slots[1u << TEST_MAP_ORDER];
+    hashmap_t map;
+    hashmap_init(&map, slots, TEST_MAP_ORDER);
+    CHECK("hashmap", hashmap_get(&map, 0) == NULL);
+
+    // Keys spaced so several share a home slot
+    for (uint32_t i = 0; i < TEST_MAP_KEYS; i++) {
+        CHECK("hashmap", hashmap_put(&map, i << 20, (void *)(uintptr_t)(i + 1)));
+    }
+    CHECK("hashmap", map.count == TEST_MAP_KEYS);
+    CHECK("hashmap", hashmap_put(&map, 5u << 20, (void *)(uintptr_t)1000) && map.count == TEST_MAP_KEYS);
+    CHECK("hashmap", hashmap_get(&map, 5u << 20) == (void *)(uintptr_t)1000);
+
+    // Remove every other key; the rest must still be reachable through the shifted runs
+    for (uint32_t i = 0; i < TEST_MAP_KEYS; i += 2) {
+        CHECK("hashmap", hashmap_remove(&map, i << 20) != NULL);
+    }
+    CHECK("hashmap", hashmap_remove(&map, 0) == NULL);
+    bool all_found = true;
+    for (uint32_t i = 1; i < TEST_MAP_KEYS; i += 2) {
+        void *want = (void *)(uintptr_t)(i == 5 ? 1000 : i + 1);
+        if (hashmap_get(&map, i << 20) != want) all_found = false;
+        if (hashmap_get(&map, (i - 1) << 20) != NULL) all_found = false;
+    }
+    CHECK("hashmap", all_found);
+    CHECK("hashmap", map.count == TEST_MAP_KEYS / 2);
+
+    // Fill up: the last slot stays empty so misses terminate
+    uint32_t added = 0;
+    while (hashmap_put(&map, 0xABC00000u + added, (void *)(uintptr_t)1)) added++;
+    CHECK("hashmap", map.count == map.mask);
+    CHECK("hashmap", hashmap_get(&map, 0xFFFFFFFFu) == NULL);
+}
+
+//============================================================================
+// Rings
+//============================================================================
+
+#define TEST_RING_ORDER 3
+
+static void test_ring(void) {
+    static void *spsc_slots[1u << TEST_RING_ORDER];
+    static mpsc_ring_slot_t mpsc_slots[1u << TEST_RING_ORDER];
+    spsc_ring_t spsc;
+    mpsc_ring_t mpsc;
+    void *value;
+
+    // Start the SPSC indices just below the 32-bit wrap
+    spsc_ring_init(&spsc, spsc_slots, TEST_RING_ORDER);
+    spsc.head = spsc.tail = 0xFFFFFFFCu;
+    mpsc_ring_init(&mpsc, mpsc_slots, TEST_RING_ORDER);
+    CHECK("ring", !spsc_ring_pop(&spsc, &value) && !mpsc_ring_pop(&mpsc, &value));
+
+    uint32_t next_in = 1, next_out = 1;
+    bool in_order = true;
+    for (uint32_t round = 0; round < 4; round++) {
+        while (spsc_ring_push(&spsc, (void *)(uintptr_t)next_in)) {
+            CHECK("ring", mpsc_ring_push(&mpsc, (void *)(uintptr_t)next_in));
+            next_in++;
+        }
+        CHECK("ring", spsc_ring_count(&spsc) == (1u << TEST_RING_ORDER));
+        CHECK("ring", !mpsc_ring_push(&mpsc, (void *)(uintptr_t)1));
+        // Drain part of it, so the next round wraps inside the slot array
+        for (uint32_t i = 0; i < 5; i++) {
+            void *m = NULL;
+            if (!spsc_ring_pop(&spsc, &value) || !mpsc_ring_pop(&mpsc, &m) ||
+                value != (void *)(uintptr_t)next_out || m != value) {
+                in_order = false;
+            }
+            next_out++;
+        }
+    }
+    CHECK("ring", in_order);
+    while (spsc_ring_pop(&spsc, &value)) next_out++;
+    while (mpsc_ring_pop(&mpsc, &value)) {}
+    CHECK("ring", next_out == next_in && spsc_ring_count(&spsc) == 0);
+    CHECK("ring", !mpsc_ring_pop(&mpsc, &value));
+}
+
+//============================================================================
+// Min-heap
+//============================================================================
+
+#define TEST_HEAP_ITEMS 64
+
+typedef struct {
+    struct minheap_node node;
+    uint32_t            key;
+} test_item_t;
+
+static bool test_item_less(const struct minheap_node *a, const struct minheap_node *b) {
+    return ((const test_item_t *)a)->key < ((const test_item_t *)b)->key;
+}
+
+static void test_minheap(void) {
+    static test_item_t items[TEST_HEAP_ITEMS];
+    static struct minheap_node *nodes[TEST_HEAP_ITEMS];
+    minheap_t heap;
+    minheap_init(&heap, nodes, TEST_HEAP_ITEMS, test_item_less);
+    CHECK("minheap", minheap_pop(&heap) == NULL);
+
+    // A permutation of 0..63 (37 is coprime to 64)
+    for (uint32_t i = 0; i < TEST_HEAP_ITEMS; i++) {
+        items[i].key = (i * 37) % TEST_HEAP_ITEMS;
+        CHECK("minheap", minheap_push(&heap, &items[i].node));
+    }
+    test_item_t extra = { { MINHEAP_NOT_QUEUED }, 0 };
+    CHECK("minheap", !minheap_push(&heap, &extra.node));
+
+    // Drop key 10, move key 50 to the front
+    for (uint32_t i = 0; i < TEST_HEAP_ITEMS; i++) {
+        if (items[i].key == 10) minheap_remove(&heap, &items[i].node);
+    }
+    for (uint32_t i = 0; i < TEST_HEAP_ITEMS; i++) {
+        if (items[i].key == 50) {
+            items[i].key = 0;
+            minheap_update(&heap, &items[i].node);
+        }
+    }
+
+    uint32_t popped = 0, last = 0;
+    bool sorted = true;
+    struct minheap_node *n;
+    while ((n = minheap_pop(&heap)) != NULL) {
+        uint32_t key = ((test_item_t *)n)->key;
+        if (key < last || key == 10 || minheap_node_queued(n)) sorted = false;
+        last = key;
+        popped++;
+    }
+    CHECK("minheap", sorted);
+    CHECK("minheap", popped == TEST_HEAP_ITEMS - 1);
+}
+
+//============================================================================
+// Entry
+//============================================================================
+
+static const char *run_suite(void (*suite)(void)) {
+    uint32_t before = s_failures;
+    suite();
+    return s_failures == before ? "ok" : "FAIL";
+}
+
+uint32_t lib_selftest_run(void) {
+    s_failures = 0;
+    const char *bitmap = run_suite(test_bitmap);
+    const char *hashmap = run_suite(test_hashmap);
+    const char *ring = run_suite(test_ring);
+    const char *minheap = run_suite(test_minheap);
+    serial_printf("[LibTest] bitmap=%s hashmap=%s ring=%s minheap=%s\n", bitmap, hashmap, ring, minheap);
+    return s_failures;
+}
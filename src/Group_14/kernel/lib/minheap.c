@@ -0,0 +1,72 @@
+/*
+ * Intrusive binary min-heap; see minheap.h.
+ */
+
+#include <kernel/lib/minheap.h>
+
+static inline void minheap_place(minheap_t *heap, struct minheap_node *node, uint32_t i) {
+    heap->nodes[i] = node;
+    node->index = i;
+}
+
+// Moves the node at @p i towards the root while it is smaller than its parent
+static void minheap_sift_up(minheap_t *heap, uint32_t i) {
+    struct minheap_node *node = heap->nodes[i];
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (!heap->less(node, heap->nodes[parent])) break;
+        minheap_place(heap, heap->nodes[parent], i);
+        i = parent;
+    }
+    minheap_place(heap, node, i);
+}
+
+// Moves the node at @p i towards the leaves while a child is smaller
+static void minheap_sift_down(minheap_t *heap, uint32_t i) {
+    struct minheap_node *node = heap->nodes[i];
+    for (;;) {
+        uint32_t child = 2 * i + 1;
+        if (child >= heap->count) break;
+        if (child + 1 < heap->count && heap->less(heap->nodes[child + 1], heap->nodes[child])) child++;
+        if (!heap->less(heap->nodes[child], node)) break;
+        minheap_place(heap, heap->nodes[child], i);
+        i = child;
+    }
+    minheap_place(heap, node, i);
+}
+
+void minheap_init(minheap_t *heap, struct minheap_node **nodes, uint32_t capacity,
+                  minheap_less_func less) {
+    heap->nodes = nodes;
+    heap->count = 0;
+    heap->capacity = capacity;
+    heap->less = less;
+}
+
+bool minheap_push(minheap_t *heap, struct minheap_node *node) {
+    if (heap->count >= heap->capacity) return false;
+    minheap_place(heap, node, heap->count++);
+    minheap_sift_up(heap, node->index);
+    return true;
+}
+
+struct minheap_node *minheap_pop(minheap_t *heap) {
+    struct minheap_node *top = minheap_peek(heap);
+    if (top) minheap_remove(heap, top);
+    return top;
+}
+
+void minheap_remove(minheap_t *heap, struct minheap_node *node) {
+    uint32_t i = node->index;
+    struct minheap_node *last = heap->nodes[--heap->count];
+    node->index = MINHEAP_NOT_QUEUED;
+    if (i == heap->count) return;
+    minheap_place(heap, last, i);
+    minheap_update(heap, last);
+}
+
+void minheap_update(minheap_t *heap, struct minheap_node *node) {
+    uint32_t i = node->index;
+    if (i > 0 && heap->less(node, heap->nodes[(i - 1) / 2])) minheap_sift_up(heap, i);
+    else minheap_sift_down(heap, i);
+}
@@ -0,0 +1,33 @@
+#include <kernel/lib/string.h>
+#include <libc/stdint.h>
+#include <kernel/cpu/fpu.h>  // SSE2 page helpers run between kernel_fpu_begin/end
+
+// Whole-page helpers in string_asm.asm
+void copy_page_movsd(void *dest, const void *src);
+void clear_page_stosd(void *dest);
+void copy_page_sse2(void *dest, const void *src);  // Only inside kernel_fpu_begin/end
+void clear_page_sse2(void *dest);
+
+/**
+ * @brief Copies a page; with SSE2 the stores stream past the cache, which
+ * the page's next user would mostly have to evict anyway.
+ */
+void copy_page(void *dest, const void *src) {
+    if (fpu_has_sse2()) {
+        uintptr_t irq_flags = kernel_fpu_begin();
+        copy_page_sse2(dest, src);
+        kernel_fpu_end(irq_flags);
+    } else {
+        copy_page_movsd(dest, src);
+    }
+}
+
+void clear_page(void *dest) {
+    if (fpu_has_sse2()) {
+        uintptr_t irq_flags = kernel_fpu_begin();
+        clear_page_sse2(dest);
+        kernel_fpu_end(irq_flags);
+    } else {
+        clear_page_stosd(dest);
+    }
+}
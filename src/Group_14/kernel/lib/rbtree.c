@@ -76,6 +76,18 @@
  
  void rb_tree_init(struct rb_tree *T) {
      T->root = NULL;
+     T->augment = NULL;
+ }
+ 
+ void rb_tree_init_augmented(struct rb_tree *T, rb_augment_func augment) {
+     T->root = NULL;
+     T->augment = augment;
+ }
+ 
+ void rb_tree_augment_propagate(struct rb_tree *T, struct rb_node *node) {
+     if (!T->augment) return;
+     for (; node; node = rb_node_parent(node))
+         T->augment(node);
  }
  
  // Transplant subtree rooted at v into the place of u
@@ -108,6 +120,7 @@
      rb_tree_splice(T, x, y); // Replace x with y (updates parent's child or root)
      y->left = x;                 // Put x on y's left
      rb_node_set_parent(x, y);
+     if (T->augment) { T->augment(x); T->augment(y); } // Same subtree contents, new shape
  }
  
  // Right rotate around y
@@ -122,6 +135,7 @@
      rb_tree_splice(T, y, x); // Replace y with x (updates parent's child or root)
      x->right = y;                // Put y on x's right
      rb_node_set_parent(y, x);
+     if (T->augment) { T->augment(y); T->augment(x); }
  }
  
  // Insert node at specific position and fix up RB properties
@@ -137,6 +151,7 @@
          KERNEL_ASSERT(T->root == NULL, "Inserting into non-empty tree with NULL parent");
          T->root = node_ptr;
          rb_node_set_black(node_ptr); // Root must be black
+         rb_tree_augment_propagate(T, node_ptr);
          return;
      }
  
@@ -148,6 +163,7 @@
          KERNEL_ASSERT(parent->right == NULL, "Insert right target not NULL");
          parent->right = node_ptr;
      }
+     rb_tree_augment_propagate(T, node_ptr); // Rotations below keep it up to date
  
      // --- Insertion Fixup ---
      struct rb_node *z = node_ptr; // z is the newly inserted node (red)
@@ -246,6 +262,9 @@
          // Now 'y' is in z's original position, 'x' replaced y, 'x_p' is parent of x's original location
      }
  
+     // Every subtree that lost z is on the path from x_p to the root
+     rb_tree_augment_propagate(T, x_p);
+ 
      // If the removed/moved node 'y' was black, the black-height might be violated
      if (!y_was_black) {
          return; // If y was red, removing it doesn't affect black-height
@@ -453,6 +472,64 @@
  }
  
  
+ // --- Gap Augmentation ---
+ 
+ static inline uintptr_t gap_between(uintptr_t from, uintptr_t to) {
+     return (to > from) ? to - from : 0;
+ }
+ 
+ void rbtree_vma_augment(struct rb_node *node) {
+     vma_struct_t *vma = rb_entry(node, vma_struct_t, rb_node);
+     uintptr_t min_start = vma->vm_start, max_end = vma->vm_end, gap = 0;
+     if (node->left) {
+         vma_struct_t *l = rb_entry(node->left, vma_struct_t, rb_node);
+         min_start = l->rb_subtree_min_start;
+         gap = l->rb_subtree_gap;
+         uintptr_t g = gap_between(l->rb_subtree_max_end, vma->vm_start);
+         if (g > gap) gap = g;
+     }
+     if (node->right) {
+         vma_struct_t *r = rb_entry(node->right, vma_struct_t, rb_node);
+         max_end = r->rb_subtree_max_end;
+         if (r->rb_subtree_gap > gap) gap = r->rb_subtree_gap;
+         uintptr_t g = gap_between(vma->vm_end, r->rb_subtree_min_start);
+         if (g > gap) gap = g;
+     }
+     vma->rb_subtree_min_start = min_start;
+     vma->rb_subtree_max_end = max_end;
+     vma->rb_subtree_gap = gap;
+ }
+ 
+ /**
+  * Searches the free space in [prev_end, next_start) around subtree @p node,
+  * where prev_end/next_start are the neighbouring VMAs outside the subtree.
+  */
+ static uintptr_t rbtree_find_gap_in(struct rb_node *node, uintptr_t prev_end, uintptr_t next_start,
+                                     uintptr_t lo, uintptr_t hi, size_t length) {
+     if (prev_end >= hi || next_start <= lo) return 0;
+     if (!node) {
+         uintptr_t a = (prev_end > lo) ? prev_end : lo;
+         uintptr_t limit = (next_start < hi) ? next_start : hi;
+         return (limit > a && limit - a >= length) ? a : 0;
+     }
+     vma_struct_t *vma = rb_entry(node, vma_struct_t, rb_node);
+     // Prune: no free range in this window is long enough, wherever lo cuts it
+     if (gap_between(prev_end, vma->rb_subtree_min_start) < length &&
+         vma->rb_subtree_gap < length &&
+         gap_between(vma->rb_subtree_max_end, next_start) < length) {
+         return 0;
+     }
+     uintptr_t a = rbtree_find_gap_in(node->left, prev_end, vma->vm_start, lo, hi, length);
+     if (a) return a;
+     return rbtree_find_gap_in(node->right, vma->vm_end, next_start, lo, hi, length);
+ }
+ 
+ uintptr_t rbtree_find_gap(struct rb_node *root, uintptr_t lo, uintptr_t hi, size_t length) {
+     if (length == 0 || lo >= hi) return 0;
+     return rbtree_find_gap_in(root, 0, UINTPTR_MAX, lo, hi, length);
+ }
+ 
+ 
  // --- Traversal Implementation ---
  
  /**
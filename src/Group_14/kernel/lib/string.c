@@ -1,73 +1,39 @@
 #include <kernel/lib/string.h> // Include the header this file implements
-#include <libc/stdint.h> // For uintptr_t, uint8_t etc. used in optimized memcpy
+#include <libc/stdint.h> // For uintptr_t, uint8_t etc.
 #include <libc/stddef.h> // For size_t, NULL
 
-// Helper definitions for optimized memcpy
-typedef uintptr_t word_t; // Use native word size for potentially faster copies
-#define WORD_SIZE sizeof(word_t)
-#define WORD_MASK (WORD_SIZE - 1)
-
 /* --- Memory Manipulation Functions --- */
 
-void *memset(void *dest, int c, size_t n) {
-    unsigned char *ptr = (unsigned char *)dest;
-    unsigned char value = (unsigned char)c;
-
-    for (size_t i = 0; i < n; i++) {
-        ptr[i] = value;
-    }
-
-    return dest;
-}
+// memcpy, memmove and memset are in string_asm.asm (rep movsd/stosd).
+// copy_page/clear_page need the FPU and live in page_copy.c; the rest of
+// this file is freestanding and also linked into the userspace programs
+// (userspace/lib).
 
-/**
- * @brief Copies n bytes from memory area src to memory area dest.
- * Uses word-sized copies for aligned sections for better performance.
- * @warning The memory areas must not overlap. Use memmove if overlap is possible.
+/*
+ * Word-at-a-time scanning: an aligned 32-bit load never crosses a page, so
+ * reading up to three bytes past a terminator within the same word is safe.
+ * HAS_ZERO_BYTE(w) is non-zero iff some byte of w is zero.
  */
- void *memcpy(void *dest, const void *src, size_t n) {
-    unsigned char *d = dest;
-    const unsigned char *s = src;
-    while (n--) {
-        *d++ = *s++;
-    }
-    return dest;
-}
-
-
-void *memmove(void *dest, const void *src, size_t n) {
-    unsigned char *d = (unsigned char *)dest;
-    const unsigned char *s = (const unsigned char *)src;
-
-    // If dest is before src or they don't overlap significantly,
-    // a forward copy is safe.
-    if (d <= s || d >= s + n) {
-        // Can use memcpy (or the optimized forward copy logic within it)
-        return memcpy(dest, src, n); // Assuming memcpy is defined (either builtin or custom)
-    }
-
-    // Otherwise, regions overlap and dest is *after* src (d > s).
-    // Copy backward to avoid overwriting source data before it's read.
-    // Start from the end of the buffers.
-    d += n;
-    s += n;
-    while (n--) {
-        *(--d) = *(--s);
-    }
-
-    return dest; // Per standard, return the original destination pointer
-}
+typedef uint32_t __attribute__((__may_alias__)) str_word_t;
+#define STR_ONES            0x01010101u
+#define STR_HIGHS           0x80808080u
+#define HAS_ZERO_BYTE(w)    (((w) - STR_ONES) & ~(w) & STR_HIGHS)
+#define WORD_ALIGNED(p)     (((uintptr_t)(p) & 3) == 0)
+#define CO_ALIGNED(a, b)    ((((uintptr_t)(a) ^ (uintptr_t)(b)) & 3) == 0)
 
 void *memchr(const void *s, int c, size_t n) {
     const unsigned char *ptr = (const unsigned char *)s;
     unsigned char value = (unsigned char)c;
 
-    for (size_t i = 0; i < n; i++) {
-        if (ptr[i] == value) {
-            return (void *)(ptr + i); // Cast okay: returning pointer within original buffer
-        }
+    for (; n && !WORD_ALIGNED(ptr); ptr++, n--) {
+        if (*ptr == value) return (void *)ptr; // Cast okay: returning pointer within original buffer
+    }
+    const str_word_t *w = (const str_word_t *)ptr;
+    uint32_t pattern = value * STR_ONES;
+    for (; n >= 4 && !HAS_ZERO_BYTE(*w ^ pattern); w++, n -= 4) { }
+    for (ptr = (const unsigned char *)w; n; ptr++, n--) {
+        if (*ptr == value) return (void *)ptr;
     }
-
     return NULL;
 }
 
@@ -75,72 +41,69 @@ int memcmp(const void *s1, const void *s2, size_t n) {
     const unsigned char *p1 = (const unsigned char *)s1;
     const unsigned char *p2 = (const unsigned char *)s2;
 
-    for (size_t i = 0; i < n; i++) {
-        if (p1[i] != p2[i]) {
-            // Return difference of the first non-matching bytes
-            return p1[i] - p2[i];
+    // Skip equal words when both sides can be read aligned; bytes find the difference
+    if (CO_ALIGNED(p1, p2)) {
+        for (; n && !WORD_ALIGNED(p1); p1++, p2++, n--) {
+            if (*p1 != *p2) return *p1 - *p2;
         }
+        const str_word_t *w1 = (const str_word_t *)p1, *w2 = (const str_word_t *)p2;
+        for (; n >= 4 && *w1 == *w2; w1++, w2++, n -= 4) { }
+        p1 = (const unsigned char *)w1;
+        p2 = (const unsigned char *)w2;
+    }
+    for (; n; p1++, p2++, n--) {
+        if (*p1 != *p2) return *p1 - *p2; // Difference of the first non-matching bytes
     }
-
-    // All n bytes matched
     return 0;
 }
 
 /* --- String Manipulation Functions --- */
 
 size_t strlen(const char *s) {
-    size_t len = 0;
-    while (s[len] != '\0') {
-        len++;
+    const char *p = s;
+    for (; !WORD_ALIGNED(p); p++) {
+        if (*p == '\0') return (size_t)(p - s);
     }
-    return len;
+    const str_word_t *w = (const str_word_t *)p;
+    while (!HAS_ZERO_BYTE(*w)) w++;
+    for (p = (const char *)w; *p != '\0'; p++) { }
+    return (size_t)(p - s);
 }
 
 int strcmp(const char *s1, const char *s2) {
-    // Iterate while both strings have characters and they are equal
+    // Equal words without a terminator can be skipped whole
+    if (CO_ALIGNED(s1, s2)) {
+        for (; !WORD_ALIGNED(s1); s1++, s2++) {
+            if (*s1 != *s2 || *s1 == '\0') goto differ;
+        }
+        const str_word_t *w1 = (const str_word_t *)s1, *w2 = (const str_word_t *)s2;
+        for (; *w1 == *w2 && !HAS_ZERO_BYTE(*w1); w1++, w2++) { }
+        s1 = (const char *)w1;
+        s2 = (const char *)w2;
+    }
     while (*s1 && (*s1 == *s2)) {
         s1++;
         s2++;
     }
-    // Return the difference of the first non-matching characters
-    // or the difference when one string ends (e.g., 'A' vs 'A\0' -> 0 - 'A')
+differ:
     // Cast to unsigned char before subtraction as per C standard
     return *(const unsigned char *)s1 - *(const unsigned char *)s2;
 }
 
 int strncmp(const char *s1, const char *s2, size_t n) {
-    if (n == 0) {
-        return 0;
+    if (CO_ALIGNED(s1, s2)) {
+        for (; n && !WORD_ALIGNED(s1); s1++, s2++, n--) {
+            if (*s1 != *s2 || *s1 == '\0') return *(const unsigned char *)s1 - *(const unsigned char *)s2;
+        }
+        const str_word_t *w1 = (const str_word_t *)s1, *w2 = (const str_word_t *)s2;
+        for (; n >= 4 && *w1 == *w2 && !HAS_ZERO_BYTE(*w1); w1++, w2++, n -= 4) { }
+        s1 = (const char *)w1;
+        s2 = (const char *)w2;
     }
-
-    while (n-- > 0 && *s1 && (*s1 == *s2)) {
-        // If we decrement n to 0 here, it means we compared n chars and they matched
-        if (n == 0) break;
-        s1++;
-        s2++;
+    for (; n; s1++, s2++, n--) {
+        if (*s1 != *s2 || *s1 == '\0') return *(const unsigned char *)s1 - *(const unsigned char *)s2;
     }
-
-    // If n is 0 here, it means the loop terminated because n characters were matched
-    // Otherwise, the loop terminated because *s1 or *s2 was null, or *s1 != *s2
-    // Return the difference of the characters at the point of termination
-    // Cast to unsigned char before subtraction as per C standard
-     return (n == (size_t)-1) ? 0 : *(const unsigned char*)s1 - *(const unsigned char*)s2;
-
-     // Note: The n == (size_t)-1 check is a bit obscure way to check if n became 0
-     // *after* the decrement in the loop condition when the characters matched.
-     // A potentially clearer way:
-     /*
-     size_t i = 0;
-     while (i < n && s1[i] && s2[i] && s1[i] == s2[i]) {
-         i++;
-     }
-     if (i == n) {
-         return 0; // Compared n characters and all matched
-     } else {
-         // Return difference at the point of mismatch or end-of-string
-         return *(const unsigned char*)(s1 + i) - *(const unsigned char*)(s2 + i);
-     }
-     */
+    return 0; // n characters compared equal
 }
 
 
@@ -202,17 +165,19 @@ char *strncat(char *dest, const char *src, size_t n) {
 
 char *strchr(const char *s, int c) {
     char char_to_find = (char)c;
-    while (*s != '\0') {
-        if (*s == char_to_find) {
-            return (char *)s; // Cast away const-ness as per standard C library behavior
-        }
-        s++;
+    for (; !WORD_ALIGNED(s); s++) {
+        if (*s == char_to_find) return (char *)s; // Cast away const-ness as per standard C library behavior
+        if (*s == '\0') return NULL;
     }
-    // If c was '\0', return pointer to the string's null terminator
-    if (char_to_find == '\0') {
-        return (char *)s;
+    // Skip words holding neither the character nor the terminator
+    const str_word_t *w = (const str_word_t *)s;
+    uint32_t pattern = (unsigned char)char_to_find * STR_ONES;
+    while (!HAS_ZERO_BYTE(*w) && !HAS_ZERO_BYTE(*w ^ pattern)) w++;
+    for (s = (const char *)w; ; s++) {
+        // If c was '\0', this is the string's null terminator
+        if (*s == char_to_find) return (char *)s;
+        if (*s == '\0') return NULL;
     }
-    return NULL;
 }
 
 char *strrchr(const char *s, int c) {
@@ -0,0 +1,187 @@
+; string_asm.asm
+; Bulk memory primitives behind kernel/lib/string.c: memcpy, memmove and
+; memset move the bulk with rep movsd/stosd once the destination is dword
+; aligned, with bytes for the head and tail. The whole-page (4 KiB,
+; page-aligned destination) helpers come in a rep movsd/stosd flavour and
+; an SSE2 one with non-temporal stores; copy_page()/clear_page() in
+; page_copy.c pick between them and bracket the SSE2 ones with
+; kernel_fpu_begin/end. Also linked into the userspace programs with
+; string.c (userspace/lib), which only use the first three.
+; cdecl: EBX, ESI, EDI and EBP are preserved and DF is clear on return.
+
+BITS 32
+
+SECTION .text
+GLOBAL memcpy
+GLOBAL memmove
+GLOBAL memset
+GLOBAL copy_page_movsd
+GLOBAL clear_page_stosd
+GLOBAL copy_page_sse2
+GLOBAL clear_page_sse2
+
+%define SHORT_COPY  16          ; Below this, bytes only: aligning costs more than it saves
+%define PAGE_DWORDS 1024
+%define PAGE_LINES  64          ; 64-byte chunks per page (four XMM registers)
+
+; void *memcpy(void *dest, const void *src, size_t n)
+memcpy:
+    push edi
+    push esi
+    mov edi, [esp + 12]         ; dest
+    mov esi, [esp + 16]         ; src
+    mov ecx, [esp + 20]         ; n
+    mov eax, edi                ; Return value
+
+; EDI = dest, ESI = src, ECX = n, ESI/EDI pushed: copies upwards and returns
+copy_forward:
+    cmp ecx, SHORT_COPY
+    jb .tail
+    mov edx, edi                ; Head: bytes up to the next dword boundary of dest
+    neg edx
+    and edx, 3
+    sub ecx, edx
+    xchg ecx, edx
+    rep movsb
+    mov ecx, edx
+    shr ecx, 2
+    rep movsd
+    mov ecx, edx
+    and ecx, 3
+.tail:
+    rep movsb
+    pop esi
+    pop edi
+    ret
+
+; void *memmove(void *dest, const void *src, size_t n)
+memmove:
+    push edi
+    push esi
+    mov edi, [esp + 12]
+    mov esi, [esp + 16]
+    mov ecx, [esp + 20]
+    mov eax, edi
+    mov edx, edi
+    sub edx, esi                ; dest - src, unsigned: >= n unless dest lies inside (src, src + n)
+    cmp edx, ecx
+    jae copy_forward
+
+    ; Overlap with dest above src: copy downwards from the last byte
+    lea esi, [esi + ecx - 1]
+    lea edi, [edi + ecx - 1]
+    std
+    cmp ecx, SHORT_COPY
+    jb .tail
+    lea edx, [edi + 1]          ; Tail first: bytes down to a dword boundary of dest's end
+    and edx, 3
+    sub ecx, edx
+    xchg ecx, edx
+    rep movsb
+    sub esi, 3                  ; movsd works on the dword ending at the current byte
+    sub edi, 3
+    mov ecx, edx
+    shr ecx, 2
+    rep movsd
+    add esi, 3
+    add edi, 3
+    mov ecx, edx
+    and ecx, 3
+.tail:
+    rep movsb
+    cld
+    pop esi
+    pop edi
+    ret
+
+; void *memset(void *dest, int c, size_t n)
+memset:
+    push edi
+    mov edi, [esp + 8]          ; dest
+    movzx eax, byte [esp + 12]  ; c
+    mov ecx, [esp + 16]         ; n
+    cmp ecx, SHORT_COPY
+    jb .tail
+    imul eax, eax, 0x01010101   ; The byte in all four lanes
+    mov edx, edi
+    neg edx
+    and edx, 3
+    sub ecx, edx
+    xchg ecx, edx
+    rep stosb
+    mov ecx, edx
+    shr ecx, 2
+    rep stosd
+    mov ecx, edx
+    and ecx, 3
+.tail:
+    rep stosb
+    pop edi
+    mov eax, [esp + 4]          ; Return dest
+    ret
+
+; void copy_page_movsd(void *dest, const void *src)
+copy_page_movsd:
+    push edi
+    push esi
+    mov edi, [esp + 12]
+    mov esi, [esp + 16]
+    mov ecx, PAGE_DWORDS
+    rep movsd
+    pop esi
+    pop edi
+    ret
+
+; void clear_page_stosd(void *dest)
+clear_page_stosd:
+    push edi
+    mov edi, [esp + 8]
+    xor eax, eax
+    mov ecx, PAGE_DWORDS
+    rep stosd
+    pop edi
+    ret
+
+; void copy_page_sse2(void *dest, const void *src) -- inside kernel_fpu_begin/end
+; Stores bypass the cache (movntdq needs the 16-byte aligned dest); src may
+; be unaligned. Clobbers XMM0-XMM3.
+copy_page_sse2:
+    push edi
+    push esi
+    mov edi, [esp + 12]
+    mov esi, [esp + 16]
+    mov ecx, PAGE_LINES
+.loop:
+    prefetchnta [esi + 256]     ; Never faults, even past the end of src
+    movdqu xmm0, [esi]
+    movdqu xmm1, [esi + 16]
+    movdqu xmm2, [esi + 32]
+    movdqu xmm3, [esi + 48]
+    movntdq [edi], xmm0
+    movntdq [edi + 16], xmm1
+    movntdq [edi + 32], xmm2
+    movntdq [edi + 48], xmm3
+    add esi, 64
+    add edi, 64
+    dec ecx
+    jnz .loop
+    sfence                      ; Order the streaming stores before the page is used
+    pop esi
+    pop edi
+    ret
+
+; void clear_page_sse2(void *dest) -- inside kernel_fpu_begin/end; clobbers XMM0
+clear_page_sse2:
+    mov edx, [esp + 4]
+    mov ecx, PAGE_LINES
+    pxor xmm0, xmm0
+.loop:
+    movntdq [edx], xmm0
+    movntdq [edx + 16], xmm0
+    movntdq [edx + 32], xmm0
+    movntdq [edx + 48], xmm0
+    add edx, 64
+    dec ecx
+    jnz .loop
+    sfence
+    ret
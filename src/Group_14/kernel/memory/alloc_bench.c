@@ -0,0 +1,246 @@
+/**
+ * @file alloc_bench.c
+ * @brief Boot-time throughput and fragmentation benchmarks for the allocators.
+ */
+
+#include <kernel/memory/alloc_bench.h>
+#include <kernel/memory/buddy.h>
+#include <kernel/memory/frame.h>
+#include <kernel/memory/kmalloc.h>
+#include <kernel/memory/slab.h>
+#include <kernel/memory/paging.h>
+#include <kernel/cpu/tsc.h>
+#include <kernel/lib/div64.h>
+#include <kernel/drivers/display/serial.h>
+
+#define BENCH_FIXED_SIZE        64     // Object size for the fixed-size workload and slab cache
+#define BENCH_MIN_SIZE          16     // Mixed-size range
+#define BENCH_MAX_SIZE          2048
+#define BENCH_FRAG_SMALL        128    // Fragmentation workload: pinned small blocks...
+#define BENCH_FRAG_LARGE        8192   // ...between which large requests must fit
+
+typedef struct bench_allocator {
+    const char *name;
+    bool        fixed_size;            // Ignores the requested size (slab, frames)
+    void     *(*alloc)(size_t size);
+    void      (*free)(void *ptr);
+} bench_allocator_t;
+
+typedef struct bench_result {
+    uint32_t ops;
+    uint64_t cycles;
+    uint32_t frag_peak_pct;
+} bench_result_t;
+
+static void   *s_slots[ALLOC_BENCH_SLOTS];
+static size_t  s_sizes[ALLOC_BENCH_SLOTS];
+static slab_cache_t *s_bench_cache = NULL;
+
+//============================================================================
+// Allocator Adapters
+//============================================================================
+static void *bench_kmalloc(size_t size) { return kmalloc(size); }
+static void  bench_kfree(void *ptr)     { kfree(ptr); }
+
+static void *bench_slab_alloc(size_t size) { (void)size; return slab_alloc(s_bench_cache); }
+static void  bench_slab_free(void *ptr)    { slab_free(s_bench_cache, ptr); }
+
+static void *bench_buddy_alloc(size_t size) { return BUDDY_ALLOC(size); }
+static void  bench_buddy_free(void *ptr)    { BUDDY_FREE(ptr); }
+
+// Frames are physical addresses; the benchmark only stores and returns them.
+static void *bench_frame_alloc(size_t size) { (void)size; return (void *)frame_alloc(); }
+static void  bench_frame_free(void *ptr)    { put_frame((uintptr_t)ptr); }
+
+static const bench_allocator_t s_allocators[] = {
+    { "kmalloc", false, bench_kmalloc,     bench_kfree },
+    { "slab",    true,  bench_slab_alloc,  bench_slab_free },
+    { "buddy",   false, bench_buddy_alloc, bench_buddy_free },
+    { "frame",   true,  bench_frame_alloc, bench_frame_free },
+};
+
+//============================================================================
+// Helpers
+//============================================================================
+/** @brief xorshift32; deterministic so runs are comparable across releases. */
+static uint32_t bench_rand(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static uint32_t bench_frag_pct(void) {
+    buddy_stats_t stats;
+    buddy_get_stats(&stats);
+    if (stats.free_bytes == 0) return 100;
+    return 100 - (uint32_t)div_u64_rem((uint64_t)stats.largest_free_block * 100, stats.free_bytes, NULL);
+}
+
+static void bench_sample_frag(bench_result_t *r) {
+    uint32_t pct = bench_frag_pct();
+    if (pct > r->frag_peak_pct) r->frag_peak_pct = pct;
+}
+
+/** @brief Timed fill of slots [0, n) with the sizes in s_sizes. Returns slots filled. */
+static uint32_t bench_fill(const bench_allocator_t *a, uint32_t n, bench_result_t *r) {
+    uint32_t filled = 0;
+    uint64_t start = read_tsc();
+    for (; filled < n; filled++) {
+        s_slots[filled] = a->alloc(s_sizes[filled]);
+        if (!s_slots[filled]) break;
+    }
+    r->cycles += read_tsc() - start;
+    r->ops += filled;
+    return filled;
+}
+
+/** @brief Timed free of every non-NULL slot in [0, n). */
+static void bench_drain(const bench_allocator_t *a, uint32_t n, bench_result_t *r) {
+    uint32_t freed = 0;
+    uint64_t start = read_tsc();
+    for (uint32_t i = 0; i < n; i++) {
+        if (!s_slots[i]) continue;
+        a->free(s_slots[i]);
+        s_slots[i] = NULL;
+        freed++;
+    }
+    r->cycles += read_tsc() - start;
+    r->ops += freed;
+}
+
+static void bench_report(const bench_allocator_t *a, const char *workload, const bench_result_t *r) {
+    uint32_t per_op = r->ops ? (uint32_t)div_u64_rem(r->cycles, r->ops, NULL) : 0;
+    serial_printf("[AllocBench] alloc=%s workload=%s ops=%lu cycles_per_op=%lu frag_peak_pct=%lu\n",
+                  a->name, workload, (unsigned long)r->ops, (unsigned long)per_op,
+                  (unsigned long)r->frag_peak_pct);
+}
+
+//============================================================================
+// Workloads
+//============================================================================
+/** @brief Fill and drain all slots with one size. */
+static void bench_fixed(const bench_allocator_t *a) {
+    bench_result_t r = { 0, 0, 0 };
+    for (uint32_t i = 0; i < ALLOC_BENCH_SLOTS; i++) s_sizes[i] = BENCH_FIXED_SIZE;
+    for (uint32_t round = 0; round < ALLOC_BENCH_ROUNDS; round++) {
+        uint32_t n = bench_fill(a, ALLOC_BENCH_SLOTS, &r);
+        bench_sample_frag(&r);
+        bench_drain(a, n, &r);
+    }
+    bench_report(a, "fixed", &r);
+}
+
+/** @brief Fill with random sizes, free in random order. */
+static void bench_mixed(const bench_allocator_t *a) {
+    bench_result_t r = { 0, 0, 0 };
+    uint32_t seed = 0x1234567u;
+    for (uint32_t round = 0; round < ALLOC_BENCH_ROUNDS; round++) {
+        for (uint32_t i = 0; i < ALLOC_BENCH_SLOTS; i++) {
+            s_sizes[i] = BENCH_MIN_SIZE + bench_rand(&seed) % (BENCH_MAX_SIZE - BENCH_MIN_SIZE + 1);
+        }
+        uint32_t n = bench_fill(a, ALLOC_BENCH_SLOTS, &r);
+        bench_sample_frag(&r);
+
+        // Shuffle so frees don't simply mirror the allocation order.
+        for (uint32_t i = n; i > 1; i--) {
+            uint32_t j = bench_rand(&seed) % i;
+            void *tmp = s_slots[i - 1];
+            s_slots[i - 1] = s_slots[j];
+            s_slots[j] = tmp;
+        }
+        bench_drain(a, n, &r);
+    }
+    bench_report(a, "mixed", &r);
+}
+
+/**
+ * @brief A FIFO of live blocks: each step frees the oldest and allocates a
+ * replacement, as a producer handing buffers to a consumer would.
+ */
+static void bench_producer_consumer(const bench_allocator_t *a) {
+    bench_result_t r = { 0, 0, 0 };
+    uint32_t seed = 0x89abcdefu;
+    for (uint32_t i = 0; i < ALLOC_BENCH_SLOTS; i++) {
+        s_sizes[i] = BENCH_MIN_SIZE + bench_rand(&seed) % (BENCH_MAX_SIZE - BENCH_MIN_SIZE + 1);
+    }
+    uint32_t n = bench_fill(a, ALLOC_BENCH_SLOTS, &r);
+    uint32_t steps = n * ALLOC_BENCH_ROUNDS;
+    uint64_t start = read_tsc();
+    for (uint32_t step = 0; step < steps; step++) {
+        uint32_t tail = step % n;
+        a->free(s_slots[tail]);
+        s_slots[tail] = a->alloc(s_sizes[(step * 7) % ALLOC_BENCH_SLOTS]);
+        r.ops += 2;
+        if (!s_slots[tail]) break;
+    }
+    r.cycles += read_tsc() - start;
+    bench_sample_frag(&r);
+    bench_drain(a, n, &r);
+    bench_report(a, "prodcons", &r);
+}
+
+/**
+ * @brief Pins small blocks between freed ones, then asks for large blocks
+ * that can't reuse the holes. Reports the worst fragmentation reached.
+ */
+static void bench_fragmentation(const bench_allocator_t *a) {
+    bench_result_t r = { 0, 0, 0 };
+    uint32_t half = ALLOC_BENCH_SLOTS / 2;
+    for (uint32_t round = 0; round < ALLOC_BENCH_ROUNDS / 4; round++) {
+        for (uint32_t i = 0; i < half; i++) s_sizes[i] = BENCH_FRAG_SMALL;
+        uint32_t n = bench_fill(a, half, &r);
+
+        // Free every other small block, leaving holes between pinned ones.
+        uint64_t start = read_tsc();
+        uint32_t freed = 0;
+        for (uint32_t i = 0; i < n; i += 2) {
+            a->free(s_slots[i]);
+            s_slots[i] = NULL;
+            freed++;
+        }
+        r.cycles += read_tsc() - start;
+        r.ops += freed;
+        bench_sample_frag(&r);
+
+        uint32_t large = 0;
+        start = read_tsc();
+        for (; large < half / 4; large++) {
+            s_slots[half + large] = a->alloc(BENCH_FRAG_LARGE);
+            if (!s_slots[half + large]) break;
+        }
+        r.cycles += read_tsc() - start;
+        r.ops += large;
+        bench_sample_frag(&r);
+        bench_drain(a, half + large, &r);
+    }
+    bench_report(a, "frag", &r);
+}
+
+//============================================================================
+// Public API
+//============================================================================
+void alloc_bench_run(void) {
+    serial_printf("[AllocBench] --- Allocator benchmarks (slots=%u rounds=%u) ---\n",
+                  (unsigned)ALLOC_BENCH_SLOTS, (unsigned)ALLOC_BENCH_ROUNDS);
+    s_bench_cache = slab_create("alloc_bench", BENCH_FIXED_SIZE, 0, 0, NULL, NULL);
+    for (uint32_t i = 0; i < ALLOC_BENCH_SLOTS; i++) s_slots[i] = NULL;
+
+    for (size_t i = 0; i < sizeof(s_allocators) / sizeof(s_allocators[0]); i++) {
+        const bench_allocator_t *a = &s_allocators[i];
+        if (a->alloc == bench_slab_alloc && !s_bench_cache) {
+            serial_printf("[AllocBench] alloc=%s skipped: no cache\n", a->name);
+            continue;
+        }
+        bench_fixed(a);
+        if (!a->fixed_size) bench_mixed(a);
+        bench_producer_consumer(a);
+        if (!a->fixed_size) bench_fragmentation(a);
+    }
+
+    if (s_bench_cache) slab_destroy(s_bench_cache);
+    s_bench_cache = NULL;
+    serial_printf("[AllocBench] --- done ---\n");
+}
@@ -24,6 +24,9 @@
 #include <kernel/memory/paging.h>           // For PAGE_SIZE, KERNEL_SPACE_VIRT_START
 #include <kernel/lib/string.h>           // For memset (use kernel's version)
 #include <kernel/lib/assert.h>           // For BUDDY_PANIC, BUDDY_ASSERT
+#include <kernel/memory/shrinker.h>       // Direct reclaim on OOM, watermarks
+#include <kernel/cpu/percpu_counter.h>    // Allocation and free counts
+#include <kernel/lib/div64.h>             // Fragmentation index arithmetic
 
 // === Configuration & Constants ===
 
@@ -84,27 +87,79 @@ typedef struct buddy_header {
  */
 typedef struct buddy_block {
     struct buddy_block *next;
+    struct buddy_block *prev; // Doubly linked so a known block unlinks in O(1)
+    uint8_t migratetype;      // Whose free list the block is on
 } buddy_block_t;
+_Static_assert(sizeof(buddy_block_t) <= MIN_BLOCK_SIZE_INTERNAL, "Free block link must fit in the smallest block");
+
+// --- Buddy Pair Bitmaps ---
+// One bit per buddy pair and order below MAX_ORDER, holding
+// free(A) XOR free(B) for the pair's two halves at that order. It is toggled
+// whenever either half enters or leaves the order's free list, so a set bit
+// seen while freeing one half means its buddy is on the free list: coalescing
+// tests a bit instead of walking the list. The bitmaps are carved from the
+// end of the heap region at init.
+#define BUDDY_PAIR_INDEX(addr, order) (((addr) - g_heap_start_virt_addr) >> ((order) + 1))
+
+// --- Pageblocks ---
+// The heap is cut into PAGEBLOCK_ORDER pageblocks, each tagged with a
+// mobility type (see buddy.h) and with a count of its bytes sitting on free
+// lists. A free block joins the lists of the type of the pageblock it
+// starts in; blocks above PAGEBLOCK_ORDER span several pageblocks and count
+// as free in each. Both arrays are carved next to the pair bitmaps.
+#define PAGEBLOCK_SIZE (1UL << PAGEBLOCK_ORDER)
+#define BUDDY_PAGEBLOCK(addr) ((uint32_t)(((addr) - g_heap_start_virt_addr) >> PAGEBLOCK_ORDER))
+_Static_assert(PAGEBLOCK_ORDER >= PAGE_ORDER && PAGEBLOCK_ORDER <= MAX_ORDER, "Pageblocks must be whole buddy blocks");
+_Static_assert(MIGRATE_TYPES <= 256, "Pageblock tags are bytes");
+
+// Lists a type steals from, best first: unmovable and reclaimable blocks
+// share pageblocks before either spoils a movable one.
+static const uint8_t g_migrate_fallbacks[MIGRATE_TYPES][MIGRATE_TYPES - 1] = {
+    [MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE },
+    [MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE, MIGRATE_MOVABLE },
+    [MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE },
+};
 
 // === Global State ===
-static buddy_block_t *free_lists[MAX_ORDER + 1] = {0}; // Array of free lists per order
+static buddy_block_t *free_lists[MIGRATE_TYPES][MAX_ORDER + 1] = {{0}}; // Free lists per type and order
+static uint32_t g_nr_free[MIGRATE_TYPES][MAX_ORDER + 1] = {{0}};       // Lengths of those lists
 static uintptr_t g_heap_start_virt_addr = 0;           // Aligned VIRTUAL start address of managed heap
 static uintptr_t g_heap_end_virt_addr = 0;             // VIRTUAL end address (exclusive) of managed heap
 static uintptr_t g_buddy_heap_phys_start_addr = 0;     // Aligned PHYSICAL start address of managed heap
 static size_t g_buddy_total_managed_size = 0;          // Total size managed by the allocator
 static size_t g_buddy_free_bytes = 0;                  // Current free bytes (tracked approximately)
 static spinlock_t g_buddy_lock;                        // Lock protecting allocator state
+static uint32_t *g_pair_bitmaps[MAX_ORDER] = {0};      // Per-order buddy pair bits (see above)
+static uint8_t *g_pageblock_type = NULL;               // Mobility type per pageblock
+static uint32_t *g_pageblock_free = NULL;              // Free bytes per pageblock
+static uint32_t g_nr_pageblocks = 0;
 
 // Statistics
-static uint64_t g_alloc_count = 0;
-static uint64_t g_free_count = 0;
+static percpu_counter_t g_alloc_count; // Per-CPU, summed by buddy_get_stats()
+static percpu_counter_t g_free_count;
 static uint64_t g_failed_alloc_count = 0;
+static uint32_t g_fallback_count = 0; // Allocations served by stealing
+static uint32_t g_claim_count = 0;    // Pageblocks retagged by a steal
 
 // --- Debug Allocation Tracker ---
 #ifdef DEBUG_BUDDY
 #define DEBUG_CANARY_START 0xDEADBEEF
 #define DEBUG_CANARY_END   0xCAFEBABE
-#define MAX_TRACKER_NODES 1024 // Adjust as needed
+#define TRACKER_SEED_NODES   1024  // Static nodes available before the pool first grows
+#define TRACKER_SEED_SLOTS   2048  // Static hash slots (power of two) before the table first grows
+#define TRACKER_SITE_BUCKETS 128   // Call-site hash buckets (power of two)
+
+/**
+ * @brief Per call-site aggregate of the allocations made from one file:line.
+ */
+typedef struct alloc_site {
+    const char* file;
+    int line;
+    uint32_t live_blocks;            // Blocks allocated here and not yet freed
+    size_t live_bytes;               // Buddy bytes held by those blocks
+    uint64_t total_allocs;           // Every allocation ever made here
+    struct alloc_site* next;         // Chain in g_site_buckets
+} alloc_site_t;
 
 /**
  * @brief Structure to track allocations in debug builds.
@@ -116,29 +171,130 @@ typedef struct allocation_tracker {
     int    order;                    // Order of the buddy block
     const char* source_file;         // File where allocation occurred
     int source_line;                 // Line where allocation occurred
-    struct allocation_tracker* next; // Link for active/free lists
+    alloc_site_t* site;              // Call-site aggregate (NULL if none could be made)
+    struct allocation_tracker* next; // Link for the free node list
 } allocation_tracker_t;
 
-static allocation_tracker_t g_tracker_nodes[MAX_TRACKER_NODES]; // Static pool
-static allocation_tracker_t *g_free_tracker_nodes = NULL;      // List of free tracker nodes
-static allocation_tracker_t *g_active_allocations = NULL;      // List of active allocations
-static spinlock_t g_alloc_tracker_lock;                        // Lock for tracker lists
+// Active allocations live in an open-addressed (linear probing) hash table
+// keyed by block address, so a free finds its tracker in O(1) however many
+// blocks are live. Nodes, sites and larger tables come from the buddy
+// allocator itself as raw blocks; those blocks are never tracked.
+static allocation_tracker_t g_tracker_nodes[TRACKER_SEED_NODES];   // Seed pool
+static allocation_tracker_t *g_tracker_seed_table[TRACKER_SEED_SLOTS];
+static allocation_tracker_t **g_tracker_table = NULL;              // Active allocations by block address
+static uint32_t g_tracker_table_bits = 0;                          // log2 of the slot count
+static uint32_t g_tracker_count = 0;                               // Occupied slots
+static allocation_tracker_t *g_free_tracker_nodes = NULL;          // List of free tracker nodes
+static alloc_site_t *g_site_buckets[TRACKER_SITE_BUCKETS];
+static uint8_t *g_site_carve = NULL, *g_site_carve_end = NULL;     // Bump region for new sites
+static spinlock_t g_alloc_tracker_lock;                            // Lock for all tracker state
+
+static void* buddy_alloc_impl(int requested_order, int migratetype, const char* file, int line);
+static void buddy_free_impl(void *block_addr_virt, int block_order, const char* file, int line);
+
+/** @brief Takes a raw block for tracker metadata. Buddy lock nests inside the tracker lock. */
+static void *tracker_block_alloc(int order) {
+    uintptr_t buddy_irq_flags = spinlock_acquire_irqsave(&g_buddy_lock);
+    void *block = buddy_alloc_impl(order, MIGRATE_UNMOVABLE, __FILE__, __LINE__);
+    spinlock_release_irqrestore(&g_buddy_lock, buddy_irq_flags);
+    return block;
+}
 
-/** @brief Initializes the debug tracker node pool. */
+static inline uint32_t tracker_hash(const void *block_addr) {
+    return (uint32_t)(((uintptr_t)block_addr >> MIN_INTERNAL_ORDER) * 0x9E3779B1u) >> (32 - g_tracker_table_bits);
+}
+
+/** @brief Initializes the debug tracker node pool, hash table and site table. */
 static void init_tracker_pool() {
     spinlock_init(&g_alloc_tracker_lock);
     g_free_tracker_nodes = NULL;
-    g_active_allocations = NULL;
-    for (int i = 0; i < MAX_TRACKER_NODES; ++i) {
+    for (int i = 0; i < TRACKER_SEED_NODES; ++i) {
         g_tracker_nodes[i].next = g_free_tracker_nodes;
         g_free_tracker_nodes = &g_tracker_nodes[i];
     }
+    memset(g_tracker_seed_table, 0, sizeof(g_tracker_seed_table));
+    g_tracker_table = g_tracker_seed_table;
+    g_tracker_table_bits = 11;
+    _Static_assert((1u << 11) == TRACKER_SEED_SLOTS, "Seed table bits must match its size");
+    g_tracker_count = 0;
+    memset(g_site_buckets, 0, sizeof(g_site_buckets));
+    g_site_carve = g_site_carve_end = NULL;
+}
+
+/**
+ * @brief Doubles the hash table, rehashing every entry.
+ * @return false if no larger table could be allocated.
+ * @note Assumes the tracker lock is held.
+ */
+static bool tracker_table_grow(void) {
+    uint32_t old_bits = g_tracker_table_bits;
+    uint32_t old_slots = 1u << old_bits;
+    int order = PAGE_ORDER;
+    while (order <= MAX_ORDER && ((size_t)1 << order) < (size_t)old_slots * 2 * sizeof(void *)) order++;
+    if (order > MAX_ORDER) return false;
+
+    allocation_tracker_t **table = (allocation_tracker_t **)tracker_block_alloc(order);
+    if (!table) return false;
+    memset(table, 0, (size_t)1 << order);
+
+    allocation_tracker_t **old = g_tracker_table;
+    g_tracker_table = table;
+    g_tracker_table_bits = old_bits + 1;
+    uint32_t mask = (1u << g_tracker_table_bits) - 1;
+    for (uint32_t i = 0; i < old_slots; i++) {
+        if (!old[i]) continue;
+        uint32_t j = tracker_hash(old[i]->block_addr);
+        while (table[j]) j = (j + 1) & mask;
+        table[j] = old[i];
+    }
+
+    if (old != g_tracker_seed_table) {
+        int old_order = PAGE_ORDER;
+        while (((size_t)1 << old_order) < (size_t)old_slots * sizeof(void *)) old_order++;
+        uintptr_t buddy_irq_flags = spinlock_acquire_irqsave(&g_buddy_lock);
+        buddy_free_impl(old, old_order, __FILE__, __LINE__);
+        spinlock_release_irqrestore(&g_buddy_lock, buddy_irq_flags);
+    }
+    return true;
+}
+
+/**
+ * @brief Finds or creates the aggregate for @p file:@p line.
+ * @note Assumes the tracker lock is held.
+ */
+static alloc_site_t *tracker_site_get(const char *file, int line) {
+    uint32_t b = (uint32_t)(((uintptr_t)file >> 2) ^ ((uint32_t)line * 0x9E3779B1u)) & (TRACKER_SITE_BUCKETS - 1);
+    for (alloc_site_t *s = g_site_buckets[b]; s; s = s->next) {
+        if (s->file == file && s->line == line) return s;
+    }
+    if ((size_t)(g_site_carve_end - g_site_carve) < sizeof(alloc_site_t)) {
+        g_site_carve = (uint8_t *)tracker_block_alloc(PAGE_ORDER);
+        if (!g_site_carve) { g_site_carve_end = NULL; return NULL; }
+        g_site_carve_end = g_site_carve + PAGE_SIZE;
+    }
+    alloc_site_t *s = (alloc_site_t *)g_site_carve;
+    g_site_carve += sizeof(alloc_site_t);
+    s->file = file;
+    s->line = line;
+    s->live_blocks = 0;
+    s->live_bytes = 0;
+    s->total_allocs = 0;
+    s->next = g_site_buckets[b];
+    g_site_buckets[b] = s;
+    return s;
 }
 
-/** @brief Allocates a tracker node from the free pool. Returns NULL if pool is empty. */
+/** @brief Allocates a tracker node, growing the pool by a page when it is empty. Returns NULL on OOM. */
 static allocation_tracker_t* alloc_tracker_node() {
     allocation_tracker_t* node = NULL;
     uintptr_t tracker_irq_flags = spinlock_acquire_irqsave(&g_alloc_tracker_lock);
+    if (!g_free_tracker_nodes) {
+        allocation_tracker_t *chunk = (allocation_tracker_t *)tracker_block_alloc(PAGE_ORDER);
+        for (size_t i = 0; chunk && i < PAGE_SIZE / sizeof(allocation_tracker_t); i++) {
+            chunk[i].next = g_free_tracker_nodes;
+            g_free_tracker_nodes = &chunk[i];
+        }
+    }
     if (g_free_tracker_nodes) {
         node = g_free_tracker_nodes;
         g_free_tracker_nodes = node->next;
@@ -160,29 +316,61 @@ static void free_tracker_node(allocation_tracker_t* node) {
     spinlock_release_irqrestore(&g_alloc_tracker_lock, tracker_irq_flags);
 }
 
-/** @brief Adds a tracker node to the active allocations list. */
-static void add_active_allocation(allocation_tracker_t* tracker) {
-    if (!tracker) return;
+/**
+ * @brief Inserts a filled-in tracker into the active table and charges its call site.
+ * @return false if the table is full and could not grow.
+ */
+static bool add_active_allocation(allocation_tracker_t* tracker) {
+    if (!tracker) return false;
     uintptr_t tracker_irq_flags = spinlock_acquire_irqsave(&g_alloc_tracker_lock);
-    tracker->next = g_active_allocations;
-    g_active_allocations = tracker;
+    // Keep the load factor at or below one half so probe runs stay short.
+    if ((g_tracker_count + 1) * 2 > (1u << g_tracker_table_bits) && !tracker_table_grow() &&
+        g_tracker_count + 1 >= (1u << g_tracker_table_bits)) {
+        spinlock_release_irqrestore(&g_alloc_tracker_lock, tracker_irq_flags);
+        return false;
+    }
+    uint32_t mask = (1u << g_tracker_table_bits) - 1;
+    uint32_t i = tracker_hash(tracker->block_addr);
+    while (g_tracker_table[i]) i = (i + 1) & mask;
+    g_tracker_table[i] = tracker;
+    g_tracker_count++;
+
+    tracker->site = tracker_site_get(tracker->source_file, tracker->source_line);
+    if (tracker->site) {
+        tracker->site->live_blocks++;
+        tracker->site->live_bytes += tracker->block_size;
+        tracker->site->total_allocs++;
+    }
     spinlock_release_irqrestore(&g_alloc_tracker_lock, tracker_irq_flags);
+    return true;
 }
 
 /** @brief Removes and returns the tracker node corresponding to user_addr. Returns NULL if not found. */
 static allocation_tracker_t* remove_active_allocation(void* user_addr) {
     allocation_tracker_t* found_tracker = NULL;
-    allocation_tracker_t** prev_next_ptr = &g_active_allocations;
     uintptr_t tracker_irq_flags = spinlock_acquire_irqsave(&g_alloc_tracker_lock);
-    allocation_tracker_t* current = g_active_allocations;
-    while (current) {
-        if (current->user_addr == user_addr) {
-            found_tracker = current;
-            *prev_next_ptr = current->next; // Unlink
-            break;
+    uint32_t mask = (1u << g_tracker_table_bits) - 1;
+    uint32_t i = tracker_hash(user_addr); // User address is the block address in debug builds
+    while (g_tracker_table[i] && g_tracker_table[i]->user_addr != user_addr) i = (i + 1) & mask;
+
+    if (g_tracker_table[i]) {
+        found_tracker = g_tracker_table[i];
+        g_tracker_count--;
+        // Backward-shift deletion: pull later entries of the probe run into
+        // the hole unless that would move them before their home slot.
+        for (uint32_t j = (i + 1) & mask; g_tracker_table[j]; j = (j + 1) & mask) {
+            uint32_t home = tracker_hash(g_tracker_table[j]->block_addr);
+            if (((j - home) & mask) >= ((j - i) & mask)) {
+                g_tracker_table[i] = g_tracker_table[j];
+                i = j;
+            }
+        }
+        g_tracker_table[i] = NULL;
+
+        if (found_tracker->site) {
+            found_tracker->site->live_blocks--;
+            found_tracker->site->live_bytes -= found_tracker->block_size;
         }
-        prev_next_ptr = &current->next;
-        current = current->next;
     }
     spinlock_release_irqrestore(&g_alloc_tracker_lock, tracker_irq_flags);
     return found_tracker;
@@ -243,7 +431,51 @@ static inline uintptr_t get_buddy_addr(uintptr_t block_addr, int order) {
 }
 
 /**
- * @brief Adds a block (given by its virtual address) to the appropriate free list.
+ * @brief Flips the pair bit of the block at @p addr (no-op at MAX_ORDER).
+ * @note Assumes the buddy lock is held by the caller.
+ */
+static inline void buddy_pair_toggle(uintptr_t addr, int order) {
+    if (order >= MAX_ORDER) return;
+    uintptr_t idx = BUDDY_PAIR_INDEX(addr, order);
+    g_pair_bitmaps[order][idx >> 5] ^= 1u << (idx & 31);
+}
+
+/**
+ * @brief True if the buddy of the (not free) block at @p addr is free at @p order.
+ * @note Assumes the buddy lock is held by the caller.
+ */
+static inline bool buddy_pair_buddy_free(uintptr_t addr, int order) {
+    uintptr_t idx = BUDDY_PAIR_INDEX(addr, order);
+    return (g_pair_bitmaps[order][idx >> 5] >> (idx & 31)) & 1u;
+}
+
+/**
+ * @brief Words of pair bitmap needed at @p order to cover @p span bytes.
+ */
+static size_t buddy_pair_bitmap_words(size_t span, int order) {
+    size_t pairs = (span >> (order + 1)) + 1; // +1 covers a trailing unpaired block
+    return (pairs + 31) / 32;
+}
+
+/**
+ * @brief Adds or subtracts a free block's bytes from the pageblocks it covers.
+ * @note Assumes the buddy lock is held by the caller.
+ */
+static inline void pageblock_free_adjust(uintptr_t addr, int order, bool freed) {
+    uint32_t pb = BUDDY_PAGEBLOCK(addr);
+    if (order < PAGEBLOCK_ORDER) {
+        uint32_t bytes = 1u << order;
+        g_pageblock_free[pb] += freed ? bytes : -bytes;
+        return;
+    }
+    for (uint32_t n = 1u << (order - PAGEBLOCK_ORDER); n; n--, pb++) {
+        g_pageblock_free[pb] += freed ? PAGEBLOCK_SIZE : -PAGEBLOCK_SIZE;
+    }
+}
+
+/**
+ * @brief Adds a block (given by its virtual address) to the free list of its
+ * pageblock's type.
  * @param block_ptr Virtual address of the block to add.
  * @param order The order of the block being added.
  * @note Assumes the buddy lock is held by the caller.
@@ -253,33 +485,146 @@ static void add_block_to_free_list(void *block_ptr, int order) {
     BUDDY_ASSERT(block_ptr != NULL, "Adding NULL block to free list");
 
     buddy_block_t *block = (buddy_block_t*)block_ptr;
-    block->next = free_lists[order];
-    free_lists[order] = block;
+    int mt = g_pageblock_type[BUDDY_PAGEBLOCK((uintptr_t)block_ptr)];
+    block->migratetype = (uint8_t)mt;
+    block->prev = NULL;
+    block->next = free_lists[mt][order];
+    if (block->next) block->next->prev = block;
+    free_lists[mt][order] = block;
+    g_nr_free[mt][order]++;
+    buddy_pair_toggle((uintptr_t)block_ptr, order);
+    pageblock_free_adjust((uintptr_t)block_ptr, order, true);
 }
 
 /**
- * @brief Removes a specific block (given by its virtual address) from its free list.
- * @param block_ptr Virtual address of the block to remove.
+ * @brief Unlinks a block (given by its virtual address) from its free list in O(1).
+ * @param block_ptr Virtual address of the block to remove; must be on the list.
  * @param order The order of the block to remove.
- * @return true if found and removed, false otherwise.
  * @note Assumes the buddy lock is held by the caller.
  */
-static bool remove_block_from_free_list(void *block_ptr, int order) {
+static void remove_block_from_free_list(void *block_ptr, int order) {
     BUDDY_ASSERT(order >= MIN_INTERNAL_ORDER && order <= MAX_ORDER, "Invalid order in remove_block_from_free_list");
     BUDDY_ASSERT(block_ptr != NULL, "Removing NULL block from free list");
 
-    buddy_block_t **prev_next_ptr = &free_lists[order];
-    buddy_block_t *current = free_lists[order];
+    buddy_block_t *block = (buddy_block_t*)block_ptr;
+    int mt = block->migratetype;
+    BUDDY_ASSERT(mt < MIGRATE_TYPES, "Free block has a corrupt migrate type");
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        BUDDY_ASSERT(free_lists[mt][order] == block, "Free block is not linked into its order's list");
+        free_lists[mt][order] = block->next;
+    }
+    if (block->next) block->next->prev = block->prev;
+    g_nr_free[mt][order]--;
+    buddy_pair_toggle((uintptr_t)block_ptr, order);
+    pageblock_free_adjust((uintptr_t)block_ptr, order, false);
+}
 
-    while (current) {
-        if (current == (buddy_block_t*)block_ptr) {
-            *prev_next_ptr = current->next; // Unlink
-            return true;
+/**
+ * @brief Retags pageblock @p pb as @p migratetype and moves its free blocks
+ * onto that type's lists, so what is already free there serves the new
+ * owner too.
+ * @note Assumes the buddy lock is held by the caller.
+ */
+static void buddy_move_pageblock(uint32_t pb, int migratetype) {
+    uintptr_t start = g_heap_start_virt_addr + ((uintptr_t)pb << PAGEBLOCK_ORDER);
+    uintptr_t end = start + PAGEBLOCK_SIZE;
+    g_pageblock_type[pb] = (uint8_t)migratetype;
+    g_claim_count++;
+    if (g_pageblock_free[pb] == 0) return;
+
+    for (int from = 0; from < MIGRATE_TYPES; from++) {
+        if (from == migratetype) continue;
+        for (int order = MIN_INTERNAL_ORDER; order < PAGEBLOCK_ORDER; order++) {
+            buddy_block_t *block = free_lists[from][order];
+            while (block) {
+                buddy_block_t *next = block->next;
+                if ((uintptr_t)block >= start && (uintptr_t)block < end) {
+                    remove_block_from_free_list(block, order);
+                    add_block_to_free_list(block, order); // Now the new type's
+                }
+                block = next;
+            }
         }
-        prev_next_ptr = &current->next;
-        current = current->next;
     }
-    return false; // Not found
+}
+
+/**
+ * @brief Decides whether @p migratetype, about to steal the free block of
+ * @p order at @p block, takes over the pageblock(s) around it.
+ *
+ * A block of a whole pageblock or more is claimed outright. A smaller one
+ * is claimed only when at least half of its pageblock is free, and a
+ * movable request needs a block of PAGEBLOCK_ORDER / 2 or more to bother:
+ * user pages are plentiful and short-lived, so they should squeeze into
+ * the holes of a foreign pageblock rather than take it over.
+ * @return true if the pageblock is now @p migratetype's (the block has moved
+ *         to its lists).
+ * @note Assumes the buddy lock is held by the caller.
+ */
+static bool buddy_try_claim(buddy_block_t *block, int order, int migratetype) {
+    uint32_t pb = BUDDY_PAGEBLOCK((uintptr_t)block);
+    if (order >= PAGEBLOCK_ORDER) {
+        // Whole pageblocks: only this block is free in them, and it is
+        // unlinked by the caller before the split re-adds the halves.
+        for (uint32_t n = 1u << (order - PAGEBLOCK_ORDER); n; n--, pb++) {
+            g_pageblock_type[pb] = (uint8_t)migratetype;
+            g_claim_count++;
+        }
+        return true;
+    }
+    if (migratetype == MIGRATE_MOVABLE && order < PAGEBLOCK_ORDER / 2) return false;
+    if (g_pageblock_free[pb] < PAGEBLOCK_SIZE / 2) return false;
+    buddy_move_pageblock(pb, migratetype);
+    return true;
+}
+
+/**
+ * @brief Finds a block for @p migratetype on the other types' lists.
+ *
+ * The largest block goes first, so a claim takes a pageblock that is as
+ * empty as possible. When the pageblock cannot be claimed, the smallest
+ * block that fits is taken from that list instead, to use as little of the
+ * foreign pageblock as possible.
+ * @param order_out Receives the order of the returned block.
+ * @return The block, still on its free list, or NULL if every list is empty.
+ * @note Assumes the buddy lock is held by the caller.
+ */
+static buddy_block_t *buddy_steal_fallback(int requested_order, int migratetype, int *order_out) {
+    for (int order = MAX_ORDER; order >= requested_order; order--) {
+        for (int i = 0; i < MIGRATE_TYPES - 1; i++) {
+            int fallback = g_migrate_fallbacks[migratetype][i];
+            buddy_block_t *block = free_lists[fallback][order];
+            if (!block) continue;
+
+            g_fallback_count++;
+            if (buddy_try_claim(block, order, migratetype)) {
+                *order_out = order;
+                return block;
+            }
+            for (int smallest = requested_order; smallest <= order; smallest++) {
+                if (free_lists[fallback][smallest]) {
+                    *order_out = smallest;
+                    return free_lists[fallback][smallest];
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief True if some list of any type holds a block of @p order or larger.
+ * @note Assumes the buddy lock is held by the caller.
+ */
+static bool buddy_has_free_block(int order) {
+    for (int mt = 0; mt < MIGRATE_TYPES; mt++) {
+        for (int o = order; o <= MAX_ORDER; o++) {
+            if (free_lists[mt][o]) return true;
+        }
+    }
+    return false;
 }
 
 /**
@@ -343,8 +688,13 @@ void buddy_init(void *heap_region_phys_start_ptr, size_t region_size) {
     }
 
     // 2. Initialize Locks and Free Lists
-    for (int i = 0; i <= MAX_ORDER; i++) free_lists[i] = NULL;
-    spinlock_init(&g_buddy_lock);
+    for (int mt = 0; mt < MIGRATE_TYPES; mt++) {
+        for (int i = 0; i <= MAX_ORDER; i++) {
+            free_lists[mt][i] = NULL;
+            g_nr_free[mt][i] = 0;
+        }
+    }
+    spinlock_init_named(&g_buddy_lock, "buddy");
     #ifdef DEBUG_BUDDY
     init_tracker_pool();
     #endif
@@ -364,6 +714,37 @@ void buddy_init(void *heap_region_phys_start_ptr, size_t region_size) {
     }
 
     size_t available_size = region_size - adjustment;
+
+    // Carve the pair bitmaps and the pageblock arrays from the end of the
+    // region. Sizing them for the whole region over-covers the slightly
+    // smaller heap that remains.
+    size_t bitmap_words = 0;
+    for (int order = MIN_INTERNAL_ORDER; order < MAX_ORDER; order++) {
+        bitmap_words += buddy_pair_bitmap_words(available_size, order);
+    }
+    g_nr_pageblocks = (uint32_t)((available_size + PAGEBLOCK_SIZE - 1) >> PAGEBLOCK_ORDER);
+    bitmap_words += g_nr_pageblocks;                                   // g_pageblock_free
+    bitmap_words += (g_nr_pageblocks + sizeof(uint32_t) - 1) / sizeof(uint32_t); // g_pageblock_type
+    size_t bitmap_bytes = bitmap_words * sizeof(uint32_t);
+    if (bitmap_bytes + MIN_BLOCK_SIZE_INTERNAL > available_size) {
+        serial_printf("[Buddy] Error: Region too small for its %lu bytes of pair bitmaps.\n", bitmap_bytes);
+        g_heap_start_virt_addr = 0; g_heap_end_virt_addr = 0; // Mark as uninitialized
+        return;
+    }
+    available_size -= bitmap_bytes;
+    uint32_t *bitmap_virt = (uint32_t *)(KERNEL_SPACE_VIRT_START + g_buddy_heap_phys_start_addr + available_size);
+    memset(bitmap_virt, 0, bitmap_bytes);
+    for (int i = 0; i < MAX_ORDER; i++) g_pair_bitmaps[i] = NULL;
+    for (int order = MIN_INTERNAL_ORDER; order < MAX_ORDER; order++) {
+        g_pair_bitmaps[order] = bitmap_virt;
+        bitmap_virt += buddy_pair_bitmap_words(available_size + bitmap_bytes, order);
+    }
+    g_pageblock_free = bitmap_virt;
+    g_pageblock_type = (uint8_t *)(bitmap_virt + g_nr_pageblocks);
+    // Everything starts movable; kernel allocations claim pageblocks from
+    // that pool as they need them, a few large ones at a time.
+    memset(g_pageblock_type, MIGRATE_MOVABLE, g_nr_pageblocks);
+
     g_heap_start_virt_addr = KERNEL_SPACE_VIRT_START + g_buddy_heap_phys_start_addr;
 
     // Check for virtual address overflow on start address calculation
@@ -375,7 +756,8 @@ void buddy_init(void *heap_region_phys_start_ptr, size_t region_size) {
     // Use %lx for uintptr_t addresses
     serial_printf("  Aligned Phys Start: 0x%lx, Corresponding Virt Start: 0x%lx\n", g_buddy_heap_phys_start_addr, g_heap_start_virt_addr);
     // Use %lu for size_t
-    serial_printf("  Available Size after alignment: %lu bytes\n", available_size);
+    serial_printf("  Available Size after alignment: %lu bytes (%lu bytes of pair bitmaps and %lu pageblock tags)\n",
+                  available_size, bitmap_bytes, (unsigned long)g_nr_pageblocks);
 
     // 4. Populate Free Lists with Initial Blocks (using VIRTUAL addresses)
     g_buddy_total_managed_size = 0;
@@ -442,25 +824,31 @@ void buddy_init(void *heap_region_phys_start_ptr, size_t region_size) {
 
 /**
  * @brief Internal implementation for buddy allocation. Finds/splits blocks.
+ * Serves @p migratetype from its own lists, stealing from the other types'
+ * only when those are empty.
  * @param requested_order The desired block order.
+ * @param migratetype The caller's mobility type (buddy_migratetype_t).
  * @param file Source file name (for debug builds).
  * @param line Source line number (for debug builds).
  * @return Virtual address of the allocated block, or NULL on failure.
  * @note Assumes the buddy lock is held by the caller.
  */
-static void* buddy_alloc_impl(int requested_order, const char* file, int line) {
+static void* buddy_alloc_impl(int requested_order, int migratetype, const char* file, int line) {
     //serial_printf("[Buddy Alloc Impl] Enter: Request order %d. File: %s Line: %d\n", requested_order, file, line); // LOG ENTRY
+    BUDDY_ASSERT(migratetype >= 0 && migratetype < MIGRATE_TYPES, "Invalid migrate type in buddy_alloc_impl");
 
     // Find the smallest available block order >= requested_order
     int order = requested_order;
     while (order <= MAX_ORDER) {
-        if (free_lists[order] != NULL) {
+        if (free_lists[migratetype][order] != NULL) {
             break; // Found a suitable free list
         }
         order++;
     }
+    buddy_block_t *block = order <= MAX_ORDER ? free_lists[migratetype][order]
+                                              : buddy_steal_fallback(requested_order, migratetype, &order);
 
-    if (order > MAX_ORDER) { // Out of memory
+    if (!block) { // Out of memory
         g_failed_alloc_count++;
         #ifdef DEBUG_BUDDY
         serial_printf("[Buddy OOM @ %s:%d] Order %d requested, no suitable blocks found.\n", file, line, requested_order);
@@ -472,8 +860,7 @@ static void* buddy_alloc_impl(int requested_order, const char* file, int line) {
     }
 
     // Remove block from the found free list
-    buddy_block_t *block = free_lists[order];
-    free_lists[order] = block->next; // Dequeue
+    remove_block_from_free_list(block, order); // Dequeue
 
     // Split the block down to the requested order if necessary
     while (order > requested_order) {
@@ -481,7 +868,8 @@ static void* buddy_alloc_impl(int requested_order, const char* file, int line) {
         size_t half_block_size = (size_t)1 << order;
         // Calculate the address of the buddy (the upper half)
         uintptr_t buddy_addr = (uintptr_t)block + half_block_size;
-        // Add the buddy (upper half) to the free list of the smaller order
+        // Add the buddy (upper half) to the free list of the smaller order,
+        // and of its pageblock's type
         add_block_to_free_list((void*)buddy_addr, order);
         // Continue splitting the lower half (pointed to by 'block')
     }
@@ -489,7 +877,7 @@ static void* buddy_alloc_impl(int requested_order, const char* file, int line) {
     // Update statistics
     size_t allocated_block_size = (size_t)1 << requested_order;
     g_buddy_free_bytes -= allocated_block_size;
-    g_alloc_count++;
+    percpu_counter_inc(&g_alloc_count);
 
     // --- Physical Address Alignment Assertion ---
     // This check ensures that if we allocate a page-sized block or larger,
@@ -555,9 +943,10 @@ static void buddy_free_impl(void *block_addr_virt, int block_order, const char*
              break; // Buddy is outside the managed heap, cannot coalesce
         }
 
-        // Attempt to find and remove the buddy from its free list
-        if (remove_block_from_free_list((void*)buddy_addr_virt, block_order)) {
+        // The pair bit says whether the buddy is on this order's free list
+        if (buddy_pair_buddy_free(addr_virt, block_order)) {
             // Buddy was free! Merge them.
+            remove_block_from_free_list((void*)buddy_addr_virt, block_order);
             // The new, larger block starts at the lower of the two addresses.
             if (buddy_addr_virt < addr_virt) {
                 addr_virt = buddy_addr_virt;
@@ -569,7 +958,7 @@ static void buddy_free_impl(void *block_addr_virt, int block_order, const char*
             // serial_printf("  [Buddy Free Debug %s:%d] Coalesced order %d->%d V=0x%lx\n", file, line, block_order-1, block_order, addr_virt);
             #endif
         } else {
-            break; // Buddy not found in free list, cannot coalesce further
+            break; // Buddy allocated or split, cannot coalesce further
         }
     }
 
@@ -579,7 +968,30 @@ static void buddy_free_impl(void *block_addr_virt, int block_order, const char*
     // Update statistics (add back size of the *originally* freed block)
     // Note: block_size was calculated based on the initial block_order passed in.
     g_buddy_free_bytes += block_size;
-    g_free_count++;
+    percpu_counter_inc(&g_free_count);
+}
+
+
+/**
+ * @brief Takes the buddy lock and allocates a block of @p order. On OOM the
+ * shrinkers are asked (without blocking) for the block's size and the
+ * allocation is retried once. Reports the free byte count for watermarks.
+ * @note Must be called WITHOUT the buddy lock held.
+ */
+static void *buddy_alloc_order_reclaim(int order, int migratetype, const char* file, int line) {
+    uintptr_t buddy_irq_flags = spinlock_acquire_irqsave(&g_buddy_lock);
+    void *block_ptr = buddy_alloc_impl(order, migratetype, file, line);
+    size_t free_bytes = g_buddy_free_bytes;
+    spinlock_release_irqrestore(&g_buddy_lock, buddy_irq_flags);
+
+    if (!block_ptr && shrink_memory((size_t)1 << order, false) > 0) {
+        buddy_irq_flags = spinlock_acquire_irqsave(&g_buddy_lock);
+        block_ptr = buddy_alloc_impl(order, migratetype, file, line);
+        free_bytes = g_buddy_free_bytes;
+        spinlock_release_irqrestore(&g_buddy_lock, buddy_irq_flags);
+    }
+    shrinker_note_free(free_bytes);
+    return block_ptr;
 }
 
 
@@ -600,9 +1012,7 @@ void *buddy_alloc_internal(size_t size, const char* file, int line) {
         return NULL;
     }
 
-    uintptr_t buddy_irq_flags = spinlock_acquire_irqsave(&g_buddy_lock);
-    void *block_ptr = buddy_alloc_impl(req_order, file, line);
-    spinlock_release_irqrestore(&g_buddy_lock, buddy_irq_flags);
+    void *block_ptr = buddy_alloc_order_reclaim(req_order, MIGRATE_UNMOVABLE, file, line);
 
     if (!block_ptr) return NULL; // buddy_alloc_impl already logged and updated stats
 
@@ -620,7 +1030,7 @@ void *buddy_alloc_internal(size_t size, const char* file, int line) {
         // Adjust stats: allocation failed overall
         uintptr_t stat_flags = spinlock_acquire_irqsave(&g_buddy_lock);
         g_failed_alloc_count++; // Increment failure
-        g_alloc_count--;        // Decrement success count from buddy_alloc_impl
+        percpu_counter_dec(&g_alloc_count); // Decrement success count from buddy_alloc_impl
         g_buddy_free_bytes += block_size; // Add block back to free count
         spinlock_release_irqrestore(&g_buddy_lock, stat_flags);
         return NULL;
@@ -632,7 +1042,15 @@ void *buddy_alloc_internal(size_t size, const char* file, int line) {
     tracker->order = req_order; // Store order
     tracker->source_file = file;
     tracker->source_line = line;
-    add_active_allocation(tracker);
+    if (!add_active_allocation(tracker)) {
+        serial_printf("[Buddy DEBUG %s:%d] CRITICAL: Tracker table full! Freeing block.\n", file, line);
+        free_tracker_node(tracker);
+        uintptr_t free_irq_flags = spinlock_acquire_irqsave(&g_buddy_lock);
+        buddy_free_impl(block_ptr, req_order, __FILE__, __LINE__);
+        g_failed_alloc_count++;
+        spinlock_release_irqrestore(&g_buddy_lock, free_irq_flags);
+        return NULL;
+    }
 
     // Place canaries
     if (block_size >= sizeof(uint32_t) * 2) {
@@ -722,14 +1140,15 @@ void buddy_free_internal(void *ptr, const char* file, int line) {
 void buddy_dump_leaks(void) {
     terminal_write("\n--- Buddy Allocator Leak Check ---\n");
     uintptr_t tracker_irq_flags = spinlock_acquire_irqsave(&g_alloc_tracker_lock);
-    allocation_tracker_t* current = g_active_allocations;
     int leak_count = 0;
     size_t leak_bytes = 0;
-    if (!current) {
+    if (g_tracker_count == 0) {
         terminal_write("No active allocations tracked. No leaks detected.\n");
     } else {
         terminal_write("Detected potential memory leaks (unfreed blocks):\n");
-        while(current) {
+        for (uint32_t i = 0; i < (1u << g_tracker_table_bits); i++) {
+            allocation_tracker_t* current = g_tracker_table[i];
+            if (!current) continue;
             // Use %lu for size_t
             serial_printf("  - User Addr: 0x%p, Block Addr: 0x%p, Block Size: %lu bytes (Order %d), Allocated at: %s:%d\n",
                             current->user_addr, current->block_addr, current->block_size, current->order,
@@ -737,10 +1156,20 @@ void buddy_dump_leaks(void) {
                             current->source_line);
             leak_count++;
             leak_bytes += current->block_size;
-            current = current->next;
         }
         // Use %lu for size_t
         serial_printf("Total Leaks: %d blocks, %lu bytes (buddy block size)\n", leak_count, leak_bytes);
+
+        terminal_write("Live blocks by call site:\n");
+        for (uint32_t b = 0; b < TRACKER_SITE_BUCKETS; b++) {
+            for (alloc_site_t *site = g_site_buckets[b]; site; site = site->next) {
+                if (site->live_blocks == 0) continue;
+                serial_printf("  %s:%d: %lu live blocks, %lu bytes (%lu allocations total)\n",
+                                site->file ? site->file : "<unknown>", site->line,
+                                (unsigned long)site->live_blocks, (unsigned long)site->live_bytes,
+                                (unsigned long)site->total_allocs);
+            }
+        }
     }
     terminal_write("----------------------------------\n");
     spinlock_release_irqrestore(&g_alloc_tracker_lock, tracker_irq_flags);
@@ -761,9 +1190,7 @@ void *buddy_alloc(size_t size) {
         return NULL;
     }
 
-    uintptr_t buddy_irq_flags = spinlock_acquire_irqsave(&g_buddy_lock);
-    void *block_ptr = buddy_alloc_impl(req_order, NULL, 0); // Pass NULL file/line
-    spinlock_release_irqrestore(&g_buddy_lock, buddy_irq_flags);
+    void *block_ptr = buddy_alloc_order_reclaim(req_order, MIGRATE_UNMOVABLE, NULL, 0); // Pass NULL file/line
 
     if (!block_ptr) return NULL; // buddy_alloc_impl already updated stats
 
@@ -822,11 +1249,12 @@ void buddy_free(void *ptr) {
  * @brief Allocates a raw buddy block of the specified order. Handles locking internally.
  * FOR KERNEL INTERNAL USE ONLY (e.g., page frame allocator). No header prepended.
  * @param order The exact buddy order to allocate (MIN_ORDER to MAX_ORDER).
+ * @param migratetype Mobility type of the block's owner (buddy_migratetype_t).
  * @return Virtual address of the allocated block, or NULL on failure.
  */
- void* buddy_alloc_raw(int order) {
+ void *buddy_alloc_raw_mt(int order, int migratetype) {
     //serial_printf("[Buddy Raw Alloc] Requesting order %d\n", order); // LOG ENTRY
-    if (order < MIN_INTERNAL_ORDER || order > MAX_ORDER) {
+    if (order < MIN_INTERNAL_ORDER || order > MAX_ORDER || migratetype < 0 || migratetype >= MIGRATE_TYPES) {
          serial_printf("[Buddy Raw Alloc] Error: Invalid order %d requested.\n", order);
          // Acquire lock just to update stats safely
          uintptr_t flags = spinlock_acquire_irqsave(&g_buddy_lock);
@@ -835,12 +1263,30 @@ void buddy_free(void *ptr) {
          return NULL; // Return NULL on invalid order
     }
 
+    void *block_ptr = buddy_alloc_order_reclaim(order, migratetype, __FILE__, __LINE__); // Pass file/line even in non-debug for OOM trace
+    //serial_printf("[Buddy Raw Alloc] buddy_alloc_order_reclaim returned %p for order %d\n", block_ptr, order); // LOG AFTER IMPL
+    return block_ptr;
+}
+
+void *buddy_alloc_raw(int order) {
+    return buddy_alloc_raw_mt(order, MIGRATE_UNMOVABLE);
+}
+
+/**
+ * @brief buddy_alloc_raw_mt() without the reclaim retry: for opportunistic
+ * allocations (user large pages) that fall back to something smaller
+ * rather than shrink caches.
+ * @return Virtual address of the block, or NULL if none of @p order is free.
+ */
+void *buddy_try_alloc_raw(int order, int migratetype) {
+    if (order < MIN_INTERNAL_ORDER || order > MAX_ORDER || migratetype < 0 || migratetype >= MIGRATE_TYPES) return NULL;
+    void *block_ptr = NULL;
     uintptr_t buddy_irq_flags = spinlock_acquire_irqsave(&g_buddy_lock);
-    //serial_printf("[Buddy Raw Alloc] Lock acquired. Calling buddy_alloc_impl for order %d\n", order); // LOG BEFORE IMPL
-    void *block_ptr = buddy_alloc_impl(order, __FILE__, __LINE__); // Pass file/line even in non-debug for OOM trace
-    //serial_printf("[Buddy Raw Alloc] buddy_alloc_impl returned %p for order %d\n", block_ptr, order); // LOG AFTER IMPL
+    // Look first: a miss here is expected and not an OOM worth logging
+    if (buddy_has_free_block(order)) {
+        block_ptr = buddy_alloc_impl(order, migratetype, __FILE__, __LINE__);
+    }
     spinlock_release_irqrestore(&g_buddy_lock, buddy_irq_flags);
-    //serial_printf("[Buddy Raw Alloc] Lock released. Returning %p\n", block_ptr); // LOG EXIT
     return block_ptr;
 }
 
@@ -881,8 +1327,70 @@ void buddy_free_raw(void* block_addr_virt, int order) {
      // Note: buddy_free_impl already increments g_free_count
 }
 
+/**
+ * @brief Allocates up to @p count raw blocks of one order under a single lock
+ * hold (per-CPU frame cache refill).
+ * @return Number of blocks stored in @p blocks; fewer than @p count on OOM.
+ */
+size_t buddy_alloc_raw_batch(int order, int migratetype, void **blocks, size_t count) {
+    if (order < MIN_INTERNAL_ORDER || order > MAX_ORDER || !blocks) return 0;
+    if (migratetype < 0 || migratetype >= MIGRATE_TYPES) return 0;
+
+    size_t got = 0;
+    uintptr_t buddy_irq_flags = spinlock_acquire_irqsave(&g_buddy_lock);
+    while (got < count) {
+        void *block_ptr = buddy_alloc_impl(order, migratetype, __FILE__, __LINE__);
+        if (!block_ptr) break;
+        blocks[got++] = block_ptr;
+    }
+    size_t free_bytes = g_buddy_free_bytes;
+    spinlock_release_irqrestore(&g_buddy_lock, buddy_irq_flags);
+
+    // Nothing at all: reclaim for one block rather than fail the refill.
+    if (got == 0 && count > 0) {
+        void *block_ptr = buddy_alloc_order_reclaim(order, migratetype, __FILE__, __LINE__);
+        if (block_ptr) blocks[got++] = block_ptr;
+    } else {
+        shrinker_note_free(free_bytes);
+    }
+    return got;
+}
+
+/**
+ * @brief Frees @p count raw blocks of one order under a single lock hold
+ * (per-CPU frame cache drain). Each block is validated as in buddy_free_raw().
+ */
+void buddy_free_raw_batch(void *const *blocks, size_t count, int order) {
+    if (order < MIN_INTERNAL_ORDER || order > MAX_ORDER) {
+        BUDDY_PANIC("Invalid order in buddy_free_raw_batch");
+        return;
+    }
+    size_t block_size = (size_t)1 << order;
+    for (size_t i = 0; i < count; i++) {
+        uintptr_t addr = (uintptr_t)blocks[i];
+        if (addr < g_heap_start_virt_addr || addr >= g_heap_end_virt_addr ||
+            (addr - g_heap_start_virt_addr) % block_size != 0) {
+            serial_printf("[Buddy Raw Free] Error: Bad batch block 0x%p for order %d.\n", blocks[i], order);
+            BUDDY_PANIC("Invalid block in buddy_free_raw_batch");
+            return;
+        }
+    }
+
+    uintptr_t buddy_irq_flags = spinlock_acquire_irqsave(&g_buddy_lock);
+    for (size_t i = 0; i < count; i++) {
+        buddy_free_impl(blocks[i], order, __FILE__, __LINE__);
+    }
+    spinlock_release_irqrestore(&g_buddy_lock, buddy_irq_flags);
+}
+
 #endif // DEBUG_BUDDY
 
+int buddy_block_migratetype(const void *block_virt) {
+    uintptr_t addr = (uintptr_t)block_virt;
+    if (addr < g_heap_start_virt_addr || addr >= g_heap_end_virt_addr) return MIGRATE_UNMOVABLE;
+    return ((volatile uint8_t *)g_pageblock_type)[BUDDY_PAGEBLOCK(addr)];
+}
+
 
 // === Statistics ===
 
@@ -900,14 +1408,53 @@ size_t buddy_total_space(void) {
     return g_buddy_total_managed_size;
 }
 
+/**
+ * @brief Fragmentation index of @p order, as in buddy_stats_t: how much of
+ * a failure to find a free block of @p order would be down to the free
+ * bytes being split into pieces rather than there being too few of them.
+ */
+static int16_t buddy_fragmentation_index(const buddy_stats_t *stats, int order) {
+    uint32_t blocks = 0;
+    bool suitable = false;
+    for (int o = MIN_INTERNAL_ORDER; o <= MAX_ORDER; o++) {
+        for (int mt = 0; mt < MIGRATE_TYPES; mt++) {
+            blocks += stats->free_blocks[mt][o];
+            if (o >= order && stats->free_blocks[mt][o]) suitable = true;
+        }
+    }
+    if (suitable) return -1000;
+    if (blocks == 0) return 0;
+    // 1000 * (1 - (1 + free / requested) / blocks)
+    uint64_t per_block = 1000 + div_u64_rem((uint64_t)stats->free_bytes * 1000, 1u << order, NULL);
+    return (int16_t)(1000 - (int32_t)div_u64_rem(per_block, blocks, NULL));
+}
+
 /** @brief Fills a structure with current allocator statistics. */
 void buddy_get_stats(buddy_stats_t *stats) {
     if (!stats) return;
     uintptr_t irq_flags = spinlock_acquire_irqsave(&g_buddy_lock);
     stats->total_bytes = g_buddy_total_managed_size;
     stats->free_bytes = g_buddy_free_bytes;
-    stats->alloc_count = g_alloc_count;
-    stats->free_count = g_free_count;
+    stats->alloc_count = percpu_counter_sum(&g_alloc_count);
+    stats->free_count = percpu_counter_sum(&g_free_count);
     stats->failed_alloc_count = g_failed_alloc_count;
+    stats->largest_free_block = 0;
+    memcpy(stats->free_blocks, g_nr_free, sizeof(stats->free_blocks));
+    for (int order = MAX_ORDER; order >= MIN_INTERNAL_ORDER && !stats->largest_free_block; order--) {
+        for (int mt = 0; mt < MIGRATE_TYPES; mt++) {
+            if (free_lists[mt][order]) {
+                stats->largest_free_block = (size_t)1 << order;
+                break;
+            }
+        }
+    }
+    memset(stats->pageblocks, 0, sizeof(stats->pageblocks));
+    for (uint32_t pb = 0; pb < g_nr_pageblocks; pb++) stats->pageblocks[g_pageblock_type[pb]]++;
+    stats->fallback_count = g_fallback_count;
+    stats->claim_count = g_claim_count;
     spinlock_release_irqrestore(&g_buddy_lock, irq_flags);
+
+    for (int order = 0; order <= MAX_ORDER; order++) {
+        stats->frag_index[order] = order < MIN_INTERNAL_ORDER ? 0 : buddy_fragmentation_index(stats, order);
+    }
 }
\ No newline at end of file
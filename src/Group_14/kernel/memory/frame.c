@@ -16,9 +16,12 @@
 #include <kernel/sync/spinlock.h>         // For protecting shared frame allocator state
 #include <libc/stdint.h>      // For SIZE_MAX, uintXX_t, UINTPTR_MAX, UINT64_MAX
 #include <libc/string.h>      // For memset
+#include <kernel/lib/string.h> // clear_page
 #include <kernel/core/types.h>            // For uintptr_t, size_t, bool
 #include <kernel/arch/multiboot2.h>
 #include <kernel/lib/assert.h>           // For KERNEL_ASSERT and KERNEL_PANIC_HALT
+#include <kernel/lib/klog.h>             // klog_debug (FRAME_PRINT)
+#include <kernel/cpu/get_cpu_id.h>         // For MAX_CPUS and the per-CPU frame caches
 
 // Forward declaration for idle task stack checking
 extern void check_idle_task_stack_integrity(const char *checkpoint);
@@ -43,6 +46,7 @@ extern void check_idle_task_stack_integrity(const char *checkpoint);
 #else
 #error "Unsupported PAGE_SIZE for frame allocator buddy order calculation."
 #endif
+#define FRAME_HUGE_ORDER 22 // One 4MB user large page (PAGE_SIZE_LARGE)
 
 #ifndef MIN_ORDER
 #error "MIN_ORDER is not defined (include buddy.h)"
@@ -62,7 +66,7 @@ extern void check_idle_task_stack_integrity(const char *checkpoint);
 
 // Use %lu for size_t/uintptr_t, %lu for uint32_t (since warning indicated it's long unsigned)
 #define FRAME_PRINT(level, fmt, ...) \
-    do { if (FRAME_DEBUG_LEVEL >= (level)) serial_printf(fmt, ##__VA_ARGS__); } while(0)
+    do { if (FRAME_DEBUG_LEVEL >= (level)) klog_debug(fmt, ##__VA_ARGS__); } while(0)
 
 // Simplified FRAME_PANIC/ASSERT using the corrected KERNEL_* macros from assert.h
 #define FRAME_PANIC(msg) KERNEL_PANIC_HALT("FRAME PANIC: " msg)
@@ -73,7 +77,11 @@ extern void check_idle_task_stack_integrity(const char *checkpoint);
 // Module Globals
 //----------------------------------------------------------------------------
 // VIRTUAL address of the reference count array (lives in kernel heap).
-static volatile uint32_t *g_frame_refcounts = NULL;
+// 16 bits per frame; see "Compact Refcounts" below for counts past 0xFFFE.
+static volatile uint16_t *g_frame_refcounts = NULL;
+// Live-PTE count of each frame used as a user page table (kept by paging.c
+// and mm.c; at most 1024). Shares the refcount array's allocation, right after it.
+static volatile uint16_t *g_pt_live_counts = NULL;
 // PHYSICAL address where the reference count array was allocated.
 static uintptr_t g_frame_refcounts_phys = 0;
 // Total number of page frames representable by the highest physical address.
@@ -85,6 +93,183 @@ static spinlock_t g_frame_lock;
 // Actual size allocated by the buddy allocator for the refcount array.
 static size_t g_refcount_array_alloc_size = 0;
 
+//----------------------------------------------------------------------------
+// Per-CPU Frame Caches
+//----------------------------------------------------------------------------
+// Each CPU keeps free order-0 frames (refcount 0) in front of the buddy
+// allocator, so frame_alloc()/put_frame() normally take no global lock.
+// frames[] is a stack: the top end is hot (just freed, likely still in the
+// CPU cache) and is handed out first; the bottom end is cold and is what
+// drains back to the buddy allocator. Refill and drain move FRAME_PCP_BATCH
+// frames under one buddy lock hold. A CPU only touches its own cache, with
+// interrupts disabled. There is one stack per buddy mobility type: a frame
+// is refilled from its type's pageblocks and freed onto the stack of the
+// pageblock it lies in, so a page table never reuses a frame from a user
+// pageblock just because it happened to be hot. At most FRAME_PCP_HIGH
+// frames per CPU and type sit unused here.
+#define FRAME_PCP_BATCH 16
+#define FRAME_PCP_HIGH  64
+
+typedef struct frame_pcp {
+    uint32_t count[MIGRATE_TYPES];
+    void    *frames[MIGRATE_TYPES][FRAME_PCP_HIGH]; // Buddy (virtual) block addresses
+} frame_pcp_t;
+
+static frame_pcp_t g_frame_pcp[MAX_CPUS];
+
+//----------------------------------------------------------------------------
+// Pre-zeroed Frame Pool
+//----------------------------------------------------------------------------
+// Free frames (refcount 0) already known to be all zeroes. The idle task
+// fills the pool with movable frames from frame_zero_pool_refill() and
+// movable frame_alloc_zeroed_mt() calls drain it, so user page faults skip
+// the memset. The pool is still free memory: any allocation takes from it
+// once the caches and the buddy allocator are empty.
+#define FRAME_ZERO_POOL_SIZE 128
+
+static spinlock_t g_zero_pool_lock;
+static uint32_t   g_zero_pool_count = 0;
+static void      *g_zero_pool[FRAME_ZERO_POOL_SIZE]; // Buddy (virtual) block addresses
+
+//----------------------------------------------------------------------------
+// Lazily Zeroed Refcount Array
+//----------------------------------------------------------------------------
+// The array (refcounts, then live-PTE counts) is not cleared at boot. Each
+// page of it is zeroed the first time any of its slots is touched, and a bit
+// in g_frame_meta_ready records that, so frames that are never used (most of
+// a large machine's RAM early on) cost no memset at all.
+#define FRAME_META_MAX_BYTES  ((UINTPTR_MAX / PAGE_SIZE + 1) * 2 * sizeof(uint16_t))
+#define FRAME_META_MAX_CHUNKS (FRAME_META_MAX_BYTES / PAGE_SIZE)
+
+static spinlock_t        g_frame_meta_lock;
+static volatile uint32_t g_frame_meta_ready[FRAME_META_MAX_CHUNKS / 32];
+static size_t            g_frame_meta_bytes = 0; // Bytes of the array in use
+
+static inline bool frame_meta_chunk_ready(size_t chunk) {
+    return (g_frame_meta_ready[chunk / 32] >> (chunk % 32)) & 1;
+}
+
+// Zeroes page @p chunk of the array, unless that was done already.
+static void frame_meta_touch_slow(size_t chunk) {
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&g_frame_meta_lock);
+    if (!frame_meta_chunk_ready(chunk)) {
+        size_t offset = chunk * PAGE_SIZE;
+        size_t len = g_frame_meta_bytes - offset;
+        if (len > PAGE_SIZE) len = PAGE_SIZE;
+        memset((uint8_t *)g_frame_refcounts + offset, 0, len);
+        asm volatile("" ::: "memory"); // Zeroes before the ready bit (x86 keeps store order)
+        g_frame_meta_ready[chunk / 32] |= 1u << (chunk % 32);
+    }
+    spinlock_release_irqrestore(&g_frame_meta_lock, irq_flags);
+}
+
+static inline volatile uint16_t *frame_meta_touch(volatile uint16_t *slot) {
+    size_t chunk = ((uintptr_t)slot - (uintptr_t)g_frame_refcounts) / PAGE_SIZE;
+    if (!frame_meta_chunk_ready(chunk)) frame_meta_touch_slow(chunk);
+    return slot;
+}
+
+static inline volatile uint16_t *refcount_slot(size_t pfn) {
+    return frame_meta_touch(&g_frame_refcounts[pfn]);
+}
+
+static inline volatile uint16_t *pt_live_slot(size_t pfn) {
+    return frame_meta_touch(&g_pt_live_counts[pfn]);
+}
+
+// A frame's refcount without initializing its chunk: untouched means 0.
+static inline uint16_t refcount_peek(size_t pfn) {
+    size_t chunk = (pfn * sizeof(uint16_t)) / PAGE_SIZE;
+    return frame_meta_chunk_ready(chunk) ? g_frame_refcounts[pfn] : 0;
+}
+
+//----------------------------------------------------------------------------
+// Compact Refcounts
+//----------------------------------------------------------------------------
+// A refcount is 16 bits. Counts up to 0xFFFE live in the slot alone and are
+// updated with one locked cmpxchg. At 0xFFFF the slot sticks ("saturated")
+// and the excess is kept in a small overflow table; while saturated, every
+// change to that frame goes through g_ref_overflow_lock, and only a lock
+// holder takes the slot back below 0xFFFF. Only frames mapped tens of
+// thousands of times over (a shared zero page, say) ever get there.
+#define FRAME_REF_SATURATED       0xFFFFu
+#define FRAME_REF_OVERFLOW_SLOTS  32
+
+typedef struct frame_ref_overflow {
+    uint32_t pfn;
+    uint32_t extra; // Count beyond FRAME_REF_SATURATED; 0 marks a free entry
+} frame_ref_overflow_t;
+
+static spinlock_t           g_ref_overflow_lock;
+static frame_ref_overflow_t g_ref_overflow[FRAME_REF_OVERFLOW_SLOTS];
+
+static inline bool cmpxchg16(volatile uint16_t *ptr, uint16_t old, uint16_t new_value) {
+    uint16_t prev;
+    asm volatile("lock cmpxchgw %2, %1" : "=a"(prev), "+m"(*ptr) : "r"(new_value), "0"(old) : "memory", "cc");
+    return prev == old;
+}
+
+static inline uint16_t count16_fetch_add(volatile uint16_t *count, uint16_t delta) {
+    asm volatile("lock xaddw %0, %1" : "+r"(delta), "+m"(*count) : : "memory", "cc");
+    return delta;
+}
+
+// Overflow entry of @p pfn, or a free one if @p create; lock held.
+static frame_ref_overflow_t *ref_overflow_find(size_t pfn, bool create) {
+    frame_ref_overflow_t *free_entry = NULL;
+    for (int i = 0; i < FRAME_REF_OVERFLOW_SLOTS; i++) {
+        frame_ref_overflow_t *e = &g_ref_overflow[i];
+        if (e->extra && e->pfn == pfn) return e;
+        if (!e->extra && !free_entry) free_entry = e;
+    }
+    if (!create) return NULL;
+    if (!free_entry) FRAME_PANIC("Refcount overflow table full");
+    free_entry->pfn = (uint32_t)pfn;
+    return free_entry;
+}
+
+static uint32_t refcount_add(size_t pfn, int delta);
+
+static uint32_t refcount_add_saturated(size_t pfn, volatile uint16_t *slot, int delta) {
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&g_ref_overflow_lock);
+    if (*slot != FRAME_REF_SATURATED) {
+        // Another lock holder just took it back below; retry the fast way
+        spinlock_release_irqrestore(&g_ref_overflow_lock, irq_flags);
+        return refcount_add(pfn, delta);
+    }
+    frame_ref_overflow_t *e = ref_overflow_find(pfn, delta > 0);
+    uint32_t extra = e ? e->extra : 0;
+    if (delta > 0) e->extra++;
+    else if (extra) e->extra--;
+    else *slot = FRAME_REF_SATURATED - 1;
+    spinlock_release_irqrestore(&g_ref_overflow_lock, irq_flags);
+    return FRAME_REF_SATURATED + extra;
+}
+
+/**
+ * @brief Adds @p delta (+1 or -1) to the refcount of @p pfn.
+ * @return The count before the change; a decrement of 0 is not applied.
+ */
+static uint32_t refcount_add(size_t pfn, int delta) {
+    volatile uint16_t *slot = refcount_slot(pfn);
+    for (;;) {
+        uint16_t old = *slot;
+        if (old == FRAME_REF_SATURATED) return refcount_add_saturated(pfn, slot, delta);
+        if (delta < 0 && old == 0) return 0;
+        if (cmpxchg16(slot, old, (uint16_t)(old + delta))) return old;
+    }
+}
+
+static uint32_t refcount_read(size_t pfn) {
+    uint16_t count = *refcount_slot(pfn);
+    if (count != FRAME_REF_SATURATED) return count;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&g_ref_overflow_lock);
+    frame_ref_overflow_t *e = ref_overflow_find(pfn, false);
+    uint32_t total = FRAME_REF_SATURATED + (e ? e->extra : 0);
+    spinlock_release_irqrestore(&g_ref_overflow_lock, irq_flags);
+    return total;
+}
+
 // External dependency (provided by paging subsystem)
 extern uint32_t g_kernel_page_directory_phys; // Physical address of initial PD
 
@@ -193,12 +378,13 @@ static void mark_reserved_range(uintptr_t start, uintptr_t end, const char* name
         if (pfn < g_total_frames) {
              // Only mark if not already marked (prevents double-counting issues)
              // Although init should zero first, this is safer if called later.
-            if (g_frame_refcounts[pfn] == 0) {
-                g_frame_refcounts[pfn] = 1; // 1 indicates reserved/allocated
+            volatile uint16_t *slot = refcount_slot(pfn);
+            if (*slot == 0) {
+                *slot = 1; // 1 indicates reserved/allocated
             } else {
                  // Use %lu for uint32_t based on previous compiler warning
                  FRAME_PRINT(1, "[Mark Reserved WARN] PFN %lu for %s already has refcount %lu\n",
-                                (unsigned long)pfn, name, (unsigned long)g_frame_refcounts[pfn]);
+                                (unsigned long)pfn, name, (unsigned long)*slot);
             }
         } else {
             // This should technically not happen if end_pfn was clamped correctly, but assert defensively.
@@ -217,7 +403,10 @@ int frame_init(struct multiboot_tag_mmap *mmap_tag_virt,
     uintptr_t buddy_heap_phys_start, uintptr_t buddy_heap_phys_end)
 {
 terminal_write("[Frame] Initializing physical frame manager...\n");
-spinlock_init(&g_frame_lock);
+spinlock_init_named(&g_frame_lock, "frame");
+spinlock_init_named(&g_zero_pool_lock, "frame_zero_pool");
+spinlock_init_named(&g_frame_meta_lock, "frame_meta");
+spinlock_init_named(&g_ref_overflow_lock, "frame_ref_overflow");
 
 // --- Step 1: Validate Multiboot Memory Map ---
 KERNEL_ASSERT(mmap_tag_virt != NULL, "Multiboot MMAP tag is NULL");
@@ -267,10 +456,11 @@ serial_printf("   Detected highest physical address (aligned up): %#lx (%lu tota
 
 // --- Step 3: Allocate Physical Memory for Reference Count Array ---
 // Check for overflow before multiplying
-if (g_total_frames > (SIZE_MAX / sizeof(uint32_t))) {
+// (The live-PTE counts of page tables follow the refcounts in the same block.)
+if (g_total_frames > (SIZE_MAX / (2 * sizeof(uint16_t)))) {
 FRAME_PANIC("Refcount array size calculation overflows size_t");
 }
-size_t refcount_array_size_bytes = g_total_frames * sizeof(uint32_t);
+size_t refcount_array_size_bytes = g_total_frames * 2 * sizeof(uint16_t);
 
 g_refcount_array_alloc_size = get_required_buddy_allocation_size(refcount_array_size_bytes);
 if (g_refcount_array_alloc_size == SIZE_MAX || g_refcount_array_alloc_size == 0) {
@@ -320,14 +510,13 @@ serial_printf("   Refcount array allocated: VIRT=%#lx -> PHYS=%#lx (Buddy Block
 KERNEL_ASSERT((g_frame_refcounts_phys % PAGE_SIZE) == 0, "Physical address for refcount array is not page-aligned! Buddy error?");
 
 // --- Step 5: Use the VIRTUAL address for access and Initialize ---
-g_frame_refcounts = (volatile uint32_t*)refcount_array_virt_ptr;
+g_frame_refcounts = (volatile uint16_t*)refcount_array_virt_ptr;
+g_pt_live_counts = g_frame_refcounts + g_total_frames;
 serial_printf("   Using VIRT address %#lx for refcount array access.\n", (unsigned long)g_frame_refcounts);
 
-terminal_write("   Initializing reference counts (zeroing, then marking reserved regions)...\n");
-serial_printf("        Zeroing refcount array (%lu actual bytes) @ VIRT=%#lx...\n",
-         (unsigned long)refcount_array_size_bytes, (unsigned long)g_frame_refcounts);
-memset((void*)g_frame_refcounts, 0, refcount_array_size_bytes);
-terminal_write("        Refcount array zeroed.\n");
+// No memset here: each page of the array is zeroed on first touch
+terminal_write("   Initializing reference counts (zeroed lazily, marking reserved regions)...\n");
+g_frame_meta_bytes = refcount_array_size_bytes;
 
 // Mark known reserved physical memory regions
 terminal_write("        Marking known reserved physical memory regions...\n");
@@ -379,7 +568,7 @@ if (entry->type == MULTIBOOT_MEMORY_AVAILABLE) {
       for (size_t pfn = first_pfn; pfn < last_pfn && pfn < g_total_frames; ++pfn) {
           // Check bounds before accessing array!
           if (pfn < g_total_frames) {
-              if (g_frame_refcounts[pfn] == 0) {
+              if (refcount_peek(pfn) == 0) {
                   available_count++;
                   // Check if this available frame falls within the buddy heap's *physical* range
                   uintptr_t current_addr = pfn_to_addr(pfn);
@@ -409,72 +598,180 @@ return 0; // Success
 //----------------------------------------------------------------------------
 
 /**
- * @brief Allocates a single physical page frame.
- * @return The physical address of the allocated frame, or 0 on failure.
+ * @brief Takes a free frame of @p migratetype from this CPU's cache,
+ * refilling it from the buddy allocator when empty.
+ * @return Buddy (virtual) address of the block, or NULL when out of memory.
  */
-uintptr_t frame_alloc(void) {
-    const int frame_req_order = FRAME_BUDDY_ORDER; // Use defined constant
-
-    FRAME_PRINT(2, "[Frame Alloc] Requesting order %d from buddy allocator...\n", frame_req_order);
-    void* block_virt = buddy_alloc_raw(frame_req_order);
-    FRAME_PRINT(2, "[Frame Alloc] buddy_alloc_raw returned VIRT=%p\n", block_virt);
+static void *frame_pcp_alloc(int migratetype) {
+    uintptr_t irq_flags = local_irq_save();
+    frame_pcp_t *pcp = &g_frame_pcp[get_cpu_id()];
+    uint32_t *count = &pcp->count[migratetype];
+    if (*count == 0) {
+        *count = (uint32_t)buddy_alloc_raw_batch(FRAME_BUDDY_ORDER, migratetype, pcp->frames[migratetype], FRAME_PCP_BATCH);
+        FRAME_PRINT(2, "[Frame PCP] Refilled %lu frames from buddy.\n", (unsigned long)*count);
+    }
+    void *block_virt = *count ? pcp->frames[migratetype][--*count] : NULL;
+    local_irq_restore(irq_flags);
+    return block_virt;
+}
 
-    if (!block_virt) {
-        FRAME_PRINT(0, "[Frame Alloc ERR] Buddy allocation failed (out of memory?)!\n");
-        return 0; // Indicate failure
+/**
+ * @brief Returns a frame whose refcount reached zero to @p pcp (hot end of
+ * its pageblock's stack). A full stack first drains its FRAME_PCP_BATCH
+ * coldest frames. Interrupts must be disabled.
+ */
+static void frame_pcp_push(frame_pcp_t *pcp, void *block_virt) {
+    int mt = buddy_block_migratetype(block_virt);
+    void **frames = pcp->frames[mt];
+    if (pcp->count[mt] == FRAME_PCP_HIGH) {
+        buddy_free_raw_batch(frames, FRAME_PCP_BATCH, FRAME_BUDDY_ORDER);
+        pcp->count[mt] -= FRAME_PCP_BATCH;
+        memmove(frames, frames + FRAME_PCP_BATCH, pcp->count[mt] * sizeof(frames[0]));
+        FRAME_PRINT(2, "[Frame PCP] Drained %d cold frames to buddy.\n", FRAME_PCP_BATCH);
     }
+    frames[pcp->count[mt]++] = block_virt;
+}
 
-    // --- Convert Virtual to Physical and Validate ---
-    FRAME_ASSERT(KERNEL_SPACE_VIRT_START != 0, "KERNEL_SPACE_VIRT_START is not defined/zero");
-    uintptr_t virt_addr_received = (uintptr_t)block_virt;
-    uintptr_t assumed_kernel_start = KERNEL_SPACE_VIRT_START; // Capture for logging
-    uintptr_t block_phys = virt_addr_received - assumed_kernel_start;
+static void frame_pcp_free(void *block_virt) {
+    uintptr_t irq_flags = local_irq_save();
+    frame_pcp_push(&g_frame_pcp[get_cpu_id()], block_virt);
+    local_irq_restore(irq_flags);
+}
 
-    FRAME_PRINT(1, "[Frame Alloc DBG] Received VIRT=%#lx, Assumed KERN_START=%#lx -> Calculated PHYS=%#lx\n",
-                  (unsigned long)virt_addr_received, (unsigned long)assumed_kernel_start, (unsigned long)block_phys);
+/** @brief Takes a frame from the pre-zeroed pool, or NULL if it is empty. */
+static void *zero_pool_take(void) {
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&g_zero_pool_lock);
+    void *block_virt = g_zero_pool_count ? g_zero_pool[--g_zero_pool_count] : NULL;
+    spinlock_release_irqrestore(&g_zero_pool_lock, irq_flags);
+    return block_virt;
+}
 
-    // Assert alignment *after* calculating physical address
+/**
+ * @brief Converts a free block taken from a cache or the pool into an
+ * allocated frame with refcount 1.
+ * @return The frame's physical address.
+ */
+static uintptr_t frame_claim(void *block_virt) {
+    // --- Convert Virtual to Physical and Validate ---
+    uintptr_t block_phys = (uintptr_t)block_virt - KERNEL_SPACE_VIRT_START;
     FRAME_ASSERT((block_phys % PAGE_SIZE) == 0, "Buddy returned non-page-aligned physical address");
 
-    // --- Calculate PFN and Check Boundary ---
     size_t pfn = addr_to_pfn(block_phys);
-    size_t current_g_total_frames = g_total_frames; // Capture current boundary value
+    if (pfn >= g_total_frames) {
+        KERNEL_PANIC_HALT("FRAME PANIC: Calculated PFN is out of range!");
+    }
 
-    FRAME_PRINT(1, "[Frame Alloc DBG] Calculated PFN=%lu, Checking against g_total_frames=%lu\n",
-                  (unsigned long)pfn, (unsigned long)current_g_total_frames);
+    // Free frames are owned by exactly one cache, so nobody else can be
+    // touching this count; a plain store is enough.
+    volatile uint16_t *slot = refcount_slot(pfn);
+    FRAME_ASSERT(*slot == 0, "Allocating frame that already has non-zero refcount!");
+    *slot = 1; // Mark as allocated (set refcount to 1)
+    FRAME_PRINT(1, "[Frame Alloc] PFN=%lu (Phys=%#lx), Refcount set to 1.\n", (unsigned long)pfn, (unsigned long)block_phys);
 
-    // Perform the critical boundary check
-    FRAME_ASSERT(pfn < current_g_total_frames, "Calculated PFN is out of range!");
+    return block_phys; // Return the physical address
+}
 
-    // --- Update Reference Count Atomically ---
-    uintptr_t irq_flags = spinlock_acquire_irqsave(&g_frame_lock);
+/**
+ * @brief Allocates a single physical page frame for an owner of @p migratetype.
+ * @return The physical address of the allocated frame, or 0 on failure.
+ */
+uintptr_t frame_alloc_mt(int migratetype) {
+    void* block_virt = frame_pcp_alloc(migratetype);
+    FRAME_PRINT(2, "[Frame Alloc] Per-CPU cache returned VIRT=%p\n", block_virt);
 
-    // Check PFN bounds *again* just before array access (defense in depth)
-    if (pfn >= current_g_total_frames) {
-        spinlock_release_irqrestore(&g_frame_lock, irq_flags);
-        // Use KERNEL_PANIC_HALT directly as FRAME_PANIC might cause issues here
-        KERNEL_PANIC_HALT("FRAME PANIC: PFN out of bounds right before refcount access!");
+    if (!block_virt) block_virt = zero_pool_take(); // Last free frames left
+    if (!block_virt) {
+        FRAME_PRINT(0, "[Frame Alloc ERR] Buddy allocation failed (out of memory?)!\n");
+        return 0; // Indicate failure
     }
+    return frame_claim(block_virt);
+}
 
-    FRAME_PRINT(2, "[Frame Alloc] PFN=%lu (Phys=%#lx), Reading refcount...\n", (unsigned long)pfn, (unsigned long)block_phys);
-    uint32_t current_refcount = g_frame_refcounts[pfn]; // Read current refcount
-    // Use %lu for uint32_t (aka unsigned long)
-    FRAME_PRINT(2, "[Frame Alloc] PFN=%lu, Current refcount=%lu\n", (unsigned long)pfn, (unsigned long)current_refcount);
+uintptr_t frame_alloc(void) {
+    return frame_alloc_mt(MIGRATE_UNMOVABLE);
+}
 
-    // This assertion is vital: We should only be allocating frames that are currently free (refcount 0).
-    FRAME_ASSERT(current_refcount == 0, "Allocating frame that already has non-zero refcount!");
+/**
+ * @brief Allocates a frame whose contents are zero. Movable requests prefer
+ * the pool the idle task pre-zeroed (its frames come from movable
+ * pageblocks); others zero a fresh frame and use the pool only when memory
+ * is otherwise exhausted.
+ * @return The physical address of the allocated frame, or 0 on failure.
+ */
+uintptr_t frame_alloc_zeroed_mt(int migratetype) {
+    void *block_virt = migratetype == MIGRATE_MOVABLE ? zero_pool_take() : NULL;
+    if (!block_virt) {
+        block_virt = frame_pcp_alloc(migratetype);
+        if (block_virt) {
+            clear_page(block_virt);
+        } else if (!(block_virt = zero_pool_take())) {
+            FRAME_PRINT(0, "[Frame Alloc ERR] Zeroed allocation failed (out of memory?)!\n");
+            return 0;
+        }
+    }
+    return frame_claim(block_virt);
+}
 
-    g_frame_refcounts[pfn] = 1; // Mark as allocated (set refcount to 1)
-    FRAME_PRINT(1, "[Frame Alloc] PFN=%lu, Refcount set to 1.\n", (unsigned long)pfn);
+uintptr_t frame_alloc_zeroed(void) {
+    return frame_alloc_zeroed_mt(MIGRATE_UNMOVABLE);
+}
 
-    spinlock_release_irqrestore(&g_frame_lock, irq_flags);
+/**
+ * @brief Allocates PAGES_PER_TABLE contiguous zeroed frames for a user
+ * large page: one buddy block of FRAME_HUGE_ORDER, taken without reclaim.
+ * Every frame gets its own refcount of 1, so the page can later be split
+ * into 4KB mappings and its frames released one by one; the buddy
+ * allocator merges them back as they return.
+ * @return Physical address of the first frame (4MB aligned), or 0.
+ */
+uintptr_t frame_alloc_huge(void) {
+    void *block_virt = buddy_try_alloc_raw(FRAME_HUGE_ORDER, MIGRATE_MOVABLE);
+    if (!block_virt) return 0;
+    uintptr_t block_phys = (uintptr_t)block_virt - KERNEL_SPACE_VIRT_START;
+    FRAME_ASSERT((block_phys % PAGE_SIZE_LARGE) == 0, "Buddy returned a misaligned large block");
+
+    size_t first_pfn = addr_to_pfn(block_phys);
+    if (first_pfn + PAGES_PER_TABLE > g_total_frames) {
+        KERNEL_PANIC_HALT("FRAME PANIC: Large block PFN range out of range!");
+    }
+    for (size_t i = 0; i < PAGES_PER_TABLE; i++) {
+        clear_page((char *)block_virt + i * PAGE_SIZE);
+        volatile uint16_t *slot = refcount_slot(first_pfn + i);
+        FRAME_ASSERT(*slot == 0, "Allocating frame that already has non-zero refcount!");
+        *slot = 1;
+    }
+    return block_phys;
+}
 
-    return block_phys; // Return the physical address
+/**
+ * @brief Zeroes up to @p max_frames free frames into the pool. Meant for the
+ * idle loop: the memset runs with interrupts enabled and no lock held, so a
+ * wakeup is only delayed by the page being cleared.
+ * @return Number of frames added.
+ */
+size_t frame_zero_pool_refill(size_t max_frames) {
+    size_t added = 0;
+    while (added < max_frames && g_zero_pool_count < FRAME_ZERO_POOL_SIZE) {
+        void *block_virt = frame_pcp_alloc(MIGRATE_MOVABLE);
+        if (!block_virt) break;
+        clear_page(block_virt);
+
+        uintptr_t irq_flags = spinlock_acquire_irqsave(&g_zero_pool_lock);
+        bool stored = g_zero_pool_count < FRAME_ZERO_POOL_SIZE; // Another CPU may have filled it
+        if (stored) g_zero_pool[g_zero_pool_count++] = block_virt;
+        spinlock_release_irqrestore(&g_zero_pool_lock, irq_flags);
+        if (!stored) {
+            frame_pcp_free(block_virt);
+            break;
+        }
+        added++;
+    }
+    return added;
 }
 
 /**
  * @brief Decrements the reference count for a physical page frame.
- * If the count reaches zero, the frame is freed back to the buddy allocator.
+ * If the count reaches zero, the frame returns to this CPU's frame cache.
  * @param phys_addr The physical address of the frame to release/decrement.
  * Must be page-aligned.
  */
@@ -497,69 +794,110 @@ void put_frame(uintptr_t phys_addr) {
          return;
     }
 
-    uintptr_t irq_flags = spinlock_acquire_irqsave(&g_frame_lock);
-
-    // Check PFN bounds again inside lock
-    if (pfn >= g_total_frames) {
-        spinlock_release_irqrestore(&g_frame_lock, irq_flags);
-        KERNEL_PANIC_HALT("FRAME PANIC: PFN out of bounds in put_frame before refcount access");
-    }
-
-    uint32_t current_refcount = g_frame_refcounts[pfn];
-    // Use %lu for uint32_t
-    FRAME_PRINT(2, "[Put Frame] PFN=%lu (Phys=%#lx), Current refcount=%lu\n",
-                  (unsigned long)pfn, (unsigned long)phys_addr, (unsigned long)current_refcount);
+    uint32_t old_refcount = refcount_add(pfn, -1);
+    FRAME_PRINT(1, "[Put Frame] PFN=%lu (Phys=%#lx), Refcount %lu -> %lu.\n",
+                  (unsigned long)pfn, (unsigned long)phys_addr,
+                  (unsigned long)old_refcount, (unsigned long)(old_refcount - 1));
 
     // Critical check: Ensure we are not decrementing a count that's already zero (double free).
-    if (current_refcount == 0) {
-        spinlock_release_irqrestore(&g_frame_lock, irq_flags);
+    if (old_refcount == 0) {
         FRAME_PANIC("Double free detected in put_frame!");
         return; // Should not be reached if PANIC halts
     }
 
-    // Decrement the reference count
-    g_frame_refcounts[pfn]--;
-    uint32_t new_refcount = g_frame_refcounts[pfn]; // Read back the new value
-
-    // Use %lu for uint32_t
-    FRAME_PRINT(1, "[Put Frame] PFN=%lu, Decremented refcount to %lu.\n", (unsigned long)pfn, (unsigned long)new_refcount);
-
-    // If the reference count is now zero, free the frame back to the buddy system
-    if (new_refcount == 0) {
-        // Convert physical address back to the virtual address the buddy system expects
+    // Last reference gone: the frame goes back to the allocator.
+    if (old_refcount == 1) {
         uintptr_t virt_addr = phys_addr + KERNEL_SPACE_VIRT_START;
-        // Check for overflow during virt conversion
-        if (virt_addr < phys_addr || virt_addr < KERNEL_SPACE_VIRT_START) {
-             spinlock_release_irqrestore(&g_frame_lock, irq_flags);
+        if (virt_addr < phys_addr) {
              FRAME_PANIC("Virtual address overflow during put_frame phys->virt conversion!");
         }
 
-        // Release the frame lock *before* calling the buddy allocator,
-        // as the buddy allocator has its own internal locking.
-        spinlock_release_irqrestore(&g_frame_lock, irq_flags);
-
-        FRAME_PRINT(2, "[Put Frame] Refcount is zero, freeing VIRT=%p (order %d) to buddy system.\n",
-                      (void*)virt_addr, FRAME_BUDDY_ORDER);
-        
-        // Check idle task stack before buddy_free_raw
+        // Check idle task stack before the frame can be reused
         if (pfn == 0x10002 || pfn == 0x10071 || pfn == 0x10074) {
             // These are important PFNs - PD frames or user stack frames
             serial_printf("[Put Frame WARN] About to free important PFN %lu (Phys=%#lx, Virt=%#lx)\n",
                           (unsigned long)pfn, (unsigned long)phys_addr, (unsigned long)virt_addr);
             check_idle_task_stack_integrity("put_frame: Before buddy_free (important frame)");
         }
-        
-        buddy_free_raw((void*)virt_addr, FRAME_BUDDY_ORDER);
-        
-        // Check idle task stack after buddy_free_raw
+
+        frame_pcp_free((void*)virt_addr);
+
         if (pfn == 0x10002 || pfn == 0x10071 || pfn == 0x10074) {
             check_idle_task_stack_integrity("put_frame: After buddy_free (important frame)");
         }
+    }
+}
 
-    } else {
-        // Frame is still referenced by others, just release the lock
-        spinlock_release_irqrestore(&g_frame_lock, irq_flags);
+/**
+ * @brief Allocates @p count frames at once, all or nothing.
+ * Refills from the buddy allocator take up to FRAME_PCP_HIGH frames per lock
+ * hold, so a large request costs one lock round-trip per 64 frames.
+ * @param count      Number of frames wanted.
+ * @param frames_out Receives the physical addresses, each with refcount 1.
+ * @return @p count on success, 0 if memory ran out (nothing is allocated).
+ */
+size_t frame_alloc_bulk(size_t count, uintptr_t *frames_out) {
+    if (!frames_out || count == 0) return 0;
+
+    size_t got = 0;
+    uintptr_t irq_flags = local_irq_save();
+    frame_pcp_t *pcp = &g_frame_pcp[get_cpu_id()];
+    uint32_t *pcp_count = &pcp->count[MIGRATE_UNMOVABLE];
+    void **pcp_frames = pcp->frames[MIGRATE_UNMOVABLE];
+    while (got < count) {
+        if (*pcp_count == 0) {
+            size_t want = count - got;
+            if (want < FRAME_PCP_BATCH) want = FRAME_PCP_BATCH;
+            if (want > FRAME_PCP_HIGH) want = FRAME_PCP_HIGH;
+            *pcp_count = (uint32_t)buddy_alloc_raw_batch(FRAME_BUDDY_ORDER, MIGRATE_UNMOVABLE, pcp_frames, want);
+            if (*pcp_count == 0) break;
+        }
+        frames_out[got++] = (uintptr_t)pcp_frames[--*pcp_count] - KERNEL_SPACE_VIRT_START;
+    }
+    if (got < count) {
+        // Out of memory: hand back what was taken; those counts are still 0.
+        while (got > 0) frame_pcp_push(pcp, (void*)(frames_out[--got] + KERNEL_SPACE_VIRT_START));
+        local_irq_restore(irq_flags);
+        FRAME_PRINT(0, "[Frame Alloc ERR] Bulk allocation of %lu frames failed (out of memory?)!\n", (unsigned long)count);
+        return 0;
     }
+    local_irq_restore(irq_flags);
+
+    for (size_t i = 0; i < count; i++) {
+        size_t pfn = addr_to_pfn(frames_out[i]);
+        if (pfn >= g_total_frames) {
+            KERNEL_PANIC_HALT("FRAME PANIC: Calculated PFN is out of range!");
+        }
+        volatile uint16_t *slot = refcount_slot(pfn);
+        FRAME_ASSERT(*slot == 0, "Allocating frame that already has non-zero refcount!");
+        *slot = 1;
+    }
+    return count;
+}
+
+/**
+ * @brief put_frame() for an array of frames, with interrupts disabled and the
+ * per-CPU cache looked up once for the whole batch.
+ */
+void put_frames_bulk(const uintptr_t *frames, size_t count) {
+    if (!frames || count == 0) return;
+
+    uintptr_t irq_flags = local_irq_save();
+    frame_pcp_t *pcp = &g_frame_pcp[get_cpu_id()];
+    for (size_t i = 0; i < count; i++) {
+        FRAME_ASSERT((frames[i] % PAGE_SIZE) == 0, "put_frames_bulk called with non-page-aligned address");
+        size_t pfn = addr_to_pfn(frames[i]);
+        KERNEL_ASSERT(pfn < g_total_frames, "put_frames_bulk called with PFN out of range");
+
+        uint32_t old_refcount = refcount_add(pfn, -1);
+        if (old_refcount == 0) {
+            local_irq_restore(irq_flags);
+            FRAME_PANIC("Double free detected in put_frames_bulk!");
+            return;
+        }
+        if (old_refcount == 1) frame_pcp_push(pcp, (void*)(frames[i] + KERNEL_SPACE_VIRT_START));
+    }
+    local_irq_restore(irq_flags);
 }
 
 //----------------------------------------------------------------------------
@@ -584,16 +922,8 @@ int get_frame_refcount(uintptr_t phys_addr) {
         return -1; // Indicate error
     }
 
-    uintptr_t irq_flags = spinlock_acquire_irqsave(&g_frame_lock);
-    // Check bounds again inside lock
-    if (pfn >= g_total_frames) {
-         spinlock_release_irqrestore(&g_frame_lock, irq_flags);
-         FRAME_PRINT(0, "[Get Refcount ERR] PFN %lu became invalid under lock?\n", (unsigned long)pfn);
-         return -1;
-    }
-    // Read refcount (cast to int for return type compatibility)
-    int count = (int)g_frame_refcounts[pfn];
-    spinlock_release_irqrestore(&g_frame_lock, irq_flags);
+    // One aligned 16-bit load unless saturated; a snapshot either way.
+    int count = (int)refcount_read(pfn);
 
     FRAME_PRINT(2, "[Get Refcount] PFN=%lu (Phys=%#lx) -> Count=%d\n", (unsigned long)pfn, (unsigned long)phys_addr, count);
     return count;
@@ -616,26 +946,59 @@ void frame_incref(uintptr_t phys_addr) {
         return; // Should not be reached if PANIC halts
     }
 
-    uintptr_t irq_flags = spinlock_acquire_irqsave(&g_frame_lock);
-
-    // Check bounds again inside lock
-    if (pfn >= g_total_frames) {
-         spinlock_release_irqrestore(&g_frame_lock, irq_flags);
-         FRAME_PANIC("PFN out of bounds in frame_incref under lock!");
-    }
-
-    uint32_t old_count = g_frame_refcounts[pfn];
+    uint32_t old_count = refcount_add(pfn, 1);
     // Use %lu for uint32_t
-    FRAME_PRINT(2, "[Frame Incref] PFN=%lu (Phys=%#lx), Old count=%lu\n",
-                  (unsigned long)pfn, (unsigned long)phys_addr, (unsigned long)old_count);
+    FRAME_PRINT(1, "[Frame Incref] PFN=%lu (Phys=%#lx), Count %lu -> %lu\n",
+                  (unsigned long)pfn, (unsigned long)phys_addr, (unsigned long)old_count, (unsigned long)(old_count + 1));
 
     // Critical assertions:
     FRAME_ASSERT(old_count > 0, "Incrementing refcount of a frame that is supposedly free (count was 0)!");
-    FRAME_ASSERT(old_count < UINT32_MAX, "Frame reference count overflow during increment!");
+}
 
-    g_frame_refcounts[pfn]++;
-    // Use %lu for uint32_t
-    FRAME_PRINT(1, "[Frame Incref] PFN=%lu, Count %lu -> %lu\n", (unsigned long)pfn, (unsigned long)old_count, (unsigned long)g_frame_refcounts[pfn]);
+/**
+ * @brief frame_incref() for @p count physically contiguous frames starting at
+ * @p phys_start (e.g. a 4MB PDE). Bounds are checked once for the range.
+ */
+void frame_pt_live_set(uintptr_t pt_phys, uint32_t count) {
+    size_t pfn = addr_to_pfn(pt_phys);
+    FRAME_ASSERT(pfn < g_total_frames, "frame_pt_live_set called with PFN out of range!");
+    FRAME_ASSERT(count <= PAGE_SIZE / sizeof(uint32_t), "Live-PTE count beyond one page table!");
+    *pt_live_slot(pfn) = (uint16_t)count;
+}
 
-    spinlock_release_irqrestore(&g_frame_lock, irq_flags);
-}
\ No newline at end of file
+uint32_t frame_pt_live_add(uintptr_t pt_phys, int32_t delta) {
+    size_t pfn = addr_to_pfn(pt_phys);
+    FRAME_ASSERT(pfn < g_total_frames, "frame_pt_live_add called with PFN out of range!");
+    uint32_t old_count = count16_fetch_add(pt_live_slot(pfn), (uint16_t)delta);
+    FRAME_ASSERT(delta >= 0 || old_count >= (uint32_t)-delta, "Page table live-PTE count underflow!");
+    return (uint16_t)(old_count + (uint32_t)delta);
+}
+
+void frame_incref_range(uintptr_t phys_start, size_t count) {
+    FRAME_ASSERT((phys_start % PAGE_SIZE) == 0, "frame_incref_range requires page-aligned address");
+    size_t first_pfn = addr_to_pfn(phys_start);
+    if (first_pfn >= g_total_frames || count > g_total_frames - first_pfn) {
+        FRAME_PANIC("frame_incref_range called with PFN range out of range!");
+        return;
+    }
+
+    for (size_t pfn = first_pfn; pfn < first_pfn + count; pfn++) {
+        uint32_t old_count = refcount_add(pfn, 1);
+        FRAME_ASSERT(old_count > 0, "Incrementing refcount of a frame that is supposedly free (count was 0)!");
+    }
+}
+
+/**
+ * @brief put_frame() for @p count physically contiguous frames starting at
+ * @p phys_start (a large page that was never mapped, for instance).
+ */
+void put_frames_range(uintptr_t phys_start, size_t count) {
+    uintptr_t frames[FRAME_PCP_BATCH];
+    while (count) {
+        size_t n = count < FRAME_PCP_BATCH ? count : FRAME_PCP_BATCH;
+        for (size_t i = 0; i < n; i++) frames[i] = phys_start + i * PAGE_SIZE;
+        put_frames_bulk(frames, n);
+        phys_start += n * PAGE_SIZE;
+        count -= n;
+    }
+}
@@ -8,6 +8,7 @@
  #include <kernel/memory/kmalloc_internal.h>
  #include <kernel/memory/buddy.h>
  #include <kernel/drivers/display/terminal.h>
+ #include <kernel/drivers/display/serial.h>
  #include <kernel/core/types.h>
  #include <kernel/memory/paging.h> // For PAGE_SIZE definition
  #include <libc/stdint.h> // Corrected include path
@@ -18,21 +19,20 @@
  
  #ifdef USE_PERCPU_ALLOC
  #   include <kernel/memory/percpu_alloc.h>
- #   include <kernel/cpu/get_cpu_id.h>
  #else // Fallback to global slab
  #   include <kernel/memory/slab.h>
  #endif
  
  #include <kernel/lib/string.h> // For memset
+ #include <kernel/cpu/percpu_counter.h>
  
  //----------------------------------------------------------------------------
  // Constants and Configuration
  //----------------------------------------------------------------------------
  
- // Max *USER* size eligible for SLAB allocation (per-cpu or global).
+ // Max *USER* size eligible for SLAB allocation (per-cpu or global): the
+ // largest size class, SLAB_ALLOC_MAX_USER_SIZE in kmalloc_internal.h.
  // Should be less than PAGE_SIZE to accommodate slab_t header if buddy fallback occurs.
- // Let's keep it at 2048 for now.
- #define SLAB_ALLOC_MAX_USER_SIZE 2048
  _Static_assert(SLAB_ALLOC_MAX_USER_SIZE < (PAGE_SIZE - 128), "SLAB_ALLOC_MAX_USER_SIZE too large"); // Basic check
  
  // Define KMALLOC_HEADER_MAGIC for extra validation in kfree (optional)
@@ -43,19 +43,16 @@
  //----------------------------------------------------------------------------
  #ifndef USE_PERCPU_ALLOC
  
- // Define slab classes based on *USER* sizes.
- static const size_t kmalloc_user_size_classes[] = {
-     32, 64, 128, 256, 512, 1024, 2048 // Up to SLAB_ALLOC_MAX_USER_SIZE
- };
- #define NUM_KMALLOC_SIZE_CLASSES (sizeof(kmalloc_user_size_classes) / sizeof(kmalloc_user_size_classes[0]))
+ // Slab classes are the shared KMALLOC_CLASS_* sizes (kmalloc_internal.h).
+ #define NUM_KMALLOC_SIZE_CLASSES KMALLOC_NUM_SIZE_CLASSES
  
  static slab_cache_t *global_slab_caches[NUM_KMALLOC_SIZE_CLASSES] = {NULL};
  static const char *global_slab_cache_names[NUM_KMALLOC_SIZE_CLASSES] = {
      "g_slab_32", "g_slab_64", "g_slab_128", "g_slab_256",
      "g_slab_512", "g_slab_1024", "g_slab_2048"
  };
- static uint32_t g_kmalloc_slab_alloc_count = 0;
- static uint32_t g_kmalloc_slab_free_count = 0;
+ static percpu_counter_t g_kmalloc_slab_alloc_count; // Summed on read; see percpu_counter.h
+ static percpu_counter_t g_kmalloc_slab_free_count;
  
  /**
   * @brief Finds smallest global slab cache for the *total* size needed.
@@ -63,21 +60,51 @@
   * @return Pointer to the slab_cache_t, or NULL.
   */
  static slab_cache_t* get_global_slab_cache(size_t total_required_size) {
-     for (size_t i = 0; i < NUM_KMALLOC_SIZE_CLASSES; i++) {
-          // Check if the cache exists and its object size is sufficient
-          if (global_slab_caches[i] && global_slab_caches[i]->internal_slot_size >= total_required_size) {
-             // Check if this cache is the *best* fit (i.e., previous wasn't smaller and sufficient)
-             // This assumes kmalloc_user_size_classes maps directly to cache suitability.
-             // A more robust check might compare internal_slot_size directly.
-             if (i == 0 || !global_slab_caches[i-1] || global_slab_caches[i-1]->internal_slot_size < total_required_size) {
-                 return global_slab_caches[i];
-             }
-          }
-     }
-     return NULL; // No suitable cache found
+     int index = kmalloc_size_class(total_required_size);
+     return (index < 0) ? NULL : global_slab_caches[index]; // NULL if its creation failed
  }
  #endif // !USE_PERCPU_ALLOC
  
+ //----------------------------------------------------------------------------
+ // Size Class Lookup Table
+ //----------------------------------------------------------------------------
+
+ // Slots of class i: those past the previous class's total size, up to its own.
+ #define KMALLOC_SIZE_TABLE_FIRST_SLOT(i) \
+     ((i) == 0 ? 0 : KMALLOC_SIZE_TABLE_SLOT(KMALLOC_CLASS_TOTAL_SIZE((i) - 1)) + 1)
+ #define KMALLOC_SIZE_TABLE_LAST_SLOT(i) KMALLOC_SIZE_TABLE_SLOT(KMALLOC_CLASS_TOTAL_SIZE(i))
+
+ #if KMALLOC_STATIC_SIZE_TABLE
+ _Static_assert(KMALLOC_SIZE_TABLE_CLASSES == 4, "Update the g_kmalloc_size_index initializer");
+ const uint8_t g_kmalloc_size_index[KMALLOC_SIZE_TABLE_SLOT(KMALLOC_SIZE_TABLE_MAX) + 1] = {
+     [KMALLOC_SIZE_TABLE_FIRST_SLOT(0) ... KMALLOC_SIZE_TABLE_LAST_SLOT(0)] = 0,
+     [KMALLOC_SIZE_TABLE_FIRST_SLOT(1) ... KMALLOC_SIZE_TABLE_LAST_SLOT(1)] = 1,
+     [KMALLOC_SIZE_TABLE_FIRST_SLOT(2) ... KMALLOC_SIZE_TABLE_LAST_SLOT(2)] = 2,
+     [KMALLOC_SIZE_TABLE_FIRST_SLOT(3) ... KMALLOC_SIZE_TABLE_LAST_SLOT(3)] = 3,
+ };
+ #else
+ uint8_t g_kmalloc_size_index[KMALLOC_SIZE_TABLE_SLOT(KMALLOC_SIZE_TABLE_MAX) + 1];
+ #endif
+
+ void kmalloc_size_table_init(void) {
+ #if !KMALLOC_STATIC_SIZE_TABLE
+     for (int i = 0; i < KMALLOC_SIZE_TABLE_CLASSES; i++) {
+         for (size_t slot = KMALLOC_SIZE_TABLE_FIRST_SLOT(i); slot <= KMALLOC_SIZE_TABLE_LAST_SLOT(i); slot++) {
+             g_kmalloc_size_index[slot] = (uint8_t)i;
+         }
+     }
+ #endif
+     // Cross-check both lookup paths against a linear scan of the classes.
+     int expected = 0;
+     for (size_t size = KMALLOC_MIN_ALIGNMENT; size <= KMALLOC_CLASS_TOTAL_SIZE(KMALLOC_NUM_SIZE_CLASSES - 1); size += KMALLOC_MIN_ALIGNMENT) {
+         while (size > KMALLOC_CLASS_TOTAL_SIZE(expected)) expected++;
+         if (kmalloc_size_class(size) != expected) {
+             serial_printf("[kmalloc] ERROR: size %u maps to class %d, expected %d!\n",
+                           (unsigned int)size, kmalloc_size_class(size), expected);
+         }
+     }
+ }
+
  //----------------------------------------------------------------------------
  // Internal Helper Functions
  //----------------------------------------------------------------------------
@@ -116,6 +143,7 @@
      serial_printf("  - Header Size    : %d bytes\n", (int)KALLOC_HEADER_SIZE);
      serial_printf("  - Min Alignment  : %d bytes\n", (int)KMALLOC_MIN_ALIGNMENT);
      serial_printf("  - Slab Max User Size: %d bytes\n", (int)SLAB_ALLOC_MAX_USER_SIZE);
+     kmalloc_size_table_init();
  
  #ifdef USE_PERCPU_ALLOC
      terminal_write("[kmalloc] Initializing Per-CPU strategy...\n");
@@ -124,13 +152,12 @@
  #else
      terminal_write("[kmalloc] Initializing Global Slab strategy...\n");
      bool overall_success = true;
-     g_kmalloc_slab_alloc_count = 0;
-     g_kmalloc_slab_free_count = 0;
+     percpu_counter_reset(&g_kmalloc_slab_alloc_count);
+     percpu_counter_reset(&g_kmalloc_slab_free_count);
  
      for (size_t i = 0; i < NUM_KMALLOC_SIZE_CLASSES; i++) {
-         size_t user_class_size = kmalloc_user_size_classes[i];
          // Create slab caches to hold the object PLUS our header
-         size_t cache_obj_size = ALIGN_UP(KALLOC_HEADER_SIZE + user_class_size, KMALLOC_MIN_ALIGNMENT);
+         size_t cache_obj_size = KMALLOC_CLASS_TOTAL_SIZE(i);
          const char *cache_name = global_slab_cache_names[i];
  
          // Pass object size, minimum alignment, default color range (0), no constructor/destructor
@@ -174,14 +201,11 @@
 
     if (user_size <= SLAB_ALLOC_MAX_USER_SIZE) {
 #ifdef USE_PERCPU_ALLOC
-        int cpu_id = get_cpu_id();
-        if (cpu_id >= 0) {
-            raw_ptr = percpu_kmalloc(total_required_size, cpu_id, &slab_cache);
-            if (raw_ptr && slab_cache) {
-                alloc_type = ALLOC_TYPE_SLAB;
-                actual_alloc_size = slab_cache->internal_slot_size;
-                goto allocation_success;
-            } // else fallback...
+        raw_ptr = percpu_kmalloc(total_required_size, PERCPU_ALLOC_THIS_CPU, &slab_cache);
+        if (raw_ptr && slab_cache) {
+            alloc_type = ALLOC_TYPE_SLAB;
+            actual_alloc_size = slab_cache->internal_slot_size;
+            goto allocation_success;
         } // else fallback...
 #else
         // Global Slab logic
@@ -192,7 +216,7 @@
                   alloc_type = ALLOC_TYPE_SLAB;
                   slab_cache = global_cache;
                   actual_alloc_size = global_cache->internal_slot_size;
-                  g_kmalloc_slab_alloc_count++;
+                  percpu_counter_inc(&g_kmalloc_slab_alloc_count);
                   goto allocation_success;
              } // else fallback...
         } // else fallback...
@@ -269,7 +293,7 @@ void kfree(void *ptr) {
             percpu_kfree(original_alloc_ptr, cache);
 #else
             slab_free(cache, original_alloc_ptr);
-            g_kmalloc_slab_free_count++;
+            percpu_counter_inc(&g_kmalloc_slab_free_count);
 #endif
             break;
         case ALLOC_TYPE_BUDDY:
@@ -290,8 +314,8 @@ void kfree(void *ptr) {
  // Function remains the same, only relevant for global slab mode
  void kmalloc_get_global_stats(uint32_t *out_alloc, uint32_t *out_free) {
  #ifndef USE_PERCPU_ALLOC
-     if (out_alloc) *out_alloc = g_kmalloc_slab_alloc_count;
-     if (out_free) *out_free = g_kmalloc_slab_free_count;
+     if (out_alloc) *out_alloc = (uint32_t)percpu_counter_sum(&g_kmalloc_slab_alloc_count);
+     if (out_free) *out_free = (uint32_t)percpu_counter_sum(&g_kmalloc_slab_free_count);
  #else
      // In per-CPU mode, these global stats are not maintained here.
      // Use percpu_get_stats for per-CPU details.
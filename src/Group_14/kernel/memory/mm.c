@@ -7,19 +7,27 @@
  */
 
  #include <kernel/memory/mm.h>
- #include <kernel/memory/kmalloc.h>    // For allocating mm_struct and vma_struct
+ #include <kernel/memory/kmalloc.h>    // For allocating mm_struct
+ #include <kernel/memory/slab.h>       // vma_struct_t cache
  #include <kernel/drivers/display/terminal.h>   // For logging (terminal_printf)
  #include <kernel/memory/buddy.h>      // Underlying physical allocator (called by frame allocator) - Needed indirectly
  #include <kernel/memory/frame.h>      // Frame allocator header (frame_alloc, put_frame, get_frame_refcount)
  #include <kernel/memory/paging.h>     // For mapping pages, flags, KERNEL_SPACE_VIRT_START, paging_temp_map/unmap, paging_invalidate_page, paging_unmap_range
- #include <kernel/fs/vfs/vfs.h>        // For file_t definition (though not used directly here, included for completeness)
+ #include <kernel/fs/vfs/vfs.h>        // vfs_pread() for file-backed faults
+ #include <kernel/memory/page_cache.h> // Shared read-only file pages
+ #include <kernel/fs/vfs/sys_file.h>   // VMA file references (sys_file_get/put)
+ #include <kernel/memory/shm.h>         // Shared-memory object pages
+ #include <kernel/memory/swap.h>        // Swap entries in non-present PTEs
+ #include <kernel/memory/tlb.h>         // tlb_shootdown after the swap clock's and COW's PTE changes
  #include <kernel/fs/vfs/fs_errno.h>   // For error codes (EFAULT, ENOMEM, EPERM, etc.)
  #include <kernel/lib/rbtree.h>     // RB Tree header
  #include <kernel/process/process.h>    // For pcb_t, get_current_process
  #include <kernel/lib/string.h>     // For memset, memcpy
  #include <kernel/drivers/display/serial.h>     // For serial_write debug logging
- #include <kernel/sync/spinlock.h>   // For spinlock_t and functions
+ #include <kernel/sync/rwlock.h>     // For rwlock_t (mm_struct_t.lock)
  #include <kernel/lib/assert.h>     // For KERNEL_ASSERT, KERNEL_PANIC_HALT
+ #include <kernel/cpu/tsc.h>         // read_tsc for fault timing
+ #include <kernel/cpu/get_cpu_id.h>  // MAX_CPUS, per-CPU fault counters
  #include <libc/stddef.h> // NULL, size_t
  #include <libc/stdbool.h> // bool
  
@@ -49,25 +57,42 @@
  // --- Forward Declarations ---
  static vma_struct_t* find_vma_locked(mm_struct_t *mm, uintptr_t addr);
  static vma_struct_t* insert_vma_locked(mm_struct_t *mm, vma_struct_t* new_vma);
- static int remove_vma_range_locked(mm_struct_t *mm, uintptr_t start, size_t length);
- static uint32_t* get_pte_ptr(mm_struct_t *mm, uintptr_t vaddr, bool allocate_pt);
- // <<<--- ADDED FORWARD DECLARATION --->>>
- static void destroy_vma_node_callback(vma_struct_t *vma_node, void *data);
+ static int remove_vma_range_locked(mm_struct_t *mm, uintptr_t start, size_t length, vma_struct_t **dead);
+ static uint32_t* get_pte_ptr(mm_struct_t *mm, uintptr_t vaddr, bool allocate_pt, uintptr_t *pt_phys_out);
  
  
  // --- VMA Struct Allocation Helpers ---
+ static slab_cache_t *s_vma_cache = NULL; // Created by mm_cache_init()
+
+ void mm_cache_init(void) {
+     s_vma_cache = slab_create("vma_struct", sizeof(vma_struct_t), 0, 0, NULL, NULL);
+     if (!s_vma_cache) KERNEL_PANIC_HALT("mm_cache_init: Failed to create vma_struct cache!");
+ }
+
  static vma_struct_t* alloc_vma_struct() {
-     vma_struct_t* vma = (vma_struct_t*)kmalloc(sizeof(vma_struct_t));
+     vma_struct_t* vma = (vma_struct_t*)slab_alloc(s_vma_cache);
      if (vma) { memset(vma, 0, sizeof(vma_struct_t)); }
      return vma;
  }
+
+ static void free_vma_struct(vma_struct_t* vma) {
+     slab_free(s_vma_cache, vma);
+ }
  
  // Frees the VMA structure and associated resources (like file handle ref count)
  static void free_vma_resources(vma_struct_t* vma) {
      if (!vma) return;
-     // TODO: If file-backed, decrement file reference count (vfs_file_put?)
-     // if (vma->vm_file) { vfs_file_put(vma->vm_file); } // Assuming vfs_file_put exists
-     kfree(vma); // Free the vma_struct itself
+     if (vma->vm_file) sys_file_put(vma->vm_file);
+     free_vma_struct(vma); // Free the vma_struct itself
+ }
+
+ // Frees the VMAs remove_vma_range_locked() unlinked, after mm->lock is released
+ static void free_vma_list(vma_struct_t *dead) {
+     while (dead) {
+         vma_struct_t *next = dead->vm_next_dead;
+         free_vma_resources(dead);
+         dead = next;
+     }
  }
  
  // --- MM Struct Management ---
@@ -83,20 +108,28 @@
      }
      memset(mm, 0, sizeof(mm_struct_t));
      mm->pgd_phys = pgd_phys;
-     rb_tree_init(&mm->vma_tree); // Initialize RB Tree
+     rb_tree_init_augmented(&mm->vma_tree, rbtree_vma_augment); // RB Tree with per-subtree gap info
      mm->map_count = 0;
-     spinlock_init(&mm->lock);
+     rwlock_init(&mm->lock);
+     spinlock_init(&mm->fault_stats_lock);
      // Initialize other mm fields if needed (start_brk, end_brk etc. set during load)
      return mm;
  }
  
- /**
-  * Destroys a memory descriptor and its VMAs using RB Tree traversal.
-  */
- // --- THIS IS THE SINGLE, CORRECT DEFINITION ---
+ static void free_vma_node_callback(vma_struct_t *vma_node, void *data) {
+     (void)data;
+     free_vma_resources(vma_node);
+ }
+
  // Forward declaration for idle task stack checking
  extern void check_idle_task_stack_integrity(const char *checkpoint);
  
+ /**
+  * Destroys a memory descriptor and its VMAs using RB Tree traversal.
+  * The whole address space goes at once: the VMAs just drop their structs
+  * and file references, and paging_free_user_space() makes one pass over the
+  * page tables instead of one paging_unmap_range() per VMA.
+  */
  void destroy_mm(mm_struct_t *mm) {
      if (!mm) return;
  
@@ -104,26 +137,28 @@
      check_idle_task_stack_integrity("destroy_mm: Enter");
  
      // Acquire lock to safely get root, then clear it
-     uintptr_t irq_flags = spinlock_acquire_irqsave(&mm->lock);
+     uintptr_t irq_flags = rwlock_write_acquire_irqsave(&mm->lock);
      struct rb_node *root = mm->vma_tree.root;
      // ---> Log root node and map count <---
      serial_printf("[destroy_mm] Root node = %p, map_count = %u\n", root, mm->map_count);
      // ---> END Log <---
      mm->vma_tree.root = NULL; // Clear root immediately
      mm->map_count = 0;
-     spinlock_release_irqrestore(&mm->lock, irq_flags); // Release lock before traversal
+     rwlock_write_release_irqrestore(&mm->lock, irq_flags); // Release lock before traversal
  
      if (root) {
          serial_write("[destroy_mm] Traversing VMA tree...\n"); // <-- Logging
          check_idle_task_stack_integrity("destroy_mm: Before VMA traversal");
-         // Perform post-order traversal of RB Tree to unmap and free nodes
-         rbtree_postorder_traverse(root, destroy_vma_node_callback, mm); // Pass mm for context
+         // Perform post-order traversal of RB Tree to free the nodes
+         rbtree_postorder_traverse(root, free_vma_node_callback, NULL);
          check_idle_task_stack_integrity("destroy_mm: After VMA traversal");
          serial_write("[destroy_mm] VMA traversal complete.\n"); // <-- Logging
      } else {
          serial_write("[destroy_mm] VMA tree is empty, skipping traversal.\n"); // <-- Logging
      }
  
+     if (mm->pgd_phys) paging_free_user_space(mm->pgd_phys);
+
      serial_write("[destroy_mm] Calling kfree(mm)...\n"); // <-- Logging
      check_idle_task_stack_integrity("destroy_mm: Before kfree(mm)");
      // Free the mm_struct itself
@@ -133,87 +168,86 @@
  }
  
  
- // Helper callback for destroy_mm traversal
- // (Includes logging added previously)
- static void destroy_vma_node_callback(vma_struct_t *vma_node, void *data) {
-    mm_struct_t *mm = (mm_struct_t*)data;
-    if (!vma_node) {
-        serial_write("[destroy_vma_cb] Warning: Callback invoked with NULL vma_node.\n");
-        return;
-    }
-
-    // Logging the VMA being processed
-    serial_printf("[destroy_vma_cb] Processing VMA [%p-%p)\n", 
-                  (void*)vma_node->vm_start, (void*)vma_node->vm_end);
-
-    // Check if the memory manager context and its page directory are valid
-    if (mm && mm->pgd_phys) {
-        serial_write("  Calling paging_unmap_range...\n");
-
-        // Calculate the size of the VMA, handling potential underflow
-        size_t vma_size = 0;
-        if (vma_node->vm_end >= vma_node->vm_start) {
-             vma_size = vma_node->vm_end - vma_node->vm_start;
-        } else {
-             // Log a warning if end address is less than start address
-             terminal_printf("   Warning: VMA end address 0x%lx < start 0x%lx during destroy. Treating size as 0.\n",
-                             (unsigned long)vma_node->vm_end, (unsigned long)vma_node->vm_start);
-        }
-
-        // Call the paging function to unmap the range
-        // Only proceed if size is greater than 0, as paging_unmap_range handles 0 size internally now.
-        int ret = 0; // Assume success for zero size
-        if (vma_size > 0) {
-            check_idle_task_stack_integrity("destroy_vma_cb: Before paging_unmap_range");
-            ret = paging_unmap_range(mm->pgd_phys, vma_node->vm_start, vma_size);
-            check_idle_task_stack_integrity("destroy_vma_cb: After paging_unmap_range");
-        } else {
-            // If size is 0, no unmapping needed, but log it for clarity if desired
-            serial_write("  Skipping paging_unmap_range for zero-sized VMA.\n");
-        }
-        serial_write("  Returned from paging_unmap_range.\n");
-
-        // --- FIXED: Avoid warning for intentionally zero-sized VMAs ---
-        // Only print a warning if unmapping failed (ret != 0) for a non-zero sized VMA.
-        if (ret != 0 && vma_size > 0) {
-             terminal_printf("   Warning: paging_unmap_range failed during VMA destroy (code %d) for VMA [%p-%p).\n",
-                             ret, (void*)vma_node->vm_start, (void*)vma_node->vm_end);
-        }
-        // --- END FIX ---
-
-    } else {
-         // Log a warning if unmapping cannot be performed
-         terminal_write("   Warning: Cannot unmap VMA during destroy, mm or pgd_phys is NULL.\n");
-    }
-
-    // Free the resources associated with the VMA structure itself
-    serial_write("  Calling free_vma_resources (kfree)...\n");
-    check_idle_task_stack_integrity("destroy_vma_cb: Before free_vma_resources");
-    free_vma_resources(vma_node); // Assumes this function calls kfree(vma_node)
-    check_idle_task_stack_integrity("destroy_vma_cb: After free_vma_resources");
-    serial_write("  Returned from free_vma_resources.\n");
-}
+ /**
+  * Duplicates src's VMA tree and layout fields for fork(). The new mm uses
+  * pgd_phys, which must already be a copy of src's page tables
+  * (paging_clone_directory). Returns NULL on allocation failure.
+  */
+ mm_struct_t *clone_mm(mm_struct_t *src, uint32_t *pgd_phys) {
+     if (!src || !pgd_phys) return NULL;
+     mm_struct_t *mm = create_mm(pgd_phys);
+     if (!mm) return NULL;
+
+     bool failed = false;
+     uintptr_t irq_flags = rwlock_read_acquire_irqsave(&src->lock);
+     for (struct rb_node *node = rb_tree_first(&src->vma_tree); node; node = rb_node_next(node)) {
+         vma_struct_t *src_vma = rb_entry(node, vma_struct_t, rb_node);
+         vma_struct_t *vma = alloc_vma_struct();
+         if (!vma) { failed = true; break; }
+         vma->vm_start = src_vma->vm_start;
+         vma->vm_end = src_vma->vm_end;
+         vma->vm_flags = src_vma->vm_flags;
+         vma->page_prot = src_vma->page_prot;
+         vma->vm_file = src_vma->vm_file;
+         if (vma->vm_file) sys_file_get(vma->vm_file);
+         vma->vm_offset = src_vma->vm_offset;
+         vma->vm_file_bytes = src_vma->vm_file_bytes;
+         vma->vm_fault_around = src_vma->vm_fault_around;
+         // Source VMAs never overlap, so this cannot fail; mm is private to us.
+         insert_vma_locked(mm, vma);
+     }
+     mm->start_code = src->start_code;   mm->end_code = src->end_code;
+     mm->start_data = src->start_data;   mm->end_data = src->end_data;
+     mm->start_brk = src->start_brk;     mm->end_brk = src->end_brk;
+     mm->start_stack = src->start_stack;
+     rwlock_read_release_irqrestore(&src->lock, irq_flags);
+
+     if (failed) {
+         // Only the structures go; the page tables belong to the caller.
+         rbtree_postorder_traverse(mm->vma_tree.root, free_vma_node_callback, NULL);
+         kfree(mm);
+         return NULL;
+     }
+     return mm;
+ }
+
 
- 
- 
  // --- VMA Find/Insert Operations (Using RB Tree) ---
  
  /**
-  * Finds the VMA containing addr using RB Tree. Assumes lock held.
+  * Forgets the cached lookups. Called with the lock held exclusively by
+  * everything that adds, removes or resizes a VMA.
+  */
+ static inline void vmacache_invalidate(mm_struct_t *mm) {
+     memset(mm->vmacache, 0, sizeof(mm->vmacache));
+ }
+ 
+ /**
+  * Finds the VMA containing addr, trying the per-mm cache before the RB Tree.
+  * Assumes lock held (shared is enough: concurrent slot stores are plain
+  * word writes of VMAs that cannot be freed while any reader holds the lock).
   */
  static vma_struct_t* find_vma_locked(mm_struct_t *mm, uintptr_t addr) {
-     // Call RB Tree find function
-     return rbtree_find_vma(mm->vma_tree.root, addr);
+     for (int i = 0; i < MM_VMACACHE_SIZE; i++) {
+         vma_struct_t *vma = mm->vmacache[i];
+         if (vma && addr >= vma->vm_start && addr < vma->vm_end) return vma;
+     }
+     vma_struct_t *vma = rbtree_find_vma(mm->vma_tree.root, addr);
+     if (vma) {
+         uint32_t slot = mm->vmacache_next++ % MM_VMACACHE_SIZE;
+         mm->vmacache[slot] = vma;
+     }
+     return vma;
  }
  
  /**
-  * Public version of find_vma (acquires lock).
+  * Public version of find_vma (takes the lock shared, so faults on other CPUs run in parallel).
   */
  vma_struct_t *find_vma(mm_struct_t *mm, uintptr_t addr) {
      if (!mm) return NULL;
-     uintptr_t irq_flags = spinlock_acquire_irqsave(&mm->lock);
+     uintptr_t irq_flags = rwlock_read_acquire_irqsave(&mm->lock);
      vma_struct_t *vma = find_vma_locked(mm, addr);
-     spinlock_release_irqrestore(&mm->lock, irq_flags);
+     rwlock_read_release_irqrestore(&mm->lock, irq_flags);
      return vma;
  }
  
@@ -253,6 +287,7 @@
  
      new_vma->vm_mm = mm;
      mm->map_count++;
+     vmacache_invalidate(mm);
  
      // TODO: Optional: Check for adjacent VMAs with compatible flags/file and merge them
  
@@ -264,7 +299,7 @@
   */
  vma_struct_t* insert_vma(mm_struct_t *mm, uintptr_t start, uintptr_t end,
                           uint32_t vm_flags, uint32_t page_prot,
-                          file_t* file, size_t offset)
+                          struct sys_file *file, size_t offset)
  {
      if (!mm || start > end || (start % PAGE_SIZE) != 0 || (end % PAGE_SIZE) != 0) {
          terminal_write("[MM] insert_vma: Invalid parameters.\n");
@@ -279,21 +314,22 @@
      vma->vm_end = end;
      vma->vm_flags = vm_flags;
      vma->page_prot = page_prot;
-     vma->vm_file = file; // Note: This doesn't take ownership or increment refcount here
+     vma->vm_file = file;
+     if (file) sys_file_get(file); // Dropped by free_vma_resources()
      vma->vm_offset = offset;
+     vma->vm_file_bytes = end - start;
+     vma->vm_fault_around = FAULT_AROUND_PAGES;
      vma->vm_mm = mm;
      // RB node fields initialized by rb_tree_insert_at
  
-     uintptr_t irq_flags = spinlock_acquire_irqsave(&mm->lock);
+     uintptr_t irq_flags = rwlock_write_acquire_irqsave(&mm->lock);
      vma_struct_t* result = insert_vma_locked(mm, vma);
-     spinlock_release_irqrestore(&mm->lock, irq_flags);
+     rwlock_write_release_irqrestore(&mm->lock, irq_flags);
  
      if (!result) {
          free_vma_resources(vma); // Free struct if insertion failed
          return NULL;
      }
-     // TODO: If file-backed, increment file reference count NOW (e.g., vfs_file_dup(file))
-     // if (vma->vm_file) { vfs_file_dup(vma->vm_file); } // Requires vfs_file_dup
      return result;
  }
  
@@ -303,7 +339,8 @@
  // get_pte_ptr helper function (maps PD/PT temporarily)
  // Returns pointer to PTE within temporarily mapped PT
  // Caller MUST unmap the returned PT mapping address after use.
- static uint32_t* get_pte_ptr(mm_struct_t *mm, uintptr_t vaddr, bool allocate_pt) {
+ // The PT's physical address is stored in *pt_phys_out if that is non-NULL.
+ static uint32_t* get_pte_ptr(mm_struct_t *mm, uintptr_t vaddr, bool allocate_pt, uintptr_t *pt_phys_out) {
      // terminal_printf("[get_pte_ptr] Enter: V=%p, alloc=%d\n", (void*)vaddr, allocate_pt);
      if (!mm || !mm->pgd_phys) {
          terminal_printf("[get_pte_ptr] Error: Invalid mm or pgd_phys.\n");
@@ -342,33 +379,37 @@
          }
  
          // Allocate a new frame for the Page Table
-         pt_phys_addr_val = frame_alloc();
+         pt_phys_addr_val = frame_alloc_zeroed(); // Page tables must start empty
          if (pt_phys_addr_val == 0) {
              terminal_printf("[get_pte_ptr] Error: Failed to allocate frame for new PT (PDE[%lu]).\n", (unsigned long)pd_idx);
              goto fail_gpp;
          }
          allocated_pt_frame = true;
+         frame_pt_live_set(pt_phys_addr_val, 0);
          // terminal_printf("[get_pte_ptr] Allocated new PT frame %#lx for PDE[%lu]\n", pt_phys_addr_val, pd_idx);
  
-         // Map the NEW PT frame temporarily to zero it out
-         void* temp_pt_zero_map = paging_temp_map(pt_phys_addr_val, PTE_KERNEL_DATA_FLAGS);
-         if (!temp_pt_zero_map) {
-             terminal_printf("[get_pte_ptr] Error: Failed to temp map new PT frame %#lx for zeroing.\n", (unsigned long)pt_phys_addr_val);
-             goto fail_gpp; // Free frame in cleanup
-         }
-         memset(temp_pt_zero_map, 0, PAGE_SIZE);
-         paging_temp_unmap(temp_pt_zero_map); // Unmap after zeroing
- 
          // Set the PDE in the temporarily mapped target PD
          // Use USER flags if the eventual PTE will need them (most flexible)
          uint32_t pde_flags = PAGE_PRESENT | PAGE_RW | PAGE_USER; // Common flags for a PT PDE
-         proc_pd_virt[pd_idx] = (pt_phys_addr_val & PAGING_ADDR_MASK) | pde_flags;
+         if (!pte_cmpxchg(&proc_pd_virt[pd_idx], pde, (pt_phys_addr_val & PAGING_ADDR_MASK) | pde_flags)) {
+             // A sibling thread's fault installed a table first: use that one
+             put_frame(pt_phys_addr_val);
+             allocated_pt_frame = false;
+             pde = proc_pd_virt[pd_idx];
+             if (pde & PAGE_SIZE_4MB) pt_phys_addr_val = paging_split_large_pde(mm->pgd_phys, proc_pd_virt, pd_idx);
+             else pt_phys_addr_val = (uintptr_t)(pde & PAGING_ADDR_MASK);
+             if (!pt_phys_addr_val) goto fail_gpp;
+         }
          // TLB invalidation is handled by caller or context switch
  
      } else if (pde & PAGE_SIZE_4MB) {
-         // Cannot get a PTE pointer if the PDE maps a 4MB page
-         terminal_printf("[get_pte_ptr] Error: Cannot get PTE for V=%p; PDE[%lu] is a 4MB page.\n", (void*)vaddr, (unsigned long)pd_idx);
-         goto fail_gpp;
+         // A user large page: the caller works on one 4KB page of it, so
+         // split it into a page table of the same frames first
+         pt_phys_addr_val = paging_split_large_pde(mm->pgd_phys, proc_pd_virt, pd_idx);
+         if (!pt_phys_addr_val) {
+             terminal_printf("[get_pte_ptr] Error: Cannot split 4MB page PDE[%lu] for V=%p.\n", (unsigned long)pd_idx, (void*)vaddr);
+             goto fail_gpp;
+         }
      } else {
          // PDE is present and points to a 4KB Page Table
          pt_phys_addr_val = (uintptr_t)(pde & PAGING_ADDR_MASK);
@@ -383,6 +424,7 @@
  
      // 5. Calculate pointer to the specific PTE within the temporary PT mapping
      pte_ptr = &pt_virt[pt_idx];
+     if (pt_phys_out) *pt_phys_out = pt_phys_addr_val;
      // terminal_printf("[get_pte_ptr] Success: Returning PTE pointer %p (inside temp map %p for PT Phys %#lx)\n",
      //                 pte_ptr, pt_virt, pt_phys_addr_val);
  
@@ -407,10 +449,570 @@
      return NULL; // Indicate failure
  }
  
+ /**
+  * The fault window around @p page_addr: its aligned vm_fault_around pages,
+  * clamped to the VMA and to the page table holding @p page_addr, in
+  * [@p start, @p end). Returns the window size (<= 1: just the page).
+  */
+ static uint32_t fault_window(const vma_struct_t *vma, uintptr_t page_addr, uintptr_t *start, uintptr_t *end) {
+     uint32_t window = vma->vm_fault_around;
+     if (window > FAULT_AROUND_PAGES) window = FAULT_AROUND_PAGES;
+     if (window <= 1) return window;
+
+     uintptr_t pt_start = page_addr & ~(uintptr_t)(PAGE_SIZE_LARGE - 1);
+     *start = page_addr - ((page_addr / PAGE_SIZE) % window) * PAGE_SIZE;
+     if (*start < pt_start) *start = pt_start;
+     if (*start < vma->vm_start) *start = vma->vm_start;
+     *end = *start + window * PAGE_SIZE;
+     if (*end > pt_start + PAGE_SIZE_LARGE) *end = pt_start + PAGE_SIZE_LARGE;
+     if (*end > vma->vm_end) *end = vma->vm_end;
+     return window;
+ }
+
+ /**
+  * Fault-around: after a demand fault at @p page_addr, maps the other
+  * non-present pages of its fault window in the page table @p pt so that
+  * neighbouring touches don't fault. Swapped-out pages are left to swap
+  * read-ahead.
+  * Anonymous pages and the zero tail of a file VMA get fresh zeroed frames;
+  * file data is only taken when already in the page cache, so this never
+  * waits for I/O. Writable file VMAs read privately and are left alone.
+  * Stops quietly when frames run out: every page here is speculative.
+  * Returns how many PTEs it made present (for the table's live count) and
+  * counts the zeroed frames among them in @p zeroed.
+  */
+ static uint32_t fault_around(vma_struct_t *vma, uintptr_t page_addr, uint32_t *pt, uint32_t *zeroed) {
+     uintptr_t start = 0, end = 0;
+     if (fault_window(vma, page_addr, &start, &end) <= 1) return 0;
+     bool file_backed = (vma->vm_flags & VM_FILEBACKED) && vma->vm_file;
+     if (file_backed && (vma->vm_flags & VM_WRITE)) return 0;
+     uint32_t mapped = 0;
+
+     for (uintptr_t addr = start; addr < end; addr += PAGE_SIZE) {
+         volatile uint32_t *pte = &pt[PTE_INDEX(addr)];
+         uint32_t old = *pte;
+         if (addr == page_addr || (old & PAGE_PRESENT) || pte_is_swap(old)) continue;
+
+         uintptr_t phys;
+         bool fresh = false;
+         size_t in_vma = addr - vma->vm_start;
+         if (file_backed && in_vma < vma->vm_file_bytes) {
+             size_t len = vma->vm_file_bytes - in_vma;
+             if (len > PAGE_SIZE) len = PAGE_SIZE;
+             phys = page_cache_lookup(vma->vm_file->vfs_file, (off_t)(vma->vm_offset + in_vma), len);
+             if (!phys) continue; // Not cached: its own fault will read it
+         } else {
+             phys = frame_alloc_zeroed_mt(MIGRATE_MOVABLE);
+             if (!phys) break;
+             fresh = true;
+         }
+         // Non-present entries are never cached in the TLB: no flush needed.
+         if (!pte_cmpxchg(pte, old, (phys & PAGING_ADDR_MASK) | vma->page_prot | PAGE_PRESENT)) {
+             put_frame(phys); // A sibling thread's fault mapped it meanwhile
+             continue;
+         }
+         if (fresh) (*zeroed)++;
+         mapped++;
+     }
+     return mapped;
+ }
+
+ /**
+  * A movable frame for a user page, zeroed if @p zeroed. When none is free
+  * and swap is on, some of @p mm's own cold pages are written out first and
+  * the allocation is retried once: the fault waits for the disk instead of
+  * killing the process. May sleep, so only with mm->lock dropped.
+  */
+ static uintptr_t user_frame_alloc(mm_struct_t *mm, bool zeroed) {
+     uintptr_t phys = zeroed ? frame_alloc_zeroed_mt(MIGRATE_MOVABLE) : frame_alloc_mt(MIGRATE_MOVABLE);
+     if (phys || !swap_active() || swap_reclaim_mm(mm, SWAP_CLUSTER) == 0) return phys;
+     return zeroed ? frame_alloc_zeroed_mt(MIGRATE_MOVABLE) : frame_alloc_mt(MIGRATE_MOVABLE);
+ }
+
+ // Besides 0 and a negated FS_ERR_* code, vma_fault() and its helpers return:
+ #define FAULT_RETRY    0x100 // Run fault_prepare() with mm->lock dropped, then fault again
+ #define FAULT_FALLBACK 0x101 // The helper doesn't apply: map an ordinary 4KB page
+
+ /**
+  * What a fault could not do under mm->lock. vma_fault() runs with the lock
+  * held shared, so the VMA and the page tables stay put under it, but it
+  * must not sleep. When it needs a disk read, reclaim, or a 4MB block
+  * zeroed, it records that in @c want and returns FAULT_RETRY.
+  * handle_vma_fault() drops the lock and fault_prepare() does the work.
+  * Then the fault starts over with a fresh VMA lookup and PTE read. A
+  * result that no longer fits (the page was mapped, unmapped or remapped
+  * meanwhile) is just released.
+  */
+ typedef enum {
+     FAULT_PREP_NONE,
+     FAULT_PREP_FRAME, // A movable frame, zeroed if @c zeroed, reclaiming if need be
+     FAULT_PREP_SWAP,  // The page in swap entry @c entry, and its read-ahead
+     FAULT_PREP_FILE,  // The page of @c file at @c pos, @c len bytes of it from the file
+     FAULT_PREP_HUGE,  // A zeroed 4MB block
+ } fault_prep_kind_t;
+
+ typedef struct {
+     uintptr_t addr;
+     uint32_t entry;    // Pinned with a slot reference of our own
+     uintptr_t phys;    // Read back by fault_prepare(), or 0
+ } fault_swap_page_t;
+
+ typedef struct {
+     fault_prep_kind_t want;   // Asked for by the last pass
+     fault_prep_kind_t ready;  // What @c phys holds: one frame reference (a 4MB block for HUGE)
+     uintptr_t phys;
+     bool zeroed;              // FRAME
+     bool no_huge;             // HUGE found no free block: stay on 4KB pages
+     uint32_t entry;           // SWAP, pinned with a slot reference of our own (0 = none)
+     uint32_t nr_ahead;
+     fault_swap_page_t ahead[FAULT_AROUND_PAGES];
+     sys_file_t *file;         // FILE, with a reference of our own
+     off_t pos;
+     size_t len;
+     bool cached;              // FILE: the page cache's frame will do (read-only VMA)
+     bool major;               // FILE: the page was read from the file privately
+ } fault_prep_t;
+
+ /**
+  * Whether @p prep is free to ask for @p kind. Not while it still holds an
+  * earlier result: releasing that may close a file, so it is left to
+  * fault_prepare(), and the next pass asks again.
+  */
+ static bool fault_want(fault_prep_t *prep, fault_prep_kind_t kind) {
+     if (prep->ready || prep->file || prep->entry || prep->nr_ahead) return false;
+     prep->want = kind;
+     return true;
+ }
+
+ /** @brief Takes the frame fault_prepare() got, if it is a @p kind; 0 otherwise. */
+ static uintptr_t fault_take(fault_prep_t *prep, fault_prep_kind_t kind) {
+     if (prep->ready != kind) return 0;
+     uintptr_t phys = prep->phys;
+     prep->phys = 0;
+     prep->ready = FAULT_PREP_NONE;
+     return phys;
+ }
+
+ /** @brief Drops everything @p prep holds. May close a file: mm->lock not held. */
+ static void fault_prep_release(fault_prep_t *prep) {
+     if (prep->phys) {
+         if (prep->ready == FAULT_PREP_HUGE) put_frames_range(prep->phys, PAGES_PER_TABLE);
+         else put_frame(prep->phys);
+     }
+     for (uint32_t i = 0; i < prep->nr_ahead; i++) {
+         if (prep->ahead[i].phys) put_frame(prep->ahead[i].phys);
+         swap_free(prep->ahead[i].entry);
+     }
+     if (prep->entry) swap_free(prep->entry);
+     if (prep->file) sys_file_put(prep->file);
+     bool no_huge = prep->no_huge;
+     memset(prep, 0, sizeof(*prep));
+     prep->no_huge = no_huge;
+ }
+
+ /**
+  * Does what the last pass of @p mm's fault asked for, with mm->lock
+  * dropped; sleeps on the disk and in reclaim. Returns 0 to fault again,
+  * or an error as vma_fault() does.
+  */
+ static int fault_prepare(mm_struct_t *mm, fault_prep_t *prep) {
+     fault_prep_kind_t want = prep->want;
+     prep->want = FAULT_PREP_NONE;
+     uintptr_t phys = 0;
+
+     switch (want) {
+     case FAULT_PREP_NONE: // Holds a result the last pass couldn't use
+         fault_prep_release(prep);
+         return 0;
+     case FAULT_PREP_FRAME:
+         phys = user_frame_alloc(mm, prep->zeroed);
+         if (!phys) return -FS_ERR_OUT_OF_MEMORY;
+         break;
+     case FAULT_PREP_SWAP: {
+         phys = user_frame_alloc(mm, false);
+         if (!phys) return -FS_ERR_OUT_OF_MEMORY;
+         int err = swap_read_page(prep->entry, phys, false);
+         if (err != FS_SUCCESS) {
+             put_frame(phys);
+             if (err == FS_ERR_NOT_FOUND || err == FS_ERR_BUSY) return 0; // Fault again and see
+             terminal_printf("[PF Swap] Error: reading slot %lu failed (%d)\n",
+                             (unsigned long)swap_entry_slot(prep->entry), err);
+             return -FS_ERR_IO;
+         }
+         // Read-ahead is speculative: no reclaim, and stop when frames run out
+         for (uint32_t i = 0; i < prep->nr_ahead; i++) {
+             fault_swap_page_t *ra = &prep->ahead[i];
+             ra->phys = frame_alloc_mt(MIGRATE_MOVABLE);
+             if (!ra->phys) break;
+             if (swap_read_page(ra->entry, ra->phys, true) != FS_SUCCESS) {
+                 put_frame(ra->phys);
+                 ra->phys = 0;
+             }
+         }
+         break;
+     }
+     case FAULT_PREP_FILE: {
+         if (prep->cached) phys = page_cache_get_page(prep->file->vfs_file, prep->pos, prep->len);
+         if (phys) break;
+         // Anything past the read (EOF, past vm_file_bytes) stays zero
+         phys = user_frame_alloc(mm, true);
+         if (!phys) return -FS_ERR_OUT_OF_MEMORY;
+         void *dst = paging_temp_map(phys, PTE_KERNEL_DATA_FLAGS); // Not kmap_atomic: the read sleeps
+         int nread = dst ? vfs_pread(prep->file->vfs_file, dst, prep->len, prep->pos) : -FS_ERR_OUT_OF_MEMORY;
+         if (dst) paging_temp_unmap(dst);
+         if (nread < 0) {
+             terminal_printf("[PF Handle] Error: file read failed (%d) at offset %ld\n", nread, (long)prep->pos);
+             put_frame(phys);
+             return -FS_ERR_IO;
+         }
+         prep->major = true;
+         break;
+     }
+     case FAULT_PREP_HUGE:
+         phys = frame_alloc_huge(); // Zeroes 4MB
+         if (!phys) {
+             prep->no_huge = true;
+             return 0;
+         }
+         break;
+     }
+     prep->phys = phys;
+     prep->ready = want;
+     return 0;
+ }
+
+ /**
+  * Picks the swap read-ahead for a fault at @p page_addr, whose entry names
+  * slot @p slot: the other pages of its fault window in page table @p pt
+  * whose entries name slots less than a window away. The clock hands out
+  * slots in sweep order, so pages that left together sit in neighbouring
+  * slots and tend to be wanted together. Each entry is pinned so that its
+  * slot can't be reused while fault_prepare() reads it.
+  */
+ static void swap_readahead_pick(vma_struct_t *vma, uintptr_t page_addr, uint32_t slot, uint32_t *pt,
+                                 fault_prep_t *prep) {
+     uintptr_t start = 0, end = 0;
+     uint32_t window = fault_window(vma, page_addr, &start, &end);
+     if (window <= 1) return;
+
+     for (uintptr_t addr = start; addr < end && prep->nr_ahead < FAULT_AROUND_PAGES; addr += PAGE_SIZE) {
+         uint32_t entry = pt[PTE_INDEX(addr)];
+         if (addr == page_addr || !pte_is_swap(entry)) continue;
+         uint32_t near = swap_entry_slot(entry);
+         if (near + window <= slot || near >= slot + window) continue;
+         if (!swap_dup(entry)) continue;
+         fault_swap_page_t *ra = &prep->ahead[prep->nr_ahead++];
+         ra->addr = addr;
+         ra->entry = entry;
+         ra->phys = 0;
+     }
+ }
+
+ /** @brief Maps the read-ahead pages whose PTEs in @p pt still hold their entries. Returns how many. */
+ static uint32_t swap_readahead_map(vma_struct_t *vma, uint32_t *pt, fault_prep_t *prep) {
+     uint32_t mapped = 0;
+     for (uint32_t i = 0; i < prep->nr_ahead; i++) {
+         fault_swap_page_t *ra = &prep->ahead[i];
+         if (!ra->phys || ra->addr < vma->vm_start || ra->addr >= vma->vm_end) continue;
+         // Left without PAGE_ACCESSED: untouched, it is the clock's first pick again
+         if (pte_cmpxchg(&pt[PTE_INDEX(ra->addr)], ra->entry, (ra->phys & PAGING_ADDR_MASK) | vma->page_prot | PAGE_PRESENT)) {
+             swap_free(ra->entry); // The PTE's reference; the pin goes with the prep
+             ra->phys = 0;
+             mapped++;
+         }
+     }
+     return mapped;
+ }
+
+ /**
+  * Non-present fault on a page that may be swapped out. Shares the frame it
+  * is still being written from (read-only, so a write copies it), or maps
+  * what fault_prepare() read back from its slot, read-ahead included;
+  * otherwise asks for that read. Returns FAULT_FALLBACK if the PTE holds no
+  * swap entry and the caller should map a fresh page, otherwise as
+  * vma_fault() does. A fault that loses a race with a sibling thread
+  * returns 0 and simply faults again.
+  */
+ static int swap_fault(mm_struct_t *mm, vma_struct_t *vma, uintptr_t page_addr, fault_prep_t *prep,
+                       mm_fault_stats_t *ev) {
+     uint32_t *pte_ptr = get_pte_ptr(mm, page_addr, false, NULL);
+     if (!pte_ptr) return FAULT_FALLBACK; // No page table, so no entry either
+     uint32_t *pt = (uint32_t *)PAGE_ALIGN_DOWN((uintptr_t)pte_ptr);
+     uint32_t entry = *pte_ptr;
+     if (!pte_is_swap(entry)) {
+         paging_temp_unmap(pt);
+         return FAULT_FALLBACK;
+     }
+
+     uint32_t map_flags = vma->page_prot;
+     uintptr_t phys = (prep->entry == entry) ? fault_take(prep, FAULT_PREP_SWAP) : 0;
+     if (!phys) {
+         phys = swap_writeback_frame(entry);
+         if (phys) map_flags &= ~PAGE_RW;
+     }
+     if (!phys) {
+         int ret = FAULT_RETRY;
+         if (fault_want(prep, FAULT_PREP_SWAP)) {
+             if (swap_dup(entry)) {
+                 prep->entry = entry;
+                 swap_readahead_pick(vma, page_addr, swap_entry_slot(entry), pt, prep);
+             } else {
+                 prep->want = FAULT_PREP_NONE;
+                 ret = -FS_ERR_NO_RESOURCES; // The slot's count is saturated
+             }
+         }
+         paging_temp_unmap(pt);
+         return ret;
+     }
+
+     if (pte_cmpxchg(pte_ptr, entry, (phys & PAGING_ADDR_MASK) | map_flags | PAGE_PRESENT)) {
+         swap_free(entry);
+         ev->major = 1;
+         ev->fault_around = swap_readahead_map(vma, pt, prep);
+     } else {
+         put_frame(phys);
+     }
+     paging_temp_unmap(pt);
+     paging_invalidate_page((void*)page_addr);
+     return 0;
+ }
+
+ // Pages the swap clock may evict: private and writable, so each frame is
+ // this mapping's own copy (a private view of shm maps the object's frames).
+ static bool vma_swappable(const vma_struct_t *vma) {
+     if ((vma->vm_flags & (VM_WRITE | VM_SHARED)) != VM_WRITE) return false;
+     return !(vma->vm_file && shm_is_shm(vma->vm_file->vfs_file));
+ }
+
+ // Present, writable user pages; read-only ones are mostly still shared
+ // since fork() and get their own frame on the next write.
+ #define SWAP_SCAN_PTE_BITS (PAGE_PRESENT | PAGE_RW | PAGE_USER)
+
+ uint32_t mm_swap_scan(mm_struct_t *mm, uintptr_t *hand, uint32_t *budget,
+                       swap_victim_t *out, uint32_t max_out, uint32_t *second_chance) {
+     uint32_t nr_out = 0;
+     uintptr_t addr = *hand;
+     uintptr_t flush_start = UINTPTR_MAX, flush_end = 0; // PTEs changed
+     struct rb_node *node = NULL;
+
+     // Exclusive: munmap can't free a table under us, and fork's
+     // write-protect pass can't copy a PTE we are replacing.
+     uintptr_t irq_flags = rwlock_write_acquire_irqsave(&mm->lock);
+     uint32_t *pd_virt = paging_temp_map((uintptr_t)mm->pgd_phys, PTE_KERNEL_DATA_FLAGS);
+     if (pd_virt) node = rb_tree_first(&mm->vma_tree);
+
+     while (node && *budget && nr_out < max_out) {
+         vma_struct_t *vma = rb_entry(node, vma_struct_t, rb_node);
+         if (addr < vma->vm_start) addr = vma->vm_start;
+         if (!vma_swappable(vma)) addr = vma->vm_end;
+
+         while (addr < vma->vm_end && *budget && nr_out < max_out) {
+             uintptr_t end = PAGE_LARGE_ALIGN_DOWN(addr) + PAGE_SIZE_LARGE;
+             if (end > vma->vm_end) end = vma->vm_end;
+             uint32_t pd_idx = PDE_INDEX(addr);
+             uint32_t pde = pd_virt[pd_idx];
+             if ((pde & (PAGE_PRESENT | PAGE_SIZE_4MB)) != PAGE_PRESENT ||
+                 !paging_pt_counted(mm->pgd_phys, pd_idx)) {
+                 addr = end; // No table, a 4MB page, or the shared identity table
+                 continue;
+             }
+
+             uint32_t *pt = kmap_atomic(pde & PAGING_PDE_ADDR_MASK_4KB);
+             for (; addr < end && *budget && nr_out < max_out; addr += PAGE_SIZE) {
+                 volatile uint32_t *pte = &pt[PTE_INDEX(addr)];
+                 uint32_t old = *pte;
+                 (*budget)--;
+                 if ((old & SWAP_SCAN_PTE_BITS) != SWAP_SCAN_PTE_BITS) continue;
+
+                 if (old & PAGE_ACCESSED) {
+                     // Second chance; the flush below makes the CPU set it again on use
+                     asm volatile("lock andl %1, %0" : "+m"(*pte) : "ir"(~(uint32_t)PAGE_ACCESSED) : "memory", "cc");
+                     (*second_chance)++;
+                 } else {
+                     uintptr_t phys = old & PAGING_ADDR_MASK;
+                     if (get_frame_refcount(phys) != 1) continue; // Shared (COW, page cache) or pinned
+                     uint32_t entry = swap_alloc_entry(phys);
+                     if (!entry) {
+                         *budget = 0; // Swap is full
+                         break;
+                     }
+                     if (!pte_cmpxchg(pte, old, entry)) {
+                         swap_cancel_entry(entry); // The CPU just touched it
+                         continue;
+                     }
+                     out[nr_out].addr = addr;
+                     out[nr_out].pte = old;
+                     out[nr_out].entry = entry;
+                     nr_out++;
+                 }
+                 if (addr < flush_start) flush_start = addr;
+                 flush_end = addr + PAGE_SIZE;
+             }
+             kunmap_atomic(pt);
+         }
+         if (addr >= vma->vm_end) node = rb_node_next(node);
+     }
+
+     if (pd_virt) paging_temp_unmap(pd_virt);
+     // Before any victim is written: no CPU may still store through an old entry
+     if (flush_end) tlb_shootdown(mm->pgd_phys, flush_start, flush_end);
+     rwlock_write_release_irqrestore(&mm->lock, irq_flags);
+     *hand = node ? addr : 0;
+     return nr_out;
+ }
+
+ bool mm_swap_restore(mm_struct_t *mm, const swap_victim_t *victim) {
+     bool restored = false;
+     uintptr_t irq_flags = rwlock_write_acquire_irqsave(&mm->lock);
+     uint32_t *pte_ptr = get_pte_ptr(mm, victim->addr, false, NULL);
+     if (pte_ptr) {
+         restored = pte_cmpxchg(pte_ptr, victim->entry, victim->pte);
+         paging_temp_unmap((void*)PAGE_ALIGN_DOWN((uintptr_t)pte_ptr));
+     }
+     rwlock_write_release_irqrestore(&mm->lock, irq_flags);
+     if (restored) swap_free(victim->entry);
+     return restored;
+ }
+ 
+ // System-wide fault counters, one line per CPU; a CPU updates its own with
+ // interrupts off, readers sum a snapshot.
+ typedef struct {
+     mm_fault_stats_t stats;
+ } __attribute__((aligned(64))) mm_cpu_fault_stats_t;
+
+ static mm_cpu_fault_stats_t s_cpu_fault_stats[MAX_CPUS];
+
+ static void fault_stats_add(mm_fault_stats_t *dst, const mm_fault_stats_t *ev) {
+     dst->minor += ev->minor;
+     dst->major += ev->major;
+     dst->cow_copies += ev->cow_copies;
+     dst->cow_reuses += ev->cow_reuses;
+     dst->zero_fills += ev->zero_fills;
+     dst->fault_around += ev->fault_around;
+     dst->huge_pages += ev->huge_pages;
+     dst->cycles += ev->cycles;
+ }
+
+ static void fault_stats_account(mm_struct_t *mm, const mm_fault_stats_t *ev) {
+     uintptr_t irq_flags = spinlock_acquire_irqsave(&mm->fault_stats_lock);
+     fault_stats_add(&mm->fault_stats, ev);
+     uint32_t cpu = get_cpu_id();
+     if (cpu < MAX_CPUS) fault_stats_add(&s_cpu_fault_stats[cpu].stats, ev);
+     spinlock_release_irqrestore(&mm->fault_stats_lock, irq_flags);
+ }
+
+ void mm_get_fault_stats(mm_struct_t *mm, mm_fault_stats_t *out) {
+     memset(out, 0, sizeof(*out));
+     if (mm) {
+         uintptr_t irq_flags = spinlock_acquire_irqsave(&mm->fault_stats_lock);
+         *out = mm->fault_stats;
+         spinlock_release_irqrestore(&mm->fault_stats_lock, irq_flags);
+         return;
+     }
+     for (int cpu = 0; cpu < MAX_CPUS; cpu++) fault_stats_add(out, &s_cpu_fault_stats[cpu].stats);
+ }
+
+ // --- 4MB Pages for Anonymous Memory ---
+
+ bool g_mm_huge_pages = true;
+
+ // Large pages are skipped below this much free buddy memory, so a sparse
+ // mapping cannot eat the last of it 4MB at a time.
+ #define HUGE_FAULT_MIN_FREE (4u * PAGE_SIZE_LARGE)
+
+ /**
+  * Whether a demand fault at @p page_addr may map the whole aligned 4MB
+  * around it: private writable anonymous memory (heap, anonymous mmap)
+  * whose VMA covers all of it. Stacks grow a page at a time and stay on 4KB.
+  */
+ static bool vma_huge_eligible(const vma_struct_t *vma, uintptr_t page_addr) {
+     if (!g_mm_huge_pages || !g_pse_supported || vma->vm_file) return false;
+     uint32_t kind = vma->vm_flags & (VM_ANONYMOUS | VM_WRITE | VM_SHARED | VM_GROWS_DOWN);
+     if (kind != (VM_ANONYMOUS | VM_WRITE)) return false;
+     uintptr_t base = PAGE_LARGE_ALIGN_DOWN(page_addr);
+     return base >= vma->vm_start && vma->vm_end - base >= PAGE_SIZE_LARGE;
+ }
+
+ /**
+  * Maps the aligned 4MB around @p page_addr with one PSE PDE over a zeroed
+  * block from fault_prepare(), asking for one first. Returns 0 once the
+  * slot holds a large page (ours, or one a sibling thread installed) or its
+  * PDE changed under us, FAULT_RETRY to get the block, and FAULT_FALLBACK
+  * if the caller should map 4KB instead: the slot already has a page
+  * table, or no 4MB block is free.
+  */
+ static int huge_fault(mm_struct_t *mm, vma_struct_t *vma, uintptr_t page_addr, fault_prep_t *prep,
+                       mm_fault_stats_t *ev) {
+     if (prep->no_huge) return FAULT_FALLBACK;
+     uint32_t pd_idx = PDE_INDEX(page_addr);
+     uint32_t *pd_virt = paging_temp_map((uintptr_t)mm->pgd_phys, PTE_KERNEL_DATA_FLAGS);
+     if (!pd_virt) return FAULT_FALLBACK;
+     uint32_t pde = pd_virt[pd_idx];
+     if (pde & PAGE_PRESENT) {
+         paging_temp_unmap(pd_virt);
+         return (pde & PAGE_SIZE_4MB) ? 0 : FAULT_FALLBACK;
+     }
+
+     uintptr_t phys = fault_take(prep, FAULT_PREP_HUGE);
+     if (!phys) {
+         // Zeroing 4MB takes too long for the lock: fault_prepare() does it
+         paging_temp_unmap(pd_virt);
+         if (buddy_free_space() < HUGE_FAULT_MIN_FREE) return FAULT_FALLBACK;
+         fault_want(prep, FAULT_PREP_HUGE);
+         return FAULT_RETRY;
+     }
+     uint32_t new_pde = (phys & PAGING_PDE_ADDR_MASK_4MB) | vma->page_prot | PAGE_PRESENT | PAGE_SIZE_4MB;
+     bool installed = pte_cmpxchg(&pd_virt[pd_idx], pde, new_pde);
+     paging_temp_unmap(pd_virt);
+     if (!installed) {
+         // A sibling thread mapped something here meanwhile; fault again and use it
+         put_frames_range(phys, PAGES_PER_TABLE);
+         return 0;
+     }
+     paging_invalidate_page((void*)page_addr);
+     ev->zero_fills = PAGES_PER_TABLE;
+     ev->huge_pages = 1;
+     return 0;
+ }
+
+ /**
+  * Write fault on a write-protected user large page (fork shared it).
+  * Makes it writable in place when no other mapping holds any of its frames
+  * and returns true; otherwise returns false and the caller copies the
+  * faulting 4KB page after get_pte_ptr() has split the PDE.
+  */
+ static bool huge_write_reuse(mm_struct_t *mm, uintptr_t page_addr, mm_fault_stats_t *ev) {
+     uint32_t *pd_virt = paging_temp_map((uintptr_t)mm->pgd_phys, PTE_KERNEL_DATA_FLAGS);
+     if (!pd_virt) return false;
+     volatile uint32_t *pde = &pd_virt[PDE_INDEX(page_addr)];
+     bool reused = false;
+     if ((*pde & (PAGE_PRESENT | PAGE_SIZE_4MB)) == (PAGE_PRESENT | PAGE_SIZE_4MB)) {
+         uintptr_t frame_base = *pde & PAGING_PDE_ADDR_MASK_4MB;
+         reused = true;
+         for (uint32_t i = 0; i < PAGES_PER_TABLE && reused; i++) {
+             reused = get_frame_refcount(frame_base + i * PAGE_SIZE) == 1;
+         }
+         // Atomic: the CPU may set the accessed or dirty bit meanwhile
+         if (reused) asm volatile("lock orl %1, %0" : "+m"(*pde) : "ir"((uint32_t)PAGE_RW) : "memory", "cc");
+     }
+     paging_temp_unmap(pd_virt);
+     if (reused) {
+         paging_invalidate_page((void*)page_addr);
+         ev->cow_reuses = 1;
+     }
+     return reused;
+ }
+
  /**
   * Handles a page fault for a given VMA. Includes COW using reference counting.
+  * Runs with mm->lock held shared and never sleeps: when it needs something
+  * that might, it asks for it in @p prep and returns FAULT_RETRY. Sibling
+  * threads fault under the same shared lock, and the CPU sets accessed and
+  * dirty bits, so every PTE goes in with pte_cmpxchg() against the value
+  * read. Notes what it did in @p ev for the fault counters.
   */
-  int handle_vma_fault(mm_struct_t *mm, vma_struct_t *vma, uintptr_t fault_address, uint32_t error_code) {
+ static int vma_fault(mm_struct_t *mm, vma_struct_t *vma, uintptr_t fault_address, uint32_t error_code,
+                      fault_prep_t *prep, mm_fault_stats_t *ev) {
      uintptr_t page_addr = PAGE_ALIGN_DOWN(fault_address);
      int ret = -FS_ERR_INTERNAL; // Default to internal error
      uint32_t* pte_ptr = NULL;      // Pointer to PTE within temp map
@@ -418,153 +1020,311 @@
      bool is_write = (error_code & PAGE_FAULT_WRITE) != 0; // Assumes PAGE_FAULT_WRITE is defined (e.g., 0x2)
      bool present = (error_code & PAGE_FAULT_PRESENT) != 0; // Assumes PAGE_FAULT_PRESENT is defined (e.g., 0x1)
      uintptr_t phys_page = 0;       // For allocating new frames
-     void* temp_addr_for_copy = NULL; // For mapping frames for memcpy/memset
- 
-     // --- Permission Checks (Simplified, assumes VMA lookup already done) ---
+
+     // --- Permission Checks ---
      if (is_write && !(vma->vm_flags & VM_WRITE)) return -FS_ERR_PERMISSION_DENIED;
      if (!is_write && !(vma->vm_flags & VM_READ)) return -FS_ERR_PERMISSION_DENIED; // Read or Execute needs VM_READ
- 
- 
+     if ((error_code & PAGE_FAULT_IFETCH) && !(vma->vm_flags & VM_EXEC)) return -FS_ERR_PERMISSION_DENIED;
+
+
      // --- Handle Present Page Fault (Protection Violation -> COW) ---
      if (present) {
          // terminal_printf("[PF Handle] Present Fault: V=%p, Write=%d\n", (void*)fault_address, is_write);
          if (is_write && (vma->vm_flags & VM_WRITE) && !(vma->vm_flags & VM_SHARED)) {
              // --- COW Logic ---
-             pte_ptr = get_pte_ptr(mm, page_addr, false); // PT must exist if page is present
+             if (huge_write_reuse(mm, page_addr, ev)) return 0;
+             pte_ptr = get_pte_ptr(mm, page_addr, false, NULL); // PT must exist if page is present
              if (!pte_ptr) {
                  terminal_printf("[PF COW] Error: Failed get PTE for present page V=%p\n", (void*)page_addr);
                  return -FS_ERR_INTERNAL; // get_pte_ptr cleans up its maps
              }
              // Since get_pte_ptr returns a pointer inside a *dynamic* temporary map, remember its base
              pt_temp_map_addr = (void*)PAGE_ALIGN_DOWN((uintptr_t)pte_ptr);
- 
+
              uint32_t pte = *pte_ptr; // Read PTE value via temporary mapping
              if (!(pte & PAGE_PRESENT)) {
                  terminal_printf("[PF COW] Error: Page present but PTE not!? PTE=%#lx V=%p\n", (unsigned long)pte, (void*)page_addr);
                  ret = -FS_ERR_INTERNAL; goto cleanup_cow;
              }
              if (pte & PAGE_RW) {
-                 terminal_printf("[PF COW] Warning: Write fault on page already marked RW? PTE=%#lx V=%p\n", (unsigned long)pte, (void*)page_addr);
-                 ret = 0; goto cleanup_cow; // Already writable, maybe TLB issue? Return success.
+                 ret = 0; goto cleanup_cow; // A sibling thread's COW got here first
              }
- 
+
              // Page is Present but Read-Only, proceed with COW
              uintptr_t src_phys_page = pte & PAGING_ADDR_MASK;
              int ref_count = get_frame_refcount(src_phys_page);
              if (ref_count < 0) { terminal_printf("[PF COW] Error: Failed get refcount P=%#lx\n", (unsigned long)src_phys_page); ret = -FS_ERR_INTERNAL; goto cleanup_cow; }
- 
+
              if (ref_count == 1) { // Frame Not Shared
                  // terminal_printf("[PF COW] Frame P=%#lx not shared (ref=%d), making writable for V=%p\n", src_phys_page, ref_count, (void*)page_addr);
-                 *pte_ptr = (pte | PAGE_RW); // Set RW bit via temporary mapping
+                 // Set RW unless the PTE changed since it was read; then just fault again
+                 if (pte_cmpxchg(pte_ptr, pte, pte | PAGE_RW)) ev->cow_reuses = 1;
                  ret = 0; // Success
              } else { // Frame Shared: Perform Copy
                  // terminal_printf("[PF COW] Frame P=%#lx shared (ref=%d), copying for V=%p\n", src_phys_page, ref_count, (void*)page_addr);
-                 phys_page = frame_alloc(); // Allocate destination frame
-                 if (!phys_page) { ret = -FS_ERR_OUT_OF_MEMORY; goto cleanup_cow; }
- 
-                 // Map source and destination frames temporarily for copy
-                 void* temp_src = paging_temp_map(src_phys_page, PTE_KERNEL_READONLY_FLAGS);
-                 void* temp_dst = paging_temp_map(phys_page, PTE_KERNEL_DATA_FLAGS);
- 
-                 if (!temp_src || !temp_dst) {
-                     terminal_printf("[PF COW] Error: Failed to temp map frames for copy (src=%p, dst=%p)\n", temp_src, temp_dst);
-                     if (temp_src) paging_temp_unmap(temp_src);
-                     if (temp_dst) paging_temp_unmap(temp_dst);
-                     put_frame(phys_page); // Free the allocated frame
-                     ret = -FS_ERR_INTERNAL; goto cleanup_cow;
+                 phys_page = fault_take(prep, FAULT_PREP_FRAME); // Allocate destination frame
+                 if (!phys_page) phys_page = frame_alloc_mt(MIGRATE_MOVABLE);
+                 if (!phys_page) {
+                     // Reclaim may sleep: ask for the frame with the lock dropped
+                     if (fault_want(prep, FAULT_PREP_FRAME)) prep->zeroed = false;
+                     ret = FAULT_RETRY; goto cleanup_cow;
                  }
- 
-                 memcpy(temp_dst, temp_src, PAGE_SIZE); // Copy data
- 
-                 paging_temp_unmap(temp_dst); // Unmap temporary pages
-                 paging_temp_unmap(temp_src);
- 
-                 // Update the PTE to point to the new frame with RW permission
-                 *pte_ptr = (phys_page & PAGING_ADDR_MASK) | (pte & PAGING_FLAG_MASK) | PAGE_RW | PAGE_PRESENT;
-                 put_frame(src_phys_page); // Decrement ref count of original frame
+
+                 // Map source and destination frames for the copy (per-CPU slots, LIFO)
+                 void* temp_src = kmap_atomic(src_phys_page);
+                 void* temp_dst = kmap_atomic(phys_page);
+
+                 copy_page(temp_dst, temp_src); // Copy data
+
+                 kunmap_atomic(temp_dst); // Unmap in reverse order
+                 kunmap_atomic(temp_src);
+
+                 // Point the PTE at the new frame with RW permission, unless
+                 // it changed since it was read (a sibling thread's COW):
+                 // then the copy may be of a reused frame, so drop it.
+                 uint32_t new_pte = (phys_page & PAGING_ADDR_MASK) | (pte & PAGING_FLAG_MASK) | PAGE_RW | PAGE_PRESENT;
+                 if (!pte_cmpxchg(pte_ptr, pte, new_pte)) { ret = 0; goto cleanup_cow; }
+                 // Other CPUs running this mm may still translate to the old
+                 // frame: only once none can does it lose our reference.
+                 tlb_shootdown(mm->pgd_phys, page_addr, page_addr + PAGE_SIZE);
+                 put_frame(src_phys_page);
+                 ev->cow_copies = 1;
                  ret = 0; // Success
              }
          cleanup_cow:
              if (pt_temp_map_addr) { // Unmap the dynamically mapped PT
                  paging_temp_unmap(pt_temp_map_addr);
              }
-             if (ret == 0) { paging_invalidate_page((void*)page_addr); } // Invalidate TLB on success
+             if (phys_page && !ev->cow_copies) put_frame(phys_page); // Allocated, then not needed
+             // Reuse only adds RW: a stale read-only entry elsewhere just faults again
+             if (ret == 0 && !ev->cow_copies) { paging_invalidate_page((void*)page_addr); }
              return ret;
+         } else if (is_write && (vma->vm_flags & VM_WRITE)) {
+             // Shared writable (shm) page that fork() write-protected along
+             // with everything else: the frame is shared on purpose.
+             pte_ptr = get_pte_ptr(mm, page_addr, false, NULL);
+             if (!pte_ptr) return -FS_ERR_INTERNAL;
+             volatile uint32_t *pte = pte_ptr;
+             if (*pte & PAGE_PRESENT) asm volatile("lock orl %1, %0" : "+m"(*pte) : "ir"((uint32_t)PAGE_RW) : "memory", "cc");
+             paging_temp_unmap((void*)PAGE_ALIGN_DOWN((uintptr_t)pte_ptr));
+             paging_invalidate_page((void*)page_addr);
+             return 0;
          } else { // Present fault, but not a COW situation
               terminal_printf("[PF Handle] Error: Unexpected present fault. ErrCode=%#x VMAFlags=%#x Addr=%p\n",
                               (unsigned int)error_code, (unsigned int)vma->vm_flags, (void*)fault_address);
               return -FS_ERR_PERMISSION_DENIED;
          }
      } // End if(present)
- 
+
      // --- Handle Non-Present Page Fault (Allocate and Map) ---
      // terminal_printf("[PF Handle] NP Fault: V=%p\n", (void*)fault_address);
-     phys_page = frame_alloc(); // 1. Allocate frame
-     if (!phys_page) { return -FS_ERR_OUT_OF_MEMORY; }
-     // terminal_printf("   Allocated phys frame: %#lx\n", phys_page);
- 
-     // 2. Map frame temporarily into kernel to populate
-     temp_addr_for_copy = paging_temp_map(phys_page, PTE_KERNEL_DATA_FLAGS);
-     if (!temp_addr_for_copy) {
-         put_frame(phys_page); return -FS_ERR_IO;
+     if (swap_active()) {
+         int swapped = swap_fault(mm, vma, page_addr, prep, ev);
+         if (swapped != FAULT_FALLBACK) return swapped;
      }
- 
-     // 3. Populate frame
-     if (vma->vm_flags & VM_FILEBACKED) {
-         terminal_printf("   Populating from file (TODO) V=%p P=%#lx\n", (void*)page_addr, (unsigned long)phys_page);
-         // TODO: Implement file read logic here
-         // Need vma->vm_file, vma->vm_offset, page_addr - vma->vm_start
-         memset(temp_addr_for_copy, 0, PAGE_SIZE); // Placeholder
-     } else { // Anonymous VMA
-         // terminal_printf("   Zeroing anonymous page V=%p P=%#lx\n", (void*)page_addr, phys_page);
-         memset(temp_addr_for_copy, 0, PAGE_SIZE);
+     if (vma_huge_eligible(vma, page_addr)) {
+         int huge = huge_fault(mm, vma, page_addr, prep, ev);
+         if (huge != FAULT_FALLBACK) return huge;
      }
- 
-     // 4. Unmap temporary kernel mapping
-     paging_temp_unmap(temp_addr_for_copy);
-     temp_addr_for_copy = NULL; // Mark as unmapped
- 
-     // 5. Map frame into process space via PTE
-     pte_ptr = get_pte_ptr(mm, page_addr, true); // Allocate PT if needed
+     size_t page_in_vma = page_addr - vma->vm_start;
+     bool shm = vma->vm_file && shm_is_shm(vma->vm_file->vfs_file);
+     bool from_file = !shm && (vma->vm_flags & VM_FILEBACKED) && vma->vm_file && page_in_vma < vma->vm_file_bytes;
+     size_t read_len = 0;
+     off_t file_pos = 0;
+     if (from_file) {
+         read_len = vma->vm_file_bytes - page_in_vma;
+         if (read_len > PAGE_SIZE) read_len = PAGE_SIZE;
+         file_pos = (off_t)(vma->vm_offset + page_in_vma);
+     }
+
+     // 1. Shared-memory pages are the object's own frames. Read-only file
+     //    pages (text, rodata) come shared from the page cache. File pages
+     //    not cached are read by fault_prepare(), shared through the cache
+     //    or privately for a writable VMA. Otherwise take a zeroed frame
+     //    (usually pre-cleared by the idle task); past vm_file_bytes or
+     //    past EOF a file page stays zero too.
+     bool zeroed = false;
+     bool major = false;
+     if (shm) {
+         phys_page = shm_get_page(vma->vm_file->vfs_file, vma->vm_offset + page_in_vma);
+         if (!phys_page) { return -FS_ERR_OUT_OF_MEMORY; }
+     } else if (from_file) {
+         if (prep->file == vma->vm_file && prep->pos == file_pos && prep->len == read_len) {
+             phys_page = fault_take(prep, FAULT_PREP_FILE);
+             major = phys_page && prep->major;
+         }
+         if (!phys_page && !(vma->vm_flags & VM_WRITE)) {
+             phys_page = page_cache_lookup(vma->vm_file->vfs_file, file_pos, read_len);
+         }
+         if (!phys_page) {
+             if (fault_want(prep, FAULT_PREP_FILE)) {
+                 sys_file_get(vma->vm_file);
+                 prep->file = vma->vm_file;
+                 prep->pos = file_pos;
+                 prep->len = read_len;
+                 prep->cached = !(vma->vm_flags & VM_WRITE);
+             }
+             return FAULT_RETRY;
+         }
+     } else {
+         if (prep->zeroed) phys_page = fault_take(prep, FAULT_PREP_FRAME);
+         if (!phys_page) phys_page = frame_alloc_zeroed_mt(MIGRATE_MOVABLE);
+         if (!phys_page) {
+             if (fault_want(prep, FAULT_PREP_FRAME)) prep->zeroed = true;
+             return FAULT_RETRY;
+         }
+         zeroed = true;
+     }
+     // terminal_printf("   Allocated phys frame: %#lx\n", phys_page);
+
+     // 2. Map frame into process space via PTE
+     uintptr_t pt_phys = 0;
+     pte_ptr = get_pte_ptr(mm, page_addr, true, &pt_phys); // Allocate PT if needed
      if (!pte_ptr) {
          put_frame(phys_page); return -FS_ERR_IO; // Failed to get PTE access
      }
      pt_temp_map_addr = (void*)PAGE_ALIGN_DOWN((uintptr_t)pte_ptr); // Remember PT temp map addr
- 
-     // Determine final flags (Apply COW by mapping RO initially if needed)
-     uint32_t map_flags = vma->page_prot; // Start with VMA's base page permissions
-     if ((vma->vm_flags & VM_WRITE) && !(vma->vm_flags & VM_SHARED)) {
-         map_flags &= ~PAGE_RW; // Clear RW for Copy-on-Write
+
+     // Map with the VMA's own permissions. A fresh frame belongs to this
+     // mapping alone, so a writable private page needs no COW round trip;
+     // fork() write-protects it later. Page cache frames only back
+     // read-only VMAs, whose page_prot has no RW. A private mapping of
+     // shm maps the object's frame read-only and copies it on first write.
+     uint32_t map_flags = vma->page_prot;
+     if (shm && !(vma->vm_flags & VM_SHARED)) map_flags &= ~PAGE_RW;
+
+     // A sibling thread may have faulted the page in first (or it was
+     // swapped out again since the last pass): keep its page, drop ours.
+     uint32_t old_pte = *pte_ptr;
+     if ((old_pte & PAGE_PRESENT) || pte_is_swap(old_pte) ||
+         !pte_cmpxchg(pte_ptr, old_pte, (phys_page & PAGING_ADDR_MASK) | map_flags | PAGE_PRESENT)) {
+         paging_temp_unmap(pt_temp_map_addr);
+         put_frame(phys_page);
+         paging_invalidate_page((void*)page_addr);
+         return 0;
      }
- 
-     // Write the PTE using the pointer from get_pte_ptr
-     *pte_ptr = (phys_page & PAGING_ADDR_MASK) | map_flags | PAGE_PRESENT;
-     // terminal_printf("   Set PTE at %p = %#lx\n", pite_ptr, *pte_ptr);
- 
- 
-     // 6. Unmap the temporary PT mapping created by get_pte_ptr
+
+     // Map the neighbours while the page table is at hand
+     uint32_t around_zeroed = 0;
+     uint32_t mapped = 1 + fault_around(vma, page_addr, (uint32_t *)pt_temp_map_addr, &around_zeroed);
+     ev->major = major ? 1 : 0;
+     ev->zero_fills = (zeroed ? 1 : 0) + around_zeroed;
+     ev->fault_around = mapped - 1;
+     if (paging_pt_counted(mm->pgd_phys, PDE_INDEX(page_addr))) frame_pt_live_add(pt_phys, (int32_t)mapped);
+
+     // 3. Unmap the temporary PT mapping created by get_pte_ptr
      paging_temp_unmap(pt_temp_map_addr);
- 
-     // 7. Invalidate TLB for the specific user page
+
+     // 4. Invalidate TLB for the specific user page
      paging_invalidate_page((void*)page_addr);
- 
+
      // terminal_printf("   NP Fault handled successfully for V=%p -> P=%#lx\n", (void*)page_addr, phys_page);
      return 0; // Success
  }
  // --- END UPDATED handle_vma_fault ---
+
+ int handle_vma_fault(mm_struct_t *mm, uintptr_t fault_address, uint32_t error_code) {
+     mm_fault_stats_t ev = {0};
+     fault_prep_t prep;
+     memset(&prep, 0, sizeof(prep));
+     uint64_t start = read_tsc();
+     int ret;
+     for (;;) {
+         // Shared: sibling threads fault in parallel, while munmap, the
+         // swap clock and fork's copy (exclusive) can't change the VMA or
+         // a page table between the lookup and the PTE update.
+         uintptr_t irq_flags = rwlock_read_acquire_irqsave(&mm->lock);
+         vma_struct_t *vma = find_vma_locked(mm, fault_address);
+         ret = vma ? vma_fault(mm, vma, fault_address, error_code, &prep, &ev) : -FS_ERR_NOT_FOUND;
+         rwlock_read_release_irqrestore(&mm->lock, irq_flags);
+         if (ret != FAULT_RETRY) break;
+         // The disk and reclaim with the lock dropped; then the VMA is looked up again
+         ret = fault_prepare(mm, &prep);
+         if (ret != 0) break;
+     }
+     fault_prep_release(&prep);
+     ev.cycles = read_tsc() - start;
+     if (ret == 0 && !ev.major) ev.minor = 1;
+     fault_stats_account(mm, &ev);
+     return ret;
+ }
+
+ /**
+  * Reads the translation of user page @p page_addr without allocating:
+  * its PTE, or for a 4MB mapping a PTE-like value for the 4KB frame inside
+  * it. 0 if nothing is mapped there.
+  */
+ static uint32_t read_user_pte(mm_struct_t *mm, uintptr_t page_addr) {
+     uint32_t *pd_virt = paging_temp_map((uintptr_t)mm->pgd_phys, PTE_KERNEL_DATA_FLAGS);
+     if (!pd_virt) return 0;
+     uint32_t pde = pd_virt[PDE_INDEX(page_addr)];
+     paging_temp_unmap(pd_virt);
+
+     if (!(pde & PAGE_PRESENT)) return 0;
+     if (pde & PAGE_SIZE_4MB) {
+         uintptr_t phys = (pde & PAGING_PDE_ADDR_MASK_4MB) + (page_addr & (PAGE_SIZE_LARGE - 1));
+         return (uint32_t)phys | (pde & PAGING_FLAG_MASK & ~PAGE_SIZE_4MB);
+     }
+     uint32_t *pt_virt = paging_temp_map(pde & PAGING_ADDR_MASK, PTE_KERNEL_DATA_FLAGS);
+     if (!pt_virt) return 0;
+     uint32_t pte = pt_virt[PTE_INDEX(page_addr)];
+     paging_temp_unmap(pt_virt);
+     return pte;
+ }
+
+ uintptr_t mm_pin_user_page(mm_struct_t *mm, uintptr_t addr, bool write) {
+     return mm_pin_user_page_flags(mm, addr, write, NULL);
+ }
+
+ uintptr_t mm_pin_user_page_flags(mm_struct_t *mm, uintptr_t addr, bool write, uint32_t *vm_flags) {
+     if (!mm || !mm->pgd_phys || addr >= KERNEL_SPACE_VIRT_START) return 0;
+     uintptr_t page_addr = PAGE_ALIGN_DOWN(addr);
+     for (int attempt = 0; attempt < 2; attempt++) {
+         // The reference is taken under the lock, before munmap could drop the frame
+         uintptr_t phys = 0;
+         uintptr_t irq_flags = rwlock_read_acquire_irqsave(&mm->lock);
+         vma_struct_t *vma = find_vma_locked(mm, addr);
+         bool allowed = vma && (vma->vm_flags & (write ? VM_WRITE : VM_READ));
+         uint32_t pte = allowed ? read_user_pte(mm, page_addr) : 0;
+         if ((pte & PAGE_PRESENT) && (!write || (pte & PAGE_RW))) {
+             phys = pte & PAGING_ADDR_MASK;
+             get_frame(phys);
+             if (vm_flags) *vm_flags = vma->vm_flags;
+         }
+         rwlock_read_release_irqrestore(&mm->lock, irq_flags);
+         if (phys) return phys;
+         if (!allowed || attempt) break;
+         // Not there yet (demand paging) or still shared (COW): fault it in
+         uint32_t error_code = PAGE_FAULT_USER | (write ? PAGE_FAULT_WRITE : 0) |
+                               ((pte & PAGE_PRESENT) ? PAGE_FAULT_PRESENT : 0);
+         if (handle_vma_fault(mm, page_addr, error_code) != 0) return 0;
+     }
+     return 0;
+ }
+
+ uintptr_t mm_user_page_frame(mm_struct_t *mm, uintptr_t addr) {
+     if (!mm || !mm->pgd_phys || addr >= KERNEL_SPACE_VIRT_START) return 0;
+     uintptr_t irq_flags = rwlock_read_acquire_irqsave(&mm->lock);
+     uint32_t pte = read_user_pte(mm, PAGE_ALIGN_DOWN(addr));
+     rwlock_read_release_irqrestore(&mm->lock, irq_flags);
+     return (pte & PAGE_PRESENT) ? (pte & PAGING_ADDR_MASK) : 0;
+ }
  
  
  // --- VMA Range Removal ---
  
  /**
   * remove_vma_range_locked
+  * VMAs removed outright go on *@p dead for free_vma_list(): dropping the
+  * last file reference closes the file, which may sleep.
   */
- static int remove_vma_range_locked(mm_struct_t *mm, uintptr_t start, size_t length) {
+ static int remove_vma_range_locked(mm_struct_t *mm, uintptr_t start, size_t length, vma_struct_t **dead) {
      uintptr_t end = start + length;
      if (start >= end) return -FS_ERR_INVALID_PARAM;
  
      // terminal_printf("[MM] remove_vma_range_locked: Request [0x%x - 0x%x)\n", start, end);
      int result = 0;
+     vmacache_invalidate(mm); // VMAs below may be freed or shrunk
      struct rb_node *node = NULL;
      struct rb_node *next_node = NULL;
      node = rb_tree_first(&mm->vma_tree);
@@ -603,6 +1363,7 @@
                  created_second_part = alloc_vma_struct();
                  if (!created_second_part) return -FS_ERR_OUT_OF_MEMORY;
                  memcpy(created_second_part, vma, sizeof(vma_struct_t)); // Copy original VMA data
+                 if (created_second_part->vm_file) sys_file_get(created_second_part->vm_file);
                  created_second_part->vm_start = end; // Set new start for second part
                  // Adjust file offset if file-backed
                  if (created_second_part->vm_flags & VM_FILEBACKED) {
@@ -613,13 +1374,16 @@
                            free_vma_resources(created_second_part); return -FS_ERR_INVALID_PARAM;
                       }
                       created_second_part->vm_offset += diff;
+                      created_second_part->vm_file_bytes = (created_second_part->vm_file_bytes > diff) ? created_second_part->vm_file_bytes - diff : 0;
                  }
                  // Shrink the original VMA
                  vma->vm_end = start;
+                 rb_tree_augment_propagate(&mm->vma_tree, node);
                  // terminal_printf("     Original shrunk to [0x%x-0x%x), New VMA [0x%x-0x%x)\n", vma->vm_start, vma->vm_end, created_second_part->vm_start, created_second_part->vm_end);
              } else if (vma->vm_start < start) { // Case 3: Overlap at end - Shrink original
                  // terminal_write("     Shrinking VMA end.\n");
                  vma->vm_end = start;
+                 rb_tree_augment_propagate(&mm->vma_tree, node);
              } else { // Case 4: Overlap at beginning - Shrink original
                  // terminal_write("     Shrinking VMA start.\n");
                  // Adjust file offset before changing vm_start
@@ -629,30 +1393,21 @@
                           terminal_printf("Warning: VMA shrink offset overflow!\n"); return -FS_ERR_INVALID_PARAM;
                       }
                       vma->vm_offset += diff;
+                      vma->vm_file_bytes = (vma->vm_file_bytes > diff) ? vma->vm_file_bytes - diff : 0;
                  }
+                 // vm_start is the tree key: take the node out and put it back.
+                 // Nothing else overlaps [end, vm_end), so the re-insert cannot fail.
+                 rb_tree_remove(&mm->vma_tree, node);
+                 mm->map_count--;
                  vma->vm_start = end;
-                 // Modifying vm_start invalidates RB-tree ordering. Must remove and re-insert.
-                 // This case is more complex. For simplicity, let's disallow partial removal from start
-                 // or implement remove/re-insert logic carefully.
-                 // *** For now: Simplification - Let's just remove fully contained and shrink-end cases ***
-                 // *** And splitting. Removing from start needs more work. ***
-                 terminal_write("    Warning: Removing VMA overlapping at start is complex due to RB tree key. Only handling full contain/end overlap/split.\n");
-                 // Let's convert this case to full removal if start matches vma->vm_start
-                  if (vma->vm_start == start) {
-                      remove_original = true;
-                      terminal_write("    Treating start overlap as full removal for simplicity.\n");
-                  } else {
-                      // If not starting exactly at VMA start, we cannot easily shrink start.
-                      // Return error or handle more complex RB tree update.
-                      terminal_printf("Error: Cannot currently handle removing VMA partial overlap at the beginning.\n");
-                      return -FS_ERR_NOT_SUPPORTED;
-                  }
+                 insert_vma_locked(mm, vma);
              }
  
              if (remove_original) {
                  rb_tree_remove(&mm->vma_tree, node);
                  mm->map_count--;
-                 free_vma_resources(vma); // Free the VMA struct
+                 vma->vm_next_dead = *dead;
+                 *dead = vma;
              }
              if (created_second_part) {
                   // Need to insert the split part back into the tree
@@ -681,8 +1436,147 @@
   */
  int remove_vma_range(mm_struct_t *mm, uintptr_t start, size_t length) {
      if (!mm || length == 0) return -FS_ERR_INVALID_PARAM;
-     uintptr_t irq_flags = spinlock_acquire_irqsave(&mm->lock);
-     int result = remove_vma_range_locked(mm, start, length);
-     spinlock_release_irqrestore(&mm->lock, irq_flags);
+     vma_struct_t *dead = NULL;
+     uintptr_t irq_flags = rwlock_write_acquire_irqsave(&mm->lock);
+     int result = remove_vma_range_locked(mm, start, length, &dead);
+     rwlock_write_release_irqrestore(&mm->lock, irq_flags);
+     free_vma_list(dead);
      return result;
- }
\ No newline at end of file
+ }
+ 
+ // --- mmap ---
+ 
+ /**
+  * First free range of @p length bytes in [MMAP_BASE_VIRT, USER_STACK_BOTTOM_VIRT).
+  * Assumes lock held. Returns 0 if there is none. O(log n) via the subtree gaps.
+  */
+ static uintptr_t find_unmapped_area_locked(mm_struct_t *mm, size_t length) {
+     return rbtree_find_gap(mm->vma_tree.root, MMAP_BASE_VIRT, USER_STACK_BOTTOM_VIRT, length);
+ }
+ 
+ uintptr_t do_mmap(mm_struct_t *mm, uintptr_t addr, size_t length, uint32_t prot,
+                   uint32_t flags, struct sys_file *file, size_t offset) {
+     if (!mm || length == 0 || length > KERNEL_SPACE_VIRT_START) return (uintptr_t)-EINVAL;
+     length = PAGE_ALIGN_UP(length);
+ 
+     uint32_t map_type = flags & (MAP_SHARED | MAP_PRIVATE);
+     if (map_type != MAP_SHARED && map_type != MAP_PRIVATE) return (uintptr_t)-EINVAL;
+ 
+     bool anonymous = (flags & MAP_ANONYMOUS) != 0;
+     bool shm = !anonymous && file && shm_is_shm(file->vfs_file);
+     // Only shm frames are shared on purpose; file pages never reach the file.
+     if (map_type == MAP_SHARED && (prot & PROT_WRITE) && !shm) return (uintptr_t)-EINVAL;
+     if (anonymous) {
+         file = NULL;
+         offset = 0;
+     } else {
+         if (!file) return (uintptr_t)-EBADF;
+         if (offset % PAGE_SIZE) return (uintptr_t)-EINVAL;
+         uint32_t accmode = file->vfs_file->flags & O_ACCMODE;
+         if (accmode == O_WRONLY) return (uintptr_t)-EACCES;
+         if (shm) {
+             if (map_type == MAP_SHARED && (prot & PROT_WRITE) && accmode != O_RDWR) return (uintptr_t)-EACCES;
+             size_t size = shm_size(file->vfs_file);
+             if (offset > size || length > size - offset) return (uintptr_t)-EINVAL;
+         }
+     }
+ 
+     uint32_t vm_flags = VM_USER | (anonymous ? VM_ANONYMOUS : VM_FILEBACKED);
+     if (prot & PROT_READ)  vm_flags |= VM_READ;
+     if (prot & PROT_WRITE) vm_flags |= VM_WRITE;
+     if (prot & PROT_EXEC)  vm_flags |= VM_EXEC | VM_READ; // x86 pages cannot be execute-only
+     if (map_type == MAP_SHARED) vm_flags |= VM_SHARED;
+     uint32_t page_prot = PAGE_PRESENT | PAGE_USER;
+     if (prot & PROT_WRITE) page_prot |= PAGE_RW;
+     if (!(prot & PROT_EXEC) && g_nx_supported) page_prot |= PAGE_NX_BIT;
+ 
+     vma_struct_t *vma = alloc_vma_struct();
+     if (!vma) return (uintptr_t)-ENOMEM;
+ 
+     vma_struct_t *dead = NULL; // What a MAP_FIXED mapping replaces
+     uintptr_t irq_flags = rwlock_write_acquire_irqsave(&mm->lock);
+     uintptr_t start;
+     if (flags & MAP_FIXED) {
+         start = addr;
+         if ((start % PAGE_SIZE) || start == 0 || start > KERNEL_SPACE_VIRT_START - length) {
+             rwlock_write_release_irqrestore(&mm->lock, irq_flags);
+             free_vma_struct(vma);
+             return (uintptr_t)-EINVAL;
+         }
+         if (remove_vma_range_locked(mm, start, length, &dead) != 0) {
+             rwlock_write_release_irqrestore(&mm->lock, irq_flags);
+             free_vma_list(dead);
+             free_vma_struct(vma);
+             return (uintptr_t)-ENOMEM;
+         }
+     } else {
+         start = find_unmapped_area_locked(mm, length);
+         if (!start) {
+             rwlock_write_release_irqrestore(&mm->lock, irq_flags);
+             free_vma_struct(vma);
+             return (uintptr_t)-ENOMEM;
+         }
+     }
+ 
+     vma->vm_start = start;
+     vma->vm_end = start + length;
+     vma->vm_flags = vm_flags;
+     vma->page_prot = page_prot;
+     vma->vm_file = file;
+     if (file) sys_file_get(file);
+     vma->vm_offset = offset;
+     vma->vm_file_bytes = length;
+     vma->vm_fault_around = FAULT_AROUND_PAGES;
+     vma_struct_t *result = insert_vma_locked(mm, vma);
+     rwlock_write_release_irqrestore(&mm->lock, irq_flags);
+     free_vma_list(dead);
+ 
+     if (!result) { // Cannot overlap after the search/removal above, but stay safe
+         free_vma_resources(vma);
+         return (uintptr_t)-ENOMEM;
+     }
+     return start;
+ }
+ 
+ // --- brk ---
+ 
+ /**
+  * The VM_HEAP VMA that ends at @p end (the page-aligned current break).
+  * Assumes lock held. Returns NULL if munmap() took it apart.
+  */
+ static vma_struct_t *find_heap_vma_locked(mm_struct_t *mm, uintptr_t end) {
+     for (struct rb_node *node = rb_tree_first(&mm->vma_tree); node; node = rb_node_next(node)) {
+         vma_struct_t *vma = rb_entry(node, vma_struct_t, rb_node);
+         if ((vma->vm_flags & VM_HEAP) && vma->vm_end == end) return vma;
+     }
+     return NULL;
+ }
+ 
+ uintptr_t do_brk(mm_struct_t *mm, uintptr_t brk) {
+     uintptr_t irq_flags = rwlock_write_acquire_irqsave(&mm->lock);
+     uintptr_t cur = mm->end_brk;
+     if (brk < mm->start_brk || brk > USER_STACK_BOTTOM_VIRT) goto out;
+ 
+     uintptr_t old_end = PAGE_ALIGN_UP(cur);
+     uintptr_t new_end = PAGE_ALIGN_UP(brk);
+     vma_struct_t *heap = find_heap_vma_locked(mm, old_end);
+     if (!heap) goto out;
+ 
+     if (new_end > old_end) {
+         // Grow in place: vm_start is the tree key and stays put. Pages fault in on first touch.
+         if (rbtree_find_overlap(mm->vma_tree.root, old_end, new_end)) goto out;
+         heap->vm_end = new_end;
+     } else if (new_end < old_end) {
+         if (paging_unmap_range(mm->pgd_phys, new_end, old_end - new_end) != 0) goto out;
+         heap->vm_end = new_end; // May become empty; the VMA stays as the heap's anchor
+     }
+     if (new_end != old_end) {
+         rb_tree_augment_propagate(&mm->vma_tree, &heap->rb_node);
+         vmacache_invalidate(mm);
+     }
+     mm->end_brk = cur = brk;
+ 
+ out:
+     rwlock_write_release_irqrestore(&mm->lock, irq_flags);
+     return cur;
+ }
@@ -0,0 +1,335 @@
+/**
+ * @file page_cache.c
+ * @brief File pages keyed by file identity, shared by read() and mappings.
+ */
+
+#include <kernel/memory/page_cache.h>
+#include <kernel/memory/frame.h>
+#include <kernel/memory/paging.h>
+#include <kernel/memory/kmalloc.h>
+#include <kernel/lib/string.h>
+#include <kernel/memory/shrinker.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/fs/vfs/fs_errno.h>
+
+#define PC_FILE_BUCKETS 32   // Per-file page hash buckets (power of two)
+
+typedef struct pc_page {
+    struct pc_page *next;
+    off_t           offset;  // Page-aligned file offset
+    uintptr_t       phys;    // The file's bytes up to a page or EOF; the rest is zero
+} pc_page_t;
+
+typedef struct pc_file {
+    struct pc_file *next;
+    vfs_file_id_t   id;
+    uint32_t        nr_pages;
+    pc_page_t      *buckets[PC_FILE_BUCKETS];
+} pc_file_t;
+
+static spinlock_t s_pc_lock; // Zero-initialized == unlocked
+static pc_file_t *s_files = NULL;
+static uint32_t   s_nr_pages = 0;
+
+//============================================================================
+// Helpers (s_pc_lock held)
+//============================================================================
+static inline uint32_t pc_bucket(off_t offset) {
+    return ((uint32_t)offset / PAGE_SIZE) & (PC_FILE_BUCKETS - 1);
+}
+
+static pc_file_t *pc_find_file(const vfs_file_id_t *id) {
+    for (pc_file_t *f = s_files; f; f = f->next) {
+        if (f->id.fs == id->fs && f->id.ino == id->ino && f->id.size == id->size) return f;
+    }
+    return NULL;
+}
+
+static pc_page_t *pc_find_page(pc_file_t *f, off_t offset) {
+    for (pc_page_t *p = f->buckets[pc_bucket(offset)]; p; p = p->next) {
+        if (p->offset == offset) return p;
+    }
+    return NULL;
+}
+
+/** @brief File bytes in the page at @p offset (< id->size): a page, fewer at EOF. */
+static inline size_t pc_page_bytes(const vfs_file_id_t *id, off_t offset) {
+    uint32_t left = id->size - (uint32_t)offset;
+    return left < PAGE_SIZE ? left : PAGE_SIZE;
+}
+
+/**
+ * @brief Unlinks one page that no process maps (refcount 1) onto @p *freed.
+ * @return true if a page was reclaimed.
+ */
+static bool pc_evict_one(pc_page_t **freed) {
+    for (pc_file_t *f = s_files; f; f = f->next) {
+        for (uint32_t b = 0; b < PC_FILE_BUCKETS; b++) {
+            for (pc_page_t **pp = &f->buckets[b]; *pp; pp = &(*pp)->next) {
+                pc_page_t *p = *pp;
+                if (get_frame_refcount(p->phys) != 1) continue;
+                *pp = p->next;
+                p->next = *freed;
+                *freed = p;
+                f->nr_pages--;
+                s_nr_pages--;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/** @brief Moves all pages of @p f onto @p *freed, leaving it empty. */
+static void pc_drain_file(pc_file_t *f, pc_page_t **freed) {
+    for (uint32_t b = 0; b < PC_FILE_BUCKETS; b++) {
+        while (f->buckets[b]) {
+            pc_page_t *p = f->buckets[b];
+            f->buckets[b] = p->next;
+            p->next = *freed;
+            *freed = p;
+        }
+    }
+    s_nr_pages -= f->nr_pages;
+    f->nr_pages = 0;
+}
+
+/** @brief Drops the cache's frame references; called without s_pc_lock. */
+static void pc_release_pages(pc_page_t *list) {
+    while (list) {
+        pc_page_t *next = list->next;
+        put_frame(list->phys);
+        kfree(list);
+        list = next;
+    }
+}
+
+/** @brief Drops the pages of one file (@p match_ino) or of a whole mount. */
+static void pc_invalidate(const void *fs, uint32_t ino, bool match_ino) {
+    pc_page_t *freed = NULL;
+    pc_file_t *dead = NULL;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_pc_lock);
+    for (pc_file_t **fp = &s_files; *fp; ) {
+        pc_file_t *f = *fp;
+        if (f->id.fs == fs && (!match_ino || f->id.ino == ino)) {
+            pc_drain_file(f, &freed);
+            *fp = f->next;
+            f->next = dead;
+            dead = f;
+        } else {
+            fp = &f->next;
+        }
+    }
+    spinlock_release_irqrestore(&s_pc_lock, irq_flags);
+
+    pc_release_pages(freed);
+    while (dead) {
+        pc_file_t *next = dead->next;
+        kfree(dead);
+        dead = next;
+    }
+}
+
+//============================================================================
+// Page Lookup and Fill
+//============================================================================
+/** @brief Cached frame for @p id with a new reference, or 0 on a miss. */
+static uintptr_t pc_lookup(const vfs_file_id_t *id, off_t offset) {
+    uintptr_t phys = 0;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_pc_lock);
+    pc_file_t *f = pc_find_file(id);
+    pc_page_t *hit = f ? pc_find_page(f, offset) : NULL;
+    if (hit) {
+        phys = hit->phys;
+        get_frame(phys); // Reference for the caller
+    }
+    spinlock_release_irqrestore(&s_pc_lock, irq_flags);
+    return phys;
+}
+
+/**
+ * @brief The page of @p file at page-aligned @p offset (< id->size), read on
+ * a miss, with a reference for the caller. When the cache is full of mapped
+ * pages the frame comes back uncached; the caller can't tell and needn't.
+ * @param file_locked The caller holds file->lock (read() paths).
+ */
+static uintptr_t pc_get_page(file_t *file, const vfs_file_id_t *id, off_t offset, bool file_locked) {
+    uintptr_t phys = pc_lookup(id, offset);
+    if (phys) return phys;
+
+    // Miss: read the page without s_pc_lock held, then publish it. The read
+    // sleeps in the driver, so not through a kmap_atomic() slot.
+    phys = frame_alloc_zeroed_mt(MIGRATE_RECLAIMABLE);
+    if (!phys) return 0;
+    void *dst = paging_temp_map(phys, PTE_KERNEL_DATA_FLAGS);
+    if (!dst) {
+        put_frame(phys);
+        return 0;
+    }
+    if (!file_locked) kmutex_lock(&file->lock);
+    int nread = vfs_pread_uncached(file, dst, pc_page_bytes(id, offset), offset);
+    if (!file_locked) kmutex_unlock(&file->lock);
+    paging_temp_unmap(dst);
+    if (nread < 0) {
+        put_frame(phys);
+        return 0;
+    }
+
+    pc_page_t *page = (pc_page_t *)kmalloc(sizeof(pc_page_t));
+    pc_file_t *new_file = (pc_file_t *)kmalloc(sizeof(pc_file_t));
+    if (!page) {
+        if (new_file) kfree(new_file);
+        return phys; // Uncached private page
+    }
+    page->offset = offset;
+    page->phys = phys;
+
+    pc_page_t *freed = NULL;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_pc_lock);
+    pc_file_t *f = pc_find_file(id);
+    pc_page_t *hit = f ? pc_find_page(f, offset) : NULL;
+    if (hit) { // Another CPU filled it first
+        uintptr_t shared = hit->phys;
+        get_frame(shared);
+        spinlock_release_irqrestore(&s_pc_lock, irq_flags);
+        put_frame(phys);
+        kfree(page);
+        if (new_file) kfree(new_file);
+        return shared;
+    }
+    if ((s_nr_pages >= PAGE_CACHE_MAX_PAGES && !pc_evict_one(&freed)) || (!f && !new_file)) {
+        spinlock_release_irqrestore(&s_pc_lock, irq_flags);
+        pc_release_pages(freed);
+        kfree(page);
+        if (new_file) kfree(new_file);
+        return phys;
+    }
+    if (!f) {
+        f = new_file;
+        new_file = NULL;
+        memset(f, 0, sizeof(*f));
+        f->id = *id;
+        f->next = s_files;
+        s_files = f;
+    }
+    uint32_t b = pc_bucket(offset);
+    page->next = f->buckets[b];
+    f->buckets[b] = page;
+    f->nr_pages++;
+    s_nr_pages++;
+    get_frame(phys); // The cache keeps the allocation's reference, the caller gets this one
+    spinlock_release_irqrestore(&s_pc_lock, irq_flags);
+
+    pc_release_pages(freed);
+    if (new_file) kfree(new_file);
+    return phys;
+}
+
+/**
+ * @brief Trades the reference on cached frame @p shared for a private frame
+ * holding only its first @p len bytes (a mapping that ends mid-page).
+ */
+static uintptr_t pc_private_copy(uintptr_t shared, size_t len) {
+    uintptr_t phys = frame_alloc_zeroed_mt(MIGRATE_MOVABLE); // Mapped privately by a process
+    if (phys) {
+        void *dst = kmap_atomic(phys);
+        void *src = kmap_atomic(shared);
+        memcpy(dst, src, len);
+        kunmap_atomic(src);
+        kunmap_atomic(dst);
+    }
+    put_frame(shared);
+    return phys;
+}
+
+//============================================================================
+// Public API
+//============================================================================
+uintptr_t page_cache_lookup(file_t *file, off_t offset, size_t len) {
+    vfs_file_id_t id;
+    if (vfs_identify(file, &id) != 0 || offset < 0 || (uint32_t)offset >= id.size) return 0;
+    uintptr_t phys = pc_lookup(&id, offset);
+    if (phys && len != pc_page_bytes(&id, offset)) {
+        put_frame(phys); // Needs a private copy: leave it to the page's own fault
+        return 0;
+    }
+    return phys;
+}
+
+uintptr_t page_cache_get_page(file_t *file, off_t offset, size_t len) {
+    vfs_file_id_t id;
+    if (vfs_identify(file, &id) != 0 || offset < 0 || (uint32_t)offset >= id.size) return 0;
+
+    uintptr_t phys = pc_get_page(file, &id, offset, false);
+    size_t bytes = pc_page_bytes(&id, offset);
+    if (!phys || len == bytes) return phys;
+    return pc_private_copy(phys, len < bytes ? len : bytes);
+}
+
+int page_cache_read(file_t *file, void *buf, size_t len, off_t offset) {
+    vfs_file_id_t id;
+    if (offset < 0) return -FS_ERR_INVALID_PARAM;
+    if (vfs_identify(file, &id) != 0) return -FS_ERR_NOT_SUPPORTED;
+    if ((uint32_t)offset >= id.size) return 0;
+    if (len > id.size - (uint32_t)offset) len = id.size - (uint32_t)offset;
+
+    size_t done = 0;
+    while (done < len) {
+        off_t pos = offset + (off_t)done;
+        off_t page_off = pos & ~(off_t)(PAGE_SIZE - 1);
+        size_t in_page = (size_t)(pos - page_off);
+        size_t chunk = PAGE_SIZE - in_page;
+        if (chunk > len - done) chunk = len - done;
+
+        uintptr_t phys = pc_get_page(file, &id, page_off, true);
+        if (!phys) return done ? (int)done : -FS_ERR_NOT_SUPPORTED; // Caller reads it directly
+        const uint8_t *src = (const uint8_t *)kmap_atomic(phys);
+        memcpy((uint8_t *)buf + done, src + in_page, chunk);
+        kunmap_atomic((void *)src);
+        put_frame(phys);
+        done += chunk;
+    }
+    return (int)done;
+}
+
+void page_cache_invalidate_file(const vfs_file_id_t *id) {
+    pc_invalidate(id->fs, id->ino, true); // Any size: the file changed
+}
+
+void page_cache_invalidate_fs(const void *fs) {
+    pc_invalidate(fs, 0, false);
+}
+
+//============================================================================
+// Reclaim
+//============================================================================
+static size_t pc_shrink_count(void) {
+    return (size_t)s_nr_pages * PAGE_SIZE; // Upper bound: mapped pages are skipped
+}
+
+/** @brief Evicts unmapped pages until @p target bytes are freed. */
+static size_t pc_shrink_scan(size_t target, bool may_block) {
+    pc_page_t *freed = NULL;
+    size_t bytes = 0;
+    uintptr_t irq_flags;
+    if (may_block) {
+        irq_flags = spinlock_acquire_irqsave(&s_pc_lock);
+    } else if (!spinlock_try_acquire_irqsave(&s_pc_lock, &irq_flags)) {
+        return 0;
+    }
+    while (bytes < target && pc_evict_one(&freed)) bytes += PAGE_SIZE + sizeof(pc_page_t);
+    spinlock_release_irqrestore(&s_pc_lock, irq_flags);
+
+    pc_release_pages(freed);
+    return bytes;
+}
+
+static shrinker_t s_pc_shrinker = {
+    .name  = "page_cache",
+    .count = pc_shrink_count,
+    .scan  = pc_shrink_scan,
+};
+
+void page_cache_init(void) {
+    shrinker_register(&s_pc_shrinker);
+}
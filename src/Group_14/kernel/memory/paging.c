@@ -11,16 +11,27 @@
  #include <kernel/memory/mm.h>                 // For VMA handling during page faults
  #include <kernel/process/scheduler.h>          // For terminating process on critical fault
  #include <kernel/lib/string.h>             // Kernel's memset, memcpy
+ #include <kernel/lib/bitmap.h>             // Temp VA slot bitmap
  #include <kernel/cpu/cpuid.h>              // CPUID instruction wrapper
  #include <kernel/memory/kmalloc_internal.h>   // For ALIGN_UP/DOWN macros
  #include <kernel/arch/multiboot2.h>
  #include <kernel/cpu/msr.h>                // For MSR read/write (EFER)
  #include <kernel/lib/assert.h>             // For KERNEL_ASSERT
+ #include <kernel/sync/spinlock.h>          // MMIO window allocator lock
+ #include <kernel/sync/preempt.h>           // cond_resched() in paging_clone_directory
+ #include <kernel/sync/rwlock.h>            // The source mm lock paging_clone_directory() takes
+ #include <kernel/memory/tlb.h>             // TLB shootdown for unmaps and temp mappings
+ #include <kernel/memory/swap.h>            // Swap entries left in non-present user PTEs
+ #include <kernel/cpu/get_cpu_id.h>         // MAX_CPUS, per-CPU kmap slots
+ #include <kernel/fs/vfs/fs_errno.h>        // handle_vma_fault() error codes
+#include <kernel/process/kstack.h>         // kstack_is_guard for kernel faults
 #include <kernel/drivers/display/serial.h>             // Serial port logging
+#include <kernel/core/tracepoint.h>
 
  // --- Constants and Macros ---
  #ifndef PAGING_PANIC
  #define PAGING_PANIC(msg) do { \
+         serial_flush_sync(); \
          serial_printf("\n[PAGING PANIC] %s at %s:%d. System Halted.\n", msg, __FILE__, __LINE__); \
          while (1) { asm volatile("cli; hlt"); } \
  } while(0)
@@ -53,11 +64,22 @@
  #endif
  // --- END DEBUG MACRO DEFINITION ---
 
+ // Set to 1 to print every page fault, handled or not, with the CPU state.
+ // Off, only faults that kill a process or the kernel are reported; the rest
+ // are counted in the fault stats (mm_get_fault_stats, /proc/faults).
+ #ifndef PAGING_PF_VERBOSE
+ #define PAGING_PF_VERBOSE 0
+ #endif
+ #define PF_VERBOSE_PRINTF(fmt, ...) \
+     do { if (PAGING_PF_VERBOSE) terminal_printf(fmt, ##__VA_ARGS__); } while (0)
+
  // --- Globals ---
  uint32_t* g_kernel_page_directory_virt = NULL;
  uint32_t  g_kernel_page_directory_phys = 0;
  bool      g_pse_supported              = false;
  bool      g_nx_supported               = false;
+ bool      g_pge_supported              = false;
+ uintptr_t g_direct_map_phys_end        = 0;
 
  // --- Linker Symbols ---
  extern uint8_t _kernel_start_phys;
@@ -95,13 +117,14 @@
  static inline uint32_t read_cr4(void);
  static inline void write_cr4(uint32_t value);
  static bool       check_and_enable_nx(void);
+ static bool       check_and_enable_pge(void);
  static uintptr_t  paging_alloc_frame(bool use_early_allocator);
  static uint32_t* allocate_page_table_phys(bool use_early_allocator);
  static struct multiboot_tag *find_multiboot_tag_early(uint32_t mb_info_phys_addr, uint16_t type);
  static int        kernel_map_virtual_to_physical_unsafe(uintptr_t vaddr, uintptr_t paddr, uint32_t flags);
  static int        paging_map_physical_early(uintptr_t page_directory_phys, uintptr_t phys_addr_start, size_t size, uint32_t flags, bool map_to_higher_half);
+ static int        paging_map_direct_early(uintptr_t page_directory_phys, uintptr_t phys_end);
  static void       debug_print_pd_entries(uint32_t* pd_ptr, uintptr_t vaddr_start, size_t count); // Changed first arg type
- static bool is_page_table_empty(uint32_t *pt_virt);
 
 
  // --- Low-Level CPU Control ---
@@ -148,8 +171,8 @@
      // If PDE not present, we need to create a new page table
      if (!(pde & PAGE_PRESENT)) {
          PAGING_DEBUG_PRINTF("PDE not present. Allocating new PT...\n");
-         // Allocate a new page table using frame allocator (NOT early allocator here, assumes buddy is up)
-         uintptr_t new_pt_phys = frame_alloc();
+         // Allocate a new, already zeroed page table (NOT early allocator here, assumes buddy is up)
+         uintptr_t new_pt_phys = frame_alloc_zeroed();
          if (new_pt_phys == 0) {
              terminal_printf("[KMapUnsafe] Error: Failed to allocate PT for VAddr %p\n", (void*)vaddr);
              return -1;
@@ -168,12 +191,8 @@
          g_kernel_page_directory_virt[pd_idx] = new_pde_val;
          paging_invalidate_page((void*)vaddr); // Invalidate old mapping potentially covering this vaddr range
 
-         // Now we need to clear the new PT - use recursive mapping to access it
+         // The new PT is reachable through the recursive mapping
          uint32_t* new_pt_virt = (uint32_t*)(RECURSIVE_PDE_VADDR + (pd_idx * PAGE_SIZE));
-         PAGING_DEBUG_PRINTF("Clearing new PT via recursive mapping at %p...\n", new_pt_virt);
-
-         // Clear the PT
-         memset(new_pt_virt, 0, PAGE_SIZE);
 
          // Now set the specific PTE entry
          uint32_t new_pte_val = (paddr & PAGING_ADDR_MASK) | (flags & PAGING_FLAG_MASK) | PAGE_PRESENT;
@@ -291,6 +310,11 @@
       mb_info_size = (mb_info_size >= 8) ? mb_info_size : 8; // Minimum size
       uintptr_t mb_info_start = g_multiboot_info_phys_addr_global;
       uintptr_t mb_info_end = PAGE_ALIGN_UP(mb_info_start + mb_info_size);
+      // And the boot module (initramfs), which stays in place for the VFS
+      struct multiboot_tag_module *module_tag = (struct multiboot_tag_module *)
+          find_multiboot_tag_early(g_multiboot_info_phys_addr_global, MULTIBOOT_TAG_TYPE_MODULE);
+      uintptr_t module_start = module_tag ? PAGE_ALIGN_DOWN(module_tag->mod_start) : 0;
+      uintptr_t module_end   = module_tag ? PAGE_ALIGN_UP(module_tag->mod_end) : 0;
 
 
       multiboot_memory_map_t *mmap_entry = mmap_tag->entries;
@@ -345,6 +369,11 @@
                        continue;
                    }
 
+                  if (current_frame_addr < module_end && (current_frame_addr + PAGE_SIZE) > module_start) {
+                      current_frame_addr = module_end;
+                      continue;
+                  }
+
 
                   // Check if already allocated by this early allocator
                   bool already_allocated = false;
@@ -368,7 +397,7 @@
                   early_allocated_frames[early_allocated_count++] = current_frame_addr;
 
                   // Zero the frame before returning - critical for page tables!
-                  memset((void*)current_frame_addr, 0, PAGE_SIZE);
+                  clear_page((void*)current_frame_addr);
 
                   return current_frame_addr;
               }
@@ -445,6 +474,29 @@
       }
  }
 
+ /**
+  * @brief Enables global pages. Kernel-half mappings are shared by every page
+  * directory (copy_kernel_pde_entries), so marking them PAGE_GLOBAL keeps their
+  * TLB entries across the CR3 reload in each context switch. User mappings
+  * are never global; kernel ranges are flushed by tlb_shootdown(), which
+  * handles global entries.
+  */
+ static bool check_and_enable_pge(void) {
+      uint32_t eax, ebx, ecx, edx;
+      cpuid(1, &eax, &ebx, &ecx, &edx);
+
+      if (!(edx & CPUID_FEAT_EDX_PGE)) {
+          terminal_write("[Paging] CPU does not support PGE (Global Pages).\n");
+          g_pge_supported = false;
+          return false;
+      }
+      write_cr4(read_cr4() | CR4_PGE);
+      g_pge_supported = (read_cr4() & CR4_PGE) != 0;
+      terminal_write(g_pge_supported ? "[Paging] CR4.PGE bit enabled.\n"
+                                     : "[Paging Error] Failed to enable CR4.PGE bit!\n");
+      return g_pge_supported;
+ }
+
  static bool check_and_enable_nx(void) {
       uint32_t eax, ebx, ecx, edx;
       cpuid(0x80000000, &eax, &ebx, &ecx, &edx); // Get highest extended function supported
@@ -495,6 +547,7 @@
           PAGING_PANIC("PSE support is required but not available/enabled!");
       }
       check_and_enable_nx();
+      check_and_enable_pge();
 
       *out_initial_pd_phys = pd_phys;
       terminal_write("[Paging Stage 1] Directory allocated, features checked/enabled.\n");
@@ -613,6 +666,9 @@
 
           uint32_t pte = pt_phys_ptr[pt_idx];
           uint32_t pte_final_flags = (flags & (PAGE_RW | PAGE_USER | PAGE_PWT | PAGE_PCD)) | PAGE_PRESENT;
+          if (map_to_higher_half && g_pge_supported && !(flags & PAGE_USER)) {
+              pte_final_flags |= PAGE_GLOBAL; // Shared kernel half: keep across CR3 switches
+          }
           uint32_t new_pte = (current_phys & PAGING_ADDR_MASK) | pte_final_flags;
 
           if (pte & PAGE_PRESENT) {
@@ -635,6 +691,33 @@
       return 0; // Success
  }
 
+ /**
+  * @brief Builds the lowmem direct map: PHYS [0, phys_end) at
+  * KERNEL_SPACE_VIRT_START + phys, one 4MB PDE per step, no page tables.
+  */
+ static int paging_map_direct_early(uintptr_t page_directory_phys, uintptr_t phys_end)
+ {
+      volatile uint32_t* pd_phys_ptr = (volatile uint32_t*)page_directory_phys;
+      uint32_t pde_flags = PAGE_PRESENT | PAGE_RW | PAGE_SIZE_4MB;
+      if (g_pge_supported) pde_flags |= PAGE_GLOBAL;
+
+      for (uintptr_t phys = 0; phys < phys_end; phys += PAGE_SIZE_LARGE) {
+          uint32_t pd_idx = PDE_INDEX(KERNEL_SPACE_VIRT_START + phys);
+          if (pd_phys_ptr[pd_idx] & PAGE_PRESENT) {
+              serial_printf("[Paging Direct Map] Error: PDE[%lu] already present (%#lx)\n",
+                            (unsigned long)pd_idx, (unsigned long)pd_phys_ptr[pd_idx]);
+              return -1;
+          }
+          pd_phys_ptr[pd_idx] = (phys & PAGING_PDE_ADDR_MASK_4MB) | pde_flags;
+      }
+      g_direct_map_phys_end = phys_end;
+      terminal_printf("  Direct map Phys [0x0 - %#lx) -> Virt [%#lx - %#lx) with %lu 4MB pages\n",
+                      (unsigned long)phys_end, (unsigned long)KERNEL_SPACE_VIRT_START,
+                      (unsigned long)(KERNEL_SPACE_VIRT_START + phys_end),
+                      (unsigned long)(phys_end / PAGE_SIZE_LARGE));
+      return 0;
+ }
+
 int paging_setup_early_maps(uintptr_t page_directory_phys,
                              uintptr_t kernel_phys_start,
                              uintptr_t kernel_phys_end,
@@ -651,19 +734,28 @@ int paging_setup_early_maps(uintptr_t page_directory_phys,
           PAGING_PANIC("Failed to set up early identity mapping!");
       }
 
-      uintptr_t kernel_phys_aligned_start = PAGE_ALIGN_DOWN(kernel_phys_start);
-      uintptr_t kernel_phys_aligned_end = PAGE_ALIGN_UP(kernel_phys_end);
-      size_t kernel_size = kernel_phys_aligned_end - kernel_phys_aligned_start;
-      terminal_printf("  Mapping Kernel Phys [%#lx - %#lx) to Higher Half [%#lx - %#lx)\n",
-        (unsigned long)kernel_phys_aligned_start, (unsigned long)kernel_phys_aligned_end,
-        (unsigned long)(KERNEL_SPACE_VIRT_START + kernel_phys_aligned_start),
-        (unsigned long)(KERNEL_SPACE_VIRT_START + kernel_phys_aligned_end));
-      if (paging_map_physical_early(page_directory_phys, kernel_phys_aligned_start, kernel_size, PTE_KERNEL_DATA_FLAGS, true) != 0) {
-          PAGING_PANIC("Failed to map kernel to higher half!");
+      // The direct map covers everything up to the end of the kernel and the
+      // frame heap, which also places the kernel image, the heap and VGA.
+      uintptr_t direct_end = kernel_phys_end;
+      if (heap_size > 0 && heap_phys_start + heap_size > direct_end) direct_end = heap_phys_start + heap_size;
+      direct_end = (direct_end > KERNEL_DIRECT_MAP_MAX_SIZE - PAGE_SIZE_LARGE)
+                   ? KERNEL_DIRECT_MAP_MAX_SIZE : PAGE_LARGE_ALIGN_UP(direct_end);
+      if (paging_map_direct_early(page_directory_phys, direct_end) != 0) {
+          PAGING_PANIC("Failed to build the kernel direct map!");
+      }
+
+      if (PAGE_ALIGN_UP(kernel_phys_end) > direct_end) {
+          PAGING_PANIC("Kernel image extends past the direct map!");
       }
+      terminal_printf("  Kernel Phys [%#lx - %#lx) and VGA %#lx reached through the direct map\n",
+        (unsigned long)PAGE_ALIGN_DOWN(kernel_phys_start), (unsigned long)PAGE_ALIGN_UP(kernel_phys_end),
+        (unsigned long)VGA_PHYS_ADDR);
 
-      if (heap_size > 0) {
+      // Heap memory past the direct map (only with a very large heap) keeps
+      // its 4KB higher-half mapping.
+      if (heap_size > 0 && heap_phys_start + heap_size > direct_end) {
           uintptr_t heap_phys_aligned_start = PAGE_ALIGN_DOWN(heap_phys_start);
+          if (heap_phys_aligned_start < direct_end) heap_phys_aligned_start = direct_end;
           uintptr_t heap_end = heap_phys_start + heap_size;
           uintptr_t heap_phys_aligned_end = PAGE_ALIGN_UP(heap_end);
           if(heap_phys_aligned_end < heap_end) heap_phys_aligned_end = UINTPTR_MAX;
@@ -677,10 +769,6 @@ int paging_setup_early_maps(uintptr_t page_directory_phys,
           }
       }
 
-      terminal_printf("  Mapping VGA Buffer Phys %#lx to Virt %#lx\n", (unsigned long)VGA_PHYS_ADDR, (unsigned long)VGA_VIRT_ADDR);
-      if (paging_map_physical_early(page_directory_phys, VGA_PHYS_ADDR, PAGE_SIZE, PTE_KERNEL_DATA_FLAGS, true) != 0) {
-          PAGING_PANIC("Failed to map VGA buffer!");
-      }
 
       // --- NEW: Pre-allocate Kernel Stack Page Tables ---
       terminal_printf("  Pre-allocating Page Tables for Kernel Stack Range [0x%lx - 0x%lx)...\n",
@@ -830,6 +918,27 @@ int paging_setup_early_maps(uintptr_t page_directory_phys,
 
  // Post-Activation Mapping Functions
 
+/**
+ * @brief Hardware entry bits for a mapping with (valid) @p flags: the PDE
+ * and, for 4KB pages, the PTE (*pte_flags is 0 for a 4MB page). A 4KB
+ * mapping's PDE carries the access bits its PTEs need.
+ */
+static void paging_entry_flags(uint32_t flags, bool use_large_page, uint32_t *pde_flags, uint32_t *pte_flags)
+{
+    uint32_t base_flags = PAGE_PRESENT | (flags & (PAGE_RW | PAGE_USER | PAGE_PWT | PAGE_PCD));
+    uint32_t leaf_flags = base_flags | (flags & (PAGE_ACCESSED | PAGE_DIRTY));
+    if ((flags & PAGE_GLOBAL) && !(flags & PAGE_USER)) leaf_flags |= PAGE_GLOBAL;
+
+    if (use_large_page) {
+        *pde_flags = leaf_flags | PAGE_SIZE_4MB;
+        *pte_flags = 0;
+        return;
+    }
+    if ((flags & PAGE_NX_BIT) && g_nx_supported) leaf_flags |= PAGE_NX_BIT;
+    *pte_flags = leaf_flags;
+    *pde_flags = base_flags;
+}
+
  static int map_page_internal(uint32_t *target_page_directory_phys,
                              uintptr_t vaddr,
                              uintptr_t paddr,
@@ -864,43 +973,13 @@ int paging_setup_early_maps(uintptr_t page_directory_phys,
         return KERN_EPERM;
     }
 
-    uint32_t base_flags = PAGE_PRESENT;
-    if (effective_flags & PAGE_RW)   base_flags |= PAGE_RW;
-    if (effective_flags & PAGE_USER) base_flags |= PAGE_USER;
-    if (effective_flags & PAGE_PWT)  base_flags |= PAGE_PWT;
-    if (effective_flags & PAGE_PCD)  base_flags |= PAGE_PCD;
-
+    if (use_large_page && !g_pse_supported) {
+        terminal_printf("[Map Internal] Error: Attempted 4MB map, but PSE not supported/enabled.\n");
+        return KERN_EPERM;
+    }
     uint32_t pde_final_flags = 0;
     uint32_t pte_final_flags = 0;
-
-    if (use_large_page) {
-        if (!g_pse_supported) {
-            terminal_printf("[Map Internal] Error: Attempted 4MB map, but PSE not supported/enabled.\n");
-            return KERN_EPERM;
-        }
-        pde_final_flags = base_flags | PAGE_SIZE_4MB;
-        if (effective_flags & PAGE_ACCESSED) pde_final_flags |= PAGE_ACCESSED;
-        if (effective_flags & PAGE_DIRTY)    pde_final_flags |= PAGE_DIRTY;
-        if ((effective_flags & PAGE_GLOBAL) && !(effective_flags & PAGE_USER)) {
-             pde_final_flags |= PAGE_GLOBAL;
-        }
-    } else {
-        pte_final_flags = base_flags;
-        if (effective_flags & PAGE_ACCESSED) pte_final_flags |= PAGE_ACCESSED;
-        if (effective_flags & PAGE_DIRTY)    pte_final_flags |= PAGE_DIRTY;
-        if ((effective_flags & PAGE_GLOBAL) && !(effective_flags & PAGE_USER)) {
-             pte_final_flags |= PAGE_GLOBAL;
-        }
-        if ((effective_flags & PAGE_NX_BIT) && g_nx_supported) {
-             pte_final_flags |= PAGE_NX_BIT;
-        }
-
-        pde_final_flags = base_flags;
-        if (pte_final_flags & PAGE_RW)   pde_final_flags |= PAGE_RW;
-        if (pte_final_flags & PAGE_USER) pde_final_flags |= PAGE_USER;
-        if (pte_final_flags & PAGE_PWT)  pde_final_flags |= PAGE_PWT;
-        if (pte_final_flags & PAGE_PCD)  pde_final_flags |= PAGE_PCD;
-    }
+    paging_entry_flags(effective_flags, use_large_page, &pde_final_flags, &pte_final_flags);
 
     // --- Modify Page Directory / Page Table ---
 
@@ -929,12 +1008,13 @@ int paging_setup_early_maps(uintptr_t page_directory_phys,
             bool pt_allocated_here = false;
 
             if (!(pde & PAGE_PRESENT)) {
-                pt_phys_addr = frame_alloc();
+                pt_phys_addr = frame_alloc_zeroed();
                 if (pt_phys_addr == 0) {
                     serial_printf("[Map Internal] Error: frame_alloc failed for PT for V=%p.\n", (void*)aligned_vaddr);
                     return KERN_ENOMEM;
                 }
                 pt_allocated_here = true;
+                frame_pt_live_set(pt_phys_addr, 0);
 
                 uint32_t pde_value_to_write = (pt_phys_addr & PAGING_ADDR_MASK)
                                             | (pde_final_flags & ~PAGE_SIZE_4MB)
@@ -944,7 +1024,6 @@ int paging_setup_early_maps(uintptr_t page_directory_phys,
                 paging_invalidate_page((void*)aligned_vaddr);
 
                 pt_virt = (uint32_t*)(RECURSIVE_PDE_VADDR + (pd_idx * PAGE_SIZE));
-                memset(pt_virt, 0, PAGE_SIZE);
 
             } else if (pde & PAGE_SIZE_4MB) {
                  terminal_printf("[Map Internal] Error: Attempted 4KB map over existing 4MB page at V=%p (PDE[%lu]=0x%lx)\n",
@@ -992,24 +1071,20 @@ int paging_setup_early_maps(uintptr_t page_directory_phys,
             }
 
             pt_virt[pt_idx] = new_pte_val_4kb;
+            if (paging_pt_counted(target_page_directory_phys, pd_idx)) frame_pt_live_add(pt_phys_addr, 1);
             paging_invalidate_page((void*)aligned_vaddr);
             return 0;
         }
 
     } else {
-        // --- Operate on NON-CURRENT Page Directory (use temporary mapping) ---
+        // --- Operate on NON-CURRENT Page Directory (use per-CPU kmap slots) ---
         int ret = -1;
         bool pt_allocated_here = false;
         uint32_t* target_pd_virt_temp = NULL;
         uint32_t* target_pt_virt_temp = NULL;
         uintptr_t pt_phys = 0;
 
-        // FIX: Use paging_temp_map instead of paging_temp_map_vaddr
-        target_pd_virt_temp = paging_temp_map((uintptr_t)target_page_directory_phys, PTE_KERNEL_DATA_FLAGS);
-        if (!target_pd_virt_temp) {
-             serial_printf("[Map Internal] Error: Failed temp map DST PD %p\n", (void*)target_page_directory_phys);
-             return -1;
-        }
+        target_pd_virt_temp = kmap_atomic((uintptr_t)target_page_directory_phys);
 
         uint32_t pde = target_pd_virt_temp[pd_idx];
 
@@ -1039,23 +1114,16 @@ int paging_setup_early_maps(uintptr_t page_directory_phys,
                     target_pd_virt_temp[pd_idx] = promoted_pde_val;
                 }
             } else {
-                pt_phys = frame_alloc();
+                pt_phys = frame_alloc_zeroed();
                 if (!pt_phys) {
                     serial_printf("[Map Internal] Error: OTHER PD failed PT alloc for V=%p\n", (void*)aligned_vaddr);
                     ret = KERN_ENOMEM;
                     goto cleanup_other_pd;
                 }
                 pt_allocated_here = true;
+                frame_pt_live_set(pt_phys, 0);
 
-                // FIX: Use paging_temp_map to map the new PT
-                target_pt_virt_temp = paging_temp_map(pt_phys, PTE_KERNEL_DATA_FLAGS);
-                if (!target_pt_virt_temp) {
-                    terminal_printf("[Map Internal] Error: OTHER PD failed temp map new PT 0x%#lx\n", (unsigned long)pt_phys);
-                    put_frame(pt_phys);
-                    ret = -1;
-                    goto cleanup_other_pd;
-                }
-                memset(target_pt_virt_temp, 0, PAGE_SIZE);
+                target_pt_virt_temp = kmap_atomic(pt_phys);
                 // NOTE: PT remains mapped for PTE write below
 
                 uint32_t pde_value_to_write = (pt_phys & PAGING_ADDR_MASK)
@@ -1066,12 +1134,7 @@ int paging_setup_early_maps(uintptr_t page_directory_phys,
 
             // Map target PT if not already mapped from allocation
             if (!target_pt_virt_temp) {
-                 target_pt_virt_temp = paging_temp_map(pt_phys, PTE_KERNEL_DATA_FLAGS); // Needs RW for PTE write
-                 if (!target_pt_virt_temp) {
-                     terminal_printf("[Map Internal] Error: OTHER PD failed temp map existing PT 0x%#lx for V=%p\n", (unsigned long)pt_phys, (void*)aligned_vaddr);
-                     ret = -1;
-                     goto cleanup_other_pd;
-                 }
+                 target_pt_virt_temp = kmap_atomic(pt_phys);
             }
 
             uint32_t pt_idx = PTE_INDEX(aligned_vaddr);
@@ -1092,31 +1155,109 @@ int paging_setup_early_maps(uintptr_t page_directory_phys,
                         target_pd_virt_temp[pd_idx] = 0;
                         put_frame(pt_phys);
                         if(target_pt_virt_temp) { // Check if PT is mapped before unmapping
-                            paging_temp_unmap(target_pt_virt_temp);
+                            kunmap_atomic(target_pt_virt_temp);
                             target_pt_virt_temp = NULL;
                         }
                     }
                 }
             } else {
                 target_pt_virt_temp[pt_idx] = new_pte_val_4kb;
+                if (paging_pt_counted(target_page_directory_phys, pd_idx)) frame_pt_live_add(pt_phys, 1);
                 ret = 0;
             }
 
             // Unmap the temporary PT mapping if it was used
             if (target_pt_virt_temp) {
-                paging_temp_unmap(target_pt_virt_temp);
+                kunmap_atomic(target_pt_virt_temp);
             }
         }
 
     cleanup_other_pd:
         // Unmap the temporary PD mapping
         if (target_pd_virt_temp) {
-            paging_temp_unmap(target_pd_virt_temp);
+            kunmap_atomic(target_pd_virt_temp);
         }
         return ret;
     }
 }
 
+/**
+ * @brief Maps [v, v_end), which lies inside one 4MB slot, to the physical
+ * pages from @p p: one PDE lookup and one page table mapping for the run,
+ * then consecutive PTE stores. A run covering the whole slot becomes a
+ * 4MB PDE when @p large_pde_flags is nonzero, @p p is 4MB aligned and the
+ * slot is empty. Entries that were live are recorded in @p batch.
+ */
+static int map_pt_run(uint32_t *pd_phys, bool is_current_pd, uintptr_t v, uintptr_t v_end, uintptr_t p,
+                      uint32_t pde_flags, uint32_t pte_flags, uint32_t large_pde_flags, tlb_batch_t *batch)
+{
+    uint32_t pd_idx = PDE_INDEX(v);
+    if (pd_idx == RECURSIVE_PDE_INDEX) return KERN_EPERM;
+
+    uint32_t *pd = is_current_pd ? g_kernel_page_directory_virt : kmap_atomic((uintptr_t)pd_phys);
+    uint32_t pde = pd[pd_idx];
+    bool whole_slot = (v % PAGE_SIZE_LARGE == 0) && (v_end - v == PAGE_SIZE_LARGE);
+    int ret = 0;
+
+    if (pde & PAGE_SIZE_4MB) {
+        uint32_t want = (p & PAGING_PDE_ADDR_MASK_4MB) | large_pde_flags;
+        if (!(pde & PAGE_PRESENT) || !large_pde_flags || !whole_slot || pde != want) ret = KERN_EPERM;
+        goto out_pd;
+    }
+    if (large_pde_flags && whole_slot && (p % PAGE_SIZE_LARGE) == 0 && !(pde & PAGE_PRESENT)) {
+        pd[pd_idx] = (p & PAGING_PDE_ADDR_MASK_4MB) | large_pde_flags;
+        goto out_pd;
+    }
+
+    uint32_t *pt_recursive = (uint32_t *)(RECURSIVE_PDE_VADDR + pd_idx * PAGE_SIZE);
+    uintptr_t pt_phys;
+    if (!(pde & PAGE_PRESENT)) {
+        pt_phys = frame_alloc_zeroed();
+        if (!pt_phys) {
+            ret = KERN_ENOMEM;
+            goto out_pd;
+        }
+        frame_pt_live_set(pt_phys, 0);
+        pd[pd_idx] = (pt_phys & PAGING_ADDR_MASK) | pde_flags;
+        if (is_current_pd) paging_invalidate_page(pt_recursive);
+    } else {
+        pt_phys = pde & PAGING_ADDR_MASK;
+        uint32_t current_pde_flags = pde & (PAGE_PRESENT | PAGE_RW | PAGE_USER | PAGE_PWT | PAGE_PCD);
+        if ((current_pde_flags & pde_flags) != pde_flags) {
+            pd[pd_idx] = pt_phys | current_pde_flags | pde_flags;
+            uintptr_t slot = PAGE_LARGE_ALIGN_DOWN(v); // Every translation under it may be cached
+            tlb_batch_add_page(batch, slot);
+            tlb_batch_add_page(batch, slot + PAGE_SIZE_LARGE - PAGE_SIZE);
+        }
+    }
+
+    uint32_t *pt = is_current_pd ? pt_recursive : kmap_atomic(pt_phys);
+    uint32_t added = 0;
+    for (uint32_t i = PTE_INDEX(v); v < v_end; i++, v += PAGE_SIZE, p += PAGE_SIZE) {
+        uint32_t new_pte = (p & PAGING_ADDR_MASK) | pte_flags;
+        uint32_t old_pte = pt[i];
+        if (old_pte & PAGE_PRESENT) {
+            if ((old_pte & PAGING_ADDR_MASK) != (p & PAGING_ADDR_MASK)) {
+                terminal_printf("[Map Range] Error: V=%p already maps P=%#lx (tried P=%#lx)\n",
+                                (void*)v, (unsigned long)(old_pte & PAGING_ADDR_MASK), (unsigned long)p);
+                ret = KERN_EEXIST;
+                break;
+            }
+            if (old_pte == new_pte) continue;
+            tlb_batch_add_page(batch, v);
+        } else {
+            added++;
+        }
+        pt[i] = new_pte;
+    }
+    if (added && paging_pt_counted(pd_phys, pd_idx)) frame_pt_live_add(pt_phys, (int32_t)added);
+    if (!is_current_pd) kunmap_atomic(pt);
+
+out_pd:
+    if (!is_current_pd) kunmap_atomic(pd);
+    return ret;
+}
+
  int paging_map_range(uint32_t *page_directory_phys,
                       uintptr_t virt_start_addr,
                       uintptr_t phys_start_addr,
@@ -1138,6 +1279,11 @@ int paging_setup_early_maps(uintptr_t page_directory_phys,
       if (flags != masked_flags) {
            serial_printf("[Map Range] Warning: Input flags 0x%lx contained invalid bits. Using masked flags 0x%lx.\n", (unsigned long)flags, (unsigned long)masked_flags);
       }
+      // Kernel-half tables are shared by all page directories, so their
+      // entries can stay in the TLB across context switches.
+      if (g_pge_supported && virt_start_addr >= KERNEL_SPACE_VIRT_START && !(masked_flags & PAGE_USER)) {
+           masked_flags |= PAGE_GLOBAL;
+      }
 
       uintptr_t v_start = PAGE_ALIGN_DOWN(virt_start_addr);
       uintptr_t p_start = PAGE_ALIGN_DOWN(phys_start_addr);
@@ -1174,78 +1320,44 @@ int paging_setup_early_maps(uintptr_t page_directory_phys,
       serial_printf("[Map Range] Mapping V=[0x%#lx-0x%#lx) to P=[0x%#lx...) Flags=0x%lx (Masked=0x%lx)\n",
         (unsigned long)v_start, (unsigned long)v_end, (unsigned long)p_start, (unsigned long)flags, (unsigned long)masked_flags);
 
+      bool is_current_pd = ((uintptr_t)page_directory_phys == g_kernel_page_directory_phys);
+      // User mappings stay 4KB: the fault and COW paths only work on PTEs
+      bool allow_large = g_pse_supported && !(masked_flags & PAGE_USER);
+      uint32_t pde_flags, pte_flags, large_pde_flags, unused;
+      paging_entry_flags(masked_flags, false, &pde_flags, &pte_flags);
+      paging_entry_flags(masked_flags, true, &large_pde_flags, &unused);
+
+      // Only entries that were already live need invalidating; one flush covers them all
+      tlb_batch_t tlb_batch;
+      tlb_batch_init(&tlb_batch, v_start >= KERNEL_SPACE_VIRT_START ? NULL : page_directory_phys);
+
       uintptr_t current_v = v_start;
       uintptr_t current_p = p_start;
       int mapped_pages = 0;
-      int safety_counter = 0;
-      const int max_map_loop_iterations = (MAX_SINGLE_MAPPING / PAGE_SIZE) + 10;
-
+      int result = 0;
       while (current_v < v_end) {
-          if (++safety_counter > max_map_loop_iterations) {
-              serial_printf("[Map Range] Safety break after %d iterations\n", safety_counter);
-              return -1;
-          }
-
-          size_t remaining_v_size = (v_end > current_v) ? (v_end - current_v) : 0;
-          if (remaining_v_size == 0) {
+          // One page table (or one 4MB slot) per step
+          uintptr_t run_end = PAGE_LARGE_ALIGN_DOWN(current_v) + PAGE_SIZE_LARGE;
+          if (run_end <= current_v || run_end > v_end) run_end = v_end;
+          if (current_p > UINTPTR_MAX - (run_end - current_v)) {
+              serial_printf("[Map Range] Warning: Physical address overflow during iteration.\n");
               break;
           }
-
-          bool possible_large = g_pse_supported &&
-                                (current_v % PAGE_SIZE_LARGE == 0) &&
-                                (current_p % PAGE_SIZE_LARGE == 0) &&
-                                (remaining_v_size >= PAGE_SIZE_LARGE);
-
-          bool use_large = false;
-
-          if (possible_large) {
-              uint32_t pd_idx_check = PDE_INDEX(current_v);
-              uint32_t existing_pde_check = 0;
-
-              if (g_kernel_page_directory_virt != NULL && (uintptr_t)page_directory_phys == g_kernel_page_directory_phys) {
-                  existing_pde_check = g_kernel_page_directory_virt[pd_idx_check];
-              } else if (g_kernel_page_directory_virt != NULL) {
-                  serial_printf("[Map Range] Warning: Cannot check PDE for non-current PD %p. Forcing 4KB.\n", (void*)page_directory_phys);
-                  existing_pde_check = PAGE_PRESENT;
-              }
-
-              if (!(existing_pde_check & PAGE_PRESENT)) {
-                   use_large = true;
-              } else {
-                   use_large = false;
-              }
-          }
-
-          int result = map_page_internal(page_directory_phys,
-                                         current_v,
-                                         current_p,
-                                         masked_flags,
-                                         use_large);
-
+          result = map_pt_run(page_directory_phys, is_current_pd, current_v, run_end, current_p,
+                              pde_flags, pte_flags, allow_large ? large_pde_flags : 0, &tlb_batch);
           if (result != 0) {
-              serial_printf("[Map Range] Failed map_page_internal for V=0x%#lx P=0x%#lx Large=%d\n",
-                (unsigned long)current_v, (unsigned long)current_p, use_large);
-              return -1;
-          }
-
-          size_t step = use_large ? PAGE_SIZE_LARGE : PAGE_SIZE;
-
-          if (current_v > UINTPTR_MAX - step) {
-              serial_printf("[Map Range] Virtual address overflow during iteration.\n");
-              break;
-          }
-          uintptr_t next_p = current_p + step;
-          if (next_p < current_p) {
-              serial_printf("[Map Range] Warning: Physical address overflow during iteration.\n");
+              serial_printf("[Map Range] Failed for V=[0x%#lx-0x%#lx) P=0x%#lx (error %d)\n",
+                (unsigned long)current_v, (unsigned long)run_end, (unsigned long)current_p, result);
               break;
           }
-
-          current_v += step;
-          current_p = next_p;
-          mapped_pages++;
+          mapped_pages += (int)((run_end - current_v) / PAGE_SIZE);
+          current_p += run_end - current_v;
+          current_v = run_end;
       }
+      tlb_batch_flush(&tlb_batch);
+      if (result != 0) return -1;
 
-      serial_printf("[Map Range] Completed. Mapped %d pages/blocks for V=[0x%#lx - 0x%#lx).\n",
+      serial_printf("[Map Range] Completed. Mapped %d pages for V=[0x%#lx - 0x%#lx).\n",
         mapped_pages, (unsigned long)v_start, (unsigned long)current_v);
       return 0;
  }
@@ -1382,95 +1494,126 @@ int paging_setup_early_maps(uintptr_t page_directory_phys,
 
  // --- Process Management Support ---
 
- void paging_free_user_space(uint32_t *page_directory_phys) {
-      if (!page_directory_phys || page_directory_phys == (uint32_t*)g_kernel_page_directory_phys) {
-           serial_printf("[FreeUser] Error: Invalid or kernel PD provided (PD Phys: %p)\n", (void*)page_directory_phys);
-          return;
-      }
-      if (!g_kernel_page_directory_virt) return;
-
-      terminal_printf("[FreeUser] Freeing user space mappings for PD Phys %p\n", (void*)page_directory_phys);
+ #define FREE_USER_BATCH 64 // Frames handed to put_frames_bulk() at a time
 
-      uint32_t* target_pd_virt_temp = NULL;
+ static inline void free_user_batch_add(uintptr_t *frames, size_t *nr, uintptr_t frame) {
+     frames[(*nr)++] = frame;
+     if (*nr == FREE_USER_BATCH) {
+         put_frames_bulk(frames, *nr);
+         *nr = 0;
+     }
+ }
 
-      // FIX: Use paging_temp_map instead of paging_temp_map_vaddr
-      target_pd_virt_temp = paging_temp_map((uintptr_t)page_directory_phys, PTE_KERNEL_DATA_FLAGS);
-      if (!target_pd_virt_temp) {
-          terminal_printf("[FreeUser] Error: Failed to temp map target PD %p\n", (void*)page_directory_phys);
-          return;
-      }
+ /**
+  * @brief Drops every user mapping of a dying address space in two passes.
+  * The first clears the present bit of each user PDE (keeping its address)
+  * and notes it in a bitmap, so one shootdown, a CR3 reload wherever the PD
+  * is loaded, replaces an INVLPG per page. The second visits only the noted
+  * PDEs and returns their frames and page tables through put_frames_bulk().
+  * PDEs shared with the kernel PD (the low identity table) are left alone.
+  */
+ void paging_free_user_space(uint32_t *page_directory_phys) {
+     if (!page_directory_phys || page_directory_phys == (uint32_t*)g_kernel_page_directory_phys) {
+         serial_printf("[FreeUser] Error: Invalid or kernel PD provided (PD Phys: %p)\n", (void*)page_directory_phys);
+         return;
+     }
+     if (!g_kernel_page_directory_virt) return;
 
-      for (size_t i = 0; i < KERNEL_PDE_INDEX; ++i) {
-          uint32_t pde = target_pd_virt_temp[i];
+     uint32_t *pd = paging_temp_map((uintptr_t)page_directory_phys, PTE_KERNEL_DATA_FLAGS);
+     if (!pd) {
+         terminal_printf("[FreeUser] Error: Failed to temp map target PD %p\n", (void*)page_directory_phys);
+         return;
+     }
 
-          if (pde & PAGE_PRESENT) {
-              if (pde & PAGE_SIZE_4MB) {
-                  uintptr_t frame_base = pde & PAGING_PDE_ADDR_MASK_4MB;
-                  for (size_t f = 0; f < PAGES_PER_TABLE; ++f) {
-                      uintptr_t frame_addr = frame_base + f * PAGE_SIZE;
-                      if(frame_addr < frame_base) break;
-                      put_frame(frame_addr);
-                  }
-                   terminal_printf("  Freed 4MB Page Frames for PDE[%zu]\n", i);
-              } else {
-                  uintptr_t pt_phys = pde & PAGING_PDE_ADDR_MASK_4KB;
-                  uint32_t* target_pt_virt_temp = NULL;
-
-                  // FIX: Use paging_temp_map instead of paging_temp_map_vaddr
-                  target_pt_virt_temp = paging_temp_map(pt_phys, PTE_KERNEL_DATA_FLAGS);
-                  if (target_pt_virt_temp) {
-                       for (size_t j = 0; j < PAGES_PER_TABLE; ++j) {
-                           uint32_t pte = target_pt_virt_temp[j];
-                           if (pte & PAGE_PRESENT) {
-                               uintptr_t frame_phys = pte & PAGING_PTE_ADDR_MASK;
-                               put_frame(frame_phys);
-                           }
-                       }
-                       // FIX: Use paging_temp_unmap instead of paging_temp_unmap_vaddr
-                       paging_temp_unmap(target_pt_virt_temp);
-                   } else {
-                       serial_printf("[FreeUser] Warning: Failed to temp map PT 0x%#lx from PDE[%zu] - frames leak!\n", (unsigned long)pt_phys, i);
-                   }
-                  put_frame(pt_phys);
-              }
-              target_pd_virt_temp[i] = 0;
-          }
-      }
+     uint32_t present[KERNEL_PDE_INDEX / 32] = { 0 };
+     uint32_t nr_tables = 0;
+     for (uint32_t i = 0; i < KERNEL_PDE_INDEX; i++) {
+         uint32_t pde = pd[i];
+         if (!(pde & PAGE_PRESENT) || pde == g_kernel_page_directory_virt[i]) continue;
+         pd[i] = pde & ~PAGE_PRESENT;
+         present[i / 32] |= 1u << (i % 32);
+         nr_tables++;
+     }
+     if (nr_tables) tlb_shootdown(page_directory_phys, 0, KERNEL_SPACE_VIRT_START);
+
+     uintptr_t frames[FREE_USER_BATCH];
+     size_t nr = 0;
+     for (uint32_t w = 0; w < KERNEL_PDE_INDEX / 32; w++) {
+         while (present[w]) {
+             uint32_t bit;
+             asm("bsfl %1, %0" : "=r"(bit) : "rm"(present[w]) : "cc");
+             present[w] &= present[w] - 1;
+             uint32_t i = w * 32 + bit;
+             uint32_t pde = pd[i];
+             pd[i] = 0;
+
+             if (pde & PAGE_SIZE_4MB) {
+                 uintptr_t frame_base = pde & PAGING_PDE_ADDR_MASK_4MB;
+                 for (uint32_t f = 0; f < PAGES_PER_TABLE; f++) {
+                     free_user_batch_add(frames, &nr, frame_base + f * PAGE_SIZE);
+                 }
+                 continue;
+             }
+             uintptr_t pt_phys = pde & PAGING_PDE_ADDR_MASK_4KB;
+             uint32_t *pt = kmap_atomic(pt_phys);
+             for (uint32_t j = 0; j < PAGES_PER_TABLE; j++) {
+                 if (pt[j] & PAGE_PRESENT) free_user_batch_add(frames, &nr, pt[j] & PAGING_PTE_ADDR_MASK);
+                 else if (pte_is_swap(pt[j])) swap_free(pt[j]);
+             }
+             kunmap_atomic(pt);
+             free_user_batch_add(frames, &nr, pt_phys);
+         }
+     }
+     if (nr) put_frames_bulk(frames, nr);
 
-      // FIX: Use paging_temp_unmap instead of paging_temp_unmap_vaddr
-      paging_temp_unmap(target_pd_virt_temp);
-      serial_printf("[FreeUser] User space mappings cleared for PD Phys %p\n", (void*)page_directory_phys);
+     paging_temp_unmap(pd);
+     serial_printf("[FreeUser] User space cleared for PD Phys %p (%lu tables).\n",
+                   (void*)page_directory_phys, (unsigned long)nr_tables);
  }
 
 
- uintptr_t paging_clone_directory(uint32_t* src_pd_phys_addr) {
+ /**
+  * @brief Copies a user address space for fork().
+  * Kernel PDEs are shared; every user page table is duplicated and each
+  * present frame gains a reference. Writable user PTEs and user 4MB PDEs
+  * are made read-only in BOTH directories, so the first write on either
+  * side takes the COW path in handle_vma_fault(). Swap entries are copied
+  * with a slot reference each.
+  * @p src_lock, the source mm's lock, is held exclusively while one page
+  * table (or 4MB PDE) is copied, so faults, munmap and the swap clock can't
+  * change it meanwhile, and dropped between tables, where the copy may
+  * reschedule. The CPUs running the source's threads still set accessed
+  * and dirty bits, so RW is cleared with pte_cmpxchg(), and each table's
+  * stale RW translations are shot down before its lock is released. NULL
+  * if nothing else can change the source.
+  * @return Physical address of the new page directory, or 0 on failure
+  * (everything allocated so far is released).
+  */
+ uintptr_t paging_clone_directory(uint32_t* src_pd_phys_addr, struct rwlock *src_lock) {
       if (!src_pd_phys_addr || !g_kernel_page_directory_virt) {
           terminal_printf("[CloneDir] Error: Invalid source PD or paging not active.\n");
           return 0;
       }
 
-      uintptr_t new_pd_phys = paging_alloc_frame(false);
+      // Zeroed, so PDEs not reached before an error are empty for cleanup.
+      uintptr_t new_pd_phys = frame_alloc_zeroed();
       if (!new_pd_phys) {
           terminal_printf("[CloneDir] Error: Failed to allocate frame for new PD.\n");
           return 0;
       }
-      terminal_printf("[CloneDir] Cloning PD %p -> New PD 0x%#lx\n", (void*)src_pd_phys_addr, (unsigned long)new_pd_phys);
+      PAGING_DEBUG_PRINTF("[CloneDir] Cloning PD %p -> New PD %#lx\n", (void*)src_pd_phys_addr, (unsigned long)new_pd_phys);
 
       uint32_t* src_pd_virt_temp = NULL;
       uint32_t* dst_pd_virt_temp = NULL;
       int error_occurred = 0;
-      uintptr_t allocated_pt_phys[KERNEL_PDE_INDEX];
-      int allocated_pt_count = 0;
-      memset(allocated_pt_phys, 0, sizeof(allocated_pt_phys));
 
-      // FIX: Use paging_temp_map instead of paging_temp_map_vaddr
-      src_pd_virt_temp = paging_temp_map((uintptr_t)src_pd_phys_addr, PTE_KERNEL_READONLY_FLAGS);
+      // Written too: user large pages lose RW in the source as well
+      src_pd_virt_temp = paging_temp_map((uintptr_t)src_pd_phys_addr, PTE_KERNEL_DATA_FLAGS);
       if (!src_pd_virt_temp) {
           terminal_printf("[CloneDir] Error: Failed to map source PD %p.\n", (void*)src_pd_phys_addr);
           error_occurred = 1; goto cleanup_clone_err;
       }
 
-      // FIX: Use paging_temp_map instead of paging_temp_map_vaddr
       dst_pd_virt_temp = paging_temp_map(new_pd_phys, PTE_KERNEL_DATA_FLAGS);
       if (!dst_pd_virt_temp) {
           terminal_printf("[CloneDir] Error: Failed to map destination PD 0x%#lx.\n", (unsigned long)new_pd_phys);
@@ -1480,92 +1623,128 @@ int paging_setup_early_maps(uintptr_t page_directory_phys,
       for (size_t i = KERNEL_PDE_INDEX; i < RECURSIVE_PDE_INDEX; i++) {
           dst_pd_virt_temp[i] = g_kernel_page_directory_virt[i];
       }
-      dst_pd_virt_temp[RECURSIVE_PDE_INDEX] = (new_pd_phys & PAGING_ADDR_MASK) | PAGE_PRESENT | PAGE_RW | PAGE_NX_BIT;
-
-      for (size_t i = 0; i < KERNEL_PDE_INDEX; i++) {
-          uint32_t src_pde = src_pd_virt_temp[i];
-          if (!(src_pde & PAGE_PRESENT)) { dst_pd_virt_temp[i] = 0; continue; }
-
-          if (src_pde & PAGE_SIZE_4MB) {
-               dst_pd_virt_temp[i] = src_pde;
-               uintptr_t frame_base = src_pde & PAGING_PDE_ADDR_MASK_4MB;
-               for (size_t f = 0; f < PAGES_PER_TABLE; ++f) {
-                   uintptr_t frame_addr_to_inc = frame_base + f * PAGE_SIZE;
-                   if (frame_addr_to_inc < frame_base) break;
-                   frame_incref(frame_addr_to_inc);
-               }
-              continue;
-          }
-
-          uintptr_t src_pt_phys = src_pde & PAGING_PDE_ADDR_MASK_4KB;
-          uintptr_t dst_pt_phys = paging_alloc_frame(false);
-          if (!dst_pt_phys) {
-              terminal_printf("[CloneDir] Error: Failed to allocate new PT for PDE[%zu].\n", i);
-              error_occurred = 1; goto cleanup_clone_err;
-          }
-          if ((size_t)allocated_pt_count < ARRAY_SIZE(allocated_pt_phys)) {
-              allocated_pt_phys[allocated_pt_count++] = dst_pt_phys;
+      dst_pd_virt_temp[RECURSIVE_PDE_INDEX] = (new_pd_phys & PAGING_ADDR_MASK) | PAGE_PRESENT | PAGE_RW | (g_nx_supported ? PAGE_NX_BIT : 0);
+
+      for (size_t i = 0; i < KERNEL_PDE_INDEX && !error_occurred; i++) {
+          if (!(src_pd_virt_temp[i] & PAGE_PRESENT)) continue;
+          cond_resched(); // Up to 768 tables; no lock or kmap_atomic slot is held here
+
+          uintptr_t lock_flags = src_lock ? rwlock_write_acquire_irqsave(src_lock) : 0;
+          bool write_protected = false;
+          uint32_t src_pde = src_pd_virt_temp[i]; // Again: it may have changed before the lock
+          if (!(src_pde & PAGE_PRESENT)) {
+              // Unmapped meanwhile
+          } else if (src_pde & PAGE_SIZE_4MB) {
+              // Shared like a page table's worth of PTEs: a writable user
+              // large page is write-protected on both sides, and the first
+              // write reuses it (refcounts back to 1) or splits it for a
+              // 4KB copy in handle_vma_fault().
+              if ((src_pde & (PAGE_USER | PAGE_RW)) == (PAGE_USER | PAGE_RW)) {
+                  while (!pte_cmpxchg(&src_pd_virt_temp[i], src_pde, src_pde & ~PAGE_RW)) src_pde = src_pd_virt_temp[i];
+                  src_pde &= ~PAGE_RW;
+                  write_protected = true;
+              }
+              dst_pd_virt_temp[i] = src_pde;
+              frame_incref_range(src_pde & PAGING_PDE_ADDR_MASK_4MB, PAGES_PER_TABLE);
           } else {
-               serial_printf("[CloneDir] Error: Exceeded allocated_pt_phys array size.\n");
-               put_frame(dst_pt_phys);
-               error_occurred = 1; goto cleanup_clone_err;
-          }
-
-          uint32_t* src_pt_virt_temp = NULL;
-          uint32_t* dst_pt_virt_temp = NULL;
-
-          // FIX: Use paging_temp_map instead of paging_temp_map_vaddr
-          src_pt_virt_temp = paging_temp_map(src_pt_phys, PTE_KERNEL_READONLY_FLAGS);
-          if (!src_pt_virt_temp) {
-              terminal_printf("[CloneDir] Error: Failed to map source PT 0x%#lx.\n", (unsigned long)src_pt_phys);
-              error_occurred = 1; goto cleanup_clone_err;
-          }
-
-          // FIX: Use paging_temp_map instead of paging_temp_map_vaddr
-          dst_pt_virt_temp = paging_temp_map(dst_pt_phys, PTE_KERNEL_DATA_FLAGS);
-          if (!dst_pt_virt_temp) {
-              terminal_printf("[CloneDir] Error: Failed to map destination PT 0x%#lx.\n", (unsigned long)dst_pt_phys);
-              paging_temp_unmap(src_pt_virt_temp); // FIX: Use correct unmap function
-              error_occurred = 1; goto cleanup_clone_err;
-          }
-
-          for (size_t j = 0; j < PAGES_PER_TABLE; j++) {
-              uint32_t src_pte = src_pt_virt_temp[j];
-              if (src_pte & PAGE_PRESENT) {
-                  uintptr_t frame_phys = src_pte & PAGING_PTE_ADDR_MASK;
-                  frame_incref(frame_phys);
-                  dst_pt_virt_temp[j] = src_pte;
+              uintptr_t src_pt_phys = src_pde & PAGING_PDE_ADDR_MASK_4KB;
+              uintptr_t dst_pt_phys = frame_alloc();
+              if (!dst_pt_phys) {
+                  terminal_printf("[CloneDir] Error: Failed to allocate new PT for PDE[%lu].\n", (unsigned long)i);
+                  error_occurred = 1;
               } else {
-                  dst_pt_virt_temp[j] = 0;
+                  // Source PT is written too (write protection), so map it RW.
+                  uint32_t* src_pt_virt_temp = kmap_atomic(src_pt_phys);
+                  uint32_t* dst_pt_virt_temp = kmap_atomic(dst_pt_phys);
+
+                  uint32_t live = 0;
+                  for (size_t j = 0; j < PAGES_PER_TABLE; j++) {
+                      uint32_t src_pte = src_pt_virt_temp[j];
+                      if (src_pte & PAGE_PRESENT) {
+                          live++;
+                          if (src_pte & PAGE_RW) {
+                              while (!pte_cmpxchg(&src_pt_virt_temp[j], src_pte, src_pte & ~PAGE_RW)) src_pte = src_pt_virt_temp[j];
+                              src_pte &= ~PAGE_RW;
+                              write_protected = true;
+                          }
+                          frame_incref(src_pte & PAGING_PTE_ADDR_MASK);
+                          dst_pt_virt_temp[j] = src_pte;
+                      } else if (pte_is_swap(src_pte) && swap_dup(src_pte)) {
+                          live++; // Swapped out: both sides refer to the slot
+                          dst_pt_virt_temp[j] = src_pte;
+                      } else {
+                          dst_pt_virt_temp[j] = 0;
+                          if (pte_is_swap(src_pte)) {
+                              terminal_printf("[CloneDir] Error: Swap slot %lu has too many references.\n",
+                                              (unsigned long)swap_entry_slot(src_pte));
+                              error_occurred = 1;
+                          }
+                      }
+                  }
+
+                  kunmap_atomic(dst_pt_virt_temp);
+                  kunmap_atomic(src_pt_virt_temp);
+                  frame_pt_live_set(dst_pt_phys, live);
+                  // Installed even after an error, so cleanup releases it
+                  dst_pd_virt_temp[i] = (dst_pt_phys & PAGING_ADDR_MASK) | (src_pde & PAGING_FLAG_MASK);
               }
           }
-
-          paging_temp_unmap(dst_pt_virt_temp); // FIX: Use correct unmap function
-          paging_temp_unmap(src_pt_virt_temp); // FIX: Use correct unmap function
-          dst_pd_virt_temp[i] = (dst_pt_phys & PAGING_ADDR_MASK) | (src_pde & PAGING_FLAG_MASK);
+          // Before the lock goes: a fault may then copy one of these pages
+          // while another CPU still writes to it through an old RW entry.
+          if (write_protected) tlb_shootdown(src_pd_phys_addr, i * PAGE_SIZE_LARGE, (i + 1) * PAGE_SIZE_LARGE);
+          if (src_lock) rwlock_write_release_irqrestore(src_lock, lock_flags);
       }
 
   cleanup_clone_err:
-      if (src_pd_virt_temp) paging_temp_unmap(src_pd_virt_temp); // FIX: Use correct unmap function
-      if (dst_pd_virt_temp) paging_temp_unmap(dst_pd_virt_temp); // FIX: Use correct unmap function
+      if (src_pd_virt_temp) paging_temp_unmap(src_pd_virt_temp);
+      if (dst_pd_virt_temp) paging_temp_unmap(dst_pd_virt_temp);
 
       if (error_occurred) {
           terminal_printf("[CloneDir] Error occurred. Cleaning up allocations...\n");
-          for (int k = 0; k < allocated_pt_count; k++) {
-              if (allocated_pt_phys[k] != 0) put_frame(allocated_pt_phys[k]);
-          }
-          if (new_pd_phys != 0) put_frame(new_pd_phys);
+          // Releases the copied PTs and the frame references taken so far.
+          if (dst_pd_virt_temp) paging_free_user_space((uint32_t*)new_pd_phys);
+          put_frame(new_pd_phys);
           return 0;
       }
 
-      terminal_printf("[CloneDir] Successfully cloned PD to 0x%#lx\n", (unsigned long)new_pd_phys);
+      PAGING_DEBUG_PRINTF("[CloneDir] Successfully cloned PD to %#lx\n", (unsigned long)new_pd_phys);
       return new_pd_phys;
  }
 
 
  // --- Page Fault Handler ---
+
+ // Prints the fault and the CPU state. Every fault paid for this on VGA and
+ // serial before, so it only runs for faults that are fatal, or for every
+ // fault with PAGING_PF_VERBOSE.
+ static void page_fault_report(const registers_t *regs, uintptr_t fault_addr, uint32_t pid) {
+    uint32_t error_code = regs->err_code;
+    terminal_printf("\n--- PAGE FAULT (#PF) ---\n");
+    terminal_printf(" PID: %lu, Addr: %p, ErrCode: 0x%lx\n",
+        (unsigned long)pid, (void*)fault_addr, (unsigned long)error_code);
+    terminal_printf(" Details: %s, %s, %s, %s, %s\n",
+                    !(error_code & 0x1) ? "Not-Present" : "Present(Protection)",
+                    (error_code & 0x2) ? "Write" : "Read",
+                    (error_code & 0x4) ? "User-Mode" : "Supervisor-Mode",
+                    (error_code & 0x8) ? "Reserved-Bit-Set" : "Reserved-OK",
+                    (error_code & 0x10) ? (g_nx_supported ? "Instruction-Fetch(NX?)" : "Instruction-Fetch") : "Data-Access");
+    terminal_printf(" CPU State: EIP=%p, CS=0x%lx, EFLAGS=0x%lx\n",
+        (void*)regs->eip, (unsigned long)regs->cs, (unsigned long)regs->eflags);
+    terminal_printf(" EAX=0x%#lx EBX=0x%#lx ECX=0x%#lx EDX=0x%#lx\n",
+            (unsigned long)regs->eax, (unsigned long)regs->ebx,
+            (unsigned long)regs->ecx, (unsigned long)regs->edx);
+    terminal_printf(" ESI=0x%#lx EDI=0x%#lx EBP=%p K_ESP_before_pusha=0x%#lx\n",
+            (unsigned long)regs->esi, (unsigned long)regs->edi,
+            (void*)regs->ebp, (unsigned long)regs->esp_dummy);
+    // user_ss/user_esp were only pushed if the fault came from CPL 3 (RPL of the saved CS)
+    if ((regs->cs & 3) != 0) {
+        terminal_printf("           U_ESP=0x%#lx, U_SS=0x%#lx\n",
+                        (unsigned long)regs->useresp, (unsigned long)regs->ss);
+    }
+ }
+
  void page_fault_handler(registers_t *regs) { // <-- Use isr_frame_t
-    serial_write("[PF] Enter C page_fault_handler\n");
+    PF_VERBOSE_PRINTF("[PF] Enter C page_fault_handler\n");
     uintptr_t fault_addr;
     asm volatile("mov %%cr2, %0" : "=r"(fault_addr));
 
@@ -1577,6 +1756,7 @@ int paging_setup_early_maps(uintptr_t page_directory_phys,
     }
 
     uint32_t error_code = regs->err_code; // <-- Use frame
+    TRACEPOINT(TP_PAGE_FAULT, fault_addr, error_code);
 
     // Decode error code bits
     bool non_present       = !(error_code & 0x1); // Corrected: 0 = Not Present
@@ -1588,49 +1768,17 @@ int paging_setup_early_maps(uintptr_t page_directory_phys,
     pcb_t* current_process = get_current_process();
     uint32_t current_pid = current_process ? current_process->pid : (uint32_t)-1;
 
-    terminal_printf("\n--- PAGE FAULT (#PF) ---\n");
-    // Use %lu for pid (uint32_t), %p for address, %lx for error_code
-    terminal_printf(" PID: %lu, Addr: %p, ErrCode: 0x%lx\n",
-        (unsigned long)current_pid,
-        (void*)fault_addr,
-        (unsigned long)error_code);
-    terminal_printf(" Details: %s, %s, %s, %s, %s\n",
-                    non_present ? "Not-Present" : "Present(Protection)", // Corrected label
-                    write_fault ? "Write" : "Read",
-                    user_mode ? "User-Mode" : "Supervisor-Mode", // Clarified label
-                    reserved_bit ? "Reserved-Bit-Set" : "Reserved-OK",
-                    instruction_fetch ? (g_nx_supported ? "Instruction-Fetch(NX?)" : "Instruction-Fetch") : "Data-Access");
-    // Use %p for EIP, %lx for CS/EFLAGS
-    terminal_printf(" CPU State: EIP=%p, CS=0x%lx, EFLAGS=0x%lx\n",
-        (void*)regs->eip, // <-- Use frame
-        (unsigned long)regs->cs, // <-- Use frame
-        (unsigned long)regs->eflags); // <-- Use frame
-    // Use %lx for general regs, %p for EBP, %lx for saved ESP
-    terminal_printf(" EAX=0x%#lx EBX=0x%#lx ECX=0x%#lx EDX=0x%#lx\n",
-            (unsigned long)regs->eax, (unsigned long)regs->ebx, // <-- Use frame
-            (unsigned long)regs->ecx, (unsigned long)regs->edx); // <-- Use frame
-    terminal_printf(" ESI=0x%#lx EDI=0x%#lx EBP=%p K_ESP_before_pusha=0x%#lx\n", // Renamed esp_dummy label
-            (unsigned long)regs->esi, (unsigned long)regs->edi, // <-- Use frame
-            (void*)regs->ebp, (unsigned long)regs->esp_dummy); // <-- Use frame
-
-    // Conditionally access and print user_ss/user_esp
-    // Check if the fault happened *while CPL was 3* by checking RPL of CS selector pushed by CPU
-    if ((regs->cs & 3) != 0) { // RPL = bits 0-1 of CS selector <-- Use frame
-        // If yes, user_ss and user_esp were pushed by the CPU *after* eflags
-        // Access them directly from the frame struct
-        terminal_printf("           U_ESP=0x%#lx, U_SS=0x%#lx\n",
-                        (unsigned long)regs->useresp, // <-- Use frame
-                        (unsigned long)regs->ss);     // <-- Use frame
-    }
+    if (PAGING_PF_VERBOSE) page_fault_report(regs, fault_addr, current_pid);
 
     if (!user_mode) { // Check error code flag: Did the fault *occur* while CPL=0?
+        if (!PAGING_PF_VERBOSE) page_fault_report(regs, fault_addr, current_pid);
         terminal_printf(" Reason: Fault occurred in Supervisor Mode!\n");
         if (reserved_bit) terminal_printf(" CRITICAL: Reserved bit set in paging structure accessed by kernel at VAddr %p!\n", (void*)fault_addr);
 
         // *** Corrected Logic Here ***
         if (non_present) { // Check if page was NOT present
              terminal_printf(" CRITICAL: Kernel attempted to access non-present page at VAddr %p!\n", (void*)fault_addr);
-             // Line 1598 is likely here or just after
+             if (kstack_is_guard(fault_addr)) terminal_printf(" CRITICAL: Kernel stack overflow (guard page hit)!\n");
              KERNEL_PANIC_HALT("Irrecoverable Supervisor Page Fault");
         } else { // Page was present, so it's a protection fault
              if (write_fault) terminal_printf(" CRITICAL: Kernel write attempt caused protection fault at VAddr %p!\n", (void*)fault_addr);
@@ -1642,9 +1790,10 @@ int paging_setup_early_maps(uintptr_t page_directory_phys,
     }
 
     // --- User Mode Fault ---
-    terminal_printf(" Reason: Fault occurred in User Mode.\n");
+    // The reasons below are printed before the report at kill_process
 
     if (!current_process) {
+        page_fault_report(regs, fault_addr, current_pid);
         terminal_printf("  Error: No current process available for user fault! Addr=%p\n", (void*)fault_addr);
         PAGING_PANIC("User Page Fault without process context!");
         return;
@@ -1673,53 +1822,29 @@ int paging_setup_early_maps(uintptr_t page_directory_phys,
         goto kill_process;
     }
 
-    terminal_printf("  Searching for VMA covering faulting address %p...\n", (void*)fault_addr);
-    vma_struct_t *vma = find_vma(mm, fault_addr);
+    // The VMA is looked up, and the access checked against it, under the
+    // mm lock together with the PTE update.
+    int handle_result = handle_vma_fault(mm, fault_addr, error_code);
 
-    if (!vma) {
+    if (handle_result == 0) {
+        PF_VERBOSE_PRINTF("  VMA fault handler succeeded. Resuming process PID %lu.\n", (unsigned long)current_pid);
+        return; // Resume process
+    } else if (handle_result == -FS_ERR_NOT_FOUND) {
         terminal_printf("  Error: No VMA covers the faulting address %p. Segmentation Fault.\n",
                         (void*)fault_addr);
         goto kill_process;
-    }
-
-    terminal_printf("  VMA Found: [%#lx - %#lx) Flags: %c%c%c PageProt: 0x%lx\n",
-        (unsigned long)vma->vm_start, (unsigned long)vma->vm_end,
-        (vma->vm_flags & VM_READ) ? 'R' : '-',
-        (vma->vm_flags & VM_WRITE) ? 'W' : '-',
-        (vma->vm_flags & VM_EXEC) ? 'X' : '-',
-        (unsigned long)vma->page_prot);
-
-    // Check permissions against VMA flags (not just PTE flags)
-    if (write_fault && !(vma->vm_flags & VM_WRITE)) {
-        terminal_printf("  Error: Write attempt to VMA without VM_WRITE flag. Segmentation Fault.\n");
+    } else if (handle_result == -FS_ERR_PERMISSION_DENIED) {
+        terminal_printf("  Error: %s attempt the VMA does not allow (%s). Segmentation Fault.\n",
+                        instruction_fetch ? "Instruction fetch" : (write_fault ? "Write" : "Read"),
+                        instruction_fetch ? "VM_EXEC" : (write_fault ? "VM_WRITE" : "VM_READ"));
         goto kill_process;
-    }
-    // Note: Read implies execute if NX is not supported/set
-    if (!write_fault && !(vma->vm_flags & VM_READ)) {
-         // This case might need refinement depending on execute handling
-         terminal_printf("  Error: Read/Execute attempt from VMA without VM_READ flag. Segmentation Fault.\n");
-         goto kill_process;
-    }
-     // Explicit execute check (relevant even without HW NX if VM_EXEC is used meaningfully)
-     if (instruction_fetch && !(vma->vm_flags & VM_EXEC)) {
-         // We might reach here even if HW NX isn't supported/active, but the VMA lacks EXEC permission
-         terminal_printf("  Error: Instruction fetch from VMA without VM_EXEC flag. Segmentation Fault.\n");
-         goto kill_process;
-     }
-
-    terminal_printf("  Attempting to handle fault via VMA operations (Demand Paging / COW)...\n");
-    int handle_result = handle_vma_fault(mm, vma, fault_addr, error_code);
-
-    if (handle_result == 0) {
-        terminal_printf("  VMA fault handler succeeded. Resuming process PID %lu.\n", (unsigned long)current_pid);
-        terminal_printf("--------------------------\n");
-        return; // Resume process
     } else {
         terminal_printf("  Error: handle_vma_fault failed with code %d. Terminating process.\n", handle_result);
         goto kill_process;
     }
 
 kill_process:
+    if (!PAGING_PF_VERBOSE) page_fault_report(regs, fault_addr, current_pid);
     terminal_printf("--- Unhandled User Page Fault ---\n");
     terminal_printf(" Terminating Process PID %lu.\n", (unsigned long)current_pid);
     terminal_printf("--------------------------\n");
@@ -1738,24 +1863,6 @@ kill_process:
   * Removed the stray code block that was previously here (lines 2120-2204 in original).
   */
 
- /**
-  * @brief Checks if all entries in a given Page Table are zero.
-  * @param pt_virt Virtual address of the Page Table to check.
-  * @return true if all PTEs are 0, false otherwise.
-  */
- static bool is_page_table_empty(uint32_t *pt_virt) {
-     if (!pt_virt) {
-         terminal_printf("[is_page_table_empty] Warning: NULL page table pointer provided\n");
-         return true;
-     }
-     for (size_t i = 0; i < PAGES_PER_TABLE; ++i) {
-         if (pt_virt[i] != 0) {
-             return false;
-         }
-     }
-     return true;
- }
-
  // --- TLB Flushing ---
 
  void tlb_flush_range(void* start_vaddr, size_t size) {
@@ -1772,13 +1879,15 @@ kill_process:
           end_addr = UINTPTR_MAX;
       }
 
-      while (addr < end_addr) {
-          paging_invalidate_page((void*)addr);
-          if (addr > UINTPTR_MAX - PAGE_SIZE) {
-              break;
-          }
-          addr += PAGE_SIZE;
+      // Kernel mappings are shared by every address space; user mappings
+      // only concern CPUs running the current page directory.
+      uint32_t *pgd = NULL;
+      if (addr < KERNEL_SPACE_VIRT_START) {
+          uintptr_t cr3;
+          asm volatile("mov %%cr3, %0" : "=r"(cr3));
+          pgd = (uint32_t *)cr3;
       }
+      tlb_shootdown(pgd, addr, end_addr);
  }
 
  // --- Global PD Pointer Setup ---
@@ -1803,24 +1912,16 @@ kill_process:
 
 // --- Dynamic Temporary Mapping State ---
 static spinlock_t g_temp_va_lock;
-static uint32_t g_temp_va_bitmap[KERNEL_TEMP_MAP_COUNT / 32];
+static uint32_t g_temp_va_bitmap[BITMAP_WORDS(KERNEL_TEMP_MAP_COUNT)];
 static bool g_temp_va_initialized = false;
 
-// Helper function to set/clear/test bits in the bitmap
-static inline void bitmap_set(uint32_t* map, int bit) {
-    map[bit / 32] |= (1 << (bit % 32));
-}
-static inline void bitmap_clear(uint32_t* map, int bit) {
-    map[bit / 32] &= ~(1 << (bit % 32));
-}
-static inline bool bitmap_test(uint32_t* map, int bit) {
-    return (map[bit / 32] & (1 << (bit % 32))) != 0;
-}
-
 int paging_temp_map_init(void) {
     terminal_write("[Paging TempVA] Initializing dynamic temporary mapping allocator...\n");
     spinlock_init(&g_temp_va_lock);
-    memset(g_temp_va_bitmap, 0, sizeof(g_temp_va_bitmap));
+    bitmap_zero(g_temp_va_bitmap, KERNEL_TEMP_MAP_COUNT);
+    for (unsigned int i = 0; i < MAX_CPUS * KMAP_SLOTS_PER_CPU; ++i) {
+        bitmap_set(g_temp_va_bitmap, i); // Reserved for kmap_atomic()
+    }
     g_temp_va_initialized = true;
     terminal_printf("  Temp VA Range: [%p - %p), Slots: %u\n",
                     (void*)KERNEL_TEMP_MAP_START, (void*)KERNEL_TEMP_MAP_END, KERNEL_TEMP_MAP_COUNT);
@@ -1837,13 +1938,10 @@ static uintptr_t temp_vaddr_alloc(void) {
     // uint32_t irq_flags = spinlock_acquire_irqsave(&g_temp_va_lock);
     uintptr_t allocated_vaddr = 0;
 
-    // FIX: Use unsigned int for loop variable matching KERNEL_TEMP_MAP_COUNT type
-    for (unsigned int i = 0; i < KERNEL_TEMP_MAP_COUNT; ++i) {
-        if (!bitmap_test(g_temp_va_bitmap, i)) {
-            bitmap_set(g_temp_va_bitmap, i);
-            allocated_vaddr = KERNEL_TEMP_MAP_START + (i * PAGE_SIZE);
-            break;
-        }
+    uint32_t slot = bitmap_find_first_zero(g_temp_va_bitmap, KERNEL_TEMP_MAP_COUNT);
+    if (slot < KERNEL_TEMP_MAP_COUNT) {
+        bitmap_set(g_temp_va_bitmap, slot);
+        allocated_vaddr = KERNEL_TEMP_MAP_START + (slot * PAGE_SIZE);
     }
 
     // ---> FIX #2: Release Lock <---
@@ -1864,14 +1962,14 @@ static void temp_vaddr_free(uintptr_t vaddr) {
         return;
     }
 
-    int bit = (vaddr - KERNEL_TEMP_MAP_START) / PAGE_SIZE;
+    uint32_t bit = (vaddr - KERNEL_TEMP_MAP_START) / PAGE_SIZE;
 
     // ---> FIX #2: Add Lock <---
     // Requires functions like spinlock_acquire_irqsave from your spinlock.h
     // uint32_t irq_flags = spinlock_acquire_irqsave(&g_temp_va_lock);
 
     if (!bitmap_test(g_temp_va_bitmap, bit)) {
-        terminal_printf("[TempVA Free] Warning: Double free detected for address %p (bit %d)\n", (void*)vaddr, bit);
+        terminal_printf("[TempVA Free] Warning: Double free detected for address %p (bit %lu)\n", (void*)vaddr, (unsigned long)bit);
     } else {
         bitmap_clear(g_temp_va_bitmap, bit);
     }
@@ -1891,6 +1989,10 @@ void* paging_temp_map(uintptr_t phys_addr, uint32_t flags) {
         terminal_printf("[TempMap] Error: Physical address %#lx not page-aligned.\n", phys_addr);
         return NULL;
     }
+    // Lowmem is permanently mapped; only uncached requests need their own PTE.
+    if (paging_phys_is_direct(phys_addr) && !(flags & (PAGE_PCD | PAGE_PWT))) {
+        return paging_phys_to_virt(phys_addr);
+    }
 
     uintptr_t vaddr = temp_vaddr_alloc();
     if (vaddr == 0) return NULL;
@@ -1899,22 +2001,12 @@ void* paging_temp_map(uintptr_t phys_addr, uint32_t flags) {
     uint32_t pde = g_kernel_page_directory_virt[pd_idx];
 
     if (!(pde & PAGE_PRESENT)) {
-        uintptr_t pt_phys = frame_alloc();
+        uintptr_t pt_phys = frame_alloc_zeroed();
         if (pt_phys == 0) {
             terminal_printf("[TempMap] Error: Failed to allocate PT frame for V=%p.\n", (void*)vaddr);
             temp_vaddr_free(vaddr);
             return NULL;
         }
-        // FIX: Check return value of recursive call
-        void* temp_pt_map = paging_temp_map(pt_phys, PTE_KERNEL_DATA_FLAGS);
-        if (!temp_pt_map) {
-             terminal_printf("[TempMap] Error: Failed to temp map new PT frame %#lx for zeroing.\n", pt_phys);
-             put_frame(pt_phys);
-             temp_vaddr_free(vaddr);
-             return NULL;
-        }
-        memset(temp_pt_map, 0, PAGE_SIZE);
-        paging_temp_unmap(temp_pt_map);
 
         uint32_t pde_flags = PAGE_PRESENT | PAGE_RW | PAGE_NX_BIT;
         g_kernel_page_directory_virt[pd_idx] = (pt_phys & PAGING_ADDR_MASK) | pde_flags;
@@ -1947,6 +2039,7 @@ void* paging_temp_map(uintptr_t phys_addr, uint32_t flags) {
 void paging_temp_unmap(void* temp_vaddr) {
     uintptr_t vaddr = (uintptr_t)temp_vaddr;
 
+    if (paging_virt_is_direct(temp_vaddr)) return; // Handed out from the direct map
     if (vaddr < KERNEL_TEMP_MAP_START || vaddr >= KERNEL_TEMP_MAP_END || (vaddr % PAGE_SIZE != 0)) {
         serial_printf("[TempUnmap] Warning: Invalid or out-of-range temporary address %p provided for unmap.\n", temp_vaddr);
         return;
@@ -1968,12 +2061,61 @@ void paging_temp_unmap(void* temp_vaddr) {
         uint32_t* pt_virt = (uint32_t*)(RECURSIVE_PDE_VADDR + (pd_idx * PAGE_SIZE));
         if (pt_virt[pt_idx] & PAGE_PRESENT) {
             pt_virt[pt_idx] = 0;
-            paging_invalidate_page(temp_vaddr);
+            // The mapper may have migrated since paging_temp_map(), and any CPU
+            // it ran on can hold the entry: flush it everywhere before the VA
+            // goes back to the pool.
+            tlb_shootdown(NULL, vaddr, vaddr + PAGE_SIZE);
         }
     }
     temp_vaddr_free(vaddr);
 }
 
+// --- Per-CPU Atomic Kmap ---
+// The slot PTEs live in the temp-area page table that paging_setup_early_maps
+// pre-allocates, so they are reached through the recursive mapping of
+// whichever page directory is loaded.
+static inline volatile uint32_t *kmap_slot_pte(uintptr_t vaddr) {
+    return (volatile uint32_t *)(RECURSIVE_PDE_VADDR + PDE_INDEX(vaddr) * PAGE_SIZE) + PTE_INDEX(vaddr);
+}
+
+static inline uintptr_t kmap_slot_vaddr(uint32_t cpu, uint32_t depth) {
+    return KERNEL_KMAP_START + (cpu * KMAP_SLOTS_PER_CPU + depth) * PAGE_SIZE;
+}
+
+void* kmap_atomic(uintptr_t phys_addr) {
+    if (paging_phys_is_direct(phys_addr)) return paging_phys_to_virt(phys_addr);
+
+    uintptr_t irq_flags = local_irq_save();
+    uint32_t depth = percpu_read(kmap_depth);
+    if (depth >= KMAP_SLOTS_PER_CPU) {
+        PAGING_PANIC("kmap_atomic: per-CPU slots exhausted!");
+    }
+    if (depth == 0) percpu_write(kmap_irq_flags, irq_flags);
+    percpu_write(kmap_depth, depth + 1);
+
+    uintptr_t vaddr = kmap_slot_vaddr(percpu_read(cpu_id), depth);
+    *kmap_slot_pte(vaddr) = (phys_addr & PAGING_ADDR_MASK) | PTE_KERNEL_DATA_FLAGS;
+    paging_invalidate_page((void*)vaddr);
+    return (void*)vaddr;
+}
+
+void kunmap_atomic(void* vaddr) {
+    if (paging_virt_is_direct(vaddr)) return;
+
+    uint32_t depth = percpu_read(kmap_depth);
+    uintptr_t expected = depth ? kmap_slot_vaddr(percpu_read(cpu_id), depth - 1) : 0;
+    if ((uintptr_t)vaddr != expected) {
+        serial_printf("[Kmap] Error: kunmap_atomic(%p) out of order (top slot %#lx, depth %lu)\n",
+                      vaddr, (unsigned long)expected, (unsigned long)depth);
+        PAGING_PANIC("kunmap_atomic: unbalanced or out-of-order unmap!");
+    }
+
+    *kmap_slot_pte((uintptr_t)vaddr) = 0;
+    paging_invalidate_page(vaddr);
+    percpu_write(kmap_depth, depth - 1);
+    if (depth == 1) local_irq_restore(percpu_read(kmap_irq_flags));
+}
+
  // Helper for copying kernel PDEs
  /* paging.c -------------------------------------------------------------- */
 void copy_kernel_pde_entries(uint32_t *dst_pd)
@@ -1999,6 +2141,49 @@ void copy_kernel_pde_entries(uint32_t *dst_pd)
     serial_printf("[CopyPDEs] Kernel PDE memcpy complete.\n");
 }
 
+/**
+ * @brief Replaces the user 4MB PDE in slot @p pd_idx of @p pd_virt (a
+ * mapping of @p page_directory_phys) with a page table mapping the same
+ * frames with the same flags, so parts of it can be unmapped or
+ * write-protected on their own. Frame references do not change: each 4KB
+ * frame of a large page already holds its own.
+ *
+ * The translation stays the same, so the CPU may keep using a cached 4MB
+ * entry until the next INVLPG in the range, which whoever changes a PTE
+ * afterwards issues anyway. Concurrent faults may race to split one PDE;
+ * the loser frees its table and returns the winner's.
+ *
+ * @return Physical address of the page table now in the slot, or 0 if the
+ * slot no longer holds a large page and no table either, or on OOM.
+ */
+uintptr_t paging_split_large_pde(uint32_t *page_directory_phys, uint32_t *pd_virt, uint32_t pd_idx) {
+    uint32_t pde = pd_virt[pd_idx];
+    if ((pde & (PAGE_PRESENT | PAGE_SIZE_4MB | PAGE_USER)) != (PAGE_PRESENT | PAGE_SIZE_4MB | PAGE_USER)) {
+        return (pde & PAGE_PRESENT) && !(pde & PAGE_SIZE_4MB) ? (pde & PAGING_PDE_ADDR_MASK_4KB) : 0;
+    }
+
+    uintptr_t pt_phys = frame_alloc();
+    if (!pt_phys) return 0;
+    uintptr_t frame_base = pde & PAGING_PDE_ADDR_MASK_4MB;
+    uint32_t pte_flags = pde & PAGING_FLAG_MASK & ~PAGE_SIZE_4MB;
+    uint32_t *pt = kmap_atomic(pt_phys);
+    for (uint32_t i = 0; i < PAGES_PER_TABLE; i++) pt[i] = (frame_base + i * PAGE_SIZE) | pte_flags;
+    kunmap_atomic(pt);
+    if (paging_pt_counted(page_directory_phys, pd_idx)) frame_pt_live_set(pt_phys, PAGES_PER_TABLE);
+
+    uint32_t new_pde = (pt_phys & PAGING_ADDR_MASK) | PAGE_PRESENT | PAGE_RW | PAGE_USER;
+    uint32_t seen;
+    asm volatile("lock cmpxchgl %2, %1"
+                 : "=a"(seen), "+m"(pd_virt[pd_idx])
+                 : "r"(new_pde), "0"(pde)
+                 : "memory", "cc");
+    if (seen != pde) {
+        put_frame(pt_phys);
+        return (seen & PAGE_PRESENT) && !(seen & PAGE_SIZE_4MB) ? (seen & PAGING_PDE_ADDR_MASK_4KB) : 0;
+    }
+    return pt_phys;
+}
+
 int paging_unmap_range(uint32_t *page_directory_phys, uintptr_t virt_start_addr, size_t memsz) {
     PAGING_DEBUG_PRINTF("Enter: V=[0x%#lx - 0x%#lx) in PD Phys %p",
         (unsigned long)virt_start_addr, (unsigned long)(virt_start_addr + memsz), (void*)page_directory_phys);
@@ -2055,6 +2240,10 @@ int paging_unmap_range(uint32_t *page_directory_phys, uintptr_t virt_start_addr,
     }
 
     int unmapped_count = 0; // Counter for pages successfully unmapped
+    // Invalidations are gathered and shot down together; the old frames are
+    // only freed after every CPU running this PD has flushed.
+    tlb_batch_t tlb_batch;
+    tlb_batch_init(&tlb_batch, page_directory_phys);
 
     // Iterate through the virtual address range, processing PDE by PDE
     for (uintptr_t v_addr = v_start; v_addr < v_end; ) { // Increment is handled inside the loop
@@ -2087,12 +2276,29 @@ int paging_unmap_range(uint32_t *page_directory_phys, uintptr_t virt_start_addr,
              continue;
         }
 
-        // This function cannot handle unmapping parts of a 4MB page
+        // A user large page goes whole, or is split and unmapped like any page table
         if (pde & PAGE_SIZE_4MB) {
-            terminal_printf("[Unmap Range] Error: Cannot unmap range overlapping 4MB page at V=0x%#lx (PDE[%u]=0x%lx).\n",
-                            (unsigned long)v_addr, pd_idx, (unsigned long)pde);
-            if (!is_current_pd) paging_temp_unmap(target_pd_virt); // Unmap temp PD if used
-            return -1; // Indicate error
+            uintptr_t large_base = PAGE_LARGE_ALIGN_DOWN(v_addr);
+            if ((pde & PAGE_USER) && v_addr == large_base && v_end - large_base >= PAGE_SIZE_LARGE) {
+                uintptr_t frame_base = pde & PAGING_PDE_ADDR_MASK_4MB;
+                target_pd_virt[pd_idx] = 0;
+                tlb_batch_add_page(&tlb_batch, large_base); // INVLPG drops the whole 4MB entry
+                for (uint32_t f = 0; f < PAGES_PER_TABLE; f++) {
+                    tlb_batch_free_frame(&tlb_batch, frame_base + f * PAGE_SIZE);
+                }
+                unmapped_count += PAGES_PER_TABLE;
+                uintptr_t next_v_addr = large_base + PAGE_SIZE_LARGE;
+                v_addr = (next_v_addr <= v_addr) ? v_end : next_v_addr;
+                continue;
+            }
+            if (!(pde & PAGE_USER) || !paging_split_large_pde(page_directory_phys, target_pd_virt, pd_idx)) {
+                terminal_printf("[Unmap Range] Error: Cannot unmap range overlapping 4MB page at V=0x%#lx (PDE[%u]=0x%lx).\n",
+                                (unsigned long)v_addr, pd_idx, (unsigned long)pde);
+                if (!is_current_pd) paging_temp_unmap(target_pd_virt); // Unmap temp PD if used
+                tlb_batch_flush(&tlb_batch);
+                return -1; // Indicate error
+            }
+            pde = target_pd_virt[pd_idx];
         }
 
         // PDE points to a 4KB Page Table
@@ -2100,6 +2306,7 @@ int paging_unmap_range(uint32_t *page_directory_phys, uintptr_t virt_start_addr,
         uint32_t* pt_virt = NULL; // Virtual address pointer to the Page Table
         bool pt_mapped_here = false; // Flag if we mapped the PT temporarily
         bool pt_freed = false; // Flag if the PT was freed in this iteration
+        uint32_t cleared = 0; // PTEs cleared in this PT
 
         // Get a virtual pointer to the Page Table
         if (is_current_pd) {
@@ -2111,7 +2318,8 @@ int paging_unmap_range(uint32_t *page_directory_phys, uintptr_t virt_start_addr,
              if (!pt_virt) {
                  terminal_printf("[Unmap Range] Error: Failed to temp map target PT %#lx for V=0x%#lx.\n", (unsigned long)pt_phys, (unsigned long)v_addr);
                  if (!is_current_pd) paging_temp_unmap(target_pd_virt); // Unmap temp PD
-                  return -1; // Indicate failure
+                 tlb_batch_flush(&tlb_batch);
+                 return -1; // Indicate failure
              }
              pt_mapped_here = true; // Mark that we mapped it
         }
@@ -2132,9 +2340,16 @@ int paging_unmap_range(uint32_t *page_directory_phys, uintptr_t virt_start_addr,
                 PAGING_DEBUG_PRINTF("  Unmapping V=%p (PTE[%u]=0x%lx -> P=%#lx)",
                                     (void*)v_addr, pt_idx, (unsigned long)pte, (unsigned long)frame_phys);
                 pt_virt[pt_idx] = 0; // Clear the PTE
-                paging_invalidate_page((void*)v_addr); // Invalidate TLB for this virtual address
-                put_frame(frame_phys); // Free the underlying physical frame
+                tlb_batch_add_page(&tlb_batch, v_addr);
+                tlb_batch_free_frame(&tlb_batch, frame_phys); // Freed once the TLBs are clean
                 unmapped_count++; // Increment count of unmapped pages
+                cleared++;
+            } else if (pte_is_swap(pte)) {
+                // Swapped out: never cached in a TLB, only the slot goes
+                pt_virt[pt_idx] = 0;
+                swap_free(pte);
+                unmapped_count++;
+                cleared++;
             }
 
             // Check for overflow before incrementing the virtual address
@@ -2147,18 +2362,16 @@ int paging_unmap_range(uint32_t *page_directory_phys, uintptr_t virt_start_addr,
         } // End inner loop (pages within the current PT)
 
 
-        // Check if the Page Table is now empty *after* processing pages within it
-        uintptr_t start_addr_of_pt_range = PAGE_ALIGN_DOWN(v_addr > PAGE_SIZE ? v_addr - PAGE_SIZE : 0);
-        if (pt_range_end > start_addr_of_pt_range) { // Check if we actually processed pages in this PT
-            if (is_page_table_empty(pt_virt)) {
-                PAGING_DEBUG_PRINTF("PT at Phys 0x%#lx (PDE[%lu]) became empty. Freeing PT.",
-                                    (unsigned long)pt_phys, (unsigned long)pd_idx);
-                target_pd_virt[pd_idx] = 0; // Clear the PDE in the target PD
-                // Invalidate TLB for an address covered by this PDE
-                paging_invalidate_page((void*)start_addr_of_pt_range);
-                put_frame(pt_phys); // Free the page table frame itself
-                pt_freed = true; // Mark that the PT was freed
-            }
+        // Free the Page Table once its live-PTE count says the last entry went
+        if (cleared && paging_pt_counted(page_directory_phys, pd_idx) &&
+            frame_pt_live_add(pt_phys, -(int32_t)cleared) == 0) {
+            PAGING_DEBUG_PRINTF("PT at Phys 0x%#lx (PDE[%lu]) became empty. Freeing PT.",
+                                (unsigned long)pt_phys, (unsigned long)pd_idx);
+            target_pd_virt[pd_idx] = 0; // Clear the PDE in the target PD
+            // Invalidate TLB for an address covered by this PDE
+            tlb_batch_add_page(&tlb_batch, PAGE_ALIGN_DOWN(v_addr - PAGE_SIZE));
+            tlb_batch_free_frame(&tlb_batch, pt_phys); // Free the page table frame itself
+            pt_freed = true; // Mark that the PT was freed
         }
 
         // Unmap the temporary PT mapping if we created one
@@ -2174,6 +2387,7 @@ int paging_unmap_range(uint32_t *page_directory_phys, uintptr_t virt_start_addr,
     if (!is_current_pd) {
         paging_temp_unmap(target_pd_virt);
     }
+    tlb_batch_flush(&tlb_batch);
 
     PAGING_DEBUG_PRINTF("Finished. Unmapped approx %d pages.", unmapped_count);
     return 0; // Success
@@ -2276,3 +2490,74 @@ int paging_unmap_range(uint32_t *page_directory_phys, uintptr_t virt_start_addr,
     }
 }
 
+
+// --- Device MMIO Window ---
+#define MMIO_FREE_SPANS 8 // Spans handed back by failed mappings, reused first-fit
+
+typedef struct {
+    uintptr_t start;
+    size_t    size; // 0: slot unused
+} mmio_span_t;
+
+static uintptr_t g_mmio_next_vaddr = KERNEL_MMIO_VIRT_START;
+static mmio_span_t g_mmio_free[MMIO_FREE_SPANS];
+static spinlock_t g_mmio_lock; // Zero-initialized == unlocked, guards both
+
+/** Takes @p span bytes of window VA, from a freed span first. 0 if exhausted. Lock held. */
+static uintptr_t mmio_va_alloc_locked(size_t span) {
+    for (int i = 0; i < MMIO_FREE_SPANS; i++) {
+        if (g_mmio_free[i].size < span) continue;
+        uintptr_t v_start = g_mmio_free[i].start;
+        g_mmio_free[i].start += span;
+        g_mmio_free[i].size -= span;
+        return v_start;
+    }
+    if (span > KERNEL_MMIO_VIRT_END - g_mmio_next_vaddr) return 0;
+    uintptr_t v_start = g_mmio_next_vaddr;
+    g_mmio_next_vaddr += span;
+    return v_start;
+}
+
+/**
+ * Gives back window VA whose mapping failed. PTEs the failed attempt did
+ * set are left for the next mapping of the span to replace. Lock held.
+ */
+static void mmio_va_free_locked(uintptr_t v_start, size_t span) {
+    if (v_start + span == g_mmio_next_vaddr) {
+        g_mmio_next_vaddr = v_start;
+        return;
+    }
+    for (int i = 0; i < MMIO_FREE_SPANS; i++) {
+        if (g_mmio_free[i].size == 0) {
+            g_mmio_free[i].start = v_start;
+            g_mmio_free[i].size = span;
+            return;
+        }
+    }
+    serial_printf("[Paging MMIO] No free-span slot: V=%#lx (+%zu) stays reserved\n", (unsigned long)v_start, span);
+}
+
+void* paging_map_mmio(uintptr_t phys_addr, size_t size) {
+    if (size == 0) return NULL;
+    uintptr_t p_start = PAGE_ALIGN_DOWN(phys_addr);
+    uintptr_t offset = phys_addr - p_start;
+    size_t span = PAGE_ALIGN_UP(offset + size);
+
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&g_mmio_lock);
+    uintptr_t v_start = mmio_va_alloc_locked(span);
+    spinlock_release_irqrestore(&g_mmio_lock, irq_flags);
+    if (!v_start) {
+        serial_printf("[Paging MMIO] Window exhausted mapping P=%#lx (+%zu)\n", (unsigned long)phys_addr, size);
+        return NULL;
+    }
+
+    if (paging_map_range((uint32_t*)g_kernel_page_directory_phys, v_start, p_start, span,
+                         PTE_KERNEL_DATA_FLAGS | PAGE_PCD | PAGE_PWT) != 0) {
+        serial_printf("[Paging MMIO] Failed to map P=%#lx at V=%#lx\n", (unsigned long)p_start, (unsigned long)v_start);
+        irq_flags = spinlock_acquire_irqsave(&g_mmio_lock);
+        mmio_va_free_locked(v_start, span);
+        spinlock_release_irqrestore(&g_mmio_lock, irq_flags);
+        return NULL;
+    }
+    return (void*)(v_start + offset);
+}
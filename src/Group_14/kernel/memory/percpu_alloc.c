@@ -10,33 +10,22 @@
  #include <kernel/core/types.h>
  #include <kernel/memory/kmalloc_internal.h> // Need KALLOC_HEADER_SIZE, KMALLOC_MIN_ALIGNMENT, ALIGN_UP
  #include <kernel/memory/paging.h> // For PAGE_SIZE
+ #include <kernel/cpu/get_cpu_id.h> // For MAX_CPUS
+ #include <kernel/cpu/percpu.h>     // For the per-CPU allocator pointer
+ #include <kernel/cpu/percpu_counter.h>
+
  #include <libc/stdio.h> // Added for snprintf
 
 
  // ---------------------------------------------------------------------------
- // Constants (Ensure these match kmalloc.c)
+ // Constants
  // ---------------------------------------------------------------------------
- #ifndef SLAB_ALLOC_MAX_USER_SIZE // Max *user* size handled by slabs
- #define SLAB_ALLOC_MAX_USER_SIZE 2048
- #endif
+ // Size classes are the shared KMALLOC_CLASS_* sizes (kmalloc_internal.h),
+ // based on *total object size* (user + header + align). These caches will
+ // store objects of size UP TO the class size.
 
- // Define size classes based on *total object size* (user + header + align)
- // These caches will store objects of size UP TO the class size.
- // Sizes must accommodate KALLOC_HEADER_SIZE.
- // Ensure this definition is compatible with compile-time constant requirements
- static const size_t percpu_total_size_classes[] = {
-     // Calculate based on typical header size (~24 bytes?) + user size
-     ALIGN_UP(KALLOC_HEADER_SIZE + 32,   KMALLOC_MIN_ALIGNMENT), // e.g., ~56 -> Cache 64
-     ALIGN_UP(KALLOC_HEADER_SIZE + 64,   KMALLOC_MIN_ALIGNMENT), // e.g., ~88 -> Cache 128
-     ALIGN_UP(KALLOC_HEADER_SIZE + 128,  KMALLOC_MIN_ALIGNMENT), // e.g., ~152 -> Cache 256? or 192?
-     ALIGN_UP(KALLOC_HEADER_SIZE + 256,  KMALLOC_MIN_ALIGNMENT), // e.g., ~280 -> Cache 512?
-     ALIGN_UP(KALLOC_HEADER_SIZE + 512,  KMALLOC_MIN_ALIGNMENT),
-     ALIGN_UP(KALLOC_HEADER_SIZE + 1024, KMALLOC_MIN_ALIGNMENT),
-     ALIGN_UP(KALLOC_HEADER_SIZE + 2048, KMALLOC_MIN_ALIGNMENT) // Max user size 2048
- };
-
-// This macro definition should follow the array definition at file scope.
-#define NUM_PERCPU_SIZE_CLASSES (sizeof(percpu_total_size_classes) / sizeof(percpu_total_size_classes[0]))
+// One per-CPU cache per shared size class.
+#define NUM_PERCPU_SIZE_CLASSES KMALLOC_NUM_SIZE_CLASSES
 
  // *** The _Static_assert line that was here has been completely removed. ***
 
@@ -49,7 +38,7 @@
  // ---------------------------------------------------------------------------
  typedef struct cpu_allocator {
      slab_cache_t *slab_caches[NUM_PERCPU_SIZE_CLASSES];
-     uint32_t alloc_count;
+     percpu_counter_t alloc_count; // Counted by whichever CPU allocates, summed on read
      uint32_t free_count;
      char name_buffers[NUM_PERCPU_SIZE_CLASSES][32]; // Buffer to hold generated cache names
  } cpu_allocator_t;
@@ -57,29 +46,15 @@
  // Array of per-CPU allocator structures
  static cpu_allocator_t cpu_allocators[MAX_CPUS];
 
- // ---------------------------------------------------------------------------
- // Internal Helper - Find matching size class index for *total* size
- // ---------------------------------------------------------------------------
- // get_size_class_index_for_total (Use size_t for loop)
-static int get_size_class_index_for_total(size_t total_size) {
-    // Use size_t for loop variable
-    for (size_t i = 0; i < NUM_PERCPU_SIZE_CLASSES; i++) {
-        if (total_size <= percpu_total_size_classes[i]) {
-            return (int)i; // Cast index back to int
-        }
-    }
-    return -1; // Size too large for any defined class
-}
-
  // ---------------------------------------------------------------------------
  // Public API Implementation
  // ---------------------------------------------------------------------------
 
  void percpu_kmalloc_init(void) {
     // Runtime check instead of _Static_assert
-    if (percpu_total_size_classes[NUM_PERCPU_SIZE_CLASSES - 1] >= (PAGE_SIZE - 128)) {
+    if (KMALLOC_CLASS_TOTAL_SIZE(NUM_PERCPU_SIZE_CLASSES - 1) >= (PAGE_SIZE - 128)) {
         serial_printf("[percpu] FATAL ERROR: Largest percpu size class (%u) too big for slab (PAGE_SIZE %u).\n",
-                        (unsigned int)percpu_total_size_classes[NUM_PERCPU_SIZE_CLASSES - 1],
+                        (unsigned int)KMALLOC_CLASS_TOTAL_SIZE(NUM_PERCPU_SIZE_CLASSES - 1),
                         (unsigned int)PAGE_SIZE);
         terminal_write("System Halted.\n");
         while(1) { asm volatile("cli; hlt"); } // Halt
@@ -88,11 +63,12 @@ static int get_size_class_index_for_total(size_t total_size) {
     terminal_write("[percpu] Initializing per-CPU slab caches...\n");
     bool success = true;
     for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
-        cpu_allocators[cpu].alloc_count = 0;
+        percpu_counter_reset(&cpu_allocators[cpu].alloc_count);
         cpu_allocators[cpu].free_count = 0;
+        g_percpu[cpu].allocator = &cpu_allocators[cpu];
         // Use size_t for loop variable
         for (size_t i = 0; i < NUM_PERCPU_SIZE_CLASSES; i++) {
-            size_t cache_obj_size = percpu_total_size_classes[i];
+            size_t cache_obj_size = KMALLOC_CLASS_TOTAL_SIZE(i);
             // Use snprintf (ensure it's declared and implemented)
             // TODO: Ensure you have a working snprintf implementation available
             int name_len = snprintf(cpu_allocators[cpu].name_buffers[i], 32, "cpu%d_slab_%u", cpu, (unsigned int)cache_obj_size);
@@ -132,25 +108,30 @@ static int get_size_class_index_for_total(size_t total_size) {
 
  // Modified percpu_kmalloc to accept total size and output cache pointer
  void *percpu_kmalloc(size_t total_required_size, int cpu_id, slab_cache_t **out_cache) {
-     // Basic validation
-     if (cpu_id < 0 || cpu_id >= MAX_CPUS) {
+     cpu_allocator_t *allocator;
+     if (cpu_id == PERCPU_ALLOC_THIS_CPU) {
+         // Common kmalloc path: one %fs load, NULL until percpu_kmalloc_init() ran.
+         allocator = (cpu_allocator_t *)percpu_read(allocator);
+     } else if (cpu_id >= 0 && cpu_id < MAX_CPUS) {
+         allocator = &cpu_allocators[cpu_id];
+     } else {
          serial_printf("[percpu] kmalloc: Invalid CPU ID %d\n", cpu_id);
-         if (out_cache) *out_cache = NULL;
-         return NULL;
+         allocator = NULL;
      }
      if (out_cache) *out_cache = NULL; // Default to NULL
+     if (!allocator) return NULL;
 
      // Find the appropriate size class based on the total size needed
-     int index = get_size_class_index_for_total(total_required_size);
+     int index = kmalloc_size_class(total_required_size);
      if (index < 0) {
          // Total size is too large for any per-cpu slab cache, fallback needed (handled by kmalloc)
          return NULL;
      }
 
-     slab_cache_t *cache = cpu_allocators[cpu_id].slab_caches[index];
+     slab_cache_t *cache = allocator->slab_caches[index];
      if (!cache) {
          // Cache wasn't created during init, fallback needed (handled by kmalloc)
-         // serial_printf("[percpu] Slab cache CPU %d index %d (size %u) not initialized!\n", cpu_id, index, percpu_total_size_classes[index]);
+         // serial_printf("[percpu] Slab cache CPU %d index %d (size %u) not initialized!\n", cpu_id, index, KMALLOC_CLASS_TOTAL_SIZE(index));
          return NULL;
      }
 
@@ -158,13 +139,13 @@ static int get_size_class_index_for_total(size_t total_size) {
       if (cache->internal_slot_size < total_required_size) {
            serial_printf("[percpu] Internal Error: Cache '%s' slot size %d < required %d !\n",
                            cache->name, (int)cache->internal_slot_size, (int)total_required_size);
-           return NULL; // Should not happen if get_size_class_index_for_total is correct
+           return NULL; // Should not happen if kmalloc_size_class is correct
       }
 
      // Attempt to allocate from the specific slab cache for this CPU and size class
      void *obj = slab_alloc(cache); // Returns raw pointer (start of slab object)
      if (obj) {
-         cpu_allocators[cpu_id].alloc_count++;
+         percpu_counter_inc(&allocator->alloc_count);
          if (out_cache) *out_cache = cache; // Return the cache pointer used
      } else {
          // Slab allocation failed (e.g., cache full), fallback handled by kmalloc
@@ -197,7 +178,7 @@ static int get_size_class_index_for_total(size_t total_size) {
      }
      // These stats might be less accurate if kfree cannot update them easily
      if (out_alloc_count) {
-         *out_alloc_count = cpu_allocators[cpu_id].alloc_count;
+         *out_alloc_count = (uint32_t)percpu_counter_sum(&cpu_allocators[cpu_id].alloc_count);
      }
      if (out_free_count) {
          *out_free_count = cpu_allocators[cpu_id].free_count;
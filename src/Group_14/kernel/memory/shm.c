@@ -0,0 +1,210 @@
+/**
+ * @file shm.c
+ * @brief Named shared-memory objects (see shm.h).
+ *
+ * s_shm_lock guards the name table, every object's refcount and its frame
+ * array. Frames are allocated and objects freed outside it.
+ */
+
+#include <kernel/memory/shm.h>
+#include <kernel/fs/vfs/sys_file.h>
+#include <kernel/fs/vfs/fs_errno.h>
+#include <kernel/memory/frame.h>
+#include <kernel/memory/kmalloc.h>
+#include <kernel/memory/paging.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/lib/string.h>
+
+typedef struct shm_object {
+    char       name[SHM_NAME_MAX];
+    uint32_t   refs;        // Open files, plus one while linked
+    size_t     npages;
+    uintptr_t *frames;      // npages entries, 0 until first touched
+} shm_object_t;
+
+static spinlock_t    s_shm_lock;
+static shm_object_t *s_shm_table[SHM_MAX_OBJECTS];
+
+static int shm_close(file_t *file);
+static int shm_fstat(file_t *file, struct vfs_stat *st);
+
+// Never registered or mounted: shm_open_file() builds the vnodes itself.
+// There is no read/write; the object is reached through mmap().
+static vfs_driver_t s_shm_driver = {
+    .fs_name = "shmfs",
+    .close   = shm_close,
+    .fstat   = shm_fstat,
+};
+
+static shm_object_t *file_shm(const file_t *file) {
+    return (shm_object_t *)file->vnode->data;
+}
+
+void shm_init(void) {
+    spinlock_init(&s_shm_lock);
+}
+
+// Caller holds s_shm_lock
+static int shm_find_locked(const char *name) {
+    for (int i = 0; i < SHM_MAX_OBJECTS; i++) {
+        if (s_shm_table[i] && strcmp(s_shm_table[i]->name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static void shm_free(shm_object_t *obj) {
+    for (size_t i = 0; i < obj->npages; i++) {
+        if (obj->frames[i]) put_frame(obj->frames[i]);
+    }
+    kfree(obj->frames);
+    kfree(obj);
+}
+
+static void shm_put(shm_object_t *obj) {
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_shm_lock);
+    bool last = --obj->refs == 0;
+    spinlock_release_irqrestore(&s_shm_lock, irq_flags);
+    if (last) shm_free(obj);
+}
+
+static shm_object_t *shm_alloc(const char *name, size_t size) {
+    shm_object_t *obj = (shm_object_t *)kmalloc(sizeof(shm_object_t));
+    if (!obj) return NULL;
+    memset(obj, 0, sizeof(*obj));
+    strncpy(obj->name, name, SHM_NAME_MAX - 1);
+    obj->npages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    obj->frames = (uintptr_t *)kmalloc(obj->npages * sizeof(uintptr_t));
+    if (!obj->frames) { kfree(obj); return NULL; }
+    memset(obj->frames, 0, obj->npages * sizeof(uintptr_t));
+    return obj;
+}
+
+file_t *shm_open_file(const char *name, int flags, size_t size, int *err) {
+    size_t name_len = name ? strlen(name) : 0;
+    if (name_len == 0 || name_len >= SHM_NAME_MAX) { *err = -EINVAL; return NULL; }
+    int accmode = flags & O_ACCMODE;
+    if (accmode != O_RDONLY && accmode != O_RDWR) { *err = -EINVAL; return NULL; }
+
+    // Built up front so nothing is allocated under the lock; dropped if the
+    // name turns out to exist already.
+    shm_object_t *fresh = NULL;
+    if (flags & O_CREAT) {
+        if (size == 0 || size > SHM_MAX_BYTES) { *err = -EINVAL; return NULL; }
+        fresh = shm_alloc(name, size);
+        if (!fresh) { *err = -ENOMEM; return NULL; }
+    }
+    vnode_t *node = (vnode_t *)kmalloc(sizeof(vnode_t));
+    if (!node) {
+        if (fresh) shm_free(fresh);
+        *err = -ENOMEM;
+        return NULL;
+    }
+
+    shm_object_t *obj = NULL;
+    int result = 0;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_shm_lock);
+    int slot = shm_find_locked(name);
+    if (slot >= 0) {
+        if ((flags & O_CREAT) && (flags & O_EXCL)) {
+            result = -EEXIST;
+        } else {
+            obj = s_shm_table[slot];
+            obj->refs++;
+        }
+    } else if (!fresh) {
+        result = -ENOENT;
+    } else {
+        for (slot = 0; slot < SHM_MAX_OBJECTS && s_shm_table[slot]; slot++) { }
+        if (slot == SHM_MAX_OBJECTS) {
+            result = -ENOSPC;
+        } else {
+            obj = fresh;
+            fresh = NULL;
+            obj->refs = 2; // The name and this open
+            s_shm_table[slot] = obj;
+        }
+    }
+    spinlock_release_irqrestore(&s_shm_lock, irq_flags);
+
+    if (fresh) shm_free(fresh);
+    if (!obj) {
+        kfree(node);
+        *err = result;
+        return NULL;
+    }
+
+    node->data = obj;
+    node->fs_driver = &s_shm_driver;
+    file_t *file = vfs_open_vnode(node, accmode);
+    if (!file) {
+        kfree(node);
+        shm_put(obj);
+        *err = -ENOMEM;
+        return NULL;
+    }
+    return file;
+}
+
+int shm_unlink(const char *name) {
+    shm_object_t *obj = NULL;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_shm_lock);
+    int slot = shm_find_locked(name);
+    if (slot >= 0) {
+        obj = s_shm_table[slot];
+        s_shm_table[slot] = NULL;
+    }
+    spinlock_release_irqrestore(&s_shm_lock, irq_flags);
+
+    if (!obj) return -ENOENT;
+    shm_put(obj); // The name's reference
+    return 0;
+}
+
+bool shm_is_shm(const file_t *file) {
+    return file && file->vnode && file->vnode->fs_driver == &s_shm_driver;
+}
+
+size_t shm_size(const file_t *file) {
+    return file_shm(file)->npages * PAGE_SIZE; // Fixed at creation
+}
+
+uintptr_t shm_get_page(file_t *file, size_t offset) {
+    shm_object_t *obj = file_shm(file);
+    size_t index = offset / PAGE_SIZE;
+    if (index >= obj->npages) return 0;
+
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_shm_lock);
+    uintptr_t frame = obj->frames[index];
+    if (frame) frame_incref(frame);
+    spinlock_release_irqrestore(&s_shm_lock, irq_flags);
+    if (frame) return frame;
+
+    // First touch: whichever faulting process installs a page first wins,
+    // so all of them map the same frame.
+    uintptr_t fresh = frame_alloc_zeroed_mt(MIGRATE_MOVABLE);
+    if (!fresh) return 0;
+    irq_flags = spinlock_acquire_irqsave(&s_shm_lock);
+    frame = obj->frames[index];
+    if (!frame) {
+        frame = fresh;
+        obj->frames[index] = fresh;
+        fresh = 0;
+    }
+    frame_incref(frame); // The caller's; the array keeps the first one
+    spinlock_release_irqrestore(&s_shm_lock, irq_flags);
+    if (fresh) put_frame(fresh);
+    return frame;
+}
+
+static int shm_close(file_t *file) {
+    shm_put(file_shm(file));
+    return FS_SUCCESS;
+}
+
+static int shm_fstat(file_t *file, struct vfs_stat *st) {
+    st->st_mode = VFS_S_IFREG | 0600;
+    st->st_size = (uint32_t)shm_size(file);
+    st->st_blksize = PAGE_SIZE;
+    st->st_blocks = (uint32_t)file_shm(file)->npages;
+    return FS_SUCCESS;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file shrinker.c
+ * @brief Shrinker registry and watermark-driven reclaim.
+ */
+
+#include <kernel/memory/shrinker.h>
+#include <kernel/memory/buddy.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/drivers/display/serial.h>
+
+static spinlock_t        s_shrinker_lock;            // Serializes registration
+static shrinker_t       *s_shrinkers = NULL;
+static volatile uint32_t s_reclaim_active = 0;       // One reclaimer at a time
+static volatile uint32_t s_background_pending = 0;
+
+//============================================================================
+// Helpers
+//============================================================================
+static inline uint32_t shrinker_xchg(volatile uint32_t *p, uint32_t v) {
+    asm volatile("xchgl %0, %1" : "+r"(v), "+m"(*p) : : "memory");
+    return v;
+}
+
+static inline size_t shrinker_low_wmark(void) {
+    return buddy_total_space() / SHRINK_WMARK_LOW_DIV;
+}
+
+static inline size_t shrinker_high_wmark(void) {
+    return buddy_total_space() / SHRINK_WMARK_HIGH_DIV;
+}
+
+//============================================================================
+// Public API
+//============================================================================
+void shrinker_register(shrinker_t *shrinker) {
+    if (!shrinker || !shrinker->scan) return;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_shrinker_lock);
+    shrinker->next = s_shrinkers;
+    asm volatile("" ::: "memory"); // Link is complete before the list can see it
+    s_shrinkers = shrinker;
+    spinlock_release_irqrestore(&s_shrinker_lock, irq_flags);
+    serial_printf("[Shrinker] Registered '%s'\n", shrinker->name ? shrinker->name : "?");
+}
+
+size_t shrink_memory(size_t target, bool may_block) {
+    // Shrinkers free through kfree/slab_free, which may allocate a magazine
+    // and land back here: only one reclaimer runs, nested calls give up.
+    if (shrinker_xchg(&s_reclaim_active, 1)) return 0;
+
+    size_t freed = 0;
+    // The list only ever grows at the head, so it is walked without the lock.
+    for (shrinker_t *s = s_shrinkers; s && freed < target; s = s->next) {
+        if (s->count && s->count() == 0) continue;
+        freed += s->scan(target - freed, may_block);
+    }
+
+    shrinker_xchg(&s_reclaim_active, 0);
+    return freed;
+}
+
+void shrinker_note_free(size_t free_bytes) {
+    if (!s_background_pending && free_bytes < shrinker_low_wmark()) s_background_pending = 1;
+}
+
+bool shrinker_background_pending(void) {
+    return s_background_pending != 0;
+}
+
+void shrinker_background_reclaim(void) {
+    size_t high = shrinker_high_wmark();
+    for (;;) {
+        size_t free_bytes = buddy_free_space();
+        if (free_bytes >= high) break;
+        if (shrink_memory(high - free_bytes, true) == 0) break; // Nothing left to give back
+    }
+    s_background_pending = 0;
+}
@@ -1,15 +1,32 @@
 /**
  * slab.c - Slab Allocator Implementation
- * Features: SMP Safety (Spinlocks), Slab Coloring, Footer Canaries, Reclaim Option.
+ * Features: SMP Safety (Spinlocks), Slab Coloring, Footer Canaries, Reclaim Option,
+ *           Per-CPU Magazines (Bonwick & Adams, "Magazines and Vmem", 2001).
+ *
+ * Free objects are cached in per-CPU magazines (stacks of SLAB_MAGAZINE_ROUNDS
+ * pointers) in front of the slab lists. slab_alloc()/slab_free() pop/push the
+ * CPU's loaded magazine with interrupts disabled and no lock. When it runs
+ * empty or full they swap in the CPU's previous magazine, then trade with the
+ * cache's depot under the cache lock; the slab free lists are only walked
+ * when a magazine is refilled or flushed, a whole magazine at a time.
+ *
+ * Constructors follow the same paper: an object is constructed once, when its
+ * slab is built, and destroyed only when the slab goes back to the buddy
+ * system. Objects stay constructed while free, so callers must free them in
+ * their constructed state (e.g. locks released) and slab_alloc() hands them
+ * out without touching them. A cache with a constructor keeps the free-list
+ * link after the user area so it can't clobber constructed fields.
  */
 
  #include <kernel/memory/slab.h>
  #include <kernel/memory/buddy.h>
  #include <kernel/drivers/display/terminal.h>
+ #include <kernel/drivers/display/serial.h>
  #include <kernel/core/types.h>
  #include <kernel/sync/spinlock.h>
  #include <kernel/lib/string.h>
  #include <kernel/memory/paging.h>     // For memset
+ #include <kernel/memory/shrinker.h>
 
  #ifndef PAGE_SIZE
  #error "PAGE_SIZE is not defined!"
@@ -29,6 +46,18 @@
  // Helper macro for alignment calculation
  #define ALIGN_UP(addr, align) (((uintptr_t)(addr) + (align) - 1) & ~((uintptr_t)(align) - 1))
 
+ // Slab pages are raw, page-aligned buddy blocks (buddy_alloc() would prepend a header)
+ #if (PAGE_SIZE == 4096)
+ #define SLAB_PAGE_ORDER 12
+ #elif (PAGE_SIZE == 8192)
+ #define SLAB_PAGE_ORDER 13
+ #else
+ #error "Unsupported PAGE_SIZE for slab page order calculation."
+ #endif
+
+ // Free-list link of a free object in the slab layer
+ #define SLAB_LINK(cache, obj) (*(void **)((uintptr_t)(obj) + (cache)->link_offset))
+
  // --- Feature Flags ---
  #define ENABLE_SLAB_RECLAIM 1 // Return empty slabs to buddy system
  // #define SLAB_POISON_ALLOC 0xCC // Poison allocated objects
@@ -54,6 +83,19 @@
  // _Static_assert((SLAB_HEADER_SIZE % SLAB_MIN_ALIGNMENT) == 0, "slab_t size not aligned");
 
 
+ /* Magazine: a stack of free objects (see the file comment) */
+ struct slab_magazine {
+     struct slab_magazine *next;  // Depot list link
+     unsigned int rounds;         // Objects in objs[]
+     void *objs[SLAB_MAGAZINE_ROUNDS];
+ };
+
+
+ /* Every live cache, for slab_dump_stats() */
+ static spinlock_t s_cache_list_lock; // Zero-initialized == unlocked
+ static slab_cache_t *s_cache_list = NULL;
+
+
  /* Forward Declarations */
  static slab_t *slab_grow_cache(slab_cache_t *cache);
  static void slab_list_add(slab_t **list_head, slab_t *slab);
@@ -111,8 +153,11 @@
      // Ensure space for free list pointer if object is small
      if (user_obj_size < sizeof(void*)) user_obj_size = sizeof(void*);
 
-     // Calculate internal size needed (user size + footer canary)
-     size_t internal_size_req = user_obj_size + SLAB_FOOTER_SIZE;
+     // Constructed objects keep their free-list link past the user area
+     size_t link_offset = constructor ? ALIGN_UP(user_obj_size, sizeof(void*)) : 0;
+
+     // Calculate internal size needed (user size [+ link] + footer canary)
+     size_t internal_size_req = (constructor ? link_offset + sizeof(void*) : user_obj_size) + SLAB_FOOTER_SIZE;
      // Align the internal size
      size_t internal_slot_size = ALIGN_UP(internal_size_req, final_align);
 
@@ -124,6 +169,7 @@
      cache->name             = name;
      cache->user_obj_size    = user_obj_size; // Store original request size (or min for ptr)
      cache->internal_slot_size = internal_slot_size;
+     cache->link_offset      = link_offset;
      cache->alignment        = final_align;
      cache->objs_per_slab_max = 0; // Calculated in grow_cache
      cache->slab_partial     = NULL;
@@ -133,10 +179,12 @@
      // Ensure color range is valid (e.g., multiple of alignment)
      cache->color_range      = (color_range > 0) ? (color_range & ~(final_align - 1)) : 0;
      if (cache->color_range > PAGE_SIZE / 2) cache->color_range = 0; // Avoid excessive waste
-     cache->alloc_count      = 0;
-     cache->free_count       = 0;
+     cache->depot_full       = NULL;
+     cache->depot_empty      = NULL;
+     cache->depot_nr_full    = 0;
      cache->constructor      = constructor;
      cache->destructor       = destructor;
+     memset(cache->cpu, 0, sizeof(cache->cpu));
      spinlock_init(&cache->lock);
 
      // --- Final Checks ---
@@ -147,6 +195,11 @@
          return NULL;
      }
 
+     uintptr_t list_irq_flags = spinlock_acquire_irqsave(&s_cache_list_lock);
+     cache->next = s_cache_list;
+     s_cache_list = cache;
+     spinlock_release_irqrestore(&s_cache_list_lock, list_irq_flags);
+
      serial_printf("[Slab] Created cache '%s' (user=%d, slot=%d, align=%d, color=%d)\n",
                      name, (int)cache->user_obj_size, (int)cache->internal_slot_size,
                      (int)cache->alignment, cache->color_range);
@@ -162,7 +215,7 @@
      uintptr_t irq_flags = local_irq_save();
      spinlock_release_irqrestore(&cache->lock, irq_flags);
 
-     void *page = buddy_alloc(PAGE_SIZE); // Buddy must be thread-safe
+     void *page = buddy_alloc_raw(SLAB_PAGE_ORDER); // Buddy must be thread-safe
 
      // *** Re-acquire lock AFTER buddy_alloc ***
      irq_flags = spinlock_acquire_irqsave(&cache->lock);
@@ -192,7 +245,7 @@
      if (slab->objs_this_slab == 0) {
          serial_printf("[Slab] Cache '%s': Error - Zero objects fit slab after coloring (offset %d, slot size %d).\n",
                         cache->name, slab->color_offset, (int)cache->internal_slot_size);
-         buddy_free(page); // Free the page
+         buddy_free_raw(page, SLAB_PAGE_ORDER); // Free the page
          return NULL; // Indicate failure
      }
      slab->free_count = slab->objs_this_slab;
@@ -209,11 +262,14 @@
      for (unsigned int i = 0; i < slab->free_count; i++) {
          void *current_obj = (void *)(obj_area_start + i * cache->internal_slot_size);
          void *next_obj = (i < slab->free_count - 1) ? (void *)(obj_area_start + (i + 1) * cache->internal_slot_size) : NULL;
-         *(void **)current_obj = next_obj;
+         SLAB_LINK(cache, current_obj) = next_obj;
          // Write initial footer canary for freed objects
          *(uint32_t*)((uintptr_t)current_obj + cache->internal_slot_size - SLAB_FOOTER_SIZE) = SLAB_FOOTER_MAGIC;
+         if (cache->constructor) {
+             cache->constructor(current_obj); // Once per object lifetime in this slab
+         }
          #ifdef SLAB_POISON_FREE
-         memset((uint8_t*)current_obj + sizeof(void*), SLAB_POISON_FREE, cache->user_obj_size - sizeof(void*)); // Poison only user area
+         else memset((uint8_t*)current_obj + sizeof(void*), SLAB_POISON_FREE, cache->user_obj_size - sizeof(void*)); // Poison only user area
          #endif
      }
 
@@ -221,17 +277,13 @@
      return slab;
  }
 
- /* slab_alloc */
- void *slab_alloc(slab_cache_t *cache) {
-     if (!cache) { /* ... */ return NULL; }
-
-     uintptr_t irq_flags = spinlock_acquire_irqsave(&cache->lock); // *** Acquire Lock ***
-
+ /* slab_take_locked: Pops one object off the slab lists, growing the cache if needed */
+ static void *slab_take_locked(slab_cache_t *cache) {
+     // --- Lock MUST be held ---
      slab_t *slab = cache->slab_partial;
-     void *obj = NULL;
 
      // Try promoting from empty list
-     if (!slab && cache->slab_empty) { /* ... promotion logic as before ... */
+     if (!slab && cache->slab_empty) {
          slab = cache->slab_empty;
          if (slab_list_remove(&cache->slab_empty, slab)) { slab_list_add(&cache->slab_partial, slab); }
          else { slab = NULL; /* Log error */ }
@@ -239,47 +291,234 @@
      // Grow cache if needed
      if (!slab) {
          slab = slab_grow_cache(cache); // Handles lock release/re-acquire for buddy
-         if (!slab) { spinlock_release_irqrestore(&cache->lock, irq_flags); return NULL; }
+         if (!slab) { return NULL; }
          slab_list_add(&cache->slab_partial, slab);
      }
 
-     // --- Perform Allocation (lock is held) ---
-     if (!is_valid_slab(slab) || !slab->free_list) { /* ... handle error ... */ spinlock_release_irqrestore(&cache->lock, irq_flags); return NULL; }
+     if (!is_valid_slab(slab) || !slab->free_list) { /* ... handle error ... */ return NULL; }
 
-     obj = slab->free_list; // Get raw object slot pointer
-     slab->free_list = *(void **)obj; // Advance free list
+     void *obj = slab->free_list; // Get raw object slot pointer
+     slab->free_list = SLAB_LINK(cache, obj); // Advance free list
      slab->free_count--;
-     cache->alloc_count++;
 
      // Update lists if slab became full
-     if (slab->free_count == 0) { /* ... move slab partial -> full ... */
+     if (slab->free_count == 0) {
           if (slab_list_remove(&cache->slab_partial, slab)) { slab_list_add(&cache->slab_full, slab); }
           else { /* Log error */ }
      }
+     return obj;
+ }
+
+ /* slab_give_locked: Returns one object to its slab; slabs that become empty go onto *reclaim */
+ static void slab_give_locked(slab_cache_t *cache, void *obj, slab_t **reclaim) {
+     // --- Lock MUST be held ---
+     slab_t *slab = (slab_t *)((uintptr_t)obj & ~(PAGE_SIZE - 1));
+
+     SLAB_LINK(cache, obj) = slab->free_list; // Prepend to free list
+     slab->free_list = obj;
+     slab->free_count++;
+
+     bool was_full = (slab->free_count == 1);
+     bool is_empty = (slab->free_count == slab->objs_this_slab); // Check against *this slab's* capacity
+     bool list_changed = false;
+
+     if (is_empty) {
+         // Remove from partial or full list
+         if (was_full) { list_changed = slab_list_remove(&cache->slab_full, slab); }
+         else { list_changed = slab_list_remove(&cache->slab_partial, slab); }
+
+         if (!list_changed) {
+              serial_printf("[Slab] Cache '%s': ERROR! Empty slab 0x%lx not found on partial/full list.\n", cache->name, (uintptr_t)slab);
+              return;
+         }
+
+         #ifdef ENABLE_SLAB_RECLAIM
+         slab->next = *reclaim; // Freed by the caller once the lock is dropped
+         *reclaim = slab;
+         #else
+         (void)reclaim;
+         slab_list_add(&cache->slab_empty, slab);
+         #endif
+
+     } else if (was_full) {
+          if (slab_list_remove(&cache->slab_full, slab)) { slab_list_add(&cache->slab_partial, slab); }
+          else { /* Log error */ }
+     }
+ }
 
-     // --- Write Footer Canary (inside lock) ---
-     *(uint32_t*)((uintptr_t)obj + cache->internal_slot_size - SLAB_FOOTER_SIZE) = SLAB_FOOTER_MAGIC;
+ /* slab_destruct_objects: Runs the destructor on every object of a slab that is going away */
+ static void slab_destruct_objects(slab_cache_t *cache, slab_t *slab) {
+     if (!cache->destructor) return;
+     uint8_t *obj_area_start = (uint8_t *)slab + SLAB_HEADER_SIZE + slab->color_offset;
+     for (unsigned int i = 0; i < slab->objs_this_slab; i++) {
+         cache->destructor(obj_area_start + i * cache->internal_slot_size);
+     }
+ }
 
-     // Call constructor (inside lock)
-     if (cache->constructor) {
-         cache->constructor(obj); // Pass pointer to start of user area
+ /* slab_release_pages: Returns reclaimed slabs to the buddy system (lock NOT held) */
+ static void slab_release_pages(slab_t *reclaim) {
+     while (reclaim) {
+         slab_t *next = reclaim->next;
+         slab_destruct_objects(reclaim->cache, reclaim);
+         buddy_free_raw((void *)reclaim, SLAB_PAGE_ORDER);
+         reclaim = next;
      }
+ }
 
-     spinlock_release_irqrestore(&cache->lock, irq_flags); // *** Release Lock ***
+ /* slab_magazine_new: Allocates an empty magazine (cache lock NOT held) */
+ static slab_magazine_t *slab_magazine_new(void) {
+     slab_magazine_t *mag = (slab_magazine_t *)buddy_alloc(sizeof(slab_magazine_t));
+     if (mag) {
+         mag->next = NULL;
+         mag->rounds = 0;
+     }
+     return mag;
+ }
 
+ /* slab_magazine_flush_locked: Returns every object in @mag to the slabs */
+ static void slab_magazine_flush_locked(slab_cache_t *cache, slab_magazine_t *mag, slab_t **reclaim) {
+     while (mag->rounds > 0) {
+         slab_give_locked(cache, mag->objs[--mag->rounds], reclaim);
+     }
+ }
+
+ static inline void slab_cpu_swap(slab_cpu_t *cpu) {
+     slab_magazine_t *tmp = cpu->loaded;
+     cpu->loaded = cpu->previous;
+     cpu->previous = tmp;
+ }
+
+ /* slab_alloc_slow: Both of this CPU's magazines are empty (interrupts disabled) */
+ static void *slab_alloc_slow(slab_cache_t *cache, slab_cpu_t *cpu) {
+     if (cpu->previous && cpu->previous->rounds > 0) {
+         slab_cpu_swap(cpu);
+         return cpu->loaded->objs[--cpu->loaded->rounds];
+     }
+
+     uintptr_t lock_flags = spinlock_acquire_irqsave(&cache->lock);
+
+     // A full magazine from the depot replaces 'loaded'; the empty 'previous' goes back.
+     if (cache->depot_full) {
+         slab_magazine_t *full = cache->depot_full;
+         cache->depot_full = full->next;
+         cache->depot_nr_full--;
+         if (cpu->previous) {
+             cpu->previous->next = cache->depot_empty;
+             cache->depot_empty = cpu->previous;
+         }
+         cpu->previous = cpu->loaded;
+         cpu->loaded = full;
+         spinlock_release_irqrestore(&cache->lock, lock_flags);
+         return full->objs[--full->rounds];
+     }
+
+     // Depot is dry: fill a magazine straight from the slabs.
+     slab_magazine_t *mag = cpu->loaded;
+     if (!mag && cache->depot_empty) {
+         mag = cache->depot_empty;
+         cache->depot_empty = mag->next;
+     }
+     if (!mag) {
+         spinlock_release_irqrestore(&cache->lock, lock_flags);
+         mag = slab_magazine_new();
+         lock_flags = spinlock_acquire_irqsave(&cache->lock);
+         if (!mag) { // No memory for a magazine: hand out a single object
+             void *obj = slab_take_locked(cache);
+             spinlock_release_irqrestore(&cache->lock, lock_flags);
+             return obj;
+         }
+     }
+     cpu->loaded = mag;
+     while (mag->rounds < SLAB_MAGAZINE_ROUNDS) {
+         void *obj = slab_take_locked(cache);
+         if (!obj) break;
+         mag->objs[mag->rounds++] = obj;
+     }
+     spinlock_release_irqrestore(&cache->lock, lock_flags);
+
+     return mag->rounds ? mag->objs[--mag->rounds] : NULL;
+ }
+
+ /* slab_alloc */
+ void *slab_alloc(slab_cache_t *cache) {
+     if (!cache) { /* ... */ return NULL; }
+
+     uintptr_t irq_flags = local_irq_save(); // Keeps us on this CPU's magazines
+     slab_cpu_t *cpu = &cache->cpu[get_cpu_id()];
+     slab_magazine_t *mag = cpu->loaded;
+     void *obj;
+     if (mag && mag->rounds > 0) {
+         obj = mag->objs[--mag->rounds];
+     } else {
+         obj = slab_alloc_slow(cache, cpu);
+     }
+     if (obj) cpu->alloc_count++;
+     local_irq_restore(irq_flags);
+
+     if (!obj) return NULL;
+
+     // The footer canary was written when the slab was built and is verified
+     // intact on every free, and the object is still constructed, so it is
+     // handed out as is.
      #ifdef SLAB_POISON_ALLOC
-     memset(obj, SLAB_POISON_ALLOC, cache->user_obj_size); // Poison user area only
+     if (!cache->constructor) memset(obj, SLAB_POISON_ALLOC, cache->user_obj_size); // Poison user area only
      #endif
 
      return obj; // Return pointer to start of user area
  }
 
+ /* slab_free_slow: Both of this CPU's magazines are full, or it has none (interrupts disabled) */
+ static void slab_free_slow(slab_cache_t *cache, slab_cpu_t *cpu, void *obj) {
+     if (cpu->previous && cpu->previous->rounds < SLAB_MAGAZINE_ROUNDS) {
+         slab_cpu_swap(cpu);
+         cpu->loaded->objs[cpu->loaded->rounds++] = obj;
+         return;
+     }
+
+     slab_t *reclaim = NULL;
+     slab_magazine_t *empty = NULL;
+     uintptr_t lock_flags = spinlock_acquire_irqsave(&cache->lock);
+
+     // Park the full 'previous' in the depot, or empty it into the slabs
+     // once the depot has enough so that idle memory can still be reclaimed.
+     if (cpu->previous) {
+         if (cache->depot_nr_full < SLAB_DEPOT_MAX_FULL) {
+             cpu->previous->next = cache->depot_full;
+             cache->depot_full = cpu->previous;
+             cache->depot_nr_full++;
+         } else {
+             slab_magazine_flush_locked(cache, cpu->previous, &reclaim);
+             empty = cpu->previous;
+         }
+         cpu->previous = NULL;
+     }
+     if (!empty && cache->depot_empty) {
+         empty = cache->depot_empty;
+         cache->depot_empty = empty->next;
+     }
+     if (!empty) {
+         spinlock_release_irqrestore(&cache->lock, lock_flags);
+         empty = slab_magazine_new();
+         lock_flags = spinlock_acquire_irqsave(&cache->lock);
+     }
+
+     if (empty) {
+         cpu->previous = cpu->loaded;
+         cpu->loaded = empty;
+         empty->objs[empty->rounds++] = obj;
+     } else { // No memory for a magazine: straight back to the slab
+         slab_give_locked(cache, obj, &reclaim);
+     }
+     spinlock_release_irqrestore(&cache->lock, lock_flags);
+
+     slab_release_pages(reclaim);
+ }
 
  /* slab_free */
  void slab_free(slab_cache_t *provided_cache, void *obj) {
      if (!obj) { return; }
 
-     // --- Initial Validation (before lock) ---
+     // --- Validation (no lock: a live slab's header never changes) ---
      uintptr_t obj_addr = (uintptr_t)obj; // This is the start of the user area / internal slot
      uintptr_t slab_base = obj_addr & ~(PAGE_SIZE - 1);
      slab_t *slab = (slab_t *)slab_base;
@@ -288,83 +527,44 @@
      if (!cache) { /* ... handle error ... */ return; }
      if (provided_cache && provided_cache != cache) { /* ... log warning ... */ }
 
-     // --- Acquire Lock ---
-     uintptr_t irq_flags = spinlock_acquire_irqsave(&cache->lock);
-
-     // --- Validations (inside lock) ---
-     if (!is_valid_slab(slab) || slab->cache != cache) { /* ... handle error ... */ spinlock_release_irqrestore(&cache->lock, irq_flags); return; }
-
      // Validate address range and alignment using color offset
      uintptr_t data_start = slab_base + SLAB_HEADER_SIZE + slab->color_offset;
      // Note: objs_this_slab might be smaller than cache->objs_per_slab_max due to coloring
      uintptr_t data_end = data_start + (slab->objs_this_slab * cache->internal_slot_size);
      if (obj_addr < data_start || obj_addr >= data_end || ((obj_addr - data_start) % cache->internal_slot_size) != 0) {
-        // <<<<< CORRECTED: Removed erroneous printf, added reasonable one >>>>>
         serial_printf("[Slab] Cache '%s': Invalid free address 0x%lx (Out of bounds or misaligned).\n", cache->name, obj_addr);
-        spinlock_release_irqrestore(&cache->lock, irq_flags); return;
+        return;
      }
 
-     // --- Check Footer Canary (inside lock) ---
+     // --- Check Footer Canary ---
      uint32_t *footer_ptr = (uint32_t*)(obj_addr + cache->internal_slot_size - SLAB_FOOTER_SIZE);
      if (*footer_ptr != SLAB_FOOTER_MAGIC) {
-          // <<<<< CORRECTED: Changed %x to %lx >>>>>
          serial_printf("[Slab] Cache '%s': CORRUPTION DETECTED freeing obj 0x%lx! Footer magic invalid (Expected: 0x%lx, Found: 0x%lx).\n",
                          cache->name, obj_addr, (unsigned long)SLAB_FOOTER_MAGIC, (unsigned long)*footer_ptr);
          // Optionally: Mark slab as corrupt? Abort? For now, just report and abort free.
-         spinlock_release_irqrestore(&cache->lock, irq_flags);
          // Consider a panic or special handling for corrupted memory
          return;
      }
 
-     // Call destructor (inside lock)
-     if (cache->destructor) {
-         cache->destructor(obj);
-     }
-
      #ifdef SLAB_POISON_FREE
-     memset(obj, SLAB_POISON_FREE, cache->user_obj_size); // Poison user area
-     // Re-write footer magic after poisoning if needed, or poison around it
-     *footer_ptr = SLAB_FOOTER_MAGIC;
+     if (!cache->constructor) { // Constructed objects must stay intact
+         memset(obj, SLAB_POISON_FREE, cache->user_obj_size); // Poison user area
+         // Re-write footer magic after poisoning if needed, or poison around it
+         *footer_ptr = SLAB_FOOTER_MAGIC;
+     }
      #endif
 
-     // --- Perform Free (inside lock) ---
-     *(void **)obj = slab->free_list; // Prepend to free list
-     slab->free_list = obj;
-     slab->free_count++;
-     cache->free_count++;
-
-     // --- Update Slab Lists (inside lock) ---
-     bool was_full = (slab->free_count == 1);
-     bool is_empty = (slab->free_count == slab->objs_this_slab); // Check against *this slab's* capacity
-     bool list_changed = false;
-
-     if (is_empty) { /* ... Move from partial/full to empty/reclaim (as before, use objs_this_slab) ... */
-         // Remove from partial or full list
-         if (was_full) { list_changed = slab_list_remove(&cache->slab_full, slab); }
-         else { list_changed = slab_list_remove(&cache->slab_partial, slab); }
-
-         if (!list_changed && slab->free_count != 1) { // Only error if it wasn't found and wasn't just moved from full
-              // <<<<< CORRECTED: Changed %x to %lx >>>>>
-              serial_printf("[Slab] Cache '%s': ERROR! Empty slab 0x%lx not found on partial/full list.\n", cache->name, (uintptr_t)slab);
-         }
-
-         #ifdef ENABLE_SLAB_RECLAIM
-         if (list_changed) {
-             spinlock_release_irqrestore(&cache->lock, irq_flags); // Release before buddy_free
-             buddy_free((void*)slab_base);
-             return; // Slab memory is gone
-         }
-         #else
-         if (list_changed) { slab_list_add(&cache->slab_empty, slab); }
-         #endif
-
-     } else if (was_full) { /* ... Move full -> partial (as before) ... */
-          if (slab_list_remove(&cache->slab_full, slab)) { slab_list_add(&cache->slab_partial, slab); }
-          else { /* Log error */ }
+     // --- Push onto this CPU's magazine ---
+     uintptr_t irq_flags = local_irq_save();
+     slab_cpu_t *cpu = &cache->cpu[get_cpu_id()];
+     slab_magazine_t *mag = cpu->loaded;
+     if (mag && mag->rounds < SLAB_MAGAZINE_ROUNDS) {
+         mag->objs[mag->rounds++] = obj;
+     } else {
+         slab_free_slow(cache, cpu, obj);
      }
-
-     // --- Release Lock (if not already released by reclaim) ---
-     spinlock_release_irqrestore(&cache->lock, irq_flags);
+     cpu->free_count++;
+     local_irq_restore(irq_flags);
  }
 
 
@@ -375,7 +575,42 @@
      if (!cache) return;
      const char * cache_name_copy = cache->name;
 
+     uintptr_t list_irq_flags = spinlock_acquire_irqsave(&s_cache_list_lock);
+     for (slab_cache_t **pp = &s_cache_list; *pp; pp = &(*pp)->next) {
+         if (*pp == cache) { *pp = cache->next; break; }
+     }
+     spinlock_release_irqrestore(&s_cache_list_lock, list_irq_flags);
+
+     // Magazines only hold objects of the slabs freed below, so they are
+     // dropped without returning their objects.
      uintptr_t irq_flags = spinlock_acquire_irqsave(&cache->lock);
+     slab_magazine_t *mags = NULL;
+     for (int cpu = 0; cpu < MAX_CPUS; ++cpu) {
+         slab_magazine_t *per_cpu[2] = {cache->cpu[cpu].loaded, cache->cpu[cpu].previous};
+         for (int m = 0; m < 2; ++m) {
+             if (per_cpu[m]) { per_cpu[m]->next = mags; mags = per_cpu[m]; }
+         }
+         cache->cpu[cpu].loaded = cache->cpu[cpu].previous = NULL;
+     }
+     slab_magazine_t *depots[] = {cache->depot_full, cache->depot_empty};
+     for (int d = 0; d < 2; ++d) {
+         while (depots[d]) {
+             slab_magazine_t *next = depots[d]->next;
+             depots[d]->next = mags;
+             mags = depots[d];
+             depots[d] = next;
+         }
+     }
+     cache->depot_full = cache->depot_empty = NULL;
+     cache->depot_nr_full = 0;
+     spinlock_release_irqrestore(&cache->lock, irq_flags);
+     while (mags) {
+         slab_magazine_t *next = mags->next;
+         buddy_free(mags);
+         mags = next;
+     }
+
+     irq_flags = spinlock_acquire_irqsave(&cache->lock);
      serial_printf("[Slab] Destroying cache '%s'...\n", cache_name_copy);
      slab_t *curr, *next;
      int freed_count = 0;
@@ -389,7 +624,11 @@
          while (curr) {
              next = curr->next;
              if (!is_valid_slab(curr)) { /* Log warning */ }
-             else { buddy_free((void *)curr); freed_count++; }
+             else {
+                 slab_destruct_objects(cache, curr);
+                 buddy_free_raw((void *)curr, SLAB_PAGE_ORDER);
+                 freed_count++;
+             }
              curr = next;
          }
          if (i < 2) { irq_flags = spinlock_acquire_irqsave(&cache->lock); } // Re-acquire for next list/final free
@@ -405,10 +644,102 @@
 
  /* slab_cache_stats */
  void slab_cache_stats(slab_cache_t *cache, unsigned long *out_alloc, unsigned long *out_free) {
-     // ... (Implementation remains the same - acquire lock, read stats, release lock) ...
      if (!cache) return;
-     uintptr_t irq_flags = spinlock_acquire_irqsave(&cache->lock);
-     if (out_alloc) *out_alloc = cache->alloc_count;
-     if (out_free) *out_free = cache->free_count;
-     spinlock_release_irqrestore(&cache->lock, irq_flags);
- }
\ No newline at end of file
+     unsigned long allocs = 0, frees = 0;
+     for (int cpu = 0; cpu < MAX_CPUS; ++cpu) {
+         allocs += cache->cpu[cpu].alloc_count;
+         frees += cache->cpu[cpu].free_count;
+     }
+     if (out_alloc) *out_alloc = allocs;
+     if (out_free) *out_free = frees;
+ }
+
+ /* slab_dump_stats */
+ void slab_dump_stats(void) {
+     serial_printf("[Slab] --- Cache statistics ---\n");
+     uintptr_t irq_flags = spinlock_acquire_irqsave(&s_cache_list_lock);
+     for (slab_cache_t *cache = s_cache_list; cache; cache = cache->next) {
+         unsigned long allocs = 0, frees = 0;
+         slab_cache_stats(cache, &allocs, &frees);
+         serial_printf("  %s: slot=%d allocs=%lu frees=%lu in_use=%lu\n",
+                       cache->name, (int)cache->internal_slot_size, allocs, frees, allocs - frees);
+     }
+     spinlock_release_irqrestore(&s_cache_list_lock, irq_flags);
+ }
+
+ /* slab_for_each_cache */
+ void slab_for_each_cache(void (*fn)(slab_cache_t *cache, void *arg), void *arg) {
+     if (!fn) return;
+     uintptr_t irq_flags = spinlock_acquire_irqsave(&s_cache_list_lock);
+     for (slab_cache_t *cache = s_cache_list; cache; cache = cache->next) fn(cache, arg);
+     spinlock_release_irqrestore(&s_cache_list_lock, irq_flags);
+ }
+
+ //============================================================================
+ // Reclaim
+ //============================================================================
+ // Objects parked in the depots' full magazines keep their slabs alive. Under
+ // pressure they are flushed back, and slabs left empty go to the buddy
+ // system; empty magazines are freed too. Per-CPU magazines are left alone:
+ // only their CPU may touch them.
+
+ static size_t slab_shrink_count(void) {
+     size_t bytes = 0;
+     for (slab_cache_t *cache = s_cache_list; cache; cache = cache->next) {
+         bytes += (size_t)cache->depot_nr_full * SLAB_MAGAZINE_ROUNDS * cache->internal_slot_size;
+     }
+     return bytes; // Unlocked snapshot; an estimate is all the caller needs
+ }
+
+ static size_t slab_shrink_scan(size_t target, bool may_block) {
+     size_t freed = 0;
+     uintptr_t list_irq_flags;
+     if (may_block) {
+         list_irq_flags = spinlock_acquire_irqsave(&s_cache_list_lock);
+     } else if (!spinlock_try_acquire_irqsave(&s_cache_list_lock, &list_irq_flags)) {
+         return 0;
+     }
+
+     for (slab_cache_t *cache = s_cache_list; cache && freed < target; cache = cache->next) {
+         uintptr_t lock_flags;
+         if (may_block) {
+             lock_flags = spinlock_acquire_irqsave(&cache->lock);
+         } else if (!spinlock_try_acquire_irqsave(&cache->lock, &lock_flags)) {
+             continue; // Held further up our own stack, or busy elsewhere
+         }
+         slab_t *reclaim = NULL;
+         slab_magazine_t *mags = cache->depot_empty;
+         cache->depot_empty = NULL;
+         while (cache->depot_full) {
+             slab_magazine_t *mag = cache->depot_full;
+             cache->depot_full = mag->next;
+             slab_magazine_flush_locked(cache, mag, &reclaim);
+             mag->next = mags;
+             mags = mag;
+         }
+         cache->depot_nr_full = 0;
+         spinlock_release_irqrestore(&cache->lock, lock_flags);
+
+         for (slab_t *slab = reclaim; slab; slab = slab->next) freed += PAGE_SIZE;
+         slab_release_pages(reclaim);
+         while (mags) {
+             slab_magazine_t *next = mags->next;
+             buddy_free(mags);
+             freed += sizeof(slab_magazine_t);
+             mags = next;
+         }
+     }
+     spinlock_release_irqrestore(&s_cache_list_lock, list_irq_flags);
+     return freed;
+ }
+
+ static shrinker_t s_slab_shrinker = {
+     .name  = "slab",
+     .count = slab_shrink_count,
+     .scan  = slab_shrink_scan,
+ };
+
+ /* slab_shrinker_init */
+ void slab_shrinker_init(void) {
+     shrinker_register(&s_slab_shrinker);
+ }
@@ -0,0 +1,426 @@
+/**
+ * @file swap.c
+ * @brief Swap area, slot references and CLOCK-driven eviction of anonymous pages.
+ */
+
+#include <kernel/memory/swap.h>
+#include <kernel/memory/mm.h>
+#include <kernel/memory/frame.h>
+#include <kernel/memory/paging.h>
+#include <kernel/memory/kmalloc.h>
+#include <kernel/memory/shrinker.h>
+#include <kernel/drivers/storage/disk.h>
+#include <kernel/process/process.h>
+#include <kernel/process/scheduler.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/sync/mutex.h>
+#include <kernel/sync/preempt.h>
+#include <kernel/lib/bitmap.h>
+#include <kernel/lib/div64.h>
+#include <kernel/lib/string.h>
+#include <kernel/fs/vfs/fs_errno.h>
+#include <kernel/drivers/display/serial.h>
+
+#define SWAP_COUNT_MAX    0xFFFFu // Saturated: fork() refuses another reference
+#define SWAP_SCAN_PROCS   64      // Processes one background scan looks at
+
+typedef struct swap_area {
+    disk_t     disk;
+    uint64_t   start_lba;        // Sector of slot 0
+    uint32_t   sectors_per_slot;
+    uint32_t   nr_slots;         // Including the unused slot 0
+    uint32_t   nr_used;
+    uint32_t   cursor;           // Next slot to try: a batch gets neighbouring slots
+    uint16_t  *counts;           // References per slot: PTEs, writeback, readers
+    uint32_t  *used;             // Bit per slot with a non-zero count
+    void      *bounce;           // Writeback copy of a highmem frame (s_evict_lock)
+} swap_area_t;
+
+// A slot whose page is being written: reads take the frame instead
+typedef struct swap_writeback {
+    uint32_t  entry;             // 0 = unused
+    uintptr_t phys;
+} swap_writeback_t;
+
+typedef struct swap_scan_procs {
+    uint32_t     nr;
+    uint32_t     pid[SWAP_SCAN_PROCS];
+    mm_struct_t *mm[SWAP_SCAN_PROCS];
+} swap_scan_procs_t;
+
+static spinlock_t        s_swap_lock;     // Area, counts, writeback table, stats
+static swap_area_t       s_swap;
+static volatile bool     s_swap_active = false;
+static swap_writeback_t  s_wb[SWAP_CLUSTER];
+static swap_stats_t      s_stats;
+
+// One eviction at a time: owns s_victims, s_scan and the clock hand
+static kmutex_t          s_evict_lock;
+static swap_victim_t     s_victims[SWAP_CLUSTER];
+static swap_scan_procs_t s_scan;
+static uint32_t          s_hand_pid = 0;  // Process and address the background sweep resumes at
+static uintptr_t         s_hand_addr = 0;
+
+//============================================================================
+// Slots (s_swap_lock held)
+//============================================================================
+static inline bool swap_slot_valid(uint32_t slot) {
+    return slot != 0 && slot < s_swap.nr_slots;
+}
+
+static void swap_slot_put_locked(uint32_t slot) {
+    if (--s_swap.counts[slot] == 0) {
+        bitmap_clear(s_swap.used, slot);
+        s_swap.nr_used--;
+    }
+}
+
+static swap_writeback_t *swap_wb_find_locked(uint32_t entry) {
+    for (uint32_t i = 0; i < SWAP_CLUSTER; i++) {
+        if (s_wb[i].entry == entry) return &s_wb[i];
+    }
+    return NULL;
+}
+
+//============================================================================
+// I/O
+//============================================================================
+/** @brief Moves one page between the frame at @p phys and @p slot. May sleep. */
+static int swap_io(uint32_t slot, uintptr_t phys, bool write) {
+    uint64_t lba = s_swap.start_lba + (uint64_t)slot * s_swap.sectors_per_slot;
+    size_t count = s_swap.sectors_per_slot;
+    if (paging_phys_is_direct(phys)) {
+        void *page = paging_phys_to_virt(phys);
+        return write ? disk_write_raw_sectors(&s_swap.disk, lba, page, count)
+                     : disk_read_raw_sectors(&s_swap.disk, lba, page, count);
+    }
+
+    // Highmem: kmap_atomic slots can't be held across a sleep, so bounce.
+    // Writes are serialized by s_evict_lock and share one buffer.
+    void *buf = write ? s_swap.bounce : kmalloc(PAGE_SIZE);
+    if (!buf) return FS_ERR_OUT_OF_MEMORY;
+    int ret;
+    if (write) {
+        void *src = kmap_atomic(phys);
+        memcpy(buf, src, PAGE_SIZE);
+        kunmap_atomic(src);
+        ret = disk_write_raw_sectors(&s_swap.disk, lba, buf, count);
+    } else {
+        ret = disk_read_raw_sectors(&s_swap.disk, lba, buf, count);
+        if (ret == FS_SUCCESS) {
+            void *dst = kmap_atomic(phys);
+            memcpy(dst, buf, PAGE_SIZE);
+            kunmap_atomic(dst);
+        }
+        kfree(buf);
+    }
+    return ret;
+}
+
+//============================================================================
+// Public API: entries
+//============================================================================
+bool swap_active(void) {
+    return s_swap_active;
+}
+
+uint32_t swap_alloc_entry(uintptr_t phys) {
+    uint32_t entry = 0;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_swap_lock);
+    swap_writeback_t *wb = s_swap_active ? swap_wb_find_locked(0) : NULL;
+    if (wb) {
+        uint32_t slot = bitmap_find_next_zero(s_swap.used, s_swap.nr_slots, s_swap.cursor);
+        if (slot >= s_swap.nr_slots) slot = bitmap_find_next_zero(s_swap.used, s_swap.nr_slots, 1);
+        if (slot < s_swap.nr_slots) {
+            s_swap.counts[slot] = 2; // The PTE's and the writeback's
+            bitmap_set(s_swap.used, slot);
+            s_swap.nr_used++;
+            s_swap.cursor = slot + 1;
+            entry = swap_slot_entry(slot);
+            wb->entry = entry;
+            wb->phys = phys;
+        }
+    }
+    spinlock_release_irqrestore(&s_swap_lock, irq_flags);
+    return entry;
+}
+
+void swap_cancel_entry(uint32_t entry) {
+    uint32_t slot = swap_entry_slot(entry);
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_swap_lock);
+    swap_writeback_t *wb = swap_wb_find_locked(entry);
+    if (wb) wb->entry = 0;
+    s_swap.counts[slot] = 1;
+    swap_slot_put_locked(slot);
+    if (s_swap.cursor == slot + 1) s_swap.cursor = slot; // Keep the batch contiguous
+    spinlock_release_irqrestore(&s_swap_lock, irq_flags);
+}
+
+bool swap_dup(uint32_t entry) {
+    uint32_t slot = swap_entry_slot(entry);
+    bool ok = false;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_swap_lock);
+    if (swap_slot_valid(slot) && s_swap.counts[slot] && s_swap.counts[slot] < SWAP_COUNT_MAX) {
+        s_swap.counts[slot]++;
+        ok = true;
+    }
+    spinlock_release_irqrestore(&s_swap_lock, irq_flags);
+    return ok;
+}
+
+void swap_free(uint32_t entry) {
+    uint32_t slot = swap_entry_slot(entry);
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_swap_lock);
+    bool ok = swap_slot_valid(slot) && s_swap.counts[slot] != 0;
+    if (ok) swap_slot_put_locked(slot);
+    spinlock_release_irqrestore(&s_swap_lock, irq_flags);
+    if (!ok) serial_printf("[Swap] Warning: free of unused entry %#lx\n", (unsigned long)entry);
+}
+
+uintptr_t swap_writeback_frame(uint32_t entry) {
+    uintptr_t phys = 0;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_swap_lock);
+    swap_writeback_t *wb = swap_wb_find_locked(entry);
+    if (wb) {
+        phys = wb->phys;
+        get_frame(phys);
+        s_stats.wb_hits++;
+    }
+    spinlock_release_irqrestore(&s_swap_lock, irq_flags);
+    return phys;
+}
+
+int swap_read_page(uint32_t entry, uintptr_t phys, bool readahead) {
+    uint32_t slot = swap_entry_slot(entry);
+    int ret = FS_SUCCESS;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_swap_lock);
+    if (!swap_slot_valid(slot) || s_swap.counts[slot] == 0) ret = FS_ERR_NOT_FOUND;
+    else if (swap_wb_find_locked(entry)) ret = FS_ERR_BUSY; // The disk copy isn't there yet
+    else s_swap.counts[slot]++; // Keeps the slot from being reused during the read
+    spinlock_release_irqrestore(&s_swap_lock, irq_flags);
+    if (ret != FS_SUCCESS) return ret;
+
+    ret = swap_io(slot, phys, false);
+
+    irq_flags = spinlock_acquire_irqsave(&s_swap_lock);
+    swap_slot_put_locked(slot);
+    if (ret == FS_SUCCESS) {
+        s_stats.swapins++;
+        if (readahead) s_stats.readahead++;
+    } else {
+        s_stats.io_errors++;
+    }
+    spinlock_release_irqrestore(&s_swap_lock, irq_flags);
+    return ret;
+}
+
+//============================================================================
+// Eviction (s_evict_lock held)
+//============================================================================
+/**
+ * @brief Writes out the @p nr pages mm_swap_scan() unmapped from @p mm and
+ * releases their frames. A page that can't be written goes back into its
+ * PTE. Returns the pages written.
+ */
+static uint32_t swap_writeback(mm_struct_t *mm, uint32_t nr) {
+    uint32_t written = 0;
+    for (uint32_t i = 0; i < nr; i++) {
+        const swap_victim_t *v = &s_victims[i];
+        uintptr_t phys = v->pte & PAGING_ADDR_MASK;
+        int ret = swap_io(swap_entry_slot(v->entry), phys, true);
+        bool restored = ret != FS_SUCCESS && mm_swap_restore(mm, v);
+
+        uintptr_t irq_flags = spinlock_acquire_irqsave(&s_swap_lock);
+        swap_writeback_t *wb = swap_wb_find_locked(v->entry);
+        if (wb) wb->entry = 0;
+        swap_slot_put_locked(swap_entry_slot(v->entry)); // The writeback's reference
+        if (ret == FS_SUCCESS) s_stats.swapouts++;
+        else s_stats.io_errors++;
+        spinlock_release_irqrestore(&s_swap_lock, irq_flags);
+
+        if (!restored) put_frame(phys); // The PTE's reference, handed over by the scan
+        if (ret == FS_SUCCESS) written++;
+    }
+    if (nr && written < nr) {
+        serial_printf("[Swap] Warning: %lu of %lu pages could not be written\n",
+                      (unsigned long)(nr - written), (unsigned long)nr);
+    }
+    return written;
+}
+
+// One sweep step over @p mm from *@p hand; accounts the second chances
+static uint32_t swap_evict_step(mm_struct_t *mm, uintptr_t *hand, uint32_t *budget, uint32_t max_out) {
+    uint32_t second_chance = 0;
+    uint32_t nr = mm_swap_scan(mm, hand, budget, s_victims, max_out, &second_chance);
+    if (second_chance) {
+        uintptr_t irq_flags = spinlock_acquire_irqsave(&s_swap_lock);
+        s_stats.second_chance += second_chance;
+        spinlock_release_irqrestore(&s_swap_lock, irq_flags);
+    }
+    return swap_writeback(mm, nr);
+}
+
+uint32_t swap_reclaim_mm(mm_struct_t *mm, uint32_t nr_pages) {
+    if (!s_swap_active || !mm || !nr_pages) return 0;
+    kmutex_lock(&s_evict_lock);
+    uint32_t budget = SWAP_SCAN_BUDGET;
+    uint32_t written = 0;
+    // Two laps at most: the first may only take accessed bits away
+    for (uint32_t laps = 0; budget && written < nr_pages && laps < 2; ) {
+        uint32_t want = nr_pages - written;
+        written += swap_evict_step(mm, &mm->swap_hand, &budget, want < SWAP_CLUSTER ? want : SWAP_CLUSTER);
+        if (mm->swap_hand == 0) laps++;
+    }
+    kmutex_unlock(&s_evict_lock);
+    return written;
+}
+
+// scheduler_for_each_process() callback, under the task list lock
+static void swap_collect_process(pcb_t *proc, void *arg) {
+    swap_scan_procs_t *scan = (swap_scan_procs_t *)arg;
+    if (scan->nr >= SWAP_SCAN_PROCS) return;
+    scan->pid[scan->nr] = proc->pid;
+    scan->mm[scan->nr] = proc->mm;
+    scan->nr++;
+}
+
+/**
+ * @brief Background eviction across all processes, resuming at the clock
+ * hand. Runs only in the reaper, which is also the only thread that
+ * destroys address spaces, so the mms collected here stay valid after the
+ * task list lock is dropped.
+ */
+static uint32_t swap_reclaim_all(uint32_t nr_pages) {
+    kmutex_lock(&s_evict_lock);
+    s_scan.nr = 0;
+    scheduler_for_each_process(swap_collect_process, &s_scan);
+
+    uint32_t idx = 0;
+    while (idx < s_scan.nr && s_scan.pid[idx] != s_hand_pid) idx++;
+    if (idx == s_scan.nr) { // That process is gone: start over with the first
+        idx = 0;
+        s_hand_addr = 0;
+    }
+
+    uint32_t budget = SWAP_SCAN_BUDGET;
+    uint32_t written = 0;
+    for (uint32_t visited = 0; s_scan.nr && budget && written < nr_pages && visited <= s_scan.nr; ) {
+        s_hand_pid = s_scan.pid[idx];
+        uint32_t want = nr_pages - written;
+        written += swap_evict_step(s_scan.mm[idx], &s_hand_addr, &budget, want < SWAP_CLUSTER ? want : SWAP_CLUSTER);
+        if (s_hand_addr == 0) {
+            idx = (idx + 1) % s_scan.nr;
+            visited++;
+        }
+        cond_resched();
+    }
+    if (s_scan.nr) s_hand_pid = s_scan.pid[idx];
+    kmutex_unlock(&s_evict_lock);
+    return written;
+}
+
+//============================================================================
+// Shrinker
+//============================================================================
+static size_t swap_shrink_count(void) {
+    if (!s_swap_active) return 0;
+    return (size_t)(s_swap.nr_slots - 1 - s_swap.nr_used) * PAGE_SIZE;
+}
+
+/** @brief Writes cold pages out; only background reclaim may wait for the disk. */
+static size_t swap_shrink_scan(size_t target, bool may_block) {
+    if (!may_block || !s_swap_active) return 0;
+    uint32_t nr_pages = (uint32_t)(target / PAGE_SIZE) + 1;
+    return (size_t)swap_reclaim_all(nr_pages) * PAGE_SIZE;
+}
+
+static shrinker_t s_swap_shrinker = {
+    .name  = "swap",
+    .count = swap_shrink_count,
+    .scan  = swap_shrink_scan,
+};
+
+void swap_shrinker_init(void) {
+    kmutex_init(&s_evict_lock, false);
+    // The newest shrinker is asked first: registered before the caches, swap is the last resort
+    shrinker_register(&s_swap_shrinker);
+}
+
+//============================================================================
+// Activation and stats
+//============================================================================
+int swap_on(const char *device) {
+    if (!device || !device[0]) return FS_ERR_INVALID_PARAM;
+    if (s_swap_active) return FS_ERR_BUSY;
+
+    disk_t *disk = &s_swap.disk;
+    int ret = disk_init(disk, device);
+    if (ret != FS_SUCCESS) return ret;
+    uint32_t sector_size = disk->blk_dev.sector_size;
+    if (sector_size == 0 || PAGE_SIZE % sector_size != 0) return FS_ERR_NOT_SUPPORTED;
+
+    // A swap partition, or the whole disk if nothing else lives on it
+    uint64_t start_lba = 0;
+    uint64_t sectors = disk_get_total_sectors(disk);
+    if (disk->has_mbr) {
+        partition_t *swap_part = NULL;
+        bool other = false;
+        for (uint8_t i = 0; i < MAX_PARTITIONS_PER_DISK; i++) {
+            partition_t *part = disk_get_partition(disk, i);
+            if (!part) continue;
+            if (part->type == SWAP_PARTITION_TYPE && !swap_part) swap_part = part;
+            else other = true;
+        }
+        if (swap_part) {
+            start_lba = swap_part->start_lba;
+            sectors = swap_part->total_sectors;
+        } else if (other) {
+            serial_printf("[Swap] %s has partitions but none of type %#x\n", device, SWAP_PARTITION_TYPE);
+            return FS_ERR_INVALID_FORMAT;
+        }
+    }
+
+    uint32_t sectors_per_slot = PAGE_SIZE / sector_size;
+    uint64_t slots = div_u64_rem(sectors, sectors_per_slot, NULL);
+    uint32_t nr_slots = slots > SWAP_MAX_SLOTS ? SWAP_MAX_SLOTS : (uint32_t)slots;
+    if (nr_slots < 2) return FS_ERR_NO_SPACE;
+
+    uint16_t *counts = kmalloc(nr_slots * sizeof(uint16_t));
+    uint32_t *used = kmalloc(BITMAP_WORDS(nr_slots) * sizeof(uint32_t));
+    void *bounce = kmalloc(PAGE_SIZE);
+    if (!counts || !used || !bounce) {
+        if (counts) kfree(counts);
+        if (used) kfree(used);
+        if (bounce) kfree(bounce);
+        return FS_ERR_OUT_OF_MEMORY;
+    }
+    memset(counts, 0, nr_slots * sizeof(uint16_t));
+    bitmap_zero(used, nr_slots);
+    bitmap_set(used, 0); // Entry 0 would look like an empty PTE's slot
+
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_swap_lock);
+    s_swap.start_lba = start_lba;
+    s_swap.sectors_per_slot = sectors_per_slot;
+    s_swap.nr_slots = nr_slots;
+    s_swap.nr_used = 0;
+    s_swap.cursor = 1;
+    s_swap.counts = counts;
+    s_swap.used = used;
+    s_swap.bounce = bounce;
+    strncpy(s_stats.device, device, sizeof(s_stats.device) - 1);
+    s_stats.device[sizeof(s_stats.device) - 1] = '\0';
+    s_swap_active = true;
+    spinlock_release_irqrestore(&s_swap_lock, irq_flags);
+
+    serial_printf("[Swap] %s: %lu slots from LBA %lu\n", device, (unsigned long)(nr_slots - 1),
+                  (unsigned long)start_lba);
+    return FS_SUCCESS;
+}
+
+void swap_get_stats(swap_stats_t *out) {
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_swap_lock);
+    *out = s_stats;
+    out->nr_slots = s_swap_active ? s_swap.nr_slots - 1 : 0;
+    out->nr_used = s_swap.nr_used;
+    spinlock_release_irqrestore(&s_swap_lock, irq_flags);
+}
@@ -0,0 +1,162 @@
+/**
+ * @file tlb.c
+ * @brief Batched TLB invalidation and IPI shootdown.
+ */
+
+#include <kernel/memory/tlb.h>
+#include <kernel/memory/paging.h>
+#include <kernel/memory/frame.h>
+#include <kernel/cpu/percpu.h>
+#include <kernel/cpu/get_cpu_id.h>
+#include <kernel/cpu/lapic.h>
+#include <kernel/cpu/idt.h>
+#include <kernel/cpu/smp.h>
+#include <kernel/sync/spinlock.h>
+
+/** @brief The one request in flight; owned by whoever holds s_tlb_lock. */
+typedef struct tlb_request {
+    uint32_t  *pgd_phys;    // NULL = kernel range, flush on every CPU
+    uintptr_t  start;
+    uintptr_t  end;
+} tlb_request_t;
+
+volatile uint32_t        g_tlb_pending_cpus = 0;
+static volatile uint32_t s_ready_cpus = 0;   // CPUs that take shootdown IPIs
+static spinlock_t        s_tlb_lock;          // Serializes senders
+static tlb_request_t     s_request;
+
+//============================================================================
+// Local Flush
+//============================================================================
+static inline uint32_t read_cr3(void) {
+    uint32_t v;
+    asm volatile("mov %%cr3, %0" : "=r"(v));
+    return v;
+}
+
+static inline void reload_cr3(void) {
+    asm volatile("mov %%cr3, %%eax\n\tmov %%eax, %%cr3" : : : "eax", "memory");
+}
+
+/** @brief Flushes global entries too: clearing CR4.PGE drops the whole TLB. */
+static void flush_all_including_global(void) {
+    uint32_t cr4;
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+    if (cr4 & CR4_PGE) {
+        asm volatile("mov %0, %%cr4" : : "r"(cr4 & ~CR4_PGE) : "memory");
+        asm volatile("mov %0, %%cr4" : : "r"(cr4) : "memory");
+    } else {
+        reload_cr3();
+    }
+}
+
+static void flush_local(uint32_t *pgd_phys, uintptr_t start, uintptr_t end) {
+    if (pgd_phys && read_cr3() != (uint32_t)(uintptr_t)pgd_phys) return; // Not loaded here
+    if ((end - start) / PAGE_SIZE > TLB_FULL_FLUSH_PAGES) {
+        if (pgd_phys) reload_cr3(); // User entries are never global
+        else flush_all_including_global();
+        return;
+    }
+    for (uintptr_t addr = start; addr < end; addr += PAGE_SIZE) {
+        paging_invalidate_page((void *)addr);
+        if (addr > UINTPTR_MAX - PAGE_SIZE) break;
+    }
+}
+
+//============================================================================
+// Remote Requests
+//============================================================================
+void tlb_service_pending(void) {
+    uint32_t bit = 1u << get_cpu_id();
+    if (!(g_tlb_pending_cpus & bit)) return;
+    flush_local(s_request.pgd_phys, s_request.start, s_request.end);
+    asm volatile("lock andl %1, %0" : "+m"(g_tlb_pending_cpus) : "r"(~bit) : "memory", "cc");
+}
+
+static void ipi_tlb_shootdown_handler(isr_frame_t *frame) {
+    (void)frame;
+    tlb_service_pending(); // May already have been served from a spin loop
+    lapic_eoi();
+}
+
+void tlb_init_cpu(uint32_t cpu) {
+    if (cpu == 0) {
+        spinlock_init(&s_tlb_lock);
+        register_int_handler(IPI_TLB_SHOOTDOWN_VECTOR, ipi_tlb_shootdown_handler, NULL);
+    }
+    asm volatile("lock orl %1, %0" : "+m"(s_ready_cpus) : "r"(1u << cpu) : "memory", "cc");
+}
+
+void tlb_shootdown(uint32_t *pgd_phys, uintptr_t start, uintptr_t end) {
+    start = PAGE_ALIGN_DOWN(start);
+    if (end <= start) return;
+
+    uintptr_t irq_flags = local_irq_save();
+    flush_local(pgd_phys, start, end);
+
+    uint32_t self = (uint32_t)get_cpu_id();
+    if (!(s_ready_cpus & ~(1u << self))) { // Uniprocessor: nobody else to tell
+        local_irq_restore(irq_flags);
+        return;
+    }
+
+    // The lock's LOCK XADD also orders the caller's PTE stores before the
+    // active_pgd reads below: a CPU that loads this CR3 later walks the new
+    // tables, one that already has it is in the mask.
+    spinlock_acquire_irqsave(&s_tlb_lock);
+    uint32_t targets = 0;
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (cpu == self || !(s_ready_cpus & (1u << cpu))) continue;
+        if (!pgd_phys || g_percpu[cpu].active_pgd == (uintptr_t)pgd_phys) targets |= 1u << cpu;
+    }
+    if (targets) {
+        s_request.pgd_phys = pgd_phys;
+        s_request.start = start;
+        s_request.end = end;
+        asm volatile("" ::: "memory");
+        g_tlb_pending_cpus = targets;
+        for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+            if (targets & (1u << cpu)) smp_send_ipi(cpu, IPI_TLB_SHOOTDOWN_VECTOR);
+        }
+        while (g_tlb_pending_cpus) {
+            asm volatile("pause" ::: "memory");
+        }
+    }
+    spinlock_release_irqrestore(&s_tlb_lock, irq_flags);
+}
+
+//============================================================================
+// Batching
+//============================================================================
+void tlb_batch_init(tlb_batch_t *batch, uint32_t *pgd_phys) {
+    batch->pgd_phys = pgd_phys;
+    batch->start = 0;
+    batch->end = 0;
+    batch->nr_frames = 0;
+}
+
+void tlb_batch_add_page(tlb_batch_t *batch, uintptr_t vaddr) {
+    vaddr = PAGE_ALIGN_DOWN(vaddr);
+    uintptr_t vend = (vaddr > UINTPTR_MAX - PAGE_SIZE) ? UINTPTR_MAX : vaddr + PAGE_SIZE;
+    if (batch->start == batch->end) {
+        batch->start = vaddr;
+        batch->end = vend;
+        return;
+    }
+    if (vaddr < batch->start) batch->start = vaddr;
+    if (vend > batch->end) batch->end = vend;
+}
+
+void tlb_batch_free_frame(tlb_batch_t *batch, uintptr_t frame_phys) {
+    if (batch->nr_frames == TLB_BATCH_FRAMES) tlb_batch_flush(batch);
+    batch->frames[batch->nr_frames++] = frame_phys;
+}
+
+void tlb_batch_flush(tlb_batch_t *batch) {
+    if (batch->start != batch->end) {
+        tlb_shootdown(batch->pgd_phys, batch->start, batch->end);
+        batch->start = batch->end = 0;
+    }
+    if (batch->nr_frames) put_frames_bulk(batch->frames, batch->nr_frames);
+    batch->nr_frames = 0;
+}
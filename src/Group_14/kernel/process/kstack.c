@@ -0,0 +1,156 @@
+/**
+ * @file kstack.c
+ * @brief Kernel stack cache with guard pages (see kstack.h).
+ *
+ * The region [KERNEL_STACK_VADDR_START, KSTACK_VIRT_END) is cut into slots
+ * of one guard page followed by the stack; paging.c pre-allocates its page
+ * tables, so every address space sees a stack as soon as it is mapped.
+ * s_kstack_lock guards the slot bitmap and the free list. Cached stacks are
+ * linked through the word just below their top.
+ */
+
+#include <kernel/process/kstack.h>
+#include <kernel/process/process.h>
+#include <kernel/memory/paging.h>
+#include <kernel/memory/frame.h>
+#include <kernel/memory/tlb.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/lib/assert.h>
+#include <kernel/drivers/display/serial.h>
+
+#define KSTACK_VIRT_END  0xF0000000u
+#define KSTACK_PAGES     (PROCESS_KSTACK_SIZE / PAGE_SIZE)
+#define KSTACK_SLOT_SIZE (PAGE_SIZE + PROCESS_KSTACK_SIZE) // Guard page, then the stack
+#define KSTACK_SLOTS     ((KSTACK_VIRT_END - KERNEL_STACK_VADDR_START) / KSTACK_SLOT_SIZE)
+#define KSTACK_MAP_WORDS ((KSTACK_SLOTS + 31) / 32)
+
+#if (PROCESS_KSTACK_SIZE % PAGE_SIZE) != 0
+#error "PROCESS_KSTACK_SIZE must be a whole number of pages"
+#endif
+
+static spinlock_t s_kstack_lock;
+static uint32_t   s_slot_map[KSTACK_MAP_WORDS]; // Bit set: slot mapped (in use or cached)
+static uint32_t   s_scan_hint;                  // No clear bit below this word
+static uint32_t  *s_free_top;                   // Cached stacks, most recently freed first
+static uint32_t   s_free_count;
+
+static inline uintptr_t slot_stack_base(uint32_t slot) {
+    return KERNEL_STACK_VADDR_START + slot * KSTACK_SLOT_SIZE + PAGE_SIZE;
+}
+
+/** Kernel PTE for @p vaddr through the recursive mapping (PTs are preallocated). */
+static inline uint32_t *kstack_pte(uintptr_t vaddr) {
+    uint32_t *pt = (uint32_t *)(RECURSIVE_PDE_VADDR + PDE_INDEX(vaddr) * PAGE_SIZE);
+    return &pt[PTE_INDEX(vaddr)];
+}
+
+/** Reserves a free slot; -1 if the region is full. */
+static int32_t slot_reserve(void) {
+    int32_t slot = -1;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_kstack_lock);
+    for (uint32_t w = s_scan_hint; w < KSTACK_MAP_WORDS; w++) {
+        if (s_slot_map[w] == 0xFFFFFFFFu) continue;
+        uint32_t bit;
+        asm("bsfl %1, %0" : "=r"(bit) : "rm"(~s_slot_map[w]) : "cc");
+        if (w * 32 + bit >= KSTACK_SLOTS) break;
+        s_slot_map[w] |= 1u << bit;
+        s_scan_hint = w;
+        slot = (int32_t)(w * 32 + bit);
+        break;
+    }
+    spinlock_release_irqrestore(&s_kstack_lock, irq_flags);
+    return slot;
+}
+
+static void slot_release(uint32_t slot) {
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_kstack_lock);
+    s_slot_map[slot / 32] &= ~(1u << (slot % 32));
+    if (slot / 32 < s_scan_hint) s_scan_hint = slot / 32;
+    spinlock_release_irqrestore(&s_kstack_lock, irq_flags);
+}
+
+/** Clears the first @p pages PTEs of a stack and frees their frames after the shootdown. */
+static void kstack_unmap(uintptr_t base, size_t pages) {
+    tlb_batch_t batch;
+    tlb_batch_init(&batch, NULL);
+    for (size_t i = 0; i < pages; i++) {
+        uintptr_t vaddr = base + i * PAGE_SIZE;
+        uint32_t *pte = kstack_pte(vaddr);
+        uintptr_t frame = *pte & PAGING_ADDR_MASK;
+        *pte = 0;
+        tlb_batch_add_page(&batch, vaddr);
+        if (frame) tlb_batch_free_frame(&batch, frame);
+    }
+    tlb_batch_flush(&batch);
+}
+
+/** Cache miss: maps a fresh stack into a free slot. */
+static uint32_t *kstack_map_new(void) {
+    int32_t slot = slot_reserve();
+    if (slot < 0) {
+        serial_write("[KStack] Error: kernel stack region exhausted.\n");
+        return NULL;
+    }
+    uintptr_t frames[KSTACK_PAGES];
+    if (frame_alloc_bulk(KSTACK_PAGES, frames) != KSTACK_PAGES) { // All or nothing
+        slot_release((uint32_t)slot);
+        return NULL;
+    }
+    uintptr_t base = slot_stack_base((uint32_t)slot);
+    for (size_t i = 0; i < KSTACK_PAGES; i++) {
+        if (paging_map_single_4k((uint32_t *)g_kernel_page_directory_phys, base + i * PAGE_SIZE,
+                                 frames[i], PTE_KERNEL_DATA_FLAGS) != 0) {
+            serial_printf("[KStack] Error: failed to map stack page at %#lx.\n", (unsigned long)(base + i * PAGE_SIZE));
+            kstack_unmap(base, i);
+            put_frames_bulk(&frames[i], KSTACK_PAGES - i);
+            slot_release((uint32_t)slot);
+            return NULL;
+        }
+    }
+    return (uint32_t *)(base + PROCESS_KSTACK_SIZE);
+}
+
+void kstack_init(void) {
+    uint32_t *stacks[KSTACK_PREFILL];
+    for (int i = 0; i < KSTACK_PREFILL; i++) stacks[i] = kstack_alloc();
+    for (int i = KSTACK_PREFILL - 1; i >= 0; i--) kstack_free(stacks[i]);
+    serial_printf("[KStack] %lu stacks of %lu bytes cached, %lu slots.\n",
+                  (unsigned long)s_free_count, (unsigned long)PROCESS_KSTACK_SIZE, (unsigned long)KSTACK_SLOTS);
+}
+
+uint32_t *kstack_alloc(void) {
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_kstack_lock);
+    uint32_t *top = s_free_top;
+    if (top) {
+        s_free_top = (uint32_t *)top[-1];
+        s_free_count--;
+    }
+    spinlock_release_irqrestore(&s_kstack_lock, irq_flags);
+    return top ? top : kstack_map_new();
+}
+
+void kstack_free(uint32_t *top) {
+    if (!top) return;
+    uintptr_t base = (uintptr_t)top - PROCESS_KSTACK_SIZE;
+    uint32_t slot = (uint32_t)((base - PAGE_SIZE - KERNEL_STACK_VADDR_START) / KSTACK_SLOT_SIZE);
+    KERNEL_ASSERT(base >= KERNEL_STACK_VADDR_START + PAGE_SIZE && slot < KSTACK_SLOTS &&
+                  slot_stack_base(slot) == base, "kstack_free: not a kernel stack");
+
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_kstack_lock);
+    if (s_free_count < KSTACK_CACHE_MAX) {
+        top[-1] = (uint32_t)(uintptr_t)s_free_top;
+        s_free_top = top;
+        s_free_count++;
+        spinlock_release_irqrestore(&s_kstack_lock, irq_flags);
+        return;
+    }
+    spinlock_release_irqrestore(&s_kstack_lock, irq_flags);
+
+    kstack_unmap(base, KSTACK_PAGES);
+    slot_release(slot);
+}
+
+bool kstack_is_guard(uintptr_t addr) {
+    if (addr < KERNEL_STACK_VADDR_START || addr >= KERNEL_STACK_VADDR_START + KSTACK_SLOTS * KSTACK_SLOT_SIZE) return false;
+    return (addr - KERNEL_STACK_VADDR_START) % KSTACK_SLOT_SIZE < PAGE_SIZE;
+}
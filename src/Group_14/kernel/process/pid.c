@@ -0,0 +1,71 @@
+/**
+ * @file pid.c
+ * @brief Bitmap ID allocator (see pid.h).
+ *
+ * s_pid_map has a bit per ID; s_pid_full has a bit per s_pid_map word that
+ * is all ones. Both, and the cursor, are guarded by s_pid_lock.
+ */
+
+#include <kernel/process/pid.h>
+#include <kernel/sync/spinlock.h>
+
+#define PID_MAP_WORDS  (PID_MAX / 32)
+#define PID_FULL_WORDS (PID_MAP_WORDS / 32)
+
+#if (PID_MAX % 1024) != 0
+#error "PID_MAX must be a multiple of 1024"
+#endif
+
+static spinlock_t s_pid_lock;
+static uint32_t   s_pid_map[PID_MAP_WORDS] = { 1u }; // ID 0 is the idle tasks'
+static uint32_t   s_pid_full[PID_FULL_WORDS];
+static uint32_t   s_pid_next = 1;                   // Where the next search starts
+
+static inline uint32_t bsf32(uint32_t word) {
+    uint32_t bit;
+    asm("bsfl %1, %0" : "=r"(bit) : "rm"(word) : "cc");
+    return bit;
+}
+
+/** First map word at or after @p w (wrapping) with a clear bit; -1 if none. */
+static int32_t next_open_word(uint32_t w) {
+    for (uint32_t n = 0; n <= PID_FULL_WORDS; n++) {
+        uint32_t f = (w / 32 + n) % PID_FULL_WORDS;
+        uint32_t open = ~s_pid_full[f];
+        if (n == 0) open &= ~0u << (w % 32); // Words below w in the first summary word come last
+        if (open) return (int32_t)(f * 32 + bsf32(open));
+    }
+    return -1;
+}
+
+uint32_t pid_alloc(void) {
+    uint32_t pid = 0;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_pid_lock);
+    uint32_t w = s_pid_next / 32;
+    uint32_t open = ~s_pid_map[w] & (~0u << (s_pid_next % 32));
+    if (!open) {
+        int32_t nw = next_open_word((w + 1) % PID_MAP_WORDS);
+        if (nw >= 0) {
+            w = (uint32_t)nw;
+            open = ~s_pid_map[w];
+        }
+    }
+    if (open) {
+        uint32_t bit = bsf32(open);
+        s_pid_map[w] |= 1u << bit;
+        if (s_pid_map[w] == 0xFFFFFFFFu) s_pid_full[w / 32] |= 1u << (w % 32);
+        pid = w * 32 + bit;
+        s_pid_next = (pid + 1) % PID_MAX;
+    }
+    spinlock_release_irqrestore(&s_pid_lock, irq_flags);
+    return pid;
+}
+
+void pid_free(uint32_t pid) {
+    if (pid == 0 || pid >= PID_MAX) return;
+    uint32_t w = pid / 32;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_pid_lock);
+    s_pid_map[w] &= ~(1u << (pid % 32));
+    s_pid_full[w / 32] &= ~(1u << (w % 32));
+    spinlock_release_irqrestore(&s_pid_lock, irq_flags);
+}
@@ -0,0 +1,240 @@
+/**
+ * @file proc_snapshot.c
+ * @brief Pre-initialized program address spaces (see proc_snapshot.h).
+ *
+ * s_snap_lock guards the table, every snapshot's refcount and last_use,
+ * and the stats. A snapshot's mm is written only while it is built, before
+ * anyone else can see it; afterwards processes only copy it, with
+ * paging_clone_directory() taking its lock one page table at a time like
+ * a fork parent's. Building (ELF headers, text faults), copying and
+ * freeing (destroy_mm) happen with no spinlock held throughout, so each
+ * may sleep or reschedule.
+ */
+
+#include <kernel/process/proc_snapshot.h>
+#include <kernel/memory/mm.h>
+#include <kernel/memory/paging.h>
+#include <kernel/memory/frame.h>
+#include <kernel/memory/kmalloc.h>
+#include <kernel/memory/shrinker.h>
+#include <kernel/fs/vfs/vfs.h>
+#include <kernel/fs/vfs/fs_errno.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/lib/string.h>
+#include <kernel/drivers/display/serial.h>
+
+static spinlock_t             s_snap_lock;
+static proc_snapshot_t       *s_snaps[PROC_SNAPSHOT_MAX];
+static uint32_t               s_use_clock;
+static proc_snapshot_stats_t  s_stats;
+
+/** @brief A page directory with the kernel half and the recursive entry only. */
+static uint32_t *snapshot_new_pd(void) {
+    uintptr_t pd_phys = frame_alloc();
+    if (!pd_phys) return NULL;
+    uint32_t *pd = (uint32_t *)paging_temp_map(pd_phys, PTE_KERNEL_DATA_FLAGS);
+    if (!pd) {
+        put_frame(pd_phys);
+        return NULL;
+    }
+    clear_page(pd);
+    copy_kernel_pde_entries(pd);
+    pd[RECURSIVE_PDE_INDEX] = (pd_phys & PAGING_ADDR_MASK) | PAGE_PRESENT | PAGE_RW |
+                              (g_nx_supported ? PAGE_NX_BIT : 0);
+    paging_temp_unmap(pd);
+    return (uint32_t *)pd_phys;
+}
+
+static void snapshot_free(proc_snapshot_t *snap) {
+    if (snap->mm) destroy_mm(snap->mm); // Clears the user half of pd_phys too
+    if (snap->pd_phys) put_frame((uintptr_t)snap->pd_phys);
+    kfree(snap);
+}
+
+/**
+ * @brief Maps the first PROC_SNAPSHOT_PREFAULT_PAGES pages of read-only
+ * text, so processes start with them present. Best effort: whatever is not
+ * mapped here faults in as usual. The mm is still private to the builder.
+ */
+static void snapshot_prefault(proc_snapshot_t *snap) {
+    mm_struct_t *mm = snap->mm;
+    for (struct rb_node *node = rb_tree_first(&mm->vma_tree); node; node = rb_node_next(node)) {
+        vma_struct_t *vma = rb_entry(node, vma_struct_t, rb_node);
+        if ((vma->vm_flags & (VM_FILEBACKED | VM_EXEC | VM_WRITE)) != (VM_FILEBACKED | VM_EXEC)) continue;
+        for (uintptr_t addr = vma->vm_start; addr < vma->vm_end; addr += PAGE_SIZE) {
+            if (snap->nr_prefaulted == PROC_SNAPSHOT_PREFAULT_PAGES) return;
+            uintptr_t phys = mm_pin_user_page(mm, addr, false);
+            if (!phys) return; // Out of frames or a read error
+            put_frame(phys);   // The PTE keeps its own reference
+            snap->nr_prefaulted++;
+        }
+    }
+}
+
+static proc_snapshot_t *snapshot_build(const char *path, const struct vfs_stat *st, int *err) {
+    size_t len = strlen(path) + 1;
+    proc_snapshot_t *snap = (proc_snapshot_t *)kmalloc(sizeof(proc_snapshot_t) + len);
+    if (!snap) {
+        *err = -ENOMEM;
+        return NULL;
+    }
+    memset(snap, 0, sizeof(proc_snapshot_t));
+    memcpy(snap->path, path, len);
+    snap->st_ino = st->st_ino;
+    snap->st_mtime = st->st_mtime;
+    snap->st_size = st->st_size;
+
+    int ret = -ENOMEM;
+    snap->pd_phys = snapshot_new_pd();
+    if (!snap->pd_phys) goto fail;
+    snap->mm = create_mm(snap->pd_phys);
+    if (!snap->mm) goto fail;
+    ret = process_build_image(path, snap->mm, &snap->entry_point);
+    if (ret != 0) goto fail;
+    snapshot_prefault(snap);
+
+    serial_printf("[Snapshot] Built '%s': entry %#lx, %lu text pages mapped.\n",
+                  path, (unsigned long)snap->entry_point, (unsigned long)snap->nr_prefaulted);
+    return snap;
+
+fail:
+    snapshot_free(snap);
+    *err = ret;
+    return NULL;
+}
+
+/** @brief Slot of @p path in the table, or -1. Lock held. */
+static int snapshot_find(const char *path) {
+    for (int i = 0; i < PROC_SNAPSHOT_MAX; i++) {
+        if (s_snaps[i] && strcmp(s_snaps[i]->path, path) == 0) return i;
+    }
+    return -1;
+}
+
+/** @brief A free slot, else the least recently used one. Lock held. */
+static int snapshot_victim(void) {
+    int victim = 0;
+    for (int i = 0; i < PROC_SNAPSHOT_MAX; i++) {
+        if (!s_snaps[i]) return i;
+        if (s_snaps[i]->last_use < s_snaps[victim]->last_use) victim = i;
+    }
+    return victim;
+}
+
+proc_snapshot_t *proc_snapshot_get(const char *path, int *err) {
+    struct vfs_stat st;
+    if (vfs_stat(path, &st) != 0) {
+        *err = -ENOENT;
+        return NULL;
+    }
+
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_snap_lock);
+    proc_snapshot_t *stale = NULL;
+    int slot = snapshot_find(path);
+    if (slot >= 0) {
+        proc_snapshot_t *snap = s_snaps[slot];
+        if (snap->st_ino == st.st_ino && snap->st_mtime == st.st_mtime && snap->st_size == st.st_size) {
+            snap->refcount++;
+            snap->last_use = ++s_use_clock;
+            s_stats.hits++;
+            spinlock_release_irqrestore(&s_snap_lock, irq_flags);
+            return snap;
+        }
+        s_snaps[slot] = NULL;
+        s_stats.cached--;
+        s_stats.stale++;
+        stale = snap;
+    }
+    spinlock_release_irqrestore(&s_snap_lock, irq_flags);
+    if (stale) proc_snapshot_put(stale);
+
+    proc_snapshot_t *snap = snapshot_build(path, &st, err);
+    if (!snap) return NULL;
+
+    // A racing build of the same path loses its slot to this newer one
+    irq_flags = spinlock_acquire_irqsave(&s_snap_lock);
+    slot = snapshot_find(path);
+    if (slot < 0) slot = snapshot_victim();
+    proc_snapshot_t *old = s_snaps[slot];
+    if (old) s_stats.evictions++;
+    else s_stats.cached++;
+    snap->refcount = 2; // The table's and the caller's
+    snap->last_use = ++s_use_clock;
+    s_snaps[slot] = snap;
+    s_stats.builds++;
+    spinlock_release_irqrestore(&s_snap_lock, irq_flags);
+    if (old) proc_snapshot_put(old);
+    return snap;
+}
+
+void proc_snapshot_put(proc_snapshot_t *snap) {
+    if (!snap) return;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_snap_lock);
+    bool last = --snap->refcount == 0;
+    spinlock_release_irqrestore(&s_snap_lock, irq_flags);
+    if (last) snapshot_free(snap);
+}
+
+/** @brief Takes the least recently used snapshot nobody else holds out of the table. */
+static proc_snapshot_t *snapshot_take_unused(void) {
+    proc_snapshot_t *snap = NULL;
+    int slot = -1;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_snap_lock);
+    for (int i = 0; i < PROC_SNAPSHOT_MAX; i++) {
+        if (s_snaps[i] && s_snaps[i]->refcount == 1 && (slot < 0 || s_snaps[i]->last_use < s_snaps[slot]->last_use)) {
+            slot = i;
+        }
+    }
+    if (slot >= 0) {
+        snap = s_snaps[slot];
+        s_snaps[slot] = NULL;
+        s_stats.cached--;
+        s_stats.evictions++;
+    }
+    spinlock_release_irqrestore(&s_snap_lock, irq_flags);
+    return snap;
+}
+
+void proc_snapshot_drop_all(void) {
+    proc_snapshot_t *snap;
+    while ((snap = snapshot_take_unused()) != NULL) proc_snapshot_put(snap);
+}
+
+void proc_snapshot_get_stats(proc_snapshot_stats_t *out) {
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_snap_lock);
+    *out = s_stats;
+    spinlock_release_irqrestore(&s_snap_lock, irq_flags);
+}
+
+//============================================================================
+// Reclaim
+//============================================================================
+#define SNAPSHOT_RECLAIM_BYTES (2 * PAGE_SIZE) // Its page directory and a page table, at least
+
+static size_t snapshot_shrink_count(void) {
+    return (size_t)__atomic_load_n(&s_stats.cached, __ATOMIC_RELAXED) * SNAPSHOT_RECLAIM_BYTES;
+}
+
+/** @brief Drops unused snapshots, oldest first. destroy_mm() may block, so only in background reclaim. */
+static size_t snapshot_shrink_scan(size_t target, bool may_block) {
+    size_t bytes = 0;
+    if (!may_block) return 0;
+    while (bytes < target) {
+        proc_snapshot_t *snap = snapshot_take_unused();
+        if (!snap) break;
+        proc_snapshot_put(snap);
+        bytes += SNAPSHOT_RECLAIM_BYTES;
+    }
+    return bytes;
+}
+
+static shrinker_t s_snap_shrinker = {
+    .name  = "proc_snapshot",
+    .count = snapshot_shrink_count,
+    .scan  = snapshot_shrink_scan,
+};
+
+void proc_snapshot_init(void) {
+    spinlock_init(&s_snap_lock);
+    shrinker_register(&s_snap_shrinker);
+}
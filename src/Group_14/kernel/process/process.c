@@ -16,12 +16,12 @@
  #include <kernel/core/types.h>          // Core type definitions
  #include <kernel/lib/string.h>         // For memset, memcpy
  #include <kernel/process/scheduler.h>      // For get_current_task() etc. (Adapt based on scheduler API)
- #include <kernel/fs/vfs/read_file.h>      // For read_file() helper
  #include <kernel/memory/frame.h>          // For frame_alloc, put_frame
  #include <kernel/memory/kmalloc_internal.h> // For ALIGN_UP (used by PAGE_ALIGN_UP in paging.h)
  #include <kernel/process/elf.h>            // ELF header definitions
  #include <libc/stddef.h>    // For NULL
  #include <kernel/lib/assert.h>         // For KERNEL_ASSERT
+ #include <kernel/lib/klog.h>           // klog_debug (PROC_DEBUG_PRINTF)
  #include <kernel/cpu/gdt.h>            // For GDT_USER_CODE_SELECTOR, GDT_USER_DATA_SELECTOR
  #include <kernel/cpu/tss.h>            // For tss_set_kernel_stack
  #include <kernel/fs/vfs/sys_file.h>       // For sys_close() definition and sys_file_t type <-- Added include
@@ -29,6 +29,14 @@
  #include <kernel/fs/vfs/fs_errno.h>       // For error codes (ENOENT, ENOEXEC, ENOMEM, EIO) <-- Added include
  #include <kernel/fs/vfs/vfs.h>            // For vfs_close (used in process_close_fds fallback)
  #include <kernel/drivers/display/serial.h>
+ #include <kernel/sync/spinlock.h>
+ #include <kernel/sync/wait_queue.h>       // Parents blocked in process_waitpid()
+ #include <kernel/process/vvar.h>          // vvar_map_process, vvar_fork_process
+ #include <kernel/cpu/syscall_stats.h>     // syscall_trace_release
+ #include <kernel/memory/uaccess.h>        // process_thread_create's user stack frame
+ #include <kernel/process/kstack.h>        // kstack_alloc/kstack_free
+ #include <kernel/process/pid.h>           // pid_alloc/pid_free
+ #include <kernel/process/proc_snapshot.h> // proc_snapshot_get, process_build_image
  
  // Forward declaration for idle task stack checking
  extern void check_idle_task_stack_integrity(const char *checkpoint);
@@ -48,13 +56,6 @@
  #define KERNEL_VIRT_BASE 0xC0000000 // Start of kernel virtual address space
  #endif
  
- #ifndef KERNEL_STACK_VIRT_START
- #define KERNEL_STACK_VIRT_START 0xE0000000 // Example: Start of a region for kernel stacks
- #endif
- #ifndef KERNEL_STACK_VIRT_END
- #define KERNEL_STACK_VIRT_END   0xF0000000 // Example: End of the region
- #endif
- 
  #ifndef MAX
  #define MAX(a, b) ((a) > (b) ? (a) : (b))
  #endif
@@ -62,6 +63,7 @@
  #define MIN(a, b) ((a) < (b) ? (a) : (b))
  #endif
  
+
  // Initial EFLAGS for user processes (IF=1, reserved bit 1=1)
  #define USER_EFLAGS_DEFAULT 0x202
  
@@ -69,7 +71,7 @@
  #define PROCESS_DEBUG 0 // Set to 0 to disable debug prints
  #if PROCESS_DEBUG
  // Note: Ensure terminal_printf handles %p correctly (it should, as %p calls _format_number with base 16)
- #define PROC_DEBUG_PRINTF(fmt, ...) terminal_printf("[Process DEBUG %s:%d] " fmt, __func__, __LINE__, ##__VA_ARGS__)
+ #define PROC_DEBUG_PRINTF(fmt, ...) klog_debug("[Process DEBUG %s:%d] " fmt, __func__, __LINE__, ##__VA_ARGS__)
  #else
  #define PROC_DEBUG_PRINTF(fmt, ...) // Do nothing
  #endif
@@ -81,183 +83,55 @@
  extern uint32_t g_kernel_page_directory_phys; // Physical address of kernel's page directory
  extern bool g_nx_supported;                   // NX support flag
  
- // Process ID counter - NEEDS LOCKING FOR SMP
- static uint32_t next_pid = 1;
- // TODO: Add spinlock_t g_pid_lock;
- 
- // Simple linear allocator for kernel stack virtual addresses
- // WARNING: Placeholder only! Not suitable for production/SMP. Needs proper allocator.
- static uintptr_t g_next_kernel_stack_virt_base = KERNEL_STACK_VIRT_START;
- // TODO: Replace with a proper kernel virtual address space allocator (e.g., using VMAs)
- 
+ // Process tree: parent/children/sibling links and the exited flags.
+ // Parents in process_waitpid() sleep on g_child_exit_wq; any exit wakes them all.
+ static spinlock_t   g_proc_tree_lock;
+ static wait_queue_t g_child_exit_wq;
+
  // ------------------------------------------------------------------------
  // Local Prototypes
  // ------------------------------------------------------------------------
  static bool allocate_kernel_stack(pcb_t *proc);
  static int load_elf_and_init_memory(const char *path, mm_struct_t *mm, uint32_t *entry_point, uintptr_t *initial_brk);
- static int copy_elf_segment_data(uintptr_t frame_paddr, const uint8_t* file_data_buffer, size_t file_buffer_offset, size_t size_to_copy, size_t zero_padding);
  static void prepare_initial_kernel_stack(pcb_t *proc);
- extern void copy_kernel_pde_entries(uint32_t *new_pd_virt); // From paging.c
+ static void process_release_resources(pcb_t *pcb);
  
  // --- FD Management Function Prototypes (implementation below) ---
  void process_init_fds(pcb_t *proc);
  void process_close_fds(pcb_t *proc);
  
+ /** @brief Frees a PCB and gives its PID back (see pid.h). */
+ static void pcb_free(pcb_t *pcb)
+ {
+     pid_free(pcb->pid);
+     kfree(pcb);
+ }
+
  // ------------------------------------------------------------------------
- // allocate_kernel_stack - Allocates and maps kernel stack pages
+ // allocate_kernel_stack - Takes a kernel stack from the stack cache
  // ------------------------------------------------------------------------
  /**
-  * @brief Allocates physical frames and maps them into the kernel's address space
-  * to serve as the kernel stack for a given process.
+  * @brief Gives @p proc a kernel stack from the guarded stack cache
+  * (kstack.h) and points TSS.esp0 at it.
   * @param proc Pointer to the PCB to setup the kernel stack for.
   * @return true on success, false on failure.
   */
-  static bool allocate_kernel_stack(pcb_t *proc)
-{
-     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Enter\n", __func__, __LINE__);
+ static bool allocate_kernel_stack(pcb_t *proc)
+ {
      KERNEL_ASSERT(proc != NULL, "allocate_kernel_stack: NULL proc");
-
-     size_t usable_stack_size = PROCESS_KSTACK_SIZE; // Defined in process.h (e.g., 16384)
-     if (usable_stack_size == 0 || (usable_stack_size % PAGE_SIZE) != 0) {
-        serial_printf("[Process] ERROR: Invalid PROCESS_KSTACK_SIZE (%lu).\n", (unsigned long)usable_stack_size);
-        return false;
-     }
-     size_t num_usable_pages = usable_stack_size / PAGE_SIZE;
-     // *** GUARD PAGE FIX: Allocate one extra page ***
-     size_t num_pages_with_guard = num_usable_pages + 1;
-     size_t total_alloc_size = num_pages_with_guard * PAGE_SIZE; // Total size including guard
-
-     // *** GUARD PAGE FIX: Ensure log message reflects the extra page ***
-     serial_printf("  Allocating %lu pages + 1 guard page (%lu bytes total) for kernel stack...\n",
-                     (unsigned long)num_usable_pages, (unsigned long)total_alloc_size);
-
-     // Use kmalloc for the temporary array holding physical frame addresses
-     uintptr_t *phys_frames = kmalloc(num_pages_with_guard * sizeof(uintptr_t));
-     if (!phys_frames) {
-        serial_write("[Process] ERROR: kmalloc failed for phys_frames array.\n");
-        return false;
-     }
-     memset(phys_frames, 0, num_pages_with_guard * sizeof(uintptr_t));
-     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] phys_frames array allocated at %p\n", __func__, __LINE__, phys_frames);
-
-     // 1. Allocate Physical Frames (Allocate num_pages_with_guard)
-     size_t allocated_count = 0;
-     for (allocated_count = 0; allocated_count < num_pages_with_guard; allocated_count++) {
-         phys_frames[allocated_count] = frame_alloc();
-         if (phys_frames[allocated_count] == 0) { // frame_alloc returns 0 on failure
-             serial_printf("[Process] ERROR: frame_alloc failed for frame %lu.\n", (unsigned long)allocated_count);
-             // Free already allocated frames before returning
-             for(size_t j = 0; j < allocated_count; ++j) { put_frame(phys_frames[j]); }
-             kfree(phys_frames);
-             return false;
-         }
-         PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Allocated frame %lu: P=%#lx\n", __func__, __LINE__, (unsigned long)allocated_count, (unsigned long)phys_frames[allocated_count]);
-     }
-     proc->kernel_stack_phys_base = (uint32_t)phys_frames[0];
-     // *** GUARD PAGE FIX: Update log message ***
-     serial_printf("  Successfully allocated %lu physical frames (incl. guard) for kernel stack.\n", (unsigned long)allocated_count);
-
-     // 2. Allocate Virtual Range (Allocate for num_pages_with_guard)
-     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Allocating virtual range...\n", __func__, __LINE__);
-     // TODO: Add locking for g_next_kernel_stack_virt_base in SMP
-     uintptr_t kstack_virt_base = g_next_kernel_stack_virt_base;
-     // *** GUARD PAGE FIX: Use total size including guard ***
-     uintptr_t kstack_virt_end_with_guard = kstack_virt_base + total_alloc_size;
-     // Check for overflow and exceeding bounds
-     if (kstack_virt_base < KERNEL_STACK_VIRT_START || kstack_virt_end_with_guard > KERNEL_STACK_VIRT_END || kstack_virt_end_with_guard <= kstack_virt_base) {
-        serial_printf("[Process] ERROR: Kernel stack virtual address range invalid or exhausted [%#lx - %#lx).\n",
-                        (unsigned long)kstack_virt_base, (unsigned long)kstack_virt_end_with_guard);
-        // Free allocated physical frames
-        for(size_t i=0; i<num_pages_with_guard; ++i) { put_frame(phys_frames[i]); }
-        kfree(phys_frames);
-        return false;
-     }
-     g_next_kernel_stack_virt_base = kstack_virt_end_with_guard; // Advance allocator
-     KERNEL_ASSERT((kstack_virt_base % PAGE_SIZE) == 0, "Kernel stack virt base not page aligned");
-     // *** GUARD PAGE FIX: Update log message ***
-     serial_printf("  Allocated kernel stack VIRTUAL range (incl. guard): [%#lx - %#lx)\n",
-                     (unsigned long)kstack_virt_base, (unsigned long)kstack_virt_end_with_guard);
-
-     // 3. Map Physical Frames to Virtual Range in Kernel Page Directory
-     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Mapping physical frames to virtual range...\n", __func__, __LINE__);
-     // *** GUARD PAGE FIX: Loop over all allocated frames ***
-     for (size_t i = 0; i < num_pages_with_guard; i++) {
-         uintptr_t target_vaddr = kstack_virt_base + (i * PAGE_SIZE);
-         uintptr_t phys_addr    = phys_frames[i];
-         PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Mapping page %lu: V=%p -> P=%#lx\n", __func__, __LINE__, (unsigned long)i, (void*)target_vaddr, (unsigned long)phys_addr);
-         // Ensure kernel paging globals are set
-         if (!g_kernel_page_directory_phys) {
-            serial_printf("[Process] ERROR: Kernel page directory physical address not set for mapping.\n");
-            for(size_t j = 0; j < num_pages_with_guard; ++j) { if (phys_frames[j] != 0) put_frame(phys_frames[j]); }
-            kfree(phys_frames);
-            g_next_kernel_stack_virt_base = kstack_virt_base; // Roll back VA allocator
-            return false;
-         }
-         int map_res = paging_map_single_4k((uint32_t*)g_kernel_page_directory_phys, target_vaddr, phys_addr, PTE_KERNEL_DATA_FLAGS);
-         if (map_res != 0) {
-            serial_printf("[Process] ERROR: Failed to map kernel stack page %lu (V=%p -> P=%#lx), error %d.\n",
-                            (unsigned long)i, (void*)target_vaddr, (unsigned long)phys_addr, map_res);
-            // Unmap already mapped pages and free all physical frames
-            paging_unmap_range((uint32_t*)g_kernel_page_directory_phys, kstack_virt_base, i * PAGE_SIZE); // Unmap successful ones
-            for(size_t j = 0; j < num_pages_with_guard; ++j) { // Free all allocated frames
-                if (phys_frames[j] != 0) put_frame(phys_frames[j]);
-            }
-            kfree(phys_frames);
-            g_next_kernel_stack_virt_base = kstack_virt_base; // Roll back VA allocator
-            return false;
-         }
-     }
-
-     // 4. Perform Kernel Stack Write Test (on usable range only)
-     // *** GUARD PAGE FIX: Test only the usable part ***
-     uintptr_t usable_stack_end = kstack_virt_base + usable_stack_size;
-     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Performing kernel stack write test V=[%p - %p)...\n", __func__, __LINE__, (void*)kstack_virt_base, (void*)usable_stack_end);
-     volatile uint32_t *stack_bottom_ptr = (volatile uint32_t *)kstack_virt_base;
-     volatile uint32_t *stack_top_word_ptr = (volatile uint32_t *)(usable_stack_end - sizeof(uint32_t)); // Test highest usable word
-     uint32_t test_value = 0xDEADBEEF;
-     uint32_t read_back1 = 0, read_back2 = 0;
-
-     serial_printf("  Writing test value to stack bottom: %p\n", (void*)stack_bottom_ptr);
-     *stack_bottom_ptr = test_value;
-     read_back1 = *stack_bottom_ptr;
-
-     serial_printf("  Writing test value to stack top word: %p\n", (void*)stack_top_word_ptr);
-     *stack_top_word_ptr = test_value;
-     read_back2 = *stack_top_word_ptr;
-
-     if (read_back1 != test_value || read_back2 != test_value) {
-         serial_printf("  KERNEL STACK WRITE TEST FAILED! Read back %#lx and %#lx (expected %#lx)\n",
-                         (unsigned long)read_back1, (unsigned long)read_back2, (unsigned long)test_value);
-         serial_printf("  Unmapping failed stack range V=[%p-%p)\n", (void*)kstack_virt_base, (void*)kstack_virt_end_with_guard);
-         // *** GUARD PAGE FIX: Unmap total size ***
-         paging_unmap_range((uint32_t*)g_kernel_page_directory_phys, kstack_virt_base, total_alloc_size);
-         // *** GUARD PAGE FIX: Free all frames ***
-         for(size_t i=0; i<num_pages_with_guard; ++i) { if(phys_frames[i]) put_frame(phys_frames[i]); }
-         kfree(phys_frames);
-         g_next_kernel_stack_virt_base = kstack_virt_base; // Roll back VA allocator
+     uint32_t *stack_top = kstack_alloc();
+     if (!stack_top) {
+         serial_write("[Process] ERROR: No kernel stack available.\n");
          return false;
      }
-     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Kernel stack write test PASSED (usable range).\n", __func__, __LINE__);
-
-     // 5. *** Set kernel_stack_vaddr_top to the end of the USABLE stack size ***
-     // This value is used for TSS.esp0 and stack preparation logic.
-     proc->kernel_stack_vaddr_top = (uint32_t*)usable_stack_end; // e.g., 0xe0004000
-
-     kfree(phys_frames); // Free the temporary array
-
-     // *** GUARD PAGE FIX: Update log message ***
-     serial_printf("  Kernel stack mapped (incl. guard): PhysBase=%#lx, VirtBase=%#lx, Usable VirtTop=%p\n",
-                     (unsigned long)proc->kernel_stack_phys_base,
-                     (unsigned long)kstack_virt_base,
-                     (void*)proc->kernel_stack_vaddr_top);
-
-     // 6. Update TSS ESP0 using the (unchanged) value of kernel_stack_vaddr_top
-     serial_printf("  Updating TSS esp0 = %p\n", (void*)proc->kernel_stack_vaddr_top);
-     tss_set_kernel_stack((uint32_t)proc->kernel_stack_vaddr_top);
-
-     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Exit OK\n", __func__, __LINE__);
-     return true; // Success
-}
+     uintptr_t base_phys = 0;
+     paging_get_physical_address((uint32_t*)g_kernel_page_directory_phys,
+                                 (uintptr_t)stack_top - PROCESS_KSTACK_SIZE, &base_phys);
+     proc->kernel_stack_phys_base = (uint32_t)base_phys;
+     proc->kernel_stack_vaddr_top = stack_top;
+     tss_set_kernel_stack((uint32_t)stack_top);
+     return true;
+ }
  
  // ------------------------------------------------------------------------
  // get_current_process - Retrieve PCB of the currently running process
@@ -280,95 +154,14 @@
  }
  
  // ------------------------------------------------------------------------
- // copy_elf_segment_data - Populate a physical frame with ELF data
+ // load_elf_and_init_memory - Load ELF headers, register segment VMAs
  // ------------------------------------------------------------------------
  /**
-  * @brief Copies data from an ELF file buffer into a physical memory frame,
-  * handling zero-padding (BSS). Uses temporary kernel mapping.
-  * @param frame_paddr Physical address of the destination frame (must be page-aligned).
-  * @param file_data_buffer Pointer to the buffer containing the entire ELF file data.
-  * @param file_buffer_offset Offset within file_data_buffer where data for this frame starts.
-  * @param size_to_copy Number of bytes to copy from the file buffer.
-  * @param zero_padding Number of bytes to zero-fill after the copied data.
-  * @return 0 on success, -1 on failure (e.g., temp mapping failed).
-  */
- static int copy_elf_segment_data(uintptr_t frame_paddr,
-                                 const uint8_t* file_data_buffer,
-                                 size_t file_buffer_offset,
-                                 size_t size_to_copy,
-                                 size_t zero_padding)
-{
-     PROC_DEBUG_PRINTF("Enter P=%#lx, offset=%lu, copy=%lu, zero=%lu\n", (unsigned long)frame_paddr, (unsigned long)file_buffer_offset, (unsigned long)size_to_copy, (unsigned long)zero_padding);
-     KERNEL_ASSERT(frame_paddr != 0 && (frame_paddr % PAGE_SIZE) == 0, "copy_elf_segment_data: Invalid physical address");
-     KERNEL_ASSERT(size_to_copy + zero_padding <= PAGE_SIZE, "ELF copy + zero exceeds frame");
- 
-     // Sanity check the input parameters
-     if (!file_data_buffer && size_to_copy > 0) {
-         serial_printf("[Process] copy_elf_segment_data: ERROR: NULL file_data_buffer with non-zero copy size.\n");
-         return -1;
-     }
-
-     if (file_buffer_offset > 0 && !file_data_buffer) {
-         serial_printf("[Process] copy_elf_segment_data: ERROR: Non-zero file offset with NULL file_data_buffer.\n");
-         return -1;
-     }
-
-     // Temporarily map the physical frame into kernel space
-     PROC_DEBUG_PRINTF("Calling paging_temp_map for P=%#lx\n", (unsigned long)frame_paddr);
-     // Use PTE_KERNEL_DATA_FLAGS to ensure it's writable by kernel
-     void* temp_vaddr = paging_temp_map(frame_paddr, PTE_KERNEL_DATA_FLAGS);
- 
-     if (temp_vaddr == NULL) {
-         serial_printf("[Process] copy_elf_segment_data: ERROR: paging_temp_map failed (paddr=%#lx).\n", (unsigned long)frame_paddr);
-         return -1;
-     }
-     PROC_DEBUG_PRINTF("paging_temp_map returned V=%p\n", temp_vaddr);
- 
-     // Copy data from ELF file buffer - with added validation
-     if (size_to_copy > 0) {
-         PROC_DEBUG_PRINTF("memcpy: dst=%p, src=%p + %lu, size=%lu\n", temp_vaddr, file_data_buffer, (unsigned long)file_buffer_offset, (unsigned long)size_to_copy);
-         KERNEL_ASSERT(file_data_buffer != NULL, "copy_elf_segment_data: NULL file_data_buffer");
-         
-         // Extra debug to see what we're copying - print first few bytes
-         if (PROCESS_DEBUG && size_to_copy >= 4) {
-             const uint8_t* src = file_data_buffer + file_buffer_offset;
-             PROC_DEBUG_PRINTF("First 4 bytes: %02x %02x %02x %02x\n", 
-                             src[0], src[1], src[2], src[3]);
-         }
-         
-         // Do the actual copy
-         memcpy(temp_vaddr, file_data_buffer + file_buffer_offset, size_to_copy);
-         
-         // Verify the copy succeeded
-         if (PROCESS_DEBUG && size_to_copy >= 4) {
-             const uint8_t* dst = (const uint8_t*)temp_vaddr;
-             PROC_DEBUG_PRINTF("Verify first 4 bytes: %02x %02x %02x %02x\n", 
-                             dst[0], dst[1], dst[2], dst[3]);
-         }
-     }
-     
-     // Zero out the BSS portion within this page
-     if (zero_padding > 0) {
-         PROC_DEBUG_PRINTF("memset: dst=%p + %lu, val=0, size=%lu\n", temp_vaddr, (unsigned long)size_to_copy, (unsigned long)zero_padding);
-         memset((uint8_t*)temp_vaddr + size_to_copy, 0, zero_padding);
-     }
- 
-     // Unmap the specific temporary kernel mapping
-     PROC_DEBUG_PRINTF("Calling paging_temp_unmap for V=%p\n", temp_vaddr);
-     paging_temp_unmap(temp_vaddr);
-     PROC_DEBUG_PRINTF("Exit OK\n");
-     return 0; // success
-}
- 
- 
- // ------------------------------------------------------------------------
- // load_elf_and_init_memory - Load ELF, setup VMAs, populate pages
- // ------------------------------------------------------------------------
- /**
-  * @brief Loads an ELF executable from a file buffer, validates it, creates
-  * Virtual Memory Areas (VMAs) for LOAD segments, allocates physical frames,
-  * copies segment data, and maps the frames into the process's address space.
-  * @param path Path to the executable (used for logging).
+  * @brief Validates an ELF executable and registers one file-backed VMA per
+  * PT_LOAD segment. Only the ELF and program headers are read here; segment
+  * pages are read from the file on first touch (handle_vma_fault), and the
+  * bytes past p_filesz (.bss) come up zeroed. The VMAs keep the file open.
+  * @param path Path to the executable.
   * @param mm Pointer to the process's memory management structure.
   * @param entry_point Output parameter for the ELF entry point virtual address.
   * @param initial_brk Output parameter for the initial program break address (end of loaded data).
@@ -382,21 +175,19 @@
       PROC_DEBUG_PRINTF("Enter path='%s', mm=%p", path ? path : "<NULL>", mm);
       KERNEL_ASSERT(path != NULL && mm != NULL && entry_point != NULL && initial_brk != NULL, "load_elf: Invalid arguments");
 
-      size_t file_size = 0;
-      uint8_t *file_data = NULL;
-      uintptr_t phys_page = 0; // Tracks a potentially allocated frame that needs freeing on error
+      Elf32_Ehdr ehdr;
       int result = -1; // Default to error
 
-      // 1. Read ELF file using the read_file helper
-      PROC_DEBUG_PRINTF("Reading file '%s'", path);
-      file_data = (uint8_t*)read_file(path, &file_size); // read_file allocates buffer
-      if (!file_data) {
-          serial_printf("[Process] load_elf: ERROR: Failed to read file '%s'.\n", path);
-          result = -ENOENT; // File not found or read error
-          goto cleanup_load_elf;
+      // 1. Open the executable; only the headers are read up front
+      sys_file_t *exe = sys_file_open_kernel(path, O_RDONLY);
+      if (!exe) {
+          serial_printf("[Process] load_elf: ERROR: Failed to open file '%s'.\n", path);
+          return -ENOENT;
       }
-      PROC_DEBUG_PRINTF("File read: size=%lu bytes, buffer=%p", (unsigned long)file_size, file_data);
-      if (file_size < sizeof(Elf32_Ehdr)) {
+      off_t end_pos = vfs_lseek(exe->vfs_file, 0, SEEK_END);
+      size_t file_size = (end_pos > 0) ? (size_t)end_pos : 0;
+      if (file_size < sizeof(Elf32_Ehdr) ||
+          vfs_pread(exe->vfs_file, &ehdr, sizeof(ehdr), 0) != (int)sizeof(ehdr)) {
           serial_printf("[Process] load_elf: ERROR: File '%s' is too small to be an ELF file (size %lu).\n", path, (unsigned long)file_size);
           result = -ENOEXEC; // Exec format error
           goto cleanup_load_elf;
@@ -404,34 +195,38 @@
 
       // 2. Parse and Validate ELF Header
       PROC_DEBUG_PRINTF("Parsing ELF header...");
-      Elf32_Ehdr *ehdr = (Elf32_Ehdr *)file_data;
-
       // Check ELF Magic Number, Class, Type, Machine, Program Header Table validity
-      if (ehdr->e_ident[EI_MAG0] != ELFMAG0 || ehdr->e_ident[EI_MAG1] != ELFMAG1 ||
-          ehdr->e_ident[EI_MAG2] != ELFMAG2 || ehdr->e_ident[EI_MAG3] != ELFMAG3) {
+      if (ehdr.e_ident[EI_MAG0] != ELFMAG0 || ehdr.e_ident[EI_MAG1] != ELFMAG1 ||
+          ehdr.e_ident[EI_MAG2] != ELFMAG2 || ehdr.e_ident[EI_MAG3] != ELFMAG3) {
           serial_printf("[Process] load_elf: ERROR: Invalid ELF magic number for '%s'.\n", path);
           result = -ENOEXEC; goto cleanup_load_elf;
       }
-      if (ehdr->e_ident[EI_CLASS] != ELFCLASS32 || ehdr->e_type != ET_EXEC || ehdr->e_machine != EM_386) {
+      if (ehdr.e_ident[EI_CLASS] != ELFCLASS32 || ehdr.e_type != ET_EXEC || ehdr.e_machine != EM_386) {
            serial_printf("[Process] load_elf: ERROR: ELF file '%s' is not a 32-bit i386 executable.\n", path);
            result = -ENOEXEC; goto cleanup_load_elf;
       }
-       if (ehdr->e_phoff == 0 || ehdr->e_phnum == 0 ||
-           (ehdr->e_phoff + (uint64_t)ehdr->e_phnum * ehdr->e_phentsize) > file_size) {
+       if (ehdr.e_phoff == 0 || ehdr.e_phnum == 0 || ehdr.e_phentsize != sizeof(Elf32_Phdr) ||
+           (ehdr.e_phoff + (uint64_t)ehdr.e_phnum * ehdr.e_phentsize) > file_size) {
            serial_printf("[Process] load_elf: ERROR: Invalid program header table in '%s'.\n", path);
            result = -ENOEXEC; goto cleanup_load_elf;
        }
 
-      *entry_point = ehdr->e_entry;
+      *entry_point = ehdr.e_entry;
       serial_printf("  ELF Entry Point: %#lx\n", (unsigned long)*entry_point);
 
-      // 3. Process Program Headers (Segments)
-      PROC_DEBUG_PRINTF("Processing %u program headers...", (unsigned)ehdr->e_phnum);
-      Elf32_Phdr *phdr_table = (Elf32_Phdr *)(file_data + ehdr->e_phoff);
+      // 3. Process Program Headers (Segments), read one at a time so the
+      //    heap use does not grow with e_phnum
+      PROC_DEBUG_PRINTF("Processing %u program headers...", (unsigned)ehdr.e_phnum);
       uintptr_t highest_addr_loaded = 0;
 
-      for (Elf32_Half i = 0; i < ehdr->e_phnum; i++) {
-          Elf32_Phdr *phdr = &phdr_table[i];
+      for (Elf32_Half i = 0; i < ehdr.e_phnum; i++) {
+          Elf32_Phdr phdr_buf;
+          Elf32_Phdr *phdr = &phdr_buf;
+          off_t phdr_off = (off_t)(ehdr.e_phoff + (uint32_t)i * sizeof(Elf32_Phdr));
+          if (vfs_pread(exe->vfs_file, phdr, sizeof(*phdr), phdr_off) != (int)sizeof(*phdr)) {
+              serial_printf("[Process] load_elf: ERROR: Failed to read program header %d of '%s'.\n", (int)i, path);
+              result = -EIO; goto cleanup_load_elf;
+          }
           PROC_DEBUG_PRINTF(" Segment %u: Type=%lu", (unsigned)i, (unsigned long)phdr->p_type);
 
           // Only process PT_LOAD segments with a non-zero memory size
@@ -440,7 +235,7 @@
               continue;
           }
 
-          // Validate segment addresses and sizes (remain the same)
+          // Validate segment addresses and sizes
           if (phdr->p_vaddr < USER_SPACE_START_VIRT || phdr->p_vaddr >= KERNEL_VIRT_BASE) {
               serial_printf("  -> Error: Segment %d VAddr %#lx out of user space bounds for '%s'.\n", (int)i, (unsigned long)phdr->p_vaddr, path);
               result = -ENOEXEC; goto cleanup_load_elf;
@@ -457,6 +252,11 @@
                serial_printf("  -> Error: Segment %d file range [%#lx-%#lx) exceeds file size (%lu) for '%s'.\n", (int)i, (unsigned long)phdr->p_offset, (unsigned long)(phdr->p_offset + phdr->p_filesz), (unsigned long)file_size, path);
                result = -ENOEXEC; goto cleanup_load_elf;
            }
+           // Pages are read straight from the file, so file and memory must share the page offset
+           if (phdr->p_filesz > 0 && (phdr->p_vaddr % PAGE_SIZE) != (phdr->p_offset % PAGE_SIZE)) {
+               serial_printf("  -> Error: Segment %d VAddr %#lx and Offset %#lx differ within a page in '%s'.\n", (int)i, (unsigned long)phdr->p_vaddr, (unsigned long)phdr->p_offset, path);
+               result = -ENOEXEC; goto cleanup_load_elf;
+           }
 
           serial_printf("  Segment %d: VAddr=%#lx, MemSz=%lu, FileSz=%lu, Offset=%#lx, Flags=%c%c%c",
                           (int)i, (unsigned long)phdr->p_vaddr, (unsigned long)phdr->p_memsz, (unsigned long)phdr->p_filesz, (unsigned long)phdr->p_offset,
@@ -469,8 +269,8 @@
           uintptr_t vm_end = PAGE_ALIGN_UP(phdr->p_vaddr + phdr->p_memsz);
           if (vm_end <= vm_start) continue; // Skip zero-sized VMA after alignment
 
-          // --- FIXED: Correct VMA and Page Flag Derivation ---
-          uint32_t vma_flags = VM_USER | VM_ANONYMOUS; // Base VMA flags (ANONYMOUS assumes no file backing *yet*)
+          bool file_backed = (phdr->p_filesz > 0);
+          uint32_t vma_flags = VM_USER | (file_backed ? VM_FILEBACKED : VM_ANONYMOUS);
           uint32_t page_prot = PAGE_PRESENT | PAGE_USER; // Base Page flags
 
           // Set VMA flags based on ELF permissions
@@ -486,89 +286,28 @@
           if (!(phdr->p_flags & PF_X) && g_nx_supported) {
               page_prot |= PAGE_NX_BIT;
           }
-          // --- END FIX ---
 
           serial_printf("  -> VMA [%#lx - %#lx), VMA Flags=%#x, PageProt=%#x",
                           (unsigned long)vm_start, (unsigned long)vm_end, (unsigned)vma_flags, (unsigned)page_prot);
 
-          // Insert VMA for this segment
-          // TODO: If implementing file-backed pages later, pass file pointer and offset here
-          if (!insert_vma(mm, vm_start, vm_end, vma_flags, page_prot, NULL, 0)) {
+          // Insert VMA for this segment; nothing is mapped until it is touched
+          vma_struct_t *vma = insert_vma(mm, vm_start, vm_end, vma_flags, page_prot,
+                                         file_backed ? exe : NULL,
+                                         file_backed ? PAGE_ALIGN_DOWN(phdr->p_offset) : 0);
+          if (!vma) {
               serial_printf("[Process] load_elf: ERROR: Failed to insert VMA for segment %d of '%s'.\n", (int)i, path);
               result = -ENOMEM; // VMA insertion likely failed due to memory
               goto cleanup_load_elf;
           }
-
-          // Allocate frames, populate data, and map pages for this segment
-          serial_printf("  -> Mapping and populating pages...");
-          for (uintptr_t page_v = vm_start; page_v < vm_end; page_v += PAGE_SIZE) {
-              PROC_DEBUG_PRINTF("    Processing page V=%p...", (void*)page_v);
-              phys_page = frame_alloc(); // Allocate a physical frame
-              if (!phys_page) {
-                  serial_printf("[Process] load_elf: ERROR: Failed to allocate frame for V=%p in '%s'.\n", (void*)page_v, path);
-                  result = -ENOMEM;
-                  goto cleanup_load_elf; // phys_page != 0 will be handled in cleanup
-              }
-              PROC_DEBUG_PRINTF("     Allocated frame P=%#lx", (unsigned long)phys_page);
-
-              // Calculate data/padding for this specific page (logic remains the same)
-              size_t copy_size_this_page = 0;
-              size_t zero_padding_this_page = 0;
-              size_t file_buffer_offset = 0;
-              uintptr_t file_copy_start_vaddr = phdr->p_vaddr;
-              uintptr_t file_copy_end_vaddr = phdr->p_vaddr + phdr->p_filesz;
-              uintptr_t page_start_vaddr = page_v;
-              uintptr_t page_end_vaddr = page_v + PAGE_SIZE;
-              uintptr_t copy_v_start = MAX(page_start_vaddr, file_copy_start_vaddr);
-              uintptr_t copy_v_end = MIN(page_end_vaddr, file_copy_end_vaddr);
-              copy_size_this_page = (copy_v_end > copy_v_start) ? (copy_v_end - copy_v_start) : 0;
-              if (copy_size_this_page > 0) {
-                  file_buffer_offset = (copy_v_start - phdr->p_vaddr) + phdr->p_offset;
-                  if (file_buffer_offset + copy_size_this_page > file_size || file_buffer_offset < phdr->p_offset) {
-                      serial_printf("[Process] load_elf: ERROR: File offset calculation error for V=%p in '%s'.\n", (void*)page_v, path);
-                      result = -ENOEXEC; goto cleanup_load_elf;
-                  }
-              }
-              uintptr_t mem_end_vaddr = phdr->p_vaddr + phdr->p_memsz;
-              uintptr_t zero_v_start = page_start_vaddr + copy_size_this_page;
-              uintptr_t zero_v_end = MIN(page_end_vaddr, mem_end_vaddr);
-              zero_padding_this_page = (zero_v_end > zero_v_start) ? (zero_v_end - zero_v_start) : 0;
-              if (copy_size_this_page + zero_padding_this_page > PAGE_SIZE) {
-                  serial_printf("[Process] load_elf: ERROR: Calculated copy+zero size (%lu) exceeds PAGE_SIZE for V=%p in '%s'.\n",
-                                  (unsigned long)(copy_size_this_page + zero_padding_this_page), (void*)page_v, path);
-                  result = -ENOEXEC; goto cleanup_load_elf;
-              }
-              PROC_DEBUG_PRINTF("     CopySize=%lu, ZeroPadding=%lu, FileOffset=%lu", (unsigned long)copy_size_this_page, (unsigned long)zero_padding_this_page, (unsigned long)file_buffer_offset);
-
-              // Populate the allocated physical frame
-              if (copy_elf_segment_data(phys_page, file_data, file_buffer_offset, copy_size_this_page, zero_padding_this_page) != 0) {
-                  serial_printf("[Process] load_elf: ERROR: copy_elf_segment_data failed for V=%p in '%s'.\n", (void*)page_v, path);
-                  result = -EIO; // Indicate an I/O related error during population
-                  goto cleanup_load_elf; // phys_page will be handled in cleanup
-              }
-
-              // Map the populated frame into the process's address space using the derived page protection flags
-              PROC_DEBUG_PRINTF("     Mapping V=%p -> P=%#lx with prot %#x", (void*)page_v, (unsigned long)phys_page, (unsigned)page_prot);
-              int map_res = paging_map_single_4k(mm->pgd_phys, page_v, phys_page, page_prot);
-              if (map_res != 0) {
-                  serial_printf("[Process] load_elf: ERROR: paging_map_single_4k failed for V=%p -> P=%#lx in '%s' (err %d).\n",
-                                  (void*)page_v, (unsigned long)phys_page, path, map_res);
-                  put_frame(phys_page); // Free the frame since mapping failed
-                  phys_page = 0; // Reset tracker
-                  result = -ENOMEM; // Mapping failure likely due to page table allocation
-                  goto cleanup_load_elf;
-              }
-              // Mapping successful, frame ownership transferred to page tables. Reset tracker.
-              phys_page = 0;
-          } // End loop for pages within a segment
+          // File data ends at p_filesz; the rest is .bss. The mm is not live yet.
+          vma->vm_file_bytes = file_backed ? (phdr->p_vaddr - vm_start) + phdr->p_filesz : 0;
 
           // Update the highest virtual address loaded so far
           uintptr_t current_segment_end = phdr->p_vaddr + phdr->p_memsz;
-          if (current_segment_end < phdr->p_vaddr) current_segment_end = UINTPTR_MAX; // Handle overflow
           if (current_segment_end > highest_addr_loaded) {
               highest_addr_loaded = current_segment_end;
           }
-          PROC_DEBUG_PRINTF("  Segment %u processed. highest_addr_loaded=%#lx", (unsigned)i, (unsigned long)highest_addr_loaded);
+          PROC_DEBUG_PRINTF("  Segment %u registered. highest_addr_loaded=%#lx", (unsigned)i, (unsigned long)highest_addr_loaded);
       } // End loop through segments
 
       // 4. Set Initial Program Break (end of loaded data, page-aligned up)
@@ -579,16 +318,44 @@
 
   cleanup_load_elf:
       PROC_DEBUG_PRINTF("Cleanup: result=%d", result);
-      if (file_data) { kfree(file_data); } // Free the buffer allocated by read_file
-      if (phys_page != 0) { // Free frame if allocation failed mid-segment
-         PROC_DEBUG_PRINTF("  Freeing dangling phys_page P=%#lx", (unsigned long)phys_page);
-          put_frame(phys_page);
-      }
+      sys_file_put(exe); // The segment VMAs hold their own references
       PROC_DEBUG_PRINTF("Exit result=%d", result);
       return result;
  }
  
  
+ /**
+  * @brief Builds a program's address space in @p mm; see proc_snapshot.h.
+  * The ELF segments, then the empty heap at the initial break and the user
+  * stack VMA. Nothing is mapped: the snapshot code faults the text in and
+  * each process maps its own argument page.
+  */
+ int process_build_image(const char *path, mm_struct_t *mm, uint32_t *entry_point)
+ {
+     uintptr_t initial_brk = 0;
+     int ret = load_elf_and_init_memory(path, mm, entry_point, &initial_brk);
+     if (ret != 0) {
+         serial_printf("[Process] ERROR: Failed to load ELF '%s' (Error code %d).\n", path, ret);
+         return ret;
+     }
+     mm->start_brk = mm->end_brk = initial_brk;
+
+     uintptr_t heap_start = mm->end_brk;
+     KERNEL_ASSERT(heap_start < USER_STACK_BOTTOM_VIRT, "Heap start overlaps user stack area");
+     uint32_t heap_page_prot = PAGE_PRESENT | PAGE_RW | PAGE_USER | (g_nx_supported ? PAGE_NX_BIT : 0);
+     if (!insert_vma(mm, heap_start, heap_start, VM_READ | VM_WRITE | VM_USER | VM_ANONYMOUS | VM_HEAP, heap_page_prot, NULL, 0)) {
+         return -ENOMEM;
+     }
+     serial_printf("  Initial Heap VMA placeholder added: [%#lx - %#lx)\n", (unsigned long)heap_start, (unsigned long)heap_start);
+     uint32_t stack_page_prot = PAGE_PRESENT | PAGE_RW | PAGE_USER | (g_nx_supported ? PAGE_NX_BIT : 0);
+     if (!insert_vma(mm, USER_STACK_BOTTOM_VIRT, USER_STACK_TOP_VIRT_ADDR, VM_READ | VM_WRITE | VM_USER | VM_GROWS_DOWN | VM_ANONYMOUS, stack_page_prot, NULL, 0)) {
+         return -ENOMEM;
+     }
+     serial_printf("  User Stack VMA added: [%#lx - %#lx)\n", (unsigned long)USER_STACK_BOTTOM_VIRT, (unsigned long)USER_STACK_TOP_VIRT_ADDR);
+     return 0;
+ }
+
+
  // ------------------------------------------------------------------------
  // prepare_initial_kernel_stack - Sets up the kernel stack for first IRET
  // ------------------------------------------------------------------------
@@ -665,73 +432,108 @@
  
  
  /**
- * @brief Creates a new user process by loading an ELF executable.
- * Sets up PCB, memory space (page directory, VMAs), kernel stack,
- * user stack, loads ELF segments, prepares the initial kernel stack
- * for context switching, and updates the TSS esp0 field.
+  * @brief Lays out argc, argv and envp at the top of the first user stack
+  * page, which the kernel sees at @p page: the strings at the very top, and
+  * below them (16-byte aligned) argc, argv[], NULL, envp[], NULL.
+  * @return The initial user ESP (pointing at argc), or 0 if it doesn't fit.
+  */
+ static uintptr_t setup_user_args(void *page, const char *const argv[], const char *const envp[])
+ {
+     uint32_t argc = 0, envc = 0;
+     size_t str_bytes = 0;
+     for (; argv && argv[argc]; argc++) str_bytes += strlen(argv[argc]) + 1;
+     for (; envp && envp[envc]; envc++) str_bytes += strlen(envp[envc]) + 1;
+     size_t vec_bytes = (argc + envc + 3) * sizeof(uint32_t);
+     if (str_bytes + vec_bytes + 16 > PAGE_SIZE) return 0;
+
+     const uintptr_t page_uaddr = USER_STACK_TOP_VIRT_ADDR - PAGE_SIZE;
+     size_t str_off = PAGE_SIZE - str_bytes;
+     size_t sp_off = (str_off - vec_bytes) & ~(size_t)15;
+     uint32_t *vec = (uint32_t *)((uint8_t *)page + sp_off);
+
+     *vec++ = argc;
+     for (int pass = 0; pass < 2; pass++) {
+         const char *const *strv = pass ? envp : argv;
+         for (uint32_t i = 0; strv && strv[i]; i++) {
+             size_t len = strlen(strv[i]) + 1;
+             memcpy((uint8_t *)page + str_off, strv[i], len);
+             *vec++ = (uint32_t)(page_uaddr + str_off);
+             str_off += len;
+         }
+         *vec++ = 0;
+     }
+     return page_uaddr + sp_off;
+ }
+
+ pcb_t *create_user_process(const char *path)
+ {
+     const char *const argv[] = { path, NULL };
+     return create_user_process_args(path, argv, NULL, NULL);
+ }
+
+ /**
+ * @brief Creates a new user process from an ELF executable.
+ * Sets up the PCB, copies the program's address space (page directory,
+ * VMAs, mapped text) from its snapshot (proc_snapshot.h), which loads the
+ * ELF the first time, maps the user stack (holding argv and envp) and the
+ * vvar pages, prepares the initial kernel stack for context switching, and
+ * updates the TSS esp0 field.
  * @param path Path to the executable file.
  * @return Pointer to the newly created PCB on success, NULL on failure.
  */
- pcb_t *create_user_process(const char *path)
+ pcb_t *create_user_process_args(const char *path, const char *const argv[],
+                                 const char *const envp[], int *err)
  {
      PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Enter path='%s'\n", __func__, __LINE__, path ? path : "<NULL>");
      KERNEL_ASSERT(path != NULL, "create_user_process: NULL path");
      serial_printf("[Process] Creating user process from '%s'.\n", path);
 
      pcb_t *proc = NULL;
+     proc_snapshot_t *snap = NULL;
      uintptr_t pd_phys = 0;
-     void* proc_pd_virt_temp = NULL;
-     bool pd_mapped_temp = false;
      bool initial_stack_mapped = false;
      uintptr_t initial_stack_phys_frame = 0;
      int ret_status = 0; // Track status for cleanup message
 
-     // === Declare local variables needed for ELF loading and verification ===
-     uint32_t entry_point = 0;           // <<< FIXED: Declare entry_point
-     uintptr_t initial_brk = 0;          // <<< FIXED: Declare initial_brk
-     bool mapping_error = false;        // <<< FIXED: Declare mapping_error
-     // =======================================================================
+     bool mapping_error = false;
 
      // --- Step 1: Allocate PCB ---
      PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Step 1: Allocate PCB\n", __func__, __LINE__);
      proc = (pcb_t *)kmalloc(sizeof(pcb_t));
      if (!proc) {
          serial_write("[Process] ERROR: kmalloc PCB failed.\n");
+         if (err) *err = -ENOMEM;
          return NULL;
      }
      memset(proc, 0, sizeof(pcb_t));
-     proc->pid = next_pid++; // TODO: Lock this for SMP
+     proc->pid = pid_alloc();
+     if (!proc->pid) {
+         serial_write("[Process] ERROR: out of PIDs.\n");
+         kfree(proc);
+         if (err) *err = -EAGAIN;
+         return NULL;
+     }
      PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] PCB allocated at %p, PID=%lu\n", __func__, __LINE__, proc, (unsigned long)proc->pid);
 
      // === Step 1.5: Initialize File Descriptors and Lock ===
      process_init_fds(proc);
      // =======================================================
 
-     // --- Step 2: Allocate Page Directory Frame ---
-     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Step 2: Allocate Page Directory Frame\n", __func__, __LINE__);
-     pd_phys = frame_alloc();
+     // --- Step 2: Find or build the program's snapshot ---
+     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Step 2: Snapshot of '%s'\n", __func__, __LINE__, path);
+     snap = proc_snapshot_get(path, &ret_status);
+     if (!snap) goto fail_create;
+
+     // --- Step 3: Copy its page directory (mapped text shared, kernel half as always) ---
+     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Step 3: Clone snapshot PD\n", __func__, __LINE__);
+     pd_phys = paging_clone_directory(snap->pd_phys, &snap->mm->lock); // Per table, like a fork parent's
      if (!pd_phys) {
-         serial_printf("[Process] ERROR: frame_alloc PD failed for PID %lu.\n", (unsigned long)proc->pid);
+         serial_printf("[Process] ERROR: PD clone failed for PID %lu.\n", (unsigned long)proc->pid);
          ret_status = -ENOMEM;
          goto fail_create;
      }
      proc->page_directory_phys = (uint32_t*)pd_phys;
-     serial_printf("  Allocated PD Phys: %#lx for PID %lu\n", (unsigned long)pd_phys, (unsigned long)proc->pid);
-
-     // --- Step 3: Initialize Page Directory ---
-     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Step 3: Initialize Page Directory (PD Phys=%#lx)\n", __func__, __LINE__, (unsigned long)pd_phys);
-     // ... (Temp map PD, memset, copy_kernel_pde_entries, set recursive entry, unmap temp PD) ...
-     proc_pd_virt_temp = paging_temp_map(pd_phys, PTE_KERNEL_DATA_FLAGS);
-     if (!proc_pd_virt_temp) { /* ... error handling ... */ ret_status = -EIO; goto fail_create; }
-     pd_mapped_temp = true;
-     memset(proc_pd_virt_temp, 0, PAGE_SIZE);
-     copy_kernel_pde_entries((uint32_t*)proc_pd_virt_temp);
-     uint32_t recursive_flags = PAGE_PRESENT | PAGE_RW | (g_nx_supported ? PAGE_NX_BIT : 0);
-     ((uint32_t*)proc_pd_virt_temp)[RECURSIVE_PDE_INDEX] = (pd_phys & PAGING_ADDR_MASK) | recursive_flags;
-     paging_temp_unmap(proc_pd_virt_temp);
-     pd_mapped_temp = false;
-     proc_pd_virt_temp = NULL;
-     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d]   PD Initialization complete.\n", __func__, __LINE__);
+     serial_printf("  Cloned snapshot PD into Phys: %#lx for PID %lu\n", (unsigned long)pd_phys, (unsigned long)proc->pid);
 
      // ... (Verification block - now uses declared `mapping_error`) ...
       PROC_DEBUG_PRINTF("[Process DEBUG %s:%d]   Verifying copied kernel PDE entries...\n", __func__, __LINE__);
@@ -764,72 +566,47 @@
      PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Step 4: Allocate Kernel Stack\n", __func__, __LINE__);
      if (!allocate_kernel_stack(proc)) { ret_status = -ENOMEM; goto fail_create; }
 
-     // --- Step 5: Create Memory Management structure ---
-     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Step 5: Create mm_struct\n", __func__, __LINE__);
-     proc->mm = create_mm(proc->page_directory_phys);
-     if (!proc->mm) { ret_status = -ENOMEM; goto fail_create; }
-
-     // --- Step 6: Load ELF executable ---
-     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Step 6: Load ELF '%s'\n", __func__, __LINE__, path);
-     // <<< FIXED: Use the now-declared variables >>>
-     int load_res = load_elf_and_init_memory(path, proc->mm, &entry_point, &initial_brk);
-      if (load_res != 0) {
-          serial_printf("[Process] ERROR: Failed to load ELF '%s' (Error code %d).\n", path, load_res);
-          ret_status = load_res;
-          goto fail_create;
-      }
-      proc->entry_point = entry_point; // Assign result to PCB member
-      if (proc->mm) { proc->mm->start_brk = proc->mm->end_brk = initial_brk; } // Assign result
-      else { /* Should not happen */ ret_status = -EINVAL; goto fail_create; }
-
-
-     // --- Step 7: Setup standard VMAs ---
-     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Step 7: Setup standard VMAs\n", __func__, __LINE__);
-     // ... (Insert Heap and Stack VMAs) ...
-      uintptr_t heap_start = proc->mm->end_brk;
-      KERNEL_ASSERT(heap_start < USER_STACK_BOTTOM_VIRT, "Heap start overlaps user stack area");
-      uint32_t heap_page_prot = PAGE_PRESENT | PAGE_RW | PAGE_USER | (g_nx_supported ? PAGE_NX_BIT : 0);
-      if (!insert_vma(proc->mm, heap_start, heap_start, VM_READ | VM_WRITE | VM_USER | VM_ANONYMOUS, heap_page_prot, NULL, 0)) {
-           /* ... error handling ... */ ret_status = -ENOMEM; goto fail_create;
-      }
-      serial_printf("  Initial Heap VMA placeholder added: [%#lx - %#lx)\n", (unsigned long)heap_start, (unsigned long)heap_start);
-      uint32_t stack_page_prot = PAGE_PRESENT | PAGE_RW | PAGE_USER | (g_nx_supported ? PAGE_NX_BIT : 0);
-      if (!insert_vma(proc->mm, USER_STACK_BOTTOM_VIRT, USER_STACK_TOP_VIRT_ADDR, VM_READ | VM_WRITE | VM_USER | VM_GROWS_DOWN | VM_ANONYMOUS, stack_page_prot, NULL, 0)) {
-        /* ... error handling ... */ ret_status = -ENOMEM; goto fail_create;
-      }
-      serial_printf("  User Stack VMA added: [%#lx - %#lx)\n", (unsigned long)USER_STACK_BOTTOM_VIRT, (unsigned long)USER_STACK_TOP_VIRT_ADDR);
+     // --- Step 5: Copy the snapshot's VMAs and layout ---
+     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Step 5: Clone snapshot mm_struct\n", __func__, __LINE__);
+     proc->mm = clone_mm(snap->mm, proc->page_directory_phys);
+     if (!proc->mm) {
+         paging_free_user_space(proc->page_directory_phys); // No VMAs to drop the shared frames
+         ret_status = -ENOMEM;
+         goto fail_create;
+     }
+     proc->entry_point = snap->entry_point;
+
+     // --- Step 6: Per-process vvar pages ---
+     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Step 6: Map vvar pages\n", __func__, __LINE__);
+     if (vvar_map_process(proc) != 0) { ret_status = -ENOMEM; goto fail_create; }
 
-     // --- Step 8: Allocate and Map Initial User Stack Page ---
-     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Step 8: Allocate initial user stack page\n", __func__, __LINE__);
-     initial_stack_phys_frame = frame_alloc();
+     // --- Step 7: Allocate and Map Initial User Stack Page ---
+     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Step 7: Allocate initial user stack page\n", __func__, __LINE__);
+     uint32_t stack_page_prot = PAGE_PRESENT | PAGE_RW | PAGE_USER | (g_nx_supported ? PAGE_NX_BIT : 0);
+     initial_stack_phys_frame = frame_alloc_mt(MIGRATE_MOVABLE);
      if (!initial_stack_phys_frame) { /* ... error handling ... */ ret_status = -ENOMEM; goto fail_create; }
      uintptr_t initial_user_stack_page_vaddr = USER_STACK_TOP_VIRT_ADDR - PAGE_SIZE;
      int map_res = paging_map_single_4k(proc->page_directory_phys, initial_user_stack_page_vaddr, initial_stack_phys_frame, stack_page_prot);
      if (map_res != 0) { /* ... error handling ... */ ret_status = -EIO; goto fail_create; }
      initial_stack_mapped = true;
-     proc->user_stack_top = (void*)USER_STACK_TOP_VIRT_ADDR;
+     // Zero the page and put the arguments at its top; ESP starts at argc
+     void* temp_stack_map = paging_temp_map(initial_stack_phys_frame, PTE_KERNEL_DATA_FLAGS);
+     if (!temp_stack_map) { ret_status = -EIO; goto fail_create; }
+     clear_page(temp_stack_map);
+     uintptr_t initial_user_esp = setup_user_args(temp_stack_map, argv, envp);
+     paging_temp_unmap(temp_stack_map);
+     if (!initial_user_esp) { ret_status = -E2BIG; goto fail_create; }
+     proc->user_stack_top = (void*)initial_user_esp;
      serial_printf("  Initial user stack page allocated (P=%#lx) and mapped (V=%p). User ESP set to %p.\n",
                      (unsigned long)initial_stack_phys_frame, (void*)initial_user_stack_page_vaddr, proc->user_stack_top);
-     // ... (Zero out stack page) ...
-     void* temp_stack_map = paging_temp_map(initial_stack_phys_frame, PTE_KERNEL_DATA_FLAGS);
-      if (temp_stack_map) { memset(temp_stack_map, 0, PAGE_SIZE); paging_temp_unmap(temp_stack_map); }
-      else { /* ... warning ... */ }
 
-     // --- Step 8.5: Verify EIP/ESP Mappings ---
+     // --- Step 7.5: Verify EIP/ESP Mappings ---
      PROC_DEBUG_PRINTF("[Process DEBUG %s:%d]   Verifying EIP and ESP mappings/flags in Proc PD P=%#lx...\n", __func__, __LINE__, (unsigned long)proc->page_directory_phys);
      // ... (Actual verification logic block - unchanged, uses `mapping_error`) ...
-      // Verify EIP page
+      // Verify EIP: segments are demand-paged, so check for an executable VMA, not a PTE
       uintptr_t eip_vaddr = proc->entry_point;
-      uintptr_t eip_page_vaddr = PAGE_ALIGN_DOWN(eip_vaddr);
-      uintptr_t eip_phys = 0;
-      uint32_t eip_pte_flags = 0;
-      int eip_check_res = paging_get_physical_address_and_flags(proc->page_directory_phys, eip_page_vaddr, &eip_phys, &eip_pte_flags);
-      if (eip_check_res != 0 || eip_phys == 0) { /* ... set mapping_error ... */ mapping_error = true; }
-      else { /* ... check flags, set mapping_error if bad ... */
-          bool flags_ok = (eip_pte_flags & PAGE_PRESENT) && (eip_pte_flags & PAGE_USER);
-          // Add NX check if needed
-          if (!flags_ok) mapping_error = true;
-      }
+      vma_struct_t *eip_vma = find_vma(proc->mm, eip_vaddr);
+      if (!eip_vma || !(eip_vma->vm_flags & VM_EXEC)) mapping_error = true;
       // Verify ESP page
       uintptr_t esp_page_vaddr_check = USER_STACK_TOP_VIRT_ADDR - PAGE_SIZE;
       uintptr_t esp_phys = 0;
@@ -849,11 +626,12 @@
      PROC_DEBUG_PRINTF("[Process DEBUG %s:%d]   User EIP and ESP mapping & flags verification passed.\n", __func__, __LINE__);
 
 
-     // --- Step 9: Prepare Initial Kernel Stack for IRET ---
-     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Step 9: Prepare initial kernel stack for IRET\n", __func__, __LINE__);
+     // --- Step 8: Prepare Initial Kernel Stack for IRET ---
+     PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Step 8: Prepare initial kernel stack for IRET\n", __func__, __LINE__);
      prepare_initial_kernel_stack(proc);
 
      // --- SUCCESS ---
+     proc_snapshot_put(snap);
      serial_printf("[Process] Successfully created PCB PID %lu structure for '%s'.\n",
                      (unsigned long)proc->pid, path);
      PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Exit OK (proc=%p)\n", __func__, __LINE__, proc);
@@ -864,10 +642,7 @@
      serial_printf("[Process] Cleanup after create_user_process failed (PID %lu, Status %d).\n",
                      (unsigned long)(proc ? proc->pid : 0), ret_status);
      // ... (Cleanup logic as before, calling destroy_process if proc is valid) ...
-      if (pd_mapped_temp && proc_pd_virt_temp != NULL) {
-          PROC_DEBUG_PRINTF("[Process DEBUG %s:%d]   Cleaning up dangling temporary PD mapping %p\n", __func__, __LINE__, proc_pd_virt_temp);
-          paging_temp_unmap(proc_pd_virt_temp);
-      }
+      proc_snapshot_put(snap);
       if (initial_stack_phys_frame != 0 && !initial_stack_mapped) {
            PROC_DEBUG_PRINTF("[Process DEBUG %s:%d]   Freeing unmapped initial user stack frame P=%#lx\n", __func__, __LINE__, (unsigned long)initial_stack_phys_frame);
            put_frame(initial_stack_phys_frame);
@@ -884,6 +659,7 @@
           }
       }
 
+     if (err) *err = ret_status ? ret_status : -ENOMEM;
      PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Exit FAIL (NULL)\n", __func__, __LINE__);
      return NULL; // Indicate failure
  }
@@ -902,8 +678,19 @@
   void destroy_process(pcb_t *pcb)
   {
        if (!pcb) return;
- 
-       uint32_t pid = pcb->pid; // Store PID for logging before freeing PCB
+       uint32_t pid = pcb->pid;
+       process_release_resources(pcb);
+       pcb_free(pcb); // Free the pcb_t struct and its PID
+       serial_printf("[Process] PCB PID %lu freed.\n", (unsigned long)pid);
+  }
+
+ /**
+  * @brief Steps 1-4 of destroy_process(): everything but the PCB itself.
+  * Leaves the PCB safe to keep around as an exit record.
+  */
+  static void process_release_resources(pcb_t *pcb)
+  {
+       uint32_t pid = pcb->pid;
        // Using serial write assuming terminal might rely on functioning process/memory
        serial_printf("[destroy_process] Enter for PID %lu\n", (unsigned long)pid);
  
@@ -917,6 +704,9 @@
        process_close_fds(pcb);
        check_idle_task_stack_integrity("destroy_process: After close_fds");
        serial_write("[destroy_process] Step 1: FDs closed.\n");
+       kfree(pcb->io_ring); // Only the kernel's copy; the ring block itself is user memory
+       pcb->io_ring = NULL;
+       syscall_trace_release(pcb); // Prints the last calls to serial
  
        // 2. Destroy Memory Management structure (handles user space VMAs, page tables, frames)
        serial_write("[destroy_process] Step 2: Destroying MM (user space memory)...\n");
@@ -933,46 +723,11 @@
        check_idle_task_stack_integrity("destroy_process: After destroy_mm");
        serial_write("[destroy_process] Step 2: MM destroyed.\n");
  
-       // 3. Free Kernel Stack (Including Guard Page)
-       serial_write("[destroy_process] Step 3: Freeing Kernel Stack (incl. guard)...\n");
+       // 3. Return the Kernel Stack to the stack cache
+       serial_write("[destroy_process] Step 3: Freeing Kernel Stack...\n");
        check_idle_task_stack_integrity("destroy_process: Before kernel stack free");
        if (pcb->kernel_stack_vaddr_top != NULL) {
-           // kernel_stack_vaddr_top points to the end of the *usable* stack (e.g., 0xe0004000)
-           uintptr_t stack_top_usable = (uintptr_t)pcb->kernel_stack_vaddr_top;
-           size_t usable_stack_size = PROCESS_KSTACK_SIZE;
-           // *** GUARD PAGE FIX: Calculate total size including guard ***
-           size_t total_stack_size = usable_stack_size + PAGE_SIZE;
-           size_t num_pages_with_guard = total_stack_size / PAGE_SIZE;
-           uintptr_t stack_base = stack_top_usable - usable_stack_size; // Base of usable stack (e.g., 0xe0000000)
- 
-           serial_printf("  Freeing kernel stack (incl. guard): V=[%p-%p)\n",
-                           (void*)stack_base, (void*)(stack_base + total_stack_size));
- 
-           // Free physical frames (Iterate over usable + guard page)
-           serial_write("  Freeing kernel stack frames (incl. guard)...\n");
-           for (size_t i = 0; i < num_pages_with_guard; ++i) { // *** GUARD PAGE FIX: Loop limit ***
-               uintptr_t v_addr = stack_base + (i * PAGE_SIZE);
-               uintptr_t phys_addr = 0;
-               // Get physical address from KERNEL page directory
-               if (g_kernel_page_directory_phys &&
-                   paging_get_physical_address((uint32_t*)g_kernel_page_directory_phys, v_addr, &phys_addr) == 0)
-               {
-                   if (phys_addr != 0) {
-                       put_frame(phys_addr); // Free the physical frame
-                   } else {
-                       serial_printf("[destroy_process] Warning: Kernel stack V=%p maps to P=0?\n", (void*)v_addr);
-                   }
-               } else {
-                    serial_printf("[destroy_process] Warning: Failed to get physical addr for kernel stack V=%p during cleanup.\n", (void*)v_addr);
-               }
-           }
-           serial_write("  Kernel stack frames (incl. guard) freed.\n");
- 
-           // NOTE: We do NOT unmap kernel stack from the kernel page directory
-           // Kernel stacks are in kernel space and the mappings are shared across all processes
-           // Just free the physical frames above, don't unmap the virtual addresses
-           serial_write("  Kernel stack physical frames freed (virtual mappings remain in kernel PD).\n");
- 
+           kstack_free(pcb->kernel_stack_vaddr_top);
            pcb->kernel_stack_vaddr_top = NULL;
            pcb->kernel_stack_phys_base = 0;
        } else {
@@ -999,18 +754,289 @@
        check_idle_task_stack_integrity("destroy_process: After PD frame free");
        serial_write("[destroy_process] Step 4: Page Directory Frame freed.\n");
  
-       // 5. Free the PCB structure itself
-       serial_write("[destroy_process] Step 5: Freeing PCB structure...\n");
-       check_idle_task_stack_integrity("destroy_process: Before kfree(pcb)");
-       kfree(pcb); // Free the memory allocated for the pcb_t struct
-       check_idle_task_stack_integrity("destroy_process: After kfree(pcb)");
-       serial_write("[destroy_process] Step 5: PCB structure freed.\n");
- 
        serial_printf("[Process] PCB PID %lu resources freed.\n", (unsigned long)pid);
        serial_printf("[destroy_process] Exit for PID %lu\n", (unsigned long)pid);
        PROC_DEBUG_PRINTF("[Process DEBUG %s:%d] Exit PID=%lu\n", __func__, __LINE__, (unsigned long)pid);
   }
  
+ // ------------------------------------------------------------------------
+ // Process tree: fork, exit and waitpid
+ // ------------------------------------------------------------------------
+ /**
+  * @brief Duplicates the calling process; see process.h.
+  * The child's kernel stack starts with a copy of the parent's syscall frame,
+  * so its first switch-in leaves through the syscall exit path (see
+  * scheduler_add_forked_task) and it returns from fork() with EAX = 0.
+  */
+ int32_t process_fork(isr_frame_t *frame)
+ {
+     pcb_t *parent = get_current_process();
+     KERNEL_ASSERT(parent != NULL && frame != NULL, "process_fork: no calling process");
+     if (!parent->mm || !parent->page_directory_phys) return -EINVAL;
+
+     pcb_t *child = (pcb_t *)kmalloc(sizeof(pcb_t));
+     if (!child) return -ENOMEM;
+     memset(child, 0, sizeof(pcb_t));
+     child->pid = pid_alloc();
+     if (!child->pid) {
+         kfree(child);
+         return -EAGAIN;
+     }
+     child->ppid = parent->pid;
+     process_init_fds(child);
+
+     // 1. Open files: the child holds a reference on each of the parent's
+     if (fd_table_clone(child, parent) != 0) goto fail;
+
+     // 2. Address space: page tables copied, user frames shared read-only.
+     //    The copy takes the mm lock one page table at a time, keeping
+     //    sibling threads' faults and the swap clock off the table it copies.
+     uintptr_t pd_phys = paging_clone_directory(parent->page_directory_phys, &parent->mm->lock);
+     if (!pd_phys) goto fail;
+     child->page_directory_phys = (uint32_t *)pd_phys;
+
+     child->mm = clone_mm(parent->mm, child->page_directory_phys);
+     if (!child->mm) {
+         paging_free_user_space(child->page_directory_phys); // No VMAs to drop the shared frames
+         goto fail;
+     }
+     if (vvar_fork_process(child) != 0) goto fail;
+
+     // 3. Kernel stack. allocate_kernel_stack() points TSS.esp0 at the new
+     //    stack; the parent returns to user mode from this one, so put it back.
+     bool stack_ok = allocate_kernel_stack(child);
+     tss_set_kernel_stack((uint32_t)task_kernel_stack_top(get_current_task()));
+     if (!stack_ok) goto fail;
+
+     child->entry_point = parent->entry_point;
+     child->user_stack_top = parent->user_stack_top;
+
+     isr_frame_t *child_frame = (isr_frame_t *)((uintptr_t)child->kernel_stack_vaddr_top - sizeof(isr_frame_t));
+     memcpy(child_frame, frame, sizeof(isr_frame_t));
+     child_frame->eax = 0; // fork() returns 0 in the child
+     child->kernel_esp_for_switch = (uint32_t)(uintptr_t)child_frame;
+     child->state = PROC_READY;
+
+     // 4. Link into the tree before the child can run (and exit)
+     uintptr_t tree_irq_flags = spinlock_acquire_irqsave(&g_proc_tree_lock);
+     child->parent = parent;
+     child->sibling = parent->children;
+     parent->children = child;
+     spinlock_release_irqrestore(&g_proc_tree_lock, tree_irq_flags);
+
+     if (scheduler_add_forked_task(child) != 0) {
+         tree_irq_flags = spinlock_acquire_irqsave(&g_proc_tree_lock);
+         pcb_t **link = &parent->children;
+         while (*link && *link != child) link = &(*link)->sibling;
+         if (*link) *link = child->sibling;
+         spinlock_release_irqrestore(&g_proc_tree_lock, tree_irq_flags);
+         goto fail;
+     }
+
+     serial_printf("[Process] PID %lu forked child PID %lu.\n",
+                     (unsigned long)parent->pid, (unsigned long)child->pid);
+     return (int32_t)child->pid;
+
+ fail:
+     serial_printf("[Process] ERROR: fork of PID %lu failed.\n", (unsigned long)parent->pid);
+     destroy_process(child); // Drops the file references, mm, stack and PD taken so far
+     return -ENOMEM;
+ }
+
+ /**
+  * @brief Spawns a child of the calling process; see process.h.
+  * The child is built like any new program (its text comes shared from the
+  * page cache, everything else is demand-paged), takes references on the
+  * caller's open files and then runs the file actions against its own table,
+  * so the caller's fds are never touched.
+  */
+ int32_t process_spawn(const char *path, const char *const argv[], const char *const envp[],
+                       const spawn_fd_action_t *actions, uint32_t nr_actions)
+ {
+     pcb_t *parent = get_current_process();
+     KERNEL_ASSERT(parent != NULL && path != NULL, "process_spawn: no calling process");
+
+     int err = 0;
+     pcb_t *child = create_user_process_args(path, argv, envp, &err);
+     // allocate_kernel_stack() pointed TSS.esp0 at the child's stack; we return on ours
+     tss_set_kernel_stack((uint32_t)task_kernel_stack_top(get_current_task()));
+     if (!child) return err;
+
+     err = fd_table_clone(child, parent);
+     for (uint32_t i = 0; err == 0 && i < nr_actions; i++) {
+         const spawn_fd_action_t *a = &actions[i];
+         if (a->op == SPAWN_FD_CLOSE) err = fd_table_close(child, a->fd);
+         else if (a->op == SPAWN_FD_DUP2) err = fd_table_dup2(child, a->fd, a->newfd);
+         else err = -EINVAL;
+         if (err > 0) err = 0; // dup2 returns newfd
+     }
+     if (err < 0) {
+         destroy_process(child);
+         return err;
+     }
+
+     // Link into the tree before the child can run (and exit), as fork does
+     child->ppid = parent->pid;
+     uintptr_t tree_irq_flags = spinlock_acquire_irqsave(&g_proc_tree_lock);
+     child->parent = parent;
+     child->sibling = parent->children;
+     parent->children = child;
+     spinlock_release_irqrestore(&g_proc_tree_lock, tree_irq_flags);
+
+     if (scheduler_add_task(child) != 0) {
+         tree_irq_flags = spinlock_acquire_irqsave(&g_proc_tree_lock);
+         pcb_t **link = &parent->children;
+         while (*link && *link != child) link = &(*link)->sibling;
+         if (*link) *link = child->sibling;
+         spinlock_release_irqrestore(&g_proc_tree_lock, tree_irq_flags);
+         destroy_process(child);
+         return -ENOMEM;
+     }
+
+     serial_printf("[Process] PID %lu spawned '%s' as PID %lu.\n",
+                     (unsigned long)parent->pid, path, (unsigned long)child->pid);
+     return (int32_t)child->pid;
+ }
+
+ /**
+  * @brief Starts a thread of the calling process; see process.h.
+  * Its kernel stack comes from the stack cache and belongs to its TCB,
+  * which frees it when reaped; the process's own stack stays with the process.
+  */
+ int32_t process_thread_create(isr_frame_t *frame, uintptr_t entry, uintptr_t stack_top, uint32_t arg)
+ {
+     pcb_t *proc = get_current_process();
+     KERNEL_ASSERT(proc != NULL && frame != NULL, "process_thread_create: no calling process");
+     if (!proc->mm || entry == 0 || entry >= KERNEL_SPACE_VIRT_START) return -EINVAL;
+
+     // entry(arg) called from a zero return address, on a 16-byte aligned stack
+     uint32_t call_frame[2] = { 0, arg };
+     uintptr_t user_esp = (stack_top & ~(uintptr_t)15) - sizeof(call_frame);
+     if (stack_top >= KERNEL_SPACE_VIRT_START || user_esp >= stack_top ||
+         copy_to_user((userptr_t)user_esp, (const_kernelptr_t)call_frame, sizeof(call_frame)) != 0) {
+         return -EFAULT;
+     }
+
+     uint32_t *stack_top_k = kstack_alloc();
+     if (!stack_top_k) return -ENOMEM;
+
+     isr_frame_t *thread_frame = (isr_frame_t *)((uintptr_t)stack_top_k - sizeof(isr_frame_t));
+     memcpy(thread_frame, frame, sizeof(isr_frame_t));
+     thread_frame->eip = (uint32_t)entry;
+     thread_frame->useresp = (uint32_t)user_esp;
+     thread_frame->eax = 0;
+     thread_frame->ebp = 0;
+
+     uint32_t tid = pid_alloc();
+     if (!tid) {
+         kstack_free(stack_top_k);
+         return -EAGAIN;
+     }
+     __atomic_add_fetch(&proc->nr_threads, 1, __ATOMIC_ACQ_REL); // >= 1 already: we are running
+     if (scheduler_add_thread(proc, tid, stack_top_k, (uint32_t)(uintptr_t)thread_frame) != 0) {
+         __atomic_sub_fetch(&proc->nr_threads, 1, __ATOMIC_ACQ_REL);
+         kstack_free(stack_top_k);
+         pid_free(tid);
+         return -ENOMEM;
+     }
+     serial_printf("[Process] PID %lu started thread %lu.\n", (unsigned long)proc->pid, (unsigned long)tid);
+     return (int32_t)tid;
+ }
+
+ /**
+  * @brief Tears down an exited process; see process.h.
+  */
+ void process_exit_release(pcb_t *pcb, uint32_t exit_code)
+ {
+     if (!pcb) return;
+     process_release_resources(pcb);
+
+     pcb_t *orphans_to_free = NULL;
+     uintptr_t irq_flags = spinlock_acquire_irqsave(&g_proc_tree_lock);
+     // Children outlive us without a parent; exit records nobody will collect go now.
+     pcb_t *c = pcb->children;
+     while (c) {
+         pcb_t *next = c->sibling;
+         c->parent = NULL;
+         c->sibling = NULL;
+         if (c->exited) {
+             c->sibling = orphans_to_free;
+             orphans_to_free = c;
+         }
+         c = next;
+     }
+     pcb->children = NULL;
+
+     bool keep_record = (pcb->parent != NULL);
+     if (keep_record) {
+         pcb->exit_code = exit_code;
+         pcb->state = PROC_ZOMBIE;
+         pcb->exited = true;
+     }
+     spinlock_release_irqrestore(&g_proc_tree_lock, irq_flags);
+
+     while (orphans_to_free) {
+         pcb_t *next = orphans_to_free->sibling;
+         pcb_free(orphans_to_free);
+         orphans_to_free = next;
+     }
+     if (keep_record) wake_up_all(&g_child_exit_wq);
+     else pcb_free(pcb);
+ }
+
+ /** @brief True if @p parent has an exited child matching @p pid (or no matching child at all). */
+ static bool child_exit_pending(pcb_t *parent, int32_t pid)
+ {
+     bool pending = true;
+     uintptr_t irq_flags = spinlock_acquire_irqsave(&g_proc_tree_lock);
+     for (pcb_t *c = parent->children; c; c = c->sibling) {
+         if (pid != -1 && c->pid != (uint32_t)pid) continue;
+         pending = c->exited;
+         if (pending) break;
+     }
+     spinlock_release_irqrestore(&g_proc_tree_lock, irq_flags);
+     return pending;
+ }
+
+ /**
+  * @brief Waits for and reaps a child; see process.h.
+  */
+ int32_t process_waitpid(int32_t pid, int *status, uint32_t options)
+ {
+     pcb_t *parent = get_current_process();
+     KERNEL_ASSERT(parent != NULL, "process_waitpid: no calling process");
+     if (pid == 0 || pid < -1) return -EINVAL; // No process groups
+
+     for (;;) {
+         bool have_child = false;
+         pcb_t *reaped = NULL;
+         uintptr_t irq_flags = spinlock_acquire_irqsave(&g_proc_tree_lock);
+         for (pcb_t **link = &parent->children; *link; link = &(*link)->sibling) {
+             pcb_t *c = *link;
+             if (pid != -1 && c->pid != (uint32_t)pid) continue;
+             have_child = true;
+             if (c->exited) {
+                 *link = c->sibling;
+                 reaped = c;
+                 break;
+             }
+         }
+         spinlock_release_irqrestore(&g_proc_tree_lock, irq_flags);
+
+         if (reaped) {
+             int32_t reaped_pid = (int32_t)reaped->pid;
+             if (status) *status = (int)((reaped->exit_code & 0xFF) << 8);
+             pcb_free(reaped);
+             return reaped_pid;
+         }
+         if (!have_child) return -ECHILD;
+         if (options & WNOHANG) return 0;
+
+         wait_event(&g_child_exit_wq, child_exit_pending(parent, pid));
+     }
+ }
+ 
+ 
  // ------------------------------------------------------------------------
  // Process File Descriptor Management Implementations
  // ------------------------------------------------------------------------
@@ -1029,17 +1055,12 @@
     // Initialize the spinlock associated with this process's FD table
     spinlock_init(&proc->fd_table_lock);
 
-    // Zero out the file descriptor table array.
-    // While locking isn't strictly needed here if called only from the
-    // single thread creating the process before it runs, it's harmless
-    // and good defensive practice.
-    uintptr_t irq_flags = spinlock_acquire_irqsave(&proc->fd_table_lock);
-    memset(proc->fd_table, 0, sizeof(proc->fd_table));
-    spinlock_release_irqrestore(&proc->fd_table_lock, irq_flags);
+    // No table yet: the first open allocates one (sys_file.c grows it)
+    proc->fdt = NULL;
 
     // --- Optional: Initialize Standard I/O Descriptors ---
     // If your kernel provides standard I/O handles (e.g., via a console device driver),
-    // you would allocate sys_file_t structures for them and place them in fd_table[0], [1], [2] here.
+    // you would allocate sys_file_t structures for them and install them as fds 0, 1 and 2 here.
     // This requires interacting with your device/console driver API.
     // Example Placeholder:
     // assign_standard_io_fds(proc); // Hypothetical function
@@ -1057,46 +1078,8 @@
     KERNEL_ASSERT(proc != NULL, "Cannot close FDs for NULL process");
     serial_printf("[Proc %lu] Closing all file descriptors...\n", (unsigned long)proc->pid);
 
-    // Acquire the lock for the FD table of the process being destroyed.
-    // Even though the process isn't running, the reaper (e.g., idle task)
-    // needs exclusive access during cleanup.
-    uintptr_t irq_flags = spinlock_acquire_irqsave(&proc->fd_table_lock);
-
-    // Iterate through the entire file descriptor table
-    for (int fd = 0; fd < MAX_FD; fd++) {
-        sys_file_t *sf = proc->fd_table[fd];
-
-        if (sf != NULL) { // Check if the file descriptor is currently open
-            serial_printf("  [Proc %lu] Closing fd %d (sys_file_t* %p, vfs_file* %p)\n",
-                           (unsigned long)proc->pid, fd, sf, sf->vfs_file);
-
-            // Clear the FD table entry FIRST while holding the lock
-            proc->fd_table[fd] = NULL;
-
-            // Release the lock *before* calling potentially blocking/complex operations
-            // like vfs_close or kfree. This minimizes lock contention, although
-            // in this specific cleanup context it might be less critical.
-            spinlock_release_irqrestore(&proc->fd_table_lock, irq_flags);
-
-            // --- Perform cleanup outside the FD table lock ---
-            // Call VFS close (safe to call now that FD entry is clear)
-            int vfs_ret = vfs_close(sf->vfs_file); // vfs_close handles freeing sf->vfs_file->data and the vnode
-            if (vfs_ret < 0) {
-                serial_printf("   [Proc %lu] Warning: vfs_close for fd %d returned error %d.\n",
-                               (unsigned long)proc->pid, fd, vfs_ret);
-            }
-            // Free the sys_file structure itself
-            kfree(sf);
-            // --- End cleanup outside lock ---
-
-            // Re-acquire the lock to continue the loop safely
-            irq_flags = spinlock_acquire_irqsave(&proc->fd_table_lock);
-
-        } // end if (sf != NULL)
-    } // end for
-
-    // Release the lock after the loop finishes
-    spinlock_release_irqrestore(&proc->fd_table_lock, irq_flags);
+    // Drops each fd's reference (outside the table lock), then frees the table
+    fd_table_close_all(proc);
 
     serial_printf("[Proc %lu] All FDs processed for closing.\n", (unsigned long)proc->pid);
 }
@@ -0,0 +1,283 @@
+/**
+ * @file sched_bench.c
+ * @brief Scheduler throughput, wakeup latency and fairness under synthetic task mixes.
+ */
+
+#include <kernel/process/sched_bench.h>
+#include <kernel/process/scheduler.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/sync/wait_queue.h>
+#include <kernel/lib/div64.h>
+#include <kernel/lib/string.h>
+#include <kernel/drivers/timer/clock.h>
+#include <kernel/drivers/display/serial.h>
+
+typedef enum bench_kind {
+    BENCH_CPU = 0,  // Spins until stopped
+    BENCH_SLEEP,    // sleep_ms(1..SCHED_BENCH_SLEEP_MAX_MS) in a loop
+    BENCH_YIELD,    // yield() in a loop
+} bench_kind_t;
+
+static const char *const s_kind_names[] = { "cpu", "sleep", "yield" };
+
+typedef struct bench_group {
+    bench_kind_t kind;
+    uint8_t      count;
+    int8_t       prio_offset;  // From SCHED_DEFAULT_PRIORITY; negative is more urgent
+} bench_group_t;
+
+#define BENCH_MAX_GROUPS 4
+
+typedef struct bench_mix {
+    const char   *name;
+    bench_group_t groups[BENCH_MAX_GROUPS]; // count 0 ends the list
+} bench_mix_t;
+
+static const bench_mix_t s_mixes[] = {
+    // Equal CPU hogs: how evenly the ticks are shared
+    { "fair",    { { BENCH_CPU, 4, 0 } } },
+    // Urgent sleepers behind CPU hogs: wakeup latency under load
+    { "latency", { { BENCH_CPU, 2, 0 }, { BENCH_SLEEP, 4, -2 } } },
+    // Yielders beside hogs: raw context switch rate
+    { "yield",   { { BENCH_YIELD, 4, 0 }, { BENCH_CPU, 2, 0 } } },
+    // Hogs on three priorities: how strictly priority is honoured
+    { "prio",    { { BENCH_CPU, 2, -4 }, { BENCH_CPU, 2, 0 }, { BENCH_CPU, 2, 4 } } },
+    // A bit of everything
+    { "mixed",   { { BENCH_CPU, 2, 2 }, { BENCH_SLEEP, 3, -2 }, { BENCH_YIELD, 2, 0 }, { BENCH_SLEEP, 2, 4 } } },
+};
+#define BENCH_MIX_COUNT (sizeof(s_mixes) / sizeof(s_mixes[0]))
+
+typedef struct bench_task {
+    bench_kind_t kind;
+    uint32_t     group;
+    uint32_t     seed;
+    // Filled in by the task itself just before it exits
+    uint32_t     ops;
+    uint32_t     runtime_ticks;
+    uint32_t     wakeup_hist[SCHED_HIST_BUCKETS];
+} bench_task_t;
+
+static bench_task_t      s_tasks[SCHED_BENCH_MAX_TASKS];
+static volatile bool     s_stop;
+static spinlock_t        s_lock;
+static volatile uint32_t s_running;   // Tasks of the current mix still alive (s_lock)
+static wait_queue_t      s_done_wq;
+static uint32_t          s_late_us[SCHED_BENCH_MAX_SAMPLES];
+static uint32_t          s_late_count; // (s_lock)
+static const bench_mix_t *s_only;     // NULL: every mix
+
+//============================================================================
+// Tasks
+//============================================================================
+static void bench_record_late(uint32_t us) {
+    uintptr_t flags = spinlock_acquire_irqsave(&s_lock);
+    if (s_late_count < SCHED_BENCH_MAX_SAMPLES) s_late_us[s_late_count++] = us;
+    spinlock_release_irqrestore(&s_lock, flags);
+}
+
+static void bench_task(void *arg) {
+    bench_task_t *t = (bench_task_t *)arg;
+    uint32_t ops = 0;
+    while (!s_stop) {
+        switch (t->kind) {
+        case BENCH_CPU:
+            asm volatile("pause");
+            break;
+        case BENCH_YIELD:
+            yield();
+            break;
+        case BENCH_SLEEP: {
+            t->seed = t->seed * 1103515245u + 12345u;
+            uint32_t ms = 1 + (t->seed >> 16) % SCHED_BENCH_SLEEP_MAX_MS;
+            uint64_t due = clock_monotonic_ns() + (uint64_t)ms * NSEC_PER_MSEC;
+            sleep_ms(ms);
+            uint64_t now = clock_monotonic_ns();
+            bench_record_late(now > due ? (uint32_t)div_u64_rem(now - due, NSEC_PER_USEC, NULL) : 0);
+            break;
+        }
+        }
+        ops++;
+    }
+
+    sched_task_stats_t stats;
+    if (scheduler_get_task_stats(get_current_task()->pid, &stats) == 0) {
+        t->runtime_ticks = stats.runtime_ticks;
+        memcpy(t->wakeup_hist, stats.wakeup_hist, sizeof(t->wakeup_hist));
+    }
+    t->ops = ops;
+
+    uintptr_t flags = spinlock_acquire_irqsave(&s_lock);
+    bool last = --s_running == 0;
+    spinlock_release_irqrestore(&s_lock, flags);
+    if (last) wake_up_all(&s_done_wq);
+}
+
+//============================================================================
+// Reporting
+//============================================================================
+static void sort_u32(uint32_t *v, uint32_t n) {
+    // Shell sort with Ciura's gaps; a few thousand samples at most
+    static const uint32_t gaps[] = { 701, 301, 132, 57, 23, 10, 4, 1 };
+    for (uint32_t g = 0; g < sizeof(gaps) / sizeof(gaps[0]); g++) {
+        uint32_t gap = gaps[g];
+        for (uint32_t i = gap; i < n; i++) {
+            uint32_t x = v[i], j = i;
+            while (j >= gap && v[j - gap] > x) { v[j] = v[j - gap]; j -= gap; }
+            v[j] = x;
+        }
+    }
+}
+
+static uint32_t pct_of_sorted(const uint32_t *v, uint32_t n, uint32_t pct) {
+    if (n == 0) return 0;
+    uint32_t i = (n * pct) / 100;
+    return v[i < n ? i : n - 1];
+}
+
+// Upper bound, in us, of the histogram bucket holding the pct-th percentile
+static uint32_t pct_of_hist(const uint32_t *hist, uint32_t pct) {
+    uint32_t total = 0;
+    for (uint32_t b = 0; b < SCHED_HIST_BUCKETS; b++) total += hist[b];
+    if (total == 0) return 0;
+    uint32_t want = (uint32_t)div_u64_rem((uint64_t)total * pct + 99, 100, NULL), seen = 0;
+    for (uint32_t b = 0; b < SCHED_HIST_BUCKETS; b++) {
+        seen += hist[b];
+        if (seen >= want) {
+            uint64_t cycles = (b + 1 < 64) ? (1ull << (b + 1)) : ~0ull;
+            return (uint32_t)div_u64_rem(clock_cycles_to_ns(cycles), NSEC_PER_USEC, NULL);
+        }
+    }
+    return 0;
+}
+
+// (sum x)^2 / (n * sum x^2), in permille; 1000 when every task got the same
+static uint32_t jain_permille(const uint32_t *x, uint32_t n) {
+    uint64_t sum = 0, sum_sq = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        sum += x[i];
+        sum_sq += (uint64_t)x[i] * x[i];
+    }
+    uint64_t num = sum * sum * 1000;
+    uint64_t den = sum_sq * n;
+    if (den == 0) return 1000;
+    while (den > 0xFFFFFFFFull) { num >>= 1; den >>= 1; } // div_u64_rem takes a 32-bit divisor
+    return (uint32_t)div_u64_rem(num, (uint32_t)den, NULL);
+}
+
+static void bench_report(const bench_mix_t *mix, uint32_t ntasks, uint32_t switches, uint64_t ns) {
+    uint32_t ms = (uint32_t)div_u64_rem(ns, NSEC_PER_MSEC, NULL);
+    if (ms == 0) ms = 1;
+    uint32_t wake_hist[SCHED_HIST_BUCKETS] = { 0 };
+    uint32_t total_ticks = 0;
+    for (uint32_t i = 0; i < ntasks; i++) {
+        total_ticks += s_tasks[i].runtime_ticks;
+        if (s_tasks[i].kind != BENCH_SLEEP) continue;
+        for (uint32_t b = 0; b < SCHED_HIST_BUCKETS; b++) wake_hist[b] += s_tasks[i].wakeup_hist[b];
+    }
+    sort_u32(s_late_us, s_late_count);
+    uint32_t n = s_late_count;
+    serial_printf("[SchedBench] mix=%s ms=%lu switches_per_s=%lu late_p50_us=%lu late_p90_us=%lu late_p99_us=%lu"
+                  " late_max_us=%lu wake_p50_us=%lu wake_p99_us=%lu\n",
+                  mix->name, (unsigned long)ms, (unsigned long)div_u64_rem((uint64_t)switches * 1000, ms, NULL),
+                  (unsigned long)pct_of_sorted(s_late_us, n, 50), (unsigned long)pct_of_sorted(s_late_us, n, 90),
+                  (unsigned long)pct_of_sorted(s_late_us, n, 99), (unsigned long)(n ? s_late_us[n - 1] : 0),
+                  (unsigned long)pct_of_hist(wake_hist, 50), (unsigned long)pct_of_hist(wake_hist, 99));
+
+    uint32_t first = 0;
+    for (uint32_t g = 0; g < BENCH_MAX_GROUPS && mix->groups[g].count; g++) {
+        const bench_group_t *grp = &mix->groups[g];
+        uint32_t ticks[SCHED_BENCH_MAX_TASKS];
+        uint32_t count = 0, ops = 0, group_ticks = 0, tmin = 0xFFFFFFFFu, tmax = 0;
+        for (uint32_t i = first; i < ntasks && s_tasks[i].group == g; i++) {
+            uint32_t t = s_tasks[i].runtime_ticks;
+            ticks[count++] = t;
+            ops += s_tasks[i].ops;
+            group_ticks += t;
+            if (t < tmin) tmin = t;
+            if (t > tmax) tmax = t;
+        }
+        first += count;
+        if (count == 0) continue;
+        serial_printf("[SchedBench] mix=%s group=%s prio=%d tasks=%lu ops_per_s=%lu share_pct=%lu"
+                      " ticks_min=%lu ticks_max=%lu jain_permille=%lu\n",
+                      mix->name, s_kind_names[grp->kind], SCHED_DEFAULT_PRIORITY + grp->prio_offset,
+                      (unsigned long)count, (unsigned long)div_u64_rem((uint64_t)ops * 1000, ms, NULL),
+                      (unsigned long)(total_ticks ? div_u64_rem((uint64_t)group_ticks * 100, total_ticks, NULL) : 0),
+                      (unsigned long)tmin, (unsigned long)tmax, (unsigned long)jain_permille(ticks, count));
+    }
+}
+
+//============================================================================
+// Controller
+//============================================================================
+static uint32_t system_switches(void) {
+    sched_task_stats_t totals;
+    scheduler_get_task_stats(IDLE_TASK_PID, &totals);
+    return totals.nr_switches;
+}
+
+static void bench_run_mix(const bench_mix_t *mix) {
+    uint32_t ntasks = 0;
+    s_stop = false;
+    s_late_count = 0;
+    memset(s_tasks, 0, sizeof(s_tasks));
+
+    // The controller holds one reference until every task is out, like the initcall runner
+    s_running = 1;
+    uint32_t switches = system_switches();
+    uint64_t start = clock_monotonic_ns();
+    for (uint32_t g = 0; g < BENCH_MAX_GROUPS && mix->groups[g].count; g++) {
+        const bench_group_t *grp = &mix->groups[g];
+        for (uint32_t i = 0; i < grp->count && ntasks < SCHED_BENCH_MAX_TASKS; i++) {
+            bench_task_t *t = &s_tasks[ntasks];
+            t->kind = grp->kind;
+            t->group = g;
+            t->seed = 0x9E3779B9u * (ntasks + 1);
+            uintptr_t flags = spinlock_acquire_irqsave(&s_lock);
+            s_running++;
+            spinlock_release_irqrestore(&s_lock, flags);
+            if (!kthread_create(bench_task, t, (uint8_t)(SCHED_DEFAULT_PRIORITY + grp->prio_offset))) {
+                flags = spinlock_acquire_irqsave(&s_lock);
+                s_running--;
+                spinlock_release_irqrestore(&s_lock, flags);
+                serial_printf("[SchedBench] mix=%s: no thread for task %lu\n", mix->name, (unsigned long)ntasks);
+                break;
+            }
+            ntasks++;
+        }
+    }
+
+    sleep_ms(SCHED_BENCH_MS);
+    s_stop = true;
+    uint64_t ns = clock_monotonic_ns() - start;
+    switches = system_switches() - switches;
+
+    uintptr_t flags = spinlock_acquire_irqsave(&s_lock);
+    bool last = --s_running == 0;
+    spinlock_release_irqrestore(&s_lock, flags);
+    if (!last) wait_event(&s_done_wq, s_running == 0);
+    bench_report(mix, ntasks, switches, ns);
+}
+
+static void sched_bench_thread(void *arg) {
+    (void)arg;
+    serial_printf("[SchedBench] --- Scheduler benchmarks (%u ms per mix) ---\n", (unsigned)SCHED_BENCH_MS);
+    for (uint32_t m = 0; m < BENCH_MIX_COUNT; m++) {
+        if (!s_only || s_only == &s_mixes[m]) bench_run_mix(&s_mixes[m]);
+    }
+    serial_printf("[SchedBench] --- done ---\n");
+}
+
+bool sched_bench_start(const char *mix) {
+    s_only = NULL;
+    if (mix) {
+        for (uint32_t m = 0; m < BENCH_MIX_COUNT; m++) {
+            if (strcmp(s_mixes[m].name, mix) == 0) s_only = &s_mixes[m];
+        }
+        if (!s_only) return false;
+    }
+    spinlock_init_named(&s_lock, "sched_bench");
+    wait_queue_init(&s_done_wq);
+    // Most urgent, so it stops the mix on time however hard the tasks spin
+    return kthread_create(sched_bench_thread, NULL, SCHED_KERNEL_PRIORITY) != NULL;
+}
@@ -5,7 +5,7 @@
  * @version 5.2
  *
  * @details Implements a priority-based preemptive scheduler.
- * Features multiple run queues, configurable time slices, sleep queue,
+ * Features multiple run queues, configurable time slices, a timer-wheel sleep queue,
  * zombie task cleanup, TCB flag for run queue status, and a reschedule hint flag.
  * Assumes a timer interrupt calls scheduler_tick(). Fixes build errors from v5.1.
  */
@@ -16,15 +16,31 @@
 #include <kernel/process/scheduler.h>
 #include <kernel/process/process.h>
 #include <kernel/memory/kmalloc.h>
+#include <kernel/memory/slab.h>
+#include <kernel/memory/frame.h>
+#include <kernel/memory/shrinker.h>
 #include <kernel/drivers/display/terminal.h>
 #include <kernel/sync/spinlock.h>
+#include <kernel/sync/preempt.h>
+#include <kernel/sync/rcu.h>        // Quiescent states on switches and ticks
 #include <kernel/cpu/idt.h>
 #include <kernel/cpu/gdt.h>
 #include <kernel/lib/assert.h>
+#include <kernel/lib/klog.h> // klog_debug (SCHED_DEBUG)
 #include <kernel/memory/paging.h>
 #include <kernel/cpu/tss.h>
+#include <kernel/cpu/get_cpu_id.h>
+#include <kernel/cpu/percpu.h>
+#include <kernel/cpu/smp.h>
 #include <kernel/drivers/display/serial.h>
 #include <kernel/drivers/timer/pit.h>
+#include <kernel/drivers/timer/tick.h>
+#include <kernel/drivers/timer/timer.h>
+#include <kernel/cpu/softirq.h>
+#include <kernel/cpu/tsc.h>
+#include <kernel/cpu/perf.h>
+#include <kernel/core/tracepoint.h>
+#include <kernel/sync/wait_queue.h>
 #include <kernel/lib/port_io.h>
 #include <kernel/drivers/input/keyboard_hw.h>
 #include <kernel/drivers/input/keyboard.h> 
@@ -32,14 +48,14 @@
 #include <libc/stddef.h>
 #include <libc/stdbool.h>
 #include <kernel/lib/string.h>
+#include <kernel/process/vvar.h>
+#include <kernel/process/kstack.h>
+#include <kernel/process/pid.h>
 
 //============================================================================
 // Scheduler Configuration & Constants
 //============================================================================
-#define SCHED_PRIORITY_LEVELS   4
-#define SCHED_DEFAULT_PRIORITY  1
-#define SCHED_IDLE_PRIORITY     (SCHED_PRIORITY_LEVELS - 1)
-#define SCHED_KERNEL_PRIORITY   0
+// Priority levels (SCHED_*_PRIORITY) are in scheduler.h for kthread_create().
 
 #ifndef SCHED_TICKS_PER_SECOND
 #define SCHED_TICKS_PER_SECOND  1000
@@ -47,9 +63,59 @@
 
 #define MS_TO_TICKS(ms) (((ms) * SCHED_TICKS_PER_SECOND) / 1000)
 
-static const uint32_t g_priority_time_slices_ms[SCHED_PRIORITY_LEVELS] = {
-    200, /* P0 */ 100, /* P1 */ 50, /* P2 */ 25  /* P3 (Idle) */
-};
+// Load balancing: every SCHED_BALANCE_INTERVAL_TICKS each CPU compares its
+// queue length against the busiest CPU and pulls half of the difference once
+// the imbalance exceeds SCHED_BALANCE_MIN_IMBALANCE tasks.
+#ifndef SCHED_BALANCE_INTERVAL_TICKS
+#define SCHED_BALANCE_INTERVAL_TICKS 100
+#endif
+#define SCHED_BALANCE_MIN_IMBALANCE  2
+
+// Buckets of the PID -> TCB hash behind scheduler_get_task_stats() and friends.
+#define SCHED_PID_HASH_BITS 8
+#define SCHED_PID_HASH_SIZE (1u << SCHED_PID_HASH_BITS)
+
+// Tickless idle: when every online CPU is idle, stop the periodic tick and
+// program a one-shot for the earliest sleep deadline. Set to 0 to keep the
+// fixed-rate tick at all times.
+#ifndef SCHED_TICKLESS_IDLE
+#define SCHED_TICKLESS_IDLE 1
+#endif
+#define SCHED_TICKLESS_MIN_TICKS 2  // Shorter idle periods keep the periodic tick
+
+// Frames the idle loop zeroes for the pre-zeroed pool per pass (see frame.h).
+#define SCHED_IDLE_ZERO_FRAMES   8
+
+// Time slices keep the original four bands (200/100/50/25 ms) spread over
+// all priority levels; the table is filled in by init_time_slices().
+#define SCHED_MAX_TIME_SLICE_MS 200
+#define SCHED_TIME_SLICE_BANDS  3
+static uint32_t g_priority_time_slices_ms[SCHED_PRIORITY_LEVELS];
+
+// Scheduling class: 0 = per-priority round robin (default), 1 = fair share.
+// The fair class orders every non-idle task on a CPU by virtual runtime in a
+// red-black tree (queues[SCHED_FAIR_QUEUE]) and always runs the task that has
+// received the least weighted CPU time; priority only sets the weight (each
+// level is worth ~25% CPU share). The idle task and the reaper stay in their
+// round-robin queues below it, so the reaper still runs only when no other
+// task wants the CPU. Enable with -DUIAOS_SCHED_FAIR=ON at configure time.
+#ifndef SCHED_CLASS_FAIR
+#define SCHED_CLASS_FAIR 0
+#endif
+#if SCHED_CLASS_FAIR
+#define SCHED_FAIR_QUEUE           0
+#if SCHED_REAPER_PRIORITY == SCHED_FAIR_QUEUE
+#error "The fair class needs a queue for the reaper below SCHED_FAIR_QUEUE"
+#endif
+#define SCHED_FAIR_NICE0_WEIGHT    1024u                 // Weight of SCHED_DEFAULT_PRIORITY
+#define SCHED_FAIR_LATENCY_TICKS   MS_TO_TICKS(20)       // Period every runnable task should run in
+#define SCHED_FAIR_MIN_GRAN_TICKS  MS_TO_TICKS(4)        // Shortest slice handed out
+// Woken/new tasks start at most half a latency period behind the pack.
+#define SCHED_FAIR_WAKEUP_CREDIT   ((SCHED_FAIR_LATENCY_TICKS / 2) * SCHED_FAIR_NICE0_WEIGHT)
+static uint32_t g_fair_weights[SCHED_PRIORITY_LEVELS];
+static uint32_t g_fair_vruntime_per_tick[SCHED_PRIORITY_LEVELS];
+#endif
+
 
 // Error Codes
 #define SCHED_OK          0
@@ -71,7 +137,7 @@ static const uint32_t g_priority_time_slices_ms[SCHED_PRIORITY_LEVELS] = {
 
 // Logging Macros (Corrected format specifiers)
 #define SCHED_INFO(fmt, ...)  serial_printf("[Sched INFO ] " fmt "\n", ##__VA_ARGS__)
-#define SCHED_DEBUG(fmt, ...) serial_printf("[Sched DEBUG] " fmt "\n", ##__VA_ARGS__)
+#define SCHED_DEBUG(fmt, ...) klog_debug("[Sched DEBUG] " fmt "\n", ##__VA_ARGS__)
 #define SCHED_ERROR(fmt, ...) serial_printf("[Sched ERROR] %s:%d: " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
 #define SCHED_WARN(fmt, ...)  serial_printf("[Sched WARN ] %s:%d: " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
 #define SCHED_TRACE(fmt, ...) ((void)0)
@@ -91,48 +157,334 @@ typedef struct {
     tcb_t      *tail;
     uint32_t    count;
     spinlock_t  lock;
+#if SCHED_CLASS_FAIR
+    struct rb_tree timeline;      // Fair queue only: tasks ordered by vruntime
+    uint32_t       min_vruntime;  // Monotonic floor for placing woken tasks
+    uint32_t       load_weight;   // Sum of queued task weights
+#endif
 } run_queue_t;
 
-typedef struct {
-    tcb_t      *head;
-    uint32_t    count;
-    spinlock_t  lock;
-} sleep_queue_t;
+/**
+ * @brief Per-CPU scheduling state.
+ * Each CPU owns a full set of priority run queues, its ready bitmap, its
+ * current task and its idle task. Queues are still individually locked so a
+ * remote CPU can steal from them.
+ */
+typedef struct sched_cpu {
+    run_queue_t        queues[SCHED_PRIORITY_LEVELS];
+    volatile uint32_t  ready_bitmap;     // Bit N set <=> queues[N] non-empty
+    volatile uint32_t  nr_queued;        // Queued non-idle tasks (load metric)
+    volatile tcb_t    *current;          // Task running on this CPU
+    tcb_t              idle_tcb;
+    pcb_t              idle_pcb;
+    uint32_t           last_balance_tick;
+    uint32_t           tasks_pulled;     // Tasks migrated to this CPU
+    tcb_t             *dead_task;        // Zombie just switched away from, not yet handed to the reaper
+    sched_task_stats_t totals;           // Switches on this CPU (idle tasks excluded); see sched_totals_sum()
+    uint32_t           cpu_id;
+    volatile bool      online;
+} sched_cpu_t;
 
 //============================================================================
 // Module Static Data (Same as refactored v5.0)
 //============================================================================
-static run_queue_t   g_run_queues[SCHED_PRIORITY_LEVELS];
-static sleep_queue_t g_sleep_queue;
-static volatile tcb_t *g_current_task = NULL;
+static sched_cpu_t   g_sched_cpus[MAX_CPUS];
+static timer_wheel_t g_sleep_wheel;     // Sleeping tasks keyed by wakeup tick
 static tcb_t        *g_all_tasks_head = NULL;
+static tcb_t        *g_pid_hash[SCHED_PID_HASH_SIZE]; // PID -> TCB (g_all_tasks_lock)
 static spinlock_t    g_all_tasks_lock;
 static volatile uint32_t g_tick_count = 0;
-static tcb_t         g_idle_task_tcb;
-static pcb_t         g_idle_task_pcb;
+static wait_queue_t  g_reaper_wq;
+static tcb_t        *g_reaper_list = NULL;  // Lock-free LIFO of zombies awaiting teardown
+static slab_cache_t *g_tcb_cache = NULL;    // Dynamic TCBs (idle TCBs are static)
+static uint32_t      g_next_kthread_pid = REAPER_TASK_PID; // Counts down (g_all_tasks_lock)
+static volatile bool g_reaper_started = false;
+static volatile bool g_tickless_active = false; // BSP has stopped the periodic global tick
+static volatile bool g_sleep_wheel_expiring = false; // check_sleeping_tasks() is running callbacks
 volatile bool g_scheduler_ready = false;
-volatile bool g_need_reschedule = false;
 
 //============================================================================
 // Forward Declarations (Assembly / Private Helpers) - Same as refactored v5.0
 //============================================================================
-extern void context_switch(uint32_t **old_esp_ptr, uint32_t *new_esp, uint32_t *new_pagedir);
-extern void jump_to_user_mode(uint32_t *user_esp, uint32_t *pagedir);
+extern void fork_child_return(void); // jump_user.asm
+extern void user_first_entry(void);  // jump_user.asm
 
 static void init_run_queue(run_queue_t *queue);
 static void init_sleep_queue(void);
 static bool enqueue_task_locked(tcb_t *task);
 static bool dequeue_task_locked(tcb_t *task);
 static void add_to_sleep_queue_locked(tcb_t *task);
-static void remove_from_sleep_queue_locked(tcb_t *task);
+
+static void sleep_timer_expired(timer_entry_t *entry, void *arg);
 static void check_sleeping_tasks(void);
-static tcb_t* scheduler_select_next_task(void);
+static void sleep_wheel_add_locked(timer_entry_t *entry);
+static tcb_t* scheduler_select_next_task(sched_cpu_t *cpu);
+static uint32_t migrate_tasks(sched_cpu_t *src, sched_cpu_t *dst, uint32_t max_tasks);
 static void perform_context_switch(tcb_t *old_task, tcb_t *new_task);
 static void kernel_idle_task_loop(void) __attribute__((noreturn));
-static void scheduler_init_idle_task(void);
-void scheduler_cleanup_zombies(void);
+static void scheduler_init_idle_task(sched_cpu_t *cpu);
+static void reaper_flush_dead_task(sched_cpu_t *cpu);
+static void scheduler_init_reaper(void);
 void check_idle_task_stack_integrity(const char *checkpoint);
 
+//============================================================================
+// Per-CPU Accessors
+//============================================================================
+static inline sched_cpu_t *this_sched_cpu(void) {
+    int id = get_cpu_id();
+    if (id < 0 || id >= MAX_CPUS) id = 0;
+    return &g_sched_cpus[id];
+}
+
+#if SCHED_CLASS_FAIR
+/** @brief Every task but the idle task and the reaper is scheduled by the fair class. */
+static inline bool task_is_fair(const tcb_t *task) {
+    return task->pid != IDLE_TASK_PID && task->pid != REAPER_TASK_PID;
+}
+#endif
+
+/** @brief Index of the queue a task belongs to (its priority, or the fair queue). */
+static inline uint32_t task_queue_index(tcb_t *task) {
+#if SCHED_CLASS_FAIR
+    if (task_is_fair(task)) return SCHED_FAIR_QUEUE;
+#endif
+    return task->priority;
+}
+
+/** @brief Run queue a task belongs to on its CPU. */
+static inline run_queue_t *task_queue(tcb_t *task) {
+    return &g_sched_cpus[task->cpu].queues[task_queue_index(task)];
+}
+
+static inline uint32_t pid_hash(uint32_t pid) {
+    return (pid * 0x9E3779B1u) >> (32 - SCHED_PID_HASH_BITS); // Fibonacci hashing
+}
+
+/** @brief Links @p task into the all-tasks list and, unless idle, the PID hash. Caller holds g_all_tasks_lock. */
+static void all_tasks_insert_locked(tcb_t *task) {
+    task->all_tasks_next = g_all_tasks_head;
+    if (g_all_tasks_head) g_all_tasks_head->all_tasks_pprev = &task->all_tasks_next;
+    task->all_tasks_pprev = &g_all_tasks_head;
+    g_all_tasks_head = task;
+    if (task->pid != IDLE_TASK_PID) {
+        tcb_t **bucket = &g_pid_hash[pid_hash(task->pid)];
+        task->pid_hash_next = *bucket;
+        *bucket = task;
+    }
+}
+
+/** @brief Undoes all_tasks_insert_locked(). Caller holds g_all_tasks_lock. */
+static void all_tasks_remove_locked(tcb_t *task) {
+    *task->all_tasks_pprev = task->all_tasks_next;
+    if (task->all_tasks_next) task->all_tasks_next->all_tasks_pprev = task->all_tasks_pprev;
+    task->all_tasks_next = NULL;
+    task->all_tasks_pprev = NULL;
+    for (tcb_t **link = &g_pid_hash[pid_hash(task->pid)]; *link; link = &(*link)->pid_hash_next) {
+        if (*link == task) {
+            *link = task->pid_hash_next;
+            break;
+        }
+    }
+    task->pid_hash_next = NULL;
+}
+
+/** @brief The live TCB with ID @p pid, or NULL. Caller holds g_all_tasks_lock. */
+static tcb_t *find_task_locked(uint32_t pid) {
+    for (tcb_t *t = g_pid_hash[pid_hash(pid)]; t; t = t->pid_hash_next) {
+        if (t->pid == pid) return t;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Sends a reschedule IPI if @p task was just queued on another CPU
+ * that is sitting in its idle task, so it starts now rather than at that
+ * CPU's next tick. Busy remote CPUs pick it up at their next slice end.
+ */
+static inline void sched_kick_remote(tcb_t *task) {
+    sched_cpu_t *target = &g_sched_cpus[task->cpu];
+    if (target == this_sched_cpu() || !target->online) return;
+    if (target->current == &target->idle_tcb) smp_send_reschedule(target->cpu_id);
+}
+
+//============================================================================
+// Ready Bitmap Helpers
+//============================================================================
+// The bitmap is only modified while the matching queue lock is held, but
+// different queues are guarded by different locks (and may be touched by a
+// stealing CPU), so the updates themselves must be atomic read-modify-write
+// operations on the shared word. The same holds for the nr_queued counter.
+static inline void ready_bitmap_set(sched_cpu_t *cpu, uint32_t prio) {
+    asm volatile("lock btsl %1, %0" : "+m"(cpu->ready_bitmap) : "r"(prio) : "memory", "cc");
+}
+
+static inline void ready_bitmap_clear(sched_cpu_t *cpu, uint32_t prio) {
+    asm volatile("lock btrl %1, %0" : "+m"(cpu->ready_bitmap) : "r"(prio) : "memory", "cc");
+}
+
+static inline void nr_queued_inc(sched_cpu_t *cpu) {
+    asm volatile("lock incl %0" : "+m"(cpu->nr_queued) : : "memory", "cc");
+}
+
+static inline void nr_queued_dec(sched_cpu_t *cpu) {
+    asm volatile("lock decl %0" : "+m"(cpu->nr_queued) : : "memory", "cc");
+}
+
+/** @brief Returns the highest ready priority (lowest set bit), or -1 if none. */
+static inline int ready_bitmap_first(sched_cpu_t *cpu) {
+    uint32_t map = cpu->ready_bitmap;
+
+    if (!map) return -1;
+    uint32_t idx;
+    asm("bsfl %1, %0" : "=r"(idx) : "rm"(map) : "cc");
+    return (int)idx;
+}
+
+//============================================================================
+// CPU Accounting
+//============================================================================
+static inline void sched_hist_add(uint32_t *hist, uint64_t cycles) {
+    uint32_t bucket = tsc_log2(cycles);
+    if (bucket >= SCHED_HIST_BUCKETS) bucket = SCHED_HIST_BUCKETS - 1;
+    hist[bucket]++;
+}
+
+/**
+ * @brief Charges the outgoing task's run time and the incoming task's run
+ * queue wait. Called from schedule() with interrupts disabled, only when the
+ * CPU really changes tasks.
+ */
+static void sched_account_switch(tcb_t *old_task, tcb_t *new_task) {
+    uint64_t now = read_tsc();
+    sched_task_stats_t *totals = &this_sched_cpu()->totals; // Only this CPU writes it
+
+    if (old_task) {
+        old_task->stats.run_cycles += now - old_task->run_start_tsc;
+        // schedule() requeues a still-runnable task as READY before picking,
+        // so READY here means preemption unless we yielded or were woken
+        // between prepare_to_wait() and the switch.
+        bool voluntary = old_task->state != TASK_READY || old_task->yielded || old_task->woken;
+        if (voluntary) old_task->stats.nr_voluntary++;
+        else old_task->stats.nr_involuntary++;
+        old_task->yielded = false;
+        if (old_task->pid != IDLE_TASK_PID) {
+            if (voluntary) totals->nr_voluntary++;
+            else totals->nr_involuntary++;
+        }
+    }
+
+    bool count_total = new_task->pid != IDLE_TASK_PID;
+    if (new_task->ready_since_tsc) {
+        uint64_t waited = now - new_task->ready_since_tsc;
+        new_task->stats.wait_cycles += waited;
+        sched_hist_add(new_task->stats.wait_hist, waited);
+        if (count_total) {
+            totals->wait_cycles += waited;
+            sched_hist_add(totals->wait_hist, waited);
+        }
+        if (new_task->woken) {
+            new_task->stats.nr_wakeups++;
+            sched_hist_add(new_task->stats.wakeup_hist, waited);
+            if (count_total) {
+                totals->nr_wakeups++;
+                sched_hist_add(totals->wakeup_hist, waited);
+            }
+        }
+    }
+    new_task->ready_since_tsc = 0;
+    new_task->woken = false;
+    new_task->run_start_tsc = now;
+    new_task->stats.nr_switches++;
+    totals->nr_switches++;
+}
+
+static void init_time_slices(void) {
+    for (uint32_t prio = 0; prio < SCHED_PRIORITY_LEVELS; prio++) {
+        uint32_t band = (prio * SCHED_TIME_SLICE_BANDS) / (SCHED_PRIORITY_LEVELS - 1);
+        g_priority_time_slices_ms[prio] = SCHED_MAX_TIME_SLICE_MS >> band;
+    }
+#if SCHED_CLASS_FAIR
+    // Weights scale by 1.25x per level around the default priority.
+    g_fair_weights[SCHED_DEFAULT_PRIORITY] = SCHED_FAIR_NICE0_WEIGHT;
+    for (int prio = SCHED_DEFAULT_PRIORITY - 1; prio >= 0; prio--) {
+        g_fair_weights[prio] = (g_fair_weights[prio + 1] * 5) / 4;
+    }
+    for (int prio = SCHED_DEFAULT_PRIORITY + 1; prio < SCHED_PRIORITY_LEVELS; prio++) {
+        uint32_t weight = (g_fair_weights[prio - 1] * 4) / 5;
+        g_fair_weights[prio] = weight ? weight : 1;
+    }
+    for (uint32_t prio = 0; prio < SCHED_PRIORITY_LEVELS; prio++) {
+        g_fair_vruntime_per_tick[prio] = (SCHED_FAIR_NICE0_WEIGHT * SCHED_FAIR_NICE0_WEIGHT) / g_fair_weights[prio];
+    }
+#endif
+}
+
+#if SCHED_CLASS_FAIR
+//============================================================================
+// Fair Class Timeline
+//============================================================================
+static inline bool vruntime_before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+static void fair_timeline_insert(run_queue_t *queue, tcb_t *task) {
+    // A task that slept (or was just created) keeps at most a bounded credit
+    // so it cannot monopolise the CPU to "catch up".
+    uint32_t floor = queue->min_vruntime - SCHED_FAIR_WAKEUP_CREDIT;
+    if (vruntime_before(task->vruntime, floor)) task->vruntime = floor;
+
+    struct rb_node *parent = NULL;
+    struct rb_node *node = queue->timeline.root;
+    bool left = false;
+    while (node) {
+        parent = node;
+        tcb_t *other = rb_entry(node, tcb_t, sched_node);
+        left = vruntime_before(task->vruntime, other->vruntime); // Ties go right (FIFO)
+        node = left ? node->left : node->right;
+    }
+    rb_tree_insert_at(&queue->timeline, parent, &task->sched_node, left);
+    queue->load_weight += g_fair_weights[task->priority];
+}
+
+static void fair_timeline_remove(run_queue_t *queue, tcb_t *task) {
+    rb_tree_remove(&queue->timeline, &task->sched_node);
+    queue->load_weight -= g_fair_weights[task->priority];
+}
+
+/** @brief Slice for a task just picked: its weighted share of the latency period. */
+static uint32_t fair_time_slice(run_queue_t *queue, tcb_t *task) {
+    uint32_t weight = g_fair_weights[task->priority];
+    uint32_t slice = (SCHED_FAIR_LATENCY_TICKS * weight) / (queue->load_weight + weight);
+    return slice < SCHED_FAIR_MIN_GRAN_TICKS ? SCHED_FAIR_MIN_GRAN_TICKS : slice;
+}
+#endif
+
+/** @brief First task that would be picked from a queue (caller holds its lock). */
+static inline tcb_t *queue_first_locked(run_queue_t *queue, uint32_t index) {
+#if SCHED_CLASS_FAIR
+    if (index == SCHED_FAIR_QUEUE) {
+        struct rb_node *first = rb_tree_first(&queue->timeline);
+        return first ? rb_entry(first, tcb_t, sched_node) : NULL;
+    }
+#else
+    (void)index;
+#endif
+    return queue->head;
+}
+
+/** @brief The task picked after @p task from the same queue (caller holds its lock). */
+static inline tcb_t *queue_next_locked(tcb_t *task, uint32_t index) {
+#if SCHED_CLASS_FAIR
+    if (index == SCHED_FAIR_QUEUE) {
+        struct rb_node *next = rb_node_next(&task->sched_node);
+        return next ? rb_entry(next, tcb_t, sched_node) : NULL;
+    }
+#else
+    (void)index;
+#endif
+    return task->next;
+}
+
 //============================================================================
 // Queue Management (Refined v5.0 implementations)
 //============================================================================
@@ -141,28 +493,39 @@ static void init_run_queue(run_queue_t *queue) {
     queue->head = NULL;
     queue->tail = NULL;
     queue->count = 0;
-    spinlock_init(&queue->lock);
+    spinlock_init_named(&queue->lock, "run_queue");
+#if SCHED_CLASS_FAIR
+    rb_tree_init(&queue->timeline);
+    queue->min_vruntime = 0;
+    queue->load_weight = 0;
+#endif
 }
 
 static void init_sleep_queue(void) {
-    g_sleep_queue.head = NULL;
-    g_sleep_queue.count = 0;
-    spinlock_init(&g_sleep_queue.lock);
+    timer_wheel_init(&g_sleep_wheel, g_tick_count);
 }
 
 static bool enqueue_task_locked(tcb_t *task) {
     KERNEL_ASSERT(task != NULL, "Cannot enqueue NULL task");
     KERNEL_ASSERT(task->state == TASK_READY, "Enqueueing task that is not READY");
     KERNEL_ASSERT(task->priority < SCHED_PRIORITY_LEVELS, "Invalid task priority for enqueue");
+    KERNEL_ASSERT(task->cpu < MAX_CPUS, "Invalid task CPU for enqueue");
 
     if (task->in_run_queue) {
         SCHED_WARN("Task PID %lu already marked as in_run_queue during enqueue attempt.", task->pid);
         return false;
     }
 
-    run_queue_t *queue = &g_run_queues[task->priority];
+    sched_cpu_t *cpu = &g_sched_cpus[task->cpu];
+    uint32_t index = task_queue_index(task);
+    run_queue_t *queue = &cpu->queues[index];
     task->next = NULL;
 
+#if SCHED_CLASS_FAIR
+    if (index == SCHED_FAIR_QUEUE) {
+        fair_timeline_insert(queue, task);
+    } else
+#endif
     if (queue->tail) {
         queue->tail->next = task;
         queue->tail = task;
@@ -173,6 +536,10 @@ static bool enqueue_task_locked(tcb_t *task) {
     }
     queue->count++;
     task->in_run_queue = true;
+    // Keep the original timestamp across migration/priority requeues.
+    if (!task->ready_since_tsc) task->ready_since_tsc = read_tsc();
+    ready_bitmap_set(cpu, index);
+    if (task->pid != IDLE_TASK_PID) nr_queued_inc(cpu);
     return true;
 }
 
@@ -180,8 +547,28 @@ static bool dequeue_task_locked(tcb_t *task) {
     KERNEL_ASSERT(task != NULL, "Cannot dequeue NULL task");
     KERNEL_ASSERT(task->priority < SCHED_PRIORITY_LEVELS, "Invalid task priority for dequeue");
 
-    run_queue_t *queue = &g_run_queues[task->priority];
+    sched_cpu_t *cpu = &g_sched_cpus[task->cpu];
+    uint32_t index = task_queue_index(task);
+    run_queue_t *queue = &cpu->queues[index];
+
+#if SCHED_CLASS_FAIR
+    if (index == SCHED_FAIR_QUEUE) {
+        if (!task->in_run_queue) {
+            SCHED_ERROR("Task PID %lu not on the fair timeline for dequeue!", task->pid);
+            return false;
+        }
+        fair_timeline_remove(queue, task);
+        KERNEL_ASSERT(queue->count > 0, "Queue count underflow (fair dequeue)");
+        queue->count--;
+        if (queue->count == 0) ready_bitmap_clear(cpu, index);
+        nr_queued_dec(cpu);
+        task->in_run_queue = false;
+        return true;
+    }
+#endif
+
     if (!queue->head) {
+
         SCHED_WARN("Attempted dequeue from empty queue Prio %u for task PID %lu", task->priority, task->pid);
         task->in_run_queue = false;
         return false;
@@ -192,6 +579,8 @@ static bool dequeue_task_locked(tcb_t *task) {
         if (queue->tail == task) { queue->tail = NULL; KERNEL_ASSERT(queue->head == NULL, "Head non-NULL when tail dequeued");}
         KERNEL_ASSERT(queue->count > 0, "Queue count underflow (head dequeue)");
         queue->count--;
+        if (queue->count == 0) ready_bitmap_clear(cpu, index);
+        if (task->pid != IDLE_TASK_PID) nr_queued_dec(cpu);
         task->next = NULL;
         task->in_run_queue = false;
         return true;
@@ -207,6 +596,8 @@ static bool dequeue_task_locked(tcb_t *task) {
         if (queue->tail == task) { queue->tail = prev; }
         KERNEL_ASSERT(queue->count > 0, "Queue count underflow (mid/tail dequeue)");
         queue->count--;
+        if (queue->count == 0) ready_bitmap_clear(cpu, index);
+        if (task->pid != IDLE_TASK_PID) nr_queued_dec(cpu);
         task->next = NULL;
         task->in_run_queue = false;
         return true;
@@ -221,68 +612,85 @@ static void add_to_sleep_queue_locked(tcb_t *task) {
     KERNEL_ASSERT(task != NULL && task->state == TASK_SLEEPING, "Invalid task/state for sleep queue add");
     KERNEL_ASSERT(!task->in_run_queue, "Sleeping task should not be marked as in_run_queue");
 
-    task->wait_next = NULL;
-    task->wait_prev = NULL;
+    timer_entry_init(&task->sleep_timer, sleep_timer_expired, task);
+    task->sleep_timer.expires = task->wakeup_time;
+    sleep_wheel_add_locked(&task->sleep_timer);
+}
+
 
-    if (!g_sleep_queue.head || task->wakeup_time <= g_sleep_queue.head->wakeup_time) {
-        task->wait_next = g_sleep_queue.head;
-        if (g_sleep_queue.head) g_sleep_queue.head->wait_prev = task;
-        g_sleep_queue.head = task;
-    } else {
-        tcb_t *current = g_sleep_queue.head;
-        while (current->wait_next && current->wait_next->wakeup_time <= task->wakeup_time) {
-            current = current->wait_next;
-        }
-        task->wait_next = current->wait_next;
-        task->wait_prev = current;
-        if (current->wait_next) current->wait_next->wait_prev = task;
-        current->wait_next = task;
+/**
+ * @brief Sleep wheel callback: moves the expired task back to its run queue.
+ * Runs from check_sleeping_tasks() with the wheel lock already dropped.
+ */
+static void sleep_timer_expired(timer_entry_t *entry, void *arg) {
+    (void)entry;
+    tcb_t *task = (tcb_t *)arg;
+    task->state = TASK_READY;
+    task->woken = true;
+
+    SCHED_DEBUG("Waking up task PID %lu (Prio %u)", task->pid, task->priority);
+    run_queue_t *queue = task_queue(task);
+
+    uintptr_t queue_irq_flags = spinlock_acquire_irqsave(&queue->lock);
+    if (!enqueue_task_locked(task)) {
+         SCHED_ERROR("Failed to enqueue woken task PID %lu", task->pid);
     }
-    g_sleep_queue.count++;
+    spinlock_release_irqrestore(&queue->lock, queue_irq_flags);
+    sched_kick_remote(task);
 }
 
-static void remove_from_sleep_queue_locked(tcb_t *task) {
-    KERNEL_ASSERT(task != NULL, "Cannot remove NULL from sleep queue");
-    KERNEL_ASSERT(g_sleep_queue.count > 0, "Sleep queue count underflow");
+// The tick skips the softirq while the wheel is empty; bring its clock up
+// to date first so the next collection doesn't walk every tick it missed.
+static void sleep_wheel_add_locked(timer_entry_t *entry) {
+    if (g_sleep_wheel.count == 0) g_sleep_wheel.base_tick = g_tick_count;
+    timer_wheel_add_locked(&g_sleep_wheel, entry);
+}
 
-    if (task->wait_prev) task->wait_prev->wait_next = task->wait_next;
-    else g_sleep_queue.head = task->wait_next;
+static void check_sleeping_tasks(void) {
+    // Advance the wheel under its lock, then wake tasks without holding it.
+    uintptr_t sleep_irq_flags = spinlock_acquire_irqsave(&g_sleep_wheel.lock);
+    timer_entry_t *expired = timer_wheel_collect_expired_locked(&g_sleep_wheel, g_tick_count);
+    if (expired) g_sleep_wheel_expiring = true;
+    spinlock_release_irqrestore(&g_sleep_wheel.lock, sleep_irq_flags);
+
+    if (!expired) return;
+    while (expired) {
+        timer_entry_t *next = expired->next;
+        expired->next = NULL;
+        expired->callback(expired, expired->arg);
+        expired = next;
+    }
+    g_sleep_wheel_expiring = false;
+    set_need_resched();
+}
 
-    if (task->wait_next) task->wait_next->wait_prev = task->wait_prev;
+//============================================================================
+// Tick-Wheel Timers
+//============================================================================
+uint32_t scheduler_ms_to_ticks(uint32_t ms) {
+    uint32_t ticks = MS_TO_TICKS(ms);
+    return (ticks == 0 && ms > 0) ? 1 : ticks;
+}
 
-    task->wait_next = NULL;
-    task->wait_prev = NULL;
-    g_sleep_queue.count--;
+void scheduler_timer_add(timer_entry_t *entry) {
+    KERNEL_ASSERT(entry != NULL && entry->callback != NULL, "scheduler_timer_add: entry without callback");
+    uintptr_t sleep_irq_flags = spinlock_acquire_irqsave(&g_sleep_wheel.lock);
+    sleep_wheel_add_locked(entry);
+    spinlock_release_irqrestore(&g_sleep_wheel.lock, sleep_irq_flags);
 }
 
-static void check_sleeping_tasks(void) {
-    uintptr_t sleep_irq_flags = spinlock_acquire_irqsave(&g_sleep_queue.lock);
-    if (!g_sleep_queue.head) { spinlock_release_irqrestore(&g_sleep_queue.lock, sleep_irq_flags); return; }
-
-    uint32_t current_ticks = g_tick_count;
-    tcb_t *task = g_sleep_queue.head;
-    bool task_woken = false;
-
-    while (task && task->wakeup_time <= current_ticks) {
-        tcb_t *task_to_wake = task;
-        task = task->wait_next;
-        remove_from_sleep_queue_locked(task_to_wake);
-        task_to_wake->state = TASK_READY;
-        spinlock_release_irqrestore(&g_sleep_queue.lock, sleep_irq_flags); // Release sleep lock
-
-        SCHED_DEBUG("Waking up task PID %lu (Prio %u)", task_to_wake->pid, task_to_wake->priority);
-        run_queue_t *queue = &g_run_queues[task_to_wake->priority];
-        uintptr_t queue_irq_flags = spinlock_acquire_irqsave(&queue->lock);
-        if (!enqueue_task_locked(task_to_wake)) {
-             SCHED_ERROR("Failed to enqueue woken task PID %lu", task_to_wake->pid);
-        }
-        task_woken = true;
-        spinlock_release_irqrestore(&queue->lock, queue_irq_flags); // Release queue lock
+bool scheduler_timer_cancel(timer_entry_t *entry) {
+    KERNEL_ASSERT(entry != NULL, "scheduler_timer_cancel: NULL entry");
+    uintptr_t sleep_irq_flags = spinlock_acquire_irqsave(&g_sleep_wheel.lock);
+    bool removed = timer_wheel_remove_locked(&g_sleep_wheel, entry);
+    spinlock_release_irqrestore(&g_sleep_wheel.lock, sleep_irq_flags);
 
-        sleep_irq_flags = spinlock_acquire_irqsave(&g_sleep_queue.lock); // Re-acquire sleep lock
+    // Not pending any more: it may sit collected on another CPU's expired
+    // list, so let that tick finish its callbacks before the entry is reused.
+    if (!removed) {
+        while (g_sleep_wheel_expiring) asm volatile("pause");
     }
-    spinlock_release_irqrestore(&g_sleep_queue.lock, sleep_irq_flags); // Release final sleep lock
-    if (task_woken) { g_need_reschedule = true; }
+    return removed;
 }
 
 //============================================================================
@@ -292,36 +700,196 @@ uint32_t scheduler_get_ticks(void) {
     return g_tick_count;
 }
 
+void scheduler_advance_ticks(uint32_t ticks) {
+    g_tick_count += ticks;
+    vvar_update_ticks(g_tick_count);
+}
+
+/**
+ * @brief SOFTIRQ_SCHED: the tick's deferred half, with interrupts enabled.
+ * Wakeups set need_resched(); the interrupt exit switches afterwards.
+ */
+static void scheduler_softirq(void) {
+    check_sleeping_tasks();
+    // Allocators only flag low memory; the wakeup happens here, where no
+    // allocator or wait-queue lock can be held.
+    if (g_reaper_started && shrinker_background_pending()) wake_up_one(&g_reaper_wq);
+}
+
 void scheduler_tick(void) {
     g_tick_count++;
+    vvar_update_ticks(g_tick_count);
+    terminal_tick();
+    timer_tick();
     if (!g_scheduler_ready) return;
 
-    check_sleeping_tasks();
+    // Only the accounting stays in the interrupt; racy reads, like timer_tick()
+    if (g_sleep_wheel.count || (g_reaper_started && shrinker_background_pending())) {
+        softirq_raise(SOFTIRQ_SCHED);
+    }
+    scheduler_tick_local();
+}
 
-    volatile tcb_t *curr_task_v = g_current_task;
+void scheduler_tick_local(void) {
+    if (!g_scheduler_ready) return;
+    rcu_tick();
+
+    sched_cpu_t *cpu = this_sched_cpu();
+    if ((g_tick_count - cpu->last_balance_tick) >= SCHED_BALANCE_INTERVAL_TICKS) {
+        cpu->last_balance_tick = g_tick_count;
+        scheduler_balance();
+    }
+
+    volatile tcb_t *curr_task_v = cpu->current;
     if (!curr_task_v) return;
     tcb_t *curr_task = (tcb_t *)curr_task_v;
 
-    if (curr_task->pid == IDLE_TASK_PID) {
-        if (g_need_reschedule) { g_need_reschedule = false; schedule(); }
-        return;
-    }
+    // Only flags the switch: irq_exit() makes it after the softirqs, so a
+    // task SOFTIRQ_SCHED wakes on this tick competes in the same decision.
+    if (curr_task->pid == IDLE_TASK_PID) return;
 
     curr_task->runtime_ticks++;
+#if SCHED_CLASS_FAIR
+    curr_task->vruntime += g_fair_vruntime_per_tick[curr_task->priority];
+#endif
     if (curr_task->ticks_remaining > 0) {
         curr_task->ticks_remaining--;
     }
 
     if (curr_task->ticks_remaining == 0) {
         SCHED_DEBUG("Timeslice expired for PID %lu", curr_task->pid);
-        g_need_reschedule = true;
+        set_need_resched();
+    }
+}
+
+//============================================================================
+// Load Balancing (Work Stealing)
+//============================================================================
+/** @brief Returns the online CPU (other than @p self) with the most queued tasks. */
+static sched_cpu_t *find_busiest_cpu(sched_cpu_t *self) {
+    sched_cpu_t *busiest = NULL;
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        sched_cpu_t *candidate = &g_sched_cpus[i];
+        if (candidate == self || !candidate->online) continue;
+        if (!busiest || candidate->nr_queued > busiest->nr_queued) busiest = candidate;
+    }
+    return busiest;
+}
+
+/** @brief Returns the online CPU with the fewest queued tasks (placement for new tasks). */
+static sched_cpu_t *find_least_loaded_cpu(void) {
+    sched_cpu_t *best = this_sched_cpu();
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        sched_cpu_t *candidate = &g_sched_cpus[i];
+        if (candidate->online && candidate->nr_queued < best->nr_queued) best = candidate;
+    }
+    return best;
+}
+
+/**
+ * @brief Moves up to @p max_tasks queued tasks from @p src to @p dst.
+
+ * Tasks are taken highest priority first; idle tasks and tasks still on a
+ * CPU (tcb_t::on_cpu) never migrate. Only one
+ * queue lock is held at a time, so no lock ordering between CPUs is needed.
+ * @return Number of tasks migrated.
+ */
+static uint32_t migrate_tasks(sched_cpu_t *src, sched_cpu_t *dst, uint32_t max_tasks) {
+    uint32_t moved = 0;
+    for (uint32_t prio = 0; prio < SCHED_PRIORITY_LEVELS && moved < max_tasks; prio++) {
+        if (!(src->ready_bitmap & (1u << prio))) continue;
+        run_queue_t *src_queue = &src->queues[prio];
+
+        while (moved < max_tasks) {
+            uintptr_t src_flags = spinlock_acquire_irqsave(&src_queue->lock);
+            tcb_t *task = queue_first_locked(src_queue, prio);
+            // A task requeued by schedule(), or woken, while it is still
+            // switching out on src has no saved ESP yet: leave it to src.
+            while (task && (task->pid == IDLE_TASK_PID || task->on_cpu)) task = queue_next_locked(task, prio);
+            if (!task || !dequeue_task_locked(task)) {
+                spinlock_release_irqrestore(&src_queue->lock, src_flags);
+                break;
+            }
+            spinlock_release_irqrestore(&src_queue->lock, src_flags);
+
+            task->cpu = (uint8_t)dst->cpu_id;
+            run_queue_t *dst_queue = &dst->queues[prio];
+            uintptr_t dst_flags = spinlock_acquire_irqsave(&dst_queue->lock);
+#if SCHED_CLASS_FAIR
+            // Keep the task's lag relative to its new CPU's timeline.
+            if (prio == SCHED_FAIR_QUEUE) {
+                task->vruntime = task->vruntime - src_queue->min_vruntime + dst_queue->min_vruntime;
+            }
+#endif
+            if (!enqueue_task_locked(task)) {
+                SCHED_ERROR("Failed to enqueue migrated task PID %lu on CPU %lu", task->pid, dst->cpu_id);
+            }
+            spinlock_release_irqrestore(&dst_queue->lock, dst_flags);
+            moved++;
+        }
     }
+    if (moved) {
+        dst->tasks_pulled += moved;
+        SCHED_DEBUG("Migrated %lu task(s) CPU %lu -> CPU %lu", moved, src->cpu_id, dst->cpu_id);
+    }
+    return moved;
+}
 
-    if (g_need_reschedule) {
-        g_need_reschedule = false;
-        schedule();
+/**
+ * @brief Idle-time work stealing: pulls half of the busiest CPU's queued tasks.
+ * @return true if at least one task was pulled onto this CPU.
+ */
+static bool scheduler_steal_work(sched_cpu_t *self) {
+    sched_cpu_t *busiest = find_busiest_cpu(self);
+    if (!busiest || busiest->nr_queued == 0) return false;
+    return migrate_tasks(busiest, self, (busiest->nr_queued + 1) / 2) > 0;
+}
+
+void scheduler_balance(void) {
+    sched_cpu_t *self = this_sched_cpu();
+    sched_cpu_t *busiest = find_busiest_cpu(self);
+    if (!busiest) return;
+    uint32_t busiest_load = busiest->nr_queued;
+    uint32_t self_load = self->nr_queued;
+    if (busiest_load < self_load + SCHED_BALANCE_MIN_IMBALANCE) return;
+    if (migrate_tasks(busiest, self, (busiest_load - self_load) / 2) > 0) {
+        set_need_resched();
+    }
+}
+
+//============================================================================
+// Tickless Idle
+//============================================================================
+#if SCHED_TICKLESS_IDLE
+/**
+ * @brief Arms a one-shot timer for the next sleep deadline if the whole system is idle.
+ * The global tick is shared by all CPUs, so it may only stop once no CPU has
+ * anything queued or running. Must be called with interrupts disabled.
+ * @return true if the periodic tick was stopped.
+ */
+static bool scheduler_enter_tickless(void) {
+    terminal_tick(); // The cursor must not wait for the next tick with the tick stopped
+    if (!g_scheduler_ready || need_resched()) return false;
+    // Only the BSP owns the global tick; APs keep their local APIC tick.
+    if (this_sched_cpu()->cpu_id != 0) return false;
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        sched_cpu_t *cpu = &g_sched_cpus[i];
+        if (!cpu->online) continue;
+        if (cpu->nr_queued != 0 || cpu->current != &cpu->idle_tcb) return false;
     }
+
+    uint32_t max_ticks = tick_max_oneshot_ticks();
+    uintptr_t sleep_irq_flags = spinlock_acquire_irqsave(&g_sleep_wheel.lock);
+    uint32_t ticks = timer_wheel_ticks_to_next_locked(&g_sleep_wheel, g_tick_count, max_ticks);
+    spinlock_release_irqrestore(&g_sleep_wheel.lock, sleep_irq_flags);
+    ticks = timer_ticks_to_next(g_tick_count, ticks); // Driver timers too
+
+    if (ticks < SCHED_TICKLESS_MIN_TICKS) return false;
+    g_tickless_active = true;
+    tick_start_oneshot(ticks);
+    return true;
 }
+#endif
 
 //============================================================================
 // Idle Task & Zombie Cleanup (KBC Polling Removed)
@@ -342,15 +910,16 @@ static __attribute__((noreturn)) void kernel_idle_task_loop(void) {
     serial_printf("[Idle DEBUG] Initial segment registers: GS=0x%x FS=0x%x ES=0x%x DS=0x%x\n",
                    gs & 0xFFFF, fs & 0xFFFF, es & 0xFFFF, ds & 0xFFFF);
     serial_printf("[Idle DEBUG] Current ESP after function prologue: 0x%x\n", current_esp);
-    serial_printf("[Idle DEBUG] TCB saved ESP was: 0x%x\n", (uint32_t)g_idle_task_tcb.esp);
+    serial_printf("[Idle DEBUG] TCB saved ESP was: 0x%x\n", (uint32_t)this_sched_cpu()->idle_tcb.esp);
 
     // Ensure segment registers are properly set
     asm volatile(
         "mov $0x10, %%ax\n"
         "mov %%ax, %%ds\n"
         "mov %%ax, %%es\n"
-        "mov %%ax, %%fs\n"
         "mov %%ax, %%gs\n"
+        "mov $0x30, %%ax\n"     // GDT_PERCPU_SELECTOR
+        "mov %%ax, %%fs\n"
         : : : "ax"
     );
 
@@ -376,7 +945,11 @@ static __attribute__((noreturn)) void kernel_idle_task_loop(void) {
             : : : "memory"
         );
         
-        scheduler_cleanup_zombies(); // Periodically try to reap zombie processes
+        reaper_flush_dead_task(this_sched_cpu()); // Hand a just-exited task to the reaper
+
+        // Nothing to run: clear a few free frames for frame_alloc_zeroed_mt().
+        // Bounded so a wakeup waits for at most a few page clears.
+        frame_zero_pool_refill(SCHED_IDLE_ZERO_FRAMES);
         
         // Check segments after cleanup
         uint32_t ds_after;
@@ -389,10 +962,32 @@ static __attribute__((noreturn)) void kernel_idle_task_loop(void) {
         // Memory barrier to ensure all writes complete
         asm volatile("mfence" ::: "memory");
 
+        // Before halting, try to pull work from a busier CPU. Interrupts stay
+        // disabled across the steal and the switch so the pulled tasks cannot
+        // be migrated away again in between.
+        asm volatile("cli");
+        if (scheduler_steal_work(this_sched_cpu())) {
+            schedule();
+        }
+
+#if SCHED_TICKLESS_IDLE
+        if (scheduler_enter_tickless()) {
+            asm volatile ("sti; hlt");
+            // Woken by the one-shot or by another IRQ: resume periodic ticks
+            // and run anything that IRQ made ready without waiting a tick.
+            tick_stop_oneshot();
+            asm volatile("cli");
+            g_tickless_active = false;
+            if (need_resched()) { clear_need_resched(); schedule(); }
+            continue;
+        }
+#endif
+
         // Enable interrupts and halt the CPU until the next interrupt.
         // This saves power and yields to other tasks if they become ready.
         asm volatile ("sti; hlt");
 
+
         // Interrupts are automatically disabled by CPU upon IRQ.
         // The IRQ handler (e.g., pit_irq_handler) will re-enable them if necessary
         // or the scheduler will when switching back to a task.
@@ -400,49 +995,13 @@ static __attribute__((noreturn)) void kernel_idle_task_loop(void) {
 }
 
 
-static void scheduler_init_idle_task(void) {
-    SCHED_DEBUG("Initializing idle task...");
-    memset(&g_idle_task_pcb, 0, sizeof(pcb_t));
-    g_idle_task_pcb.pid = IDLE_TASK_PID;
-    g_idle_task_pcb.page_directory_phys = (uint32_t*)g_kernel_page_directory_phys;
-    KERNEL_ASSERT(g_idle_task_pcb.page_directory_phys != NULL, "Kernel PD phys NULL during idle init");
-    g_idle_task_pcb.entry_point = (uintptr_t)kernel_idle_task_loop;
-
-    // --- Corrected Stack Setup ---
-    // Allocate idle task stack from kmalloc to avoid static buffer issues
-    void *idle_stack_mem = kmalloc(PROCESS_KSTACK_SIZE + 8); // Extra space for alignment
-    if (!idle_stack_mem) {
-        KERNEL_PANIC_HALT("Failed to allocate idle task stack!");
-    }
-    
-    // Align to 16-byte boundary
-    uintptr_t idle_stack_base = ((uintptr_t)idle_stack_mem + 15) & ~15;
-    uintptr_t idle_stack_top = idle_stack_base + PROCESS_KSTACK_SIZE;
-    
-    // Explicitly zero the stack region
-    serial_printf("[Sched DEBUG] Zeroing idle task stack region: V=[%p - %p)\n",
-                  (void*)idle_stack_base, (void*)idle_stack_top);
-    memset((void*)idle_stack_base, 0, PROCESS_KSTACK_SIZE); // Zero the usable stack size
-    
-    uintptr_t stack_top_virt_addr = idle_stack_top;
-    g_idle_task_pcb.kernel_stack_vaddr_top = (uint32_t*)stack_top_virt_addr;
-
-    // Log the allocated stack location
-    serial_printf("[Sched DEBUG] Idle stack allocated at virt %p-%p\n", 
-                  (void*)idle_stack_base, (void*)idle_stack_top);
-
-    memset(&g_idle_task_tcb, 0, sizeof(tcb_t));
-    g_idle_task_tcb.process = &g_idle_task_pcb;
-    g_idle_task_tcb.pid     = IDLE_TASK_PID;
-    g_idle_task_tcb.state   = TASK_READY;
-    g_idle_task_tcb.in_run_queue = false;
-    g_idle_task_tcb.has_run = false;
-    g_idle_task_tcb.priority = SCHED_IDLE_PRIORITY;
-    KERNEL_ASSERT(g_idle_task_tcb.priority < SCHED_PRIORITY_LEVELS, "Idle priority out of bounds");
-    g_idle_task_tcb.time_slice_ticks = MS_TO_TICKS(g_priority_time_slices_ms[g_idle_task_tcb.priority]);
-    g_idle_task_tcb.ticks_remaining = g_idle_task_tcb.time_slice_ticks;
-
-    uint32_t *kstack_ptr = (uint32_t*)stack_top_virt_addr;
+/**
+ * @brief Lays out a fresh kernel stack so context_switch() "returns" into
+ * @p entry with interrupts enabled and kernel segments loaded.
+ * @return Initial saved ESP for the thread's TCB.
+ */
+static uint32_t *kthread_build_initial_stack(uintptr_t stack_top, void (*entry)(void)) {
+    uint32_t *kstack_ptr = (uint32_t*)stack_top;
     
     // Build the stack exactly as context_switch expects to find it.
     // context_switch restores in this exact order:
@@ -460,12 +1019,12 @@ static void scheduler_init_idle_task(void) {
     // What we store LAST will be at the LOWEST address (ESP points here, popped FIRST).
     
     // Store in reverse order of how they'll be popped:
-    *(--kstack_ptr) = (uint32_t)kernel_idle_task_loop; // Return address for RET
+    *(--kstack_ptr) = (uint32_t)entry; // Return address for RET
     *(--kstack_ptr) = 0; // Saved EBP for epilogue  
     // Segment registers - same order as they appear after context save
     *(--kstack_ptr) = KERNEL_DATA_SELECTOR; // DS (first to be popped)
     *(--kstack_ptr) = KERNEL_DATA_SELECTOR; // ES
-    *(--kstack_ptr) = KERNEL_DATA_SELECTOR; // FS
+    *(--kstack_ptr) = GDT_PERCPU_SELECTOR;  // FS
     *(--kstack_ptr) = KERNEL_DATA_SELECTOR; // GS (last to be popped)
     *(--kstack_ptr) = 0x00000202; // EFLAGS with interrupts enabled
     
@@ -480,9 +1039,58 @@ static void scheduler_init_idle_task(void) {
     *(--kstack_ptr) = 0; // EBP (will be at ESP+8)
     *(--kstack_ptr) = 0; // ESI (will be at ESP+4)
     *(--kstack_ptr) = 0; // EDI (will be at ESP+0, first register restored)
+    return kstack_ptr;
+}
+
+static void scheduler_init_idle_task(sched_cpu_t *cpu) {
+    SCHED_DEBUG("Initializing idle task for CPU %lu...", cpu->cpu_id);
+    memset(&cpu->idle_pcb, 0, sizeof(pcb_t));
+    cpu->idle_pcb.pid = IDLE_TASK_PID;
+    cpu->idle_pcb.page_directory_phys = (uint32_t*)g_kernel_page_directory_phys;
+    KERNEL_ASSERT(cpu->idle_pcb.page_directory_phys != NULL, "Kernel PD phys NULL during idle init");
+    cpu->idle_pcb.entry_point = (uintptr_t)kernel_idle_task_loop;
+
+    // --- Corrected Stack Setup ---
+    // Allocate idle task stack from kmalloc to avoid static buffer issues
+    void *idle_stack_mem = kmalloc(PROCESS_KSTACK_SIZE + 8); // Extra space for alignment
+    if (!idle_stack_mem) {
+        KERNEL_PANIC_HALT("Failed to allocate idle task stack!");
+    }
+    
+    // Align to 16-byte boundary
+    uintptr_t idle_stack_base = ((uintptr_t)idle_stack_mem + 15) & ~15;
+    uintptr_t idle_stack_top = idle_stack_base + PROCESS_KSTACK_SIZE;
+    
+    // Explicitly zero the stack region
+    serial_printf("[Sched DEBUG] Zeroing idle task stack region: V=[%p - %p)\n",
+                  (void*)idle_stack_base, (void*)idle_stack_top);
+    memset((void*)idle_stack_base, 0, PROCESS_KSTACK_SIZE); // Zero the usable stack size
     
-    g_idle_task_tcb.esp = kstack_ptr;
-    SCHED_DEBUG("Idle task initial TCB ESP set to: %p", g_idle_task_tcb.esp);
+    uintptr_t stack_top_virt_addr = idle_stack_top;
+    cpu->idle_pcb.kernel_stack_vaddr_top = (uint32_t*)stack_top_virt_addr;
+
+    // Log the allocated stack location
+    serial_printf("[Sched DEBUG] Idle stack allocated at virt %p-%p\n", 
+                  (void*)idle_stack_base, (void*)idle_stack_top);
+
+    memset(&cpu->idle_tcb, 0, sizeof(tcb_t));
+    cpu->idle_tcb.process = &cpu->idle_pcb;
+    cpu->idle_tcb.pid     = IDLE_TASK_PID;
+    cpu->idle_tcb.cpu     = (uint8_t)cpu->cpu_id;
+    cpu->idle_tcb.state   = TASK_READY;
+    cpu->idle_tcb.in_run_queue = false;
+    cpu->idle_tcb.has_run = false;
+    cpu->idle_tcb.priority = SCHED_IDLE_PRIORITY;
+    KERNEL_ASSERT(cpu->idle_tcb.priority < SCHED_PRIORITY_LEVELS, "Idle priority out of bounds");
+    cpu->idle_tcb.time_slice_ticks = MS_TO_TICKS(g_priority_time_slices_ms[cpu->idle_tcb.priority]);
+    cpu->idle_tcb.ticks_remaining = cpu->idle_tcb.time_slice_ticks;
+
+    cpu->idle_tcb.kernel_thread = true;
+
+    uint32_t *kstack_ptr = kthread_build_initial_stack(stack_top_virt_addr, kernel_idle_task_loop);
+    
+    cpu->idle_tcb.esp = kstack_ptr;
+    SCHED_DEBUG("Idle task initial TCB ESP set to: %p", cpu->idle_tcb.esp);
     
     // Debug: Verify stack contents match what context_switch expects
     SCHED_DEBUG("Idle task stack contents (ESP=%p):", kstack_ptr);
@@ -498,83 +1106,164 @@ static void scheduler_init_idle_task(void) {
     SCHED_DEBUG("  [ESP+28] EAX = 0x%08lx", (unsigned long)debug_ptr[7]);
     SCHED_DEBUG("  [ESP+32] EFLAGS = 0x%08lx (IF=%s)", (unsigned long)debug_ptr[8], 
                 (debug_ptr[8] & 0x200) ? "1" : "0");
-    SCHED_DEBUG("  [ESP+36] DS = 0x%08lx (expect 0x10)", (unsigned long)debug_ptr[9]);
-    SCHED_DEBUG("  [ESP+40] ES = 0x%08lx (expect 0x10)", (unsigned long)debug_ptr[10]);
-    SCHED_DEBUG("  [ESP+44] FS = 0x%08lx (expect 0x10)", (unsigned long)debug_ptr[11]);
-    SCHED_DEBUG("  [ESP+48] GS = 0x%08lx (expect 0x10)", (unsigned long)debug_ptr[12]);
+    SCHED_DEBUG("  [ESP+36] GS = 0x%08lx (expect 0x10)", (unsigned long)debug_ptr[9]);
+    SCHED_DEBUG("  [ESP+40] FS = 0x%08lx (expect 0x30)", (unsigned long)debug_ptr[10]);
+    SCHED_DEBUG("  [ESP+44] ES = 0x%08lx (expect 0x10)", (unsigned long)debug_ptr[11]);
+    SCHED_DEBUG("  [ESP+48] DS = 0x%08lx (expect 0x10)", (unsigned long)debug_ptr[12]);
     SCHED_DEBUG("  [ESP+52] saved EBP = 0x%08lx", (unsigned long)debug_ptr[13]);
     SCHED_DEBUG("  [ESP+56] return addr = 0x%08lx (kernel_idle_task_loop)", (unsigned long)debug_ptr[14]);
 
     uintptr_t irq_flags = spinlock_acquire_irqsave(&g_all_tasks_lock);
-    g_idle_task_tcb.all_tasks_next = g_all_tasks_head;
-    g_all_tasks_head = &g_idle_task_tcb;
+    all_tasks_insert_locked(&cpu->idle_tcb);
     spinlock_release_irqrestore(&g_all_tasks_lock, irq_flags);
 }
 
-void scheduler_cleanup_zombies(void) {
-    SCHED_TRACE("Checking for ZOMBIE tasks...");
-    tcb_t *zombie_to_reap = NULL;
-    tcb_t *prev_all = NULL;
+//============================================================================
+// Zombie Reaper
+//============================================================================
+// Exiting tasks are handed to a dedicated low-priority kernel thread through a
+// lock-free LIFO, so teardown cost lands on otherwise idle CPU time instead of
+// on whichever task happens to run schedule() or the idle loop next.
+static inline bool reaper_list_cas(tcb_t **expected, tcb_t *desired) {
+    tcb_t *prev;
+    asm volatile("lock cmpxchgl %2, %1"
+                 : "=a"(prev), "+m"(g_reaper_list)
+                 : "r"(desired), "0"(*expected)
+                 : "memory");
+    if (prev == *expected) return true;
+    *expected = prev;
+    return false;
+}
+
+static void reaper_list_push(tcb_t *zombie) {
+    tcb_t *head = g_reaper_list;
+    do {
+        zombie->next = head;
+    } while (!reaper_list_cas(&head, zombie));
+}
 
-    uintptr_t all_tasks_irq_flags = spinlock_acquire_irqsave(&g_all_tasks_lock);
-    tcb_t *current_all = g_all_tasks_head;
-    while (current_all) {
-        if (current_all->pid != IDLE_TASK_PID && current_all->state == TASK_ZOMBIE) {
-            zombie_to_reap = current_all;
-            if (prev_all) prev_all->all_tasks_next = current_all->all_tasks_next;
-            else g_all_tasks_head = current_all->all_tasks_next;
-            zombie_to_reap->all_tasks_next = NULL;
-            break;
-        }
-        prev_all = current_all;
-        current_all = current_all->all_tasks_next;
-    }
-    spinlock_release_irqrestore(&g_all_tasks_lock, all_tasks_irq_flags);
+/**
+ * @brief Hands the zombie this CPU last switched away from to the reaper.
+ * Only called from code running on a different stack than the zombie's, so
+ * its kernel stack is guaranteed to be out of use by then.
+ */
+static void reaper_flush_dead_task(sched_cpu_t *cpu) {
+    tcb_t *dead = __atomic_exchange_n(&cpu->dead_task, NULL, __ATOMIC_ACQ_REL);
+    if (!dead) return;
+    reaper_list_push(dead);
+    if (g_reaper_started) wake_up_one(&g_reaper_wq);
+}
+
+uint32_t scheduler_cleanup_zombies(void) {
+    // Take the whole list at once; everything on it is freed as one batch.
+    tcb_t *batch = __atomic_exchange_n(&g_reaper_list, NULL, __ATOMIC_ACQ_REL);
+    uint32_t reaped = 0;
+
+    while (batch) {
+        tcb_t *zombie_to_reap = batch;
+        batch = batch->next;
+        zombie_to_reap->next = NULL;
+        KERNEL_ASSERT(zombie_to_reap->state == TASK_ZOMBIE, "Non-zombie task handed to the reaper");
+
+        uintptr_t all_tasks_irq_flags = spinlock_acquire_irqsave(&g_all_tasks_lock);
+        if (zombie_to_reap->all_tasks_pprev) all_tasks_remove_locked(zombie_to_reap);
+        else SCHED_WARN("Zombie PID %lu missing from the all-tasks list", zombie_to_reap->pid);
+        spinlock_release_irqrestore(&g_all_tasks_lock, all_tasks_irq_flags);
 
-    if (zombie_to_reap) {
         SCHED_INFO("Cleanup: Reaping ZOMBIE task PID %lu (Exit Code: %lu).", zombie_to_reap->pid, zombie_to_reap->exit_code);
         
         // Check idle task stack before destroying process
         check_idle_task_stack_integrity("Before destroy_process");
         
-        if (zombie_to_reap->process) {
-            serial_printf("[destroy_process] Enter for PID %lu\n", zombie_to_reap->pid);
-            destroy_process(zombie_to_reap->process);
-            serial_printf("[destroy_process] Exit for PID %lu\n", zombie_to_reap->pid);
+        pcb_t *proc = zombie_to_reap->process;
+        if (!proc) {
+            SCHED_WARN("Zombie task PID %lu has NULL process pointer!", zombie_to_reap->pid);
+        } else if (zombie_to_reap->kernel_thread) {
+            kfree(proc); // kthread_create()'s placeholder PCB
+        } else {
+            // An extra thread's TID is its own; the process's PID goes with the PCB.
+            if (zombie_to_reap->pid != proc->pid) pid_free(zombie_to_reap->pid);
+            uint32_t threads_before = (uint32_t)-1;
+            asm volatile("lock xaddl %0, %1" : "+r"(threads_before), "+m"(proc->nr_threads) : : "memory", "cc");
+            if (threads_before == 1) {
+                // Last thread out: the process goes with it
+                serial_printf("[destroy_process] Enter for PID %lu\n", proc->pid);
+                process_exit_release(proc, zombie_to_reap->exit_code);
+                serial_printf("[destroy_process] Exit for PID %lu\n", zombie_to_reap->pid);
+            }
         }
-        else SCHED_WARN("Zombie task PID %lu has NULL process pointer!", zombie_to_reap->pid);
         
-        // Check idle task stack after destroying process
-        check_idle_task_stack_integrity("After destroy_process");
-        
-        kfree(zombie_to_reap);
+        kstack_free(zombie_to_reap->kernel_stack_top);
+        fpu_release_task(zombie_to_reap);
+        perf_release_task(zombie_to_reap);
+        slab_free(g_tcb_cache, zombie_to_reap);
         
         // Check idle task stack after freeing TCB
-        check_idle_task_stack_integrity("After kfree(tcb)");
+        check_idle_task_stack_integrity("After freeing tcb");
+        reaped++;
     }
+    return reaped;
+}
+
+static void reaper_thread_loop(void *arg) {
+    (void)arg;
+    SCHED_INFO("Reaper thread started (PID %lu, Prio %u).", get_current_task()->pid, get_current_task()->priority);
+    for (;;) {
+        // We may be the first thing to run after a zombie on this CPU.
+        reaper_flush_dead_task(this_sched_cpu());
+        wait_event(&g_reaper_wq, g_reaper_list != NULL || shrinker_background_pending());
+        // The reaper doubles as the background reclaimer (see shrinker.h).
+        if (shrinker_background_pending()) shrinker_background_reclaim();
+        uint32_t reaped = scheduler_cleanup_zombies();
+        if (reaped > 1) SCHED_DEBUG("Reaper freed a batch of %lu tasks", (unsigned long)reaped);
+    }
+}
+
+static void scheduler_init_reaper(void) {
+    wait_queue_init(&g_reaper_wq);
+    if (!kthread_create(reaper_thread_loop, NULL, SCHED_REAPER_PRIORITY)) {
+        KERNEL_PANIC_HALT("Failed to start reaper thread");
+    }
+    g_reaper_started = true;
 }
 
 //============================================================================
 // Task Selection & Context Switching (Corrected format specifiers)
 //============================================================================
-static tcb_t* scheduler_select_next_task(void) {
-    for (int prio = 0; prio < SCHED_PRIORITY_LEVELS; ++prio) {
-        run_queue_t *queue = &g_run_queues[prio];
-        if (!queue->head) continue;
+static tcb_t* scheduler_select_next_task(sched_cpu_t *cpu) {
+    // Nothing but the idle task queued here: steal before settling for idle.
+    if (cpu->nr_queued == 0) scheduler_steal_work(cpu);
+
+    // O(1): BSF on the ready bitmap names the highest non-empty queue, so only
+    // that queue's lock is taken. A bit can go stale between the scan and the
+    // lock (another path emptied the queue), in which case we simply rescan.
+    int prio;
+    while ((prio = ready_bitmap_first(cpu)) >= 0) {
+        run_queue_t *queue = &cpu->queues[prio];
         uintptr_t queue_irq_flags = spinlock_acquire_irqsave(&queue->lock);
-        tcb_t *task = queue->head;
-        if (task) {
-            bool dequeued = dequeue_task_locked(task);
+        tcb_t *task = queue_first_locked(queue, (uint32_t)prio);
+        if (!task) {
+            ready_bitmap_clear(cpu, (uint32_t)prio);
             spinlock_release_irqrestore(&queue->lock, queue_irq_flags);
-            if (!dequeued) { SCHED_ERROR("Selected task PID %lu Prio %d but failed to dequeue!", task->pid, prio); continue; }
-            task->ticks_remaining = MS_TO_TICKS(g_priority_time_slices_ms[task->priority]);
-            SCHED_DEBUG("Selected task PID %lu (Prio %d), Slice=%lu", task->pid, prio, task->ticks_remaining);
-            return task;
+            continue;
         }
+        bool dequeued = dequeue_task_locked(task);
+#if SCHED_CLASS_FAIR
+        if (dequeued && prio == SCHED_FAIR_QUEUE) {
+            if (vruntime_before(queue->min_vruntime, task->vruntime)) queue->min_vruntime = task->vruntime;
+            task->ticks_remaining = fair_time_slice(queue, task);
+        } else
+#endif
+        task->ticks_remaining = MS_TO_TICKS(g_priority_time_slices_ms[task->priority]);
         spinlock_release_irqrestore(&queue->lock, queue_irq_flags);
+        if (!dequeued) { SCHED_ERROR("Selected task PID %lu Prio %d but failed to dequeue!", task->pid, prio); continue; }
+        // Queues only hold other CPUs' on_cpu tasks if something moved one
+        KERNEL_ASSERT(!task->on_cpu || task == cpu->current, "Picked a task still running on another CPU");
+        SCHED_DEBUG("Selected task PID %lu (Prio %d), Slice=%lu", task->pid, prio, task->ticks_remaining);
+        return task;
     }
-    g_idle_task_tcb.ticks_remaining = MS_TO_TICKS(g_priority_time_slices_ms[g_idle_task_tcb.priority]);
-    return &g_idle_task_tcb;
+    cpu->idle_tcb.ticks_remaining = MS_TO_TICKS(g_priority_time_slices_ms[cpu->idle_tcb.priority]);
+    return &cpu->idle_tcb;
 }
 
 static void perform_context_switch(tcb_t *old_task, tcb_t *new_task) {
@@ -588,46 +1277,43 @@ static void perform_context_switch(tcb_t *old_task, tcb_t *new_task) {
         serial_printf("[Sched DEBUG] Switching TO idle task, saved ESP is: %p\n", new_task->esp);
     }
     
-    uintptr_t new_kernel_stack_top_vaddr = (new_task->pid == IDLE_TASK_PID)
-        ? (uintptr_t)g_idle_task_pcb.kernel_stack_vaddr_top
-        : (uintptr_t)new_task->process->kernel_stack_vaddr_top;
+    // Idle tasks carry their own per-CPU idle PCB, so this covers them too.
+    uintptr_t new_kernel_stack_top_vaddr = (uintptr_t)task_kernel_stack_top(new_task);
+
     tss_set_kernel_stack((uint32_t)new_kernel_stack_top_vaddr);
+    perf_switch(old_task, new_task);
     bool pd_needs_switch = (!old_task || !old_task->process || old_task->process->page_directory_phys != new_task->process->page_directory_phys);
-
-    if (!new_task->has_run && new_task->pid != IDLE_TASK_PID) {
-        new_task->has_run = true;
-        SCHED_DEBUG("First run for PID %lu. Jumping to user mode (ESP=%p, PD=%p)",
-                      new_task->pid, new_task->esp, new_task->process->page_directory_phys);
-        jump_to_user_mode(new_task->esp, new_task->process->page_directory_phys);
-        KERNEL_PANIC_HALT("jump_to_user_mode returned!");
-    } else {
-        if (!new_task->has_run && new_task->pid == IDLE_TASK_PID) new_task->has_run = true;
-        SCHED_DEBUG("Context switch: PID %lu (ESP=%p) -> PID %lu (ESP=%p) (PD Switch: %s)",
-                      old_task ? old_task->pid : (uint32_t)-1, old_task ? old_task->esp : NULL,
-                      new_task->pid, new_task->esp,
-                      pd_needs_switch ? "YES" : "NO");
+    // Published before CR3 is loaded so TLB shootdowns for this PD target us (tlb.c).
+    percpu_write(active_pgd, (uintptr_t)new_task->process->page_directory_phys);
+
+    if (!new_task->has_run) new_task->has_run = true;
+    SCHED_DEBUG("Context switch: PID %lu (ESP=%p) -> PID %lu (ESP=%p) (PD Switch: %s)",
+                  old_task ? old_task->pid : (uint32_t)-1, old_task ? old_task->esp : NULL,
+                  new_task->pid, new_task->esp,
+                  pd_needs_switch ? "YES" : "NO");
+    
+    // Debug: Verify stack contents before switch to idle task
+    if (new_task->pid == IDLE_TASK_PID) {
+        uint32_t *stack_ptr = (uint32_t*)new_task->esp;
+        serial_printf("[Sched DEBUG] Pre-switch idle stack check (ESP=%p):\n", stack_ptr);
         
-        // Debug: Verify stack contents before switch to idle task
-        if (new_task->pid == IDLE_TASK_PID) {
-            uint32_t *stack_ptr = (uint32_t*)new_task->esp;
-            serial_printf("[Sched DEBUG] Pre-switch idle stack check (ESP=%p):\n", stack_ptr);
-            
-            // First, let's see what's actually on the stack
-            serial_printf("[Sched DEBUG] Stack dump (looking for 0x10 pattern):\n");
-            for (int i = 0; i < 20; i++) {
-                serial_printf("  [ESP+%d] = 0x%08x %s\n", i*4, stack_ptr[i],
-                              stack_ptr[i] == 0x10 ? "<-- KERNEL_DATA_SEL" : "");
-            }
-            
-            serial_printf("  [ESP+36] DS value = 0x%08x (expect 0x10)\n", stack_ptr[9]);
-            serial_printf("  [ESP+40] ES value = 0x%08x (expect 0x10)\n", stack_ptr[10]);
-            serial_printf("  [ESP+44] FS value = 0x%08x (expect 0x10)\n", stack_ptr[11]);
-            serial_printf("  [ESP+48] GS value = 0x%08x (expect 0x10)\n", stack_ptr[12]);
+        // First, let's see what's actually on the stack
+        serial_printf("[Sched DEBUG] Stack dump (looking for 0x10 pattern):\n");
+        for (int i = 0; i < 20; i++) {
+            serial_printf("  [ESP+%d] = 0x%08x %s\n", i*4, stack_ptr[i],
+                          stack_ptr[i] == 0x10 ? "<-- KERNEL_DATA_SEL" : "");
         }
         
-        context_switch(old_task ? &(old_task->esp) : NULL, new_task->esp,
-                       pd_needs_switch ? new_task->process->page_directory_phys : NULL);
+        serial_printf("  [ESP+36] GS value = 0x%08x (expect 0x10)\n", stack_ptr[9]);
+        serial_printf("  [ESP+40] FS value = 0x%08x (expect 0x30)\n", stack_ptr[10]);
+        serial_printf("  [ESP+44] ES value = 0x%08x (expect 0x10)\n", stack_ptr[11]);
+        serial_printf("  [ESP+48] DS value = 0x%08x (expect 0x10)\n", stack_ptr[12]);
     }
+    
+    // Clears old_task->on_cpu once its context is saved and its stack left
+    context_switch(old_task ? &(old_task->esp) : NULL, new_task->esp,
+                   pd_needs_switch ? new_task->process->page_directory_phys : NULL,
+                   old_task ? &old_task->on_cpu : NULL);
 }
 
 void schedule(void) {
@@ -635,77 +1321,220 @@ void schedule(void) {
     uint32_t eflags;
     asm volatile("pushf; pop %0; cli" : "=r"(eflags));
 
-    tcb_t *old_task = (tcb_t *)g_current_task;
-    tcb_t *new_task = scheduler_select_next_task();
+    sched_cpu_t *cpu = this_sched_cpu();
+    tcb_t *old_task = (tcb_t *)cpu->current;
+    // A zombie stashed by an earlier switch whose next task was entered fresh
+    // (user_first_entry, fork_child_return, a kthread) is off its stack by now.
+    reaper_flush_dead_task(cpu);
+
+    // Requeue a still-runnable old task first so it competes with the rest of
+    // this CPU's queue; if it is still the best choice it is picked again.
+    // Until context_switch() has saved it, on_cpu keeps other CPUs from
+    // pulling it; wakeups are safe too, as they only queue on task->cpu.
+    if (old_task && old_task->state == TASK_RUNNING) {
+        old_task->state = TASK_READY;
+        run_queue_t *queue = task_queue(old_task);
+        uintptr_t queue_irq_flags = spinlock_acquire_irqsave(&queue->lock);
+        if (!enqueue_task_locked(old_task)) {
+            SCHED_ERROR("Failed to re-enqueue old task PID %lu", old_task->pid);
+        }
+        spinlock_release_irqrestore(&queue->lock, queue_irq_flags);
+    }
+
+    tcb_t *new_task = scheduler_select_next_task(cpu);
     KERNEL_ASSERT(new_task != NULL, "scheduler_select_next_task returned NULL!");
 
     if (new_task == old_task) {
         if (old_task && old_task->state == TASK_READY) old_task->state = TASK_RUNNING;
+        if (old_task) {
+            // Picked again without leaving the CPU: no wait to account.
+            old_task->ready_since_tsc = 0;
+            old_task->woken = false;
+            old_task->yielded = false;
+        }
         if (eflags & 0x200) asm volatile("sti");
         return;
     }
 
-    if (old_task) {
-        if (old_task->state == TASK_RUNNING) {
-            old_task->state = TASK_READY;
-            run_queue_t *queue = &g_run_queues[old_task->priority];
-            uintptr_t queue_irq_flags = spinlock_acquire_irqsave(&queue->lock);
-            if (!enqueue_task_locked(old_task)) {
-                SCHED_ERROR("Failed to re-enqueue old task PID %lu", old_task->pid);
-            }
-            spinlock_release_irqrestore(&queue->lock, queue_irq_flags);
-        }
-    }
+#if SCHED_TICKLESS_IDLE
+    // The BSP may have stopped the system clock while every CPU was idle;
+    // wake it so the tick runs again while this CPU has work.
+    if (cpu->cpu_id != 0 && old_task == &cpu->idle_tcb && g_tickless_active) smp_send_reschedule(0);
+#endif
 
-    g_current_task = new_task;
+    sched_account_switch(old_task, new_task);
+    TRACEPOINT(TP_SCHED_SWITCH, old_task ? old_task->pid : 0, new_task->pid);
+    // The count belongs to the task: a syscall that blocks takes its share along
+    if (old_task) old_task->preempt_count = preempt_count();
+    percpu_write(preempt_count, new_task->preempt_count);
+    rcu_note_quiescent(); // No read section survives a switch (rcu.h)
+    new_task->cpu = (uint8_t)cpu->cpu_id;
+    cpu->current = new_task;
+    percpu_write(current_task, new_task);
     new_task->state = TASK_RUNNING;
+    new_task->on_cpu = true;
+    // The zombie's stack stays in use until context_switch() leaves it, so
+    // it is only handed to the reaper from the next task's side.
+    if (old_task && old_task->state == TASK_ZOMBIE) cpu->dead_task = old_task;
+    fpu_switch_out(old_task);
     perform_context_switch(old_task, new_task);
+
+    // Resumed on whichever CPU picked us; that CPU may have a zombie to pass on.
+    reaper_flush_dead_task(this_sched_cpu());
 }
 
 
 //============================================================================
 // Public API Functions (Corrected format specifiers)
 //============================================================================
-int scheduler_add_task(pcb_t *pcb) {
-    KERNEL_ASSERT(pcb && pcb->pid != IDLE_TASK_PID && pcb->page_directory_phys &&
-                  pcb->kernel_stack_vaddr_top && pcb->user_stack_top &&
-                  pcb->entry_point && pcb->kernel_esp_for_switch, "Invalid PCB for add_task");
-
-    tcb_t *new_task = (tcb_t *)kmalloc(sizeof(tcb_t));
-    if (!new_task) { SCHED_ERROR("kmalloc TCB failed for PID %lu", pcb->pid); return SCHED_ERR_NOMEM; }
-    memset(new_task, 0, sizeof(tcb_t));
-    new_task->process = pcb;
-    new_task->pid     = pcb->pid;
+/**
+ * @brief Gives @p new_task (esp, has_run and priority already set) a CPU and
+ * time slice, lists it and makes it runnable.
+ */
+static void scheduler_launch_task(tcb_t *new_task) {
     new_task->state   = TASK_READY;
     new_task->in_run_queue = false;
-    new_task->has_run = false;
-    new_task->esp     = (uint32_t*)pcb->kernel_esp_for_switch;
-    new_task->priority = SCHED_DEFAULT_PRIORITY;
+    new_task->cpu     = (uint8_t)find_least_loaded_cpu()->cpu_id;
     KERNEL_ASSERT(new_task->priority < SCHED_PRIORITY_LEVELS, "Bad default prio");
     new_task->time_slice_ticks = MS_TO_TICKS(g_priority_time_slices_ms[new_task->priority]);
     new_task->ticks_remaining = new_task->time_slice_ticks;
+#if SCHED_CLASS_FAIR
+    // Start level with the target CPU's timeline rather than at zero.
+    new_task->vruntime = task_queue(new_task)->min_vruntime;
+#endif
+
 
     uintptr_t all_tasks_irq_flags = spinlock_acquire_irqsave(&g_all_tasks_lock);
-    new_task->all_tasks_next = g_all_tasks_head;
-    g_all_tasks_head = new_task;
+    all_tasks_insert_locked(new_task);
     spinlock_release_irqrestore(&g_all_tasks_lock, all_tasks_irq_flags);
 
-    run_queue_t *queue = &g_run_queues[new_task->priority];
+    run_queue_t *queue = task_queue(new_task);
     uintptr_t queue_irq_flags = spinlock_acquire_irqsave(&queue->lock);
     if (!enqueue_task_locked(new_task)) {
         SCHED_ERROR("Failed to enqueue newly created task PID %lu!", new_task->pid);
     }
     spinlock_release_irqrestore(&queue->lock, queue_irq_flags);
+    sched_kick_remote(new_task);
+
+    SCHED_INFO("Added task PID %lu (Prio %u, Slice %lu ticks, CPU %u)",
+                 new_task->pid, new_task->priority, new_task->time_slice_ticks, new_task->cpu);
+}
+
+int scheduler_add_task(pcb_t *pcb) {
+    KERNEL_ASSERT(pcb && pcb->pid != IDLE_TASK_PID && pcb->page_directory_phys &&
+                  pcb->kernel_stack_vaddr_top && pcb->user_stack_top &&
+                  pcb->entry_point && pcb->kernel_esp_for_switch, "Invalid PCB for add_task");
 
-    SCHED_INFO("Added task PID %lu (Prio %u, Slice %lu ticks)",
-                 new_task->pid, new_task->priority, new_task->time_slice_ticks);
+    tcb_t *new_task = (tcb_t *)slab_alloc(g_tcb_cache);
+    if (!new_task) { SCHED_ERROR("TCB allocation failed for PID %lu", pcb->pid); return SCHED_ERR_NOMEM; }
+    memset(new_task, 0, sizeof(tcb_t));
+    new_task->process = pcb;
+    new_task->pid     = pcb->pid;
+    // Switched to like any other task: context_switch() returns into
+    // user_first_entry, which IRETs through prepare_initial_kernel_stack()'s frame.
+    new_task->has_run = true;
+    new_task->esp     = kthread_build_initial_stack(pcb->kernel_esp_for_switch, user_first_entry);
+    new_task->priority = SCHED_DEFAULT_PRIORITY;
+    pcb->nr_threads = 1;
+    scheduler_launch_task(new_task);
+    return SCHED_OK;
+}
+
+int scheduler_add_forked_task(pcb_t *pcb) {
+    KERNEL_ASSERT(pcb && pcb->pid != IDLE_TASK_PID && pcb->page_directory_phys &&
+                  pcb->kernel_esp_for_switch, "Invalid PCB for add_forked_task");
+
+    tcb_t *new_task = (tcb_t *)slab_alloc(g_tcb_cache);
+    if (!new_task) { SCHED_ERROR("TCB allocation failed for PID %lu", pcb->pid); return SCHED_ERR_NOMEM; }
+    memset(new_task, 0, sizeof(tcb_t));
+    new_task->process = pcb;
+    new_task->pid     = pcb->pid;
+    // Not a first run: context_switch() returns into fork_child_return, which
+    // unwinds the copied syscall frame below it just like the syscall stub.
+    new_task->has_run = true;
+    new_task->esp     = kthread_build_initial_stack(pcb->kernel_esp_for_switch, fork_child_return);
+    tcb_t *parent = get_current_task();
+    new_task->priority = parent ? parent->priority : SCHED_DEFAULT_PRIORITY;
+    pcb->nr_threads = 1;
+    scheduler_launch_task(new_task);
+    return SCHED_OK;
+}
+
+int scheduler_add_thread(pcb_t *pcb, uint32_t tid, uint32_t *kstack_top, uint32_t frame_esp) {
+    KERNEL_ASSERT(pcb && pcb->page_directory_phys && kstack_top && frame_esp, "Invalid arguments for add_thread");
+
+    tcb_t *new_task = (tcb_t *)slab_alloc(g_tcb_cache);
+    if (!new_task) { SCHED_ERROR("TCB allocation failed for TID %lu", tid); return SCHED_ERR_NOMEM; }
+    memset(new_task, 0, sizeof(tcb_t));
+    new_task->process = pcb;
+    new_task->pid     = tid;
+    new_task->kernel_stack_top = kstack_top;
+    // Entered like a forked child: fork_child_return unwinds the frame.
+    new_task->has_run = true;
+    new_task->esp     = kthread_build_initial_stack(frame_esp, fork_child_return);
+    tcb_t *creator = get_current_task();
+    new_task->priority = creator ? creator->priority : SCHED_DEFAULT_PRIORITY;
+    scheduler_launch_task(new_task);
     return SCHED_OK;
 }
 
+tcb_t *kthread_create(void (*fn)(void *), void *arg, uint8_t priority) {
+    KERNEL_ASSERT(fn != NULL && priority < SCHED_IDLE_PRIORITY, "Bad kernel thread arguments");
+
+    pcb_t *pcb = (pcb_t *)kmalloc(sizeof(pcb_t));
+    uint32_t *stack_top = kstack_alloc();
+    tcb_t *new_task = (tcb_t *)slab_alloc(g_tcb_cache);
+    if (!pcb || !stack_top || !new_task) {
+        SCHED_ERROR("Kernel thread allocation failed");
+        if (pcb) kfree(pcb);
+        kstack_free(stack_top);
+        if (new_task) slab_free(g_tcb_cache, new_task);
+        return NULL;
+    }
+
+    memset(pcb, 0, sizeof(pcb_t));
+    uintptr_t pid_irq_flags = spinlock_acquire_irqsave(&g_all_tasks_lock);
+    pcb->pid = g_next_kthread_pid--;
+    spinlock_release_irqrestore(&g_all_tasks_lock, pid_irq_flags);
+    pcb->page_directory_phys = (uint32_t*)g_kernel_page_directory_phys;
+    pcb->entry_point = (uintptr_t)fn;
+    pcb->kernel_stack_vaddr_top = stack_top;
+
+    // fn(arg) is entered by context_switch()'s RET, so lay out a cdecl call
+    // frame above it: the argument, then kthread_exit as return address.
+    uint32_t *frame = pcb->kernel_stack_vaddr_top;
+    *(--frame) = (uint32_t)(uintptr_t)arg;
+    *(--frame) = (uint32_t)(uintptr_t)kthread_exit;
+
+    memset(new_task, 0, sizeof(tcb_t));
+    new_task->process = pcb;
+    new_task->pid     = pcb->pid;
+    new_task->kernel_stack_top = stack_top; // Freed with the TCB, not the placeholder PCB
+    new_task->has_run = true;   // Resumed through context_switch, not jump_to_user_mode
+    new_task->kernel_thread = true;
+    new_task->priority = priority;
+    new_task->esp     = kthread_build_initial_stack((uintptr_t)frame, (void (*)(void))fn);
+    scheduler_launch_task(new_task);
+    return new_task;
+}
+
+void preempt_schedule(void) {
+    if (!g_scheduler_ready) return;
+    clear_need_resched();
+    schedule();
+}
+
+void kthread_exit(void) {
+    remove_current_task_with_code(0);
+    for (;;) { } // Not reached
+}
+
 void yield(void) {
     uint32_t eflags;
     asm volatile("pushf; pop %0; cli" : "=r"(eflags));
-    SCHED_TRACE("yield() called by PID %lu", g_current_task ? g_current_task->pid : (uint32_t)-1);
+    SCHED_TRACE("yield() called by PID %lu", get_current_task() ? get_current_task()->pid : (uint32_t)-1);
+    tcb_t *current = get_current_task();
+    if (current) current->yielded = true;
     schedule();
     if (eflags & 0x200) asm volatile("sti");
 }
@@ -715,12 +1544,12 @@ void sleep_ms(uint32_t ms) {
     uint32_t ticks_to_wait = MS_TO_TICKS(ms);
     if (ticks_to_wait == 0 && ms > 0) ticks_to_wait = 1;
     uint32_t current_ticks = scheduler_get_ticks();
-    uint32_t wakeup_target;
-    if (ticks_to_wait > (UINT32_MAX - current_ticks)) { wakeup_target = UINT32_MAX; SCHED_WARN("Sleep duration %lu ms results in tick overflow.", ms); }
-    else { wakeup_target = current_ticks + ticks_to_wait; }
+    // Wakeup ticks compare wrap-safely, so only the distance must fit in 31 bits.
+    if (ticks_to_wait > (uint32_t)INT32_MAX) { ticks_to_wait = (uint32_t)INT32_MAX; SCHED_WARN("Sleep duration %lu ms clamped to max tick distance.", ms); }
+    uint32_t wakeup_target = current_ticks + ticks_to_wait;
 
     asm volatile("cli");
-    tcb_t *current = (tcb_t*)g_current_task;
+    tcb_t *current = get_current_task();
     KERNEL_ASSERT(current && current->pid != IDLE_TASK_PID && (current->state == TASK_RUNNING || current->state == TASK_READY), "Invalid task state for sleep_ms");
 
     current->wakeup_time = wakeup_target;
@@ -728,15 +1557,16 @@ void sleep_ms(uint32_t ms) {
     current->in_run_queue = false;
     SCHED_DEBUG("Task PID %lu sleeping for %lu ms until tick %lu", current->pid, ms, current->wakeup_time);
 
-    uintptr_t sleep_irq_flags = spinlock_acquire_irqsave(&g_sleep_queue.lock);
+    uintptr_t sleep_irq_flags = spinlock_acquire_irqsave(&g_sleep_wheel.lock);
     add_to_sleep_queue_locked(current);
-    spinlock_release_irqrestore(&g_sleep_queue.lock, sleep_irq_flags);
+    spinlock_release_irqrestore(&g_sleep_wheel.lock, sleep_irq_flags);
+
     schedule();
 }
 
 void remove_current_task_with_code(uint32_t code) {
     asm volatile("cli");
-    tcb_t *task_to_terminate = (tcb_t *)g_current_task;
+    tcb_t *task_to_terminate = get_current_task();
     KERNEL_ASSERT(task_to_terminate && task_to_terminate->pid != IDLE_TASK_PID, "Cannot terminate idle/null task");
 
     SCHED_INFO("Task PID %lu exiting with code %lu. Marking as ZOMBIE.", task_to_terminate->pid, code);
@@ -747,20 +1577,18 @@ void remove_current_task_with_code(uint32_t code) {
     KERNEL_PANIC_HALT("Returned from schedule() after terminating task!");
 }
 
-volatile tcb_t* get_current_task_volatile(void) { return g_current_task; }
-tcb_t* get_current_task(void) { return (tcb_t *)g_current_task; }
-
 //============================================================================
 // Debug Helper Functions
 //============================================================================
 void check_idle_task_stack_integrity(const char *checkpoint) {
-    if (!g_idle_task_tcb.esp) return;
+    sched_cpu_t *cpu = this_sched_cpu();
+    if (!cpu->idle_tcb.esp) return;
     
-    uint32_t *stack_ptr = (uint32_t*)g_idle_task_tcb.esp;
+    uint32_t *stack_ptr = (uint32_t*)cpu->idle_tcb.esp;
     
     // Check if ESP is within valid range
-    uintptr_t stack_base = (uintptr_t)g_idle_task_pcb.kernel_stack_vaddr_top - PROCESS_KSTACK_SIZE;
-    uintptr_t stack_top = (uintptr_t)g_idle_task_pcb.kernel_stack_vaddr_top;
+    uintptr_t stack_base = (uintptr_t)cpu->idle_pcb.kernel_stack_vaddr_top - PROCESS_KSTACK_SIZE;
+    uintptr_t stack_top = (uintptr_t)cpu->idle_pcb.kernel_stack_vaddr_top;
     
     if ((uintptr_t)stack_ptr < stack_base || (uintptr_t)stack_ptr >= stack_top) {
         serial_printf("[Stack Check] %s: Idle ESP %p out of range [%p-%p)\n", 
@@ -770,23 +1598,24 @@ void check_idle_task_stack_integrity(const char *checkpoint) {
     
     // Check segment registers at expected positions
     bool corrupted = false;
+    // Slots follow context_switch's pop order: GS, FS, ES, DS.
     if (stack_ptr[9] != KERNEL_DATA_SELECTOR) {
-        serial_printf("[Stack Check] %s: Idle DS corrupted: 0x%x (expect 0x10)\n", 
+        serial_printf("[Stack Check] %s: Idle GS corrupted: 0x%x (expect 0x10)\n", 
                       checkpoint, stack_ptr[9]);
         corrupted = true;
     }
-    if (stack_ptr[10] != KERNEL_DATA_SELECTOR) {
-        serial_printf("[Stack Check] %s: Idle ES corrupted: 0x%x (expect 0x10)\n", 
+    if (stack_ptr[10] != GDT_PERCPU_SELECTOR) {
+        serial_printf("[Stack Check] %s: Idle FS corrupted: 0x%x (expect 0x30)\n", 
                       checkpoint, stack_ptr[10]);
         corrupted = true;
     }
     if (stack_ptr[11] != KERNEL_DATA_SELECTOR) {
-        serial_printf("[Stack Check] %s: Idle FS corrupted: 0x%x (expect 0x10)\n", 
+        serial_printf("[Stack Check] %s: Idle ES corrupted: 0x%x (expect 0x10)\n", 
                       checkpoint, stack_ptr[11]);
         corrupted = true;
     }
     if (stack_ptr[12] != KERNEL_DATA_SELECTOR) {
-        serial_printf("[Stack Check] %s: Idle GS corrupted: 0x%x (expect 0x10)\n", 
+        serial_printf("[Stack Check] %s: Idle DS corrupted: 0x%x (expect 0x10)\n", 
                       checkpoint, stack_ptr[12]);
         corrupted = true;
     }
@@ -802,82 +1631,178 @@ void check_idle_task_stack_integrity(const char *checkpoint) {
 void scheduler_start(void) {
     terminal_printf("Scheduler starting...\n");
     g_scheduler_ready = true;
-    g_need_reschedule = false; // Clear any pending reschedule from init
+    clear_need_resched(); // Clear any pending reschedule from init
 
-    tcb_t *first_task = scheduler_select_next_task();
+    sched_cpu_t *cpu = this_sched_cpu();
+    KERNEL_ASSERT(cpu->online, "scheduler_start: CPU not initialized for scheduling");
+    tcb_t *first_task = scheduler_select_next_task(cpu);
     KERNEL_ASSERT(first_task != NULL, "scheduler_start: No task to run!");
 
-    g_current_task = first_task;
-    g_current_task->state = TASK_RUNNING;
-    g_current_task->has_run = true; // Mark as having run
+    cpu->current = first_task;
+    percpu_write(current_task, first_task);
+    first_task->cpu = (uint8_t)cpu->cpu_id;
+    first_task->state = TASK_RUNNING;
+    first_task->on_cpu = true;
+    first_task->has_run = true; // Mark as having run
 
-    terminal_printf("  [Scheduler Start] First task selected: PID %lu (ESP=%p)\n",
-                     (unsigned long)g_current_task->pid, g_current_task->esp);
+    terminal_printf("  [Scheduler Start] CPU %lu first task selected: PID %lu (ESP=%p)\n",
+                     (unsigned long)cpu->cpu_id, (unsigned long)first_task->pid, first_task->esp);
 
     // Set TSS ESP0 for the first task.
     // Note: For the idle task, kernel_stack_vaddr_top is set in scheduler_init_idle_task.
     // For user tasks, it's set in allocate_kernel_stack.
-    KERNEL_ASSERT(g_current_task->process && g_current_task->process->kernel_stack_vaddr_top,
+    KERNEL_ASSERT(first_task->process && first_task->process->kernel_stack_vaddr_top,
                   "First task's PCB or kernel_stack_vaddr_top is NULL");
-    tss_set_kernel_stack((uint32_t)g_current_task->process->kernel_stack_vaddr_top);
+    tss_set_kernel_stack((uint32_t)first_task->process->kernel_stack_vaddr_top);
+    percpu_write(active_pgd, (uintptr_t)first_task->process->page_directory_phys);
 
-    if (g_current_task->pid != IDLE_TASK_PID) {
-        // First task is a user process
-        terminal_printf("  [Scheduler Start] Jumping to user mode for PID %lu.\n", (unsigned long)g_current_task->pid);
-        jump_to_user_mode(g_current_task->esp, g_current_task->process->page_directory_phys);
-    } else {
-        // First task is the Idle Task. Its ESP points to a kernel stack frame.
-        // We effectively switch from the current "bootstrap" kernel context to the idle task's context.
-        // The context_switch function needs to handle `old_esp_ptr == NULL`.
-        terminal_printf("  [Scheduler Start] Context switching to Idle Task (PID %lu).\n", (unsigned long)g_current_task->pid);
-        context_switch(NULL, g_current_task->esp, g_current_task->process->page_directory_phys);
-    }
+    // Every task's ESP points to a context_switch() frame, user processes'
+    // included (user_first_entry). The bootstrap context is not saved.
+    terminal_printf("  [Scheduler Start] Context switching to PID %lu.\n", (unsigned long)first_task->pid);
+    context_switch(NULL, first_task->esp, first_task->process->page_directory_phys, NULL);
 
     // These lines should not be reached if the switch/jump is successful.
     KERNEL_PANIC_HALT("scheduler_start: Initial task switch/jump failed to transfer control!");
 }
 
+void scheduler_start_cpu(void) {
+    asm volatile("cli");
+    sched_cpu_t *cpu = this_sched_cpu();
+    KERNEL_ASSERT(cpu->online && g_scheduler_ready, "scheduler_start_cpu: CPU not ready for scheduling");
+
+    // Usually the idle task, unless tasks were already placed on this CPU.
+    tcb_t *first_task = scheduler_select_next_task(cpu);
+    KERNEL_ASSERT(first_task != NULL && first_task->process && first_task->process->kernel_stack_vaddr_top,
+                  "scheduler_start_cpu: No valid task to run!");
+
+    sched_account_switch(NULL, first_task);
+    cpu->current = first_task;
+    percpu_write(current_task, first_task);
+    first_task->cpu = (uint8_t)cpu->cpu_id;
+    first_task->state = TASK_RUNNING;
+    first_task->on_cpu = true;
+    SCHED_INFO("CPU %lu starting with PID %lu", (unsigned long)cpu->cpu_id, (unsigned long)first_task->pid);
+
+    tss_set_kernel_stack((uint32_t)first_task->process->kernel_stack_vaddr_top);
+    percpu_write(active_pgd, (uintptr_t)first_task->process->page_directory_phys);
+    first_task->has_run = true;
+    // The boot stack is abandoned here; it is only a few KB per AP.
+    context_switch(NULL, first_task->esp, first_task->process->page_directory_phys, NULL);
+    KERNEL_PANIC_HALT("scheduler_start_cpu: Initial task switch failed to transfer control!");
+}
+
 void scheduler_init(void) {
     terminal_printf("Initializing scheduler...\n");
-    memset(g_run_queues, 0, sizeof(g_run_queues));
-    g_current_task = NULL;
+    memset(g_sched_cpus, 0, sizeof(g_sched_cpus));
+    init_time_slices();
+
     g_tick_count = 0;
     g_scheduler_ready = false;
-    g_need_reschedule = false;
+    clear_need_resched();
     g_all_tasks_head = NULL;
-    spinlock_init(&g_all_tasks_lock);
-    for (int i = 0; i < SCHED_PRIORITY_LEVELS; i++) init_run_queue(&g_run_queues[i]);
+    memset(g_pid_hash, 0, sizeof(g_pid_hash));
+    spinlock_init_named(&g_all_tasks_lock, "all_tasks");
+    g_tcb_cache = slab_create("tcb_t", sizeof(tcb_t), 0, 0, NULL, NULL);
+    if (!g_tcb_cache) KERNEL_PANIC_HALT("Failed to create TCB cache");
+    for (uint32_t c = 0; c < MAX_CPUS; c++) {
+        g_sched_cpus[c].cpu_id = c;
+        for (int i = 0; i < SCHED_PRIORITY_LEVELS; i++) init_run_queue(&g_sched_cpus[c].queues[i]);
+    }
     init_sleep_queue();
+    softirq_register(SOFTIRQ_SCHED, scheduler_softirq);
+
+    // Only the bootstrap CPU schedules for now; APs join via scheduler_init_cpu().
+    scheduler_init_cpu((uint32_t)(this_sched_cpu() - g_sched_cpus));
+    scheduler_init_reaper();
 
-    scheduler_init_idle_task();
+    // Do NOT set cpu->current = &cpu->idle_tcb here.
+    // It will be set properly in scheduler_start() when we do the first context switch.
 
-    run_queue_t *idle_queue = &g_run_queues[g_idle_task_tcb.priority];
+    terminal_printf("Scheduler initialized\n");
+}
+
+void scheduler_init_cpu(uint32_t cpu_index) {
+    KERNEL_ASSERT(cpu_index < MAX_CPUS, "scheduler_init_cpu: CPU index out of range");
+    sched_cpu_t *cpu = &g_sched_cpus[cpu_index];
+    if (cpu->online) return;
+
+    scheduler_init_idle_task(cpu);
+
+    run_queue_t *idle_queue = &cpu->queues[cpu->idle_tcb.priority];
     uintptr_t queue_irq_flags = spinlock_acquire_irqsave(&idle_queue->lock);
-    if (!enqueue_task_locked(&g_idle_task_tcb)) {
+    if (!enqueue_task_locked(&cpu->idle_tcb)) {
         KERNEL_PANIC_HALT("Failed to enqueue idle task");
     }
     spinlock_release_irqrestore(&idle_queue->lock, queue_irq_flags);
 
-    // Do NOT set g_current_task = &g_idle_task_tcb here.
-    // It will be set properly in scheduler_start() when we do the first context switch.
+    cpu->last_balance_tick = g_tick_count;
+    cpu->online = true;
+    SCHED_INFO("CPU %lu online for scheduling", (unsigned long)cpu_index);
+}
 
-    terminal_printf("Scheduler initialized\n");
+/**
+ * @brief Whether a just-woken task should take this CPU right away.
+ * Only tasks queued on this CPU count; remote CPUs pick theirs up on their
+ * next tick.
+ */
+static bool wakeup_preempts_current(tcb_t *woken) {
+    sched_cpu_t *cpu = this_sched_cpu();
+    if (woken->cpu != cpu->cpu_id) return false;
+    tcb_t *curr = (tcb_t *)cpu->current;
+    if (!curr || curr->pid == IDLE_TASK_PID) return true;
+#if SCHED_CLASS_FAIR
+    // The fair queue outranks the reaper's; vruntimes only compare within it
+    if (!task_is_fair(woken)) return false;
+    if (!task_is_fair(curr)) return true;
+    return vruntime_before(woken->vruntime, curr->vruntime);
+#else
+    return woken->priority < curr->priority;
+#endif
+}
+
+void scheduler_set_task_priority(tcb_t *task, uint8_t priority) {
+    if (!task || task->pid == IDLE_TASK_PID) return;
+    if (priority >= SCHED_PRIORITY_LEVELS) priority = SCHED_PRIORITY_LEVELS - 1;
+    if (task->priority == priority) return;
+
+    uintptr_t irq_flags = local_irq_save();
+    run_queue_t *old_queue = task_queue(task);
+    uintptr_t queue_irq_flags = spinlock_acquire_irqsave(&old_queue->lock);
+    bool requeue = task->in_run_queue && dequeue_task_locked(task);
+    task->priority = priority;
+    spinlock_release_irqrestore(&old_queue->lock, queue_irq_flags);
+
+    if (requeue) {
+        run_queue_t *new_queue = task_queue(task);
+        queue_irq_flags = spinlock_acquire_irqsave(&new_queue->lock);
+        if (!enqueue_task_locked(task)) {
+            SCHED_ERROR("Failed to requeue task PID %lu at Prio %u", task->pid, priority);
+        }
+        spinlock_release_irqrestore(&new_queue->lock, queue_irq_flags);
+        if (wakeup_preempts_current(task)) set_need_resched();
+    }
+    SCHED_DEBUG("Task PID %lu priority set to %u", task->pid, priority);
+    local_irq_restore(irq_flags);
 }
 
 void scheduler_unblock_task(tcb_t *task) {
     if (!task) { SCHED_WARN("Called with NULL task."); return; }
 
     KERNEL_ASSERT(task->priority < SCHED_PRIORITY_LEVELS, "Invalid task priority for unblock");
-    run_queue_t *queue = &g_run_queues[task->priority];
+    run_queue_t *queue = task_queue(task);
+
     uintptr_t queue_irq_flags = spinlock_acquire_irqsave(&queue->lock);
 
     if (task->state == TASK_BLOCKED) {
         task->state = TASK_READY;
+        task->woken = true;
         SCHED_DEBUG("Task PID %lu unblocked, new state: READY.", task->pid);
         if (!enqueue_task_locked(task)) {
              SCHED_ERROR("Failed to enqueue unblocked task PID %lu (already enqueued?)", task->pid);
         } else {
-             g_need_reschedule = true;
+             TRACEPOINT(TP_SCHED_WAKEUP, task->pid, 0);
+             if (wakeup_preempts_current(task)) set_need_resched();
+             sched_kick_remote(task);
              SCHED_DEBUG("Task PID %lu enqueued into run queue Prio %u.", task->pid, task->priority);
         }
     } else {
@@ -885,4 +1810,106 @@ void scheduler_unblock_task(tcb_t *task) {
     }
 
     spinlock_release_irqrestore(&queue->lock, queue_irq_flags);
-}
\ No newline at end of file
+}
+//============================================================================
+// Statistics
+//============================================================================
+/** @brief Sums the per-CPU switch totals. A CPU switching meanwhile may be half counted. */
+static void sched_totals_sum(sched_task_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < MAX_CPUS; i++) {
+        const sched_task_stats_t *t = &g_sched_cpus[i].totals;
+        out->nr_switches += t->nr_switches;
+        out->nr_voluntary += t->nr_voluntary;
+        out->nr_involuntary += t->nr_involuntary;
+        out->nr_wakeups += t->nr_wakeups;
+        out->wait_cycles += t->wait_cycles;
+        for (uint32_t b = 0; b < SCHED_HIST_BUCKETS; b++) {
+            out->wakeup_hist[b] += t->wakeup_hist[b];
+            out->wait_hist[b] += t->wait_hist[b];
+        }
+    }
+}
+
+void debug_scheduler_stats(uint32_t *out_task_count, uint32_t *out_switches) {
+    uint32_t count = 0;
+    uintptr_t all_tasks_irq_flags = spinlock_acquire_irqsave(&g_all_tasks_lock);
+    for (tcb_t *t = g_all_tasks_head; t; t = t->all_tasks_next) count++;
+    spinlock_release_irqrestore(&g_all_tasks_lock, all_tasks_irq_flags);
+
+    if (out_task_count) *out_task_count = count;
+    if (out_switches) {
+        uint32_t switches = 0;
+        for (int i = 0; i < MAX_CPUS; i++) switches += g_sched_cpus[i].totals.nr_switches;
+        *out_switches = switches;
+    }
+}
+
+void scheduler_for_each_process(void (*fn)(pcb_t *proc, void *arg), void *arg) {
+    uintptr_t all_tasks_irq_flags = spinlock_acquire_irqsave(&g_all_tasks_lock);
+    for (tcb_t *t = g_all_tasks_head; t; t = t->all_tasks_next) {
+        if (t->process && t->process->mm && t->pid == t->process->pid) fn(t->process, arg);
+    }
+    spinlock_release_irqrestore(&g_all_tasks_lock, all_tasks_irq_flags);
+}
+
+int scheduler_get_task_stats(uint32_t pid, sched_task_stats_t *out) {
+    KERNEL_ASSERT(out != NULL, "scheduler_get_task_stats: NULL output");
+    int result = -1;
+
+    uintptr_t all_tasks_irq_flags = spinlock_acquire_irqsave(&g_all_tasks_lock);
+    if (pid == IDLE_TASK_PID) {
+        sched_totals_sum(out);
+        for (tcb_t *t = g_all_tasks_head; t; t = t->all_tasks_next) {
+            if (t->pid == IDLE_TASK_PID) continue;
+            out->runtime_ticks += t->runtime_ticks;
+            out->run_cycles += t->stats.run_cycles;
+        }
+        result = 0;
+    } else {
+        tcb_t *t = find_task_locked(pid);
+        if (t) {
+            *out = t->stats;
+            out->runtime_ticks = t->runtime_ticks;
+            // Include the slice in progress for a task that is on a CPU now.
+            if (t->state == TASK_RUNNING) out->run_cycles += read_tsc() - t->run_start_tsc;
+            result = 0;
+        }
+    }
+    spinlock_release_irqrestore(&g_all_tasks_lock, all_tasks_irq_flags);
+
+    out->pid = pid;
+    return result;
+}
+
+static void dump_histogram(const char *name, const uint32_t *hist) {
+    serial_printf("  %s (log2 cycles: count):", name);
+    for (uint32_t b = 0; b < SCHED_HIST_BUCKETS; b++) {
+        if (hist[b]) serial_printf(" %lu:%lu", (unsigned long)b, (unsigned long)hist[b]);
+    }
+    serial_printf("\n");
+}
+
+void scheduler_dump_stats(void) {
+    SCHED_INFO("--- Scheduler statistics ---");
+    uintptr_t all_tasks_irq_flags = spinlock_acquire_irqsave(&g_all_tasks_lock);
+    for (tcb_t *t = g_all_tasks_head; t; t = t->all_tasks_next) {
+        // Cycle totals are printed in units of 1024 to stay within %lu.
+        serial_printf("  PID %lu CPU %u prio %u: switches=%lu vol=%lu invol=%lu wakeups=%lu ticks=%lu run=%luK wait=%luK cycles\n",
+                      (unsigned long)t->pid, t->cpu, t->priority,
+                      (unsigned long)t->stats.nr_switches, (unsigned long)t->stats.nr_voluntary,
+                      (unsigned long)t->stats.nr_involuntary, (unsigned long)t->stats.nr_wakeups,
+                      (unsigned long)t->runtime_ticks,
+                      (unsigned long)(t->stats.run_cycles >> 10), (unsigned long)(t->stats.wait_cycles >> 10));
+    }
+    spinlock_release_irqrestore(&g_all_tasks_lock, all_tasks_irq_flags);
+
+    sched_task_stats_t totals;
+    sched_totals_sum(&totals);
+    serial_printf("  All tasks: switches=%lu vol=%lu invol=%lu wakeups=%lu wait=%luK cycles\n",
+                  (unsigned long)totals.nr_switches, (unsigned long)totals.nr_voluntary,
+                  (unsigned long)totals.nr_involuntary, (unsigned long)totals.nr_wakeups,
+                  (unsigned long)(totals.wait_cycles >> 10));
+    dump_histogram("Wakeup latency", totals.wakeup_hist);
+    dump_histogram("Run queue wait", totals.wait_hist);
+}
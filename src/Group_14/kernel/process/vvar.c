@@ -0,0 +1,88 @@
+/**
+ * @file vvar.c
+ * @brief The shared and per-process vvar pages (see vvar.h).
+ */
+
+#include <kernel/process/vvar.h>
+#include <kernel/process/process.h>
+#include <kernel/memory/mm.h>
+#include <kernel/memory/paging.h>
+#include <kernel/memory/frame.h>
+#include <kernel/drivers/timer/clock.h>
+#include <kernel/drivers/timer/pit.h>
+#include <kernel/fs/vfs/fs_errno.h>
+#include <kernel/lib/assert.h>
+#include <kernel/drivers/display/serial.h>
+
+#define VVAR_INFO(fmt, ...)  serial_printf("[VVar INFO ] " fmt "\n", ##__VA_ARGS__)
+
+// User, read-only, never executable
+#define VVAR_PAGE_PROT  (PAGE_PRESENT | PAGE_USER | (g_nx_supported ? PAGE_NX_BIT : 0))
+
+_Static_assert(VVAR_BASE_VIRT + (VVAR_PAGES + 1) * PAGE_SIZE <= USER_STACK_BOTTOM_VIRT,
+               "vvar pages (plus a guard page) must sit below the user stack");
+_Static_assert(sizeof(vvar_data_t) <= PAGE_SIZE && sizeof(vvar_proc_t) <= PAGE_SIZE,
+               "vvar structures must fit in a page");
+
+static uintptr_t    s_data_frame = 0;
+static vvar_data_t *s_data = NULL;   // Direct-map view of s_data_frame
+
+void vvar_init(void) {
+    uintptr_t frame = frame_alloc_zeroed();
+    if (!frame || !paging_phys_is_direct(frame)) {
+        KERNEL_PANIC_HALT("vvar_init: no lowmem frame for the shared page");
+    }
+    vvar_data_t *data = (vvar_data_t *)paging_phys_to_virt(frame);
+    data->version = VVAR_VERSION;
+    data->tick_hz = TARGET_FREQUENCY;
+    data->tsc_khz = clock_tsc_khz();
+    clock_get_tsc_params(&data->tsc_mult, &data->tsc_shift, &data->tsc_base);
+    data->ticks = 0;
+
+    s_data_frame = frame;
+    s_data = data;
+    VVAR_INFO("Shared page at phys %#lx, mapped at %#lx in every process.",
+              (unsigned long)frame, (unsigned long)VVAR_DATA_VIRT);
+}
+
+void vvar_update_ticks(uint32_t ticks) {
+    if (s_data) s_data->ticks = ticks; // The PIT runs before vvar_init()
+}
+
+/** @brief Maps a new private page at VVAR_PROC_VIRT describing @p proc. */
+static int map_proc_page(pcb_t *proc) {
+    uintptr_t frame = frame_alloc_zeroed();
+    if (!frame) return -ENOMEM;
+    vvar_proc_t *page = (vvar_proc_t *)kmap_atomic(frame);
+    page->pid = proc->pid;
+    page->ppid = proc->ppid;
+    kunmap_atomic(page);
+
+    if (paging_map_single_4k(proc->page_directory_phys, VVAR_PROC_VIRT, frame, VVAR_PAGE_PROT) != 0) {
+        put_frame(frame);
+        return -ENOMEM;
+    }
+    return 0; // The PTE owns the reference now; the VMA teardown drops it
+}
+
+int vvar_map_process(pcb_t *proc) {
+    KERNEL_ASSERT(proc && proc->mm && proc->page_directory_phys, "vvar_map_process: no address space");
+    if (!insert_vma(proc->mm, VVAR_BASE_VIRT, VVAR_BASE_VIRT + VVAR_PAGES * PAGE_SIZE,
+                    VM_READ | VM_USER, VVAR_PAGE_PROT, NULL, 0)) {
+        return -ENOMEM;
+    }
+    frame_incref(s_data_frame);
+    if (paging_map_single_4k(proc->page_directory_phys, VVAR_DATA_VIRT, s_data_frame, VVAR_PAGE_PROT) != 0) {
+        put_frame(s_data_frame);
+        return -ENOMEM;
+    }
+    return map_proc_page(proc);
+}
+
+int vvar_fork_process(pcb_t *child) {
+    vma_struct_t *vma = find_vma(child->mm, VVAR_PROC_VIRT);
+    if (!vma || vma->vm_start > VVAR_PROC_VIRT) return 0; // Unmapped by the parent
+    // The clone shares the parent's private page (with a reference of its own)
+    if (paging_unmap_range(child->page_directory_phys, VVAR_PROC_VIRT, PAGE_SIZE) != 0) return -ENOMEM;
+    return map_proc_page(child);
+}
@@ -0,0 +1,112 @@
+/**
+ * @file futex.c
+ * @brief Futex wait/wake over hashed wait queues (see futex.h).
+ *
+ * Keys that hash alike share a bucket; wake_up_key() picks out the
+ * waiters whose tcb_t.wait_key_space/wait_key match, so they never steal each other's
+ * wakeups.
+ */
+
+#include <kernel/sync/futex.h>
+#include <kernel/sync/wait_queue.h>
+#include <kernel/process/process.h>
+#include <kernel/memory/paging.h>
+#include <kernel/memory/mm.h>
+#include <kernel/memory/frame.h>
+#include <kernel/memory/uaccess.h>
+#include <kernel/fs/vfs/fs_errno.h>
+
+static wait_queue_t s_futex_buckets[FUTEX_HASH_BUCKETS];
+
+void futex_init(void) {
+    for (uint32_t i = 0; i < FUTEX_HASH_BUCKETS; i++) wait_queue_init(&s_futex_buckets[i]);
+}
+
+/**
+ * Where a futex word lives. A private mapping's word is named by its
+ * (mm, address): a COW break after fork() moves it to a new frame, and the
+ * wake that follows must still find the waiters. Only a VM_SHARED word is
+ * named by its frame, which is what every process mapping it shares.
+ */
+typedef struct {
+    mm_struct_t *mm;     // Private: the address space; NULL for a shared word
+    uintptr_t    addr;   // Private: the user address; shared: the physical one
+    uintptr_t    frame;  // Frame holding the word, pinned until futex_put_key()
+} futex_key_t;
+
+static wait_queue_t *futex_bucket(const futex_key_t *key) {
+    uint32_t hash = ((uint32_t)(key->addr >> 2) ^ (uint32_t)(uintptr_t)key->mm) * 0x9E3779B1u; // Fibonacci hashing
+    return &s_futex_buckets[hash >> (32 - FUTEX_HASH_BITS)];
+}
+
+/**
+ * Keys the user word at @p uaddr, faulting its page in first. The frame
+ * stays pinned, so a shared key can't be reused by another page (and the
+ * word read through it) until futex_put_key().
+ */
+static int futex_get_key(uintptr_t uaddr, futex_key_t *key) {
+    if (uaddr & (sizeof(uint32_t) - 1)) return -EINVAL;
+    if (!access_ok(VERIFY_READ, (const_userptr_t)uaddr, sizeof(uint32_t))) return -EFAULT;
+    pcb_t *proc = get_current_process();
+    if (!proc || !proc->mm) return -EFAULT;
+    uint32_t vm_flags = 0;
+    key->frame = mm_pin_user_page_flags(proc->mm, uaddr, false, &vm_flags);
+    if (!key->frame) return -EFAULT;
+    if (vm_flags & VM_SHARED) {
+        key->mm = NULL;
+        key->addr = key->frame + (uaddr & (PAGE_SIZE - 1));
+    } else {
+        key->mm = proc->mm;
+        key->addr = uaddr;
+    }
+    return 0;
+}
+
+static void futex_put_key(futex_key_t *key) {
+    put_frame(key->frame);
+}
+
+int futex_wait(uintptr_t uaddr, uint32_t val) {
+    tcb_t *self = get_current_task();
+    for (;;) {
+        futex_key_t key;
+        int err = futex_get_key(uaddr, &key);
+        if (err < 0) return err;
+
+        wait_queue_t *wq = futex_bucket(&key);
+        self->wait_key_space = key.mm;
+        self->wait_key = key.addr;
+        uintptr_t flags = prepare_to_wait(wq);
+        // A private word may have moved to a new frame (COW break) since it
+        // was pinned; its writer's wake then came too early or finds us
+        // queued, so look again rather than check a stale copy.
+        if (key.mm && mm_user_page_frame(key.mm, uaddr) != key.frame) {
+            finish_wait(wq, flags);
+            self->wait_key = 0;
+            self->wait_key_space = NULL;
+            futex_put_key(&key);
+            continue;
+        }
+        // Read through the frame: interrupts are off, so no user faults here,
+        // and a waker's store is either seen now or its wake finds us queued.
+        uint8_t *page = (uint8_t *)kmap_atomic(key.frame);
+        uint32_t cur = *(volatile uint32_t *)(page + (uaddr & (PAGE_SIZE - 1)));
+        kunmap_atomic(page);
+        if (cur == val) schedule();
+        finish_wait(wq, flags);
+        self->wait_key = 0;
+        self->wait_key_space = NULL;
+        futex_put_key(&key);
+        return cur == val ? 0 : -EAGAIN;
+    }
+}
+
+int futex_wake(uintptr_t uaddr, uint32_t count) {
+    futex_key_t key;
+    int err = futex_get_key(uaddr, &key);
+    if (err < 0) return err;
+    if (count > INT32_MAX) count = INT32_MAX;
+    int woken = (int)wake_up_key(futex_bucket(&key), key.mm, key.addr, count);
+    futex_put_key(&key);
+    return woken;
+}
@@ -0,0 +1,95 @@
+/**
+ * @file mutex.c
+ * @brief Sleeping mutex with optional single-level priority inheritance.
+ */
+
+#include <kernel/sync/mutex.h>
+#include <kernel/lib/assert.h>
+
+void kmutex_init(kmutex_t *m, bool inherit) {
+    KERNEL_ASSERT(m != NULL, "kmutex_init: NULL mutex");
+    spinlock_init(&m->lock);
+    m->locked = false;
+    m->owner = NULL;
+    m->owner_priority = 0;
+    m->inherit = inherit;
+    wait_queue_init(&m->waiters);
+}
+
+/**
+ * @brief Takes the mutex if free; otherwise lends the owner our priority.
+ * Used as the wait_event() condition, so it runs after we are queued.
+ */
+static bool kmutex_acquire_or_boost(kmutex_t *m, tcb_t *self) {
+    tcb_t *boost_owner = NULL;
+
+    uintptr_t flags = spinlock_acquire_irqsave(&m->lock);
+    if (!m->locked) {
+        m->locked = true;
+        m->owner = self;
+        m->owner_priority = self ? self->priority : 0;
+        spinlock_release_irqrestore(&m->lock, flags);
+        return true;
+    }
+    if (m->inherit && self && m->owner && self->priority < m->owner->priority) {
+        boost_owner = m->owner;
+    }
+    spinlock_release_irqrestore(&m->lock, flags);
+
+    // Priority 0 is highest: pull the owner up so a middle-priority task
+    // cannot keep it (and therefore us) off the CPU.
+    if (boost_owner) scheduler_set_task_priority(boost_owner, self->priority);
+    return false;
+}
+
+bool kmutex_trylock(kmutex_t *m) {
+    tcb_t *self = g_scheduler_ready ? get_current_task() : NULL;
+
+    uintptr_t flags = spinlock_acquire_irqsave(&m->lock);
+    bool taken = !m->locked;
+    if (taken) {
+        m->locked = true;
+        m->owner = self;
+        m->owner_priority = self ? self->priority : 0;
+    }
+    spinlock_release_irqrestore(&m->lock, flags);
+    return taken;
+}
+
+void kmutex_lock(kmutex_t *m) {
+    KERNEL_ASSERT(m != NULL, "kmutex_lock: NULL mutex");
+    tcb_t *self = g_scheduler_ready ? get_current_task() : NULL;
+
+    if (!self || self->pid == IDLE_TASK_PID) {
+        // Early boot / idle context: nothing to sleep on, so spin.
+        while (!kmutex_trylock(m)) asm volatile("pause");
+        return;
+    }
+    KERNEL_ASSERT(!m->locked || m->owner != self, "kmutex_lock: recursive lock");
+
+    if (kmutex_trylock(m)) return; // Uncontended fast path
+    wait_event(&m->waiters, kmutex_acquire_or_boost(m, self));
+}
+
+void kmutex_unlock(kmutex_t *m) {
+    KERNEL_ASSERT(m != NULL, "kmutex_unlock: NULL mutex");
+    tcb_t *self = g_scheduler_ready ? get_current_task() : NULL;
+
+    uintptr_t flags = spinlock_acquire_irqsave(&m->lock);
+    KERNEL_ASSERT(m->locked && (m->owner == self || m->owner == NULL), "kmutex_unlock: caller does not own the mutex");
+    uint8_t restore_priority = m->owner_priority;
+    m->locked = false;
+    m->owner = NULL;
+    spinlock_release_irqrestore(&m->lock, flags);
+
+    // Drop any inherited boost before a waiter gets to run.
+    if (self && self->priority != restore_priority) {
+        scheduler_set_task_priority(self, restore_priority);
+    }
+    wake_up_one(&m->waiters);
+}
+
+bool kmutex_is_owner(kmutex_t *m) {
+    tcb_t *self = g_scheduler_ready ? get_current_task() : NULL;
+    return m->locked && m->owner == self;
+}
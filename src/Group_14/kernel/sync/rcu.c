@@ -0,0 +1,43 @@
+/**
+ * @file rcu.c
+ * @brief Grace-period detection for rcu.h.
+ */
+
+#include <kernel/sync/rcu.h>
+#include <kernel/cpu/get_cpu_id.h>  // MAX_CPUS
+#include <kernel/cpu/smp.h>
+#include <kernel/process/scheduler.h>
+
+/** @brief True once @p cpu passed a quiescent state since @p snap was taken. */
+static bool rcu_cpu_quiescent(uint32_t cpu, uint32_t snap) {
+    const volatile percpu_t *area = &g_percpu[cpu];
+    if (area->rcu_qs != snap) return true;
+    // The idle task never reads RCU data, and a CPU halted in it takes no
+    // ticks under tickless idle, so its counter may not move for a while.
+    const tcb_t *curr = (const tcb_t *)area->current_task;
+    return curr && curr->pid == IDLE_TASK_PID;
+}
+
+void synchronize_rcu(void) {
+    uint32_t ncpus = smp_cpu_count();
+    if (ncpus <= 1 || !g_percpu_ready) return;
+    if (ncpus > MAX_CPUS) ncpus = MAX_CPUS;
+
+    // The writer's unlinking stores must be visible before the snapshot.
+    asm volatile("lock; orl $0, (%%esp)" ::: "memory", "cc");
+
+    uint32_t self = percpu_read(cpu_id);
+    uint32_t snap[MAX_CPUS];
+    for (uint32_t cpu = 0; cpu < ncpus; cpu++) snap[cpu] = g_percpu[cpu].rcu_qs;
+
+    // Blocking is fine inside a syscall too, as long as no lock is held
+    bool can_sleep = g_scheduler_ready && (preempt_count() & PREEMPT_LOCK_MASK) == 0 &&
+                     irqs_enabled() && !percpu_read(softirq_active);
+    for (uint32_t cpu = 0; cpu < ncpus; cpu++) {
+        if (cpu == self) continue; // The caller is not in a read section
+        while (!rcu_cpu_quiescent(cpu, snap[cpu])) {
+            if (can_sleep) sleep_ms(1);
+            else asm volatile("pause" ::: "memory");
+        }
+    }
+}
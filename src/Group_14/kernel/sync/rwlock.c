@@ -0,0 +1,72 @@
+/**
+ * @file rwlock.c
+ * @brief Writer-preferring reader-writer spinlock.
+ */
+
+#include <kernel/sync/rwlock.h>
+#include <kernel/memory/tlb.h> // tlb_poll() while spinning
+#include <kernel/sync/preempt.h>
+
+/**
+ * @brief LOCK CMPXCHG on the state word.
+ * @return true if @p expected was replaced by @p desired.
+ */
+static inline bool state_cas(rwlock_t *lock, uint32_t expected, uint32_t desired) {
+    uint32_t prev;
+    asm volatile("lock cmpxchgl %2, %1"
+                 : "=a"(prev), "+m"(lock->state)
+                 : "r"(desired), "0"(expected)
+                 : "memory", "cc");
+    return prev == expected;
+}
+
+static inline void state_add(rwlock_t *lock, uint32_t delta) {
+    asm volatile("lock addl %1, %0" : "+m"(lock->state) : "ir"(delta) : "memory", "cc");
+}
+
+void rwlock_init(rwlock_t *lock) {
+    lock->state = 0;
+}
+
+uintptr_t rwlock_read_acquire_irqsave(rwlock_t *lock) {
+    preempt_disable();
+    uintptr_t flags = local_irq_save();
+    for (;;) {
+        uint32_t state = lock->state;
+        if (!(state & (RWLOCK_WRITER | RWLOCK_WRITER_WAITING)) &&
+            state_cas(lock, state, state + RWLOCK_READER)) {
+            return flags;
+        }
+        asm volatile("pause" ::: "memory");
+        tlb_poll();
+    }
+}
+
+void rwlock_read_release_irqrestore(rwlock_t *lock, uintptr_t flags) {
+    state_add(lock, (uint32_t)-RWLOCK_READER);
+    local_irq_restore(flags);
+    preempt_enable();
+}
+
+uintptr_t rwlock_write_acquire_irqsave(rwlock_t *lock) {
+    preempt_disable();
+    uintptr_t flags = local_irq_save();
+    for (;;) {
+        uint32_t state = lock->state;
+        // Free apart from a waiting flag (ours or another writer's): take it.
+        // The flag is cleared on success; other waiting writers set it again.
+        if ((state & ~RWLOCK_WRITER_WAITING) == 0) {
+            if (state_cas(lock, state, RWLOCK_WRITER)) return flags;
+        } else if (!(state & RWLOCK_WRITER_WAITING)) {
+            state_cas(lock, state, state | RWLOCK_WRITER_WAITING);
+        }
+        asm volatile("pause" ::: "memory");
+        tlb_poll();
+    }
+}
+
+void rwlock_write_release_irqrestore(rwlock_t *lock, uintptr_t flags) {
+    state_add(lock, (uint32_t)-RWLOCK_WRITER);
+    local_irq_restore(flags);
+    preempt_enable();
+}
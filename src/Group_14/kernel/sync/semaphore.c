@@ -0,0 +1,43 @@
+/**
+ * @file semaphore.c
+ * @brief Counting semaphore that sleeps on a wait queue.
+ */
+
+#include <kernel/sync/semaphore.h>
+#include <kernel/lib/assert.h>
+
+void ksem_init(ksemaphore_t *sem, int32_t initial) {
+    KERNEL_ASSERT(sem != NULL && initial >= 0, "ksem_init: invalid arguments");
+    spinlock_init(&sem->lock);
+    sem->count = initial;
+    wait_queue_init(&sem->waiters);
+}
+
+bool ksem_try_down(ksemaphore_t *sem) {
+    uintptr_t flags = spinlock_acquire_irqsave(&sem->lock);
+    bool taken = sem->count > 0;
+    if (taken) sem->count--;
+    spinlock_release_irqrestore(&sem->lock, flags);
+    return taken;
+}
+
+void ksem_down(ksemaphore_t *sem) {
+    KERNEL_ASSERT(sem != NULL, "ksem_down: NULL semaphore");
+    if (ksem_try_down(sem)) return;
+
+    tcb_t *self = g_scheduler_ready ? get_current_task() : NULL;
+    if (!self || self->pid == IDLE_TASK_PID) {
+        // No task to block (early boot / idle): wait for an up() from an IRQ.
+        while (!ksem_try_down(sem)) asm volatile("pause");
+        return;
+    }
+    wait_event(&sem->waiters, ksem_try_down(sem));
+}
+
+void ksem_up(ksemaphore_t *sem) {
+    KERNEL_ASSERT(sem != NULL, "ksem_up: NULL semaphore");
+    uintptr_t flags = spinlock_acquire_irqsave(&sem->lock);
+    sem->count++;
+    spinlock_release_irqrestore(&sem->lock, flags);
+    wake_up_one(&sem->waiters);
+}
@@ -1,20 +1,72 @@
 #include <kernel/sync/spinlock.h>
 #include <kernel/drivers/display/terminal.h> // For potential debug output
+#include <kernel/drivers/display/serial.h>
+#include <kernel/memory/tlb.h>               // tlb_poll() while spinning
+#include <kernel/sync/preempt.h>             // Held locks count in preempt_count
+#if SPINLOCK_STATS
+#include <kernel/cpu/tsc.h>
+#include <kernel/drivers/timer/clock.h>
+#include <kernel/lib/div64.h>
+
+// Named locks, linked through stats_next (see spinlock_init_named).
+static spinlock_t  s_registry_lock;
+static spinlock_t *s_named_locks = NULL;
+#endif
+
+/**
+ * @brief Atomically takes the next ticket (LOCK XADD on the 'next' counter).
+ * @return The ticket this CPU must wait for.
+ */
+static inline uint16_t ticket_take(spinlock_t *lock) {
+    uint16_t ticket = 1;
+    asm volatile("lock xaddw %0, %1" : "+r"(ticket), "+m"(lock->next) : : "memory", "cc");
+    return ticket;
+}
 
 /**
  * @brief Initializes a spinlock to the unlocked state.
  */
 void spinlock_init(spinlock_t *lock) {
     if (lock) {
-        lock->locked = 0;
+        lock->owner = 0;
+        lock->next = 0;
+#if SPINLOCK_STATS
+        // name and stats_next survive so a re-initialized named lock stays listed once.
+        lock->acquires = 0;
+        lock->contended = 0;
+        lock->spin_cycles = 0;
+        lock->max_hold_cycles = 0;
+        lock->hold_start = 0;
+#endif
     }
 }
 
+void spinlock_init_named(spinlock_t *lock, const char *name) {
+    spinlock_init(lock);
+#if SPINLOCK_STATS
+    if (!lock) return;
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_registry_lock);
+    bool listed = false;
+    for (spinlock_t *l = s_named_locks; l; l = l->stats_next) {
+        if (l == lock) { listed = true; break; }
+    }
+    lock->name = name;
+    if (!listed) {
+        lock->stats_next = s_named_locks;
+        s_named_locks = lock;
+    }
+    spinlock_release_irqrestore(&s_registry_lock, irq_flags);
+#else
+    (void)name;
+#endif
+}
+
 /**
  * @brief Acquires the spinlock, disabling local interrupts first.
- * Uses GCC/Clang atomic built-ins for test-and-set.
+ * Takes a ticket, then spins read-only until it is served.
  */
 uintptr_t spinlock_acquire_irqsave(spinlock_t *lock) {
+    preempt_disable();                  // Dropped again by the release, NULL lock or not
     uintptr_t flags = local_irq_save(); // Disable interrupts, save state
     if (!lock) {
         terminal_write("[Spinlock] Error: Trying to acquire NULL lock!\n");
@@ -22,18 +74,57 @@ uintptr_t spinlock_acquire_irqsave(spinlock_t *lock) {
         return flags; // Return saved flags even on error
     }
 
-    // Atomically test-and-set: Set lock->locked to 1, return previous value.
-    // Loop until the previous value was 0 (meaning we successfully acquired the lock).
-    // __ATOMIC_ACQUIRE ensures memory operations after are not reordered before.
-    while (__atomic_test_and_set(&lock->locked, __ATOMIC_ACQUIRE)) {
-        // Spin (yield or pause instruction recommended for SMP)
+    uint16_t ticket = ticket_take(lock);
+#if SPINLOCK_STATS
+    bool contended = (lock->owner != ticket);
+    uint64_t wait_start = contended ? read_tsc() : 0;
+#endif
+    while (lock->owner != ticket) {
         asm volatile ("pause" ::: "memory"); // Hint to CPU we are spinning
+        tlb_poll(); // The holder may be waiting for our TLB flush
     }
-    // Lock acquired
+    // Lock acquired; keep the critical section's accesses after the owner load.
+    asm volatile ("" ::: "memory");
 
+#if SPINLOCK_STATS
+    uint64_t now = read_tsc();
+    lock->acquires++;
+    if (contended) {
+        lock->contended++;
+        lock->spin_cycles += now - wait_start;
+    }
+    lock->hold_start = now;
+#endif
     return flags; // Return previous interrupt state
 }
 
+/**
+ * @brief Takes the lock if no ticket is outstanding: one CMPXCHG moves
+ * 'next' past 'owner' only while the two are equal.
+ */
+bool spinlock_try_acquire_irqsave(spinlock_t *lock, uintptr_t *flags) {
+    uintptr_t saved = local_irq_save();
+    uint16_t owner = lock->owner;
+    uint32_t expected = ((uint32_t)owner << 16) | owner; // next == owner: unlocked
+    uint32_t desired = ((uint32_t)(uint16_t)(owner + 1) << 16) | owner;
+    uint32_t prev;
+    asm volatile("lock cmpxchgl %1, (%3)" // owner and next as one dword
+                 : "=a"(prev)
+                 : "r"(desired), "0"(expected), "r"(lock)
+                 : "memory", "cc");
+    if (prev != expected) {
+        local_irq_restore(saved);
+        return false;
+    }
+#if SPINLOCK_STATS
+    lock->acquires++;
+    lock->hold_start = read_tsc();
+#endif
+    preempt_disable();
+    *flags = saved;
+    return true;
+}
+
 /**
  * @brief Releases the spinlock and restores the previous interrupt state.
  */
@@ -42,12 +133,40 @@ void spinlock_release_irqrestore(spinlock_t *lock, uintptr_t flags) {
         terminal_write("[Spinlock] Error: Trying to release NULL lock!\n");
         // Restore interrupts anyway? Or panic?
         local_irq_restore(flags);
+        preempt_enable();
         return;
     }
 
-    // Atomically clear the lock flag.
-    // __ATOMIC_RELEASE ensures memory operations before are not reordered after.
-    __atomic_clear(&lock->locked, __ATOMIC_RELEASE);
+#if SPINLOCK_STATS
+    uint64_t held = read_tsc() - lock->hold_start;
+    if (held > lock->max_hold_cycles) lock->max_hold_cycles = held;
+#endif
+
+    // Serve the next ticket. Only the holder writes 'owner' and x86 keeps
+    // stores in order, so a plain store after a compiler barrier is a release.
+    asm volatile ("" ::: "memory");
+    lock->owner = (uint16_t)(lock->owner + 1);
 
     local_irq_restore(flags); // Restore previous interrupt state
-}
\ No newline at end of file
+    // Last: a switch here (PREEMPT_FULL) must see the restored interrupt flag
+    preempt_enable();
+}
+
+void spinlock_dump_stats(void) {
+#if SPINLOCK_STATS
+    serial_printf("[Spinlock] --- Lock statistics ---\n");
+    uintptr_t irq_flags = spinlock_acquire_irqsave(&s_registry_lock);
+    for (spinlock_t *l = s_named_locks; l; l = l->stats_next) {
+        // Read without taking the lock: the values are a snapshot, not exact.
+        uint32_t avg_spin = l->contended ? (uint32_t)div_u64_rem(l->spin_cycles, l->contended, NULL) : 0;
+        uint32_t max_hold_us = (uint32_t)div_u64_rem(clock_cycles_to_ns(l->max_hold_cycles), NSEC_PER_USEC, NULL);
+        serial_printf("  %s: acquires=%lu contended=%lu avg_spin=%lu cycles max_hold=%lu us\n",
+                      l->name ? l->name : "?",
+                      (unsigned long)l->acquires, (unsigned long)l->contended,
+                      (unsigned long)avg_spin, (unsigned long)max_hold_us);
+    }
+    spinlock_release_irqrestore(&s_registry_lock, irq_flags);
+#else
+    serial_printf("[Spinlock] Statistics disabled; configure with -DUIAOS_SPINLOCK_STATS=ON.\n");
+#endif
+}
@@ -0,0 +1,155 @@
+/**
+ * @file wait_queue.c
+ * @brief Blocking wait queues built on the scheduler's BLOCKED state.
+ *
+ * Lock order: wq->lock is taken before any run queue lock, since wakeups
+ * enqueue the woken task while still holding the wait queue lock. This keeps
+ * finish_wait() from observing a half-finished wakeup.
+ */
+
+#include <kernel/sync/wait_queue.h>
+#include <kernel/lib/assert.h>
+#include <kernel/drivers/display/serial.h>
+
+#define WQ_WARN(fmt, ...) serial_printf("[WaitQ WARN ] %s:%d: " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
+
+//============================================================================
+// List helpers (wq->lock held)
+//============================================================================
+static void wq_append_locked(wait_queue_t *wq, tcb_t *task) {
+    task->wait_next = NULL;
+    task->wait_prev = wq->tail;
+    if (wq->tail) wq->tail->wait_next = task;
+    else wq->head = task;
+    wq->tail = task;
+    task->wait_reason = wq;
+}
+
+static void wq_unlink_locked(wait_queue_t *wq, tcb_t *task) {
+    if (task->wait_prev) task->wait_prev->wait_next = task->wait_next;
+    else wq->head = task->wait_next;
+    if (task->wait_next) task->wait_next->wait_prev = task->wait_prev;
+    else wq->tail = task->wait_prev;
+    task->wait_next = NULL;
+    task->wait_prev = NULL;
+    task->wait_reason = NULL;
+}
+
+static tcb_t *wq_wake_head_locked(wait_queue_t *wq) {
+    tcb_t *task = wq->head;
+    if (!task) return NULL;
+    wq_unlink_locked(wq, task);
+    scheduler_unblock_task(task);
+    return task;
+}
+
+/**
+ * Deadline of wait_queue_block_until(): dequeue and wake the task unless a
+ * regular wakeup got there first. scheduler_timer_cancel() keeps the waiter
+ * from returning (and its queue from going away) while this runs.
+ */
+static void wait_timeout_expired(timer_entry_t *entry, void *arg) {
+    (void)entry;
+    tcb_t *task = (tcb_t *)arg;
+    wait_queue_t *wq = (wait_queue_t *)task->wait_reason;
+    if (!wq) return;
+
+    uintptr_t wq_flags = spinlock_acquire_irqsave(&wq->lock);
+    if (task->wait_reason == wq) {
+        wq_unlink_locked(wq, task);
+        scheduler_unblock_task(task);
+    }
+    spinlock_release_irqrestore(&wq->lock, wq_flags);
+}
+
+//============================================================================
+// Public API
+//============================================================================
+void wait_queue_init(wait_queue_t *wq) {
+    KERNEL_ASSERT(wq != NULL, "wait_queue_init: NULL queue");
+    wq->head = NULL;
+    wq->tail = NULL;
+    spinlock_init(&wq->lock);
+}
+
+uintptr_t prepare_to_wait(wait_queue_t *wq) {
+    uintptr_t flags = local_irq_save();
+    tcb_t *current = get_current_task();
+    KERNEL_ASSERT(current && current->pid != IDLE_TASK_PID, "prepare_to_wait: no waitable current task");
+
+    uintptr_t wq_flags = spinlock_acquire_irqsave(&wq->lock);
+    if (current->wait_reason == wq) {
+        WQ_WARN("Task PID %lu already queued on this wait queue", current->pid);
+    } else {
+        KERNEL_ASSERT(current->wait_reason == NULL, "prepare_to_wait: task already waiting elsewhere");
+        wq_append_locked(wq, current);
+    }
+    current->state = TASK_BLOCKED;
+    spinlock_release_irqrestore(&wq->lock, wq_flags);
+    return flags;
+}
+
+void finish_wait(wait_queue_t *wq, uintptr_t flags) {
+    tcb_t *current = get_current_task();
+    bool woken_not_switched = false;
+
+    uintptr_t wq_flags = spinlock_acquire_irqsave(&wq->lock);
+    if (current->wait_reason == wq) {
+        // No wakeup arrived (condition held, or a spurious return).
+        wq_unlink_locked(wq, current);
+        current->state = TASK_RUNNING;
+    } else if (current->state == TASK_READY && current->in_run_queue) {
+        // Woken after prepare_to_wait() but before we ever switched away:
+        // the task sits in a run queue while still running here.
+        woken_not_switched = true;
+    }
+    spinlock_release_irqrestore(&wq->lock, wq_flags);
+
+    // Let schedule() consume the stale run queue entry (it normally picks us).
+    if (woken_not_switched) schedule();
+    local_irq_restore(flags);
+}
+
+bool wake_up_one(wait_queue_t *wq) {
+    uintptr_t wq_flags = spinlock_acquire_irqsave(&wq->lock);
+    tcb_t *task = wq_wake_head_locked(wq);
+    spinlock_release_irqrestore(&wq->lock, wq_flags);
+    return task != NULL;
+}
+
+uint32_t wake_up_all(wait_queue_t *wq) {
+    uint32_t woken = 0;
+    uintptr_t wq_flags = spinlock_acquire_irqsave(&wq->lock);
+    while (wq_wake_head_locked(wq)) woken++;
+    spinlock_release_irqrestore(&wq->lock, wq_flags);
+    return woken;
+}
+
+uint32_t wake_up_key(wait_queue_t *wq, const void *space, uintptr_t key, uint32_t max) {
+    uint32_t woken = 0;
+    uintptr_t wq_flags = spinlock_acquire_irqsave(&wq->lock);
+    tcb_t *task = wq->head;
+    while (task && woken < max) {
+        tcb_t *next = task->wait_next;
+        if (task->wait_key == key && task->wait_key_space == space) {
+            wq_unlink_locked(wq, task);
+            scheduler_unblock_task(task);
+            woken++;
+        }
+        task = next;
+    }
+    spinlock_release_irqrestore(&wq->lock, wq_flags);
+    return woken;
+}
+
+bool wait_queue_block_until(uint32_t deadline) {
+    if ((int32_t)(scheduler_get_ticks() - deadline) >= 0) return true;
+
+    tcb_t *current = get_current_task();
+    timer_entry_init(&current->wait_timer, wait_timeout_expired, current);
+    current->wait_timer.expires = deadline;
+    scheduler_timer_add(&current->wait_timer);
+    schedule();
+    scheduler_timer_cancel(&current->wait_timer);
+    return (int32_t)(scheduler_get_ticks() - deadline) >= 0;
+}
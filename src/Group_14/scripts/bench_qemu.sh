@@ -0,0 +1,178 @@
+#!/bin/bash
+# Boots kernel-bench.iso (target uiaos-bench-image) headless, once per run
+# and accelerator profile, collects bench.elf's key=value lines from the
+# serial log and compares their medians against a stored baseline.
+#
+# Usage: bench_qemu.sh [options] <path/to/kernel-bench.iso>
+#   --profile kvm|tcg|both  Accelerators to run (default: both; kvm is
+#                           skipped without /dev/kvm)
+#   --runs N                Boots per profile, the median is kept (default: 3)
+#   --baseline DIR          Baseline directory, one <profile>.txt each
+#                           (default: bench-baseline next to the ISO)
+#   --threshold PCT         Allowed regression in percent (default: 10)
+#   --save-baseline         Store this result as the new baseline
+#   --timeout SEC           Per boot (default: 300)
+#   --disk IMG              FAT image to boot with (default: disk.img next to
+#                           the ISO), e.g. a uiaos-fsbench-images variant
+#
+# Exit status: 0 all within threshold (or no baseline yet), 1 on a
+# regression, 2 if a run failed.
+PROFILES=both
+RUNS=3
+BASELINE_DIR=
+THRESHOLD=10
+SAVE_BASELINE=0
+TIMEOUT=300
+INPUT_ISO_PATH=
+INPUT_DISK_PATH=
+
+while [ $# -gt 0 ]; do
+  case "$1" in
+    --profile)       PROFILES=$2; shift 2 ;;
+    --runs)          RUNS=$2; shift 2 ;;
+    --baseline)      BASELINE_DIR=$2; shift 2 ;;
+    --threshold)     THRESHOLD=$2; shift 2 ;;
+    --save-baseline) SAVE_BASELINE=1; shift ;;
+    --timeout)       TIMEOUT=$2; shift 2 ;;
+    --disk)          INPUT_DISK_PATH=$2; shift 2 ;;
+    -*)              echo "Error: Unknown option $1"; exit 2 ;;
+    *)               INPUT_ISO_PATH=$1; shift ;;
+  esac
+done
+
+if [ -z "$INPUT_ISO_PATH" ]; then
+  echo "Usage: $0 [--profile kvm|tcg|both] [--runs N] [--baseline DIR] [--threshold PCT] [--save-baseline] [--disk IMG] <path/to/kernel-bench.iso>"
+  exit 2
+fi
+ABS_ISO_PATH=$(readlink -f "$INPUT_ISO_PATH")
+ISO_DIR=$(dirname "$ABS_ISO_PATH")
+ABS_DISK_PATH=$(readlink -f "${INPUT_DISK_PATH:-$ISO_DIR/disk.img}")
+if [ ! -f "$ABS_ISO_PATH" ]; then
+  echo "Error: ISO file not found: $INPUT_ISO_PATH"
+  exit 2
+fi
+if [ ! -f "$ABS_DISK_PATH" ]; then
+  echo "Error: Disk image file not found: $ABS_DISK_PATH"
+  exit 2
+fi
+[ -n "$BASELINE_DIR" ] || BASELINE_DIR="$ISO_DIR/bench-baseline"
+
+case "$PROFILES" in
+  both)    PROFILES="kvm tcg" ;;
+  kvm|tcg) ;;
+  *)       echo "Error: Unknown profile $PROFILES"; exit 2 ;;
+esac
+
+WORK_DIR=$(mktemp -d)
+QEMU_PID=
+cleanup() {
+  [ -n "$QEMU_PID" ] && kill -9 $QEMU_PID 2>/dev/null
+  rm -rf "$WORK_DIR"
+}
+trap cleanup EXIT
+trap 'exit 2' SIGINT SIGTERM
+
+# run_once <profile> <log>: one headless boot until bench.end=1 or timeout.
+# Writes go to a copy of disk.img, so every boot starts from the same state.
+run_once() {
+  local accel log=$2
+  case "$1" in
+    kvm) accel="-enable-kvm -cpu host" ;;
+    tcg) accel="-accel tcg" ;;
+  esac
+  cp "$ABS_DISK_PATH" "$WORK_DIR/disk.img"
+  : > "$log"
+  qemu-system-i386 $accel \
+                   -boot d \
+                   -cdrom "$ABS_ISO_PATH" \
+                   -hdb "$WORK_DIR/disk.img" \
+                   -m 1024 -smp 1 \
+                   -display none -no-reboot -monitor none \
+                   -serial file:"$log" &
+  QEMU_PID=$!
+
+  local waited=0 status=1
+  while kill -0 $QEMU_PID 2>/dev/null; do
+    if grep -q '^bench\.end=1' "$log"; then status=0; break; fi
+    if [ $waited -ge $TIMEOUT ]; then echo "  timed out after ${TIMEOUT}s"; break; fi
+    sleep 1
+    waited=$((waited + 1))
+  done
+  kill $QEMU_PID 2>/dev/null
+  wait $QEMU_PID 2>/dev/null
+  QEMU_PID=
+  tr -d '\r' < "$log" | grep -q '^bench\.end=1' && status=0
+  return $status
+}
+
+# Median per key over the given run results ("key value" lines).
+median_of() {
+  cat "$@" | sort -k1,1 -k2,2n | awk '
+    $1 != key { if (key != "") emit(); key = $1; n = 0 }
+    { v[n++] = $2 }
+    END { if (key != "") emit() }
+    function emit() { print key, (n % 2) ? v[int(n / 2)] : int((v[n / 2 - 1] + v[n / 2]) / 2) }'
+}
+
+# compare <baseline> <result>: prints every shared key, returns 1 if one
+# regressed by more than THRESHOLD percent. *_per_s is higher-is-better,
+# ns/us/cycles per op lower-is-better; other keys are informational.
+compare() {
+  awk -v threshold="$THRESHOLD" '
+    NR == FNR { base[$1] = $2; next }
+    !($1 in base) { printf "  %-40s %12s -> %12d  (new)\n", $1, "-", $2; next }
+    {
+      b = base[$1]; dir = 0
+      if ($1 ~ /_per_s$/) dir = 1
+      else if ($1 ~ /(ns|us|cycles)_per_op$/ || $1 ~ /ns_per_line$/) dir = -1
+      change = b ? ($2 - b) * 100.0 / b : 0
+      mark = ""
+      if (dir != 0 && -dir * change > threshold) { mark = "  REGRESSION"; bad = 1 }
+      printf "  %-40s %12d -> %12d  %+6.1f%%%s\n", $1, b, $2, change, mark
+    }
+    END { exit bad }' "$1" "$2"
+}
+
+FAILED=0
+REGRESSED=0
+for profile in $PROFILES; do
+  if [ "$profile" = kvm ] && [ ! -w /dev/kvm ]; then
+    echo "[$profile] /dev/kvm not available, skipping"
+    continue
+  fi
+  results=()
+  for run in $(seq 1 "$RUNS"); do
+    log="$WORK_DIR/$profile-$run.log"
+    echo "[$profile] run $run/$RUNS"
+    if ! run_once "$profile" "$log"; then
+      echo "[$profile] run $run did not finish; serial log tail:"
+      tail -n 20 "$log"
+      FAILED=1
+      continue
+    fi
+    tr -d '\r' < "$log" | grep '^error\.' | sed "s/^/[$profile]   /"
+    tr -d '\r' < "$log" | grep -E '^[a-z0-9_.]+=[0-9]+$' | grep -v '^bench\.' | tr '=' ' ' > "$log.kv"
+    results+=("$log.kv")
+  done
+  [ ${#results[@]} -gt 0 ] || continue
+
+  result="$ISO_DIR/bench-$profile.txt"
+  median_of "${results[@]}" > "$result"
+  echo "[$profile] median of ${#results[@]} runs in $result"
+
+  baseline="$BASELINE_DIR/$profile.txt"
+  if [ "$SAVE_BASELINE" = 1 ]; then
+    mkdir -p "$BASELINE_DIR"
+    cp "$result" "$baseline"
+    echo "[$profile] saved as baseline $baseline"
+  elif [ -f "$baseline" ]; then
+    echo "[$profile] against $baseline (threshold ${THRESHOLD}%):"
+    compare "$baseline" "$result" || REGRESSED=1
+  else
+    echo "[$profile] Warning: no baseline at $baseline; rerun with --save-baseline to store one"
+  fi
+done
+
+[ $FAILED = 1 ] && exit 2
+[ $REGRESSED = 1 ] && { echo "Benchmark regressions beyond ${THRESHOLD}%"; exit 1; }
+exit 0
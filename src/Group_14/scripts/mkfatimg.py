@@ -0,0 +1,362 @@
+#!/usr/bin/env python3
+"""Generates FAT16/FAT32 disk.img variants with a benchmark layout.
+
+The image is written from scratch (no mkfs.fat/mtools), so the cluster
+allocation order, and with it the fragmentation, is under our control.
+Everything below /FSB is what bench.elf's FAT layout section measures:
+
+  /FSB/LAYOUT.TXT          key=value description of the layout (read by bench.elf)
+  /FSB/DEEP/L1/.../Ln      one directory per level, each holding F.DAT (lookup depth)
+  /FSB/DIRS/N<k>/F<i>.DAT  one directory per --dir-sizes entry with k empty files
+  /FSB/TREE/...            --files small files, --fanout entries per directory
+  /FSB/BIG/B<i>.DAT        --big-files files of --big-mib MiB each (unlink)
+  /FSB/NEW                 empty; bench.elf creates and removes its files here
+
+--frag sets the chance, in percent, that the next cluster of a file is
+taken from a random free cluster instead of the one after its previous
+cluster; 0 gives contiguous files. --seed makes layouts reproducible.
+--add SRC:DEST copies host files in (8.3 names only), so the variant can
+stand in for the build's disk.img:
+
+  mkfatimg.py --fat 32 --frag 30 --add hello.elf:/hello.elf \\
+      --add shell.elf:/bin/shell.elf --add bench.elf:/bin/bench.elf disk.img
+"""
+
+import argparse
+import random
+import struct
+import sys
+
+SECTOR = 512
+ATTR_DIR = 0x10
+ATTR_ARCHIVE = 0x20
+# 2025-01-01 00:00:00, so identical arguments give identical images
+FAT_DATE = ((2025 - 1980) << 9) | (1 << 5) | 1
+FAT_TIME = 0
+
+
+class Node:
+    def __init__(self, name, is_dir, size=0, data=None):
+        self.name = name
+        self.is_dir = is_dir
+        self.size = size          # Bytes, files only
+        self.data = data          # Host file contents, or None for the fill pattern
+        self.children = []
+        self.clusters = []
+        self.index = 0            # Fill pattern seed
+        self.is_root = False
+
+    def add(self, child):
+        if any(c.name == child.name for c in self.children):
+            sys.exit("mkfatimg: duplicate name %s" % child.name)
+        self.children.append(child)
+        return child
+
+    def subdir(self, name):
+        for c in self.children:
+            if c.name == name:
+                if not c.is_dir:
+                    sys.exit("mkfatimg: %s is a file" % name)
+                return c
+        return self.add(Node(name, True))
+
+
+def short_name(name):
+    """8.3 directory entry name; long names are refused rather than mangled."""
+    base, _, ext = name.upper().partition(".")
+    if not base or len(base) > 8 or len(ext) > 3 or "." in ext:
+        sys.exit("mkfatimg: %s is not an 8.3 name" % name)
+    for ch in base + ext:
+        if not (ch.isalnum() or ch in "_-~!#$%&'()@^`{}"):
+            sys.exit("mkfatimg: %s is not an 8.3 name" % name)
+    return (base.ljust(8) + ext.ljust(3)).encode("ascii")
+
+
+def dir_entry(name11, attr, cluster, size):
+    return struct.pack("<11sBBBHHHHHHHI", name11, attr, 0, 0, FAT_TIME, FAT_DATE, FAT_DATE,
+                       cluster >> 16, FAT_TIME, FAT_DATE, cluster & 0xFFFF, size)
+
+
+class Geometry:
+    def __init__(self, fat, size_mib, cluster_size):
+        if cluster_size % SECTOR or cluster_size // SECTOR not in (1, 2, 4, 8, 16, 32, 64, 128):
+            sys.exit("mkfatimg: cluster size must be 512 bytes times a power of two up to 128")
+        self.fat = fat
+        self.spc = cluster_size // SECTOR
+        self.cluster_size = cluster_size
+        self.total = size_mib * 1024 * 1024 // SECTOR
+        self.reserved = 32 if fat == 32 else 1
+        self.root_entries = 0 if fat == 32 else 512
+        self.root_sectors = self.root_entries * 32 // SECTOR
+        entry = 4 if fat == 32 else 2
+        fat_sectors = 1
+        while True:  # The FAT size and the cluster count depend on each other
+            data = self.total - self.reserved - 2 * fat_sectors - self.root_sectors
+            clusters = data // self.spc
+            need = ((clusters + 2) * entry + SECTOR - 1) // SECTOR
+            if need <= fat_sectors:
+                break
+            fat_sectors = need
+        self.fat_sectors = fat_sectors
+        self.clusters = clusters
+        self.data_start = self.reserved + 2 * fat_sectors + self.root_sectors
+        # The kernel (like every FAT driver) picks the type from the cluster count
+        if fat == 16 and not 4085 <= clusters < 65525:
+            sys.exit("mkfatimg: %d clusters is not FAT16 (4085..65524); change --size-mib or --cluster-size" % clusters)
+        if fat == 32 and clusters < 65525:
+            sys.exit("mkfatimg: %d clusters is not FAT32 (65525 or more); grow --size-mib or shrink --cluster-size" % clusters)
+
+    def cluster_offset(self, cluster):
+        return (self.data_start + (cluster - 2) * self.spc) * SECTOR
+
+
+class Allocator:
+    """Hands out clusters 2.. in order, jumping to a random free one at rate frag."""
+
+    def __init__(self, count, frag, rng):
+        self.used = bytearray(count + 2)
+        self.used[0] = self.used[1] = 1
+        self.count = count
+        self.frag = frag
+        self.rng = rng
+        self.cursor = 2
+        self.free = count
+
+    def _next_free(self, start):
+        c = start
+        for _ in range(self.count + 2):
+            if c >= self.count + 2:
+                c = 2
+            if not self.used[c]:
+                return c
+            c += 1
+        sys.exit("mkfatimg: image full; grow --size-mib")
+
+    def chain(self, n):
+        out = []
+        for _ in range(n):
+            if out and self.rng.random() * 100 < self.frag:
+                c = self._next_free(self.rng.randrange(2, self.count + 2))
+            else:
+                c = self._next_free(out[-1] + 1 if out else self.cursor)
+            self.used[c] = 1
+            self.free -= 1
+            out.append(c)
+        if out:
+            self.cursor = out[-1] + 1  # Next fit: the next chain starts where this one ended
+        return out
+
+
+def dir_clusters(node, geo):
+    entries = len(node.children) + 2
+    return max(1, (entries * 32 + geo.cluster_size - 1) // geo.cluster_size)
+
+
+def allocate(node, geo, alloc, is_root):
+    """Depth first, in creation order, like a tool copying the tree in."""
+    if node.is_dir:
+        if not (is_root and geo.fat == 16):
+            node.clusters = alloc.chain(dir_clusters(node, geo))
+        for child in node.children:
+            allocate(child, geo, alloc, False)
+    elif node.size:
+        node.clusters = alloc.chain((node.size + geo.cluster_size - 1) // geo.cluster_size)
+
+
+def dir_bytes(node, parent, is_root, geo):
+    out = bytearray()
+    if not is_root:
+        parent_cluster = 0 if parent.is_root else parent.clusters[0]  # 0 means the root, even on FAT32
+        out += dir_entry(b".          ", ATTR_DIR, node.clusters[0], 0)
+        out += dir_entry(b"..         ", ATTR_DIR, parent_cluster, 0)
+    for c in node.children:
+        first = c.clusters[0] if c.clusters else 0
+        out += dir_entry(short_name(c.name), ATTR_DIR if c.is_dir else ATTR_ARCHIVE, first,
+                         0 if c.is_dir else c.size)
+    return bytes(out)
+
+
+def fill(node):
+    if node.data is not None:
+        return node.data
+    pattern = bytes((node.index + i) & 0xFF for i in range(256))
+    return (pattern * (node.size // 256 + 1))[:node.size]
+
+
+def write_tree(img, node, parent, geo, is_root, fat):
+    node.is_root = is_root
+    if node.is_dir:
+        data = dir_bytes(node, parent, is_root, geo)
+        if is_root and geo.fat == 16:
+            if len(node.children) > geo.root_entries:
+                sys.exit("mkfatimg: more than %d entries in the FAT16 root" % geo.root_entries)
+            img.seek((geo.reserved + 2 * geo.fat_sectors) * SECTOR)
+            img.write(data)
+        else:
+            write_chain(img, node.clusters, data, geo, fat)
+        for child in node.children:
+            write_tree(img, child, node, geo, False, fat)
+    elif node.clusters:
+        write_chain(img, node.clusters, fill(node), geo, fat)
+
+
+def write_chain(img, clusters, data, geo, fat):
+    eoc = 0x0FFFFFFF if geo.fat == 32 else 0xFFFF
+    for i, c in enumerate(clusters):
+        fat[c] = clusters[i + 1] if i + 1 < len(clusters) else eoc
+        chunk = data[i * geo.cluster_size:(i + 1) * geo.cluster_size]
+        if chunk:
+            img.seek(geo.cluster_offset(c))
+            img.write(chunk)
+
+
+def boot_sector(geo, root_cluster, volume_id):
+    bs = bytearray(SECTOR)
+    total16 = geo.total if geo.total < 0x10000 else 0
+    struct.pack_into("<3s8sHBHBHHBHHHII", bs, 0,
+                     b"\xEB\x58\x90" if geo.fat == 32 else b"\xEB\x3C\x90", b"UIAOSFSB",
+                     SECTOR, geo.spc, geo.reserved, 2, geo.root_entries, total16, 0xF8,
+                     0 if geo.fat == 32 else geo.fat_sectors, 32, 64, 0,
+                     0 if total16 else geo.total)
+    if geo.fat == 32:
+        struct.pack_into("<IHHIHH12xBBBI11s8s", bs, 36, geo.fat_sectors, 0, 0, root_cluster, 1, 6,
+                         0x80, 0, 0x29, volume_id, b"UIAOS FSB  ", b"FAT32   ")
+    else:
+        struct.pack_into("<BBBI11s8s", bs, 36, 0x80, 0, 0x29, volume_id, b"UIAOS FSB  ", b"FAT16   ")
+    bs[510:512] = b"\x55\xAA"
+    return bytes(bs)
+
+
+def fsinfo_sector(free, next_free):
+    fs = bytearray(SECTOR)
+    struct.pack_into("<I", fs, 0, 0x41615252)
+    struct.pack_into("<IIII", fs, 484, 0x61417272, free, next_free, 0)
+    struct.pack_into("<I", fs, 508, 0xAA550000)
+    return bytes(fs)
+
+
+def build_layout(root, args, rng):
+    fsb = root.subdir("FSB")
+
+    deep = fsb.add(Node("DEEP", True))
+    level = deep
+    level.add(Node("F.DAT", False, 512))
+    for d in range(1, args.depth + 1):
+        level = level.add(Node("L%d" % d, True))
+        level.add(Node("F.DAT", False, 512))
+
+    dirs = fsb.add(Node("DIRS", True))
+    for k in args.dir_sizes:
+        d = dirs.add(Node("N%d" % k, True))
+        for i in range(k):
+            d.add(Node("F%05d.DAT" % i, False))
+
+    # The tree: leaf directories of fanout files, then levels of fanout
+    # directories above them until one level fits under TREE
+    tree = fsb.add(Node("TREE", True))
+    leaves = []
+    remaining = args.files
+    while remaining > 0:
+        leaf = Node("D%05d" % len(leaves), True)
+        for i in range(min(args.fanout, remaining)):
+            f = leaf.add(Node("F%05d.DAT" % i, False, rng.randint(1, 4) * args.cluster_size))
+            f.index = len(leaves) * args.fanout + i
+        remaining -= len(leaf.children)
+        leaves.append(leaf)
+    levels = 1
+    while len(leaves) > args.fanout:
+        parents = []
+        for p in range(0, len(leaves), args.fanout):
+            parent = Node("D%05d" % len(parents), True)
+            for child in leaves[p:p + args.fanout]:
+                parent.add(child)
+            parents.append(parent)
+        leaves = parents
+        levels += 1
+    for child in leaves:
+        tree.add(child)
+
+    big = fsb.add(Node("BIG", True))
+    for i in range(args.big_files):
+        big.add(Node("B%d.DAT" % i, False, args.big_mib * 1024 * 1024)).index = i
+
+    fsb.add(Node("NEW", True))
+
+    layout = ["fat=%d" % args.fat, "cluster=%d" % args.cluster_size, "frag=%d" % args.frag,
+              "depth=%d" % args.depth, "files=%d" % args.files, "fanout=%d" % args.fanout,
+              "tree_levels=%d" % levels, "dirs=%d" % len(args.dir_sizes)]
+    layout += ["dir%d=%d" % (i, k) for i, k in enumerate(args.dir_sizes)]
+    layout += ["big=%d" % args.big_files, "big_kib=%d" % (args.big_mib * 1024)]
+    text = ("\n".join(layout) + "\n").encode("ascii")
+    # First in /FSB, so it lands in the first clusters whatever --frag says
+    fsb.children.insert(0, Node("LAYOUT.TXT", False, len(text), text))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("--fat", type=int, choices=(16, 32), default=16)
+    ap.add_argument("--size-mib", type=int, default=64)
+    ap.add_argument("--cluster-size", type=int, help="bytes (default 2048 on FAT16, 512 on FAT32)")
+    ap.add_argument("--files", type=int, default=1024, help="small files under /FSB/TREE")
+    ap.add_argument("--fanout", type=int, default=32, help="entries per /FSB/TREE directory")
+    ap.add_argument("--depth", type=int, default=8, help="levels under /FSB/DEEP")
+    ap.add_argument("--dir-sizes", default="16,128,512", help="comma-separated /FSB/DIRS sizes")
+    ap.add_argument("--big-files", type=int, default=2)
+    ap.add_argument("--big-mib", type=int, default=4)
+    ap.add_argument("--frag", type=int, default=0, help="fragmentation, 0-100")
+    ap.add_argument("--seed", type=int, default=1)
+    ap.add_argument("--add", action="append", default=[], metavar="SRC:DEST")
+    ap.add_argument("output")
+    args = ap.parse_args()
+
+    if args.cluster_size is None:
+        args.cluster_size = 512 if args.fat == 32 else 2048
+    args.dir_sizes = [int(k) for k in args.dir_sizes.split(",") if k]
+    if not 0 <= args.frag <= 100 or args.fanout < 1 or args.depth < 0:
+        ap.error("--frag is 0-100, --fanout at least 1, --depth not negative")
+    rng = random.Random(args.seed)
+    geo = Geometry(args.fat, args.size_mib, args.cluster_size)
+
+    root = Node("", True)
+    for spec in args.add:
+        src, _, dest = spec.partition(":")
+        parts = [p for p in dest.split("/") if p]
+        if not parts:
+            ap.error("--add needs SRC:DEST")
+        with open(src, "rb") as f:
+            data = f.read()
+        d = root
+        for p in parts[:-1]:
+            d = d.subdir(p.upper())
+        d.add(Node(parts[-1].upper(), False, len(data), data))
+    build_layout(root, args, rng)
+
+    alloc = Allocator(geo.clusters, args.frag, rng)
+    allocate(root, geo, alloc, True)  # On FAT32 the root comes first, at cluster 2
+
+    fat = [0] * (geo.clusters + 2)
+    fat[0] = 0x0FFFFFF8 if args.fat == 32 else 0xFFF8
+    fat[1] = 0x0FFFFFFF if args.fat == 32 else 0xFFFF
+    with open(args.output, "wb") as img:
+        img.truncate(geo.total * SECTOR)
+        write_tree(img, root, None, geo, True, fat)
+        fat_bytes = struct.pack("<%d%s" % (len(fat), "I" if args.fat == 32 else "H"), *fat)
+        for copy in range(2):
+            img.seek((geo.reserved + copy * geo.fat_sectors) * SECTOR)
+            img.write(fat_bytes)
+        bs = boot_sector(geo, root.clusters[0] if root.clusters else 0, rng.getrandbits(32))
+        img.seek(0)
+        img.write(bs)
+        if args.fat == 32:
+            info = fsinfo_sector(alloc.free, alloc.cursor)
+            img.seek(SECTOR)
+            img.write(info)
+            img.seek(6 * SECTOR)  # Backup boot sector and FSInfo
+            img.write(bs + info)
+
+    print("%s: FAT%d, %d clusters of %d bytes, %d free, fragmentation %d%%"
+          % (args.output, args.fat, geo.clusters, geo.cluster_size, alloc.free, args.frag))
+
+
+if __name__ == "__main__":
+    main()
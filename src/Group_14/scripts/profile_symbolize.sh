@@ -0,0 +1,54 @@
+#!/bin/bash
+# Turns a profiler dump (SYS_PROFILE PROFILE_DUMP) in a serial log into a
+# flat profile: kernel samples are symbolized against kernel.bin and summed
+# per function, user samples are summed per PID.
+#
+# Usage: profile_symbolize.sh <kernel.bin> <qemu_output.log> [top-N]
+KERNEL_BIN=$1
+LOG_FILE=$2
+TOP=${3:-30}
+ADDR2LINE=${ADDR2LINE:-addr2line}
+
+if [ -z "$KERNEL_BIN" ] || [ -z "$LOG_FILE" ]; then
+  echo "Usage: $0 <kernel.bin> <serial log> [top-N]"
+  exit 1
+fi
+if [ ! -f "$KERNEL_BIN" ]; then
+  echo "Error: Kernel binary not found: $KERNEL_BIN"
+  exit 1
+fi
+if [ ! -f "$LOG_FILE" ]; then
+  echo "Error: Serial log not found: $LOG_FILE"
+  exit 1
+fi
+
+# Sample lines: "[Profile] S <cpu> <pid> <cpl> <eip>"
+SAMPLES=$(grep -a '^\[Profile\] S ' "$LOG_FILE")
+TOTAL=$(printf '%s\n' "$SAMPLES" | grep -c .)
+if [ "$TOTAL" -eq 0 ]; then
+  echo "No profiler samples in $LOG_FILE"
+  exit 1
+fi
+KERNEL_SAMPLES=$(printf '%s\n' "$SAMPLES" | awk '$5 == 0' | grep -c .)
+echo "$TOTAL samples, $KERNEL_SAMPLES in the kernel"
+grep -a '^\[Profile\] Dump end' "$LOG_FILE" | tail -1
+
+# One addr2line run over the distinct kernel EIPs, then sum per function
+if [ "$KERNEL_SAMPLES" -gt 0 ]; then
+  COUNTS=$(printf '%s\n' "$SAMPLES" | awk '$5 == 0 { print $6 }' | sort | uniq -c)
+  echo
+  echo "Kernel functions (top $TOP):"
+  paste <(printf '%s\n' "$COUNTS" | awk '{ print $1 }') \
+        <(printf '%s\n' "$COUNTS" | awk '{ print $2 }' | "$ADDR2LINE" -f -s -e "$KERNEL_BIN" | paste - -) |
+    awk -F'\t' '{ n[$2] += $1; if (!($2 in where)) where[$2] = $3 }
+                END { for (f in n) print n[f] "\t" f "\t" where[f] }' |
+    sort -t$'\t' -k1,1nr | head -n "$TOP" |
+    awk -F'\t' -v total="$TOTAL" '{ printf "  %6d %5.1f%%  %-32s %s\n", $1, 100.0 * $1 / total, $2, $3 }'
+fi
+
+if [ "$KERNEL_SAMPLES" -lt "$TOTAL" ]; then
+  echo
+  echo "User mode, per PID:"
+  printf '%s\n' "$SAMPLES" | awk '$5 != 0 { n[$4]++ } END { for (p in n) print n[p], p }' | sort -nr |
+    awk -v total="$TOTAL" '{ printf "  %6d %5.1f%%  PID %s\n", $1, 100.0 * $1 / total, $2 }'
+fi
@@ -0,0 +1,31 @@
+#!/bin/bash
+# Cuts the last tracepoint dump (SYS_TRACEPOINT TRACEPOINT_DUMP) out of a
+# serial log as a Chrome trace JSON file for chrome://tracing or
+# ui.perfetto.dev.
+#
+# Usage: trace_extract.sh <qemu_output.log> [trace.json]
+LOG_FILE=$1
+OUT_FILE=${2:-trace.json}
+
+if [ -z "$LOG_FILE" ]; then
+  echo "Usage: $0 <serial log> [trace.json]"
+  exit 1
+fi
+if [ ! -f "$LOG_FILE" ]; then
+  echo "Error: Serial log not found: $LOG_FILE"
+  exit 1
+fi
+
+# The last begin..end block; other log lines never start with '{' or '[{'
+awk '/^\[Trace\] JSON begin/ { n = 0; inside = 1; next }
+     /^\[Trace\] JSON end/   { inside = 0; done = n; for (i = 0; i < n; i++) keep[i] = buf[i]; summary = $0; next }
+     inside && /^\[?\{/       { buf[n++] = $0 }
+     END { for (i = 0; i < done; i++) print keep[i]; if (summary) print summary > "/dev/stderr" }' \
+    "$LOG_FILE" > "$OUT_FILE"
+
+if [ ! -s "$OUT_FILE" ]; then
+  echo "No tracepoint dump in $LOG_FILE"
+  rm -f "$OUT_FILE"
+  exit 1
+fi
+echo "Wrote $OUT_FILE"
@@ -0,0 +1,670 @@
+/*
+ * bench.c - UiAOS userspace micro-benchmarks
+ *
+ * Times the syscall paths the performance work touches: a null syscall
+ * (SYS_GETPID), SYS_WRITE to the terminal and to files, sequential and
+ * random SYS_READ over several file sizes, open/close and spawn. Every
+ * result is one "key=value" line with the unit in the key, so runs can be
+ * diffed or scraped; keys are never renamed, only added.
+ *
+ * Usage: bench.elf [quick]. "quick" divides the iteration counts by 8;
+ * file sizes stay the same.
+ * Files go to /tmp (tmpfs) and to / (the FAT root disk); the FAT file is
+ * left behind, truncated, for the next run to reuse.
+ *
+ * malloc.* times the userspace heap (userspace/lib/malloc.c) against a
+ * bare mmap/munmap pair, the price of a syscall per allocation; its
+ * map_calls keys count the heap's own SYS_MMAPs during each test.
+ *
+ * On images made by scripts/mkfatimg.py (which have /FSB/LAYOUT.TXT) the
+ * fsb.* keys add FAT lookups by depth and directory size, directory
+ * listing, create/append and unlink of the image's big files. Those are
+ * removed, so run that part on a copy of the image (bench_qemu.sh does).
+ */
+
+typedef signed   char      int8_t;
+typedef unsigned char      uint8_t;
+typedef signed   short     int16_t;
+typedef unsigned short     uint16_t;
+typedef signed   int       int32_t;
+typedef unsigned int       uint32_t;
+typedef signed   long long int64_t;
+typedef unsigned long long uint64_t;
+typedef uint32_t           uintptr_t;
+typedef uint32_t           size_t;
+typedef int32_t            ssize_t;
+
+#ifndef NULL
+#define NULL ((void*)0)
+#endif
+
+// --- Syscall numbers and flags (must match include/kernel/cpu/syscall.h, sys_file.h) ---
+#define SYS_READ    3
+#define SYS_WRITE   4
+#define SYS_OPEN    5
+#define SYS_CLOSE   6
+#define SYS_PUTS    7
+#define SYS_LSEEK   19
+#define SYS_GETPID  20
+#define SYS_WAITPID 24
+#define SYS_MMAP    25
+#define SYS_MUNMAP  26
+#define SYS_GETDENTS 29
+#define SYS_STAT    38
+#define SYS_SPAWN   49
+#define SYS_UNLINK  55
+
+#define O_RDONLY    0x0000
+#define O_WRONLY    0x0001
+#define O_RDWR      0x0002
+#define O_CREAT     0x0040
+#define O_TRUNC     0x0200
+#define O_APPEND    0x0400
+#define SEEK_SET    0
+
+#define DT_DIR      4
+
+#define STDOUT_FILENO 1
+
+// Mirrors the kernel's spawn_args_t (process.h), struct dirent_rec and struct vfs_stat (types.h)
+typedef struct { uint32_t path, argv, envp, fd_actions, nr_fd_actions; } spawn_args_t;
+struct dirent_rec { uint32_t d_ino, d_off; uint16_t d_reclen; uint8_t d_type; char d_name[]; };
+struct vfs_stat { uint32_t st_ino, st_mode, st_size, st_blksize, st_blocks, st_attr, st_mtime, st_ctime; };
+
+#define CHILD_ARG "--bench-child"
+
+#include "../lib/vvar.h"  // Needs uint32_t/uint64_t from above
+#include "../lib/malloc.h"
+
+// SYSENTER support, probed once: -1 unknown, 0 no, 1 yes.
+// Same probe as the shell and the kernel's syscall_init_cpu().
+static int g_use_sysenter = -1;
+
+static int cpu_has_sysenter(void) {
+    uint32_t eax, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+    if (!(edx & (1u << 11))) return 0; // CPUID.1:EDX.SEP
+    uint32_t family = (eax >> 8) & 0xF, model = (eax >> 4) & 0xF, stepping = eax & 0xF;
+    return !(family == 6 && model < 3 && stepping < 3); // Early Pentium Pro lies about SEP
+}
+
+static inline int32_t syscall(int32_t nr, int32_t arg1, int32_t arg2, int32_t arg3) {
+    int32_t ret;
+    if (g_use_sysenter < 0) g_use_sysenter = cpu_has_sysenter();
+    if (g_use_sysenter) {
+        __asm__ volatile (
+            "pushl %%ebp          \n\t"
+            "pushl %%esi          \n\t"
+            "movl %%esp, %%ebp    \n\t"
+            "movl $1f, %%esi      \n\t"
+            "sysenter             \n"
+            "1:                   \n\t"
+            "popl %%esi           \n\t"
+            "popl %%ebp           \n\t"
+            : "=a" (ret), "+b" (arg1), "+c" (arg2), "+d" (arg3)
+            : "0" (nr)
+            : "cc", "memory"
+        );
+        return ret;
+    }
+    __asm__ volatile (
+        "int $0x80"
+        : "=a" (ret), "+b" (arg1), "+c" (arg2), "+d" (arg3)
+        : "0" (nr)
+        : "cc", "memory"
+    );
+    return ret;
+}
+
+#define sys_read(fd, buf, n)    syscall(SYS_READ, (fd), (int32_t)(uintptr_t)(buf), (n))
+#define sys_write(fd, buf, n)   syscall(SYS_WRITE, (fd), (int32_t)(uintptr_t)(buf), (n))
+#define sys_open(p, f, m)       syscall(SYS_OPEN, (int32_t)(uintptr_t)(p), (f), (m))
+#define sys_close(fd)           syscall(SYS_CLOSE, (fd), 0, 0)
+#define sys_puts(p)             syscall(SYS_PUTS, (int32_t)(uintptr_t)(p), 0, 0)
+#define sys_lseek(fd, off, wh)  syscall(SYS_LSEEK, (fd), (off), (wh))
+#define sys_getpid()            syscall(SYS_GETPID, 0, 0, 0)
+#define sys_getdents(fd, b, n)  syscall(SYS_GETDENTS, (fd), (int32_t)(uintptr_t)(b), (n))
+#define sys_stat(p, st)         syscall(SYS_STAT, (int32_t)(uintptr_t)(p), (int32_t)(uintptr_t)(st), 0)
+#define sys_unlink(p)           syscall(SYS_UNLINK, (int32_t)(uintptr_t)(p), 0, 0)
+
+// --- Output ---
+
+static int my_strcmp(const char *a, const char *b) {
+    while (*a && *a == *b) { a++; b++; }
+    return *(const unsigned char *)a - *(const unsigned char *)b;
+}
+
+static char *put_str(char *p, const char *s) {
+    while (*s) *p++ = *s++;
+    return p;
+}
+
+static char *put_u64(char *p, uint64_t v) {
+    char tmp[21];
+    int n = 0;
+    do { tmp[n++] = (char)('0' + v % 10); v /= 10; } while (v);
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+static char *put_u5(char *p, uint32_t v) { // Zero-padded to 5 digits, as mkfatimg.py names files
+    for (int i = 4; i >= 0; i--) { p[i] = (char)('0' + v % 10); v /= 10; }
+    return p + 5;
+}
+
+// Prints "<prefix><key>=<value>\n"
+static void report(const char *prefix, const char *key, uint64_t value) {
+    char line[96];
+    char *p = put_str(line, prefix);
+    p = put_str(p, key);
+    *p++ = '=';
+    p = put_u64(p, value);
+    *p++ = '\n';
+    *p = '\0';
+    sys_puts(line);
+}
+
+static void report_error(const char *key, int32_t err) {
+    report("error.", key, err < 0 ? (uint64_t)-(int64_t)err : (uint64_t)err);
+}
+
+// --- Timing ---
+
+static uint64_t per_op_ns(uint64_t ns, uint32_t ops) {
+    return ops ? ns / ops : 0;
+}
+
+// Bytes per second as KiB/s
+static uint64_t kib_per_s(uint64_t bytes, uint64_t ns) {
+    if (!ns) ns = 1;
+    return (bytes * 1000000000ull / ns) / 1024;
+}
+
+static uint64_t ops_per_s(uint32_t ops, uint64_t ns) {
+    if (!ns) ns = 1;
+    return (uint64_t)ops * 1000000000ull / ns;
+}
+
+// --- Benchmarks ---
+
+static uint32_t g_scale = 1; // Iteration divisor ("quick")
+
+static uint32_t iters(uint32_t n) {
+    return n / g_scale ? n / g_scale : 1;
+}
+
+static void bench_null_syscall(void) {
+    uint32_t n = iters(20000);
+    sys_getpid(); // Warm the path (and the SYSENTER probe)
+    uint64_t t0 = vvar_clock_ns();
+    uint64_t c0 = vvar_rdtsc();
+    for (uint32_t i = 0; i < n; i++) sys_getpid();
+    uint64_t cycles = vvar_rdtsc() - c0;
+    uint64_t ns = vvar_clock_ns() - t0;
+    report("syscall.", "sysenter", g_use_sysenter ? 1 : 0);
+    report("syscall.getpid.", "ns_per_op", per_op_ns(ns, n));
+    report("syscall.getpid.", "cycles_per_op", n ? cycles / n : 0);
+}
+
+static char g_buf[65536];
+
+static void bench_terminal_write(void) {
+    // 32 lines of 64 bytes, written with one SYS_WRITE each
+    static char line[64];
+    for (uint32_t i = 0; i < sizeof(line) - 1; i++) line[i] = (char)('a' + i % 26);
+    line[sizeof(line) - 1] = '\n';
+    uint32_t n = 32;
+    uint64_t t0 = vvar_clock_ns();
+    for (uint32_t i = 0; i < n; i++) sys_write(STDOUT_FILENO, line, sizeof(line));
+    uint64_t ns = vvar_clock_ns() - t0;
+    report("write.terminal.", "ns_per_line", per_op_ns(ns, n));
+    report("write.terminal.", "kib_per_s", kib_per_s((uint64_t)n * sizeof(line), ns));
+}
+
+// Writes @p size bytes in @p chunk-byte writes; the file stays open for the reads
+static int32_t bench_file_write(const char *fs, const char *path, uint32_t size, uint32_t chunk, const char *tag) {
+    int32_t fd = sys_open(path, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0) {
+        report_error(fs, fd);
+        return fd;
+    }
+    uint64_t t0 = vvar_clock_ns();
+    for (uint32_t done = 0; done < size; done += chunk) {
+        int32_t w = sys_write(fd, g_buf, chunk);
+        if (w != (int32_t)chunk) {
+            report_error(fs, w < 0 ? w : 0);
+            sys_close(fd);
+            return -1;
+        }
+    }
+    uint64_t ns = vvar_clock_ns() - t0;
+    char key[48];
+    char *p = put_str(key, fs);
+    p = put_str(p, ".write.");
+    p = put_str(p, tag);
+    *(put_str(p, ".")) = '\0';
+    report(key, "kib_per_s", kib_per_s(size, ns));
+    return fd;
+}
+
+static void bench_file_read(const char *fs, int32_t fd, uint32_t size, const char *tag) {
+    char key[48];
+    char *p = put_str(key, fs);
+    p = put_str(p, ".read.");
+    p = put_str(p, tag);
+    *(put_str(p, ".")) = '\0';
+
+    // Sequential, 4 KiB at a time, twice: the second pass is served from cache
+    uint32_t chunk = 4096;
+    uint64_t ns = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        sys_lseek(fd, 0, SEEK_SET);
+        uint64_t t0 = vvar_clock_ns();
+        for (uint32_t done = 0; done < size; done += chunk) {
+            if (sys_read(fd, g_buf, chunk) <= 0) break;
+        }
+        ns = vvar_clock_ns() - t0;
+    }
+    report(key, "seq_kib_per_s", kib_per_s(size, ns));
+
+    // Random 4 KiB blocks (fixed-seed LCG, so every run reads the same ones)
+    uint32_t blocks = size / chunk ? size / chunk : 1;
+    uint32_t n = iters(256);
+    uint32_t seed = 12345;
+    uint64_t t0 = vvar_clock_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        seed = seed * 1103515245u + 12345u;
+        sys_lseek(fd, (int32_t)(((seed >> 8) % blocks) * chunk), SEEK_SET);
+        sys_read(fd, g_buf, chunk < size ? chunk : size);
+    }
+    ns = vvar_clock_ns() - t0;
+    report(key, "rand_ns_per_op", per_op_ns(ns, n));
+}
+
+static void bench_files(const char *fs, const char *path) {
+    static const struct { uint32_t size; const char *tag; } sizes[] = {
+        { 4096, "4k" }, { 65536, "64k" }, { 1048576, "1m" },
+    };
+    for (uint32_t i = 0; i < sizeof(g_buf); i++) g_buf[i] = (char)i;
+    for (uint32_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        uint32_t size = sizes[i].size;
+        uint32_t chunk = size < sizeof(g_buf) ? size : sizeof(g_buf);
+        int32_t fd = bench_file_write(fs, path, size, chunk, sizes[i].tag);
+        if (fd < 0) return;
+        bench_file_read(fs, fd, size, sizes[i].tag);
+        sys_close(fd);
+    }
+
+    // Open/close of the (now existing) file
+    uint32_t n = iters(2000);
+    uint64_t t0 = vvar_clock_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        int32_t fd = sys_open(path, O_RDONLY, 0);
+        if (fd < 0) {
+            report_error(fs, fd);
+            return;
+        }
+        sys_close(fd);
+    }
+    uint64_t ns = vvar_clock_ns() - t0;
+    char key[32];
+    *(put_str(put_str(key, fs), ".open_close.")) = '\0';
+    report(key, "ns_per_op", per_op_ns(ns, n));
+    report(key, "ops_per_s", ops_per_s(n, ns));
+    int32_t fd = sys_open(path, O_RDWR | O_TRUNC, 0); // Leave it empty
+    if (fd >= 0) sys_close(fd);
+}
+
+// --- FAT layout (images from scripts/mkfatimg.py) ---
+
+#define FSB_DIR       "/fsb"
+#define FSB_MAX_KEYS  24
+#define FSB_PATH_MAX  160
+
+static struct { const char *key; uint32_t value; } g_layout[FSB_MAX_KEYS];
+static uint32_t g_layout_count = 0;
+
+static uint32_t layout_get(const char *key) {
+    for (uint32_t i = 0; i < g_layout_count; i++) {
+        if (my_strcmp(g_layout[i].key, key) == 0) return g_layout[i].value;
+    }
+    return 0;
+}
+
+// Reads LAYOUT.TXT ("key=value" lines) and echoes it as fsb.layout.* keys
+static int fsb_read_layout(void) {
+    static char text[1024];
+    int32_t fd = sys_open(FSB_DIR "/layout.txt", O_RDONLY, 0);
+    if (fd < 0) return 0;
+    int32_t n = sys_read(fd, text, sizeof(text) - 1);
+    sys_close(fd);
+    if (n <= 0) {
+        report_error("fsb.layout", n);
+        return 0;
+    }
+    text[n] = '\0';
+    char *p = text;
+    while (*p && g_layout_count < FSB_MAX_KEYS) {
+        char *key = p;
+        while (*p && *p != '=' && *p != '\n') p++;
+        if (*p != '=') break;
+        *p++ = '\0';
+        uint32_t v = 0;
+        while (*p >= '0' && *p <= '9') v = v * 10 + (uint32_t)(*p++ - '0');
+        while (*p && *p != '\n') p++;
+        if (*p) p++;
+        g_layout[g_layout_count].key = key;
+        g_layout[g_layout_count++].value = v;
+        report("fsb.layout.", key, v);
+    }
+    return 1;
+}
+
+// One open/close, then @p n more: the first walks the disk, the rest the caches
+static void bench_open(const char *path, const char *key, uint32_t n) {
+    uint64_t t0 = vvar_clock_ns();
+    int32_t fd = sys_open(path, O_RDONLY, 0);
+    uint64_t cold = vvar_clock_ns() - t0;
+    if (fd < 0) {
+        report_error(key, fd);
+        return;
+    }
+    sys_close(fd);
+    t0 = vvar_clock_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        fd = sys_open(path, O_RDONLY, 0);
+        if (fd >= 0) sys_close(fd);
+    }
+    uint64_t ns = vvar_clock_ns() - t0;
+    report(key, "cold_ns_per_op", cold);
+    report(key, "warm_ns_per_op", per_op_ns(ns, n));
+}
+
+// /FSB/DEEP/L1/../Ld/F.DAT for every d: the cost of one more path component
+static void bench_fsb_depth(void) {
+    char path[FSB_PATH_MAX], key[48];
+    uint32_t depth = layout_get("depth");
+    char *end = put_str(path, FSB_DIR "/deep");
+    for (uint32_t d = 0; d <= depth; d++) {
+        if (d > 0) end = put_u64(put_str(end, "/l"), d);
+        if (end - path > FSB_PATH_MAX - 8) break;
+        *(put_str(end, "/f.dat")) = '\0';
+        *(put_str(put_u64(put_str(key, "fsb.lookup.depth"), d), ".")) = '\0';
+        bench_open(path, key, iters(200));
+    }
+}
+
+// Lists @p path once per pass; returns the entries seen in the last pass
+static uint32_t list_dir(const char *path, uint32_t passes, uint64_t *ns_out) {
+    static char buf[4096];
+    uint32_t entries = 0;
+    uint64_t t0 = vvar_clock_ns();
+    for (uint32_t pass = 0; pass < passes; pass++) {
+        int32_t fd = sys_open(path, O_RDONLY, 0);
+        entries = 0;
+        if (fd < 0) break;
+        int32_t got;
+        while ((got = sys_getdents(fd, buf, sizeof(buf))) > 0) {
+            for (int32_t off = 0; off < got; off += ((struct dirent_rec *)(buf + off))->d_reclen) entries++;
+        }
+        sys_close(fd);
+    }
+    *ns_out = vvar_clock_ns() - t0;
+    return entries;
+}
+
+// /FSB/DIRS/N<k>: finding the last entry, a name that isn't there, and listing
+static void bench_fsb_dirs(void) {
+    char path[FSB_PATH_MAX], key[48], name[8];
+    uint32_t dirs = layout_get("dirs");
+    for (uint32_t i = 0; i < dirs; i++) {
+        *(put_u64(put_str(name, "dir"), i)) = '\0';
+        uint32_t k = layout_get(name);
+        if (k == 0) continue;
+        char *dir_end = put_u64(put_str(path, FSB_DIR "/dirs/n"), k);
+        char *key_end = put_str(put_u64(put_str(key, "fsb.find.n"), k), ".");
+        *key_end = '\0';
+        *(put_str(put_u5(put_str(dir_end, "/f"), k - 1), ".dat")) = '\0';
+        bench_open(path, key, iters(200));
+
+        *(put_str(dir_end, "/missing.dat")) = '\0';
+        uint32_t n = iters(100);
+        uint64_t t0 = vvar_clock_ns();
+        for (uint32_t j = 0; j < n; j++) {
+            int32_t fd = sys_open(path, O_RDONLY, 0);
+            if (fd >= 0) sys_close(fd);
+        }
+        report(key, "miss_ns_per_op", per_op_ns(vvar_clock_ns() - t0, n));
+
+        *dir_end = '\0';
+        uint32_t passes = iters(16);
+        uint64_t ns;
+        uint32_t entries = list_dir(path, passes, &ns);
+        *(put_str(put_u64(put_str(key, "fsb.readdir.n"), k), ".")) = '\0';
+        if (entries == 0) {
+            report_error(key, 0);
+            continue;
+        }
+        report(key, "entries_per_s", ops_per_s(entries * passes, ns));
+    }
+}
+
+// Depth-first listing of everything below @p path (which it extends in place)
+static void walk_tree(char *path, char *end, uint32_t *entries) {
+    char buf[1024];
+    int32_t fd = sys_open(path, O_RDONLY, 0);
+    if (fd < 0) return;
+    int32_t got;
+    while ((got = sys_getdents(fd, buf, sizeof(buf))) > 0) {
+        for (int32_t off = 0; off < got; off += ((struct dirent_rec *)(buf + off))->d_reclen) {
+            struct dirent_rec *rec = (struct dirent_rec *)(buf + off);
+            if (rec->d_name[0] == '.') continue;
+            (*entries)++;
+            if (rec->d_type != DT_DIR || end - path > FSB_PATH_MAX - 16) continue;
+            *end = '/';
+            char *sub = put_str(end + 1, rec->d_name);
+            *sub = '\0';
+            walk_tree(path, sub, entries);
+            *end = '\0';
+        }
+    }
+    sys_close(fd);
+}
+
+static void bench_fsb_tree(void) {
+    char path[FSB_PATH_MAX];
+    char *end = put_str(path, FSB_DIR "/tree");
+    *end = '\0';
+    uint32_t entries = 0;
+    uint64_t t0 = vvar_clock_ns();
+    walk_tree(path, end, &entries);
+    uint64_t ns = vvar_clock_ns() - t0;
+    report("fsb.tree.walk.", "entries", entries);
+    report("fsb.tree.walk.", "entries_per_s", ops_per_s(entries, ns));
+}
+
+// Creates files in /FSB/NEW, appends to one, then removes them all again
+static void bench_fsb_create(void) {
+    char path[FSB_PATH_MAX];
+    uint32_t n = iters(128);
+    uint64_t t0 = vvar_clock_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        *(put_str(put_u5(put_str(path, FSB_DIR "/new/c"), i), ".dat")) = '\0';
+        int32_t fd = sys_open(path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+        if (fd < 0) {
+            report_error("fsb.create", fd);
+            n = i;
+            break;
+        }
+        sys_close(fd);
+    }
+    report("fsb.create.", "ops_per_s", ops_per_s(n, vvar_clock_ns() - t0));
+
+    const char *append_path = FSB_DIR "/new/append.dat";
+    int32_t fd = sys_open(append_path, O_CREAT | O_WRONLY | O_APPEND, 0644);
+    if (fd >= 0) {
+        uint32_t writes = iters(256);
+        t0 = vvar_clock_ns();
+        for (uint32_t i = 0; i < writes; i++) {
+            if (sys_write(fd, g_buf, 4096) != 4096) break;
+        }
+        report("fsb.append.", "kib_per_s", kib_per_s((uint64_t)writes * 4096, vvar_clock_ns() - t0));
+        sys_close(fd);
+        sys_unlink(append_path);
+    } else {
+        report_error("fsb.append", fd);
+    }
+
+    t0 = vvar_clock_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        *(put_str(put_u5(put_str(path, FSB_DIR "/new/c"), i), ".dat")) = '\0';
+        int32_t err = sys_unlink(path);
+        if (err < 0) {
+            report_error("fsb.unlink", err);
+            return;
+        }
+    }
+    report("fsb.unlink.small.", "ops_per_s", ops_per_s(n, vvar_clock_ns() - t0));
+}
+
+// Removes /FSB/BIG/B<i>.DAT: freeing long (and, with --frag, scattered) chains
+static void bench_fsb_unlink_big(void) {
+    char path[FSB_PATH_MAX];
+    uint32_t big = layout_get("big"), done = 0;
+    uint64_t ns = 0;
+    for (uint32_t i = 0; i < big; i++) {
+        *(put_str(put_u64(put_str(path, FSB_DIR "/big/b"), i), ".dat")) = '\0';
+        struct vfs_stat st;
+        if (sys_stat(path, &st) != 0) continue; // Removed by an earlier run on this image
+        uint64_t t0 = vvar_clock_ns();
+        int32_t err = sys_unlink(path);
+        ns += vvar_clock_ns() - t0;
+        if (err < 0) {
+            report_error("fsb.unlink.big", err);
+            return;
+        }
+        done++;
+    }
+    if (done) report("fsb.unlink.big.", "us_per_op", per_op_ns(ns, done) / 1000);
+}
+
+static void bench_fsb(void) {
+    if (!fsb_read_layout()) return;
+    bench_fsb_depth();
+    bench_fsb_dirs();
+    bench_fsb_tree();
+    bench_fsb_create();
+    bench_fsb_unlink_big();
+}
+
+// --- Userspace heap ---
+
+#define MALLOC_BENCH_LIVE 4096
+
+static void *g_ptrs[MALLOC_BENCH_LIVE];
+
+static uint32_t heap_map_calls(void) {
+    malloc_stats_t st;
+    malloc_get_stats(&st);
+    return st.map_calls;
+}
+
+static void bench_malloc(void) {
+    // One size, malloc then free: the span free-list fast path
+    uint32_t n = iters(50000);
+    free(malloc(32)); // The class's first span
+    uint32_t maps = heap_map_calls();
+    uint64_t t0 = vvar_clock_ns();
+    for (uint32_t i = 0; i < n; i++) free(malloc(32));
+    uint64_t ns = vvar_clock_ns() - t0;
+    report("malloc.pair32.", "ns_per_op", per_op_ns(ns, n));
+    report("malloc.pair32.", "map_calls", heap_map_calls() - maps);
+
+    // MALLOC_BENCH_LIVE live objects of mixed small sizes, freed in another order
+    uint32_t rounds = iters(16);
+    uint32_t seed = 1;
+    maps = heap_map_calls();
+    t0 = vvar_clock_ns();
+    for (uint32_t r = 0; r < rounds; r++) {
+        for (uint32_t i = 0; i < MALLOC_BENCH_LIVE; i++) {
+            seed = seed * 1103515245u + 12345u;
+            g_ptrs[i] = malloc(16 + (seed >> 16) % 1024);
+        }
+        for (uint32_t i = 0; i < MALLOC_BENCH_LIVE; i++) free(g_ptrs[(i * 7) % MALLOC_BENCH_LIVE]);
+    }
+    ns = vvar_clock_ns() - t0;
+    report("malloc.mixed.", "ns_per_op", per_op_ns(ns, rounds * MALLOC_BENCH_LIVE * 2));
+    report("malloc.mixed.", "map_calls", heap_map_calls() - maps);
+
+    // Above MALLOC_SMALL_MAX every allocation is a mapping of its own
+    n = iters(256);
+    t0 = vvar_clock_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        char *p = malloc(256 * 1024);
+        if (!p) {
+            report_error("malloc.large", -12);
+            break;
+        }
+        p[0] = 1;
+        free(p);
+    }
+    ns = vvar_clock_ns() - t0;
+    report("malloc.large256k.", "us_per_op", per_op_ns(ns, n) / 1000);
+
+    // What a syscall per allocation costs: a bare anonymous mmap/munmap of one page
+    typedef struct { uint32_t addr, length, prot, flags; int32_t fd; uint32_t offset; } mmap_args_t;
+    mmap_args_t args = { 0, 4096, 0x3, 0x22, -1, 0 }; // PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS
+    n = iters(2048);
+    t0 = vvar_clock_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        int32_t addr = syscall(SYS_MMAP, (int32_t)&args, 0, 0);
+        if (addr < 0 && addr > -4096) {
+            report_error("malloc.mmap", addr);
+            break;
+        }
+        syscall(SYS_MUNMAP, addr, 4096, 0);
+    }
+    ns = vvar_clock_ns() - t0;
+    report("malloc.mmap_page.", "ns_per_op", per_op_ns(ns, n));
+
+    malloc_stats_t st;
+    malloc_trim(0);
+    malloc_get_stats(&st);
+    report("malloc.trim.", "spans_left", st.spans);
+}
+
+static void bench_spawn(const char *self) {
+    const char *argv[] = { "bench", CHILD_ARG, NULL };
+    spawn_args_t args = { (uint32_t)self, (uint32_t)argv, 0, 0, 0 };
+    uint32_t n = iters(64);
+    uint64_t t0 = vvar_clock_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        int32_t pid = syscall(SYS_SPAWN, (int32_t)&args, 0, 0);
+        if (pid <= 0) {
+            report_error("spawn", pid);
+            return;
+        }
+        int status = 0;
+        syscall(SYS_WAITPID, pid, (int32_t)&status, 0);
+    }
+    uint64_t ns = vvar_clock_ns() - t0;
+    report("spawn.", "us_per_op", per_op_ns(ns, n) / 1000);
+    report("spawn.", "ops_per_s", ops_per_s(n, ns));
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && my_strcmp(argv[1], CHILD_ARG) == 0) return 0;
+    if (argc > 1 && my_strcmp(argv[1], "quick") == 0) g_scale = 8;
+
+    sys_puts("bench.begin=1\n");
+    report("bench.", "scale", g_scale);
+    bench_null_syscall();
+    bench_terminal_write();
+    bench_malloc();
+    bench_files("tmpfs", "/tmp/bench.dat");
+    bench_files("fat", "/bench.dat");
+    bench_fsb();
+    bench_spawn(argc > 0 ? argv[0] : "/bin/bench.elf");
+    sys_puts("bench.end=1\n");
+    return 0;
+}
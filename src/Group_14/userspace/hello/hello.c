@@ -19,6 +19,7 @@
  typedef unsigned short     uint16_t;
  typedef signed   int       int32_t;
  typedef unsigned int       uint32_t;
+ typedef unsigned long long uint64_t;
  
  /*
   * Common Unsigned Integer Types for Sizing and Addressing.
@@ -62,6 +63,24 @@
  #define SYS_PUTS    7  /* Write string to console (kernel-specific convenience). */
  #define SYS_LSEEK   19 /* Reposition file offset. */
  #define SYS_GETPID  20 /* Get current process ID. */
+ #define SYS_POLL    43 /* Wait for descriptor readiness. */
+ #define SYS_PIPE    44 /* Create a pipe. */
+ #define SYS_MMAP    25 /* Map memory (arguments by pointer). */
+ #define SYS_MUNMAP  26 /* Unmap a range. */
+ #define SYS_SHM_OPEN   45 /* Open a named shared-memory object. */
+ #define SYS_SHM_UNLINK 46 /* Remove a shared-memory object's name. */
+ #define SYS_FUTEX   47 /* Sleep on / wake a user word. */
+ #define SYS_THREAD_CREATE 48 /* Start another thread in this process. */
+ #define SYS_WAITPID 24 /* Wait for a child to exit. */
+ #define SYS_SPAWN   49 /* Start a program as a child (arguments by pointer). */
+ #define SYS_TTY_MODE 50 /* Get or set the terminal's input mode. */
+ #define SYS_IRQ_STATS 51 /* Read one interrupt vector's counters. */
+ #define SYS_PROFILE 52 /* Control the sampling profiler. */
+ #define SYS_PERF    53 /* Program and read this task's hardware counters. */
+ #define SYS_TRACEPOINT 54 /* Enable tracepoints / dump them as a Chrome trace. */
+ #define SYS_UNLINK  55 /* Remove a file. */
+ #define SYS_FSYNC   56 /* Write one file back to disk. */
+ #define SYS_FDATASYNC 57 /* Write one file's data back to disk. */
  
  /* File open flags, mirroring standard POSIX definitions. */
  #define O_RDONLY     0x0000 /* Open for reading only. */
@@ -97,6 +116,9 @@
  #define NEG_EISDIR       (-21) /* Operation on a directory, expected file. */
  #define NEG_ENOTDIR      (-20) /* Operation on a file, expected directory. */
  #define NEG_EFAULT       (-14) /* Bad address (invalid pointer from user space). */
+ #define NEG_EPIPE        (-32) /* Write to a pipe with no reader. */
+ #define NEG_EAGAIN       (-11) /* Try again (futex word changed). */
+ #define NEG_ENODEV       (-19) /* No such device (no PMU). */
  
  /* ==== Syscall Wrapper Function ========================================== */
  /*
@@ -153,63 +175,21 @@
  #define sys_getpid()        syscall(SYS_GETPID, 0, 0, 0)
  #define sys_lseek(fd,off,wh) syscall(SYS_LSEEK, (fd), (off), (wh))
  
- /* ==== Minimal Libc-like Utilities ======================================== */
+ /* ==== C Library ========================================================= */
  /*
-  * These are minimal, self-contained implementations of common C library
-  * functions. They are necessary because this test suite is built with
-  * -nostdlib, meaning it cannot link against a standard C library.
+  * The shared userspace library (userspace/lib): the kernel's string
+  * routines and buffered stdio. stdout is line buffered on the terminal, so
+  * a test's "Test: ... [PASS]" line goes out as one write, and exit() (also
+  * reached by returning from main) flushes it.
   */
- static size_t my_strlen(const char *s) {
-     size_t i = 0; if (!s) return 0; while (s[i]) i++; return i;
- }
- static int my_strcmp(const char *s1, const char *s2) {
-     if (!s1 && !s2) return 0; if (!s1) return -1; if (!s2) return 1;
-     while (*s1 && (*s1 == *s2)) { s1++; s2++; }
-     return *(const unsigned char*)s1 - *(const unsigned char*)s2;
- }
- static void my_memset(void *s, int c, size_t n) {
-     unsigned char *p = (unsigned char *)s; while (n-- > 0) *p++ = (unsigned char)c;
- }
- static char* my_strcpy(char *dest, const char *src) {
-     char *ret = dest;
-     if (!dest || !src) return dest;
-     while ((*dest++ = *src++));
-     return ret;
- }
- static char* my_strcat(char *dest, const char *src) {
-     char *ret = dest;
-     if (!dest || !src) return dest;
-     while (*dest) dest++;
-     while ((*dest++ = *src++));
-     return ret;
- }
- 
- /* Basic character and string printing functions using the 'sys_puts' syscall. */
- static void print_char(char c) { char b[2]={c,0}; sys_puts(b); }
- static void print_str(const char *s) { if (s) sys_puts(s); }
+ #include "../lib/string.h"
+ #include "../lib/stdio.h"
+ #include "../lib/malloc.h"
+
+ static void print_char(char c) { putchar(c); }
+ static void print_str(const char *s) { if (s) fputs(s, stdout); }
  static void print_nl() { print_char('\n'); }
- 
- /* Prints a signed decimal integer. Handles INT32_MIN. */
- static void print_sdec(int32_t v) {
-     char buf[12]; char *p = buf + 11; *p = '\0'; /* Work backwards from end of buffer. */
-     if (v == 0) { if (p > buf) *--p = '0'; }
-     else {
-         bool neg = v < 0;
-         /* Handle INT32_MIN carefully to avoid overflow when negating. */
-         uint32_t n = neg ? ((v == INT32_MIN) ? 2147483648U : (uint32_t)-v) : (uint32_t)v;
-         while (n > 0) { if (p == buf) break; *--p = (n % 10) + '0'; n /= 10; }
-         if (neg) { if (p > buf) *--p = '-'; }
-     }
-     print_str(p);
- }
- /* Prints an unsigned 32-bit integer in hexadecimal format. */
- static void print_hex32(uint32_t v) {
-     print_str("0x");
-     for (int i = 7; i >= 0; i--) { /* Iterate through nibbles. */
-         uint8_t nibble = (v >> (i * 4)) & 0xF;
-         print_char(nibble < 10 ? ('0' + nibble) : ('A' + nibble - 10));
-     }
- }
+ static void print_sdec(int32_t v) { printf("%d", v); }
  
  /* ==== Test Framework Primitives ========================================== */
  /* Simple framework for running tests and reporting pass/fail status. */
@@ -237,23 +217,11 @@
  
  /* Macro to assert equality, providing detailed output on failure. */
  #define TC_EXPECT_EQ_DETAIL(val, exp, detail_label_prefix) do { \
-     bool _cond = ((val) == (exp)); \
+     int32_t _val = (val), _exp = (exp); \
+     bool _cond = (_val == _exp); \
      if (!_cond) { \
-         my_strcpy(fail_msg_buf, detail_label_prefix); \
-         my_strcat(fail_msg_buf, ": Expected "); \
-         /* Convert expected value to string. */ \
-         char temp_buf_exp[12]; char *tp_exp = temp_buf_exp+11; *tp_exp = '\0'; \
-         int32_t _exp = (exp); \
-         if(_exp == 0) *--tp_exp = '0'; else { bool _neg_exp = _exp < 0; uint32_t _n_exp = _neg_exp ? ((_exp == INT32_MIN) ? 2147483648U : (uint32_t)-_exp) : (uint32_t)_exp; \
-         while(_n_exp>0) {*--tp_exp=(_n_exp%10)+'0'; _n_exp/=10;} if(_neg_exp && _exp != INT32_MIN) *--tp_exp = '-';} \
-         my_strcat(fail_msg_buf, tp_exp); \
-         my_strcat(fail_msg_buf, ", Got "); \
-         /* Convert actual value to string. */ \
-         char temp_buf_val[12]; char *tp_val = temp_buf_val+11; *tp_val = '\0'; \
-         int32_t _val = (val); \
-         if(_val == 0) *--tp_val = '0'; else { bool _neg_val = _val < 0; uint32_t _n_val = _neg_val ? ((_val == INT32_MIN) ? 2147483648U : (uint32_t)-_val) : (uint32_t)_val; \
-         while(_n_val>0) {*--tp_val=(_n_val%10)+'0'; _n_val/=10;} if(_neg_val && _val != INT32_MIN) *--tp_val = '-';} \
-         my_strcat(fail_msg_buf, tp_val); \
+         snprintf(fail_msg_buf, sizeof(fail_msg_buf), "%s: Expected %d, Got %d", \
+                  (const char *)(detail_label_prefix), _exp, _val); \
          TC_RESULT_MSG(_cond, fail_msg_buf); \
      } else { \
          TC_RESULT_MSG(_cond, NULL); \
@@ -264,6 +232,8 @@
  #define TC_EXPECT_TRUE(cond, msg_on_fail) TC_RESULT_MSG(cond, msg_on_fail)
  
  
+ #include "../lib/vvar.h"  /* Needs uint32_t/uint64_t from above. */
+
  /* ==== Individual Test Cases ============================================== */
  
  /*
@@ -276,20 +246,449 @@
      TC_START("sys_getpid returns a non-negative PID");
      pid_t pid = sys_getpid();
      bool cond = (pid >= 0); /* PID 0 is valid (e.g. idle/kernel) */
-     if (!cond) { my_strcpy(fail_msg_buf, "PID was negative!"); }
-     else { /* Construct pass message with PID value */
-         my_strcpy(fail_msg_buf, " (Note: PID is ");
-         char temp_pid_buf[12]; char *tp_pid = temp_pid_buf+11; *tp_pid = '\0';
-         if(pid == 0) *--tp_pid = '0'; else { uint32_t _p = (uint32_t)pid; while(_p>0) {*--tp_pid=(_p%10)+'0'; _p/=10;} }
-         my_strcat(fail_msg_buf, tp_pid);
-         my_strcat(fail_msg_buf, ")");
-     }
+     if (!cond) { strcpy(fail_msg_buf, "PID was negative!"); }
+     else { snprintf(fail_msg_buf, sizeof(fail_msg_buf), " (Note: PID is %d)", pid); } /* Pass message with PID value */
      /* Report PASS/FAIL. Only print custom message on failure. */
      TC_RESULT_MSG(cond, cond ? NULL : fail_msg_buf);
      if (cond) print_str(fail_msg_buf); /* Print PID note on pass */
      print_nl();
  }
  
+ /*
+  * Tests the vvar pages: the PID and clock read without a syscall must agree
+  * with what the kernel reports through syscalls.
+  */
+ void test_vvar() {
+     print_str("\n--- vvar Tests ---\n");
+     TC_START("vvar PID matches sys_getpid");
+     TC_EXPECT_EQ_DETAIL((int32_t)vvar_getpid(), sys_getpid(), "vvar_getpid");
+
+     TC_START("vvar clock is monotonic");
+     uint64_t t0 = vvar_clock_ns();
+     uint64_t t1 = vvar_clock_ns();
+     TC_EXPECT_TRUE(t1 >= t0, "vvar_clock_ns went backwards");
+ }
+
+ /* Mirrors struct pollfd in the kernel's poll.h. */
+ struct pollfd { int32_t fd; int16_t events; int16_t revents; };
+ #define POLLIN   0x0001
+ #define POLLOUT  0x0004
+ #define POLLNVAL 0x0020
+
+ /*
+  * Tests sys_poll without blocking: the terminal is writable, a closed fd is
+  * reported per entry, and negative fds are skipped.
+  */
+ void test_poll() {
+     print_str("\n--- poll Tests ---\n");
+     struct pollfd pfd[3] = {
+         { 1, POLLOUT, 0 },
+         { 57, POLLIN, 0 },
+         { -1, POLLIN, 0 },
+     };
+     TC_START("poll with timeout 0 counts ready entries");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_POLL, (int32_t)pfd, 3, 0), 2, "sys_poll");
+
+     TC_START("poll reports POLLOUT, POLLNVAL and skips fd -1");
+     TC_EXPECT_TRUE(pfd[0].revents == POLLOUT && pfd[1].revents == POLLNVAL && pfd[2].revents == 0,
+                    "unexpected revents");
+ }
+
+ #define TTY_NONBLOCK 0x04
+
+ /*
+  * Tests SYS_TTY_MODE: with TTY_NONBLOCK a read of the (idle) terminal fails
+  * with EAGAIN instead of waiting for a key, and unknown mode bits are refused.
+  */
+ void test_tty() {
+     print_str("\n--- TTY Tests ---\n");
+     char buf[8];
+     int32_t old = syscall(SYS_TTY_MODE, -1, 0, 0);
+     TC_START("SYS_TTY_MODE queries the mode");
+     TC_EXPECT_TRUE(old >= 0, "sys_tty_mode query");
+     if (old < 0) return;
+
+     TC_START("Non-blocking read of fd 0 without input");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_TTY_MODE, old | TTY_NONBLOCK, 0, 0), old, "sys_tty_mode set");
+     TC_EXPECT_EQ_DETAIL(sys_read(0, buf, sizeof(buf)), NEG_EAGAIN, "sys_read of the terminal");
+     syscall(SYS_TTY_MODE, old, 0, 0);
+
+     TC_START("SYS_TTY_MODE refuses unknown bits");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_TTY_MODE, 0x100, 0, 0), NEG_EINVAL, "sys_tty_mode bad bits");
+ }
+
+ typedef struct {
+     uint32_t vector, count, reserved[2];
+     uint64_t total_cycles, max_cycles;
+ } irq_stats_t;
+
+ #define IRQ_PIT_VECTOR   32
+ #define IRQ_LAPIC_TIMER  0xF0
+
+ /*
+  * Tests SYS_IRQ_STATS: the timer has ticked by now on one of its two
+  * vectors (PIT IRQ0 before the APIC timer takes over), and vectors past
+  * 255 are refused.
+  */
+ void test_irq_stats() {
+     print_str("\n--- IRQ Stats Tests ---\n");
+     irq_stats_t pit, lapic;
+     TC_START("SYS_IRQ_STATS copies the record");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_IRQ_STATS, IRQ_PIT_VECTOR, (int32_t)&pit, sizeof(pit)),
+                         (int32_t)sizeof(pit), "sys_irq_stats PIT");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_IRQ_STATS, IRQ_LAPIC_TIMER, (int32_t)&lapic, sizeof(lapic)),
+                         (int32_t)sizeof(lapic), "sys_irq_stats LAPIC timer");
+
+     TC_START("The timer vector has been counted");
+     TC_EXPECT_TRUE(pit.vector == IRQ_PIT_VECTOR && pit.count + lapic.count > 0, "no timer interrupts counted");
+
+     TC_START("SYS_IRQ_STATS refuses vector 256");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_IRQ_STATS, 256, (int32_t)&pit, sizeof(pit)), NEG_EINVAL, "sys_irq_stats bad vector");
+ }
+
+ typedef struct {
+     uint32_t eip, pid;
+     uint8_t cpu, cpl;
+     uint16_t reserved;
+ } profile_sample_t;
+
+ #define PROFILE_START 0
+ #define PROFILE_STOP  1
+ #define PROFILE_READ  2
+
+ /*
+  * Tests SYS_PROFILE: sampling every tick while this process spins yields
+  * whole samples, and a period of 0 is refused.
+  */
+ void test_profile() {
+     print_str("\n--- Profiler Tests ---\n");
+     profile_sample_t samples[8];
+     TC_START("SYS_PROFILE refuses period 0");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_PROFILE, PROFILE_START, 0, 0), NEG_EINVAL, "sys_profile start 0");
+
+     TC_START("SYS_PROFILE samples a busy loop");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_PROFILE, PROFILE_START, 1, 0), 0, "sys_profile start");
+     int32_t got = 0;
+     for (int tries = 0; tries < 1000 && got == 0; tries++) {
+         for (volatile int spin = 0; spin < 100000; spin++) { }
+         got = syscall(SYS_PROFILE, PROFILE_READ, (int32_t)samples, sizeof(samples));
+     }
+     syscall(SYS_PROFILE, PROFILE_STOP, 0, 0);
+     TC_EXPECT_TRUE(got > 0 && got % (int32_t)sizeof(profile_sample_t) == 0, "no whole samples read");
+     TC_EXPECT_TRUE(got <= 0 || samples[0].cpl == 0 || samples[0].cpl == 3, "bad sample CPL");
+ }
+
+ #define PERF_QUERY 0
+ #define PERF_SET   1
+ #define PERF_READ  2
+ #define PERF_CLOSE 4
+ #define PERF_EVENT_INSTRUCTIONS 2
+
+ /*
+  * Tests SYS_PERF: without a PMU (QEMU's TCG has none) counters are refused
+  * with ENODEV; with one, a loop retires instructions and counts them.
+  */
+ void test_perf() {
+     print_str("\n--- Perf Counter Tests ---\n");
+     int32_t slots = syscall(SYS_PERF, PERF_QUERY, 0, 0);
+     TC_START("SYS_PERF reports its counter slots");
+     TC_EXPECT_TRUE(slots >= 0, "sys_perf query");
+     if (slots <= 0) {
+         TC_START("SYS_PERF refuses counters without a PMU");
+         TC_EXPECT_EQ_DETAIL(syscall(SYS_PERF, PERF_SET, 0, PERF_EVENT_INSTRUCTIONS), NEG_ENODEV, "sys_perf set");
+         return;
+     }
+
+     TC_START("SYS_PERF counts retired instructions");
+     uint64_t count = 0;
+     int32_t set = syscall(SYS_PERF, PERF_SET, 0, PERF_EVENT_INSTRUCTIONS);
+     TC_EXPECT_TRUE(set == 0 || set == NEG_ENODEV, "sys_perf set");
+     if (set == 0) {
+         for (volatile int spin = 0; spin < 10000; spin++) { }
+         TC_EXPECT_EQ_DETAIL(syscall(SYS_PERF, PERF_READ, (int32_t)&count, sizeof(count)), (int32_t)sizeof(count), "sys_perf read");
+         TC_EXPECT_TRUE(count >= 10000, "too few instructions counted");
+     }
+     syscall(SYS_PERF, PERF_CLOSE, 0, 0);
+ }
+
+ #define TRACEPOINT_ENABLE 0
+ #define TRACEPOINT_DUMP   1
+ #define TRACEPOINT_ALL    0x3FF
+
+ /*
+  * Tests SYS_TRACEPOINT: the enable call hands back the previous mask, and
+  * an open traced in between dumps (to serial) without error.
+  */
+ void test_tracepoints() {
+     print_str("\n--- Tracepoint Tests ---\n");
+     int32_t old = syscall(SYS_TRACEPOINT, TRACEPOINT_ENABLE, TRACEPOINT_ALL, 0);
+     TC_START("SYS_TRACEPOINT enables every tracepoint");
+     TC_EXPECT_TRUE(old >= 0, "sys_tracepoint enable");
+     if (old < 0) return;
+
+     int32_t fd = sys_open("/no_such_file.txt", O_RDONLY, 0);
+     if (fd >= 0) sys_close(fd);
+     TC_START("SYS_TRACEPOINT dumps and restores the mask");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_TRACEPOINT, TRACEPOINT_DUMP, 0, 0), 0, "sys_tracepoint dump");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_TRACEPOINT, TRACEPOINT_ENABLE, old, 0), TRACEPOINT_ALL, "sys_tracepoint restore");
+
+     TC_START("SYS_TRACEPOINT refuses unknown ops");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_TRACEPOINT, 7, 0, 0), NEG_EINVAL, "sys_tracepoint bad op");
+ }
+
+ /*
+  * Tests /proc: a stats file reads back as "key: value" text, and writing
+  * to it is refused.
+  */
+ void test_procfs() {
+     print_str("\n--- Procfs Tests ---\n");
+     char buf[64];
+     TC_START("/proc/meminfo reads back as text");
+     int32_t fd = sys_open("/proc/meminfo", O_RDONLY, 0);
+     TC_EXPECT_TRUE(fd >= 0, "sys_open /proc/meminfo failed");
+     if (fd < 0) return;
+     ssize_t n = sys_read(fd, buf, sizeof(buf) - 1);
+     sys_close(fd);
+     TC_EXPECT_TRUE(n > 0 && buf[0] == 'B', "unexpected /proc/meminfo contents");
+
+     TC_START("/proc/faults counts this process' faults");
+     fd = sys_open("/proc/faults", O_RDONLY, 0);
+     n = fd >= 0 ? sys_read(fd, buf, sizeof(buf) - 1) : -1;
+     if (fd >= 0) sys_close(fd);
+     TC_EXPECT_TRUE(n > 0 && buf[0] == 'p', "unexpected /proc/faults contents");
+
+     TC_START("/proc/buddyinfo reports pageblock mobility groups");
+     fd = sys_open("/proc/buddyinfo", O_RDONLY, 0);
+     n = fd >= 0 ? sys_read(fd, buf, sizeof(buf) - 1) : -1;
+     if (fd >= 0) sys_close(fd);
+     TC_EXPECT_TRUE(n > 11 && buf[0] == 'p' && buf[4] == 'b' && buf[10] == ':', "unexpected /proc/buddyinfo contents");
+
+     TC_START("/proc/swaps names the swap device");
+     fd = sys_open("/proc/swaps", O_RDONLY, 0);
+     n = fd >= 0 ? sys_read(fd, buf, sizeof(buf) - 1) : -1;
+     if (fd >= 0) sys_close(fd);
+     TC_EXPECT_TRUE(n > 8 && buf[0] == 'd' && buf[6] == ':', "unexpected /proc/swaps contents");
+
+     TC_START("/proc files cannot be opened for writing");
+     fd = sys_open("/proc/sched", O_WRONLY, 0);
+     if (fd >= 0) sys_close(fd);
+     TC_EXPECT_TRUE(fd < 0, "sys_open /proc/sched for write succeeded");
+ }
+
+ /*
+  * Tests sys_pipe within one process: data comes out in order, poll sees it,
+  * the reader gets EOF once the writer closes, and a write without a reader
+  * fails with EPIPE.
+  */
+ void test_pipe() {
+     print_str("\n--- Pipe Tests ---\n");
+     int fds[2] = { -1, -1 };
+     char buf[16];
+     TC_START("sys_pipe creates two descriptors");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_PIPE, (int32_t)fds, 0, 0), 0, "sys_pipe");
+     if (fds[0] < 0 || fds[1] < 0) return;
+
+     TC_START("Write then read through the pipe");
+     sys_write(fds[1], "pipe", 4);
+     sys_write(fds[1], "line", 4);
+     struct pollfd pfd = { fds[0], POLLIN, 0 };
+     int32_t ready = syscall(SYS_POLL, (int32_t)&pfd, 1, 0);
+     ssize_t n = sys_read(fds[0], buf, sizeof(buf));
+     TC_EXPECT_TRUE(ready == 1 && n == 8 && buf[0] == 'p' && buf[4] == 'l' && buf[7] == 'e', "pipe data mismatch");
+
+     TC_START("Read after the writer closes returns EOF");
+     sys_close(fds[1]);
+     TC_EXPECT_EQ_DETAIL(sys_read(fds[0], buf, sizeof(buf)), 0, "sys_read at EOF");
+     sys_close(fds[0]);
+
+     TC_START("Write without a reader fails with EPIPE");
+     if (syscall(SYS_PIPE, (int32_t)fds, 0, 0) == 0) {
+         sys_close(fds[0]);
+         TC_EXPECT_EQ_DETAIL(sys_write(fds[1], "x", 1), NEG_EPIPE, "sys_write to a pipe without readers");
+         sys_close(fds[1]);
+     } else {
+         TC_RESULT_MSG(false, "second sys_pipe failed");
+     }
+ }
+ 
+ /* Mirrors mmap_args_t and the PROT_/MAP_ bits in the kernel's mm.h. */
+ struct mmap_args { uint32_t addr, length, prot, flags; int32_t fd; uint32_t offset; };
+ #define PROT_READ   0x1
+ #define PROT_WRITE  0x2
+ #define MAP_SHARED  0x01
+ 
+ static volatile char *shm_map(int fd) {
+     struct mmap_args args = { 0, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 };
+     int32_t addr = syscall(SYS_MMAP, (int32_t)&args, 0, 0);
+     return (addr < 0 && addr > -4096) ? (volatile char *)0 : (volatile char *)addr;
+ }
+ 
+ /*
+  * Tests shared memory: two mappings of one object see each other's writes,
+  * O_EXCL refuses an existing name, and the name goes away on unlink.
+  */
+ void test_shm() {
+     print_str("\n--- Shared Memory Tests ---\n");
+     const char *name = "/hello_shm";
+     TC_START("shm_open creates an object");
+     int fd = syscall(SYS_SHM_OPEN, (int32_t)name, O_CREAT | O_EXCL | O_RDWR, 4096);
+     TC_EXPECT_TRUE(fd >= 0, "sys_shm_open create failed");
+     if (fd < 0) return;
+ 
+     TC_START("Two mappings share the same page");
+     volatile char *a = shm_map(fd);
+     volatile char *b = shm_map(fd);
+     if (a && b) {
+         a[0] = 'S';
+         a[4095] = 'M';
+         TC_EXPECT_TRUE(a != b && b[0] == 'S' && b[4095] == 'M', "write not visible through second mapping");
+     } else {
+         TC_RESULT_MSG(false, "mmap of the shm fd failed");
+     }
+ 
+     TC_START("O_EXCL on an existing name fails");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_SHM_OPEN, (int32_t)name, O_CREAT | O_EXCL | O_RDWR, 4096), NEG_EEXIST,
+                         "sys_shm_open O_EXCL");
+ 
+     TC_START("Unlink removes the name");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_SHM_UNLINK, (int32_t)name, 0, 0), 0, "sys_shm_unlink");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_SHM_OPEN, (int32_t)name, O_RDWR, 0), NEG_ENOENT, "sys_shm_open after unlink");
+     sys_close(fd);
+ }
+
+ #define MAP_PRIVATE   0x02
+ #define MAP_ANONYMOUS 0x20
+ #define LARGE_PAGE    0x400000u
+
+ /*
+  * Tests a large anonymous mapping, which the kernel may back with 4MB
+  * pages: every page reads back, and unmapping one 4KB page inside an
+  * aligned 4MB run (a split) leaves its neighbours intact.
+  */
+ void test_large_mmap() {
+     print_str("\n--- Large Anonymous Mapping Tests ---\n");
+     TC_START("12MB anonymous mapping is zeroed and writable");
+     struct mmap_args args = { 0, 3 * LARGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 };
+     int32_t addr = syscall(SYS_MMAP, (int32_t)&args, 0, 0);
+     if (addr < 0 && addr > -4096) {
+         TC_RESULT_MSG(false, "mmap failed");
+         return;
+     }
+     /* At least one whole aligned 4MB run lies inside */
+     volatile uint32_t *run = (volatile uint32_t *)(((uint32_t)addr + LARGE_PAGE - 1) & ~(LARGE_PAGE - 1));
+     bool ok = true;
+     for (uint32_t i = 0; i < LARGE_PAGE / 4; i += 1024) {
+         if (run[i] != 0) ok = false;
+         run[i] = i;
+     }
+     for (uint32_t i = 0; i < LARGE_PAGE / 4; i += 1024) {
+         if (run[i] != i) ok = false;
+     }
+     TC_EXPECT_TRUE(ok, "large mapping contents wrong");
+
+     TC_START("Unmapping one page inside a 4MB run keeps the rest");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_MUNMAP, (int32_t)(run + 1024 * 100), 4096, 0), 0, "sys_munmap");
+     ok = true;
+     for (uint32_t i = 0; i < LARGE_PAGE / 4; i += 1024) {
+         if (i != 1024 * 100 && run[i] != i) ok = false;
+     }
+     TC_EXPECT_TRUE(ok, "neighbouring pages changed after the split");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_MUNMAP, addr, 3 * LARGE_PAGE, 0), 0, "sys_munmap of the whole mapping");
+ }
+
+ #define FUTEX_WAIT 0
+ #define FUTEX_WAKE 1
+
+ /*
+  * Tests the futex paths that do not sleep: a wait on a word that already
+  * changed returns at once, and a wake with no sleepers wakes none.
+  */
+ void test_futex() {
+     print_str("\n--- Futex Tests ---\n");
+     static volatile uint32_t word = 1;
+     TC_START("FUTEX_WAIT on a changed word returns EAGAIN");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_FUTEX, (int32_t)&word, FUTEX_WAIT, 0), NEG_EAGAIN, "futex wait");
+
+     TC_START("FUTEX_WAKE without sleepers wakes none");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_FUTEX, (int32_t)&word, FUTEX_WAKE, 1), 0, "futex wake");
+
+     TC_START("Unaligned futex word is rejected");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_FUTEX, (int32_t)&word + 1, FUTEX_WAKE, 1), NEG_EINVAL, "futex unaligned");
+ }
+
+ static volatile uint32_t thread_flag = 0;
+ static uint8_t thread_stack[4096] __attribute__((aligned(16)));
+
+ /* Runs as a second thread: publishes its argument and wakes the waiter. */
+ static void thread_entry(uint32_t arg) {
+     thread_flag = arg;
+     syscall(SYS_FUTEX, (int32_t)&thread_flag, FUTEX_WAKE, 1);
+     syscall(SYS_EXIT, 0, 0, 0); /* Ends this thread only */
+ }
+
+ /*
+  * Tests SYS_THREAD_CREATE: the thread shares our memory, so the main
+  * thread sleeps on the flag word until the thread stores to it.
+  */
+ void test_threads() {
+     print_str("\n--- Thread Tests ---\n");
+     TC_START("SYS_THREAD_CREATE starts a thread sharing memory");
+     int32_t tid = syscall(SYS_THREAD_CREATE, (int32_t)thread_entry,
+                           (int32_t)(thread_stack + sizeof(thread_stack)), 42);
+     if (tid <= 0) {
+         TC_EXPECT_EQ_DETAIL(tid > 0, 1, "thread create");
+         return;
+     }
+     while (thread_flag == 0) {
+         syscall(SYS_FUTEX, (int32_t)&thread_flag, FUTEX_WAIT, 0);
+     }
+     TC_EXPECT_EQ_DETAIL(thread_flag, 42, "thread flag");
+ }
+
+ /* Mirrors the kernel's spawn_args_t and spawn_fd_action_t (process.h). */
+ typedef struct { uint32_t path, argv, envp, fd_actions, nr_fd_actions; } spawn_args_t;
+ typedef struct { uint32_t op; int32_t fd, newfd; } spawn_fd_action_t;
+ #define SPAWN_FD_DUP2 1
+ #define SPAWNED_ARG       "--spawned"
+ #define SPAWNED_EXIT_CODE 7
+
+ /*
+  * Tests SYS_SPAWN by starting this program again with SPAWNED_ARG, which
+  * makes main() return SPAWNED_EXIT_CODE at once, and reaping the child.
+  */
+ void test_spawn(const char *self) {
+     print_str("\n--- Spawn Tests ---\n");
+     const char *argv[] = { "hello", SPAWNED_ARG, NULL };
+     spawn_args_t args = { (uint32_t)self, (uint32_t)argv, 0, 0, 0 };
+
+     TC_START("SYS_SPAWN runs a child with arguments");
+     int32_t pid = syscall(SYS_SPAWN, (int32_t)&args, 0, 0);
+     if (pid <= 0) {
+         TC_EXPECT_EQ_DETAIL(pid > 0, 1, "spawn");
+     } else {
+         int status = -1;
+         TC_EXPECT_EQ_DETAIL(syscall(SYS_WAITPID, pid, (int32_t)&status, 0), pid, "waitpid spawned child");
+         TC_EXPECT_EQ_DETAIL(status, SPAWNED_EXIT_CODE << 8, "spawned child exit status");
+     }
+
+     /* The kernel built this program's snapshot when it launched us; the child came from it. */
+     TC_START("Spawned child started from the program snapshot");
+     char buf[64];
+     int32_t fd = sys_open("/proc/snapshots", O_RDONLY, 0);
+     TC_EXPECT_TRUE(fd >= 0, "sys_open /proc/snapshots failed");
+     if (fd >= 0) {
+         ssize_t n = sys_read(fd, buf, sizeof(buf) - 1);
+         sys_close(fd);
+         TC_EXPECT_TRUE(n > 6 && memcmp(buf, "hits: ", 6) == 0 && buf[6] != '0', "no snapshot hits in /proc/snapshots");
+     }
+
+     TC_START("SYS_SPAWN fails on a bad file action");
+     spawn_fd_action_t bad = { SPAWN_FD_DUP2, 1000, 3 };
+     args.fd_actions = (uint32_t)&bad;
+     args.nr_fd_actions = 1;
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_SPAWN, (int32_t)&args, 0, 0), NEG_EBADF, "spawn with dup2 of a closed fd");
+ }
+
  /*
   * Tests core file operations: create, write, close, re-open, read, verify, append.
   * Uses `testfile1.txt`.
@@ -302,8 +701,8 @@
      char read_buf[128]; /* Sufficiently large buffer for reading content. */
      int fd = -1;
      ssize_t ret_s;
-     size_t content1_len = my_strlen(CONTENT1);
-     size_t content2_len = my_strlen(CONTENT2);
+     size_t content1_len = strlen(CONTENT1);
+     size_t content2_len = strlen(CONTENT2);
  
      /* Test 1: Create a new file, write initial content, and close it. */
      TC_START("Create, Write, Close");
@@ -323,14 +722,14 @@
      TC_EXPECT_TRUE(fd >= 0, "sys_open for read failed");
      if (fd < 0) return;
  
-     my_memset(read_buf, 0, sizeof(read_buf)); /* Clear buffer before read. */
+     memset(read_buf, 0, sizeof(read_buf)); /* Clear buffer before read. */
      ret_s = sys_read(fd, read_buf, content1_len);
      TC_EXPECT_EQ_DETAIL(ret_s, (ssize_t)content1_len, "sys_read full content");
      if (ret_s == (ssize_t)content1_len) {
-         TC_EXPECT_EQ_DETAIL(my_strcmp(read_buf, CONTENT1), 0, "Content verification");
+         TC_EXPECT_EQ_DETAIL(strcmp(read_buf, CONTENT1), 0, "Content verification");
      }
      /* Attempt to read past the End-Of-File. Should return 0 bytes read. */
-     my_memset(read_buf, 0, sizeof(read_buf));
+     memset(read_buf, 0, sizeof(read_buf));
      ret_s = sys_read(fd, read_buf, 10);
      TC_EXPECT_EQ_DETAIL(ret_s, 0, "sys_read past EOF should return 0");
  
@@ -357,7 +756,7 @@
      TC_EXPECT_TRUE(fd >= 0, "sys_open for append verification failed");
      if (fd < 0) return;
  
-     my_memset(read_buf, 0, sizeof(read_buf));
+     memset(read_buf, 0, sizeof(read_buf));
      size_t total_len = content1_len + content2_len;
      ret_s = sys_read(fd, read_buf, total_len);
      TC_EXPECT_EQ_DETAIL(ret_s, (ssize_t)total_len, "sys_read appended content length");
@@ -365,13 +764,36 @@
      if (ret_s == (ssize_t)total_len) {
          /* Construct expected full content. */
          char expected_total_content[64]; /* Ensure buffer is large enough. */
-         my_strcpy(expected_total_content, CONTENT1);
-         my_strcat(expected_total_content, CONTENT2);
-         TC_EXPECT_EQ_DETAIL(my_strcmp(read_buf, expected_total_content), 0, "Appended content verification");
+         strcpy(expected_total_content, CONTENT1);
+         strcat(expected_total_content, CONTENT2);
+         TC_EXPECT_EQ_DETAIL(strcmp(read_buf, expected_total_content), 0, "Appended content verification");
      }
      ret_s = sys_close(fd);
      TC_EXPECT_EQ_DETAIL(ret_s, 0, "sys_close after append verification");
      fd = -1;
+
+     /* Test 5: Sync a file after appending to it; the terminal and bad fds cannot be synced. */
+     TC_START("Fsync / fdatasync (SYS_FSYNC, SYS_FDATASYNC)");
+     fd = sys_open(FNAME1, O_WRONLY | O_APPEND, 0);
+     TC_EXPECT_TRUE(fd >= 0, "sys_open for fsync failed");
+     if (fd >= 0) {
+         ret_s = sys_write(fd, CONTENT2, content2_len);
+         TC_EXPECT_EQ_DETAIL(ret_s, (ssize_t)content2_len, "sys_write before fsync");
+         TC_EXPECT_EQ_DETAIL(syscall(SYS_FSYNC, fd, 0, 0), 0, "sys_fsync");
+         TC_EXPECT_EQ_DETAIL(syscall(SYS_FDATASYNC, fd, 0, 0), 0, "sys_fdatasync with nothing new");
+         sys_close(fd);
+         fd = -1;
+     }
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_FSYNC, 1, 0, 0), NEG_EINVAL, "sys_fsync on the terminal");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_FSYNC, 99, 0, 0), NEG_EBADF, "sys_fsync on a bad fd");
+
+     /* Test 6: Remove the file; it can no longer be opened or removed again. */
+     TC_START("Unlink (SYS_UNLINK)");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_UNLINK, (int32_t)(uintptr_t)FNAME1, 0, 0), 0, "sys_unlink");
+     fd = sys_open(FNAME1, O_RDONLY, 0);
+     if (fd >= 0) sys_close(fd);
+     TC_EXPECT_EQ_DETAIL(fd, NEG_ENOENT, "sys_open after unlink");
+     TC_EXPECT_EQ_DETAIL(syscall(SYS_UNLINK, (int32_t)(uintptr_t)FNAME1, 0, 0), NEG_ENOENT, "sys_unlink twice");
  }
  
  /*
@@ -392,18 +814,18 @@
      fd = sys_open(FNAME_LSEEK, O_CREAT | O_RDWR | O_TRUNC, DEFAULT_MODE);
      TC_EXPECT_TRUE(fd >= 0, "lseek test: sys_open for setup failed");
      if (fd < 0) return;
-     ret_s = sys_write(fd, DATA1, my_strlen(DATA1));
-     TC_EXPECT_EQ_DETAIL(ret_s, (ssize_t)my_strlen(DATA1), "lseek test: initial write");
+     ret_s = sys_write(fd, DATA1, strlen(DATA1));
+     TC_EXPECT_EQ_DETAIL(ret_s, (ssize_t)strlen(DATA1), "lseek test: initial write");
  
      /* Test 1: SEEK_SET - Seek to a specific offset from the beginning. */
      TC_START("lseek with SEEK_SET");
      ret_o = sys_lseek(fd, 5, SEEK_SET); /* Seek to offset 5 (to '5'). */
      TC_EXPECT_EQ_DETAIL(ret_o, 5, "lseek SEEK_SET to 5");
-     my_memset(buf, 0, sizeof(buf));
+     memset(buf, 0, sizeof(buf));
      ret_s = sys_read(fd, buf, 3); /* Read "567". */
      TC_EXPECT_EQ_DETAIL(ret_s, 3, "lseek test: read after SEEK_SET");
      if (ret_s == 3) {
-         TC_EXPECT_EQ_DETAIL(my_strcmp(buf, "567"), 0, "lseek test: content after SEEK_SET");
+         TC_EXPECT_EQ_DETAIL(strcmp(buf, "567"), 0, "lseek test: content after SEEK_SET");
      }
  
      /* Test 2: SEEK_CUR - Seek relative to the current position. */
@@ -411,11 +833,11 @@
      /* Current position is 5 (start of "567") + 3 (bytes read) = 8. */
      ret_o = sys_lseek(fd, -2, SEEK_CUR); /* Seek back 2 bytes to offset 6 (to '6'). */
      TC_EXPECT_EQ_DETAIL(ret_o, 6, "lseek SEEK_CUR to 6");
-     my_memset(buf, 0, sizeof(buf));
+     memset(buf, 0, sizeof(buf));
      ret_s = sys_read(fd, buf, 2); /* Read "67". */
      TC_EXPECT_EQ_DETAIL(ret_s, 2, "lseek test: read after SEEK_CUR");
      if (ret_s == 2) {
-         TC_EXPECT_EQ_DETAIL(my_strcmp(buf, "67"), 0, "lseek test: content after SEEK_CUR");
+         TC_EXPECT_EQ_DETAIL(strcmp(buf, "67"), 0, "lseek test: content after SEEK_CUR");
      }
  
      /* Test 3: SEEK_END - Seek relative to the end of the file. */
@@ -430,24 +852,24 @@
      TC_START("lseek write after SEEK_END");
      ret_o = sys_lseek(fd, 0, SEEK_END); /* Ensure at end of file (offset 10). */
      TC_EXPECT_EQ_DETAIL(ret_o, 10, "lseek SEEK_END before extend");
-     ret_s = sys_write(fd, DATA2, my_strlen(DATA2)); /* Write "XYZ". */
-     TC_EXPECT_EQ_DETAIL(ret_s, (ssize_t)my_strlen(DATA2), "lseek test: write to extend file");
+     ret_s = sys_write(fd, DATA2, strlen(DATA2)); /* Write "XYZ". */
+     TC_EXPECT_EQ_DETAIL(ret_s, (ssize_t)strlen(DATA2), "lseek test: write to extend file");
  
-     size_t expected_new_size = my_strlen(DATA1) + my_strlen(DATA2); /* 10 + 3 = 13. */
+     size_t expected_new_size = strlen(DATA1) + strlen(DATA2); /* 10 + 3 = 13. */
      ret_o = sys_lseek(fd, 0, SEEK_END); /* Check new file size. */
      TC_EXPECT_EQ_DETAIL(ret_o, (off_t)expected_new_size, "lseek test: new file size after extend");
  
      /* Verify the extended content. */
      ret_o = sys_lseek(fd, 0, SEEK_SET); /* Seek to start for full read. */
      TC_EXPECT_EQ_DETAIL(ret_o, 0, "lseek test: seek to start for verification");
-     my_memset(buf, 0, sizeof(buf));
+     memset(buf, 0, sizeof(buf));
      ret_s = sys_read(fd, buf, sizeof(buf)-1); /* Read up to buffer capacity. */
      TC_EXPECT_EQ_DETAIL(ret_s, (ssize_t)expected_new_size, "lseek test: read full extended content");
      if (ret_s == (ssize_t)expected_new_size) {
          char expected_content[32];
-         my_strcpy(expected_content, DATA1);
-         my_strcat(expected_content, DATA2); /* Expected: "0123456789XYZ" */
-         TC_EXPECT_EQ_DETAIL(my_strcmp(buf, expected_content), 0, "lseek test: verify extended content");
+         strcpy(expected_content, DATA1);
+         strcat(expected_content, DATA2); /* Expected: "0123456789XYZ" */
+         TC_EXPECT_EQ_DETAIL(strcmp(buf, expected_content), 0, "lseek test: verify extended content");
      }
  
      ret_s = sys_close(fd);
@@ -482,6 +904,15 @@
      fd = sys_open("/exist_test.txt", O_CREAT | O_EXCL, DEFAULT_MODE);
      TC_EXPECT_EQ_DETAIL(fd, NEG_EEXIST, "sys_open O_EXCL on existing (expected -EEXIST)");
      if (fd >= 0) sys_close(fd); fd = -1;
+
+     /* "." and ".." resolve by name, also across a mount point. */
+     TC_START("Open with . and .. components");
+     fd = sys_open("/no_dir/.././/exist_test.txt", O_RDONLY, 0);
+     TC_EXPECT_TRUE(fd >= 0, "sys_open /no_dir/.././/exist_test.txt failed");
+     if (fd >= 0) sys_close(fd);
+     fd = sys_open("/proc/../proc/./meminfo", O_RDONLY, 0);
+     TC_EXPECT_TRUE(fd >= 0, "sys_open /proc/../proc/./meminfo failed");
+     if (fd >= 0) sys_close(fd); fd = -1;
  
      /* Test operations on invalid file descriptors. Expect -EBADF. */
      TC_START("Write to invalid FD (-1)");
@@ -531,15 +962,108 @@
  }
  
  
+ /*
+  * Tests the userspace stdio: snprintf formatting and truncation, and that a
+  * fully buffered file stream keeps its data until fflush.
+  */
+ void test_stdio() {
+     print_str("\n--- stdio Tests ---\n");
+     char buf[32];
+     TC_START("snprintf formats width, padding and hex");
+     int n = snprintf(buf, sizeof(buf), "[%5d|%-3s|%04x]", -42, "ab", 0xBEEFu);
+     TC_EXPECT_EQ_DETAIL(n == 16 && strcmp(buf, "[  -42|ab |beef]") == 0, 1, "snprintf output");
+ 
+     TC_START("snprintf truncates but returns the full length");
+     n = snprintf(buf, 8, "%s", "0123456789");
+     TC_EXPECT_EQ_DETAIL(n == 10 && strcmp(buf, "0123456") == 0, 1, "snprintf truncation");
+ 
+     TC_START("File stream holds its data until fflush");
+     FILE *f = fopen("/stdio_test.txt", "w");
+     TC_EXPECT_TRUE(f != NULL, "fopen failed");
+     if (!f) return;
+     fprintf(f, "line %d\n", 1);
+     int32_t fd = sys_open("/stdio_test.txt", O_RDONLY, 0);
+     memset(buf, 0, sizeof(buf));
+     ssize_t before = fd >= 0 ? sys_read(fd, buf, sizeof(buf) - 1) : -1;
+     fflush(f);
+     ssize_t after = fd >= 0 ? sys_read(fd, buf, sizeof(buf) - 1) : -1;
+     TC_EXPECT_EQ_DETAIL(before == 0 && after == 7 && strcmp(buf, "line 1\n") == 0, 1, "buffered fprintf");
+     if (fd >= 0) sys_close(fd);
+     fclose(f);
+     syscall(SYS_UNLINK, (int32_t)(uintptr_t)"/stdio_test.txt", 0, 0);
+ }
+ 
+ 
+ /*
+  * Tests the userspace heap: a freed object is reused without a new mapping,
+  * large requests get their own, calloc zeroes, and trimming unmaps empty spans.
+  */
+ void test_malloc() {
+     print_str("\n--- malloc Tests ---\n");
+     malloc_stats_t st;
+     TC_START("Small malloc/free reuses the span without SYS_MMAP");
+     char *a = malloc(40);
+     malloc_get_stats(&st);
+     uint32_t maps = st.map_calls;
+     free(a);
+     char *b = malloc(40);
+     char *c = malloc(33); /* Same 48-byte class */
+     malloc_get_stats(&st);
+     TC_EXPECT_EQ_DETAIL(a != NULL && b == a && c != NULL && c != b && st.map_calls == maps, 1, "small reuse");
+     free(b);
+     free(c);
+ 
+     TC_START("Large malloc is aligned and writable");
+     char *big = malloc(100000);
+     bool ok = big != NULL && ((uintptr_t)big & (MALLOC_ALIGN - 1)) == 0 && malloc_usable_size(big) >= 100000;
+     if (ok) { big[0] = 'x'; big[99999] = 'y'; ok = big[0] == 'x' && big[99999] == 'y'; }
+     TC_EXPECT_TRUE(ok, "large allocation unusable");
+ 
+     TC_START("realloc keeps the contents and calloc zeroes");
+     char *r = malloc(16);
+     if (r) strcpy(r, "realloc");
+     r = realloc(r, 5000);
+     uint32_t *z = calloc(256, sizeof(uint32_t));
+     ok = r != NULL && strcmp(r, "realloc") == 0 && z != NULL;
+     for (int i = 0; ok && i < 256; i++) ok = z[i] == 0;
+     TC_EXPECT_TRUE(ok, "realloc/calloc contents wrong");
+     free(r);
+     free(z);
+     free(big);
+ 
+     TC_START("malloc_trim returns the empty spans");
+     malloc_trim(0);
+     malloc_get_stats(&st);
+     TC_EXPECT_EQ_DETAIL(st.cached_spans == 0 && st.large == 0, 1, "trim");
+ }
+ 
+ 
  /* ==== Main Test Runner =================================================== */
  /* Executes all defined test suites and prints a summary. */
- int main(void) {
+ int main(int argc, char **argv) {
+     if (argc > 1 && strcmp(argv[1], SPAWNED_ARG) == 0) return SPAWNED_EXIT_CODE;
      print_str("=== UiAOS Kernel Test Suite v3.9.1 (POSIX Errors) ===\n");
  
      test_pid_syscall();
+     test_vvar();
+     test_poll();
+     test_tty();
+     test_irq_stats();
+     test_profile();
+     test_perf();
+     test_tracepoints();
+     test_procfs();
+     test_pipe();
+     test_shm();
+     test_large_mmap();
+     test_futex();
+     test_threads();
+     test_spawn(argv[0]);
      test_core_file_operations();
      test_lseek_operations();
      test_error_conditions();
+     test_stdio();
+     test_malloc();
      /* Add calls to other test suites here as they are developed. */
  
      print_str("\n--- Test Summary ---\n");
@@ -553,7 +1077,6 @@
          print_str(">>> SOME TESTS FAILED! SEE DETAILS ABOVE. <<<\n");
      }
  
-     /* Exit with status 0 if all passed, 1 if any failed. */
-     sys_exit(tests_failed > 0 ? 1 : 0);
-     return 0; /* Should not be reached due to sys_exit. */
+     /* Exit with status 0 if all passed, 1 if any failed; exit() flushes stdout. */
+     return tests_failed > 0 ? 1 : 0;
  }
\ No newline at end of file
@@ -0,0 +1,292 @@
+/*
+ * Size-class heap for the userspace programs; see malloc.h.
+ *
+ * A span is MALLOC_SPAN_SIZE-aligned, so free() finds the header of any
+ * pointer by masking. Small spans hand out objects from a bump pointer
+ * first and from their free list once objects come back, which leaves
+ * pages nobody asked for untouched (anonymous mappings fault them in on
+ * first use). Large allocations are aligned the same way and carry a
+ * header with LARGE_MAGIC instead.
+ *
+ * There is no thread-local storage (no %gs base) in UiAOS yet, so the
+ * lists are per process behind one futex lock; uncontended, that is two
+ * xchg instructions per call.
+ */
+
+#include <libc/stdint.h>
+#include <libc/stddef.h>
+#include <libc/stdbool.h>
+#include "syscall.h"
+#include "string.h"
+#include "malloc.h"
+
+// Must match the kernel's syscall.h, mm.h and futex.h
+#define SYS_MMAP        25
+#define SYS_MUNMAP      26
+#define SYS_FUTEX       47
+
+#define PROT_READ       0x1
+#define PROT_WRITE      0x2
+#define MAP_PRIVATE     0x02
+#define MAP_ANONYMOUS   0x20
+
+#define FUTEX_WAIT      0
+#define FUTEX_WAKE      1
+
+// Mirrors the kernel's mmap_args_t
+typedef struct { uint32_t addr, length, prot, flags; int32_t fd; uint32_t offset; } mmap_args_t;
+
+#define PAGE_SIZE       4096u
+#define SPAN_MAGIC      0x5350414Eu // "SPAN"
+#define LARGE_MAGIC     0x4C415247u // "LARG"
+#define SPAN_HDR_SIZE   64u         // Objects start here, MALLOC_ALIGN-aligned
+#define LARGE_HDR_SIZE  MALLOC_ALIGN
+
+#define ALIGN_UP(x, a)  (((x) + (a) - 1) & ~((uintptr_t)(a) - 1))
+
+// About 1.5x apart, multiples of MALLOC_ALIGN
+static const uint16_t s_class_size[] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024,
+    1536, 2048, 3072, 4096, 6144, 8192, 12288, 16384,
+};
+#define NR_CLASSES      (sizeof(s_class_size) / sizeof(s_class_size[0]))
+#define SMALL_LUT_MAX   1024        // Sizes up to this map through s_class_of
+
+typedef struct span {
+    uint32_t     magic;         // SPAN_MAGIC or LARGE_MAGIC
+    uint32_t     map_len;       // Large: bytes mapped
+    uint32_t     cls;
+    uint32_t     obj_size;
+    uint32_t     nr_objs;
+    uint32_t     nr_free;       // On the free list plus never handed out
+    void        *free;          // Returned objects, linked through their first word
+    char        *bump;          // Next never-used object
+    struct span *next;          // Class list or the empty-span cache
+    struct span *prev;
+} span_t;
+
+static span_t *s_partial[NR_CLASSES];   // Spans with a free object, per class
+static span_t *s_empty;                 // Empty spans kept for reuse
+static uint8_t s_class_of[SMALL_LUT_MAX / MALLOC_ALIGN + 1];
+static bool s_lut_ready;
+static malloc_stats_t s_stats;
+
+/* --- Lock: 0 free, 1 held, 2 held with sleepers (futex) --- */
+
+static volatile uint32_t s_lock;
+
+static inline uint32_t xchg(volatile uint32_t *p, uint32_t v) {
+    __asm__ volatile("xchgl %0, %1" : "+r"(v), "+m"(*p) : : "memory");
+    return v;
+}
+
+static void heap_lock(void) {
+    if (xchg(&s_lock, 1) == 0) return;
+    while (xchg(&s_lock, 2) != 0) {
+        syscall(SYS_FUTEX, (int32_t)(uintptr_t)&s_lock, FUTEX_WAIT, 2);
+    }
+}
+
+static void heap_unlock(void) {
+    if (xchg(&s_lock, 0) == 2) {
+        syscall(SYS_FUTEX, (int32_t)(uintptr_t)&s_lock, FUTEX_WAKE, 1);
+    }
+}
+
+/* --- Mappings --- */
+
+static void unmap(void *addr, size_t len) {
+    syscall(SYS_MUNMAP, (int32_t)(uintptr_t)addr, (int32_t)len, 0);
+    s_stats.unmap_calls++;
+}
+
+// Maps @p len bytes (a page multiple) at a MALLOC_SPAN_SIZE boundary by
+// over-mapping and trimming the ends
+static void *map_aligned(size_t len) {
+    mmap_args_t args = { 0, len + MALLOC_SPAN_SIZE - PAGE_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 };
+    uint32_t ret = (uint32_t)syscall(SYS_MMAP, (int32_t)(uintptr_t)&args, 0, 0);
+    s_stats.map_calls++;
+    if (ret >= (uint32_t)-4095) return NULL; // -errno
+
+    uintptr_t base = ret, start = ALIGN_UP(base, MALLOC_SPAN_SIZE);
+    uintptr_t end = base + args.length;
+    if (start > base) unmap((void *)base, start - base);
+    if (end > start + len) unmap((void *)(start + len), end - (start + len));
+    return (void *)start;
+}
+
+/* --- Span lists --- */
+
+static void list_push(span_t **head, span_t *sp) {
+    sp->prev = NULL;
+    sp->next = *head;
+    if (*head) (*head)->prev = sp;
+    *head = sp;
+}
+
+static void list_remove(span_t **head, span_t *sp) {
+    if (sp->prev) sp->prev->next = sp->next;
+    else *head = sp->next;
+    if (sp->next) sp->next->prev = sp->prev;
+}
+
+static uint32_t size_class(size_t size) {
+    if (size <= SMALL_LUT_MAX) {
+        if (!s_lut_ready) {
+            uint32_t cls = 0;
+            for (uint32_t i = 0; i < sizeof(s_class_of); i++) {
+                while (s_class_size[cls] < i * MALLOC_ALIGN) cls++;
+                s_class_of[i] = (uint8_t)cls;
+            }
+            s_lut_ready = true;
+        }
+        return s_class_of[(size + MALLOC_ALIGN - 1) / MALLOC_ALIGN];
+    }
+    uint32_t cls = 0;
+    while (s_class_size[cls] < size) cls++;
+    return cls;
+}
+
+// A span for @p cls from the cache or a new mapping, on the class list. Lock held.
+static span_t *span_new(uint32_t cls) {
+    span_t *sp = s_empty;
+    if (sp) {
+        list_remove(&s_empty, sp);
+        s_stats.cached_spans--;
+    } else {
+        sp = (span_t *)map_aligned(MALLOC_SPAN_SIZE);
+        if (!sp) return NULL;
+        s_stats.spans++;
+    }
+    sp->magic = SPAN_MAGIC;
+    sp->map_len = MALLOC_SPAN_SIZE;
+    sp->cls = cls;
+    sp->obj_size = s_class_size[cls];
+    sp->nr_objs = (MALLOC_SPAN_SIZE - SPAN_HDR_SIZE) / sp->obj_size;
+    sp->nr_free = sp->nr_objs;
+    sp->free = NULL;
+    sp->bump = (char *)sp + SPAN_HDR_SIZE;
+    list_push(&s_partial[cls], sp);
+    return sp;
+}
+
+// An empty span goes to the cache, or back to the kernel if that is full. Lock held.
+static void span_retire(span_t *sp) {
+    if (s_stats.cached_spans < MALLOC_SPAN_CACHE) {
+        list_push(&s_empty, sp);
+        s_stats.cached_spans++;
+        return;
+    }
+    sp->magic = 0;
+    unmap(sp, MALLOC_SPAN_SIZE);
+    s_stats.spans--;
+}
+
+/* --- Allocation --- */
+
+static void *large_alloc(size_t size) {
+    if (size > 0xC0000000u) return NULL;
+    size_t len = ALIGN_UP(size + LARGE_HDR_SIZE, PAGE_SIZE);
+    heap_lock();
+    span_t *sp = (span_t *)map_aligned(len);
+    if (sp) {
+        sp->magic = LARGE_MAGIC;
+        sp->map_len = len;
+        s_stats.large++;
+    }
+    heap_unlock();
+    return sp ? (char *)sp + LARGE_HDR_SIZE : NULL;
+}
+
+void *malloc(size_t size) {
+    if (size > MALLOC_SMALL_MAX) return large_alloc(size);
+    heap_lock();
+    uint32_t cls = size_class(size);
+    span_t *sp = s_partial[cls];
+    if (!sp && !(sp = span_new(cls))) {
+        heap_unlock();
+        return NULL;
+    }
+    void *obj = sp->free;
+    if (obj) {
+        sp->free = *(void **)obj;
+    } else {
+        obj = sp->bump;
+        sp->bump += sp->obj_size;
+    }
+    if (--sp->nr_free == 0) list_remove(&s_partial[cls], sp);
+    heap_unlock();
+    return obj;
+}
+
+void free(void *ptr) {
+    if (!ptr) return;
+    span_t *sp = (span_t *)((uintptr_t)ptr & ~(uintptr_t)(MALLOC_SPAN_SIZE - 1));
+    heap_lock();
+    if (sp->magic == LARGE_MAGIC) {
+        sp->magic = 0;
+        s_stats.large--;
+        unmap(sp, sp->map_len);
+        heap_unlock();
+        return;
+    }
+    *(void **)ptr = sp->free;
+    sp->free = ptr;
+    if (sp->nr_free++ == 0) list_push(&s_partial[sp->cls], sp); // Was full
+    if (sp->nr_free == sp->nr_objs) {
+        list_remove(&s_partial[sp->cls], sp);
+        span_retire(sp);
+    }
+    heap_unlock();
+}
+
+size_t malloc_usable_size(void *ptr) {
+    if (!ptr) return 0;
+    span_t *sp = (span_t *)((uintptr_t)ptr & ~(uintptr_t)(MALLOC_SPAN_SIZE - 1));
+    return sp->magic == LARGE_MAGIC ? sp->map_len - LARGE_HDR_SIZE : sp->obj_size;
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    if (size && nmemb > (size_t)-1 / size) return NULL;
+    void *ptr = malloc(nmemb * size);
+    if (ptr) memset(ptr, 0, nmemb * size);
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (!ptr) return malloc(size);
+    if (size == 0) {
+        free(ptr);
+        return NULL;
+    }
+    size_t usable = malloc_usable_size(ptr);
+    if (size <= usable && size > usable / 2) return ptr; // Fits without wasting half
+    void *new_ptr = malloc(size);
+    if (!new_ptr) return NULL;
+    memcpy(new_ptr, ptr, size < usable ? size : usable);
+    free(ptr);
+    return new_ptr;
+}
+
+int malloc_trim(size_t pad) {
+    (void)pad;
+    heap_lock();
+    int released = s_empty != NULL;
+    while (s_empty) {
+        span_t *sp = s_empty;
+        list_remove(&s_empty, sp);
+        s_stats.cached_spans--;
+        sp->magic = 0;
+        unmap(sp, MALLOC_SPAN_SIZE);
+        s_stats.spans--;
+    }
+    heap_unlock();
+    return released;
+}
+
+void malloc_get_stats(malloc_stats_t *out) {
+    heap_lock();
+    *out = s_stats;
+    heap_unlock();
+}
@@ -0,0 +1,37 @@
+/*
+ * Userspace heap (malloc.c). Requests up to MALLOC_SMALL_MAX bytes are
+ * rounded up to a size class and carved out of MALLOC_SPAN_SIZE spans:
+ * every class keeps its spans with room on a list and every span its own
+ * free list, so malloc and free are a pop and a push, without a syscall.
+ * Larger requests get a mapping of their own. A span that empties is kept
+ * for reuse, up to MALLOC_SPAN_CACHE of them, and unmapped beyond that;
+ * malloc_trim() unmaps the cache as well. Include after size_t is defined.
+ */
+
+#ifndef USER_MALLOC_H
+#define USER_MALLOC_H
+
+#define MALLOC_SPAN_SIZE   65536   // Span size and alignment
+#define MALLOC_SMALL_MAX   16384   // Largest size-class request
+#define MALLOC_SPAN_CACHE  4       // Empty spans kept mapped
+#define MALLOC_ALIGN       16      // Every pointer returned is aligned to this
+
+void *malloc(size_t size);
+void free(void *ptr);
+void *calloc(size_t nmemb, size_t size);
+void *realloc(void *ptr, size_t size);
+size_t malloc_usable_size(void *ptr);
+/** Unmaps the cached empty spans; @return 1 if memory went back to the kernel. */
+int malloc_trim(size_t pad);
+
+typedef struct malloc_stats {
+    unsigned int spans;         // Size-class spans mapped, cached ones included
+    unsigned int cached_spans;  // Empty spans waiting for reuse
+    unsigned int large;         // Live allocations above MALLOC_SMALL_MAX
+    unsigned int map_calls;     // SYS_MMAP calls so far
+    unsigned int unmap_calls;   // SYS_MUNMAP calls so far
+} malloc_stats_t;
+
+void malloc_get_stats(malloc_stats_t *out);
+
+#endif // USER_MALLOC_H
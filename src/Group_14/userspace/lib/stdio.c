@@ -0,0 +1,427 @@
+/*
+ * Buffered stdio for the userspace programs; see stdio.h.
+ */
+
+#include <libc/stdint.h>
+#include <libc/stddef.h>
+#include <libc/stdarg.h>
+#include <libc/stdbool.h>
+#include "syscall.h"
+#include "string.h"
+#include "stdio.h"
+
+// Must match the kernel's syscall.h
+#define SYS_EXIT    1
+#define SYS_WRITE   4
+#define SYS_OPEN    5
+#define SYS_CLOSE   6
+#define SYS_FSTAT   39
+
+#define O_RDONLY    0x0000
+#define O_WRONLY    0x0001
+#define O_RDWR      0x0002
+#define O_CREAT     0x0040
+#define O_TRUNC     0x0200
+#define O_APPEND    0x0400
+
+// Mirrors the kernel's struct vfs_stat (types.h)
+struct vfs_stat { uint32_t st_ino, st_mode, st_size, st_blksize, st_blocks, st_attr, st_mtime, st_ctime; };
+#define VFS_S_IFMT   0170000
+#define VFS_S_IFCHR  0020000
+
+#define STDIO_MODE_UNSET  (-1)  // Picked at the first write: _IOLBF on the terminal, else _IOFBF
+
+#define STDIO_F_OPEN   0x1
+#define STDIO_F_ERROR  0x2      // A write failed; what was buffered is dropped
+
+struct user_file {
+    int    fd;
+    int    mode;    // _IOFBF, _IOLBF, _IONBF or STDIO_MODE_UNSET
+    int    flags;   // STDIO_F_*
+    char  *buf;
+    size_t size;    // Capacity of buf
+    size_t len;     // Bytes waiting in buf
+};
+
+static char s_stdout_buf[BUFSIZ];
+static char s_file_bufs[FOPEN_MAX][BUFSIZ];
+static struct user_file s_files[2 + FOPEN_MAX] = {
+    { .fd = 1, .mode = STDIO_MODE_UNSET, .flags = STDIO_F_OPEN, .buf = s_stdout_buf, .size = BUFSIZ },
+    { .fd = 2, .mode = _IONBF, .flags = STDIO_F_OPEN },
+};
+
+FILE *stdout = &s_files[0];
+FILE *stderr = &s_files[1];
+
+/* --- Stream buffers --- */
+
+static int write_all(FILE *f, const char *p, size_t n) {
+    while (n > 0) {
+        int32_t done = syscall(SYS_WRITE, f->fd, (int32_t)(uintptr_t)p, (int32_t)n);
+        if (done <= 0) {
+            f->flags |= STDIO_F_ERROR;
+            return EOF;
+        }
+        p += done;
+        n -= (size_t)done;
+    }
+    return 0;
+}
+
+static void resolve_mode(FILE *f) {
+    struct vfs_stat st;
+    bool tty = syscall(SYS_FSTAT, f->fd, (int32_t)(uintptr_t)&st, 0) == 0 &&
+               (st.st_mode & VFS_S_IFMT) == VFS_S_IFCHR;
+    f->mode = tty ? _IOLBF : _IOFBF;
+}
+
+static int flush_buf(FILE *f) {
+    size_t n = f->len;
+    f->len = 0;
+    return n ? write_all(f, f->buf, n) : 0;
+}
+
+// Appends to f's buffer, writing it out when full or, line buffered, at a '\n'
+static int stream_write(FILE *f, const char *p, size_t n) {
+    if (f->mode == STDIO_MODE_UNSET) resolve_mode(f);
+    if (f->mode == _IONBF || f->size == 0) return write_all(f, p, n);
+
+    if (n > f->size - f->len) {
+        if (flush_buf(f) != 0) return EOF;
+        if (n >= f->size) return write_all(f, p, n); // Large writes skip the copy
+    }
+    memcpy(f->buf + f->len, p, n);
+    f->len += n;
+    if (f->len == f->size || (f->mode == _IOLBF && memchr(p, '\n', n))) return flush_buf(f);
+    return 0;
+}
+
+int fflush(FILE *f) {
+    if (f) return flush_buf(f);
+    int ret = 0;
+    for (size_t i = 0; i < sizeof(s_files) / sizeof(s_files[0]); i++) {
+        if ((s_files[i].flags & STDIO_F_OPEN) && flush_buf(&s_files[i]) != 0) ret = EOF;
+    }
+    return ret;
+}
+
+int setvbuf(FILE *f, char *buf, int mode, size_t size) {
+    if (!f || mode < _IOFBF || mode > _IONBF || f->len != 0) return EOF;
+    f->mode = mode;
+    if (mode == _IONBF) {
+        f->size = 0;
+    } else if (buf && size > 0) {
+        f->buf = buf;
+        f->size = size;
+    }
+    return 0;
+}
+
+/* --- Opening and closing --- */
+
+FILE *fdopen(int fd, const char *mode) {
+    if (fd < 0 || !mode) return NULL;
+    for (size_t i = 2; i < sizeof(s_files) / sizeof(s_files[0]); i++) {
+        FILE *f = &s_files[i];
+        if (f->flags & STDIO_F_OPEN) continue;
+        *f = (struct user_file){ .fd = fd, .mode = STDIO_MODE_UNSET, .flags = STDIO_F_OPEN,
+                                 .buf = s_file_bufs[i - 2], .size = BUFSIZ };
+        return f;
+    }
+    return NULL;
+}
+
+FILE *fopen(const char *path, const char *mode) {
+    if (!path || !mode) return NULL;
+    bool plus = strchr(mode, '+') != NULL;
+    int32_t flags;
+    switch (mode[0]) {
+        case 'r': flags = plus ? O_RDWR : O_RDONLY; break;
+        case 'w': flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC; break;
+        case 'a': flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_APPEND; break;
+        default:  return NULL;
+    }
+    int32_t fd = syscall(SYS_OPEN, (int32_t)(uintptr_t)path, flags, 0666);
+    if (fd < 0) return NULL;
+    FILE *f = fdopen((int)fd, mode);
+    if (!f) syscall(SYS_CLOSE, fd, 0, 0);
+    return f;
+}
+
+int fclose(FILE *f) {
+    if (!f || !(f->flags & STDIO_F_OPEN)) return EOF;
+    int ret = flush_buf(f);
+    if (syscall(SYS_CLOSE, f->fd, 0, 0) != 0) ret = EOF;
+    if (f != stdout && f != stderr) f->flags = 0;
+    return ret;
+}
+
+/* --- Unformatted output --- */
+
+size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *f) {
+    size_t total = size * nmemb;
+    if (!f || total == 0) return 0;
+    return stream_write(f, (const char *)ptr, total) == 0 ? nmemb : 0;
+}
+
+int fputc(int c, FILE *f) {
+    char ch = (char)c;
+    return stream_write(f, &ch, 1) == 0 ? (unsigned char)c : EOF;
+}
+
+int putchar(int c) {
+    return fputc(c, stdout);
+}
+
+int fputs(const char *s, FILE *f) {
+    return stream_write(f, s, strlen(s)) == 0 ? 0 : EOF;
+}
+
+int puts(const char *s) {
+    if (fputs(s, stdout) != 0) return EOF;
+    return fputc('\n', stdout) == EOF ? EOF : 0;
+}
+
+/* --- Formatted output --- */
+
+// Where a format goes: a stream, or a caller's buffer (snprintf)
+typedef struct {
+    FILE  *f;
+    char  *buf;
+    size_t size;
+    size_t count;   // Characters produced, stored or not
+    bool   failed;
+} fmt_sink_t;
+
+static void sink_put(fmt_sink_t *s, const char *p, size_t n) {
+    if (s->f) {
+        if (stream_write(s->f, p, n) != 0) s->failed = true;
+    } else if (s->count + 1 < s->size) {
+        size_t room = s->size - 1 - s->count;
+        memcpy(s->buf + s->count, p, n < room ? n : room);
+    }
+    s->count += n;
+}
+
+static void sink_pad(fmt_sink_t *s, char c, int n) {
+    static const char spaces[16] = "                ";
+    static const char zeros[16] = "0000000000000000";
+    const char *run = c == '0' ? zeros : spaces;
+    while (n > 0) {
+        int chunk = n < 16 ? n : 16;
+        sink_put(s, run, (size_t)chunk);
+        n -= chunk;
+    }
+}
+
+/*
+ * *n /= base, returning the remainder. Two 32-bit divides (the high word,
+ * then remainder:low word with divl) keep 64-bit values off libgcc.
+ */
+static uint32_t divmod_u64(uint64_t *n, uint32_t base) {
+    uint32_t hi = (uint32_t)(*n >> 32), lo = (uint32_t)*n;
+    uint32_t rem = hi % base, q_lo;
+    hi /= base;
+    __asm__("divl %4" : "=a"(q_lo), "=d"(rem) : "0"(lo), "1"(rem), "rm"(base));
+    *n = ((uint64_t)hi << 32) | q_lo;
+    return rem;
+}
+
+typedef struct {
+    bool left, zero, plus, space, alt;
+    int  width;
+    int  prec;      // -1: none
+} fmt_spec_t;
+
+static void emit_field(fmt_sink_t *s, const fmt_spec_t *spec, const char *p, size_t n) {
+    int pad = spec->width - (int)n;
+    if (!spec->left) sink_pad(s, ' ', pad);
+    sink_put(s, p, n);
+    if (spec->left) sink_pad(s, ' ', pad);
+}
+
+static void emit_number(fmt_sink_t *s, const fmt_spec_t *spec, uint64_t v, bool neg, uint32_t base, bool upper) {
+    const char *digit_chars = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char digits[24];
+    int nd = 0;
+    bool zero_value = v == 0;
+    while (v != 0) {
+        uint32_t d;
+        if (v >> 32) {
+            d = divmod_u64(&v, base);
+        } else {
+            d = (uint32_t)v % base;
+            v = (uint32_t)v / base;
+        }
+        digits[nd++] = digit_chars[d];
+    }
+    if (zero_value && spec->prec != 0) digits[nd++] = '0';
+
+    char prefix[3];
+    int np = 0;
+    if (neg) prefix[np++] = '-';
+    else if (spec->plus) prefix[np++] = '+';
+    else if (spec->space) prefix[np++] = ' ';
+    if (spec->alt && base == 16 && !zero_value) {
+        prefix[np++] = '0';
+        prefix[np++] = upper ? 'X' : 'x';
+    }
+    int prec_zeros = spec->prec > nd ? spec->prec - nd : 0;
+    if (spec->alt && base == 8 && prec_zeros == 0 && (nd == 0 || digits[nd - 1] != '0')) prec_zeros = 1;
+
+    int pad = spec->width - np - prec_zeros - nd;
+    bool zero_pad = spec->zero && !spec->left && spec->prec < 0;
+    if (!spec->left && !zero_pad) sink_pad(s, ' ', pad);
+    sink_put(s, prefix, (size_t)np);
+    if (zero_pad) sink_pad(s, '0', pad);
+    sink_pad(s, '0', prec_zeros);
+    while (nd > 0) sink_put(s, &digits[--nd], 1);
+    if (spec->left) sink_pad(s, ' ', pad);
+}
+
+static void format(fmt_sink_t *s, const char *fmt, va_list ap) {
+    while (*fmt) {
+        const char *lit = fmt;
+        while (*fmt && *fmt != '%') fmt++;
+        if (fmt > lit) sink_put(s, lit, (size_t)(fmt - lit));
+        if (!*fmt) break;
+        const char *conv_start = fmt++;
+
+        fmt_spec_t spec = { .prec = -1 };
+        for (;; fmt++) {
+            if (*fmt == '-') spec.left = true;
+            else if (*fmt == '0') spec.zero = true;
+            else if (*fmt == '+') spec.plus = true;
+            else if (*fmt == ' ') spec.space = true;
+            else if (*fmt == '#') spec.alt = true;
+            else break;
+        }
+        if (*fmt == '*') {
+            spec.width = va_arg(ap, int);
+            if (spec.width < 0) { spec.left = true; spec.width = -spec.width; }
+            fmt++;
+        } else {
+            while (*fmt >= '0' && *fmt <= '9') spec.width = spec.width * 10 + (*fmt++ - '0');
+        }
+        if (*fmt == '.') {
+            fmt++;
+            spec.prec = 0;
+            if (*fmt == '*') {
+                spec.prec = va_arg(ap, int);
+                if (spec.prec < 0) spec.prec = -1;
+                fmt++;
+            } else {
+                while (*fmt >= '0' && *fmt <= '9') spec.prec = spec.prec * 10 + (*fmt++ - '0');
+            }
+        }
+        int longs = 0;  // l and z are 32 bits here, like int
+        while (*fmt == 'h' || *fmt == 'l' || *fmt == 'z') {
+            if (*fmt++ == 'l') longs++;
+        }
+
+        char conv = *fmt;
+        if (!conv) {
+            sink_put(s, conv_start, (size_t)(fmt - conv_start));
+            break;
+        }
+        fmt++;
+        switch (conv) {
+            case 'c': {
+                char ch = (char)va_arg(ap, int);
+                emit_field(s, &spec, &ch, 1);
+                break;
+            }
+            case 's': {
+                const char *str = va_arg(ap, const char *);
+                if (!str) str = "(null)";
+                size_t n = 0;
+                while (str[n] && (spec.prec < 0 || n < (size_t)spec.prec)) n++;
+                emit_field(s, &spec, str, n);
+                break;
+            }
+            case 'd':
+            case 'i': {
+                long long v = longs >= 2 ? va_arg(ap, long long) : va_arg(ap, int);
+                uint64_t mag = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+                emit_number(s, &spec, mag, v < 0, 10, false);
+                break;
+            }
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o': {
+                uint64_t v = longs >= 2 ? va_arg(ap, unsigned long long) : (uint64_t)va_arg(ap, unsigned int);
+                uint32_t base = conv == 'u' ? 10 : (conv == 'o' ? 8 : 16);
+                emit_number(s, &spec, v, false, base, conv == 'X');
+                break;
+            }
+            case 'p':
+                spec.alt = true;
+                emit_number(s, &spec, (uintptr_t)va_arg(ap, void *), false, 16, false);
+                break;
+            case '%':
+                sink_put(s, "%", 1);
+                break;
+            default:    // Unknown: printed as written
+                sink_put(s, conv_start, (size_t)(fmt - conv_start));
+                break;
+        }
+    }
+}
+
+int vsnprintf(char *buf, size_t size, const char *fmt, va_list ap) {
+    fmt_sink_t s = { .buf = buf, .size = size };
+    format(&s, fmt, ap);
+    if (size > 0) buf[s.count < size ? s.count : size - 1] = '\0';
+    return (int)s.count;
+}
+
+int snprintf(char *buf, size_t size, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int ret = vsnprintf(buf, size, fmt, ap);
+    va_end(ap);
+    return ret;
+}
+
+int vfprintf(FILE *f, const char *fmt, va_list ap) {
+    if (!f) return EOF;
+    if (f->mode == STDIO_MODE_UNSET) resolve_mode(f);
+    if (f->mode == _IONBF || f->size == 0) {
+        // Unbuffered: one write for the whole message where it fits
+        char line[256];
+        va_list copy;
+        __builtin_va_copy(copy, ap);
+        int n = vsnprintf(line, sizeof(line), fmt, copy);
+        va_end(copy);
+        if (n >= 0 && (size_t)n < sizeof(line)) return write_all(f, line, (size_t)n) == 0 ? n : EOF;
+    }
+    fmt_sink_t s = { .f = f };
+    format(&s, fmt, ap);
+    return s.failed ? EOF : (int)s.count;
+}
+
+int fprintf(FILE *f, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int ret = vfprintf(f, fmt, ap);
+    va_end(ap);
+    return ret;
+}
+
+int printf(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int ret = vfprintf(stdout, fmt, ap);
+    va_end(ap);
+    return ret;
+}
+
+/* --- Process exit --- */
+
+void exit(int status) {
+    fflush(NULL);
+    syscall(SYS_EXIT, status, 0, 0);
+    for (;;) {
+    }
+}
@@ -0,0 +1,54 @@
+/*
+ * Buffered output for the userspace programs (stdio.c). stdout is line
+ * buffered on the terminal and fully buffered when it goes to a file or a
+ * pipe, stderr is unbuffered and streams from fopen() are fully buffered,
+ * so a program makes one write per line or per BUFSIZ bytes instead of one
+ * per print call. exit(), which _start calls with main's return value,
+ * flushes every stream; write(1, ...) or SYS_PUTS next to stdout needs an
+ * fflush(stdout) first to stay in order. Include after size_t is defined.
+ */
+
+#ifndef USER_STDIO_H
+#define USER_STDIO_H
+
+typedef struct user_file FILE;
+
+#define EOF        (-1)
+#define BUFSIZ     1024
+#define FOPEN_MAX  8    // Streams open at once besides stdout and stderr
+
+#define _IOFBF 0        // Written when the buffer fills
+#define _IOLBF 1        // Also written at every '\n'
+#define _IONBF 2        // Written at once
+
+extern FILE *stdout;
+extern FILE *stderr;
+
+/** Modes "w" (create, truncate), "a" (create, append), "r"; "+" adds the other direction. NULL on error. */
+FILE *fopen(const char *path, const char *mode);
+FILE *fdopen(int fd, const char *mode);
+int fclose(FILE *f);
+int fflush(FILE *f);    // NULL: every stream
+/** Before the first write to @p f; a NULL @p buf keeps the stream's own buffer. */
+int setvbuf(FILE *f, char *buf, int mode, size_t size);
+
+size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *f);
+int fputc(int c, FILE *f);
+int putchar(int c);
+int fputs(const char *s, FILE *f);
+int puts(const char *s);
+
+/*
+ * Conversions d i u x X o p c s %, flags - 0 + space #, width and precision
+ * (also as *), and the h, l, ll and z length modifiers.
+ */
+int printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+int fprintf(FILE *f, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+int vfprintf(FILE *f, const char *fmt, __builtin_va_list ap);
+int snprintf(char *buf, size_t size, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+int vsnprintf(char *buf, size_t size, const char *fmt, __builtin_va_list ap);
+
+/** Flushes every stream and ends the process with @p status. */
+void exit(int status) __attribute__((noreturn));
+
+#endif // USER_STDIO_H
@@ -0,0 +1,30 @@
+/*
+ * Userspace declarations of the kernel's string routines
+ * (kernel/lib/string.c and string_asm.asm), which every program links:
+ * word-at-a-time scans and rep movsd/stosd copies. Include after size_t is
+ * defined; see include/kernel/lib/string.h for the descriptions.
+ */
+
+#ifndef USER_STRING_H
+#define USER_STRING_H
+
+void *memset(void *s, int c, size_t n);
+void *memcpy(void *dest, const void *src, size_t n);
+void *memmove(void *dest, const void *src, size_t n);
+void *memchr(const void *s, int c, size_t n);
+int memcmp(const void *s1, const void *s2, size_t n);
+
+size_t strlen(const char *s);
+int strcmp(const char *s1, const char *s2);
+int strncmp(const char *s1, const char *s2, size_t n);
+char *strcpy(char *dest, const char *src);
+char *strncpy(char *dest, const char *src, size_t n);
+char *strcat(char *dest, const char *src);
+char *strncat(char *dest, const char *src, size_t n);
+char *strchr(const char *s, int c);
+char *strrchr(const char *s, int c);
+size_t strspn(const char *s, const char *accept);
+char *strpbrk(const char *s, const char *accept);
+char *strtok(char *str, const char *delim);
+
+#endif // USER_STRING_H
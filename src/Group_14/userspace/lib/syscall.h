@@ -0,0 +1,57 @@
+/*
+ * System call wrapper for the userspace programs: SYSENTER where the CPU
+ * has it, int 0x80 otherwise. Include after int32_t and uint32_t are
+ * defined.
+ */
+
+#ifndef USER_SYSCALL_H
+#define USER_SYSCALL_H
+
+// SYSENTER support, probed once: -1 unknown, 0 no, 1 yes.
+// Must match the kernel's check in syscall_init_cpu().
+static int g_use_sysenter = -1;
+
+static int cpu_has_sysenter(void) {
+    uint32_t eax, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+    if (!(edx & (1u << 11))) return 0; // CPUID.1:EDX.SEP
+    uint32_t family = (eax >> 8) & 0xF, model = (eax >> 4) & 0xF, stepping = eax & 0xF;
+    return !(family == 6 && model < 3 && stepping < 3); // Early Pentium Pro lies about SEP
+}
+
+static inline int32_t syscall(int32_t syscall_number,
+                              int32_t arg1_val,
+                              int32_t arg2_val,
+                              int32_t arg3_val) {
+    int32_t return_value;
+    if (g_use_sysenter < 0) g_use_sysenter = cpu_has_sysenter();
+    if (g_use_sysenter) {
+        // Fast path: ESI = return address, EBP = stack pointer; the kernel
+        // returns with SYSEXIT, which clobbers ECX and EDX.
+        __asm__ volatile (
+            "pushl %%ebp          \n\t"
+            "pushl %%esi          \n\t"
+            "movl %%esp, %%ebp    \n\t"
+            "movl $1f, %%esi      \n\t"
+            "sysenter             \n"
+            "1:                   \n\t"
+            "popl %%esi           \n\t"
+            "popl %%ebp           \n\t"
+            : "=a" (return_value), "+b" (arg1_val), "+c" (arg2_val), "+d" (arg3_val)
+            : "0" (syscall_number)
+            : "cc", "memory"
+        );
+        return return_value;
+    }
+    // Register operands: the library is built with -O2, where "m" operands
+    // could be ESP-relative and would move under pushes
+    __asm__ volatile (
+        "int $0x80"
+        : "=a" (return_value), "+b" (arg1_val), "+c" (arg2_val), "+d" (arg3_val)
+        : "0" (syscall_number)
+        : "cc", "memory"
+    );
+    return return_value;
+}
+
+#endif // USER_SYSCALL_H
@@ -0,0 +1,64 @@
+/*
+ * Userspace access to the kernel's vvar pages (include/kernel/process/vvar.h):
+ * the PID, the tick count and the monotonic clock without a syscall.
+ * Include after uint32_t and uint64_t are defined; the layouts and addresses
+ * below must match the kernel's.
+ */
+
+#ifndef USER_VVAR_H
+#define USER_VVAR_H
+
+#define VVAR_DATA_ADDR  0xBFFF8000u
+#define VVAR_PROC_ADDR  0xBFFF9000u
+
+typedef struct {
+    uint32_t version;
+    volatile uint32_t ticks;
+    uint32_t tick_hz;
+    uint32_t tsc_khz;       // 0: no TSC, the clock runs on ticks
+    uint32_t tsc_mult;
+    uint32_t tsc_shift;
+    uint64_t tsc_base;
+} user_vvar_data_t;
+
+typedef struct {
+    uint32_t pid;
+    uint32_t ppid;
+} user_vvar_proc_t;
+
+#define VVAR_DATA ((const user_vvar_data_t *)VVAR_DATA_ADDR)
+#define VVAR_PROC ((const user_vvar_proc_t *)VVAR_PROC_ADDR)
+
+/* Same value as SYS_GETPID. */
+static inline uint32_t vvar_getpid(void) {
+    return VVAR_PROC->pid;
+}
+
+/* Scheduler ticks since boot (wraps at 32 bits); VVAR_DATA->tick_hz per second. */
+static inline uint32_t vvar_ticks(void) {
+    return VVAR_DATA->ticks;
+}
+
+static inline uint64_t vvar_rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/*
+ * Nanoseconds on the SYS_CLOCK_GETTIME CLOCK_MONOTONIC timeline. Converts
+ * like the kernel's clock_cycles_to_ns(): 32x32 multiplies only, so no
+ * libgcc 64-bit division is needed.
+ */
+static inline uint64_t vvar_clock_ns(void) {
+    const user_vvar_data_t *d = VVAR_DATA;
+    if (!d->tsc_khz) return (uint64_t)d->ticks * (1000000000u / d->tick_hz);
+    uint64_t cycles = vvar_rdtsc() - d->tsc_base;
+    uint32_t hi = (uint32_t)(cycles >> 32);
+    uint32_t lo = (uint32_t)cycles;
+    uint64_t ns = ((uint64_t)lo * d->tsc_mult) >> d->tsc_shift;
+    if (hi) ns += ((uint64_t)hi * d->tsc_mult) << (32 - d->tsc_shift);
+    return ns;
+}
+
+#endif /* USER_VVAR_H */
@@ -22,6 +22,7 @@ typedef signed   short     int16_t;
 typedef unsigned short     uint16_t;
 typedef signed   int       int32_t;
 typedef unsigned int       uint32_t;
+typedef signed   long long int64_t;
 typedef unsigned long long uint64_t;
 typedef uint32_t           uintptr_t; // For i386 user space
 
@@ -51,124 +52,329 @@ typedef char bool;
 #define SYS_WRITE   4
 // #define SYS_OPEN    5 // Not used by this simple shell directly
 // #define SYS_CLOSE   6 // Not used by this simple shell directly
-#define SYS_PUTS    7
 #define SYS_READ_TERMINAL_LINE 21 // Your new syscall number
+#define SYS_CLOCK_GETTIME 23
+#define SYS_WAITPID 24
+#define SYS_STAT    38
+#define SYS_SPAWN   49
+
+#define CLOCK_MONOTONIC 1
+
+#define ENOENT      2
+
+// Matches the kernel's clock_timespec_t
+typedef struct {
+    int64_t tv_sec;
+    int64_t tv_nsec;
+} clock_timespec_t;
+
+// Matches the kernel's struct vfs_stat (types.h)
+typedef struct {
+    uint32_t st_ino, st_mode, st_size, st_blksize, st_blocks, st_attr, st_mtime, st_ctime;
+} vfs_stat_t;
+
+#define VFS_S_IFMT  0170000
+#define VFS_S_IFREG 0100000
+
+// Matches the kernel's spawn_args_t (process.h)
+typedef struct { uint32_t path, argv, envp, fd_actions, nr_fd_actions; } spawn_args_t;
 
 #define STDIN_FILENO  0
 #define STDOUT_FILENO 1
 
-// --- Syscall Wrapper Prototype ---
-// The function 'syscall' must be declared before its first use in a macro.
-static inline int32_t syscall(int32_t syscall_number,
-                              int32_t arg1_val,
-                              int32_t arg2_val,
-                              int32_t arg3_val);
+// --- Syscall Wrapper and C Library ---
+// The shared SYSENTER/int 0x80 wrapper, buffered stdio (stdout is line
+// buffered on the terminal) and the kernel's string routines.
+#include "../lib/syscall.h"
+#include "../lib/string.h"
+#include "../lib/stdio.h"
 
 // --- Syscall Helpers ---
 // These macros use the 'syscall' function.
-#define sys_exit(code)      syscall(SYS_EXIT, (code), 0, 0)
 #define sys_read_generic(fd,buf,n)  syscall(SYS_READ, (fd), (int32_t)(uintptr_t)(buf), (n))
 #define sys_write(fd,buf,n) syscall(SYS_WRITE, (fd), (int32_t)(uintptr_t)(buf), (n))
-#define sys_puts(p)         syscall(SYS_PUTS, (int32_t)(uintptr_t)(p), 0, 0)
 #define sys_read_terminal_line(buf, n) syscall(SYS_READ_TERMINAL_LINE, (int32_t)(uintptr_t)(buf), (n), 0)
+#define sys_clock_gettime(id, ts) syscall(SYS_CLOCK_GETTIME, (id), (int32_t)(uintptr_t)(ts), 0)
+#define sys_waitpid(pid, status) syscall(SYS_WAITPID, (pid), (int32_t)(uintptr_t)(status), 0)
+#define sys_stat(path, st) syscall(SYS_STAT, (int32_t)(uintptr_t)(path), (int32_t)(uintptr_t)(st), 0)
+#define sys_spawn(args) syscall(SYS_SPAWN, (int32_t)(uintptr_t)(args), 0, 0)
+
+
+#define CMD_BUFFER_SIZE 256
+char cmd_buffer[CMD_BUFFER_SIZE];
+
+#define SHELL_MAX_ARGS 16
+
+// --- Command Cache ---
+// Names resolved against the search path, with the stat of the program
+// found, so a repeated command costs one stat per search directory (the
+// kernel answers those from its lookup caches) instead of a probe for each
+// candidate file. Any change to a search directory's stat (its mtime on
+// FAT) drops the whole cache; so does a cached path that fails to spawn
+// with ENOENT, since FAT does not touch a directory's mtime when an entry
+// in it is created or removed. "hash -r" drops it by hand.
+
+#define CMD_CACHE_SLOTS 32 // Power of two; open addressing, linear probing
+#define CMD_NAME_MAX    32
+#define CMD_PATH_MAX    64
+
+typedef struct {
+    char       name[CMD_NAME_MAX]; // Empty: free slot
+    char       path[CMD_PATH_MAX];
+    vfs_stat_t st;                 // The program's, when it was resolved
+    uint32_t   hits;
+} cmd_cache_entry_t;
+
+static const char *const s_search_dirs[] = { "/bin", "/" };
+static const char *const s_suffixes[] = { ".elf", "" };
+#define NR_SEARCH_DIRS (sizeof(s_search_dirs) / sizeof(s_search_dirs[0]))
+#define NR_SUFFIXES    (sizeof(s_suffixes) / sizeof(s_suffixes[0]))
+
+static cmd_cache_entry_t s_cmd_cache[CMD_CACHE_SLOTS];
+static uint32_t s_cmd_cached;
+static vfs_stat_t s_dir_stat[NR_SEARCH_DIRS]; // As of the last validation
+static bool s_dir_stat_valid[NR_SEARCH_DIRS];
+
+static uint32_t cmd_hash(const char *s) {
+    uint32_t h = 2166136261u; // FNV-1a
+    while (*s) h = (h ^ (uint8_t)*s++) * 16777619u;
+    return h;
+}
 
+static void cmd_cache_flush(void) {
+    memset(s_cmd_cache, 0, sizeof(s_cmd_cache));
+    s_cmd_cached = 0;
+}
 
-// --- Syscall Wrapper Definition ---
-// This must come AFTER the type definitions it uses (int32_t).
-static inline int32_t syscall(int32_t syscall_number,
-                              int32_t arg1_val,
-                              int32_t arg2_val,
-                              int32_t arg3_val) {
-    int32_t return_value;
-    __asm__ volatile (
-        "pushl %%ebx          \n\t"
-        "pushl %%ecx          \n\t"
-        "pushl %%edx          \n\t"
-        "movl %1, %%eax       \n\t"
-        "movl %2, %%ebx       \n\t"
-        "movl %3, %%ecx       \n\t"
-        "movl %4, %%edx       \n\t"
-        "int $0x80            \n\t"
-        "popl %%edx           \n\t"
-        "popl %%ecx           \n\t"
-        "popl %%ebx           \n\t"
-        : "=a" (return_value)
-        : "m" (syscall_number), "m" (arg1_val), "m" (arg2_val), "m" (arg3_val)
-        : "cc", "memory"
-    );
-    return return_value;
-}
-
-// --- String Utilities ---
-// Prototypes for string utilities
-static size_t my_strlen(const char *s);
-static int my_strcmp(const char *s1, const char *s2);
-
-// Definitions for string utilities
-static size_t my_strlen(const char *s) {
-    size_t i = 0;
-    if (!s) return 0;
-    while (s[i]) i++;
-    return i;
-}
-
-static int my_strcmp(const char *s1, const char *s2) {
-    if (!s1 && !s2) {
-        return 0;
+// Drops the cache if a search directory changed (or appeared or vanished)
+static void cmd_cache_validate(void) {
+    bool changed = false;
+    for (uint32_t i = 0; i < NR_SEARCH_DIRS; i++) {
+        vfs_stat_t st;
+        bool valid = sys_stat(s_search_dirs[i], &st) == 0;
+        if (valid != s_dir_stat_valid[i] ||
+            (valid && (st.st_ino != s_dir_stat[i].st_ino || st.st_mtime != s_dir_stat[i].st_mtime ||
+                       st.st_size != s_dir_stat[i].st_size))) {
+            changed = true;
+        }
+        s_dir_stat_valid[i] = valid;
+        if (valid) s_dir_stat[i] = st;
     }
-    if (!s1) {
-        return -1;
+    if (changed) cmd_cache_flush();
+}
+
+// The slot holding @p name, or the free slot where it would go
+static cmd_cache_entry_t *cmd_cache_slot(const char *name) {
+    uint32_t i = cmd_hash(name) & (CMD_CACHE_SLOTS - 1);
+    while (s_cmd_cache[i].name[0] && strcmp(s_cmd_cache[i].name, name) != 0) {
+        i = (i + 1) & (CMD_CACHE_SLOTS - 1);
     }
-    if (!s2) {
-        return 1;
+    return &s_cmd_cache[i];
+}
+
+// Probes the search path for @p name; true with the path and stat filled in
+static bool cmd_search(const char *name, char *path, vfs_stat_t *st) {
+    for (uint32_t d = 0; d < NR_SEARCH_DIRS; d++) {
+        const char *dir = s_search_dirs[d];
+        for (uint32_t x = 0; x < NR_SUFFIXES; x++) {
+            int len = snprintf(path, CMD_PATH_MAX, "%s%s%s%s", dir,
+                               strcmp(dir, "/") == 0 ? "" : "/", name, s_suffixes[x]);
+            if (len < 0 || len >= CMD_PATH_MAX) continue;
+            if (sys_stat(path, st) == 0 && (st->st_mode & VFS_S_IFMT) == VFS_S_IFREG) return true;
+        }
+    }
+    return false;
+}
+
+// The program @p name runs, from the cache or the search path; NULL if none
+static const char *cmd_lookup(const char *name) {
+    if (strchr(name, '/')) return name; // A path: the kernel resolves it
+    if (strlen(name) >= CMD_NAME_MAX) return NULL;
+
+    cmd_cache_validate();
+    cmd_cache_entry_t *e = cmd_cache_slot(name);
+    if (e->name[0]) {
+        e->hits++;
+        return e->path;
     }
-    while (*s1 && (*s1 == *s2)) {
-        s1++;
-        s2++;
+
+    static char path[CMD_PATH_MAX];
+    vfs_stat_t st;
+    if (!cmd_search(name, path, &st)) return NULL;
+    if (s_cmd_cached >= CMD_CACHE_SLOTS * 3 / 4) { // Keep probe chains short
+        cmd_cache_flush();
+        e = cmd_cache_slot(name);
     }
-    return *(const unsigned char*)s1 - *(const unsigned char*)s2;
+    strcpy(e->name, name);
+    strcpy(e->path, path);
+    e->st = st;
+    e->hits = 0;
+    s_cmd_cached++;
+    return e->path;
 }
 
-#define CMD_BUFFER_SIZE 256
-char cmd_buffer[CMD_BUFFER_SIZE];
+// --- Running Programs ---
+
+// Spawns @p path with @p argv and waits for it. Returns its wait status, or -errno.
+static int32_t run_program(const char *path, char **argv) {
+    spawn_args_t args = { (uint32_t)(uintptr_t)path, (uint32_t)(uintptr_t)argv, 0, 0, 0 };
+    int32_t pid = sys_spawn(&args);
+    if (pid < 0) return pid;
+    int status = 0;
+    int32_t ret = sys_waitpid(pid, &status);
+    return ret < 0 ? ret : status;
+}
+
+static void run_external(int argc, char **argv) {
+    (void)argc;
+    fflush(stdout); // The child writes to the terminal directly
+    const char *path = cmd_lookup(argv[0]);
+    int32_t ret = path ? run_program(path, argv) : -ENOENT;
+    if (ret == -ENOENT && path && path != argv[0]) {
+        cmd_cache_flush(); // Stale: the file went away under an unchanged directory
+        path = cmd_lookup(argv[0]);
+        ret = path ? run_program(path, argv) : -ENOENT;
+    }
+
+    if (ret == -ENOENT) {
+        printf("%s: command not found\n", argv[0]);
+    } else if (ret < 0) {
+        printf("%s: cannot run (%d)\n", argv[0], (int)ret);
+    } else if (ret != 0) {
+        printf("[%s exited with %d]\n", argv[0], (int)((uint32_t)ret >> 8));
+    }
+}
+
+// --- Builtins ---
+// Dispatched through a perfect hash of the name's first two characters and
+// its length into a table with no collisions, so a builtin costs one
+// strcmp and an external command usually none. Check for collisions when
+// adding one; BUILTIN_SLOTS may have to grow.
+
+typedef void (*builtin_fn_t)(int argc, char **argv);
+
+typedef struct {
+    const char  *name;
+    builtin_fn_t fn;
+    const char  *help;
+} builtin_t;
+
+#define BUILTIN_SLOTS 16
+
+static uint32_t builtin_hash(const char *s) {
+    return ((uint8_t)s[0] + 2u * (uint8_t)s[1] + (uint32_t)strlen(s)) & (BUILTIN_SLOTS - 1);
+}
+
+static void builtin_exit(int argc, char **argv);
+static void builtin_help(int argc, char **argv);
+static void builtin_uptime(int argc, char **argv);
+static void builtin_hash_cmd(int argc, char **argv);
+static void builtin_time(int argc, char **argv);
+
+// Indexed by builtin_hash() of the name
+static const builtin_t s_builtins[BUILTIN_SLOTS] = {
+    [6]  = { "help",   builtin_help,     "Display this help message." },
+    [9]  = { "exit",   builtin_exit,     "Exit the shell (with an optional status)." },
+    [10] = { "time",   builtin_time,     "Run a command and show how long it took." },
+    [11] = { "uptime", builtin_uptime,   "Show time since boot." },
+    [14] = { "hash",   builtin_hash_cmd, "List the command cache; -r empties it." },
+};
+
+static const builtin_t *builtin_find(const char *name) {
+    const builtin_t *b = &s_builtins[builtin_hash(name)];
+    return b->name && strcmp(b->name, name) == 0 ? b : NULL;
+}
+
+static void run_command(int argc, char **argv) {
+    const builtin_t *b = builtin_find(argv[0]);
+    if (b) b->fn(argc, argv);
+    else run_external(argc, argv);
+}
+
+static void builtin_exit(int argc, char **argv) {
+    int status = 0;
+    if (argc > 1) {
+        for (const char *p = argv[1]; *p >= '0' && *p <= '9'; p++) status = status * 10 + (*p - '0');
+    }
+    puts("Exiting shell.");
+    exit(status);
+}
+
+static void builtin_help(int argc, char **argv) {
+    (void)argc; (void)argv;
+    fputs("Available commands:\n", stdout);
+    for (uint32_t i = 0; i < BUILTIN_SLOTS; i++) {
+        if (s_builtins[i].name) printf("  %-6s - %s\n", s_builtins[i].name, s_builtins[i].help);
+    }
+    fputs("Anything else runs as a program from /bin or /, with or without .elf.\n", stdout);
+}
+
+static void builtin_uptime(int argc, char **argv) {
+    (void)argc; (void)argv;
+    clock_timespec_t ts;
+    if (sys_clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+        printf("Up %u.%06u s\n", (uint32_t)ts.tv_sec, (uint32_t)ts.tv_nsec / 1000);
+    } else {
+        puts("clock_gettime failed.");
+    }
+}
+
+static void builtin_hash_cmd(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "-r") == 0) {
+        cmd_cache_flush();
+        return;
+    }
+    for (uint32_t i = 0; i < CMD_CACHE_SLOTS; i++) {
+        const cmd_cache_entry_t *e = &s_cmd_cache[i];
+        if (e->name[0]) printf("%4u  %s\n", e->hits, e->path);
+    }
+}
+
+static void builtin_time(int argc, char **argv) {
+    if (argc < 2) return;
+    clock_timespec_t t0, t1;
+    sys_clock_gettime(CLOCK_MONOTONIC, &t0);
+    run_command(argc - 1, argv + 1);
+    sys_clock_gettime(CLOCK_MONOTONIC, &t1);
+    uint32_t us = (uint32_t)(t1.tv_sec - t0.tv_sec) * 1000000u +
+                  (uint32_t)t1.tv_nsec / 1000 - (uint32_t)t0.tv_nsec / 1000;
+    printf("real %u.%03u ms\n", us / 1000, us % 1000);
+}
+
+// Splits @p line in place at blanks; returns the word count
+static int split_args(char *line, char **argv) {
+    int argc = 0;
+    while (*line) {
+        while (*line == ' ' || *line == '\t') *line++ = '\0';
+        if (!*line) break;
+        if (argc == SHELL_MAX_ARGS) {
+            puts("Too many arguments.");
+            return 0;
+        }
+        argv[argc++] = line;
+        while (*line && *line != ' ' && *line != '\t') line++;
+    }
+    argv[argc] = NULL;
+    return argc;
+}
 
 int main(void) {
-    sys_puts("UiAOS Shell v0.1 (Self-Contained) Initialized.\n");
+    puts("UiAOS Shell v0.2 Initialized. Type 'help' for commands.");
 
     while (1) {
-        sys_puts("UiAOS> ");
+        fputs("UiAOS> ", stdout);
+        fflush(stdout); // The prompt has no '\n' to flush it
 
         ssize_t bytes_read = sys_read_terminal_line(cmd_buffer, CMD_BUFFER_SIZE);
-        
-        
 
         if (bytes_read >= 0) {
             // Kernel should have null-terminated at cmd_buffer[bytes_read]
-            // No further null termination needed here if kernel does its job.
-
-            if (bytes_read == 0 && cmd_buffer[0] == '\0') { // Empty line after Enter
-                continue;
-            }
-
-            if (my_strcmp(cmd_buffer, "exit") == 0) {
-                sys_puts("Exiting shell.\n");
-                sys_exit(0);
-            } else if (my_strcmp(cmd_buffer, "help") == 0) {
-                sys_puts("Available commands:\n");
-                sys_puts("  exit  - Exit the shell.\n");
-                sys_puts("  help  - Display this help message.\n");
-                sys_puts("  hello - (Conceptual) Run hello program.\n");
-            } else if (my_strcmp(cmd_buffer, "hello") == 0) {
-                sys_puts("Conceptual: Would try to run /hello.elf\n");
-            } else {
-                sys_puts("Unknown command: ");
-                sys_puts(cmd_buffer);
-                sys_puts("\n");
-            }
+            char *argv[SHELL_MAX_ARGS + 1];
+            int argc = split_args(cmd_buffer, argv);
+            if (argc > 0) run_command(argc, argv);
         } else { // Error from sys_read_terminal_line
-            sys_puts("Error reading input from terminal.\n");
-            // Potentially print bytes_read (the error code) if you have a print_sdec
+            printf("Error reading input from terminal (%d).\n", (int)bytes_read);
         }
     }
     return 0;
-}
\ No newline at end of file
+}